@@ -55,6 +55,32 @@
 #define PLD(code...)
 #endif
 
+/*
+ * How far ahead of the source the bulk copy loops preload, in bytes.
+ * Slow memory behind the cache wants more lines in flight.
+ */
+#ifdef CONFIG_ARM_COPY_PLD_AHEAD
+#define PLD_AHEAD	CONFIG_ARM_COPY_PLD_AHEAD
+#else
+#define PLD_AHEAD	96
+#endif
+
+#if PLD_AHEAD < 64 || PLD_AHEAD % 32
+#error "PLD_AHEAD must be a multiple of 32 and at least 64"
+#endif
+
+/*
+ * Preload the cache lines \off, \off + \step, ... from \base that
+ * are still missing before a loop preloading PLD_AHEAD bytes ahead.
+ */
+	.macro	pld_ahead, base, off, step=32
+	.set	.Lpld_off, \off
+	.rept	PLD_AHEAD / 32 - 1
+	pld	[\base, #.Lpld_off]
+	.set	.Lpld_off, .Lpld_off + \step
+	.endr
+	.endm
+
 /*
  * This can be used to enable code to cacheline align the destination
  * pointer when bulk writing to memory.  Experiments on StrongARM and
@@ -74,4 +74,30 @@ init_pmu(enum arm_pmu_type device)
 
 #endif /* CONFIG_CPU_HAS_PMU */
 
+#ifdef CONFIG_HW_PERF_EVENTS
+
+/*
+ * Save and restore the counters around a power collapse that loses the
+ * PMU state. Both must be called with interrupts disabled.
+ */
+extern void
+armpmu_suspend(void);
+
+extern void
+armpmu_resume(void);
+
+#else /* CONFIG_HW_PERF_EVENTS */
+
+static inline void
+armpmu_suspend(void)
+{
+}
+
+static inline void
+armpmu_resume(void)
+{
+}
+
+#endif /* CONFIG_HW_PERF_EVENTS */
+
 #endif /* __ARM_PMU_H__ */
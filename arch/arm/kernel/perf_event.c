@@ -558,6 +558,58 @@ hw_perf_disable(void)
 		armpmu->stop();
 }
 
+/*
+ * Power collapse resets the PMU. The platform calls armpmu_suspend() with
+ * interrupts off before it powers the core down, which folds the running
+ * counts into the events, and armpmu_resume() once it is back, which
+ * programs the counters again from the events' remaining periods. Events
+ * keep counting across the collapse as if the core had just been idle.
+ */
+static int armpmu_suspended;
+
+void
+armpmu_suspend(void)
+{
+	struct cpu_hw_events *cpuc = &__get_cpu_var(cpu_hw_events);
+	int idx;
+
+	if (!armpmu || !pmu_device)
+		return;
+
+	armpmu->stop();
+	for (idx = 0; idx <= armpmu->num_events; ++idx) {
+		struct perf_event *event = cpuc->events[idx];
+
+		if (!event || !test_bit(idx, cpuc->active_mask))
+			continue;
+
+		armpmu_event_update(event, &event->hw, idx);
+	}
+	armpmu_suspended = 1;
+}
+
+void
+armpmu_resume(void)
+{
+	struct cpu_hw_events *cpuc = &__get_cpu_var(cpu_hw_events);
+	int idx;
+
+	if (!armpmu_suspended)
+		return;
+	armpmu_suspended = 0;
+
+	for (idx = 0; idx <= armpmu->num_events; ++idx) {
+		struct perf_event *event = cpuc->events[idx];
+
+		if (!event || !test_bit(idx, cpuc->active_mask))
+			continue;
+
+		armpmu_event_set_period(event, &event->hw, idx);
+		armpmu->enable(&event->hw, idx);
+	}
+	armpmu->start();
+}
+
 /*
  * ARMv6 Performance counter handling code.
  *
@@ -624,8 +676,8 @@ enum armv6_counters {
 static const unsigned armv6_perf_map[PERF_COUNT_HW_MAX] = {
 	[PERF_COUNT_HW_CPU_CYCLES]	    = ARMV6_PERFCTR_CPU_CYCLES,
 	[PERF_COUNT_HW_INSTRUCTIONS]	    = ARMV6_PERFCTR_INSTR_EXEC,
-	[PERF_COUNT_HW_CACHE_REFERENCES]    = HW_OP_UNSUPPORTED,
-	[PERF_COUNT_HW_CACHE_MISSES]	    = HW_OP_UNSUPPORTED,
+	[PERF_COUNT_HW_CACHE_REFERENCES]    = ARMV6_PERFCTR_DCACHE_ACCESS,
+	[PERF_COUNT_HW_CACHE_MISSES]	    = ARMV6_PERFCTR_DCACHE_MISS,
 	[PERF_COUNT_HW_BRANCH_INSTRUCTIONS] = ARMV6_PERFCTR_BR_EXEC,
 	[PERF_COUNT_HW_BRANCH_MISSES]	    = ARMV6_PERFCTR_BR_MISPREDICT,
 	[PERF_COUNT_HW_BUS_CYCLES]	    = HW_OP_UNSUPPORTED,
@@ -0,0 +1,145 @@
+/*
+ *  linux/arch/arm/lib/copy_bench.c
+ *
+ *  Throughput of memcpy and the user copy routines
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Loading the module runs every copy over each size and source/destination
+ * alignment below and prints the result in MB/s. The user buffer is an
+ * anonymous mapping in the address space of the process loading the module.
+ * The module refuses to stay loaded afterwards, like tcrypt.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/uaccess.h>
+
+/* Bytes copied for each measurement */
+#define BENCH_BYTES	(16 << 20)
+#define BENCH_MAX_SIZE	(64 << 10)
+/* Room for the misalignment */
+#define BENCH_BUF_SIZE	(BENCH_MAX_SIZE + PAGE_SIZE)
+
+static const unsigned int bench_sizes[] = { 32, 128, 512, 4096, 65536 };
+
+static const struct {
+	unsigned int src, dst;
+} bench_align[] = {
+	{ 0, 0 }, { 1, 0 }, { 0, 1 }, { 2, 2 },
+};
+
+enum { BENCH_MEMCPY, BENCH_TO_USER, BENCH_FROM_USER };
+
+static const char *bench_names[] = {
+	[BENCH_MEMCPY]		= "memcpy",
+	[BENCH_TO_USER]		= "copy_to_user",
+	[BENCH_FROM_USER]	= "copy_from_user",
+};
+
+static int bench_one(int type, char *kbuf, char __user *ubuf,
+		     unsigned int size, unsigned int src, unsigned int dst)
+{
+	unsigned int loops = max(BENCH_BYTES / size, 1U);
+	unsigned int i;
+	ktime_t start;
+	s64 ns;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		switch (type) {
+		case BENCH_MEMCPY:
+			memcpy(kbuf + BENCH_BUF_SIZE + dst, kbuf + src, size);
+			break;
+		case BENCH_TO_USER:
+			if (copy_to_user(ubuf + dst, kbuf + src, size))
+				return -EFAULT;
+			break;
+		case BENCH_FROM_USER:
+			if (copy_from_user(kbuf + dst, ubuf + src, size))
+				return -EFAULT;
+			break;
+		}
+		barrier();
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	/* bytes per us is MB/s */
+	printk(KERN_INFO "copy_bench: %-14s %6u bytes src+%u dst+%u: %llu MB/s\n",
+	       bench_names[type], size, src, dst,
+	       ns > 0 ? div64_u64((u64)loops * size * 1000, ns) : 0ULL);
+
+	cond_resched();
+	return 0;
+}
+
+static int __init copy_bench_init(void)
+{
+	unsigned long kbuf, ubuf;
+	int type, s, a;
+	int ret = 0;
+
+	/* Source and destination of memcpy side by side */
+	kbuf = __get_free_pages(GFP_KERNEL, get_order(2 * BENCH_BUF_SIZE));
+	if (!kbuf)
+		return -ENOMEM;
+	memset((void *)kbuf, 0x5a, 2 * BENCH_BUF_SIZE);
+
+	down_write(&current->mm->mmap_sem);
+	ubuf = do_mmap(NULL, 0, BENCH_BUF_SIZE, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, 0);
+	up_write(&current->mm->mmap_sem);
+	if (IS_ERR_VALUE(ubuf)) {
+		ret = ubuf;
+		goto out_free;
+	}
+
+	/* Fault the user pages in before timing anything */
+	if (copy_to_user((void __user *)ubuf, (void *)kbuf, BENCH_BUF_SIZE)) {
+		ret = -EFAULT;
+		goto out_unmap;
+	}
+
+	printk(KERN_INFO "copy_bench: preload distance %d bytes\n",
+	       CONFIG_ARM_COPY_PLD_AHEAD);
+
+	for (type = BENCH_MEMCPY; type <= BENCH_FROM_USER; type++)
+		for (s = 0; s < ARRAY_SIZE(bench_sizes); s++)
+			for (a = 0; a < ARRAY_SIZE(bench_align); a++) {
+				ret = bench_one(type, (char *)kbuf,
+						(char __user *)ubuf,
+						bench_sizes[s],
+						bench_align[a].src,
+						bench_align[a].dst);
+				if (ret)
+					goto out_unmap;
+			}
+
+	/* Done, don't stay loaded */
+	ret = -EAGAIN;
+
+out_unmap:
+	down_write(&current->mm->mmap_sem);
+	do_munmap(current->mm, ubuf, BENCH_BUF_SIZE);
+	up_write(&current->mm->mmap_sem);
+out_free:
+	free_pages(kbuf, get_order(2 * BENCH_BUF_SIZE));
+	return ret;
+}
+
+static void __exit copy_bench_exit(void)
+{
+}
+
+module_init(copy_bench_init);
+module_exit(copy_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("memcpy and user copy throughput");
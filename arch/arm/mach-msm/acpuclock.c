@@ -28,10 +28,14 @@
 #include <linux/mutex.h>
 #include <linux/io.h>
 #include <linux/sort.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 #include <linux/remote_spinlock.h>
 #include <mach/board.h>
 #include <mach/msm_iomap.h>
 #include <asm/mach-types.h>
+#include <asm/div64.h>
 
 #include "proc_comm.h"
 #include "smd_private.h"
@@ -64,6 +68,21 @@ struct clock_state {
 	uint32_t			max_speed_delta_khz;
 	uint32_t			vdd_switch_time_us;
 	unsigned long			max_axi_khz;
+	/* PLLs the application processor holds a vote on */
+	unsigned int			plls_voted;
+};
+
+/* Frequency switch statistics, in debugfs as acpuclock/stats */
+struct acpuclk_stats {
+	unsigned int	switches;
+	unsigned int	steps;
+	u64		total_us;
+	unsigned int	max_us;
+	unsigned int	last_us;
+	unsigned int	vdd_writes;
+	unsigned int	vdd_skips;
+	unsigned int	pll_requests;
+	unsigned int	pll_skips;
 };
 
 #define PLL_BASE	7
@@ -104,6 +123,7 @@ static remote_spinlock_t pll_lock;
 static struct shared_pll_control *pll_control;
 static struct clock_state drv_state = { 0 };
 static struct clkctl_acpu_speed *acpu_freq_tbl;
+static struct acpuclk_stats acpuclk_stats;
 
 static void __init acpuclk_init(void);
 
@@ -416,6 +436,13 @@ static int pc_pll_request(unsigned id, unsigned on)
 	if (id >= ACPU_PLL_END)
 		return -EINVAL;
 
+	/* Voting again for what we already voted is a wasted round trip */
+	if (on == !!(drv_state.plls_voted & (1 << id))) {
+		acpuclk_stats.pll_skips++;
+		return 0;
+	}
+	acpuclk_stats.pll_requests++;
+
 	if (pll_control) {
 		remote_spin_lock(&pll_lock);
 		if (on) {
@@ -443,6 +470,11 @@ static int pc_pll_request(unsigned id, unsigned on)
 			return -EINVAL;
 	}
 
+	if (on)
+		drv_state.plls_voted |= 1 << id;
+	else
+		drv_state.plls_voted &= ~(1 << id);
+
 	if (on)
 		dprintk("PLL enabled\n");
 	else
@@ -478,6 +510,15 @@ static int acpuclk_set_vdd_level(int vdd)
 
 	current_vdd = readl(A11S_VDD_SVS_PLEVEL_ADDR) & 0x07;
 
+	/* Already there, skip the write and the settling delay. Reading it
+	 * back rather than caching it also covers modem firmwares that reset
+	 * the VDD across power collapse. */
+	if (current_vdd == vdd) {
+		acpuclk_stats.vdd_skips++;
+		return 0;
+	}
+	acpuclk_stats.vdd_writes++;
+
 	dprintk("Switching VDD from %u mV -> %d mV\n",
 	       current_vdd, vdd);
 
@@ -579,9 +620,12 @@ int acpuclk_set_rate(int cpu, unsigned long rate, enum setrate_reason reason)
 	struct clkctl_acpu_speed *cur_s, *tgt_s, *strt_s;
 	int res, rc = 0;
 	unsigned int plls_enabled = 0, pll;
+	ktime_t start = ktime_set(0, 0);
 
-	if (reason == SETRATE_CPUFREQ)
+	if (reason == SETRATE_CPUFREQ) {
 		mutex_lock(&drv_state.lock);
+		start = ktime_get();
+	}
 
 	strt_s = cur_s = drv_state.current_speed;
 
@@ -649,12 +693,14 @@ int acpuclk_set_rate(int cpu, unsigned long rate, enum setrate_reason reason)
 
 	while (cur_s != tgt_s) {
 		/*
-		 * Always jump to target freq if within 256mhz, regulardless of
-		 * PLL. If differnece is greater, use the predefinied
-		 * steppings in the table.
+		 * Always jump to target freq if within max_speed_delta_khz,
+		 * regardless of PLL, or if it runs off the same PLL, since
+		 * only the divider changes then. Otherwise use the
+		 * predefined steppings in the table.
 		 */
 		int d = abs((int)(cur_s->a11clk_khz - tgt_s->a11clk_khz));
-		if (d > drv_state.max_speed_delta_khz) {
+		if (d > drv_state.max_speed_delta_khz
+		    && cur_s->pll != tgt_s->pll) {
 
 			if (tgt_s->a11clk_khz > cur_s->a11clk_khz) {
 				/* Step up: jump to target PLL as early as
@@ -702,6 +748,8 @@ int acpuclk_set_rate(int cpu, unsigned long rate, enum setrate_reason reason)
 
 		acpuclk_set_div(cur_s);
 		drv_state.current_speed = cur_s;
+		if (reason == SETRATE_CPUFREQ)
+			acpuclk_stats.steps++;
 		/* Re-adjust lpj for the new clock speed. */
 		loops_per_jiffy = cur_s->lpj;
 		udelay(drv_state.acpu_switch_time_us);
@@ -747,8 +795,19 @@ int acpuclk_set_rate(int cpu, unsigned long rate, enum setrate_reason reason)
 
 	dprintk("ACPU speed change complete\n");
 out:
-	if (reason == SETRATE_CPUFREQ)
+	if (reason == SETRATE_CPUFREQ) {
+		if (!rc && strt_s != drv_state.current_speed) {
+			unsigned int us = ktime_to_us(ktime_sub(ktime_get(),
+								start));
+
+			acpuclk_stats.switches++;
+			acpuclk_stats.total_us += us;
+			acpuclk_stats.last_us = us;
+			if (us > acpuclk_stats.max_us)
+				acpuclk_stats.max_us = us;
+		}
 		mutex_unlock(&drv_state.lock);
+	}
 	return rc;
 }
 
@@ -1058,3 +1117,70 @@ void __init msm_acpu_clock_init(struct msm_acpu_clock_platform_data *clkdata)
 	cpufreq_frequency_table_get_attr(freq_table, smp_processor_id());
 #endif
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int acpuclk_stats_show(struct seq_file *m, void *unused)
+{
+	struct acpuclk_stats st;
+	u64 avg_us = 0;
+
+	mutex_lock(&drv_state.lock);
+	st = acpuclk_stats;
+	mutex_unlock(&drv_state.lock);
+
+	if (st.switches) {
+		avg_us = st.total_us;
+		do_div(avg_us, st.switches);
+	}
+
+	seq_printf(m, "switches:     %u\n", st.switches);
+	seq_printf(m, "steps:        %u\n", st.steps);
+	seq_printf(m, "avg_us:       %llu\n", avg_us);
+	seq_printf(m, "max_us:       %u\n", st.max_us);
+	seq_printf(m, "last_us:      %u\n", st.last_us);
+	seq_printf(m, "vdd_writes:   %u\n", st.vdd_writes);
+	seq_printf(m, "vdd_skips:    %u\n", st.vdd_skips);
+	seq_printf(m, "pll_requests: %u\n", st.pll_requests);
+	seq_printf(m, "pll_skips:    %u\n", st.pll_skips);
+	return 0;
+}
+
+static int acpuclk_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, acpuclk_stats_show, NULL);
+}
+
+static ssize_t acpuclk_stats_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	mutex_lock(&drv_state.lock);
+	memset(&acpuclk_stats, 0, sizeof(acpuclk_stats));
+	mutex_unlock(&drv_state.lock);
+	return count;
+}
+
+static const struct file_operations acpuclk_stats_fops = {
+	.open		= acpuclk_stats_open,
+	.read		= seq_read,
+	.write		= acpuclk_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init acpuclk_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("acpuclock", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("stats", S_IRUGO | S_IWUSR, dir, NULL,
+				 &acpuclk_stats_fops)) {
+		debugfs_remove_recursive(dir);
+		return -ENOMEM;
+	}
+	return 0;
+}
+late_initcall(acpuclk_debugfs_init);
+#endif
@@ -1047,16 +1047,8 @@ static uint32_t lcdc_gpio_table[] = {
 
 static void config_lcdc_gpio_table(uint32_t *table, int len, unsigned enable)
 {
-	int n, rc;
-	for (n = 0; n < len; n++) {
-		rc = gpio_tlmm_config(table[n],
-			enable ? GPIO_ENABLE : GPIO_DISABLE);
-		if (rc) {
-			printk(KERN_ERR "%s: gpio_tlmm_config(%#x)=%d\n",
-				__func__, table[n], rc);
-			break;
-		}
-	}
+	gpio_tlmm_config_table(table, len,
+			       enable ? GPIO_ENABLE : GPIO_DISABLE);
 }
 
 
@@ -1855,15 +1847,7 @@ static uint32_t camera_on_gpio_table[] = {
 
 static void config_gpio_table(uint32_t *table, int len)
 {
-	int n, rc;
-	for (n = 0; n < len; n++) {
-		rc = gpio_tlmm_config(table[n], GPIO_ENABLE);
-		if (rc) {
-			printk(KERN_ERR "%s: gpio_tlmm_config(%#x)=%d\n",
-				__func__, table[n], rc);
-			break;
-		}
-	}
+	gpio_tlmm_config_table(table, len, GPIO_ENABLE);
 }
 
 static struct vreg *vreg_gp2;
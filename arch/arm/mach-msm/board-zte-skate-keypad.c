@@ -80,8 +80,9 @@ static struct gpio_event_matrix_info skate_keypad_matrix_info = {
 	.ninputs	= ARRAY_SIZE(keypad_col_gpios),
 	.settle_time.tv.nsec = 0,
 	.poll_time.tv.nsec = 20 * NSEC_PER_MSEC,
+	.held_poll_time.tv.nsec = 100 * NSEC_PER_MSEC,
 #if 1
-	.flags		= GPIOKPF_LEVEL_TRIGGERED_IRQ | GPIOKPF_DRIVE_INACTIVE | GPIOKPF_PRINT_UNMAPPED_KEYS
+	.flags		= GPIOKPF_LEVEL_TRIGGERED_IRQ | GPIOKPF_DRIVE_INACTIVE | GPIOKPF_HELD_KEY_IRQ | GPIOKPF_PRINT_UNMAPPED_KEYS
 #else
 	.flags		= GPIOKPF_LEVEL_TRIGGERED_IRQ | GPIOKPF_DRIVE_INACTIVE | GPIOKPF_ACTIVE_HIGH | GPIOKPF_PRINT_UNMAPPED_KEYS /*| GPIOKPF_PRINT_MAPPED_KEYS*/
 #endif
@@ -162,6 +162,46 @@ static const struct file_operations list_rates_fops = {
 	.release	= seq_release,
 };
 
+static int clock_debug_off_delay_set(void *data, u64 val)
+{
+	struct clk *clock = data;
+
+	return clock->ops->set_off_delay(clock->id, val);
+}
+
+static int clock_debug_off_delay_get(void *data, u64 *val)
+{
+	struct clk *clock = data;
+
+	*val = clock->ops->get_off_delay(clock->id);
+
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(clock_off_delay_fops, clock_debug_off_delay_get,
+			clock_debug_off_delay_set, "%llu\n");
+
+static int stats_show(struct seq_file *m, void *unused)
+{
+	struct clk *clock = m->private;
+
+	clock->ops->print_stats(clock->id, m);
+
+	return 0;
+}
+
+static int stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stats_show, inode->i_private);
+}
+
+static const struct file_operations stats_fops = {
+	.open		= stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 int __init clock_debug_add(struct clk *clock)
 {
 	char temp[50], *ptr;
@@ -200,6 +240,16 @@ int __init clock_debug_add(struct clk *clock)
 				S_IRUGO, clk_dir, clock, &list_rates_fops))
 			goto error;
 
+	if (clock->ops->print_stats)
+		if (!debugfs_create_file("stats",
+				S_IRUGO, clk_dir, clock, &stats_fops))
+			goto error;
+
+	if (clock->ops->set_off_delay && clock->ops->get_off_delay)
+		if (!debugfs_create_file("off_delay_ms", S_IRUGO | S_IWUSR,
+				clk_dir, clock, &clock_off_delay_fops))
+			goto error;
+
 	return 0;
 error:
 	debugfs_remove_recursive(clk_dir);
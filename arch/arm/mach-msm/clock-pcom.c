@@ -17,6 +17,11 @@
 #include <linux/ctype.h>
 #include <linux/stddef.h>
 #include <linux/spinlock.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
+#include <linux/suspend.h>
+#include <linux/workqueue.h>
 
 #include <mach/clk.h>
 
@@ -29,21 +34,92 @@ static DEFINE_SPINLOCK(clock_map_lock);	//LHX_PM_20110503_01 add code to record
 struct clk_pcom {
 	unsigned count;
 	bool always_on;
+	/*
+	 * Milliseconds between the last disable and the remote disable, an
+	 * enable in between cancels it. 0 disables right away.
+	 */
+	unsigned off_delay;
+	bool pending_off;
+	unsigned long off_at;
+	/* Statistics for debugfs */
+	unsigned enable_calls;
+	unsigned disable_calls;
+	unsigned avoided;
+	ktime_t on_since;
+	u64 on_time;
 };
 
+#define PC_CLK_LAZY { .off_delay = CONFIG_MSM_PCOM_CLK_OFF_DELAY }
+
 static struct clk_pcom pcom_clocks[P_NR_CLKS] = {
 	[P_EBI1_CLK] = { .always_on = true },
 	[P_PBUS_CLK] = { .always_on = true },
+	[P_SDC1_CLK ... P_SDC4_P_CLK] = PC_CLK_LAZY,
+	[P_GRP_3D_CLK] = PC_CLK_LAZY,
+	[P_GRP_3D_P_CLK] = PC_CLK_LAZY,
+	[P_IMEM_CLK] = PC_CLK_LAZY,
+	[P_GRP_2D_CLK] = PC_CLK_LAZY,
+	[P_GRP_2D_P_CLK] = PC_CLK_LAZY,
 };
 
 static DEFINE_SPINLOCK(pc_clk_lock);
 
+/* Disable right away while the system suspends */
+static bool pc_clk_suspending;
+
+static void pc_clk_off_func(struct work_struct *work);
+static DECLARE_DELAYED_WORK(pc_clk_off_work, pc_clk_off_func);
+
 /*
  * glue for the proc_comm interface
  */
+static void pc_clk_off_locked(struct clk_pcom *clk, unsigned id)
+{
+	unsigned id_record = id;	//LHX_PM_20110503_01 add code to record which CLK is on after 6150
+
+	clk->pending_off = false;
+	msm_proc_comm(PCOM_CLKCTL_RPC_DISABLE, &id, NULL);
+	clk->disable_calls++;
+	clk->on_time += ktime_to_ns(ktime_sub(ktime_get(), clk->on_since));
+
+	spin_lock(&clock_map_lock);	//LHX_PM_20110503_01 add code to record which CLK is on after 6150
+	clock_map_enabled[BIT_WORD(id_record)] &= ~BIT_MASK(id_record);
+	spin_unlock(&clock_map_lock);
+}
+
+/*
+ * Turn off the clocks whose delay ran out. With different delays the
+ * work runs for the first one scheduled, so a shorter delay may be
+ * served late by up to the difference.
+ */
+static void pc_clk_off_func(struct work_struct *work)
+{
+	unsigned long flags;
+	unsigned long next = 0;
+	bool more = false;
+	unsigned id;
+
+	spin_lock_irqsave(&pc_clk_lock, flags);
+	for (id = 0; id < P_NR_CLKS; id++) {
+		struct clk_pcom *clk = &pcom_clocks[id];
+
+		if (!clk->pending_off)
+			continue;
+		if (time_after_eq(jiffies, clk->off_at))
+			pc_clk_off_locked(clk, id);
+		else if (!more || time_before(clk->off_at, next)) {
+			next = clk->off_at;
+			more = true;
+		}
+	}
+	if (more)
+		schedule_delayed_work(&pc_clk_off_work, next - jiffies);
+	spin_unlock_irqrestore(&pc_clk_lock, flags);
+}
+
 int pc_clk_enable(unsigned id)
 {
-	int rc;
+	int rc = 0;
 	unsigned long flags;
 	struct clk_pcom *clk = &pcom_clocks[id];
 	unsigned id_record;	//LHX_PM_20110503_01 add code to record which CLK is on after 6150
@@ -52,7 +128,11 @@ int pc_clk_enable(unsigned id)
 		return 0;
 
 	spin_lock_irqsave(&pc_clk_lock, flags);
-	if (clk->count == 0) {
+	if (clk->count == 0 && clk->pending_off) {
+		/* Still on, just forget about turning it off */
+		clk->pending_off = false;
+		clk->avoided++;
+	} else if (clk->count == 0) {
 		rc = msm_proc_comm(PCOM_CLKCTL_RPC_ENABLE, &id, NULL);
 		if (rc < 0)
 			goto unlock;
@@ -62,6 +142,8 @@ int pc_clk_enable(unsigned id)
 		} else
 			{
 				rc = 0;
+				clk->enable_calls++;
+				clk->on_since = ktime_get();
 				spin_lock(&clock_map_lock);
 				clock_map_enabled[BIT_WORD(id_record)] |= BIT_MASK(id_record);	//LHX_PM_20110503_01 add code to record which CLK is on after 6150
 				spin_unlock(&clock_map_lock);
@@ -77,8 +159,6 @@ void pc_clk_disable(unsigned id)
 {
 	unsigned long flags;
 	struct clk_pcom *clk = &pcom_clocks[id];
-	unsigned id_record;	//LHX_PM_20110503_01 add code to record which CLK is on after 6150
-	id_record = id;
 
 	if (clk->always_on)
 		return;
@@ -87,13 +167,16 @@ void pc_clk_disable(unsigned id)
 	if (WARN_ON(clk->count == 0))
 		goto out;
 	clk->count--;
-	if (clk->count == 0)
-		{
-			msm_proc_comm(PCOM_CLKCTL_RPC_DISABLE, &id, NULL);
-			spin_lock(&clock_map_lock);	//LHX_PM_20110503_01 add code to record which CLK is on after 6150
-			clock_map_enabled[BIT_WORD(id_record)] &= ~BIT_MASK(id_record);
-			spin_unlock(&clock_map_lock);
-		}
+	if (clk->count == 0) {
+		if (clk->off_delay && !pc_clk_suspending) {
+			clk->pending_off = true;
+			clk->off_at = jiffies + msecs_to_jiffies(clk->off_delay);
+			if (!delayed_work_pending(&pc_clk_off_work))
+				schedule_delayed_work(&pc_clk_off_work,
+					msecs_to_jiffies(clk->off_delay));
+		} else
+			pc_clk_off_locked(clk, id);
+	}
 out:
 	spin_unlock_irqrestore(&pc_clk_lock, flags);
 }
@@ -115,11 +198,86 @@ void pc_clk_auto_off(unsigned id)
 	struct clk_pcom *clk = &pcom_clocks[id];
 
 	spin_lock_irqsave(&pc_clk_lock, flags);
-	if (clk->count == 0)
+	if (clk->pending_off)
+		pc_clk_off_locked(clk, id);
+	else if (clk->count == 0)
 		msm_proc_comm(PCOM_CLKCTL_RPC_DISABLE, &id, NULL);
 	spin_unlock_irqrestore(&pc_clk_lock, flags);
 }
 
+/*
+ * Clocks disabled from here on go off right away, and the ones waiting
+ * are turned off now, so none of them keeps TCXO on through suspend.
+ */
+static int pc_clk_pm_notify(struct notifier_block *nb,
+			    unsigned long event, void *unused)
+{
+	unsigned long flags;
+	unsigned id;
+
+	switch (event) {
+	case PM_SUSPEND_PREPARE:
+		spin_lock_irqsave(&pc_clk_lock, flags);
+		pc_clk_suspending = true;
+		for (id = 0; id < P_NR_CLKS; id++)
+			if (pcom_clocks[id].pending_off)
+				pc_clk_off_locked(&pcom_clocks[id], id);
+		spin_unlock_irqrestore(&pc_clk_lock, flags);
+		break;
+	case PM_POST_SUSPEND:
+		spin_lock_irqsave(&pc_clk_lock, flags);
+		pc_clk_suspending = false;
+		spin_unlock_irqrestore(&pc_clk_lock, flags);
+		break;
+	}
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block pc_clk_pm_nb = {
+	.notifier_call = pc_clk_pm_notify,
+};
+
+static int __init pc_clk_pm_init(void)
+{
+	return register_pm_notifier(&pc_clk_pm_nb);
+}
+late_initcall(pc_clk_pm_init);
+
+static void pc_clk_print_stats(unsigned id, struct seq_file *m)
+{
+	struct clk_pcom *clk = &pcom_clocks[id];
+	struct clk_pcom snap;
+	unsigned long flags;
+	u64 on_time;
+
+	spin_lock_irqsave(&pc_clk_lock, flags);
+	snap = *clk;
+	on_time = clk->on_time;
+	if (clk->count || clk->pending_off)
+		on_time += ktime_to_ns(ktime_sub(ktime_get(), clk->on_since));
+	spin_unlock_irqrestore(&pc_clk_lock, flags);
+	do_div(on_time, NSEC_PER_MSEC);
+
+	seq_printf(m, "count: %u%s\n", snap.count,
+		   snap.always_on ? " (always on)" : "");
+	seq_printf(m, "enable_calls: %u\n", snap.enable_calls);
+	seq_printf(m, "disable_calls: %u\n", snap.disable_calls);
+	seq_printf(m, "avoided: %u\n", snap.avoided);
+	seq_printf(m, "pending_off: %d\n", snap.pending_off);
+	seq_printf(m, "enabled_ms: %llu\n", on_time);
+}
+
+static int pc_clk_set_off_delay(unsigned id, unsigned ms)
+{
+	pcom_clocks[id].off_delay = ms;
+	return 0;
+}
+
+static unsigned pc_clk_get_off_delay(unsigned id)
+{
+	return pcom_clocks[id].off_delay;
+}
+
 int pc_clk_reset(unsigned id, enum clk_reset_action action)
 {
 	int rc;
@@ -210,6 +368,9 @@ struct clk_ops clk_ops_remote = {
 	.get_rate = pc_clk_get_rate,
 	.is_enabled = pc_clk_is_enabled,
 	.round_rate = pc_clk_round_rate,
+	.print_stats = pc_clk_print_stats,
+	.set_off_delay = pc_clk_set_off_delay,
+	.get_off_delay = pc_clk_get_off_delay,
 };
 
 int pc_clk_set_rate2(unsigned id, unsigned rate)
@@ -238,4 +399,7 @@ struct clk_ops clk_ops_pcom_div2 = {
 	.get_rate = pc_clk_get_rate2,
 	.is_enabled = pc_clk_is_enabled,
 	.round_rate = pc_clk_round_rate,
+	.print_stats = pc_clk_print_stats,
+	.set_off_delay = pc_clk_set_off_delay,
+	.get_off_delay = pc_clk_get_off_delay,
 };
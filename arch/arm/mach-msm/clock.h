@@ -33,6 +33,8 @@
 #define CLKFLAG_MIN			0x00000400
 #define CLKFLAG_MAX			0x00000800
 
+struct seq_file;
+
 struct clk_ops {
 	int (*enable)(unsigned id);
 	void (*disable)(unsigned id);
@@ -48,6 +50,10 @@ struct clk_ops {
 	unsigned (*is_enabled)(unsigned id);
 	long (*round_rate)(unsigned id, unsigned rate);
 	int (*set_parent)(unsigned id, struct clk *parent);
+	/* Optional, debugfs statistics and delayed disable */
+	void (*print_stats)(unsigned id, struct seq_file *m);
+	int (*set_off_delay)(unsigned id, unsigned ms);
+	unsigned (*get_off_delay)(unsigned id);
 };
 
 struct clk {
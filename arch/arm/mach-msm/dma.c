@@ -15,13 +15,16 @@
  */
 
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/err.h>
 #include <linux/io.h>
 #include <linux/interrupt.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/spinlock.h>
 #include <linux/pm_runtime.h>
+#include <linux/seq_file.h>
 #include <mach/dma.h>
 
 #define MODULE_NAME "msm_dmov"
@@ -177,6 +180,31 @@ static struct msm_dmov_conf dmov_conf[] = {
 #define DMOV_ID_TO_CHAN(id)   ((id) % MSM_DMOV_CHANNEL_COUNT)
 #define DMOV_CHAN_ADM_TO_ID(ch, adm) ((ch) + (adm) * MSM_DMOV_CHANNEL_COUNT)
 
+/* Per channel, updated under the ADM lock when a command completes */
+struct msm_dmov_stats {
+	unsigned int cmds;
+	unsigned int errors;
+	u64 total_us;
+	unsigned int max_us;
+};
+
+static struct msm_dmov_stats dmov_stats[MSM_DMOV_ID_COUNT];
+
+static void dmov_account(unsigned int id, struct msm_dmov_cmd *cmd,
+			 unsigned int result)
+{
+	struct msm_dmov_stats *stats = &dmov_stats[id];
+	unsigned int us;
+
+	us = ktime_to_us(ktime_sub(ktime_get(), cmd->enqueue_time));
+	stats->cmds++;
+	if (result & (DMOV_RSLT_ERROR | DMOV_RSLT_FLUSH))
+		stats->errors++;
+	stats->total_us += us;
+	if (us > stats->max_us)
+		stats->max_us = us;
+}
+
 #ifdef CONFIG_MSM_ADM3
 #define DMOV_IRQ_TO_ADM(irq)   \
 ({ \
@@ -392,6 +420,8 @@ void msm_dmov_enqueue_cmd_ext(unsigned id, struct msm_dmov_cmd *cmd)
 	int adm = DMOV_ID_TO_ADM(id);
 	int ch = DMOV_ID_TO_CHAN(id);
 
+	cmd->enqueue_time = ktime_get();
+
 	spin_lock_irqsave(&dmov_conf[adm].lock, irq_flags);
 #ifndef CONFIG_MSM_ADM3
 	if (clk_ctl == CLK_DIS)
@@ -563,6 +593,7 @@ static irqreturn_t msm_datamover_irq_handler(int irq, void *dev_id)
 				PRINT_IO("msm_datamover_irq_handler id %d, got result "
 					"for %p, result %x\n", id, cmd, ch_result);
 				if (cmd) {
+					dmov_account(id, cmd, ch_result);
 					list_del(&cmd->list);
 					cmd->complete_func(cmd, ch_result, NULL);
 				}
@@ -574,6 +605,7 @@ static irqreturn_t msm_datamover_irq_handler(int irq, void *dev_id)
 				PRINT_FLOW("msm_datamover_irq_handler id %d, status %x\n", id, ch_status);
 				PRINT_FLOW("msm_datamover_irq_handler id %d, flush, result %x, flush0 %x\n", id, ch_result, errdata.flush[0]);
 				if (cmd) {
+					dmov_account(id, cmd, ch_result);
 					list_del(&cmd->list);
 					cmd->complete_func(cmd, ch_result, &errdata);
 				}
@@ -586,6 +618,7 @@ static irqreturn_t msm_datamover_irq_handler(int irq, void *dev_id)
 				PRINT_ERROR("msm_datamover_irq_handler id %d, status %x\n", id, ch_status);
 				PRINT_ERROR("msm_datamover_irq_handler id %d, error, result %x, flush0 %x\n", id, ch_result, errdata.flush[0]);
 				if (cmd) {
+					dmov_account(id, cmd, ch_result);
 					list_del(&cmd->list);
 					cmd->complete_func(cmd, ch_result, &errdata);
 				}
@@ -702,6 +735,43 @@ static int __init msm_dmov_init_clocks(void)
 }
 #endif
 
+#ifdef CONFIG_DEBUG_FS
+static int dmov_stats_show(struct seq_file *m, void *unused)
+{
+	struct msm_dmov_stats stats;
+	unsigned long irq_flags;
+	int id, adm;
+
+	seq_printf(m, "%4s %10s %8s %10s %10s\n", "chan", "commands",
+		   "errors", "avg_us", "max_us");
+	for (id = 0; id < MSM_DMOV_ID_COUNT; id++) {
+		adm = DMOV_ID_TO_ADM(id);
+		spin_lock_irqsave(&dmov_conf[adm].lock, irq_flags);
+		stats = dmov_stats[id];
+		spin_unlock_irqrestore(&dmov_conf[adm].lock, irq_flags);
+		if (!stats.cmds)
+			continue;
+		seq_printf(m, "%4d %10u %8u %10u %10u\n", id, stats.cmds,
+			   stats.errors,
+			   (unsigned int)div_u64(stats.total_us, stats.cmds),
+			   stats.max_us);
+	}
+	return 0;
+}
+
+static int dmov_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dmov_stats_show, NULL);
+}
+
+static const struct file_operations dmov_stats_fops = {
+	.open = dmov_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 static void config_datamover(int adm)
 {
 #ifdef CONFIG_MSM_ADM3
@@ -748,6 +818,10 @@ static int __init msm_init_datamover(void)
 		}
 		disable_irq(dmov_conf[j].irq);
 	}
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("msm_dmov_stats", S_IRUGO, NULL, NULL,
+			    &dmov_stats_fops);
+#endif
 #ifndef CONFIG_MSM_ADM3
 	msm_dmov_init_clocks();
 	ret = platform_driver_register(&msm_dmov_driver);
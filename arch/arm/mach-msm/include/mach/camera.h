@@ -38,6 +38,7 @@
 #include <linux/cdev.h>
 #include <linux/platform_device.h>
 #include <linux/wakelock.h>
+#include <linux/workqueue.h>
 #include "linux/types.h"
 
 #include <mach/board.h>
@@ -258,6 +259,9 @@ struct msm_sync {
 	*/
 	struct hlist_head pmem_frames;
 	struct hlist_head pmem_stats;
+	/* The same regions hashed by the address the VFE reports back */
+	struct hlist_head pmem_frame_hash[1 << MSM_PMEM_HASH_BITS];
+	struct hlist_head pmem_stats_hash[1 << MSM_PMEM_HASH_BITS];
 
 	/* The message queue is used by the control thread to send commands
 	 * to the config thread, and also by the DSP to send messages to the
@@ -279,6 +283,12 @@ struct msm_sync {
 	int get_pic_abort;
 	struct msm_device_queue vpe_q;
 
+	/* Stale stats dropped from event_q, their buffers are handed back
+	 * to the VFE by stats_drop_work.
+	 */
+	struct msm_device_queue stats_drop_q;
+	struct work_struct stats_drop_work;
+
 	struct msm_camera_sensor_info *sdata;
 	struct msm_camvfe_fn vfefn;
 	struct msm_camvpe_fn vpefn;
@@ -351,8 +361,12 @@ struct register_address_value_pair {
 	uint16_t register_value;
 };
 
+/* Buckets of the physical address hashes of the pmem regions */
+#define MSM_PMEM_HASH_BITS 4
+
 struct msm_pmem_region {
 	struct hlist_node list;
+	struct hlist_node hash;
 	unsigned long paddr;
 	unsigned long len;
 	struct file *file;
@@ -17,6 +17,7 @@
 #ifndef __ASM_ARCH_MSM_DMA_H
 
 #include <linux/list.h>
+#include <linux/ktime.h>
 #include <mach/msm_iomap.h>
 
 struct msm_dmov_errdata {
@@ -32,6 +33,7 @@ struct msm_dmov_cmd {
 			      struct msm_dmov_errdata *err);
 	void (*exec_func)(struct msm_dmov_cmd *cmd);
 	void *user;	/* Pointer for caller's reference */
+	ktime_t enqueue_time;	/* For the per-channel latency stats */
 };
 
 void msm_dmov_enqueue_cmd(unsigned id, struct msm_dmov_cmd *cmd);
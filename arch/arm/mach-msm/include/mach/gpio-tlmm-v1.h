@@ -69,4 +69,18 @@ enum {
 
 int gpio_tlmm_config(unsigned config, unsigned disable);
 
+/**
+ * gpio_tlmm_config_table() - gpio_tlmm_config() a table of pins
+ * @config: array of GPIO_CFG() values
+ * @size: number of entries in @config
+ * @disable: GPIO_ENABLE or GPIO_DISABLE, applied to every entry
+ *
+ * The pins are configured in order, several per proc_comm lock hold
+ * rather than one modem round trip each. Stops at the first failure.
+ *
+ * Returns 0 on success, -EIO if a configuration was refused.
+ */
+int gpio_tlmm_config_table(const unsigned *config, int size,
+			   unsigned disable);
+
 #endif
@@ -0,0 +1,64 @@
+/* arch/arm/mach-msm/include/mach/msm_latency.h
+ *
+ * Request latency tracepoints for MSM drivers
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __ASM_ARCH_MSM_LATENCY_H
+#define __ASM_ARCH_MSM_LATENCY_H
+
+#include <linux/types.h>
+
+/* Keep in step with show_msm_latency_subsys() */
+enum msm_latency_subsys {
+	MSM_LATENCY_SMD,	/* one pass of the SMD interrupt handler */
+	MSM_LATENCY_RPC,	/* msm_rpc_call_reply() round trip */
+	MSM_LATENCY_SDCC,	/* mmc_request in the controller */
+	MSM_LATENCY_NAND,	/* page read or write operation */
+	MSM_LATENCY_FB,		/* pan display, DMA to the panel included */
+	MSM_LATENCY_KGSL,	/* wait for a GPU timestamp */
+	MSM_LATENCY_NR
+};
+
+#ifdef CONFIG_MSM_LATENCY_TRACE
+#include <linux/sched.h>
+#include <trace/events/msm_latency.h>
+
+/*
+ * The driver keeps what msm_latency_start() returns with the request and
+ * hands it back to msm_latency_done(). msm_req_done carries the latency,
+ * which is what the debugfs msm_latency report is built from.
+ */
+static inline u64 msm_latency_start(int subsys, unsigned long id)
+{
+	trace_msm_req_start(subsys, id);
+	return sched_clock();
+}
+
+static inline void msm_latency_done(int subsys, unsigned long id, u64 start,
+				    int result)
+{
+	trace_msm_req_done(subsys, id, sched_clock() - start, result);
+}
+#else
+static inline u64 msm_latency_start(int subsys, unsigned long id)
+{
+	return 0;
+}
+
+static inline void msm_latency_done(int subsys, unsigned long id, u64 start,
+				    int result)
+{
+}
+#endif
+
+#endif
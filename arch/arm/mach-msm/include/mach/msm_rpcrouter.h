@@ -21,6 +21,8 @@
 #include <linux/types.h>
 #include <linux/list.h>
 #include <linux/platform_device.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
 
 /* RPC API version structure
  * Version bit 31 : 1->hashkey versioning,
@@ -163,6 +165,45 @@ int msm_rpc_call(struct msm_rpc_endpoint *ept, uint32_t proc,
 		 void *request, int request_size,
 		 long timeout);
 
+/* asynchronous rpc call
+ *
+ * msm_rpc_call_async() sends the request and returns at once; any
+ * number of calls may be outstanding on one endpoint. When the reply
+ * arrives (or the call fails) func is run from the router's async
+ * workqueue with the reply and its length, or a negative error. func
+ * may issue further async calls but must not wait for a reply on the
+ * same endpoint.
+ *
+ * Without func the reply is copied to reply/reply_size, as with
+ * msm_rpc_call_reply(), and msm_rpc_call_wait() collects the result.
+ *
+ * The caller owns the msm_rpc_async_call and must keep it around until
+ * func has run, msm_rpc_call_wait() has returned or msm_rpc_call_cancel()
+ * has succeeded.
+ */
+struct msm_rpc_async_call {
+	void (*func)(struct msm_rpc_async_call *call, void *reply, int len);
+	void *reply;
+	int reply_size;
+	void *data;
+
+	/* private to the router */
+	struct list_head list;
+	struct work_struct work;
+	struct completion done;
+	uint32_t xid; /* be32 */
+	struct rr_fragment *frag;
+	int status;
+};
+
+int msm_rpc_call_async(struct msm_rpc_endpoint *ept, uint32_t proc,
+		       void *request, int request_size,
+		       struct msm_rpc_async_call *call);
+int msm_rpc_call_wait(struct msm_rpc_endpoint *ept,
+		      struct msm_rpc_async_call *call, long timeout);
+int msm_rpc_call_cancel(struct msm_rpc_endpoint *ept,
+			struct msm_rpc_async_call *call);
+
 struct msm_rpc_xdr {
 	void *in_buf;
 	uint32_t in_size;
@@ -193,6 +234,40 @@ int xdr_recv_int32(struct msm_rpc_xdr *xdr, int32_t *value);
 int xdr_recv_uint32(struct msm_rpc_xdr *xdr, uint32_t *value);
 int xdr_recv_bytes(struct msm_rpc_xdr *xdr, void **data, uint32_t *size);
 
+/* fixed layout structures of 8, 16 and 32 bit members:
+ *
+ *	static const struct xdr_field foo_fields[] = {
+ *		XDR_FIELD(struct foo, a),
+ *		XDR_FIELD(struct foo, b),
+ *	};
+ *	static const struct xdr_desc foo_desc = XDR_DESC(foo_fields);
+ *
+ *	xdr_send_struct(xdr, &foo_desc, &foo);
+ */
+struct xdr_field {
+	uint16_t offset;
+	uint8_t size;
+	uint8_t is_signed;
+};
+
+struct xdr_desc {
+	const struct xdr_field *fields;
+	uint32_t nfields;
+};
+
+#define XDR_FIELD(type, member) {					\
+	.offset = offsetof(type, member),				\
+	.size = sizeof(((type *)0)->member),				\
+	.is_signed = (typeof(((type *)0)->member))-1 < 0,		\
+}
+
+#define XDR_DESC(f) { .fields = (f), .nfields = ARRAY_SIZE(f) }
+
+int xdr_send_struct(struct msm_rpc_xdr *xdr, const struct xdr_desc *desc,
+		    const void *data);
+int xdr_recv_struct(struct msm_rpc_xdr *xdr, const struct xdr_desc *desc,
+		    void *data);
+
 struct msm_rpc_server
 {
 	struct list_head list;
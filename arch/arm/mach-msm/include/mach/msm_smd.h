@@ -52,6 +52,22 @@ int smd_write_user_buffer(smd_channel_t *ch, const void *data, int len);
 int smd_write_avail(smd_channel_t *ch);
 int smd_read_avail(smd_channel_t *ch);
 
+/* Zero-copy access to the fifo.
+** smd_read_buffer() returns the number of contiguous bytes readable
+** at *ptr (bounded by the current packet on packet channels), which
+** are released with smd_read_done().
+** smd_write_start() reserves len bytes (-ENOMEM if they don't fit);
+** they are then filled in place with smd_write_buffer(), which returns
+** the contiguous space at *ptr, and smd_write_commit(), which returns
+** the bytes still to be committed. The other side is signalled after
+** the last commit.
+*/
+int smd_read_buffer(smd_channel_t *ch, void **ptr);
+void smd_read_done(smd_channel_t *ch, int len);
+int smd_write_start(smd_channel_t *ch, int len);
+int smd_write_buffer(smd_channel_t *ch, void **ptr);
+int smd_write_commit(smd_channel_t *ch, int len);
+
 /* Returns the total size of the current packet being read.
 ** Returns 0 if no packets available or a stream channel.
 */
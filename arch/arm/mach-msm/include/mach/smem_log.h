@@ -34,6 +34,9 @@
 
 #define SMIOC_SETMODE _IOW(SMEM_LOG_BASE, 1, int)
 #define SMIOC_SETLOG _IOW(SMEM_LOG_BASE, 2, int)
+/* Merge staged apps events into the shared log, e.g. before reading it
+ * through mmap() */
+#define SMIOC_FLUSH _IO(SMEM_LOG_BASE, 3)
 
 #define SMIOC_TEXT 0x00000001
 #define SMIOC_BINARY 0x00000002
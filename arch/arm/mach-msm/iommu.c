@@ -27,6 +27,11 @@
 #include <linux/slab.h>
 #include <linux/iommu.h>
 #include <linux/clk.h>
+#include <linux/scatterlist.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #include <asm/cacheflush.h>
 #include <asm/sizes.h>
@@ -51,6 +56,22 @@ struct msm_priv {
 	struct list_head list_attached;
 };
 
+/* Under msm_iommu_lock */
+static struct msm_iommu_stats {
+	unsigned long maps;
+	unsigned long unmaps;
+	unsigned long map_ranges;
+	unsigned long unmap_ranges;
+	unsigned long sections;
+	unsigned long large_pages;
+	unsigned long small_pages;
+	unsigned long tlb_flushes;
+	u64 map_ns;
+	u64 unmap_ns;
+	u64 map_range_ns;
+	u64 unmap_range_ns;
+} msm_iommu_stats;
+
 static int __enable_clocks(struct msm_iommu_drvdata *drvdata)
 {
 	int ret;
@@ -75,28 +96,22 @@ static void __disable_clocks(struct msm_iommu_drvdata *drvdata)
 	clk_disable(drvdata->pclk);
 }
 
-static int __flush_iotlb(struct iommu_domain *domain)
+/* Write the page table entries in [start, end) out to memory */
+static inline void __clean_pte(unsigned long *start, unsigned long *end)
+{
+#ifndef CONFIG_IOMMU_PGTABLES_L2
+	dmac_flush_range(start, end);
+#endif
+}
+
+static int __invalidate_tlb(struct iommu_domain *domain)
 {
 	struct msm_priv *priv = domain->priv;
 	struct msm_iommu_drvdata *iommu_drvdata;
 	struct msm_iommu_ctx_drvdata *ctx_drvdata;
 	int ret = 0;
-#ifndef CONFIG_IOMMU_PGTABLES_L2
-	unsigned long *fl_table = priv->pgtable;
-	int i;
-
-	if (!list_empty(&priv->list_attached)) {
-		dmac_flush_range(fl_table, fl_table + SZ_16K);
-
-		for (i = 0; i < NUM_FL_PTE; i++)
-			if ((fl_table[i] & 0x03) == FL_TYPE_TABLE) {
-				void *sl_table = __va(fl_table[i] &
-								FL_BASE_MASK);
-				dmac_flush_range(sl_table, sl_table + SZ_4K);
-			}
-	}
-#endif
 
+	msm_iommu_stats.tlb_flushes++;
 	list_for_each_entry(ctx_drvdata, &priv->list_attached, attached_elm) {
 		if (!ctx_drvdata->pdev || !ctx_drvdata->pdev->dev.parent)
 			BUG();
@@ -116,6 +131,28 @@ fail:
 	return ret;
 }
 
+static int __flush_iotlb(struct iommu_domain *domain)
+{
+#ifndef CONFIG_IOMMU_PGTABLES_L2
+	struct msm_priv *priv = domain->priv;
+	unsigned long *fl_table = priv->pgtable;
+	int i;
+
+	if (!list_empty(&priv->list_attached)) {
+		dmac_flush_range(fl_table, fl_table + SZ_16K);
+
+		for (i = 0; i < NUM_FL_PTE; i++)
+			if ((fl_table[i] & 0x03) == FL_TYPE_TABLE) {
+				void *sl_table = __va(fl_table[i] &
+								FL_BASE_MASK);
+				dmac_flush_range(sl_table, sl_table + SZ_4K);
+			}
+	}
+#endif
+
+	return __invalidate_tlb(domain);
+}
+
 static void __reset_context(void __iomem *base, int ctx)
 {
 	SET_BPRCOSH(base, ctx, 0);
@@ -367,6 +404,7 @@ static int msm_iommu_map(struct iommu_domain *domain, unsigned long va,
 	unsigned int pgprot;
 	size_t len = 0x1000UL << order;
 	int ret = 0, tex, sh;
+	ktime_t start = ktime_get();
 
 	spin_lock_irqsave(&msm_iommu_lock, flags);
 
@@ -461,6 +499,8 @@ static int msm_iommu_map(struct iommu_domain *domain, unsigned long va,
 
 	ret = __flush_iotlb(domain);
 fail:
+	msm_iommu_stats.maps++;
+	msm_iommu_stats.map_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
 	spin_unlock_irqrestore(&msm_iommu_lock, flags);
 	return ret;
 }
@@ -478,6 +518,7 @@ static int msm_iommu_unmap(struct iommu_domain *domain, unsigned long va,
 	unsigned long sl_offset;
 	size_t len = 0x1000UL << order;
 	int i, ret = 0;
+	ktime_t start = ktime_get();
 
 	spin_lock_irqsave(&msm_iommu_lock, flags);
 
@@ -546,6 +587,231 @@ static int msm_iommu_unmap(struct iommu_domain *domain, unsigned long va,
 
 	ret = __flush_iotlb(domain);
 fail:
+	msm_iommu_stats.unmaps++;
+	msm_iommu_stats.unmap_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	spin_unlock_irqrestore(&msm_iommu_lock, flags);
+	return ret;
+}
+
+static inline phys_addr_t __sg_phys(struct scatterlist *sg)
+{
+	return sg_dma_address(sg) ? sg_dma_address(sg) : sg_phys(sg);
+}
+
+/*
+ * Clear the entries for [va, va + len), freeing second level tables that
+ * become empty. Only the entries touched are cleaned to memory, the
+ * caller invalidates the TLB.
+ */
+static void __unmap_range(unsigned long *fl_table, unsigned long va,
+			  unsigned long len)
+{
+	unsigned long end = va + len;
+	unsigned long next;
+	unsigned long *fl_pte;
+	unsigned long *sl_table;
+	int i, used;
+
+	while (va < end) {
+		next = (va & ~(SZ_1M - 1)) + SZ_1M;
+		if (!next || next > end)
+			next = end;
+		fl_pte = fl_table + FL_OFFSET(va);
+
+		if ((*fl_pte & 0x03) == FL_TYPE_TABLE) {
+			sl_table = __va(*fl_pte & FL_BASE_MASK);
+			memset(sl_table + SL_OFFSET(va), 0,
+			       ((next - va) >> 12) * sizeof(*sl_table));
+			__clean_pte(sl_table + SL_OFFSET(va),
+				    sl_table + SL_OFFSET(va) +
+				    ((next - va) >> 12));
+
+			used = 0;
+			for (i = 0; i < NUM_SL_PTE; i++)
+				if (sl_table[i])
+					used = 1;
+			if (!used) {
+				free_page((unsigned long)sl_table);
+				*fl_pte = 0;
+				__clean_pte(fl_pte, fl_pte + 1);
+			}
+		} else if ((*fl_pte & 0x03) == FL_TYPE_SECT) {
+			if (*fl_pte & FL_SUPERSECTION) {
+				fl_pte = fl_table + (FL_OFFSET(va) & ~15);
+				memset(fl_pte, 0, 16 * sizeof(*fl_pte));
+				__clean_pte(fl_pte, fl_pte + 16);
+			} else {
+				*fl_pte = 0;
+				__clean_pte(fl_pte, fl_pte + 1);
+			}
+		}
+		va = next;
+	}
+}
+
+/*
+ * Map the whole scatterlist with the largest entries the alignment of
+ * each chunk allows, 1MB sections where the first level entry is free,
+ * then 64KB large pages, then 4KB pages, and invalidate the TLB once at
+ * the end instead of after every page.
+ */
+static int msm_iommu_map_range(struct iommu_domain *domain, unsigned int va,
+			       struct scatterlist *sg, unsigned int len,
+			       int prot)
+{
+	struct msm_priv *priv;
+	unsigned long flags;
+	unsigned long *fl_table;
+	unsigned long *fl_pte;
+	unsigned long *sl_table;
+	unsigned long *sl_pte;
+	unsigned int fl_prot, sl_prot;
+	unsigned int mapped = 0, off = 0, seg, size;
+	unsigned long v;
+	phys_addr_t pa, p;
+	int ret = 0, tex, sh, i;
+	ktime_t start = ktime_get();
+
+	spin_lock_irqsave(&msm_iommu_lock, flags);
+
+	sh = (prot & MSM_IOMMU_ATTR_SH) ? 1 : 0;
+	tex = msm_iommu_tex_class[prot & MSM_IOMMU_CP_MASK];
+
+	if (tex < 0 || tex > NUM_TEX_CLASS - 1) {
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	priv = domain->priv;
+	if (!priv || !priv->pgtable || !len || ((va | len) & (SZ_4K - 1))) {
+		ret = -EINVAL;
+		goto fail;
+	}
+	fl_table = priv->pgtable;
+
+	fl_prot = sh ? FL_SHARED : 0;
+	fl_prot |= tex & 0x01 ? FL_BUFFERABLE : 0;
+	fl_prot |= tex & 0x02 ? FL_CACHEABLE : 0;
+	fl_prot |= tex & 0x04 ? FL_TEX0 : 0;
+	sl_prot = sh ? SL_SHARED : 0;
+	sl_prot |= tex & 0x01 ? SL_BUFFERABLE : 0;
+	sl_prot |= tex & 0x02 ? SL_CACHEABLE : 0;
+	sl_prot |= tex & 0x04 ? SL_TEX0 : 0;
+
+	for (; sg && mapped < len; sg = sg_next(sg)) {
+		pa = __sg_phys(sg);
+		seg = min(sg->length, len - mapped);
+		if ((pa | seg) & (SZ_4K - 1)) {
+			ret = -EINVAL;
+			goto unmap;
+		}
+
+		for (off = 0; off < seg; off += size) {
+			v = va + mapped + off;
+			p = pa + off;
+			fl_pte = fl_table + FL_OFFSET(v);
+
+			if (seg - off >= SZ_1M && !((v | p) & (SZ_1M - 1)) &&
+			    *fl_pte == 0) {
+				*fl_pte = (p & 0xFFF00000) | FL_AP_READ |
+					  FL_AP_WRITE | FL_TYPE_SECT |
+					  FL_SHARED | fl_prot;
+				__clean_pte(fl_pte, fl_pte + 1);
+				msm_iommu_stats.sections++;
+				size = SZ_1M;
+				continue;
+			}
+
+			if (*fl_pte == 0) {
+				sl_table = (unsigned long *)
+					__get_free_page(GFP_ATOMIC);
+				if (!sl_table) {
+					ret = -ENOMEM;
+					goto unmap;
+				}
+				memset(sl_table, 0, SZ_4K);
+				__clean_pte(sl_table,
+					    sl_table + NUM_SL_PTE);
+				*fl_pte = (((int)__pa(sl_table)) &
+					   FL_BASE_MASK) | FL_TYPE_TABLE;
+				__clean_pte(fl_pte, fl_pte + 1);
+			} else if ((*fl_pte & 0x03) != FL_TYPE_TABLE) {
+				/* Already covered by a section */
+				ret = -EBUSY;
+				goto unmap;
+			}
+
+			sl_table = __va(*fl_pte & FL_BASE_MASK);
+			sl_pte = sl_table + SL_OFFSET(v);
+
+			if (seg - off >= SZ_64K &&
+			    !((v | p) & (SZ_64K - 1))) {
+				for (i = 0; i < 16; i++)
+					sl_pte[i] = (p & SL_BASE_MASK_LARGE) |
+						SL_AP0 | SL_AP1 | SL_SHARED |
+						SL_TYPE_LARGE | sl_prot;
+				__clean_pte(sl_pte, sl_pte + 16);
+				msm_iommu_stats.large_pages++;
+				size = SZ_64K;
+			} else {
+				*sl_pte = (p & SL_BASE_MASK_SMALL) | SL_AP0 |
+					SL_AP1 | SL_SHARED | SL_TYPE_SMALL |
+					sl_prot;
+				__clean_pte(sl_pte, sl_pte + 1);
+				msm_iommu_stats.small_pages++;
+				size = SZ_4K;
+			}
+		}
+		mapped += seg;
+		off = 0;
+	}
+
+	if (mapped < len) {
+		ret = -EINVAL;
+		goto unmap;
+	}
+
+	ret = __invalidate_tlb(domain);
+	goto fail;
+
+unmap:
+	__unmap_range(fl_table, va, mapped + off);
+	__invalidate_tlb(domain);
+fail:
+	msm_iommu_stats.map_ranges++;
+	msm_iommu_stats.map_range_ns +=
+		ktime_to_ns(ktime_sub(ktime_get(), start));
+	spin_unlock_irqrestore(&msm_iommu_lock, flags);
+	return ret;
+}
+
+static int msm_iommu_unmap_range(struct iommu_domain *domain, unsigned int va,
+				 unsigned int len)
+{
+	struct msm_priv *priv;
+	unsigned long flags;
+	int ret = 0;
+	ktime_t start = ktime_get();
+
+	spin_lock_irqsave(&msm_iommu_lock, flags);
+
+	priv = domain->priv;
+	if (!priv || !priv->pgtable) {
+		ret = -ENODEV;
+		goto fail;
+	}
+
+	if (!len || ((va | len) & (SZ_4K - 1))) {
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	__unmap_range(priv->pgtable, va, len);
+	ret = __invalidate_tlb(domain);
+fail:
+	msm_iommu_stats.unmap_ranges++;
+	msm_iommu_stats.unmap_range_ns +=
+		ktime_to_ns(ktime_sub(ktime_get(), start));
 	spin_unlock_irqrestore(&msm_iommu_lock, flags);
 	return ret;
 }
@@ -679,6 +945,8 @@ static struct iommu_ops msm_iommu_ops = {
 	.detach_dev = msm_iommu_detach_dev,
 	.map = msm_iommu_map,
 	.unmap = msm_iommu_unmap,
+	.map_range = msm_iommu_map_range,
+	.unmap_range = msm_iommu_unmap_range,
 	.iova_to_phys = msm_iommu_iova_to_phys,
 	.domain_has_cap = msm_iommu_domain_has_cap
 };
@@ -730,5 +998,50 @@ static int __init msm_iommu_init(void)
 
 subsys_initcall(msm_iommu_init);
 
+#ifdef CONFIG_DEBUG_FS
+static int msm_iommu_stats_show(struct seq_file *m, void *unused)
+{
+	struct msm_iommu_stats s;
+	unsigned long flags;
+
+	spin_lock_irqsave(&msm_iommu_lock, flags);
+	s = msm_iommu_stats;
+	spin_unlock_irqrestore(&msm_iommu_lock, flags);
+
+	seq_printf(m, "map:         %lu calls %llu us\n", s.maps,
+		   div_u64(s.map_ns, NSEC_PER_USEC));
+	seq_printf(m, "unmap:       %lu calls %llu us\n", s.unmaps,
+		   div_u64(s.unmap_ns, NSEC_PER_USEC));
+	seq_printf(m, "map_range:   %lu calls %llu us, %lu x 1M %lu x 64K"
+		   " %lu x 4K\n", s.map_ranges,
+		   div_u64(s.map_range_ns, NSEC_PER_USEC),
+		   s.sections, s.large_pages, s.small_pages);
+	seq_printf(m, "unmap_range: %lu calls %llu us\n", s.unmap_ranges,
+		   div_u64(s.unmap_range_ns, NSEC_PER_USEC));
+	seq_printf(m, "tlb flushes: %lu\n", s.tlb_flushes);
+	return 0;
+}
+
+static int msm_iommu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_iommu_stats_show, NULL);
+}
+
+static const struct file_operations msm_iommu_stats_fops = {
+	.open		= msm_iommu_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init msm_iommu_debugfs_init(void)
+{
+	debugfs_create_file("msm_iommu_stats", S_IRUGO, NULL, NULL,
+			    &msm_iommu_stats_fops);
+	return 0;
+}
+late_initcall(msm_iommu_debugfs_init);
+#endif
+
 MODULE_LICENSE("GPL v2");
 MODULE_AUTHOR("Stepan Moskovchenko <stepanm@codeaurora.org>");
@@ -0,0 +1,422 @@
+/* Copyright (c) 2010, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/*
+ * IPC BENCH Driver source file
+ *
+ * Times round trips to the modem over the inter processor paths. Write
+ * one of the commands below to /sys/kernel/debug/ipc_bench:
+ *
+ *   pcom [iters]              proc_comm PCOM_OEM_TEST_CMD
+ *   rpc [iters] [bytes]       ping server call, null or with a data array
+ *   smd [iters] [bytes]       local SMD loopback channel
+ *   smd_modem [iters] [bytes] LOOPBACK channel echoed by the modem
+ *
+ * Reading the file gives one line of key=value pairs per run, the last
+ * IPC_BENCH_RESULTS runs, for scripts to collect. Binder is driven from
+ * user space, its latencies are in /sys/kernel/debug/binder/latency.
+ */
+
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/debugfs.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+#include <linux/err.h>
+
+#include <mach/msm_smd.h>
+#include <mach/msm_rpcrouter.h>
+
+#include "proc_comm.h"
+#include "smd_private.h"
+
+#define IPC_BENCH_ITERS		1000
+#define IPC_BENCH_MAX_ITERS	100000
+#define IPC_BENCH_RESULTS	16
+/* Half of the SMD FIFO, a round trip never waits for room */
+#define IPC_BENCH_SMD_MAX	4096
+/* xdr_send_array() limit of the ping server data call */
+#define IPC_BENCH_RPC_MAX	64
+
+#define PING_MDM_PROG			0x30000081
+#define PING_MDM_VERS			0x00010001
+#define PING_MDM_NULL_PROC		0
+#define PING_MDM_REGISTER_DATA_PROC	4
+
+struct ipc_bench_result {
+	char test[12];
+	unsigned iters;
+	unsigned size;
+	u32 min, p50, p90, p99, max;	/* ns */
+	u64 ops_per_sec;
+	u64 bytes_per_sec;
+};
+
+struct ipc_bench {
+	const char *name;
+	unsigned def_size;
+	unsigned max_size;
+	int (*setup)(unsigned size);
+	int (*run)(unsigned size);
+	void (*teardown)(void);
+};
+
+static struct dentry *dent;
+static DEFINE_MUTEX(ipc_bench_lock);
+static int ipc_bench_res;
+static struct ipc_bench_result results[IPC_BENCH_RESULTS];
+static unsigned result_next, result_count;
+static u32 *lat;
+static uint32_t *bench_buf, *bench_rbuf;
+
+/* proc_comm */
+
+static int pcom_run(unsigned size)
+{
+	unsigned data1 = 10, data2 = 20;
+	int rc;
+
+	rc = msm_proc_comm(PCOM_OEM_TEST_CMD, &data1, &data2);
+	if (rc)
+		return rc;
+	return (data1 == 20 && data2 == 10) ? 0 : -EIO;
+}
+
+/* RPC to the modem ping server */
+
+static struct msm_rpc_client *rpc_client;
+
+struct rpc_data_arg {
+	uint32_t *data;
+	uint32_t size;
+};
+
+static int rpc_data_arg(struct msm_rpc_client *client,
+			struct msm_rpc_xdr *xdr, void *data)
+{
+	struct rpc_data_arg *arg = data;
+
+	xdr_send_array(xdr, (void **)&arg->data, &arg->size,
+		       IPC_BENCH_RPC_MAX, sizeof(uint32_t),
+		       (void *)xdr_send_uint32);
+	xdr_send_uint32(xdr, &arg->size);
+	return 0;
+}
+
+static int rpc_data_ret(struct msm_rpc_client *client,
+			struct msm_rpc_xdr *xdr, void *data)
+{
+	return xdr_recv_uint32(xdr, data);
+}
+
+static int rpc_setup(unsigned size)
+{
+	rpc_client = msm_rpc_register_client2("ipc_bench", PING_MDM_PROG,
+					      PING_MDM_VERS, 0, NULL);
+	if (IS_ERR(rpc_client))
+		return PTR_ERR(rpc_client);
+	return 0;
+}
+
+static int rpc_run(unsigned size)
+{
+	struct rpc_data_arg arg = { .data = bench_buf, .size = size / 4 };
+	uint32_t result;
+
+	if (!arg.size)
+		return msm_rpc_client_req2(rpc_client, PING_MDM_NULL_PROC,
+					   NULL, NULL, NULL, NULL, -1);
+	return msm_rpc_client_req2(rpc_client, PING_MDM_REGISTER_DATA_PROC,
+				   rpc_data_arg, &arg, rpc_data_ret, &result,
+				   -1);
+}
+
+static void rpc_teardown(void)
+{
+	msm_rpc_unregister_client(rpc_client);
+}
+
+/* SMD loopback */
+
+static smd_channel_t *smd_ch;
+static DECLARE_WAIT_QUEUE_HEAD(smd_wait);
+static int smd_opened;
+
+static void smd_bench_notify(void *priv, unsigned event)
+{
+	if (event == SMD_EVENT_OPEN)
+		smd_opened = 1;
+	wake_up(&smd_wait);
+}
+
+static int smd_local_setup(unsigned size)
+{
+	return smd_named_open_on_edge("local_loopback", SMD_LOOPBACK_TYPE,
+				      &smd_ch, NULL, smd_bench_notify);
+}
+
+static int smd_modem_setup(unsigned size)
+{
+	int rc;
+
+	/* Ask the modem to echo what it receives on LOOPBACK */
+	smsm_change_state(SMSM_APPS_STATE, 0, SMSM_SMD_LOOPBACK);
+	smd_opened = 0;
+	rc = smd_open("LOOPBACK", &smd_ch, NULL, smd_bench_notify);
+	if (rc)
+		return rc;
+	if (!wait_event_timeout(smd_wait, smd_opened, 5 * HZ)) {
+		smd_close(smd_ch);
+		return -ETIMEDOUT;
+	}
+	return 0;
+}
+
+static int smd_run(unsigned size)
+{
+	int rc;
+
+	rc = smd_write(smd_ch, bench_buf, size);
+	if (rc != size)
+		return rc < 0 ? rc : -EIO;
+	if (!wait_event_timeout(smd_wait, smd_read_avail(smd_ch) >= size, HZ))
+		return -ETIMEDOUT;
+	rc = smd_read(smd_ch, bench_rbuf, size);
+	if (rc != size)
+		return rc < 0 ? rc : -EIO;
+	return memcmp(bench_buf, bench_rbuf, size) ? -EIO : 0;
+}
+
+static void smd_teardown(void)
+{
+	smd_close(smd_ch);
+}
+
+static const struct ipc_bench benches[] = {
+	{ "pcom", 8, 8, NULL, pcom_run, NULL },
+	{ "rpc", 0, IPC_BENCH_RPC_MAX * 4, rpc_setup, rpc_run,
+	  rpc_teardown },
+	{ "smd", 64, IPC_BENCH_SMD_MAX, smd_local_setup, smd_run,
+	  smd_teardown },
+	{ "smd_modem", 64, IPC_BENCH_SMD_MAX, smd_modem_setup, smd_run,
+	  smd_teardown },
+};
+
+static int cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int ipc_bench_run(const struct ipc_bench *b, unsigned iters,
+			 unsigned size)
+{
+	struct ipc_bench_result *r;
+	ktime_t start;
+	s64 ns, total = 0;
+	unsigned i;
+	int rc;
+
+	if (b->setup) {
+		rc = b->setup(size);
+		if (rc)
+			return rc;
+	}
+
+	for (i = 0; i < iters; i++) {
+		bench_buf[i % (IPC_BENCH_SMD_MAX / 4)] = i;
+		start = ktime_get();
+		rc = b->run(size);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		if (rc)
+			break;
+		lat[i] = min_t(s64, ns, UINT_MAX);
+		total += ns;
+	}
+
+	if (b->teardown)
+		b->teardown();
+	if (rc)
+		return rc;
+
+	sort(lat, iters, sizeof(u32), cmp_u32, NULL);
+	r = &results[result_next];
+	result_next = (result_next + 1) % IPC_BENCH_RESULTS;
+	if (result_count < IPC_BENCH_RESULTS)
+		result_count++;
+
+	strlcpy(r->test, b->name, sizeof(r->test));
+	r->iters = iters;
+	r->size = size;
+	r->min = lat[0];
+	r->p50 = lat[iters / 2];
+	r->p90 = lat[iters * 9 / 10];
+	r->p99 = lat[iters * 99 / 100];
+	r->max = lat[iters - 1];
+	total = max_t(s64, total, 1);
+	r->ops_per_sec = div64_u64((u64)iters * NSEC_PER_SEC, total);
+	r->bytes_per_sec = div64_u64((u64)iters * size * NSEC_PER_SEC, total);
+	return 0;
+}
+
+static int ipc_bench_cmd(const char *cmd)
+{
+	const struct ipc_bench *b = NULL;
+	char name[16];
+	unsigned iters = IPC_BENCH_ITERS, size;
+	int i, n;
+
+	n = sscanf(cmd, "%15s %u %u", name, &iters, &size);
+	if (n < 1)
+		return -EINVAL;
+
+	for (i = 0; i < ARRAY_SIZE(benches); i++)
+		if (!strcmp(name, benches[i].name))
+			b = &benches[i];
+	if (!b)
+		return -EINVAL;
+
+	if (n < 3)
+		size = b->def_size;
+	if (!iters || iters > IPC_BENCH_MAX_ITERS || size > b->max_size)
+		return -EINVAL;
+
+	return ipc_bench_run(b, iters, size);
+}
+
+static ssize_t debug_read(struct file *fp, char __user *buf,
+			  size_t count, loff_t *pos)
+{
+	struct ipc_bench_result *r;
+	char *_buf;
+	int i, len = 0, size = 256 * IPC_BENCH_RESULTS;
+	ssize_t ret;
+
+	_buf = kmalloc(size, GFP_KERNEL);
+	if (!_buf)
+		return -ENOMEM;
+
+	mutex_lock(&ipc_bench_lock);
+	if (ipc_bench_res)
+		len = scnprintf(_buf, size, "error=%i\n", ipc_bench_res);
+	for (i = 0; i < result_count; i++) {
+		r = &results[(result_next + IPC_BENCH_RESULTS - result_count +
+			      i) % IPC_BENCH_RESULTS];
+		len += scnprintf(_buf + len, size - len,
+				 "test=%s iters=%u size=%u min_ns=%u "
+				 "p50_ns=%u p90_ns=%u p99_ns=%u max_ns=%u "
+				 "ops_per_sec=%llu bytes_per_sec=%llu\n",
+				 r->test, r->iters, r->size, r->min, r->p50,
+				 r->p90, r->p99, r->max, r->ops_per_sec,
+				 r->bytes_per_sec);
+	}
+	mutex_unlock(&ipc_bench_lock);
+
+	ret = simple_read_from_buffer(buf, count, pos, _buf, len);
+	kfree(_buf);
+	return ret;
+}
+
+static ssize_t debug_write(struct file *fp, const char __user *buf,
+			   size_t count, loff_t *pos)
+{
+	unsigned char cmd[64];
+	int len;
+
+	if (count < 1)
+		return 0;
+
+	len = count > 63 ? 63 : count;
+
+	if (copy_from_user(cmd, buf, len))
+		return -EFAULT;
+
+	cmd[len] = 0;
+
+	if (cmd[len-1] == '\n') {
+		cmd[len-1] = 0;
+		len--;
+	}
+
+	mutex_lock(&ipc_bench_lock);
+	ipc_bench_res = ipc_bench_cmd(cmd);
+	mutex_unlock(&ipc_bench_lock);
+
+	if (ipc_bench_res)
+		pr_err("ipc bench \"%s\" fail %d\n", cmd, ipc_bench_res);
+
+	return count;
+}
+
+static int debug_open(struct inode *ip, struct file *fp)
+{
+	return 0;
+}
+
+static int debug_release(struct inode *ip, struct file *fp)
+{
+	return 0;
+}
+
+static const struct file_operations debug_ops = {
+	.owner = THIS_MODULE,
+	.open = debug_open,
+	.release = debug_release,
+	.read = debug_read,
+	.write = debug_write,
+};
+
+static void __exit ipc_bench_mod_exit(void)
+{
+	debugfs_remove(dent);
+	vfree(lat);
+	kfree(bench_buf);
+	kfree(bench_rbuf);
+}
+
+static int __init ipc_bench_mod_init(void)
+{
+	lat = vmalloc(IPC_BENCH_MAX_ITERS * sizeof(u32));
+	bench_buf = kzalloc(IPC_BENCH_SMD_MAX, GFP_KERNEL);
+	bench_rbuf = kzalloc(IPC_BENCH_SMD_MAX, GFP_KERNEL);
+	if (!lat || !bench_buf || !bench_rbuf) {
+		vfree(lat);
+		kfree(bench_buf);
+		kfree(bench_rbuf);
+		return -ENOMEM;
+	}
+
+	dent = debugfs_create_file("ipc_bench", 0644, 0, NULL, &debug_ops);
+	return 0;
+}
+
+module_init(ipc_bench_mod_init);
+module_exit(ipc_bench_mod_exit);
+
+MODULE_DESCRIPTION("IPC BENCH Driver");
+MODULE_LICENSE("GPL v2");
@@ -207,7 +207,7 @@ static int __init init_modem_notifier_list(void)
 #endif
 
 	/* Create the workqueue */
-	modem_notifier_wq = create_singlethread_workqueue("modem_notifier");
+	modem_notifier_wq = create_shared_workqueue("modem_notifier");
 	if (!modem_notifier_wq) {
 		srcu_cleanup_notifier_head(&modem_notifier_list);
 		return -ENOMEM;
@@ -22,6 +22,10 @@
 #include <linux/mutex.h>
 #include <linux/radix-tree.h>
 #include <linux/clk.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/jiffies.h>
 #include <mach/msm_bus_board.h>
 #include <mach/msm_bus.h>
 #include "msm_bus_core.h"
@@ -53,6 +57,22 @@
 
 static DEFINE_MUTEX(msm_bus_lock);
 static atomic_t num_fab = ATOMIC_INIT(0);
+static LIST_HEAD(msm_bus_clients);
+
+/*
+ * Votes that only lower bandwidth are committed to the RPM after this
+ * many ms, so that the votes clients make back to back (several per
+ * frame for MDP and the GPU) go out as one commit. A vote that raises
+ * bandwidth commits at once, together with anything still pending.
+ * 0 commits every vote immediately.
+ */
+static unsigned int commit_delay_ms = 4;
+module_param(commit_delay_ms, uint, S_IRUGO | S_IWUSR);
+
+static int msm_bus_commit_pending;
+static unsigned long msm_bus_commits;
+static void msm_bus_commit_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(msm_bus_commit_dwork, msm_bus_commit_work);
 
 int msm_bus_device_match(struct device *dev, void* id)
 {
@@ -414,6 +434,25 @@ static int msm_bus_commit_fn(struct device *dev, void *data)
 	return ret;
 }
 
+/* Called with msm_bus_lock held */
+static void msm_bus_commit_all(void)
+{
+	int context = ACTIVE_ONLY;
+
+	msm_bus_commit_pending = 0;
+	msm_bus_commits++;
+	bus_for_each_dev(&msm_bus_type, NULL, (void *)context,
+		msm_bus_commit_fn);
+}
+
+static void msm_bus_commit_work(struct work_struct *work)
+{
+	mutex_lock(&msm_bus_lock);
+	if (msm_bus_commit_pending)
+		msm_bus_commit_all();
+	mutex_unlock(&msm_bus_lock);
+}
+
 /* msm bus client related EXPORTED functions */
 
 /**
@@ -445,6 +484,7 @@ uint32_t msm_bus_scale_register_client(struct msm_bus_scale_pdata *pdata)
 	mutex_lock(&msm_bus_lock);
 	client->pdata = pdata;
 	client->curr = -1;
+	INIT_LIST_HEAD(&client->list);
 	for (i = 0; i < pdata->usecase->num_paths; i++) {
 		int *pnode;
 		struct msm_bus_fabric_device *srcfab;
@@ -465,11 +505,13 @@ uint32_t msm_bus_scale_register_client(struct msm_bus_scale_pdata *pdata)
 		if (pnode[i] < 0) {
 			MSM_BUS_ERR("Cannot register client now!\n"
 				"Fabrics not yet up. Try again!\n");
+			kfree(client->src_pnode);
 			kfree(client);
 			mutex_unlock(&msm_bus_lock);
 			goto err;
 		}
 	}
+	list_add_tail(&client->list, &msm_bus_clients);
 	mutex_unlock(&msm_bus_lock);
 	MSM_BUS_DBG("ret: %u num_paths: %d\n", (uint32_t)client,
 		pdata->usecase->num_paths);
@@ -494,7 +536,7 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 	unsigned int req_clk, req_bw, curr_clk, curr_bw;
 	int pnode, src, curr;
 	struct msm_bus_client *client = (struct msm_bus_client *)cl;
-	int context;
+	int raise = 0;
 	if (IS_ERR(client)) {
 		MSM_BUS_ERR("msm_bus_scale_client update req error %d\n",
 				(uint32_t)client);
@@ -503,8 +545,13 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 	}
 
 	mutex_lock(&msm_bus_lock);
-	if (client->curr == index)
+	if (!client->votes++)
+		client->first_vote = jiffies;
+	client->last_vote = jiffies;
+	if (client->curr == index) {
+		client->unchanged++;
 		goto err;
+	}
 
 	curr = client->curr;
 	pdata = client->pdata;
@@ -527,6 +574,8 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 					usecase[curr].vectors[i].ab);
 			MSM_BUS_DBG("ab: %d ib: %d\n", curr_bw, curr_clk);
 		}
+		if (req_clk > curr_clk || req_bw > curr_bw)
+			raise = 1;
 
 		if (!pdata->active_only) {
 			ret = update_path(src, pnode, req_clk, req_bw,
@@ -546,9 +595,16 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 	}
 
 	client->curr = index;
-	context = ACTIVE_ONLY;
-	bus_for_each_dev(&msm_bus_type, NULL, (void *)context,
-		msm_bus_commit_fn);
+	if (raise || !commit_delay_ms) {
+		msm_bus_commit_all();
+	} else {
+		client->deferred++;
+		if (!msm_bus_commit_pending) {
+			msm_bus_commit_pending = 1;
+			schedule_delayed_work(&msm_bus_commit_dwork,
+				msecs_to_jiffies(commit_delay_ms));
+		}
+	}
 
 err:
 	mutex_unlock(&msm_bus_lock);
@@ -568,6 +624,9 @@ void msm_bus_scale_unregister_client(uint32_t cl)
 	if (client->curr != 0)
 		msm_bus_scale_client_update_request(cl, 0);
 	MSM_BUS_DBG("Unregistering client %d\n", cl);
+	mutex_lock(&msm_bus_lock);
+	list_del(&client->list);
+	mutex_unlock(&msm_bus_lock);
 	kfree(client->src_pnode);
 	kfree(client);
 }
@@ -605,8 +664,54 @@ int msm_bus_axi_portunhalt(int master_port)
 }
 EXPORT_SYMBOL(msm_bus_axi_portunhalt);
 
+#ifdef CONFIG_DEBUG_FS
+static int msm_bus_clients_show(struct seq_file *m, void *unused)
+{
+	struct msm_bus_client *client;
+
+	mutex_lock(&msm_bus_lock);
+	seq_printf(m, "commits %lu pending %d delay_ms %u\n",
+		msm_bus_commits, msm_bus_commit_pending, commit_delay_ms);
+	seq_printf(m, "%-16s %5s %8s %8s %8s %10s\n", "client", "curr",
+		"votes", "same", "deferred", "votes/sec");
+	list_for_each_entry(client, &msm_bus_clients, list) {
+		unsigned long secs = (client->last_vote -
+			client->first_vote) / HZ;
+
+		seq_printf(m, "%-16s %5d %8lu %8lu %8lu %10lu\n",
+			client->pdata->name ? client->pdata->name : "?",
+			client->curr, client->votes, client->unchanged,
+			client->deferred,
+			secs ? client->votes / secs : client->votes);
+	}
+	mutex_unlock(&msm_bus_lock);
+	return 0;
+}
+
+static int msm_bus_clients_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_bus_clients_show, inode->i_private);
+}
+
+static const struct file_operations msm_bus_clients_fops = {
+	.open		= msm_bus_clients_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init msm_bus_debugfs_init(void)
+{
+	debugfs_create_file("msm_bus_clients", S_IRUGO, NULL, NULL,
+		&msm_bus_clients_fops);
+	return 0;
+}
+late_initcall(msm_bus_debugfs_init);
+#endif
+
 static void __exit msm_bus_exit(void)
 {
+	cancel_delayed_work_sync(&msm_bus_commit_dwork);
 	bus_unregister(&msm_bus_type);
 }
 
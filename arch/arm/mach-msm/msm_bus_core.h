@@ -149,6 +149,13 @@ struct msm_bus_client {
 	struct msm_bus_scale_pdata *pdata;
 	int *src_pnode;
 	int curr;
+	struct list_head list;
+	/* Vote statistics, under msm_bus_lock */
+	unsigned long votes;
+	unsigned long unchanged;
+	unsigned long deferred;
+	unsigned long first_vote;
+	unsigned long last_vote;
 };
 
 int msm_bus_fabric_device_register(struct msm_bus_fabric_device *fabric);
@@ -67,6 +67,9 @@ struct msm_bus_fabric {
 	const struct msm_bus_fab_algorithm *algo;
 	struct msm_bus_fabric_registration *pdata;
 	struct msm_rpm_iv_pair *rpm_data;
+	/* Last data the RPM accepted, valid once rpm_last_valid is set */
+	struct msm_rpm_iv_pair *rpm_last;
+	int rpm_last_valid;
 };
 #define to_msm_bus_fabric(d) container_of(d, \
 	struct msm_bus_fabric, d)
@@ -203,6 +206,8 @@ static int register_fabric_info(struct msm_bus_fabric *fabric)
 
 	fabric->rpm_data = kmalloc((sizeof(struct msm_rpm_iv_pair) * count),
 		GFP_KERNEL);
+	fabric->rpm_last = kmalloc((sizeof(struct msm_rpm_iv_pair) * count),
+		GFP_KERNEL);
 
 	MSM_FAB_DBG("Fabric: %d nmasters: %d nslaves: %d\n"
 		" ntieredslaves: %d, rpm_enabled: %d\n",
@@ -289,11 +294,28 @@ static int msm_bus_fabric_rpm_commit(struct msm_bus_fabric_device *fabdev,
 			cdata->arb[(i * fabric->nmasters) + j]);
 	}
 
+	/*
+	 * Votes often move the bandwidth back and forth between the same
+	 * values, skip the RPM request when the aggregate is unchanged.
+	 */
+	if (active_only && fabric->rpm_last_valid &&
+		!memcmp(fabric->rpm_last, rpm_data, count * sizeof(*rpm_data))) {
+		MSM_FAB_DBG("Not committing as arb data unchanged\n");
+		fabric->dirty = false;
+		return status;
+	}
+
 	MSM_FAB_DBG("calling msm_rpm_set:  %d\n", status);
 	if (fabric->pdata->rpm_enabled) {
-		if (active_only)
+		if (active_only) {
 			status = msm_rpm_set(MSM_RPM_CTX_SET_0, rpm_data,
 				count);
+			if (!status && fabric->rpm_last) {
+				memcpy(fabric->rpm_last, rpm_data,
+					count * sizeof(*rpm_data));
+				fabric->rpm_last_valid = true;
+			}
+		}
 	}
 
 	MSM_FAB_DBG("msm_rpm_set returned: %d\n", status);
@@ -770,6 +792,7 @@ static int msm_bus_fabric_remove(struct platform_device *pdev)
 	}
 	kfree(fabric->info.node_info);
 	kfree(fabric->rpm_data);
+	kfree(fabric->rpm_last);
 	kfree(fabric);
 	return ret;
 }
@@ -0,0 +1,305 @@
+/* Copyright (c) 2010, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/*
+ * Hotplug policy for the second core
+ *
+ * Every sample_ms the busy percentage of the online cores and an average
+ * of the runqueue depth are sampled on CPU0. The second core is taken
+ * offline after down_samples samples in a row below down_load with at
+ * most one runnable task, and brought back after up_samples samples
+ * above up_load or with the runqueue average at or above up_nr_running
+ * (in hundredths). A touch input boost brings it back straight away,
+ * before the load shows up, and keeps it online while the boost lasts.
+ *
+ * When the screen turns off the second core goes offline and sampling
+ * stops; it comes back online with the screen.
+ *
+ * The tunables and the time cpu_up()/cpu_down() took are module
+ * parameters in /sys/module/msm_hotplug/parameters.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/earlysuspend.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/sched.h>
+#include <linux/tick.h>
+#include <linux/workqueue.h>
+
+static int enabled = 1;
+static unsigned int sample_ms = 100;
+static unsigned int up_load = 80;
+static unsigned int up_nr_running = 250;
+static unsigned int up_samples = 2;
+static unsigned int down_load = 30;
+static unsigned int down_samples = 10;
+
+static unsigned int up_count;
+static unsigned int up_latency_us;
+static unsigned int up_latency_max_us;
+static unsigned int down_count;
+static unsigned int down_latency_us;
+static unsigned int down_latency_max_us;
+
+module_param(sample_ms, uint, S_IRUGO | S_IWUSR);
+module_param(up_load, uint, S_IRUGO | S_IWUSR);
+module_param(up_nr_running, uint, S_IRUGO | S_IWUSR);
+module_param(up_samples, uint, S_IRUGO | S_IWUSR);
+module_param(down_load, uint, S_IRUGO | S_IWUSR);
+module_param(down_samples, uint, S_IRUGO | S_IWUSR);
+module_param(up_count, uint, S_IRUGO);
+module_param(up_latency_us, uint, S_IRUGO);
+module_param(up_latency_max_us, uint, S_IRUGO);
+module_param(down_count, uint, S_IRUGO);
+module_param(down_latency_us, uint, S_IRUGO);
+module_param(down_latency_max_us, uint, S_IRUGO);
+
+static struct {
+	struct delayed_work work;
+	struct work_struct boost_work;
+	struct mutex lock;
+	u64 prev_idle[NR_CPUS];
+	u64 prev_wall[NR_CPUS];
+	unsigned int nr_avg;
+	unsigned int up_hits;
+	unsigned int down_hits;
+	bool screen_off;
+	bool ready;
+} hp;
+
+static void msm_hotplug_sample_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		hp.prev_idle[cpu] = get_cpu_idle_time_us(cpu,
+							 &hp.prev_wall[cpu]);
+	hp.nr_avg = 0;
+	hp.up_hits = 0;
+	hp.down_hits = 0;
+}
+
+/* Busy percentage averaged over the online cores since the last sample */
+static unsigned int msm_hotplug_load(void)
+{
+	unsigned int load = 0;
+	unsigned int n = 0;
+	u64 idle, wall;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		idle = get_cpu_idle_time_us(cpu, &wall);
+		if (cpu_online(cpu) && wall > hp.prev_wall[cpu]) {
+			u64 d_wall = wall - hp.prev_wall[cpu];
+			u64 d_idle = idle - hp.prev_idle[cpu];
+
+			if (d_idle < d_wall)
+				load += div64_u64(100 * (d_wall - d_idle),
+						  d_wall);
+			n++;
+		}
+		hp.prev_idle[cpu] = idle;
+		hp.prev_wall[cpu] = wall;
+	}
+	return n ? load / n : 0;
+}
+
+static void msm_hotplug_up(unsigned int cpu)
+{
+	ktime_t start = ktime_get();
+	unsigned int us;
+
+	if (cpu_up(cpu))
+		return;
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	up_count++;
+	up_latency_us = us;
+	if (us > up_latency_max_us)
+		up_latency_max_us = us;
+	hp.down_hits = 0;
+}
+
+static void msm_hotplug_down(unsigned int cpu)
+{
+	ktime_t start = ktime_get();
+	unsigned int us;
+
+	if (cpu_down(cpu))
+		return;
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	down_count++;
+	down_latency_us = us;
+	if (us > down_latency_max_us)
+		down_latency_max_us = us;
+	hp.up_hits = 0;
+}
+
+static void msm_hotplug_work(struct work_struct *work)
+{
+	unsigned int load;
+	unsigned int nr;
+
+	mutex_lock(&hp.lock);
+	if (!enabled || hp.screen_off)
+		goto out;
+
+	load = msm_hotplug_load();
+	/* Not counting this worker */
+	nr = nr_running();
+	if (nr)
+		nr--;
+	hp.nr_avg = (hp.nr_avg * 3 + nr * 100) / 4;
+
+	if (!cpu_online(1)) {
+		if (load >= up_load || hp.nr_avg >= up_nr_running)
+			hp.up_hits++;
+		else
+			hp.up_hits = 0;
+		if (hp.up_hits >= up_samples)
+			msm_hotplug_up(1);
+	} else {
+		if (load < down_load && hp.nr_avg <= 100 &&
+		    !cpufreq_input_boost_freq())
+			hp.down_hits++;
+		else
+			hp.down_hits = 0;
+		if (hp.down_hits >= down_samples)
+			msm_hotplug_down(1);
+	}
+
+	schedule_delayed_work_on(0, &hp.work, msecs_to_jiffies(sample_ms));
+out:
+	mutex_unlock(&hp.lock);
+}
+
+static void msm_hotplug_boost_work(struct work_struct *work)
+{
+	mutex_lock(&hp.lock);
+	if (enabled && !hp.screen_off && !cpu_online(1))
+		msm_hotplug_up(1);
+	mutex_unlock(&hp.lock);
+}
+
+/* Called from the input event path, in atomic context */
+static int msm_hotplug_boost(struct notifier_block *nb, unsigned long freq,
+			     void *unused)
+{
+	if (enabled && !cpu_online(1))
+		schedule_work_on(0, &hp.boost_work);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block msm_hotplug_boost_nb = {
+	.notifier_call = msm_hotplug_boost,
+};
+
+/* Called without hp.lock, the works take it */
+static void msm_hotplug_stop(void)
+{
+	cancel_delayed_work_sync(&hp.work);
+	cancel_work_sync(&hp.boost_work);
+}
+
+static void msm_hotplug_start(void)
+{
+	msm_hotplug_sample_init();
+	schedule_delayed_work_on(0, &hp.work, msecs_to_jiffies(sample_ms));
+}
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void msm_hotplug_early_suspend(struct early_suspend *h)
+{
+	msm_hotplug_stop();
+	mutex_lock(&hp.lock);
+	hp.screen_off = true;
+	if (enabled && cpu_online(1))
+		msm_hotplug_down(1);
+	mutex_unlock(&hp.lock);
+}
+
+static void msm_hotplug_late_resume(struct early_suspend *h)
+{
+	mutex_lock(&hp.lock);
+	hp.screen_off = false;
+	if (enabled && !cpu_online(1))
+		msm_hotplug_up(1);
+	mutex_unlock(&hp.lock);
+	if (enabled)
+		msm_hotplug_start();
+}
+
+static struct early_suspend msm_hotplug_early_suspend_handler = {
+	.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN,
+	.suspend = msm_hotplug_early_suspend,
+	.resume = msm_hotplug_late_resume,
+};
+#endif
+
+/*
+ * Disabling leaves the cores as they are, for the cpuX/online files or
+ * a userspace policy.
+ */
+static int msm_hotplug_set_enabled(const char *val, struct kernel_param *kp)
+{
+	int old = enabled;
+	int ret;
+
+	ret = param_set_bool(val, kp);
+	if (ret || old == enabled || !hp.ready)
+		return ret;
+
+	if (enabled) {
+		mutex_lock(&hp.lock);
+		if (!hp.screen_off)
+			msm_hotplug_start();
+		mutex_unlock(&hp.lock);
+	} else
+		msm_hotplug_stop();
+	return 0;
+}
+
+module_param_call(enabled, msm_hotplug_set_enabled, param_get_bool,
+		  &enabled, S_IRUGO | S_IWUSR);
+
+static int __init msm_hotplug_init(void)
+{
+	if (num_possible_cpus() < 2)
+		return 0;
+
+	mutex_init(&hp.lock);
+	INIT_DELAYED_WORK_DEFERRABLE(&hp.work, msm_hotplug_work);
+	INIT_WORK(&hp.boost_work, msm_hotplug_boost_work);
+
+	cpufreq_input_boost_register(&msm_hotplug_boost_nb);
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&msm_hotplug_early_suspend_handler);
+#endif
+	hp.ready = true;
+	if (enabled)
+		msm_hotplug_start();
+	return 0;
+}
+
+late_initcall(msm_hotplug_init);
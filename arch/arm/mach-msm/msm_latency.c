@@ -0,0 +1,164 @@
+/* arch/arm/mach-msm/msm_latency.c
+ *
+ * Request latency report for MSM drivers
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Hooks msm_req_done and keeps a histogram of the latencies per
+ * subsystem, so percentiles are available without tracing to a buffer.
+ * Buckets are powers of two in microseconds split in four, good to 25%.
+ * debugfs msm_latency prints the report, writing to it resets it.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+
+#define CREATE_TRACE_POINTS
+#include <mach/msm_latency.h>
+
+#define LAT_BUCKETS	128
+
+struct msm_latency_hist {
+	u32 bucket[LAT_BUCKETS];
+	u32 count;
+	u32 errors;
+	u32 max_us;
+	u64 total_us;
+};
+
+static const char *msm_latency_names[MSM_LATENCY_NR] = {
+	[MSM_LATENCY_SMD]	= "smd",
+	[MSM_LATENCY_RPC]	= "rpc",
+	[MSM_LATENCY_SDCC]	= "sdcc",
+	[MSM_LATENCY_NAND]	= "nand",
+	[MSM_LATENCY_FB]	= "fb",
+	[MSM_LATENCY_KGSL]	= "kgsl",
+};
+
+static struct msm_latency_hist msm_latency_hist[MSM_LATENCY_NR];
+static DEFINE_SPINLOCK(msm_latency_lock);
+
+static unsigned int lat_bucket(u32 us)
+{
+	unsigned int shift;
+
+	if (us < 4)
+		return us;
+	shift = fls(us) - 3;
+	return (shift + 1) * 4 + ((us >> shift) & 3);
+}
+
+/* Upper bound of a bucket in microseconds */
+static u32 lat_bucket_max(unsigned int i)
+{
+	if (i < 4)
+		return i;
+	return ((u32)(5 + i % 4) << (i / 4 - 1)) - 1;
+}
+
+static void msm_latency_probe(void *ignore, int subsys, unsigned long id,
+			      u64 ns, int result)
+{
+	struct msm_latency_hist *h;
+	unsigned long flags;
+	u32 us;
+
+	if (subsys < 0 || subsys >= MSM_LATENCY_NR)
+		return;
+	h = &msm_latency_hist[subsys];
+	us = min_t(u64, div_u64(ns, NSEC_PER_USEC), (u32)~0U);
+
+	spin_lock_irqsave(&msm_latency_lock, flags);
+	h->bucket[lat_bucket(us)]++;
+	h->count++;
+	if (result < 0)
+		h->errors++;
+	h->total_us += us;
+	if (us > h->max_us)
+		h->max_us = us;
+	spin_unlock_irqrestore(&msm_latency_lock, flags);
+}
+
+static u32 lat_percentile(struct msm_latency_hist *h, unsigned int pct)
+{
+	u32 want = div_u64((u64)h->count * pct + 99, 100);
+	u32 seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seen += h->bucket[i];
+		if (seen >= want)
+			return min(lat_bucket_max(i), h->max_us);
+	}
+	return h->max_us;
+}
+
+static int msm_latency_show(struct seq_file *m, void *unused)
+{
+	struct msm_latency_hist h;
+	int i;
+
+	seq_printf(m, "%-6s %10s %8s %8s %8s %8s %8s %8s\n", "subsys",
+		   "count", "errors", "avg_us", "p50_us", "p90_us", "p99_us",
+		   "max_us");
+	for (i = 0; i < MSM_LATENCY_NR; i++) {
+		spin_lock_irq(&msm_latency_lock);
+		h = msm_latency_hist[i];
+		spin_unlock_irq(&msm_latency_lock);
+
+		if (!h.count)
+			continue;
+		seq_printf(m, "%-6s %10u %8u %8llu %8u %8u %8u %8u\n",
+			   msm_latency_names[i], h.count, h.errors,
+			   div_u64(h.total_us, h.count),
+			   lat_percentile(&h, 50), lat_percentile(&h, 90),
+			   lat_percentile(&h, 99), h.max_us);
+	}
+	return 0;
+}
+
+static int msm_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_latency_show, NULL);
+}
+
+static ssize_t msm_latency_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	spin_lock_irq(&msm_latency_lock);
+	memset(msm_latency_hist, 0, sizeof(msm_latency_hist));
+	spin_unlock_irq(&msm_latency_lock);
+	return count;
+}
+
+static const struct file_operations msm_latency_fops = {
+	.open		= msm_latency_open,
+	.read		= seq_read,
+	.write		= msm_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init msm_latency_init(void)
+{
+	int ret;
+
+	ret = register_trace_msm_req_done(msm_latency_probe, NULL);
+	if (ret)
+		return ret;
+	debugfs_create_file("msm_latency", 0644, NULL, NULL,
+			    &msm_latency_fops);
+	return 0;
+}
+late_initcall(msm_latency_init);
@@ -18,6 +18,7 @@
 
 #include <linux/pm_qos_params.h>
 #include <linux/err.h>
+#include <linux/sched.h>
 #include <mach/msm_reqs.h>
 
 struct pm_qos_request_list {
@@ -28,6 +29,8 @@ struct pm_qos_request_list {
                 s32 kbps;
         };
         int pm_qos_class;
+        void *owner;
+        char comm[TASK_COMM_LEN];
 };
 
 
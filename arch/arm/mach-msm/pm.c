@@ -30,6 +30,7 @@
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
 #include <asm/io.h>
+#include <asm/pmu.h>
 
 #ifdef CONFIG_HAS_WAKELOCK
 #include <linux/wakelock.h>
@@ -352,6 +353,7 @@ static int msm_sleep(int sleep_mode, uint32_t sleep_delay,
 			printk(KERN_INFO "msm_sleep(): vector %x %x -> "
 			       "%x %x\n", saved_vector[0], saved_vector[1],
 			       msm_pm_reset_vector[0], msm_pm_reset_vector[1]);
+		armpmu_suspend();
 		collapsed = msm_pm_collapse();
 		msm_pm_reset_vector[0] = saved_vector[0];
 		msm_pm_reset_vector[1] = saved_vector[1];
@@ -360,6 +362,7 @@ static int msm_sleep(int sleep_mode, uint32_t sleep_delay,
 			local_fiq_enable();
 			rv = 0;
 		}
+		armpmu_resume();
 		if (msm_pm_debug_mask & MSM_PM_DEBUG_POWER_COLLAPSE)
 			printk(KERN_INFO "msm_pm_collapse(): returned %d\n",
 			       collapsed);
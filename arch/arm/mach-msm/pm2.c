@@ -32,11 +32,14 @@
 #include <linux/uaccess.h>
 #include <linux/io.h>
 #include <linux/memory.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #ifdef CONFIG_HAS_WAKELOCK
 #include <linux/wakelock.h>
 #endif
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
+#include <asm/pmu.h>
 #ifdef CONFIG_CPU_V7
 #include <asm/pgtable.h>
 #include <asm/pgalloc.h>
@@ -648,6 +651,10 @@ enum msm_pm_time_stats_id {
 	MSM_PM_STAT_SUSPEND,
 	MSM_PM_STAT_FAILED_SUSPEND,
 	MSM_PM_STAT_NOT_IDLE,
+#ifdef CONFIG_MSM_IDLE_PREDICT
+	MSM_PM_STAT_IDLE_PREDICT_MISS,
+#endif
+	MSM_PM_STAT_IDLE_QOS_LIMITED,
 	MSM_PM_STAT_COUNT
 };
 
@@ -710,6 +717,17 @@ static struct msm_pm_time_stats {
 	[MSM_PM_STAT_NOT_IDLE].name = "not-idle",
 	[MSM_PM_STAT_NOT_IDLE].first_bucket_time =
 		CONFIG_MSM_IDLE_STATS_FIRST_BUCKET,
+
+#ifdef CONFIG_MSM_IDLE_PREDICT
+	[MSM_PM_STAT_IDLE_PREDICT_MISS].name = "idle-predict-miss",
+	[MSM_PM_STAT_IDLE_PREDICT_MISS].first_bucket_time =
+		CONFIG_MSM_IDLE_STATS_FIRST_BUCKET,
+#endif
+
+	/* Requested idle time of idles where PM QoS ruled out a mode */
+	[MSM_PM_STAT_IDLE_QOS_LIMITED].name = "idle-qos-limited",
+	[MSM_PM_STAT_IDLE_QOS_LIMITED].first_bucket_time =
+		CONFIG_MSM_IDLE_STATS_FIRST_BUCKET,
 };
 
 static uint32_t msm_pm_sleep_limit = SLEEP_LIMIT_NONE;
@@ -892,6 +910,191 @@ write_proc_failed:
 #endif /* CONFIG_MSM_IDLE_STATS */
 
 
+/******************************************************************************
+ * CONFIG_MSM_IDLE_PREDICT
+ *****************************************************************************/
+
+#ifdef CONFIG_MSM_IDLE_PREDICT
+/*
+ * The next timer only bounds the idle period, interrupts (WLAN, touch) end
+ * many of them much earlier. Like the menu cpuidle governor, scale the time
+ * to the next timer by a correction factor learnt from the actual idle
+ * periods, per order of magnitude of that time, and trust the average of
+ * the last idle periods instead when they repeat closely.
+ */
+#define MSM_PM_PREDICT_BUCKETS		6
+#define MSM_PM_PREDICT_INTERVALS	8
+#define MSM_PM_PREDICT_RESOLUTION	1024
+#define MSM_PM_PREDICT_DECAY		8
+#define MSM_PM_PREDICT_UNITY \
+	(MSM_PM_PREDICT_RESOLUTION * MSM_PM_PREDICT_DECAY)
+/* Longer waits are as good as infinite, keeps the arithmetic in range */
+#define MSM_PM_PREDICT_MAX_NS		(100LL * NSEC_PER_SEC)
+
+static int msm_pm_idle_predict = 1;
+module_param_named(
+	idle_predict, msm_pm_idle_predict, int, S_IRUGO | S_IWUSR | S_IWGRP
+);
+
+static struct msm_pm_predictor {
+	unsigned int correction[MSM_PM_PREDICT_BUCKETS];
+	uint32_t intervals_us[MSM_PM_PREDICT_INTERVALS];
+	int interval_ptr;
+	int bucket;
+	int64_t expected;
+	int64_t predicted;
+} msm_pm_predictor = {
+	.correction = {
+		[0 ... MSM_PM_PREDICT_BUCKETS - 1] = MSM_PM_PREDICT_UNITY,
+	},
+};
+
+/* One per sleep mode, the last one counts the idle spins */
+static struct msm_pm_predict_stats {
+	unsigned int entries;
+	unsigned int misses;
+	int64_t total_time;
+} msm_pm_predict_stats[MSM_PM_SLEEP_MODE_NR + 1];
+
+static int msm_pm_predict_bucket(int64_t expected)
+{
+	int64_t limit = NSEC_PER_MSEC;
+	int bucket = 0;
+
+	while (bucket < MSM_PM_PREDICT_BUCKETS - 1 && expected >= limit) {
+		limit *= 10;
+		bucket++;
+	}
+	return bucket;
+}
+
+/*
+ * Return the expected idle time in nanoseconds, given the time to the next
+ * timer.
+ */
+static int64_t msm_pm_predict_idle(int64_t timer_expiration)
+{
+	struct msm_pm_predictor *p = &msm_pm_predictor;
+	uint64_t avg = 0, variance = 0;
+	int64_t predicted;
+	int i;
+
+	if (timer_expiration > MSM_PM_PREDICT_MAX_NS)
+		timer_expiration = MSM_PM_PREDICT_MAX_NS;
+
+	p->expected = timer_expiration;
+	p->bucket = msm_pm_predict_bucket(timer_expiration);
+	predicted = div_s64(timer_expiration * p->correction[p->bucket],
+			    MSM_PM_PREDICT_UNITY);
+
+	/* Repeating pattern: the last idle periods are close together */
+	for (i = 0; i < MSM_PM_PREDICT_INTERVALS; i++)
+		avg += p->intervals_us[i];
+	avg /= MSM_PM_PREDICT_INTERVALS;
+
+	for (i = 0; i < MSM_PM_PREDICT_INTERVALS; i++) {
+		int64_t d = (int64_t)p->intervals_us[i] - (int64_t)avg;
+		variance += d * d;
+	}
+	variance /= MSM_PM_PREDICT_INTERVALS;
+
+	/* Standard deviation below a sixth of the average, or below 20us */
+	if (avg && (avg * avg > 36 * variance || variance <= 400)
+	    && avg * NSEC_PER_USEC < predicted)
+		predicted = avg * NSEC_PER_USEC;
+
+	p->predicted = predicted;
+	return predicted;
+}
+
+/*
+ * Learn from the idle period that just ended in sleep mode 'mode'
+ * (MSM_PM_SLEEP_MODE_NR for a spin).
+ */
+static void msm_pm_predict_update(int mode, int64_t actual)
+{
+	struct msm_pm_predictor *p = &msm_pm_predictor;
+	struct msm_pm_predict_stats *st = &msm_pm_predict_stats[mode];
+	int64_t measured = actual;
+	unsigned int factor;
+
+	if (measured > p->expected)
+		measured = p->expected;
+	if (measured < 0)
+		measured = 0;
+
+	factor = p->correction[p->bucket];
+	factor -= factor / MSM_PM_PREDICT_DECAY;
+	if (p->expected > 0)
+		factor += div64_u64((uint64_t)measured *
+				    MSM_PM_PREDICT_RESOLUTION, p->expected);
+	else
+		factor += MSM_PM_PREDICT_RESOLUTION;
+	if (factor == 0)
+		factor = 1;
+	p->correction[p->bucket] = factor;
+
+	p->intervals_us[p->interval_ptr] = (uint32_t)div_s64(
+		min_t(int64_t, actual, MSM_PM_PREDICT_MAX_NS), NSEC_PER_USEC);
+	p->interval_ptr = (p->interval_ptr + 1) % MSM_PM_PREDICT_INTERVALS;
+
+	st->entries++;
+	st->total_time += actual;
+
+	/* Woke up before the mode paid back its entry and exit latency */
+	if (mode < MSM_PM_SLEEP_MODE_NR && msm_pm_modes[mode].residency &&
+	    actual < msm_pm_modes[mode].residency * 1000LL) {
+		st->misses++;
+#ifdef CONFIG_MSM_IDLE_STATS
+		msm_pm_add_stat(MSM_PM_STAT_IDLE_PREDICT_MISS, actual);
+#endif
+	}
+}
+
+/*
+ * Write out the correction factors and, per sleep mode, the idle periods
+ * and the misses.
+ */
+static int msm_pm_predict_read_proc
+	(char *page, char **start, off_t off, int count, int *eof, void *data)
+{
+	struct msm_pm_predictor *p = &msm_pm_predictor;
+	char *out = page;
+	int i;
+
+	if (off) {
+		*eof = 1;
+		return 0;
+	}
+
+	out += sprintf(out, "correction (%%):");
+	for (i = 0; i < MSM_PM_PREDICT_BUCKETS; i++)
+		out += sprintf(out, " %u", p->correction[i] * 100 /
+			       MSM_PM_PREDICT_UNITY);
+	out += sprintf(out, "\nlast expected: %lld predicted: %lld\n\n",
+		       p->expected, p->predicted);
+
+	out += sprintf(out, "%-36s %8s %8s %12s\n",
+		       "mode", "entries", "misses", "avg_us");
+	for (i = 0; i <= MSM_PM_SLEEP_MODE_NR; i++) {
+		struct msm_pm_predict_stats *st = &msm_pm_predict_stats[i];
+		int64_t avg = 0;
+
+		if (st->entries)
+			avg = div_s64(div_s64(st->total_time, st->entries),
+				      NSEC_PER_USEC);
+		out += sprintf(out, "%-36s %8u %8u %12lld\n",
+			       i < MSM_PM_SLEEP_MODE_NR ?
+			       msm_pm_sleep_mode_labels[i] : "spin",
+			       st->entries, st->misses, avg);
+	}
+
+	*eof = 1;
+	return out - page;
+}
+#endif /* CONFIG_MSM_IDLE_PREDICT */
+
+
 /******************************************************************************
  * Shared Memory Bits
  *****************************************************************************/
@@ -1161,6 +1364,8 @@ static int msm_pm_power_collapse
 		saved_vector[0], saved_vector[1],
 		msm_pm_reset_vector[0], msm_pm_reset_vector[1]);
 
+	armpmu_suspend();
+
 #ifdef CONFIG_VFP
 	if (from_idle)
 		vfp_flush_context();
@@ -1187,6 +1392,7 @@ static int msm_pm_power_collapse
 		cpu_init();
 		local_fiq_enable();
 	}
+	armpmu_resume();
 
 	MSM_PM_DPRINTK(MSM_PM_DEBUG_SUSPEND | MSM_PM_DEBUG_POWER_COLLAPSE,
 		KERN_INFO,
@@ -1381,6 +1587,8 @@ static int msm_pm_power_collapse_standalone(void)
 		saved_vector[0], saved_vector[1],
 		msm_pm_reset_vector[0], msm_pm_reset_vector[1]);
 
+	armpmu_suspend();
+
 #ifdef CONFIG_VFP
 	vfp_flush_context();
 #endif
@@ -1405,6 +1613,7 @@ static int msm_pm_power_collapse_standalone(void)
 		cpu_init();
 		local_fiq_enable();
 	}
+	armpmu_resume();
 
 	MSM_PM_DPRINTK(MSM_PM_DEBUG_SUSPEND | MSM_PM_DEBUG_POWER_COLLAPSE,
 		KERN_INFO,
@@ -1480,7 +1689,10 @@ void arch_idle(void)
 	uint32_t sleep_limit = SLEEP_LIMIT_NONE;
 
 	int latency_qos;
+	bool qos_limited = false;
 	int64_t timer_expiration;
+	int64_t sleep_estimate;
+	int idle_mode = MSM_PM_SLEEP_MODE_NR;
 
 	int low_power;
 	int ret;
@@ -1492,12 +1704,22 @@ void arch_idle(void)
 	static int64_t t2;
 	int exit_stat;
 #endif /* CONFIG_MSM_IDLE_STATS */
+#ifdef CONFIG_MSM_IDLE_PREDICT
+	ktime_t idle_entry;
+#endif
 
 	if (!atomic_read(&msm_pm_init_done))
 		return;
 
 	latency_qos = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
 	timer_expiration = msm_timer_enter_idle();
+	sleep_estimate = timer_expiration;
+
+#ifdef CONFIG_MSM_IDLE_PREDICT
+	idle_entry = ktime_get();
+	if (msm_pm_idle_predict)
+		sleep_estimate = msm_pm_predict_idle(timer_expiration);
+#endif
 
 #ifdef CONFIG_MSM_IDLE_STATS
 	t1 = ktime_to_ns(ktime_get());
@@ -1536,7 +1758,7 @@ void arch_idle(void)
 		goto arch_idle_exit;
 	}
 
-	if ((timer_expiration < msm_pm_idle_sleep_min_time) ||
+	if ((sleep_estimate < msm_pm_idle_sleep_min_time) ||
 #ifdef CONFIG_HAS_WAKELOCK
 		has_wake_lock(WAKE_LOCK_IDLE) ||
 #endif
@@ -1549,11 +1771,19 @@ void arch_idle(void)
 	for (i = 0; i < ARRAY_SIZE(allow); i++) {
 		struct msm_pm_platform_data *mode = &msm_pm_modes[i];
 		if (!mode->supported || !mode->idle_enabled ||
-			mode->latency >= latency_qos ||
-			mode->residency * 1000ULL >= timer_expiration)
+			mode->residency * 1000LL >= sleep_estimate)
+			allow[i] = false;
+		else if (allow[i] && mode->latency >= latency_qos) {
 			allow[i] = false;
+			qos_limited = true;
+		}
 	}
 
+#ifdef CONFIG_MSM_IDLE_STATS
+	if (qos_limited)
+		msm_pm_add_stat(MSM_PM_STAT_IDLE_QOS_LIMITED, sleep_estimate);
+#endif
+
 	if (allow[MSM_PM_SLEEP_MODE_POWER_COLLAPSE] ||
 		allow[MSM_PM_SLEEP_MODE_POWER_COLLAPSE_NO_XO_SHUTDOWN]) {
 		uint32_t wait_us = CONFIG_MSM_IDLE_WAIT_ON_MODEM;
@@ -1612,6 +1842,9 @@ void arch_idle(void)
 		sleep_limit |= SLEEP_RESOURCE_MEMORY_BIT0;
 #endif
 
+		idle_mode = allow[MSM_PM_SLEEP_MODE_POWER_COLLAPSE] ?
+			MSM_PM_SLEEP_MODE_POWER_COLLAPSE :
+			MSM_PM_SLEEP_MODE_POWER_COLLAPSE_NO_XO_SHUTDOWN;
 		ret = msm_pm_power_collapse(true, sleep_delay, sleep_limit);
 		low_power = (ret != -EBUSY && ret != -ETIMEDOUT);
 
@@ -1633,6 +1866,7 @@ void arch_idle(void)
 		if (sleep_delay == 0) /* 0 would mean infinite time */
 			sleep_delay = 1;
 
+		idle_mode = MSM_PM_SLEEP_MODE_APPS_SLEEP;
 		ret = msm_pm_apps_sleep(sleep_delay, sleep_limit);
 		low_power = 0;
 
@@ -1643,6 +1877,7 @@ void arch_idle(void)
 			exit_stat = MSM_PM_STAT_IDLE_SLEEP;
 #endif /* CONFIG_MSM_IDLE_STATS */
 	} else if (allow[MSM_PM_SLEEP_MODE_POWER_COLLAPSE_STANDALONE]) {
+		idle_mode = MSM_PM_SLEEP_MODE_POWER_COLLAPSE_STANDALONE;
 		ret = msm_pm_power_collapse_standalone();
 		low_power = 0;
 #ifdef CONFIG_MSM_IDLE_STATS
@@ -1651,6 +1886,7 @@ void arch_idle(void)
 			MSM_PM_STAT_IDLE_STANDALONE_POWER_COLLAPSE;
 #endif /* CONFIG_MSM_IDLE_STATS */
 	} else if (allow[MSM_PM_SLEEP_MODE_RAMP_DOWN_AND_WAIT_FOR_INTERRUPT]) {
+		idle_mode = MSM_PM_SLEEP_MODE_RAMP_DOWN_AND_WAIT_FOR_INTERRUPT;
 		ret = msm_pm_swfi(true);
 		if (ret)
 			while (!msm_irq_pending())
@@ -1660,6 +1896,7 @@ void arch_idle(void)
 		exit_stat = ret ? MSM_PM_STAT_IDLE_SPIN : MSM_PM_STAT_IDLE_WFI;
 #endif /* CONFIG_MSM_IDLE_STATS */
 	} else if (allow[MSM_PM_SLEEP_MODE_WAIT_FOR_INTERRUPT]) {
+		idle_mode = MSM_PM_SLEEP_MODE_WAIT_FOR_INTERRUPT;
 		msm_pm_swfi(false);
 		low_power = 0;
 #ifdef CONFIG_MSM_IDLE_STATS
@@ -1677,6 +1914,12 @@ void arch_idle(void)
 arch_idle_exit:
 	msm_timer_exit_idle(low_power);
 
+#ifdef CONFIG_MSM_IDLE_PREDICT
+	if (msm_pm_idle_predict)
+		msm_pm_predict_update(idle_mode,
+			ktime_to_ns(ktime_sub(ktime_get(), idle_entry)));
+#endif
+
 #ifdef CONFIG_MSM_IDLE_STATS
 	t2 = ktime_to_ns(ktime_get());
 	msm_pm_add_stat(exit_stat, t2 - t1);
@@ -2068,7 +2311,7 @@ static int zte_alarm_write_proc(struct file *file, const char __user *buffer,
  */
 static int __init msm_pm_init(void)
 {
-#ifdef CONFIG_MSM_IDLE_STATS
+#if defined(CONFIG_MSM_IDLE_STATS) || defined(CONFIG_MSM_IDLE_PREDICT)
 	struct proc_dir_entry *d_entry;
 #endif
 	int ret;
@@ -2151,6 +2394,13 @@ static int __init msm_pm_init(void)
 		d_entry->data = NULL;
 	}
 #endif
+#ifdef CONFIG_MSM_IDLE_PREDICT
+	d_entry = create_proc_entry("msm_pm_idle_predict", S_IRUGO, NULL);
+	if (d_entry) {
+		d_entry->read_proc = msm_pm_predict_read_proc;
+		d_entry->data = NULL;
+	}
+#endif
 #ifdef CONFIG_MSM_GPIO_WAKE
 	{
 		struct gpio_stat *new_gpio_stat;
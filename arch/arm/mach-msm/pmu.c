@@ -20,9 +20,15 @@
 #include <asm/pmu.h>
 #include <mach/irqs.h>
 
+#ifdef CONFIG_ARCH_MSM_ARM11
+#define MSM_PMU_IRQ	INT_ARM11_PMU
+#else
+#define MSM_PMU_IRQ	INT_ARMQC_PERFMON
+#endif
+
 static struct resource pmu_resource = {
-	.start = INT_ARMQC_PERFMON,
-	.end = INT_ARMQC_PERFMON,
+	.start = MSM_PMU_IRQ,
+	.end = MSM_PMU_IRQ,
 	.flags	= IORESOURCE_IRQ,
 };
 
@@ -33,11 +39,11 @@ static struct platform_device pmu_device = {
 	.num_resources	= 1,
 };
 
-static int __init scorpion_pmu_init(void)
+static int __init msm_pmu_init(void)
 {
 	platform_device_register(&pmu_device);
-	printk(KERN_INFO "Scorpion registered PMU device\n");
+	printk(KERN_INFO "MSM registered PMU device, irq %d\n", MSM_PMU_IRQ);
 	return 0;
 }
 
-arch_initcall(scorpion_pmu_init);
+arch_initcall(msm_pmu_init);
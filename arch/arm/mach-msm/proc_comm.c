@@ -15,11 +15,15 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/errno.h>
 #include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/spinlock.h>
 #include <linux/module.h>
+#include <linux/seq_file.h>
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
 
@@ -95,17 +99,61 @@ again:
 }
 EXPORT_SYMBOL(msm_proc_comm_reset_modem_now);
 
-int msm_proc_comm(unsigned cmd, unsigned *data1, unsigned *data2)
+#ifdef CONFIG_DEBUG_FS
+/* The last slot counts the OEM commands */
+#define PCOM_STATS_NR	(PCOM_NPA_ISSUE_REQUIRED_REQUEST + 2)
+
+/* Time spent waiting on the modem, per command, under proc_comm_lock */
+static struct proc_comm_stats {
+	unsigned calls;
+	unsigned restarts;
+	u64 spin_ns;
+	u64 max_ns;
+} proc_comm_stats[PCOM_STATS_NR];
+
+static unsigned proc_comm_batches;
+static unsigned proc_comm_batch_cmds;
+
+static inline ktime_t proc_comm_now(void)
+{
+	return ktime_get();
+}
+
+static void proc_comm_account(unsigned cmd, ktime_t start, unsigned restarts)
+{
+	struct proc_comm_stats *st =
+		&proc_comm_stats[min_t(unsigned, cmd, PCOM_STATS_NR - 1)];
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	st->calls++;
+	st->restarts += restarts;
+	st->spin_ns += ns;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+}
+#else
+static inline ktime_t proc_comm_now(void)
+{
+	return ktime_set(0, 0);
+}
+
+static inline void proc_comm_account(unsigned cmd, ktime_t start,
+				     unsigned restarts) { }
+#endif
+
+/* Run one command, with proc_comm_lock held */
+static int proc_comm_cmd_locked(unsigned cmd, unsigned *data1, unsigned *data2)
 {
 	unsigned base = (unsigned)MSM_SHARED_RAM_BASE;
-	unsigned long flags;
+	ktime_t start = proc_comm_now();
+	unsigned restarts = 0;
 	int ret;
 
-	spin_lock_irqsave(&proc_comm_lock, flags);
-
 again:
-	if (proc_comm_wait_for(base + MDM_STATUS, PCOM_READY))
+	if (proc_comm_wait_for(base + MDM_STATUS, PCOM_READY)) {
+		restarts++;
 		goto again;
+	}
 
 	writel(cmd, base + APP_COMMAND);
 	writel(data1 ? *data1 : 0, base + APP_DATA1);
@@ -113,8 +161,10 @@ again:
 
 	notify_other_proc_comm();
 
-	if (proc_comm_wait_for(base + APP_COMMAND, PCOM_CMD_DONE))
+	if (proc_comm_wait_for(base + APP_COMMAND, PCOM_CMD_DONE)) {
+		restarts++;
 		goto again;
+	}
 
 	if (readl(base + APP_STATUS) == PCOM_CMD_SUCCESS) {
 		if (data1)
@@ -128,7 +178,111 @@ again:
 
 	writel(PCOM_CMD_IDLE, base + APP_COMMAND);
 
+	proc_comm_account(cmd, start, restarts);
+	return ret;
+}
+
+int msm_proc_comm(unsigned cmd, unsigned *data1, unsigned *data2)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&proc_comm_lock, flags);
+	ret = proc_comm_cmd_locked(cmd, data1, data2);
 	spin_unlock_irqrestore(&proc_comm_lock, flags);
 	return ret;
 }
 EXPORT_SYMBOL(msm_proc_comm);
+
+/*
+ * Run a sequence of commands under a single hold of the lock, so nothing
+ * else gets in between. The modem has a single command slot, so they
+ * still go one after the other. data1 and data2 of each command are
+ * updated like msm_proc_comm() does. Interrupts are off for the whole
+ * sequence, keep it short.
+ *
+ * Stops at the first command that fails, returns the number of commands
+ * that succeeded.
+ */
+int msm_proc_comm_batch(struct msm_proc_comm_cmd *cmds, int n)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&proc_comm_lock, flags);
+	for (i = 0; i < n; i++)
+		if (proc_comm_cmd_locked(cmds[i].cmd, &cmds[i].data1,
+					 &cmds[i].data2))
+			break;
+#ifdef CONFIG_DEBUG_FS
+	proc_comm_batches++;
+	proc_comm_batch_cmds += n;
+#endif
+	spin_unlock_irqrestore(&proc_comm_lock, flags);
+	return i;
+}
+EXPORT_SYMBOL(msm_proc_comm_batch);
+
+#ifdef CONFIG_DEBUG_FS
+static int proc_comm_stats_show(struct seq_file *m, void *unused)
+{
+	struct proc_comm_stats *st, snap;
+	unsigned long flags;
+	int i;
+
+	seq_printf(m, "batches: %u commands: %u\n\n", proc_comm_batches,
+		   proc_comm_batch_cmds);
+	seq_printf(m, "%-6s %10s %10s %12s %10s\n", "cmd", "calls",
+		   "restarts", "avg_ns", "max_ns");
+	for (i = 0; i < PCOM_STATS_NR; i++) {
+		st = &proc_comm_stats[i];
+		spin_lock_irqsave(&proc_comm_lock, flags);
+		snap = *st;
+		spin_unlock_irqrestore(&proc_comm_lock, flags);
+		if (!snap.calls)
+			continue;
+		do_div(snap.spin_ns, snap.calls);
+		if (i < PCOM_STATS_NR - 1)
+			seq_printf(m, "%-6d", i);
+		else
+			seq_printf(m, "%-6s", "oem");
+		seq_printf(m, " %10u %10u %12llu %10llu\n", snap.calls,
+			   snap.restarts, snap.spin_ns, snap.max_ns);
+	}
+	return 0;
+}
+
+static int proc_comm_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proc_comm_stats_show, NULL);
+}
+
+static ssize_t proc_comm_stats_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&proc_comm_lock, flags);
+	memset(proc_comm_stats, 0, sizeof(proc_comm_stats));
+	proc_comm_batches = 0;
+	proc_comm_batch_cmds = 0;
+	spin_unlock_irqrestore(&proc_comm_lock, flags);
+	return count;
+}
+
+static const struct file_operations proc_comm_stats_fops = {
+	.open = proc_comm_stats_open,
+	.read = seq_read,
+	.write = proc_comm_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init proc_comm_debugfs_init(void)
+{
+	debugfs_create_file("proc_comm_stats", S_IRUGO | S_IWUSR, NULL, NULL,
+			    &proc_comm_stats_fops);
+	return 0;
+}
+late_initcall(proc_comm_debugfs_init);
+#endif
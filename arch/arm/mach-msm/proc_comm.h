@@ -196,13 +196,22 @@ enum {
 		(((dir) & 0x1) << 14)		| \
 		(((pull) & 0x3) << 15)		| \
 		(((drvstr) & 0xF) << 17))
+struct msm_proc_comm_cmd {
+	unsigned cmd;
+	unsigned data1;
+	unsigned data2;
+};
+
 #ifdef CONFIG_MSM_PROC_COMM
 void msm_proc_comm_reset_modem_now(void);
 int msm_proc_comm(unsigned cmd, unsigned *data1, unsigned *data2);
+int msm_proc_comm_batch(struct msm_proc_comm_cmd *cmds, int n);
 #else
 static inline void msm_proc_comm_reset_modem_now(void) { }
 static inline int msm_proc_comm(unsigned cmd, unsigned *data1, unsigned *data2)
 { return 0; }
+static inline int msm_proc_comm_batch(struct msm_proc_comm_cmd *cmds, int n)
+{ return n; }
 #endif
 
 #endif
@@ -31,6 +31,7 @@ when       who       what, where, why
 ===========================================================================*/
 
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
@@ -581,6 +582,8 @@ int msm_adsp_write(struct msm_adsp_module *module, unsigned dsp_queue_addr,
 		if (rc == -EAGAIN)
 			udelay(10);
 	} while (rc == -EAGAIN && retries++ < 300);
+	if (retries)
+		module->num_write_retries += retries;
 	if (retries > 50)
 		MM_ERR("adsp: %s command took %d attempts: rc %d\n",
 			module->name, retries, rc);
@@ -1137,6 +1140,52 @@ int msm_adsp_disable(struct msm_adsp_module *module)
 }
 EXPORT_SYMBOL(msm_adsp_disable);
 
+#ifdef CONFIG_DEBUG_FS
+static int adsp_debug_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+/* Counters since boot; sample twice to get command and event rates */
+static ssize_t adsp_debug_read(struct file *file, char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	const int debug_bufmax = PAGE_SIZE;
+	char *buffer;
+	int n, i;
+	ssize_t rc;
+
+	buffer = kmalloc(debug_bufmax, GFP_KERNEL);
+	if (!buffer)
+		return -ENOMEM;
+
+	n = scnprintf(buffer, debug_bufmax,
+		      "events %u\nevent_backlog_max %u\n",
+		      adsp_info.events_received, adsp_info.event_backlog_max);
+	n += scnprintf(buffer + n, debug_bufmax - n,
+		       "%-20s %5s %10s %10s %10s\n", "module", "state",
+		       "commands", "events", "retries");
+	for (i = 0; i < adsp_info.module_count; i++) {
+		struct msm_adsp_module *mod = adsp_modules + i;
+
+		n += scnprintf(buffer + n, debug_bufmax - n,
+			       "%-20s %5u %10u %10u %10u\n", mod->name,
+			       mod->state, mod->num_commands, mod->num_events,
+			       mod->num_write_retries);
+	}
+
+	rc = simple_read_from_buffer(buf, count, ppos, buffer, n);
+	kfree(buffer);
+	return rc;
+}
+
+static const struct file_operations adsp_debug_fops = {
+	.read = adsp_debug_read,
+	.open = adsp_debug_open,
+};
+#endif
+
 static int msm_adsp_probe(struct platform_device *pdev)
 {
 	unsigned count;
@@ -1220,6 +1269,11 @@ static int msm_adsp_probe(struct platform_device *pdev)
 
 	msm_adsp_publish_cdevs(adsp_modules, count);
 
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("adsp_stats", S_IFREG | S_IRUGO, NULL, NULL,
+			    &adsp_debug_fops);
+#endif
+
 	return 0;
 
 fail_rpc_register:
@@ -1268,4 +1322,4 @@ static int __init adsp_init(void)
 	return rc;
 }
 
-device_initcall(adsp_init);
+parallel_initcall(adsp_init);
@@ -264,6 +264,8 @@ struct msm_adsp_module {
 	/* statistics */
 	unsigned num_commands;
 	unsigned num_events;
+	/* writes retried because the DSP queue was busy */
+	unsigned num_write_retries;
 
 	wait_queue_head_t state_wait;
 	unsigned state;
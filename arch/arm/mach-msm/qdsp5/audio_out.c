@@ -22,6 +22,7 @@
 #include <linux/uaccess.h>
 #include <linux/kthread.h>
 #include <linux/wait.h>
+#include <linux/poll.h>
 #include <linux/dma-mapping.h>
 #include <linux/debugfs.h>
 #include <linux/delay.h>
@@ -94,6 +95,8 @@ module_init(_pcm_log_init);
 
 #define BUFSZ (960 * 5)
 #define DMASZ (BUFSZ * 2)
+/* Smallest buffer AUDIO_SET_CONFIG accepts, 5.4ms of 44.1kHz stereo */
+#define MIN_BUFSZ 960
 
 #define COMMON_OBJ_ID 6
 
@@ -547,6 +550,25 @@ static long audio_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			rc = -EINVAL;
 			break;
 		}
+		/* Smaller buffers give lower latency but more DSP
+		 * interrupts. They can only change while stopped.
+		 */
+		if (config.buffer_size &&
+		    config.buffer_size != audio->out_buffer_size) {
+			if (config.buffer_size < MIN_BUFSZ ||
+			    config.buffer_size > BUFSZ ||
+			    (config.buffer_size & 3)) {
+				rc = -EINVAL;
+				break;
+			}
+			if (audio->enabled) {
+				rc = -EBUSY;
+				break;
+			}
+			audio->out_buffer_size = config.buffer_size;
+			audio->out[0].size = config.buffer_size;
+			audio->out[1].size = config.buffer_size;
+		}
 		audio->out_sample_rate = config.sample_rate;
 		audio->out_channel_mode = config.channel_count;
 		rc = 0;
@@ -554,7 +576,7 @@ static long audio_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	}
 	case AUDIO_GET_CONFIG: {
 		struct msm_audio_config config;
-		config.buffer_size = BUFSZ;
+		config.buffer_size = audio->out_buffer_size;
 		config.buffer_count = 2;
 		config.sample_rate = audio->out_sample_rate;
 		if (audio->out_channel_mode == AUDPP_CMD_PCM_INTF_MONO_V) {
@@ -657,6 +679,12 @@ static ssize_t audio_write(struct file *file, const char __user *buf,
 	while (count > 0) {
 		frame = audio->out + audio->out_head;
 
+		if ((file->f_flags & O_NONBLOCK) && frame->used &&
+		    !audio->stopped) {
+			rc = -EAGAIN;
+			break;
+		}
+
 		LOG(EV_WAIT_EVENT, 0);
 		rc = wait_event_interruptible(audio->wait,
 					      (frame->used == 0) || (audio->stopped));
@@ -709,6 +737,20 @@ static ssize_t audio_write(struct file *file, const char __user *buf,
 	return rc;	
 }
 
+/* Writable once the DSP has given back the buffer the next write fills */
+static unsigned int audio_poll(struct file *file,
+			       struct poll_table_struct *wait)
+{
+	struct audio *audio = file->private_data;
+
+	poll_wait(file, &audio->wait, wait);
+	if (audio->stopped)
+		return POLLERR;
+	if (audio->out[audio->out_head].used == 0)
+		return POLLOUT | POLLWRNORM;
+	return 0;
+}
+
 static int audio_release(struct inode *inode, struct file *file)
 {
 	struct audio *audio = file->private_data;
@@ -982,6 +1024,7 @@ static struct file_operations audio_fops = {
 	.release	= audio_release,
 	.read		= audio_read,
 	.write		= audio_write,
+	.poll		= audio_poll,
 	.unlocked_ioctl	= audio_ioctl,
 	.fsync		= audio_fsync,
 };
@@ -121,14 +121,28 @@ static struct dentry *stats_dentry;
 #define RMT_STORAGE_EVENT_CB_TYPE_PROC          3
 #define RMT_STORAGE_READ_IOVEC_CB_TYPE_PROC     4
 
+static const struct xdr_field rmt_storage_send_sts_fields[] = {
+	XDR_FIELD(struct rmt_storage_send_sts, handle),
+	XDR_FIELD(struct rmt_storage_send_sts, err_code),
+	XDR_FIELD(struct rmt_storage_send_sts, data),
+};
+
+static const struct xdr_desc rmt_storage_send_sts_desc =
+	XDR_DESC(rmt_storage_send_sts_fields);
+
+static const struct xdr_field rmt_storage_iovec_fields[] = {
+	XDR_FIELD(struct rmt_storage_iovec_desc, sector_addr),
+	XDR_FIELD(struct rmt_storage_iovec_desc, data_phy_addr),
+	XDR_FIELD(struct rmt_storage_iovec_desc, num_sector),
+};
+
+static const struct xdr_desc rmt_storage_iovec_desc =
+	XDR_DESC(rmt_storage_iovec_fields);
+
 static int rmt_storage_send_sts_arg(struct msm_rpc_client *client,
 				struct msm_rpc_xdr *xdr, void *data)
 {
-	struct rmt_storage_send_sts *args = data;
-
-	xdr_send_uint32(xdr, &args->handle);
-	xdr_send_uint32(xdr, &args->err_code);
-	xdr_send_uint32(xdr, &args->data);
+	xdr_send_struct(xdr, &rmt_storage_send_sts_desc, data);
 	return 0;
 }
 
@@ -439,9 +453,8 @@ static int rmt_storage_event_write_iovec_cb(
 #endif
 	for (i = 0; i < ent; i++) {
 		xfer = &event_args->xfer_desc[i];
-		xdr_recv_uint32(xdr, &xfer->sector_addr);
-		xdr_recv_uint32(xdr, &xfer->data_phy_addr);
-		xdr_recv_uint32(xdr, &xfer->num_sector);
+		if (xdr_recv_struct(xdr, &rmt_storage_iovec_desc, xfer))
+			return -1;
 
 		if (xfer->data_phy_addr < _rmc->rmt_shrd_mem.start ||
 		   xfer->data_phy_addr > (_rmc->rmt_shrd_mem.start +
@@ -486,9 +499,8 @@ static int rmt_storage_event_read_iovec_cb(
 #endif
 	for (i = 0; i < ent; i++) {
 		xfer = &event_args->xfer_desc[i];
-		xdr_recv_uint32(xdr, &xfer->sector_addr);
-		xdr_recv_uint32(xdr, &xfer->data_phy_addr);
-		xdr_recv_uint32(xdr, &xfer->num_sector);
+		if (xdr_recv_struct(xdr, &rmt_storage_iovec_desc, xfer))
+			return -EINVAL;
 
 		if (xfer->data_phy_addr < _rmc->rmt_shrd_mem.start ||
 		   xfer->data_phy_addr > (_rmc->rmt_shrd_mem.start +
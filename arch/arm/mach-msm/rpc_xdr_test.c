@@ -0,0 +1,286 @@
+/* Copyright (c) 2010, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/*
+ * RPC XDR TEST Driver source file
+ *
+ * Times encoding and decoding a fixed layout structure field by field
+ * against xdr_send_struct()/xdr_recv_struct(). Write "bench" to
+ * /sys/kernel/debug/rpc_xdr_test, then read it for the cost per call.
+ */
+
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/debugfs.h>
+#include <linux/module.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+
+#include <mach/msm_rpcrouter.h>
+
+#define XDR_TEST_LOOPS 10000
+
+struct xdr_test_args {
+	uint32_t handle;
+	uint32_t client_id;
+	int32_t level;
+	uint16_t type;
+	uint8_t vote;
+	int8_t delta;
+	uint32_t flags;
+	uint32_t cookie;
+};
+
+static const struct xdr_field xdr_test_fields[] = {
+	XDR_FIELD(struct xdr_test_args, handle),
+	XDR_FIELD(struct xdr_test_args, client_id),
+	XDR_FIELD(struct xdr_test_args, level),
+	XDR_FIELD(struct xdr_test_args, type),
+	XDR_FIELD(struct xdr_test_args, vote),
+	XDR_FIELD(struct xdr_test_args, delta),
+	XDR_FIELD(struct xdr_test_args, flags),
+	XDR_FIELD(struct xdr_test_args, cookie),
+};
+
+static const struct xdr_desc xdr_test_desc = XDR_DESC(xdr_test_fields);
+
+static struct dentry *dent;
+static int xdr_test_res;
+static char xdr_test_buf[256];
+
+static uint32_t xdr_test_wire[ARRAY_SIZE(xdr_test_fields)];
+
+static void xdr_test_send_fields(struct msm_rpc_xdr *xdr,
+				 struct xdr_test_args *args)
+{
+	uint32_t v;
+
+	xdr_send_uint32(xdr, &args->handle);
+	xdr_send_uint32(xdr, &args->client_id);
+	xdr_send_int32(xdr, &args->level);
+	v = args->type;
+	xdr_send_uint32(xdr, &v);
+	v = args->vote;
+	xdr_send_uint32(xdr, &v);
+	v = args->delta;
+	xdr_send_uint32(xdr, &v);
+	xdr_send_uint32(xdr, &args->flags);
+	xdr_send_uint32(xdr, &args->cookie);
+}
+
+static void xdr_test_recv_fields(struct msm_rpc_xdr *xdr,
+				 struct xdr_test_args *args)
+{
+	uint32_t v;
+
+	xdr_recv_uint32(xdr, &args->handle);
+	xdr_recv_uint32(xdr, &args->client_id);
+	xdr_recv_int32(xdr, &args->level);
+	xdr_recv_uint32(xdr, &v);
+	args->type = v;
+	xdr_recv_uint32(xdr, &v);
+	args->vote = v;
+	xdr_recv_uint32(xdr, &v);
+	args->delta = v;
+	xdr_recv_uint32(xdr, &args->flags);
+	xdr_recv_uint32(xdr, &args->cookie);
+}
+
+static void xdr_test_reset(struct msm_rpc_xdr *xdr)
+{
+	xdr->out_buf = xdr_test_wire;
+	xdr->out_size = sizeof(xdr_test_wire);
+	xdr->out_index = 0;
+	xdr->in_buf = xdr_test_wire;
+	xdr->in_size = sizeof(xdr_test_wire);
+	xdr->in_index = 0;
+}
+
+/* ns per call for XDR_TEST_LOOPS runs of one encode or decode */
+static unsigned xdr_test_time(int fast, int send)
+{
+	struct msm_rpc_xdr xdr;
+	struct xdr_test_args args = {
+		.handle = 1, .client_id = 0x30000061, .level = -1200,
+		.type = 3, .vote = 1, .delta = -2, .flags = 0x80000001,
+		.cookie = 0xdeadbeef,
+	};
+	ktime_t start;
+	int i;
+
+	start = ktime_get();
+	for (i = 0; i < XDR_TEST_LOOPS; i++) {
+		xdr_test_reset(&xdr);
+		if (send && fast)
+			xdr_send_struct(&xdr, &xdr_test_desc, &args);
+		else if (send)
+			xdr_test_send_fields(&xdr, &args);
+		else if (fast)
+			xdr_recv_struct(&xdr, &xdr_test_desc, &args);
+		else
+			xdr_test_recv_fields(&xdr, &args);
+	}
+
+	return div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		       XDR_TEST_LOOPS);
+}
+
+static int xdr_test_check(void)
+{
+	struct msm_rpc_xdr xdr;
+	struct xdr_test_args in = {
+		.handle = 7, .client_id = 0x30000089, .level = -5,
+		.type = 0xfffe, .vote = 0xff, .delta = -128,
+		.flags = 0x12345678, .cookie = 0xcafef00d,
+	};
+	struct xdr_test_args out_fields, out_struct;
+	uint32_t wire[ARRAY_SIZE(xdr_test_fields)];
+
+	memset(&out_fields, 0, sizeof(out_fields));
+	memset(&out_struct, 0, sizeof(out_struct));
+
+	/* both encoders must produce the same bytes */
+	xdr_test_reset(&xdr);
+	xdr_test_send_fields(&xdr, &in);
+	memcpy(wire, xdr_test_wire, sizeof(wire));
+	xdr_test_reset(&xdr);
+	xdr_send_struct(&xdr, &xdr_test_desc, &in);
+	if (memcmp(wire, xdr_test_wire, sizeof(wire)))
+		return -1;
+
+	xdr_test_reset(&xdr);
+	xdr_test_recv_fields(&xdr, &out_fields);
+	xdr_test_reset(&xdr);
+	xdr_recv_struct(&xdr, &xdr_test_desc, &out_struct);
+	if (memcmp(&in, &out_fields, sizeof(in)) ||
+	    memcmp(&in, &out_struct, sizeof(in)))
+		return -1;
+
+	return 0;
+}
+
+static int xdr_test_bench(void)
+{
+	unsigned send_fields, send_struct, recv_fields, recv_struct;
+	int rc;
+
+	rc = xdr_test_check();
+	if (rc)
+		return rc;
+
+	send_fields = xdr_test_time(0, 1);
+	send_struct = xdr_test_time(1, 1);
+	recv_fields = xdr_test_time(0, 0);
+	recv_struct = xdr_test_time(1, 0);
+
+	snprintf(xdr_test_buf, sizeof(xdr_test_buf),
+		 "%u fields, ns per call\n"
+		 "encode: per field %u, struct %u\n"
+		 "decode: per field %u, struct %u\n",
+		 (unsigned) ARRAY_SIZE(xdr_test_fields),
+		 send_fields, send_struct, recv_fields, recv_struct);
+
+	return 0;
+}
+
+static ssize_t debug_read(struct file *fp, char __user *buf,
+			  size_t count, loff_t *pos)
+{
+	char _buf[16];
+
+	if (!xdr_test_res && xdr_test_buf[0])
+		return simple_read_from_buffer(buf, count, pos, xdr_test_buf,
+					       strlen(xdr_test_buf));
+
+	snprintf(_buf, sizeof(_buf), "%i\n", xdr_test_res);
+
+	return simple_read_from_buffer(buf, count, pos, _buf, strlen(_buf));
+}
+
+static ssize_t debug_write(struct file *fp, const char __user *buf,
+			   size_t count, loff_t *pos)
+{
+	unsigned char cmd[64];
+	int len;
+
+	if (count < 1)
+		return 0;
+
+	len = count > 63 ? 63 : count;
+
+	if (copy_from_user(cmd, buf, len))
+		return -EFAULT;
+
+	cmd[len] = 0;
+
+	if (cmd[len-1] == '\n') {
+		cmd[len-1] = 0;
+		len--;
+	}
+
+	xdr_test_buf[0] = 0;
+	if (!strncmp(cmd, "bench", 64))
+		xdr_test_res = xdr_test_bench();
+	else
+		xdr_test_res = -EINVAL;
+
+	if (xdr_test_res)
+		pr_err("rpc xdr test fail %d\n", xdr_test_res);
+	else
+		pr_info("rpc xdr test passed\n");
+
+	return count;
+}
+
+static int debug_open(struct inode *ip, struct file *fp)
+{
+	return 0;
+}
+
+static int debug_release(struct inode *ip, struct file *fp)
+{
+	return 0;
+}
+
+static const struct file_operations debug_ops = {
+	.owner = THIS_MODULE,
+	.open = debug_open,
+	.release = debug_release,
+	.read = debug_read,
+	.write = debug_write,
+};
+
+static void __exit rpc_xdr_test_mod_exit(void)
+{
+	debugfs_remove(dent);
+}
+
+static int __init rpc_xdr_test_mod_init(void)
+{
+	dent = debugfs_create_file("rpc_xdr_test", 0644, 0, NULL, &debug_ops);
+	xdr_test_res = -1;
+	return 0;
+}
+
+module_init(rpc_xdr_test_mod_init);
+module_exit(rpc_xdr_test_mod_exit);
+
+MODULE_DESCRIPTION("RPC XDR TEST Driver");
+MODULE_LICENSE("GPL v2");
@@ -35,6 +35,37 @@ struct rpcrouter_smd_xprt {
 
 static struct rpcrouter_smd_xprt smd_remote_xprt;
 
+/*
+ * The router writes each message as a header, then the pacmark and
+ * payload, with room for all of it checked beforehand. Reserve the
+ * whole message when the header comes in and copy the pieces straight
+ * into the fifo, so the remote end is only signalled once.
+ */
+static int rpcrouter_smd_write(smd_channel_t *ch, void *data, uint32_t len,
+			       uint32_t type)
+{
+	struct rr_header *hdr = data;
+	unsigned char *buf = data;
+	uint32_t done;
+	void *ptr;
+	int n;
+
+	if (type == HEADER && smd_write_start(ch, len + hdr->size))
+		return smd_write(ch, data, len);
+
+	for (done = 0; done < len; done += n) {
+		n = smd_write_buffer(ch, &ptr);
+		if (n <= 0)
+			return done ? done : smd_write(ch, data, len);
+		if (n > len - done)
+			n = len - done;
+		memcpy(ptr, buf + done, n);
+		smd_write_commit(ch, n);
+	}
+
+	return len;
+}
+
 static int rpcrouter_smd_remote_read_avail(void)
 {
 	return smd_read_avail(smd_remote_xprt.channel);
@@ -52,7 +83,7 @@ static int rpcrouter_smd_remote_write_avail(void)
 
 static int rpcrouter_smd_remote_write(void *data, uint32_t len, uint32_t type)
 {
-	return smd_write(smd_remote_xprt.channel, data, len);
+	return rpcrouter_smd_write(smd_remote_xprt.channel, data, len, type);
 }
 
 static int rpcrouter_smd_remote_close(void)
@@ -89,7 +120,7 @@ static int rpcrouter_smd_loopback_write_avail(void)
 
 static int rpcrouter_smd_loopback_write(void *data, uint32_t len, uint32 type)
 {
-	return smd_write(smd_loopback_xprt.channel, data, len);
+	return rpcrouter_smd_write(smd_loopback_xprt.channel, data, len, type);
 }
 
 static int rpcrouter_smd_loopback_close(void)
@@ -48,6 +48,7 @@
 #include <mach/sdio_al.h>
 
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/uaccess.h>
 
 #define MODULE_NAME "sdio_al"
@@ -138,6 +139,19 @@
 #define INACTIVITY_TIME_MSEC 100
 #define INITIAL_INACTIVITY_TIME_MSEC 5000
 
+/**
+ *  Adaptive polling: every mailbox read that finds nothing to do
+ *  doubles the poll delay, up to poll_max_msec. Any activity
+ *  drops it back to the shortest channel delay. The cap stays
+ *  below the inactivity time so an idle link still goes to
+ *  sleep and falls back to interrupts.
+ */
+static int adaptive_poll = 1;
+module_param(adaptive_poll, int, S_IRUGO | S_IWUSR);
+
+static int poll_max_msec = INACTIVITY_TIME_MSEC / 2;
+module_param(poll_max_msec, int, S_IRUGO | S_IWUSR);
+
 /** Context validity check */
 #define SDIO_AL_SIGNATURE 0xAABBCCDD
 
@@ -157,6 +171,7 @@ struct sdio_al_debug {
 	struct dentry *sdio_al_debug_root;
 	struct dentry *sdio_al_debug_lpm_on;
 	struct dentry *sdio_al_debug_data_on;
+	struct dentry *sdio_al_debug_stats;
 };
 
 /**
@@ -389,6 +404,9 @@ struct sdio_channel {
 
 	u32 total_rx_bytes;
 	u32 total_tx_bytes;
+	u32 total_rx_packets;
+	u32 total_tx_packets;
+	unsigned long open_jiffies;
 
 	u32 signature;
 };
@@ -428,6 +446,11 @@ struct sdio_channel {
  *
  *  @poll_delay_msec - timer delay for polling the mailbox.
  *
+ *  @mbox_reads_polled - mailbox reads from the worker (timer or
+ *  		client request).
+ *
+ *  @mbox_reads_irq - mailbox reads from the SDIO interrupt.
+ *
  *  @use_irq - allow to work in polling mode or interrupt mode.
  *
  *  @is_err - error detected.
@@ -461,6 +484,8 @@ struct sdio_al {
 
 	struct timer_list timer;
 	u32 poll_delay_msec;
+	u32 mbox_reads_polled;
+	u32 mbox_reads_irq;
 
 	int use_irq;
 
@@ -505,7 +530,55 @@ static int sdio_al_wake_up(u32 enable_wake_up_func);
 * echo 0 > /sys/kernel/debugfs/sdio_al/debug_lpm_on
 * for trigger on the lpm messages debug level use:
 * echo 1 > /sys/kernel/debugfs/sdio_al/debug_lpm_on
+*
+* Per channel traffic, average throughput since open and the
+* current mailbox poll delay:
+* cat /sys/kernel/debugfs/sdio_al/stats
 */
+static int sdio_al_stats_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	seq_printf(s, "poll %u msec (adaptive %d, max %d) "
+		   "mailbox reads polled %u irq %u\n",
+		   sdio_al->poll_delay_msec, adaptive_poll, poll_max_msec,
+		   sdio_al->mbox_reads_polled, sdio_al->mbox_reads_irq);
+
+	for (i = 0; i < SDIO_AL_MAX_CHANNELS; i++) {
+		struct sdio_channel *ch = &sdio_al->channel[i];
+		unsigned int msec;
+
+		if ((!ch->is_valid) || (!ch->is_open))
+			continue;
+
+		msec = jiffies_to_msecs(jiffies - ch->open_jiffies);
+		if (!msec)
+			msec = 1;
+		/* bytes per msec is KB/s */
+		seq_printf(s, "%-16s rx %u pkts %u bytes %u KB/s, "
+			   "tx %u pkts %u bytes %u KB/s, poll %d msec\n",
+			   ch->name,
+			   ch->total_rx_packets, ch->total_rx_bytes,
+			   ch->total_rx_bytes / msec,
+			   ch->total_tx_packets, ch->total_tx_bytes,
+			   ch->total_tx_bytes / msec,
+			   ch->poll_delay_msec);
+	}
+	return 0;
+}
+
+static int sdio_al_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sdio_al_stats_show, NULL);
+}
+
+static const struct file_operations sdio_al_stats_fops = {
+	.open		= sdio_al_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int sdio_al_debugfs_init(void)
 {
 	sdio_al->debug.sdio_al_debug_root = debugfs_create_dir("sdio_al", NULL);
@@ -523,6 +596,11 @@ static int sdio_al_debugfs_init(void)
 					sdio_al->debug.sdio_al_debug_root,
 					&sdio_al->debug.debug_data_on);
 
+	sdio_al->debug.sdio_al_debug_stats = debugfs_create_file("stats",
+					S_IRUGO,
+					sdio_al->debug.sdio_al_debug_root,
+					NULL, &sdio_al_stats_fops);
+
 	if ((!sdio_al->debug.sdio_al_debug_data_on) &&
 	    (!sdio_al->debug.sdio_al_debug_lpm_on)) {
 		debugfs_remove(sdio_al->debug.sdio_al_debug_root);
@@ -534,6 +612,7 @@ static int sdio_al_debugfs_init(void)
 
 static void sdio_al_debugfs_cleanup(void)
 {
+       debugfs_remove(sdio_al->debug.sdio_al_debug_stats);
        debugfs_remove(sdio_al->debug.sdio_al_debug_lpm_on);
        debugfs_remove(sdio_al->debug.sdio_al_debug_data_on);
        debugfs_remove(sdio_al->debug.sdio_al_debug_root);
@@ -582,6 +661,31 @@ static inline int is_inactive_time_expired(void)
 	return time_after(jiffies, sdio_al->inactivity_time);
 }
 
+/**
+ *  Track traffic with the mailbox poll delay. Does nothing
+ *  while the timer is stopped (sleep or error).
+ */
+static void adapt_poll_delay(int active)
+{
+	u32 min_delay, max_delay;
+
+	if (!adaptive_poll || !sdio_al->poll_delay_msec)
+		return;
+
+	min_delay = get_min_poll_time_msec();
+	if (!min_delay)
+		return;
+
+	if (active) {
+		sdio_al->poll_delay_msec = min_delay;
+		return;
+	}
+
+	max_delay = max_t(u32, min_delay, poll_max_msec);
+	sdio_al->poll_delay_msec = min(sdio_al->poll_delay_msec * 2,
+				       max_delay);
+}
+
 /**
  *  Read SDIO-Client Mailbox from Function#1.thresh_pipe
  *
@@ -625,6 +729,11 @@ static int read_mailbox(int from_isr)
 	if (!from_isr)
 		sdio_claim_host(sdio_al->card->sdio_func[0]);
 
+	if (from_isr)
+		sdio_al->mbox_reads_irq++;
+	else
+		sdio_al->mbox_reads_polled++;
+
 	pr_debug(MODULE_NAME ":before sdio_memcpy_fromio.\n");
 	ret = sdio_memcpy_fromio(func1, mailbox,
 			HW_MAILBOX_ADDR, sizeof(*mailbox));
@@ -722,11 +831,13 @@ static int read_mailbox(int from_isr)
 	if ((rx_notify_bitmask == 0) && (tx_notify_bitmask == 0) &&
 	    !any_read_avail) {
 		DATA_DEBUG(MODULE_NAME ":Nothing to Notify\n");
+		adapt_poll_delay(false);
 	} else {
 		DATA_DEBUG(MODULE_NAME ":Notify bitmask rx=0x%x, tx=0x%x.\n",
 			rx_notify_bitmask, tx_notify_bitmask);
 		/* Restart inactivity timer if any activity on the channel */
 		restart_inactive_time();
+		adapt_poll_delay(true);
 	}
 
 	for (i = 0; i < SDIO_AL_MAX_CHANNELS; i++) {
@@ -1388,6 +1499,9 @@ static int open_channel(struct sdio_channel *ch)
 
 	ch->total_rx_bytes = 0;
 	ch->total_tx_bytes = 0;
+	ch->total_rx_packets = 0;
+	ch->total_tx_packets = 0;
+	ch->open_jiffies = jiffies;
 
 	ch->write_avail = 0;
 	ch->read_avail = 0;
@@ -2022,6 +2136,7 @@ int sdio_read(struct sdio_channel *ch, void *data, int len)
 		ch->read_avail -= len;
 
 	ch->total_rx_bytes += len;
+	ch->total_rx_packets++;
 	DATA_DEBUG(MODULE_NAME ":end ch %s read %d avail %d total %d.\n",
 		ch->name, len, ch->read_avail, ch->total_rx_bytes);
 
@@ -2081,6 +2196,7 @@ int sdio_write(struct sdio_channel *ch, const void *data, int len)
 	ret = sdio_ch_write(ch, data, len);
 
 	ch->total_tx_bytes += len;
+	ch->total_tx_packets++;
 	DATA_DEBUG(MODULE_NAME ":end ch %s write %d avail %d total %d.\n",
 		ch->name, len, ch->write_avail, ch->total_tx_bytes);
 
@@ -28,6 +28,7 @@
 #include <linux/platform_device.h>
 #include <linux/sched.h>
 #include <linux/skbuff.h>
+#include <linux/slab.h>
 #include <linux/wakelock.h>
 
 #include <mach/sdio_al.h>
@@ -42,11 +43,25 @@
 #define SDIO_MUX_HDR_CMD_OPEN    1
 #define SDIO_MUX_HDR_CMD_CLOSE   2
 
+/* Largest write when frames of several channels go out together */
+#define SDIO_MUX_AGGR_MAX        (16 * 1024)
+
 
 static int msm_sdio_dmux_debug_enable;
 module_param_named(debug_enable, msm_sdio_dmux_debug_enable,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Frames pending on more than one channel are copied into one buffer
+ * and written with a single sdio_write(). The peer parses the stream
+ * by header, the same way sdio_mux_read_data() does.
+ */
+static int msm_sdio_dmux_aggregate = 1;
+module_param_named(aggregate, msm_sdio_dmux_aggregate,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+static uint32_t sdio_dmux_write_aggr_cnt;
+module_param_named(aggr_writes, sdio_dmux_write_aggr_cnt, uint, S_IRUGO);
+
 #if defined(DEBUG)
 static uint32_t sdio_dmux_read_cnt;
 static uint32_t sdio_dmux_write_cnt;
@@ -126,6 +141,7 @@ static DECLARE_WORK(work_sdio_mux_write, sdio_mux_write_data);
 static struct workqueue_struct *sdio_mux_read_workqueue;
 static struct workqueue_struct *sdio_mux_write_workqueue;
 static struct sdio_partial_pkt_info sdio_partial_pkt;
+static void *sdio_mux_aggr_buf;
 
 #define sdio_ch_is_open(x)						\
 	(sdio_ch[(x)].status == (SDIO_CH_LOCAL_OPEN | SDIO_CH_REMOTE_OPEN))
@@ -393,12 +409,74 @@ static int sdio_mux_write_cmd(void *data, uint32_t len)
 	return 0;
 }
 
+/*
+ * Write the frames pending on all open channels in one go. Returns 0
+ * when they went out, -EAGAIN when the write should be retried and
+ * -EINVAL when there is nothing to combine, leaving it to the per
+ * channel loop.
+ */
+static int sdio_mux_write_aggregated(void)
+{
+	struct sk_buff *skbs[SDIO_DMUX_NUM_CHANNELS];
+	int ids[SDIO_DMUX_NUM_CHANNELS];
+	int i, n = 0, len = 0, rc;
+	unsigned long flags;
+
+	for (i = 0; i < SDIO_DMUX_NUM_CHANNELS; ++i) {
+		spin_lock_irqsave(&sdio_ch[i].lock, flags);
+		if (sdio_ch_is_local_open(i) && sdio_ch[i].skb &&
+		    len + sdio_ch[i].skb->len <= SDIO_MUX_AGGR_MAX) {
+			skbs[n] = sdio_ch[i].skb;
+			ids[n++] = i;
+			len += sdio_ch[i].skb->len;
+		}
+		spin_unlock_irqrestore(&sdio_ch[i].lock, flags);
+	}
+	if (n < 2)
+		return -EINVAL;
+
+	mutex_lock(&sdio_mux_lock);
+	if (sdio_write_avail(sdio_mux_ch) < len) {
+		mutex_unlock(&sdio_mux_lock);
+		return -EINVAL;
+	}
+	len = 0;
+	for (i = 0; i < n; ++i) {
+		memcpy(sdio_mux_aggr_buf + len, skbs[i]->data, skbs[i]->len);
+		len += skbs[i]->len;
+	}
+	rc = sdio_write(sdio_mux_ch, sdio_mux_aggr_buf, len);
+	DBG("%s: %d frames, %d bytes, write returned %d\n",
+	    __func__, n, len, rc);
+	mutex_unlock(&sdio_mux_lock);
+	if (rc)
+		return -EAGAIN;
+
+	DBG_INC_WRITE_CNT(len);
+	sdio_dmux_write_aggr_cnt++;
+	for (i = 0; i < n; ++i) {
+		spin_lock_irqsave(&sdio_ch[ids[i]].lock, flags);
+		sdio_ch[ids[i]].skb = NULL;
+		sdio_ch[ids[i]].write_done(sdio_ch[ids[i]].priv, skbs[i]);
+		spin_unlock_irqrestore(&sdio_ch[ids[i]].lock, flags);
+	}
+	return 0;
+}
+
 static void sdio_mux_write_data(struct work_struct *work)
 {
 	int i, rc, reschedule = 0;
 	struct sk_buff *skb;
 	unsigned long flags;
 
+	if (msm_sdio_dmux_aggregate && sdio_mux_aggr_buf) {
+		rc = sdio_mux_write_aggregated();
+		if (rc == -EAGAIN)
+			reschedule = 1;
+		if (rc != -EINVAL)
+			goto done;
+	}
+
 	for (i = 0; i < SDIO_DMUX_NUM_CHANNELS; ++i) {
 		spin_lock_irqsave(&sdio_ch[i].lock, flags);
 		if (sdio_ch_is_local_open(i) && sdio_ch[i].skb) {
@@ -418,6 +496,7 @@ static void sdio_mux_write_data(struct work_struct *work)
 			spin_unlock_irqrestore(&sdio_ch[i].lock, flags);
 	}
 
+done:
 	/* probably should use delayed work */
 	if (reschedule)
 		queue_work(sdio_mux_write_workqueue, &work_sdio_mux_write);
@@ -603,12 +682,17 @@ static int sdio_dmux_probe(struct platform_device *pdev)
 	for (rc = 0; rc < SDIO_DMUX_NUM_CHANNELS; ++rc)
 		spin_lock_init(&sdio_ch[rc].lock);
 
+	/* Without the buffer frames are simply written one by one */
+	sdio_mux_aggr_buf = kmalloc(SDIO_MUX_AGGR_MAX, GFP_KERNEL);
+
 	wake_lock_init(&sdio_mux_ch_wakelock, WAKE_LOCK_SUSPEND,
 		       "sdio_dmux");
 	rc = sdio_open("SDIO_RMNT", &sdio_mux_ch, NULL, sdio_mux_notify);
 	if (rc < 0) {
 		pr_err("%s: sido open failed %d\n", __func__, rc);
 		wake_lock_destroy(&sdio_mux_ch_wakelock);
+		kfree(sdio_mux_aggr_buf);
+		sdio_mux_aggr_buf = NULL;
 		destroy_workqueue(sdio_mux_read_workqueue);
 		destroy_workqueue(sdio_mux_write_workqueue);
 		return rc;
@@ -31,9 +31,13 @@
 #include <linux/ctype.h>
 #include <linux/remote_spinlock.h>
 #include <linux/uaccess.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
 #include <mach/msm_smd.h>
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
+#include <mach/msm_latency.h>
 
 #include "smd_private.h"
 #include "proc_comm.h"
@@ -81,6 +85,11 @@ static int msm_smd_debug_mask;
 module_param_named(debug_mask, msm_smd_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* How long data kicks to the other processor may be held back, 0 = off */
+static int smd_kick_delay_us = 50;
+module_param_named(kick_delay_us, smd_kick_delay_us,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
 #if defined(CONFIG_MSM_SMD_DEBUG)
 #define SMD_DBG(x...) do {				\
 		if (msm_smd_debug_mask & MSM_SMD_DEBUG) \
@@ -172,6 +181,69 @@ static inline void notify_dsps_smd(void)
 	MSM_TRIG_A2DSPS_SMD_INT;
 }
 
+/*
+ * Write-side interrupt mitigation
+ *
+ * Data written to a fifo is signalled up to smd_kick_delay_us later, so
+ * a burst of small writes (AT commands, QMI, small IP packets) costs the
+ * other processor one interrupt instead of one per write. A write that
+ * leaves less than a quarter of the fifo free is signalled at once so
+ * the other side starts draining it. State changes are never delayed.
+ */
+enum {
+	SMD_KICK_MODEM,
+	SMD_KICK_DSP,
+	SMD_KICK_DSPS,
+	SMD_KICK_NR,
+};
+
+static void (*const smd_kick_fn[SMD_KICK_NR])(void) = {
+	[SMD_KICK_MODEM] = notify_modem_smd,
+	[SMD_KICK_DSP] = notify_dsp_smd,
+	[SMD_KICK_DSPS] = notify_dsps_smd,
+};
+
+/* Per-channel counters, see smd_stats_print() */
+struct smd_ch_stats {
+	u64 tx_bytes;
+	u64 rx_bytes;
+	unsigned tx_pkts;	/* packet channels only */
+	unsigned rx_pkts;
+	unsigned tx_hwm;	/* most bytes seen queued in the fifo */
+	unsigned rx_hwm;
+	unsigned full;		/* writes that found the fifo full */
+	u64 full_since;		/* sched_clock() of the first one */
+	u64 full_ns;		/* total time spent full */
+};
+
+static unsigned smd_irqs[SMD_KICK_NR];
+static unsigned smd_kicks[SMD_KICK_NR];
+static unsigned smd_kicks_saved[SMD_KICK_NR];
+
+static DEFINE_SPINLOCK(smd_kick_lock);
+static unsigned smd_kick_pending;
+static struct hrtimer smd_kick_timer;
+
+static enum hrtimer_restart smd_kick_timer_fn(struct hrtimer *timer)
+{
+	unsigned long flags;
+	unsigned pending;
+	int i;
+
+	spin_lock_irqsave(&smd_kick_lock, flags);
+	pending = smd_kick_pending;
+	smd_kick_pending = 0;
+	spin_unlock_irqrestore(&smd_kick_lock, flags);
+
+	for (i = 0; i < SMD_KICK_NR; i++)
+		if (pending & (1 << i)) {
+			smd_kicks[i]++;
+			smd_kick_fn[i]();
+		}
+
+	return HRTIMER_NORESTART;
+}
+
 void smd_diag(void)
 {
 	char *x;
@@ -256,6 +328,7 @@ struct smd_channel {
 	struct list_head ch_list;
 
 	unsigned current_packet;
+	unsigned pending_write;
 	unsigned n;
 	void *priv;
 	void (*notify)(void *priv, unsigned flags);
@@ -271,6 +344,9 @@ struct smd_channel {
 	void (*update_state)(smd_channel_t *ch);
 	unsigned last_state;
 	void (*notify_other_cpu)(void);
+	int kick;		/* SMD_KICK_*, or -1 to always kick at once */
+
+	struct smd_ch_stats stats;
 
 	char name[20];
 	struct platform_device pdev;
@@ -392,6 +468,7 @@ static void ch_read_done(struct smd_channel *ch, unsigned count)
 	BUG_ON(count > smd_stream_read_avail(ch));
 	ch->recv->tail = (ch->recv->tail + count) & ch->fifo_mask;
 	ch->send->fTAIL = 1;
+	ch->stats.rx_bytes += count;
 }
 
 /* basic read interface to ch_read_{buffer,done} used
@@ -457,6 +534,7 @@ static void update_packet_state(struct smd_channel *ch)
 		BUG_ON(r != SMD_HEADER_SIZE);
 
 		ch->current_packet = hdr[0];
+		ch->stats.rx_pkts++;
 	}
 }
 
@@ -485,6 +563,55 @@ static void ch_write_done(struct smd_channel *ch, unsigned count)
 	BUG_ON(count > smd_stream_write_avail(ch));
 	ch->send->head = (ch->send->head + count) & ch->fifo_mask;
 	ch->send->fHEAD = 1;
+	ch->stats.tx_bytes += count;
+}
+
+/* A write found no room in the fifo */
+static void ch_stats_full(struct smd_channel *ch)
+{
+	ch->stats.full++;
+	if (!ch->stats.full_since)
+		ch->stats.full_since = sched_clock();
+}
+
+/* Data went into the fifo: end any full period, update the high mark */
+static void ch_stats_written(struct smd_channel *ch)
+{
+	unsigned used = ch->fifo_mask - smd_stream_write_avail(ch);
+
+	if (ch->stats.full_since) {
+		ch->stats.full_ns += sched_clock() - ch->stats.full_since;
+		ch->stats.full_since = 0;
+	}
+	if (used > ch->stats.tx_hwm)
+		ch->stats.tx_hwm = used;
+}
+
+/* Tell the other side new data was written to @ch, see smd_kick_fn */
+static void ch_data_kick(struct smd_channel *ch)
+{
+	int delay = smd_kick_delay_us;
+	unsigned long flags;
+
+	ch_stats_written(ch);
+
+	if (ch->kick < 0 || delay <= 0 ||
+	    smd_stream_write_avail(ch) < ch->fifo_size / 4) {
+		if (ch->kick >= 0)
+			smd_kicks[ch->kick]++;
+		ch->notify_other_cpu();
+		return;
+	}
+
+	spin_lock_irqsave(&smd_kick_lock, flags);
+	if (smd_kick_pending & (1 << ch->kick))
+		smd_kicks_saved[ch->kick]++;
+	smd_kick_pending |= 1 << ch->kick;
+	if (!hrtimer_is_queued(&smd_kick_timer))
+		hrtimer_start(&smd_kick_timer,
+			      ktime_set(0, delay * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	spin_unlock_irqrestore(&smd_kick_lock, flags);
 }
 
 static void ch_set_state(struct smd_channel *ch, unsigned n)
@@ -547,31 +674,53 @@ static void smd_state_change(struct smd_channel *ch,
 	}
 }
 
+/*
+ * fHEAD, fTAIL, fSTATE and fBLOCKREADINTR share a word of the half
+ * channel, which lives in uncached shared memory.
+ */
+#define SMD_FLAG_HEAD	(0xff << 0)
+#define SMD_FLAG_TAIL	(0xff << 8)
+#define SMD_FLAG_STATE	(0xff << 16)
+
+static inline unsigned ch_recv_flags(struct smd_channel *ch)
+{
+	BUILD_BUG_ON(offsetof(struct smd_half_channel, fHEAD) % 4 ||
+		     offsetof(struct smd_half_channel, fSTATE) !=
+		     offsetof(struct smd_half_channel, fHEAD) + 2);
+
+	return *(volatile unsigned *)&ch->recv->fHEAD &
+		(SMD_FLAG_HEAD | SMD_FLAG_TAIL | SMD_FLAG_STATE);
+}
+
 static void handle_smd_irq(struct list_head *list, void (*notify)(void))
 {
 	unsigned long flags;
 	struct smd_channel *ch;
 	unsigned ch_flags;
 	unsigned tmp;
+	u64 start;
 
+	start = msm_latency_start(MSM_LATENCY_SMD, (unsigned long)list);
 	spin_lock_irqsave(&smd_lock, flags);
 	list_for_each_entry(ch, list, ch_list) {
 		ch_flags = 0;
-		if (ch_is_open(ch)) {
-			if (ch->recv->fHEAD) {
+		tmp = ch->recv->state;
+		if ((tmp == SMD_SS_OPENED || tmp == SMD_SS_FLUSHING) &&
+		    ch->send->state == SMD_SS_OPENED) {
+			/* one uncached read for all three flags */
+			ch_flags = ch_recv_flags(ch);
+			if (ch_flags & SMD_FLAG_HEAD) {
+				unsigned n = smd_stream_read_avail(ch);
+
 				ch->recv->fHEAD = 0;
-				ch_flags |= 1;
+				if (n > ch->stats.rx_hwm)
+					ch->stats.rx_hwm = n;
 			}
-			if (ch->recv->fTAIL) {
+			if (ch_flags & SMD_FLAG_TAIL)
 				ch->recv->fTAIL = 0;
-				ch_flags |= 2;
-			}
-			if (ch->recv->fSTATE) {
+			if (ch_flags & SMD_FLAG_STATE)
 				ch->recv->fSTATE = 0;
-				ch_flags |= 4;
-			}
 		}
-		tmp = ch->recv->state;
 		if (tmp != ch->last_state)
 			smd_state_change(ch, ch->last_state, tmp);
 		if (ch_flags) {
@@ -581,10 +730,12 @@ static void handle_smd_irq(struct list_head *list, void (*notify)(void))
 	}
 	spin_unlock_irqrestore(&smd_lock, flags);
 	do_smd_probe();
+	msm_latency_done(MSM_LATENCY_SMD, (unsigned long)list, start, 0);
 }
 
 static irqreturn_t smd_modem_irq_handler(int irq, void *data)
 {
+	smd_irqs[SMD_KICK_MODEM]++;
 	handle_smd_irq(&smd_ch_list_modem, notify_modem_smd);
 	return IRQ_HANDLED;
 }
@@ -592,6 +743,7 @@ static irqreturn_t smd_modem_irq_handler(int irq, void *data)
 #if defined(CONFIG_QDSP6)
 static irqreturn_t smd_dsp_irq_handler(int irq, void *data)
 {
+	smd_irqs[SMD_KICK_DSP]++;
 	handle_smd_irq(&smd_ch_list_dsp, notify_dsp_smd);
 	return IRQ_HANDLED;
 }
@@ -600,6 +752,7 @@ static irqreturn_t smd_dsp_irq_handler(int irq, void *data)
 #if defined(CONFIG_DSPS)
 static irqreturn_t smd_dsps_irq_handler(int irq, void *data)
 {
+	smd_irqs[SMD_KICK_DSPS]++;
 	handle_smd_irq(&smd_ch_list_dsps, notify_dsps_smd);
 	return IRQ_HANDLED;
 }
@@ -714,8 +867,11 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 			break;
 	}
 
+	if (len)
+		ch_stats_full(ch);
+
 	if (orig_len - len)
-		ch->notify_other_cpu();
+		ch_data_kick(ch);
 
 	return orig_len - len;
 }
@@ -732,8 +888,10 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	else if (len == 0)
 		return 0;
 
-	if (smd_stream_write_avail(ch) < (len + SMD_HEADER_SIZE))
+	if (smd_stream_write_avail(ch) < (len + SMD_HEADER_SIZE)) {
+		ch_stats_full(ch);
 		return -ENOMEM;
+	}
 
 	hdr[0] = len;
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
@@ -754,6 +912,7 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 		return ret;
 	}
 
+	ch->stats.tx_pkts++;
 	return len;
 }
 
@@ -884,11 +1043,12 @@ static int smd_alloc_channel(struct smd_alloc_elm *alloc_elm)
 	ch->type = SMD_CHANNEL_TYPE(alloc_elm->type);
 
 	if (ch->type == SMD_APPS_MODEM)
-		ch->notify_other_cpu = notify_modem_smd;
+		ch->kick = SMD_KICK_MODEM;
 	else if (ch->type == SMD_APPS_QDSP)
-		ch->notify_other_cpu = notify_dsp_smd;
+		ch->kick = SMD_KICK_DSP;
 	else
-		ch->notify_other_cpu = notify_dsps_smd;
+		ch->kick = SMD_KICK_DSPS;
+	ch->notify_other_cpu = smd_kick_fn[ch->kick];
 
 	if (smd_is_packet(alloc_elm)) {
 		ch->read = smd_packet_read;
@@ -964,6 +1124,7 @@ static int smd_alloc_loopback_channel(void)
 	ch->fifo_mask = ch->fifo_size - 1;
 	ch->type = SMD_LOOPBACK_TYPE;
 	ch->notify_other_cpu = notify_loopback_smd;
+	ch->kick = -1;
 
 	ch->read = smd_stream_read;
 	ch->write = smd_stream_write;
@@ -1033,6 +1194,8 @@ int smd_named_open_on_edge(const char *name, uint32_t edge,
 
 	ch->notify = notify;
 	ch->current_packet = 0;
+	ch->pending_write = 0;
+	memset(&ch->stats, 0, sizeof(ch->stats));
 	ch->last_state = SMD_SS_CLOSED;
 	ch->priv = priv;
 
@@ -1137,6 +1300,130 @@ int smd_write_user_buffer(smd_channel_t *ch, const void *data, int len)
 }
 EXPORT_SYMBOL(smd_write_user_buffer);
 
+/*
+ * Zero-copy access to the fifo
+ *
+ * smd_read_buffer() points at the data at the read end of the fifo and
+ * returns how much of it is contiguous, no more than the rest of the
+ * current packet on packet channels. smd_read_done() gives the space
+ * back once the data has been used.
+ *
+ * smd_write_start() reserves room for @len bytes and, on packet
+ * channels, writes the packet header. The caller then fills the fifo
+ * in place with smd_write_buffer()/smd_write_commit(); the other side
+ * is signalled once, when the last byte is committed.
+ *
+ * Callers serialize these the same way as smd_read() and smd_write().
+ */
+static int ch_is_packet(smd_channel_t *ch)
+{
+	return ch->read == smd_packet_read;
+}
+
+int smd_read_buffer(smd_channel_t *ch, void **ptr)
+{
+	unsigned n = ch_read_buffer(ch, ptr);
+
+	if (ch_is_packet(ch) && n > ch->current_packet)
+		n = ch->current_packet;
+
+	return n;
+}
+EXPORT_SYMBOL(smd_read_buffer);
+
+/* Not to be called from the notify callback */
+void smd_read_done(smd_channel_t *ch, int len)
+{
+	unsigned long flags;
+
+	if (len <= 0)
+		return;
+
+	ch_read_done(ch, len);
+	if (!read_intr_blocked(ch))
+		ch->notify_other_cpu();
+
+	if (ch_is_packet(ch)) {
+		spin_lock_irqsave(&smd_lock, flags);
+		BUG_ON(len > ch->current_packet);
+		ch->current_packet -= len;
+		update_packet_state(ch);
+		spin_unlock_irqrestore(&smd_lock, flags);
+	}
+}
+EXPORT_SYMBOL(smd_read_done);
+
+int smd_write_start(smd_channel_t *ch, int len)
+{
+	unsigned hdr[5];
+	void *ptr;
+	int need = len;
+	int n, r;
+
+	if (len <= 0)
+		return -EINVAL;
+	if (ch->pending_write)
+		return -EBUSY;
+	if (!ch_is_open(ch))
+		return -ENODEV;
+
+	if (ch_is_packet(ch))
+		need += SMD_HEADER_SIZE;
+	if (smd_stream_write_avail(ch) < need) {
+		ch_stats_full(ch);
+		return -ENOMEM;
+	}
+
+	if (ch_is_packet(ch)) {
+		hdr[0] = len;
+		hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
+
+		/* The header may wrap, copy it without signalling */
+		for (r = 0; r < SMD_HEADER_SIZE; r += n) {
+			n = ch_write_buffer(ch, &ptr);
+			if (n > SMD_HEADER_SIZE - r)
+				n = SMD_HEADER_SIZE - r;
+			memcpy(ptr, (char *)hdr + r, n);
+			ch_write_done(ch, n);
+		}
+		ch->stats.tx_pkts++;
+	}
+
+	ch->pending_write = len;
+	return 0;
+}
+EXPORT_SYMBOL(smd_write_start);
+
+int smd_write_buffer(smd_channel_t *ch, void **ptr)
+{
+	unsigned n;
+
+	if (!ch->pending_write)
+		return -EINVAL;
+
+	n = ch_write_buffer(ch, ptr);
+	if (n > ch->pending_write)
+		n = ch->pending_write;
+
+	return n;
+}
+EXPORT_SYMBOL(smd_write_buffer);
+
+/* Returns how much of the reserved length is still to be committed */
+int smd_write_commit(smd_channel_t *ch, int len)
+{
+	if (len < 0 || len > ch->pending_write)
+		return -EINVAL;
+
+	ch_write_done(ch, len);
+	ch->pending_write -= len;
+	if (!ch->pending_write)
+		ch_data_kick(ch);
+
+	return ch->pending_write;
+}
+EXPORT_SYMBOL(smd_write_commit);
+
 int smd_read_avail(smd_channel_t *ch)
 {
 	return ch->read_avail(ch);
@@ -1145,7 +1432,12 @@ EXPORT_SYMBOL(smd_read_avail);
 
 int smd_write_avail(smd_channel_t *ch)
 {
-	return ch->write_avail(ch);
+	int n = ch->write_avail(ch);
+
+	if (!n)
+		ch_stats_full(ch);
+
+	return n;
 }
 EXPORT_SYMBOL(smd_write_avail);
 
@@ -1179,6 +1471,61 @@ int smd_cur_packet_size(smd_channel_t *ch)
 }
 EXPORT_SYMBOL(smd_cur_packet_size);
 
+static int smd_stats_print_ch(char *buf, int max, struct smd_channel *ch)
+{
+	struct smd_ch_stats *s = &ch->stats;
+	u64 full_ns = s->full_ns;
+
+	if (s->full_since)
+		full_ns += sched_clock() - s->full_since;
+
+	return scnprintf(buf, max,
+			 "ch%02d %-20s %5x tx %llu/%u hwm %x full %u/%llums"
+			 " rx %llu/%u hwm %x\n",
+			 ch->n, ch->name, ch->fifo_size,
+			 s->tx_bytes, s->tx_pkts, s->tx_hwm, s->full,
+			 div_u64(full_ns, NSEC_PER_MSEC),
+			 s->rx_bytes, s->rx_pkts, s->rx_hwm);
+}
+
+/*
+ * Per-edge interrupt counts and, for each channel, the fifo size, then
+ * bytes/packets sent, the highest fill seen, the number of writes that
+ * found the fifo full and the time spent full, and the same for the
+ * receive side. Packet counts are only kept for packet channels.
+ * Counters are reset when a channel is opened.
+ */
+int smd_stats_print(char *buf, int max)
+{
+	static const char *edges[SMD_KICK_NR] = { "modem", "dsp", "dsps" };
+	struct list_head *lists[] = {
+		&smd_ch_list_modem, &smd_ch_list_dsp, &smd_ch_list_dsps,
+	};
+	struct smd_channel *ch;
+	unsigned long flags;
+	int n, i = 0;
+
+	for (n = 0; n < SMD_KICK_NR; n++)
+		i += scnprintf(buf + i, max - i,
+			       "%s: irqs %u kicks %u coalesced %u\n",
+			       edges[n], smd_irqs[n], smd_kicks[n],
+			       smd_kicks_saved[n]);
+
+	spin_lock_irqsave(&smd_lock, flags);
+	for (n = 0; n < ARRAY_SIZE(lists); n++)
+		list_for_each_entry(ch, lists[n], ch_list)
+			i += smd_stats_print_ch(buf + i, max - i, ch);
+	spin_unlock_irqrestore(&smd_lock, flags);
+
+	i += scnprintf(buf + i, max - i, "closed:\n");
+	mutex_lock(&smd_creation_mutex);
+	list_for_each_entry(ch, &smd_ch_closed_list, ch_list)
+		i += smd_stats_print_ch(buf + i, max - i, ch);
+	mutex_unlock(&smd_creation_mutex);
+
+	return i;
+}
+
 int smd_tiocmget(smd_channel_t *ch)
 {
 	return  (ch->recv->fDSR ? TIOCM_DSR : 0) |
@@ -1565,6 +1912,9 @@ int smd_core_init(void)
 	unsigned long flags = IRQF_TRIGGER_RISING;
 	SMD_INFO("smd_core_init()\n");
 
+	hrtimer_init(&smd_kick_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	smd_kick_timer.function = smd_kick_timer_fn;
+
 	r = request_irq(INT_A9_M2A_0, smd_modem_irq_handler,
 			flags, "smd_dev", 0);
 	if (r < 0)
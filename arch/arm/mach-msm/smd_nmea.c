@@ -195,7 +195,7 @@ static int __init nmea_init(void)
 	nmea_device.bytes_read = 0;
 	nmea_devp = &nmea_device;
 
-	nmea_wq = create_singlethread_workqueue("nmea");
+	nmea_wq = create_shared_workqueue("nmea");
 	if (nmea_wq == 0)
 		return -ENOMEM;
 
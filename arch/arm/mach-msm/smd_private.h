@@ -315,5 +315,6 @@ int smsm_check_for_modem_crash(void);
 void *smem_find(unsigned id, unsigned size);
 void *smem_get_entry(unsigned id, unsigned *size);
 void smd_diag(void);
+int smd_stats_print(char *buf, int max);
 
 #endif
@@ -829,7 +829,7 @@ static int __init qmi_init(void)
 {
 	int ret;
 
-	qmi_wq = create_singlethread_workqueue("qmi");
+	qmi_wq = create_shared_workqueue("qmi");
 	if (qmi_wq == 0)
 		return -ENOMEM;
 
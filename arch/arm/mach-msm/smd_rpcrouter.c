@@ -46,11 +46,13 @@
 #include <linux/platform_device.h>
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
+#include <linux/hash.h>
 
 #include <asm/byteorder.h>
 
 #include <mach/msm_smd.h>
 #include <mach/smem_log.h>
+#include <mach/msm_latency.h>
 #include "smd_rpcrouter.h"
 #include "modem_notifier.h"
 #include "smd_rpc_sym.h"
@@ -149,6 +151,10 @@ static LIST_HEAD(server_list);
 static wait_queue_head_t newserver_wait;
 
 static DEFINE_SPINLOCK(local_endpoints_lock);
+
+/* local endpoints by cid, for do_read_data() */
+#define RPCROUTER_EPT_HASH_BITS	5
+static struct hlist_head local_endpoints_hash[1 << RPCROUTER_EPT_HASH_BITS];
 static DEFINE_SPINLOCK(remote_endpoints_lock);
 static DEFINE_SPINLOCK(server_list_lock);
 
@@ -283,12 +289,14 @@ static int rpcrouter_send_control_msg(struct rpcrouter_xprt_info *xprt_info,
 	return 0;
 }
 
+static void rr_free_pkt(struct rr_packet *pkt);
+static void rpcrouter_async_fail(struct msm_rpc_endpoint *ept, int status);
+
 static void modem_reset_start_cleanup(void)
 {
 	struct msm_rpc_endpoint *ept;
 	struct rr_remote_endpoint *r_ept;
 	struct rr_packet *pkt, *tmp_pkt;
-	struct rr_fragment *frag, *next;
 	struct msm_rpc_reply *reply, *reply_tmp;
 	unsigned long flags;
 
@@ -302,6 +310,7 @@ static void modem_reset_start_cleanup(void)
 		list_for_each_entry_safe(reply, reply_tmp,
 					 &ept->reply_pend_q, list) {
 			list_del(&reply->list);
+			hlist_del(&reply->hash);
 			kfree(reply);
 		}
 		list_for_each_entry_safe(reply, reply_tmp,
@@ -311,17 +320,12 @@ static void modem_reset_start_cleanup(void)
 		}
 		spin_unlock(&ept->reply_q_lock);
 		if (ept->dst_pid == RPCROUTER_PID_REMOTE) {
+			rpcrouter_async_fail(ept, -ENETRESET);
 			spin_lock(&ept->incomplete_lock);
 			list_for_each_entry_safe(pkt, tmp_pkt,
 						 &ept->incomplete, list) {
 				list_del(&pkt->list);
-				frag = pkt->first;
-				while (frag != NULL) {
-					next = frag->next;
-					kfree(frag);
-					frag = next;
-				}
-			kfree(pkt);
+				rr_free_pkt(pkt);
 			}
 			spin_unlock(&ept->incomplete_lock);
 			/* remove all completed packets waiting to be read*/
@@ -329,13 +333,7 @@ static void modem_reset_start_cleanup(void)
 			list_for_each_entry_safe(pkt, tmp_pkt, &ept->read_q,
 						 list) {
 				list_del(&pkt->list);
-				frag = pkt->first;
-				while (frag != NULL) {
-					next = frag->next;
-					kfree(frag);
-					frag = next;
-				}
-				kfree(pkt);
+				rr_free_pkt(pkt);
 			}
 			spin_unlock(&ept->read_q_lock);
 			/* Set restart state for local ep */
@@ -497,6 +495,7 @@ struct msm_rpc_endpoint *msm_rpcrouter_create_local_endpoint(dev_t dev)
 {
 	struct msm_rpc_endpoint *ept;
 	unsigned long flags;
+	int i;
 
 	ept = kmalloc(sizeof(struct msm_rpc_endpoint), GFP_KERNEL);
 	if (!ept)
@@ -531,6 +530,8 @@ struct msm_rpc_endpoint *msm_rpcrouter_create_local_endpoint(dev_t dev)
 	spin_lock_init(&ept->read_q_lock);
 	INIT_LIST_HEAD(&ept->reply_avail_q);
 	INIT_LIST_HEAD(&ept->reply_pend_q);
+	for (i = 0; i < ARRAY_SIZE(ept->reply_hash); i++)
+		INIT_HLIST_HEAD(&ept->reply_hash[i]);
 	spin_lock_init(&ept->reply_q_lock);
 	spin_lock_init(&ept->restart_lock);
 	init_waitqueue_head(&ept->restart_wait);
@@ -539,9 +540,13 @@ struct msm_rpc_endpoint *msm_rpcrouter_create_local_endpoint(dev_t dev)
 	wake_lock_init(&ept->reply_q_wake_lock, WAKE_LOCK_SUSPEND, "rpc_reply");
 	INIT_LIST_HEAD(&ept->incomplete);
 	spin_lock_init(&ept->incomplete_lock);
+	INIT_LIST_HEAD(&ept->async_q);
+	spin_lock_init(&ept->async_lock);
 
 	spin_lock_irqsave(&local_endpoints_lock, flags);
 	list_add_tail(&ept->list, &local_endpoints);
+	hlist_add_head(&ept->cid_hash, &local_endpoints_hash[
+			hash_32(ept->cid, RPCROUTER_EPT_HASH_BITS)]);
 	spin_unlock_irqrestore(&local_endpoints_lock, flags);
 	return ept;
 }
@@ -578,6 +583,7 @@ int msm_rpcrouter_destroy_local_endpoint(struct msm_rpc_endpoint *ept)
 	spin_lock_irqsave(&ept->reply_q_lock, flags);
 	list_for_each_entry_safe(reply, reply_tmp, &ept->reply_pend_q, list) {
 		list_del(&reply->list);
+		hlist_del(&reply->hash);
 		kfree(reply);
 	}
 	list_for_each_entry_safe(reply, reply_tmp, &ept->reply_avail_q, list) {
@@ -586,10 +592,13 @@ int msm_rpcrouter_destroy_local_endpoint(struct msm_rpc_endpoint *ept)
 	}
 	spin_unlock_irqrestore(&ept->reply_q_lock, flags);
 
+	rpcrouter_async_fail(ept, -ENOTCONN);
+
 	wake_lock_destroy(&ept->read_q_wake_lock);
 	wake_lock_destroy(&ept->reply_q_wake_lock);
 	spin_lock_irqsave(&local_endpoints_lock, flags);
 	list_del(&ept->list);
+	hlist_del(&ept->cid_hash);
 	spin_unlock_irqrestore(&local_endpoints_lock, flags);
 	kfree(ept);
 	return 0;
@@ -620,10 +629,12 @@ static int rpcrouter_create_remote_endpoint(uint32_t pid, uint32_t cid)
 static struct msm_rpc_endpoint *rpcrouter_lookup_local_endpoint(uint32_t cid)
 {
 	struct msm_rpc_endpoint *ept;
+	struct hlist_node *n;
 	unsigned long flags;
 
 	spin_lock_irqsave(&local_endpoints_lock, flags);
-	list_for_each_entry(ept, &local_endpoints, list) {
+	hlist_for_each_entry(ept, n, &local_endpoints_hash[
+			hash_32(cid, RPCROUTER_EPT_HASH_BITS)], cid_hash) {
 		if (ept->cid == cid) {
 			spin_unlock_irqrestore(&local_endpoints_lock, flags);
 			return ept;
@@ -890,6 +901,212 @@ static void *rr_malloc(unsigned sz)
 	return ptr;
 }
 
+/*
+ * Packet buffers
+ *
+ * Every fragment read off a transport takes a RPCROUTER_MSGSIZE_MAX
+ * buffer, and every new message a rr_packet. Both come from their own
+ * slab caches, and the fragments the router frees itself are kept on a
+ * short free list so the next packets don't go to the allocator at all.
+ * Single fragment messages are handed to the caller of msm_rpc_read(),
+ * who frees them with kfree(); that is fine for slab objects, they just
+ * don't make it back to the free list.
+ */
+#define RR_FRAG_POOL_MAX 16
+
+static struct kmem_cache *rr_frag_cache;
+static struct kmem_cache *rr_pkt_cache;
+
+static DEFINE_SPINLOCK(rr_frag_pool_lock);
+static struct rr_fragment *rr_frag_pool;
+static unsigned rr_frag_pool_cnt;
+static unsigned rr_frag_hits;
+static unsigned rr_frag_misses;
+
+static void *rr_cache_alloc(struct kmem_cache *cache)
+{
+	void *ptr = kmem_cache_alloc(cache, GFP_KERNEL);
+	if (ptr)
+		return ptr;
+
+	printk(KERN_ERR "rpcrouter: %s alloc failed, retrying...\n",
+	       kmem_cache_name(cache));
+	do {
+		ptr = kmem_cache_alloc(cache, GFP_KERNEL);
+	} while (!ptr);
+
+	return ptr;
+}
+
+static struct rr_fragment *rr_alloc_frag(void)
+{
+	struct rr_fragment *frag;
+	unsigned long flags;
+
+	spin_lock_irqsave(&rr_frag_pool_lock, flags);
+	frag = rr_frag_pool;
+	if (frag) {
+		rr_frag_pool = frag->next;
+		rr_frag_pool_cnt--;
+		rr_frag_hits++;
+	} else {
+		rr_frag_misses++;
+	}
+	spin_unlock_irqrestore(&rr_frag_pool_lock, flags);
+
+	if (!frag)
+		frag = rr_cache_alloc(rr_frag_cache);
+	frag->next = NULL;
+	return frag;
+}
+
+static void rr_free_frag(struct rr_fragment *frag)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&rr_frag_pool_lock, flags);
+	if (rr_frag_pool_cnt < RR_FRAG_POOL_MAX) {
+		frag->next = rr_frag_pool;
+		rr_frag_pool = frag;
+		rr_frag_pool_cnt++;
+		frag = NULL;
+	}
+	spin_unlock_irqrestore(&rr_frag_pool_lock, flags);
+
+	if (frag)
+		kmem_cache_free(rr_frag_cache, frag);
+}
+
+void msm_rpcrouter_free_frags(struct rr_fragment *frag)
+{
+	struct rr_fragment *next;
+
+	while (frag != NULL) {
+		next = frag->next;
+		rr_free_frag(frag);
+		frag = next;
+	}
+}
+
+static void rr_free_pkt(struct rr_packet *pkt)
+{
+	msm_rpcrouter_free_frags(pkt->first);
+	kmem_cache_free(rr_pkt_cache, pkt);
+}
+
+/*
+ * Async calls
+ *
+ * An async call sits on its endpoint's async_q until do_read_data()
+ * sees a reply with its xid, which is then handed to the call's work
+ * on rpcrouter_async_wq instead of going to the read queue. The call
+ * is only ever taken off async_q with async_lock held and its work is
+ * queued under the same lock, so once it is off the list flushing the
+ * work is enough to know it is finished.
+ */
+static struct workqueue_struct *rpcrouter_async_wq;
+
+static int msm_rpc_reply_status(struct rpc_reply_hdr *reply, int len)
+{
+	if (len < (3 * sizeof(uint32_t)))
+		return -EIO;
+	if (reply->reply_stat != 0)
+		return -EPERM;
+	if (reply->data.acc_hdr.accept_stat != 0)
+		return -EINVAL;
+	return len;
+}
+
+static void rpcrouter_async_work(struct work_struct *work)
+{
+	struct msm_rpc_async_call *call =
+		container_of(work, struct msm_rpc_async_call, work);
+	struct rr_fragment *frag = call->frag;
+	struct rr_fragment *f;
+	void *reply = NULL;
+	void *buf;
+	int rc = call->status;
+
+	call->frag = NULL;
+	if (frag) {
+		if (frag->next == NULL) {
+			reply = frag->data;
+		} else {
+			reply = kmalloc(rc, GFP_KERNEL);
+			if (!reply)
+				rc = -ENOMEM;
+			for (buf = reply, f = frag; reply && f; f = f->next) {
+				memcpy(buf, f->data, f->length);
+				buf += f->length;
+			}
+		}
+		if (reply)
+			rc = msm_rpc_reply_status(reply, rc);
+	}
+
+	/* the call may be gone as soon as func or the waiter has it */
+	if (call->func) {
+		call->func(call, rc < 0 ? NULL : reply, rc);
+	} else {
+		if (rc >= 0 && call->reply == NULL) {
+			rc = 0;
+		} else if (rc >= 0) {
+			if (rc > call->reply_size)
+				rc = -ENOMEM;
+			else
+				memcpy(call->reply, reply, rc);
+		}
+		call->status = rc;
+		complete(&call->done);
+	}
+
+	if (frag && frag->next)
+		kfree(reply);
+	msm_rpcrouter_free_frags(frag);
+}
+
+/* Hand a reply to the async call waiting for it, if there is one */
+static int rpcrouter_async_reply(struct msm_rpc_endpoint *ept,
+				 struct rr_packet *pkt)
+{
+	struct rpc_reply_hdr *reply = (void *) pkt->first->data;
+	struct msm_rpc_async_call *call;
+	unsigned long flags;
+
+	if (pkt->first->length < (2 * sizeof(uint32_t)) || reply->type == 0)
+		return 0;
+
+	spin_lock_irqsave(&ept->async_lock, flags);
+	list_for_each_entry(call, &ept->async_q, list) {
+		if (call->xid == reply->xid) {
+			list_del_init(&call->list);
+			call->frag = pkt->first;
+			call->status = pkt->length;
+			queue_work(rpcrouter_async_wq, &call->work);
+			spin_unlock_irqrestore(&ept->async_lock, flags);
+			kmem_cache_free(rr_pkt_cache, pkt);
+			return 1;
+		}
+	}
+	spin_unlock_irqrestore(&ept->async_lock, flags);
+
+	return 0;
+}
+
+static void rpcrouter_async_fail(struct msm_rpc_endpoint *ept, int status)
+{
+	struct msm_rpc_async_call *call, *tmp;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ept->async_lock, flags);
+	list_for_each_entry_safe(call, tmp, &ept->async_q, list) {
+		list_del_init(&call->list);
+		call->status = status;
+		queue_work(rpcrouter_async_wq, &call->work);
+	}
+	spin_unlock_irqrestore(&ept->async_lock, flags);
+}
+
 static int rr_read(struct rpcrouter_xprt_info *xprt_info,
 		   void *data, uint32_t len)
 {
@@ -1001,11 +1218,10 @@ static void do_read_data(struct work_struct *work)
 
 	hdr.size -= sizeof(pm);
 
-	frag = rr_malloc(sizeof(*frag));
-	frag->next = NULL;
+	frag = rr_alloc_frag();
 	frag->length = hdr.size;
 	if (rr_read(xprt_info, frag->data, hdr.size)) {
-		kfree(frag);
+		rr_free_frag(frag);
 		goto fail_io;
 	}
 
@@ -1047,7 +1263,7 @@ static void do_read_data(struct work_struct *work)
 	ept = rpcrouter_lookup_local_endpoint(hdr.dst_cid);
 	if (!ept) {
 		DIAG("no local ept for cid %08x\n", hdr.dst_cid);
-		kfree(frag);
+		rr_free_frag(frag);
 		goto done;
 	}
 
@@ -1076,7 +1292,7 @@ static void do_read_data(struct work_struct *work)
 	 * the incomplete list if this fragment is not a last fragment,
 	 * otherwise put it on the read queue.
 	 */
-	pkt = rr_malloc(sizeof(struct rr_packet));
+	pkt = rr_cache_alloc(rr_pkt_cache);
 	pkt->first = frag;
 	pkt->last = frag;
 	memcpy(&pkt->hdr, &hdr, sizeof(hdr));
@@ -1088,6 +1304,9 @@ static void do_read_data(struct work_struct *work)
 	}
 
 packet_complete:
+	if (rpcrouter_async_reply(ept, pkt))
+		goto done;
+
 	spin_lock_irqsave(&ept->read_q_lock, flags);
 	D("%s: take read lock on ept %p\n", __func__, ept);
 	wake_lock(&ept->read_q_wake_lock);
@@ -1358,15 +1577,24 @@ static int msm_rpc_write_pkt(
 	return needed;
 }
 
+/* Pending replies are hashed by xid, called with reply_q_lock held */
+static inline struct hlist_head *reply_hash(struct msm_rpc_endpoint *ept,
+					    uint32_t xid)
+{
+	return &ept->reply_hash[hash_32(xid, RPCROUTER_REPLY_HASH_BITS)];
+}
+
 static struct msm_rpc_reply *get_pend_reply(struct msm_rpc_endpoint *ept,
 					    uint32_t xid)
 {
 	unsigned long flags;
 	struct msm_rpc_reply *reply;
+	struct hlist_node *n;
 	spin_lock_irqsave(&ept->reply_q_lock, flags);
-	list_for_each_entry(reply, &ept->reply_pend_q, list) {
+	hlist_for_each_entry(reply, n, reply_hash(ept, xid), hash) {
 		if (reply->xid == xid) {
 			list_del(&reply->list);
+			hlist_del(&reply->hash);
 			spin_unlock_irqrestore(&ept->reply_q_lock, flags);
 			return reply;
 		}
@@ -1380,12 +1608,13 @@ void get_requesting_client(struct msm_rpc_endpoint *ept, uint32_t xid,
 {
 	unsigned long flags;
 	struct msm_rpc_reply *reply;
+	struct hlist_node *n;
 
 	if (!clnt_info)
 		return;
 
 	spin_lock_irqsave(&ept->reply_q_lock, flags);
-	list_for_each_entry(reply, &ept->reply_pend_q, list) {
+	hlist_for_each_entry(reply, n, reply_hash(ept, xid), hash) {
 		if (reply->xid == xid) {
 			clnt_info->pid = reply->pid;
 			clnt_info->cid = reply->cid;
@@ -1446,6 +1675,7 @@ static void set_pend_reply(struct msm_rpc_endpoint *ept,
 		D("%s: take reply lock on ept %p\n", __func__, ept);
 		wake_lock(&ept->reply_q_wake_lock);
 		list_add_tail(&reply->list, &ept->reply_pend_q);
+		hlist_add_head(&reply->hash, reply_hash(ept, reply->xid));
 		spin_unlock_irqrestore(&ept->reply_q_lock, flags);
 }
 
@@ -1613,7 +1843,7 @@ int msm_rpc_read(struct msm_rpc_endpoint *ept, void **buffer,
 		memcpy(buf, frag->data, frag->length);
 		next = frag->next;
 		buf += frag->length;
-		kfree(frag);
+		rr_free_frag(frag);
 		frag = next;
 	}
 
@@ -1631,6 +1861,17 @@ int msm_rpc_call(struct msm_rpc_endpoint *ept, uint32_t proc,
 }
 EXPORT_SYMBOL(msm_rpc_call);
 
+static void msm_rpc_setup_call(struct msm_rpc_endpoint *ept,
+			       struct rpc_request_hdr *req, uint32_t proc)
+{
+	memset(req, 0, sizeof(*req));
+	req->xid = cpu_to_be32(atomic_add_return(1, &next_xid));
+	req->rpc_vers = cpu_to_be32(2);
+	req->prog = ept->dst_prog;
+	req->vers = ept->dst_vers;
+	req->procedure = cpu_to_be32(proc);
+}
+
 int msm_rpc_call_reply(struct msm_rpc_endpoint *ept, uint32_t proc,
 		       void *_request, int request_size,
 		       void *_reply, int reply_size,
@@ -1638,6 +1879,7 @@ int msm_rpc_call_reply(struct msm_rpc_endpoint *ept, uint32_t proc,
 {
 	struct rpc_request_hdr *req = _request;
 	struct rpc_reply_hdr *reply;
+	u64 start;
 	int rc;
 
 	if (request_size < sizeof(*req))
@@ -1646,21 +1888,17 @@ int msm_rpc_call_reply(struct msm_rpc_endpoint *ept, uint32_t proc,
 	if (ept->dst_pid == 0xffffffff)
 		return -ENOTCONN;
 
-	memset(req, 0, sizeof(*req));
-	req->xid = cpu_to_be32(atomic_add_return(1, &next_xid));
-	req->rpc_vers = cpu_to_be32(2);
-	req->prog = ept->dst_prog;
-	req->vers = ept->dst_vers;
-	req->procedure = cpu_to_be32(proc);
+	msm_rpc_setup_call(ept, req, proc);
 
+	start = msm_latency_start(MSM_LATENCY_RPC, req->xid);
 	rc = msm_rpc_write(ept, req, request_size);
 	if (rc < 0)
-		return rc;
+		goto out;
 
 	for (;;) {
 		rc = msm_rpc_read(ept, (void*) &reply, -1, timeout);
 		if (rc < 0)
-			return rc;
+			goto out;
 		if (rc < (3 * sizeof(uint32_t))) {
 			rc = -EIO;
 			break;
@@ -1678,14 +1916,9 @@ int msm_rpc_call_reply(struct msm_rpc_endpoint *ept, uint32_t proc,
 			kfree(reply);
 			continue;
 		}
-		if (reply->reply_stat != 0) {
-			rc = -EPERM;
-			break;
-		}
-		if (reply->data.acc_hdr.accept_stat != 0) {
-			rc = -EINVAL;
+		rc = msm_rpc_reply_status(reply, rc);
+		if (rc < 0)
 			break;
-		}
 		if (_reply == NULL) {
 			rc = 0;
 			break;
@@ -1698,10 +1931,92 @@ int msm_rpc_call_reply(struct msm_rpc_endpoint *ept, uint32_t proc,
 		break;
 	}
 	kfree(reply);
+out:
+	msm_latency_done(MSM_LATENCY_RPC, req->xid, start, rc);
 	return rc;
 }
 EXPORT_SYMBOL(msm_rpc_call_reply);
 
+int msm_rpc_call_async(struct msm_rpc_endpoint *ept, uint32_t proc,
+		       void *_request, int request_size,
+		       struct msm_rpc_async_call *call)
+{
+	struct rpc_request_hdr *req = _request;
+	unsigned long flags;
+	int rc;
+
+	if (request_size < sizeof(*req))
+		return -ETOOSMALL;
+
+	if (ept->dst_pid == 0xffffffff)
+		return -ENOTCONN;
+
+	msm_rpc_setup_call(ept, req, proc);
+
+	call->xid = req->xid;
+	call->frag = NULL;
+	call->status = 0;
+	INIT_WORK(&call->work, rpcrouter_async_work);
+	init_completion(&call->done);
+
+	/* queue it before sending, the reply can beat msm_rpc_write() */
+	spin_lock_irqsave(&ept->async_lock, flags);
+	list_add_tail(&call->list, &ept->async_q);
+	spin_unlock_irqrestore(&ept->async_lock, flags);
+
+	rc = msm_rpc_write(ept, req, request_size);
+	if (rc < 0) {
+		spin_lock_irqsave(&ept->async_lock, flags);
+		if (list_empty(&call->list)) {
+			/* failed by a restart meanwhile, that gets reported */
+			rc = 0;
+		} else {
+			list_del_init(&call->list);
+		}
+		spin_unlock_irqrestore(&ept->async_lock, flags);
+		return rc;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(msm_rpc_call_async);
+
+int msm_rpc_call_cancel(struct msm_rpc_endpoint *ept,
+			struct msm_rpc_async_call *call)
+{
+	unsigned long flags;
+	int rc = -EALREADY;
+
+	spin_lock_irqsave(&ept->async_lock, flags);
+	if (!list_empty(&call->list)) {
+		list_del_init(&call->list);
+		rc = 0;
+	}
+	spin_unlock_irqrestore(&ept->async_lock, flags);
+
+	/* too late, wait for it to be completed */
+	if (rc)
+		flush_work(&call->work);
+
+	return rc;
+}
+EXPORT_SYMBOL(msm_rpc_call_cancel);
+
+int msm_rpc_call_wait(struct msm_rpc_endpoint *ept,
+		      struct msm_rpc_async_call *call, long timeout)
+{
+	if (timeout < 0) {
+		wait_for_completion(&call->done);
+	} else if (!wait_for_completion_timeout(&call->done, timeout)) {
+		if (msm_rpc_call_cancel(ept, call) == 0)
+			return -ETIMEDOUT;
+		wait_for_completion(&call->done);
+	}
+
+	return call->status;
+}
+EXPORT_SYMBOL(msm_rpc_call_wait);
+
 
 static inline int ept_packet_available(struct msm_rpc_endpoint *ept)
 {
@@ -1826,7 +2141,7 @@ int __msm_rpc_read(struct msm_rpc_endpoint *ept,
 		set_pend_reply(ept, reply);
 	}
 
-	kfree(pkt);
+	kmem_cache_free(rr_pkt_cache, pkt);
 
 	IO("READ on ept %p (%d bytes)\n", ept, rc);
 
@@ -2208,6 +2523,22 @@ static int dump_msm_rpc_endpoint(char *buf, int max)
 	return i;
 }
 
+static int dump_pool_stats(char *buf, int max)
+{
+	unsigned long flags;
+	unsigned hits, misses, pooled;
+
+	spin_lock_irqsave(&rr_frag_pool_lock, flags);
+	hits = rr_frag_hits;
+	misses = rr_frag_misses;
+	pooled = rr_frag_pool_cnt;
+	spin_unlock_irqrestore(&rr_frag_pool_lock, flags);
+
+	return scnprintf(buf, max, "frag hits: %u\nfrag misses: %u\n"
+			 "frags pooled: %u/%u\n",
+			 hits, misses, pooled, RR_FRAG_POOL_MAX);
+}
+
 #define DEBUG_BUFMAX 4096
 static char debug_buffer[DEBUG_BUFMAX];
 
@@ -2251,6 +2582,8 @@ static void debugfs_init(void)
 		     dump_remote_endpoints);
 	debug_create("dump_servers", 0444, dent,
 		     dump_servers);
+	debug_create("dump_pool_stats", 0444, dent,
+		     dump_pool_stats);
 
 }
 
@@ -2334,6 +2667,21 @@ static int __init rpcrouter_init(void)
 {
 	int ret;
 
+	rr_frag_cache = kmem_cache_create("rpcrouter_frag",
+					  sizeof(struct rr_fragment), 0, 0, NULL);
+	rr_pkt_cache = kmem_cache_create("rpcrouter_pkt",
+					 sizeof(struct rr_packet), 0, 0, NULL);
+	rpcrouter_async_wq = create_singlethread_workqueue("rpcrouter_async");
+	if (!rr_frag_cache || !rr_pkt_cache || !rpcrouter_async_wq) {
+		if (rr_frag_cache)
+			kmem_cache_destroy(rr_frag_cache);
+		if (rr_pkt_cache)
+			kmem_cache_destroy(rr_pkt_cache);
+		if (rpcrouter_async_wq)
+			destroy_workqueue(rpcrouter_async_wq);
+		return -ENOMEM;
+	}
+
 	msm_rpc_connect_timeout_ms = 0;
 	smd_rpcrouter_debug_mask |= SMEM_LOG;
 	debugfs_init();
@@ -34,6 +34,7 @@
 #define RPCROUTER_PROCESSORS_MAX		4
 #define RPCROUTER_MSGSIZE_MAX			512
 #define RPCROUTER_PEND_REPLIES_MAX		32
+#define RPCROUTER_REPLY_HASH_BITS		3
 
 #define RPCROUTER_CLIENT_BCAST_ID		0xffffffff
 #define RPCROUTER_ROUTER_ADDRESS		0xfffffffe
@@ -145,6 +146,7 @@ struct rr_remote_endpoint {
 
 struct msm_rpc_reply {
 	struct list_head list;
+	struct hlist_node hash;		/* in ept->reply_hash while pending */
 	uint32_t pid;
 	uint32_t cid;
 	uint32_t prog; /* be32 */
@@ -154,6 +156,7 @@ struct msm_rpc_reply {
 
 struct msm_rpc_endpoint {
 	struct list_head list;
+	struct hlist_node cid_hash;
 
 	/* incomplete packets waiting for assembly */
 	struct list_head incomplete;
@@ -187,11 +190,16 @@ struct msm_rpc_endpoint {
 
 	/* reply queue for inbound messages */
 	struct list_head reply_pend_q;
+	struct hlist_head reply_hash[1 << RPCROUTER_REPLY_HASH_BITS];
 	struct list_head reply_avail_q;
 	spinlock_t reply_q_lock;
 	uint32_t reply_cnt;
 	struct wake_lock reply_q_wake_lock;
 
+	/* async calls waiting for their reply */
+	struct list_head async_q;
+	spinlock_t async_lock;
+
 	/* device node if this endpoint is accessed via userspace */
 	dev_t dev;
 };
@@ -219,6 +227,8 @@ int __msm_rpc_read(struct msm_rpc_endpoint *ept,
 		   struct rr_fragment **frag,
 		   unsigned len, long timeout);
 
+void msm_rpcrouter_free_frags(struct rr_fragment *frag);
+
 int msm_rpcrouter_close(void);
 struct msm_rpc_endpoint *msm_rpcrouter_create_local_endpoint(dev_t dev);
 int msm_rpcrouter_destroy_local_endpoint(struct msm_rpc_endpoint *ept);
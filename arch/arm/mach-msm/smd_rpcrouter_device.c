@@ -166,17 +166,15 @@ static ssize_t rpcrouter_read(struct file *filp, char __user *buf,
 
 	count = rc;
 
-	while (frag != NULL) {		
-		if (copy_to_user(buf, frag->data, frag->length)) {
+	for (next = frag; next != NULL; next = next->next) {
+		if (copy_to_user(buf, next->data, next->length)) {
 			printk(KERN_ERR
 			       "rpcrouter: could not copy all read data to user!\n");
 			rc = -EFAULT;
 		}
-		buf += frag->length;
-		next = frag->next;
-		kfree(frag);
-		frag = next;
+		buf += next->length;
 	}
+	msm_rpcrouter_free_frags(frag);
 
 	return rc;
 }
@@ -174,6 +174,84 @@ int xdr_recv_bytes(struct msm_rpc_xdr *xdr, void **data,
 	return 0;
 }
 
+/*
+ * Fixed layout structures
+ *
+ * An xdr_desc lists the members of a C structure in wire order. The
+ * buffer is checked once for the whole structure and the members are
+ * then converted in one pass, instead of a call, a bounds check and a
+ * byte swap per field.
+ */
+static inline uint32_t xdr_field_get(const void *p, const struct xdr_field *f)
+{
+	switch (f->size) {
+	case 1:
+		return f->is_signed ? (int32_t)*(int8_t *)p : *(uint8_t *)p;
+	case 2:
+		return f->is_signed ? (int32_t)*(int16_t *)p : *(uint16_t *)p;
+	default:
+		return *(uint32_t *)p;
+	}
+}
+
+static inline void xdr_field_put(void *p, const struct xdr_field *f,
+				 uint32_t value)
+{
+	switch (f->size) {
+	case 1:
+		*(uint8_t *)p = value;
+		break;
+	case 2:
+		*(uint16_t *)p = value;
+		break;
+	default:
+		*(uint32_t *)p = value;
+		break;
+	}
+}
+
+int xdr_send_struct(struct msm_rpc_xdr *xdr, const struct xdr_desc *desc,
+		    const void *data)
+{
+	const struct xdr_field *f = desc->fields;
+	const struct xdr_field *end = f + desc->nfields;
+	uint32_t len = desc->nfields * sizeof(uint32_t);
+	uint32_t *out;
+
+	if ((xdr->out_index + len) > xdr->out_size) {
+		pr_err("%s: xdr out buffer full\n", __func__);
+		return -1;
+	}
+
+	out = xdr->out_buf + xdr->out_index;
+	for (; f < end; f++)
+		*out++ = cpu_to_be32(xdr_field_get(data + f->offset, f));
+
+	xdr->out_index += len;
+	return 0;
+}
+
+int xdr_recv_struct(struct msm_rpc_xdr *xdr, const struct xdr_desc *desc,
+		    void *data)
+{
+	const struct xdr_field *f = desc->fields;
+	const struct xdr_field *end = f + desc->nfields;
+	uint32_t len = desc->nfields * sizeof(uint32_t);
+	uint32_t *in;
+
+	if ((xdr->in_index + len) > xdr->in_size) {
+		pr_err("%s: xdr in buffer full\n", __func__);
+		return -1;
+	}
+
+	in = xdr->in_buf + xdr->in_index;
+	for (; f < end; f++)
+		xdr_field_put(data + f->offset, f, be32_to_cpu(*in++));
+
+	xdr->in_index += len;
+	return 0;
+}
+
 int xdr_send_pointer(struct msm_rpc_xdr *xdr, void **obj,
 		     uint32_t obj_size, void *xdr_op)
 {
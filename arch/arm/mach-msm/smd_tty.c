@@ -20,6 +20,7 @@
 #include <linux/cdev.h>
 #include <linux/device.h>
 #include <linux/interrupt.h>
+#include <linux/workqueue.h>
 #include <linux/delay.h>
 #include <linux/wakelock.h>
 #include <linux/platform_device.h>
@@ -42,12 +43,28 @@ static uint smd_tty_modem_wait;
 module_param_named(modem_wait, smd_tty_modem_wait,
 			uint, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Low latency channels are read from a workqueue instead of a tasklet,
+ * which lets the tty push received data straight to the line discipline
+ * rather than a jiffy later from keventd. Takes effect on the next open.
+ */
+static int smd_tty_low_latency = 1;
+module_param_named(low_latency, smd_tty_low_latency,
+			bool, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static uint smd_tty_buf_full;
+module_param_named(buf_full, smd_tty_buf_full, uint, S_IRUGO);
+static uint smd_tty_buf_retries;
+module_param_named(buf_retries, smd_tty_buf_retries, uint, S_IRUGO);
+
 struct smd_tty_info {
 	smd_channel_t *ch;
 	struct tty_struct *tty;
 	struct wake_lock wake_lock;
 	int open_count;
 	struct tasklet_struct tty_tsklt;
+	struct work_struct tty_work;
+	int low_latency;
 	struct timer_list buf_req_timer;
 	struct completion ch_allocated;
 	struct platform_driver driver;
@@ -63,18 +80,35 @@ static char *smd_ch_name[] = {
 };
 
 
+/* The AT command channel: RIL waits on every reply */
+static const char smd_ch_low_latency[MAX_SMD_TTYS] = {
+	[0] = 1,
+};
+
 static struct smd_tty_info smd_tty[MAX_SMD_TTYS];
+static struct workqueue_struct *smd_tty_wq;
+
+static void smd_tty_kick(struct smd_tty_info *info)
+{
+	if (info->low_latency)
+		queue_work(smd_tty_wq, &info->tty_work);
+	else
+		tasklet_hi_schedule(&info->tty_tsklt);
+}
 
 static void buf_req_retry(unsigned long param)
 {
 	struct smd_tty_info *info = (struct smd_tty_info *)param;
-	tasklet_hi_schedule(&info->tty_tsklt);
+
+	smd_tty_buf_retries++;
+	smd_tty_kick(info);
 }
 
 static void smd_tty_read(unsigned long param)
 {
 	unsigned char *ptr;
 	int avail;
+	int pending = 0;
 	struct smd_tty_info *info = (struct smd_tty_info *)param;
 	struct tty_struct *tty = info->tty;
 
@@ -92,6 +126,9 @@ static void smd_tty_read(unsigned long param)
 
 		avail = tty_prepare_flip_string(tty, &ptr, avail);
 		if (avail <= 0) {
+			smd_tty_buf_full++;
+			if (pending)
+				tty_flip_buffer_push(tty);
 			if (!timer_pending(&info->buf_req_timer)) {
 				init_timer(&info->buf_req_timer);
 				info->buf_req_timer.expires = jiffies +
@@ -112,13 +149,25 @@ static void smd_tty_read(unsigned long param)
 		}
 
 		wake_lock_timeout(&info->wake_lock, HZ / 2);
-		tty_flip_buffer_push(tty);
+		pending = 1;
 	}
 
+	/* one push for everything read in this pass */
+	if (pending)
+		tty_flip_buffer_push(tty);
+
 	/* XXX only when writable and necessary */
 	tty_wakeup(tty);
 }
 
+static void smd_tty_read_work(struct work_struct *work)
+{
+	struct smd_tty_info *info = container_of(work, struct smd_tty_info,
+						 tty_work);
+
+	smd_tty_read((unsigned long)info);
+}
+
 static void smd_tty_notify(void *priv, unsigned event)
 {
 	struct smd_tty_info *info = priv;
@@ -126,7 +175,7 @@ static void smd_tty_notify(void *priv, unsigned event)
 	if (event != SMD_EVENT_DATA)
 		return;
 
-	tasklet_hi_schedule(&info->tty_tsklt);
+	smd_tty_kick(info);
 }
 
 static uint32_t is_modem_smsm_inited(void)
@@ -198,6 +247,10 @@ static int smd_tty_open(struct tty_struct *tty, struct file *f)
 		info->tty = tty;
 		tasklet_init(&info->tty_tsklt, smd_tty_read,
 			     (unsigned long)info);
+		INIT_WORK(&info->tty_work, smd_tty_read_work);
+		info->low_latency = smd_tty_low_latency && smd_tty_wq &&
+				    smd_ch_low_latency[n];
+		tty->low_latency = info->low_latency;
 		wake_lock_init(&info->wake_lock, WAKE_LOCK_SUSPEND,
 				smd_ch_name[n]);
 		if (!info->ch) {
@@ -228,6 +281,7 @@ static void smd_tty_close(struct tty_struct *tty, struct file *f)
 	if (--info->open_count == 0) {
 		if (info->tty) {
 			tasklet_kill(&info->tty_tsklt);
+			cancel_work_sync(&info->tty_work);
 			wake_lock_destroy(&info->wake_lock);
 			info->tty = 0;
 		}
@@ -273,7 +327,7 @@ static int smd_tty_chars_in_buffer(struct tty_struct *tty)
 static void smd_tty_unthrottle(struct tty_struct *tty)
 {
 	struct smd_tty_info *info = tty->driver_data;
-	tasklet_hi_schedule(&info->tty_tsklt);
+	smd_tty_kick(info);
 	return;
 }
 
@@ -346,6 +400,9 @@ static int __init smd_tty_init(void)
 	ret = tty_register_driver(smd_tty_driver);
 	if (ret) return ret;
 
+	/* without it every channel is read from its tasklet */
+	smd_tty_wq = create_rt_workqueue("smd_tty");
+
 	/* this should be dynamic */
 	tty_register_device(smd_tty_driver, 0, 0);
 	tty_register_device(smd_tty_driver, 7, 0);
@@ -406,6 +463,8 @@ out:
 	tty_unregister_device(smd_tty_driver, 21);
 	tty_unregister_device(smd_tty_driver, 27);
 	tty_unregister_device(smd_tty_driver, 36);
+	if (smd_tty_wq)
+		destroy_workqueue(smd_tty_wq);
 	tty_unregister_driver(smd_tty_driver);
 	put_tty_driver(smd_tty_driver);
 	return ret;
@@ -42,6 +42,11 @@ when                who               what, where, why                comment ta
 #include <linux/wait.h>
 #include <linux/delay.h>
 #include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <linux/timer.h>
+#include <linux/notifier.h>
 
 #include <mach/msm_iomap.h>
 #include <mach/smem_log.h>
@@ -159,6 +164,33 @@ static uint32_t log_area_offset[NUM] = {
   SMEM_LOG_POWER_OFFSET
 };
 
+/* What mmap() exposes: the control block and all three logs */
+#define SMEM_LOG_MAP_SIZE \
+	PAGE_ALIGN(SMEM_LOG_POWER_OFFSET + SMEM_POWER_LOG_EVENTS_SIZE)
+
+/*
+ * Apps events for the general log are staged per cpu and merged into the
+ * shared log in batches, so the remote spinlock shared with the modem is
+ * taken once per batch instead of once per event. A batch is merged when
+ * the stage fills up, from a deferrable timer, before the log is read and
+ * at panic. Every entry keeps the timetick it was logged with, so apps
+ * entries may land after modem entries with a later timetick.
+ */
+#define SMEM_LOG_STAGE_ENTRIES	64
+#define SMEM_LOG_STAGE_INTERVAL	(HZ / 4)
+
+struct smem_log_stage {
+	spinlock_t lock;
+	unsigned int count;
+	struct {
+		struct smem_log_item item[2];
+		int num;
+	} rec[SMEM_LOG_STAGE_ENTRIES];
+};
+
+static DEFINE_PER_CPU(struct smem_log_stage, smem_log_stage);
+static struct timer_list smem_log_stage_timer;
+
 #define SMEM_MAGIC  0xdeadbeef
 
 #if defined(CONFIG_DEBUG_FS)
@@ -729,6 +761,27 @@ static void smem_log_event_from_user(struct smem_log_inst *inst,
 	remote_spin_unlock_irqrestore(inst->remote_spinlock, flags);
 }
 
+/* Stores one or two (event6) items, the remote spinlock must be held */
+static void smem_log_put(struct smem_log_item __iomem *events,
+			 uint32_t __iomem *_idx, int num,
+			 const struct smem_log_item *item, int n)
+{
+	uint32_t idx;
+	uint32_t next_idx;
+
+	idx = *_idx;
+
+	if (idx < (num - (n - 1))) {
+		memcpy(&events[idx],
+		       item, n * sizeof(*item));
+	}
+
+	next_idx = idx + n;
+	if (next_idx >= num)
+		next_idx = 0;
+	*_idx = next_idx;
+}
+
 static void _smem_log_event(
 	struct smem_log_item __iomem *events,
 	uint32_t __iomem *_idx,
@@ -738,8 +791,6 @@ static void _smem_log_event(
 	uint32_t data3)
 {
 	struct smem_log_item item;
-	uint32_t idx;
-	uint32_t next_idx;
 	unsigned long flags;
 
 	item.timetick = read_timestamp();
@@ -749,19 +800,7 @@ static void _smem_log_event(
 	item.data3 = data3;
 
 	remote_spin_lock_irqsave(lock, flags);
-
-	idx = *_idx;
-
-	if (idx < num) {
-		memcpy(&events[idx],
-		       &item, sizeof(item));
-	}
-
-	next_idx = idx + 1;
-	if (next_idx >= num)
-		next_idx = 0;
-	*_idx = next_idx;
-
+	smem_log_put(events, _idx, num, &item, 1);
 	remote_spin_unlock_irqrestore(lock, flags);
 }
 
@@ -775,8 +814,6 @@ static void _smem_log_event6(
 	uint32_t data6)
 {
 	struct smem_log_item item[2];
-	uint32_t idx;
-	uint32_t next_idx;
 	unsigned long flags;
 
 	item[0].timetick = read_timestamp();
@@ -791,41 +828,110 @@ static void _smem_log_event6(
 	item[1].data3 = data6;
 
 	remote_spin_lock_irqsave(lock, flags);
+	smem_log_put(events, _idx, num, item, 2);
+	remote_spin_unlock_irqrestore(lock, flags);
+}
 
-	idx = *_idx;
+/* Called with the stage lock held and interrupts off */
+static void smem_log_stage_merge(struct smem_log_stage *st)
+{
+	unsigned int i;
 
-	if (idx < (num-1)) {
-		memcpy(&events[idx],
-		       &item, sizeof(item));
+	if (!st->count)
+		return;
+
+	remote_spin_lock(inst[GEN].remote_spinlock);
+	for (i = 0; i < st->count; i++)
+		smem_log_put(inst[GEN].events, inst[GEN].idx,
+			     SMEM_LOG_NUM_ENTRIES,
+			     st->rec[i].item, st->rec[i].num);
+	remote_spin_unlock(inst[GEN].remote_spinlock);
+	st->count = 0;
+}
+
+static void smem_log_merge_all(void)
+{
+	struct smem_log_stage *st;
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		st = &per_cpu(smem_log_stage, cpu);
+		spin_lock_irqsave(&st->lock, flags);
+		smem_log_stage_merge(st);
+		spin_unlock_irqrestore(&st->lock, flags);
 	}
+}
 
-	next_idx = idx + 2;
-	if (next_idx >= num)
-		next_idx = 0;
-	*_idx = next_idx;
+static void smem_log_stage_event(const struct smem_log_item *item, int n)
+{
+	struct smem_log_stage *st;
+	unsigned long flags;
 
-	remote_spin_unlock_irqrestore(lock, flags);
+	local_irq_save(flags);
+	st = &__get_cpu_var(smem_log_stage);
+	spin_lock(&st->lock);
+	memcpy(st->rec[st->count].item, item, n * sizeof(*item));
+	st->rec[st->count].num = n;
+	if (++st->count == SMEM_LOG_STAGE_ENTRIES)
+		smem_log_stage_merge(st);
+	spin_unlock(&st->lock);
+	local_irq_restore(flags);
 }
 
+static void smem_log_stage_timer_fn(unsigned long data)
+{
+	smem_log_merge_all();
+	mod_timer(&smem_log_stage_timer, jiffies + SMEM_LOG_STAGE_INTERVAL);
+}
+
+static int smem_log_panic(struct notifier_block *this, unsigned long event,
+			  void *ptr)
+{
+	smem_log_merge_all();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block smem_log_panic_nb = {
+	.notifier_call = smem_log_panic,
+};
+
 void smem_log_event(uint32_t id, uint32_t data1, uint32_t data2,
 		    uint32_t data3)
 {
-	if (smem_log_enable)
-		_smem_log_event(inst[GEN].events, inst[GEN].idx,
-				inst[GEN].remote_spinlock,
-				SMEM_LOG_NUM_ENTRIES, id,
-				data1, data2, data3);
+	struct smem_log_item item;
+
+	if (!smem_log_enable)
+		return;
+
+	item.timetick = read_timestamp();
+	item.identifier = id;
+	item.data1 = data1;
+	item.data2 = data2;
+	item.data3 = data3;
+	smem_log_stage_event(&item, 1);
 }
 
 void smem_log_event6(uint32_t id, uint32_t data1, uint32_t data2,
 		     uint32_t data3, uint32_t data4, uint32_t data5,
 		     uint32_t data6)
 {
-	if (smem_log_enable)
-		_smem_log_event6(inst[GEN].events, inst[GEN].idx,
-				 inst[GEN].remote_spinlock,
-				 SMEM_LOG_NUM_ENTRIES, id,
-				 data1, data2, data3, data4, data5, data6);
+	struct smem_log_item item[2];
+
+	if (!smem_log_enable)
+		return;
+
+	item[0].timetick = read_timestamp();
+	item[0].identifier = id;
+	item[0].data1 = data1;
+	item[0].data2 = data2;
+	item[0].data3 = data3;
+	item[1].identifier = item[0].identifier;
+	item[1].timetick = item[0].timetick;
+	item[1].data1 = data4;
+	item[1].data2 = data5;
+	item[1].data3 = data6;
+	smem_log_stage_event(item, 2);
 }
 
 void smem_log_event_to_static(uint32_t id, uint32_t data1, uint32_t data2,
@@ -914,6 +1020,7 @@ int a9_log_init(void)
 static int _smem_log_init(void)
 {
 	int ret;
+	int cpu;
 
 	/* caozy_log_20100306 */
 	log_info = (smem_log_info *)ioremap(MSM_SMEM_RAM_PHYS, MSM_SMEM_RAM_SIZE);
@@ -975,6 +1082,18 @@ static int _smem_log_init(void)
 	if (ret)
 		return ret;
 
+	/* Only once, SMSM_INIT comes again after a modem restart */
+	if (!smem_log_stage_timer.function) {
+		for_each_possible_cpu(cpu)
+			spin_lock_init(&per_cpu(smem_log_stage, cpu).lock);
+		init_timer_deferrable(&smem_log_stage_timer);
+		smem_log_stage_timer.function = smem_log_stage_timer_fn;
+		mod_timer(&smem_log_stage_timer,
+			  jiffies + SMEM_LOG_STAGE_INTERVAL);
+		atomic_notifier_chain_register(&panic_notifier_list,
+					       &smem_log_panic_nb);
+	}
+
 	init_syms();
 #ifdef ZTE_DUMP_A9LOG//zhengchao_a9log_20100925
 	a9_log_init();
@@ -994,6 +1113,7 @@ static ssize_t smem_log_read_bin(struct file *fp, char __user *buf,
 
 	inst = fp->private_data;
 
+	smem_log_merge_all();
 	remote_spin_lock_irqsave(inst->remote_spinlock, flags);
 
 	orig_idx = *inst->idx;
@@ -1044,6 +1164,7 @@ static ssize_t smem_log_read(struct file *fp, char __user *buf,
 
 	inst = fp->private_data;
 
+	smem_log_merge_all();
 	remote_spin_lock_irqsave(inst->remote_spinlock, flags);
 
 	orig_idx = *inst->idx;
@@ -1191,6 +1312,29 @@ static int smem_log_release(struct inode *ip, struct file *fp)
 	return 0;
 }
 
+/*
+ * Maps the control block and the logs read-only, uncached like the
+ * modem sees them. The host tool issues SMIOC_FLUSH before reading to
+ * merge what the apps side still has staged.
+ */
+static int smem_log_mmap(struct file *fp, struct vm_area_struct *vma)
+{
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff || size > SMEM_LOG_MAP_SIZE)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_IO | VM_RESERVED;
+	vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+
+	smem_log_merge_all();
+	return remap_pfn_range(vma, vma->vm_start,
+			       MSM_SMEM_RAM_PHYS >> PAGE_SHIFT, size,
+			       vma->vm_page_prot);
+}
+
 static int smem_log_ioctl(struct inode *ip, struct file *fp,
 			  unsigned int cmd, unsigned long arg);
 
@@ -1201,6 +1345,7 @@ static const struct file_operations smem_log_fops = {
 	.open = smem_log_open,
 	.release = smem_log_release,
 	.ioctl = smem_log_ioctl,
+	.mmap = smem_log_mmap,
 };
 
 static const struct file_operations smem_log_bin_fops = {
@@ -1210,6 +1355,7 @@ static const struct file_operations smem_log_bin_fops = {
 	.open = smem_log_open,
 	.release = smem_log_release,
 	.ioctl = smem_log_ioctl,
+	.mmap = smem_log_mmap,
 };
 
 static int smem_log_ioctl(struct inode *ip, struct file *fp,
@@ -1242,6 +1388,9 @@ static int smem_log_ioctl(struct inode *ip, struct file *fp,
 		else
 			return -EINVAL;
 		break;
+	case SMIOC_FLUSH:
+		smem_log_merge_all();
+		break;
 	}
 
 	return 0;
@@ -1922,8 +2071,10 @@ static ssize_t debug_read(struct file *file, char __user *buf,
 		if (!debug_buffer)
 			return 0;
 	}
-	if (!(*ppos))
+	if (!(*ppos)) {
+		smem_log_merge_all();
 		bsize = fill(debug_buffer, EVENTS_PRINT_SIZE, 0);
+	}
 	DBG("%s: count %d ppos %d\n", __func__, count, (unsigned int)*ppos);
 	r =  simple_read_from_buffer(buf, count, ppos, debug_buffer,
 				     bsize);
@@ -1944,6 +2095,7 @@ static ssize_t debug_read_cont(struct file *file, char __user *buf,
 	int bsize;
 	if (!buffer)
 		return -ENOMEM;
+	smem_log_merge_all();
 	bsize = fill(buffer, count, 1);
 	DBG("%s: count %d bsize %d\n", __func__, count, bsize);
 	if (copy_to_user(buf, buffer, bsize)) {
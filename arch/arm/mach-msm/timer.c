@@ -19,9 +19,11 @@
 #include <linux/irq.h>
 #include <linux/clk.h>
 #include <linux/clockchips.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/io.h>
 #include <linux/percpu.h>
+#include <linux/seq_file.h>
 
 #include <asm/mach/time.h>
 #include <mach/msm_iomap.h>
@@ -38,6 +40,18 @@ enum {
 static int msm_timer_debug_mask;
 module_param_named(debug_mask, msm_timer_debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Alarms at least coalesce_min_us away are pushed back to the next multiple
+ * of coalesce_us of the counter, so timers that expire close to each other
+ * share one interrupt, and one wakeup from power collapse. An alarm is late
+ * by less than coalesce_us, a small fraction of the time it waited for.
+ * coalesce_us=0 programs every alarm as asked.
+ */
+static int msm_timer_coalesce_us = 1000;
+module_param_named(coalesce_us, msm_timer_coalesce_us, int, S_IRUGO | S_IWUSR | S_IWGRP);
+static int msm_timer_coalesce_min_us = 20000;
+module_param_named(coalesce_min_us, msm_timer_coalesce_min_us, int, S_IRUGO | S_IWUSR | S_IWGRP);
+
 #if defined(CONFIG_ARCH_MSM7X30) || defined(CONFIG_ARCH_MSM8X60)
 #define MSM_GPT_BASE (MSM_TMR_BASE + 0x4)
 #define MSM_DGT_BASE (MSM_TMR_BASE + 0x24)
@@ -123,6 +137,9 @@ static void msm_timer_set_mode(enum clock_event_mode mode,
 			       struct clock_event_device *evt);
 static int msm_timer_set_next_event(unsigned long cycles,
 				    struct clock_event_device *evt);
+static int msm_timer_program_alarm(unsigned long cycles,
+				   struct clock_event_device *evt,
+				   bool coalesce);
 
 enum {
 	MSM_CLOCK_FLAGS_UNSTABLE_COUNT = 1U << 0,
@@ -162,6 +179,16 @@ struct msm_clock_percpu_data {
 	u64                       last_sync_jiffies;
 };
 
+/* Per clock counters, in debugfs msm_timer/stats */
+struct msm_timer_stats {
+	unsigned int set;		/* alarms programmed */
+	unsigned int coalesced;		/* alarms moved to the coalescing grid */
+	unsigned int expired;		/* alarms already expired when set */
+	unsigned int irqs;		/* alarm interrupts */
+	unsigned int wake_timer;	/* power collapse ended by the alarm */
+	unsigned int wake_other;	/* power collapse ended by another irq */
+};
+
 struct msm_timer_sync_data_t {
 	struct msm_clock *clock;
 	uint32_t         timeout;
@@ -243,11 +270,16 @@ static DEFINE_PER_CPU(struct msm_clock_percpu_data[NR_TIMERS],
 
 static DEFINE_PER_CPU(struct msm_clock *, msm_active_clock);
 
+static struct msm_timer_stats msm_timer_stats[NR_TIMERS];
+
 static irqreturn_t msm_timer_interrupt(int irq, void *dev_id)
 {
 	struct clock_event_device *evt = dev_id;
 	if (smp_processor_id() != 0)
 		evt = local_clock_event;
+	else
+		msm_timer_stats[container_of(evt, struct msm_clock,
+					     clockevent)->index].irqs++;
 	if (evt->event_handler == NULL)
 		return IRQ_HANDLED;
 	evt->event_handler(evt);
@@ -321,8 +353,40 @@ static struct msm_clock *clockevent_to_clock(struct clock_event_device *evt)
 }
 #endif
 
+/*
+ * Move 'alarm', 'cycles' from now, to the coalescing grid if it is far
+ * enough away.
+ */
+static uint32_t msm_timer_coalesce(struct msm_clock *clock,
+				   unsigned long cycles, uint32_t alarm)
+{
+	uint32_t per_ms = clock->freq / MSEC_PER_SEC;
+	uint32_t grid, rem;
+
+	if (msm_timer_coalesce_us <= 0 ||
+	    cycles < msm_timer_coalesce_min_us * per_ms / USEC_PER_MSEC)
+		return alarm;
+
+	grid = (msm_timer_coalesce_us * per_ms / USEC_PER_MSEC) << clock->shift;
+	if (grid <= 1)
+		return alarm;
+	rem = alarm % grid;
+	if (rem) {
+		alarm += grid - rem;
+		msm_timer_stats[clock->index].coalesced++;
+	}
+	return alarm;
+}
+
 static int msm_timer_set_next_event(unsigned long cycles,
 				    struct clock_event_device *evt)
+{
+	return msm_timer_program_alarm(cycles, evt, true);
+}
+
+static int msm_timer_program_alarm(unsigned long cycles,
+				   struct clock_event_device *evt,
+				   bool coalesce)
 {
 	int i;
 	struct msm_clock *clock;
@@ -341,6 +405,9 @@ static int msm_timer_set_next_event(unsigned long cycles,
 		return 0;
 	now = msm_read_timer_count(clock, LOCAL_TIMER);
 	alarm = now + (cycles << clock->shift);
+	if (coalesce)
+		alarm = msm_timer_coalesce(clock, cycles, alarm);
+	msm_timer_stats[clock->index].set++;
 	if (clock->flags & MSM_CLOCK_FLAGS_ODD_MATCH_WRITE)
 		while (now == clock_state->last_set)
 			now = msm_read_timer_count(clock, LOCAL_TIMER);
@@ -360,6 +427,7 @@ static int msm_timer_set_next_event(unsigned long cycles,
 	late = now - alarm;
 	if (late >= (int)(-clock->write_delay << clock->shift) && late < DGT_HZ*5) {
 		static int print_limit = 10;
+		msm_timer_stats[clock->index].expired++;
 		if (print_limit > 0) {
 			print_limit--;
 			printk(KERN_NOTICE "msm_timer_set_next_event(%lu) "
@@ -773,7 +841,8 @@ static void msm_timer_reactivate_alarm(struct msm_clock *clock)
 	alarm_delta >>= clock->shift;
 	if (alarm_delta < (long)clock->write_delay + 4)
 		alarm_delta = clock->write_delay + 4;
-	while (msm_timer_set_next_event(alarm_delta, &clock->clockevent))
+	/* The alarm was placed on the grid when first set */
+	while (msm_timer_program_alarm(alarm_delta, &clock->clockevent, false))
 		;
 }
 
@@ -854,6 +923,11 @@ void msm_timer_exit_idle(int low_power)
 	msm_timer_sync_to_gpt(clock, 1);
 
 exit_idle_alarm:
+	if ((int32_t)(clock_state->alarm_vtime - clock_state->sleep_offset -
+		      msm_read_timer_count(clock, LOCAL_TIMER)) <= 0)
+		msm_timer_stats[clock->index].wake_timer++;
+	else
+		msm_timer_stats[clock->index].wake_other++;
 	msm_timer_reactivate_alarm(clock);
 
 exit_idle_exit:
@@ -1091,3 +1165,56 @@ void __cpuexit local_timer_stop(void)
 struct sys_timer msm_timer = {
 	.init = msm_timer_init
 };
+
+#ifdef CONFIG_DEBUG_FS
+static int msm_timer_stats_show(struct seq_file *m, void *unused)
+{
+	int i;
+
+	seq_printf(m, "%-10s %10s %10s %10s %10s %10s %10s\n", "clock",
+		   "set", "coalesced", "expired", "irqs", "wake_timer",
+		   "wake_other");
+	for (i = 0; i < ARRAY_SIZE(msm_clocks); i++) {
+		struct msm_timer_stats *st = &msm_timer_stats[i];
+
+		seq_printf(m, "%-10s %10u %10u %10u %10u %10u %10u\n",
+			   msm_clocks[i].clockevent.name, st->set,
+			   st->coalesced, st->expired, st->irqs,
+			   st->wake_timer, st->wake_other);
+	}
+	return 0;
+}
+
+static int msm_timer_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_timer_stats_show, NULL);
+}
+
+static ssize_t msm_timer_stats_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	memset(msm_timer_stats, 0, sizeof(msm_timer_stats));
+	return count;
+}
+
+static const struct file_operations msm_timer_stats_fops = {
+	.open = msm_timer_stats_open,
+	.read = seq_read,
+	.write = msm_timer_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init msm_timer_debugfs_init(void)
+{
+	struct dentry *dent;
+
+	dent = debugfs_create_dir("msm_timer", NULL);
+	if (IS_ERR_OR_NULL(dent))
+		return 0;
+	debugfs_create_file("stats", S_IRUGO | S_IWUSR, dent, NULL,
+			    &msm_timer_stats_fops);
+	return 0;
+}
+late_initcall(msm_timer_debugfs_init);
+#endif
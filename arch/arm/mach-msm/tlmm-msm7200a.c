@@ -75,52 +75,97 @@ void msm_gpios_free(const struct msm_gpio *table, int size)
 }
 EXPORT_SYMBOL(msm_gpios_free);
 
+static void msm_gpios_report(const struct msm_gpio *g, unsigned disable,
+			     int rc)
+{
+	pr_err("gpio_tlmm_config(0x%08x, %s) <%s> failed: %d\n",
+	       g->gpio_cfg, disable ? "GPIO_DISABLE" : "GPIO_ENABLE",
+	       g->label ?: "?", rc);
+	pr_err("pin %d func %d dir %d pull %d drvstr %d\n",
+	       GPIO_PIN(g->gpio_cfg), GPIO_FUNC(g->gpio_cfg),
+	       GPIO_DIR(g->gpio_cfg), GPIO_PULL(g->gpio_cfg),
+	       GPIO_DRVSTR(g->gpio_cfg));
+}
+
+/* Configurations sent to the modem under one proc_comm lock hold */
+#define MSM_GPIOS_BATCH 16
+
+int gpio_tlmm_config_table(const unsigned *config, int size, unsigned disable)
+{
+	struct msm_proc_comm_cmd cmds[MSM_GPIOS_BATCH];
+	int i = 0;
+	int j, n, done;
+
+	while (i < size) {
+		n = min(size - i, MSM_GPIOS_BATCH);
+		for (j = 0; j < n; j++) {
+			cmds[j].cmd = PCOM_RPC_GPIO_TLMM_CONFIG_EX;
+			cmds[j].data1 = config[i + j];
+			cmds[j].data2 = disable;
+		}
+		done = msm_proc_comm_batch(cmds, n);
+		i += done;
+		if (done < n) {
+			pr_err("gpio_tlmm_config(0x%08x, %s) failed\n",
+			       config[i],
+			       disable ? "GPIO_DISABLE" : "GPIO_ENABLE");
+			return -EIO;
+		}
+	}
+	return 0;
+}
+EXPORT_SYMBOL(gpio_tlmm_config_table);
+
 int msm_gpios_enable(const struct msm_gpio *table, int size)
 {
-	int rc;
-	int i;
-	const struct msm_gpio *g;
-	for (i = 0; i < size; i++) {
-		g = table + i;
-		rc = gpio_tlmm_config(g->gpio_cfg, GPIO_ENABLE);
-		if (rc) {
-			pr_err("gpio_tlmm_config(0x%08x, GPIO_ENABLE)"
-			       " <%s> failed: %d\n",
-			       g->gpio_cfg, g->label ?: "?", rc);
-			pr_err("pin %d func %d dir %d pull %d drvstr %d\n",
-			       GPIO_PIN(g->gpio_cfg), GPIO_FUNC(g->gpio_cfg),
-			       GPIO_DIR(g->gpio_cfg), GPIO_PULL(g->gpio_cfg),
-			       GPIO_DRVSTR(g->gpio_cfg));
+	struct msm_proc_comm_cmd cmds[MSM_GPIOS_BATCH];
+	int i = 0;
+	int j, n, done;
+
+	while (i < size) {
+		n = min(size - i, MSM_GPIOS_BATCH);
+		for (j = 0; j < n; j++) {
+			cmds[j].cmd = PCOM_RPC_GPIO_TLMM_CONFIG_EX;
+			cmds[j].data1 = table[i + j].gpio_cfg;
+			cmds[j].data2 = GPIO_ENABLE;
+		}
+		done = msm_proc_comm_batch(cmds, n);
+		i += done;
+		if (done < n) {
+			msm_gpios_report(table + i, GPIO_ENABLE, -EIO);
 			goto err;
 		}
 	}
 	return 0;
 err:
 	msm_gpios_disable(table, i);
-	return rc;
+	return -EIO;
 }
 EXPORT_SYMBOL(msm_gpios_enable);
 
 int msm_gpios_disable(const struct msm_gpio *table, int size)
 {
+	struct msm_proc_comm_cmd cmds[MSM_GPIOS_BATCH];
 	int rc = 0;
-	int i;
-	const struct msm_gpio *g;
-	for (i = size-1; i >= 0; i--) {
-		int tmp;
-		g = table + i;
-		tmp = gpio_tlmm_config(g->gpio_cfg, GPIO_DISABLE);
-		if (tmp) {
-			pr_err("gpio_tlmm_config(0x%08x, GPIO_DISABLE)"
-			       " <%s> failed: %d\n",
-			       g->gpio_cfg, g->label ?: "?", rc);
-			pr_err("pin %d func %d dir %d pull %d drvstr %d\n",
-			       GPIO_PIN(g->gpio_cfg), GPIO_FUNC(g->gpio_cfg),
-			       GPIO_DIR(g->gpio_cfg), GPIO_PULL(g->gpio_cfg),
-			       GPIO_DRVSTR(g->gpio_cfg));
+	int i = size - 1;
+	int j, n, done;
+
+	while (i >= 0) {
+		n = min(i + 1, MSM_GPIOS_BATCH);
+		for (j = 0; j < n; j++) {
+			cmds[j].cmd = PCOM_RPC_GPIO_TLMM_CONFIG_EX;
+			cmds[j].data1 = table[i - j].gpio_cfg;
+			cmds[j].data2 = GPIO_DISABLE;
+		}
+		done = msm_proc_comm_batch(cmds, n);
+		if (done < n) {
+			/* Go on with the ones after the failed one */
+			msm_gpios_report(table + i - done, GPIO_DISABLE, -EIO);
 			if (!rc)
-				rc = tmp;
+				rc = -EIO;
+			done++;
 		}
+		i -= done;
 	}
 
 	return rc;
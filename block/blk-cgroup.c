@@ -19,6 +19,7 @@
 #include <linux/slab.h>
 #include "blk-cgroup.h"
 #include <linux/genhd.h>
+#include <linux/math64.h>
 
 #define MAX_KEY_LEN 100
 
@@ -453,6 +454,48 @@ blkiocg_weight_write(struct cgroup *cgroup, struct cftype *cftype, u64 val)
 	return 0;
 }
 
+/*
+ * Throttle limits. cftype->private is the direction, with
+ * BLKIO_THROTL_IOPS set for the iops limit.
+ */
+#define BLKIO_THROTL_IOPS	2
+
+static u64 blkiocg_throtl_read(struct cgroup *cgroup, struct cftype *cftype)
+{
+	struct blkio_cgroup *blkcg = cgroup_to_blkio_cgroup(cgroup);
+	struct blkio_throtl_bucket *b = &blkcg->throtl[cftype->private & 1];
+
+	if (cftype->private & BLKIO_THROTL_IOPS)
+		return b->iops;
+	return b->bps;
+}
+
+static int
+blkiocg_throtl_write(struct cgroup *cgroup, struct cftype *cftype, u64 val)
+{
+	struct blkio_cgroup *blkcg = cgroup_to_blkio_cgroup(cgroup);
+	struct blkio_throtl_bucket *b = &blkcg->throtl[cftype->private & 1];
+
+	if (blkcg == &blkio_root_cgroup)
+		return -EINVAL;
+
+	if ((cftype->private & BLKIO_THROTL_IOPS) && val > UINT_MAX)
+		return -EINVAL;
+
+	spin_lock_irq(&blkcg->lock);
+	if (cftype->private & BLKIO_THROTL_IOPS)
+		b->iops = val;
+	else
+		b->bps = val;
+	/* Start over with one second worth of budget */
+	b->bytes = b->bps;
+	b->ios = (s64)b->iops * HZ;
+	b->last = jiffies;
+	spin_unlock_irq(&blkcg->lock);
+
+	return 0;
+}
+
 static int
 blkiocg_reset_stats(struct cgroup *cgroup, struct cftype *cftype, u64 val)
 {
@@ -874,6 +917,30 @@ struct cftype blkio_files[] = {
 		.name = "reset_stats",
 		.write_u64 = blkiocg_reset_stats,
 	},
+	{
+		.name = "throttle.read_bps",
+		.private = READ,
+		.read_u64 = blkiocg_throtl_read,
+		.write_u64 = blkiocg_throtl_write,
+	},
+	{
+		.name = "throttle.write_bps",
+		.private = WRITE,
+		.read_u64 = blkiocg_throtl_read,
+		.write_u64 = blkiocg_throtl_write,
+	},
+	{
+		.name = "throttle.read_iops",
+		.private = READ | BLKIO_THROTL_IOPS,
+		.read_u64 = blkiocg_throtl_read,
+		.write_u64 = blkiocg_throtl_write,
+	},
+	{
+		.name = "throttle.write_iops",
+		.private = WRITE | BLKIO_THROTL_IOPS,
+		.read_u64 = blkiocg_throtl_read,
+		.write_u64 = blkiocg_throtl_write,
+	},
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 	{
 		.name = "avg_queue_size",
@@ -1033,6 +1100,226 @@ void blkio_policy_unregister(struct blkio_policy_type *blkiop)
 }
 EXPORT_SYMBOL_GPL(blkio_policy_unregister);
 
+#ifdef CONFIG_BLK_CGROUP
+/*
+ * Throttling for elevators without groups of their own.
+ *
+ * Each direction of a cgroup has a token bucket that fills at the limit
+ * rate and holds at most one second worth. A request takes its tokens
+ * when it is added, and may take the bucket below zero; requests coming
+ * in while it is below zero are parked until it has filled back up.
+ * The root cgroup is never throttled.
+ */
+static struct blkio_cgroup *blkio_throtl_blkcg(struct request *rq)
+{
+	unsigned short id = (unsigned long)rq->elevator_private3;
+	struct cgroup_subsys_state *css;
+
+	if (!id)
+		return NULL;
+
+	css = css_lookup(&blkio_subsys, id);
+	if (!css)
+		return NULL;
+
+	return container_of(css, struct blkio_cgroup, css);
+}
+
+static void blkio_throtl_refill(struct blkio_throtl_bucket *b)
+{
+	unsigned long elapsed = jiffies - b->last;
+
+	b->last = jiffies;
+	if (elapsed > HZ)
+		elapsed = HZ;
+
+	if (b->bps) {
+		b->bytes += div_u64(b->bps * elapsed, HZ);
+		if (b->bytes > (s64)b->bps)
+			b->bytes = b->bps;
+	}
+	if (b->iops) {
+		b->ios += (s64)b->iops * elapsed;
+		if (b->ios > (s64)b->iops * HZ)
+			b->ios = (s64)b->iops * HZ;
+	}
+}
+
+/* Jiffies until @b takes another request, 0 if it would now */
+static unsigned long blkio_throtl_wait(struct blkio_throtl_bucket *b)
+{
+	unsigned long wait = 0;
+
+	if (b->bps && b->bytes < 0)
+		wait = div64_u64(-b->bytes * HZ + b->bps - 1, b->bps);
+	if (b->iops && b->ios < 0)
+		wait = max_t(unsigned long, wait,
+			     DIV_ROUND_UP((unsigned long)-b->ios, b->iops));
+
+	return wait;
+}
+
+/*
+ * Take the tokens for @rq if @blkcg has them. Returns 0 if it did,
+ * otherwise the jiffies to wait. Call under rcu_read_lock().
+ */
+static unsigned long blkio_throtl_charge(struct blkio_cgroup *blkcg,
+					 struct request *rq, bool force)
+{
+	struct blkio_throtl_bucket *b = &blkcg->throtl[rq_data_dir(rq)];
+	unsigned long flags, wait = 0;
+
+	spin_lock_irqsave(&blkcg->lock, flags);
+	if (b->bps || b->iops) {
+		blkio_throtl_refill(b);
+		wait = blkio_throtl_wait(b);
+		if (!wait || force) {
+			b->bytes -= blk_rq_bytes(rq);
+			b->ios -= HZ;
+			wait = 0;
+		}
+	}
+	spin_unlock_irqrestore(&blkcg->lock, flags);
+
+	return wait;
+}
+
+static void blkio_throtl_work(struct work_struct *work)
+{
+	struct blkio_throtl_data *td =
+		container_of(work, struct blkio_throtl_data, work.work);
+	struct request_queue *q = td->queue;
+
+	spin_lock_irq(q->queue_lock);
+	if (blkio_throtl_release(td, false))
+		__blk_run_queue(q);
+	spin_unlock_irq(q->queue_lock);
+}
+
+/**
+ * blkio_throtl_init - set up throttling for an elevator
+ * @td: throttling data, in the elevator data
+ * @q: the queue of the elevator
+ * @add_fn: adds a request released from throttling to the elevator
+ */
+void blkio_throtl_init(struct blkio_throtl_data *td, struct request_queue *q,
+		void (*add_fn)(struct request_queue *, struct request *))
+{
+	td->queue = q;
+	INIT_LIST_HEAD(&td->parked);
+	td->nr_parked = 0;
+	INIT_DELAYED_WORK(&td->work, blkio_throtl_work);
+	td->add_fn = add_fn;
+}
+EXPORT_SYMBOL_GPL(blkio_throtl_init);
+
+/**
+ * blkio_throtl_exit - tear down throttling for an elevator
+ * @td: throttling data
+ *
+ * The elevator must have been drained, so nothing is parked.
+ */
+void blkio_throtl_exit(struct blkio_throtl_data *td)
+{
+	cancel_delayed_work_sync(&td->work);
+	BUG_ON(td->nr_parked);
+}
+EXPORT_SYMBOL_GPL(blkio_throtl_exit);
+
+/**
+ * blkio_throtl_set_request - note the cgroup a request is issued from
+ * @rq: the request, in the context of the task allocating it
+ *
+ * Uses rq->elevator_private3.
+ */
+void blkio_throtl_set_request(struct request *rq)
+{
+	struct blkio_cgroup *blkcg;
+	unsigned short id = 0;
+
+	rcu_read_lock();
+	blkcg = cgroup_to_blkio_cgroup(task_cgroup(current, blkio_subsys_id));
+	if (blkcg != &blkio_root_cgroup)
+		id = css_id(&blkcg->css);
+	rcu_read_unlock();
+
+	rq->elevator_private3 = (void *)(unsigned long)id;
+}
+EXPORT_SYMBOL_GPL(blkio_throtl_set_request);
+
+/**
+ * blkio_throtl_park - throttle a request being added to the elevator
+ * @td: throttling data
+ * @rq: the request
+ *
+ * Returns true if the request was parked. It is then handed to the
+ * elevator's add_fn later. Merging into parked requests is not allowed,
+ * as the elevator doesn't know about them. Call with the queue lock held.
+ */
+bool blkio_throtl_park(struct blkio_throtl_data *td, struct request *rq)
+{
+	struct blkio_cgroup *blkcg;
+	unsigned long wait = 0;
+
+	rcu_read_lock();
+	blkcg = blkio_throtl_blkcg(rq);
+	if (blkcg)
+		wait = blkio_throtl_charge(blkcg, rq, false);
+	rcu_read_unlock();
+
+	if (!wait)
+		return false;
+
+	rq->cmd_flags |= REQ_NOMERGE;
+	list_add_tail(&rq->queuelist, &td->parked);
+	td->nr_parked++;
+
+	schedule_delayed_work(&td->work, wait);
+
+	return true;
+}
+EXPORT_SYMBOL_GPL(blkio_throtl_park);
+
+/**
+ * blkio_throtl_release - hand back parked requests that may go now
+ * @td: throttling data
+ * @force: hand them all back, as for a forced dispatch
+ *
+ * Returns true if any request was handed back. Call with the queue lock
+ * held.
+ */
+bool blkio_throtl_release(struct blkio_throtl_data *td, bool force)
+{
+	struct request *rq, *tmp;
+	struct blkio_cgroup *blkcg;
+	unsigned long wait, next = 0;
+	bool released = false;
+
+	rcu_read_lock();
+	list_for_each_entry_safe(rq, tmp, &td->parked, queuelist) {
+		blkcg = blkio_throtl_blkcg(rq);
+		wait = blkcg ? blkio_throtl_charge(blkcg, rq, force) : 0;
+		if (wait) {
+			if (!next || wait < next)
+				next = wait;
+			continue;
+		}
+
+		list_del_init(&rq->queuelist);
+		td->nr_parked--;
+		td->add_fn(td->queue, rq);
+		released = true;
+	}
+	rcu_read_unlock();
+
+	if (next)
+		schedule_delayed_work(&td->work, next);
+
+	return released;
+}
+EXPORT_SYMBOL_GPL(blkio_throtl_release);
+#endif
+
 static int __init init_cgroup_blkio(void)
 {
 	return cgroup_load_subsys(&blkio_subsys);
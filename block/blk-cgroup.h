@@ -14,6 +14,7 @@
  */
 
 #include <linux/cgroup.h>
+#include <linux/workqueue.h>
 
 #if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_CGROUP_MODULE)
 
@@ -65,12 +66,23 @@ enum blkg_state_flags {
 	BLKG_empty,
 };
 
+/* Token bucket for the bps/iops limits of one direction */
+struct blkio_throtl_bucket {
+	u64 bps;			/* 0 for no limit */
+	unsigned int iops;		/* 0 for no limit */
+	s64 bytes;			/* byte tokens */
+	s64 ios;			/* io tokens, HZ of them per io */
+	unsigned long last;		/* jiffies at the last refill */
+};
+
 struct blkio_cgroup {
 	struct cgroup_subsys_state css;
 	unsigned int weight;
 	spinlock_t lock;
 	struct hlist_head blkg_list;
 	struct list_head policy_list; /* list of blkio_policy_node */
+	/* throttling, for all devices, by elevators that support it */
+	struct blkio_throtl_bucket throtl[2];
 };
 
 struct blkio_group_stats {
@@ -255,4 +267,51 @@ static inline void blkiocg_update_io_add_stats(struct blkio_group *blkg,
 static inline void blkiocg_update_io_remove_stats(struct blkio_group *blkg,
 						bool direction, bool sync) {}
 #endif
+
+/*
+ * Throttling for elevators that have no groups of their own (row, sio).
+ * Requests from a cgroup over its throttle limits are parked here, and
+ * handed back to @add_fn once the cgroup has budget again. Only built in
+ * blk-cgroup can be used, as those elevators may be built in too.
+ */
+#ifdef CONFIG_BLK_CGROUP
+struct blkio_throtl_data {
+	struct request_queue *queue;
+	struct list_head parked;
+	unsigned int nr_parked;
+	struct delayed_work work;
+	void (*add_fn)(struct request_queue *, struct request *);
+};
+
+extern void blkio_throtl_init(struct blkio_throtl_data *td,
+		struct request_queue *q,
+		void (*add_fn)(struct request_queue *, struct request *));
+extern void blkio_throtl_exit(struct blkio_throtl_data *td);
+extern void blkio_throtl_set_request(struct request *rq);
+extern bool blkio_throtl_park(struct blkio_throtl_data *td,
+			      struct request *rq);
+extern bool blkio_throtl_release(struct blkio_throtl_data *td, bool force);
+
+static inline bool blkio_throtl_empty(struct blkio_throtl_data *td)
+{
+	return !td->nr_parked;
+}
+#else
+struct blkio_throtl_data {
+};
+
+static inline void blkio_throtl_init(struct blkio_throtl_data *td,
+		struct request_queue *q,
+		void (*add_fn)(struct request_queue *, struct request *)) {}
+static inline void blkio_throtl_exit(struct blkio_throtl_data *td) {}
+static inline void blkio_throtl_set_request(struct request *rq) {}
+static inline bool blkio_throtl_park(struct blkio_throtl_data *td,
+				     struct request *rq) { return false; }
+static inline bool blkio_throtl_release(struct blkio_throtl_data *td,
+					bool force) { return false; }
+static inline bool blkio_throtl_empty(struct blkio_throtl_data *td)
+{
+	return true;
+}
+#endif
 #endif /* _BLK_CGROUP_H */
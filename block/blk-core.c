@@ -442,6 +442,7 @@ void blk_cleanup_queue(struct request_queue *q)
 	 * not have processes doing IO to this device.
 	 */
 	blk_sync_queue(q);
+	blk_discard_exit(q);
 
 	del_timer_sync(&q->backing_dev_info.laptop_mode_wb_timer);
 	mutex_lock(&q->sysfs_lock);
@@ -517,6 +518,7 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 
 	mutex_init(&q->sysfs_lock);
 	spin_lock_init(&q->__queue_lock);
+	blk_discard_init(q);
 
 	return q;
 }
@@ -1538,6 +1540,8 @@ static inline void __generic_make_request(struct bio *bio)
 			goto end_io;
 		}
 
+		blk_discard_cancel(q, bio);
+
 		trace_block_bio_queue(q, bio);
 
 		ret = q->make_request_fn(q, bio);
@@ -1779,6 +1783,49 @@ static void blk_account_io_completion(struct request *req, unsigned int bytes)
 	}
 }
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static inline int blk_latency_bucket(u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+	int b = us ? fls64(us) - 1 : 0;
+
+	return min(b, BLK_LAT_BUCKETS - 1);
+}
+
+/*
+ * Account the queue and service time of a completed request. Called
+ * with the queue lock held.
+ */
+static void blk_latency_hist_add(struct request *req)
+{
+	struct blk_latency_hist *hist = &req->q->lat_hist;
+	u64 start = rq_start_time_ns(req);
+	u64 io_start = rq_io_start_time_ns(req);
+	u64 now = sched_clock();
+	int type;
+
+	/* Never went through blk_dequeue_request() */
+	if (!io_start || io_start < start || now < io_start)
+		return;
+
+	if (req->cmd_flags & REQ_DISCARD)
+		type = BLK_LAT_DISCARD;
+	else if (rq_data_dir(req) == READ)
+		type = BLK_LAT_READ;
+	else if (rq_is_sync(req))
+		type = BLK_LAT_SYNC;
+	else
+		type = BLK_LAT_WRITE;
+
+	hist->queue[type][blk_latency_bucket(io_start - start)]++;
+	hist->service[type][blk_latency_bucket(now - io_start)]++;
+}
+#else
+static inline void blk_latency_hist_add(struct request *req)
+{
+}
+#endif
+
 static void blk_account_io_done(struct request *req)
 {
 	/*
@@ -1801,6 +1848,8 @@ static void blk_account_io_done(struct request *req)
 		part_dec_in_flight(part, rw);
 
 		part_stat_unlock();
+
+		blk_latency_hist_add(req);
 	}
 }
 
@@ -6,6 +6,8 @@
 #include <linux/bio.h>
 #include <linux/blkdev.h>
 #include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/earlysuspend.h>
 
 #include "blk.h"
 
@@ -34,6 +36,10 @@ static void blkdev_discard_end_io(struct bio *bio, int err)
  *
  * Description:
  *    Issue a discard request for the sectors in question.
+ *
+ *    With BLKDEV_IFL_DEFER set the discard may instead be queued and
+ *    issued later, when the device is idle. Only pass it if the
+ *    sectors may be read back with their old contents in the meantime.
  */
 int blkdev_issue_discard(struct block_device *bdev, sector_t sector,
 		sector_t nr_sects, gfp_t gfp_mask, unsigned long flags)
@@ -52,6 +58,10 @@ int blkdev_issue_discard(struct block_device *bdev, sector_t sector,
 	if (!blk_queue_discard(q))
 		return -EOPNOTSUPP;
 
+	if ((flags & BLKDEV_IFL_DEFER) &&
+	    !blk_discard_defer(bdev, sector, nr_sects, gfp_mask))
+		return 0;
+
 	while (nr_sects && !ret) {
 		unsigned int sector_size = q->limits.logical_block_size;
 		unsigned int max_discard_sectors =
@@ -113,6 +123,349 @@ out:
 }
 EXPORT_SYMBOL(blkdev_issue_discard);
 
+#ifdef CONFIG_BLK_DEFERRED_DISCARD
+/*
+ * Deferred discards.
+ *
+ * Filesystems doing online discard send a discard for every extent they
+ * free, right after the journal commit, and wait for it. On eMMC that
+ * stalls the writes queued behind it. Instead the ranges are parked on
+ * the queue, merged with their neighbours, and issued from kdiscardd
+ * once the queue has no requests outstanding. With the screen off they
+ * go out as soon as the queue is idle, with it on they are held for
+ * discard_delay first so that deletes don't compete with foreground IO.
+ *
+ * A parked range is kept in whole disk sectors. Any write to the disk
+ * trims it first, so a discard never lands after the sectors have been
+ * reused; a write to the chunk being issued waits for it to complete.
+ * Ranges of a partition are flushed when its last opener goes away.
+ */
+#define BLK_DISCARD_DELAY	(5 * HZ)
+#define BLK_DISCARD_IDLE	(HZ / 5)
+#define BLK_DISCARD_MAX_RANGES	256
+
+struct blk_discard_range {
+	struct list_head	list;
+	struct block_device	*bdev;
+	sector_t		sector;
+	sector_t		nr_sects;
+};
+
+static struct workqueue_struct *kdiscardd_workqueue;
+static LIST_HEAD(blk_discard_queues);
+static DEFINE_SPINLOCK(blk_discard_lock);
+static int blk_discard_screen_off;
+
+static inline int blk_discard_busy(struct request_queue *q)
+{
+	return q->rq.count[BLK_RW_SYNC] + q->rq.count[BLK_RW_ASYNC];
+}
+
+static inline int blk_discard_overlaps(sector_t a, sector_t na,
+				       sector_t b, sector_t nb)
+{
+	return a < b + nb && b < a + na;
+}
+
+static inline void blk_discard_free(struct request_queue *q,
+				    struct blk_discard_range *r)
+{
+	list_del(&r->list);
+	q->nr_discard_ranges--;
+	kfree(r);
+}
+
+/* Called with queue_lock held */
+static void blk_discard_schedule(struct request_queue *q)
+{
+	unsigned long delay = q->discard_delay;
+
+	if (blk_discard_screen_off)
+		delay = BLK_DISCARD_IDLE;
+
+	queue_delayed_work(kdiscardd_workqueue, &q->discard_work, delay);
+}
+
+static void blk_discard_work(struct work_struct *work)
+{
+	struct request_queue *q = container_of(work, struct request_queue,
+					       discard_work.work);
+	unsigned int max_discard_sectors =
+		min(q->limits.max_discard_sectors, UINT_MAX >> 9);
+	struct blk_discard_range *r;
+	struct block_device *bdev;
+	sector_t sector, nr;
+
+	spin_lock_irq(q->queue_lock);
+	while (!list_empty(&q->discard_ranges)) {
+		if (blk_discard_busy(q)) {
+			queue_delayed_work(kdiscardd_workqueue,
+					   &q->discard_work, BLK_DISCARD_IDLE);
+			break;
+		}
+
+		r = list_first_entry(&q->discard_ranges,
+				     struct blk_discard_range, list);
+		bdev = r->bdev;
+		sector = r->sector;
+		nr = min_t(sector_t, r->nr_sects, max_discard_sectors);
+
+		r->sector += nr;
+		r->nr_sects -= nr;
+		if (!r->nr_sects)
+			blk_discard_free(q, r);
+
+		q->discard_sector = sector;
+		q->discard_nr = nr;
+		spin_unlock_irq(q->queue_lock);
+
+		blkdev_issue_discard(bdev, sector - get_start_sect(bdev), nr,
+				     GFP_NOIO, BLKDEV_IFL_WAIT);
+
+		spin_lock_irq(q->queue_lock);
+		q->discard_nr = 0;
+		wake_up_all(&q->discard_wait);
+	}
+	spin_unlock_irq(q->queue_lock);
+}
+
+/**
+ * blk_discard_defer - park a discard until the queue is idle
+ * @bdev:	blockdev to issue discard for
+ * @sector:	start sector
+ * @nr_sects:	number of sectors to discard
+ * @gfp_mask:	memory allocation flags
+ *
+ * Returns 0 if the discard was queued, or an error if the caller
+ * should issue it right away.
+ */
+int blk_discard_defer(struct block_device *bdev, sector_t sector,
+		      sector_t nr_sects, gfp_t gfp_mask)
+{
+	struct request_queue *q = bdev_get_queue(bdev);
+	struct blk_discard_range *r, *new, *prev = NULL;
+	unsigned long flags;
+
+	if (!q->request_fn || !q->discard_delay || !kdiscardd_workqueue)
+		return -EOPNOTSUPP;
+
+	new = kmalloc(sizeof(*new), gfp_mask);
+	if (!new)
+		return -ENOMEM;
+
+	new->bdev = bdev;
+	new->sector = sector + get_start_sect(bdev);
+	new->nr_sects = nr_sects;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+
+	/* Find the last range starting before the new one */
+	list_for_each_entry(r, &q->discard_ranges, list) {
+		if (r->sector > new->sector)
+			break;
+		prev = r;
+	}
+
+	/* Merge into the range before ... */
+	if (prev && prev->bdev == bdev &&
+	    prev->sector + prev->nr_sects >= new->sector) {
+		if (new->sector + new->nr_sects >
+		    prev->sector + prev->nr_sects)
+			prev->nr_sects = new->sector + new->nr_sects -
+					 prev->sector;
+		kfree(new);
+		new = prev;
+	} else if (q->nr_discard_ranges >= BLK_DISCARD_MAX_RANGES) {
+		spin_unlock_irqrestore(q->queue_lock, flags);
+		kfree(new);
+		return -EBUSY;
+	} else {
+		list_add(&new->list, prev ? &prev->list : &q->discard_ranges);
+		q->nr_discard_ranges++;
+	}
+
+	/* ... and swallow the ones it now reaches */
+	while (!list_is_last(&new->list, &q->discard_ranges)) {
+		r = list_entry(new->list.next, struct blk_discard_range, list);
+		if (r->bdev != bdev ||
+		    r->sector > new->sector + new->nr_sects)
+			break;
+		if (r->sector + r->nr_sects > new->sector + new->nr_sects)
+			new->nr_sects = r->sector + r->nr_sects - new->sector;
+		blk_discard_free(q, r);
+	}
+
+	blk_discard_schedule(q);
+	spin_unlock_irqrestore(q->queue_lock, flags);
+
+	return 0;
+}
+
+static int blk_discard_issuing(struct request_queue *q, sector_t sector,
+			       sector_t nr)
+{
+	int ret;
+
+	spin_lock_irq(q->queue_lock);
+	ret = q->discard_nr &&
+		blk_discard_overlaps(q->discard_sector, q->discard_nr,
+				     sector, nr);
+	spin_unlock_irq(q->queue_lock);
+
+	return ret;
+}
+
+/*
+ * Trim the parked discards a write is about to overwrite. When the
+ * write lands in the middle of a range only the bigger side is kept:
+ * dropping a discard is always safe.
+ */
+void __blk_discard_cancel(struct request_queue *q, struct bio *bio)
+{
+	sector_t start = bio->bi_sector, nr = bio_sectors(bio);
+	sector_t end = start + nr;
+	struct blk_discard_range *r, *tmp;
+
+	spin_lock_irq(q->queue_lock);
+	list_for_each_entry_safe(r, tmp, &q->discard_ranges, list) {
+		sector_t r_end = r->sector + r->nr_sects;
+
+		if (r->sector >= end)
+			break;
+		if (!blk_discard_overlaps(r->sector, r->nr_sects, start, nr))
+			continue;
+
+		if (r->sector >= start && r_end <= end) {
+			blk_discard_free(q, r);
+		} else if (r->sector >= start) {
+			r->nr_sects = r_end - end;
+			r->sector = end;
+		} else if (r_end <= end || start - r->sector >= r_end - end) {
+			r->nr_sects = start - r->sector;
+		} else {
+			r->nr_sects = r_end - end;
+			r->sector = end;
+		}
+	}
+	spin_unlock_irq(q->queue_lock);
+
+	wait_event(q->discard_wait, !blk_discard_issuing(q, start, nr));
+}
+
+/**
+ * blkdev_flush_discards - issue the discards parked for a blockdev
+ * @bdev:	blockdev going away
+ *
+ * Called when the last opener of @bdev is gone. Issues what is parked
+ * for it and makes sure kdiscardd no longer uses it.
+ */
+void blkdev_flush_discards(struct block_device *bdev)
+{
+	struct request_queue *q = bdev_get_queue(bdev);
+	struct blk_discard_range *r, *tmp;
+	LIST_HEAD(ranges);
+
+	if (!q || !kdiscardd_workqueue ||
+	    (list_empty(&q->discard_ranges) && !q->discard_nr))
+		return;
+
+	cancel_delayed_work_sync(&q->discard_work);
+
+	spin_lock_irq(q->queue_lock);
+	list_for_each_entry_safe(r, tmp, &q->discard_ranges, list) {
+		if (r->bdev != bdev)
+			continue;
+		list_move_tail(&r->list, &ranges);
+		q->nr_discard_ranges--;
+	}
+	if (!list_empty(&q->discard_ranges))
+		blk_discard_schedule(q);
+	spin_unlock_irq(q->queue_lock);
+
+	/* Nothing can write to @bdev anymore, so no need to park these */
+	list_for_each_entry_safe(r, tmp, &ranges, list) {
+		blkdev_issue_discard(bdev, r->sector - get_start_sect(bdev),
+				     r->nr_sects, GFP_NOIO, BLKDEV_IFL_WAIT);
+		kfree(r);
+	}
+}
+EXPORT_SYMBOL(blkdev_flush_discards);
+
+void blk_discard_init(struct request_queue *q)
+{
+	INIT_LIST_HEAD(&q->discard_ranges);
+	q->discard_delay = BLK_DISCARD_DELAY;
+	init_waitqueue_head(&q->discard_wait);
+	INIT_DELAYED_WORK(&q->discard_work, blk_discard_work);
+
+	spin_lock(&blk_discard_lock);
+	list_add(&q->discard_node, &blk_discard_queues);
+	spin_unlock(&blk_discard_lock);
+}
+
+void blk_discard_exit(struct request_queue *q)
+{
+	struct blk_discard_range *r, *tmp;
+
+	spin_lock(&blk_discard_lock);
+	list_del_init(&q->discard_node);
+	spin_unlock(&blk_discard_lock);
+
+	cancel_delayed_work_sync(&q->discard_work);
+
+	/* Every blockdev is closed by now, this is only paranoia */
+	spin_lock_irq(q->queue_lock);
+	list_for_each_entry_safe(r, tmp, &q->discard_ranges, list)
+		blk_discard_free(q, r);
+	spin_unlock_irq(q->queue_lock);
+}
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+/* With the screen off nobody is waiting on IO, send everything now */
+static void blk_discard_early_suspend(struct early_suspend *h)
+{
+	struct request_queue *q;
+	unsigned long flags;
+
+	spin_lock(&blk_discard_lock);
+	blk_discard_screen_off = 1;
+	list_for_each_entry(q, &blk_discard_queues, discard_node) {
+		spin_lock_irqsave(q->queue_lock, flags);
+		if (!list_empty(&q->discard_ranges)) {
+			cancel_delayed_work(&q->discard_work);
+			blk_discard_schedule(q);
+		}
+		spin_unlock_irqrestore(q->queue_lock, flags);
+	}
+	spin_unlock(&blk_discard_lock);
+}
+
+static void blk_discard_late_resume(struct early_suspend *h)
+{
+	blk_discard_screen_off = 0;
+}
+
+static struct early_suspend blk_discard_early_suspend_desc = {
+	.level = EARLY_SUSPEND_LEVEL_DISABLE_FB + 1,
+	.suspend = blk_discard_early_suspend,
+	.resume = blk_discard_late_resume,
+};
+#endif
+
+static int __init blk_discard_setup(void)
+{
+	kdiscardd_workqueue = create_freezeable_workqueue("kdiscardd");
+	if (!kdiscardd_workqueue)
+		return -ENOMEM;
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&blk_discard_early_suspend_desc);
+#endif
+	return 0;
+}
+subsys_initcall(blk_discard_setup);
+#endif /* CONFIG_BLK_DEFERRED_DISCARD */
+
 struct bio_batch
 {
 	atomic_t 		done;
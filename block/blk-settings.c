@@ -450,6 +450,24 @@ void blk_queue_io_opt(struct request_queue *q, unsigned int opt)
 }
 EXPORT_SYMBOL(blk_queue_io_opt);
 
+/**
+ * blk_queue_swap_cost - set the cost of swapping in from the queue
+ * @q:	the request queue for the device
+ * @cost:  cost in percent of reading a file page back from storage
+ *
+ * Description:
+ *   Devices that swap much faster than file pages can be read back, like
+ *   compressed RAM disks, report a cost below 100 here so reclaim favours
+ *   swapping anon pages over dropping page cache when the device is used
+ *   for swap. Call swap_update_cost() after changing it on a device that
+ *   may already be swapped to.
+ */
+void blk_queue_swap_cost(struct request_queue *q, unsigned int cost)
+{
+	q->swap_cost = cost;
+}
+EXPORT_SYMBOL(blk_queue_swap_cost);
+
 /*
  * Returns the minimum that is _not_ zero, unless both are zero.
  */
@@ -271,6 +271,128 @@ static ssize_t queue_iostats_store(struct request_queue *q, const char *page,
 	return ret;
 }
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static const char *blk_lat_names[BLK_LAT_TYPES] = {
+	"read", "write", "sync", "discard",
+};
+
+/* Upper bound, in usec, of the bucket the @pct percentile falls in */
+static unsigned long blk_lat_percentile(const unsigned int *buckets,
+					unsigned long total, int pct)
+{
+	unsigned long want = DIV_ROUND_UP(total * pct, 100), seen = 0;
+	int i;
+
+	for (i = 0; i < BLK_LAT_BUCKETS - 1; i++) {
+		seen += buckets[i];
+		if (seen >= want)
+			break;
+	}
+
+	return 2UL << i;
+}
+
+static ssize_t blk_lat_show_one(char *page, ssize_t len, const char *phase,
+				int type, const unsigned int *buckets)
+{
+	unsigned long total = 0;
+	int i;
+
+	for (i = 0; i < BLK_LAT_BUCKETS; i++)
+		total += buckets[i];
+
+	len += scnprintf(page + len, PAGE_SIZE - len, "%s %s: n %lu",
+			 blk_lat_names[type], phase, total);
+	if (total)
+		len += scnprintf(page + len, PAGE_SIZE - len,
+				 " p50 %lu p90 %lu p99 %lu",
+				 blk_lat_percentile(buckets, total, 50),
+				 blk_lat_percentile(buckets, total, 90),
+				 blk_lat_percentile(buckets, total, 99));
+	len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+
+	return len;
+}
+
+static ssize_t queue_latency_hist_show(struct request_queue *q, char *page)
+{
+	struct blk_latency_hist *hist;
+	ssize_t len = 0;
+	int phase, type, i;
+
+	hist = kmalloc(sizeof(*hist), GFP_KERNEL);
+	if (!hist)
+		return -ENOMEM;
+
+	spin_lock_irq(q->queue_lock);
+	memcpy(hist, &q->lat_hist, sizeof(*hist));
+	spin_unlock_irq(q->queue_lock);
+
+	/* Percentiles in usec, then the buckets themselves */
+	for (type = 0; type < BLK_LAT_TYPES; type++) {
+		len = blk_lat_show_one(page, len, "queue", type,
+				       hist->queue[type]);
+		len = blk_lat_show_one(page, len, "service", type,
+				       hist->service[type]);
+	}
+
+	len += scnprintf(page + len, PAGE_SIZE - len, "usec:");
+	for (i = 0; i < BLK_LAT_BUCKETS; i++)
+		len += scnprintf(page + len, PAGE_SIZE - len, " %lu",
+				 2UL << i);
+	len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+
+	for (phase = 0; phase < 2; phase++) {
+		for (type = 0; type < BLK_LAT_TYPES; type++) {
+			const unsigned int *buckets = phase ?
+				hist->service[type] : hist->queue[type];
+
+			len += scnprintf(page + len, PAGE_SIZE - len, "%s %s:",
+					 blk_lat_names[type],
+					 phase ? "service" : "queue");
+			for (i = 0; i < BLK_LAT_BUCKETS; i++)
+				len += scnprintf(page + len, PAGE_SIZE - len,
+						 " %u", buckets[i]);
+			len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+		}
+	}
+
+	kfree(hist);
+
+	return len;
+}
+
+/* Any write clears the histograms */
+static ssize_t queue_latency_hist_store(struct request_queue *q,
+					const char *page, size_t count)
+{
+	spin_lock_irq(q->queue_lock);
+	memset(&q->lat_hist, 0, sizeof(q->lat_hist));
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+#endif
+
+#ifdef CONFIG_BLK_DEFERRED_DISCARD
+static ssize_t queue_discard_defer_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(jiffies_to_msecs(q->discard_delay), page);
+}
+
+/* 0 issues discards right away */
+static ssize_t queue_discard_defer_store(struct request_queue *q,
+					 const char *page, size_t count)
+{
+	unsigned long msecs;
+	ssize_t ret = queue_var_store(&msecs, page, count);
+
+	q->discard_delay = msecs_to_jiffies(msecs);
+
+	return ret;
+}
+#endif
+
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_requests_show,
@@ -374,6 +496,22 @@ static struct queue_sysfs_entry queue_iostats_entry = {
 	.store = queue_iostats_store,
 };
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static struct queue_sysfs_entry queue_latency_hist_entry = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_latency_hist_show,
+	.store = queue_latency_hist_store,
+};
+#endif
+
+#ifdef CONFIG_BLK_DEFERRED_DISCARD
+static struct queue_sysfs_entry queue_discard_defer_entry = {
+	.attr = {.name = "discard_defer_ms", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_discard_defer_show,
+	.store = queue_discard_defer_store,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -394,6 +532,12 @@ static struct attribute *default_attrs[] = {
 	&queue_nomerges_entry.attr,
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
+#ifdef CONFIG_BLK_LATENCY_HIST
+	&queue_latency_hist_entry.attr,
+#endif
+#ifdef CONFIG_BLK_DEFERRED_DISCARD
+	&queue_discard_defer_entry.attr,
+#endif
 	NULL,
 };
 
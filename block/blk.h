@@ -176,4 +176,41 @@ static inline int blk_do_io_stat(struct request *rq)
 	       (blk_fs_request(rq) || blk_discard_rq(rq));
 }
 
+#ifdef CONFIG_BLK_DEFERRED_DISCARD
+void blk_discard_init(struct request_queue *q);
+void blk_discard_exit(struct request_queue *q);
+int blk_discard_defer(struct block_device *bdev, sector_t sector,
+		      sector_t nr_sects, gfp_t gfp_mask);
+void __blk_discard_cancel(struct request_queue *q, struct bio *bio);
+
+/*
+ * A write is about to hit the disk: a deferred discard of the same
+ * sectors must not be issued after it.
+ */
+static inline void blk_discard_cancel(struct request_queue *q,
+				      struct bio *bio)
+{
+	if (bio_data_dir(bio) == WRITE && bio_sectors(bio) &&
+	    !bio_rw_flagged(bio, BIO_RW_DISCARD) &&
+	    (!list_empty(&q->discard_ranges) || q->discard_nr))
+		__blk_discard_cancel(q, bio);
+}
+#else
+static inline void blk_discard_init(struct request_queue *q)
+{
+}
+static inline void blk_discard_exit(struct request_queue *q)
+{
+}
+static inline int blk_discard_defer(struct block_device *bdev,
+		sector_t sector, sector_t nr_sects, gfp_t gfp_mask)
+{
+	return -EOPNOTSUPP;
+}
+static inline void blk_discard_cancel(struct request_queue *q,
+				      struct bio *bio)
+{
+}
+#endif
+
 #endif
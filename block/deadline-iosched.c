@@ -14,6 +14,8 @@
 #include <linux/compiler.h>
 #include <linux/rbtree.h>
 
+#include "elv-fifo.h"
+
 /*
  * See Documentation/block/deadline-iosched.txt
  */
@@ -108,8 +110,7 @@ deadline_add_request(struct request_queue *q, struct request *rq)
 	/*
 	 * set expire time and add to fifo list
 	 */
-	rq_set_fifo_time(rq, jiffies + dd->fifo_expire[data_dir]);
-	list_add_tail(&rq->queuelist, &dd->fifo_list[data_dir]);
+	elv_fifo_add(&dd->fifo_list[data_dir], rq, dd->fifo_expire[data_dir]);
 }
 
 /*
@@ -171,16 +172,7 @@ static void
 deadline_merged_requests(struct request_queue *q, struct request *req,
 			 struct request *next)
 {
-	/*
-	 * if next expires before rq, assign its expire time to rq
-	 * and move into next position (next will be deleted) in fifo
-	 */
-	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
-		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
-			list_move(&req->queuelist, &next->queuelist);
-			rq_set_fifo_time(req, rq_fifo_time(next));
-		}
-	}
+	elv_fifo_merge(req, next);
 
 	/*
 	 * kill knowledge of next, this one is a goner
@@ -0,0 +1,76 @@
+#ifndef _ELV_FIFO_H
+#define _ELV_FIFO_H
+/*
+ * Deadline fifo helpers shared by the io schedulers
+ *
+ * deadline, sio, vr and zen each keep requests on fifo lists ordered by
+ * the expire time stored with rq_set_fifo_time(), and each carried its
+ * own copy of the code below.
+ */
+
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/jiffies.h>
+
+/*
+ * Merging @next into @rq: if next expires before rq, give rq its expire
+ * time and its position in the fifo. The caller still removes @next.
+ */
+static inline void elv_fifo_merge(struct request *rq, struct request *next)
+{
+	if (!list_empty(&rq->queuelist) && !list_empty(&next->queuelist) &&
+	    time_before(rq_fifo_time(next), rq_fifo_time(rq))) {
+		list_move(&rq->queuelist, &next->queuelist);
+		rq_set_fifo_time(rq, rq_fifo_time(next));
+	}
+}
+
+/*
+ * Add @rq to the tail of @fifo, expiring @expire jiffies from now
+ */
+static inline void elv_fifo_add(struct list_head *fifo, struct request *rq,
+				unsigned long expire)
+{
+	rq_set_fifo_time(rq, jiffies + expire);
+	list_add_tail(&rq->queuelist, fifo);
+}
+
+/*
+ * The request at the head of @fifo, or NULL if it is empty
+ */
+static inline struct request *elv_fifo_first(struct list_head *fifo)
+{
+	if (list_empty(fifo))
+		return NULL;
+
+	return rq_entry_fifo(fifo->next);
+}
+
+/*
+ * The request at the head of @fifo if it has expired, else NULL
+ */
+static inline struct request *elv_fifo_expired(struct list_head *fifo)
+{
+	struct request *rq = elv_fifo_first(fifo);
+
+	if (rq && time_after(jiffies, rq_fifo_time(rq)))
+		return rq;
+
+	return NULL;
+}
+
+/*
+ * Whichever of @a and @b expires first; either may be NULL
+ */
+static inline struct request *elv_fifo_earlier(struct request *a,
+					       struct request *b)
+{
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+
+	return time_after(rq_fifo_time(a), rq_fifo_time(b)) ? b : a;
+}
+
+#endif
@@ -26,6 +26,9 @@
 #include <linux/compiler.h>
 #include <linux/blktrace_api.h>
 #include <linux/jiffies.h>
+#include <linux/hrtimer.h>
+
+#include "blk-cgroup.h"
 
 /*
  * enum row_queue_prio - Priorities of the ROW queues
@@ -85,6 +88,18 @@ static const struct row_queue_params row_queues_def[] = {
 #define ROW_IDLE_TIME_MSEC 10
 #define ROW_READ_FREQ_MSEC 25
 
+/*
+ * Adaptive tuning: read idling is twice the read completion latency,
+ * within these bounds (in usec), and the read quantums are scaled so a
+ * full run of reads takes about ROW_WRITE_STARVE_MSEC.
+ */
+#define ROW_IDLE_MIN_USEC	500
+#define ROW_IDLE_MAX_USEC	20000
+#define ROW_WRITE_STARVE_MSEC	100
+#define ROW_READ_QUANTUM_MIN	4
+#define ROW_READ_QUANTUM_SCALE	4	/* most a quantum may grow by */
+#define ROW_LAT_EWMA_SHIFT	3	/* new samples weigh 1/8 */
+
 /**
  * struct rowq_idling_data -  parameters for idling on the queue
  * @last_insert_time:	time the last request was inserted
@@ -128,18 +143,20 @@ struct row_queue {
 
 /**
  * struct idling_data - data for idling on empty rqueue
- * @idle_time:		idling duration (jiffies)
+ * @idle_time_us:	idling duration (usec)
  * @freq:		min time between two requests that
  *			triger idling (msec)
- * @idle_work:		pointer to struct delayed_work
+ * @hr_timer:		idling timer, a jiffy is too coarse
+ * @idle_work:		kicks the queue once the timer expires
  *
  */
 struct idling_data {
-	unsigned long			idle_time;
+	unsigned long			idle_time_us;
 	u32				freq;
     
 	struct workqueue_struct	*idle_workqueue;
-	struct delayed_work		idle_work;
+	struct hrtimer			hr_timer;
+	struct work_struct		idle_work;
 };
 
 /**
@@ -153,6 +170,12 @@ struct idling_data {
  *			scheduler, nr_reqs[1] holds the number of all WRITE
  *			requests in scheduler
  * @cycle_flags:	used for marking unserved queueus
+ * @lat_us:		completion latency EWMA, [0] for READ and [1]
+ *			for WRITE requests (usec)
+ * @adaptive:		tune read idling and the read quantums from
+ *			@lat_us
+ * @write_starve_us:	how long a run of reads may hold off writes
+ * @throtl:		requests held back by blkio throttling
  *
  */
 struct row_data {
@@ -166,6 +189,12 @@ struct row_data {
 	unsigned int			nr_reqs[2];
     
 	unsigned int			cycle_flags;
+
+	unsigned long			lat_us[2];
+	int				adaptive;
+	unsigned long			write_starve_us;
+
+	struct blkio_throtl_data	throtl;
 };
 
 #define RQ_ROWQ(rq) ((struct row_queue *) ((rq)->elevator_private))
@@ -217,9 +246,8 @@ static inline void __maybe_unused row_dump_queues_stat(struct row_data *rd)
  */
 static void kick_queue(struct work_struct *work)
 {
-	struct delayed_work *idle_work = to_delayed_work(work);
 	struct idling_data *read_data =
-    container_of(idle_work, struct idling_data, idle_work);
+    container_of(work, struct idling_data, idle_work);
 	struct row_data *rd =
     container_of(read_data, struct row_data, read_idle);
     
@@ -236,6 +264,54 @@ static void kick_queue(struct work_struct *work)
 	}
 }
 
+/*
+ * row_idle_hrtimer_fn() - Idling timer expired
+ * @hr_timer:	pointer to struct hrtimer
+ *
+ * The queue can't be run from here, so leave it to kick_queue().
+ */
+static enum hrtimer_restart row_idle_hrtimer_fn(struct hrtimer *hr_timer)
+{
+	struct idling_data *read_data =
+		container_of(hr_timer, struct idling_data, hr_timer);
+
+	queue_work(read_data->idle_workqueue, &read_data->idle_work);
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * row_adapt() - Retune read idling and quantums
+ * @rd:	pointer to struct row_data
+ *
+ * Idle long enough for a dependent read to come back after the last
+ * one completes, and size the read quantums so the reads of a
+ * dispatch cycle hold the device for about write_starve_us.
+ */
+static void row_adapt(struct row_data *rd)
+{
+	unsigned long lat = rd->lat_us[READ] ? rd->lat_us[READ] : 1;
+	unsigned long sum = 0, q;
+	int i;
+
+	rd->read_idle.idle_time_us = clamp_t(unsigned long, 2 * lat,
+					     ROW_IDLE_MIN_USEC,
+					     ROW_IDLE_MAX_USEC);
+
+	for (i = 0; i < ROWQ_MAX_PRIO; i++)
+		if (row_queues_def[i].idling_enabled)
+			sum += row_queues_def[i].quantum;
+
+	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
+		if (!row_queues_def[i].idling_enabled)
+			continue;
+		q = row_queues_def[i].quantum * rd->write_starve_us /
+			(lat * sum);
+		rd->row_queues[i].disp_quantum = clamp_t(unsigned long, q,
+			ROW_READ_QUANTUM_MIN,
+			row_queues_def[i].quantum * ROW_READ_QUANTUM_SCALE);
+	}
+}
+
 /*
  * row_restart_disp_cycle() - Restart the dispatch cycle
  * @rd:	pointer to struct row_data
@@ -266,13 +342,13 @@ static inline void row_get_next_queue(struct row_data *rd)
 /******************* Elevator callback functions *********************/
 
 /*
- * row_add_request() - Add request to the scheduler
+ * row_queue_request() - Add request to its rqueue
  * @q:	requests queue
  * @rq:	request to add
  *
  */
-static void row_add_request(struct request_queue *q,
-                            struct request *rq)
+static void row_queue_request(struct request_queue *q,
+                              struct request *rq)
 {
 	struct row_data *rd = (struct row_data *)q->elevator->elevator_data;
 	struct row_queue *rqueue = RQ_ROWQ(rq);
@@ -283,9 +359,8 @@ static void row_add_request(struct request_queue *q,
 	rq_set_fifo_time(rq, jiffies); /* for statistics*/
     
 	if (row_queues_def[rqueue->prio].idling_enabled) {
-		if (delayed_work_pending(&rd->read_idle.idle_work))
-			(void)cancel_delayed_work(
-                                      &rd->read_idle.idle_work);
+		if (hrtimer_active(&rd->read_idle.hr_timer))
+			(void)hrtimer_try_to_cancel(&rd->read_idle.hr_timer);
 		if (ktime_to_ms(ktime_sub(ktime_get(),
                                   rqueue->idle_data.last_insert_time)) <
             rd->read_idle.freq) {
@@ -308,6 +383,23 @@ static void row_add_request(struct request_queue *q,
                      "added request (total on queue=%d)", rqueue->nr_req);
 }
 
+/*
+ * row_add_request() - Add request to the scheduler
+ * @q:	requests queue
+ * @rq:	request to add
+ *
+ * Requests held back by blkio throttling are added later, through
+ * row_queue_request().
+ */
+static void row_add_request(struct request_queue *q,
+                            struct request *rq)
+{
+	struct row_data *rd = (struct row_data *)q->elevator->elevator_data;
+
+	if (!blkio_throtl_park(&rd->throtl, rq))
+		row_queue_request(q, rq);
+}
+
 /**
  * row_reinsert_req() - Reinsert request back to the scheduler
  * @q:	requests queue
@@ -449,6 +541,9 @@ static int row_dispatch_requests(struct request_queue *q, int force)
 	struct row_data *rd = (struct row_data *)q->elevator->elevator_data;
 	int ret = 0, currq, i;
     
+	if (unlikely(force))
+		blkio_throtl_release(&rd->throtl, true);
+
 	currq = rd->curr_queue;
     
 	/*
@@ -481,10 +576,10 @@ static int row_dispatch_requests(struct request_queue *q, int force)
 	/* Dispatch from curr_queue */
 	if (list_empty(&rd->row_queues[currq].fifo)) {
 		/* check idling */
-		if (delayed_work_pending(&rd->read_idle.idle_work)) {
+		if (hrtimer_active(&rd->read_idle.hr_timer)) {
 			if (force) {
-				(void)cancel_delayed_work(
-                                          &rd->read_idle.idle_work);
+				(void)hrtimer_try_to_cancel(
+					&rd->read_idle.hr_timer);
 				row_log_rowq(rd, currq,
                              "Canceled delayed work - forced dispatch");
 			} else {
@@ -496,14 +591,11 @@ static int row_dispatch_requests(struct request_queue *q, int force)
         
 		if (!force && row_queues_def[currq].idling_enabled &&
 		    rd->row_queues[currq].idle_data.begin_idling) {
-			if (!queue_delayed_work(rd->read_idle.idle_workqueue,
-                                    &rd->read_idle.idle_work,
-                                    rd->read_idle.idle_time)) {
-				row_log_rowq(rd, currq,
-                             "Work already on queue!");
-				pr_err("ROW_BUG: Work already on queue!");
-			} else
-				row_log_rowq(rd, currq,
+			hrtimer_start(&rd->read_idle.hr_timer,
+				ns_to_ktime(rd->read_idle.idle_time_us *
+					    NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+			row_log_rowq(rd, currq,
                              "Scheduled delayed work. exiting");
 			goto done;
 		} else {
@@ -556,15 +648,20 @@ static void *row_init_queue(struct request_queue *q)
 	 * enable it for write queues also, note that idling frequency will
 	 * be the same in both cases
 	 */
-	rdata->read_idle.idle_time = msecs_to_jiffies(ROW_IDLE_TIME_MSEC);
-	/* Maybe 0 on some platforms */
-	if (!rdata->read_idle.idle_time)
-		rdata->read_idle.idle_time = 1;
+	rdata->read_idle.idle_time_us = ROW_IDLE_TIME_MSEC * USEC_PER_MSEC;
 	rdata->read_idle.freq = ROW_READ_FREQ_MSEC;
 	rdata->read_idle.idle_workqueue = create_workqueue("row_idle_work");
 	if (!rdata->read_idle.idle_workqueue)
 		panic("Failed to create idle workqueue\n");
-	INIT_DELAYED_WORK(&rdata->read_idle.idle_work, kick_queue);
+	INIT_WORK(&rdata->read_idle.idle_work, kick_queue);
+	hrtimer_init(&rdata->read_idle.hr_timer, CLOCK_MONOTONIC,
+		     HRTIMER_MODE_REL);
+	rdata->read_idle.hr_timer.function = &row_idle_hrtimer_fn;
+
+	rdata->adaptive = 1;
+	rdata->write_starve_us = ROW_WRITE_STARVE_MSEC * USEC_PER_MSEC;
+
+	blkio_throtl_init(&rdata->throtl, q, row_queue_request);
     
 	rdata->curr_queue = ROWQ_PRIO_HIGH_READ;
 	rdata->dispatch_queue = q;
@@ -586,12 +683,53 @@ static void row_exit_queue(struct elevator_queue *e)
     
 	for (i = 0; i < ROWQ_MAX_PRIO; i++)
 		BUG_ON(!list_empty(&rd->row_queues[i].fifo));
-	(void)cancel_delayed_work_sync(&rd->read_idle.idle_work);
-	BUG_ON(delayed_work_pending(&rd->read_idle.idle_work));
+	hrtimer_cancel(&rd->read_idle.hr_timer);
+	(void)cancel_work_sync(&rd->read_idle.idle_work);
 	destroy_workqueue(rd->read_idle.idle_workqueue);
+	blkio_throtl_exit(&rd->throtl);
 	kfree(rd);
 }
 
+/*
+ * row_activate_request() - Called when the driver starts a request
+ * @q:		requests queue
+ * @rq:		request being started
+ *
+ * Stamp the request so its completion latency can be measured.
+ */
+static void row_activate_request(struct request_queue *q, struct request *rq)
+{
+	rq->elevator_private2 = (void *)(unsigned long)ktime_to_us(ktime_get());
+}
+
+/*
+ * row_completed_request() - Called when a request completes
+ * @q:		requests queue
+ * @rq:		completed request
+ *
+ * Fold the request's latency into the EWMA for its direction.
+ */
+static void row_completed_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	unsigned long start = (unsigned long)rq->elevator_private2;
+	unsigned long *avg = &rd->lat_us[rq_data_dir(rq)];
+	unsigned long lat;
+
+	if (!start)
+		return;
+	rq->elevator_private2 = NULL;
+
+	lat = (unsigned long)ktime_to_us(ktime_get()) - start;
+	if (!*avg)
+		*avg = lat;
+	else
+		*avg = *avg + ((long)(lat - *avg) >> ROW_LAT_EWMA_SHIFT);
+
+	if (rd->adaptive && rq_data_dir(rq) == READ)
+		row_adapt(rd);
+}
+
 /*
  * row_merged_requests() - Called when 2 requests are merged
  * @q:		requests queue
@@ -649,6 +787,7 @@ row_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
 	rq->elevator_private =
     (void *)(&rd->row_queues[get_queue_type(rq)]);
 	spin_unlock_irqrestore(q->queue_lock, flags);
+	blkio_throtl_set_request(rq);
     
 	return 0;
 }
@@ -690,8 +829,15 @@ SHOW_FUNCTION(row_lp_read_quantum_show,
               rowd->row_queues[ROWQ_PRIO_LOW_READ].disp_quantum, 0);
 SHOW_FUNCTION(row_lp_swrite_quantum_show,
               rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].disp_quantum, 0);
-SHOW_FUNCTION(row_read_idle_show, rowd->read_idle.idle_time, 0);
+SHOW_FUNCTION(row_read_idle_show,
+              rowd->read_idle.idle_time_us / USEC_PER_MSEC, 0);
+SHOW_FUNCTION(row_read_idle_us_show, rowd->read_idle.idle_time_us, 0);
 SHOW_FUNCTION(row_read_idle_freq_show, rowd->read_idle.freq, 0);
+SHOW_FUNCTION(row_adaptive_show, rowd->adaptive, 0);
+SHOW_FUNCTION(row_write_starve_show,
+              rowd->write_starve_us / USEC_PER_MSEC, 0);
+SHOW_FUNCTION(row_read_latency_us_show, rowd->lat_us[READ], 0);
+SHOW_FUNCTION(row_write_latency_us_show, rowd->lat_us[WRITE], 0);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -730,11 +876,36 @@ STORE_FUNCTION(row_lp_read_quantum_store,
 STORE_FUNCTION(row_lp_swrite_quantum_store,
                &rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].disp_quantum,
                1, INT_MAX, 1);
-STORE_FUNCTION(row_read_idle_store, &rowd->read_idle.idle_time, 1, INT_MAX, 0);
 STORE_FUNCTION(row_read_idle_freq_store, &rowd->read_idle.freq, 1, INT_MAX, 0);
+STORE_FUNCTION(row_adaptive_store, &rowd->adaptive, 0, 1, 0);
 
 #undef STORE_FUNCTION
 
+/* Fixed idling in msec, only holds while adaptive is 0 */
+static ssize_t row_read_idle_store(struct elevator_queue *e,
+				   const char *page, size_t count)
+{
+	struct row_data *rowd = e->elevator_data;
+	int data;
+	int ret = row_var_store(&data, page, count);
+
+	rowd->read_idle.idle_time_us = clamp(data, 1, INT_MAX / 1000) *
+		USEC_PER_MSEC;
+	return ret;
+}
+
+static ssize_t row_write_starve_store(struct elevator_queue *e,
+				      const char *page, size_t count)
+{
+	struct row_data *rowd = e->elevator_data;
+	int data;
+	int ret = row_var_store(&data, page, count);
+
+	rowd->write_starve_us = clamp(data, 1, INT_MAX / 1000) *
+		USEC_PER_MSEC;
+	return ret;
+}
+
 #define ROW_ATTR(name) \
 __ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
 row_##name##_store)
@@ -749,6 +920,11 @@ static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(lp_swrite_quantum),
 	ROW_ATTR(read_idle),
 	ROW_ATTR(read_idle_freq),
+	ROW_ATTR(adaptive),
+	ROW_ATTR(write_starve),
+	__ATTR(read_idle_us, S_IRUGO, row_read_idle_us_show, NULL),
+	__ATTR(read_latency_us, S_IRUGO, row_read_latency_us_show, NULL),
+	__ATTR(write_latency_us, S_IRUGO, row_write_latency_us_show, NULL),
 	__ATTR_NULL
 };
 
@@ -759,6 +935,8 @@ static struct elevator_type iosched_row = {
 		.elevator_add_req_fn		= row_add_request,
 		.elevator_reinsert_req_fn	= row_reinsert_req,
 		.elevator_is_urgent_fn		= row_urgent_pending,
+		.elevator_activate_req_fn	= row_activate_request,
+		.elevator_completed_req_fn	= row_completed_request,
 		.elevator_former_req_fn		= elv_rb_former_request,
 		.elevator_latter_req_fn		= elv_rb_latter_request,
 		.elevator_set_req_fn		= row_set_request,
@@ -21,6 +21,9 @@
 #include <linux/version.h>
 #include <linux/slab.h>
 
+#include "elv-fifo.h"
+#include "blk-cgroup.h"
+
 enum { ASYNC, SYNC };
 
 /* Tunables */
@@ -47,29 +50,23 @@ struct sio_data {
 	int fifo_expire[2][2];
 	int fifo_batch;
 	int writes_starved;
+
+	/* Requests held back by blkio throttling */
+	struct blkio_throtl_data throtl;
 };
 
 static void
 sio_merged_requests(struct request_queue *q, struct request *rq,
 		    struct request *next)
 {
-	/*
-	 * If next expires before rq, assign its expire time to rq
-	 * and move into next position (next will be deleted) in fifo.
-	 */
-	if (!list_empty(&rq->queuelist) && !list_empty(&next->queuelist)) {
-		if (time_before(rq_fifo_time(next), rq_fifo_time(rq))) {
-			list_move(&rq->queuelist, &next->queuelist);
-			rq_set_fifo_time(rq, rq_fifo_time(next));
-		}
-	}
+	elv_fifo_merge(rq, next);
 
 	/* Delete next request */
 	rq_fifo_clear(next);
 }
 
 static void
-sio_add_request(struct request_queue *q, struct request *rq)
+sio_queue_request(struct request_queue *q, struct request *rq)
 {
 	struct sio_data *sd = q->elevator->elevator_data;
 	const int sync = rq_is_sync(rq);
@@ -79,8 +76,18 @@ sio_add_request(struct request_queue *q, struct request *rq)
 	 * Add request to the proper fifo list and set its
 	 * expire time.
 	 */
-	rq_set_fifo_time(rq, jiffies + sd->fifo_expire[sync][data_dir]);
-	list_add_tail(&rq->queuelist, &sd->fifo_list[sync][data_dir]);
+	elv_fifo_add(&sd->fifo_list[sync][data_dir], rq,
+		     sd->fifo_expire[sync][data_dir]);
+}
+
+static void
+sio_add_request(struct request_queue *q, struct request *rq)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+
+	/* Throttled requests come back through sio_queue_request() */
+	if (!blkio_throtl_park(&sd->throtl, rq))
+		sio_queue_request(q, rq);
 }
 
 #if LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,38)
@@ -95,23 +102,10 @@ sio_queue_empty(struct request_queue *q)
 }
 #endif
 
-static struct request *
+static inline struct request *
 sio_expired_request(struct sio_data *sd, int sync, int data_dir)
 {
-	struct list_head *list = &sd->fifo_list[sync][data_dir];
-	struct request *rq;
-
-	if (list_empty(list))
-		return NULL;
-
-	/* Retrieve request */
-	rq = rq_entry_fifo(list->next);
-
-	/* Request has expired */
-	if (time_after(jiffies, rq_fifo_time(rq)))
-		return rq;
-
-	return NULL;
+	return elv_fifo_expired(&sd->fifo_list[sync][data_dir]);
 }
 
 static struct request *
@@ -146,23 +140,22 @@ sio_choose_request(struct sio_data *sd, int data_dir)
 {
 	struct list_head *sync = sd->fifo_list[SYNC];
 	struct list_head *async = sd->fifo_list[ASYNC];
+	struct request *rq;
 
 	/*
 	 * Retrieve request from available fifo list.
 	 * Synchronous requests have priority over asynchronous.
 	 * Read requests have priority over write.
 	 */
-	if (!list_empty(&sync[data_dir]))
-		return rq_entry_fifo(sync[data_dir].next);
-	if (!list_empty(&async[data_dir]))
-		return rq_entry_fifo(async[data_dir].next);
-
-	if (!list_empty(&sync[!data_dir]))
-		return rq_entry_fifo(sync[!data_dir].next);
-	if (!list_empty(&async[!data_dir]))
-		return rq_entry_fifo(async[!data_dir].next);
-
-	return NULL;
+	rq = elv_fifo_first(&sync[data_dir]);
+	if (!rq)
+		rq = elv_fifo_first(&async[data_dir]);
+	if (!rq)
+		rq = elv_fifo_first(&sync[!data_dir]);
+	if (!rq)
+		rq = elv_fifo_first(&async[!data_dir]);
+
+	return rq;
 }
 
 static inline void
@@ -190,6 +183,9 @@ sio_dispatch_requests(struct request_queue *q, int force)
 	struct request *rq = NULL;
 	int data_dir = READ;
 
+	if (unlikely(force))
+		blkio_throtl_release(&sd->throtl, true);
+
 	/*
 	 * Retrieve any expired request after a batch of
 	 * sequential requests.
@@ -243,6 +239,14 @@ sio_latter_request(struct request_queue *q, struct request *rq)
 	return list_entry(rq->queuelist.next, struct request, queuelist);
 }
 
+static int
+sio_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
+{
+	blkio_throtl_set_request(rq);
+
+	return 0;
+}
+
 static void *
 sio_init_queue(struct request_queue *q)
 {
@@ -267,6 +271,8 @@ sio_init_queue(struct request_queue *q)
 	sd->fifo_expire[ASYNC][WRITE] = async_write_expire;
 	sd->fifo_batch = fifo_batch;
 
+	blkio_throtl_init(&sd->throtl, q, sio_queue_request);
+
 	return sd;
 }
 
@@ -280,6 +286,8 @@ sio_exit_queue(struct elevator_queue *e)
 	BUG_ON(!list_empty(&sd->fifo_list[ASYNC][READ]));
 	BUG_ON(!list_empty(&sd->fifo_list[ASYNC][WRITE]));
 
+	blkio_throtl_exit(&sd->throtl);
+
 	/* Free structure */
 	kfree(sd);
 }
@@ -368,6 +376,7 @@ static struct elevator_type iosched_sio = {
 #endif
 		.elevator_former_req_fn		= sio_former_request,
 		.elevator_latter_req_fn		= sio_latter_request,
+		.elevator_set_req_fn		= sio_set_request,
 		.elevator_init_fn		= sio_init_queue,
 		.elevator_exit_fn		= sio_exit_queue,
 	},
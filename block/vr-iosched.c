@@ -29,6 +29,8 @@
 
 #include <asm/div64.h>
 
+#include "elv-fifo.h"
+
 enum vr_data_dir {
 ASYNC,
 SYNC,
@@ -117,10 +119,8 @@ const int dir = rq_is_sync(rq);
 
 vr_add_rq_rb(vd, rq);
 
-if (vd->fifo_expire[dir]) {
-rq_set_fifo_time(rq, jiffies + vd->fifo_expire[dir]);
-list_add_tail(&rq->queuelist, &vd->fifo_list[dir]);
-}
+if (vd->fifo_expire[dir])
+elv_fifo_add(&vd->fifo_list[dir], rq, vd->fifo_expire[dir]);
 }
 
 /*
@@ -167,17 +167,7 @@ static void
 vr_merged_requests(struct request_queue *q, struct request *rq,
 struct request *next)
 {
-/*
-* if next expires before rq, assign its expire time to rq
-* and move into next position (next will be deleted) in fifo
-*/
-if (!list_empty(&rq->queuelist) && !list_empty(&next->queuelist)) {
-if (time_before(rq_fifo_time(next), rq_fifo_time(rq))) {
-list_move(&rq->queuelist, &next->queuelist);
-rq_set_fifo_time(rq, rq_fifo_time(next));
-}
-}
-
+elv_fifo_merge(rq, next);
 vr_remove_request(q, next);
 }
 
@@ -205,41 +195,14 @@ elv_dispatch_add_tail(q, rq);
 vd->nbatched++;
 }
 
-/*
-* get the first expired request in direction ddir
-*/
-static struct request *
-vr_expired_request(struct vr_data *vd, int ddir)
-{
-struct request *rq;
-
-if (list_empty(&vd->fifo_list[ddir]))
-return NULL;
-
-rq = rq_entry_fifo(vd->fifo_list[ddir].next);
-if (time_after(jiffies, rq_fifo_time(rq)))
-return rq;
-
-return NULL;
-}
-
 /*
 * Returns the oldest expired request
 */
 static struct request *
 vr_check_fifo(struct vr_data *vd)
 {
-struct request *rq_sync = vr_expired_request(vd, SYNC);
-struct request *rq_async = vr_expired_request(vd, ASYNC);
-
-if (rq_async && rq_sync) {
-if (time_after(rq_fifo_time(rq_async), rq_fifo_time(rq_sync)))
-return rq_sync;
-}
-else if (rq_sync)
-return rq_sync;
-
-return rq_async;
+return elv_fifo_earlier(elv_fifo_expired(&vd->fifo_list[SYNC]),
+elv_fifo_expired(&vd->fifo_list[ASYNC]));
 }
 
 /*
@@ -14,6 +14,8 @@
 #include <linux/slab.h>
 #include <linux/init.h>
 
+#include "elv-fifo.h"
+
 enum zen_data_dir { ASYNC, SYNC };
 
 static const int sync_expire  = HZ / 4;    /* max time before a sync is submitted. */
@@ -43,16 +45,7 @@ static void
 zen_merged_requests(struct request_queue *q, struct request *req,
                     struct request *next)
 {
-	/*
-	 * if next expires before rq, assign its expire time to arq
-	 * and move into next position (next will be deleted) in fifo
-	 */
-	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
-		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
-			list_move(&req->queuelist, &next->queuelist);
-			rq_set_fifo_time(req, rq_fifo_time(next));
-		}
-	}
+	elv_fifo_merge(req, next);
 
 	/* next request is gone */
 	rq_fifo_clear(next);
@@ -61,12 +54,11 @@ zen_merged_requests(struct request_queue *q, struct request *req,
 static void zen_add_request(struct request_queue *q, struct request *rq)
 {
 	struct zen_data *zdata = zen_get_data(q);
-	const int dir = rq_data_dir(rq);
+	const int sync = rq_is_sync(rq);
 
-	if (zdata->fifo_expire[dir]) {
-		rq_set_fifo_time(rq, jiffies + zdata->fifo_expire[dir]);
-		list_add_tail(&rq->queuelist, &zdata->fifo_list[dir]);
-	}
+	if (zdata->fifo_expire[sync])
+		elv_fifo_add(&zdata->fifo_list[sync], rq,
+			     zdata->fifo_expire[sync]);
 }
 
 static void zen_dispatch(struct zen_data *zdata, struct request *rq)
@@ -80,58 +72,30 @@ static void zen_dispatch(struct zen_data *zdata, struct request *rq)
 }
 
 /*
- * get the first expired request in direction ddir
- */
-static struct request *
-zen_expired_request(struct zen_data *zdata, int ddir)
-{
-        struct request *rq;
-
-        if (list_empty(&zdata->fifo_list[ddir]))
-                return NULL;
-
-        rq = rq_entry_fifo(zdata->fifo_list[ddir].next);
-        if (time_after(jiffies, rq_fifo_time(rq)))
-                return rq;
-
-        return NULL;
-}
-
-/*
- * zen_check_fifo returns 0 if there are no expired requests on the fifo,
- * otherwise it returns the next expired request
+ * zen_check_fifo returns NULL if there are no expired requests on the
+ * fifo, otherwise it returns the oldest expired request
  */
 static struct request *
 zen_check_fifo(struct zen_data *zdata)
 {
-        struct request *rq_sync = zen_expired_request(zdata, SYNC);
-        struct request *rq_async = zen_expired_request(zdata, ASYNC);
-
-        if (rq_async && rq_sync) {
-        	if (time_after(rq_fifo_time(rq_async), rq_fifo_time(rq_sync)))
-                	return rq_sync;
-        } else if (rq_sync) {
-                return rq_sync;
-	} else if (rq_async) {
-		return rq_async;
-	}
-
-        return 0;
+	return elv_fifo_earlier(elv_fifo_expired(&zdata->fifo_list[SYNC]),
+				elv_fifo_expired(&zdata->fifo_list[ASYNC]));
 }
 
 static struct request *
 zen_choose_request(struct zen_data *zdata)
 {
-        /*
-         * Retrieve request from available fifo list.
-         * Synchronous requests have priority over asynchronous.
-         */
-        if (!list_empty(&zdata->fifo_list[SYNC]))
-                return rq_entry_fifo(zdata->fifo_list[SYNC].next);
-        if (!list_empty(&zdata->fifo_list[ASYNC]))
-                return rq_entry_fifo(zdata->fifo_list[ASYNC].next);
-
-        return NULL;
+	struct request *rq;
+
+	/*
+	 * Retrieve request from available fifo list.
+	 * Synchronous requests have priority over asynchronous.
+	 */
+	rq = elv_fifo_first(&zdata->fifo_list[SYNC]);
+	if (!rq)
+		rq = elv_fifo_first(&zdata->fifo_list[ASYNC]);
+
+	return rq;
 }
 
 static int zen_dispatch_requests(struct request_queue *q, int force)
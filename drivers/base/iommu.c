@@ -22,6 +22,7 @@
 #include <linux/slab.h>
 #include <linux/errno.h>
 #include <linux/iommu.h>
+#include <linux/scatterlist.h>
 
 static struct iommu_ops *iommu_ops;
 
@@ -122,3 +123,62 @@ int iommu_unmap(struct iommu_domain *domain, unsigned long iova, int gfp_order)
 	return iommu_ops->unmap(domain, iova, gfp_order);
 }
 EXPORT_SYMBOL_GPL(iommu_unmap);
+
+/*
+ * Map len bytes of the scatterlist at iova. Drivers that implement
+ * map_range update the page table for the whole range and invalidate
+ * the TLB once, the others get a page at a time through map.
+ */
+int iommu_map_range(struct iommu_domain *domain, unsigned int iova,
+		    struct scatterlist *sg, unsigned int len, int prot)
+{
+	unsigned int mapped = 0, off;
+	phys_addr_t pa;
+	int ret = 0;
+
+	BUG_ON((iova | len) & ~PAGE_MASK);
+
+	if (iommu_ops->map_range)
+		return iommu_ops->map_range(domain, iova, sg, len, prot);
+
+	for (; sg && mapped < len; sg = sg_next(sg)) {
+		pa = sg_dma_address(sg) ? sg_dma_address(sg) : sg_phys(sg);
+		for (off = 0; off < sg->length && mapped < len;
+		     off += PAGE_SIZE, mapped += PAGE_SIZE) {
+			ret = iommu_ops->map(domain, iova + mapped, pa + off, 0,
+					     prot);
+			if (ret)
+				goto fail;
+		}
+	}
+	if (mapped < len) {
+		ret = -EINVAL;
+		goto fail;
+	}
+	return 0;
+
+fail:
+	while (mapped) {
+		mapped -= PAGE_SIZE;
+		iommu_ops->unmap(domain, iova + mapped, 0);
+	}
+	return ret;
+}
+EXPORT_SYMBOL_GPL(iommu_map_range);
+
+int iommu_unmap_range(struct iommu_domain *domain, unsigned int iova,
+		      unsigned int len)
+{
+	unsigned int off;
+	int ret = 0;
+
+	BUG_ON((iova | len) & ~PAGE_MASK);
+
+	if (iommu_ops->unmap_range)
+		return iommu_ops->unmap_range(domain, iova, len);
+
+	for (off = 0; off < len; off += PAGE_SIZE)
+		ret |= iommu_ops->unmap(domain, iova + off, 0);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(iommu_unmap_range);
@@ -26,6 +26,7 @@
 #include <linux/interrupt.h>
 #include <linux/sched.h>
 #include <linux/async.h>
+#include <linux/spinlock.h>
 #include <linux/timer.h>
 
 #include "../base.h"
@@ -196,6 +197,108 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 	}
 }
 
+/*
+ * The slowest devices of the last suspend and resume, with the time their
+ * callbacks took. The time a device spends waiting for its parent or its
+ * children is not counted, so an asynchronous device shows its own cost.
+ */
+#define DPM_REPORT_DEVICES	10
+
+struct dpm_report_entry {
+	char name[32];
+	s64 usecs;
+	bool async;
+};
+
+struct dpm_report {
+	struct dpm_report_entry slowest[DPM_REPORT_DEVICES];
+	unsigned int devices;
+	unsigned int async_devices;
+	s64 total_usecs;
+};
+
+static struct dpm_report dpm_suspend_report, dpm_resume_report;
+static DEFINE_SPINLOCK(dpm_report_lock);
+
+static void dpm_report_start(struct dpm_report *report)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dpm_report_lock, flags);
+	memset(report, 0, sizeof(*report));
+	spin_unlock_irqrestore(&dpm_report_lock, flags);
+}
+
+static void dpm_report_end(struct dpm_report *report, ktime_t starttime)
+{
+	report->total_usecs = ktime_us_delta(ktime_get(), starttime);
+}
+
+static void dpm_report_add(struct dpm_report *report, struct device *dev,
+			   ktime_t calltime, bool async)
+{
+	struct dpm_report_entry *e;
+	unsigned long flags;
+	s64 usecs = ktime_us_delta(ktime_get(), calltime);
+	int i;
+
+	if (report == &dpm_suspend_report)
+		dev->power.suspend_time = usecs;
+	else
+		dev->power.resume_time = usecs;
+
+	spin_lock_irqsave(&dpm_report_lock, flags);
+	report->devices++;
+	if (async)
+		report->async_devices++;
+
+	/* Keep slowest[] sorted, slowest first */
+	i = DPM_REPORT_DEVICES - 1;
+	if (usecs <= report->slowest[i].usecs)
+		goto out;
+	for (; i > 0 && usecs > report->slowest[i - 1].usecs; i--)
+		report->slowest[i] = report->slowest[i - 1];
+	e = &report->slowest[i];
+	snprintf(e->name, sizeof(e->name), "%s %s",
+		 dev_driver_string(dev), dev_name(dev));
+	e->usecs = usecs;
+	e->async = async;
+out:
+	spin_unlock_irqrestore(&dpm_report_lock, flags);
+}
+
+static int dpm_report_print(char *buf, int size, const char *phase,
+			    struct dpm_report *report)
+{
+	int i, n;
+
+	n = scnprintf(buf, size, "%s: %lld usecs, %u devices, %u async\n",
+		      phase, report->total_usecs, report->devices,
+		      report->async_devices);
+	for (i = 0; i < DPM_REPORT_DEVICES; i++) {
+		struct dpm_report_entry *e = &report->slowest[i];
+
+		if (!e->usecs)
+			break;
+		n += scnprintf(buf + n, size - n, "  %10lld %s%s\n", e->usecs,
+			       e->name, e->async ? " (async)" : "");
+	}
+	return n;
+}
+
+ssize_t dpm_report_show(char *buf)
+{
+	unsigned long flags;
+	int n;
+
+	spin_lock_irqsave(&dpm_report_lock, flags);
+	n = dpm_report_print(buf, PAGE_SIZE, "suspend", &dpm_suspend_report);
+	n += dpm_report_print(buf + n, PAGE_SIZE - n, "resume",
+			      &dpm_resume_report);
+	spin_unlock_irqrestore(&dpm_report_lock, flags);
+	return n;
+}
+
 /**
  * dpm_wait - Wait for a PM operation to complete.
  * @dev: Device to wait for.
@@ -522,6 +625,7 @@ static int legacy_resume(struct device *dev, int (*cb)(struct device *dev))
  */
 static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
+	ktime_t calltime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -529,6 +633,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 
 	if (dev->parent && dev->parent->power.status >= DPM_OFF)
 		dpm_wait(dev->parent, async);
+	calltime = ktime_get();
 	device_lock(dev);
 
 	dev->power.status = DPM_RESUMING;
@@ -566,6 +671,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
  End:
 	device_unlock(dev);
 	complete_all(&dev->power.completion);
+	dpm_report_add(&dpm_resume_report, dev, calltime, async);
 
 	TRACE_RESUME(error);
 	return error;
@@ -641,6 +747,7 @@ static void dpm_resume(pm_message_t state)
 	ktime_t starttime = ktime_get();
 
 	INIT_LIST_HEAD(&list);
+	dpm_report_start(&dpm_resume_report);
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 
@@ -679,6 +786,7 @@ static void dpm_resume(pm_message_t state)
 	list_splice(&list, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	dpm_report_end(&dpm_resume_report, starttime);
 	dpm_show_time(starttime, state, NULL);
 }
 
@@ -882,9 +990,11 @@ static int async_error;
  */
 static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 {
+	ktime_t calltime;
 	int error = 0;
 
 	dpm_wait_for_children(dev, async);
+	calltime = ktime_get();
 	device_lock(dev);
 
 	if (async_error)
@@ -927,6 +1037,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
  End:
 	device_unlock(dev);
 	complete_all(&dev->power.completion);
+	dpm_report_add(&dpm_suspend_report, dev, calltime, async);
 
 	return error;
 }
@@ -969,6 +1080,7 @@ static int dpm_suspend(pm_message_t state)
 	int error = 0;
 
 	INIT_LIST_HEAD(&list);
+	dpm_report_start(&dpm_suspend_report);
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
@@ -997,6 +1109,7 @@ static int dpm_suspend(pm_message_t state)
 	list_splice(&list, dpm_list.prev);
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	dpm_report_end(&dpm_suspend_report, starttime);
 	if (!error)
 		error = async_error;
 	if (!error)
@@ -73,6 +73,11 @@
  *	device are known to the PM core.  However, for some devices this
  *	attribute is set to "enabled" by bus type code or device drivers and in
  *	that cases it should be safe to leave the default value.
+ *
+ *	suspend_time, resume_time - Report how long, in microseconds, the
+ *	device's suspend and resume callbacks took in the last system-wide
+ *	power state transition.  The time spent waiting for the device's
+ *	children (suspend) or parent (resume) is not included.
  */
 
 static const char enabled[] = "enabled";
@@ -225,11 +230,33 @@ static ssize_t async_store(struct device *dev, struct device_attribute *attr,
 static DEVICE_ATTR(async, 0644, async_show, async_store);
 #endif /* CONFIG_PM_ADVANCED_DEBUG */
 
+#ifdef CONFIG_PM_SLEEP
+static ssize_t suspend_time_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lld\n", dev->power.suspend_time);
+}
+
+static DEVICE_ATTR(suspend_time, 0444, suspend_time_show, NULL);
+
+static ssize_t resume_time_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lld\n", dev->power.resume_time);
+}
+
+static DEVICE_ATTR(resume_time, 0444, resume_time_show, NULL);
+#endif
+
 static struct attribute * power_attrs[] = {
 #ifdef CONFIG_PM_RUNTIME
 	&dev_attr_control.attr,
 #endif
 	&dev_attr_wakeup.attr,
+#ifdef CONFIG_PM_SLEEP
+	&dev_attr_suspend_time.attr,
+	&dev_attr_resume_time.attr,
+#endif
 #ifdef CONFIG_PM_ADVANCED_DEBUG
 	&dev_attr_async.attr,
 #ifdef CONFIG_PM_RUNTIME
@@ -167,6 +167,11 @@ struct diagchar_dev {
 	uint8_t *msg_masks;
 	uint8_t *log_masks;
 	int log_masks_length;
+	/* filter modem traffic against the masks set by the host */
+	int filter_modem_logs;
+	int filter_modem_msgs;
+	int modem_in_frame;
+	unsigned long modem_filtered;
 	uint8_t *event_masks;
 	struct diag_master_table *table;
 	uint8_t *pkt_buf;
@@ -576,37 +576,12 @@ static int diagchar_write(struct file *file, const char __user *buf,
 		return 0;
 	}
 
-	buf_copy = diagmem_alloc(driver, payload_size, POOL_TYPE_COPY);
-	if (!buf_copy) {
+	/* worst case every byte and the crc escaped, plus the terminator */
+	if (payload_size < 0 || (2*payload_size) + 5 > HDLC_OUT_BUF_SIZE) {
 		driver->dropped_count++;
-		return -ENOMEM;
+		return -EBADMSG;
 	}
 
-	err = copy_from_user(buf_copy, buf + 4, payload_size);
-	if (err) {
-		printk(KERN_INFO "diagchar : copy_from_user failed\n");
-		ret = -EFAULT;
-		goto fail_free_copy;
-	}
-#ifdef DIAG_DEBUG
-	printk(KERN_DEBUG "data is -->\n");
-	for (i = 0; i < payload_size; i++)
-		printk(KERN_DEBUG "\t %x \t", *(((unsigned char *)buf_copy)+i));
-#endif
-	send.state = DIAG_STATE_START;
-	send.pkt = buf_copy;
-	send.last = (void *)(buf_copy + payload_size - 1);
-	send.terminate = 1;
-#ifdef DIAG_DEBUG
-	printk(KERN_INFO "\n Already used bytes in buffer %d, and"
-	" incoming payload size is %d\n", driver->used, payload_size);
-	printk(KERN_DEBUG "hdlc encoded data is -->\n");
-	for (i = 0; i < payload_size + 8; i++) {
-		printk(KERN_DEBUG "\t %x \t", *(((unsigned char *)buf_hdlc)+i));
-		if (*(((unsigned char *)buf_hdlc)+i) != 0x7e)
-			length++;
-	}
-#endif
 	mutex_lock(&driver->diagchar_mutex);
 	if (!buf_hdlc)
 		buf_hdlc = diagmem_alloc(driver, HDLC_OUT_BUF_SIZE,
@@ -638,13 +613,48 @@ static int diagchar_write(struct file *file, const char __user *buf,
 		}
 	}
 
+	/*
+	 * Copy the payload straight into the tail of the room reserved for
+	 * its encoding and encode it in place, rather than going through a
+	 * separate copy buffer.
+	 */
+	buf_copy = buf_hdlc + driver->used + payload_size + 4;
+	err = copy_from_user(buf_copy, buf + 4, payload_size);
+	if (err) {
+		printk(KERN_INFO "diagchar : copy_from_user failed\n");
+		mutex_unlock(&driver->diagchar_mutex);
+		return -EFAULT;
+	}
+#ifdef DIAG_DEBUG
+	printk(KERN_DEBUG "data is -->\n");
+	for (i = 0; i < payload_size; i++)
+		printk(KERN_DEBUG "\t %x \t", *(((unsigned char *)buf_copy)+i));
+#endif
+	send.state = DIAG_STATE_START;
+	send.pkt = buf_copy;
+	send.last = (void *)(buf_copy + payload_size - 1);
+	send.terminate = 1;
+
 	enc.dest = buf_hdlc + driver->used;
 	enc.dest_last = (void *)(buf_hdlc + driver->used + 2*payload_size + 3);
 	diag_hdlc_encode(&send, &enc);
+#ifdef DIAG_DEBUG
+	printk(KERN_INFO "\n Already used bytes in buffer %d, and"
+	" incoming payload size is %d\n", driver->used, payload_size);
+	printk(KERN_DEBUG "hdlc encoded data is -->\n");
+	for (i = 0; i < payload_size + 8; i++) {
+		printk(KERN_DEBUG "\t %x \t",
+		       *(((unsigned char *)buf_hdlc + driver->used)+i));
+		if (*(((unsigned char *)buf_hdlc + driver->used)+i) != 0x7e)
+			length++;
+	}
+#endif
 
 	/* This is to check if after HDLC encoding, we are still within the
 	 limits of aggregation buffer. If not, we write out the current buffer
-	and start aggregation in a newly allocated buffer */
+	and start aggregation in a newly allocated buffer. The payload itself
+	always fits the room reserved above, so only the crc and terminator
+	can be left and the source is not needed any more. */
 	if ((unsigned int) enc.dest >=
 		 (unsigned int)(buf_hdlc + HDLC_OUT_BUF_SIZE)) {
 		err = diag_device_write(buf_hdlc, APPS_DATA, NULL);
@@ -692,7 +702,6 @@ static int diagchar_write(struct file *file, const char __user *buf,
 	}
 
 	mutex_unlock(&driver->diagchar_mutex);
-	diagmem_free(driver, buf_copy, POOL_TYPE_COPY);
 	if (!timer_in_progress)	{
 		timer_in_progress = 1;
 		ret = mod_timer(&drain_timer, jiffies + msecs_to_jiffies(500));
@@ -702,13 +711,8 @@ static int diagchar_write(struct file *file, const char __user *buf,
 fail_free_hdlc:
 	buf_hdlc = NULL;
 	driver->used = 0;
-	diagmem_free(driver, buf_copy, POOL_TYPE_COPY);
 	mutex_unlock(&driver->diagchar_mutex);
 	return ret;
-
-fail_free_copy:
-	diagmem_free(driver, buf_copy, POOL_TYPE_COPY);
-	return ret;
 }
 
 int mask_request_validate(unsigned char mask_buf[])
@@ -33,6 +33,48 @@ MODULE_LICENSE("GPL v2");
 #define CRC_16_L_STEP(xx_crc, xx_c) \
 	crc_ccitt_byte(xx_crc, xx_c)
 
+/*
+ * Find the first byte in [src, end) that needs escaping, a word at a
+ * time. CONTROL_CHAR and ESC_CHAR only differ in their two low bits,
+ * so or-ing those in and looking for a 0x7f byte catches both; it also
+ * stops at 0x7c and 0x7f, which the byte loop then steps over.
+ */
+static const uint8_t *diag_hdlc_scan(const uint8_t *src, const uint8_t *end)
+{
+	const unsigned long ones = ~0UL / 0xff;
+	unsigned long w;
+	int i, n;
+
+	while (src < end && ((unsigned long)src & (sizeof(long) - 1))) {
+		if (*src == CONTROL_CHAR || *src == ESC_CHAR)
+			return src;
+		src++;
+	}
+
+	while (src < end) {
+		while (end - src >= sizeof(long)) {
+			w = (*(const unsigned long *)src | (ones * 0x03)) ^
+				(ones * 0x7f);
+			if ((w - ones) & ~w & (ones * 0x80))
+				break;
+			src += sizeof(long);
+		}
+
+		n = min_t(int, end - src, sizeof(long));
+		for (i = 0; i < n; i++)
+			if (src[i] == CONTROL_CHAR || src[i] == ESC_CHAR)
+				return src + i;
+		src += n;
+	}
+
+	return end;
+}
+
+/*
+ * The source may sit inside the destination buffer, ahead of dest, as
+ * long as it starts at least len + 4 bytes in: dest then never catches
+ * up with bytes that have not been read yet.
+ */
 void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 		      struct diag_hdlc_dest_type *enc)
 {
@@ -68,6 +110,21 @@ void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 			/* This condition needs to include the possibility
 			   of 2 dest bytes for an escaped byte */
 			while (src <= src_last && dest <= dest_last) {
+				unsigned int run;
+
+				/* Copy the bytes up to the next one needing
+				   an escape in one go */
+				run = diag_hdlc_scan(src, src_last + 1) - src;
+				if (run > dest_last - dest + 1)
+					run = dest_last - dest + 1;
+				if (run) {
+					crc = crc_ccitt(crc, src, run);
+					memmove(dest, src, run);
+					src += run;
+					dest += run;
+					used += run;
+					continue;
+				}
 
 				src_byte = *src++;
 
@@ -66,6 +66,133 @@ do {									\
 #define CHK_OVERFLOW(bufStart, start, end, length) \
 ((bufStart <= start) && (end - start >= length)) ? 1 : 0
 
+/* Log masks start with a table of where each equipment id's bits are */
+struct diag_log_mask_info {
+	int equip_id;
+	int index;
+};
+
+/*
+ * Filtering of modem traffic
+ *
+ * The masks the host sets are forwarded to the modem, but the apps side
+ * keeps a copy of them too. Once the host has set one, log and message
+ * packets from the modem that it does not ask for are dropped here
+ * instead of being sent on to USB. Anything the copy of the masks does
+ * not cover is let through. The masks are read without the mutex; a
+ * packet racing a mask update goes one way or the other.
+ */
+static int diag_log_code_wanted(uint16_t code)
+{
+	struct diag_log_mask_info *ptr =
+		(struct diag_log_mask_info *)driver->log_masks;
+	int equip_id = code >> 12;
+	int item = code & 0xfff;
+	int i, size;
+
+	for (i = 0; i < MAX_EQUIP_ID; i++, ptr++) {
+		if ((ptr->equip_id == 0) && (ptr->index == 0))
+			break;
+		if (ptr->equip_id != equip_id)
+			continue;
+		if ((i + 1 < MAX_EQUIP_ID) && ptr[1].index)
+			size = ptr[1].index - ptr->index;
+		else
+			size = driver->log_masks_length - ptr->index;
+		if (item / 8 >= size)
+			return 0;
+		return driver->log_masks[ptr->index + item / 8] &
+			(1 << (item % 8));
+	}
+
+	return 1;
+}
+
+static int diag_msg_wanted(uint32_t ssid, uint32_t ss_mask)
+{
+	uint8_t *ptr = driver->msg_masks;
+	uint8_t *ptr_end = driver->msg_masks + MSG_MASK_SIZE;
+	uint32_t first, last;
+
+	while (ptr + 8 <= ptr_end && *(uint32_t *)(ptr + 4)) {
+		first = *(uint32_t *)ptr;
+		last = *(uint32_t *)(ptr + 4);
+		ptr += 8;
+		if (ssid >= first && ssid <= last)
+			return *((uint32_t *)ptr + (ssid - first)) & ss_mask;
+		ptr += ((last - first) + 1)*4;
+	}
+
+	return 1;
+}
+
+/* Decide on one HDLC frame (without its terminator) */
+static int diag_modem_frame_wanted(const unsigned char *frame, int len)
+{
+	unsigned char hdr[20];
+	int i, n;
+
+	for (i = 0, n = 0; i < len && n < sizeof(hdr); i++) {
+		hdr[n] = frame[i];
+		if (hdr[n] == ESC_CHAR) {
+			if (++i >= len)
+				break;
+			hdr[n] = frame[i] ^ ESC_MASK;
+		}
+		n++;
+	}
+
+	/* log packet: cmd, more, len, then the log header len, code */
+	if (hdr[0] == 0x10 && n >= 8 && driver->filter_modem_logs)
+		return diag_log_code_wanted(hdr[6] | (hdr[7] << 8));
+
+	/* extended message: cmd, ts_type, num_args, drop_cnt, ts, line,
+	   ssid, ss_mask */
+	if (hdr[0] == 0x79 && n >= 20 && driver->filter_modem_msgs)
+		return diag_msg_wanted(hdr[14] | (hdr[15] << 8),
+				       hdr[16] | (hdr[17] << 8) |
+				       (hdr[18] << 16) | (hdr[19] << 24));
+
+	return 1;
+}
+
+/* Drop unwanted frames from a buffer read off the modem channel and
+   return what is left of it */
+static int diag_filter_modem(unsigned char *buf, int len)
+{
+	unsigned char *end;
+	int src = 0, dst = 0, flen;
+
+	if (!driver->filter_modem_logs && !driver->filter_modem_msgs)
+		return len;
+
+	while (src < len) {
+		end = memchr(buf + src, CONTROL_CHAR, len - src);
+		if (!end) {
+			/* frame continues in the next read */
+			memmove(buf + dst, buf + src, len - src);
+			dst += len - src;
+			driver->modem_in_frame = 1;
+			return dst;
+		}
+		flen = end - (buf + src) + 1;
+
+		/* the tail of a frame started in the last read goes out */
+		if (driver->modem_in_frame || flen == 1 ||
+		    diag_modem_frame_wanted(buf + src, flen - 1)) {
+			if (dst != src)
+				memmove(buf + dst, buf + src, flen);
+			dst += flen;
+		} else {
+			driver->modem_filtered++;
+		}
+		driver->modem_in_frame = 0;
+		src += flen;
+	}
+
+	return dst;
+}
+
 void __diag_smd_send_req(void)
 {
 	void *buf = NULL;
@@ -103,6 +230,9 @@ void __diag_smd_send_req(void)
 				APPEND_DEBUG('i');
 				smd_read(driver->ch, buf, r);
 				APPEND_DEBUG('j');
+				r = diag_filter_modem(buf, r);
+				if (r == 0)
+					return;
 				write_ptr_modem->length = r;
 				*in_busy_ptr = 1;
 				diag_device_write(buf, MODEM_DATA,
@@ -307,6 +437,7 @@ static void diag_update_msg_mask(int start, int end , uint8_t *buf)
 			printk(KERN_CRIT " Not enough buffer"
 					 " space for MSG_MASK\n");
 	}
+	driver->filter_modem_msgs = 1;
 	mutex_unlock(&driver->diagchar_mutex);
 	diag_print_mask_table();
 
@@ -334,14 +465,11 @@ static void diag_update_event_mask(uint8_t *buf, int toggle, int num_bits)
 static void diag_update_log_mask(int equip_id, uint8_t *buf, int num_items)
 {
 	uint8_t *temp = buf;
-	struct mask_info {
-		int equip_id;
-		int index;
-	};
 	int i = 0;
 	unsigned char *ptr_data;
 	int offset = 8*MAX_EQUIP_ID;
-	struct mask_info *ptr = (struct mask_info *)driver->log_masks;
+	struct diag_log_mask_info *ptr =
+		(struct diag_log_mask_info *)driver->log_masks;
 
 	mutex_lock(&driver->diagchar_mutex);
 	/* Check if we already know index of this equipment ID */
@@ -366,6 +494,7 @@ static void diag_update_log_mask(int equip_id, uint8_t *buf, int num_items)
 		memcpy(ptr_data, temp , (num_items+7)/8);
 	else
 		printk(KERN_CRIT " Not enough buffer space for LOG_MASK\n");
+	driver->filter_modem_logs = 1;
 	mutex_unlock(&driver->diagchar_mutex);
 }
 
@@ -416,6 +545,11 @@ static int diag_process_apps_pkt(unsigned char *buf, int len)
 	int packet_type = 1;
 	unsigned char *temp = buf;
 
+	/* Setting all message masks at once isn't mirrored here, so leave
+	   modem messages alone from then on */
+	if ((buf[0] == 0x7d) && (buf[1] == 0x5))
+		driver->filter_modem_msgs = 0;
+
 	/* event mask */
 	if ((*buf == 0x60) && (*(++buf) == 0x0)) {
 		diag_update_event_mask(buf, 0, 0);
@@ -892,7 +1026,7 @@ void diagfwd_init(void)
 		if (driver->apps_rsp_buf == NULL)
 			goto err;
 #endif
-	driver->diag_wq = create_singlethread_workqueue("diag_wq");
+	driver->diag_wq = create_shared_workqueue("diag_wq");
 #ifdef CONFIG_DIAG_OVER_USB
 	INIT_WORK(&(driver->diag_proc_hdlc_work), diag_process_hdlc_fn);
 	INIT_WORK(&(driver->diag_read_work), diag_read_work_fn);
@@ -447,6 +447,10 @@ static struct entropy_store nonblocking_pool = {
 	.pool = nonblocking_pool_data
 };
 
+static __u32 const twist_table[8] = {
+	0x00000000, 0x3b6e20c8, 0x76dc4190, 0x4db26158,
+	0xedb88320, 0xd6d6a3e8, 0x9b64c2b0, 0xa00ae278 };
+
 /*
  * This function adds bytes into the entropy "pool".  It does not
  * update the entropy estimate.  The caller should call
@@ -460,9 +464,6 @@ static struct entropy_store nonblocking_pool = {
 static void mix_pool_bytes_extract(struct entropy_store *r, const void *in,
 				   int nbytes, __u8 out[64])
 {
-	static __u32 const twist_table[8] = {
-		0x00000000, 0x3b6e20c8, 0x76dc4190, 0x4db26158,
-		0xedb88320, 0xd6d6a3e8, 0x9b64c2b0, 0xa00ae278 };
 	unsigned long i, j, tap1, tap2, tap3, tap4, tap5;
 	int input_rotate;
 	int wordmask = r->poolinfo->poolwords - 1;
@@ -521,6 +522,45 @@ static void mix_pool_bytes(struct entropy_store *r, const void *in, int bytes)
        mix_pool_bytes_extract(r, in, bytes, NULL);
 }
 
+/*
+ * Timer samples are first stirred into a small per CPU pool, without
+ * taking the input pool lock, and the per CPU pool is folded into the
+ * input pool once FAST_POOL_SAMPLES samples have come in or a second has
+ * passed since the last fold.  The 16 bytes of the per CPU pool cannot
+ * carry more than 128 bits, so a fold credits at most
+ * FAST_POOL_MAX_CREDIT bits whatever the per sample estimates add up to.
+ */
+#define FAST_POOL_SAMPLES	16
+#define FAST_POOL_MAX_CREDIT	64
+
+struct fast_pool {
+	__u32 pool[4];
+	unsigned long last;
+	unsigned short count;
+	unsigned short samples;
+	unsigned char rotate;
+	int credit;
+};
+
+static DEFINE_PER_CPU(struct fast_pool, fast_pool);
+
+static void fast_mix(struct fast_pool *f, const void *in, int nbytes)
+{
+	const char *bytes = in;
+	__u32 w;
+	unsigned i = f->count;
+	unsigned input_rotate = f->rotate;
+
+	while (nbytes--) {
+		w = rol32(*bytes++, input_rotate & 31) ^ f->pool[i & 3] ^
+			f->pool[(i + 1) & 3];
+		f->pool[i & 3] = (w >> 3) ^ twist_table[w & 7];
+		input_rotate += (i++ & 3) ? 7 : 14;
+	}
+	f->count = i;
+	f->rotate = input_rotate;
+}
+
 /*
  * Credit (or debit) the entropy store with n bits of entropy
  */
@@ -622,8 +662,11 @@ static void add_timer_randomness(struct timer_rand_state *state, unsigned num)
 		unsigned num;
 	} sample;
 	long delta, delta2, delta3;
+	struct fast_pool *f;
+	unsigned long flags;
 
-	preempt_disable();
+	/* process context callers race with interrupts for the fast pool */
+	local_irq_save(flags);
 	/* if over the trickle threshold, use only 1 in 4096 samples */
 	if (input_pool.entropy_count > trickle_thresh &&
 	    (__get_cpu_var(trickle_count)++ & 0xfff))
@@ -632,7 +675,9 @@ static void add_timer_randomness(struct timer_rand_state *state, unsigned num)
 	sample.jiffies = jiffies;
 	sample.cycles = get_cycles();
 	sample.num = num;
-	mix_pool_bytes(&input_pool, &sample, sizeof(sample));
+	f = &__get_cpu_var(fast_pool);
+	fast_mix(f, &sample, sizeof(sample));
+	f->samples++;
 
 	/*
 	 * Calculate number of bits of randomness we probably added.
@@ -666,11 +711,20 @@ static void add_timer_randomness(struct timer_rand_state *state, unsigned num)
 		 * Round down by 1 bit on general principles,
 		 * and limit entropy entimate to 12 bits.
 		 */
+		f->credit += min_t(int, fls(delta>>1), 11);
+	}
+
+	if (f->samples >= FAST_POOL_SAMPLES ||
+	    time_after(jiffies, f->last + HZ)) {
+		f->last = jiffies;
+		mix_pool_bytes(&input_pool, f->pool, sizeof(f->pool));
 		credit_entropy_bits(&input_pool,
-				    min_t(int, fls(delta>>1), 11));
+				    min_t(int, f->credit, FAST_POOL_MAX_CREDIT));
+		f->samples = 0;
+		f->credit = 0;
 	}
 out:
-	preempt_enable();
+	local_irq_restore(flags);
 }
 
 void add_input_randomness(unsigned int type, unsigned int code,
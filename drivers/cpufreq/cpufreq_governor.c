@@ -0,0 +1,501 @@
+/*
+ * drivers/cpufreq/cpufreq_governor.c
+ *
+ * Load sampling core shared by the demand based governors.
+ *
+ * Every governor in the tree used to carry its own copy of the sampling
+ * timer, of the idle time accounting and of the early suspend hooks. This
+ * keeps one copy: a deferrable timer per policy samples the idle time of
+ * its CPUs once, hands the load to the governor's next_freq() and sets
+ * the frequency it asks for.
+ *
+ * With tracing on, every sample is logged with the load, the frequency
+ * before and the frequency picked, so governors can be compared on the
+ * same workload:
+ *
+ *   echo 1 > /sys/kernel/debug/cpufreq_load/trace_enable
+ *   cat /sys/kernel/debug/cpufreq_load/trace
+ *   cat /sys/kernel/debug/cpufreq_load/stats
+ *
+ * Writing to the trace file clears the log and the stats.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/cpu.h>
+#include <linux/debugfs.h>
+#include <linux/earlysuspend.h>
+#include <linux/kernel_stat.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/sysfs.h>
+#include <linux/tick.h>
+#include <asm/div64.h>
+
+#include "cpufreq_governor.h"
+
+static DEFINE_PER_CPU(struct cpufreq_load_cpu, load_gov_cpu);
+
+/* Protects the load policy list and the enable counts */
+static DEFINE_MUTEX(load_gov_mutex);
+static LIST_HEAD(load_gov_list);
+static unsigned int load_gov_enabled;
+
+static bool load_gov_suspended;
+
+#define LOAD_TRACE_SIZE 1024
+
+struct load_trace_entry {
+	u64 time_us;
+	const char *gov;
+	unsigned int old_freq;
+	unsigned int new_freq;
+	u8 cpu;
+	u8 load;
+};
+
+static struct load_trace_entry load_trace[LOAD_TRACE_SIZE];
+static unsigned int load_trace_head;
+static unsigned int load_trace_count;
+static u32 load_trace_enable;
+static DEFINE_SPINLOCK(load_trace_lock);
+
+bool cpufreq_load_suspended(void)
+{
+	return load_gov_suspended;
+}
+EXPORT_SYMBOL_GPL(cpufreq_load_suspended);
+
+static u64 load_gov_idle_jiffy(unsigned int cpu, u64 *wall)
+{
+	cputime64_t busy_time;
+	u64 cur_wall_time;
+
+	cur_wall_time = jiffies64_to_cputime64(get_jiffies_64());
+
+	busy_time = cputime64_add(kstat_cpu(cpu).cpustat.user,
+				  kstat_cpu(cpu).cpustat.system);
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.irq);
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.softirq);
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.steal);
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.nice);
+
+	*wall = jiffies_to_usecs(cur_wall_time);
+	return jiffies_to_usecs(cur_wall_time - busy_time);
+}
+
+/* Idle time (uS) including iowait, like the governors always counted it */
+static u64 load_gov_idle(unsigned int cpu, u64 *wall)
+{
+	u64 idle_time = get_cpu_idle_time_us(cpu, wall);
+
+	if (idle_time == -1ULL)
+		return load_gov_idle_jiffy(cpu, wall);
+	return idle_time + get_cpu_iowait_time_us(cpu, wall);
+}
+
+static void load_gov_sample_init(struct cpufreq_load_cpu *lc)
+{
+	lc->prev_idle = load_gov_idle(lc->cpu, &lc->prev_wall);
+	lc->prev_nice = kstat_cpu(lc->cpu).cpustat.nice;
+	lc->load = 0;
+}
+
+static unsigned int load_gov_sample(struct cpufreq_load_cpu *lc,
+				    unsigned int ignore_nice)
+{
+	u64 cur_idle, cur_wall, cur_nice;
+	unsigned int idle_time, wall_time;
+
+	cur_idle = load_gov_idle(lc->cpu, &cur_wall);
+	cur_nice = kstat_cpu(lc->cpu).cpustat.nice;
+
+	wall_time = (unsigned int)(cur_wall - lc->prev_wall);
+	idle_time = (unsigned int)(cur_idle - lc->prev_idle);
+
+	if (ignore_nice)
+		idle_time += jiffies_to_usecs(
+			cputime64_to_jiffies64(cur_nice - lc->prev_nice));
+
+	lc->prev_wall = cur_wall;
+	lc->prev_idle = cur_idle;
+	lc->prev_nice = cur_nice;
+
+	if (!wall_time || wall_time < idle_time)
+		lc->load = 0;
+	else
+		lc->load = 100 * (wall_time - idle_time) / wall_time;
+
+	return lc->load;
+}
+
+static void load_gov_trace(struct cpufreq_load_policy *lp,
+		struct cpufreq_load_cpu *lc, unsigned int load,
+		unsigned int old_freq, unsigned int new_freq)
+{
+	struct load_trace_entry *e;
+	unsigned long flags;
+
+	spin_lock_irqsave(&load_trace_lock, flags);
+
+	lp->stats.samples++;
+	lp->stats.load_sum += load;
+	lp->stats.freq_sum += new_freq;
+	if (new_freq > old_freq)
+		lp->stats.ups++;
+	else if (new_freq < old_freq)
+		lp->stats.downs++;
+
+	if (load_trace_enable) {
+		e = &load_trace[load_trace_head];
+		e->time_us = ktime_to_us(ktime_get());
+		e->gov = lp->gov->name;
+		e->cpu = lc->cpu;
+		e->load = load;
+		e->old_freq = old_freq;
+		e->new_freq = new_freq;
+
+		load_trace_head = (load_trace_head + 1) % LOAD_TRACE_SIZE;
+		if (load_trace_count < LOAD_TRACE_SIZE)
+			load_trace_count++;
+	}
+
+	spin_unlock_irqrestore(&load_trace_lock, flags);
+}
+
+static void load_gov_check(struct cpufreq_load_cpu *lc)
+{
+	struct cpufreq_policy *policy = lc->policy;
+	struct cpufreq_load_policy *lp = lc->lp;
+	unsigned int load = 0, old_freq, freq, j;
+
+	/* The busiest CPU of the policy decides */
+	for_each_cpu(j, policy->cpus) {
+		struct cpufreq_load_cpu *jc = &per_cpu(load_gov_cpu, j);
+		unsigned int jload = load_gov_sample(jc, lp->ignore_nice);
+
+		if (jload > load)
+			load = jload;
+	}
+
+	old_freq = policy->cur;
+	freq = lp->next_freq(lc, load);
+	if (freq) {
+		if (freq > policy->max)
+			freq = policy->max;
+		if (freq < policy->min)
+			freq = policy->min;
+		if (freq != policy->cur)
+			__cpufreq_driver_target(policy, freq, lp->relation);
+	}
+
+	load_gov_trace(lp, lc, load, old_freq, policy->cur);
+}
+
+static void load_gov_timer(struct work_struct *work)
+{
+	struct cpufreq_load_cpu *lc =
+		container_of(work, struct cpufreq_load_cpu, work.work);
+	int delay;
+
+	mutex_lock(&lc->timer_mutex);
+	load_gov_check(lc);
+
+	delay = usecs_to_jiffies(lc->lp->sampling_rate);
+	if (delay < 1)
+		delay = 1;
+	schedule_delayed_work_on(lc->cpu, &lc->work, delay);
+	mutex_unlock(&lc->timer_mutex);
+}
+
+/* keep track of frequency transitions */
+static int load_gov_notifier(struct notifier_block *nb, unsigned long val,
+			     void *data)
+{
+	struct cpufreq_freqs *freq = data;
+	struct cpufreq_load_cpu *lc = &per_cpu(load_gov_cpu, freq->cpu);
+
+	if (val == CPUFREQ_POSTCHANGE && lc->enable)
+		lc->requested_freq = freq->new;
+	return 0;
+}
+
+static struct notifier_block load_gov_notifier_block = {
+	.notifier_call = load_gov_notifier,
+};
+
+int cpufreq_load_governor(struct cpufreq_policy *policy,
+		unsigned int event, struct cpufreq_load_policy *lp)
+{
+	unsigned int cpu = policy->cpu;
+	struct cpufreq_load_cpu *lc = &per_cpu(load_gov_cpu, cpu);
+	unsigned int j;
+	int rc;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if ((!cpu_online(cpu)) || (!policy->cur))
+			return -EINVAL;
+
+		if (lc->enable) /* Already enabled */
+			break;
+
+		mutex_lock(&load_gov_mutex);
+
+		if (lp->attr_group) {
+			rc = sysfs_create_group(&policy->kobj, lp->attr_group);
+			if (rc) {
+				mutex_unlock(&load_gov_mutex);
+				return rc;
+			}
+		}
+
+		if (lp->enabled++ == 0) {
+			unsigned int latency;
+			/* policy latency is in nS. Convert it to uS first */
+			latency = policy->cpuinfo.transition_latency / 1000;
+			if (latency == 0)
+				latency = 1;
+
+			lp->def_sampling_rate = 10 * latency *
+				CONFIG_CPU_FREQ_SAMPLING_LATENCY_MULTIPLIER;
+			if (lp->def_sampling_rate < CPUFREQ_LOAD_MIN_STAT_RATE)
+				lp->def_sampling_rate =
+					CPUFREQ_LOAD_MIN_STAT_RATE;
+			lp->sampling_rate = lp->def_sampling_rate;
+		}
+
+		if (load_gov_enabled++ == 0)
+			cpufreq_register_notifier(&load_gov_notifier_block,
+						  CPUFREQ_TRANSITION_NOTIFIER);
+
+		for_each_cpu(j, policy->cpus) {
+			struct cpufreq_load_cpu *jc = &per_cpu(load_gov_cpu, j);
+
+			jc->policy = policy;
+			jc->lp = lp;
+			jc->cpu = j;
+			load_gov_sample_init(jc);
+		}
+		lc->requested_freq = policy->cur;
+		if (lp->start)
+			lp->start(lc);
+		lc->enable = 1;
+
+		mutex_unlock(&load_gov_mutex);
+
+		mutex_init(&lc->timer_mutex);
+		INIT_DELAYED_WORK_DEFERRABLE(&lc->work, load_gov_timer);
+		schedule_delayed_work_on(cpu, &lc->work,
+				usecs_to_jiffies(lp->sampling_rate));
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		cancel_delayed_work_sync(&lc->work);
+
+		mutex_lock(&load_gov_mutex);
+		lc->enable = 0;
+		if (lp->attr_group)
+			sysfs_remove_group(&policy->kobj, lp->attr_group);
+		lp->enabled--;
+		if (--load_gov_enabled == 0)
+			cpufreq_unregister_notifier(&load_gov_notifier_block,
+						    CPUFREQ_TRANSITION_NOTIFIER);
+		mutex_unlock(&load_gov_mutex);
+		mutex_destroy(&lc->timer_mutex);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&lc->timer_mutex);
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy, policy->max,
+						CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy, policy->min,
+						CPUFREQ_RELATION_L);
+		mutex_unlock(&lc->timer_mutex);
+		break;
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpufreq_load_governor);
+
+int cpufreq_load_register(struct cpufreq_load_policy *lp)
+{
+	int rc;
+
+	rc = cpufreq_register_governor(lp->gov);
+	if (rc)
+		return rc;
+
+	mutex_lock(&load_gov_mutex);
+	list_add_tail(&lp->list, &load_gov_list);
+	mutex_unlock(&load_gov_mutex);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpufreq_load_register);
+
+void cpufreq_load_unregister(struct cpufreq_load_policy *lp)
+{
+	mutex_lock(&load_gov_mutex);
+	list_del(&lp->list);
+	mutex_unlock(&load_gov_mutex);
+
+	cpufreq_unregister_governor(lp->gov);
+}
+EXPORT_SYMBOL_GPL(cpufreq_load_unregister);
+
+static void load_gov_early_suspend(struct early_suspend *handler)
+{
+	load_gov_suspended = true;
+}
+
+static void load_gov_late_resume(struct early_suspend *handler)
+{
+	load_gov_suspended = false;
+}
+
+static struct early_suspend load_gov_power_suspend = {
+	.suspend = load_gov_early_suspend,
+	.resume = load_gov_late_resume,
+	.level = EARLY_SUSPEND_LEVEL_DISABLE_FB + 1,
+};
+
+#ifdef CONFIG_DEBUG_FS
+static int load_trace_show(struct seq_file *s, void *unused)
+{
+	unsigned int i, idx, count;
+	unsigned long flags;
+
+	seq_printf(s, "%-14s %-12s %3s %4s %8s %8s\n",
+		   "time", "governor", "cpu", "load", "old", "new");
+
+	spin_lock_irqsave(&load_trace_lock, flags);
+	count = load_trace_count;
+	idx = (load_trace_head + LOAD_TRACE_SIZE - count) % LOAD_TRACE_SIZE;
+	for (i = 0; i < count; i++) {
+		struct load_trace_entry *e = &load_trace[idx];
+		u64 sec = e->time_us;
+		unsigned long usec = do_div(sec, USEC_PER_SEC);
+
+		seq_printf(s, "%7llu.%06lu %-12s %3u %4u %8u %8u\n",
+			   sec, usec, e->gov, e->cpu, e->load, e->old_freq,
+			   e->new_freq);
+		idx = (idx + 1) % LOAD_TRACE_SIZE;
+	}
+	spin_unlock_irqrestore(&load_trace_lock, flags);
+	return 0;
+}
+
+static int load_trace_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, load_trace_show, NULL);
+}
+
+static ssize_t load_trace_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct cpufreq_load_policy *lp;
+	unsigned long flags;
+
+	mutex_lock(&load_gov_mutex);
+	spin_lock_irqsave(&load_trace_lock, flags);
+	load_trace_head = 0;
+	load_trace_count = 0;
+	list_for_each_entry(lp, &load_gov_list, list)
+		memset(&lp->stats, 0, sizeof(lp->stats));
+	spin_unlock_irqrestore(&load_trace_lock, flags);
+	mutex_unlock(&load_gov_mutex);
+
+	return count;
+}
+
+static const struct file_operations load_trace_fops = {
+	.open		= load_trace_open,
+	.read		= seq_read,
+	.write		= load_trace_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int load_stats_show(struct seq_file *s, void *unused)
+{
+	struct cpufreq_load_policy *lp;
+	struct cpufreq_load_stats st;
+	unsigned long flags;
+
+	seq_printf(s, "%-12s %10s %8s %10s %8s %8s\n",
+		   "governor", "samples", "avg_load", "avg_freq", "ups",
+		   "downs");
+
+	mutex_lock(&load_gov_mutex);
+	list_for_each_entry(lp, &load_gov_list, list) {
+		u64 avg_load = 0, avg_freq = 0;
+
+		spin_lock_irqsave(&load_trace_lock, flags);
+		st = lp->stats;
+		spin_unlock_irqrestore(&load_trace_lock, flags);
+
+		if (st.samples) {
+			avg_load = st.load_sum;
+			do_div(avg_load, st.samples);
+			avg_freq = st.freq_sum;
+			do_div(avg_freq, st.samples);
+		}
+		seq_printf(s, "%-12s %10llu %8llu %10llu %8llu %8llu\n",
+			   lp->gov->name, st.samples, avg_load, avg_freq,
+			   st.ups, st.downs);
+	}
+	mutex_unlock(&load_gov_mutex);
+	return 0;
+}
+
+static int load_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, load_stats_show, NULL);
+}
+
+static const struct file_operations load_stats_fops = {
+	.open		= load_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void load_gov_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("cpufreq_load", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_bool("trace_enable", 0644, dir, &load_trace_enable);
+	debugfs_create_file("trace", 0644, dir, NULL, &load_trace_fops);
+	debugfs_create_file("stats", 0444, dir, NULL, &load_stats_fops);
+}
+#else
+static inline void load_gov_debugfs_init(void) { }
+#endif
+
+static int __init cpufreq_load_init(void)
+{
+	register_early_suspend(&load_gov_power_suspend);
+	load_gov_debugfs_init();
+	return 0;
+}
+
+late_initcall(cpufreq_load_init);
+
+MODULE_DESCRIPTION("Load sampling core for the cpufreq governors");
+MODULE_LICENSE("GPL");
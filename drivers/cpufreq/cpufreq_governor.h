@@ -0,0 +1,102 @@
+/*
+ * drivers/cpufreq/cpufreq_governor.h
+ *
+ * Load sampling core shared by the demand based governors.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef _CPUFREQ_GOVERNOR_H
+#define _CPUFREQ_GOVERNOR_H
+
+#include <linux/cpufreq.h>
+#include <linux/jiffies.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/types.h>
+#include <linux/workqueue.h>
+
+/*
+ * The core owns the sampling timer, the idle time accounting and the
+ * frequency change of every CPU running one of its governors. A governor
+ * built on it (a "load policy") only decides which frequency a given load
+ * asks for, and keeps its own tunables.
+ *
+ * The timers are deferrable, an idle CPU is not woken up just to find out
+ * it is still idle.
+ */
+
+struct cpufreq_load_policy;
+
+struct cpufreq_load_cpu {
+	struct cpufreq_policy *policy;
+	struct cpufreq_load_policy *lp;
+	struct delayed_work work;
+	/* Serialises the timer against GOV_LIMITS */
+	struct mutex timer_mutex;
+	u64 prev_idle;
+	u64 prev_wall;
+	u64 prev_nice;
+	/* Busy percentage over the last sample */
+	unsigned int load;
+	/* Last frequency set on this CPU, kept by a transition notifier */
+	unsigned int requested_freq;
+	unsigned int cpu;
+	int enable;
+};
+
+/* Benchmark counters, cleared through debugfs */
+struct cpufreq_load_stats {
+	u64 samples;
+	u64 load_sum;
+	u64 freq_sum;
+	u64 ups;
+	u64 downs;
+};
+
+struct cpufreq_load_policy {
+	struct cpufreq_governor *gov;
+	/*
+	 * Called once per sample with the busiest CPU of the policy's load.
+	 * Returns the frequency to go to, or 0 to leave it alone. The core
+	 * clamps it to the policy limits.
+	 */
+	unsigned int (*next_freq)(struct cpufreq_load_cpu *lc, unsigned int load);
+	/* Optional, reset the per CPU state of the load policy */
+	void (*start)(struct cpufreq_load_cpu *lc);
+	/* Tunables, created in the policy directory while governing */
+	struct attribute_group *attr_group;
+	unsigned int relation;
+
+	/* Sampling period (uS), reset to def_sampling_rate on first start */
+	unsigned int sampling_rate;
+	unsigned int def_sampling_rate;
+	/* Count niced tasks as idle time */
+	unsigned int ignore_nice;
+
+	unsigned int enabled;
+	struct cpufreq_load_stats stats;
+	struct list_head list;
+};
+
+/* for correct statistics, we need at least 10 ticks between each measure */
+#define CPUFREQ_LOAD_MIN_STAT_RATE \
+	(2 * jiffies_to_usecs(CONFIG_CPU_FREQ_MIN_TICKS))
+
+extern int cpufreq_load_governor(struct cpufreq_policy *policy,
+		unsigned int event, struct cpufreq_load_policy *lp);
+extern int cpufreq_load_register(struct cpufreq_load_policy *lp);
+extern void cpufreq_load_unregister(struct cpufreq_load_policy *lp);
+
+/* Whether the screen is off (early suspend) */
+extern bool cpufreq_load_suspended(void);
+
+#endif /* _CPUFREQ_GOVERNOR_H */
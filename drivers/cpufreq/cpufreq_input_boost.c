@@ -0,0 +1,261 @@
+/*
+ * drivers/cpufreq/cpufreq_input_boost.c
+ *
+ * Touch input boost shared by the load sampling governors.
+ *
+ * The governors only notice a scroll once their sampling timer has seen a
+ * busy period, so the first frames render at whatever speed the CPU idled
+ * at. This hooks the touchscreens and, when a touch starts, tells the
+ * governors that opted in to raise the CPU to boost_freq. While touch
+ * events keep coming, and for boost_ms after the last one,
+ * cpufreq_input_boost_freq() returns the floor they should not ramp below.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/input.h>
+#include <linux/jiffies.h>
+#include <linux/module.h>
+#include <linux/notifier.h>
+#include <linux/slab.h>
+
+/*
+ * Frequency (kHz) to raise the CPU to when a touch starts, 0 disables the
+ * boost. Governors clamp it to the policy limits.
+ */
+#define DEFAULT_BOOST_FREQ 600000
+static unsigned long boost_freq;
+
+/*
+ * How long (ms) the boost floor lasts after the last touch event.
+ */
+#define DEFAULT_BOOST_MS 200
+static unsigned long boost_ms;
+
+static unsigned long boost_until;
+static unsigned long boost_count;
+
+static ATOMIC_NOTIFIER_HEAD(boost_notifier_list);
+
+/*
+ * The notifiers are called from the input event path, in atomic context,
+ * with the boost frequency as the event. They should queue their own
+ * frequency change work rather than change the frequency themselves.
+ */
+int cpufreq_input_boost_register(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&boost_notifier_list, nb);
+}
+EXPORT_SYMBOL_GPL(cpufreq_input_boost_register);
+
+int cpufreq_input_boost_unregister(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&boost_notifier_list, nb);
+}
+EXPORT_SYMBOL_GPL(cpufreq_input_boost_unregister);
+
+unsigned int cpufreq_input_boost_freq(void)
+{
+	unsigned int freq = boost_freq;
+
+	if (!freq || time_after_eq(jiffies, ACCESS_ONCE(boost_until)))
+		return 0;
+	return freq;
+}
+EXPORT_SYMBOL_GPL(cpufreq_input_boost_freq);
+
+static void cpufreq_input_boost_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	bool active;
+
+	if (!boost_freq || !boost_ms)
+		return;
+
+	if (type == EV_KEY) {
+		/* Let the boost run out after the finger lifts */
+		if (code != BTN_TOUCH || !value)
+			return;
+	} else if (type != EV_ABS)
+		return;
+
+	active = time_before(jiffies, boost_until);
+	boost_until = jiffies + msecs_to_jiffies(boost_ms);
+
+	/* Kick the governors on touch down, or on the first move after
+	 * the previous boost ran out.
+	 */
+	if (active && type != EV_KEY)
+		return;
+
+	boost_count++;
+	atomic_notifier_call_chain(&boost_notifier_list, boost_freq, NULL);
+}
+
+static int cpufreq_input_boost_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpufreq_input_boost";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	pr_debug("cpufreq_input_boost: connected to %s\n", dev->name);
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void cpufreq_input_boost_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+/* Multi-touch screens (ft5x0x, synaptics) and single touch ones */
+static const struct input_device_id cpufreq_input_boost_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	{ },
+};
+
+static struct input_handler cpufreq_input_boost_handler = {
+	.event		= cpufreq_input_boost_event,
+	.connect	= cpufreq_input_boost_connect,
+	.disconnect	= cpufreq_input_boost_disconnect,
+	.name		= "cpufreq_input_boost",
+	.id_table	= cpufreq_input_boost_ids,
+};
+
+static ssize_t show_boost_freq(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", boost_freq);
+}
+
+static ssize_t store_boost_freq(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	unsigned long input;
+	int res;
+
+	res = strict_strtoul(buf, 0, &input);
+	if (res)
+		return res;
+	boost_freq = input;
+	return count;
+}
+
+static struct global_attr boost_freq_attr = __ATTR(boost_freq, 0644,
+		show_boost_freq, store_boost_freq);
+
+static ssize_t show_boost_ms(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", boost_ms);
+}
+
+static ssize_t store_boost_ms(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	unsigned long input;
+	int res;
+
+	res = strict_strtoul(buf, 0, &input);
+	if (res)
+		return res;
+	if (input > 10000)
+		return -EINVAL;
+	boost_ms = input;
+	return count;
+}
+
+static struct global_attr boost_ms_attr = __ATTR(boost_ms, 0644,
+		show_boost_ms, store_boost_ms);
+
+static ssize_t show_boost_count(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", boost_count);
+}
+
+static struct global_attr boost_count_attr = __ATTR(boost_count, 0444,
+		show_boost_count, NULL);
+
+static struct attribute *cpufreq_input_boost_attributes[] = {
+	&boost_freq_attr.attr,
+	&boost_ms_attr.attr,
+	&boost_count_attr.attr,
+	NULL,
+};
+
+static struct attribute_group cpufreq_input_boost_attr_group = {
+	.attrs = cpufreq_input_boost_attributes,
+	.name = "input_boost",
+};
+
+static int __init cpufreq_input_boost_init(void)
+{
+	int rc;
+
+	boost_freq = DEFAULT_BOOST_FREQ;
+	boost_ms = DEFAULT_BOOST_MS;
+	boost_until = jiffies;
+
+	rc = sysfs_create_group(cpufreq_global_kobject,
+				&cpufreq_input_boost_attr_group);
+	if (rc)
+		return rc;
+
+	rc = input_register_handler(&cpufreq_input_boost_handler);
+	if (rc)
+		sysfs_remove_group(cpufreq_global_kobject,
+				   &cpufreq_input_boost_attr_group);
+	return rc;
+}
+
+late_initcall(cpufreq_input_boost_init);
+
+MODULE_DESCRIPTION("Touch input boost for the cpufreq governors");
+MODULE_LICENSE("GPL");
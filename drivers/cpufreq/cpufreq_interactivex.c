@@ -194,6 +194,7 @@ static void cpufreq_interactivex_freq_change_time_work(struct work_struct *work)
 {
 	unsigned int cpu;
 	unsigned int newtarget;
+	unsigned int boost = suspended ? 0 : cpufreq_input_boost_freq();
 	cpumask_t tmp_mask = work_cpumask;
 	newtarget = FREQ_THRESHOLD;
 
@@ -208,6 +209,9 @@ static void cpufreq_interactivex_freq_change_time_work(struct work_struct *work)
 			__cpufreq_driver_target(policy, newtarget, CPUFREQ_RELATION_H);
 		} else {
 			target_freq = cpufreq_interactivex_calc_freq(cpu);
+			/* Hold the touch boost floor while it lasts */
+			if (target_freq < boost)
+				target_freq = boost;
 			__cpufreq_driver_target(policy, target_freq,
 							CPUFREQ_RELATION_L);
 		}
@@ -219,6 +223,26 @@ static void cpufreq_interactivex_freq_change_time_work(struct work_struct *work)
 
 }
 
+/*
+ * Touch started: raise to the boost frequency now rather than on the next
+ * busy sample. Called in atomic context from the input event path.
+ */
+static int interactivex_input_boost(struct notifier_block *nb,
+		unsigned long freq, void *data)
+{
+	if (!enabled || suspended || policy->cur >= freq)
+		return NOTIFY_DONE;
+
+	target_freq = freq;
+	cpumask_set_cpu(policy->cpu, &work_cpumask);
+	queue_work(up_wq, &freq_scale_work);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block interactivex_input_boost_nb = {
+	.notifier_call = interactivex_input_boost,
+};
+
 static ssize_t show_min_sample_time(struct kobject *kobj,
 				struct attribute *attr, char *buf)
 {
@@ -301,6 +325,7 @@ static int cpufreq_governor_interactivex(struct cpufreq_policy *new_policy,
 		pm_idle = cpufreq_idle;
 		policy = new_policy;
 		enabled = 1;
+		cpufreq_input_boost_register(&interactivex_input_boost_nb);
         	register_early_suspend(&interactivex_power_suspend);
         	pr_info("[imoseyon] interactiveX active\n");
 		break;
@@ -315,6 +340,7 @@ static int cpufreq_governor_interactivex(struct cpufreq_policy *new_policy,
 		pm_idle = pm_idle_old;
 		del_timer(&per_cpu(cpu_timer, new_policy->cpu));
 		enabled = 0;
+		cpufreq_input_boost_unregister(&interactivex_input_boost_nb);
         	unregister_early_suspend(&interactivex_power_suspend);
         	pr_info("[imoseyon] interactiveX inactive\n");
 			break;
@@ -18,23 +18,15 @@
 
 #include <linux/kernel.h>
 #include <linux/module.h>
-#include <linux/smp.h>
 #include <linux/init.h>
-#include <linux/interrupt.h>
-#include <linux/ctype.h>
 #include <linux/cpufreq.h>
-#include <linux/sysctl.h>
 #include <linux/types.h>
-#include <linux/fs.h>
 #include <linux/sysfs.h>
-#include <linux/cpu.h>
-#include <linux/kmod.h>
-#include <linux/workqueue.h>
-#include <linux/jiffies.h>
-#include <linux/kernel_stat.h>
 #include <linux/percpu.h>
 #include <linux/mutex.h>
 
+#include "cpufreq_governor.h"
+
 /*
  * dbs is used in this file as a shortform for demandbased switching
  * It helps to keep variable names smaller, simpler
@@ -52,93 +44,38 @@
  * For CPUs with transition latency > 10mS (mostly drivers
  * with CPUFREQ_ETERNAL), this governor will not work.
  * All times here are in uS.
+ * The sampling itself is done by the load sampling core.
  */
-static unsigned int def_sampling_rate;
 #define MIN_SAMPLING_RATE_RATIO			(2)
-/* for correct statistics, we need at least 10 ticks between each measure */
-#define MIN_STAT_SAMPLING_RATE			\
-	(MIN_SAMPLING_RATE_RATIO * jiffies_to_usecs(CONFIG_CPU_FREQ_MIN_TICKS))
 #define MIN_SAMPLING_RATE			\
-			(def_sampling_rate / MIN_SAMPLING_RATE_RATIO)
-#define MAX_SAMPLING_RATE			(500 * def_sampling_rate)
+			(minmax_load.def_sampling_rate / MIN_SAMPLING_RATE_RATIO)
+#define MAX_SAMPLING_RATE			(500 * minmax_load.def_sampling_rate)
 #define DEF_SAMPLING_DOWN_FACTOR		(10)
 #define MAX_SAMPLING_DOWN_FACTOR		(100)
 #define TRANSITION_LATENCY_LIMIT		(10 * 1000 * 1000)
 
-static void do_dbs_timer(struct work_struct *work);
-
 struct cpu_dbs_info_s {
-	struct cpufreq_policy *cur_policy;
-	unsigned int prev_cpu_idle_up;
-	unsigned int prev_cpu_idle_down;
-	unsigned int enable;
 	unsigned int down_skip;
-	unsigned int requested_freq;
+	unsigned int down_load;
 };
 static DEFINE_PER_CPU(struct cpu_dbs_info_s, cpu_dbs_info);
 
-static unsigned int dbs_enable;	/* number of CPUs using this policy */
-
-/*
- * DEADLOCK ALERT! There is a ordering requirement between cpu_hotplug
- * lock and dbs_mutex. cpu_hotplug lock should always be held before
- * dbs_mutex. If any function that can potentially take cpu_hotplug lock
- * (like __cpufreq_driver_target()) is being called with dbs_mutex taken, then
- * cpu_hotplug lock should be taken before that. Note that cpu_hotplug lock
- * is recursive for the same process. -Venki
- */
+/* Serialises the tunables against each other */
 static DEFINE_MUTEX (dbs_mutex);
-static DECLARE_DELAYED_WORK(dbs_work, do_dbs_timer);
 
 struct dbs_tuners {
-	unsigned int sampling_rate;
 	unsigned int sampling_down_factor;
 	unsigned int up_threshold;
 	unsigned int down_threshold;
-	unsigned int ignore_nice;
 };
 
 static struct dbs_tuners dbs_tuners_ins = {
 	.up_threshold = DEF_FREQUENCY_UP_THRESHOLD,
 	.down_threshold = DEF_FREQUENCY_DOWN_THRESHOLD,
 	.sampling_down_factor = DEF_SAMPLING_DOWN_FACTOR,
-	.ignore_nice = 0,
 };
 
-static inline unsigned int get_cpu_idle_time(unsigned int cpu)
-{
-	unsigned int add_nice = 0, ret;
-
-	if (dbs_tuners_ins.ignore_nice)
-		add_nice = kstat_cpu(cpu).cpustat.nice;
-
-	ret = kstat_cpu(cpu).cpustat.idle +
-		kstat_cpu(cpu).cpustat.iowait +
-		add_nice;
-
-	return ret;
-}
-
-/* keep track of frequency transitions */
-static int
-dbs_cpufreq_notifier(struct notifier_block *nb, unsigned long val,
-		     void *data)
-{
-	struct cpufreq_freqs *freq = data;
-	struct cpu_dbs_info_s *this_dbs_info = &per_cpu(cpu_dbs_info,
-							freq->cpu);
-
-	if (!this_dbs_info->enable)
-		return 0;
-
-	this_dbs_info->requested_freq = freq->new;
-
-	return 0;
-}
-
-static struct notifier_block dbs_cpufreq_notifier_block = {
-	.notifier_call = dbs_cpufreq_notifier
-};
+static struct cpufreq_load_policy minmax_load;
 
 /************************** sysfs interface ************************/
 static ssize_t show_sampling_rate_max(struct cpufreq_policy *policy, char *buf)
@@ -163,13 +100,13 @@ define_one_ro(sampling_rate_min);
 static ssize_t show_##file_name						\
 (struct cpufreq_policy *unused, char *buf)				\
 {									\
-	return sprintf(buf, "%u\n", dbs_tuners_ins.object);		\
+	return sprintf(buf, "%u\n", object);				\
 }
-show_one(sampling_rate, sampling_rate);
-show_one(sampling_down_factor, sampling_down_factor);
-show_one(up_threshold, up_threshold);
-show_one(down_threshold, down_threshold);
-show_one(ignore_nice_load, ignore_nice);
+show_one(sampling_rate, minmax_load.sampling_rate);
+show_one(sampling_down_factor, dbs_tuners_ins.sampling_down_factor);
+show_one(up_threshold, dbs_tuners_ins.up_threshold);
+show_one(down_threshold, dbs_tuners_ins.down_threshold);
+show_one(ignore_nice_load, minmax_load.ignore_nice);
 
 static ssize_t store_sampling_down_factor(struct cpufreq_policy *unused,
 		const char *buf, size_t count)
@@ -200,7 +137,7 @@ static ssize_t store_sampling_rate(struct cpufreq_policy *unused,
 		return -EINVAL;
 	}
 
-	dbs_tuners_ins.sampling_rate = input;
+	minmax_load.sampling_rate = input;
 	mutex_unlock(&dbs_mutex);
 
 	return count;
@@ -250,8 +187,6 @@ static ssize_t store_ignore_nice_load(struct cpufreq_policy *policy,
 	unsigned int input;
 	int ret;
 
-	unsigned int j;
-
 	ret = sscanf(buf, "%u", &input);
 	if (ret != 1)
 		return -EINVAL;
@@ -259,21 +194,8 @@ static ssize_t store_ignore_nice_load(struct cpufreq_policy *policy,
 	if (input > 1)
 		input = 1;
 
-	mutex_lock(&dbs_mutex);
-	if (input == dbs_tuners_ins.ignore_nice) { /* nothing to do */
-		mutex_unlock(&dbs_mutex);
-		return count;
-	}
-	dbs_tuners_ins.ignore_nice = input;
-
-	/* we need to re-evaluate prev_cpu_idle_up and prev_cpu_idle_down */
-	for_each_online_cpu(j) {
-		struct cpu_dbs_info_s *j_dbs_info;
-		j_dbs_info = &per_cpu(cpu_dbs_info, j);
-		j_dbs_info->prev_cpu_idle_up = get_cpu_idle_time(j);
-		j_dbs_info->prev_cpu_idle_down = j_dbs_info->prev_cpu_idle_up;
-	}
-	mutex_unlock(&dbs_mutex);
+	/* the core tracks nice time on every sample, nothing to resync */
+	minmax_load.ignore_nice = input;
 
 	return count;
 }
@@ -306,234 +228,61 @@ static struct attribute_group dbs_attr_group = {
 
 /************************** sysfs end ************************/
 
-static void dbs_check_cpu(int cpu)
+/*
+ * Every sample, a load above up_threshold takes the CPU straight to the
+ * maximum. Once the load stayed below that for sampling_down_factor
+ * samples, an average below down_threshold drops it to the minimum.
+ */
+static unsigned int minmax_next_freq(struct cpufreq_load_cpu *lc,
+				     unsigned int load)
 {
-	unsigned int idle_ticks, up_idle_ticks, down_idle_ticks;
-	unsigned int tmp_idle_ticks, total_idle_ticks;
-	//unsigned int freq_target;
-	unsigned int freq_down_sampling_rate;
-	struct cpu_dbs_info_s *this_dbs_info = &per_cpu(cpu_dbs_info, cpu);
-	struct cpufreq_policy *policy;
-
-	if (!this_dbs_info->enable)
-		return;
-
-	policy = this_dbs_info->cur_policy;
-
-	/*
-	 * The default safe range is 20% to 80%
-	 * Every sampling_rate, we check
-	 *	- If current idle time is less than 20%, then we try to
-	 *	  increase frequency
-	 * Every sampling_rate*sampling_down_factor, we check
-	 *	- If current idle time is more than 80%, then we try to
-	 *	  decrease frequency
-	 *
-	 */
-
-	this_dbs_info->down_skip++;
-
-	/* Check for frequency increase */
-	idle_ticks = UINT_MAX;
+	struct cpu_dbs_info_s *this_dbs_info = &per_cpu(cpu_dbs_info, lc->cpu);
+	struct cpufreq_policy *policy = lc->policy;
+	unsigned int down_load;
 
 	/* Check for frequency increase */
-	total_idle_ticks = get_cpu_idle_time(cpu);
-	tmp_idle_ticks = total_idle_ticks -
-		this_dbs_info->prev_cpu_idle_up;
-	this_dbs_info->prev_cpu_idle_up = total_idle_ticks;
-
-	if (tmp_idle_ticks < idle_ticks)
-		idle_ticks = tmp_idle_ticks;
-
-	/* Scale idle ticks by 100 and compare with up and down ticks */
-	idle_ticks *= 100;
-	up_idle_ticks = (100 - dbs_tuners_ins.up_threshold) *
-			usecs_to_jiffies(dbs_tuners_ins.sampling_rate);
-
-	if (idle_ticks < up_idle_ticks) {
+	if (load > dbs_tuners_ins.up_threshold) {
 		this_dbs_info->down_skip = 0;
-		this_dbs_info->prev_cpu_idle_down =
-			this_dbs_info->prev_cpu_idle_up;
+		this_dbs_info->down_load = 0;
 
 		/* if we are already at full speed then break out early */
-		if (this_dbs_info->requested_freq == policy->max)
-			return;
+		if (lc->requested_freq == policy->max)
+			return 0;
 
-		this_dbs_info->requested_freq = policy->max;
-
-		__cpufreq_driver_target(policy, this_dbs_info->requested_freq,
-			CPUFREQ_RELATION_H);
-		return;
+		return policy->max;
 	}
 
 	/* Check for frequency decrease */
-	if (this_dbs_info->down_skip < dbs_tuners_ins.sampling_down_factor)
-		return;
-	else this_dbs_info->down_skip--; /* just to prevent overflow */
+	this_dbs_info->down_load += load;
+	if (++this_dbs_info->down_skip < dbs_tuners_ins.sampling_down_factor)
+		return 0;
 
+	down_load = this_dbs_info->down_load / this_dbs_info->down_skip;
+	this_dbs_info->down_skip = 0;
+	this_dbs_info->down_load = 0;
 
-	/* Check for frequency decrease */
-	total_idle_ticks = this_dbs_info->prev_cpu_idle_up;
-	tmp_idle_ticks = total_idle_ticks -
-		this_dbs_info->prev_cpu_idle_down;
-	this_dbs_info->prev_cpu_idle_down = total_idle_ticks;
-
-	if (tmp_idle_ticks < idle_ticks)
-		idle_ticks = tmp_idle_ticks;
-
-	/* Scale idle ticks by 100 and compare with up and down ticks */
-	idle_ticks *= 100;
-
-	freq_down_sampling_rate = dbs_tuners_ins.sampling_rate *
-		dbs_tuners_ins.sampling_down_factor;
-	down_idle_ticks = (100 - dbs_tuners_ins.down_threshold) *
-		usecs_to_jiffies(freq_down_sampling_rate);
-
-	if (idle_ticks > down_idle_ticks) {
-		/*
-		 * if we are already at the lowest speed then break out early
-		 * or if we 'cannot' reduce the speed as the user might want
-		 * freq_target to be zero
-		 */
-		if (this_dbs_info->requested_freq == policy->min)
-			return;
-
-		this_dbs_info->requested_freq = policy->min;
-
-		__cpufreq_driver_target(policy, this_dbs_info->requested_freq,
-				CPUFREQ_RELATION_H);
-		return;
+	if (down_load < dbs_tuners_ins.down_threshold) {
+		/* if we are already at the lowest speed then break out early */
+		if (lc->requested_freq == policy->min)
+			return 0;
+
+		return policy->min;
 	}
+	return 0;
 }
 
-static void do_dbs_timer(struct work_struct *work)
+static void minmax_start(struct cpufreq_load_cpu *lc)
 {
-	int i;
+	struct cpu_dbs_info_s *this_dbs_info = &per_cpu(cpu_dbs_info, lc->cpu);
 
-	mutex_lock(&dbs_mutex);
-	for_each_online_cpu(i)
-		dbs_check_cpu(i);
-	schedule_delayed_work(&dbs_work,
-			usecs_to_jiffies(dbs_tuners_ins.sampling_rate));
-	mutex_unlock(&dbs_mutex);
-}
-
-static inline void dbs_timer_init(void)
-{
-	init_timer_deferrable(&dbs_work.timer);
-	schedule_delayed_work(&dbs_work,
-			usecs_to_jiffies(dbs_tuners_ins.sampling_rate));
-	return;
-}
-
-static inline void dbs_timer_exit(void)
-{
-	cancel_delayed_work(&dbs_work);
-	return;
+	this_dbs_info->down_skip = 0;
+	this_dbs_info->down_load = 0;
 }
 
 static int cpufreq_governor_dbs(struct cpufreq_policy *policy,
 				   unsigned int event)
 {
-	unsigned int cpu = policy->cpu;
-	struct cpu_dbs_info_s *this_dbs_info;
-	unsigned int j;
-	int rc;
-
-	this_dbs_info = &per_cpu(cpu_dbs_info, cpu);
-
-	switch (event) {
-	case CPUFREQ_GOV_START:
-		if ((!cpu_online(cpu)) || (!policy->cur))
-			return -EINVAL;
-
-		if (this_dbs_info->enable) /* Already enabled */
-			break;
-
-		mutex_lock(&dbs_mutex);
-
-		rc = sysfs_create_group(&policy->kobj, &dbs_attr_group);
-		if (rc) {
-			mutex_unlock(&dbs_mutex);
-			return rc;
-		}
-
-		for_each_cpu(j, policy->cpus) {
-			struct cpu_dbs_info_s *j_dbs_info;
-			j_dbs_info = &per_cpu(cpu_dbs_info, j);
-			j_dbs_info->cur_policy = policy;
-
-			j_dbs_info->prev_cpu_idle_up = get_cpu_idle_time(cpu);
-			j_dbs_info->prev_cpu_idle_down
-				= j_dbs_info->prev_cpu_idle_up;
-		}
-		this_dbs_info->enable = 1;
-		this_dbs_info->down_skip = 0;
-		this_dbs_info->requested_freq = policy->cur;
-
-		dbs_enable++;
-		/*
-		 * Start the timerschedule work, when this governor
-		 * is used for first time
-		 */
-		if (dbs_enable == 1) {
-			unsigned int latency;
-			/* policy latency is in nS. Convert it to uS first */
-			latency = policy->cpuinfo.transition_latency / 1000;
-			if (latency == 0)
-				latency = 1;
-
-			def_sampling_rate = 10 * latency *
-				CONFIG_CPU_FREQ_SAMPLING_LATENCY_MULTIPLIER;
-
-			if (def_sampling_rate < MIN_STAT_SAMPLING_RATE)
-				def_sampling_rate = MIN_STAT_SAMPLING_RATE;
-
-			dbs_tuners_ins.sampling_rate = def_sampling_rate;
-
-			dbs_timer_init();
-			cpufreq_register_notifier(
-					&dbs_cpufreq_notifier_block,
-					CPUFREQ_TRANSITION_NOTIFIER);
-		}
-
-		mutex_unlock(&dbs_mutex);
-		break;
-
-	case CPUFREQ_GOV_STOP:
-		mutex_lock(&dbs_mutex);
-		this_dbs_info->enable = 0;
-		sysfs_remove_group(&policy->kobj, &dbs_attr_group);
-		dbs_enable--;
-		/*
-		 * Stop the timerschedule work, when this governor
-		 * is used for first time
-		 */
-		if (dbs_enable == 0) {
-			dbs_timer_exit();
-			cpufreq_unregister_notifier(
-					&dbs_cpufreq_notifier_block,
-					CPUFREQ_TRANSITION_NOTIFIER);
-		}
-
-		mutex_unlock(&dbs_mutex);
-
-		break;
-
-	case CPUFREQ_GOV_LIMITS:
-		mutex_lock(&dbs_mutex);
-		if (policy->max < this_dbs_info->cur_policy->cur)
-			__cpufreq_driver_target(
-					this_dbs_info->cur_policy,
-					policy->max, CPUFREQ_RELATION_H);
-		else if (policy->min > this_dbs_info->cur_policy->cur)
-			__cpufreq_driver_target(
-					this_dbs_info->cur_policy,
-					policy->min, CPUFREQ_RELATION_L);
-		mutex_unlock(&dbs_mutex);
-		break;
-	}
-	return 0;
+	return cpufreq_load_governor(policy, event, &minmax_load);
 }
 
 #ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_MINMAX
@@ -546,17 +295,23 @@ struct cpufreq_governor cpufreq_gov_minmax = {
 	.owner			= THIS_MODULE,
 };
 
+static struct cpufreq_load_policy minmax_load = {
+	.gov		= &cpufreq_gov_minmax,
+	.next_freq	= minmax_next_freq,
+	.start		= minmax_start,
+	.attr_group	= &dbs_attr_group,
+	.relation	= CPUFREQ_RELATION_H,
+	.ignore_nice	= 0,
+};
+
 static int __init cpufreq_gov_dbs_init(void)
 {
-	return cpufreq_register_governor(&cpufreq_gov_minmax);
+	return cpufreq_load_register(&minmax_load);
 }
 
 static void __exit cpufreq_gov_dbs_exit(void)
 {
-	/* Make sure that the scheduled work is indeed not running */
-	flush_scheduled_work();
-
-	cpufreq_unregister_governor(&cpufreq_gov_minmax);
+	cpufreq_load_unregister(&minmax_load);
 }
 
 MODULE_AUTHOR ("Erasmux");
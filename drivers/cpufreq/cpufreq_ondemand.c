@@ -1071,7 +1071,7 @@ static int __init cpufreq_gov_dbs_init(void)
 
 	touch = false;
 	timer_delay = msecs_to_jiffies(dbs_tuners_ins.touch_load_duration);
-	init_timer(&input_timer);
+	init_timer_deferrable(&input_timer);
 	input_timer.function = input_timeout;
 
 	for_each_possible_cpu(i) {
@@ -382,6 +382,7 @@ static void cpufreq_smartass_freq_change_time_work(struct work_struct *work)
 	struct smartass_info_s *this_smartass;
 	struct cpufreq_policy *policy;
 	unsigned int relation = CPUFREQ_RELATION_L;
+	unsigned int boost = suspended ? 0 : cpufreq_input_boost_freq();
 	for_each_possible_cpu(cpu) {
 		this_smartass = &per_cpu(smartass_info, cpu);
 		if (!work_cpumask_test_and_clear(cpu))
@@ -399,7 +400,7 @@ static void cpufreq_smartass_freq_change_time_work(struct work_struct *work)
 			       old_freq,policy->cur);
 			new_freq = old_freq;
 		}
-		else if (ramp_dir > 0 && nr_running() > 1) {
+		else if (ramp_dir > 0 && (nr_running() > 1 || old_freq < (int)boost)) {
 			// ramp up logic:
 			if (old_freq < this_smartass->ideal_speed)
 				new_freq = this_smartass->ideal_speed;
@@ -441,6 +442,12 @@ static void cpufreq_smartass_freq_change_time_work(struct work_struct *work)
 				old_freq,ramp_dir,nr_running());
 		}
 
+		// while a touch boost lasts, don't go below its floor:
+		if (new_freq < (int)boost) {
+			new_freq = boost;
+			relation = CPUFREQ_RELATION_L;
+		}
+
 		// do actual ramp up (returns 0, if frequency change failed):
 		new_freq = target_freq(policy,this_smartass,new_freq,old_freq,relation);
 		if (new_freq)
@@ -457,6 +464,38 @@ static void cpufreq_smartass_freq_change_time_work(struct work_struct *work)
 	}
 }
 
+/*
+ * Touch started: ramp up right away instead of waiting for the timer to
+ * see the load. Called in atomic context from the input event path.
+ */
+static int smartass_input_boost(struct notifier_block *nb, unsigned long freq, void *data)
+{
+	unsigned int cpu;
+	int queued = 0;
+	struct smartass_info_s *this_smartass;
+
+	if (suspended)
+		return NOTIFY_DONE;
+
+	for_each_online_cpu(cpu) {
+		this_smartass = &per_cpu(smartass_info, cpu);
+		if (!this_smartass->enable || this_smartass->cur_policy->cur >= freq)
+			continue;
+		this_smartass->old_freq = this_smartass->cur_policy->cur;
+		this_smartass->ramp_dir = 1;
+		work_cpumask_set(cpu);
+		queued = 1;
+	}
+	if (queued)
+		queue_work(up_wq, &freq_scale_work);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block smartass_input_boost_nb = {
+	.notifier_call = smartass_input_boost,
+};
+
 static ssize_t show_debug_mask(struct kobject *kobj, struct attribute *attr, char *buf)
 {
 	return sprintf(buf, "%lu\n", debug_mask);
@@ -698,6 +737,7 @@ static int cpufreq_governor_smartass_h3(struct cpufreq_policy *new_policy,
 
 			pm_idle_old = pm_idle;
 			pm_idle = cpufreq_idle;
+			cpufreq_input_boost_register(&smartass_input_boost_nb);
 		}
 
 		if (this_smartass->cur_policy->cur < new_policy->max && !timer_pending(&this_smartass->timer))
@@ -732,6 +772,7 @@ static int cpufreq_governor_smartass_h3(struct cpufreq_policy *new_policy,
 		this_smartass->idle_exit_time = 0;
 
 		if (atomic_dec_return(&active_count) <= 1) {
+			cpufreq_input_boost_unregister(&smartass_input_boost_nb);
 			sysfs_remove_group(cpufreq_global_kobject,
 					   &smartass_attr_group);
 			pm_idle = pm_idle_old;
@@ -0,0 +1,1090 @@
+/* Copyright (c) 2012, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Qualcomm crypto engine driver.
+ *
+ * The engine is fed by two data mover channels, one into its input FIFO
+ * and one out of its output FIFO. The driver takes whatever requests
+ * queued up while the engine was busy, up to QCE_BATCH_MAX, and runs
+ * them as one command list per channel. The key, IV and segment
+ * registers of each request are written by the input channel itself, so
+ * the CPU only gets involved once per batch. The input channel waits
+ * (CMD_OCB) before programming the next request until the output
+ * channel has read out the one before (CMD_OCU).
+ *
+ * Requests below min_size, and those the engine or data mover can't
+ * handle (AES-192, unaligned buffers, too many segments), go to a
+ * software implementation instead.
+ *
+ * Hashes take the engine for themselves: the digest is read from the
+ * registers by the CPU once the data is in. Only digest() goes to the
+ * engine, the incremental interface always uses the software hash.
+ */
+
+#include <linux/clk.h>
+#include <linux/delay.h>
+#include <linux/dma-mapping.h>
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#include <asm/unaligned.h>
+
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <crypto/scatterwalk.h>
+#include <crypto/sha.h>
+#include <crypto/internal/hash.h>
+
+#include <mach/dma.h>
+
+#include "qcryptohw.h"
+
+/* Requests run from one pair of command lists */
+#define QCE_BATCH_MAX		16
+/* Data mover commands per request and direction */
+#define QCE_MAX_SG		16
+/* Register writes ahead of the data of a request */
+#define QCE_REG_CMDS		3
+#define QCE_QUEUE_LEN		64
+/* The segment size registers are 16 bits */
+#define QCE_MAX_NBYTES		0xfff0
+
+static unsigned int qce_min_size = 256;
+module_param_named(min_size, qce_min_size, uint, 0644);
+MODULE_PARM_DESC(min_size, "Smaller requests are handled by the CPU");
+
+/* What the input channel writes to the engine for one request */
+struct qce_reg_data {
+	u32 key[8];
+	u32 iv[4];
+	u32 cntr_mask;
+	u32 pad0;
+	u32 auth_iv[8];
+	u32 auth_bytecnt[2];
+	/* seg_cfg, encr_seg_cfg, auth_seg_cfg, seg_size, goproc */
+	u32 seg[5];
+	u32 pad1;
+};
+
+/* Everything the data mover reads, 8-byte aligned */
+struct qce_dma {
+	u32 in_ptr[2];
+	u32 out_ptr[2];
+	struct qce_reg_data regs[QCE_BATCH_MAX];
+	dmov_s in[QCE_BATCH_MAX * (QCE_REG_CMDS + QCE_MAX_SG)];
+	dmov_s out[QCE_BATCH_MAX * QCE_MAX_SG];
+};
+
+struct qce_device {
+	struct device *dev;
+	void __iomem *base;
+	u32 phys_base;
+	struct clk *clk;
+	unsigned int chan_in;
+	unsigned int chan_out;
+	unsigned int crci_in;
+	unsigned int crci_out;
+
+	/* the lock protects queue, held and busy */
+	spinlock_t lock;
+	struct crypto_queue queue;
+	/* A hash dequeued while filling a batch, runs next */
+	struct crypto_async_request *held;
+	bool busy;
+
+	struct crypto_async_request *batch[QCE_BATCH_MAX];
+	int nr_batch;
+	int result;
+	/* Channels still running the batch */
+	atomic_t pending;
+	struct msm_dmov_cmd cmd_in;
+	struct msm_dmov_cmd cmd_out;
+	struct tasklet_struct done_tasklet;
+
+	struct qce_dma *dma;
+	dma_addr_t dma_addr;
+
+	unsigned long requests;
+	unsigned long batches;
+	unsigned long fallbacks;
+	unsigned long errors;
+};
+
+static struct qce_device *qce_dev;
+
+struct qce_cipher_alg {
+	u32 mode;
+	struct crypto_alg alg;
+};
+
+struct qce_cipher_ctx {
+	u32 mode;
+	/* Key words as the engine wants them */
+	u32 key[AES_MAX_KEY_SIZE / 4];
+	unsigned int key_len;
+	struct crypto_blkcipher *fallback;
+};
+
+struct qce_cipher_reqctx {
+	bool encrypt;
+	int src_nents;
+	int dst_nents;
+	/* Last ciphertext block, the next IV after a CBC decryption */
+	u8 iv_out[AES_BLOCK_SIZE];
+};
+
+struct qce_hash_ctx {
+	struct crypto_shash *fallback;
+};
+
+struct qce_hash_reqctx {
+	int nents;
+	/* Followed by the context of the fallback */
+	struct shash_desc desc;
+};
+
+static bool qce_is_hash(struct crypto_async_request *req)
+{
+	return crypto_tfm_alg_type(req->tfm) == CRYPTO_ALG_TYPE_AHASH;
+}
+
+/*
+ * Count the data mover commands for nbytes of sg and the entries they
+ * use. Returns INT_MAX if the data mover can't take the buffers: it
+ * moves 16 byte bursts from 8-byte aligned addresses.
+ */
+static int qce_sg_cmds(struct scatterlist *sg, unsigned int nbytes,
+		       int *nents)
+{
+	int cmds = 0;
+
+	*nents = 0;
+	while (nbytes) {
+		unsigned int len = min(sg->length, nbytes);
+
+		nbytes -= len;
+		if (!IS_ALIGNED(sg->offset, 8) ||
+		    (nbytes && !IS_ALIGNED(len, AES_BLOCK_SIZE)))
+			return INT_MAX;
+		cmds += DIV_ROUND_UP(len, CRYPTO_DATA_SHADOW_SIZE);
+		(*nents)++;
+		sg = sg_next(sg);
+	}
+	return cmds;
+}
+
+static dmov_s *qce_reg_cmd(struct qce_device *qce, dmov_s *cmd,
+			   dma_addr_t src, u32 reg, unsigned int len)
+{
+	cmd->cmd = CMD_MODE_SINGLE;
+	cmd->src = src;
+	cmd->dst = qce->phys_base + reg;
+	cmd->len = len;
+	return cmd + 1;
+}
+
+static dmov_s *qce_data_cmds(struct qce_device *qce, dmov_s *cmd,
+			     struct scatterlist *sg, unsigned int nbytes,
+			     bool to_engine)
+{
+	u32 fifo = qce->phys_base + CRYPTO_DATA_SHADOW0;
+
+	while (nbytes) {
+		unsigned int len = min(sg_dma_len(sg), nbytes);
+		dma_addr_t addr = sg_dma_address(sg);
+
+		nbytes -= len;
+		while (len) {
+			unsigned int chunk = min_t(unsigned int, len,
+						   CRYPTO_DATA_SHADOW_SIZE);
+
+			if (to_engine) {
+				cmd->cmd = CMD_MODE_SINGLE |
+					CMD_DST_CRCI(qce->crci_in);
+				cmd->src = addr;
+				cmd->dst = fifo;
+			} else {
+				cmd->cmd = CMD_MODE_SINGLE |
+					CMD_SRC_CRCI(qce->crci_out);
+				cmd->src = fifo;
+				cmd->dst = addr;
+			}
+			cmd->len = chunk;
+			cmd++;
+			addr += chunk;
+			len -= chunk;
+		}
+		sg = sg_next(sg);
+	}
+	return cmd;
+}
+
+static void qce_reset(struct qce_device *qce)
+{
+	writel(1 << CRYPTO_SW_RST, qce->base + CRYPTO_CONFIG_REG);
+	udelay(1);
+	/* Completion comes from the data mover, not from the engine */
+	writel((1 << CRYPTO_MASK_DOUT_INTR) | (1 << CRYPTO_MASK_DIN_INTR) |
+	       (1 << CRYPTO_MASK_AUTH_DONE_INTR) | (1 << CRYPTO_MASK_ERR_INTR),
+	       qce->base + CRYPTO_CONFIG_REG);
+}
+
+static void qce_cipher_unmap(struct qce_device *qce,
+			     struct ablkcipher_request *req)
+{
+	struct qce_cipher_reqctx *rctx = ablkcipher_request_ctx(req);
+
+	if (req->src == req->dst) {
+		dma_unmap_sg(qce->dev, req->src, rctx->src_nents,
+			     DMA_BIDIRECTIONAL);
+	} else {
+		dma_unmap_sg(qce->dev, req->src, rctx->src_nents,
+			     DMA_TO_DEVICE);
+		dma_unmap_sg(qce->dev, req->dst, rctx->dst_nents,
+			     DMA_FROM_DEVICE);
+	}
+}
+
+/* Build the commands of request idx, returns the ends of both lists */
+static void qce_cipher_cmds(struct qce_device *qce,
+			    struct ablkcipher_request *req, int idx,
+			    dmov_s **in, dmov_s **out)
+{
+	struct qce_cipher_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	struct qce_cipher_reqctx *rctx = ablkcipher_request_ctx(req);
+	struct qce_reg_data *regs = &qce->dma->regs[idx];
+	dma_addr_t regs_addr = qce->dma_addr + offsetof(struct qce_dma, regs) +
+		idx * sizeof(struct qce_reg_data);
+	u32 seg_cfg;
+	int i;
+
+	if (req->src == req->dst) {
+		dma_map_sg(qce->dev, req->src, rctx->src_nents,
+			   DMA_BIDIRECTIONAL);
+	} else {
+		dma_map_sg(qce->dev, req->src, rctx->src_nents,
+			   DMA_TO_DEVICE);
+		dma_map_sg(qce->dev, req->dst, rctx->dst_nents,
+			   DMA_FROM_DEVICE);
+	}
+
+	seg_cfg = ctx->mode | CRYPTO_ENCR_ALG_AES | (1 << CRYPTO_FIRST) |
+		(1 << CRYPTO_LAST);
+	seg_cfg |= ctx->key_len == AES_KEYSIZE_256 ?
+		CRYPTO_ENCR_KEY_SZ_AES256 : CRYPTO_ENCR_KEY_SZ_AES128;
+	if (rctx->encrypt)
+		seg_cfg |= 1 << CRYPTO_ENCODE;
+
+	memcpy(regs->key, ctx->key, ctx->key_len);
+	regs->seg[0] = seg_cfg;
+	regs->seg[1] = req->nbytes << CRYPTO_SEG_SIZE;
+	regs->seg[2] = 0;
+	regs->seg[3] = req->nbytes;
+	regs->seg[4] = 1 << CRYPTO_GO;
+
+	*in = qce_reg_cmd(qce, *in, regs_addr +
+			  offsetof(struct qce_reg_data, key),
+			  CRYPTO_AES_RNDKEY0, ctx->key_len);
+	if (ctx->mode != CRYPTO_ENCR_MODE_ECB) {
+		for (i = 0; i < 4; i++)
+			regs->iv[i] = get_unaligned_be32(req->info + i * 4);
+		regs->cntr_mask = 0xffffffff;
+		/* The counter mask follows the IV */
+		*in = qce_reg_cmd(qce, *in, regs_addr +
+				  offsetof(struct qce_reg_data, iv),
+				  CRYPTO_CNTR0_IV0_REG,
+				  ctx->mode == CRYPTO_ENCR_MODE_CTR ?
+				  5 * sizeof(u32) : 4 * sizeof(u32));
+	}
+	*in = qce_reg_cmd(qce, *in, regs_addr +
+			  offsetof(struct qce_reg_data, seg),
+			  CRYPTO_SEG_CFG_REG, sizeof(regs->seg));
+
+	*in = qce_data_cmds(qce, *in, req->src, req->nbytes, true);
+	*out = qce_data_cmds(qce, *out, req->dst, req->nbytes, false);
+}
+
+static void qce_hash_cmds(struct qce_device *qce, struct ahash_request *req,
+			  dmov_s **in)
+{
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
+	struct qce_hash_reqctx *rctx = ahash_request_ctx(req);
+	struct qce_reg_data *regs = &qce->dma->regs[0];
+	dma_addr_t regs_addr = qce->dma_addr + offsetof(struct qce_dma, regs);
+	unsigned int digestsize = crypto_ahash_digestsize(tfm);
+	static const u32 sha1_iv[] = {
+		SHA1_H0, SHA1_H1, SHA1_H2, SHA1_H3, SHA1_H4,
+	};
+	static const u32 sha256_iv[] = {
+		SHA256_H0, SHA256_H1, SHA256_H2, SHA256_H3,
+		SHA256_H4, SHA256_H5, SHA256_H6, SHA256_H7,
+	};
+
+	dma_map_sg(qce->dev, req->src, rctx->nents, DMA_TO_DEVICE);
+
+	if (digestsize == SHA1_DIGEST_SIZE) {
+		memcpy(regs->auth_iv, sha1_iv, sizeof(sha1_iv));
+		regs->seg[0] = CRYPTO_AUTH_SIZE_SHA1;
+	} else {
+		memcpy(regs->auth_iv, sha256_iv, sizeof(sha256_iv));
+		regs->seg[0] = CRYPTO_AUTH_SIZE_SHA256;
+	}
+	regs->seg[0] |= CRYPTO_AUTH_ALG_SHA | CRYPTO_ENCR_ALG_NONE |
+		(1 << CRYPTO_FIRST) | (1 << CRYPTO_LAST);
+	regs->seg[1] = 0;
+	regs->seg[2] = req->nbytes << CRYPTO_SEG_SIZE;
+	regs->seg[3] = req->nbytes;
+	regs->seg[4] = 1 << CRYPTO_GO;
+	regs->auth_bytecnt[0] = 0;
+	regs->auth_bytecnt[1] = 0;
+
+	*in = qce_reg_cmd(qce, *in, regs_addr +
+			  offsetof(struct qce_reg_data, auth_iv),
+			  CRYPTO_AUTH_IV0_REG, digestsize);
+	*in = qce_reg_cmd(qce, *in, regs_addr +
+			  offsetof(struct qce_reg_data, auth_bytecnt),
+			  CRYPTO_AUTH_BYTECNT0_REG, sizeof(regs->auth_bytecnt));
+	*in = qce_reg_cmd(qce, *in, regs_addr +
+			  offsetof(struct qce_reg_data, seg),
+			  CRYPTO_SEG_CFG_REG, sizeof(regs->seg));
+	*in = qce_data_cmds(qce, *in, req->src, req->nbytes, true);
+}
+
+static void qce_start_batch(struct qce_device *qce)
+{
+	dmov_s *in = qce->dma->in;
+	dmov_s *out = qce->dma->out;
+	int i;
+
+	qce->result = 0;
+	qce->batches++;
+	qce->requests += qce->nr_batch;
+
+	if (qce_is_hash(qce->batch[0])) {
+		qce_hash_cmds(qce, ahash_request_cast(qce->batch[0]), &in);
+		in[-1].cmd |= CMD_LC;
+		atomic_set(&qce->pending, 1);
+		wmb();
+		msm_dmov_enqueue_cmd(qce->chan_in, &qce->cmd_in);
+		return;
+	}
+
+	for (i = 0; i < qce->nr_batch; i++) {
+		dmov_s *first = in;
+
+		qce_cipher_cmds(qce, ablkcipher_request_cast(qce->batch[i]), i,
+				&in, &out);
+		/* Don't reprogram the engine before the last output is out */
+		if (i)
+			first->cmd |= CMD_OCB;
+		if (i < qce->nr_batch - 1)
+			out[-1].cmd |= CMD_OCU;
+	}
+	in[-1].cmd |= CMD_LC;
+	out[-1].cmd |= CMD_LC;
+
+	atomic_set(&qce->pending, 2);
+	wmb();
+	msm_dmov_enqueue_cmd(qce->chan_out, &qce->cmd_out);
+	msm_dmov_enqueue_cmd(qce->chan_in, &qce->cmd_in);
+}
+
+static void qce_run_queue(struct qce_device *qce)
+{
+	struct crypto_async_request *backlog[QCE_BATCH_MAX];
+	struct crypto_async_request *req, *bl;
+	unsigned long flags;
+	int nr_backlog = 0;
+	int n = 0;
+	int i;
+
+	spin_lock_irqsave(&qce->lock, flags);
+	if (qce->busy) {
+		spin_unlock_irqrestore(&qce->lock, flags);
+		return;
+	}
+
+	while (n < QCE_BATCH_MAX) {
+		if (qce->held) {
+			req = qce->held;
+			qce->held = NULL;
+		} else {
+			bl = crypto_get_backlog(&qce->queue);
+			req = crypto_dequeue_request(&qce->queue);
+			if (!req)
+				break;
+			if (bl)
+				backlog[nr_backlog++] = bl;
+		}
+
+		if (qce_is_hash(req)) {
+			if (n)
+				qce->held = req;
+			else
+				qce->batch[n++] = req;
+			break;
+		}
+		qce->batch[n++] = req;
+	}
+	qce->nr_batch = n;
+	qce->busy = n > 0;
+	spin_unlock_irqrestore(&qce->lock, flags);
+
+	for (i = 0; i < nr_backlog; i++)
+		backlog[i]->complete(backlog[i], -EINPROGRESS);
+
+	if (n)
+		qce_start_batch(qce);
+}
+
+static int qce_enqueue(struct qce_device *qce,
+		       struct crypto_async_request *req)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&qce->lock, flags);
+	ret = crypto_enqueue_request(&qce->queue, req);
+	spin_unlock_irqrestore(&qce->lock, flags);
+
+	qce_run_queue(qce);
+	return ret;
+}
+
+/* Add blocks to a big-endian counter */
+static void qce_ctr_add(u8 *ctr, u32 blocks)
+{
+	int i;
+
+	for (i = AES_BLOCK_SIZE - 1; i >= 0 && blocks; i--) {
+		blocks += ctr[i];
+		ctr[i] = blocks;
+		blocks >>= 8;
+	}
+}
+
+static void qce_cipher_done(struct qce_device *qce,
+			    struct ablkcipher_request *req, int err)
+{
+	struct qce_cipher_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	struct qce_cipher_reqctx *rctx = ablkcipher_request_ctx(req);
+
+	qce_cipher_unmap(qce, req);
+
+	if (!err && ctx->mode == CRYPTO_ENCR_MODE_CBC) {
+		if (rctx->encrypt)
+			scatterwalk_map_and_copy(req->info, req->dst,
+						 req->nbytes - AES_BLOCK_SIZE,
+						 AES_BLOCK_SIZE, 0);
+		else
+			memcpy(req->info, rctx->iv_out, AES_BLOCK_SIZE);
+	} else if (!err && ctx->mode == CRYPTO_ENCR_MODE_CTR) {
+		qce_ctr_add(req->info, req->nbytes / AES_BLOCK_SIZE);
+	}
+
+	req->base.complete(&req->base, err);
+}
+
+static int qce_hash_read(struct qce_device *qce, struct ahash_request *req)
+{
+	unsigned int words = crypto_ahash_digestsize(crypto_ahash_reqtfm(req)) /
+		sizeof(u32);
+	int timeout = 1000;
+	unsigned int i;
+
+	/* The data is in, the last block may still be going */
+	while (!(readl(qce->base + CRYPTO_STATUS_REG) &
+		 (1 << CRYPTO_AUTH_DONE))) {
+		if (!--timeout)
+			return -ETIMEDOUT;
+		udelay(1);
+	}
+
+	for (i = 0; i < words; i++)
+		put_unaligned_be32(readl(qce->base + CRYPTO_AUTH_IV0_REG +
+					 i * sizeof(u32)),
+				   req->result + i * sizeof(u32));
+	return 0;
+}
+
+static void qce_hash_done(struct qce_device *qce, struct ahash_request *req,
+			  int err)
+{
+	struct qce_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	if (!err)
+		err = qce_hash_read(qce, req);
+	dma_unmap_sg(qce->dev, req->src, rctx->nents, DMA_TO_DEVICE);
+	req->base.complete(&req->base, err);
+}
+
+static void qce_done_tasklet(unsigned long data)
+{
+	struct qce_device *qce = (struct qce_device *)data;
+	unsigned long flags;
+	int i;
+
+	if (atomic_read(&qce->pending)) {
+		/* One channel failed, the other may be waiting for it */
+		msm_dmov_flush(qce->chan_in);
+		msm_dmov_flush(qce->chan_out);
+		return;
+	}
+
+	if (qce->result) {
+		dev_err(qce->dev, "batch of %d failed\n", qce->nr_batch);
+		qce->errors++;
+		qce_reset(qce);
+	}
+
+	for (i = 0; i < qce->nr_batch; i++) {
+		struct crypto_async_request *req = qce->batch[i];
+
+		if (qce_is_hash(req))
+			qce_hash_done(qce, ahash_request_cast(req),
+				      qce->result);
+		else
+			qce_cipher_done(qce, ablkcipher_request_cast(req),
+					qce->result);
+	}
+
+	spin_lock_irqsave(&qce->lock, flags);
+	qce->nr_batch = 0;
+	qce->busy = false;
+	spin_unlock_irqrestore(&qce->lock, flags);
+
+	qce_run_queue(qce);
+}
+
+/* Called from the data mover interrupt with its lock held */
+static void qce_dma_complete(struct msm_dmov_cmd *cmd, unsigned int result,
+			     struct msm_dmov_errdata *err)
+{
+	struct qce_device *qce = cmd->user;
+
+	if (!(result & DMOV_RSLT_DONE) ||
+	    (result & (DMOV_RSLT_ERROR | DMOV_RSLT_FLUSH))) {
+		qce->result = -EIO;
+		tasklet_schedule(&qce->done_tasklet);
+	}
+
+	if (atomic_dec_and_test(&qce->pending))
+		tasklet_schedule(&qce->done_tasklet);
+}
+
+static int qce_cipher_fallback(struct ablkcipher_request *req, bool encrypt)
+{
+	struct qce_cipher_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	struct blkcipher_desc desc = {
+		.tfm = ctx->fallback,
+		.info = req->info,
+		.flags = req->base.flags,
+	};
+
+	qce_dev->fallbacks++;
+	if (encrypt)
+		return crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+						   req->nbytes);
+	return crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+					   req->nbytes);
+}
+
+static bool qce_cipher_fits(struct ablkcipher_request *req)
+{
+	struct qce_cipher_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	struct qce_cipher_reqctx *rctx = ablkcipher_request_ctx(req);
+	unsigned int blocks = req->nbytes / AES_BLOCK_SIZE;
+
+	if (ctx->key_len == AES_KEYSIZE_192 || !req->nbytes ||
+	    req->nbytes < qce_min_size ||
+	    req->nbytes > QCE_MAX_NBYTES ||
+	    !IS_ALIGNED(req->nbytes, AES_BLOCK_SIZE))
+		return false;
+
+	/* The engine only counts in the low word */
+	if (ctx->mode == CRYPTO_ENCR_MODE_CTR &&
+	    ~get_unaligned_be32(req->info + 12) < blocks - 1)
+		return false;
+
+	if (qce_sg_cmds(req->src, req->nbytes, &rctx->src_nents) > QCE_MAX_SG)
+		return false;
+	if (req->src == req->dst) {
+		rctx->dst_nents = rctx->src_nents;
+		return true;
+	}
+	return qce_sg_cmds(req->dst, req->nbytes, &rctx->dst_nents) <=
+		QCE_MAX_SG;
+}
+
+static int qce_cipher_crypt(struct ablkcipher_request *req, bool encrypt)
+{
+	struct qce_cipher_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	struct qce_cipher_reqctx *rctx = ablkcipher_request_ctx(req);
+
+	if (!qce_cipher_fits(req))
+		return qce_cipher_fallback(req, encrypt);
+
+	rctx->encrypt = encrypt;
+	/* An in-place decryption overwrites the next IV */
+	if (!encrypt && ctx->mode == CRYPTO_ENCR_MODE_CBC)
+		scatterwalk_map_and_copy(rctx->iv_out, req->src,
+					 req->nbytes - AES_BLOCK_SIZE,
+					 AES_BLOCK_SIZE, 0);
+
+	return qce_enqueue(qce_dev, &req->base);
+}
+
+static int qce_cipher_encrypt(struct ablkcipher_request *req)
+{
+	return qce_cipher_crypt(req, true);
+}
+
+static int qce_cipher_decrypt(struct ablkcipher_request *req)
+{
+	return qce_cipher_crypt(req, false);
+}
+
+static int qce_cipher_setkey(struct crypto_ablkcipher *cipher, const u8 *key,
+			     unsigned int len)
+{
+	struct crypto_tfm *tfm = crypto_ablkcipher_tfm(cipher);
+	struct qce_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	int ret;
+	int i;
+
+	if (len != AES_KEYSIZE_128 && len != AES_KEYSIZE_192 &&
+	    len != AES_KEYSIZE_256) {
+		crypto_ablkcipher_set_flags(cipher,
+					    CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < len / sizeof(u32); i++)
+		ctx->key[i] = get_unaligned_be32(key + i * sizeof(u32));
+	ctx->key_len = len;
+
+	/* The fallback also takes the AES-192 requests */
+	crypto_blkcipher_clear_flags(ctx->fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_blkcipher_set_flags(ctx->fallback,
+				   tfm->crt_flags & CRYPTO_TFM_REQ_MASK);
+	ret = crypto_blkcipher_setkey(ctx->fallback, key, len);
+	tfm->crt_flags &= ~CRYPTO_TFM_RES_MASK;
+	tfm->crt_flags |= crypto_blkcipher_get_flags(ctx->fallback) &
+		CRYPTO_TFM_RES_MASK;
+	return ret;
+}
+
+static int qce_cipher_init(struct crypto_tfm *tfm)
+{
+	struct qce_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct qce_cipher_alg *alg = container_of(tfm->__crt_alg,
+						  struct qce_cipher_alg, alg);
+
+	ctx->mode = alg->mode;
+	ctx->fallback = crypto_alloc_blkcipher(tfm->__crt_alg->cra_name, 0,
+				CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		pr_err("qce: fallback for %s failed\n",
+		       tfm->__crt_alg->cra_name);
+		return PTR_ERR(ctx->fallback);
+	}
+
+	tfm->crt_ablkcipher.reqsize = sizeof(struct qce_cipher_reqctx);
+	return 0;
+}
+
+static void qce_cipher_exit(struct crypto_tfm *tfm)
+{
+	struct qce_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_blkcipher(ctx->fallback);
+}
+
+static int qce_hash_init(struct ahash_request *req)
+{
+	struct qce_hash_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct qce_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	rctx->desc.tfm = ctx->fallback;
+	rctx->desc.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+	return crypto_shash_init(&rctx->desc);
+}
+
+static int qce_hash_update(struct ahash_request *req)
+{
+	struct qce_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	return shash_ahash_update(req, &rctx->desc);
+}
+
+static int qce_hash_final(struct ahash_request *req)
+{
+	struct qce_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	return crypto_shash_final(&rctx->desc, req->result);
+}
+
+static int qce_hash_finup(struct ahash_request *req)
+{
+	struct qce_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	return shash_ahash_finup(req, &rctx->desc);
+}
+
+static int qce_hash_digest(struct ahash_request *req)
+{
+	struct qce_hash_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct qce_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	if (req->nbytes && req->nbytes >= qce_min_size &&
+	    req->nbytes <= QCE_MAX_NBYTES &&
+	    qce_sg_cmds(req->src, req->nbytes, &rctx->nents) <= QCE_MAX_SG)
+		return qce_enqueue(qce_dev, &req->base);
+
+	qce_dev->fallbacks++;
+	rctx->desc.tfm = ctx->fallback;
+	rctx->desc.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+	return shash_ahash_digest(req, &rctx->desc);
+}
+
+static int qce_hash_export(struct ahash_request *req, void *out)
+{
+	struct qce_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	return crypto_shash_export(&rctx->desc, out);
+}
+
+static int qce_hash_import(struct ahash_request *req, const void *in)
+{
+	struct qce_hash_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	struct qce_hash_reqctx *rctx = ahash_request_ctx(req);
+
+	rctx->desc.tfm = ctx->fallback;
+	rctx->desc.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+	return crypto_shash_import(&rctx->desc, in);
+}
+
+static int qce_hash_cra_init(struct crypto_tfm *tfm)
+{
+	struct qce_hash_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	ctx->fallback = crypto_alloc_shash(tfm->__crt_alg->cra_name, 0,
+					   CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		pr_err("qce: fallback for %s failed\n",
+		       tfm->__crt_alg->cra_name);
+		return PTR_ERR(ctx->fallback);
+	}
+
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
+				 sizeof(struct qce_hash_reqctx) +
+				 crypto_shash_descsize(ctx->fallback));
+	return 0;
+}
+
+static void qce_hash_cra_exit(struct crypto_tfm *tfm)
+{
+	struct qce_hash_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_shash(ctx->fallback);
+}
+
+#define QCE_CIPHER_ALG(_mode, _name, _blocksize, _ivsize)		\
+{									\
+	.mode = _mode,							\
+	.alg = {							\
+		.cra_name		= _name "(aes)",		\
+		.cra_driver_name	= "qce-" _name "-aes",		\
+		.cra_priority		= 300,				\
+		.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |	\
+					  CRYPTO_ALG_ASYNC |		\
+					  CRYPTO_ALG_NEED_FALLBACK,	\
+		.cra_blocksize		= _blocksize,			\
+		.cra_ctxsize		= sizeof(struct qce_cipher_ctx), \
+		.cra_alignmask		= 0,				\
+		.cra_type		= &crypto_ablkcipher_type,	\
+		.cra_module		= THIS_MODULE,			\
+		.cra_init		= qce_cipher_init,		\
+		.cra_exit		= qce_cipher_exit,		\
+		.cra_u.ablkcipher	= {				\
+			.min_keysize	= AES_MIN_KEY_SIZE,		\
+			.max_keysize	= AES_MAX_KEY_SIZE,		\
+			.ivsize		= _ivsize,			\
+			.setkey		= qce_cipher_setkey,		\
+			.encrypt	= qce_cipher_encrypt,		\
+			.decrypt	= qce_cipher_decrypt,		\
+		},							\
+	},								\
+}
+
+static struct qce_cipher_alg qce_cipher_algs[] = {
+	QCE_CIPHER_ALG(CRYPTO_ENCR_MODE_ECB, "ecb", AES_BLOCK_SIZE, 0),
+	QCE_CIPHER_ALG(CRYPTO_ENCR_MODE_CBC, "cbc", AES_BLOCK_SIZE,
+		       AES_BLOCK_SIZE),
+	QCE_CIPHER_ALG(CRYPTO_ENCR_MODE_CTR, "ctr", 1, AES_BLOCK_SIZE),
+};
+
+#define QCE_HASH_ALG(_name, _digestsize, _blocksize, _state)		\
+{									\
+	.init		= qce_hash_init,				\
+	.update		= qce_hash_update,				\
+	.final		= qce_hash_final,				\
+	.finup		= qce_hash_finup,				\
+	.digest		= qce_hash_digest,				\
+	.export		= qce_hash_export,				\
+	.import		= qce_hash_import,				\
+	.halg = {							\
+		.digestsize	= _digestsize,				\
+		.statesize	= sizeof(struct _state),		\
+		.base = {						\
+			.cra_name	 = _name,			\
+			.cra_driver_name = "qce-" _name,		\
+			.cra_priority	 = 300,				\
+			.cra_flags	 = CRYPTO_ALG_TYPE_AHASH |	\
+					   CRYPTO_ALG_ASYNC |		\
+					   CRYPTO_ALG_NEED_FALLBACK,	\
+			.cra_blocksize	 = _blocksize,			\
+			.cra_ctxsize	 = sizeof(struct qce_hash_ctx),	\
+			.cra_module	 = THIS_MODULE,			\
+			.cra_init	 = qce_hash_cra_init,		\
+			.cra_exit	 = qce_hash_cra_exit,		\
+		},							\
+	},								\
+}
+
+static struct ahash_alg qce_hash_algs[] = {
+	QCE_HASH_ALG("sha1", SHA1_DIGEST_SIZE, SHA1_BLOCK_SIZE, sha1_state),
+	QCE_HASH_ALG("sha256", SHA256_DIGEST_SIZE, SHA256_BLOCK_SIZE,
+		     sha256_state),
+};
+
+static ssize_t qce_stats_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct qce_device *qce = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE,
+			"requests %lu\nbatches %lu\nfallbacks %lu\nerrors %lu\n",
+			qce->requests, qce->batches, qce->fallbacks,
+			qce->errors);
+}
+
+static DEVICE_ATTR(stats, 0444, qce_stats_show, NULL);
+
+static void qce_unregister_algs(int nr_cipher, int nr_hash)
+{
+	while (nr_hash--)
+		crypto_unregister_ahash(&qce_hash_algs[nr_hash]);
+	while (nr_cipher--)
+		crypto_unregister_alg(&qce_cipher_algs[nr_cipher].alg);
+}
+
+static int qce_register_algs(struct qce_device *qce)
+{
+	int i, j = 0;
+	int ret;
+
+	for (i = 0; i < ARRAY_SIZE(qce_cipher_algs); i++) {
+		INIT_LIST_HEAD(&qce_cipher_algs[i].alg.cra_list);
+		ret = crypto_register_alg(&qce_cipher_algs[i].alg);
+		if (ret)
+			goto err;
+	}
+	for (j = 0; j < ARRAY_SIZE(qce_hash_algs); j++) {
+		ret = crypto_register_ahash(&qce_hash_algs[j]);
+		if (ret)
+			goto err;
+	}
+	return 0;
+
+err:
+	dev_err(qce->dev, "registering algorithms failed %d\n", ret);
+	qce_unregister_algs(i, i < ARRAY_SIZE(qce_cipher_algs) ? 0 : j);
+	return ret;
+}
+
+static int __devinit qce_get_dma(struct platform_device *pdev,
+				 const char *name, unsigned int *start,
+				 unsigned int *end)
+{
+	struct resource *res;
+
+	res = platform_get_resource_byname(pdev, IORESOURCE_DMA, name);
+	if (!res)
+		return -ENXIO;
+	*start = res->start;
+	if (end)
+		*end = res->end;
+	return 0;
+}
+
+static int __devinit qce_probe(struct platform_device *pdev)
+{
+	struct qce_device *qce;
+	struct resource *res;
+	int ret;
+
+	if (qce_dev)
+		return -EBUSY;
+
+	qce = kzalloc(sizeof(struct qce_device), GFP_KERNEL);
+	if (!qce)
+		return -ENOMEM;
+	qce->dev = &pdev->dev;
+
+	res = platform_get_resource_byname(pdev, IORESOURCE_MEM,
+					   "crypto_base");
+	if (!res ||
+	    qce_get_dma(pdev, "crypto_channels", &qce->chan_in,
+			&qce->chan_out) ||
+	    qce_get_dma(pdev, "crypto_crci_in", &qce->crci_in, NULL) ||
+	    qce_get_dma(pdev, "crypto_crci_out", &qce->crci_out, NULL)) {
+		dev_err(&pdev->dev, "missing resources\n");
+		ret = -ENXIO;
+		goto err_free;
+	}
+
+	qce->phys_base = res->start;
+	qce->base = ioremap(res->start, resource_size(res));
+	if (!qce->base) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	qce->clk = clk_get(&pdev->dev, "ce_clk");
+	if (IS_ERR(qce->clk))
+		qce->clk = NULL;
+	else
+		clk_enable(qce->clk);
+
+	if (!(readl(qce->base + CRYPTO_ENGINES_AVAIL) &
+	      (1 << CRYPTO_AES_SEL))) {
+		dev_err(&pdev->dev, "no AES engine\n");
+		ret = -ENODEV;
+		goto err_clk;
+	}
+	qce_reset(qce);
+
+	qce->dma = dma_alloc_coherent(&pdev->dev, sizeof(struct qce_dma),
+				      &qce->dma_addr, GFP_KERNEL);
+	if (!qce->dma) {
+		ret = -ENOMEM;
+		goto err_clk;
+	}
+
+	qce->dma->in_ptr[0] = CMD_PTR_LP | CMD_PTR_ADDR(qce->dma_addr +
+		offsetof(struct qce_dma, in));
+	qce->dma->out_ptr[0] = CMD_PTR_LP | CMD_PTR_ADDR(qce->dma_addr +
+		offsetof(struct qce_dma, out));
+	qce->cmd_in.cmdptr = DMOV_CMD_PTR_LIST |
+		DMOV_CMD_ADDR(qce->dma_addr + offsetof(struct qce_dma, in_ptr));
+	qce->cmd_in.crci_mask = msm_dmov_build_crci_mask(1, qce->crci_in);
+	qce->cmd_in.complete_func = qce_dma_complete;
+	qce->cmd_in.user = qce;
+	qce->cmd_out.cmdptr = DMOV_CMD_PTR_LIST |
+		DMOV_CMD_ADDR(qce->dma_addr + offsetof(struct qce_dma, out_ptr));
+	qce->cmd_out.crci_mask = msm_dmov_build_crci_mask(1, qce->crci_out);
+	qce->cmd_out.complete_func = qce_dma_complete;
+	qce->cmd_out.user = qce;
+
+	spin_lock_init(&qce->lock);
+	crypto_init_queue(&qce->queue, QCE_QUEUE_LEN);
+	tasklet_init(&qce->done_tasklet, qce_done_tasklet,
+		     (unsigned long)qce);
+	platform_set_drvdata(pdev, qce);
+	qce_dev = qce;
+
+	ret = qce_register_algs(qce);
+	if (ret)
+		goto err_dma;
+
+	ret = device_create_file(&pdev->dev, &dev_attr_stats);
+	if (ret)
+		dev_warn(&pdev->dev, "can't create stats file\n");
+
+	dev_info(&pdev->dev, "crypto engine rev %d\n",
+		 (readl(qce->base + CRYPTO_STATUS_REG) &
+		  CRYPTO_CORE_REV_MASK) >> CRYPTO_CORE_REV);
+	return 0;
+
+err_dma:
+	qce_dev = NULL;
+	dma_free_coherent(&pdev->dev, sizeof(struct qce_dma), qce->dma,
+			  qce->dma_addr);
+err_clk:
+	if (qce->clk) {
+		clk_disable(qce->clk);
+		clk_put(qce->clk);
+	}
+	iounmap(qce->base);
+err_free:
+	kfree(qce);
+	return ret;
+}
+
+static int __devexit qce_remove(struct platform_device *pdev)
+{
+	struct qce_device *qce = platform_get_drvdata(pdev);
+
+	device_remove_file(&pdev->dev, &dev_attr_stats);
+	qce_unregister_algs(ARRAY_SIZE(qce_cipher_algs),
+			    ARRAY_SIZE(qce_hash_algs));
+	tasklet_kill(&qce->done_tasklet);
+	qce_dev = NULL;
+
+	dma_free_coherent(&pdev->dev, sizeof(struct qce_dma), qce->dma,
+			  qce->dma_addr);
+	if (qce->clk) {
+		clk_disable(qce->clk);
+		clk_put(qce->clk);
+	}
+	iounmap(qce->base);
+	kfree(qce);
+	return 0;
+}
+
+static struct platform_driver qce_driver = {
+	.probe		= qce_probe,
+	.remove		= __devexit_p(qce_remove),
+	.driver		= {
+		.name	= "qce",
+		.owner	= THIS_MODULE,
+	},
+};
+
+static int __init qce_init(void)
+{
+	return platform_driver_register(&qce_driver);
+}
+
+static void __exit qce_exit(void)
+{
+	platform_driver_unregister(&qce_driver);
+}
+
+module_init(qce_init);
+module_exit(qce_exit);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("Qualcomm crypto engine driver");
@@ -248,9 +248,9 @@ int ion_carveout_heap_map_iommu(struct ion_buffer *buffer,
 					unsigned long iova_length,
 					unsigned long flags)
 {
-	unsigned long temp_phys, temp_iova;
 	struct iommu_domain *domain;
-	int i, ret = 0;
+	struct scatterlist sg;
+	int ret = 0;
 	unsigned long extra;
 
 	data->mapped_size = iova_length;
@@ -277,30 +277,31 @@ int ion_carveout_heap_map_iommu(struct ion_buffer *buffer,
 		goto out1;
 	}
 
-	temp_iova = data->iova_addr;
-	temp_phys = buffer->priv_phys;
-	for (i = buffer->size; i > 0; i -= SZ_4K, temp_iova += SZ_4K,
-						  temp_phys += SZ_4K) {
-		ret = iommu_map(domain, temp_iova, temp_phys,
-				get_order(SZ_4K),
-				ION_IS_CACHED(flags) ? 1 : 0);
-
-		if (ret) {
-			pr_err("%s: could not map %lx to %lx in domain %p\n",
-				__func__, temp_iova, temp_phys, domain);
-			goto out2;
-		}
+	/* The carveout is contiguous, one entry covers the whole buffer */
+	sg_init_table(&sg, 1);
+	sg.length = buffer->size;
+	sg_dma_address(&sg) = buffer->priv_phys;
+
+	ret = iommu_map_range(domain, data->iova_addr, &sg, buffer->size,
+			      ION_IS_CACHED(flags) ? 1 : 0);
+	if (ret) {
+		pr_err("%s: could not map %lx to %lx in domain %p\n",
+			__func__, data->iova_addr, buffer->priv_phys, domain);
+		goto out1;
 	}
 
-	if (extra && (msm_iommu_map_extra(domain, temp_iova, extra, flags) < 0))
-		goto out2;
+	if (extra) {
+		ret = msm_iommu_map_extra(domain, data->iova_addr +
+					  buffer->size, extra, flags);
+		if (ret < 0)
+			goto out2;
+	}
 
 	return 0;
 
 
 out2:
-	for ( ; i < buffer->size; i += SZ_4K, temp_iova -= SZ_4K)
-		iommu_unmap(domain, temp_iova, get_order(SZ_4K));
+	iommu_unmap_range(domain, data->iova_addr, buffer->size);
 
 out1:
 	msm_free_iova_address(data->iova_addr, domain_num, partition_num,
@@ -313,8 +314,6 @@ out:
 
 void ion_carveout_heap_unmap_iommu(struct ion_iommu_map *data)
 {
-	int i;
-	unsigned long temp_iova;
 	unsigned int domain_num;
 	unsigned int partition_num;
 	struct iommu_domain *domain;
@@ -332,9 +331,7 @@ void ion_carveout_heap_unmap_iommu(struct ion_iommu_map *data)
 		return;
 	}
 
-	temp_iova = data->iova_addr;
-	for (i = data->mapped_size; i > 0; i -= SZ_4K, temp_iova += SZ_4K)
-		iommu_unmap(domain, temp_iova, get_order(SZ_4K));
+	iommu_unmap_range(domain, data->iova_addr, data->mapped_size);
 
 	msm_free_iova_address(data->iova_addr, domain_num, partition_num,
 				data->mapped_size);
@@ -158,10 +158,10 @@ int ion_iommu_heap_map_iommu(struct ion_buffer *buffer,
 					unsigned long iova_length,
 					unsigned long flags)
 {
-	unsigned long temp_iova;
 	struct iommu_domain *domain;
 	struct ion_iommu_priv_data *buffer_data = buffer->priv_virt;
-	int i, j, ret = 0;
+	struct scatterlist *sglist;
+	int i, n, ret = 0;
 	unsigned long extra;
 
 	BUG_ON(!msm_use_iommu());
@@ -184,35 +184,47 @@ int ion_iommu_heap_map_iommu(struct ion_buffer *buffer,
 		goto out1;
 	}
 
-	temp_iova = data->iova_addr;
-	for (i = buffer->size, j = 0; i > 0; j++, i -= SZ_4K,
-						temp_iova += SZ_4K) {
-		ret = iommu_map(domain, temp_iova,
-				page_to_phys(buffer_data->pages[j]),
-				get_order(SZ_4K),
-				ION_IS_CACHED(flags) ? 1 : 0);
-
-		if (ret) {
-			pr_err("%s: could not map %lx to %x in domain %p\n",
-				__func__, temp_iova,
-				page_to_phys(buffer_data->pages[j]),
-				domain);
-			goto out2;
-		}
+	/*
+	 * Hand the whole buffer to the IOMMU at once, merging physically
+	 * contiguous pages so the driver can use large pages for them.
+	 */
+	sglist = vmalloc(sizeof(*sglist) * buffer_data->nrpages);
+	if (!sglist) {
+		ret = -ENOMEM;
+		goto out1;
+	}
+	sg_init_table(sglist, buffer_data->nrpages);
+	for (i = 0, n = 0; i < buffer_data->nrpages; i++) {
+		if (n && page_to_phys(buffer_data->pages[i]) ==
+		    sg_phys(&sglist[n - 1]) + sglist[n - 1].length)
+			sglist[n - 1].length += PAGE_SIZE;
+		else
+			sg_set_page(&sglist[n++], buffer_data->pages[i],
+				    PAGE_SIZE, 0);
+	}
+	sg_mark_end(&sglist[n - 1]);
+
+	ret = iommu_map_range(domain, data->iova_addr, sglist,
+			      buffer->size, ION_IS_CACHED(flags) ? 1 : 0);
+	vfree(sglist);
+	if (ret) {
+		pr_err("%s: could not map %lx in domain %p\n",
+			__func__, data->iova_addr, domain);
+		goto out1;
 	}
 
-
-	if (extra &&
-		msm_iommu_map_extra
-			(domain, temp_iova, extra, flags) < 0)
-		goto out2;
+	if (extra) {
+		ret = msm_iommu_map_extra(domain, data->iova_addr +
+					  buffer->size, extra, flags);
+		if (ret < 0)
+			goto out2;
+	}
 
 	return 0;
 
 
 out2:
-	for ( ; i < buffer->size; i += SZ_4K, temp_iova -= SZ_4K)
-		iommu_unmap(domain, temp_iova, get_order(SZ_4K));
+	iommu_unmap_range(domain, data->iova_addr, buffer->size);
 
 out1:
 	msm_free_iova_address(data->iova_addr, domain_num, partition_num,
@@ -225,8 +237,6 @@ out:
 
 void ion_iommu_heap_unmap_iommu(struct ion_iommu_map *data)
 {
-	int i;
-	unsigned long temp_iova;
 	unsigned int domain_num;
 	unsigned int partition_num;
 	struct iommu_domain *domain;
@@ -243,9 +253,7 @@ void ion_iommu_heap_unmap_iommu(struct ion_iommu_map *data)
 		return;
 	}
 
-	temp_iova = data->iova_addr;
-	for (i = data->mapped_size; i > 0; i -= SZ_4K, temp_iova += SZ_4K)
-		iommu_unmap(domain, temp_iova, get_order(SZ_4K));
+	iommu_unmap_range(domain, data->iova_addr, data->mapped_size);
 
 	msm_free_iova_address(data->iova_addr, domain_num, partition_num,
 				data->mapped_size);
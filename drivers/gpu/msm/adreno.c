@@ -119,6 +119,7 @@ static struct adreno_device device_3d0 = {
 	.pm4_fw = NULL,
 	.wait_timeout = 10000, /* in milliseconds */
 	.ib_check_level = 0,
+	.rb_kick_delay_us = 0,
 };
 
 
@@ -893,6 +894,8 @@ static int adreno_getproperty(struct kgsl_device *device,
 static inline void adreno_poke(struct kgsl_device *device)
 {
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+
+	adreno_ringbuffer_kick(&adreno_dev->ringbuffer);
 	adreno_regwrite(device, REG_CP_RB_WPTR, adreno_dev->ringbuffer.wptr);
 }
 
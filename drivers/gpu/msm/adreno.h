@@ -77,6 +77,8 @@ struct adreno_device {
 	unsigned int istore_size;
 	unsigned int pix_shader_start;
 	unsigned int ib_check_level;
+	/* How long user submits may wait for a write pointer kick, 0 = never */
+	unsigned int rb_kick_delay_us;
 };
 
 struct adreno_gpudev {
@@ -15,6 +15,7 @@
 #include <linux/debugfs.h>
 #include <linux/uaccess.h>
 #include <linux/io.h>
+#include <linux/seq_file.h>
 
 #include "kgsl.h"
 #include "adreno_postmortem.h"
@@ -326,6 +327,40 @@ static const struct file_operations kgsl_mh_debug_fops = {
 	.read = kgsl_mh_debug_read,
 };
 
+static int rb_kick_stats_show(struct seq_file *s, void *unused)
+{
+	struct kgsl_device *device = s->private;
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	struct adreno_rb_kick_stats stats;
+
+	mutex_lock(&device->mutex);
+	stats = adreno_dev->ringbuffer.kick_stats;
+	mutex_unlock(&device->mutex);
+
+	seq_printf(s, "submits: %u\n", stats.submits);
+	seq_printf(s, "deferred: %u\n", stats.deferred);
+	seq_printf(s, "kicks: %u\n", stats.kicks);
+	seq_printf(s, "timer_kicks: %u\n", stats.timer_kicks);
+	seq_printf(s, "max_submits_per_kick: %u\n", stats.max_batch);
+	if (stats.kicks)
+		seq_printf(s, "submits_per_kick: %u.%02u\n",
+			   stats.submits / stats.kicks,
+			   (stats.submits % stats.kicks) * 100 / stats.kicks);
+	return 0;
+}
+
+static int rb_kick_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rb_kick_stats_show, inode->i_private);
+}
+
+static const struct file_operations rb_kick_stats_fops = {
+	.open = rb_kick_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void adreno_debugfs_init(struct kgsl_device *device)
 {
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
@@ -347,6 +382,10 @@ void adreno_debugfs_init(struct kgsl_device *device)
 		&adreno_dev->wait_timeout);
 	debugfs_create_u32("ib_check", 0644, device->d_debugfs,
 			   &adreno_dev->ib_check_level);
+	debugfs_create_u32("rb_kick_delay_us", 0644, device->d_debugfs,
+			   &adreno_dev->rb_kick_delay_us);
+	debugfs_create_file("rb_kick_stats", 0444, device->d_debugfs, device,
+			    &rb_kick_stats_fops);
 
 	/* Create post mortem control files */
 
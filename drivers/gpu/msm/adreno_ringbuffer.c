@@ -57,8 +57,19 @@
 
 void adreno_ringbuffer_submit(struct adreno_ringbuffer *rb)
 {
+	struct adreno_rb_kick_stats *stats = &rb->kick_stats;
+
 	BUG_ON(rb->wptr == 0);
 
+	if (rb->pending) {
+		stats->kicks++;
+		if (rb->pending > stats->max_batch)
+			stats->max_batch = rb->pending;
+		rb->pending = 0;
+		hrtimer_try_to_cancel(&rb->kick_timer);
+	}
+	rb->kicked_wptr = rb->wptr;
+
 	/* Let the pwrscale policy know that new commands have
 	 been submitted. */
 	kgsl_pwrscale_busy(rb->device);
@@ -71,6 +82,65 @@ void adreno_ringbuffer_submit(struct adreno_ringbuffer *rb)
 	adreno_regwrite(rb->device, REG_CP_RB_WPTR, rb->wptr);
 }
 
+/*
+ * Deferred kick: user submits that find the CP still busy with earlier
+ * commands only land in the ring, the write pointer is given to the CP by
+ * a later submit, at the latest ADRENO_RB_MAX_DEFERRED submits on, by a
+ * wait on a timestamp or idle, or by the kick timer. Kernel commands,
+ * which include a switch to another context, always kick, so only submits
+ * of one context are put together.
+ */
+static void adreno_ringbuffer_defer(struct adreno_ringbuffer *rb)
+{
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(rb->device);
+	unsigned int delay_us = adreno_dev->rb_kick_delay_us;
+
+	rb->kick_stats.submits++;
+	rb->pending++;
+
+	if (delay_us == 0 || rb->pending >= ADRENO_RB_MAX_DEFERRED) {
+		adreno_ringbuffer_submit(rb);
+		return;
+	}
+
+	/* Nothing to put the submit together with when the CP has caught up */
+	GSL_RB_GET_READPTR(rb, &rb->rptr);
+	if (rb->rptr == rb->kicked_wptr) {
+		adreno_ringbuffer_submit(rb);
+		return;
+	}
+
+	rb->kick_stats.deferred++;
+	if (rb->pending == 1)
+		hrtimer_start(&rb->kick_timer,
+			      ns_to_ktime((u64)delay_us * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+}
+
+static enum hrtimer_restart adreno_ringbuffer_kick_timer(struct hrtimer *t)
+{
+	struct adreno_ringbuffer *rb = container_of(t,
+		struct adreno_ringbuffer, kick_timer);
+
+	/* The write pointer is only stable under the device mutex */
+	queue_work(rb->device->work_queue, &rb->kick_ws);
+	return HRTIMER_NORESTART;
+}
+
+static void adreno_ringbuffer_kick_work(struct work_struct *work)
+{
+	struct adreno_ringbuffer *rb = container_of(work,
+		struct adreno_ringbuffer, kick_ws);
+	struct kgsl_device *device = rb->device;
+
+	mutex_lock(&device->mutex);
+	if (rb->pending && device->state == KGSL_STATE_ACTIVE) {
+		rb->kick_stats.timer_kicks++;
+		adreno_ringbuffer_submit(rb);
+	}
+	mutex_unlock(&device->mutex);
+}
+
 static void
 adreno_ringbuffer_waitspace(struct adreno_ringbuffer *rb, unsigned int numcmds,
 			  int wptr_ahead)
@@ -340,6 +410,7 @@ int adreno_ringbuffer_start(struct adreno_ringbuffer *rb, unsigned int init_ram)
 
 	rb->rptr = 0;
 	rb->wptr = 0;
+	rb->pending = 0;
 
 	/* clear ME_HALT to start micro engine */
 	adreno_regwrite(device, REG_CP_ME_CNTL, 0);
@@ -410,6 +481,8 @@ void adreno_ringbuffer_stop(struct adreno_ringbuffer *rb)
 		adreno_regwrite(rb->device, REG_CP_ME_CNTL, 0x10000000);
 		rb->flags &= ~KGSL_FLAGS_STARTED;
 	}
+	hrtimer_cancel(&rb->kick_timer);
+	rb->pending = 0;
 }
 
 int adreno_ringbuffer_init(struct kgsl_device *device)
@@ -419,6 +492,10 @@ int adreno_ringbuffer_init(struct kgsl_device *device)
 	struct adreno_ringbuffer *rb = &adreno_dev->ringbuffer;
 
 	rb->device = device;
+	hrtimer_init(&rb->kick_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	rb->kick_timer.function = adreno_ringbuffer_kick_timer;
+	INIT_WORK(&rb->kick_ws, adreno_ringbuffer_kick_work);
+
 	/*
 	 * It is silly to convert this to words and then back to bytes
 	 * immediately below, but most of the rest of the code deals
@@ -456,6 +533,9 @@ void adreno_ringbuffer_close(struct adreno_ringbuffer *rb)
 {
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(rb->device);
 
+	hrtimer_cancel(&rb->kick_timer);
+	cancel_work_sync(&rb->kick_ws);
+
 	kgsl_sharedmem_free(&rb->buffer_desc);
 	kgsl_sharedmem_free(&rb->memptrs_desc);
 
@@ -549,7 +629,10 @@ adreno_ringbuffer_addcmds(struct adreno_ringbuffer *rb,
 		GSL_RB_WRITE(ringcmds, rcmd_gpu, CP_INT_CNTL__RB_INT_MASK);
 	}
 
-	adreno_ringbuffer_submit(rb);
+	if (flags & KGSL_CMD_FLAGS_NOT_KERNEL_CMD)
+		adreno_ringbuffer_defer(rb);
+	else
+		adreno_ringbuffer_submit(rb);
 
 	/* return timestamp of issued coREG_ands */
 	return timestamp;
@@ -822,6 +905,8 @@ adreno_ringbuffer_issueibcmds(struct kgsl_device_private *dev_priv,
 		      kgsl_mmu_pt_get_flags(device->mmu.hwpagetable,
 					device->id));
 
+	if (adreno_dev->drawctxt_active != drawctxt)
+		dev_priv->process_priv->ctxt_switches++;
 	adreno_drawctxt_switch(adreno_dev, drawctxt, flags);
 
 	*timestamp = adreno_ringbuffer_addcmds(&adreno_dev->ringbuffer,
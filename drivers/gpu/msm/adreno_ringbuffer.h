@@ -13,6 +13,9 @@
 #ifndef __ADRENO_RINGBUFFER_H
 #define __ADRENO_RINGBUFFER_H
 
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+
 #define GSL_RB_USE_MEM_RPTR
 #define GSL_RB_USE_MEM_TIMESTAMP
 #define GSL_DEVICE_SHADOW_MEMSTORE_TO_USER
@@ -44,6 +47,19 @@ struct kgsl_rbmemptrs {
 #define GSL_RB_MEMPTRS_WPTRPOLL_OFFSET \
 	(offsetof(struct kgsl_rbmemptrs, wptr_poll))
 
+/* Most user submits written to the ring before the write pointer is kicked */
+#define ADRENO_RB_MAX_DEFERRED	8
+
+struct adreno_rb_kick_stats {
+	unsigned int submits;
+	unsigned int kicks;
+	/* Submits that left the write pointer for a later kick */
+	unsigned int deferred;
+	/* Kicks by the timer rather than by a submit or a wait */
+	unsigned int timer_kicks;
+	unsigned int max_batch;
+};
+
 struct adreno_ringbuffer {
 	struct kgsl_device *device;
 	uint32_t flags;
@@ -59,6 +75,14 @@ struct adreno_ringbuffer {
 	unsigned int wptr; /* write pointer offset in dwords from baseaddr */
 	unsigned int rptr; /* read pointer offset in dwords from baseaddr */
 	uint32_t timestamp;
+
+	/* Last write pointer given to the CP */
+	unsigned int kicked_wptr;
+	/* User submits in the ring behind kicked_wptr */
+	unsigned int pending;
+	struct hrtimer kick_timer;
+	struct work_struct kick_ws;
+	struct adreno_rb_kick_stats kick_stats;
 };
 
 
@@ -126,6 +150,15 @@ void adreno_ringbuffer_issuecmds(struct kgsl_device *device,
 					unsigned int *cmdaddr,
 					int sizedwords);
 
+void adreno_ringbuffer_submit(struct adreno_ringbuffer *rb);
+
+/* Give the CP the user submits held back by the deferred kick */
+static inline void adreno_ringbuffer_kick(struct adreno_ringbuffer *rb)
+{
+	if (rb->pending)
+		adreno_ringbuffer_submit(rb);
+}
+
 void kgsl_cp_intrcallback(struct kgsl_device *device);
 
 int adreno_ringbuffer_extract(struct adreno_ringbuffer *rb,
@@ -25,6 +25,7 @@
 #include <linux/ashmem.h>
 #include <linux/major.h>
 #include <linux/ion.h>
+#include <mach/msm_latency.h>
 
 #include "kgsl.h"
 #include "kgsl_debugfs.h"
@@ -34,6 +35,7 @@
 #include "kgsl_device.h"
 #include "kgsl_trace.h"
 #include "kgsl_sync.h"
+#include "kgsl_pool.h"
 
 #undef MODULE_PARAM_PREFIX
 #define MODULE_PARAM_PREFIX "kgsl."
@@ -192,6 +194,37 @@ kgsl_mem_entry_destroy(struct kref *kref)
 }
 EXPORT_SYMBOL(kgsl_mem_entry_destroy);
 
+/*
+ * Entries whose free timestamp retired. Unmapping and freeing them is left
+ * to kgsl_free_work(), so the timestamp work doesn't hold the device mutex
+ * while a process that exits frees all its buffers.
+ */
+static LIST_HEAD(kgsl_free_list);
+static DEFINE_SPINLOCK(kgsl_free_lock);
+
+static void kgsl_free_work(struct work_struct *work)
+{
+	struct kgsl_mem_entry *entry, *tmp;
+	unsigned int count = 0;
+	LIST_HEAD(list);
+
+	spin_lock(&kgsl_free_lock);
+	list_splice_init(&kgsl_free_list, &list);
+	spin_unlock(&kgsl_free_lock);
+
+	list_for_each_entry_safe(entry, tmp, &list, free_list) {
+		list_del(&entry->free_list);
+		kgsl_mem_entry_put(entry);
+		count++;
+	}
+
+	kgsl_driver.stats.deferred_free += count;
+	if (count > kgsl_driver.stats.deferred_free_max)
+		kgsl_driver.stats.deferred_free_max = count;
+}
+
+static DECLARE_WORK(kgsl_free_ws, kgsl_free_work);
+
 static
 void kgsl_mem_entry_attach_process(struct kgsl_mem_entry *entry,
 				   struct kgsl_process_private *process)
@@ -298,12 +331,99 @@ static inline int _mark_next_event(struct kgsl_device *device,
 	return 0;
 }
 
+/*
+ * Charge the GPU time of the submits retired by 'retired' to the processes
+ * that made them. The GPU runs submits in order, so the time since the
+ * last charge, or since the first of them was issued if the GPU had run
+ * dry, is split evenly between them. Consecutive submits of one process
+ * share an entry. Caller must hold the device mutex.
+ */
+static void kgsl_gpu_time_retire(struct kgsl_device *device,
+				 unsigned int retired)
+{
+	struct kgsl_process_private *private;
+	struct kgsl_gpu_time_entry *entry;
+	s64 now, start, share;
+	unsigned int i, n = 0;
+
+	while (n < device->gpu_time.count) {
+		entry = &device->gpu_time.queue[(device->gpu_time.head + n) %
+						KGSL_GPU_TIME_QUEUE];
+		if (timestamp_cmp(retired, entry->timestamp) < 0)
+			break;
+		n++;
+	}
+
+	if (n == 0)
+		return;
+
+	now = ktime_to_ns(ktime_get());
+	entry = &device->gpu_time.queue[device->gpu_time.head];
+	start = max(device->gpu_time.mark, entry->issued);
+	share = now > start ? div_s64(now - start, n) : 0;
+
+	mutex_lock(&kgsl_driver.process_mutex);
+	for (i = 0; i < n; i++) {
+		entry = &device->gpu_time.queue[device->gpu_time.head];
+
+		list_for_each_entry(private, &kgsl_driver.process_list, list) {
+			if (private->pid == entry->pid) {
+				private->gpu_time += share;
+				break;
+			}
+		}
+		trace_kgsl_gpu_time(device, entry->pid, entry->timestamp,
+				    share);
+
+		device->gpu_time.head = (device->gpu_time.head + 1) %
+					KGSL_GPU_TIME_QUEUE;
+	}
+	mutex_unlock(&kgsl_driver.process_mutex);
+
+	device->gpu_time.count -= n;
+	device->gpu_time.mark = now;
+}
+
+/* Queue a submit of 'private' for GPU time accounting */
+static void kgsl_gpu_time_submit(struct kgsl_device *device,
+				 struct kgsl_process_private *private,
+				 unsigned int timestamp)
+{
+	struct kgsl_gpu_time_entry *entry;
+
+	kgsl_gpu_time_retire(device, device->ftbl->readtimestamp(device,
+						KGSL_TIMESTAMP_RETIRED));
+	private->gpu_submits++;
+
+	if (device->gpu_time.count) {
+		entry = &device->gpu_time.queue[(device->gpu_time.head +
+			device->gpu_time.count - 1) % KGSL_GPU_TIME_QUEUE];
+		if (entry->pid == private->pid) {
+			entry->timestamp = timestamp;
+			return;
+		}
+	}
+
+	/* Full: charge the oldest entry as if it just retired */
+	if (device->gpu_time.count == KGSL_GPU_TIME_QUEUE)
+		kgsl_gpu_time_retire(device,
+			device->gpu_time.queue[device->gpu_time.head].timestamp);
+
+	entry = &device->gpu_time.queue[(device->gpu_time.head +
+		device->gpu_time.count) % KGSL_GPU_TIME_QUEUE];
+	entry->timestamp = timestamp;
+	entry->pid = private->pid;
+	entry->issued = ktime_to_ns(ktime_get());
+	device->gpu_time.count++;
+}
+
 static void kgsl_timestamp_expired(struct work_struct *work)
 {
 	struct kgsl_device *device = container_of(work, struct kgsl_device,
 		ts_expired_ws);
 	struct kgsl_event *event, *event_tmp;
 	uint32_t ts_processed;
+	int fired = 0;
 
 	mutex_lock(&device->mutex);
 
@@ -312,6 +432,8 @@ static void kgsl_timestamp_expired(struct work_struct *work)
 		ts_processed = device->ftbl->readtimestamp(device,
 			KGSL_TIMESTAMP_RETIRED);
 
+		kgsl_gpu_time_retire(device, ts_processed);
+
 		/* Process expired events */
 		list_for_each_entry_safe(event, event_tmp, &device->events, list) {
 			if (timestamp_cmp(ts_processed, event->timestamp) < 0)
@@ -322,6 +444,7 @@ static void kgsl_timestamp_expired(struct work_struct *work)
 
 			list_del(&event->list);
 			kfree(event);
+			fired = 1;
 		}
 
 		/*
@@ -335,6 +458,9 @@ static void kgsl_timestamp_expired(struct work_struct *work)
 			break;
 	}
 
+	if (fired)
+		kgsl_pwrscale_frame(device);
+
 	mutex_unlock(&device->mutex);
 }
 
@@ -639,6 +765,9 @@ kgsl_put_process_private(struct kgsl_device *device,
 	if (!private)
 		return;
 
+	/* Deferred frees still account their memory to the process */
+	flush_work(&kgsl_free_ws);
+
 	mutex_lock(&kgsl_driver.process_mutex);
 
 	if (--private->refcnt)
@@ -692,6 +821,8 @@ static int kgsl_release(struct inode *inodep, struct file *filep)
 	if (device->open_count == 0) {
 		result = device->ftbl->stop(device);
 		kgsl_pwrctrl_set_state(device, KGSL_STATE_INIT);
+		/* Timestamps start over with the next open */
+		device->gpu_time.count = 0;
 	}
 	/* clean up any to-be-freed entries that belong to this
 	 * process and this device
@@ -896,6 +1027,7 @@ static long kgsl_ioctl_device_waittimestamp(struct kgsl_device_private
 {
 	int result = 0;
 	struct kgsl_device_waittimestamp *param = data;
+	u64 start;
 
 	/* Set the active count so that suspend doesn't do the
 	   wrong thing */
@@ -903,11 +1035,13 @@ static long kgsl_ioctl_device_waittimestamp(struct kgsl_device_private
 	dev_priv->device->active_cnt++;
 
 	trace_kgsl_waittimestamp_entry(dev_priv->device, param);
+	start = msm_latency_start(MSM_LATENCY_KGSL, param->timestamp);
 
 	result = dev_priv->device->ftbl->waittimestamp(dev_priv->device,
 					param->timestamp,
 					param->timeout);
 
+	msm_latency_done(MSM_LATENCY_KGSL, param->timestamp, start, result);
 	trace_kgsl_waittimestamp_exit(dev_priv->device, result);
 
 	/* Fire off any pending suspend operations that are in flight */
@@ -996,6 +1130,10 @@ static long kgsl_ioctl_rb_issueibcmds(struct kgsl_device_private *dev_priv,
 
 	trace_kgsl_issueibcmds(dev_priv->device, param, result);
 
+	if (result == 0)
+		kgsl_gpu_time_submit(dev_priv->device, dev_priv->process_priv,
+				     param->timestamp);
+
 free_ibdesc:
 	kfree(ibdesc);
 done:
@@ -1029,7 +1167,11 @@ static void kgsl_freemem_event_cb(struct kgsl_device *device,
 	spin_lock(&entry->priv->mem_lock);
 	rb_erase(&entry->node, &entry->priv->mem_rb);
 	spin_unlock(&entry->priv->mem_lock);
-	kgsl_mem_entry_put(entry);
+
+	spin_lock(&kgsl_free_lock);
+	list_add_tail(&entry->free_list, &kgsl_free_list);
+	spin_unlock(&kgsl_free_lock);
+	schedule_work(&kgsl_free_ws);
 }
 
 static long kgsl_ioctl_cmdstream_freememontimestamp(struct kgsl_device_private
@@ -1640,6 +1782,9 @@ static long kgsl_ioctl_map_user_mem(struct kgsl_device_private *dev_priv,
 	if (result)
 		goto error;
 
+	/* The process maps this memory cached */
+	entry->memdesc.priv |= KGSL_MEMFLAGS_CPU_CACHED;
+
 	result = kgsl_mmu_map(private->pagetable,
 			      &entry->memdesc,
 			      GSL_PT_PAGE_RV | GSL_PT_PAGE_WV);
@@ -1710,6 +1855,46 @@ done:
 	return result;
 }
 
+/* Cache maintenance on the part of a buffer the CPU touched */
+static long
+kgsl_ioctl_gpumem_cache_range(struct kgsl_device_private *dev_priv,
+			      unsigned int cmd, void *data)
+{
+	int result;
+	struct kgsl_mem_entry *entry;
+	struct kgsl_gpumem_cache_range *param = data;
+	struct kgsl_process_private *private = dev_priv->process_priv;
+	int op;
+
+	switch (param->op) {
+	case KGSL_GPUMEM_CACHE_CLEAN:
+		op = KGSL_CACHE_OP_CLEAN;
+		break;
+	case KGSL_GPUMEM_CACHE_INV:
+		op = KGSL_CACHE_OP_INV;
+		break;
+	case KGSL_GPUMEM_CACHE_FLUSH:
+		op = KGSL_CACHE_OP_FLUSH;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	spin_lock(&private->mem_lock);
+	entry = kgsl_sharedmem_find(private, param->gpuaddr);
+	if (!entry) {
+		KGSL_CORE_ERR("invalid gpuaddr %08x\n", param->gpuaddr);
+		result = -EINVAL;
+		goto done;
+	}
+
+	result = kgsl_cache_range_op_range(&entry->memdesc, param->offset,
+					   param->length, op);
+done:
+	spin_unlock(&private->mem_lock);
+	return result;
+}
+
 static long
 kgsl_ioctl_gpumem_alloc(struct kgsl_device_private *dev_priv,
 			unsigned int cmd, void *data)
@@ -1930,6 +2115,8 @@ static const struct {
 			kgsl_ioctl_cff_user_event, 0),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_TIMESTAMP_EVENT,
 			kgsl_ioctl_timestamp_event, 1),
+	KGSL_IOCTL_FUNC(IOCTL_KGSL_GPUMEM_CACHE_RANGE,
+			kgsl_ioctl_gpumem_cache_range, 0),
 };
 
 static long kgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
@@ -2007,7 +2194,16 @@ static long kgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
 	}
 
 	if (lock) {
+		struct kgsl_process_private *private = dev_priv->process_priv;
+		s64 start = ktime_to_ns(ktime_get());
+		s64 wait;
+
 		mutex_lock(&dev_priv->device->mutex);
+		/* How long the process waited for the GPU to be handed over */
+		wait = ktime_to_ns(ktime_get()) - start;
+		private->gpu_wait += wait;
+		if (wait > private->gpu_wait_max)
+			private->gpu_wait_max = wait;
 		kgsl_check_suspended(dev_priv->device);
 	}
 
@@ -2410,9 +2606,13 @@ kgsl_ptdata_init(void)
 
 static void kgsl_core_exit(void)
 {
+	flush_work(&kgsl_free_ws);
+
 	kgsl_mmu_ptpool_destroy(kgsl_driver.ptpool);
 	kgsl_driver.ptpool = NULL;
 
+	kgsl_pool_close();
+
 	kgsl_drm_exit();
 	kgsl_cffdump_destroy();
 	kgsl_core_debugfs_close();
@@ -2492,6 +2692,7 @@ static int __init kgsl_core_init(void)
 
 	kgsl_sharedmem_init_sysfs();
 	kgsl_cffdump_init();
+	kgsl_pool_init();
 
 	INIT_LIST_HEAD(&kgsl_driver.process_list);
 
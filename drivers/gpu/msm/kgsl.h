@@ -102,6 +102,12 @@ struct kgsl_driver {
 		unsigned int mapped;
 		unsigned int mapped_max;
 		unsigned int histogram[16];
+		unsigned int chunk_64k;
+		unsigned int chunk_64k_fail;
+		unsigned int cache_op_skipped;
+		unsigned int cache_op_bytes;
+		unsigned int deferred_free;
+		unsigned int deferred_free_max;
 	} stats;
 };
 
@@ -146,6 +152,8 @@ struct kgsl_mem_entry {
 	int memtype;
 	void *priv_data;
 	struct rb_node node;
+	/* On kgsl_free_list once its free timestamp retired */
+	struct list_head free_list;
 	uint32_t free_timestamp;
 	/* back pointer to private structure under whose context this
 	* allocation is made */
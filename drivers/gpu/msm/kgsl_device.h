@@ -135,6 +135,15 @@ struct kgsl_event {
 };
 
 
+/* Submits waiting to have their GPU time charged, per device */
+#define KGSL_GPU_TIME_QUEUE	32
+
+struct kgsl_gpu_time_entry {
+	unsigned int timestamp;
+	pid_t pid;
+	s64 issued;
+};
+
 struct kgsl_device {
 	struct device *dev;
 	const char *name;
@@ -193,6 +202,15 @@ struct kgsl_device {
 	struct work_struct ts_expired_ws;
 	struct list_head events;
 	s64 on_time;
+
+	/* Submits not yet charged, see kgsl_gpu_time_retire() */
+	struct {
+		struct kgsl_gpu_time_entry queue[KGSL_GPU_TIME_QUEUE];
+		unsigned int head;
+		unsigned int count;
+		/* When the GPU time was last charged, in ns */
+		s64 mark;
+	} gpu_time;
 };
 
 struct kgsl_context {
@@ -229,6 +247,16 @@ struct kgsl_process_private {
 		unsigned int cur;
 		unsigned int max;
 	} stats[KGSL_MEM_ENTRY_MAX];
+
+	/* GPU time used by the process, in ns */
+	u64 gpu_time;
+	unsigned int gpu_submits;
+
+	/* Time spent waiting for the device mutex in ioctls, in ns */
+	u64 gpu_wait;
+	u64 gpu_wait_max;
+	/* Times the GPU switched to one of the process's contexts */
+	unsigned int ctxt_switches;
 };
 
 struct kgsl_device_private {
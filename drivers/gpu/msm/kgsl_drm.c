@@ -1189,6 +1189,11 @@ int msm_drm_gem_mmap(struct file *filp, struct vm_area_struct *vma)
 			pgprot_writecombine(vma->vm_page_prot);
 	}
 
+	if (gpriv->type & (DRM_KGSL_GEM_CACHE_WBACK |
+			   DRM_KGSL_GEM_CACHE_WBACKWA |
+			   DRM_KGSL_GEM_CACHE_WTHROUGH))
+		gpriv->memdesc.priv |= KGSL_MEMFLAGS_CPU_CACHED;
+
 	/* flush out existing KMEM cached mappings if new ones are
 	 * of uncached type */
 	if (IS_MEM_UNCACHED(gpriv->type))
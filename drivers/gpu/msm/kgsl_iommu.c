@@ -241,7 +241,7 @@ kgsl_iommu_unmap(void *mmu_specific_pt,
 	if (range == 0 || gpuaddr == 0)
 		return 0;
 
-	ret = iommu_unmap(domain, gpuaddr, range);
+	ret = iommu_unmap_range(domain, gpuaddr, range);
 	if (ret)
 		KGSL_CORE_ERR("iommu_unmap_range(%p, %x, %d) failed "
 			"with err: %d\n", domain, gpuaddr,
@@ -537,8 +537,15 @@ kgsl_mmu_map(struct kgsl_pagetable *pagetable,
 		memdesc->gpuaddr = memdesc->physaddr;
 		return 0;
 	}
+	/*
+	 * A 64KB aligned start keeps the contiguous chunks of large buffers
+	 * on whole super PTEs, and a map that starts on a super PTE boundary
+	 * doesn't have to flush the TLB.
+	 */
 	memdesc->gpuaddr = gen_pool_alloc_aligned(pagetable->pool,
-		memdesc->size, KGSL_MMU_ALIGN_SHIFT);
+		memdesc->size,
+		memdesc->size >= (1 << KGSL_MMU_LARGE_ALIGN_SHIFT) ?
+		KGSL_MMU_LARGE_ALIGN_SHIFT : KGSL_MMU_ALIGN_SHIFT);
 
 	if (memdesc->gpuaddr == 0) {
 		KGSL_CORE_ERR("gen_pool_alloc(%d) failed\n", memdesc->size);
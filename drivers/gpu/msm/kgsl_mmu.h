@@ -15,6 +15,8 @@
 
 #define KGSL_MMU_ALIGN_SHIFT    13
 #define KGSL_MMU_ALIGN_MASK     (~((1 << KGSL_MMU_ALIGN_SHIFT) - 1))
+/* Buffers of at least 64KB start on a 64KB boundary */
+#define KGSL_MMU_LARGE_ALIGN_SHIFT	16
 
 /* Identifier for the global page table */
 /* Per process page tables will probably pass in the thread group
@@ -0,0 +1,283 @@
+/* Copyright (c) 2012, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <linux/delay.h>
+#include <linux/freezer.h>
+#include <linux/kthread.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+
+#include "kgsl.h"
+#include "kgsl_pool.h"
+#include "kgsl_sharedmem.h"
+
+/*
+ * A pool of pages for GPU allocations that are already zeroed and out of
+ * the caches, so kgsl_sharedmem_page_alloc() only has to take them. The
+ * pool is kept filled by a SCHED_IDLE thread, which also zeroes the pages
+ * of freed GPU buffers for reuse. A shrinker gives the pages back under
+ * memory pressure, after which the thread waits a while before filling
+ * the pool again.
+ */
+
+/* Pages zeroed under one vmap */
+#define KGSL_POOL_CHUNK		16
+/* How long to leave the pool alone after the shrinker ran */
+#define KGSL_POOL_BACKOFF_MS	1000
+
+static unsigned int kgsl_pool_size = CONFIG_MSM_KGSL_PAGE_POOL_SIZE;
+module_param_named(pool_size, kgsl_pool_size, uint, 0644);
+
+static struct {
+	spinlock_t lock;
+	struct list_head clean;
+	struct list_head dirty;
+	wait_queue_head_t wait;
+	struct task_struct *task;
+	bool backoff;
+	struct kgsl_pool_stats stats;
+} kgsl_pool = {
+	.lock = __SPIN_LOCK_UNLOCKED(kgsl_pool.lock),
+	.clean = LIST_HEAD_INIT(kgsl_pool.clean),
+	.dirty = LIST_HEAD_INIT(kgsl_pool.dirty),
+	.wait = __WAIT_QUEUE_HEAD_INITIALIZER(kgsl_pool.wait),
+};
+
+static bool kgsl_pool_needs_work(void)
+{
+	bool ret;
+
+	spin_lock(&kgsl_pool.lock);
+	ret = kgsl_pool.stats.dirty ||
+		kgsl_pool.stats.pages < kgsl_pool_size;
+	spin_unlock(&kgsl_pool.lock);
+	return ret;
+}
+
+/*
+ * Zero one chunk of pages, the freed ones first, and add it to the pool.
+ * Returns the number of pages added.
+ */
+static int kgsl_pool_refill_chunk(void)
+{
+	struct page *pages[KGSL_POOL_CHUNK];
+	unsigned int total;
+	int count = 0;
+	int i;
+
+	spin_lock(&kgsl_pool.lock);
+	while (count < KGSL_POOL_CHUNK && !list_empty(&kgsl_pool.dirty)) {
+		pages[count] = list_first_entry(&kgsl_pool.dirty,
+						struct page, lru);
+		list_del(&pages[count]->lru);
+		kgsl_pool.stats.dirty--;
+		count++;
+	}
+	total = kgsl_pool.stats.pages + kgsl_pool.stats.dirty + count;
+	spin_unlock(&kgsl_pool.lock);
+
+	for (; count < KGSL_POOL_CHUNK && total < kgsl_pool_size; total++) {
+		/* Don't push the system into reclaim to fill the pool */
+		pages[count] = alloc_page(GFP_KERNEL | __GFP_HIGHMEM |
+					  __GFP_NOWARN | __GFP_NORETRY);
+		if (pages[count] == NULL) {
+			kgsl_pool.backoff = true;
+			break;
+		}
+		count++;
+	}
+
+	if (count == 0)
+		return 0;
+
+	kgsl_zero_pages(pages, count);
+
+	spin_lock(&kgsl_pool.lock);
+	for (i = 0; i < count; i++)
+		list_add_tail(&pages[i]->lru, &kgsl_pool.clean);
+	kgsl_pool.stats.pages += count;
+	spin_unlock(&kgsl_pool.lock);
+
+	return count;
+}
+
+static int kgsl_pool_thread(void *data)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	/* Only run when nothing else wants the CPU */
+	sched_setscheduler(current, SCHED_IDLE, &param);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(kgsl_pool.wait,
+			kgsl_pool_needs_work() || kthread_should_stop());
+
+		if (kgsl_pool.backoff) {
+			kgsl_pool.backoff = false;
+			msleep_interruptible(KGSL_POOL_BACKOFF_MS);
+			continue;
+		}
+
+		while (!kthread_should_stop() && !kgsl_pool.backoff &&
+		       kgsl_pool_refill_chunk())
+			;
+	}
+
+	return 0;
+}
+
+/**
+ * kgsl_pool_get_pages - take zeroed pages from the pool
+ * @pages: where to store the pages
+ * @count: number of pages wanted
+ *
+ * Return the number of pages taken, the caller allocates the rest itself.
+ */
+int kgsl_pool_get_pages(struct page **pages, int count)
+{
+	int i = 0;
+
+	spin_lock(&kgsl_pool.lock);
+	while (i < count && !list_empty(&kgsl_pool.clean)) {
+		pages[i] = list_first_entry(&kgsl_pool.clean,
+					    struct page, lru);
+		list_del(&pages[i]->lru);
+		i++;
+	}
+	kgsl_pool.stats.pages -= i;
+	kgsl_pool.stats.hits += i;
+	kgsl_pool.stats.misses += count - i;
+	spin_unlock(&kgsl_pool.lock);
+
+	if (kgsl_pool.task)
+		wake_up(&kgsl_pool.wait);
+
+	return i;
+}
+
+/**
+ * kgsl_pool_put_page - give a freed page to the pool
+ * @page: the page, no longer used by the GPU
+ *
+ * Return true if the pool took the page, else the caller frees it.
+ */
+bool kgsl_pool_put_page(struct page *page)
+{
+	bool ret = false;
+
+	/* Still mapped by a process that hasn't unmapped the buffer yet */
+	if (page_count(page) != 1 || !kgsl_pool.task)
+		return false;
+
+	spin_lock(&kgsl_pool.lock);
+	if (kgsl_pool.stats.pages + kgsl_pool.stats.dirty < kgsl_pool_size) {
+		list_add_tail(&page->lru, &kgsl_pool.dirty);
+		kgsl_pool.stats.dirty++;
+		kgsl_pool.stats.recycled++;
+		ret = true;
+	}
+	spin_unlock(&kgsl_pool.lock);
+
+	if (ret)
+		wake_up(&kgsl_pool.wait);
+
+	return ret;
+}
+
+void kgsl_pool_get_stats(struct kgsl_pool_stats *stats)
+{
+	spin_lock(&kgsl_pool.lock);
+	*stats = kgsl_pool.stats;
+	spin_unlock(&kgsl_pool.lock);
+}
+
+/* Free up to nr pages, the dirty ones first */
+static int kgsl_pool_free_pages(int nr)
+{
+	LIST_HEAD(list);
+	struct page *page, *tmp;
+	int freed = 0;
+
+	spin_lock(&kgsl_pool.lock);
+	while (freed < nr && !list_empty(&kgsl_pool.dirty)) {
+		list_move(kgsl_pool.dirty.next, &list);
+		kgsl_pool.stats.dirty--;
+		freed++;
+	}
+	while (freed < nr && !list_empty(&kgsl_pool.clean)) {
+		list_move(kgsl_pool.clean.next, &list);
+		kgsl_pool.stats.pages--;
+		freed++;
+	}
+	kgsl_pool.stats.shrunk += freed;
+	spin_unlock(&kgsl_pool.lock);
+
+	list_for_each_entry_safe(page, tmp, &list, lru) {
+		list_del(&page->lru);
+		__free_page(page);
+	}
+
+	return freed;
+}
+
+static int kgsl_pool_shrink(struct shrinker *shrinker, int nr_to_scan,
+			    gfp_t gfp_mask)
+{
+	int count;
+
+	if (nr_to_scan) {
+		kgsl_pool.backoff = true;
+		kgsl_pool_free_pages(nr_to_scan);
+	}
+
+	spin_lock(&kgsl_pool.lock);
+	count = kgsl_pool.stats.pages + kgsl_pool.stats.dirty;
+	spin_unlock(&kgsl_pool.lock);
+
+	return count;
+}
+
+static struct shrinker kgsl_pool_shrinker = {
+	.shrink = kgsl_pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+int kgsl_pool_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(kgsl_pool_thread, NULL, "kgsl_pool");
+	if (IS_ERR(task)) {
+		KGSL_CORE_ERR("kthread_run(kgsl_pool) failed %ld\n",
+			PTR_ERR(task));
+		return PTR_ERR(task);
+	}
+	kgsl_pool.task = task;
+	register_shrinker(&kgsl_pool_shrinker);
+	return 0;
+}
+
+void kgsl_pool_close(void)
+{
+	if (!kgsl_pool.task)
+		return;
+
+	unregister_shrinker(&kgsl_pool_shrinker);
+	kthread_stop(kgsl_pool.task);
+	kgsl_pool.task = NULL;
+	kgsl_pool_free_pages(INT_MAX);
+}
@@ -0,0 +1,58 @@
+/* Copyright (c) 2012, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#ifndef __KGSL_POOL_H
+#define __KGSL_POOL_H
+
+#include <linux/types.h>
+
+struct page;
+
+struct kgsl_pool_stats {
+	/* Zeroed pages ready to be handed out */
+	unsigned int pages;
+	/* Freed pages waiting to be zeroed */
+	unsigned int dirty;
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int recycled;
+	unsigned int shrunk;
+};
+
+#ifdef CONFIG_MSM_KGSL_PAGE_POOL
+int kgsl_pool_init(void);
+void kgsl_pool_close(void);
+int kgsl_pool_get_pages(struct page **pages, int count);
+bool kgsl_pool_put_page(struct page *page);
+void kgsl_pool_get_stats(struct kgsl_pool_stats *stats);
+#else
+static inline int kgsl_pool_init(void)
+{
+	return 0;
+}
+
+static inline void kgsl_pool_close(void)
+{
+}
+
+static inline int kgsl_pool_get_pages(struct page **pages, int count)
+{
+	return 0;
+}
+
+static inline bool kgsl_pool_put_page(struct page *page)
+{
+	return false;
+}
+#endif
+
+#endif /* __KGSL_POOL_H */
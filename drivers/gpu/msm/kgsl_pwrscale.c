@@ -44,6 +44,9 @@ static struct kgsl_pwrscale_policy *kgsl_pwrscale_policies[] = {
 #endif
 #ifdef CONFIG_MSM_SLEEP_STATS_DEVICE
 	&kgsl_pwrscale_policy_idlestats,
+#endif
+#ifdef CONFIG_MSM_KGSL_PWRSCALE_FRAMETIME
+	&kgsl_pwrscale_policy_frametime,
 #endif
 	NULL
 };
@@ -221,6 +224,13 @@ void kgsl_pwrscale_wake(struct kgsl_device *device)
 }
 EXPORT_SYMBOL(kgsl_pwrscale_wake);
 
+void kgsl_pwrscale_frame(struct kgsl_device *device)
+{
+	if (device->pwrscale.policy && device->pwrscale.policy->frame)
+		device->pwrscale.policy->frame(device, &device->pwrscale);
+}
+EXPORT_SYMBOL(kgsl_pwrscale_frame);
+
 void kgsl_pwrscale_busy(struct kgsl_device *device)
 {
 	if (device->pwrscale.policy && device->pwrscale.policy->busy)
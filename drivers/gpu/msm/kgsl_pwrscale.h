@@ -30,6 +30,9 @@ struct kgsl_pwrscale_policy  {
 		struct kgsl_pwrscale *pwrscale);
 	void (*wake)(struct kgsl_device *device,
 		struct kgsl_pwrscale *pwrscale);
+	/* A frame was handed on, i.e. a timestamp event fired */
+	void (*frame)(struct kgsl_device *device,
+		struct kgsl_pwrscale *pwrscale);
 };
 
 struct kgsl_pwrscale {
@@ -54,6 +57,7 @@ struct kgsl_pwrscale_policy_attribute {
 
 extern struct kgsl_pwrscale_policy kgsl_pwrscale_policy_tz;
 extern struct kgsl_pwrscale_policy kgsl_pwrscale_policy_idlestats;
+extern struct kgsl_pwrscale_policy kgsl_pwrscale_policy_frametime;
 
 int kgsl_pwrscale_init(struct kgsl_device *device);
 void kgsl_pwrscale_close(struct kgsl_device *device);
@@ -66,6 +70,7 @@ void kgsl_pwrscale_idle(struct kgsl_device *device);
 void kgsl_pwrscale_busy(struct kgsl_device *device);
 void kgsl_pwrscale_sleep(struct kgsl_device *device);
 void kgsl_pwrscale_wake(struct kgsl_device *device);
+void kgsl_pwrscale_frame(struct kgsl_device *device);
 
 int kgsl_pwrscale_policy_add_files(struct kgsl_device *device,
 				   struct kgsl_pwrscale *pwrscale,
@@ -0,0 +1,256 @@
+/* Copyright (c) 2012, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+
+#include "kgsl.h"
+#include "kgsl_pwrscale.h"
+#include "kgsl_device.h"
+
+/*
+ * Pick the GPU power level from the GPU time of each frame rather than
+ * from the busy percentage. A frame ends when a timestamp event (the
+ * buffer handed to the compositor) fires. The GPU time of the frame is
+ * scaled to the fastest level, and the slowest level that would still
+ * finish the frame within 'headroom' percent of the frame time at
+ * 'target_fps' is chosen. A frame that took longer than the average
+ * counts at once, so the clock goes up on the next frame and comes down
+ * slowly.
+ *
+ * Clients that never register timestamp events get a frame every
+ * FT_MAX_FRAME_US, with the GPU time scaled to the frame time.
+ */
+
+#define FT_MAX_FRAME_US		100000
+
+struct frametime_priv {
+	unsigned int target_fps;
+	unsigned int headroom;
+	/* GPU time since the last frame, in us at the fastest level */
+	u64 work;
+	/* Running average of the GPU time per frame, same unit */
+	unsigned int avg;
+	s64 last_frame;
+	unsigned int frames;
+	unsigned int last_work;
+};
+
+static unsigned int ft_freq(struct kgsl_pwrctrl *pwr, int level)
+{
+	/* Cores in sync with AXI only scale the bus */
+	if (pwr->pwrlevels[level].gpu_freq)
+		return pwr->pwrlevels[level].gpu_freq;
+	return pwr->pwrlevels[level].bus_freq;
+}
+
+/* Add the GPU time since the last call to the work of the current frame */
+static void ft_account(struct kgsl_device *device, struct frametime_priv *priv)
+{
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	struct kgsl_power_stats stats;
+	unsigned int fmax = ft_freq(pwr, pwr->thermal_pwrlevel);
+
+	/* The busy counter can't be read with the clocks off */
+	if (device->state != KGSL_STATE_ACTIVE)
+		return;
+
+	device->ftbl->power_stats(device, &stats);
+	if (stats.busy_time <= 0 || fmax == 0)
+		return;
+
+	priv->work += div_u64((u64)stats.busy_time *
+			      ft_freq(pwr, pwr->active_pwrlevel), fmax);
+}
+
+static void ft_frame(struct kgsl_device *device, struct frametime_priv *priv,
+		     s64 now)
+{
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	unsigned int budget, demand, fmax;
+	s64 elapsed = now - priv->last_frame;
+	int level;
+
+	ft_account(device, priv);
+
+	/* No frame events: treat the window as frames at the target rate */
+	if (elapsed > FT_MAX_FRAME_US && priv->target_fps)
+		priv->work = div64_u64(priv->work * (USEC_PER_SEC /
+				       priv->target_fps), elapsed);
+
+	priv->last_work = min_t(u64, priv->work, UINT_MAX);
+	priv->work = 0;
+	priv->last_frame = now;
+	priv->frames++;
+
+	priv->avg = (priv->avg * 3 + priv->last_work) / 4;
+	demand = max(priv->avg, priv->last_work);
+
+	if (priv->target_fps == 0)
+		return;
+	budget = USEC_PER_SEC / priv->target_fps * priv->headroom / 100;
+	fmax = ft_freq(pwr, pwr->thermal_pwrlevel);
+
+	/* The last level is the one used while the GPU is off */
+	for (level = pwr->num_pwrlevels - 2; level > pwr->thermal_pwrlevel;
+	     level--) {
+		unsigned int f = ft_freq(pwr, level);
+
+		if (f && div_u64((u64)demand * fmax, f) <= budget)
+			break;
+	}
+
+	kgsl_pwrctrl_pwrlevel_change(device, level);
+}
+
+static void ft_frame_event(struct kgsl_device *device,
+			   struct kgsl_pwrscale *pwrscale)
+{
+	ft_frame(device, pwrscale->priv, ktime_to_us(ktime_get()));
+}
+
+static void ft_idle(struct kgsl_device *device, struct kgsl_pwrscale *pwrscale)
+{
+	struct frametime_priv *priv = pwrscale->priv;
+	s64 now = ktime_to_us(ktime_get());
+
+	if (now - priv->last_frame > FT_MAX_FRAME_US)
+		ft_frame(device, priv, now);
+	else
+		ft_account(device, priv);
+}
+
+static void ft_sleep(struct kgsl_device *device,
+		     struct kgsl_pwrscale *pwrscale)
+{
+	struct frametime_priv *priv = pwrscale->priv;
+
+	/* Work from before the GPU slept says little about the next frame */
+	priv->work = 0;
+	priv->avg = 0;
+	priv->last_frame = ktime_to_us(ktime_get());
+}
+
+static ssize_t ft_target_fps_show(struct kgsl_device *device,
+				  struct kgsl_pwrscale *pwrscale, char *buf)
+{
+	struct frametime_priv *priv = pwrscale->priv;
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", priv->target_fps);
+}
+
+static ssize_t ft_target_fps_store(struct kgsl_device *device,
+				   struct kgsl_pwrscale *pwrscale,
+				   const char *buf, size_t count)
+{
+	struct frametime_priv *priv = pwrscale->priv;
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val) || val == 0 || val > 1000)
+		return -EINVAL;
+
+	mutex_lock(&device->mutex);
+	priv->target_fps = val;
+	mutex_unlock(&device->mutex);
+	return count;
+}
+
+static ssize_t ft_headroom_show(struct kgsl_device *device,
+				struct kgsl_pwrscale *pwrscale, char *buf)
+{
+	struct frametime_priv *priv = pwrscale->priv;
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", priv->headroom);
+}
+
+static ssize_t ft_headroom_store(struct kgsl_device *device,
+				 struct kgsl_pwrscale *pwrscale,
+				 const char *buf, size_t count)
+{
+	struct frametime_priv *priv = pwrscale->priv;
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val) || val == 0 || val > 100)
+		return -EINVAL;
+
+	mutex_lock(&device->mutex);
+	priv->headroom = val;
+	mutex_unlock(&device->mutex);
+	return count;
+}
+
+static ssize_t ft_stats_show(struct kgsl_device *device,
+			     struct kgsl_pwrscale *pwrscale, char *buf)
+{
+	struct frametime_priv *priv = pwrscale->priv;
+	int ret;
+
+	mutex_lock(&device->mutex);
+	ret = snprintf(buf, PAGE_SIZE,
+		       "frames: %u\nlast_frame_us: %u\navg_frame_us: %u\n"
+		       "pwrlevel: %u\n", priv->frames, priv->last_work,
+		       priv->avg, device->pwrctrl.active_pwrlevel);
+	mutex_unlock(&device->mutex);
+	return ret;
+}
+
+PWRSCALE_POLICY_ATTR(target_fps, 0644, ft_target_fps_show,
+		     ft_target_fps_store);
+PWRSCALE_POLICY_ATTR(headroom, 0644, ft_headroom_show, ft_headroom_store);
+PWRSCALE_POLICY_ATTR(stats, 0444, ft_stats_show, NULL);
+
+static struct attribute *ft_attrs[] = {
+	&policy_attr_target_fps.attr,
+	&policy_attr_headroom.attr,
+	&policy_attr_stats.attr,
+	NULL
+};
+
+static struct attribute_group ft_attr_group = {
+	.attrs = ft_attrs,
+};
+
+static int ft_init(struct kgsl_device *device, struct kgsl_pwrscale *pwrscale)
+{
+	struct frametime_priv *priv;
+
+	priv = pwrscale->priv = kzalloc(sizeof(struct frametime_priv),
+		GFP_KERNEL);
+	if (pwrscale->priv == NULL)
+		return -ENOMEM;
+
+	priv->target_fps = 60;
+	priv->headroom = 80;
+	priv->last_frame = ktime_to_us(ktime_get());
+	kgsl_pwrscale_policy_add_files(device, pwrscale, &ft_attr_group);
+
+	return 0;
+}
+
+static void ft_close(struct kgsl_device *device, struct kgsl_pwrscale *pwrscale)
+{
+	kgsl_pwrscale_policy_remove_files(device, pwrscale, &ft_attr_group);
+	kfree(pwrscale->priv);
+	pwrscale->priv = NULL;
+}
+
+struct kgsl_pwrscale_policy kgsl_pwrscale_policy_frametime = {
+	.name = "frametime",
+	.init = ft_init,
+	.idle = ft_idle,
+	.sleep = ft_sleep,
+	.frame = ft_frame_event,
+	.close = ft_close
+};
+EXPORT_SYMBOL(kgsl_pwrscale_policy_frametime);
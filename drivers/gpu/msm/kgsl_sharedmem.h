@@ -29,6 +29,16 @@ struct kgsl_process_private;
 
 /** Set if the memdesc describes cached memory */
 #define KGSL_MEMFLAGS_CACHED    0x00000001
+/*
+ * Set if the CPU may have the memory in its caches, i.e. it has a
+ * cacheable mapping of it. Memory only ever mapped write-combined
+ * skips cache maintenance.
+ */
+#define KGSL_MEMFLAGS_CPU_CACHED	0x00000002
+
+/* Physically contiguous chunks allocated for large buffers, 64KB */
+#define KGSL_CHUNK_ORDER	4
+#define KGSL_CHUNK_PAGES	(1 << KGSL_CHUNK_ORDER)
 
 extern struct kgsl_memdesc_ops kgsl_page_alloc_ops;
 
@@ -65,6 +75,11 @@ int kgsl_sharedmem_set(const struct kgsl_memdesc *memdesc,
 
 void kgsl_cache_range_op(struct kgsl_memdesc *memdesc, int op);
 
+int kgsl_cache_range_op_range(struct kgsl_memdesc *memdesc,
+			unsigned int offset, unsigned int length, int op);
+
+void kgsl_zero_pages(struct page **pages, int count);
+
 void kgsl_process_init_sysfs(struct kgsl_process_private *private);
 void kgsl_process_uninit_sysfs(struct kgsl_process_private *private);
 
@@ -156,6 +156,39 @@ TRACE_EVENT(kgsl_waittimestamp_exit,
 	)
 );
 
+/*
+ * Tracepoint for the GPU time charged to a process when its submits retire
+ */
+TRACE_EVENT(kgsl_gpu_time,
+
+	TP_PROTO(struct kgsl_device *device, pid_t pid,
+		 unsigned int timestamp, s64 busy),
+
+	TP_ARGS(device, pid, timestamp, busy),
+
+	TP_STRUCT__entry(
+		__string(device_name, device->name)
+		__field(pid_t, pid)
+		__field(unsigned int, timestamp)
+		__field(s64, busy)
+	),
+
+	TP_fast_assign(
+		__assign_str(device_name, device->name);
+		__entry->pid = pid;
+		__entry->timestamp = timestamp;
+		__entry->busy = busy;
+	),
+
+	TP_printk(
+		"d_name=%s pid=%d timestamp=%u busy_ns=%lld",
+		__get_str(device_name),
+		__entry->pid,
+		__entry->timestamp,
+		__entry->busy
+	)
+);
+
 DECLARE_EVENT_CLASS(kgsl_pwr_template,
 	TP_PROTO(struct kgsl_device *device, int on),
 
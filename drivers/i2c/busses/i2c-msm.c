@@ -27,7 +27,7 @@
 #include <linux/delay.h>
 #include <linux/io.h>
 #include <mach/board.h>
-#include <linux/mutex.h>
+#include <linux/rtmutex.h>
 #include <linux/timer.h>
 #include <linux/remote_spinlock.h>
 #include <linux/pm_qos_params.h>
@@ -87,7 +87,8 @@ struct msm_i2c_dev {
 	int                          one_bit_t;
 	remote_mutex_t               r_lock;
 	int                          suspended;
-	struct mutex                 mlock;
+	/* Taken in priority order, so a touch IRQ thread goes first */
+	struct rt_mutex              mlock;
 	struct msm_i2c_platform_data *pdata;
 	struct timer_list            pwr_timer;
 	int                          clk_state;
@@ -375,9 +376,9 @@ msm_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 	int check_busy = 1;
 
 	del_timer_sync(&dev->pwr_timer);
-	mutex_lock(&dev->mlock);
+	rt_mutex_lock(&dev->mlock);
 	if (dev->suspended) {
-		mutex_unlock(&dev->mlock);
+		rt_mutex_unlock(&dev->mlock);
 		return -EIO;
 	}
 
@@ -543,7 +544,7 @@ wait_for_int:
 	pm_qos_update_request(dev->pm_qos_req,
 			      PM_QOS_DEFAULT_VALUE);
 	mod_timer(&dev->pwr_timer, (jiffies + 3*HZ));
-	mutex_unlock(&dev->mlock);
+	rt_mutex_unlock(&dev->mlock);
 	return ret;
 }
 
@@ -655,6 +656,7 @@ msm_i2c_probe(struct platform_device *pdev)
 
 	dev->one_bit_t = USEC_PER_SEC/pdata->clk_freq;
 	spin_lock_init(&dev->lock);
+	rt_mutex_init(&dev->mlock);
 	platform_set_drvdata(pdev, dev);
 
 	clk_enable(clk);
@@ -744,7 +746,6 @@ msm_i2c_probe(struct platform_device *pdev)
 
 	disable_irq(dev->irq);
 	dev->suspended = 0;
-	mutex_init(&dev->mlock);
 	dev->clk_state = 0;
 	/* Config GPIOs for primary and secondary lines */
 	pdata->msm_i2c_config_gpio(dev->adap_pri.nr, 1);
@@ -790,10 +791,10 @@ msm_i2c_remove(struct platform_device *pdev)
 	struct resource		*mem;
 
 	/* Grab mutex to ensure ongoing transaction is over */
-	mutex_lock(&dev->mlock);
+	rt_mutex_lock(&dev->mlock);
 	dev->suspended = 1;
-	mutex_unlock(&dev->mlock);
-	mutex_destroy(&dev->mlock);
+	rt_mutex_unlock(&dev->mlock);
+	rt_mutex_destroy(&dev->mlock);
 	del_timer_sync(&dev->pwr_timer);
 	if (dev->clk_state != 0)
 		msm_i2c_pwr_mgmt(dev, 0);
@@ -819,9 +820,9 @@ static int msm_i2c_suspend(struct platform_device *pdev, pm_message_t state)
 	 */
 	if (dev) {
 		/* Grab mutex to ensure ongoing transaction is over */
-		mutex_lock(&dev->mlock);
+		rt_mutex_lock(&dev->mlock);
 		dev->suspended = 1;
-		mutex_unlock(&dev->mlock);
+		rt_mutex_unlock(&dev->mlock);
 		del_timer_sync(&dev->pwr_timer);
 		if (dev->clk_state != 0)
 			msm_i2c_pwr_mgmt(dev, 0);
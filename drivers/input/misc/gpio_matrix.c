@@ -23,10 +23,12 @@
 */
 
 #include <linux/kernel.h>
+#include <linux/debugfs.h>
 #include <linux/gpio.h>
 #include <linux/gpio_event.h>
 #include <linux/hrtimer.h>
 #include <linux/interrupt.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/wakelock.h>
 
@@ -43,9 +45,23 @@ struct gpio_kp {
 	unsigned int last_key_state_changed:1;
 	unsigned int some_keys_pressed:2;
 	unsigned int disabled_irq:1;
+	unsigned int held:1;
+	ktime_t held_start;
+	struct {
+		unsigned long scans;
+		unsigned long timer_calls;
+		u64 timer_ns;
+		unsigned long irqs;
+		unsigned long held;
+		u64 held_ns;
+		unsigned long held_polls;
+	} stats;
+	struct dentry *debugfs;
 	unsigned long keys_pressed[0];
 };
 
+static struct dentry *gpio_matrix_debugfs;
+
 
 static void clear_phantom_key(struct gpio_kp *kp, int out, int in)
 {
@@ -142,19 +158,120 @@ static void report_key(struct gpio_kp *kp, int key_index, int out, int in)
 	}
 }
 
-static enum hrtimer_restart gpio_keypad_timer_func(struct hrtimer *timer)
+static unsigned long gpio_keypad_trigger(struct gpio_event_matrix_info *mi,
+					 int active)
+{
+	int high = !(mi->flags & GPIOKPF_ACTIVE_HIGH) ^ !!active;
+
+	if (mi->flags & GPIOKPF_LEVEL_TRIGGERED_IRQ)
+		return high ? IRQF_TRIGGER_HIGH : IRQF_TRIGGER_LOW;
+	return high ? IRQF_TRIGGER_RISING : IRQF_TRIGGER_FALLING;
+}
+
+static void gpio_keypad_drive_outputs(struct gpio_kp *kp)
+{
+	int out;
+	struct gpio_event_matrix_info *mi = kp->keypad_info;
+	unsigned gpio_keypad_flags = mi->flags;
+	unsigned polarity = !!(gpio_keypad_flags & GPIOKPF_ACTIVE_HIGH);
+
+	for (out = 0; out < mi->noutputs; out++) {
+		if (gpio_keypad_flags & GPIOKPF_DRIVE_INACTIVE)
+#ifdef ROW_SCAN   //ZTE_KB_ZFJ_20110325
+		{
+			gpio_direction_output(mi->output_gpios[out], polarity);
+			gpio_set_value(mi->output_gpios[out], polarity);
+		}
+#else
+			gpio_set_value(mi->output_gpios[out], polarity);
+#endif
+		else
+			gpio_direction_output(mi->output_gpios[out], polarity);
+	}
+}
+
+static void gpio_keypad_release_outputs(struct gpio_kp *kp)
+{
+	int i;
+	struct gpio_event_matrix_info *mi = kp->keypad_info;
+	unsigned gpio_keypad_flags = mi->flags;
+
+	for (i = 0; i < mi->noutputs; i++) {
+		if (gpio_keypad_flags & GPIOKPF_DRIVE_INACTIVE)
+			gpio_set_value(mi->output_gpios[i],
+				!(gpio_keypad_flags & GPIOKPF_ACTIVE_HIGH));
+		else
+			gpio_direction_input(mi->output_gpios[i]);
+	}
+}
+
+/*
+ * Keys are held and the last scan saw no change: instead of rescanning
+ * every poll_time, drive all outputs and arm each input for the level
+ * it does not have now. An idle input fires when a key on it is
+ * pressed, a busy one when all of its keys are released. The wake lock
+ * stays held so the release is still reported, but the cpu is free to
+ * power collapse until the next edge or held_poll_time.
+ */
+static void gpio_keypad_hold(struct gpio_kp *kp)
+{
+	int in;
+	int gpio;
+	struct gpio_event_matrix_info *mi = kp->keypad_info;
+	unsigned polarity = !!(mi->flags & GPIOKPF_ACTIVE_HIGH);
+
+	gpio_keypad_drive_outputs(kp);
+	for (in = 0; in < mi->ninputs; in++) {
+		gpio = mi->input_gpios[in];
+		set_irq_type(gpio_to_irq(gpio), gpio_keypad_trigger(mi,
+				!(gpio_get_value(gpio) ^ !polarity)));
+	}
+	kp->held = 1;
+	kp->held_start = ktime_get();
+	kp->stats.held++;
+	for (in = 0; in < mi->ninputs; in++)
+		enable_irq(gpio_to_irq(mi->input_gpios[in]));
+	if (mi->held_poll_time.tv64)
+		hrtimer_start(&kp->timer, mi->held_poll_time, HRTIMER_MODE_REL);
+}
+
+/* Called with the input interrupts disabled */
+static void gpio_keypad_unhold(struct gpio_kp *kp)
+{
+	int in;
+	struct gpio_event_matrix_info *mi = kp->keypad_info;
+
+	for (in = 0; in < mi->ninputs; in++)
+		set_irq_type(gpio_to_irq(mi->input_gpios[in]),
+			     gpio_keypad_trigger(mi, 1));
+	kp->stats.held_ns += ktime_to_ns(ktime_sub(ktime_get(),
+						   kp->held_start));
+	kp->held = 0;
+}
+
+static enum hrtimer_restart gpio_keypad_scan(struct gpio_kp *kp)
 {
 	int out, in;
 	int key_index;
 	int gpio;
-	struct gpio_kp *kp = container_of(timer, struct gpio_kp, timer);
+	struct hrtimer *timer = &kp->timer;
 	struct gpio_event_matrix_info *mi = kp->keypad_info;
 	unsigned gpio_keypad_flags = mi->flags;
 	unsigned polarity = !!(gpio_keypad_flags & GPIOKPF_ACTIVE_HIGH);
 
+	if (kp->held) {
+		/* held_poll_time expired without an edge */
+		for (in = 0; in < mi->ninputs; in++)
+			disable_irq_nosync(gpio_to_irq(mi->input_gpios[in]));
+		gpio_keypad_unhold(kp);
+		gpio_keypad_release_outputs(kp);
+		kp->stats.held_polls++;
+	}
+
 	out = kp->current_output;
 	if (out == mi->noutputs) {
 		out = 0;
+		kp->stats.scans++;
 		kp->last_key_state_changed = kp->key_state_changed;
 		kp->key_state_changed = 0;
 		kp->some_keys_pressed = 0;
@@ -219,36 +336,40 @@ static enum hrtimer_restart gpio_keypad_timer_func(struct hrtimer *timer)
 				report_key(kp, key_index, out, in);
 	}
 	if (!kp->use_irq || kp->some_keys_pressed) {
+		if (kp->use_irq && !kp->key_state_changed &&
+		    (gpio_keypad_flags & GPIOKPF_HELD_KEY_IRQ)) {
+			gpio_keypad_hold(kp);
+			return HRTIMER_NORESTART;
+		}
 		hrtimer_start(timer, mi->poll_time, HRTIMER_MODE_REL);
 		return HRTIMER_NORESTART;
 	}
 
 	/* No keys are pressed, reenable interrupt */
-	for (out = 0; out < mi->noutputs; out++) {
-		if (gpio_keypad_flags & GPIOKPF_DRIVE_INACTIVE)
-#ifdef ROW_SCAN   //ZTE_KB_ZFJ_20110325
-		{
-			gpio_direction_output(mi->output_gpios[out], polarity);
-			gpio_set_value(mi->output_gpios[out], polarity);
-		}
-#else
-			gpio_set_value(mi->output_gpios[out], polarity);
-#endif
-		else
-			gpio_direction_output(mi->output_gpios[out], polarity);
-	}
+	gpio_keypad_drive_outputs(kp);
 	for (in = 0; in < mi->ninputs; in++)
 		enable_irq(gpio_to_irq(mi->input_gpios[in]));
 	wake_unlock(&kp->wake_lock);
 	return HRTIMER_NORESTART;
 }
 
+static enum hrtimer_restart gpio_keypad_timer_func(struct hrtimer *timer)
+{
+	struct gpio_kp *kp = container_of(timer, struct gpio_kp, timer);
+	ktime_t start = ktime_get();
+	enum hrtimer_restart ret;
+
+	ret = gpio_keypad_scan(kp);
+	kp->stats.timer_calls++;
+	kp->stats.timer_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	return ret;
+}
+
 static irqreturn_t gpio_keypad_irq_handler(int irq_in, void *dev_id)
 {
 	int i;
 	struct gpio_kp *kp = dev_id;
 	struct gpio_event_matrix_info *mi = kp->keypad_info;
-	unsigned gpio_keypad_flags = mi->flags;
 
 	if (!kp->use_irq) {
 		/* ignore interrupt while registering the handler */
@@ -257,20 +378,45 @@ static irqreturn_t gpio_keypad_irq_handler(int irq_in, void *dev_id)
 		return IRQ_HANDLED;
 	}
 
+	kp->stats.irqs++;
 	for (i = 0; i < mi->ninputs; i++)
 		disable_irq_nosync(gpio_to_irq(mi->input_gpios[i]));
-	for (i = 0; i < mi->noutputs; i++) {
-		if (gpio_keypad_flags & GPIOKPF_DRIVE_INACTIVE)
-			gpio_set_value(mi->output_gpios[i],
-				!(gpio_keypad_flags & GPIOKPF_ACTIVE_HIGH));
-		else
-			gpio_direction_input(mi->output_gpios[i]);
+	if (kp->held) {
+		hrtimer_try_to_cancel(&kp->timer);
+		gpio_keypad_unhold(kp);
 	}
+	gpio_keypad_release_outputs(kp);
 	wake_lock(&kp->wake_lock);
 	hrtimer_start(&kp->timer, ktime_set(0, 0), HRTIMER_MODE_REL);
 	return IRQ_HANDLED;
 }
 
+static int gpio_keypad_stats_show(struct seq_file *m, void *unused)
+{
+	struct gpio_kp *kp = m->private;
+
+	seq_printf(m, "scans: %lu\n", kp->stats.scans);
+	seq_printf(m, "timer_calls: %lu\n", kp->stats.timer_calls);
+	seq_printf(m, "timer_us: %llu\n", div_u64(kp->stats.timer_ns, 1000));
+	seq_printf(m, "irqs: %lu\n", kp->stats.irqs);
+	seq_printf(m, "held: %lu\n", kp->stats.held);
+	seq_printf(m, "held_ms: %llu\n", div_u64(kp->stats.held_ns, 1000000));
+	seq_printf(m, "held_polls: %lu\n", kp->stats.held_polls);
+	return 0;
+}
+
+static int gpio_keypad_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, gpio_keypad_stats_show, inode->i_private);
+}
+
+static const struct file_operations gpio_keypad_stats_fops = {
+	.open		= gpio_keypad_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int gpio_keypad_request_irqs(struct gpio_kp *kp)
 {
 	int i;
@@ -279,20 +425,7 @@ static int gpio_keypad_request_irqs(struct gpio_kp *kp)
 	unsigned long request_flags;
 	struct gpio_event_matrix_info *mi = kp->keypad_info;
 
-	switch (mi->flags & (GPIOKPF_ACTIVE_HIGH|GPIOKPF_LEVEL_TRIGGERED_IRQ)) {
-	default:
-		request_flags = IRQF_TRIGGER_FALLING;
-		break;
-	case GPIOKPF_ACTIVE_HIGH:
-		request_flags = IRQF_TRIGGER_RISING;
-		break;
-	case GPIOKPF_LEVEL_TRIGGERED_IRQ:
-		request_flags = IRQF_TRIGGER_LOW;
-		break;
-	case GPIOKPF_LEVEL_TRIGGERED_IRQ | GPIOKPF_ACTIVE_HIGH:
-		request_flags = IRQF_TRIGGER_HIGH;
-		break;
-	}
+	request_flags = gpio_keypad_trigger(mi, 1);
 
 	for (i = 0; i < mi->ninputs; i++) {
 		err = irq = gpio_to_irq(mi->input_gpios[i]);
@@ -432,6 +565,15 @@ int gpio_event_matrix_func(struct gpio_event_input_devs *input_devs,
 			(input_devs->count > 1) ? "..." : "",
 			kp->use_irq ? "interrupt" : "polling");
 
+		if (!gpio_matrix_debugfs)
+			gpio_matrix_debugfs = debugfs_create_dir("gpio_matrix",
+								 NULL);
+		if (!IS_ERR_OR_NULL(gpio_matrix_debugfs))
+			kp->debugfs = debugfs_create_file(
+				input_devs->dev[0]->name, S_IRUGO,
+				gpio_matrix_debugfs, kp,
+				&gpio_keypad_stats_fops);
+
 		if (kp->use_irq)
 			wake_lock(&kp->wake_lock);
 		hrtimer_start(&kp->timer, ktime_set(0, 0), HRTIMER_MODE_REL);
@@ -441,6 +583,7 @@ int gpio_event_matrix_func(struct gpio_event_input_devs *input_devs,
 	err = 0;
 	kp = *data;
 
+	debugfs_remove(kp->debugfs);
 	if (kp->use_irq)
 		for (i = mi->noutputs - 1; i >= 0; i--)
 			free_irq(gpio_to_irq(mi->input_gpios[i]), kp);
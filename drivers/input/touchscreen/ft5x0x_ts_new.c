@@ -19,6 +19,7 @@ When		Who	What,Where,Why		Comment			Tag
 #include <linux/i2c.h>
 #include <linux/input.h>
 #include <linux/interrupt.h>
+#include <linux/input/touch_latency.h>
 #include <linux/io.h>
 #include <linux/proc_fs.h>
 #include <linux/platform_device.h>
@@ -72,7 +73,6 @@ static int usb_plug_status=0;
 
 
 
-static struct workqueue_struct *Fts_wq;
 static struct i2c_driver Fts_ts_driver;
 
 struct Fts_ts_data
@@ -85,7 +85,7 @@ struct Fts_ts_data
 	int touch_event;
 	int use_irq;
 	struct hrtimer timer;
-	struct work_struct  work;
+	struct touch_latency latency;
 	uint16_t max[2];
 	struct early_suspend early_suspend;
 };
@@ -306,17 +306,39 @@ static int proc_write_val(struct file *file, const char *buffer,
 	return 0;
 }
 
-static void Fts_ts_work_func(struct work_struct *work)
+/* The whole report in one transfer, SMBus block reads stop at 32 bytes */
+static int Fts_ts_read_report(struct i2c_client *client, uint8_t *buf, int len)
+{
+	uint8_t reg = 0x00;
+	struct i2c_msg msgs[] = {
+		{
+			.addr	= client->addr,
+			.flags	= 0,
+			.len	= 1,
+			.buf	= &reg,
+		},
+		{
+			.addr	= client->addr,
+			.flags	= I2C_M_RD,
+			.len	= len,
+			.buf	= buf,
+		},
+	};
+	int ret;
+
+	ret = i2c_transfer(client->adapter, msgs, 2);
+	return ret == 2 ? 0 : (ret < 0 ? ret : -EIO);
+}
+
+static irqreturn_t Fts_ts_irq_thread(int irq, void *dev_id)
 {
 	int ret, i;
 	uint8_t buf[33];
-	struct Fts_ts_data *ts = container_of(work, struct Fts_ts_data, work);
-
+	struct Fts_ts_data *ts = dev_id;
 
-	//buf = i2c_smbus_read_byte_data(ts->client, 0x00, 33); 
-	ret = i2c_smbus_read_i2c_block_data(ts->client, 0x00, 33, buf);
+	ret = Fts_ts_read_report(ts->client, buf, sizeof(buf));
 	if (ret < 0){
-   		printk(KERN_ERR "Fts_ts_work_func: i2c_smbus_write_byte_data failed, go to poweroff.\n");
+   		printk(KERN_ERR "Fts_ts_irq_thread: reading the report failed, go to poweroff.\n");
 	    	gpio_direction_output(GPIO_TOUCH_EN_OUT, 0);
 	    	msleep(200);
 	    	gpio_direction_output(GPIO_TOUCH_EN_OUT, 1);
@@ -348,33 +370,32 @@ static void Fts_ts_work_func(struct work_struct *work)
 			//ts->finger_data[i].z, ts->finger_data[i].event_flag,ts->finger_data[i].touch_id);
 		}
 		input_sync(ts->input_dev);
+		touch_latency_sync(&ts->latency);
 	}
-	if (ts->use_irq)
-		enable_irq(ts->client->irq);
+	return IRQ_HANDLED;
 }
 
 static irqreturn_t Fts_ts_irq_handler(int irq, void *dev_id)
 {
 	struct Fts_ts_data *ts = dev_id;
 
-	disable_irq_nosync(ts->client->irq);
-	queue_work(Fts_wq, &ts->work);
+	touch_latency_irq(&ts->latency);
+	return IRQ_WAKE_THREAD;
+}
+
+static ssize_t Fts_ts_latency_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct Fts_ts_data *ts = i2c_get_clientdata(to_i2c_client(dev));
 
-	return IRQ_HANDLED;
+	return touch_latency_show(&ts->latency, buf);
 }
+static DEVICE_ATTR(latency, 0444, Fts_ts_latency_show, NULL);
 
 static int Fts_ts_suspend(struct i2c_client *client, pm_message_t mesg)
 {
-	int ret = 0;
-	struct Fts_ts_data *ts;
-	
-	//ts = container_of(client, struct Fts_ts_data , client);
-	ts = i2c_get_clientdata(client);
+	/* Also waits for a running IRQ thread */
 	disable_irq(client->irq);
-	ret = cancel_work_sync(&ts->work);
-	if(ret & ts->use_irq)
-		enable_irq(client->irq);
-	//flush_workqueue(ts->work);
 	// ==set mode ==, 
 	//ft5x0x_set_reg(FT5X0X_REG_PMODE, PMODE_HIBERNATE);
 	gpio_direction_output(GPIO_TOUCH_INT_WAKEUP,1);
@@ -469,16 +490,6 @@ static int Fts_ts_probe(
 
 	if (!validate_fts_ctpm(client))
 		goto err_detect_failed;
-	
-	Fts_wq= create_singlethread_workqueue("Fts_wq");
-	if(!Fts_wq)
-	{
-		ret = -ESRCH;
-		pr_err("%s creare single thread workqueue failed!\n", __func__);
-		goto err_detect_failed;
-	}
-
-	INIT_WORK(&ts->work, Fts_ts_work_func);
 
 	ts->client = client;
 	i2c_set_clientdata(client, ts);
@@ -529,10 +540,14 @@ static int Fts_ts_probe(
 		printk(KERN_ERR "Fts_ts_probe: Unable to register %s input device\n", ts->input_dev->name);
 		goto err_input_register_device_failed;
 	}
+	/* Only depends on its I2C adapter, which the PM core orders for us */
+	device_enable_async_suspend(&client->dev);
 
   if (client->irq)
   {
-    ret = request_irq(client->irq, Fts_ts_irq_handler, IRQF_TRIGGER_FALLING, "ft5x0x_ts", ts);
+    ret = request_threaded_irq(client->irq, Fts_ts_irq_handler,
+      Fts_ts_irq_thread, IRQF_TRIGGER_FALLING | IRQF_ONESHOT,
+      "ft5x0x_ts", ts);
     if (ret == 0)
       ts->use_irq = 1;
     else
@@ -542,6 +557,9 @@ static int Fts_ts_probe(
     }
   }
 
+	if (device_create_file(&client->dev, &dev_attr_latency))
+		dev_err(&client->dev, "failed to create latency attribute\n");
+
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	ts->early_suspend.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN + 1;
 	ts->early_suspend.suspend = Fts_ts_early_suspend;
@@ -578,7 +596,6 @@ err_input_request_irq_failed:
 err_input_register_device_failed:
 	input_free_device(ts->input_dev);
 err_input_dev_alloc_failed:
-	destroy_workqueue(Fts_wq);
 err_detect_failed:
 	kfree(ts);
 err_alloc_data_failed:
@@ -598,6 +615,7 @@ static int Fts_ts_remove(struct i2c_client *client)
 #endif
 
 	unregister_early_suspend(&ts->early_suspend);
+	device_remove_file(&client->dev, &dev_attr_latency);
 	if (ts->use_irq)
 		free_irq(client->irq, ts);
 	else
@@ -631,21 +649,12 @@ static struct i2c_driver Fts_ts_driver = {
 
 static int __devinit Fts_ts_init(void)
 {
-	/*ZTE_TS_ZFJ_20110302 begin*/
-	#if 0
-	Fts_wq = create_rt_workqueue("Fts_wq");
-	if (!Fts_wq)
-		return -ENOMEM;
-	#endif
-	/*ZTE_TS_ZFJ_20110302 end*/
 	return i2c_add_driver(&Fts_ts_driver);
 }
 
 static void __exit Fts_ts_exit(void)
 {
 	i2c_del_driver(&Fts_ts_driver);
-	if (Fts_wq)
-		destroy_workqueue(Fts_wq);
 }
 
 module_init(Fts_ts_init);
@@ -1879,6 +1879,8 @@ static int atmel_ts_probe(struct i2c_client *client,
 			ts->input_dev->name);
 		goto err_input_register_device_failed;
 	}
+	/* Only depends on its I2C adapter, which the PM core orders for us */
+	device_enable_async_suspend(&client->dev);
 
 	ret = request_irq(client->irq, atmel_ts_irq_handler, IRQF_TRIGGER_LOW,//IRQF_TRIGGER_FALLING,
 			client->name, ts);
@@ -423,10 +423,9 @@ static int synaptics_rmi4_set_panel_state(
 	return ret;
 }
 
-static void synaptics_rmi4_work_func(struct work_struct *work)
+static void synaptics_rmi4_report(struct synaptics_rmi4_data *ts)
 {
 	int ret=0;
-	struct synaptics_rmi4_data *ts = container_of(work, struct synaptics_rmi4_data, work);
 	__u16 interrupt	= 0;
 	int buf_len		= ts->data_len;
 	__u8 buf[buf_len];
@@ -495,12 +494,17 @@ static void synaptics_rmi4_work_func(struct work_struct *work)
 				input_mt_sync(ts->input_dev);
 			}
 			input_sync(ts->input_dev);
+			if (ts->use_irq)
+				touch_latency_sync(&ts->latency);
 		}
 	}
+}
 
-	if (ts->use_irq)
-		enable_irq(ts->client->irq);
+static void synaptics_rmi4_work_func(struct work_struct *work)
+{
+	struct synaptics_rmi4_data *ts = container_of(work, struct synaptics_rmi4_data, work);
 
+	synaptics_rmi4_report(ts);
 }
 
 
@@ -515,11 +519,27 @@ static enum hrtimer_restart synaptics_rmi4_timer_func(struct hrtimer *timer)
 irqreturn_t synaptics_rmi4_irq_handler(int irq, void *dev_id)
 {
 	struct synaptics_rmi4_data *ts = dev_id;
-	disable_irq_nosync(ts->client->irq);
-	queue_work(synaptics_wq, &ts->work);
+
+	touch_latency_irq(&ts->latency);
+	return IRQ_WAKE_THREAD;
+}
+
+/* The line stays masked (IRQF_ONESHOT) until the report has been read */
+static irqreturn_t synaptics_rmi4_irq_thread(int irq, void *dev_id)
+{
+	synaptics_rmi4_report(dev_id);
 	return IRQ_HANDLED;
 }
 
+static ssize_t synaptics_rmi4_latency_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct synaptics_rmi4_data *ts = i2c_get_clientdata(to_i2c_client(dev));
+
+	return touch_latency_show(&ts->latency, buf);
+}
+static DEVICE_ATTR(latency, 0444, synaptics_rmi4_latency_show, NULL);
+
 static int synaptics_rmi4_probe(
 	struct i2c_client *client,
 	const struct i2c_device_id *id)
@@ -665,12 +685,15 @@ static int synaptics_rmi4_probe(
 			__func__, ts->input_dev->name);
 		goto err_input_register_device_failed;
 	}
+	/* Only depends on its I2C adapter, which the PM core orders for us */
+	device_enable_async_suspend(&client->dev);
 
 	ts->use_irq = 1;
 	if (client->irq)
 	{
-	        if (request_irq(client->irq, synaptics_rmi4_irq_handler,
-			IRQF_TRIGGER_FALLING, client->name, ts)==0)
+	        if (request_threaded_irq(client->irq, synaptics_rmi4_irq_handler,
+			synaptics_rmi4_irq_thread,
+			IRQF_TRIGGER_FALLING | IRQF_ONESHOT, client->name, ts)==0)
         {
 			pr_info("Received IRQ!\n");
 			ts->use_irq = 1;
@@ -686,6 +709,9 @@ static int synaptics_rmi4_probe(
 		hrtimer_start(&ts->timer, ktime_set(1, 0), HRTIMER_MODE_REL);
 	}
 
+	if (device_create_file(&client->dev, &dev_attr_latency))
+		dev_err(&client->dev, "failed to create latency attribute\n");
+
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	ts->early_suspend.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN + 1;
 	ts->early_suspend.suspend = synaptics_rmi4_early_suspend;
@@ -743,10 +769,13 @@ static int synaptics_rmi4_remove(struct i2c_client *client)
 	}
 
 	unregister_early_suspend(&ts->early_suspend);
+	device_remove_file(&client->dev, &dev_attr_latency);
 	if (ts->use_irq)
 		free_irq(client->irq, ts);
-	else
+	else {
 		hrtimer_cancel(&ts->timer);
+		cancel_work_sync(&ts->work);
+	}
 	input_unregister_device(ts->input_dev);
 
 	kfree(ts);
@@ -756,20 +785,16 @@ static int synaptics_rmi4_remove(struct i2c_client *client)
 
 static int synaptics_rmi4_suspend(struct i2c_client *client, pm_message_t mesg)
 {
-	int ret;
-
 	struct synaptics_rmi4_data *ts = i2c_get_clientdata(client);
 
+	/* disable_irq() also waits for a running IRQ thread */
 	if (ts->use_irq){
 		disable_irq(client->irq);
 	}
-	else
+	else {
 		hrtimer_cancel(&ts->timer);
-
-	ret = cancel_work_sync(&ts->work);
-	/* if work was pending disable-count is now 2 */
-	if (ret && ts->use_irq)
-		enable_irq(client->irq);
+		cancel_work_sync(&ts->work);
+	}
 
 	synaptics_rmi4_set_panel_state(ts, TS_SUSPEND);
 	return 0;
@@ -33,6 +33,7 @@
 #include <linux/uaccess.h>
 #include <linux/fs.h>
 #include <linux/list.h>
+#include <linux/hash.h>
 #include <linux/uaccess.h>
 #include <linux/android_pmem.h>
 #include <linux/poll.h>
@@ -54,6 +55,12 @@ spinlock_t pp_thumb_spinlock;
 #define ERR_COPY_FROM_USER() ERR_USER_COPY(0)
 #define ERR_COPY_TO_USER() ERR_USER_COPY(1)
 
+/* Pending stats of one type kept for the config thread, 0 for no limit */
+static int msm_stats_queue_max = 2;
+module_param_named(stats_queue_max, msm_stats_queue_max, int, 0644);
+static unsigned int msm_stats_dropped;
+module_param_named(stats_dropped, msm_stats_dropped, uint, 0444);
+
 static struct class *msm_class;
 static dev_t msm_devno;
 static LIST_HEAD(msm_sensors);
@@ -150,8 +157,14 @@ static inline void free_qcmd(struct msm_queue_cmd *qcmd)
 
 static void msm_region_init(struct msm_sync *sync)
 {
+	int i;
+
 	INIT_HLIST_HEAD(&sync->pmem_frames);
 	INIT_HLIST_HEAD(&sync->pmem_stats);
+	for (i = 0; i < (1 << MSM_PMEM_HASH_BITS); i++) {
+		INIT_HLIST_HEAD(&sync->pmem_frame_hash[i]);
+		INIT_HLIST_HEAD(&sync->pmem_stats_hash[i]);
+	}
 	spin_lock_init(&sync->pmem_frame_spinlock);
 	spin_lock_init(&sync->pmem_stats_spinlock);
 }
@@ -297,7 +310,18 @@ static int check_pmem_info(struct msm_pmem_info *info, int len)
 		len);
 	return -EINVAL;
 }
+static inline struct hlist_head *msm_pmem_hash(struct hlist_head *hash,
+	unsigned long paddr)
+{
+	return &hash[hash_long(paddr, MSM_PMEM_HASH_BITS)];
+}
+
+/*
+ * Frames are hashed by the address of their Y plane and stats buffers by
+ * their start, which is what the VFE hands back when a buffer is done.
+ */
 static int msm_pmem_table_add(struct hlist_head *ptype,
+	struct hlist_head *hash, int hash_y_off,
 	struct msm_pmem_info *info, spinlock_t* pmem_spinlock)
 {
 	struct file *file;
@@ -341,6 +365,7 @@ static int msm_pmem_table_add(struct hlist_head *ptype,
 
 	spin_lock_irqsave(pmem_spinlock, flags);
 	INIT_HLIST_NODE(&region->list);
+	INIT_HLIST_NODE(&region->hash);
 
 	region->paddr = paddr;
 	region->len = len;
@@ -348,6 +373,8 @@ static int msm_pmem_table_add(struct hlist_head *ptype,
 	memcpy(&region->info, info, sizeof(region->info));
 
 	hlist_add_head(&(region->list), ptype);
+	hlist_add_head(&region->hash, msm_pmem_hash(hash,
+		hash_y_off ? paddr + info->y_off : paddr));
 	spin_unlock_irqrestore(pmem_spinlock, flags);
 	pr_info("%s: type %d, paddr 0x%lx, vaddr 0x%lx\n",
 		__func__, info->type, paddr, (unsigned long)info->vaddr);
@@ -429,7 +456,8 @@ static int msm_pmem_frame_ptov_lookup(struct msm_sync *sync,
 	unsigned long flags = 0;
 
 	spin_lock_irqsave(&sync->pmem_frame_spinlock, flags);
-	hlist_for_each_entry_safe(region, node, n, &sync->pmem_frames, list) {
+	hlist_for_each_entry_safe(region, node, n,
+			msm_pmem_hash(sync->pmem_frame_hash, pyaddr), hash) {
 		if (pyaddr == (region->paddr + region->info.y_off) &&
 				pcbcraddr == (region->paddr +
 						region->info.cbcr_off) &&
@@ -467,7 +495,8 @@ static unsigned long msm_pmem_stats_ptov_lookup(struct msm_sync *sync,
 	unsigned long flags = 0;
 
 	spin_lock_irqsave(&sync->pmem_stats_spinlock, flags);
-	hlist_for_each_entry_safe(region, node, n, &sync->pmem_stats, list) {
+	hlist_for_each_entry_safe(region, node, n,
+			msm_pmem_hash(sync->pmem_stats_hash, addr), hash) {
 		if (addr == region->paddr && region->info.active) {
 			/* offset since we could pass vaddr inside a
 			 * registered pmem buffer */
@@ -584,6 +613,7 @@ static int __msm_pmem_table_del(struct msm_sync *sync,
 					pinfo->vaddr == region->info.vaddr &&
 					pinfo->fd == region->info.fd) {
 				hlist_del(node);
+				hlist_del(&region->hash);
 				put_pmem_file(region->file);
 				kfree(region);
 				pr_info("%s: type %d, vaddr  0x%p\n",
@@ -603,6 +633,7 @@ static int __msm_pmem_table_del(struct msm_sync *sync,
 					pinfo->vaddr == region->info.vaddr &&
 					pinfo->fd == region->info.fd) {
 				hlist_del(node);
+				hlist_del(&region->hash);
 				put_pmem_file(region->file);
 				kfree(region);
 				pr_info("%s: type %d, vaddr  0x%p\n",
@@ -1683,7 +1714,8 @@ static int __msm_register_pmem(struct msm_sync *sync,
 	case MSM_PMEM_MAINIMG:
 	case MSM_PMEM_RAW_MAINIMG:
 	case MSM_PMEM_VIDEO_VPE:
-		rc = msm_pmem_table_add(&sync->pmem_frames, pinfo,
+		rc = msm_pmem_table_add(&sync->pmem_frames,
+			sync->pmem_frame_hash, 1, pinfo,
 			&sync->pmem_frame_spinlock);
 		break;
 
@@ -1696,8 +1728,9 @@ static int __msm_register_pmem(struct msm_sync *sync,
 	case MSM_PMEM_IHIST:
 	case MSM_PMEM_SKIN:
 
-		rc = msm_pmem_table_add(&sync->pmem_stats, pinfo,
-			 &sync->pmem_stats_spinlock);
+		rc = msm_pmem_table_add(&sync->pmem_stats,
+			sync->pmem_stats_hash, 0, pinfo,
+			&sync->pmem_stats_spinlock);
 		break;
 
 	default:
@@ -1827,6 +1860,102 @@ put_done:
 	return rc;
 }
 
+static int msm_stats_release_cmd(int type)
+{
+	switch (type) {
+	case VFE_MSG_STATS_WE:
+		return CMD_STATS_BUF_RELEASE;
+	case VFE_MSG_STATS_AF:
+		return CMD_STATS_AF_BUF_RELEASE;
+	case VFE_MSG_STATS_AEC:
+		return CMD_STATS_AEC_BUF_RELEASE;
+	case VFE_MSG_STATS_AWB:
+		return CMD_STATS_AWB_BUF_RELEASE;
+	case VFE_MSG_STATS_IHIST:
+		return CMD_STATS_IHIST_BUF_RELEASE;
+	case VFE_MSG_STATS_RS:
+		return CMD_STATS_RS_BUF_RELEASE;
+	case VFE_MSG_STATS_CS:
+		return CMD_STATS_CS_BUF_RELEASE;
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * Give the buffers of the dropped stats back to the VFE. These were never
+ * looked up by the config thread, so their pmem regions are still marked
+ * active.
+ */
+static void msm_stats_drop_work(struct work_struct *work)
+{
+	struct msm_sync *sync =
+		container_of(work, struct msm_sync, stats_drop_work);
+	struct msm_queue_cmd *qcmd;
+	struct msm_vfe_resp *data;
+	struct msm_vfe_cfg_cmd cfgcmd;
+	unsigned long pphy;
+	int rc;
+
+	mutex_lock(&sync->lock);
+	while ((qcmd = msm_dequeue(&sync->stats_drop_q, list_config))) {
+		data = (struct msm_vfe_resp *)(qcmd->command);
+		if (sync->core_powered_on && sync->vfefn.vfe_config) {
+			cfgcmd.cmd_type = msm_stats_release_cmd(data->type);
+			cfgcmd.length = 0;
+			cfgcmd.value = NULL;
+			pphy = data->phy.sbuf_phy;
+			rc = sync->vfefn.vfe_config(&cfgcmd, &pphy);
+			if (rc < 0)
+				pr_err("%s: vfe_config error %d\n",
+					__func__, rc);
+		}
+		free_qcmd(qcmd);
+	}
+	mutex_unlock(&sync->lock);
+}
+
+/*
+ * Called from the DSP callback before a stats message is queued. When the
+ * config thread is behind, drop the oldest pending stats of the same type
+ * so the VFE doesn't run out of stats buffers.
+ */
+static void msm_stats_drop_stale(struct msm_sync *sync, int type)
+{
+	struct msm_device_queue *queue = &sync->event_q;
+	struct msm_queue_cmd *qcmd, *oldest = NULL;
+	struct msm_vfe_resp *data;
+	unsigned long flags;
+	int count = 0;
+
+	if (msm_stats_queue_max <= 0)
+		return;
+
+	spin_lock_irqsave(&queue->lock, flags);
+	list_for_each_entry(qcmd, &queue->list, list_config) {
+		if (qcmd->type != MSM_CAM_Q_VFE_MSG)
+			continue;
+		data = (struct msm_vfe_resp *)(qcmd->command);
+		if (!data || data->type != type)
+			continue;
+		if (!oldest)
+			oldest = qcmd;
+		count++;
+	}
+	if (count >= msm_stats_queue_max) {
+		list_del_init(&oldest->list_config);
+		queue->len--;
+	} else
+		oldest = NULL;
+	spin_unlock_irqrestore(&queue->lock, flags);
+
+	if (oldest) {
+		msm_stats_dropped++;
+		msm_enqueue(&sync->stats_drop_q, &oldest->list_config);
+		schedule_work(&sync->stats_drop_work);
+	}
+}
+
 static int msm_axi_config(struct msm_sync *sync, void __user *arg)
 {
 	struct msm_vfe_cfg_cmd cfgcmd;
@@ -2443,6 +2572,7 @@ static int __msm_release(struct msm_sync *sync)
 		hlist_for_each_entry_safe(region, hnode, n,
 				&sync->pmem_frames, list) {
 			hlist_del(hnode);
+			hlist_del(&region->hash);
 			put_pmem_file(region->file);
 			kfree(region);
 		}
@@ -2450,11 +2580,13 @@ static int __msm_release(struct msm_sync *sync)
 		hlist_for_each_entry_safe(region, hnode, n,
 				&sync->pmem_stats, list) {
 			hlist_del(hnode);
+			hlist_del(&region->hash);
 			put_pmem_file(region->file);
 			kfree(region);
 		}
 		msm_queue_drain(&sync->pict_q, list_pict);
 		msm_queue_drain(&sync->event_q, list_config);
+		msm_queue_drain(&sync->stats_drop_q, list_config);
 
 		wake_unlock(&sync->wake_lock);
 		sync->apps_id = NULL;
@@ -2835,6 +2967,9 @@ static void msm_vfe_sync(struct msm_vfe_resp *vdata,
 		/* fall through, send to config. */
 	}
 
+	if (msm_stats_release_cmd(vdata->type) >= 0)
+		msm_stats_drop_stale(sync, vdata->type);
+
 vfe_for_config:
 	CDBG("%s: msm_enqueue event_q\n", __func__);
 	if (sync->frame_q.len <= 100 && sync->event_q.len <= 100) {
@@ -3216,6 +3351,8 @@ static int msm_sync_init(struct msm_sync *sync,
 	msm_queue_init(&sync->frame_q, "frame");
 	msm_queue_init(&sync->pict_q, "pict");
 	msm_queue_init(&sync->vpe_q, "vpe");
+	msm_queue_init(&sync->stats_drop_q, "stats_drop");
+	INIT_WORK(&sync->stats_drop_work, msm_stats_drop_work);
 
 	wake_lock_init(&sync->wake_lock, WAKE_LOCK_IDLE, "msm_camera");
 
@@ -3361,6 +3498,8 @@ int msm_camera_drv_start(struct platform_device *dev,
 	camera_node++;
 
 	list_add(&sync->list, &msm_sensors);
+	/* Sensors are powered up on open, resume has nothing to wait for */
+	device_enable_async_suspend(&dev->dev);
 	return rc;
 }
 EXPORT_SYMBOL(msm_camera_drv_start);
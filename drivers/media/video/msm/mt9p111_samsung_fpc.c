@@ -3001,7 +3001,7 @@ static int32_t mt9p111_probe_workqueue(void)
 {
     int32_t rc;
 
-    mt9p111_wq = create_singlethread_workqueue("mt9p111_wq");
+    mt9p111_wq = create_shared_workqueue("mt9p111_wq");
 
     if (!mt9p111_wq)
     {
@@ -3064,5 +3064,5 @@ static int __init mt9p111_init(void)
     return platform_driver_register(&msm_camera_driver);
 }
 
-module_init(mt9p111_init);
+parallel_initcall(mt9p111_init);
 
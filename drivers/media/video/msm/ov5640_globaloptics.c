@@ -4151,7 +4151,7 @@ static int32_t ov5640_probe_workqueue(void)
     int32_t rc;
 
 
-    ov5640_wq = create_singlethread_workqueue("ov5640_wq");
+    ov5640_wq = create_shared_workqueue("ov5640_wq");
 
     if (!ov5640_wq)
     {
@@ -4202,5 +4202,6 @@ static int __init ov5640_init(void)
     return platform_driver_register(&msm_camera_driver);
 }
 
-module_init(ov5640_init);
+/* The sensors share power and reset lines, probe them one at a time */
+parallel_initcall_after(ov5640_init, "ov5642_init");
 
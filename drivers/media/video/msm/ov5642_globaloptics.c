@@ -3584,7 +3584,7 @@ static int32_t ov5642_probe_workqueue(void)
 {
     int32_t rc;
 
-    ov5642_wq = create_singlethread_workqueue("ov5642_wq");
+    ov5642_wq = create_shared_workqueue("ov5642_wq");
 
     if (!ov5642_wq)
     {
@@ -3633,5 +3633,6 @@ static int __init ov5642_init(void)
     return platform_driver_register(&msm_camera_driver);
 }
 
-module_init(ov5642_init);
+/* The sensors share power and reset lines, probe them one at a time */
+parallel_initcall_after(ov5642_init, "mt9p111_init");
 
@@ -37,6 +37,8 @@
 #include <linux/mutex.h>
 #include <linux/workqueue.h>
 #include <linux/preempt.h>
+#include <linux/vmalloc.h>
+#include <linux/lzo.h>
 
 extern void ram_console_enable_console(int);
 
@@ -45,25 +47,45 @@ struct panic_header {
 #define PANIC_MAGIC 0xdeadf00d
 
 	u32 version;
-#define PHDR_VERSION   0x01
+#define PHDR_VERSION   0x02
 
 	u32 console_offset;
 	u32 console_length;
 
 	u32 threads_offset;
 	u32 threads_length;
+
+	/* Version 2: uncompressed size if the threads dump is LZO, else 0 */
+	u32 threads_raw_length;
 };
 
+/* The threads dump is whatever show_state_filter() left in log_buf */
+#define APANIC_THREADS_MAX	(1 << CONFIG_LOG_BUF_SHIFT)
+
 struct apanic_data {
 	struct mtd_info		*mtd;
 	struct panic_header	curr;
 	void			*bounce;
 	struct proc_dir_entry	*apanic_console;
 	struct proc_dir_entry	*apanic_threads;
+
+	/* Previous dump, read in at boot so the partition can be erased */
+	char			*console_buf;
+	char			*threads_buf;
+	size_t			threads_size;
+
+	/* Set once the partition is erased and the next panic may write */
+	int			ready;
+
+	/* Compression buffers, panic time can't allocate */
+	void			*lzo_src;
+	void			*lzo_dst;
+	void			*lzo_wrkmem;
 };
 
 static struct apanic_data drv_ctx;
 static struct work_struct proc_removal_work;
+static struct work_struct erase_work;
 static DEFINE_MUTEX(drv_mutex);
 
 static unsigned int *apanic_bbt;
@@ -143,11 +165,7 @@ static int apanic_proc_read(char *buffer, char **start, off_t offset,
 {
 	struct apanic_data *ctx = &drv_ctx;
 	size_t file_length;
-	off_t file_offset;
-	unsigned int page_no;
-	off_t page_offset;
-	int rc;
-	size_t len;
+	char *file_buf;
 
 	if (!count)
 		return 0;
@@ -157,11 +175,11 @@ static int apanic_proc_read(char *buffer, char **start, off_t offset,
 	switch ((int) dat) {
 	case 1:	/* apanic_console */
 		file_length = ctx->curr.console_length;
-		file_offset = ctx->curr.console_offset;
+		file_buf = ctx->console_buf;
 		break;
 	case 2:	/* apanic_threads */
-		file_length = ctx->curr.threads_length;
-		file_offset = ctx->curr.threads_offset;
+		file_length = ctx->threads_size;
+		file_buf = ctx->threads_buf;
 		break;
 	default:
 		pr_err("Bad dat (%d)\n", (int) dat);
@@ -169,35 +187,17 @@ static int apanic_proc_read(char *buffer, char **start, off_t offset,
 		return -EINVAL;
 	}
 
-	if ((offset + count) > file_length) {
+	if (!file_buf || offset >= file_length) {
+		*peof = 1;
 		mutex_unlock(&drv_mutex);
 		return 0;
 	}
 
-	/* We only support reading a maximum of a flash page */
-	if (count > ctx->mtd->writesize)
-		count = ctx->mtd->writesize;
-
-	page_no = (file_offset + offset) / ctx->mtd->writesize;
-	page_offset = (file_offset + offset) % ctx->mtd->writesize;
+	if (count > file_length - offset)
+		count = file_length - offset;
+	memcpy(buffer, file_buf + offset, count);
 
-
-	if (phy_offset(ctx->mtd, (page_no * ctx->mtd->writesize))
-		== APANIC_INVALID_OFFSET) {
-		pr_err("apanic: reading an invalid address\n");
-		mutex_unlock(&drv_mutex);
-		return -EINVAL;
-	}
-	rc = ctx->mtd->read(ctx->mtd,
-		phy_offset(ctx->mtd, (page_no * ctx->mtd->writesize)),
-		ctx->mtd->writesize,
-		&len, ctx->bounce);
-
-	if (page_offset)
-		count -= page_offset;
-	memcpy(buffer, ctx->bounce + page_offset, count);
-
-	*start = count;
+	*start = (char *) count;
 
 	if ((offset + count) == file_length)
 		*peof = 1;
@@ -266,13 +266,30 @@ out:
 	return;
 }
 
+static void apanic_erase_work(struct work_struct *work)
+{
+	struct apanic_data *ctx = &drv_ctx;
+
+	mutex_lock(&drv_mutex);
+	if (ctx->mtd) {
+		mtd_panic_erase();
+		ctx->ready = 1;
+	}
+	mutex_unlock(&drv_mutex);
+}
+
 static void apanic_remove_proc_work(struct work_struct *work)
 {
 	struct apanic_data *ctx = &drv_ctx;
 
+	/* The partition was erased at boot, only the copy goes */
 	mutex_lock(&drv_mutex);
-	mtd_panic_erase();
 	memset(&ctx->curr, 0, sizeof(struct panic_header));
+	vfree(ctx->console_buf);
+	ctx->console_buf = NULL;
+	vfree(ctx->threads_buf);
+	ctx->threads_buf = NULL;
+	ctx->threads_size = 0;
 	if (ctx->apanic_console) {
 		remove_proc_entry("apanic_console", NULL);
 		ctx->apanic_console = NULL;
@@ -291,6 +308,105 @@ static int apanic_proc_write(struct file *file, const char __user *buffer,
 	return count;
 }
 
+/*
+ * Reads len bytes at logical offset off of the partition. Bad ECC is
+ * ignored, a damaged dump is still worth reading.
+ */
+static int apanic_read(struct mtd_info *mtd, unsigned int off, size_t len,
+		       char *buf)
+{
+	struct apanic_data *ctx = &drv_ctx;
+	unsigned int page_offset;
+	size_t rlen, chunk;
+	int rc;
+
+	while (len) {
+		page_offset = off % mtd->writesize;
+		if (phy_offset(mtd, off - page_offset) == APANIC_INVALID_OFFSET)
+			return -EINVAL;
+		rc = mtd->read(mtd, phy_offset(mtd, off - page_offset),
+			       mtd->writesize, &rlen, ctx->bounce);
+		if (rc && rc != -EUCLEAN && rc != -EBADMSG)
+			return rc;
+
+		chunk = min_t(size_t, len, mtd->writesize - page_offset);
+		memcpy(buf, ctx->bounce + page_offset, chunk);
+		buf += chunk;
+		off += chunk;
+		len -= chunk;
+	}
+	return 0;
+}
+
+/*
+ * Copies the previous dump into memory so the partition can be erased
+ * now rather than at the next panic.
+ */
+static int apanic_load(struct mtd_info *mtd, struct panic_header *hdr)
+{
+	struct apanic_data *ctx = &drv_ctx;
+	char *threads = NULL;
+	size_t raw_len;
+	int rc = -ENOMEM;
+
+	if ((u64) hdr->console_offset + hdr->console_length > mtd->size ||
+	    (u64) hdr->threads_offset + hdr->threads_length > mtd->size ||
+	    hdr->threads_raw_length > APANIC_THREADS_MAX)
+		return -EINVAL;
+
+	if (hdr->console_length) {
+		ctx->console_buf = vmalloc(hdr->console_length);
+		if (!ctx->console_buf)
+			goto out_err;
+		rc = apanic_read(mtd, hdr->console_offset,
+				 hdr->console_length, ctx->console_buf);
+		if (rc)
+			goto out_err;
+	}
+
+	if (hdr->threads_length) {
+		threads = vmalloc(hdr->threads_length);
+		if (!threads)
+			goto out_err;
+		rc = apanic_read(mtd, hdr->threads_offset,
+				 hdr->threads_length, threads);
+		if (rc)
+			goto out_err;
+		ctx->threads_buf = threads;
+		ctx->threads_size = hdr->threads_length;
+		threads = NULL;
+	}
+
+	if (hdr->threads_raw_length && ctx->threads_buf) {
+		rc = -ENOMEM;
+		threads = vmalloc(hdr->threads_raw_length);
+		if (!threads)
+			goto out_err;
+		raw_len = hdr->threads_raw_length;
+		rc = lzo1x_decompress_safe(ctx->threads_buf, ctx->threads_size,
+					   threads, &raw_len);
+		if (rc != LZO_E_OK) {
+			printk(KERN_ERR "apanic: threads dump is corrupt (%d)\n",
+			       rc);
+			rc = -EINVAL;
+			goto out_err;
+		}
+		vfree(ctx->threads_buf);
+		ctx->threads_buf = threads;
+		ctx->threads_size = raw_len;
+	}
+	return 0;
+
+out_err:
+	vfree(threads);
+	vfree(ctx->console_buf);
+	ctx->console_buf = NULL;
+	vfree(ctx->threads_buf);
+	ctx->threads_buf = NULL;
+	ctx->threads_size = 0;
+	return rc;
+}
+
 static void mtd_panic_notify_add(struct mtd_info *mtd)
 {
 	struct apanic_data *ctx = &drv_ctx;
@@ -329,26 +445,50 @@ static void mtd_panic_notify_add(struct mtd_info *mtd)
 
 	printk(KERN_INFO "apanic: Bound to mtd partition '%s'\n", mtd->name);
 
+	/* Panic time compression, the dump goes out uncompressed without */
+	ctx->lzo_src = vmalloc(APANIC_THREADS_MAX);
+	ctx->lzo_dst = vmalloc(lzo1x_worst_compress(APANIC_THREADS_MAX));
+	ctx->lzo_wrkmem = vmalloc(LZO1X_1_MEM_COMPRESS);
+	if (!ctx->lzo_src || !ctx->lzo_dst || !ctx->lzo_wrkmem) {
+		printk(KERN_WARNING "apanic: threads dump won't be compressed\n");
+		vfree(ctx->lzo_src);
+		vfree(ctx->lzo_dst);
+		vfree(ctx->lzo_wrkmem);
+		ctx->lzo_src = ctx->lzo_dst = ctx->lzo_wrkmem = NULL;
+	}
+
 	if (hdr->magic != PANIC_MAGIC) {
 		printk(KERN_INFO "apanic: No panic data available\n");
-		mtd_panic_erase();
+		schedule_work(&erase_work);
 		return;
 	}
 
-	if (hdr->version != PHDR_VERSION) {
+	if (hdr->version == 0x01) {
+		hdr->threads_raw_length = 0;
+	} else if (hdr->version != PHDR_VERSION) {
 		printk(KERN_INFO "apanic: Version mismatch (%d != %d)\n",
 		       hdr->version, PHDR_VERSION);
-		mtd_panic_erase();
+		schedule_work(&erase_work);
 		return;
 	}
 
 	memcpy(&ctx->curr, hdr, sizeof(struct panic_header));
 
-	printk(KERN_INFO "apanic: c(%u, %u) t(%u, %u)\n",
+	printk(KERN_INFO "apanic: c(%u, %u) t(%u, %u, %u)\n",
 	       hdr->console_offset, hdr->console_length,
-	       hdr->threads_offset, hdr->threads_length);
+	       hdr->threads_offset, hdr->threads_length,
+	       hdr->threads_raw_length);
 
-	if (hdr->console_length) {
+	rc = apanic_load(mtd, &ctx->curr);
+	/* Whatever happened, the partition is free for the next panic */
+	schedule_work(&erase_work);
+	if (rc) {
+		printk(KERN_ERR "apanic: Error reading panic data (%d)\n", rc);
+		memset(&ctx->curr, 0, sizeof(struct panic_header));
+		return;
+	}
+
+	if (ctx->curr.console_length) {
 		ctx->apanic_console = create_proc_entry("apanic_console",
 						      S_IFREG | S_IRUGO, NULL);
 		if (!ctx->apanic_console)
@@ -357,13 +497,13 @@ static void mtd_panic_notify_add(struct mtd_info *mtd)
 		else {
 			ctx->apanic_console->read_proc = apanic_proc_read;
 			ctx->apanic_console->write_proc = apanic_proc_write;
-			ctx->apanic_console->size = hdr->console_length;
+			ctx->apanic_console->size = ctx->curr.console_length;
 			ctx->apanic_console->data = (void *) 1;
 			proc_entry_created = 1;
 		}
 	}
 
-	if (hdr->threads_length) {
+	if (ctx->threads_size) {
 		ctx->apanic_threads = create_proc_entry("apanic_threads",
 						       S_IFREG | S_IRUGO, NULL);
 		if (!ctx->apanic_threads)
@@ -372,14 +512,14 @@ static void mtd_panic_notify_add(struct mtd_info *mtd)
 		else {
 			ctx->apanic_threads->read_proc = apanic_proc_read;
 			ctx->apanic_threads->write_proc = apanic_proc_write;
-			ctx->apanic_threads->size = hdr->threads_length;
+			ctx->apanic_threads->size = ctx->threads_size;
 			ctx->apanic_threads->data = (void *) 2;
 			proc_entry_created = 1;
 		}
 	}
 
 	if (!proc_entry_created)
-		mtd_panic_erase();
+		apanic_remove_proc_work(NULL);
 
 	return;
 out_err:
@@ -484,6 +624,74 @@ static int apanic_write_console(struct mtd_info *mtd, unsigned int off)
 	return idx;
 }
 
+/*
+ * Writes len bytes of buf to the specified offset in flash, a page at a
+ * time through the bounce buffer. Returns number of bytes written.
+ */
+static int apanic_write_buf(struct mtd_info *mtd, unsigned int off,
+			    const char *buf, size_t len)
+{
+	struct apanic_data *ctx = &drv_ctx;
+	size_t chunk, done = 0;
+	int rc;
+
+	while (done < len) {
+		chunk = min_t(size_t, len - done, mtd->writesize);
+		memcpy(ctx->bounce, buf + done, chunk);
+		if (chunk != mtd->writesize)
+			memset(ctx->bounce + chunk, 0, mtd->writesize - chunk);
+
+		rc = apanic_writeflashpage(mtd, off, ctx->bounce);
+		if (rc <= 0) {
+			printk(KERN_EMERG
+			       "apanic: Flash write failed (%d)\n", rc);
+			break;
+		}
+		done += chunk;
+		off += rc;
+	}
+	return done;
+}
+
+/*
+ * Writes what is in the log buffer, LZO-compressed if the buffers could be
+ * allocated. Returns number of bytes written, *raw_len gets the
+ * uncompressed size or 0.
+ */
+static int apanic_write_threads(struct mtd_info *mtd, unsigned int off,
+				u32 *raw_len)
+{
+	struct apanic_data *ctx = &drv_ctx;
+	size_t dst_len;
+	int saved_oip;
+	int len, rc;
+
+	*raw_len = 0;
+	if (!ctx->lzo_wrkmem)
+		return apanic_write_console(mtd, off);
+
+	saved_oip = oops_in_progress;
+	oops_in_progress = 1;
+	len = log_buf_copy(ctx->lzo_src, 0, APANIC_THREADS_MAX);
+	oops_in_progress = saved_oip;
+	if (len <= 0)
+		return 0;
+
+	rc = lzo1x_1_compress(ctx->lzo_src, len, ctx->lzo_dst, &dst_len,
+			      ctx->lzo_wrkmem);
+	if (rc != LZO_E_OK) {
+		printk(KERN_EMERG "apanic: compression failed (%d)\n", rc);
+		return apanic_write_console(mtd, off);
+	}
+
+	rc = apanic_write_buf(mtd, off, ctx->lzo_dst, dst_len);
+	if (rc == dst_len)
+		*raw_len = len;
+	else
+		rc = 0;	/* a truncated LZO stream is no use */
+	return rc;
+}
+
 static int apanic(struct notifier_block *this, unsigned long event,
 			void *ptr)
 {
@@ -493,6 +701,7 @@ static int apanic(struct notifier_block *this, unsigned long event,
 	int console_len = 0;
 	int threads_offset = 0;
 	int threads_len = 0;
+	u32 threads_raw_len = 0;
 	int rc;
 
 	if (in_panic)
@@ -507,10 +716,12 @@ static int apanic(struct notifier_block *this, unsigned long event,
 	if (!ctx->mtd)
 		goto out;
 
-	if (ctx->curr.magic) {
-		printk(KERN_EMERG "Crash partition in use!\n");
+	if (!ctx->ready) {
+		printk(KERN_EMERG "apanic: Crash partition not erased yet!\n");
 		goto out;
 	}
+	/* NAND pages can't be rewritten until the next erase */
+	ctx->ready = 0;
 	console_offset = ctx->mtd->writesize;
 
 	/*
@@ -535,7 +746,8 @@ static int apanic(struct notifier_block *this, unsigned long event,
 
 	log_buf_clear();
 	show_state_filter(0);
-	threads_len = apanic_write_console(ctx->mtd, threads_offset);
+	threads_len = apanic_write_threads(ctx->mtd, threads_offset,
+					   &threads_raw_len);
 	if (threads_len < 0) {
 		printk(KERN_EMERG "Error writing threads to panic log! (%d)\n",
 		       threads_len);
@@ -554,6 +766,7 @@ static int apanic(struct notifier_block *this, unsigned long event,
 
 	hdr->threads_offset = threads_offset;
 	hdr->threads_length = threads_len;
+	hdr->threads_raw_length = threads_raw_len;
 
 	rc = apanic_writeflashpage(ctx->mtd, 0, ctx->bounce);
 	if (rc <= 0) {
@@ -598,6 +811,7 @@ int __init apanic_init(void)
 	memset(&drv_ctx, 0, sizeof(drv_ctx));
 	drv_ctx.bounce = (void *) __get_free_page(GFP_KERNEL);
 	INIT_WORK(&proc_removal_work, apanic_remove_proc_work);
+	INIT_WORK(&erase_work, apanic_erase_work);
 	printk(KERN_INFO "Android kernel panic handler initialized (bind=%s)\n",
 	       CONFIG_APANIC_PLABEL);
 	return 0;
@@ -24,6 +24,9 @@
 #include <linux/android_pmem.h>
 #include <linux/mempolicy.h>
 #include <linux/kobject.h>
+#include <linux/workqueue.h>
+#include <linux/spinlock.h>
+#include <linux/log2.h>
 #ifdef CONFIG_MEMORY_HOTPLUG
 #include <linux/memory.h>
 #include <linux/memory_hotplug.h>
@@ -95,6 +98,17 @@ struct pmem_data {
 	struct list_head region_list;
 	/* a linked list of data so we can access them for debugging */
 	struct list_head list;
+	/* set once the physical address has been handed out (or another
+	 * file connected to us); the allocation may then never be moved by
+	 * compaction */
+	int pinned;
+	/* PMEM_MAP_* attributes chosen at allocation time */
+	unsigned int map_attr;
+	/* for PMEM_MAP_DIRTY_TRACK: byte range written since the last
+	 * flush, empty when dirty_start == dirty_end */
+	spinlock_t dirty_lock;
+	unsigned long dirty_start;
+	unsigned long dirty_end;
 #if PMEM_DEBUG
 	int ref;
 #endif
@@ -105,6 +119,13 @@ struct pmem_bits {
 	unsigned order:7;		/* size of the region in pmem space */
 };
 
+/* one node of the bitmap allocator's free-run tree, counts are in quanta */
+struct pmem_bitmap_summary {
+	unsigned int head;	/* free run starting at the lowest bit */
+	unsigned int tail;	/* free run ending at the highest bit */
+	unsigned int run;	/* longest free run anywhere below */
+};
+
 struct pmem_region_node {
 	struct pmem_region region;
 	struct list_head list;
@@ -208,6 +229,10 @@ struct pmem_info {
 			unsigned int bitmap_free; /* # of zero bits/quanta */
 			uint32_t *bitmap;
 			int32_t bitmap_allocs;
+			/* free-run tree over the bitmap words, see
+			 * bitmap_summary_update() */
+			struct pmem_bitmap_summary *summary;
+			int summary_leaves;
 			struct {
 				short bit;
 				unsigned short quanta;
@@ -237,6 +262,12 @@ struct pmem_info {
 
 	long (*ioctl)(struct file *, unsigned int, unsigned long);
 	int (*release)(struct inode *, struct file *);
+
+	/* buddy allocator compaction: when auto_compact is set, a failed
+	 * allocation queues compact_work to defragment the arena */
+	struct work_struct compact_work;
+	unsigned auto_compact;
+	unsigned long compact_moves;
 };
 #define to_pmem_info_id(a) (container_of(a, struct pmem_info, kobj)->id)
 
@@ -478,9 +509,62 @@ static ssize_t show_pmem_buddy_bitmap_dump(int id, char *buf)
 }
 RO_PMEM_ATTR(buddy_bitmap_dump);
 
+/*
+ * fragmentation index: how much of the free space is unusable for an
+ * allocation of the largest free size, 0 (one free run) .. 100.
+ */
+static ssize_t show_pmem_fragmentation(int id, char *buf)
+{
+	struct pmem_freespace fs;
+	unsigned long frag = 0;
+
+	mutex_lock(&pmem[id].arena_mutex);
+	pmem[id].free_space(id, &fs);
+	mutex_unlock(&pmem[id].arena_mutex);
+
+	if (fs.total)
+		frag = 100 - (fs.largest * 100) / fs.total;
+
+	return scnprintf(buf, PAGE_SIZE, "%lu (free %lu, largest %lu)\n",
+		frag, fs.total, fs.largest);
+}
+RO_PMEM_ATTR(fragmentation);
+
+static void pmem_compact_buddy(int id);
+
+static ssize_t show_pmem_compact(int id, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%lu\n", pmem[id].compact_moves);
+}
+
+static ssize_t store_pmem_compact(int id, const char *buf, size_t count)
+{
+	pmem_compact_buddy(id);
+	return count;
+}
+RW_PMEM_ATTR(compact);
+
+static ssize_t show_pmem_auto_compact(int id, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%u\n", pmem[id].auto_compact);
+}
+
+static ssize_t store_pmem_auto_compact(int id, const char *buf,
+				       size_t count)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val))
+		return -EINVAL;
+	pmem[id].auto_compact = !!val;
+	return count;
+}
+RW_PMEM_ATTR(auto_compact);
+
 #define PMEM_BITMAP_BUDDY_BESTFIT_COMMON_SYSFS_ATTRS \
 	&pmem_attr_quantum_size.attr, \
-	&pmem_attr_total_entries.attr
+	&pmem_attr_total_entries.attr, \
+	&pmem_attr_fragmentation.attr
 
 static struct attribute *pmem_buddy_bestfit_attrs[] = {
 	PMEM_COMMON_SYSFS_ATTRS,
@@ -488,6 +572,8 @@ static struct attribute *pmem_buddy_bestfit_attrs[] = {
 	PMEM_BITMAP_BUDDY_BESTFIT_COMMON_SYSFS_ATTRS,
 
 	&pmem_attr_buddy_bitmap_dump.attr,
+	&pmem_attr_compact.attr,
+	&pmem_attr_auto_compact.attr,
 
 	NULL
 };
@@ -704,6 +790,117 @@ static inline int compute_total_words(int bit_end, int word_index)
 			PMEM_32BIT_WORD_ORDER) - word_index;
 }
 
+/* free quanta of bitmap word @word, bits past num_entries read as used */
+static uint32_t bitmap_summary_free_bits(int id, int word)
+{
+	int last_word = (pmem[id].num_entries - 1) >> PMEM_32BIT_WORD_ORDER;
+	uint32_t free;
+
+	if (word > last_word)
+		return 0;
+	free = ~pmem[id].allocator.bitmap.bitmap[word];
+	if (word == last_word)
+		free &= end_mask(pmem[id].num_entries);
+	return free;
+}
+
+static void bitmap_summary_leaf(int id, int word)
+{
+	struct pmem_bitmap_summary *s = &pmem[id].allocator.bitmap.summary[
+		pmem[id].allocator.bitmap.summary_leaves + word];
+	uint32_t free = bitmap_summary_free_bits(id, word);
+	unsigned int bit, cur = 0;
+
+	if (free == ~0U) {
+		s->head = s->tail = s->run = 32;
+		return;
+	}
+	s->head = __ffs(~free);
+	s->tail = 31 - __fls(~free);
+	s->run = 0;
+	for (bit = 0; bit < 32; bit++) {
+		if (!(free & (1U << bit)))
+			cur = 0;
+		else if (++cur > s->run)
+			s->run = cur;
+	}
+}
+
+static void bitmap_summary_node(int id, int node, unsigned int half)
+{
+	struct pmem_bitmap_summary *s = pmem[id].allocator.bitmap.summary;
+	struct pmem_bitmap_summary *l = &s[2 * node], *r = &s[2 * node + 1];
+
+	s[node].head = l->head == half ? half + r->head : l->head;
+	s[node].tail = r->tail == half ? half + l->tail : r->tail;
+	s[node].run = max(max(l->run, r->run), l->tail + r->head);
+}
+
+/*
+ * Refresh the free-run tree after bits [bit_start, bit_end) of the bitmap
+ * changed.  Leaf i of the tree summarises bitmap word i; every inner node
+ * holds the longest free run below it plus the free runs touching its low
+ * (head) and high (tail) edges, so a run spanning both children is
+ * left->tail + right->head.  The cost is the number of words touched plus
+ * the height of the tree.  Caller holds arena_mutex.
+ */
+static void bitmap_summary_update(int id, int bit_start, int bit_end)
+{
+	int leaves = pmem[id].allocator.bitmap.summary_leaves;
+	int lo = bit_start >> PMEM_32BIT_WORD_ORDER;
+	int hi = (bit_end - 1) >> PMEM_32BIT_WORD_ORDER;
+	unsigned int half = 32;
+	int n;
+
+	if (!pmem[id].allocator.bitmap.summary || bit_end <= bit_start)
+		return;
+
+	for (n = lo; n <= hi; n++)
+		bitmap_summary_leaf(id, n);
+
+	for (lo += leaves, hi += leaves; lo > 1; half <<= 1) {
+		lo >>= 1;
+		hi >>= 1;
+		for (n = lo; n <= hi; n++)
+			bitmap_summary_node(id, n, half);
+	}
+}
+
+/* lowest bit starting a run of @quanta free bits, or -1 */
+static int bitmap_summary_find(int id, unsigned int quanta)
+{
+	struct pmem_bitmap_summary *s = pmem[id].allocator.bitmap.summary;
+	int leaves = pmem[id].allocator.bitmap.summary_leaves;
+	unsigned int half = leaves << (PMEM_32BIT_WORD_ORDER - 1);
+	unsigned int bit, cur = 0;
+	uint32_t free;
+	int node = 1, base = 0;
+
+	if (!quanta || s[1].run < quanta)
+		return -1;
+
+	for (; node < leaves; half >>= 1) {
+		if (s[2 * node].run >= quanta) {
+			node = 2 * node;
+		} else if (s[2 * node].tail + s[2 * node + 1].head >= quanta) {
+			return base + half - s[2 * node].tail;
+		} else {
+			node = 2 * node + 1;
+			base += half;
+		}
+	}
+
+	/* the run lies within a single word */
+	free = bitmap_summary_free_bits(id, node - leaves);
+	for (bit = 0; bit < 32; bit++) {
+		if (!(free & (1U << bit)))
+			cur = 0;
+		else if (++cur == quanta)
+			return base + bit + 1 - quanta;
+	}
+	return -1;
+}
+
 static void bitmap_bits_clear_all(uint32_t *bitp, int bit_start, int bit_end)
 {
 	int word_index = bit_start >> PMEM_32BIT_WORD_ORDER, total_words;
@@ -747,6 +944,8 @@ static int pmem_free_bitmap(int id, int bitnum)
 
 			bitmap_bits_clear_all(pmem[id].allocator.bitmap.bitmap,
 				curr_bit, curr_bit + curr_quanta);
+			bitmap_summary_update(id, curr_bit,
+				curr_bit + curr_quanta);
 			pmem[id].allocator.bitmap.bitmap_free += curr_quanta;
 			pmem[id].allocator.bitmap.bitm_alloc[i].bit = -1;
 			pmem[id].allocator.bitmap.bitm_alloc[i].quanta = 0;
@@ -783,48 +982,10 @@ static int pmem_free_system(int id, int index)
 
 static int pmem_free_space_bitmap(int id, struct pmem_freespace *fs)
 {
-	int i, j;
-	int max_allocs = pmem[id].allocator.bitmap.bitmap_allocs;
-	int alloc_start = 0;
-	int next_alloc;
-	unsigned long size = 0;
-
-	fs->total = 0;
-	fs->largest = 0;
-
-	for (i = 0; i < max_allocs; i++) {
-
-		int alloc_quanta = 0;
-		int alloc_idx = 0;
-		next_alloc = pmem[id].num_entries;
-
-		/* Look for the lowest bit where next allocation starts */
-		for (j = 0; j < max_allocs; j++) {
-			const int curr_alloc = pmem[id].allocator.
-						bitmap.bitm_alloc[j].bit;
-			if (curr_alloc != -1) {
-				if (alloc_start == curr_alloc)
-					alloc_idx = j;
-				if (alloc_start >= curr_alloc)
-					continue;
-				if (curr_alloc < next_alloc)
-					next_alloc = curr_alloc;
-			}
-		}
-		alloc_quanta = pmem[id].allocator.bitmap.
-				bitm_alloc[alloc_idx].quanta;
-		size = (next_alloc - (alloc_start + alloc_quanta)) *
-				pmem[id].quantum;
-
-		if (size > fs->largest)
-			fs->largest = size;
-		fs->total += size;
-
-		if (next_alloc == pmem[id].num_entries)
-			break;
-		else
-			alloc_start = next_alloc;
-	}
+	fs->total = (unsigned long)pmem[id].allocator.bitmap.bitmap_free *
+			pmem[id].quantum;
+	fs->largest = (unsigned long)pmem[id].allocator.bitmap.summary[1].run *
+			pmem[id].quantum;
 
 	return 0;
 }
@@ -933,6 +1094,10 @@ static int pmem_open(struct inode *inode, struct file *file)
 	data->vma = NULL;
 	data->pid = 0;
 	data->master_file = NULL;
+	data->pinned = 0;
+	data->map_attr = PMEM_MAP_DEFAULT;
+	spin_lock_init(&data->dirty_lock);
+	data->dirty_start = data->dirty_end = 0;
 #if PMEM_DEBUG
 	data->ref = 0;
 #endif
@@ -1017,6 +1182,9 @@ static int pmem_allocator_buddy_bestfit(const int id,
 		printk(KERN_ALERT "pmem: %s: no space left to allocate!\n",
 			__func__);
 #endif
+		/* defragment in the background so a retry can succeed */
+		if (pmem[id].auto_compact)
+			schedule_work(&pmem[id].compact_work);
 		goto out;
 	}
 
@@ -1036,6 +1204,128 @@ out:
 }
 
 
+/*
+ * pmem_buddy_find_hole - find a free block of exactly @order, other than
+ * @avoid, whose buddy is not free at the same order: a hole that can't
+ * merge on its own and is the best place to move an allocation into.
+ *
+ * caller should hold the lock on arena_mutex!
+ */
+static int pmem_buddy_find_hole(int id, int order, int avoid)
+{
+	int curr, buddy;
+
+	for (curr = 0; curr < pmem[id].num_entries;
+	     curr = PMEM_BUDDY_NEXT_INDEX(id, curr)) {
+		if (curr == avoid || !PMEM_IS_FREE_BUDDY(id, curr) ||
+		    PMEM_BUDDY_ORDER(id, curr) != order)
+			continue;
+		buddy = PMEM_BUDDY_INDEX(id, curr);
+		if (buddy < pmem[id].num_entries &&
+		    PMEM_IS_FREE_BUDDY(id, buddy) &&
+		    PMEM_BUDDY_ORDER(id, buddy) == order)
+			continue;
+		return curr;
+	}
+	return -1;
+}
+
+/*
+ * An allocation can be moved only if nothing outside this driver can
+ * know where it lives: it has never been mmaped, connected or
+ * submapped, and its physical address was never handed out.
+ */
+static int pmem_data_movable(struct pmem_data *data)
+{
+	return data->index != -1 && !data->pinned && !data->vma &&
+		!(data->flags & (PMEM_FLAGS_CONNECTED | PMEM_FLAGS_MASTERMAP |
+				 PMEM_FLAGS_SUBMAP | PMEM_FLAGS_UNSUBMAP)) &&
+		list_empty(&data->region_list);
+}
+
+/*
+ * pmem_buddy_move - relocate @data if freeing its block would let it
+ * merge with its buddy.  Caller holds data->sem for writing and
+ * arena_mutex.  Returns 1 if the allocation moved.
+ */
+static int pmem_buddy_move(int id, struct pmem_data *data)
+{
+	int src = data->index, order, buddy, dst;
+	unsigned long len;
+	void *vsrc, *vdst;
+
+	order = PMEM_BUDDY_ORDER(id, src);
+	buddy = PMEM_BUDDY_INDEX(id, src);
+	if (buddy >= pmem[id].num_entries || !PMEM_IS_FREE_BUDDY(id, buddy) ||
+	    PMEM_BUDDY_ORDER(id, buddy) != order)
+		return 0;
+
+	dst = pmem_buddy_find_hole(id, order, buddy);
+	if (dst < 0)
+		return 0;
+
+	len = PMEM_BUDDY_LEN(id, src);
+	vsrc = pmem[id].vbase + PMEM_OFFSET(src);
+	vdst = pmem[id].vbase + PMEM_OFFSET(dst);
+
+	pmem[id].allocator.buddy_bestfit.buddy_bitmap[dst].allocated = 1;
+	memcpy(vdst, vsrc, len);
+	if (pmem[id].cached) {
+		dmac_flush_range(vdst, vdst + len);
+#ifdef CONFIG_OUTER_CACHE
+		outer_flush_range(PMEM_START_ADDR(id, dst),
+				  PMEM_START_ADDR(id, dst) + len);
+#endif
+	}
+	data->index = dst;
+	pmem_free_buddy_bestfit(id, src);
+	pmem[id].compact_moves++;
+
+	DLOG("compact: moved index %d to %d (order %d)\n", src, dst, order);
+	return 1;
+}
+
+/*
+ * pmem_compact_buddy - one compaction pass over a buddy arena, moving
+ * every movable allocation whose buddy is free into a hole that cannot
+ * merge, until nothing more moves.  Files that are busy are skipped.
+ */
+static void pmem_compact_buddy(int id)
+{
+	struct pmem_data *data;
+	int moved, passes = 0;
+
+	if (pmem[id].allocator_type != PMEM_ALLOCATORTYPE_BUDDYBESTFIT ||
+	    !pmem[id].vbase)
+		return;
+
+	mutex_lock(&pmem[id].data_list_mutex);
+	do {
+		moved = 0;
+		list_for_each_entry(data, &pmem[id].data_list, list) {
+			/* lock order is data->sem => arena_mutex, so only
+			 * try for the semaphore */
+			if (!down_write_trylock(&data->sem))
+				continue;
+			if (pmem_data_movable(data)) {
+				mutex_lock(&pmem[id].arena_mutex);
+				moved += pmem_buddy_move(id, data);
+				mutex_unlock(&pmem[id].arena_mutex);
+			}
+			up_write(&data->sem);
+		}
+	} while (moved && ++passes < PMEM_MAX_ORDER);
+	mutex_unlock(&pmem[id].data_list_mutex);
+}
+
+static void pmem_compact_work(struct work_struct *work)
+{
+	struct pmem_info *info = container_of(work, struct pmem_info,
+					      compact_work);
+
+	pmem_compact_buddy(info->id);
+}
+
 static inline unsigned long paddr_from_bit(const int id, const int bitnum)
 {
 	return pmem[id].base + pmem[id].quantum * bitnum;
@@ -1159,11 +1449,29 @@ static int reserve_quanta(const unsigned int quanta_needed,
 	spacing = align / pmem[id].quantum;
 	spacing = spacing > 1 ? spacing : 1;
 
-	ret = bitmap_allocate_contiguous(pmem[id].allocator.bitmap.bitmap,
-		quanta_needed,
-		(pmem[id].size + pmem[id].quantum - 1) / pmem[id].quantum,
-		spacing,
-		start_bit);
+	/*
+	 * Unaligned requests take the lowest fitting run straight from the
+	 * free-run tree; aligned ones still scan, but only once the tree
+	 * says a long enough run exists at all.
+	 */
+	if (pmem[id].allocator.bitmap.summary[1].run < quanta_needed)
+		ret = -1;
+	else if (spacing == 1 && start_bit == 0) {
+		ret = bitmap_summary_find(id, quanta_needed);
+		if (ret >= 0)
+			bitmap_bits_set_all(pmem[id].allocator.bitmap.bitmap,
+				ret, ret + quanta_needed);
+	} else
+		ret = bitmap_allocate_contiguous(
+			pmem[id].allocator.bitmap.bitmap,
+			quanta_needed,
+			(pmem[id].size + pmem[id].quantum - 1) /
+				pmem[id].quantum,
+			spacing,
+			start_bit);
+
+	if (ret >= 0)
+		bitmap_summary_update(id, ret, ret + quanta_needed);
 
 #if PMEM_DEBUG
 	if (ret < 0)
@@ -1336,6 +1644,18 @@ static int pmem_allocator_system(const int id,
 static pgprot_t phys_mem_access_prot(struct file *file, pgprot_t vma_prot)
 {
 	int id = get_id(file);
+	struct pmem_data *data = file->private_data;
+
+	switch (data->map_attr & PMEM_MAP_MASK) {
+	case PMEM_MAP_CACHED:
+		return vma_prot;
+	case PMEM_MAP_UNCACHED:
+		return pgprot_noncached(vma_prot);
+#ifdef pgprot_writecombine
+	case PMEM_MAP_WRITECOMBINE:
+		return pgprot_writecombine(vma_prot);
+#endif
+	}
 #ifdef pgprot_writecombine
 	if (pmem[id].cached == 0 || file->f_flags & O_SYNC)
 		/* on ARMv6 and ARMv7 this expands to Normal Noncached */
@@ -1716,6 +2036,7 @@ int get_pmem_addr(struct file *file, unsigned long *start,
 		if (has_allocation(file)) {
 			int id = get_id(file);
 
+			data->pinned = 1;
 			*start = pmem[id].start_addr(id, data);
 			*len = pmem[id].len(id, data);
 			*vstart = (unsigned long)
@@ -1850,8 +2171,35 @@ void flush_pmem_file(struct file *file, unsigned long offset, unsigned long len)
 	if (!has_allocation(file))
 		goto end;
 
+	/* nothing of this allocation can be in the cache */
+	if ((data->map_attr & PMEM_MAP_MASK) == PMEM_MAP_WRITECOMBINE ||
+	    (data->map_attr & PMEM_MAP_MASK) == PMEM_MAP_UNCACHED)
+		goto end;
+
 	vaddr = pmem_start_vaddr(id, data);
 
+	/* only clean what the client told us it wrote */
+	if ((data->map_attr & PMEM_MAP_DIRTY_TRACK) &&
+	    !(data->flags & PMEM_FLAGS_CONNECTED)) {
+		unsigned long dstart, dend;
+
+		spin_lock(&data->dirty_lock);
+		dstart = data->dirty_start;
+		dend = data->dirty_end;
+		data->dirty_start = data->dirty_end = 0;
+		spin_unlock(&data->dirty_lock);
+
+		if (dstart == dend)
+			goto end;
+		dmac_flush_range(vaddr + dstart, vaddr + dend);
+#ifdef CONFIG_OUTER_CACHE
+		phy_start = pmem[id].start_addr(id, data) + dstart;
+		phy_end = phy_start + (dend - dstart);
+		outer_flush_range(phy_start, phy_end);
+#endif
+		goto end;
+	}
+
 	if (pmem[id].allocator_type == PMEM_ALLOCATORTYPE_SYSTEM) {
 		dmac_flush_range(vaddr,
 			(void *)((unsigned long)vaddr +
@@ -1958,6 +2306,15 @@ int pmem_cache_maint(struct file *file, unsigned int cmd,
 	else if (cmd == PMEM_INV_CACHES)
 		invalidate_caches(vaddr, length, paddr);
 
+	/* a clean over the whole dirty range leaves nothing to flush */
+	if (cmd != PMEM_INV_CACHES) {
+		spin_lock(&data->dirty_lock);
+		if (offset <= data->dirty_start &&
+		    offset + length >= data->dirty_end)
+			data->dirty_start = data->dirty_end = 0;
+		spin_unlock(&data->dirty_lock);
+	}
+
 	return 0;
 }
 EXPORT_SYMBOL(pmem_cache_maint);
@@ -2152,7 +2509,9 @@ static int pmem_connect(unsigned long connect, struct file *file)
 		} else {
 			struct pmem_data *data;
 			int src_index = src_data->index;
+			unsigned int src_attr = src_data->map_attr;
 
+			src_data->pinned = 1;
 			up_read(&src_data->sem);
 
 			data = file->private_data;
@@ -2175,6 +2534,8 @@ static int pmem_connect(unsigned long connect, struct file *file)
 				ret = -EINVAL;
 			} else {
 				data->index = src_index;
+				/* submaps share the master's cacheability */
+				data->map_attr = src_attr & PMEM_MAP_MASK;
 				data->flags |= PMEM_FLAGS_CONNECTED;
 				data->master_fd = connect;
 				data->master_file = src_file;
@@ -2423,6 +2784,98 @@ static void pmem_get_size(struct pmem_region *region, struct file *file)
 }
 
 
+static int pmem_mark_dirty(struct file *file, struct pmem_region *region)
+{
+	struct pmem_data *data = file->private_data;
+	int id = get_id(file);
+	unsigned long len;
+
+	down_read(&data->sem);
+	if (!has_allocation(file) ||
+	    !(data->map_attr & PMEM_MAP_DIRTY_TRACK)) {
+		up_read(&data->sem);
+		return -EINVAL;
+	}
+	len = pmem[id].len(id, data);
+	up_read(&data->sem);
+
+	if (!region->len || region->offset >= len ||
+	    region->len > len - region->offset)
+		return -EINVAL;
+
+	spin_lock(&data->dirty_lock);
+	if (data->dirty_start == data->dirty_end) {
+		data->dirty_start = region->offset;
+		data->dirty_end = region->offset + region->len;
+	} else {
+		data->dirty_start = min(data->dirty_start, region->offset);
+		data->dirty_end = max(data->dirty_end,
+				      region->offset + region->len);
+	}
+	spin_unlock(&data->dirty_lock);
+
+	return 0;
+}
+
+static int pmem_allocate_aligned(struct file *file, unsigned long size,
+				 unsigned int align, unsigned int attr)
+{
+	struct pmem_data *data = file->private_data;
+	int id = get_id(file);
+	int ret;
+
+	DLOG("allocate id align %d %u attr %#x\n", id, align, attr);
+
+	if (align & (align - 1)) {
+		pr_err("pmem: Alignment is not a power of 2\n");
+		return -EINVAL;
+	}
+
+	if (align != SZ_4K &&
+			(pmem[id].allocator_type !=
+				PMEM_ALLOCATORTYPE_BITMAP)) {
+		pr_err("pmem: Non 4k alignment requires bitmap"
+			" allocator on %s\n", pmem[id].name);
+		return -EINVAL;
+	}
+
+	if (align > SZ_1M || align < SZ_4K) {
+		pr_err("pmem: Invalid Alignment (%u) "
+			"specified\n", align);
+		return -EINVAL;
+	}
+
+	if (attr & ~(PMEM_MAP_MASK | PMEM_MAP_DIRTY_TRACK))
+		return -EINVAL;
+
+	/* a cached user mapping of an uncached region would alias the
+	 * kernel's uncached ioremap; dirty tracking needs a cached map */
+	if ((attr & PMEM_MAP_MASK) == PMEM_MAP_CACHED && !pmem[id].cached)
+		return -EINVAL;
+	if ((attr & PMEM_MAP_DIRTY_TRACK) &&
+	    ((attr & PMEM_MAP_MASK) == PMEM_MAP_WRITECOMBINE ||
+	     (attr & PMEM_MAP_MASK) == PMEM_MAP_UNCACHED ||
+	     !pmem[id].cached))
+		return -EINVAL;
+
+	down_write(&data->sem);
+	if (has_allocation(file)) {
+		pr_err("pmem: Existing allocation found on "
+			"this file descrpitor\n");
+		up_write(&data->sem);
+		return -EINVAL;
+	}
+
+	mutex_lock(&pmem[id].arena_mutex);
+	data->index = pmem[id].allocate(id, size, align);
+	mutex_unlock(&pmem[id].arena_mutex);
+	if (data->index != -1)
+		data->map_attr = attr;
+	ret = data->index == -1 ? -ENOMEM : data->index;
+	up_write(&data->sem);
+	return ret;
+}
+
 static long pmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	/* called from user space as file op, so file guaranteed to be not
@@ -2450,6 +2903,7 @@ static long pmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 				region.offset = 0;
 				region.len = 0;
 			} else {
+				data->pinned = 1;
 				region.offset = pmem[id].start_addr(id, data);
 				region.len = pmem[id].len(id, data);
 			}
@@ -2552,49 +3006,31 @@ static long pmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case PMEM_ALLOCATE_ALIGNED:
 		{
 			struct pmem_allocation alloc;
-			int ret = 0;
 
 			if (copy_from_user(&alloc, (void __user *)arg,
 						sizeof(struct pmem_allocation)))
 				return -EFAULT;
-			DLOG("allocate id align %d %u\n", id, alloc.align);
-			down_write(&data->sem);
-			if (has_allocation(file)) {
-				pr_err("pmem: Existing allocation found on "
-					"this file descrpitor\n");
-				up_write(&data->sem);
-				return -EINVAL;
-			}
-
-			if (alloc.align & (alloc.align - 1)) {
-				pr_err("pmem: Alignment is not a power of 2\n");
-				return -EINVAL;
-			}
-
-			if (alloc.align != SZ_4K &&
-					(pmem[id].allocator_type !=
-						PMEM_ALLOCATORTYPE_BITMAP)) {
-				pr_err("pmem: Non 4k alignment requires bitmap"
-					" allocator on %s\n", pmem[id].name);
-				return -EINVAL;
-			}
+			return pmem_allocate_aligned(file, alloc.size,
+					alloc.align, PMEM_MAP_DEFAULT);
+		}
+	case PMEM_ALLOCATE_ATTR:
+		{
+			struct pmem_allocation_attr alloc;
 
-			if (alloc.align > SZ_1M ||
-				alloc.align < SZ_4K) {
-				pr_err("pmem: Invalid Alignment (%u) "
-					"specified\n", alloc.align);
-				return -EINVAL;
-			}
+			if (copy_from_user(&alloc, (void __user *)arg,
+					sizeof(struct pmem_allocation_attr)))
+				return -EFAULT;
+			return pmem_allocate_aligned(file, alloc.size,
+					alloc.align, alloc.attr);
+		}
+	case PMEM_MARK_DIRTY:
+		{
+			struct pmem_region region;
 
-			mutex_lock(&pmem[id].arena_mutex);
-			data->index = pmem[id].allocate(id,
-					alloc.size,
-					alloc.align);
-			mutex_unlock(&pmem[id].arena_mutex);
-			ret = data->index == -1 ? -ENOMEM :
-				data->index;
-			up_write(&data->sem);
-			return ret;
+			if (copy_from_user(&region, (void __user *)arg,
+						sizeof(struct pmem_region)))
+				return -EFAULT;
+			return pmem_mark_dirty(file, &region);
 		}
 	case PMEM_CONNECT:
 		DLOG("connect\n");
@@ -2986,6 +3422,21 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 		}
 		pmem[id].allocator.bitmap.bitmap_free = pmem[id].num_entries;
 
+		pmem[id].allocator.bitmap.summary_leaves = roundup_pow_of_two(
+			(pmem[id].num_entries + 31) / 32);
+		pmem[id].allocator.bitmap.summary =
+			kcalloc(2 * pmem[id].allocator.bitmap.summary_leaves,
+				sizeof(struct pmem_bitmap_summary), GFP_KERNEL);
+		if (!pmem[id].allocator.bitmap.summary) {
+			pr_alert("pmem: %s: Unable to register pmem "
+				"driver - can't allocate bitmap summary!\n",
+				__func__);
+			goto err_cant_register_device;
+		}
+		bitmap_summary_update(id, 0,
+			pmem[id].allocator.bitmap.summary_leaves <<
+				PMEM_32BIT_WORD_ORDER);
+
 		pmem[id].allocate = pmem_allocator_bitmap;
 		pmem[id].free = pmem_free_bitmap;
 		pmem[id].free_space = pmem_free_space_bitmap;
@@ -3039,6 +3490,7 @@ int pmem_setup(struct android_pmem_platform_data *pdata,
 	mutex_init(&pmem[id].arena_mutex);
 	mutex_init(&pmem[id].data_list_mutex);
 	INIT_LIST_HEAD(&pmem[id].data_list);
+	INIT_WORK(&pmem[id].compact_work, pmem_compact_work);
 
 	pmem[id].dev.name = pdata->name;
 	if (!is_kernel_memtype) {
@@ -3083,6 +3535,7 @@ out_put_kobj:
 	if (pmem[id].allocator_type == PMEM_ALLOCATORTYPE_BUDDYBESTFIT)
 		kfree(pmem[id].allocator.buddy_bestfit.buddy_bitmap);
 	else if (pmem[id].allocator_type == PMEM_ALLOCATORTYPE_BITMAP) {
+		kfree(pmem[id].allocator.bitmap.summary);
 		kfree(pmem[id].allocator.bitmap.bitmap);
 		kfree(pmem[id].allocator.bitmap.bitm_alloc);
 	}
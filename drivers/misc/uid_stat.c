@@ -19,36 +19,47 @@
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
+#include <linux/rculist.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/stat.h>
 #include <linux/uid_stat.h>
 #include <net/activity_stats.h>
+#include <net/sock.h>
 
+/*
+ * Entries are never freed, so the list is walked under RCU only and
+ * sockets can keep a pointer to the entry of the uid that last used them.
+ * The counters are per cpu and summed when read.
+ */
 static DEFINE_SPINLOCK(uid_lock);
 static LIST_HEAD(uid_list);
 static struct proc_dir_entry *parent;
 
+struct uid_stat_cpu {
+	unsigned int tcp_rcv;
+	unsigned int tcp_snd;
+};
+
 struct uid_stat {
 	struct list_head link;
 	uid_t uid;
-	atomic_t tcp_rcv;
-	atomic_t tcp_snd;
+	struct uid_stat_cpu __percpu *cpu;
 };
 
 static struct uid_stat *find_uid_stat(uid_t uid) {
-	unsigned long flags;
 	struct uid_stat *entry;
 
-	spin_lock_irqsave(&uid_lock, flags);
-	list_for_each_entry(entry, &uid_list, link) {
+	rcu_read_lock();
+	list_for_each_entry_rcu(entry, &uid_list, link) {
 		if (entry->uid == uid) {
-			spin_unlock_irqrestore(&uid_lock, flags);
+			rcu_read_unlock();
 			return entry;
 		}
 	}
-	spin_unlock_irqrestore(&uid_lock, flags);
+	rcu_read_unlock();
 	return NULL;
 }
 
@@ -59,10 +70,13 @@ static int tcp_snd_read_proc(char *page, char **start, off_t off,
 	unsigned int bytes;
 	char *p = page;
 	struct uid_stat *uid_entry = (struct uid_stat *) data;
+	int cpu;
 	if (!data)
 		return 0;
 
-	bytes = (unsigned int) (atomic_read(&uid_entry->tcp_snd) + INT_MIN);
+	bytes = 0;
+	for_each_possible_cpu(cpu)
+		bytes += per_cpu_ptr(uid_entry->cpu, cpu)->tcp_snd;
 	p += sprintf(p, "%u\n", bytes);
 	len = (p - page) - off;
 	*eof = (len <= count) ? 1 : 0;
@@ -77,10 +91,13 @@ static int tcp_rcv_read_proc(char *page, char **start, off_t off,
 	unsigned int bytes;
 	char *p = page;
 	struct uid_stat *uid_entry = (struct uid_stat *) data;
+	int cpu;
 	if (!data)
 		return 0;
 
-	bytes = (unsigned int) (atomic_read(&uid_entry->tcp_rcv) + INT_MIN);
+	bytes = 0;
+	for_each_possible_cpu(cpu)
+		bytes += per_cpu_ptr(uid_entry->cpu, cpu)->tcp_rcv;
 	p += sprintf(p, "%u\n", bytes);
 	len = (p - page) - off;
 	*eof = (len <= count) ? 1 : 0;
@@ -92,7 +109,7 @@ static int tcp_rcv_read_proc(char *page, char **start, off_t off,
 static struct uid_stat *create_stat(uid_t uid) {
 	unsigned long flags;
 	char uid_s[32];
-	struct uid_stat *new_uid;
+	struct uid_stat *new_uid, *old;
 	struct proc_dir_entry *entry;
 
 	/* Create the uid stat struct and append it to the list. */
@@ -100,12 +117,24 @@ static struct uid_stat *create_stat(uid_t uid) {
 		return NULL;
 
 	new_uid->uid = uid;
-	/* Counters start at INT_MIN, so we can track 4GB of network traffic. */
-	atomic_set(&new_uid->tcp_rcv, INT_MIN);
-	atomic_set(&new_uid->tcp_snd, INT_MIN);
+	/* Zeroed, wrapping unsigned counters track 4GB of network traffic. */
+	new_uid->cpu = alloc_percpu(struct uid_stat_cpu);
+	if (!new_uid->cpu) {
+		kfree(new_uid);
+		return NULL;
+	}
 
 	spin_lock_irqsave(&uid_lock, flags);
-	list_add_tail(&new_uid->link, &uid_list);
+	/* Lost a race with another task of the same uid */
+	list_for_each_entry(old, &uid_list, link) {
+		if (old->uid == uid) {
+			spin_unlock_irqrestore(&uid_lock, flags);
+			free_percpu(new_uid->cpu);
+			kfree(new_uid);
+			return old;
+		}
+	}
+	list_add_tail_rcu(&new_uid->link, &uid_list);
 	spin_unlock_irqrestore(&uid_lock, flags);
 
 	sprintf(uid_s, "%d", uid);
@@ -121,25 +150,39 @@ static struct uid_stat *create_stat(uid_t uid) {
 	return new_uid;
 }
 
-int uid_stat_tcp_snd(uid_t uid, int size) {
-	struct uid_stat *entry;
-	activity_stats_update();
+/*
+ * The entry of the uid, from the socket if the same uid used it last.
+ * The socket isn't locked here, racing callers at worst both look up.
+ */
+static struct uid_stat *get_uid_stat(struct sock *sk, uid_t uid) {
+	struct uid_stat *entry = ACCESS_ONCE(sk->sk_uid_stat);
+
+	if (likely(entry && entry->uid == uid))
+		return entry;
+
 	if ((entry = find_uid_stat(uid)) == NULL &&
 		((entry = create_stat(uid)) == NULL)) {
-			return -1;
+			return NULL;
 	}
-	atomic_add(size, &entry->tcp_snd);
+	sk->sk_uid_stat = entry;
+	return entry;
+}
+
+int uid_stat_tcp_snd(struct sock *sk, uid_t uid, int size) {
+	struct uid_stat *entry;
+	activity_stats_update();
+	if ((entry = get_uid_stat(sk, uid)) == NULL)
+		return -1;
+	this_cpu_add(entry->cpu->tcp_snd, size);
 	return 0;
 }
 
-int uid_stat_tcp_rcv(uid_t uid, int size) {
+int uid_stat_tcp_rcv(struct sock *sk, uid_t uid, int size) {
 	struct uid_stat *entry;
 	activity_stats_update();
-	if ((entry = find_uid_stat(uid)) == NULL &&
-		((entry = create_stat(uid)) == NULL)) {
-			return -1;
-	}
-	atomic_add(size, &entry->tcp_rcv);
+	if ((entry = get_uid_stat(sk, uid)) == NULL)
+		return -1;
+	this_cpu_add(entry->cpu->tcp_rcv, size);
 	return 0;
 }
 
@@ -64,8 +64,20 @@ struct mmc_blk_data {
 	//ruanmeisi
 	int err_times;
 	int reinit_times;
+
+	__le32		*packed_hdr;	/* set if writes can be packed */
+	unsigned long	packed_cmds;	/* packed writes issued */
+	unsigned long	packed_reqs;	/* requests carried in them */
+	unsigned long	packed_fails;	/* packed writes redone singly */
+	unsigned long	unpacked_reqs;	/* writes issued on their own */
 };
 
+/*
+ * Most requests packed into one write. The header block has room for
+ * 63, the card sets its own limit in EXT_CSD.
+ */
+#define MMC_BLK_PACKED_MAX	32
+
 //ruanmeisi_20100831
 #define MAX_ERR_TIMES    20
 #define MAX_RETINIT_TIMES    1
@@ -130,6 +142,7 @@ static void mmc_blk_put(struct mmc_blk_data *md)
 		__clear_bit(devidx, dev_use);
 
 		put_disk(md->disk);
+		kfree(md->packed_hdr);
 		kfree(md);
 	}
 	mutex_unlock(&open_lock);
@@ -180,6 +193,7 @@ static const struct block_device_operations mmc_bdops = {
 
 struct mmc_blk_request {
 	struct mmc_request	mrq;
+	struct mmc_command	sbc;
 	struct mmc_command	cmd;
 	struct mmc_command	stop;
 	struct mmc_data		data;
@@ -303,7 +317,23 @@ mmc_blk_set_blksize(struct mmc_blk_data *md, struct mmc_card *card)
 }
 
 
-static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
+/*
+ * Hand the rest of a write back to the elevator, so the urgent request
+ * it is holding up goes first. Call with the queue lock held.
+ */
+static int mmc_blk_preempt(struct mmc_queue *mq, struct request *req)
+{
+	if (!mq->urgent || rq_data_dir(req) != WRITE)
+		return 0;
+
+	if (blk_reinsert_request(mq->queue, req))
+		return 0;
+
+	mq->urgent = 0;
+	return 1;
+}
+
+static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 {
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
@@ -316,6 +346,10 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	
 
 	if (get_err_times(md) > MAX_ERR_TIMES) {
+		mmc_claim_host(card->host);
+		mmc_queue_unprep(mq);
+		mmc_release_host(card->host);
+
 		spin_lock_irq(&md->lock);
 		while (ret)
 			ret = __blk_end_request(req, -EIO, blk_rq_cur_bytes(req));
@@ -333,9 +367,16 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 
 	mmc_claim_host(card->host);
 
+	/* Something got in ahead of the request mapped early */
+	if (mq->prep_req && mq->prep_req != req)
+		mmc_queue_unprep(mq);
+
 	do {
 		struct mmc_command cmd;
 		u32 readcmd, writecmd, status = 0;
+		u32 prg_sectors = 0;
+		int hpi = 0;
+		struct completion complete;
 
 		memset(&brq, 0, sizeof(struct mmc_blk_request));
 		brq.mrq.cmd = &brq.cmd;
@@ -392,8 +433,12 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 
 		mmc_set_data_timeout(&brq.data, card);
 
+		/* The request may have been mapped while the last one ran */
+		brq.data.sg_len = mmc_queue_use_prepped(mq,
+						&brq.data.host_cookie);
 		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+		if (!brq.data.sg_len)
+			brq.data.sg_len = mmc_queue_map_sg(mq);
 
 		/*
 		 * Adjust the sg list so it is the same size as the
@@ -416,7 +461,10 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 
 		mmc_queue_bounce_pre(mq);
 
-		mmc_wait_for_req(card->host, &brq.mrq);
+		mmc_start_req(card->host, &brq.mrq, &complete);
+		mmc_queue_prep_next(mq);
+		wait_for_completion(&complete);
+		mmc_post_req(card->host, &brq.mrq, 0);
 
 		mmc_queue_bounce_post(mq);
 
@@ -532,6 +580,20 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 					goto cmd_err;
 				}
 				//end
+				/*
+				 * An urgent request is waiting: stop the
+				 * card programming and rewrite what it
+				 * didn't get to after the urgent one.
+				 */
+				if (mq->urgent && card->ext_csd.hpi_en &&
+				    !brq.cmd.error && !brq.data.error &&
+				    R1_CURRENT_STATE(cmd.resp[0]) == 7) {
+					prg_sectors = brq.data.blocks;
+					hpi = !mmc_interrupt_hpi(card,
+								 &prg_sectors);
+					if (hpi)
+						break;
+				}
 				/*
 				 * Some cards mishandle the status bits,
 				 * so make sure to check both the busy
@@ -570,7 +632,17 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		 * A block was successfully transferred.
 		 */
 		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		if (hpi) {
+			if (prg_sectors > brq.data.blocks)
+				prg_sectors = brq.data.blocks;
+			ret = __blk_end_request(req, 0, prg_sectors << 9);
+			mq->urgent_hpi++;
+		} else
+			ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		if (ret && mmc_blk_preempt(mq, req)) {
+			mq->urgent_preempts++;
+			ret = 0;
+		}
 		spin_unlock_irq(&md->lock);
 	} while (ret);
 
@@ -614,6 +686,236 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	return 0;
 }
 
+static int mmc_blk_issue_flush(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	int err;
+
+	mmc_claim_host(card->host);
+	err = mmc_flush_cache(card);
+	mmc_release_host(card->host);
+
+	spin_lock_irq(&md->lock);
+	__blk_end_request_all(req, err ? -EIO : 0);
+	spin_unlock_irq(&md->lock);
+
+	return !err;
+}
+
+static int mmc_blk_wait_for_ready(struct mmc_card *card, u32 *status)
+{
+	struct mmc_command cmd;
+	unsigned long timeout = jiffies + 10 * HZ;
+	int err;
+
+	do {
+		memset(&cmd, 0, sizeof(struct mmc_command));
+		cmd.opcode = MMC_SEND_STATUS;
+		cmd.arg = card->rca << 16;
+		cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		err = mmc_wait_for_cmd(card->host, &cmd, 5);
+		if (err)
+			return err;
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+	} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
+		 (R1_CURRENT_STATE(cmd.resp[0]) == 7));
+
+	*status = cmd.resp[0];
+	return 0;
+}
+
+/*
+ * Send 'req' and the writes queued behind it as one eMMC 4.5 packed
+ * write: CMD23 with the packed bit, then a single CMD25 whose first
+ * block is a header listing each request's CMD23 and CMD25 arguments.
+ *
+ * Returns -1 if there is nothing to pack 'req' with, so the caller
+ * issues it the usual way. If the packed write fails each request is
+ * redone singly; writing a sector twice is harmless.
+ */
+static int mmc_blk_issue_packed(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_host *host = card->host;
+	struct request_queue *q = mq->queue;
+	struct request *reqs[MMC_BLK_PACKED_MAX];
+	struct mmc_blk_request brq;
+	unsigned int blocks, segs, max_segs, max = MMC_BLK_PACKED_MAX;
+	u32 status = 0;
+	int i, n = 1, sg_len, err, ret = 1;
+
+	if (req->cmd_flags & (REQ_HARDBARRIER | REQ_FUA) ||
+	    blk_discard_rq(req))
+		return -1;
+
+	if (max > card->ext_csd.max_packed_writes)
+		max = card->ext_csd.max_packed_writes;
+	max_segs = min(host->max_hw_segs, host->max_phys_segs);
+
+	/* One block and one segment go to the header */
+	blocks = blk_rq_sectors(req) + 1;
+	segs = req->nr_phys_segments + 1;
+	if (blocks > host->max_blk_count || segs > max_segs)
+		return -1;
+
+	mmc_claim_host(host);
+
+	reqs[0] = req;
+	spin_lock_irq(q->queue_lock);
+	while (n < max) {
+		struct request *next = blk_peek_request(q);
+
+		if (!next || !blk_fs_request(next) ||
+		    rq_data_dir(next) != WRITE || blk_discard_rq(next) ||
+		    next->cmd_flags & (REQ_HARDBARRIER | REQ_FUA))
+			break;
+		if (blocks + blk_rq_sectors(next) > host->max_blk_count ||
+		    segs + next->nr_phys_segments > max_segs)
+			break;
+
+		blk_start_request(next);
+		reqs[n++] = next;
+		blocks += blk_rq_sectors(next);
+		segs += next->nr_phys_segments;
+	}
+	spin_unlock_irq(q->queue_lock);
+
+	if (n == 1) {
+		mmc_release_host(host);
+		return -1;
+	}
+
+	/* This goes out in one piece, nothing can be mapped ahead */
+	mmc_queue_unprep(mq);
+
+	memset(md->packed_hdr, 0, 512);
+	md->packed_hdr[0] = cpu_to_le32((n << 16) |
+					(MMC_PACKED_CMD_WR << 8) |
+					MMC_PACKED_CMD_VER);
+	for (i = 0; i < n; i++) {
+		u32 addr = blk_rq_pos(reqs[i]);
+
+		if (!mmc_card_blockaddr(card))
+			addr <<= 9;
+		md->packed_hdr[(i + 1) * 2] =
+			cpu_to_le32(blk_rq_sectors(reqs[i]));
+		md->packed_hdr[(i + 1) * 2 + 1] = cpu_to_le32(addr);
+	}
+
+	sg_set_buf(&mq->sg[0], md->packed_hdr, 512);
+	sg_unmark_end(&mq->sg[0]);
+	sg_len = 1;
+	for (i = 0; i < n; i++) {
+		sg_len += blk_rq_map_sg(q, reqs[i], &mq->sg[sg_len]);
+		sg_unmark_end(&mq->sg[sg_len - 1]);
+	}
+	sg_mark_end(&mq->sg[sg_len - 1]);
+
+	memset(&brq, 0, sizeof(struct mmc_blk_request));
+	brq.mrq.sbc = &brq.sbc;
+	brq.mrq.cmd = &brq.cmd;
+	brq.mrq.data = &brq.data;
+
+	brq.sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq.sbc.arg = blocks | MMC_CMD23_ARG_PACKED;
+	brq.sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	brq.cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq.cmd.arg = le32_to_cpu(md->packed_hdr[3]);
+	brq.cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq.data.blksz = 512;
+	brq.data.blocks = blocks;
+	brq.data.flags = MMC_DATA_WRITE;
+	brq.data.sg = mq->sg;
+	brq.data.sg_len = sg_len;
+	mmc_set_data_timeout(&brq.data, card);
+
+	mmc_wait_for_req(host, &brq.mrq);
+
+	err = brq.sbc.error || brq.cmd.error || brq.data.error;
+	if (!err)
+		err = mmc_blk_wait_for_ready(card, &status);
+	if (!err && status & (R1_EXCEPTION_EVENT | R1_ERROR))
+		err = -EIO;
+
+	mmc_release_host(host);
+
+	if (err) {
+		printk(KERN_WARNING "%s: packed write of %d requests failed "
+		       "(%d/%d/%d, status %#x), redoing them singly\n",
+		       req->rq_disk->disk_name, n, brq.sbc.error,
+		       brq.cmd.error, brq.data.error, status);
+		md->packed_fails++;
+
+		for (i = 0; i < n; i++) {
+			mq->req = reqs[i];
+			ret &= mmc_blk_issue_rw_rq(mq, reqs[i]);
+		}
+		mq->req = req;
+		return ret;
+	}
+
+	md->packed_cmds++;
+	md->packed_reqs += n;
+	clear_err_times(md);
+
+	spin_lock_irq(&md->lock);
+	for (i = 0; i < n; i++)
+		__blk_end_request_all(reqs[i], 0);
+	spin_unlock_irq(&md->lock);
+
+	return 1;
+}
+
+static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	int ret;
+
+	if (mmc_req_is_flush(req))
+		return mmc_blk_issue_flush(mq, req);
+
+	if (rq_data_dir(req) == WRITE) {
+		if (md->packed_hdr && get_err_times(md) <= MAX_ERR_TIMES) {
+			ret = mmc_blk_issue_packed(mq, req);
+			if (ret >= 0)
+				return ret;
+		}
+		md->unpacked_reqs++;
+	}
+
+	return mmc_blk_issue_rw_rq(mq, req);
+}
+
+
+static ssize_t
+mmc_blk_packed_stats_show(struct device *dev, struct device_attribute *attr,
+			  char *buf)
+{
+	struct mmc_blk_data *md = dev_to_disk(dev)->private_data;
+
+	return sprintf(buf, "packed %lu\npacked_reqs %lu\npacked_fails %lu\n"
+		       "unpacked_reqs %lu\n", md->packed_cmds, md->packed_reqs,
+		       md->packed_fails, md->unpacked_reqs);
+}
+
+static DEVICE_ATTR(packed_stats, S_IRUGO, mmc_blk_packed_stats_show, NULL);
+
+static ssize_t
+mmc_blk_urgent_stats_show(struct device *dev, struct device_attribute *attr,
+			  char *buf)
+{
+	struct mmc_blk_data *md = dev_to_disk(dev)->private_data;
+
+	return sprintf(buf, "preempts %lu\nhpi %lu\n",
+		       md->queue.urgent_preempts, md->queue.urgent_hpi);
+}
+
+static DEVICE_ATTR(urgent_stats, S_IRUGO, mmc_blk_urgent_stats_show, NULL);
 
 static inline int mmc_blk_readonly(struct mmc_card *card)
 {
@@ -660,6 +962,11 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 	md->queue.issue_fn = mmc_blk_issue_rq;
 	md->queue.data = md;
 
+	/* Packed writes need CMD23 and the whole sg list in one go */
+	if (mmc_card_mmc(card) && card->ext_csd.max_packed_writes > 1 &&
+	    (card->host->caps & MMC_CAP_CMD23) && !md->queue.bounce_buf)
+		md->packed_hdr = kmalloc(512, GFP_KERNEL);
+
 	md->disk->major	= MMC_BLOCK_MAJOR;
 	md->disk->first_minor = devidx << MMC_SHIFT;
 	md->disk->fops = &mmc_bdops;
@@ -740,6 +1047,12 @@ static int mmc_blk_probe(struct mmc_card *card)
 	mmc_set_bus_resume_policy(card->host, 1);
 #endif
 	add_disk(md->disk);
+	if (device_create_file(disk_to_dev(md->disk), &dev_attr_packed_stats))
+		printk(KERN_WARNING "%s: unable to create packed_stats\n",
+		       md->disk->disk_name);
+	if (device_create_file(disk_to_dev(md->disk), &dev_attr_urgent_stats))
+		printk(KERN_WARNING "%s: unable to create urgent_stats\n",
+		       md->disk->disk_name);
 	return 0;
 
  out:
@@ -765,6 +1078,10 @@ static void mmc_blk_remove(struct mmc_card *card)
 		queue_flag_set_unlocked(QUEUE_FLAG_DEAD, 
 		 			md->queue.queue); 
 		
+		device_remove_file(disk_to_dev(md->disk),
+				   &dev_attr_packed_stats);
+		device_remove_file(disk_to_dev(md->disk),
+				   &dev_attr_urgent_stats);
 		del_gendisk(md->disk);
 
 		/* Then flush out any already in there */
@@ -32,9 +32,9 @@
 static int mmc_prep_request(struct request_queue *q, struct request *req)
 {
 	/*
-	 * We only like normal block requests.
+	 * We only like normal block requests and cache flushes.
 	 */
-	if (!blk_fs_request(req)) {
+	if (!blk_fs_request(req) && !mmc_req_is_flush(req)) {
 		blk_dump_rq_flags(req, "MMC bad request");
 		return BLKPREP_KILL;
 	}
@@ -43,6 +43,12 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 
 	return BLKPREP_OK;
 }
+static void mmc_prepare_flush(struct request_queue *q, struct request *req)
+{
+	req->cmd_type = REQ_TYPE_LINUX_BLOCK;
+	req->cmd[0] = REQ_LB_OP_FLUSH;
+}
+
 //ruanmeisi_20100603
 int mmc_send_status(struct mmc_card *card, u32 *status);
 	
@@ -101,6 +107,7 @@ static int mmc_queue_thread(void *d)
 		if (!blk_queue_plugged(q))
 			req = blk_fetch_request(q);
 		mq->req = req;
+		mq->urgent = 0;
 		spin_unlock_irq(q->queue_lock);
 
 		if (!req) {
@@ -217,6 +224,21 @@ static void mmc_request(struct request_queue *q)
 		wake_up_process(mq->thread);
 }
 
+/*
+ * The elevator has a request that should not wait for the one being
+ * issued. Flag it so a write in progress gives way at the next chance,
+ * and otherwise treat it like any other request.
+ */
+static void mmc_urgent_request(struct request_queue *q)
+{
+	struct mmc_queue *mq = q->queuedata;
+
+	if (mq && mq->req)
+		mq->urgent = 1;
+
+	mmc_request(q);
+}
+
 /**
  * mmc_init_queue - initialise a queue structure.
  * @mq: mmc queue
@@ -243,8 +265,17 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 	mq->req = NULL;
 
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
-	blk_queue_ordered(mq->queue, QUEUE_ORDERED_DRAIN, NULL);
+	blk_urgent_request(mq->queue, mmc_urgent_request);
+	/* With the eMMC cache on, barriers need it flushed either side */
+	if (card->ext_csd.cache_ctrl)
+		blk_queue_ordered(mq->queue, QUEUE_ORDERED_DRAIN_FLUSH,
+				  mmc_prepare_flush);
+	else
+		blk_queue_ordered(mq->queue, QUEUE_ORDERED_DRAIN, NULL);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
+	/* Let filesystems align allocations to the flash erase unit */
+	if (card->erase_size)
+		blk_queue_io_opt(mq->queue, card->erase_size << 9);
 
 #ifdef CONFIG_MMC_BLOCK_BOUNCE
 	if (host->max_hw_segs == 1) {
@@ -307,6 +338,14 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
 			goto cleanup_queue;
 		}
 		sg_init_table(mq->sg, host->max_phys_segs);
+
+		/* Without it requests just aren't prepared early */
+		if (host->ops->pre_req) {
+			mq->prep_sg = kmalloc(sizeof(struct scatterlist) *
+				host->max_phys_segs, GFP_KERNEL);
+			if (mq->prep_sg)
+				sg_init_table(mq->prep_sg, host->max_phys_segs);
+		}
 	}
 
 	init_MUTEX(&mq->thread_sem);
@@ -326,6 +365,8 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card, spinlock_t *lock
  	if (mq->sg)
 		kfree(mq->sg);
 	mq->sg = NULL;
+	kfree(mq->prep_sg);
+	mq->prep_sg = NULL;
 	if (mq->bounce_buf)
 		kfree(mq->bounce_buf);
 	mq->bounce_buf = NULL;
@@ -344,6 +385,12 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	/* Then terminate our worker thread */
 	kthread_stop(mq->thread);
 
+	if (mq->prep_req) {
+		mmc_claim_host(mq->card->host);
+		mmc_queue_unprep(mq);
+		mmc_release_host(mq->card->host);
+	}
+
 	/* Empty the queue */
 	spin_lock_irqsave(q->queue_lock, flags);
 	q->queuedata = NULL;
@@ -356,6 +403,8 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 
 	kfree(mq->sg);
 	mq->sg = NULL;
+	kfree(mq->prep_sg);
+	mq->prep_sg = NULL;
 
 	if (mq->bounce_buf)
 		kfree(mq->bounce_buf);
@@ -477,3 +526,76 @@ void mmc_queue_bounce_post(struct mmc_queue *mq)
 	local_irq_restore(flags);
 }
 
+/*
+ * Map the request that will be issued next and let the host set up its
+ * DMA for it, while the current request is still being transferred.
+ * Must be called with the host claimed. Requests that won't go to the
+ * card in one piece are left alone.
+ */
+void mmc_queue_prep_next(struct mmc_queue *mq)
+{
+	struct mmc_host *host = mq->card->host;
+	struct request_queue *q = mq->queue;
+	struct mmc_data *data = &mq->prep_data;
+	struct request *next;
+
+	if (!mq->prep_sg || mq->prep_req)
+		return;
+
+	spin_lock_irq(q->queue_lock);
+	next = blk_peek_request(q);	/* now started, so it won't grow */
+	spin_unlock_irq(q->queue_lock);
+
+	if (!next || !blk_fs_request(next) || blk_discard_rq(next) ||
+	    blk_rq_sectors(next) > host->max_blk_count)
+		return;
+
+	memset(data, 0, sizeof(*data));
+	data->blksz = 512;
+	data->blocks = blk_rq_sectors(next);
+	data->flags = rq_data_dir(next) == READ ?
+		MMC_DATA_READ : MMC_DATA_WRITE;
+	data->sg = mq->prep_sg;
+	data->sg_len = blk_rq_map_sg(q, next, mq->prep_sg);
+
+	memset(&mq->prep_mrq, 0, sizeof(mq->prep_mrq));
+	mq->prep_mrq.data = data;
+
+	mmc_pre_req(host, &mq->prep_mrq, false);
+	if (data->host_cookie)
+		mq->prep_req = next;
+}
+
+/*
+ * If mq->req is the request prepared by mmc_queue_prep_next(), make its
+ * sg list mq->sg and return its length and the host's cookie. Otherwise
+ * return 0.
+ */
+unsigned int mmc_queue_use_prepped(struct mmc_queue *mq, int *host_cookie)
+{
+	struct scatterlist *sg;
+
+	if (!mq->prep_req || mq->prep_req != mq->req)
+		return 0;
+
+	sg = mq->sg;
+	mq->sg = mq->prep_sg;
+	mq->prep_sg = sg;
+	mq->prep_req = NULL;
+
+	*host_cookie = mq->prep_data.host_cookie;
+	return mq->prep_data.sg_len;
+}
+
+/*
+ * Undo mmc_queue_prep_next() for a request that won't be issued the way
+ * it was prepared. The request itself stays on the queue.
+ */
+void mmc_queue_unprep(struct mmc_queue *mq)
+{
+	if (!mq->prep_req)
+		return;
+
+	mmc_post_req(mq->card->host, &mq->prep_mrq, -EINVAL);
+	mq->prep_req = NULL;
+}
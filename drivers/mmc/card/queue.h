@@ -1,6 +1,9 @@
 #ifndef MMC_QUEUE_H
 #define MMC_QUEUE_H
 
+#include <linux/blkdev.h>
+#include <linux/mmc/core.h>
+
 struct request;
 struct task_struct;
 
@@ -17,11 +20,25 @@ struct mmc_queue {
 	char			*bounce_buf;
 	struct scatterlist	*bounce_sg;
 	unsigned int		bounce_sg_len;
+	struct scatterlist	*prep_sg;	/* sg list for prep_req */
+	struct request		*prep_req;	/* next request, mapped early */
+	struct mmc_request	prep_mrq;
+	struct mmc_data		prep_data;
+	int			urgent;		/* elevator has an urgent request */
+	unsigned long		urgent_preempts;
+	unsigned long		urgent_hpi;
 #ifdef CONFIG_MMC_BLOCK_PARANOID_RESUME
 	int			check_status;
 #endif
 };
 
+/* Cache flush issued by the block layer around a barrier */
+static inline int mmc_req_is_flush(struct request *req)
+{
+	return req->cmd_type == REQ_TYPE_LINUX_BLOCK &&
+		req->cmd[0] == REQ_LB_OP_FLUSH;
+}
+
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *);
 extern void mmc_cleanup_queue(struct mmc_queue *);
 extern void mmc_queue_suspend(struct mmc_queue *);
@@ -31,4 +48,8 @@ extern unsigned int mmc_queue_map_sg(struct mmc_queue *);
 extern void mmc_queue_bounce_pre(struct mmc_queue *);
 extern void mmc_queue_bounce_post(struct mmc_queue *);
 
+extern void mmc_queue_prep_next(struct mmc_queue *);
+extern unsigned int mmc_queue_use_prepped(struct mmc_queue *, int *);
+extern void mmc_queue_unprep(struct mmc_queue *);
+
 #endif
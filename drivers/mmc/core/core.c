@@ -21,6 +21,7 @@
 #include <linux/leds.h>
 #include <linux/scatterlist.h>
 #include <linux/log2.h>
+#include <linux/slab.h>
 #include <linux/regulator/consumer.h>
 #include <linux/wakelock.h>
 
@@ -175,6 +176,14 @@ mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 
 	led_trigger_event(host->led, LED_FULL);
 
+	if (mrq->sbc) {
+		pr_debug("%s:     CMD%u arg %08x flags %08x (sbc)\n",
+			 mmc_hostname(host), mrq->sbc->opcode,
+			 mrq->sbc->arg, mrq->sbc->flags);
+		WARN_ON(!(host->caps & MMC_CAP_CMD23));
+		mrq->sbc->error = 0;
+		mrq->sbc->mrq = mrq;
+	}
 	mrq->cmd->error = 0;
 	mrq->cmd->mrq = mrq;
 	if (mrq->data) {
@@ -224,10 +233,7 @@ void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 {
 	DECLARE_COMPLETION_ONSTACK(complete);
 
-	mrq->done_data = &complete;
-	mrq->done = mmc_wait_done;
-
-	mmc_start_request(host, mrq);
+	mmc_start_req(host, mrq, &complete);
 //#ifdef CONFIG_BCM_WIFI
 //    if(!wait_for_completion_timeout(&complete, 5*HZ))
 //	{
@@ -241,6 +247,62 @@ void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 
 EXPORT_SYMBOL(mmc_wait_for_req);
 
+/**
+ *	mmc_start_req - start a request without waiting for it
+ *	@host: MMC host to start command
+ *	@mrq: MMC request to start
+ *	@complete: completed when the request is done
+ *
+ *	Like mmc_wait_for_req(), but returns once the request is started,
+ *	so that the caller can get on with something else, such as
+ *	preparing the next request with mmc_pre_req(). The caller must
+ *	wait for @complete before touching @mrq again.
+ */
+void mmc_start_req(struct mmc_host *host, struct mmc_request *mrq,
+		   struct completion *complete)
+{
+	init_completion(complete);
+	mrq->done_data = complete;
+	mrq->done = mmc_wait_done;
+
+	mmc_start_request(host, mrq);
+}
+
+EXPORT_SYMBOL(mmc_start_req);
+
+/**
+ *	mmc_pre_req - let the host prepare a request ahead of time
+ *	@host: MMC host the request will be issued to
+ *	@mrq: MMC request, only its data needs to be filled in
+ *	@is_first_req: no other request is in progress
+ *
+ *	The host sets mrq->data->host_cookie if it did anything. The same
+ *	host_cookie must be passed in with the data when the request is
+ *	issued, and mmc_post_req() called when it is done or dropped.
+ */
+void mmc_pre_req(struct mmc_host *host, struct mmc_request *mrq,
+		 bool is_first_req)
+{
+	if (host->ops->pre_req)
+		host->ops->pre_req(host, mrq, is_first_req);
+}
+
+EXPORT_SYMBOL(mmc_pre_req);
+
+/**
+ *	mmc_post_req - undo what mmc_pre_req() did
+ *	@host: MMC host the request was prepared for
+ *	@mrq: MMC request
+ *	@err: non-zero if the request was dropped without being issued
+ */
+void mmc_post_req(struct mmc_host *host, struct mmc_request *mrq, int err)
+{
+	if (host->ops->post_req)
+		host->ops->post_req(host, mrq, err);
+}
+
+EXPORT_SYMBOL(mmc_post_req);
+
 /**
  *	mmc_wait_for_cmd - start a command and wait for completion
  *	@host: MMC host to start command
@@ -353,6 +415,102 @@ void mmc_set_data_timeout(struct mmc_data *data, const struct mmc_card *card)
 }
 EXPORT_SYMBOL(mmc_set_data_timeout);
 
+/**
+ *	mmc_flush_cache - write back the eMMC volatile cache
+ *	@card: the MMC card to flush
+ *
+ *	Does nothing unless the cache was turned on when the card
+ *	was initialised. The host must be claimed.
+ */
+int mmc_flush_cache(struct mmc_card *card)
+{
+	int err = 0;
+
+	if (mmc_card_mmc(card) && card->ext_csd.cache_ctrl) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_FLUSH_CACHE, 1);
+		if (err)
+			printk(KERN_ERR "%s: cache flush error %d\n",
+			       mmc_hostname(card->host), err);
+	}
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_flush_cache);
+
+/**
+ *	mmc_interrupt_hpi - stop the card programming with HPI
+ *	@card: the MMC card to interrupt
+ *	@prg_sectors: sectors of the interrupted write that made it
+ *
+ *	Sends a high priority interrupt so a card busy with a write
+ *	takes commands again, and waits for it to return to the
+ *	transfer state. If the write was cut short, @prg_sectors is
+ *	set to the number of its sectors the card programmed and the
+ *	rest must be written again. It is left alone if the card had
+ *	already finished. The host must be claimed.
+ */
+int mmc_interrupt_hpi(struct mmc_card *card, u32 *prg_sectors)
+{
+	struct mmc_command cmd;
+	unsigned long timeout;
+	u8 *ext_csd;
+	u32 status;
+	int err;
+
+	if (!mmc_card_mmc(card) || !card->ext_csd.hpi_en)
+		return -EOPNOTSUPP;
+
+	err = mmc_send_status(card, &status);
+	if (err)
+		return err;
+
+	/* Only a card that is programming can be interrupted */
+	if (R1_CURRENT_STATE(status) != 7)
+		return 0;
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = card->ext_csd.hpi_cmd;
+	cmd.arg = card->rca << 16 | 1;
+	if (cmd.opcode == MMC_STOP_TRANSMISSION)
+		cmd.flags = MMC_RSP_R1B | MMC_CMD_AC;
+	else
+		cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	err = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (err) {
+		printk(KERN_ERR "%s: HPI error %d, card status %#x\n",
+		       mmc_hostname(card->host), err, cmd.resp[0]);
+		return err;
+	}
+
+	timeout = jiffies + msecs_to_jiffies(100);
+	do {
+		err = mmc_send_status(card, &status);
+		if (err)
+			return err;
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+	} while (R1_CURRENT_STATE(status) != 4);
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return -ENOMEM;
+
+	err = mmc_send_ext_csd(card, ext_csd);
+	if (!err)
+		*prg_sectors =
+			ext_csd[EXT_CSD_CORRECTLY_PRG_SECTORS_NUM + 0] << 0 |
+			ext_csd[EXT_CSD_CORRECTLY_PRG_SECTORS_NUM + 1] << 8 |
+			ext_csd[EXT_CSD_CORRECTLY_PRG_SECTORS_NUM + 2] << 16 |
+			ext_csd[EXT_CSD_CORRECTLY_PRG_SECTORS_NUM + 3] << 24;
+
+	kfree(ext_csd);
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_interrupt_hpi);
+
 /**
  *	mmc_align_data_size - pads a transfer size to a more optimal value
  *	@card: the MMC card associated with the data transfer
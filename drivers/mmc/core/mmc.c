@@ -152,6 +152,14 @@ static int mmc_decode_csd(struct mmc_card *card)
 	csd->write_blkbits = UNSTUFF_BITS(resp, 22, 4);
 	csd->write_partial = UNSTUFF_BITS(resp, 21, 1);
 
+	/* Erase group, in write blocks; the EXT_CSD may override it */
+	if (csd->write_blkbits >= 9) {
+		e = UNSTUFF_BITS(resp, 42, 5);
+		m = UNSTUFF_BITS(resp, 37, 5);
+		card->erase_size = (e + 1) * (m + 1);
+		card->erase_size <<= csd->write_blkbits - 9;
+	}
+
 	return 0;
 }
 
@@ -221,7 +229,7 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 	}
 
 	card->ext_csd.rev = ext_csd[EXT_CSD_REV];
-	if (card->ext_csd.rev > 5) {
+	if (card->ext_csd.rev > 6) {
 		printk(KERN_ERR "%s: unrecognised EXT_CSD revision %d\n",
 			mmc_hostname(card->host), card->ext_csd.rev);
 		err = -EINVAL;
@@ -264,6 +272,32 @@ static int mmc_read_ext_csd(struct mmc_card *card)
 		if (sa_shift > 0 && sa_shift <= 0x17)
 			card->ext_csd.sa_timeout =
 					1 << ext_csd[EXT_CSD_S_A_TIMEOUT];
+
+		/* High-capacity erase unit, in 512KiB units */
+		if (ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE])
+			card->erase_size =
+				ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] << 10;
+	}
+
+	if (card->ext_csd.rev >= 5) {
+		/* HPI needs enabling in mmc_init_card */
+		if (ext_csd[EXT_CSD_HPI_FEATURES] & EXT_CSD_HPI_SUPPORT)
+			card->ext_csd.hpi_cmd =
+				(ext_csd[EXT_CSD_HPI_FEATURES] &
+				 EXT_CSD_HPI_IMPL_CMD12) ?
+				MMC_STOP_TRANSMISSION : MMC_SEND_STATUS;
+	}
+
+	if (card->ext_csd.rev >= 6) {
+		card->ext_csd.cache_size =
+			ext_csd[EXT_CSD_CACHE_SIZE + 0] << 0 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 1] << 8 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 2] << 16 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 3] << 24;
+		card->ext_csd.max_packed_writes =
+			ext_csd[EXT_CSD_MAX_PACKED_WRITES];
+		card->ext_csd.max_packed_reads =
+			ext_csd[EXT_CSD_MAX_PACKED_READS];
 	}
 
 out:
@@ -283,11 +317,13 @@ MMC_DEV_ATTR(manfid, "0x%06x\n", card->cid.manfid);
 MMC_DEV_ATTR(name, "%s\n", card->cid.prod_name);
 MMC_DEV_ATTR(oemid, "0x%04x\n", card->cid.oemid);
 MMC_DEV_ATTR(serial, "0x%08x\n", card->cid.serial);
+MMC_DEV_ATTR(erase_size, "%u\n", card->erase_size << 9);
 
 static struct attribute *mmc_std_attrs[] = {
 	&dev_attr_cid.attr,
 	&dev_attr_csd.attr,
 	&dev_attr_date.attr,
+	&dev_attr_erase_size.attr,
 	&dev_attr_fwrev.attr,
 	&dev_attr_hwrev.attr,
 	&dev_attr_manfid.attr,
@@ -497,6 +533,46 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		}
 	}
 
+	/*
+	 * Turn on the volatile cache (if present). The block driver
+	 * flushes it for barriers, and it is flushed before suspend.
+	 */
+	card->ext_csd.cache_ctrl = 0;
+	if (card->ext_csd.cache_size > 0) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_CACHE_CTRL, 1);
+		if (err && err != -EBADMSG)
+			goto free_card;
+
+		if (err) {
+			printk(KERN_WARNING "%s: enabling the cache failed\n",
+			       mmc_hostname(card->host));
+			err = 0;
+		} else {
+			card->ext_csd.cache_ctrl = 1;
+		}
+	}
+
+	/*
+	 * High priority interrupt lets the block driver cut a long
+	 * write short when an urgent read turns up.
+	 */
+	card->ext_csd.hpi_en = 0;
+	if (card->ext_csd.hpi_cmd) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_HPI_MGMT, 1);
+		if (err && err != -EBADMSG)
+			goto free_card;
+
+		if (err) {
+			printk(KERN_WARNING "%s: enabling HPI failed\n",
+			       mmc_hostname(card->host));
+			err = 0;
+		} else {
+			card->ext_csd.hpi_en = 1;
+		}
+	}
+
 	if (!oldcard)
 		host->card = card;
 
@@ -555,16 +631,22 @@ static void mmc_detect(struct mmc_host *host)
  */
 static int mmc_suspend(struct mmc_host *host)
 {
+	int err;
+
 	BUG_ON(!host);
 	BUG_ON(!host->card);
 
 	mmc_claim_host(host);
+	err = mmc_flush_cache(host->card);
+	if (err)
+		goto out;
 	if (!mmc_host_is_spi(host))
 		mmc_deselect_cards(host);
 	host->card->state &= ~MMC_STATE_HIGHSPEED;
+ out:
 	mmc_release_host(host);
 
-	return 0;
+	return err;
 }
 
 /*
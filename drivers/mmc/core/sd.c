@@ -119,6 +119,11 @@ static int mmc_decode_csd(struct mmc_card *card)
 		csd->r2w_factor = UNSTUFF_BITS(resp, 26, 3);
 		csd->write_blkbits = UNSTUFF_BITS(resp, 22, 4);
 		csd->write_partial = UNSTUFF_BITS(resp, 21, 1);
+
+		/* Erase sector, in write blocks; the AU overrides it */
+		if (csd->write_blkbits >= 9)
+			card->erase_size = (UNSTUFF_BITS(resp, 39, 7) + 1) <<
+				(csd->write_blkbits - 9);
 		break;
 	case 1:
 		/*
@@ -147,6 +152,7 @@ static int mmc_decode_csd(struct mmc_card *card)
 		csd->r2w_factor = 4; /* Unused */
 		csd->write_blkbits = 9;
 		csd->write_partial = 0;
+		card->erase_size = UNSTUFF_BITS(resp, 39, 7) + 1;
 		break;
 	default:
 		printk(KERN_ERR "%s: unrecognised CSD structure version %d\n",
@@ -235,6 +241,42 @@ out:
 	return err;
 }
 
+/*
+ * Read the allocation unit size from the SD status. The card does its
+ * internal garbage collection per AU, so it is the unit worth aligning
+ * writes to. Failing this is not fatal.
+ */
+static void mmc_read_ssr(struct mmc_card *card)
+{
+	unsigned int au;
+	u32 *ssr;
+	int i;
+
+	if (!(card->csd.cmdclass & CCC_APP_SPEC))
+		return;
+
+	ssr = kmalloc(64, GFP_KERNEL);
+	if (!ssr)
+		return;
+
+	if (mmc_app_sd_status(card, ssr)) {
+		printk(KERN_WARNING "%s: problem reading SD Status "
+			"register.\n", mmc_hostname(card->host));
+		goto out;
+	}
+
+	for (i = 0; i < 16; i++)
+		ssr[i] = be32_to_cpu(ssr[i]);
+
+	/* AU_SIZE is bits 431:428, 16KiB << (AU_SIZE - 1) */
+	au = UNSTUFF_BITS(ssr, 428 - 384, 4);
+	if (au > 0 && au <= 9)
+		card->erase_size = 1 << (au + 4);
+
+out:
+	kfree(ssr);
+}
+
 /*
  * Test if the card supports high-speed mode and, if so, switch to it.
  */
@@ -295,6 +337,7 @@ MMC_DEV_ATTR(manfid, "0x%06x\n", card->cid.manfid);
 MMC_DEV_ATTR(name, "%s\n", card->cid.prod_name);
 MMC_DEV_ATTR(oemid, "0x%04x\n", card->cid.oemid);
 MMC_DEV_ATTR(serial, "0x%08x\n", card->cid.serial);
+MMC_DEV_ATTR(erase_size, "%u\n", card->erase_size << 9);
 
 
 static struct attribute *sd_std_attrs[] = {
@@ -302,6 +345,7 @@ static struct attribute *sd_std_attrs[] = {
 	&dev_attr_csd.attr,
 	&dev_attr_scr.attr,
 	&dev_attr_date.attr,
+	&dev_attr_erase_size.attr,
 	&dev_attr_fwrev.attr,
 	&dev_attr_hwrev.attr,
 	&dev_attr_manfid.attr,
@@ -467,6 +511,8 @@ static int mmc_sd_init_card(struct mmc_host *host, u32 ocr,
 
 		if (err)
 			goto free_card;
+
+		mmc_read_ssr(card);
 	}
 
 	/*
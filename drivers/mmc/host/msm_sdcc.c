@@ -52,6 +52,7 @@
 #include <mach/clk.h>
 #include <mach/dma.h>
 #include <mach/htc_pwrsink.h>
+#include <mach/msm_latency.h>
 //ruanmeisi
 #include <linux/proc_fs.h>
 
@@ -99,6 +100,10 @@ static int  msmsdcc_dbg_init(void);
 static int msmsdcc_auto_suspend(struct mmc_host *, int);
 #endif
 
+#ifdef CONFIG_MMC_MSM_SDIO_SUPPORT
+static void msmsdcc_enable_sdio_irq(struct mmc_host *mmc, int enable);
+#endif
+
 static unsigned int msmsdcc_fmin = 144000;
 //static unsigned int msmsdcc_fmid = 24576000;
 //static unsigned int msmsdcc_temp = 25000000;
@@ -198,6 +203,8 @@ msmsdcc_request_end(struct msmsdcc_host *host, struct mmc_request *mrq)
 
 	if (mrq->data)
 		mrq->data->bytes_xfered = host->curr.data_xfered;
+	msm_latency_done(MSM_LATENCY_SDCC, (unsigned long)mrq,
+			 host->curr.start, mrq->cmd->error);
 	//if (mrq->cmd->error == -ETIMEDOUT)
 		//mdelay(5);
 
@@ -318,15 +325,24 @@ msmsdcc_dma_complete_tlet(unsigned long data)
 		if (!mrq->data->error)
 			mrq->data->error = -EIO;
 	}
-	dma_unmap_sg(mmc_dev(host->mmc), host->dma.sg, host->dma.num_ents,
-		     host->dma.dir);
+	if (host->dma.bounced) {
+		if (host->dma.dir == DMA_FROM_DEVICE &&
+		    (host->dma.result & DMOV_RSLT_DONE))
+			sg_copy_from_buffer(host->dma.sg, host->dma.num_ents,
+					    host->dma.bounce,
+					    host->curr.xfer_size);
+		host->dma.bounced = 0;
+	} else {
+		dma_unmap_sg(mmc_dev(host->mmc), host->dma.sg,
+			     host->dma.num_ents, host->dma.dir);
 
-	if (host->curr.user_pages) {
-		struct scatterlist *sg = host->dma.sg;
-		int i;
+		if (host->curr.user_pages) {
+			struct scatterlist *sg = host->dma.sg;
+			int i;
 
-		for (i = 0; i < host->dma.num_ents; i++, sg++)
-			flush_dcache_page(sg_page(sg));
+			for (i = 0; i < host->dma.num_ents; i++, sg++)
+				flush_dcache_page(sg_page(sg));
+		}
 	}
 
 	host->dma.sg = NULL;
@@ -401,61 +417,79 @@ static int validate_dma(struct msmsdcc_host *host, struct mmc_data *data)
 	return 0;
 }
 
-static int msmsdcc_config_dma(struct msmsdcc_host *host, struct mmc_data *data)
+/*
+ * Decide whether 'data' should go through the bounce buffer. Small
+ * transfers are cheaper to copy than to map, and scatterlists the box
+ * list can't describe (too many entries, or entries that are not whole
+ * FIFO rows or not 64 bit aligned) have to be copied anyway.
+ */
+static int msmsdcc_dma_bounce_needed(struct msmsdcc_host *host,
+				     struct mmc_data *data)
 {
-	struct msmsdcc_nc_dmadata *nc;
-	dmov_box *box;
-	uint32_t rows;
-	uint32_t crci;
-	unsigned int n;
-	int i, rc;
-	struct scatterlist *sg = data->sg;
-
-	rc = validate_dma(host, data);
-	if (rc)
-		return rc;
-
-	host->dma.sg = data->sg;
-	host->dma.num_ents = data->sg_len;
+	unsigned int size = data->blksz * data->blocks;
+	struct scatterlist *sg;
+	int i;
 
-	BUG_ON(host->dma.num_ents > NR_SG); /* Prevent memory corruption */
+	if (size > MSMSDCC_BOUNCE_SIZE)
+		return 0;
+	if (size <= host->dma.bounce_threshold || data->sg_len > NR_SG)
+		return 1;
 
-	nc = host->dma.nc;
+	for_each_sg(data->sg, sg, data->sg_len, i) {
+		if ((sg->offset & 0x07) || (sg->length % MCI_FIFOSIZE))
+			return 1;
+	}
+	return 0;
+}
 
+static int msmsdcc_dma_crci(struct msmsdcc_host *host, uint32_t *crci)
+{
 	if (host->pdev_id == 1)
-		crci = DMOV_SDC1_CRCI;
+		*crci = DMOV_SDC1_CRCI;
 	else if (host->pdev_id == 2)
-		crci = DMOV_SDC2_CRCI;
+		*crci = DMOV_SDC2_CRCI;
 	else if (host->pdev_id == 3)
-		crci = DMOV_SDC3_CRCI;
+		*crci = DMOV_SDC3_CRCI;
 	else if (host->pdev_id == 4)
-		crci = DMOV_SDC4_CRCI;
+		*crci = DMOV_SDC4_CRCI;
 #ifdef DMOV_SDC5_CRCI
 	else if (host->pdev_id == 5)
-		crci = DMOV_SDC5_CRCI;
+		*crci = DMOV_SDC5_CRCI;
 #endif
-	else {
-		host->dma.sg = NULL;
-		host->dma.num_ents = 0;
+	else
 		return -ENOENT;
-	}
 
-	if (data->flags & MMC_DATA_READ)
-		host->dma.dir = DMA_FROM_DEVICE;
-	else
-		host->dma.dir = DMA_TO_DEVICE;
+	return 0;
+}
+
+/*
+ * Build the box list for 'data' in list 'slot' and map its pages.
+ */
+static int msmsdcc_map_dma(struct msmsdcc_host *host, struct mmc_data *data,
+			   int slot, enum dma_data_direction dir)
+{
+	struct msmsdcc_nc_dmadata *nc = &host->dma.nc[slot];
+	dmov_box *box;
+	uint32_t rows;
+	uint32_t crci;
+	unsigned int n;
+	int i;
+	struct scatterlist *sg = data->sg;
+
+	BUG_ON(data->sg_len > NR_SG); /* Prevent memory corruption */
+
+	if (msmsdcc_dma_crci(host, &crci))
+		return -ENOENT;
 
-	/* host->curr.user_pages = (data->flags & MMC_DATA_USERPAGE); */
-	host->curr.user_pages = 0;
 	box = &nc->cmd[0];
-	for (i = 0; i < host->dma.num_ents; i++) {
+	for (i = 0; i < data->sg_len; i++) {
 		box->cmd = CMD_MODE_BOX;
 
 		/* Initialize sg dma address */
 		sg->dma_address = page_to_dma(mmc_dev(host->mmc), sg_page(sg))
 					+ sg->offset;
 
-		if (i == (host->dma.num_ents - 1))
+		if (i == (data->sg_len - 1))
 			box->cmd |= CMD_LC;
 		rows = (sg_dma_len(sg) % MCI_FIFOSIZE) ?
 			(sg_dma_len(sg) / MCI_FIFOSIZE) + 1 :
@@ -486,6 +520,114 @@ static int msmsdcc_config_dma(struct msmsdcc_host *host, struct mmc_data *data)
 		sg++;
 	}
 
+	n = dma_map_sg(mmc_dev(host->mmc), data->sg, data->sg_len, dir);
+	/* dsb inside dma_map_sg will write nc out to mem as well */
+
+	if (n != data->sg_len) {
+		pr_err("%s: Unable to map in all sg elements\n",
+		       mmc_hostname(host->mmc));
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/*
+ * Build a single box moving 'data' between the FIFO and the bounce
+ * buffer in list 'slot'. Data to be written is copied in here, data
+ * read is copied out by msmsdcc_dma_complete_tlet().
+ */
+static void msmsdcc_bounce_dma(struct msmsdcc_host *host,
+			       struct mmc_data *data, int slot, uint32_t crci)
+{
+	dmov_box *box = &host->dma.nc[slot].cmd[0];
+	unsigned int size = data->blksz * data->blocks;
+
+	box->cmd = CMD_MODE_BOX | CMD_LC;
+	box->src_dst_len = (MCI_FIFOSIZE << 16) | (MCI_FIFOSIZE);
+	box->num_rows = (size / MCI_FIFOSIZE) * ((1 << 16) + 1);
+
+	if (data->flags & MMC_DATA_READ) {
+		box->src_row_addr = msmsdcc_fifo_addr(host);
+		box->dst_row_addr = host->dma.bounce_busaddr;
+		box->row_offset = MCI_FIFOSIZE;
+		box->cmd |= CMD_SRC_CRCI(crci);
+	} else {
+		sg_copy_to_buffer(data->sg, data->sg_len, host->dma.bounce,
+				  size);
+		box->src_row_addr = host->dma.bounce_busaddr;
+		box->dst_row_addr = msmsdcc_fifo_addr(host);
+		box->row_offset = (MCI_FIFOSIZE << 16);
+		box->cmd |= CMD_DST_CRCI(crci);
+	}
+
+	/* No dma_map_sg() to flush the box list and buffer out for us */
+	wmb();
+}
+
+static int msmsdcc_config_dma(struct msmsdcc_host *host, struct mmc_data *data)
+{
+	struct msmsdcc_nc_dmadata *nc;
+	uint32_t crci;
+	int slot, rc;
+
+	rc = validate_dma(host, data);
+	if (rc)
+		return rc;
+
+	rc = msmsdcc_dma_crci(host, &crci);
+	if (rc)
+		return rc;
+
+	host->dma.bounced = 0;
+	if (data->host_cookie > 0 && data->host_cookie == host->dma.prep.cookie &&
+	    data->sg == host->dma.prep.sg) {
+		/* Already mapped by msmsdcc_pre_req() */
+		slot = host->dma.prep.slot;
+		host->dma.sg = host->dma.prep.sg;
+		host->dma.num_ents = host->dma.prep.num_ents;
+		host->dma.dir = host->dma.prep.dir;
+		host->dma.prep.cookie = 0;
+	} else {
+		if (data->sg_len > NR_SG &&
+		    !msmsdcc_dma_bounce_needed(host, data))
+			return -EINVAL;
+
+		/* Keep off the list of a request mapped ahead */
+		slot = host->dma.prep.cookie ? !host->dma.prep.slot :
+			host->dma.nc_slot;
+
+		host->dma.sg = data->sg;
+		host->dma.num_ents = data->sg_len;
+
+		if (data->flags & MMC_DATA_READ)
+			host->dma.dir = DMA_FROM_DEVICE;
+		else
+			host->dma.dir = DMA_TO_DEVICE;
+
+		if (msmsdcc_dma_bounce_needed(host, data)) {
+			msmsdcc_bounce_dma(host, data, slot, crci);
+			host->dma.bounced = 1;
+			host->dma.nbounced++;
+		} else {
+			rc = msmsdcc_map_dma(host, data, slot, host->dma.dir);
+			if (rc) {
+				host->dma.sg = NULL;
+				host->dma.num_ents = 0;
+				return rc;
+			}
+		}
+	}
+
+	/* host->curr.user_pages = (data->flags & MMC_DATA_USERPAGE); */
+	host->curr.user_pages = 0;
+
+	nc = &host->dma.nc[slot];
+	host->dma.nc_slot = slot;
+	host->dma.cmd_busaddr = host->dma.nc_busaddr + slot * sizeof(*nc);
+	host->dma.cmdptr_busaddr = host->dma.cmd_busaddr +
+				offsetof(struct msmsdcc_nc_dmadata, cmdptr);
+
 	/* location of command block must be 64 bit aligned */
 	BUG_ON(host->dma.cmd_busaddr & 0x07);
 
@@ -495,19 +637,80 @@ static int msmsdcc_config_dma(struct msmsdcc_host *host, struct mmc_data *data)
 	host->dma.hdr.complete_func = msmsdcc_dma_complete_func;
 	host->dma.hdr.crci_mask = msm_dmov_build_crci_mask(1, crci);
 
-	n = dma_map_sg(mmc_dev(host->mmc), host->dma.sg,
-			host->dma.num_ents, host->dma.dir);
-	/* dsb inside dma_map_sg will write nc out to mem as well */
+	return 0;
+}
 
-	if (n != host->dma.num_ents) {
-		pr_err("%s: Unable to map in all sg elements\n",
-		       mmc_hostname(host->mmc));
-		host->dma.sg = NULL;
-		host->dma.num_ents = 0;
-		return -ENOMEM;
+/*
+ * Map a request and build its box list while the one before it is still
+ * on the bus, so that msmsdcc_request() can start it straight away. Only
+ * one request is mapped ahead at a time; msmsdcc_post_req() undoes the
+ * mapping if the request never gets to msmsdcc_config_dma().
+ */
+static void msmsdcc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			    bool is_first_req)
+{
+	struct msmsdcc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	enum dma_data_direction dir;
+	unsigned long flags;
+	int slot, rc;
+
+	if (!data || data->host_cookie || validate_dma(host, data) ||
+	    data->sg_len > NR_SG || msmsdcc_dma_bounce_needed(host, data))
+		return;
+
+	dir = (data->flags & MMC_DATA_READ) ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+
+	spin_lock_irqsave(&host->lock, flags);
+	if (host->dma.prep.cookie) {
+		spin_unlock_irqrestore(&host->lock, flags);
+		return;
 	}
+	/* Claim the list the current request isn't using */
+	slot = !host->dma.nc_slot;
+	host->dma.prep.slot = slot;
+	host->dma.prep.cookie = -1;
+	spin_unlock_irqrestore(&host->lock, flags);
 
-	return 0;
+	rc = msmsdcc_map_dma(host, data, slot, dir);
+
+	spin_lock_irqsave(&host->lock, flags);
+	if (rc) {
+		host->dma.prep.cookie = 0;
+	} else {
+		if (++host->dma.last_cookie <= 0)
+			host->dma.last_cookie = 1;
+		host->dma.prep.cookie = host->dma.last_cookie;
+		host->dma.prep.sg = data->sg;
+		host->dma.prep.num_ents = data->sg_len;
+		host->dma.prep.dir = dir;
+		data->host_cookie = host->dma.prep.cookie;
+	}
+	spin_unlock_irqrestore(&host->lock, flags);
+}
+
+static void msmsdcc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			     int err)
+{
+	struct msmsdcc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	struct msmsdcc_dma_prep prep;
+	unsigned long flags;
+
+	if (!data || data->host_cookie <= 0)
+		return;
+
+	spin_lock_irqsave(&host->lock, flags);
+	prep = host->dma.prep;
+	if (prep.cookie == data->host_cookie)
+		host->dma.prep.cookie = 0;
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	/* Still mapped if it was never started */
+	if (prep.cookie == data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), prep.sg, prep.num_ents,
+			     prep.dir);
+	data->host_cookie = 0;
 }
 
 static void
@@ -578,6 +781,7 @@ msmsdcc_start_data(struct msmsdcc_host *host, struct mmc_data *data,
 	if (!msmsdcc_config_dma(host, data))
 		datactrl |= MCI_DPSM_DMAENABLE;
 	else {
+		host->dma.npio++;
 		host->pio.sg = data->sg;
 		host->pio.sg_len = data->sg_len;
 		host->pio.sg_off = 0;
@@ -869,6 +1073,78 @@ msmsdcc_pio_irq(int irq, void *dev_id)
 
 static void
 msmsdcc_request_start(struct msmsdcc_host *host, struct mmc_request *mrq);
+static void
+msmsdcc_request_start_cmd(struct msmsdcc_host *host, struct mmc_request *mrq);
+
+#ifdef CONFIG_MMC_MSM_SDIO_SUPPORT
+/*
+ * Count a card interrupt and switch to polling once the rate passes
+ * sdio_poll_threshold. Called with host->lock held.
+ */
+static void msmsdcc_sdio_irq_account(struct msmsdcc_host *host)
+{
+	host->sdio_nirqs++;
+
+	if (!host->sdio_poll_threshold)
+		return;
+
+	if (time_after(jiffies, host->sdio_irq_window +
+		       MSMSDCC_SDIO_IRQ_WINDOW)) {
+		host->sdio_irq_window = jiffies;
+		host->sdio_irq_count = 0;
+	}
+
+	if (++host->sdio_irq_count * HZ / MSMSDCC_SDIO_IRQ_WINDOW >=
+	    host->sdio_poll_threshold) {
+		host->sdio_polling = 1;
+		host->sdio_poll_idle = 0;
+	}
+}
+
+/*
+ * Poll for the card interrupt while it is masked, like blk-iopoll does
+ * for block completions: a bounded number of status reads per run, and
+ * back to interrupts once the card has been quiet for a few runs.
+ */
+static void msmsdcc_sdio_poll_tlet(unsigned long data)
+{
+	struct msmsdcc_host *host = (struct msmsdcc_host *)data;
+	int budget = MSMSDCC_SDIO_POLL_BUDGET;
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->lock, flags);
+
+	if (!host->sdio_irq_wanted || !host->sdio_polling)
+		goto out;
+
+	if (!host->clks_on)
+		goto stop;
+
+	while (budget--) {
+		if (readl(host->base + MMCISTATUS) & MCI_SDIOINTROPE) {
+			writel(MCI_SDIOINTROPECLR, host->base + MMCICLEAR);
+			host->sdio_npolled++;
+			host->sdio_poll_idle = 0;
+			mmc_signal_sdio_irq(host->mmc);
+			goto out;
+		}
+		cpu_relax();
+	}
+
+	if (++host->sdio_poll_idle < MSMSDCC_SDIO_POLL_IDLE) {
+		tasklet_schedule(&host->sdio_poll_tlet);
+		goto out;
+	}
+
+ stop:
+	host->sdio_polling = 0;
+	host->sdio_irq_count = 0;
+	host->sdio_irq_window = jiffies;
+	msmsdcc_enable_sdio_irq(host->mmc, 1);
+ out:
+	spin_unlock_irqrestore(&host->lock, flags);
+}
+#endif /* CONFIG_MMC_MSM_SDIO_SUPPORT */
 
 static irqreturn_t
 msmsdcc_irq(int irq, void *dev_id)
@@ -919,8 +1195,10 @@ msmsdcc_irq(int irq, void *dev_id)
 
 		data = host->curr.data;
 #ifdef CONFIG_MMC_MSM_SDIO_SUPPORT
-		if (status & MCI_SDIOINTROPE)
+		if (status & MCI_SDIOINTROPE) {
+			msmsdcc_sdio_irq_account(host);
 			mmc_signal_sdio_irq(host->mmc);
+		}
 #endif
 		/*
 		 * Check for proper command response
@@ -951,7 +1229,9 @@ msmsdcc_irq(int irq, void *dev_id)
 				cmd->error = -EILSEQ;
 			}
 
-			if (!cmd->data || cmd->error) {
+			if (cmd == cmd->mrq->sbc && !cmd->error) {
+				msmsdcc_request_start_cmd(host, cmd->mrq);
+			} else if (!cmd->data || cmd->error) {
 				if (host->curr.data && host->dma.sg)
 					msm_dmov_stop_cmd(host->dma.channel,
 							  &host->dma.hdr, 0);
@@ -1064,7 +1344,7 @@ msmsdcc_irq(int irq, void *dev_id)
 }
 
 static void
-msmsdcc_request_start(struct msmsdcc_host *host, struct mmc_request *mrq)
+msmsdcc_request_start_cmd(struct msmsdcc_host *host, struct mmc_request *mrq)
 {
 	if (mrq->data && mrq->data->flags & MMC_DATA_READ) {
 		/* Queue/read data, daisy-chain command when data starts */
@@ -1074,6 +1354,17 @@ msmsdcc_request_start(struct msmsdcc_host *host, struct mmc_request *mrq)
 	}
 }
 
+static void
+msmsdcc_request_start(struct msmsdcc_host *host, struct mmc_request *mrq)
+{
+	if (mrq->sbc) {
+		/* SET_BLOCK_COUNT goes first, the rest on its response */
+		msmsdcc_start_command(host, mrq->sbc, 0);
+		return;
+	}
+	msmsdcc_request_start_cmd(host, mrq);
+}
+
 static void
 msmsdcc_request(struct mmc_host *mmc, struct mmc_request *mrq)
 {
@@ -1100,6 +1391,8 @@ msmsdcc_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	}
 
 	host->curr.mrq = mrq;
+	host->curr.start = msm_latency_start(MSM_LATENCY_SDCC,
+					     (unsigned long)mrq);
 
 	if (host->plat->dummy52_required) {
 		if (host->dummy_52_needed) {
@@ -1225,7 +1518,12 @@ static void msmsdcc_enable_sdio_irq(struct mmc_host *mmc, int enable)
 {
 	struct msmsdcc_host *host = mmc_priv(mmc);
 
-	if (enable) {
+	host->sdio_irq_wanted = enable;
+
+	if (enable && host->sdio_polling) {
+		/* Leave the interrupt masked and look for the card ourselves */
+		tasklet_schedule(&host->sdio_poll_tlet);
+	} else if (enable) {
 		host->mci_irqenable |= MCI_SDIOINTOPERMASK;
 		writel(readl(host->base + MMCIMASK0) | MCI_SDIOINTOPERMASK,
 			       host->base + MMCIMASK0);
@@ -1238,6 +1536,8 @@ static void msmsdcc_enable_sdio_irq(struct mmc_host *mmc, int enable)
 #endif /* CONFIG_MMC_MSM_SDIO_SUPPORT */
 
 static const struct mmc_host_ops msmsdcc_ops = {
+	.pre_req	= msmsdcc_pre_req,
+	.post_req	= msmsdcc_post_req,
 	.request	= msmsdcc_request,
 	.set_ios	= msmsdcc_set_ios,
 	.get_ro		= msmsdcc_get_ro,
@@ -1346,18 +1646,20 @@ msmsdcc_init_dma(struct msmsdcc_host *host)
 	if (!host->dmares)
 		return -ENODEV;
 
-	host->dma.nc = dma_alloc_coherent(NULL,
-					  sizeof(struct msmsdcc_nc_dmadata),
+	host->dma.nc = dma_alloc_coherent(NULL, MSMSDCC_NC_SIZE,
 					  &host->dma.nc_busaddr,
 					  GFP_KERNEL);
 	if (host->dma.nc == NULL) {
 		pr_err("Unable to allocate DMA buffer\n");
 		return -ENOMEM;
 	}
-	memset(host->dma.nc, 0x00, sizeof(struct msmsdcc_nc_dmadata));
+	memset(host->dma.nc, 0x00, MSMSDCC_NC_LISTS_SIZE);
 	host->dma.cmd_busaddr = host->dma.nc_busaddr;
 	host->dma.cmdptr_busaddr = host->dma.nc_busaddr +
 				offsetof(struct msmsdcc_nc_dmadata, cmdptr);
+	host->dma.bounce = (void *)host->dma.nc + MSMSDCC_NC_LISTS_SIZE;
+	host->dma.bounce_busaddr = host->dma.nc_busaddr + MSMSDCC_NC_LISTS_SIZE;
+	host->dma.bounce_threshold = MSMSDCC_BOUNCE_THRESHOLD;
 	host->dma.channel = host->dmares->start;
 
 	return 0;
@@ -1493,6 +1795,106 @@ set_redetect(struct device *dev, struct device_attribute *attr,
 
 static DEVICE_ATTR(redetect, S_IRUGO | S_IWUSR,
 		NULL, set_redetect);
+
+static ssize_t
+show_bounce_threshold(struct device *dev, struct device_attribute *attr,
+		char *buf)
+{
+	struct mmc_host *mmc = dev_get_drvdata(dev);
+	struct msmsdcc_host *host = mmc_priv(mmc);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", host->dma.bounce_threshold);
+}
+
+/*
+ * Transfers up to this many bytes are copied through the bounce buffer
+ * rather than mapped. 0 only bounces what the data mover can't take as is.
+ */
+static ssize_t
+set_bounce_threshold(struct device *dev, struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct mmc_host *mmc = dev_get_drvdata(dev);
+	struct msmsdcc_host *host = mmc_priv(mmc);
+	unsigned int value;
+	unsigned long flags;
+
+	if (sscanf(buf, "%u", &value) != 1)
+		return -EINVAL;
+	if (value > MSMSDCC_BOUNCE_SIZE)
+		value = MSMSDCC_BOUNCE_SIZE;
+
+	spin_lock_irqsave(&host->lock, flags);
+	host->dma.bounce_threshold = value;
+	spin_unlock_irqrestore(&host->lock, flags);
+	return count;
+}
+
+static ssize_t
+show_dma_stats(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct mmc_host *mmc = dev_get_drvdata(dev);
+	struct msmsdcc_host *host = mmc_priv(mmc);
+
+	return snprintf(buf, PAGE_SIZE, "bounced %lu\npio %lu\n",
+			host->dma.nbounced, host->dma.npio);
+}
+
+static DEVICE_ATTR(bounce_threshold, S_IRUGO | S_IWUSR,
+		show_bounce_threshold, set_bounce_threshold);
+static DEVICE_ATTR(dma_stats, S_IRUGO, show_dma_stats, NULL);
+
+#ifdef CONFIG_MMC_MSM_SDIO_SUPPORT
+static ssize_t
+show_sdio_poll_threshold(struct device *dev, struct device_attribute *attr,
+		char *buf)
+{
+	struct mmc_host *mmc = dev_get_drvdata(dev);
+	struct msmsdcc_host *host = mmc_priv(mmc);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", host->sdio_poll_threshold);
+}
+
+/*
+ * SDIO card interrupts per second above which they are polled for.
+ * 0 turns polling off.
+ */
+static ssize_t
+set_sdio_poll_threshold(struct device *dev, struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct mmc_host *mmc = dev_get_drvdata(dev);
+	struct msmsdcc_host *host = mmc_priv(mmc);
+	unsigned int value;
+	unsigned long flags;
+
+	if (sscanf(buf, "%u", &value) != 1)
+		return -EINVAL;
+
+	spin_lock_irqsave(&host->lock, flags);
+	host->sdio_poll_threshold = value;
+	host->sdio_irq_count = 0;
+	host->sdio_irq_window = jiffies;
+	spin_unlock_irqrestore(&host->lock, flags);
+	return count;
+}
+
+static ssize_t
+show_sdio_irq_stats(struct device *dev, struct device_attribute *attr,
+		char *buf)
+{
+	struct mmc_host *mmc = dev_get_drvdata(dev);
+	struct msmsdcc_host *host = mmc_priv(mmc);
+
+	return snprintf(buf, PAGE_SIZE, "irqs %lu\npolled %lu\npolling %d\n",
+			host->sdio_nirqs, host->sdio_npolled,
+			host->sdio_polling);
+}
+
+static DEVICE_ATTR(sdio_poll_threshold, S_IRUGO | S_IWUSR,
+		show_sdio_poll_threshold, set_sdio_poll_threshold);
+static DEVICE_ATTR(sdio_irq_stats, S_IRUGO, show_sdio_irq_stats, NULL);
+#endif
 static DEVICE_ATTR(highspeed, S_IRUGO | S_IWUSR,
 		show_highspeed, set_highspeed);
 
@@ -1511,6 +1913,12 @@ static struct attribute *dev_attrs[] = {
 	&dev_attr_redetect.attr,
 	&dev_attr_highspeed.attr,
 	//end
+	&dev_attr_bounce_threshold.attr,
+	&dev_attr_dma_stats.attr,
+#ifdef CONFIG_MMC_MSM_SDIO_SUPPORT
+	&dev_attr_sdio_poll_threshold.attr,
+	&dev_attr_sdio_irq_stats.attr,
+#endif
 	NULL,
 };
 static struct attribute_group dev_attr_grp = {
@@ -1634,6 +2042,10 @@ msmsdcc_probe(struct platform_device *pdev)
 
 	tasklet_init(&host->dma_tlet, msmsdcc_dma_complete_tlet,
 			(unsigned long)host);
+#ifdef CONFIG_MMC_MSM_SDIO_SUPPORT
+	tasklet_init(&host->sdio_poll_tlet, msmsdcc_sdio_poll_tlet,
+			(unsigned long)host);
+#endif
 
 	/*
 	 * Setup DMA
@@ -1687,6 +2099,7 @@ msmsdcc_probe(struct platform_device *pdev)
 	mmc->caps |= plat->mmc_bus_width;
 
 	mmc->caps |= MMC_CAP_MMC_HIGHSPEED | MMC_CAP_SD_HIGHSPEED;
+	mmc->caps |= MMC_CAP_CMD23;
 
 	if (plat->nonremovable)
 		mmc->caps |= MMC_CAP_NONREMOVABLE;
@@ -1855,7 +2268,7 @@ msmsdcc_probe(struct platform_device *pdev)
 	if (!IS_ERR(host->pclk))
 		clk_put(host->pclk);
 
-	dma_free_coherent(NULL, sizeof(struct msmsdcc_nc_dmadata),
+	dma_free_coherent(NULL, MSMSDCC_NC_SIZE,
 			host->dma.nc, host->dma.nc_busaddr);
  ioremap_free:
 	iounmap(host->base);
@@ -1890,6 +2303,9 @@ static int msmsdcc_remove(struct platform_device *pdev)
 
 	tasklet_kill(&host->dma_tlet);
 	mmc_remove_host(mmc);
+#ifdef CONFIG_MMC_MSM_SDIO_SUPPORT
+	tasklet_kill(&host->sdio_poll_tlet);
+#endif
 
 	if (plat->status_irq)
 		free_irq(plat->status_irq, host);
@@ -1911,7 +2327,7 @@ static int msmsdcc_remove(struct platform_device *pdev)
 	if (!IS_ERR(host->pclk))
 		clk_put(host->pclk);
 
-	dma_free_coherent(NULL, sizeof(struct msmsdcc_nc_dmadata),
+	dma_free_coherent(NULL, MSMSDCC_NC_SIZE,
 			host->dma.nc, host->dma.nc_busaddr);
 	iounmap(host->base);
 	mmc_free_host(mmc);
@@ -176,16 +176,50 @@
 
 struct clk;
 
+/*
+ * Transfers that cannot be handed to the data mover as they stand are
+ * copied through a coherent buffer of this size instead.
+ */
+#define MSMSDCC_BOUNCE_SIZE	(8 * 1024)
+
+/* Default for the bounce_threshold sysfs attribute */
+#define MSMSDCC_BOUNCE_THRESHOLD	2048
+
 struct msmsdcc_nc_dmadata {
 	dmov_box	cmd[NR_SG];
 	uint32_t	cmdptr;
+} __aligned(8);
+
+/* Two box lists followed by the bounce buffer, in one coherent block */
+#define MSMSDCC_NC_LISTS_SIZE	\
+	ALIGN(2 * sizeof(struct msmsdcc_nc_dmadata), MCI_FIFOSIZE)
+#define MSMSDCC_NC_SIZE		(MSMSDCC_NC_LISTS_SIZE + MSMSDCC_BOUNCE_SIZE)
+
+/*
+ * SDIO interrupt polling: the rate is measured over windows of
+ * MSMSDCC_SDIO_IRQ_WINDOW jiffies. Each poll run reads the status up to
+ * MSMSDCC_SDIO_POLL_BUDGET times, and after MSMSDCC_SDIO_POLL_IDLE runs
+ * in a row without a card interrupt we go back to taking interrupts.
+ */
+#define MSMSDCC_SDIO_IRQ_WINDOW		(HZ / 10 ? HZ / 10 : 1)
+#define MSMSDCC_SDIO_POLL_BUDGET	64
+#define MSMSDCC_SDIO_POLL_IDLE		16
+
+/* A request mapped ahead of time by msmsdcc_pre_req() */
+struct msmsdcc_dma_prep {
+	int			cookie;		/* 0 if none, < 0 while mapping */
+	int			slot;		/* box list it was built in */
+	struct scatterlist	*sg;
+	int			num_ents;
+	enum dma_data_direction	dir;
 };
 
 struct msmsdcc_dma_data {
-	struct msmsdcc_nc_dmadata	*nc;
+	struct msmsdcc_nc_dmadata	*nc;		/* two box lists */
 	dma_addr_t			nc_busaddr;
-	dma_addr_t			cmd_busaddr;
+	dma_addr_t			cmd_busaddr;	/* of the list in use */
 	dma_addr_t			cmdptr_busaddr;
+	int				nc_slot;
 
 	struct msm_dmov_cmd		hdr;
 	enum dma_data_direction		dir;
@@ -198,6 +232,16 @@ struct msmsdcc_dma_data {
 	int				busy; /* Set if DM is busy */
 	unsigned int 			result;
 	struct msm_dmov_errdata 	*err;
+
+	struct msmsdcc_dma_prep		prep;
+	int				last_cookie;
+
+	void				*bounce;
+	dma_addr_t			bounce_busaddr;
+	unsigned int			bounce_threshold;
+	int				bounced; /* Set if sg is copied */
+	unsigned long			nbounced;
+	unsigned long			npio;
 };
 
 struct msmsdcc_pio_data {
@@ -218,6 +262,7 @@ struct msmsdcc_curr_req {
 	int			got_datablkend;
 	//ZTE_WIFI_OYHQ_20100714 wifi froyo upgrade end
 	int			user_pages;
+	u64			start;		/* msm_latency_start() */
 };
 
 struct msmsdcc_host {
@@ -283,6 +328,19 @@ struct msmsdcc_host {
 	struct workqueue_struct   *workqueue;
 	struct delayed_work	cmd_timeout_work;
 	struct mmc_request	*timeout_mrq;
+
+#ifdef CONFIG_MMC_MSM_SDIO_SUPPORT
+	/* Polling for SDIO card interrupts under heavy load */
+	struct tasklet_struct	sdio_poll_tlet;
+	unsigned int		sdio_poll_threshold;	/* irqs/s, 0 = off */
+	unsigned long		sdio_irq_window;	/* start, in jiffies */
+	unsigned int		sdio_irq_count;		/* irqs in window */
+	int			sdio_irq_wanted;
+	int			sdio_polling;
+	unsigned int		sdio_poll_idle;		/* empty polls in row */
+	unsigned long		sdio_nirqs;
+	unsigned long		sdio_npolled;
+#endif
 };
 
 #endif
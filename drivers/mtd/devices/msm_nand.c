@@ -25,11 +25,15 @@
 #include <linux/io.h>
 #include <linux/crc16.h>
 #include <linux/bitrev.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
 
 #include <asm/dma.h>
 #include <asm/mach/flash.h>
 
 #include <mach/dma.h>
+#include <mach/msm_latency.h>
 
 //BOOT_JIANGFENG_20100611_01, start
 #include <linux/proc_fs.h>
@@ -46,9 +50,10 @@ uint32_t dual_nand_ctlr_present;
 uint32_t interleave_enable;
 unsigned crci_mask;
 
-#define MSM_NAND_DMA_BUFFER_SIZE SZ_8K
+#define MSM_NAND_DMA_BUFFER_SIZE SZ_16K
+#define MSM_NAND_DMA_BUFFER_SLOT_SIZE 256
 #define MSM_NAND_DMA_BUFFER_SLOTS \
-	(MSM_NAND_DMA_BUFFER_SIZE / (sizeof(((atomic_t *)0)->counter) * 8))
+	(MSM_NAND_DMA_BUFFER_SIZE / MSM_NAND_DMA_BUFFER_SLOT_SIZE)
 
 #define MSM_NAND_CFG0_RAW 0xA80420C0
 #define MSM_NAND_CFG1_RAW 0x5045D
@@ -71,15 +76,31 @@ unsigned crci_mask;
 
 #define VERBOSE 0
 
+/* Bits corrected by the hardware ECC in an erase block since it was
+ * last erased, see msm_nand_ecc_account()
+ */
+struct msm_nand_ecc_block {
+	uint16_t corrected;	/* saturates */
+	uint8_t max;		/* most in one codeword */
+};
+
 struct msm_nand_chip {
 	struct device *dev;
-	wait_queue_head_t wait_queue;
-	atomic_t dma_buffer_busy;
+	spinlock_t dma_buffer_lock;
+	DECLARE_BITMAP(dma_buffer_busy, MSM_NAND_DMA_BUFFER_SLOTS);
+	struct list_head dma_buffer_waiters;
+	unsigned dma_buffer_allocs;	/* statistics */
+	unsigned dma_buffer_waits;
+	unsigned dma_buffer_peak;	/* most slots ever in use */
+	unsigned dma_buffer_used;
 	unsigned dma_channel;
 	uint8_t *dma_buffer;
 	dma_addr_t dma_addr;
 	unsigned CFG0, CFG1;
 	uint32_t ecc_buf_cfg;
+	struct msm_nand_ecc_block *ecc_blocks;	/* may be NULL */
+	unsigned ecc_nblocks;
+	unsigned ecc_block_shift;	/* pages per block, as a shift */
 };
 
 #define CFG1_WIDE_FLASH (1U << 1)
@@ -180,57 +201,84 @@ static struct nand_ecclayout msm_onenand_oob_64 = {
 	}
 };
 
+/* A task sleeping in msm_nand_get_dma_buffer() */
+struct msm_nand_dma_waiter {
+	struct list_head list;
+	struct task_struct *task;
+};
+
+static void *msm_nand_try_dma_buffer(struct msm_nand_chip *chip,
+				     unsigned nslots)
+{
+	unsigned long index;
+
+	index = bitmap_find_next_zero_area(chip->dma_buffer_busy,
+					   MSM_NAND_DMA_BUFFER_SLOTS, 0,
+					   nslots, 0);
+	if (index >= MSM_NAND_DMA_BUFFER_SLOTS)
+		return NULL;
+
+	bitmap_set(chip->dma_buffer_busy, index, nslots);
+	chip->dma_buffer_used += nslots;
+	if (chip->dma_buffer_used > chip->dma_buffer_peak)
+		chip->dma_buffer_peak = chip->dma_buffer_used;
+
+	return chip->dma_buffer + index * MSM_NAND_DMA_BUFFER_SLOT_SIZE;
+}
+
+/*
+ * Get a piece of the coherent DMA buffer, sleeping until one is free.
+ * Sleepers are woken in the order they arrived when buffers are released,
+ * instead of all at once.
+ */
 static void *msm_nand_get_dma_buffer(struct msm_nand_chip *chip, size_t size)
 {
-	unsigned int bitmask, free_bitmask, old_bitmask;
-	unsigned int need_mask, current_need_mask;
-	int free_index;
-
-	need_mask = (1UL << DIV_ROUND_UP(size, MSM_NAND_DMA_BUFFER_SLOTS)) - 1;
-	bitmask = atomic_read(&chip->dma_buffer_busy);
-	free_bitmask = ~bitmask;
-	do {
-		free_index = __ffs(free_bitmask);
-		current_need_mask = need_mask << free_index;
-
-		if (size + free_index * MSM_NAND_DMA_BUFFER_SLOTS >=
-						 MSM_NAND_DMA_BUFFER_SIZE)
-			return NULL;
-
-		if ((bitmask & current_need_mask) == 0) {
-			old_bitmask =
-				atomic_cmpxchg(&chip->dma_buffer_busy,
-					       bitmask,
-					       bitmask | current_need_mask);
-			if (old_bitmask == bitmask)
-				return chip->dma_buffer +
-					free_index * MSM_NAND_DMA_BUFFER_SLOTS;
-			free_bitmask = 0; /* force return */
+	unsigned nslots = DIV_ROUND_UP(size, MSM_NAND_DMA_BUFFER_SLOT_SIZE);
+	struct msm_nand_dma_waiter waiter;
+	void *buffer;
+
+	BUG_ON(nslots > MSM_NAND_DMA_BUFFER_SLOTS);
+
+	spin_lock(&chip->dma_buffer_lock);
+	chip->dma_buffer_allocs++;
+	buffer = msm_nand_try_dma_buffer(chip, nslots);
+	if (!buffer) {
+		chip->dma_buffer_waits++;
+		waiter.task = current;
+		list_add_tail(&waiter.list, &chip->dma_buffer_waiters);
+		for (;;) {
+			set_current_state(TASK_UNINTERRUPTIBLE);
+			buffer = msm_nand_try_dma_buffer(chip, nslots);
+			if (buffer)
+				break;
+			spin_unlock(&chip->dma_buffer_lock);
+			io_schedule();
+			spin_lock(&chip->dma_buffer_lock);
 		}
-		/* current free range was too small, clear all free bits */
-		/* below the top busy bit within current_need_mask */
-		free_bitmask &=
-			~(~0U >> (32 - fls(bitmask & current_need_mask)));
-	} while (free_bitmask);
+		__set_current_state(TASK_RUNNING);
+		list_del(&waiter.list);
+	}
+	spin_unlock(&chip->dma_buffer_lock);
 
-	return NULL;
+	return buffer;
 }
 
 static void msm_nand_release_dma_buffer(struct msm_nand_chip *chip,
 					void *buffer, size_t size)
 {
-	int index;
-	unsigned int used_mask;
-
-	used_mask = (1UL << DIV_ROUND_UP(size, MSM_NAND_DMA_BUFFER_SLOTS)) - 1;
-	index = ((uint8_t *)buffer - chip->dma_buffer) /
-		MSM_NAND_DMA_BUFFER_SLOTS;
-	atomic_sub(used_mask << index, &chip->dma_buffer_busy);
-
-	wake_up(&chip->wait_queue);
+	unsigned nslots = DIV_ROUND_UP(size, MSM_NAND_DMA_BUFFER_SLOT_SIZE);
+	unsigned index = ((uint8_t *)buffer - chip->dma_buffer) /
+		MSM_NAND_DMA_BUFFER_SLOT_SIZE;
+	struct msm_nand_dma_waiter *waiter;
+
+	spin_lock(&chip->dma_buffer_lock);
+	bitmap_clear(chip->dma_buffer_busy, index, nslots);
+	chip->dma_buffer_used -= nslots;
+	list_for_each_entry(waiter, &chip->dma_buffer_waiters, list)
+		wake_up_process(waiter->task);
+	spin_unlock(&chip->dma_buffer_lock);
 }
 
-
 unsigned flash_rd_reg(struct msm_nand_chip *chip, unsigned addr)
 {
 	struct {
@@ -240,9 +288,7 @@ unsigned flash_rd_reg(struct msm_nand_chip *chip, unsigned addr)
 	} *dma_buffer;
 	unsigned rv;
 
-	wait_event(chip->wait_queue,
-		   (dma_buffer = msm_nand_get_dma_buffer(
-			    chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	dma_buffer->cmd.cmd = CMD_LC | CMD_OCB | CMD_OCU;
 	dma_buffer->cmd.src = addr;
@@ -274,9 +320,7 @@ void flash_wr_reg(struct msm_nand_chip *chip, unsigned addr, unsigned val)
 		unsigned data;
 	} *dma_buffer;
 
-	wait_event(chip->wait_queue,
-		   (dma_buffer = msm_nand_get_dma_buffer(
-			    chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	dma_buffer->cmd.cmd = CMD_LC | CMD_OCB | CMD_OCU;
 	dma_buffer->cmd.src = msm_virt_to_dma(chip, &dma_buffer->data);
@@ -321,8 +365,7 @@ uint32_t flash_read_id(struct msm_nand_chip *chip)
 	} *dma_buffer;
 	uint32_t rv;
 
-	wait_event(chip->wait_queue, (dma_buffer = msm_nand_get_dma_buffer
-				(chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	dma_buffer->data[0] = 0 | 4;
 	dma_buffer->data[1] = MSM_NAND_CMD_FETCH_ID;
@@ -501,16 +544,15 @@ uint32_t flash_onfi_probe(struct msm_nand_chip *chip)
 		return err;
 	}
 
-	wait_event(chip->wait_queue, (onfi_identifier_buf =
-		msm_nand_get_dma_buffer(chip, ONFI_IDENTIFIER_LENGTH)));
+	onfi_identifier_buf = msm_nand_get_dma_buffer(chip,
+			ONFI_IDENTIFIER_LENGTH);
 	dma_addr_identifier = msm_virt_to_dma(chip, onfi_identifier_buf);
 
-	wait_event(chip->wait_queue, (onfi_param_info_buf =
-		msm_nand_get_dma_buffer(chip, ONFI_PARAM_INFO_LENGTH)));
+	onfi_param_info_buf = msm_nand_get_dma_buffer(chip,
+			ONFI_PARAM_INFO_LENGTH);
 	dma_addr_param_info = msm_virt_to_dma(chip, onfi_param_info_buf);
 
-	wait_event(chip->wait_queue, (dma_buffer = msm_nand_get_dma_buffer
-				(chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	dma_buffer->data.sflash_bcfg_orig = flash_rd_reg
 				(chip, MSM_NAND_SFLASHC_BURST_CFG);
@@ -733,36 +775,379 @@ uint32_t flash_onfi_probe(struct msm_nand_chip *chip)
 	return err;
 }
 
-static int msm_nand_read_oob(struct mtd_info *mtd, loff_t from,
-			     struct mtd_oob_ops *ops)
+/* Command list and results for reading one page, see msm_nand_read_oob() */
+struct msm_nand_read_dma {
+	dmov_s cmd[8 * 5 + 2];
+	unsigned cmdptr;
+	struct {
+		uint32_t cmd;
+		uint32_t addr0;
+		uint32_t addr1;
+		uint32_t chipsel;
+		uint32_t cfg0;
+		uint32_t cfg1;
+		uint32_t exec;
+		uint32_t ecccfg;
+		struct {
+			uint32_t flash_status;
+			uint32_t buffer_status;
+		} result[8];
+	} data;
+} __aligned(8);
+
+/* A page read handed to the data mover */
+struct msm_nand_read_req {
+	struct msm_dmov_cmd dmov;
+	struct completion done;
+	void *dma_buffer;	/* struct msm_nand_read_dma or, with two
+				 * controllers, msm_nand_read_dualnandc_dma
+				 */
+	unsigned page;
+	uint8_t *datbuf;	/* where this page's data and oob go */
+	dma_addr_t data_dma_addr;
+	uint8_t *oobbuf;
+	dma_addr_t oob_dma_addr;
+	uint32_t oob_len;
+};
+
+/* Number of page reads msm_nand_read_oob() keeps in flight. With two the
+ * controller reads the next page while the last one's status is checked.
+ */
+static unsigned msm_nand_read_pipeline = 2;
+module_param_named(read_pipeline, msm_nand_read_pipeline, uint, 0644);
+
+/* A codeword with this many bits corrected makes the read return
+ * -EUCLEAN, so that YAFFS2 or UBI move the data to a fresh block
+ * before it gets beyond what the ECC can correct.
+ */
+static unsigned msm_nand_scrub_threshold = 2;
+module_param_named(scrub_threshold, msm_nand_scrub_threshold, uint, 0644);
+
+/* Account the bits corrected in one codeword of a page. Returns -EUCLEAN
+ * if the page should be scrubbed. Not thread safe, like mtd->ecc_stats.
+ */
+static int msm_nand_ecc_account(struct mtd_info *mtd, unsigned page,
+				uint32_t ecc_errors)
 {
 	struct msm_nand_chip *chip = mtd->priv;
+	unsigned block = page >> chip->ecc_block_shift;
+	struct msm_nand_ecc_block *eb;
+
+	if (chip->ecc_blocks && block < chip->ecc_nblocks) {
+		eb = &chip->ecc_blocks[block];
+		eb->corrected = min_t(uint32_t, eb->corrected + ecc_errors,
+				      0xffff);
+		if (ecc_errors > eb->max)
+			eb->max = ecc_errors;
+	}
 
-	struct {
-		dmov_s cmd[8 * 5 + 2];
-		unsigned cmdptr;
-		struct {
-			uint32_t cmd;
-			uint32_t addr0;
-			uint32_t addr1;
-			uint32_t chipsel;
-			uint32_t cfg0;
-			uint32_t cfg1;
-			uint32_t exec;
-			uint32_t ecccfg;
-			struct {
-				uint32_t flash_status;
-				uint32_t buffer_status;
-			} result[8];
-		} data;
-	} *dma_buffer;
-	dmov_s *cmd;
+	return ecc_errors >= msm_nand_scrub_threshold ? -EUCLEAN : 0;
+}
+
+static void msm_nand_ecc_erased(struct mtd_info *mtd, loff_t addr)
+{
+	struct msm_nand_chip *chip = mtd->priv;
+	unsigned block = mtd_div_by_eb(addr, mtd);
+
+	if (chip->ecc_blocks && block < chip->ecc_nblocks)
+		memset(&chip->ecc_blocks[block], 0, sizeof(*chip->ecc_blocks));
+}
+
+static void msm_nand_read_prep(struct mtd_info *mtd, struct mtd_oob_ops *ops,
+			       struct msm_nand_read_dma *dma_buffer,
+			       unsigned page, uint32_t oob_col,
+			       unsigned start_sector,
+			       dma_addr_t *data_dma_addr_curr,
+			       dma_addr_t *oob_dma_addr_curr,
+			       uint32_t *oob_len)
+{
+	struct msm_nand_chip *chip = mtd->priv;
+	unsigned cwperpage = (mtd->writesize >> 9);
+	uint32_t sectordatasize;
+	uint32_t sectoroobsize;
+	dmov_s *cmd = dma_buffer->cmd;
+	unsigned n;
+
+	/* CMD / ADDR0 / ADDR1 / CHIPSEL program values */
+	if (ops->mode != MTD_OOB_RAW) {
+		dma_buffer->data.cmd = MSM_NAND_CMD_PAGE_READ_ECC;
+		dma_buffer->data.cfg0 =
+		(chip->CFG0 & ~(7U << 6))
+			| (((cwperpage-1) - start_sector) << 6);
+		dma_buffer->data.cfg1 = chip->CFG1;
+	} else {
+		dma_buffer->data.cmd = MSM_NAND_CMD_PAGE_READ;
+		dma_buffer->data.cfg0 = (MSM_NAND_CFG0_RAW
+				& ~(7U << 6)) | ((cwperpage-1) << 6);
+		dma_buffer->data.cfg1 = MSM_NAND_CFG1_RAW |
+				(chip->CFG1 & CFG1_WIDE_FLASH);
+	}
+
+	dma_buffer->data.addr0 = (page << 16) | oob_col;
+	dma_buffer->data.addr1 = (page >> 16) & 0xff;
+	/* chipsel_0 + enable DM interface */
+	dma_buffer->data.chipsel = 0 | 4;
+
+
+	/* GO bit for the EXEC register */
+	dma_buffer->data.exec = 1;
+
+
+	BUILD_BUG_ON(8 != ARRAY_SIZE(dma_buffer->data.result));
+
+	for (n = start_sector; n < cwperpage; n++) {
+		/* flash + buffer status return words */
+		dma_buffer->data.result[n].flash_status = 0xeeeeeeee;
+		dma_buffer->data.result[n].buffer_status = 0xeeeeeeee;
+
+		/* block on cmd ready, then
+		 * write CMD / ADDR0 / ADDR1 / CHIPSEL
+		 * regs in a burst
+		 */
+		cmd->cmd = DST_CRCI_NAND_CMD;
+		cmd->src = msm_virt_to_dma(chip, &dma_buffer->data.cmd);
+		cmd->dst = MSM_NAND_FLASH_CMD;
+		if (n == start_sector)
+			cmd->len = 16;
+		else
+			cmd->len = 4;
+		cmd++;
+
+		if (n == start_sector) {
+			cmd->cmd = 0;
+			cmd->src = msm_virt_to_dma(chip,
+						&dma_buffer->data.cfg0);
+			cmd->dst = MSM_NAND_DEV0_CFG0;
+			cmd->len = 8;
+			cmd++;
+
+			dma_buffer->data.ecccfg = chip->ecc_buf_cfg;
+			cmd->cmd = 0;
+			cmd->src = msm_virt_to_dma(chip,
+					&dma_buffer->data.ecccfg);
+			cmd->dst = MSM_NAND_EBI2_ECC_BUF_CFG;
+			cmd->len = 4;
+			cmd++;
+		}
+
+		/* kick the execute register */
+		cmd->cmd = 0;
+		cmd->src =
+			msm_virt_to_dma(chip, &dma_buffer->data.exec);
+		cmd->dst = MSM_NAND_EXEC_CMD;
+		cmd->len = 4;
+		cmd++;
+
+		/* block on data ready, then
+		 * read the status register
+		 */
+		cmd->cmd = SRC_CRCI_NAND_DATA;
+		cmd->src = MSM_NAND_FLASH_STATUS;
+		cmd->dst = msm_virt_to_dma(chip,
+					   &dma_buffer->data.result[n]);
+		/* MSM_NAND_FLASH_STATUS + MSM_NAND_BUFFER_STATUS */
+		cmd->len = 8;
+		cmd++;
+
+		/* read data block
+		 * (only valid if status says success)
+		 */
+		if (ops->datbuf) {
+			if (ops->mode != MTD_OOB_RAW)
+				sectordatasize = (n < (cwperpage - 1))
+				? 516 : (512 - ((cwperpage - 1) << 2));
+			else
+				sectordatasize = 528;
+
+			cmd->cmd = 0;
+			cmd->src = MSM_NAND_FLASH_BUFFER;
+			cmd->dst = *data_dma_addr_curr;
+			*data_dma_addr_curr += sectordatasize;
+			cmd->len = sectordatasize;
+			cmd++;
+		}
+
+		if (ops->oobbuf && (n == (cwperpage - 1)
+		     || ops->mode != MTD_OOB_AUTO)) {
+			cmd->cmd = 0;
+			if (n == (cwperpage - 1)) {
+				cmd->src = MSM_NAND_FLASH_BUFFER +
+					(512 - ((cwperpage - 1) << 2));
+				sectoroobsize = (cwperpage << 2);
+				if (ops->mode != MTD_OOB_AUTO)
+					sectoroobsize += 10;
+			} else {
+				cmd->src = MSM_NAND_FLASH_BUFFER + 516;
+				sectoroobsize = 10;
+			}
+
+			cmd->dst = *oob_dma_addr_curr;
+			if (sectoroobsize < *oob_len)
+				cmd->len = sectoroobsize;
+			else
+				cmd->len = *oob_len;
+			*oob_dma_addr_curr += cmd->len;
+			*oob_len -= cmd->len;
+			if (cmd->len > 0)
+				cmd++;
+		}
+	}
+
+	BUILD_BUG_ON(8 * 5 + 2 != ARRAY_SIZE(dma_buffer->cmd));
+	BUG_ON(cmd - dma_buffer->cmd > ARRAY_SIZE(dma_buffer->cmd));
+	dma_buffer->cmd[0].cmd |= CMD_OCB;
+	cmd[-1].cmd |= CMD_OCU | CMD_LC;
+
+	dma_buffer->cmdptr =
+		(msm_virt_to_dma(chip, dma_buffer->cmd) >> 3)
+		| CMD_PTR_LP;
+}
+
+static void msm_nand_read_done(struct msm_dmov_cmd *cmd,
+			       unsigned int result,
+			       struct msm_dmov_errdata *err)
+{
+	struct msm_nand_read_req *req =
+		container_of(cmd, struct msm_nand_read_req, dmov);
+
+	complete(&req->done);
+}
+
+static void msm_nand_read_start(struct msm_nand_chip *chip,
+				struct msm_nand_read_req *req,
+				unsigned *cmdptr)
+{
+	req->dmov.cmdptr = DMOV_CMD_PTR_LIST |
+		DMOV_CMD_ADDR(msm_virt_to_dma(chip, cmdptr));
+	req->dmov.crci_mask = crci_mask;
+	req->dmov.complete_func = msm_nand_read_done;
+	req->dmov.exec_func = NULL;
+	init_completion(&req->done);
+
+	dsb();
+	msm_dmov_enqueue_cmd(chip->dma_channel, &req->dmov);
+}
+
+/* Check the results of a finished page read. Returns 0 or the page's
+ * error; correctable errors are added to *total_ecc_errors.
+ */
+static int msm_nand_read_check(struct mtd_info *mtd, struct mtd_oob_ops *ops,
+			       struct msm_nand_read_req *req,
+			       unsigned start_sector,
+			       uint32_t *total_ecc_errors)
+{
+	struct msm_nand_chip *chip = mtd->priv;
+	struct msm_nand_read_dma *dma_buffer = req->dma_buffer;
+	unsigned cwperpage = (mtd->writesize >> 9);
+	uint32_t ecc_errors;
+	int pageerr, rawerr;
 	unsigned n;
+
+	/* if any of the writes failed (0x10), or there
+	 * was a protection violation (0x100), we lose
+	 */
+	pageerr = rawerr = 0;
+	for (n = start_sector; n < cwperpage; n++) {
+		if (dma_buffer->data.result[n].flash_status & 0x110) {
+			rawerr = -EIO;
+			break;
+		}
+	}
+	if (rawerr) {
+		if (ops->datbuf && ops->mode != MTD_OOB_RAW) {
+			uint8_t *datbuf = req->datbuf;
+
+			dma_sync_single_for_cpu(chip->dev,
+				req->data_dma_addr,
+				mtd->writesize, DMA_BIDIRECTIONAL);
+
+			for (n = 0; n < mtd->writesize; n++) {
+				/* empty blocks read 0x54 at
+				 * these offsets
+				 */
+				if (n % 516 == 3 && datbuf[n] == 0x54)
+					datbuf[n] = 0xff;
+				if (datbuf[n] != 0xff) {
+					pageerr = rawerr;
+					break;
+				}
+			}
+
+			dma_sync_single_for_device(chip->dev,
+				req->data_dma_addr,
+				mtd->writesize, DMA_BIDIRECTIONAL);
+
+		}
+		if (ops->oobbuf && req->oob_len) {
+			dma_sync_single_for_cpu(chip->dev,
+			req->oob_dma_addr,
+			req->oob_len, DMA_BIDIRECTIONAL);
+
+			for (n = 0; n < req->oob_len; n++) {
+				if (req->oobbuf[n] != 0xff) {
+					pageerr = rawerr;
+					break;
+				}
+			}
+
+			dma_sync_single_for_device(chip->dev,
+			req->oob_dma_addr,
+			req->oob_len, DMA_BIDIRECTIONAL);
+		}
+	}
+	if (pageerr) {
+		for (n = start_sector; n < cwperpage; n++) {
+			if (dma_buffer->data.result[n].buffer_status
+					& 0x8) {
+				/* not thread safe */
+				mtd->ecc_stats.failed++;
+				pageerr = -EBADMSG;
+				break;
+			}
+		}
+	}
+	if (!rawerr) { /* check for corretable errors */
+		for (n = start_sector; n < cwperpage; n++) {
+			ecc_errors = dma_buffer->data.
+				result[n].buffer_status & 0x7;
+			if (ecc_errors) {
+				*total_ecc_errors += ecc_errors;
+				/* not thread safe */
+				mtd->ecc_stats.corrected += ecc_errors;
+				if (msm_nand_ecc_account(mtd, req->page,
+							 ecc_errors))
+					pageerr = -EUCLEAN;
+			}
+		}
+	}
+
+#if VERBOSE
+	if (rawerr && !pageerr) {
+		pr_err("msm_nand_read_oob %llx %x %x empty page\n",
+		       (loff_t)req->page * mtd->writesize, ops->len,
+		       ops->ooblen);
+	} else {
+		for (n = start_sector; n < cwperpage; n++)
+			pr_info("flash_status[%d] = %x,\
+			buffr_status[%d] = %x\n",
+			n, dma_buffer->data.result[n].flash_status,
+			n, dma_buffer->data.result[n].buffer_status);
+	}
+#endif
+	return pageerr;
+}
+
+static int __msm_nand_read_oob(struct mtd_info *mtd, loff_t from,
+			       struct mtd_oob_ops *ops)
+{
+	struct msm_nand_chip *chip = mtd->priv;
+
+	struct msm_nand_read_dma *dma_buffer;
+	struct msm_nand_read_req reqs[2];
+	struct msm_nand_read_req *req;
 	unsigned page = 0;
 	uint32_t oob_len;
-	uint32_t sectordatasize;
-	uint32_t sectoroobsize;
-	int err, pageerr, rawerr;
+	int err, pageerr;
 	dma_addr_t data_dma_addr = 0;
 	dma_addr_t oob_dma_addr = 0;
 	dma_addr_t data_dma_addr_curr = 0;
@@ -770,8 +1155,10 @@ static int msm_nand_read_oob(struct mtd_info *mtd, loff_t from,
 	uint32_t oob_col = 0;
 	unsigned page_count;
 	unsigned pages_read = 0;
+	unsigned pages_queued = 0;
+	unsigned nreqs;
+	uint32_t oob_read = 0;
 	unsigned start_sector = 0;
-	uint32_t ecc_errors;
 	uint32_t total_ecc_errors = 0;
 	unsigned cwperpage;
 #if VERBOSE
@@ -855,281 +1242,95 @@ static int msm_nand_read_oob(struct mtd_info *mtd, loff_t from,
 		}
 	}
 
-	wait_event(chip->wait_queue,
-		   (dma_buffer = msm_nand_get_dma_buffer(
-			    chip, sizeof(*dma_buffer))));
+	/* Multi page reads get a command list per request in flight. The
+	 * empty page check writes to the page just read, so the pages must
+	 * not share cache lines with the one being read next.
+	 */
+	nreqs = (page_count > 1 && msm_nand_read_pipeline > 1 &&
+		 !((unsigned long)ops->datbuf &
+		   (dma_get_cache_alignment() - 1))) ?
+		ARRAY_SIZE(reqs) : 1;
+
+	dma_buffer = msm_nand_get_dma_buffer(chip, nreqs * sizeof(*dma_buffer));
 
 	oob_col = start_sector * 0x210;
 	if (chip->CFG1 & CFG1_WIDE_FLASH)
 		oob_col >>= 1;
 
 	err = 0;
-	while (page_count-- > 0) {
-		cmd = dma_buffer->cmd;
-
-		/* CMD / ADDR0 / ADDR1 / CHIPSEL program values */
-		if (ops->mode != MTD_OOB_RAW) {
-			dma_buffer->data.cmd = MSM_NAND_CMD_PAGE_READ_ECC;
-			dma_buffer->data.cfg0 =
-			(chip->CFG0 & ~(7U << 6))
-				| (((cwperpage-1) - start_sector) << 6);
-			dma_buffer->data.cfg1 = chip->CFG1;
-		} else {
-			dma_buffer->data.cmd = MSM_NAND_CMD_PAGE_READ;
-			dma_buffer->data.cfg0 = (MSM_NAND_CFG0_RAW
-					& ~(7U << 6)) | ((cwperpage-1) << 6);
-			dma_buffer->data.cfg1 = MSM_NAND_CFG1_RAW |
-					(chip->CFG1 & CFG1_WIDE_FLASH);
+	while (pages_read < page_count) {
+		/* Queue up the next pages behind the one being waited on */
+		while (pages_queued < page_count &&
+		       pages_queued - pages_read < nreqs) {
+			req = &reqs[pages_queued % nreqs];
+			req->dma_buffer = &dma_buffer[pages_queued % nreqs];
+			req->page = page + pages_queued;
+			req->datbuf = ops->datbuf ? ops->datbuf +
+				(data_dma_addr_curr - data_dma_addr) : NULL;
+			req->data_dma_addr = data_dma_addr_curr;
+			req->oobbuf = ops->oobbuf ? ops->oobbuf +
+				(ops->ooblen - oob_len) : NULL;
+			req->oob_dma_addr = oob_dma_addr_curr;
+			req->oob_len = oob_len;
+
+			msm_nand_read_prep(mtd, ops, req->dma_buffer,
+					   req->page, oob_col,
+					   start_sector, &data_dma_addr_curr,
+					   &oob_dma_addr_curr, &oob_len);
+			req->oob_len -= oob_len;
+
+			msm_nand_read_start(chip, req,
+				&dma_buffer[pages_queued % nreqs].cmdptr);
+			pages_queued++;
 		}
 
-		dma_buffer->data.addr0 = (page << 16) | oob_col;
-		dma_buffer->data.addr1 = (page >> 16) & 0xff;
-		/* chipsel_0 + enable DM interface */
-		dma_buffer->data.chipsel = 0 | 4;
-
+		req = &reqs[pages_read % nreqs];
+		wait_for_completion_io(&req->done);
+		dsb();
 
-		/* GO bit for the EXEC register */
-		dma_buffer->data.exec = 1;
+		pageerr = msm_nand_read_check(mtd, ops, req, start_sector,
+					      &total_ecc_errors);
+		if (pageerr && (pageerr != -EUCLEAN || err == 0))
+			err = pageerr;
+		oob_read += req->oob_len;
 
+		if (err && err != -EUCLEAN && err != -EBADMSG)
+			break;
+		pages_read++;
+	}
 
-		BUILD_BUG_ON(8 != ARRAY_SIZE(dma_buffer->data.result));
+	/* Don't let go of the buffers under reads still in flight */
+	while (pages_queued > pages_read + 1) {
+		pages_queued--;
+		wait_for_completion_io(&reqs[pages_queued % nreqs].done);
+	}
 
-		for (n = start_sector; n < cwperpage; n++) {
-			/* flash + buffer status return words */
-			dma_buffer->data.result[n].flash_status = 0xeeeeeeee;
-			dma_buffer->data.result[n].buffer_status = 0xeeeeeeee;
+	msm_nand_release_dma_buffer(chip, dma_buffer,
+				    nreqs * sizeof(*dma_buffer));
 
-			/* block on cmd ready, then
-			 * write CMD / ADDR0 / ADDR1 / CHIPSEL
-			 * regs in a burst
-			 */
-			cmd->cmd = DST_CRCI_NAND_CMD;
-			cmd->src = msm_virt_to_dma(chip, &dma_buffer->data.cmd);
-			cmd->dst = MSM_NAND_FLASH_CMD;
-			if (n == start_sector)
-				cmd->len = 16;
-			else
-				cmd->len = 4;
-			cmd++;
+	if (ops->oobbuf) {
+		dma_unmap_page(chip->dev, oob_dma_addr,
+				 ops->ooblen, DMA_FROM_DEVICE);
+	}
+err_dma_map_oobbuf_failed:
+	if (ops->datbuf) {
+		dma_unmap_page(chip->dev, data_dma_addr,
+				 ops->len, DMA_BIDIRECTIONAL);
+	}
 
-			if (n == start_sector) {
-				cmd->cmd = 0;
-				cmd->src = msm_virt_to_dma(chip,
-							&dma_buffer->data.cfg0);
-				cmd->dst = MSM_NAND_DEV0_CFG0;
-				cmd->len = 8;
-				cmd++;
-
-				dma_buffer->data.ecccfg = chip->ecc_buf_cfg;
-				cmd->cmd = 0;
-				cmd->src = msm_virt_to_dma(chip,
-						&dma_buffer->data.ecccfg);
-				cmd->dst = MSM_NAND_EBI2_ECC_BUF_CFG;
-				cmd->len = 4;
-				cmd++;
-			}
-
-			/* kick the execute register */
-			cmd->cmd = 0;
-			cmd->src =
-				msm_virt_to_dma(chip, &dma_buffer->data.exec);
-			cmd->dst = MSM_NAND_EXEC_CMD;
-			cmd->len = 4;
-			cmd++;
-
-			/* block on data ready, then
-			 * read the status register
-			 */
-			cmd->cmd = SRC_CRCI_NAND_DATA;
-			cmd->src = MSM_NAND_FLASH_STATUS;
-			cmd->dst = msm_virt_to_dma(chip,
-						   &dma_buffer->data.result[n]);
-			/* MSM_NAND_FLASH_STATUS + MSM_NAND_BUFFER_STATUS */
-			cmd->len = 8;
-			cmd++;
-
-			/* read data block
-			 * (only valid if status says success)
-			 */
-			if (ops->datbuf) {
-				if (ops->mode != MTD_OOB_RAW)
-					sectordatasize = (n < (cwperpage - 1))
-					? 516 : (512 - ((cwperpage - 1) << 2));
-				else
-					sectordatasize = 528;
-
-				cmd->cmd = 0;
-				cmd->src = MSM_NAND_FLASH_BUFFER;
-				cmd->dst = data_dma_addr_curr;
-				data_dma_addr_curr += sectordatasize;
-				cmd->len = sectordatasize;
-				cmd++;
-			}
-
-			if (ops->oobbuf && (n == (cwperpage - 1)
-			     || ops->mode != MTD_OOB_AUTO)) {
-				cmd->cmd = 0;
-				if (n == (cwperpage - 1)) {
-					cmd->src = MSM_NAND_FLASH_BUFFER +
-						(512 - ((cwperpage - 1) << 2));
-					sectoroobsize = (cwperpage << 2);
-					if (ops->mode != MTD_OOB_AUTO)
-						sectoroobsize += 10;
-				} else {
-					cmd->src = MSM_NAND_FLASH_BUFFER + 516;
-					sectoroobsize = 10;
-				}
-
-				cmd->dst = oob_dma_addr_curr;
-				if (sectoroobsize < oob_len)
-					cmd->len = sectoroobsize;
-				else
-					cmd->len = oob_len;
-				oob_dma_addr_curr += cmd->len;
-				oob_len -= cmd->len;
-				if (cmd->len > 0)
-					cmd++;
-			}
-		}
-
-		BUILD_BUG_ON(8 * 5 + 2 != ARRAY_SIZE(dma_buffer->cmd));
-		BUG_ON(cmd - dma_buffer->cmd > ARRAY_SIZE(dma_buffer->cmd));
-		dma_buffer->cmd[0].cmd |= CMD_OCB;
-		cmd[-1].cmd |= CMD_OCU | CMD_LC;
-
-		dma_buffer->cmdptr =
-			(msm_virt_to_dma(chip, dma_buffer->cmd) >> 3)
-			| CMD_PTR_LP;
-
-		dsb();
-		msm_dmov_exec_cmd(chip->dma_channel, crci_mask,
-			DMOV_CMD_PTR_LIST | DMOV_CMD_ADDR(msm_virt_to_dma(chip,
-			&dma_buffer->cmdptr)));
-		dsb();
-
-		/* if any of the writes failed (0x10), or there
-		 * was a protection violation (0x100), we lose
-		 */
-		pageerr = rawerr = 0;
-		for (n = start_sector; n < cwperpage; n++) {
-			if (dma_buffer->data.result[n].flash_status & 0x110) {
-				rawerr = -EIO;
-				break;
-			}
-		}
-		if (rawerr) {
-			if (ops->datbuf && ops->mode != MTD_OOB_RAW) {
-				uint8_t *datbuf = ops->datbuf +
-					pages_read * mtd->writesize;
-
-				dma_sync_single_for_cpu(chip->dev,
-					data_dma_addr_curr-mtd->writesize,
-					mtd->writesize, DMA_BIDIRECTIONAL);
-
-				for (n = 0; n < mtd->writesize; n++) {
-					/* empty blocks read 0x54 at
-					 * these offsets
-					 */
-					if (n % 516 == 3 && datbuf[n] == 0x54)
-						datbuf[n] = 0xff;
-					if (datbuf[n] != 0xff) {
-						pageerr = rawerr;
-						break;
-					}
-				}
-
-				dma_sync_single_for_device(chip->dev,
-					data_dma_addr_curr-mtd->writesize,
-					mtd->writesize, DMA_BIDIRECTIONAL);
-
-			}
-			if (ops->oobbuf) {
-				dma_sync_single_for_cpu(chip->dev,
-				oob_dma_addr_curr - (ops->ooblen - oob_len),
-				ops->ooblen - oob_len, DMA_BIDIRECTIONAL);
-
-				for (n = 0; n < ops->ooblen; n++) {
-					if (ops->oobbuf[n] != 0xff) {
-						pageerr = rawerr;
-						break;
-					}
-				}
-
-				dma_sync_single_for_device(chip->dev,
-				oob_dma_addr_curr - (ops->ooblen - oob_len),
-				ops->ooblen - oob_len, DMA_BIDIRECTIONAL);
-			}
-		}
-		if (pageerr) {
-			for (n = start_sector; n < cwperpage; n++) {
-				if (dma_buffer->data.result[n].buffer_status
-						& 0x8) {
-					/* not thread safe */
-					mtd->ecc_stats.failed++;
-					pageerr = -EBADMSG;
-					break;
-				}
-			}
-		}
-		if (!rawerr) { /* check for corretable errors */
-			for (n = start_sector; n < cwperpage; n++) {
-				ecc_errors = dma_buffer->data.
-					result[n].buffer_status & 0x7;
-				if (ecc_errors) {
-					total_ecc_errors += ecc_errors;
-					/* not thread safe */
-					mtd->ecc_stats.corrected += ecc_errors;
-					if (ecc_errors > 1)
-						pageerr = -EUCLEAN;
-				}
-			}
-		}
-		if (pageerr && (pageerr != -EUCLEAN || err == 0))
-			err = pageerr;
-
-#if VERBOSE
-		if (rawerr && !pageerr) {
-			pr_err("msm_nand_read_oob %llx %x %x empty page\n",
-			       (loff_t)page * mtd->writesize, ops->len,
-			       ops->ooblen);
-		} else {
-			for (n = start_sector; n < cwperpage; n++)
-				pr_info("flash_status[%d] = %x,\
-				buffr_status[%d] = %x\n",
-				n, dma_buffer->data.result[n].flash_status,
-				n, dma_buffer->data.result[n].buffer_status);
-		}
-#endif
-		if (err && err != -EUCLEAN && err != -EBADMSG)
-			break;
-		pages_read++;
-		page++;
-	}
-	msm_nand_release_dma_buffer(chip, dma_buffer, sizeof(*dma_buffer));
-
-	if (ops->oobbuf) {
-		dma_unmap_page(chip->dev, oob_dma_addr,
-				 ops->ooblen, DMA_FROM_DEVICE);
-	}
-err_dma_map_oobbuf_failed:
-	if (ops->datbuf) {
-		dma_unmap_page(chip->dev, data_dma_addr,
-				 ops->len, DMA_BIDIRECTIONAL);
-	}
-
-	if (ops->mode != MTD_OOB_RAW)
-		ops->retlen = mtd->writesize * pages_read;
-	else
-		ops->retlen = (mtd->writesize +  mtd->oobsize) *
-							pages_read;
-	ops->oobretlen = ops->ooblen - oob_len;
-	if (err)
-		pr_err("msm_nand_read_oob %llx %x %x failed %d, corrected %d\n",
-		       from, ops->datbuf ? ops->len : 0, ops->ooblen, err,
-		       total_ecc_errors);
-#if VERBOSE
-	pr_info("\n%s: ret %d, retlen %d oobretlen %d\n",
-			__func__, err, ops->retlen, ops->oobretlen);
+	if (ops->mode != MTD_OOB_RAW)
+		ops->retlen = mtd->writesize * pages_read;
+	else
+		ops->retlen = (mtd->writesize +  mtd->oobsize) *
+							pages_read;
+	ops->oobretlen = oob_read;
+	if (err)
+		pr_err("msm_nand_read_oob %llx %x %x failed %d, corrected %d\n",
+		       from, ops->datbuf ? ops->len : 0, ops->ooblen, err,
+		       total_ecc_errors);
+#if VERBOSE
+	pr_info("\n%s: ret %d, retlen %d oobretlen %d\n",
+			__func__, err, ops->retlen, ops->oobretlen);
 
 	pr_info("==================================================="
 			"==============\n");
@@ -1137,455 +1338,428 @@ err_dma_map_oobbuf_failed:
 	return err;
 }
 
-static int msm_nand_read_oob_dualnandc(struct mtd_info *mtd, loff_t from,
-			struct mtd_oob_ops *ops)
+/* Each read_oob and write_oob call is one MSM_LATENCY_NAND request */
+static int msm_nand_read_oob(struct mtd_info *mtd, loff_t from,
+			     struct mtd_oob_ops *ops)
 {
-	struct msm_nand_chip *chip = mtd->priv;
+	u64 start;
+	int ret;
+
+	start = msm_latency_start(MSM_LATENCY_NAND, (unsigned long)ops);
+	ret = __msm_nand_read_oob(mtd, from, ops);
+	msm_latency_done(MSM_LATENCY_NAND, (unsigned long)ops, start, ret);
+	return ret;
+}
 
+/* Command list and results for reading one page with both controllers,
+ * see msm_nand_read_oob_dualnandc()
+ */
+struct msm_nand_read_dualnandc_dma {
+	dmov_s cmd[16 * 6 + 20];
+	unsigned cmdptr;
 	struct {
-		dmov_s cmd[16 * 6 + 20];
-		unsigned cmdptr;
+		uint32_t cmd;
+		uint32_t nandc01_addr0;
+		uint32_t nandc10_addr0;
+		uint32_t nandc11_addr1;
+		uint32_t chipsel_cs0;
+		uint32_t chipsel_cs1;
+		uint32_t cfg0;
+		uint32_t cfg1;
+		uint32_t exec;
+		uint32_t ecccfg;
+		uint32_t ebi2_chip_select_cfg0;
+		uint32_t adm_mux_data_ack_req_nc01;
+		uint32_t adm_mux_cmd_ack_req_nc01;
+		uint32_t adm_mux_data_ack_req_nc10;
+		uint32_t adm_mux_cmd_ack_req_nc10;
+		uint32_t adm_default_mux;
+		uint32_t default_ebi2_chip_select_cfg0;
+		uint32_t nc10_flash_dev_cmd_vld;
+		uint32_t nc10_flash_dev_cmd1;
+		uint32_t nc10_flash_dev_cmd_vld_default;
+		uint32_t nc10_flash_dev_cmd1_default;
 		struct {
-			uint32_t cmd;
-			uint32_t nandc01_addr0;
-			uint32_t nandc10_addr0;
-			uint32_t nandc11_addr1;
-			uint32_t chipsel_cs0;
-			uint32_t chipsel_cs1;
-			uint32_t cfg0;
-			uint32_t cfg1;
-			uint32_t exec;
-			uint32_t ecccfg;
-			uint32_t ebi2_chip_select_cfg0;
-			uint32_t adm_mux_data_ack_req_nc01;
-			uint32_t adm_mux_cmd_ack_req_nc01;
-			uint32_t adm_mux_data_ack_req_nc10;
-			uint32_t adm_mux_cmd_ack_req_nc10;
-			uint32_t adm_default_mux;
-			uint32_t default_ebi2_chip_select_cfg0;
-			uint32_t nc10_flash_dev_cmd_vld;
-			uint32_t nc10_flash_dev_cmd1;
-			uint32_t nc10_flash_dev_cmd_vld_default;
-			uint32_t nc10_flash_dev_cmd1_default;
-			struct {
-				uint32_t flash_status;
-				uint32_t buffer_status;
-			} result[16];
-		} data;
-	} *dma_buffer;
-	dmov_s *cmd;
-	unsigned n;
-	unsigned page = 0;
-	uint32_t oob_len;
+			uint32_t flash_status;
+			uint32_t buffer_status;
+		} result[16];
+	} data;
+} __aligned(8);
+
+static void
+msm_nand_read_dualnandc_prep(struct mtd_info *mtd, struct mtd_oob_ops *ops,
+			     struct msm_nand_read_dualnandc_dma *dma_buffer,
+			     unsigned page, uint32_t oob_col,
+			     unsigned start_sector,
+			     dma_addr_t *data_dma_addr_curr,
+			     dma_addr_t *oob_dma_addr_curr,
+			     uint32_t *oob_len)
+{
+	struct msm_nand_chip *chip = mtd->priv;
+	unsigned cwperpage = (mtd->writesize >> 9);
 	uint32_t sectordatasize;
 	uint32_t sectoroobsize;
-	int err, pageerr, rawerr;
-	dma_addr_t data_dma_addr = 0;
-	dma_addr_t oob_dma_addr = 0;
-	dma_addr_t data_dma_addr_curr = 0;
-	dma_addr_t oob_dma_addr_curr = 0;
-	uint32_t oob_col = 0;
-	unsigned page_count;
-	unsigned pages_read = 0;
-	unsigned start_sector = 0;
-	uint32_t ecc_errors;
-	uint32_t total_ecc_errors = 0;
-	unsigned cwperpage;
-#if VERBOSE
-		pr_info("================================================="
-				"============\n");
-		pr_info("%s:\nfrom 0x%llx mode %d\ndatbuf 0x%p datlen 0x%x"
-				"\noobbuf 0x%p ooblen 0x%x\n\n",
-				__func__, from, ops->mode, ops->datbuf,
-				ops->len, ops->oobbuf, ops->ooblen);
-#endif
-
-	if (mtd->writesize == 2048)
-		page = from >> 11;
-
-	if (mtd->writesize == 4096)
-		page = from >> 12;
-
-	if (interleave_enable)
-		page = (from >> 1) >> 12;
-
-	oob_len = ops->ooblen;
-	cwperpage = (mtd->writesize >> 9);
+	dmov_s *cmd = dma_buffer->cmd;
+	unsigned n;
 
-	if (from & (mtd->writesize - 1)) {
-		pr_err("%s: unsupported from, 0x%llx\n",
-		       __func__, from);
-		return -EINVAL;
-	}
 	if (ops->mode != MTD_OOB_RAW) {
-		if (ops->datbuf != NULL && (ops->len % mtd->writesize) != 0) {
-			pr_err("%s: unsupported ops->len, %d\n",
-			       __func__, ops->len);
-			return -EINVAL;
+		dma_buffer->data.cmd = MSM_NAND_CMD_PAGE_READ_ECC;
+		if (start_sector == (cwperpage - 1)) {
+			dma_buffer->data.cfg0 = (chip->CFG0 &
+						~(7U << 6));
+		} else {
+			dma_buffer->data.cfg0 = (chip->CFG0 &
+			~(7U << 6))
+			| (((cwperpage >> 1)-1) << 6);
 		}
+		dma_buffer->data.cfg1 = chip->CFG1;
 	} else {
-		if (ops->datbuf != NULL &&
-			(ops->len % (mtd->writesize + mtd->oobsize)) != 0) {
-			pr_err("%s: unsupported ops->len,"
-				" %d for MTD_OOB_RAW\n", __func__, ops->len);
-			return -EINVAL;
-		}
-	}
-
-	if (ops->mode != MTD_OOB_RAW && ops->ooblen != 0 && ops->ooboffs != 0) {
-		pr_err("%s: unsupported ops->ooboffs, %d\n",
-		       __func__, ops->ooboffs);
-		return -EINVAL;
+		dma_buffer->data.cmd = MSM_NAND_CMD_PAGE_READ;
+		dma_buffer->data.cfg0 = ((MSM_NAND_CFG0_RAW &
+			~(7U << 6)) | ((((cwperpage >> 1)-1) << 6)));
+		dma_buffer->data.cfg1 = MSM_NAND_CFG1_RAW |
+				(chip->CFG1 & CFG1_WIDE_FLASH);
 	}
 
-	if (ops->oobbuf && !ops->datbuf && ops->mode == MTD_OOB_AUTO)
-		start_sector = cwperpage - 1;
-
-	if (ops->oobbuf && !ops->datbuf) {
-		page_count = ops->ooblen / ((ops->mode == MTD_OOB_AUTO) ?
-			mtd->oobavail : mtd->oobsize);
-		if ((page_count == 0) && (ops->ooblen))
-			page_count = 1;
-	} else if (ops->mode != MTD_OOB_RAW)
-		page_count = ops->len / mtd->writesize;
-	else
-		page_count = ops->len / (mtd->writesize + mtd->oobsize);
-
-	if (ops->datbuf) {
-		data_dma_addr_curr = data_dma_addr =
-			msm_nand_dma_map(chip->dev, ops->datbuf, ops->len,
-				       DMA_FROM_DEVICE);
-		if (dma_mapping_error(chip->dev, data_dma_addr)) {
-			pr_err("msm_nand_read_oob_dualnandc: "
-				"failed to get dma addr for %p\n",
-				ops->datbuf);
-			return -EIO;
-		}
-	}
-	if (ops->oobbuf) {
-		memset(ops->oobbuf, 0xff, ops->ooblen);
-		oob_dma_addr_curr = oob_dma_addr =
-			msm_nand_dma_map(chip->dev, ops->oobbuf,
-				       ops->ooblen, DMA_BIDIRECTIONAL);
-		if (dma_mapping_error(chip->dev, oob_dma_addr)) {
-			pr_err("msm_nand_read_oob_dualnandc: "
-				"failed to get dma addr for %p\n",
-				ops->oobbuf);
-			err = -EIO;
-			goto err_dma_map_oobbuf_failed;
+	if (!interleave_enable) {
+		if (start_sector == (cwperpage - 1)) {
+			dma_buffer->data.nandc10_addr0 =
+						(page << 16) | oob_col;
+			dma_buffer->data.nc10_flash_dev_cmd_vld = 0xD;
+			dma_buffer->data.nc10_flash_dev_cmd1 =
+							0xF00F3000;
+		} else {
+			dma_buffer->data.nandc01_addr0 = page << 16;
+			dma_buffer->data.nandc10_addr0 = (page << 16) |
+								 0x108;
+			dma_buffer->data.nc10_flash_dev_cmd_vld = 0x1D;
+			dma_buffer->data.nc10_flash_dev_cmd1 =
+							0xF00FE005;
 		}
+	} else {
+		dma_buffer->data.nandc01_addr0 =
+		dma_buffer->data.nandc10_addr0 =
+					(page << 16) | oob_col;
 	}
+	/* ADDR1 */
+	dma_buffer->data.nandc11_addr1 = (page >> 16) & 0xff;
 
-	wait_event(chip->wait_queue,
-		   (dma_buffer = msm_nand_get_dma_buffer(
-			    chip, sizeof(*dma_buffer))));
-
-	oob_col = start_sector * 0x210;
-	if (chip->CFG1 & CFG1_WIDE_FLASH)
-		oob_col >>= 1;
+	dma_buffer->data.adm_mux_data_ack_req_nc01 = 0x00000A3C;
+	dma_buffer->data.adm_mux_cmd_ack_req_nc01  = 0x0000053C;
+	dma_buffer->data.adm_mux_data_ack_req_nc10 = 0x00000F28;
+	dma_buffer->data.adm_mux_cmd_ack_req_nc10  = 0x00000F14;
+	dma_buffer->data.adm_default_mux = 0x00000FC0;
+	dma_buffer->data.nc10_flash_dev_cmd_vld_default = 0x1D;
+	dma_buffer->data.nc10_flash_dev_cmd1_default = 0xF00F3000;
 
-	err = 0;
-	while (page_count-- > 0) {
-		cmd = dma_buffer->cmd;
+	dma_buffer->data.ebi2_chip_select_cfg0 = 0x00000805;
+	dma_buffer->data.default_ebi2_chip_select_cfg0 = 0x00000801;
 
-		if (ops->mode != MTD_OOB_RAW) {
-			dma_buffer->data.cmd = MSM_NAND_CMD_PAGE_READ_ECC;
-			if (start_sector == (cwperpage - 1)) {
-				dma_buffer->data.cfg0 = (chip->CFG0 &
-							~(7U << 6));
-			} else {
-				dma_buffer->data.cfg0 = (chip->CFG0 &
-				~(7U << 6))
-				| (((cwperpage >> 1)-1) << 6);
-			}
-			dma_buffer->data.cfg1 = chip->CFG1;
-		} else {
-			dma_buffer->data.cmd = MSM_NAND_CMD_PAGE_READ;
-			dma_buffer->data.cfg0 = ((MSM_NAND_CFG0_RAW &
-				~(7U << 6)) | ((((cwperpage >> 1)-1) << 6)));
-			dma_buffer->data.cfg1 = MSM_NAND_CFG1_RAW |
-					(chip->CFG1 & CFG1_WIDE_FLASH);
-		}
+	/* chipsel_0 + enable DM interface */
+	dma_buffer->data.chipsel_cs0 = (1<<4) | 4;
+	/* chipsel_1 + enable DM interface */
+	dma_buffer->data.chipsel_cs1 = (1<<4) | 5;
 
-		if (!interleave_enable) {
-			if (start_sector == (cwperpage - 1)) {
-				dma_buffer->data.nandc10_addr0 =
-							(page << 16) | oob_col;
-				dma_buffer->data.nc10_flash_dev_cmd_vld = 0xD;
-				dma_buffer->data.nc10_flash_dev_cmd1 =
-								0xF00F3000;
-			} else {
-				dma_buffer->data.nandc01_addr0 = page << 16;
-				dma_buffer->data.nandc10_addr0 = (page << 16) |
-									 0x108;
-				dma_buffer->data.nc10_flash_dev_cmd_vld = 0x1D;
-				dma_buffer->data.nc10_flash_dev_cmd1 =
-								0xF00FE005;
-			}
-		} else {
-			dma_buffer->data.nandc01_addr0 =
-			dma_buffer->data.nandc10_addr0 =
-						(page << 16) | oob_col;
-		}
-		/* ADDR1 */
-		dma_buffer->data.nandc11_addr1 = (page >> 16) & 0xff;
+	/* GO bit for the EXEC register */
+	dma_buffer->data.exec = 1;
 
-		dma_buffer->data.adm_mux_data_ack_req_nc01 = 0x00000A3C;
-		dma_buffer->data.adm_mux_cmd_ack_req_nc01  = 0x0000053C;
-		dma_buffer->data.adm_mux_data_ack_req_nc10 = 0x00000F28;
-		dma_buffer->data.adm_mux_cmd_ack_req_nc10  = 0x00000F14;
-		dma_buffer->data.adm_default_mux = 0x00000FC0;
-		dma_buffer->data.nc10_flash_dev_cmd_vld_default = 0x1D;
-		dma_buffer->data.nc10_flash_dev_cmd1_default = 0xF00F3000;
+	BUILD_BUG_ON(16 != ARRAY_SIZE(dma_buffer->data.result));
 
-		dma_buffer->data.ebi2_chip_select_cfg0 = 0x00000805;
-		dma_buffer->data.default_ebi2_chip_select_cfg0 = 0x00000801;
+	for (n = start_sector; n < cwperpage; n++) {
+		/* flash + buffer status return words */
+		dma_buffer->data.result[n].flash_status = 0xeeeeeeee;
+		dma_buffer->data.result[n].buffer_status = 0xeeeeeeee;
 
-		/* chipsel_0 + enable DM interface */
-		dma_buffer->data.chipsel_cs0 = (1<<4) | 4;
-		/* chipsel_1 + enable DM interface */
-		dma_buffer->data.chipsel_cs1 = (1<<4) | 5;
+		if (n == start_sector) {
+			if (!interleave_enable) {
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->
+					data.nc10_flash_dev_cmd_vld);
+				cmd->dst = NC10(MSM_NAND_DEV_CMD_VLD);
+				cmd->len = 4;
+				cmd++;
 
-		/* GO bit for the EXEC register */
-		dma_buffer->data.exec = 1;
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->data.nc10_flash_dev_cmd1);
+				cmd->dst = NC10(MSM_NAND_DEV_CMD1);
+				cmd->len = 4;
+				cmd++;
 
-		BUILD_BUG_ON(16 != ARRAY_SIZE(dma_buffer->data.result));
+				/* NC01, NC10 --> ADDR1 */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->data.nandc11_addr1);
+				cmd->dst = NC11(MSM_NAND_ADDR1);
+				cmd->len = 8;
+				cmd++;
 
-		for (n = start_sector; n < cwperpage; n++) {
-			/* flash + buffer status return words */
-			dma_buffer->data.result[n].flash_status = 0xeeeeeeee;
-			dma_buffer->data.result[n].buffer_status = 0xeeeeeeee;
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+					&dma_buffer->data.cfg0);
+				cmd->dst = NC11(MSM_NAND_DEV0_CFG0);
+				cmd->len = 8;
+				cmd++;
+			} else {
+				/* enable CS0 & CS1 */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->
+					data.ebi2_chip_select_cfg0);
+				cmd->dst = EBI2_CHIP_SELECT_CFG0;
+				cmd->len = 4;
+				cmd++;
 
-			if (n == start_sector) {
-				if (!interleave_enable) {
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->
-						data.nc10_flash_dev_cmd_vld);
-					cmd->dst = NC10(MSM_NAND_DEV_CMD_VLD);
-					cmd->len = 4;
-					cmd++;
+				/* NC01, NC10 --> ADDR1 */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->data.nandc11_addr1);
+				cmd->dst = NC11(MSM_NAND_ADDR1);
+				cmd->len = 4;
+				cmd++;
 
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->data.nc10_flash_dev_cmd1);
-					cmd->dst = NC10(MSM_NAND_DEV_CMD1);
-					cmd->len = 4;
-					cmd++;
+				/* Enable CS0 for NC01 */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->data.chipsel_cs0);
+				cmd->dst =
+				NC01(MSM_NAND_FLASH_CHIP_SELECT);
+				cmd->len = 4;
+				cmd++;
 
-					/* NC01, NC10 --> ADDR1 */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->data.nandc11_addr1);
-					cmd->dst = NC11(MSM_NAND_ADDR1);
-					cmd->len = 8;
-					cmd++;
+				/* Enable CS1 for NC10 */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->data.chipsel_cs1);
+				cmd->dst =
+				NC10(MSM_NAND_FLASH_CHIP_SELECT);
+				cmd->len = 4;
+				cmd++;
 
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-						&dma_buffer->data.cfg0);
-					cmd->dst = NC11(MSM_NAND_DEV0_CFG0);
-					cmd->len = 8;
-					cmd++;
-				} else {
-					/* enable CS0 & CS1 */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->
-						data.ebi2_chip_select_cfg0);
-					cmd->dst = EBI2_CHIP_SELECT_CFG0;
-					cmd->len = 4;
-					cmd++;
+				/* config DEV0_CFG0 & CFG1 for CS0 */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->data.cfg0);
+				cmd->dst = NC01(MSM_NAND_DEV0_CFG0);
+				cmd->len = 8;
+				cmd++;
 
-					/* NC01, NC10 --> ADDR1 */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->data.nandc11_addr1);
-					cmd->dst = NC11(MSM_NAND_ADDR1);
-					cmd->len = 4;
-					cmd++;
+				/* config DEV1_CFG0 & CFG1 for CS1 */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->data.cfg0);
+				cmd->dst = NC10(MSM_NAND_DEV1_CFG0);
+				cmd->len = 8;
+				cmd++;
+			}
 
-					/* Enable CS0 for NC01 */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->data.chipsel_cs0);
-					cmd->dst =
-					NC01(MSM_NAND_FLASH_CHIP_SELECT);
-					cmd->len = 4;
-					cmd++;
+			dma_buffer->data.ecccfg = chip->ecc_buf_cfg;
+			cmd->cmd = 0;
+			cmd->src = msm_virt_to_dma(chip,
+					&dma_buffer->data.ecccfg);
+			cmd->dst = NC11(MSM_NAND_EBI2_ECC_BUF_CFG);
+			cmd->len = 4;
+			cmd++;
 
-					/* Enable CS1 for NC10 */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->data.chipsel_cs1);
-					cmd->dst =
-					NC10(MSM_NAND_FLASH_CHIP_SELECT);
-					cmd->len = 4;
-					cmd++;
+			/* if 'only' the last code word */
+			if (n == cwperpage - 1) {
+				/* MASK CMD ACK/REQ --> NC01 (0x53C)*/
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->
+					data.adm_mux_cmd_ack_req_nc01);
+				cmd->dst = EBI2_NAND_ADM_MUX;
+				cmd->len = 4;
+				cmd++;
 
-					/* config DEV0_CFG0 & CFG1 for CS0 */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->data.cfg0);
-					cmd->dst = NC01(MSM_NAND_DEV0_CFG0);
-					cmd->len = 8;
-					cmd++;
+				/* CMD */
+				cmd->cmd = DST_CRCI_NAND_CMD;
+				cmd->src = msm_virt_to_dma(chip,
+						&dma_buffer->data.cmd);
+				cmd->dst = NC10(MSM_NAND_FLASH_CMD);
+				cmd->len = 4;
+				cmd++;
 
-					/* config DEV1_CFG0 & CFG1 for CS1 */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->data.cfg0);
-					cmd->dst = NC10(MSM_NAND_DEV1_CFG0);
-					cmd->len = 8;
-					cmd++;
-				}
+				/* NC10 --> ADDR0 ( 0x0 ) */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->data.nandc10_addr0);
+				cmd->dst = NC10(MSM_NAND_ADDR0);
+				cmd->len = 4;
+				cmd++;
 
-				dma_buffer->data.ecccfg = chip->ecc_buf_cfg;
+				/* kick the execute reg for NC10 */
 				cmd->cmd = 0;
 				cmd->src = msm_virt_to_dma(chip,
-						&dma_buffer->data.ecccfg);
-				cmd->dst = NC11(MSM_NAND_EBI2_ECC_BUF_CFG);
+					&dma_buffer->data.exec);
+				cmd->dst = NC10(MSM_NAND_EXEC_CMD);
 				cmd->len = 4;
 				cmd++;
 
-				/* if 'only' the last code word */
-				if (n == cwperpage - 1) {
-					/* MASK CMD ACK/REQ --> NC01 (0x53C)*/
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->
-						data.adm_mux_cmd_ack_req_nc01);
-					cmd->dst = EBI2_NAND_ADM_MUX;
-					cmd->len = 4;
-					cmd++;
+				/* MASK DATA ACK/REQ --> NC01 (0xA3C)*/
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->
+				data.adm_mux_data_ack_req_nc01);
+				cmd->dst = EBI2_NAND_ADM_MUX;
+				cmd->len = 4;
+				cmd++;
 
-					/* CMD */
-					cmd->cmd = DST_CRCI_NAND_CMD;
-					cmd->src = msm_virt_to_dma(chip,
-							&dma_buffer->data.cmd);
-					cmd->dst = NC10(MSM_NAND_FLASH_CMD);
-					cmd->len = 4;
-					cmd++;
+				/* block on data ready from NC10, then
+				 * read the status register
+				 */
+				cmd->cmd = SRC_CRCI_NAND_DATA;
+				cmd->src = NC10(MSM_NAND_FLASH_STATUS);
+				cmd->dst = msm_virt_to_dma(chip,
+					&dma_buffer->data.result[n]);
+				/* MSM_NAND_FLASH_STATUS +
+				 * MSM_NAND_BUFFER_STATUS
+				 */
+				cmd->len = 8;
+				cmd++;
+			} else {
+				/* NC01 --> ADDR0 */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->data.nandc01_addr0);
+				cmd->dst = NC01(MSM_NAND_ADDR0);
+				cmd->len = 4;
+				cmd++;
 
-					/* NC10 --> ADDR0 ( 0x0 ) */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->data.nandc10_addr0);
-					cmd->dst = NC10(MSM_NAND_ADDR0);
-					cmd->len = 4;
-					cmd++;
+				/* NC10 --> ADDR1 */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->data.nandc10_addr0);
+				cmd->dst = NC10(MSM_NAND_ADDR0);
+				cmd->len = 4;
+				cmd++;
 
-					/* kick the execute reg for NC10 */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-						&dma_buffer->data.exec);
-					cmd->dst = NC10(MSM_NAND_EXEC_CMD);
-					cmd->len = 4;
-					cmd++;
+				/* MASK CMD ACK/REQ --> NC10 (0xF14)*/
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->
+					data.adm_mux_cmd_ack_req_nc10);
+				cmd->dst = EBI2_NAND_ADM_MUX;
+				cmd->len = 4;
+				cmd++;
 
-					/* MASK DATA ACK/REQ --> NC01 (0xA3C)*/
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->
-					data.adm_mux_data_ack_req_nc01);
-					cmd->dst = EBI2_NAND_ADM_MUX;
-					cmd->len = 4;
-					cmd++;
+				/* CMD */
+				cmd->cmd = DST_CRCI_NAND_CMD;
+				cmd->src = msm_virt_to_dma(chip,
+						&dma_buffer->data.cmd);
+				cmd->dst = NC01(MSM_NAND_FLASH_CMD);
+				cmd->len = 4;
+				cmd++;
 
-					/* block on data ready from NC10, then
-					 * read the status register
-					 */
-					cmd->cmd = SRC_CRCI_NAND_DATA;
-					cmd->src = NC10(MSM_NAND_FLASH_STATUS);
-					cmd->dst = msm_virt_to_dma(chip,
-						&dma_buffer->data.result[n]);
-					/* MSM_NAND_FLASH_STATUS +
-					 * MSM_NAND_BUFFER_STATUS
-					 */
-					cmd->len = 8;
-					cmd++;
-				} else {
-					/* NC01 --> ADDR0 */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->data.nandc01_addr0);
-					cmd->dst = NC01(MSM_NAND_ADDR0);
-					cmd->len = 4;
-					cmd++;
+				/* kick the execute register for NC01*/
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+					 &dma_buffer->data.exec);
+				cmd->dst = NC01(MSM_NAND_EXEC_CMD);
+				cmd->len = 4;
+				cmd++;
+			}
+		}
 
-					/* NC10 --> ADDR1 */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->data.nandc10_addr0);
-					cmd->dst = NC10(MSM_NAND_ADDR0);
-					cmd->len = 4;
-					cmd++;
+		/* read data block
+		 * (only valid if status says success)
+		 */
+		if (ops->datbuf) {
+			if (ops->mode != MTD_OOB_RAW)
+				sectordatasize = (n < (cwperpage - 1))
+				? 516 : (512 - ((cwperpage - 1) << 2));
+			else
+				sectordatasize = 528;
 
-					/* MASK CMD ACK/REQ --> NC10 (0xF14)*/
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->
-						data.adm_mux_cmd_ack_req_nc10);
-					cmd->dst = EBI2_NAND_ADM_MUX;
-					cmd->len = 4;
-					cmd++;
+			if (n % 2 == 0) {
+				/* MASK DATA ACK/REQ --> NC10 (0xF28)*/
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->
+				data.adm_mux_data_ack_req_nc10);
+				cmd->dst = EBI2_NAND_ADM_MUX;
+				cmd->len = 4;
+				cmd++;
 
-					/* CMD */
-					cmd->cmd = DST_CRCI_NAND_CMD;
-					cmd->src = msm_virt_to_dma(chip,
-							&dma_buffer->data.cmd);
-					cmd->dst = NC01(MSM_NAND_FLASH_CMD);
-					cmd->len = 4;
-					cmd++;
+				/* block on data ready from NC01, then
+				 * read the status register
+				 */
+				cmd->cmd = SRC_CRCI_NAND_DATA;
+				cmd->src = NC01(MSM_NAND_FLASH_STATUS);
+				cmd->dst = msm_virt_to_dma(chip,
+					&dma_buffer->data.result[n]);
+				/* MSM_NAND_FLASH_STATUS +
+				 * MSM_NAND_BUFFER_STATUS
+				 */
+				cmd->len = 8;
+				cmd++;
 
-					/* kick the execute register for NC01*/
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-						 &dma_buffer->data.exec);
-					cmd->dst = NC01(MSM_NAND_EXEC_CMD);
-					cmd->len = 4;
-					cmd++;
-				}
-			}
+				/* MASK CMD ACK/REQ --> NC01 (0x53C)*/
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->
+					data.adm_mux_cmd_ack_req_nc01);
+				cmd->dst = EBI2_NAND_ADM_MUX;
+				cmd->len = 4;
+				cmd++;
 
-			/* read data block
-			 * (only valid if status says success)
-			 */
-			if (ops->datbuf) {
-				if (ops->mode != MTD_OOB_RAW)
-					sectordatasize = (n < (cwperpage - 1))
-					? 516 : (512 - ((cwperpage - 1) << 2));
-				else
-					sectordatasize = 528;
+				/* CMD */
+				cmd->cmd = DST_CRCI_NAND_CMD;
+				cmd->src = msm_virt_to_dma(chip,
+						&dma_buffer->data.cmd);
+				cmd->dst = NC10(MSM_NAND_FLASH_CMD);
+				cmd->len = 4;
+				cmd++;
 
-				if (n % 2 == 0) {
-					/* MASK DATA ACK/REQ --> NC10 (0xF28)*/
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->
-					data.adm_mux_data_ack_req_nc10);
-					cmd->dst = EBI2_NAND_ADM_MUX;
-					cmd->len = 4;
-					cmd++;
+				/* kick the execute register for NC10 */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+					&dma_buffer->data.exec);
+				cmd->dst = NC10(MSM_NAND_EXEC_CMD);
+				cmd->len = 4;
+				cmd++;
 
-					/* block on data ready from NC01, then
-					 * read the status register
-					 */
-					cmd->cmd = SRC_CRCI_NAND_DATA;
-					cmd->src = NC01(MSM_NAND_FLASH_STATUS);
-					cmd->dst = msm_virt_to_dma(chip,
-						&dma_buffer->data.result[n]);
-					/* MSM_NAND_FLASH_STATUS +
-					 * MSM_NAND_BUFFER_STATUS
-					 */
-					cmd->len = 8;
-					cmd++;
+				cmd->cmd = 0;
+				cmd->src = NC01(MSM_NAND_FLASH_BUFFER);
+				cmd->dst = *data_dma_addr_curr;
+				*data_dma_addr_curr += sectordatasize;
+				cmd->len = sectordatasize;
+				cmd++;
+			} else {
+				/* MASK DATA ACK/REQ -->
+				 * NC01 (0xA3C)
+				 */
+				cmd->cmd = 0;
+				cmd->src = msm_virt_to_dma(chip,
+				&dma_buffer->
+				data.adm_mux_data_ack_req_nc01);
+				cmd->dst = EBI2_NAND_ADM_MUX;
+				cmd->len = 4;
+				cmd++;
 
-					/* MASK CMD ACK/REQ --> NC01 (0x53C)*/
+				/* block on data ready from NC10
+				 * then read the status register
+				 */
+				cmd->cmd = SRC_CRCI_NAND_DATA;
+				cmd->src =
+				NC10(MSM_NAND_FLASH_STATUS);
+				cmd->dst = msm_virt_to_dma(chip,
+				   &dma_buffer->data.result[n]);
+				/* MSM_NAND_FLASH_STATUS +
+				 * MSM_NAND_BUFFER_STATUS
+				 */
+				cmd->len = 8;
+				cmd++;
+				if (n != cwperpage - 1) {
+					/* MASK CMD ACK/REQ -->
+					 * NC10 (0xF14)
+					 */
 					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
+					cmd->src =
+					msm_virt_to_dma(chip,
 					&dma_buffer->
-						data.adm_mux_cmd_ack_req_nc01);
+					data.adm_mux_cmd_ack_req_nc10);
 					cmd->dst = EBI2_NAND_ADM_MUX;
 					cmd->len = 4;
 					cmd++;
@@ -1593,279 +1767,403 @@ static int msm_nand_read_oob_dualnandc(struct mtd_info *mtd, loff_t from,
 					/* CMD */
 					cmd->cmd = DST_CRCI_NAND_CMD;
 					cmd->src = msm_virt_to_dma(chip,
-							&dma_buffer->data.cmd);
-					cmd->dst = NC10(MSM_NAND_FLASH_CMD);
+						&dma_buffer->data.cmd);
+					cmd->dst =
+					NC01(MSM_NAND_FLASH_CMD);
 					cmd->len = 4;
 					cmd++;
 
-					/* kick the execute register for NC10 */
+					/* EXEC */
 					cmd->cmd = 0;
 					cmd->src = msm_virt_to_dma(chip,
 						&dma_buffer->data.exec);
-					cmd->dst = NC10(MSM_NAND_EXEC_CMD);
-					cmd->len = 4;
-					cmd++;
-
-					cmd->cmd = 0;
-					cmd->src = NC01(MSM_NAND_FLASH_BUFFER);
-					cmd->dst = data_dma_addr_curr;
-					data_dma_addr_curr += sectordatasize;
-					cmd->len = sectordatasize;
-					cmd++;
-				} else {
-					/* MASK DATA ACK/REQ -->
-					 * NC01 (0xA3C)
-					 */
-					cmd->cmd = 0;
-					cmd->src = msm_virt_to_dma(chip,
-					&dma_buffer->
-					data.adm_mux_data_ack_req_nc01);
-					cmd->dst = EBI2_NAND_ADM_MUX;
+					cmd->dst =
+					NC01(MSM_NAND_EXEC_CMD);
 					cmd->len = 4;
 					cmd++;
-
-					/* block on data ready from NC10
-					 * then read the status register
-					 */
-					cmd->cmd = SRC_CRCI_NAND_DATA;
-					cmd->src =
-					NC10(MSM_NAND_FLASH_STATUS);
-					cmd->dst = msm_virt_to_dma(chip,
-					   &dma_buffer->data.result[n]);
-					/* MSM_NAND_FLASH_STATUS +
-					 * MSM_NAND_BUFFER_STATUS
-					 */
-					cmd->len = 8;
-					cmd++;
-					if (n != cwperpage - 1) {
-						/* MASK CMD ACK/REQ -->
-						 * NC10 (0xF14)
-						 */
-						cmd->cmd = 0;
-						cmd->src =
-						msm_virt_to_dma(chip,
-						&dma_buffer->
-						data.adm_mux_cmd_ack_req_nc10);
-						cmd->dst = EBI2_NAND_ADM_MUX;
-						cmd->len = 4;
-						cmd++;
-
-						/* CMD */
-						cmd->cmd = DST_CRCI_NAND_CMD;
-						cmd->src = msm_virt_to_dma(chip,
-							&dma_buffer->data.cmd);
-						cmd->dst =
-						NC01(MSM_NAND_FLASH_CMD);
-						cmd->len = 4;
-						cmd++;
-
-						/* EXEC */
-						cmd->cmd = 0;
-						cmd->src = msm_virt_to_dma(chip,
-							&dma_buffer->data.exec);
-						cmd->dst =
-						NC01(MSM_NAND_EXEC_CMD);
-						cmd->len = 4;
-						cmd++;
-					}
-					cmd->cmd = 0;
-					cmd->src = NC10(MSM_NAND_FLASH_BUFFER);
-					cmd->dst = data_dma_addr_curr;
-					data_dma_addr_curr += sectordatasize;
-					cmd->len = sectordatasize;
-					cmd++;
 				}
+				cmd->cmd = 0;
+				cmd->src = NC10(MSM_NAND_FLASH_BUFFER);
+				cmd->dst = *data_dma_addr_curr;
+				*data_dma_addr_curr += sectordatasize;
+				cmd->len = sectordatasize;
+				cmd++;
 			}
+		}
 
-			if (ops->oobbuf && (n == (cwperpage - 1)
-			     || ops->mode != MTD_OOB_AUTO)) {
-				cmd->cmd = 0;
-				if (n == (cwperpage - 1)) {
-					/* Use NC10 for reading the
-					 * last codeword!!!
-					 */
-					cmd->src = NC10(MSM_NAND_FLASH_BUFFER) +
-						(512 - ((cwperpage - 1) << 2));
-					sectoroobsize = (cwperpage << 2);
-					if (ops->mode != MTD_OOB_AUTO)
-						sectoroobsize += 10;
+		if (ops->oobbuf && (n == (cwperpage - 1)
+		     || ops->mode != MTD_OOB_AUTO)) {
+			cmd->cmd = 0;
+			if (n == (cwperpage - 1)) {
+				/* Use NC10 for reading the
+				 * last codeword!!!
+				 */
+				cmd->src = NC10(MSM_NAND_FLASH_BUFFER) +
+					(512 - ((cwperpage - 1) << 2));
+				sectoroobsize = (cwperpage << 2);
+				if (ops->mode != MTD_OOB_AUTO)
+					sectoroobsize += 10;
+			} else {
+				if (n % 2 == 0) {
+					cmd->src =
+					NC01(MSM_NAND_FLASH_BUFFER)
+					+ 516;
+					sectoroobsize = 10;
 				} else {
-					if (n % 2 == 0) {
-						cmd->src =
-						NC01(MSM_NAND_FLASH_BUFFER)
-						+ 516;
-						sectoroobsize = 10;
-					} else {
-						cmd->src =
-						NC10(MSM_NAND_FLASH_BUFFER)
-						+ 516;
-						sectoroobsize = 10;
-					}
+					cmd->src =
+					NC10(MSM_NAND_FLASH_BUFFER)
+					+ 516;
+					sectoroobsize = 10;
 				}
-				cmd->dst = oob_dma_addr_curr;
-				if (sectoroobsize < oob_len)
-					cmd->len = sectoroobsize;
-				else
-					cmd->len = oob_len;
-				oob_dma_addr_curr += cmd->len;
-				oob_len -= cmd->len;
-				if (cmd->len > 0)
-					cmd++;
 			}
+			cmd->dst = *oob_dma_addr_curr;
+			if (sectoroobsize < *oob_len)
+				cmd->len = sectoroobsize;
+			else
+				cmd->len = *oob_len;
+			*oob_dma_addr_curr += cmd->len;
+			*oob_len -= cmd->len;
+			if (cmd->len > 0)
+				cmd++;
 		}
-		/* ADM --> Default mux state (0xFC0) */
+	}
+	/* ADM --> Default mux state (0xFC0) */
+	cmd->cmd = 0;
+	cmd->src = msm_virt_to_dma(chip,
+		&dma_buffer->data.adm_default_mux);
+	cmd->dst = EBI2_NAND_ADM_MUX;
+	cmd->len = 4;
+	cmd++;
+
+	if (!interleave_enable) {
 		cmd->cmd = 0;
 		cmd->src = msm_virt_to_dma(chip,
-			&dma_buffer->data.adm_default_mux);
-		cmd->dst = EBI2_NAND_ADM_MUX;
+		&dma_buffer->data.nc10_flash_dev_cmd_vld_default);
+		cmd->dst = NC10(MSM_NAND_DEV_CMD_VLD);
 		cmd->len = 4;
 		cmd++;
 
-		if (!interleave_enable) {
-			cmd->cmd = 0;
-			cmd->src = msm_virt_to_dma(chip,
-			&dma_buffer->data.nc10_flash_dev_cmd_vld_default);
-			cmd->dst = NC10(MSM_NAND_DEV_CMD_VLD);
-			cmd->len = 4;
-			cmd++;
-
-			cmd->cmd = 0;
-			cmd->src = msm_virt_to_dma(chip,
-			&dma_buffer->data.nc10_flash_dev_cmd1_default);
-			cmd->dst = NC10(MSM_NAND_DEV_CMD1);
-			cmd->len = 4;
-			cmd++;
-		} else {
-			/* disable CS1 */
-			cmd->cmd = 0;
-			cmd->src = msm_virt_to_dma(chip,
-			&dma_buffer->data.default_ebi2_chip_select_cfg0);
-			cmd->dst = EBI2_CHIP_SELECT_CFG0;
-			cmd->len = 4;
-			cmd++;
-		}
+		cmd->cmd = 0;
+		cmd->src = msm_virt_to_dma(chip,
+		&dma_buffer->data.nc10_flash_dev_cmd1_default);
+		cmd->dst = NC10(MSM_NAND_DEV_CMD1);
+		cmd->len = 4;
+		cmd++;
+	} else {
+		/* disable CS1 */
+		cmd->cmd = 0;
+		cmd->src = msm_virt_to_dma(chip,
+		&dma_buffer->data.default_ebi2_chip_select_cfg0);
+		cmd->dst = EBI2_CHIP_SELECT_CFG0;
+		cmd->len = 4;
+		cmd++;
+	}
 
-		BUILD_BUG_ON(16 * 6 + 20 != ARRAY_SIZE(dma_buffer->cmd));
-		BUG_ON(cmd - dma_buffer->cmd > ARRAY_SIZE(dma_buffer->cmd));
-		dma_buffer->cmd[0].cmd |= CMD_OCB;
-		cmd[-1].cmd |= CMD_OCU | CMD_LC;
+	BUILD_BUG_ON(16 * 6 + 20 != ARRAY_SIZE(dma_buffer->cmd));
+	BUG_ON(cmd - dma_buffer->cmd > ARRAY_SIZE(dma_buffer->cmd));
+	dma_buffer->cmd[0].cmd |= CMD_OCB;
+	cmd[-1].cmd |= CMD_OCU | CMD_LC;
 
-		dma_buffer->cmdptr =
-			(msm_virt_to_dma(chip, dma_buffer->cmd) >> 3)
-			| CMD_PTR_LP;
+	dma_buffer->cmdptr =
+		(msm_virt_to_dma(chip, dma_buffer->cmd) >> 3)
+		| CMD_PTR_LP;
+}
 
-		dsb();
-		msm_dmov_exec_cmd(chip->dma_channel, crci_mask,
-			DMOV_CMD_PTR_LIST | DMOV_CMD_ADDR(msm_virt_to_dma(chip,
-			&dma_buffer->cmdptr)));
-		dsb();
+/* Check the results of a page read by both controllers, as for
+ * msm_nand_read_check()
+ */
+static int
+msm_nand_read_dualnandc_check(struct mtd_info *mtd, struct mtd_oob_ops *ops,
+			      struct msm_nand_read_req *req,
+			      unsigned start_sector,
+			      uint32_t *total_ecc_errors)
+{
+	struct msm_nand_chip *chip = mtd->priv;
+	struct msm_nand_read_dualnandc_dma *dma_buffer = req->dma_buffer;
+	unsigned cwperpage = (mtd->writesize >> 9);
+	uint32_t ecc_errors;
+	int pageerr, rawerr;
+	unsigned n;
 
-		/* if any of the writes failed (0x10), or there
-		 * was a protection violation (0x100), we lose
-		 */
-		pageerr = rawerr = 0;
-		for (n = start_sector; n < cwperpage; n++) {
-			if (dma_buffer->data.result[n].flash_status & 0x110) {
-				rawerr = -EIO;
-				break;
-			}
+	/* if any of the writes failed (0x10), or there
+	 * was a protection violation (0x100), we lose
+	 */
+	pageerr = rawerr = 0;
+	for (n = start_sector; n < cwperpage; n++) {
+		if (dma_buffer->data.result[n].flash_status & 0x110) {
+			rawerr = -EIO;
+			break;
 		}
-		if (rawerr) {
-			if (ops->datbuf && ops->mode != MTD_OOB_RAW) {
-				uint8_t *datbuf = ops->datbuf +
-					pages_read * mtd->writesize;
-
-				dma_sync_single_for_cpu(chip->dev,
-					data_dma_addr_curr-mtd->writesize,
-					mtd->writesize, DMA_BIDIRECTIONAL);
-
-				for (n = 0; n < mtd->writesize; n++) {
-					/* empty blocks read 0x54 at
-					 * these offsets
-					 */
-					if (n % 516 == 3 && datbuf[n] == 0x54)
-						datbuf[n] = 0xff;
-					if (datbuf[n] != 0xff) {
-						pageerr = rawerr;
-						break;
-					}
-				}
+	}
+	if (rawerr) {
+		if (ops->datbuf && ops->mode != MTD_OOB_RAW) {
+			uint8_t *datbuf = req->datbuf;
 
-				dma_sync_single_for_device(chip->dev,
-					data_dma_addr_curr-mtd->writesize,
-					mtd->writesize, DMA_BIDIRECTIONAL);
+			dma_sync_single_for_cpu(chip->dev,
+				req->data_dma_addr,
+				mtd->writesize, DMA_BIDIRECTIONAL);
 
-			}
-			if (ops->oobbuf) {
-				for (n = 0; n < ops->ooblen; n++) {
-					if (ops->oobbuf[n] != 0xff) {
-						pageerr = rawerr;
-						break;
-					}
+			for (n = 0; n < mtd->writesize; n++) {
+				/* empty blocks read 0x54 at
+				 * these offsets
+				 */
+				if (n % 516 == 3 && datbuf[n] == 0x54)
+					datbuf[n] = 0xff;
+				if (datbuf[n] != 0xff) {
+					pageerr = rawerr;
+					break;
 				}
 			}
+
+			dma_sync_single_for_device(chip->dev,
+				req->data_dma_addr,
+				mtd->writesize, DMA_BIDIRECTIONAL);
+
 		}
-		if (pageerr) {
-			for (n = start_sector; n < cwperpage; n++) {
-				if (dma_buffer->data.result[n].buffer_status
-					& MSM_NAND_BUF_STAT_UNCRCTBL_ERR) {
-					/* not thread safe */
-					mtd->ecc_stats.failed++;
-					pageerr = -EBADMSG;
+		if (ops->oobbuf && req->oob_len) {
+			dma_sync_single_for_cpu(chip->dev,
+			req->oob_dma_addr,
+			req->oob_len, DMA_BIDIRECTIONAL);
+
+			for (n = 0; n < req->oob_len; n++) {
+				if (req->oobbuf[n] != 0xff) {
+					pageerr = rawerr;
 					break;
 				}
 			}
+
+			dma_sync_single_for_device(chip->dev,
+			req->oob_dma_addr,
+			req->oob_len, DMA_BIDIRECTIONAL);
 		}
-		if (!rawerr) { /* check for corretable errors */
-			for (n = start_sector; n < cwperpage; n++) {
-				ecc_errors = dma_buffer->data.
-					result[n].buffer_status
-					& MSM_NAND_BUF_STAT_NUM_ERR_MASK;
-				if (ecc_errors) {
-					total_ecc_errors += ecc_errors;
-					/* not thread safe */
-					mtd->ecc_stats.corrected += ecc_errors;
-					if (ecc_errors > 1)
-						pageerr = -EUCLEAN;
-				}
+	}
+	if (pageerr) {
+		for (n = start_sector; n < cwperpage; n++) {
+			if (dma_buffer->data.result[n].buffer_status
+				& MSM_NAND_BUF_STAT_UNCRCTBL_ERR) {
+				/* not thread safe */
+				mtd->ecc_stats.failed++;
+				pageerr = -EBADMSG;
+				break;
 			}
 		}
-		if (pageerr && (pageerr != -EUCLEAN || err == 0))
-			err = pageerr;
-
+	}
+	if (!rawerr) { /* check for corretable errors */
+		for (n = start_sector; n < cwperpage; n++) {
+			ecc_errors = dma_buffer->data.
+				result[n].buffer_status
+				& MSM_NAND_BUF_STAT_NUM_ERR_MASK;
+			if (ecc_errors) {
+				*total_ecc_errors += ecc_errors;
+				/* not thread safe */
+				mtd->ecc_stats.corrected += ecc_errors;
+				if (msm_nand_ecc_account(mtd, req->page,
+							 ecc_errors))
+					pageerr = -EUCLEAN;
+			}
+		}
+	}
 #if VERBOSE
-		if (rawerr && !pageerr) {
-			pr_err("msm_nand_read_oob_dualnandc "
-				"%llx %x %x empty page\n",
-			       (loff_t)page * mtd->writesize, ops->len,
-			       ops->ooblen);
-		} else {
-			for (n = start_sector; n < cwperpage; n++) {
-				if (n%2) {
-					pr_info("NC10: flash_status[%d] = %x, "
-					 "buffr_status[%d] = %x\n",
-					n, dma_buffer->
-						data.result[n].flash_status,
-					n, dma_buffer->
-						data.result[n].buffer_status);
-				} else {
-					pr_info("NC01: flash_status[%d] = %x, "
-					 "buffr_status[%d] = %x\n",
-					n, dma_buffer->
-						data.result[n].flash_status,
-					n, dma_buffer->
-						data.result[n].buffer_status);
-				}
+	if (rawerr && !pageerr) {
+		pr_err("msm_nand_read_oob_dualnandc "
+			"%llx %x %x empty page\n",
+		       (loff_t)req->page * mtd->writesize, ops->len,
+		       ops->ooblen);
+	} else {
+		for (n = start_sector; n < cwperpage; n++) {
+			if (n%2) {
+				pr_info("NC10: flash_status[%d] = %x, "
+				 "buffr_status[%d] = %x\n",
+				n, dma_buffer->
+					data.result[n].flash_status,
+				n, dma_buffer->
+					data.result[n].buffer_status);
+			} else {
+				pr_info("NC01: flash_status[%d] = %x, "
+				 "buffr_status[%d] = %x\n",
+				n, dma_buffer->
+					data.result[n].flash_status,
+				n, dma_buffer->
+					data.result[n].buffer_status);
 			}
 		}
+	}
 #endif
+	return pageerr;
+}
+
+static int msm_nand_read_oob_dualnandc(struct mtd_info *mtd, loff_t from,
+			struct mtd_oob_ops *ops)
+{
+	struct msm_nand_chip *chip = mtd->priv;
+
+	struct msm_nand_read_dualnandc_dma *dma_buffer;
+	struct msm_nand_read_req reqs[2];
+	struct msm_nand_read_req *req;
+	unsigned page = 0;
+	uint32_t oob_len;
+	int err, pageerr;
+	dma_addr_t data_dma_addr = 0;
+	dma_addr_t oob_dma_addr = 0;
+	dma_addr_t data_dma_addr_curr = 0;
+	dma_addr_t oob_dma_addr_curr = 0;
+	uint32_t oob_col = 0;
+	unsigned page_count;
+	unsigned pages_read = 0;
+	unsigned pages_queued = 0;
+	unsigned nreqs;
+	uint32_t oob_read = 0;
+	unsigned start_sector = 0;
+	uint32_t total_ecc_errors = 0;
+	unsigned cwperpage;
+#if VERBOSE
+		pr_info("================================================="
+				"============\n");
+		pr_info("%s:\nfrom 0x%llx mode %d\ndatbuf 0x%p datlen 0x%x"
+				"\noobbuf 0x%p ooblen 0x%x\n\n",
+				__func__, from, ops->mode, ops->datbuf,
+				ops->len, ops->oobbuf, ops->ooblen);
+#endif
+
+	if (mtd->writesize == 2048)
+		page = from >> 11;
+
+	if (mtd->writesize == 4096)
+		page = from >> 12;
+
+	if (interleave_enable)
+		page = (from >> 1) >> 12;
+
+	oob_len = ops->ooblen;
+	cwperpage = (mtd->writesize >> 9);
+
+	if (from & (mtd->writesize - 1)) {
+		pr_err("%s: unsupported from, 0x%llx\n",
+		       __func__, from);
+		return -EINVAL;
+	}
+	if (ops->mode != MTD_OOB_RAW) {
+		if (ops->datbuf != NULL && (ops->len % mtd->writesize) != 0) {
+			pr_err("%s: unsupported ops->len, %d\n",
+			       __func__, ops->len);
+			return -EINVAL;
+		}
+	} else {
+		if (ops->datbuf != NULL &&
+			(ops->len % (mtd->writesize + mtd->oobsize)) != 0) {
+			pr_err("%s: unsupported ops->len,"
+				" %d for MTD_OOB_RAW\n", __func__, ops->len);
+			return -EINVAL;
+		}
+	}
+
+	if (ops->mode != MTD_OOB_RAW && ops->ooblen != 0 && ops->ooboffs != 0) {
+		pr_err("%s: unsupported ops->ooboffs, %d\n",
+		       __func__, ops->ooboffs);
+		return -EINVAL;
+	}
+
+	if (ops->oobbuf && !ops->datbuf && ops->mode == MTD_OOB_AUTO)
+		start_sector = cwperpage - 1;
+
+	if (ops->oobbuf && !ops->datbuf) {
+		page_count = ops->ooblen / ((ops->mode == MTD_OOB_AUTO) ?
+			mtd->oobavail : mtd->oobsize);
+		if ((page_count == 0) && (ops->ooblen))
+			page_count = 1;
+	} else if (ops->mode != MTD_OOB_RAW)
+		page_count = ops->len / mtd->writesize;
+	else
+		page_count = ops->len / (mtd->writesize + mtd->oobsize);
+
+	if (ops->datbuf) {
+		data_dma_addr_curr = data_dma_addr =
+			msm_nand_dma_map(chip->dev, ops->datbuf, ops->len,
+				       DMA_FROM_DEVICE);
+		if (dma_mapping_error(chip->dev, data_dma_addr)) {
+			pr_err("msm_nand_read_oob_dualnandc: "
+				"failed to get dma addr for %p\n",
+				ops->datbuf);
+			return -EIO;
+		}
+	}
+	if (ops->oobbuf) {
+		memset(ops->oobbuf, 0xff, ops->ooblen);
+		oob_dma_addr_curr = oob_dma_addr =
+			msm_nand_dma_map(chip->dev, ops->oobbuf,
+				       ops->ooblen, DMA_BIDIRECTIONAL);
+		if (dma_mapping_error(chip->dev, oob_dma_addr)) {
+			pr_err("msm_nand_read_oob_dualnandc: "
+				"failed to get dma addr for %p\n",
+				ops->oobbuf);
+			err = -EIO;
+			goto err_dma_map_oobbuf_failed;
+		}
+	}
+	/* As in msm_nand_read_oob(), keep the next page queued behind the
+	 * one being checked. Each command list puts the mux and chip
+	 * selects back to their defaults, so lists can run back to back.
+	 */
+	nreqs = (page_count > 1 && msm_nand_read_pipeline > 1 &&
+		 !((unsigned long)ops->datbuf &
+		   (dma_get_cache_alignment() - 1))) ?
+		ARRAY_SIZE(reqs) : 1;
+
+	dma_buffer = msm_nand_get_dma_buffer(chip, nreqs * sizeof(*dma_buffer));
+
+	oob_col = start_sector * 0x210;
+	if (chip->CFG1 & CFG1_WIDE_FLASH)
+		oob_col >>= 1;
+
+	err = 0;
+	while (pages_read < page_count) {
+		while (pages_queued < page_count &&
+		       pages_queued - pages_read < nreqs) {
+			req = &reqs[pages_queued % nreqs];
+			req->dma_buffer = &dma_buffer[pages_queued % nreqs];
+			req->page = page + pages_queued;
+			req->datbuf = ops->datbuf ? ops->datbuf +
+				(data_dma_addr_curr - data_dma_addr) : NULL;
+			req->data_dma_addr = data_dma_addr_curr;
+			req->oobbuf = ops->oobbuf ? ops->oobbuf +
+				(ops->ooblen - oob_len) : NULL;
+			req->oob_dma_addr = oob_dma_addr_curr;
+			req->oob_len = oob_len;
+
+			msm_nand_read_dualnandc_prep(mtd, ops,
+					&dma_buffer[pages_queued % nreqs],
+					req->page, oob_col, start_sector,
+					&data_dma_addr_curr,
+					&oob_dma_addr_curr, &oob_len);
+			req->oob_len -= oob_len;
+
+			msm_nand_read_start(chip, req,
+				&dma_buffer[pages_queued % nreqs].cmdptr);
+			pages_queued++;
+		}
+
+		req = &reqs[pages_read % nreqs];
+		wait_for_completion_io(&req->done);
+		dsb();
+
+		pageerr = msm_nand_read_dualnandc_check(mtd, ops, req,
+					start_sector, &total_ecc_errors);
+		if (pageerr && (pageerr != -EUCLEAN || err == 0))
+			err = pageerr;
+		oob_read += req->oob_len;
+
 		if (err && err != -EUCLEAN && err != -EBADMSG)
 			break;
 		pages_read++;
-		page++;
 	}
 
-	msm_nand_release_dma_buffer(chip, dma_buffer, sizeof(*dma_buffer));
+	while (pages_queued > pages_read + 1) {
+		pages_queued--;
+		wait_for_completion_io(&reqs[pages_queued % nreqs].done);
+	}
+
+	msm_nand_release_dma_buffer(chip, dma_buffer,
+				    nreqs * sizeof(*dma_buffer));
 
 	if (ops->oobbuf) {
 		dma_unmap_page(chip->dev, oob_dma_addr,
@@ -1882,7 +2180,7 @@ err_dma_map_oobbuf_failed:
 	else
 		ops->retlen = (mtd->writesize +  mtd->oobsize) *
 							pages_read;
-	ops->oobretlen = ops->ooblen - oob_len;
+	ops->oobretlen = oob_read;
 	if (err)
 		pr_err("msm_nand_read_oob_dualnandc "
 			"%llx %x %x failed %d, corrected %d\n",
@@ -1922,7 +2220,7 @@ msm_nand_read(struct mtd_info *mtd, loff_t from, size_t len,
 }
 
 static int
-msm_nand_write_oob(struct mtd_info *mtd, loff_t to, struct mtd_oob_ops *ops)
+__msm_nand_write_oob(struct mtd_info *mtd, loff_t to, struct mtd_oob_ops *ops)
 {
 	struct msm_nand_chip *chip = mtd->priv;
 	struct {
@@ -2034,8 +2332,7 @@ msm_nand_write_oob(struct mtd_info *mtd, loff_t to, struct mtd_oob_ops *ops)
 	else
 		page_count = ops->len / (mtd->writesize + mtd->oobsize);
 
-	wait_event(chip->wait_queue, (dma_buffer =
-			msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	while (page_count-- > 0) {
 		cmd = dma_buffer->cmd;
@@ -2244,6 +2541,18 @@ err_dma_map_oobbuf_failed:
 	return err;
 }
 
+static int
+msm_nand_write_oob(struct mtd_info *mtd, loff_t to, struct mtd_oob_ops *ops)
+{
+	u64 start;
+	int ret;
+
+	start = msm_latency_start(MSM_LATENCY_NAND, (unsigned long)ops);
+	ret = __msm_nand_write_oob(mtd, to, ops);
+	msm_latency_done(MSM_LATENCY_NAND, (unsigned long)ops, start, ret);
+	return ret;
+}
+
 static int
 msm_nand_write_oob_dualnandc(struct mtd_info *mtd, loff_t to,
 				struct mtd_oob_ops *ops)
@@ -2378,8 +2687,7 @@ msm_nand_write_oob_dualnandc(struct mtd_info *mtd, loff_t to,
 	else
 		page_count = ops->len / (mtd->writesize + mtd->oobsize);
 
-	wait_event(chip->wait_queue, (dma_buffer =
-			msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	dma_buffer->data.ebi2_chip_select_cfg0 = 0x00000805;
 	dma_buffer->data.adm_mux_data_ack_req_nc01 = 0x00000A3C;
@@ -2911,9 +3219,7 @@ msm_nand_erase(struct mtd_info *mtd, struct erase_info *instr)
 		return -EINVAL;
 	}
 
-	wait_event(chip->wait_queue,
-		   (dma_buffer = msm_nand_get_dma_buffer(
-			    chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	cmd = dma_buffer->cmd;
 
@@ -2991,6 +3297,7 @@ msm_nand_erase(struct mtd_info *mtd, struct erase_info *instr)
 		instr->fail_addr = instr->addr;
 		instr->state = MTD_ERASE_FAILED;
 	} else {
+		msm_nand_ecc_erased(mtd, instr->addr);
 		instr->state = MTD_ERASE_DONE;
 		instr->fail_addr = 0xffffffff;
 		mtd_erase_callback(instr);
@@ -3053,9 +3360,7 @@ msm_nand_erase_dualnandc(struct mtd_info *mtd, struct erase_info *instr)
 		return -EINVAL;
 	}
 
-	wait_event(chip->wait_queue,
-		   (dma_buffer = msm_nand_get_dma_buffer(
-			    chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	cmd = dma_buffer->cmd;
 
@@ -3232,6 +3537,7 @@ msm_nand_erase_dualnandc(struct mtd_info *mtd, struct erase_info *instr)
 		instr->fail_addr = instr->addr;
 		instr->state = MTD_ERASE_FAILED;
 	} else {
+		msm_nand_ecc_erased(mtd, instr->addr);
 		instr->state = MTD_ERASE_DONE;
 		instr->fail_addr = 0xffffffff;
 		mtd_erase_callback(instr);
@@ -3284,9 +3590,7 @@ msm_nand_block_isbad(struct mtd_info *mtd, loff_t ofs)
 		return -EINVAL;
 	}
 
-	wait_event(chip->wait_queue,
-		(dma_buffer = msm_nand_get_dma_buffer(chip ,
-					 sizeof(*dma_buffer) + 4)));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer) + 4);
 	buf = (uint8_t *)dma_buffer + sizeof(*dma_buffer);
 
 	/* Read 4 bytes starting from the bad block marker location
@@ -3435,9 +3739,7 @@ msm_nand_block_isbad_dualnandc(struct mtd_info *mtd, loff_t ofs)
 		return -EINVAL;
 	}
 
-	wait_event(chip->wait_queue,
-		(dma_buffer = msm_nand_get_dma_buffer(chip ,
-					 sizeof(*dma_buffer) + 8)));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer) + 8);
 	buf01 = (uint8_t *)dma_buffer + sizeof(*dma_buffer);
 	buf10 = buf01 + 4;
 
@@ -3743,8 +4045,7 @@ uint32_t flash_onenand_probe(struct msm_nand_chip *chip)
 
 	printk(KERN_INFO "SFLASHC Async Mode bit: %x \n", nand_sfcmd_mode);
 
-	wait_event(chip->wait_queue, (dma_buffer = msm_nand_get_dma_buffer
-				(chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	cmd = dma_buffer->cmd;
 
@@ -4061,8 +4362,7 @@ int msm_onenand_read_oob(struct mtd_info *mtd,
 		}
 	}
 
-	wait_event(chip->wait_queue, (dma_buffer = msm_nand_get_dma_buffer
-				(chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	from_curr = from;
 
@@ -4781,8 +5081,7 @@ static int msm_onenand_write_oob(struct mtd_info *mtd, loff_t to,
 	}
 
 
-	wait_event(chip->wait_queue, (dma_buffer = msm_nand_get_dma_buffer
-				(chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	to_curr = to;
 
@@ -5385,8 +5684,7 @@ static int msm_onenand_erase(struct mtd_info *mtd, struct erase_info *instr)
 		return -EINVAL;
 	}
 
-	wait_event(chip->wait_queue, (dma_buffer = msm_nand_get_dma_buffer
-				(chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	cmd = dma_buffer->cmd;
 
@@ -5845,8 +6143,7 @@ static int msm_onenand_unlock(struct mtd_info *mtd, loff_t ofs, uint64_t len)
 		return -EINVAL;
 	}
 
-	wait_event(chip->wait_queue, (dma_buffer = msm_nand_get_dma_buffer
-				(chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	for (start_ofs = ofs; ofs < start_ofs+len; ofs = ofs+mtd->erasesize) {
 #if VERBOSE
@@ -6209,8 +6506,7 @@ static int msm_onenand_lock(struct mtd_info *mtd, loff_t ofs, uint64_t len)
 		return -EINVAL;
 	}
 
-	wait_event(chip->wait_queue, (dma_buffer = msm_nand_get_dma_buffer
-				(chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	for (start_ofs = ofs; ofs < start_ofs+len; ofs = ofs+mtd->erasesize) {
 #if VERBOSE
@@ -6746,6 +7042,74 @@ struct msm_nand_info {
 	struct msm_nand_chip	msm_nand;
 };
 
+static ssize_t msm_nand_dma_stats_show(struct device *dev,
+				       struct device_attribute *attr,
+				       char *buf)
+{
+	struct msm_nand_info *info = dev_get_drvdata(dev);
+	struct msm_nand_chip *chip = &info->msm_nand;
+
+	return sprintf(buf, "allocs %u waits %u peak %u/%u slots\n",
+		       chip->dma_buffer_allocs, chip->dma_buffer_waits,
+		       chip->dma_buffer_peak, MSM_NAND_DMA_BUFFER_SLOTS);
+}
+
+static DEVICE_ATTR(dma_stats, S_IRUGO, msm_nand_dma_stats_show, NULL);
+
+#if defined(CONFIG_DEBUG_FS)
+static struct dentry *msm_nand_debugfs_dir;
+
+/* Erase blocks that needed correcting since they were last erased */
+static int msm_nand_ecc_blocks_show(struct seq_file *m, void *unused)
+{
+	struct msm_nand_chip *chip = m->private;
+	unsigned n;
+
+	seq_printf(m, "scrub threshold %u bits\n", msm_nand_scrub_threshold);
+	for (n = 0; n < chip->ecc_nblocks; n++)
+		if (chip->ecc_blocks[n].corrected)
+			seq_printf(m, "block %u: corrected %u max %u\n", n,
+				   chip->ecc_blocks[n].corrected,
+				   chip->ecc_blocks[n].max);
+	return 0;
+}
+
+static int msm_nand_ecc_blocks_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_nand_ecc_blocks_show, inode->i_private);
+}
+
+static const struct file_operations msm_nand_ecc_blocks_fops = {
+	.open		= msm_nand_ecc_blocks_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void msm_nand_debugfs_init(struct msm_nand_chip *chip)
+{
+	msm_nand_debugfs_dir = debugfs_create_dir("msm_nand", NULL);
+	if (IS_ERR_OR_NULL(msm_nand_debugfs_dir)) {
+		msm_nand_debugfs_dir = NULL;
+		return;
+	}
+
+	if (chip->ecc_blocks)
+		debugfs_create_file("ecc_blocks", S_IRUGO,
+				    msm_nand_debugfs_dir, chip,
+				    &msm_nand_ecc_blocks_fops);
+}
+
+static void msm_nand_debugfs_exit(void)
+{
+	debugfs_remove_recursive(msm_nand_debugfs_dir);
+	msm_nand_debugfs_dir = NULL;
+}
+#else
+static inline void msm_nand_debugfs_init(struct msm_nand_chip *chip) { }
+static inline void msm_nand_debugfs_exit(void) { }
+#endif
+
 /* duplicating the NC01 XFR contents to NC10 */
 static int msm_nand_nc10_xfr_settings(struct mtd_info *mtd)
 {
@@ -6757,9 +7121,7 @@ static int msm_nand_nc10_xfr_settings(struct mtd_info *mtd)
 	} *dma_buffer;
 	dmov_s *cmd;
 
-	wait_event(chip->wait_queue,
-		(dma_buffer = msm_nand_get_dma_buffer(
-				chip, sizeof(*dma_buffer))));
+	dma_buffer = msm_nand_get_dma_buffer(chip, sizeof(*dma_buffer));
 
 	cmd = dma_buffer->cmd;
 
@@ -6946,7 +7308,8 @@ no_dual_nand_ctlr_support:
 
 	info->msm_nand.dev = &pdev->dev;
 
-	init_waitqueue_head(&info->msm_nand.wait_queue);
+	spin_lock_init(&info->msm_nand.dma_buffer_lock);
+	INIT_LIST_HEAD(&info->msm_nand.dma_buffer_waiters);
 
 	info->msm_nand.dma_channel = res->start;
 	pr_info("%s: dmac 0x%x\n", __func__, info->msm_nand.dma_channel);
@@ -6985,8 +7348,19 @@ no_dual_nand_ctlr_support:
 			goto out_free_dma_buffer;
 		}
 
+	/* Missing ECC statistics are not worth failing the probe over */
+	info->msm_nand.ecc_block_shift =
+		ilog2(info->mtd.erasesize / info->mtd.writesize);
+	info->msm_nand.ecc_nblocks = mtd_div_by_eb(info->mtd.size, &info->mtd);
+	info->msm_nand.ecc_blocks = kcalloc(info->msm_nand.ecc_nblocks,
+					    sizeof(struct msm_nand_ecc_block),
+					    GFP_KERNEL);
+	msm_nand_debugfs_init(&info->msm_nand);
+
 	setup_mtd_device(pdev, info);
 	dev_set_drvdata(&pdev->dev, info);
+	if (device_create_file(&pdev->dev, &dev_attr_dma_stats))
+		pr_warning("%s: failed to create dma_stats\n", __func__);
 	init_memory_proc();		////BOOT_JIANGFENG_20100611_01
 
 	return 0;
@@ -7005,6 +7379,7 @@ static int __devexit msm_nand_remove(struct platform_device *pdev)
 {
 	struct msm_nand_info *info = dev_get_drvdata(&pdev->dev);
 
+	device_remove_file(&pdev->dev, &dev_attr_dma_stats);
 	dev_set_drvdata(&pdev->dev, NULL);
 
 	if (info) {
@@ -7016,6 +7391,8 @@ static int __devexit msm_nand_remove(struct platform_device *pdev)
 			del_mtd_device(&info->mtd);
 
 		msm_nand_release(&info->mtd);
+		msm_nand_debugfs_exit();
+		kfree(info->msm_nand.ecc_blocks);
 		dma_free_coherent(NULL, MSM_NAND_DMA_BUFFER_SIZE,
 				  info->msm_nand.dma_buffer,
 				  info->msm_nand.dma_addr);
@@ -0,0 +1,797 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * Storage stack benchmark.
+ *
+ * Runs the same matrix of tests on each layer of the flash storage stack
+ * and prints throughput, IOPS and latency percentiles, so that the layers
+ * can be compared and changes measured the same way every time:
+ *
+ *   dev=N          raw MTD device N (msm_nand, OneNAND, ...), destructive
+ *   ubi=N vol=M    UBI volume M of UBI device N, destructive
+ *   blkdev=PATH    block device, e.g. /dev/block/mtdblock5, destructive
+ *   dir=PATH       directory on a mounted file system (YAFFS2, UBIFS, ...)
+ *
+ * The matrix is sequential write and read in units of @unit bytes, random
+ * reads of @page bytes, random writes of @unit bytes, a mixed run of three
+ * random reads to one random write over the full test area, which makes
+ * the layers below collect garbage, and for file systems creation and
+ * deletion of small files. Raw MTD devices also get erase, OOB only and
+ * page plus OOB reads, the latter being how YAFFS2 reads its chunks.
+ *
+ * The random numbers are seeded with @seed, so runs are repeatable.
+ * Interleaved dual controller NAND and OneNAND are driven through their MTD
+ * methods like any other device, the device line printed first tells the
+ * setups apart.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/err.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/ubi.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sort.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/namei.h>
+#include <linux/mount.h>
+#include <linux/uaccess.h>
+
+#define PRINT_PREF KERN_INFO "mtd_benchmark: "
+
+/* Size of the I/O units of block devices and files */
+#define BENCH_FILE_UNIT  (64 * 1024)
+#define BENCH_FILE_PAGE  4096
+#define BENCH_FILE_AREA  (16 * 1024)
+
+static int dev = -1;
+module_param(dev, int, S_IRUGO);
+MODULE_PARM_DESC(dev, "MTD device number to benchmark (destroys data)");
+
+static int ubi = -1;
+module_param(ubi, int, S_IRUGO);
+MODULE_PARM_DESC(ubi, "UBI device number to benchmark");
+
+static int vol = -1;
+module_param(vol, int, S_IRUGO);
+MODULE_PARM_DESC(vol, "UBI volume ID to benchmark (destroys data)");
+
+static char *blkdev;
+module_param(blkdev, charp, S_IRUGO);
+MODULE_PARM_DESC(blkdev, "block device to benchmark (destroys data)");
+
+static char *dir;
+module_param(dir, charp, S_IRUGO);
+MODULE_PARM_DESC(dir, "directory on the file system to benchmark");
+
+static int size;
+module_param(size, int, S_IRUGO);
+MODULE_PARM_DESC(size, "test area in KiB (default: whole device, 16 MiB "
+		 "for file systems)");
+
+static int count = 1000;
+module_param(count, int, S_IRUGO);
+MODULE_PARM_DESC(count, "number of random operations and small files");
+
+static unsigned int seed = 1;
+module_param(seed, uint, S_IRUGO);
+MODULE_PARM_DESC(seed, "random seed");
+
+/**
+ * struct bench_target - a layer of the storage stack under test.
+ * @name: name used in the results
+ * @area: bytes of the test area
+ * @unit: size of sequential I/O and random writes
+ * @page: size of random reads
+ * @buf: I/O buffer of @unit bytes
+ * @read: read @len bytes at @pos
+ * @write: write @unit bytes at @pos, which is a multiple of @unit
+ * @sync: make written data stable and drop cached data
+ */
+struct bench_target {
+	char name[32];
+	long long area;
+	int unit;
+	int page;
+	void *buf;
+	int (*read)(struct bench_target *t, loff_t pos, int len);
+	int (*write)(struct bench_target *t, loff_t pos);
+	int (*sync)(struct bench_target *t);
+};
+
+static u32 *lat;
+static int lat_max;
+static unsigned long next;
+
+static unsigned int simple_rand(void)
+{
+	next = next * 1103515245 + 12345;
+	return (unsigned int)((next / 65536) % 32768);
+}
+
+/* Random multiple of @align below @area */
+static loff_t rand_pos(long long area, int align)
+{
+	u32 n = div_u64(area, align);
+	u32 r = (simple_rand() << 15) | simple_rand();
+
+	return (loff_t)(r % n) * align;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * report - print the results of one test.
+ * @t: the target
+ * @test: name of the test
+ * @ops: number of operations, @lat holds their latencies
+ * @bytes: bytes transferred
+ * @ns: total time of the operations
+ */
+static void report(struct bench_target *t, const char *test, int ops,
+		   long long bytes, s64 ns)
+{
+	u64 rate, iops;
+
+	if (ops <= 0 || ns <= 0)
+		return;
+
+	sort(lat, ops, sizeof(u32), cmp_u32, NULL);
+	/* bytes per us is MB/s, keep two decimals */
+	rate = div64_u64((u64)bytes * 100000, ns);
+	iops = div64_u64((u64)ops * NSEC_PER_SEC, ns);
+	printk(PRINT_PREF "%-8s %-10s %6d x %6llu B %5llu.%02llu MB/s "
+	       "%6llu IOPS, lat us p50 %u p90 %u p99 %u max %u\n",
+	       t->name, test, ops, div_u64(bytes, ops),
+	       div_u64(rate, 100), rate % 100, iops,
+	       lat[ops / 2], lat[ops * 9 / 10], lat[ops * 99 / 100],
+	       lat[ops - 1]);
+}
+
+/* Record the latency of operation @i started at @start, return it in ns */
+static s64 account(int i, ktime_t start)
+{
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (i < lat_max)
+		lat[i] = min_t(s64, div_s64(ns, NSEC_PER_USEC), UINT_MAX);
+	return ns;
+}
+
+static int bench_seq(struct bench_target *t, int write)
+{
+	int i, err, n = min_t(long long, div_s64(t->area, t->unit), lat_max);
+	s64 ns = 0;
+	ktime_t start;
+
+	if (!write) {
+		err = t->sync(t);
+		if (err)
+			return err;
+	}
+
+	for (i = 0; i < n; i++) {
+		start = ktime_get();
+		if (write)
+			err = t->write(t, (loff_t)i * t->unit);
+		else
+			err = t->read(t, (loff_t)i * t->unit, t->unit);
+		if (err)
+			return err;
+		ns += account(i, start);
+		cond_resched();
+	}
+
+	if (write) {
+		start = ktime_get();
+		err = t->sync(t);
+		if (err)
+			return err;
+		ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	}
+
+	report(t, write ? "seq-write" : "seq-read", n, (long long)n * t->unit,
+	       ns);
+	return 0;
+}
+
+/*
+ * Random reads, random writes or both. In the mixed run one operation in
+ * four is a write.
+ */
+static int bench_rand(struct bench_target *t, int reads, int writes)
+{
+	int i, err, write, n = min(count, lat_max);
+	long long bytes = 0;
+	s64 ns = 0;
+	ktime_t start;
+	loff_t pos;
+	const char *test;
+
+	err = t->sync(t);
+	if (err)
+		return err;
+
+	for (i = 0; i < n; i++) {
+		write = writes && (!reads || simple_rand() % 4 == 0);
+		if (write)
+			pos = rand_pos(t->area, t->unit);
+		else
+			pos = rand_pos(t->area, t->page);
+
+		start = ktime_get();
+		if (write)
+			err = t->write(t, pos);
+		else
+			err = t->read(t, pos, t->page);
+		if (err)
+			return err;
+		ns += account(i, start);
+		bytes += write ? t->unit : t->page;
+		cond_resched();
+	}
+
+	if (reads && writes)
+		test = "mixed";
+	else
+		test = reads ? "rand-read" : "rand-write";
+	report(t, test, n, bytes, ns);
+	return 0;
+}
+
+static int bench_target(struct bench_target *t)
+{
+	int err;
+
+	err = bench_seq(t, 1);
+	if (!err)
+		err = bench_seq(t, 0);
+	if (!err)
+		err = bench_rand(t, 1, 0);
+	if (!err)
+		err = bench_rand(t, 0, 1);
+	if (!err)
+		err = bench_rand(t, 1, 1);
+	if (err)
+		printk(PRINT_PREF "%s: error %d\n", t->name, err);
+	return err;
+}
+
+/* Test area in bytes, @def if the size parameter is not given */
+static long long area_size(long long max, long long def)
+{
+	if (size > 0)
+		def = (long long)size * 1024;
+	return min(max, def);
+}
+
+/* Raw MTD devices */
+
+static struct mtd_info *mtd;
+/* Good eraseblocks of the test area */
+static int *ebs;
+static int ebcnt;
+
+static loff_t mtd_addr(loff_t pos)
+{
+	u32 off;
+	u64 eb = div_u64_rem(pos, mtd->erasesize, &off);
+
+	return (loff_t)ebs[eb] * mtd->erasesize + off;
+}
+
+static int mtd_erase(struct bench_target *t, loff_t pos)
+{
+	struct erase_info ei;
+	int err;
+
+	memset(&ei, 0, sizeof(struct erase_info));
+	ei.mtd = mtd;
+	ei.addr = mtd_addr(pos);
+	ei.len = mtd->erasesize;
+
+	err = mtd->erase(mtd, &ei);
+	if (!err && ei.state == MTD_ERASE_FAILED)
+		err = -EIO;
+	return err;
+}
+
+static int mtd_bench_read(struct bench_target *t, loff_t pos, int len)
+{
+	size_t read;
+	int err;
+
+	err = mtd->read(mtd, mtd_addr(pos), len, &read, t->buf);
+	/* Ignore corrected ECC errors */
+	if (err == -EUCLEAN)
+		err = 0;
+	if (!err && read != len)
+		err = -EIO;
+	return err;
+}
+
+static int mtd_bench_write(struct bench_target *t, loff_t pos)
+{
+	size_t written;
+	int err;
+
+	err = mtd_erase(t, pos);
+	if (err)
+		return err;
+
+	err = mtd->write(mtd, mtd_addr(pos), t->unit, &written, t->buf);
+	if (!err && written != t->unit)
+		err = -EIO;
+	return err;
+}
+
+static int mtd_bench_sync(struct bench_target *t)
+{
+	if (mtd->sync)
+		mtd->sync(mtd);
+	return 0;
+}
+
+/* Random reads of OOB only, or of a page and its OOB like YAFFS2 does */
+static int mtd_bench_oob(struct bench_target *t, int data)
+{
+	struct mtd_oob_ops ops;
+	int i, err, n = min(count, lat_max);
+	s64 ns = 0;
+	ktime_t start;
+
+	for (i = 0; i < n; i++) {
+		memset(&ops, 0, sizeof(ops));
+		ops.mode = MTD_OOB_AUTO;
+		ops.ooblen = mtd->oobavail;
+		ops.oobbuf = t->buf + t->page;
+		if (data) {
+			ops.len = t->page;
+			ops.datbuf = t->buf;
+		}
+
+		start = ktime_get();
+		err = mtd->read_oob(mtd, mtd_addr(rand_pos(t->area, t->page)),
+				    &ops);
+		if (err && err != -EUCLEAN)
+			return err;
+		ns += account(i, start);
+		cond_resched();
+	}
+
+	report(t, data ? "page+oob" : "oob-read", n,
+	       (long long)n * (mtd->oobavail + (data ? t->page : 0)), ns);
+	return 0;
+}
+
+static int mtd_bench_erase(struct bench_target *t)
+{
+	int i, err;
+	s64 ns = 0;
+	ktime_t start;
+
+	for (i = 0; i < ebcnt && i < lat_max; i++) {
+		start = ktime_get();
+		err = mtd_erase(t, (loff_t)i * mtd->erasesize);
+		if (err)
+			return err;
+		ns += account(i, start);
+		cond_resched();
+	}
+
+	report(t, "erase", i, (long long)i * mtd->erasesize, ns);
+	return 0;
+}
+
+static int bench_mtd(void)
+{
+	struct bench_target t = {
+		.read = mtd_bench_read,
+		.write = mtd_bench_write,
+		.sync = mtd_bench_sync,
+	};
+	int i, total, err;
+	uint64_t tmp;
+
+	mtd = get_mtd_device(NULL, dev);
+	if (IS_ERR(mtd)) {
+		printk(PRINT_PREF "error: cannot get MTD device %d\n", dev);
+		return PTR_ERR(mtd);
+	}
+
+	tmp = mtd->size;
+	do_div(tmp, mtd->erasesize);
+	total = tmp;
+	printk(PRINT_PREF "mtd%d \"%s\" type %d, size %llu, eraseblock %u, "
+	       "page %u, OOB %u (%u free)\n", dev, mtd->name, mtd->type,
+	       (unsigned long long)mtd->size, mtd->erasesize, mtd->writesize,
+	       mtd->oobsize, mtd->oobavail);
+
+	err = -ENOMEM;
+	ebs = kmalloc(total * sizeof(int), GFP_KERNEL);
+	t.buf = kmalloc(mtd->erasesize + mtd->oobsize, GFP_KERNEL);
+	if (!ebs || !t.buf)
+		goto out;
+	memset(t.buf, 0x5a, mtd->erasesize + mtd->oobsize);
+
+	t.area = area_size(mtd->size, mtd->size);
+	for (i = ebcnt = 0; i < total; i++) {
+		if ((long long)ebcnt * mtd->erasesize >= t.area)
+			break;
+		if (mtd->block_isbad &&
+		    mtd->block_isbad(mtd, (loff_t)i * mtd->erasesize))
+			continue;
+		ebs[ebcnt++] = i;
+	}
+
+	err = -ENOSPC;
+	if (!ebcnt)
+		goto out;
+
+	snprintf(t.name, sizeof(t.name), "mtd%d", dev);
+	t.area = (long long)ebcnt * mtd->erasesize;
+	t.unit = mtd->erasesize;
+	t.page = mtd->writesize > 1 ? mtd->writesize : 512;
+
+	err = mtd_bench_erase(&t);
+	if (!err)
+		err = bench_target(&t);
+	if (!err && mtd->read_oob && mtd->oobavail) {
+		err = mtd_bench_oob(&t, 0);
+		if (!err)
+			err = mtd_bench_oob(&t, 1);
+	}
+
+out:
+	kfree(t.buf);
+	kfree(ebs);
+	put_mtd_device(mtd);
+	return err;
+}
+
+/* UBI volumes */
+
+#if defined(CONFIG_MTD_UBI) || defined(CONFIG_MTD_UBI_MODULE)
+static struct ubi_volume_desc *ubi_desc;
+
+static int ubi_bench_read(struct bench_target *t, loff_t pos, int len)
+{
+	u32 off;
+	int lnum = div_u64_rem(pos, t->unit, &off);
+
+	return ubi_leb_read(ubi_desc, lnum, t->buf, off, len, 0);
+}
+
+static int ubi_bench_write(struct bench_target *t, loff_t pos)
+{
+	int lnum = div_u64(pos, t->unit);
+
+	return ubi_leb_change(ubi_desc, lnum, t->buf, t->unit, UBI_UNKNOWN);
+}
+
+static int ubi_bench_sync(struct bench_target *t)
+{
+	return ubi_sync(ubi);
+}
+
+static int bench_ubi(void)
+{
+	struct bench_target t = {
+		.read = ubi_bench_read,
+		.write = ubi_bench_write,
+		.sync = ubi_bench_sync,
+	};
+	struct ubi_device_info di;
+	struct ubi_volume_info vi;
+	int err;
+
+	ubi_desc = ubi_open_volume(ubi, vol, UBI_EXCLUSIVE);
+	if (IS_ERR(ubi_desc)) {
+		printk(PRINT_PREF "error: cannot open UBI volume %d:%d\n",
+		       ubi, vol);
+		return PTR_ERR(ubi_desc);
+	}
+
+	ubi_get_volume_info(ubi_desc, &vi);
+	err = ubi_get_device_info(ubi, &di);
+	if (err)
+		goto out;
+	printk(PRINT_PREF "ubi%d_%d \"%s\", %d LEBs of %d bytes, "
+	       "min I/O %d\n", ubi, vol, vi.name, vi.size,
+	       vi.usable_leb_size, di.min_io_size);
+
+	err = -ENOMEM;
+	t.buf = kmalloc(vi.usable_leb_size, GFP_KERNEL);
+	if (!t.buf)
+		goto out;
+	memset(t.buf, 0x5a, vi.usable_leb_size);
+
+	snprintf(t.name, sizeof(t.name), "ubi%d_%d", ubi, vol);
+	t.unit = vi.usable_leb_size;
+	t.page = di.min_io_size;
+	t.area = area_size((long long)vi.size * t.unit,
+			   (long long)vi.size * t.unit);
+	t.area = div_s64(t.area, t.unit) * t.unit;
+	err = t.area ? bench_target(&t) : -ENOSPC;
+
+out:
+	kfree(t.buf);
+	ubi_close_volume(ubi_desc);
+	return err;
+}
+#else
+static int bench_ubi(void)
+{
+	printk(PRINT_PREF "UBI is not enabled\n");
+	return -ENODEV;
+}
+#endif
+
+/* Block devices and file systems */
+
+static struct file *bench_file;
+
+static int file_bench_read(struct bench_target *t, loff_t pos, int len)
+{
+	mm_segment_t old_fs = get_fs();
+	ssize_t ret;
+
+	set_fs(KERNEL_DS);
+	ret = vfs_read(bench_file, (char __user *)t->buf, len, &pos);
+	set_fs(old_fs);
+	if (ret < 0)
+		return ret;
+	return ret == len ? 0 : -EIO;
+}
+
+static int file_write(struct file *file, void *buf, int len, loff_t pos)
+{
+	mm_segment_t old_fs = get_fs();
+	ssize_t ret;
+
+	set_fs(KERNEL_DS);
+	ret = vfs_write(file, (const char __user *)buf, len, &pos);
+	set_fs(old_fs);
+	if (ret < 0)
+		return ret;
+	return ret == len ? 0 : -ENOSPC;
+}
+
+static int file_bench_write(struct bench_target *t, loff_t pos)
+{
+	return file_write(bench_file, t->buf, t->unit, pos);
+}
+
+/* Write back and drop the page cache, reads have to reach the layer */
+static int file_bench_sync(struct bench_target *t)
+{
+	int err = vfs_fsync(bench_file, 0);
+
+	invalidate_mapping_pages(bench_file->f_mapping, 0, -1);
+	return err;
+}
+
+static int bench_open(struct bench_target *t, const char *path, int flags,
+		      long long max, long long def)
+{
+	bench_file = filp_open(path, flags | O_RDWR | O_SYNC | O_LARGEFILE,
+			       0600);
+	if (IS_ERR(bench_file)) {
+		printk(PRINT_PREF "error: cannot open %s\n", path);
+		return PTR_ERR(bench_file);
+	}
+
+	t->buf = kmalloc(BENCH_FILE_UNIT, GFP_KERNEL);
+	if (!t->buf) {
+		filp_close(bench_file, NULL);
+		return -ENOMEM;
+	}
+	memset(t->buf, 0x5a, BENCH_FILE_UNIT);
+
+	t->read = file_bench_read;
+	t->write = file_bench_write;
+	t->sync = file_bench_sync;
+	t->unit = BENCH_FILE_UNIT;
+	t->page = BENCH_FILE_PAGE;
+	t->area = area_size(max, def);
+	t->area = div_s64(t->area, t->unit) * t->unit;
+	return 0;
+}
+
+static void bench_close(struct bench_target *t)
+{
+	kfree(t->buf);
+	filp_close(bench_file, NULL);
+}
+
+static int bench_blkdev(void)
+{
+	struct bench_target t = { .name = "blkdev" };
+	long long max;
+	int err;
+
+	err = bench_open(&t, blkdev, 0, LLONG_MAX, LLONG_MAX);
+	if (err)
+		return err;
+
+	max = i_size_read(bench_file->f_mapping->host);
+	t.area = div_s64(min(t.area, max), t.unit) * t.unit;
+	printk(PRINT_PREF "%s, size %lld\n", blkdev, max);
+	err = t.area ? bench_target(&t) : -ENOSPC;
+	bench_close(&t);
+	return err;
+}
+
+/* Create @count small files in @dir, then delete them */
+static int bench_files(struct bench_target *t)
+{
+	struct path parent;
+	struct dentry *dentry;
+	struct file *file;
+	char *name;
+	int i, n = min(count, lat_max), err;
+	s64 ns = 0;
+	ktime_t start;
+
+	name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!name)
+		return -ENOMEM;
+
+	for (i = 0; i < n; i++) {
+		snprintf(name, PATH_MAX, "%s/mtd_benchmark.%d", dir, i);
+		start = ktime_get();
+		file = filp_open(name, O_CREAT | O_TRUNC | O_WRONLY | O_SYNC,
+				 0600);
+		if (IS_ERR(file)) {
+			err = PTR_ERR(file);
+			goto out;
+		}
+		err = file_write(file, t->buf, BENCH_FILE_PAGE, 0);
+		filp_close(file, NULL);
+		if (err)
+			goto out;
+		ns += account(i, start);
+		cond_resched();
+	}
+	report(t, "create", n, (long long)n * BENCH_FILE_PAGE, ns);
+
+	err = kern_path(dir, LOOKUP_FOLLOW | LOOKUP_DIRECTORY, &parent);
+	if (err)
+		goto out;
+	err = mnt_want_write(parent.mnt);
+	if (err)
+		goto out_path;
+
+	ns = 0;
+	for (i = 0; i < n; i++) {
+		snprintf(name, PATH_MAX, "mtd_benchmark.%d", i);
+		start = ktime_get();
+		mutex_lock_nested(&parent.dentry->d_inode->i_mutex,
+				  I_MUTEX_PARENT);
+		dentry = lookup_one_len(name, parent.dentry, strlen(name));
+		if (IS_ERR(dentry))
+			err = PTR_ERR(dentry);
+		else {
+			if (dentry->d_inode)
+				err = vfs_unlink(parent.dentry->d_inode,
+						 dentry);
+			else
+				err = -ENOENT;
+			dput(dentry);
+		}
+		mutex_unlock(&parent.dentry->d_inode->i_mutex);
+		if (err)
+			break;
+		ns += account(i, start);
+		cond_resched();
+	}
+	if (!err)
+		report(t, "delete", n, 0, ns);
+
+	mnt_drop_write(parent.mnt);
+out_path:
+	path_put(&parent);
+out:
+	kfree(name);
+	return err;
+}
+
+static int bench_dir(void)
+{
+	struct bench_target t = { .name = "fs" };
+	char *path;
+	int err;
+
+	path = kasprintf(GFP_KERNEL, "%s/mtd_benchmark.dat", dir);
+	if (!path)
+		return -ENOMEM;
+
+	err = bench_open(&t, path, O_CREAT | O_TRUNC, LLONG_MAX,
+			 BENCH_FILE_AREA * 1024LL);
+	if (err)
+		goto out;
+
+	printk(PRINT_PREF "%s on %s\n", path,
+	       bench_file->f_path.mnt->mnt_sb->s_type->name);
+	err = bench_target(&t);
+	if (!err)
+		err = bench_files(&t);
+	if (err)
+		printk(PRINT_PREF "fs: error %d\n", err);
+	bench_close(&t);
+
+out:
+	kfree(path);
+	return err;
+}
+
+static int __init mtd_benchmark_init(void)
+{
+	int err = 0, ret;
+
+	printk(KERN_INFO "\n");
+	printk(KERN_INFO "=================================================\n");
+
+	/* Enough latency slots for the random runs and any sequential one */
+	lat_max = max(count, 65536);
+	lat = vmalloc(lat_max * sizeof(u32));
+	if (!lat)
+		return -ENOMEM;
+
+	if (dev >= 0) {
+		next = seed;
+		ret = bench_mtd();
+		err = err ? : ret;
+	}
+	if (ubi >= 0 && vol >= 0) {
+		next = seed;
+		ret = bench_ubi();
+		err = err ? : ret;
+	}
+	if (blkdev && *blkdev) {
+		next = seed;
+		ret = bench_blkdev();
+		err = err ? : ret;
+	}
+	if (dir && *dir) {
+		next = seed;
+		ret = bench_dir();
+		err = err ? : ret;
+	}
+
+	vfree(lat);
+	if (err)
+		printk(PRINT_PREF "error %d occurred\n", err);
+	else
+		printk(PRINT_PREF "finished\n");
+	printk(KERN_INFO "=================================================\n");
+	return err;
+}
+module_init(mtd_benchmark_init);
+
+static void __exit mtd_benchmark_exit(void)
+{
+	return;
+}
+module_exit(mtd_benchmark_exit);
+
+MODULE_DESCRIPTION("Storage stack benchmark module");
+MODULE_LICENSE("GPL");
@@ -44,6 +44,7 @@
 #include <linux/kthread.h>
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <linux/reboot.h>
 #include "ubi.h"
 
 /* Maximum length of the 'mtd=' parameter */
@@ -942,6 +943,10 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 		goto out_free;
 #endif
 
+	err = ubi_fm_init(ubi);
+	if (err)
+		goto out_free;
+
 	err = attach_by_scanning(ubi);
 	if (err) {
 		dbg_err("failed to attach by scanning, error %d", err);
@@ -1004,6 +1009,7 @@ out_detach:
 	free_internal_volumes(ubi);
 	vfree(ubi->vtbl);
 out_free:
+	ubi_fm_close(ubi);
 	vfree(ubi->peb_buf1);
 	vfree(ubi->peb_buf2);
 #ifdef CONFIG_MTD_UBI_DEBUG_PARANOID
@@ -1066,6 +1072,12 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	if (ubi->bgt_thread)
 		kthread_stop(ubi->bgt_thread);
 
+	/* Leave a fastmap behind so that the next attach is fast */
+	spin_lock(&ubi->wl_lock);
+	ubi->thread_enabled = 0;
+	spin_unlock(&ubi->wl_lock);
+	ubi_update_fastmap(ubi);
+
 	/*
 	 * Get a reference to the device in order to prevent 'dev_release()'
 	 * from freeing the @ubi object.
@@ -1077,6 +1089,7 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	free_internal_volumes(ubi);
 	vfree(ubi->vtbl);
 	put_mtd_device(ubi->mtd);
+	ubi_fm_close(ubi);
 	vfree(ubi->peb_buf1);
 	vfree(ubi->peb_buf2);
 #ifdef CONFIG_MTD_UBI_DEBUG_PARANOID
@@ -1155,6 +1168,34 @@ static struct mtd_info * __init open_mtd_device(const char *mtd_dev)
 	return mtd;
 }
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+/**
+ * ubi_reboot_notifier - write the fastmaps before reboot.
+ * @nb: notifier block
+ * @event: reboot event
+ * @unused: unused
+ *
+ * The fastmap of a device is only rewritten when enough of its pool was used,
+ * write an up to date one so that the next boot scans as little as possible.
+ */
+static int ubi_reboot_notifier(struct notifier_block *nb,
+			       unsigned long event, void *unused)
+{
+	int i;
+
+	mutex_lock(&ubi_devices_mutex);
+	for (i = 0; i < UBI_MAX_DEVICES; i++)
+		if (ubi_devices[i])
+			ubi_update_fastmap(ubi_devices[i]);
+	mutex_unlock(&ubi_devices_mutex);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ubi_reboot_nb = {
+	.notifier_call = ubi_reboot_notifier,
+};
+#endif
+
 static int __init ubi_init(void)
 {
 	int err, i, k;
@@ -1162,6 +1203,9 @@ static int __init ubi_init(void)
 	/* Ensure that EC and VID headers have correct size */
 	BUILD_BUG_ON(sizeof(struct ubi_ec_hdr) != 64);
 	BUILD_BUG_ON(sizeof(struct ubi_vid_hdr) != 64);
+	BUILD_BUG_ON(sizeof(struct ubi_fm_hdr) != 64);
+	BUILD_BUG_ON(sizeof(struct ubi_fm_vol) != 20);
+	BUILD_BUG_ON(sizeof(struct ubi_fm_peb) != 12);
 
 	if (mtd_devs > UBI_MAX_DEVICES) {
 		ubi_err("too many MTD devices, maximum is %d", UBI_MAX_DEVICES);
@@ -1233,6 +1277,9 @@ static int __init ubi_init(void)
 		}
 	}
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	register_reboot_notifier(&ubi_reboot_nb);
+#endif
 	return 0;
 
 out_detach:
@@ -1259,6 +1306,9 @@ static void __exit ubi_exit(void)
 {
 	int i;
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	unregister_reboot_notifier(&ubi_reboot_nb);
+#endif
 	for (i = 0; i < UBI_MAX_DEVICES; i++)
 		if (ubi_devices[i]) {
 			mutex_lock(&ubi_devices_mutex);
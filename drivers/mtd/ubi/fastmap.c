@@ -0,0 +1,760 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * UBI fastmap sub-system.
+ *
+ * Scanning reads the EC and VID headers of every PEB, which takes long on
+ * big NAND chips. The fastmap is a snapshot of the EBA tables, erase
+ * counters and PEB states written to one PEB of the internal fastmap volume
+ * among the first %UBI_FM_MAX_START PEBs. Attaching reads it and only scans
+ * the PEBs of its pool.
+ *
+ * For that to be correct, UBI keeps two promises while the fastmap is valid:
+ *   o new data is written only to pool PEBs, the other free PEBs are kept in
+ *     @ubi->fm_reserved (see 'ubi_wl_fm_refill()');
+ *   o a PEB the fastmap maps a LEB to is not erased, its erasure is deferred
+ *     to @ubi->fm_deferred until the next fastmap is written. The scan of the
+ *     pool finds the newer copies of such LEBs, as the fastmap records them
+ *     with sequence number 0.
+ *
+ * When a promise cannot be kept any more, e.g. because the pool ran dry or a
+ * PEB went bad, the fastmap is erased ('ubi_fm_invalidate()') and attaching
+ * falls back to full scanning until the background thread writes a new one.
+ * The fastmap is rewritten when half of the pool was used, when too many
+ * erasures were deferred, on reboot and when the device is detached.
+ *
+ * Note, an unmapped LEB whose erasure was deferred comes back with its old
+ * contents after an unclean reboot unless it was written again. The same may
+ * happen without the fastmap if the erasure did not make it in time, and
+ * 'ubi_wl_flush()' drops the fastmap for callers which need the old contents
+ * to be gone.
+ */
+
+#include <linux/crc32.h>
+#include <linux/bitmap.h>
+#include "ubi.h"
+
+/* Limits of the pool size, which is 1/32 of the PEBs otherwise */
+#define FM_POOL_MIN 16
+#define FM_POOL_MAX 256
+
+/**
+ * fm_pool_size - get the number of PEBs the pool should have.
+ * @ubi: UBI device description object
+ */
+static int fm_pool_size(const struct ubi_device *ubi)
+{
+	return clamp(ubi->peb_count / 32, FM_POOL_MIN, FM_POOL_MAX);
+}
+
+/**
+ * fm_set_peb - fill a fastmap PEB record.
+ * @fpeb: the record
+ * @vol: volume record index or one of the %UBI_FM_PEB_* states
+ * @lnum: logical eraseblock number
+ * @ec: erase counter
+ */
+static void fm_set_peb(struct ubi_fm_peb *fpeb, int vol, int lnum, int ec)
+{
+	fpeb->vol = cpu_to_be16(vol);
+	fpeb->lnum = cpu_to_be32(lnum);
+	fpeb->ec = cpu_to_be32(ec);
+}
+
+/**
+ * fm_erase - erase a PEB owned by the fastmap.
+ * @ubi: UBI device description object
+ * @e: the PEB
+ *
+ * This function erases the PEB and writes its new erase counter. Returns
+ * zero in case of success and a negative error code in case of failure.
+ */
+static int fm_erase(struct ubi_device *ubi, struct ubi_wl_entry *e)
+{
+	int err;
+	struct ubi_ec_hdr *ec_hdr;
+	unsigned long long ec = e->ec;
+
+	ec_hdr = kzalloc(ubi->ec_hdr_alsize, GFP_NOFS);
+	if (!ec_hdr)
+		return -ENOMEM;
+
+	err = ubi_io_sync_erase(ubi, e->pnum, 0);
+	if (err < 0)
+		goto out_free;
+
+	ec += err;
+	if (ec > UBI_MAX_ERASECOUNTER) {
+		ubi_err("erase counter overflow at PEB %d, EC %llu",
+			e->pnum, ec);
+		err = -EINVAL;
+		goto out_free;
+	}
+
+	ec_hdr->ec = cpu_to_be64(ec);
+	err = ubi_io_write_ec_hdr(ubi, e->pnum, ec_hdr);
+	if (err)
+		goto out_free;
+
+	e->ec = ec;
+	spin_lock(&ubi->wl_lock);
+	if (e->ec > ubi->max_ec)
+		ubi->max_ec = e->ec;
+	spin_unlock(&ubi->wl_lock);
+
+out_free:
+	kfree(ec_hdr);
+	return err;
+}
+
+/**
+ * add_to_list - add a PEB to a list of the scanning information.
+ * @si: scanning information
+ * @pnum: physical eraseblock number
+ * @ec: erase counter
+ * @list: the list to add to
+ */
+static int add_to_list(struct ubi_scan_info *si, int pnum, int ec,
+		       struct list_head *list)
+{
+	struct ubi_scan_leb *seb;
+
+	seb = kmalloc(sizeof(struct ubi_scan_leb), GFP_KERNEL);
+	if (!seb)
+		return -ENOMEM;
+
+	seb->pnum = pnum;
+	seb->ec = ec;
+	list_add_tail(&seb->u.list, list);
+	return 0;
+}
+
+/**
+ * check_fm - validate the fastmap read to @ubi->fm_buf.
+ * @ubi: UBI device description object
+ * @fm_pnum: the PEB the fastmap was read from
+ *
+ * Returns zero if the records are consistent and %-EINVAL if not.
+ */
+static int check_fm(const struct ubi_device *ubi, int fm_pnum)
+{
+	const struct ubi_fm_hdr *hdr = ubi->fm_buf;
+	const struct ubi_fm_vol *fvol = ubi->fm_buf + UBI_FM_HDR_SIZE;
+	const struct ubi_fm_peb *fpeb;
+	int i, vol, vol_id, vol_count, pool = 0, bad = 0;
+
+	vol_count = be32_to_cpu(hdr->vol_count);
+	for (i = 0; i < vol_count; i++) {
+		vol_id = be32_to_cpu(fvol[i].vol_id);
+		if ((vol_id < 0 || vol_id >= UBI_MAX_VOLUMES) &&
+		    vol_id != UBI_LAYOUT_VOLUME_ID)
+			return -EINVAL;
+		if (fvol[i].vol_type != UBI_VID_DYNAMIC &&
+		    fvol[i].vol_type != UBI_VID_STATIC)
+			return -EINVAL;
+	}
+
+	fpeb = (const void *)(fvol + vol_count);
+	for (i = 0; i < ubi->peb_count; i++) {
+		vol = be16_to_cpu(fpeb[i].vol);
+		if (be32_to_cpu(fpeb[i].ec) > UBI_MAX_ERASECOUNTER)
+			return -EINVAL;
+		if ((vol == UBI_FM_PEB_FM) != (i == fm_pnum))
+			return -EINVAL;
+
+		switch (vol) {
+		case UBI_FM_PEB_POOL:
+			pool += 1;
+			break;
+		case UBI_FM_PEB_BAD:
+			bad += 1;
+			break;
+		case UBI_FM_PEB_FREE:
+		case UBI_FM_PEB_ERASE:
+		case UBI_FM_PEB_FM:
+			break;
+		default:
+			if (vol >= vol_count ||
+			    (int)be32_to_cpu(fpeb[i].lnum) < 0)
+				return -EINVAL;
+		}
+	}
+
+	if (pool != be32_to_cpu(hdr->pool_size) ||
+	    bad != be32_to_cpu(hdr->bad_peb_count))
+		return -EINVAL;
+	return 0;
+}
+
+/**
+ * read_fm - read and check the fastmap.
+ * @ubi: UBI device description object
+ * @pnum: the PEB to read the fastmap from
+ * @image_seq: image sequence number of the PEB
+ *
+ * This function reads the fastmap to @ubi->fm_buf. Returns zero if it is
+ * good, %UBI_IO_BITFLIPS if it is good but has to be rewritten, %-EINVAL if
+ * it is not usable and other negative error codes in case of failure.
+ */
+static int read_fm(struct ubi_device *ubi, int pnum, int image_seq)
+{
+	int err, bitflips = 0, data_size, vol_count;
+	struct ubi_fm_hdr *hdr = ubi->fm_buf;
+	uint32_t crc;
+
+	err = ubi_io_read_data(ubi, hdr, pnum, 0, UBI_FM_HDR_SIZE);
+	if (err == UBI_IO_BITFLIPS)
+		bitflips = 1;
+	else if (err == -EBADMSG)
+		return -EINVAL;
+	else if (err)
+		return err;
+
+	crc = crc32(UBI_CRC32_INIT, hdr, UBI_FM_HDR_SIZE_CRC);
+	if (be32_to_cpu(hdr->magic) != UBI_FM_HDR_MAGIC ||
+	    crc != be32_to_cpu(hdr->hdr_crc)) {
+		ubi_warn("bad fastmap header in PEB %d", pnum);
+		return -EINVAL;
+	}
+
+	vol_count = be32_to_cpu(hdr->vol_count);
+	data_size = be32_to_cpu(hdr->data_size);
+	if (hdr->version != UBI_FM_VERSION ||
+	    be32_to_cpu(hdr->peb_count) != ubi->peb_count ||
+	    be32_to_cpu(hdr->image_seq) != image_seq ||
+	    vol_count > UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT ||
+	    data_size != vol_count * UBI_FM_VOL_SIZE +
+			 ubi->peb_count * UBI_FM_PEB_SIZE) {
+		ubi_warn("fastmap in PEB %d does not fit this device", pnum);
+		return -EINVAL;
+	}
+
+	err = ubi_io_read_data(ubi, ubi->fm_buf + UBI_FM_HDR_SIZE, pnum,
+			       UBI_FM_HDR_SIZE, data_size);
+	if (err == UBI_IO_BITFLIPS)
+		bitflips = 1;
+	else if (err == -EBADMSG)
+		return -EINVAL;
+	else if (err)
+		return err;
+
+	crc = crc32(UBI_CRC32_INIT, ubi->fm_buf + UBI_FM_HDR_SIZE, data_size);
+	if (crc != be32_to_cpu(hdr->data_crc)) {
+		ubi_warn("bad fastmap data CRC in PEB %d", pnum);
+		return -EINVAL;
+	}
+
+	if (check_fm(ubi, pnum)) {
+		ubi_warn("inconsistent fastmap in PEB %d", pnum);
+		return -EINVAL;
+	}
+
+	return bitflips ? UBI_IO_BITFLIPS : 0;
+}
+
+/**
+ * ubi_fm_load - fill the scanning information from the fastmap.
+ * @ubi: UBI device description object
+ * @si: scanning information to fill
+ *
+ * This function looks for the fastmap among the first %UBI_FM_MAX_START PEBs
+ * and adds what it describes to @si. The PEBs of its pool are left for
+ * 'ubi_scan()', see 'ubi_fm_need_scan()'. Returns %1 if the fastmap was
+ * used, %0 if there is no usable fastmap and the device has to be scanned,
+ * and a negative error code in case of failure.
+ */
+int ubi_fm_load(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	int err, pnum, fm_pnum = -1, image_seq, vol, ec, lnum, dirty;
+	int vol_count, pool = 0;
+	unsigned long long sqnum = 0;
+	struct ubi_vid_hdr *vh;
+	struct ubi_ec_hdr *ech;
+	const struct ubi_fm_hdr *hdr = ubi->fm_buf;
+	const struct ubi_fm_vol *fvol = ubi->fm_buf + UBI_FM_HDR_SIZE, *v;
+	const struct ubi_fm_peb *fpeb;
+
+	/* Unless a fastmap is found, the thread writes one after attaching */
+	ubi->fm_dirty = 1;
+	if (ubi->fm_disabled)
+		return 0;
+
+	err = -ENOMEM;
+	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+	if (!ech)
+		return err;
+
+	vh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vh)
+		goto out_ech;
+
+	for (pnum = 0; pnum < ubi->peb_count && pnum < UBI_FM_MAX_START;
+	     pnum++) {
+		err = ubi_io_is_bad(ubi, pnum);
+		if (err < 0)
+			goto out_vh;
+		else if (err)
+			continue;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+		if (err < 0)
+			goto out_vh;
+		else if (err && err != UBI_IO_BITFLIPS)
+			continue;
+
+		if (be32_to_cpu(vh->vol_id) != UBI_FM_VOLUME_ID)
+			continue;
+		if (fm_pnum == -1 || be64_to_cpu(vh->sqnum) > sqnum) {
+			fm_pnum = pnum;
+			sqnum = be64_to_cpu(vh->sqnum);
+		}
+	}
+
+	err = 0;
+	if (fm_pnum == -1) {
+		ubi_msg("no fastmap found, scanning");
+		goto out_vh;
+	}
+
+	err = ubi_io_read_ec_hdr(ubi, fm_pnum, ech, 0);
+	if (err < 0)
+		goto out_vh;
+	if (err && err != UBI_IO_BITFLIPS) {
+		ubi_warn("bad EC header in fastmap PEB %d, scanning", fm_pnum);
+		err = 0;
+		goto out_vh;
+	}
+	ec = be64_to_cpu(ech->ec);
+	image_seq = be32_to_cpu(ech->image_seq);
+
+	err = read_fm(ubi, fm_pnum, image_seq);
+	if (err == -EINVAL) {
+		ubi_warn("fastmap in PEB %d is not usable, scanning", fm_pnum);
+		err = 0;
+		goto out_vh;
+	} else if (err < 0)
+		goto out_vh;
+	dirty = !!err;
+
+	ubi->fm_e = kmem_cache_alloc(ubi_wl_entry_slab, GFP_KERNEL);
+	err = -ENOMEM;
+	if (!ubi->fm_e)
+		goto out_vh;
+	ubi->fm_e->pnum = fm_pnum;
+	ubi->fm_e->ec = ec;
+
+	ubi->image_seq = image_seq;
+	si->is_empty = 0;
+	si->max_sqnum = be64_to_cpu(hdr->sqnum);
+	bitmap_zero(ubi->fm_pool, ubi->peb_count);
+	bitmap_zero(ubi->fm_used, ubi->peb_count);
+
+	vol_count = be32_to_cpu(hdr->vol_count);
+	fpeb = (const void *)(fvol + vol_count);
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		cond_resched();
+
+		vol = be16_to_cpu(fpeb[pnum].vol);
+		lnum = be32_to_cpu(fpeb[pnum].lnum);
+		ec = be32_to_cpu(fpeb[pnum].ec);
+
+		switch (vol) {
+		case UBI_FM_PEB_POOL:
+			set_bit(pnum, ubi->fm_pool);
+			pool += 1;
+			continue;
+		case UBI_FM_PEB_BAD:
+			si->bad_peb_count += 1;
+			continue;
+		case UBI_FM_PEB_FM:
+			continue;
+		case UBI_FM_PEB_FREE:
+			err = add_to_list(si, pnum, ec, &si->free);
+			break;
+		case UBI_FM_PEB_ERASE:
+			err = add_to_list(si, pnum, ec, &si->erase);
+			break;
+		default:
+			/*
+			 * Make up the VID header with sequence number 0, so
+			 * that any copy found in the pool is newer.
+			 */
+			v = &fvol[vol];
+			memset(vh, 0, sizeof(struct ubi_vid_hdr));
+			vh->vol_type = v->vol_type;
+			vh->compat = v->compat;
+			vh->vol_id = v->vol_id;
+			vh->lnum = cpu_to_be32(lnum);
+			vh->used_ebs = v->used_ebs;
+			vh->data_pad = v->data_pad;
+			vh->data_size = v->last_data_size;
+			err = ubi_scan_add_used(ubi, si, pnum, ec, vh,
+						fpeb[pnum].scrub);
+			set_bit(pnum, ubi->fm_used);
+			break;
+		}
+		if (err)
+			goto out_vh;
+
+		si->ec_sum += ec;
+		si->ec_count += 1;
+		if (ec > si->max_ec)
+			si->max_ec = ec;
+		if (ec < si->min_ec)
+			si->min_ec = ec;
+	}
+
+	ubi->fm_pool_size = pool;
+	ubi->fm_valid = 1;
+	ubi->fm_dirty = dirty;
+	ubi_msg("attaching from fastmap in PEB %d, scanning %d pool PEBs",
+		fm_pnum, pool);
+	err = 1;
+
+out_vh:
+	ubi_free_vid_hdr(ubi, vh);
+out_ech:
+	kfree(ech);
+	return err;
+}
+
+/**
+ * vol_updating - check if a volume update is in progress.
+ * @ubi: UBI device description object
+ *
+ * Static volumes get new used_ebs values in their VID headers on update, the
+ * fastmap is not written until it finished.
+ */
+static int vol_updating(struct ubi_device *ubi)
+{
+	int i, ret = 0;
+
+	spin_lock(&ubi->volumes_lock);
+	for (i = 0; i < UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT; i++)
+		if (ubi->volumes[i] && ubi->volumes[i]->updating)
+			ret = 1;
+	spin_unlock(&ubi->volumes_lock);
+	return ret;
+}
+
+/**
+ * fm_fill - build the fastmap in @ubi->fm_buf.
+ * @ubi: UBI device description object
+ * @sqnum: sequence number to record
+ *
+ * Has to be called with @ubi->wl_lock and @ubi->volumes_lock held, LEB
+ * writers and works stopped and the new pool picked. Returns the size of the
+ * fastmap in case of success and %-EINVAL if some PEBs are not accounted for,
+ * e.g. PEBs of "preserve"-compatible volumes.
+ */
+static int fm_fill(struct ubi_device *ubi, unsigned long long sqnum)
+{
+	int i, lnum, pnum, vol_count = 0, bad = 0, size;
+	struct ubi_fm_hdr *hdr = ubi->fm_buf;
+	struct ubi_fm_vol *fvol = ubi->fm_buf + UBI_FM_HDR_SIZE;
+	struct ubi_fm_peb *fpeb;
+	struct ubi_volume *vol;
+	struct ubi_wl_entry *e;
+	struct ubi_work *wrk;
+	struct rb_node *rb;
+
+	for (i = 0; i < UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT; i++)
+		if (ubi->volumes[i])
+			vol_count += 1;
+	fpeb = (void *)(fvol + vol_count);
+	size = (void *)(fpeb + ubi->peb_count) - ubi->fm_buf;
+
+	memset(ubi->fm_buf, 0, size);
+	for (pnum = 0; pnum < ubi->peb_count; pnum++)
+		fpeb[pnum].vol = cpu_to_be16(UBI_FM_PEB_BAD);
+	bitmap_zero(ubi->fm_used, ubi->peb_count);
+
+	vol_count = 0;
+	for (i = 0; i < UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT; i++) {
+		vol = ubi->volumes[i];
+		if (!vol)
+			continue;
+
+		fvol->vol_id = cpu_to_be32(vol->vol_id);
+		fvol->data_pad = cpu_to_be32(vol->data_pad);
+		if (vol->vol_type == UBI_STATIC_VOLUME) {
+			fvol->vol_type = UBI_VID_STATIC;
+			fvol->used_ebs = cpu_to_be32(vol->used_ebs);
+			fvol->last_data_size = cpu_to_be32(vol->last_eb_bytes);
+		} else
+			fvol->vol_type = UBI_VID_DYNAMIC;
+		if (vol->vol_id == UBI_LAYOUT_VOLUME_ID)
+			fvol->compat = UBI_LAYOUT_VOLUME_COMPAT;
+
+		for (lnum = 0; lnum < vol->reserved_pebs; lnum++) {
+			pnum = vol->eba_tbl[lnum];
+			if (pnum < 0)
+				continue;
+			fm_set_peb(&fpeb[pnum], vol_count, lnum,
+				   ubi->lookuptbl[pnum]->ec);
+			set_bit(pnum, ubi->fm_used);
+		}
+		fvol += 1;
+		vol_count += 1;
+	}
+
+	ubi_rb_for_each_entry(rb, e, &ubi->scrub, u.rb)
+		fpeb[e->pnum].scrub = 1;
+	ubi_rb_for_each_entry(rb, e, &ubi->erroneous, u.rb)
+		fpeb[e->pnum].scrub = 1;
+	ubi_rb_for_each_entry(rb, e, &ubi->free, u.rb)
+		fm_set_peb(&fpeb[e->pnum], UBI_FM_PEB_POOL, 0, e->ec);
+	ubi_rb_for_each_entry(rb, e, &ubi->fm_reserved, u.rb)
+		fm_set_peb(&fpeb[e->pnum], UBI_FM_PEB_FREE, 0, e->ec);
+	list_for_each_entry(wrk, &ubi->works, list)
+		if (ubi_is_erase_work(wrk))
+			fm_set_peb(&fpeb[wrk->e->pnum], UBI_FM_PEB_ERASE, 0,
+				   wrk->e->ec);
+	list_for_each_entry(e, &ubi->fm_deferred, u.list)
+		fm_set_peb(&fpeb[e->pnum], UBI_FM_PEB_ERASE, 0, e->ec);
+	fm_set_peb(&fpeb[ubi->fm_e->pnum], UBI_FM_PEB_FM, 0, ubi->fm_e->ec);
+
+	for (pnum = 0; pnum < ubi->peb_count; pnum++)
+		if (be16_to_cpu(fpeb[pnum].vol) == UBI_FM_PEB_BAD)
+			bad += 1;
+	if (bad != ubi->bad_peb_count) {
+		ubi_warn("%d PEBs are not accounted for",
+			 bad - ubi->bad_peb_count);
+		return -EINVAL;
+	}
+
+	hdr->magic = cpu_to_be32(UBI_FM_HDR_MAGIC);
+	hdr->version = UBI_FM_VERSION;
+	hdr->peb_count = cpu_to_be32(ubi->peb_count);
+	hdr->bad_peb_count = cpu_to_be32(bad);
+	hdr->vol_count = cpu_to_be32(vol_count);
+	hdr->pool_size = cpu_to_be32(ubi->fm_pool_size);
+	hdr->image_seq = cpu_to_be32(ubi->image_seq);
+	hdr->sqnum = cpu_to_be64(sqnum);
+	hdr->data_size = cpu_to_be32(size - UBI_FM_HDR_SIZE);
+	hdr->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT,
+					  ubi->fm_buf + UBI_FM_HDR_SIZE,
+					  size - UBI_FM_HDR_SIZE));
+	hdr->hdr_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, hdr,
+					 UBI_FM_HDR_SIZE_CRC));
+	return size;
+}
+
+/**
+ * fm_write - write the fastmap built in @ubi->fm_buf.
+ * @ubi: UBI device description object
+ * @pnum: the erased PEB to write to
+ * @sqnum: sequence number for the VID header
+ * @size: size of the fastmap
+ */
+static int fm_write(struct ubi_device *ubi, int pnum,
+		    unsigned long long sqnum, int size)
+{
+	int err, len = ALIGN(size, ubi->min_io_size);
+	struct ubi_vid_hdr *vid_hdr;
+
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_NOFS);
+	if (!vid_hdr)
+		return -ENOMEM;
+
+	vid_hdr->vol_type = UBI_VID_DYNAMIC;
+	vid_hdr->vol_id = cpu_to_be32(UBI_FM_VOLUME_ID);
+	vid_hdr->compat = UBI_FM_VOLUME_COMPAT;
+	vid_hdr->sqnum = cpu_to_be64(sqnum);
+
+	err = ubi_io_write_vid_hdr(ubi, pnum, vid_hdr);
+	if (!err) {
+		memset(ubi->fm_buf + size, 0xFF, len - size);
+		err = ubi_io_write_data(ubi, ubi->fm_buf, pnum, 0, len);
+	}
+
+	ubi_free_vid_hdr(ubi, vid_hdr);
+	return err;
+}
+
+/**
+ * ubi_update_fastmap - write a new fastmap.
+ * @ubi: UBI device description object
+ *
+ * This function stops LEB writers and works, erases the old fastmap, picks
+ * a new pool and writes the new fastmap. If it cannot be written, the device
+ * is left without one. Returns zero in case of success and a negative error
+ * code in case of failure.
+ */
+int ubi_update_fastmap(struct ubi_device *ubi)
+{
+	int err = 0, size = 0;
+	unsigned long long sqnum;
+	struct ubi_wl_entry *e;
+
+	mutex_lock(&ubi->device_mutex);
+	down_write(&ubi->fm_sem);
+	down_write(&ubi->work_sem);
+	mutex_lock(&ubi->fm_mutex);
+
+	spin_lock(&ubi->wl_lock);
+	ubi->fm_dirty = 0;
+	spin_unlock(&ubi->wl_lock);
+
+	if (ubi->ro_mode || ubi->fm_disabled || vol_updating(ubi))
+		goto out_unlock;
+
+	if (ubi->fm_e) {
+		/*
+		 * The old fastmap goes first, a power cut from here on costs
+		 * a full scan but never leaves two fastmaps behind.
+		 */
+		err = fm_erase(ubi, ubi->fm_e);
+		if (err) {
+			ubi_err("cannot erase fastmap PEB %d, error %d",
+				ubi->fm_e->pnum, err);
+			ubi_ro_mode(ubi);
+			goto out_unlock;
+		}
+	}
+
+	sqnum = ubi_next_sqnum(ubi);
+	spin_lock(&ubi->wl_lock);
+	ubi->fm_valid = 0;
+	e = ubi_wl_fm_refill(ubi, ubi->fm_e, fm_pool_size(ubi));
+	ubi->fm_e = e;
+	if (e) {
+		spin_lock(&ubi->volumes_lock);
+		size = fm_fill(ubi, sqnum);
+		spin_unlock(&ubi->volumes_lock);
+	}
+	spin_unlock(&ubi->wl_lock);
+
+	if (!e) {
+		ubi_warn("no free PEB among the first %d for the fastmap",
+			 UBI_FM_MAX_START);
+		goto out_release;
+	}
+	if (size < 0) {
+		ubi_warn("fastmap disabled");
+		ubi->fm_disabled = 1;
+		goto out_release;
+	}
+
+	err = fm_write(ubi, e->pnum, sqnum, size);
+	if (err) {
+		ubi_err("cannot write fastmap to PEB %d, error %d",
+			e->pnum, err);
+		goto out_release;
+	}
+
+	dbg_msg("fastmap written to PEB %d, %d bytes, pool of %d PEBs",
+		e->pnum, size, ubi->fm_pool_size);
+	ubi_wl_fm_release(ubi, 1);
+	goto out_unlock;
+
+out_release:
+	ubi_wl_fm_release(ubi, 0);
+out_unlock:
+	mutex_unlock(&ubi->fm_mutex);
+	up_write(&ubi->work_sem);
+	up_write(&ubi->fm_sem);
+	mutex_unlock(&ubi->device_mutex);
+	return err;
+}
+
+/**
+ * ubi_fm_invalidate - erase the fastmap.
+ * @ubi: UBI device description object
+ *
+ * This function is called when UBI is about to do something the fastmap
+ * cannot describe. Once the fastmap is erased, the reserved PEBs are free
+ * and the deferred erasures are scheduled. The background thread is asked
+ * to write a new fastmap.
+ */
+void ubi_fm_invalidate(struct ubi_device *ubi)
+{
+	int err;
+
+	mutex_lock(&ubi->fm_mutex);
+	if (!ubi->fm_valid)
+		goto out_unlock;
+
+	dbg_msg("erase fastmap in PEB %d", ubi->fm_e->pnum);
+	err = fm_erase(ubi, ubi->fm_e);
+	if (err) {
+		/* The fastmap is still there, nothing may change */
+		ubi_err("cannot erase fastmap PEB %d, error %d",
+			ubi->fm_e->pnum, err);
+		ubi_ro_mode(ubi);
+		goto out_unlock;
+	}
+
+	ubi_wl_fm_release(ubi, 0);
+	spin_lock(&ubi->wl_lock);
+	ubi_fm_request_update(ubi);
+	spin_unlock(&ubi->wl_lock);
+
+out_unlock:
+	mutex_unlock(&ubi->fm_mutex);
+}
+
+/**
+ * ubi_fm_init - initialize the fastmap sub-system.
+ * @ubi: UBI device description object
+ *
+ * Has to be called before scanning. Returns zero in case of success and
+ * %-ENOMEM in case of failure.
+ */
+int ubi_fm_init(struct ubi_device *ubi)
+{
+	size_t size = BITS_TO_LONGS(ubi->peb_count) * sizeof(long);
+
+	ubi->fm_reserved = RB_ROOT;
+	INIT_LIST_HEAD(&ubi->fm_deferred);
+	init_rwsem(&ubi->fm_sem);
+	mutex_init(&ubi->fm_mutex);
+
+	ubi->fm_pool = kzalloc(size, GFP_KERNEL);
+	ubi->fm_used = kzalloc(size, GFP_KERNEL);
+	ubi->fm_buf = vmalloc(ubi->leb_size);
+	if (!ubi->fm_pool || !ubi->fm_used || !ubi->fm_buf) {
+		ubi_fm_close(ubi);
+		return -ENOMEM;
+	}
+
+	if (UBI_FM_HDR_SIZE +
+	    (UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT) * UBI_FM_VOL_SIZE +
+	    ubi->peb_count * UBI_FM_PEB_SIZE > ubi->leb_size) {
+		ubi_warn("%d PEBs do not fit the fastmap, it is disabled",
+			 ubi->peb_count);
+		ubi->fm_disabled = 1;
+	}
+
+	return 0;
+}
+
+/**
+ * ubi_fm_close - close the fastmap sub-system.
+ * @ubi: UBI device description object
+ */
+void ubi_fm_close(struct ubi_device *ubi)
+{
+	if (ubi->fm_e)
+		kmem_cache_free(ubi_wl_entry_slab, ubi->fm_e);
+	ubi->fm_e = NULL;
+	kfree(ubi->fm_pool);
+	kfree(ubi->fm_used);
+	vfree(ubi->fm_buf);
+	ubi->fm_pool = ubi->fm_used = NULL;
+	ubi->fm_buf = NULL;
+}
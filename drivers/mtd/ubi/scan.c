@@ -829,6 +829,18 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 	}
 
 	vol_id = be32_to_cpu(vidh->vol_id);
+	if (vol_id == UBI_FM_VOLUME_ID) {
+		/*
+		 * A fastmap which was not used for attaching is stale, the
+		 * next one is written to another PEB.
+		 */
+		dbg_bld("stale fastmap in PEB %d", pnum);
+		err = add_to_list(si, pnum, ec, &si->erase);
+		if (err)
+			return err;
+		goto adjust_mean_ec;
+	}
+
 	if (vol_id > UBI_MAX_VOLUMES && vol_id != UBI_LAYOUT_VOLUME_ID) {
 		int lnum = be32_to_cpu(vidh->lnum);
 
@@ -890,7 +902,8 @@ adjust_mean_ec:
  * @ubi: UBI device description object
  *
  * This function does full scanning of an MTD device and returns complete
- * information about it. In case of failure, an error code is returned.
+ * information about it. If a fastmap is found, only the PEBs of its pool are
+ * scanned. In case of failure, an error code is returned.
  */
 struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 {
@@ -920,9 +933,17 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 	if (!vidh)
 		goto out_ech;
 
+	err = ubi_fm_load(ubi, si);
+	if (err < 0)
+		goto out_vidh;
+
 	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
 		cond_resched();
 
+		/* The fastmap describes all PEBs but those of its pool */
+		if (!ubi_fm_need_scan(ubi, pnum))
+			continue;
+
 		dbg_gen("process PEB %d", pnum);
 		err = process_eb(ubi, si, pnum);
 		if (err < 0)
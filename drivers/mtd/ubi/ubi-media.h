@@ -375,4 +375,115 @@ struct ubi_vtbl_record {
 	__be32  crc;
 } __attribute__ ((packed));
 
+/*
+ * The fastmap is a snapshot of the EBA tables and erase counters stored in
+ * one PEB of the internal fastmap volume. It is only looked for in the first
+ * %UBI_FM_MAX_START PEBs. Kernels which do not know the volume delete it,
+ * which is what makes them fall back to full scanning safely.
+ */
+#define UBI_FM_VOLUME_ID     (UBI_INTERNAL_VOL_START + 1)
+#define UBI_FM_VOLUME_COMPAT UBI_COMPAT_DELETE
+#define UBI_FM_MAX_START     64
+
+#define UBI_FM_HDR_MAGIC 0x55424946
+#define UBI_FM_VERSION   1
+
+/*
+ * Special values of the @vol field of &struct ubi_fm_peb for PEBs which do
+ * not belong to a volume.
+ */
+#define UBI_FM_PEB_FREE  0xFFFF
+#define UBI_FM_PEB_POOL  0xFFFE
+#define UBI_FM_PEB_ERASE 0xFFFD
+#define UBI_FM_PEB_BAD   0xFFFC
+#define UBI_FM_PEB_FM    0xFFFB
+
+/* Sizes of the fastmap records */
+#define UBI_FM_HDR_SIZE     sizeof(struct ubi_fm_hdr)
+#define UBI_FM_HDR_SIZE_CRC (UBI_FM_HDR_SIZE - sizeof(__be32))
+#define UBI_FM_VOL_SIZE     sizeof(struct ubi_fm_vol)
+#define UBI_FM_PEB_SIZE     sizeof(struct ubi_fm_peb)
+
+/**
+ * struct ubi_fm_hdr - fastmap header.
+ * @magic: fastmap header magic number (%UBI_FM_HDR_MAGIC)
+ * @version: version of the fastmap format (%UBI_FM_VERSION)
+ * @padding1: reserved for future, zeroes
+ * @peb_count: count of PEBs the fastmap describes
+ * @bad_peb_count: count of bad PEBs
+ * @vol_count: count of &struct ubi_fm_vol records
+ * @pool_size: count of PEBs in the pool
+ * @image_seq: image sequence number
+ * @sqnum: sequence number higher than any on the flash when the fastmap was
+ *         written
+ * @data_size: how many bytes of records follow the header
+ * @data_crc: CRC32 checksum of the records
+ * @padding2: reserved for future, zeroes
+ * @hdr_crc: fastmap header CRC checksum
+ *
+ * The header is followed by @vol_count volume records and then by one
+ * &struct ubi_fm_peb record per PEB, indexed by the PEB number.
+ *
+ * PEBs in the pool were free when the fastmap was written and are the only
+ * ones UBI writes to until the next fastmap, so attaching scans just them.
+ * Everything else on the flash is known to be as the fastmap says: a PEB a
+ * LEB was mapped to is not erased before a newer fastmap is written, and if
+ * the fastmap cannot be kept up to date it is erased and attaching falls
+ * back to full scanning.
+ */
+struct ubi_fm_hdr {
+	__be32  magic;
+	__u8    version;
+	__u8    padding1[3];
+	__be32  peb_count;
+	__be32  bad_peb_count;
+	__be32  vol_count;
+	__be32  pool_size;
+	__be32  image_seq;
+	__be64  sqnum;
+	__be32  data_size;
+	__be32  data_crc;
+	__u8    padding2[16];
+	__be32  hdr_crc;
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_fm_vol - a volume record in the fastmap.
+ * @vol_id: ID of this volume
+ * @used_ebs: number of used logical eraseblocks (static volumes only)
+ * @data_pad: how many bytes at the end of logical eraseblocks are not used
+ * @last_data_size: data bytes in the last logical eraseblock (static volumes
+ *                  only)
+ * @vol_type: volume type (%UBI_VID_DYNAMIC or %UBI_VID_STATIC)
+ * @compat: compatibility of this volume as in its VID headers
+ * @padding: reserved for future, zeroes
+ */
+struct ubi_fm_vol {
+	__be32  vol_id;
+	__be32  used_ebs;
+	__be32  data_pad;
+	__be32  last_data_size;
+	__u8    vol_type;
+	__u8    compat;
+	__u8    padding[2];
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_fm_peb - a PEB record in the fastmap.
+ * @ec: erase counter
+ * @lnum: logical eraseblock number mapped to this PEB
+ * @vol: index of the volume record, or one of %UBI_FM_PEB_FREE,
+ *       %UBI_FM_PEB_POOL, %UBI_FM_PEB_ERASE, %UBI_FM_PEB_BAD and
+ *       %UBI_FM_PEB_FM
+ * @scrub: if the PEB has to be scrubbed
+ * @padding: reserved for future, zeroes
+ */
+struct ubi_fm_peb {
+	__be32  ec;
+	__be32  lnum;
+	__be16  vol;
+	__u8    scrub;
+	__u8    padding;
+} __attribute__ ((packed));
+
 #endif /* !__UBI_MEDIA_H__ */
@@ -144,6 +144,26 @@ struct ubi_wl_entry {
 	int pnum;
 };
 
+/**
+ * struct ubi_work - UBI work description data structure.
+ * @list: a link in the list of pending works
+ * @func: worker function
+ * @e: physical eraseblock to erase
+ * @torture: if the physical eraseblock has to be tortured
+ *
+ * The @func pointer points to the worker function. If the @cancel argument is
+ * not zero, the worker has to free the resources and exit immediately. The
+ * worker has to return zero in case of success and a negative error code in
+ * case of failure.
+ */
+struct ubi_work {
+	struct list_head list;
+	int (*func)(struct ubi_device *ubi, struct ubi_work *wrk, int cancel);
+	/* The below fields are only relevant to erasure works */
+	struct ubi_wl_entry *e;
+	int torture;
+};
+
 /**
  * struct ubi_ltree_entry - an entry in the lock tree.
  * @rb: links RB-tree nodes
@@ -336,7 +356,8 @@ struct ubi_wl_entry;
  * @pq_head: protection queue head
  * @wl_lock: protects the @used, @free, @pq, @pq_head, @lookuptbl, @move_from,
  * 	     @move_to, @move_to_put @erase_pending, @wl_scheduled, @works,
- * 	     @erroneous, and @erroneous_peb_count fields
+ * 	     @erroneous, @erroneous_peb_count and the fastmap fields except
+ * 	     @fm_e and @fm_buf
  * @move_mutex: serializes eraseblock moves
  * @work_sem: synchronizes the WL worker with use tasks
  * @wl_scheduled: non-zero if the wear-leveling was scheduled
@@ -351,6 +372,24 @@ struct ubi_wl_entry;
  * @thread_enabled: if the background thread is enabled
  * @bgt_name: background thread name
  *
+ * @fm_e: the PEB holding the fastmap, not in any WL tree
+ * @fm_valid: non-zero while the fastmap on the flash describes the device
+ * @fm_dirty: the background thread has to rewrite the fastmap
+ * @fm_disabled: the fastmap cannot describe this device
+ * @fm_pool_size: count of PEBs in the fastmap pool
+ * @fm_pool_used: PEBs taken from the pool since the fastmap was written
+ * @fm_pool: bitmap of the pool PEBs
+ * @fm_used: bitmap of the PEBs the fastmap maps a LEB to
+ * @fm_reserved: RB-tree of free PEBs outside of the pool
+ * @fm_deferred: list of PEBs which may only be erased after the fastmap is
+ *               rewritten
+ * @fm_deferred_count: count of PEBs in @fm_deferred
+ * @fm_sem: taken for reading by LEB writers and for writing by the fastmap
+ *          writer
+ * @fm_mutex: serializes writing and erasing the fastmap, protects @fm_e and
+ *            @fm_buf
+ * @fm_buf: buffer of LEB size the fastmap is built in
+ *
  * @flash_size: underlying MTD device size (in bytes)
  * @peb_count: count of physical eraseblocks on the MTD device
  * @peb_size: physical eraseblock size
@@ -436,6 +475,24 @@ struct ubi_device {
 	int thread_enabled;
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	/* Fastmap stuff */
+	struct ubi_wl_entry *fm_e;
+	int fm_valid;
+	int fm_dirty;
+	int fm_disabled;
+	int fm_pool_size;
+	int fm_pool_used;
+	unsigned long *fm_pool;
+	unsigned long *fm_used;
+	struct rb_root fm_reserved;
+	struct list_head fm_deferred;
+	int fm_deferred_count;
+	struct rw_semaphore fm_sem;
+	struct mutex fm_mutex;
+	void *fm_buf;
+#endif
+
 	/* I/O sub-system's stuff */
 	long long flash_size;
 	int peb_count;
@@ -522,6 +579,7 @@ int ubi_eba_atomic_leb_change(struct ubi_device *ubi, struct ubi_volume *vol,
 int ubi_eba_copy_leb(struct ubi_device *ubi, int from, int to,
 		     struct ubi_vid_hdr *vid_hdr);
 int ubi_eba_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
+unsigned long long ubi_next_sqnum(struct ubi_device *ubi);
 
 /* wl.c */
 int ubi_wl_get_peb(struct ubi_device *ubi, int dtype);
@@ -531,6 +589,28 @@ int ubi_wl_scrub_peb(struct ubi_device *ubi, int pnum);
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_wl_close(struct ubi_device *ubi);
 int ubi_thread(void *u);
+int ubi_is_erase_work(struct ubi_work *wrk);
+#ifdef CONFIG_MTD_UBI_FASTMAP
+struct ubi_wl_entry *ubi_wl_fm_refill(struct ubi_device *ubi,
+				      struct ubi_wl_entry *fm_e, int size);
+void ubi_wl_fm_release(struct ubi_device *ubi, int valid);
+#endif
+
+/* fastmap.c */
+#ifdef CONFIG_MTD_UBI_FASTMAP
+int ubi_fm_init(struct ubi_device *ubi);
+void ubi_fm_close(struct ubi_device *ubi);
+int ubi_fm_load(struct ubi_device *ubi, struct ubi_scan_info *si);
+int ubi_update_fastmap(struct ubi_device *ubi);
+void ubi_fm_invalidate(struct ubi_device *ubi);
+#else
+static inline int ubi_fm_init(struct ubi_device *ubi) { return 0; }
+static inline void ubi_fm_close(struct ubi_device *ubi) {}
+static inline int ubi_fm_load(struct ubi_device *ubi,
+			      struct ubi_scan_info *si) { return 0; }
+static inline int ubi_update_fastmap(struct ubi_device *ubi) { return 0; }
+static inline void ubi_fm_invalidate(struct ubi_device *ubi) {}
+#endif
 
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
@@ -658,6 +738,60 @@ static inline void ubi_ro_mode(struct ubi_device *ubi)
 	}
 }
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+/**
+ * ubi_fm_need_scan - check if attaching has to scan a PEB.
+ * @ubi: UBI device description object
+ * @pnum: the physical eraseblock
+ *
+ * Once the fastmap is loaded, only the PEBs of its pool are scanned.
+ */
+static inline int ubi_fm_need_scan(const struct ubi_device *ubi, int pnum)
+{
+	return !ubi->fm_valid || test_bit(pnum, ubi->fm_pool);
+}
+
+/**
+ * ubi_fm_request_update - ask the background thread to rewrite the fastmap.
+ * @ubi: UBI device description object
+ *
+ * Has to be called with @ubi->wl_lock held.
+ */
+static inline void ubi_fm_request_update(struct ubi_device *ubi)
+{
+	ubi->fm_dirty = 1;
+	if (ubi->thread_enabled)
+		wake_up_process(ubi->bgt_thread);
+}
+
+/*
+ * LEB writers hold @ubi->fm_sem for reading, so the fastmap writer sees
+ * the EBA tables between writes.
+ */
+static inline void ubi_fm_write_lock(struct ubi_device *ubi)
+{
+	down_read(&ubi->fm_sem);
+}
+
+static inline int ubi_fm_write_trylock(struct ubi_device *ubi)
+{
+	return down_read_trylock(&ubi->fm_sem);
+}
+
+static inline void ubi_fm_write_unlock(struct ubi_device *ubi)
+{
+	up_read(&ubi->fm_sem);
+}
+#else
+static inline int ubi_fm_need_scan(const struct ubi_device *ubi, int pnum)
+{
+	return 1;
+}
+static inline void ubi_fm_write_lock(struct ubi_device *ubi) {}
+static inline int ubi_fm_write_trylock(struct ubi_device *ubi) { return 1; }
+static inline void ubi_fm_write_unlock(struct ubi_device *ubi) {}
+#endif
+
 /**
  * vol_id2idx - get table index by volume ID.
  * @ubi: UBI device description object
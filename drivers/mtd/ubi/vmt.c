@@ -437,6 +437,8 @@ int ubi_remove_volume(struct ubi_volume_desc *desc, int no_vtbl)
 		if (err)
 			goto out_err;
 	}
+	/* The fastmap still maps LEBs of the volume */
+	ubi_fm_invalidate(ubi);
 
 	cdev_del(&vol->cdev);
 	volume_sysfs_close(vol);
@@ -553,6 +555,7 @@ int ubi_resize_volume(struct ubi_volume_desc *desc, int reserved_pebs)
 			if (err)
 				goto out_acc;
 		}
+		ubi_fm_invalidate(ubi);
 		spin_lock(&ubi->volumes_lock);
 		ubi->rsvd_pebs += pebs;
 		ubi->avail_pebs -= pebs;
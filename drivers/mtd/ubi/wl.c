@@ -141,26 +141,6 @@
  */
 #define WL_MAX_FAILURES 32
 
-/**
- * struct ubi_work - UBI work description data structure.
- * @list: a link in the list of pending works
- * @func: worker function
- * @e: physical eraseblock to erase
- * @torture: if the physical eraseblock has to be tortured
- *
- * The @func pointer points to the worker function. If the @cancel argument is
- * not zero, the worker has to free the resources and exit immediately. The
- * worker has to return zero in case of success and a negative error code in
- * case of failure.
- */
-struct ubi_work {
-	struct list_head list;
-	int (*func)(struct ubi_device *ubi, struct ubi_work *wrk, int cancel);
-	/* The below fields are only relevant to erasure works */
-	struct ubi_wl_entry *e;
-	int torture;
-};
-
 #ifdef CONFIG_MTD_UBI_DEBUG_PARANOID
 static int paranoid_check_ec(struct ubi_device *ubi, int pnum, int ec);
 static int paranoid_check_in_wl_tree(struct ubi_wl_entry *e,
@@ -208,6 +188,30 @@ static void wl_tree_add(struct ubi_wl_entry *e, struct rb_root *root)
 	rb_insert_color(&e->u.rb, root);
 }
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+/**
+ * free_tree - get the tree an erased physical eraseblock goes to.
+ * @ubi: UBI device description object
+ * @pnum: the physical eraseblock
+ *
+ * While the fastmap is valid, new data may only go to the PEBs of its pool,
+ * as attaching scans nothing else. The other erased PEBs wait in
+ * @ubi->fm_reserved until the fastmap is rewritten. Has to be called with
+ * @ubi->wl_lock held.
+ */
+static struct rb_root *free_tree(struct ubi_device *ubi, int pnum)
+{
+	if (ubi->fm_valid && !test_bit(pnum, ubi->fm_pool))
+		return &ubi->fm_reserved;
+	return &ubi->free;
+}
+#else
+static inline struct rb_root *free_tree(struct ubi_device *ubi, int pnum)
+{
+	return &ubi->free;
+}
+#endif
+
 /**
  * do_work - do one pending work.
  * @ubi: UBI device description object
@@ -269,7 +273,7 @@ static int produce_free_peb(struct ubi_device *ubi)
 	int err;
 
 	spin_lock(&ubi->wl_lock);
-	while (!ubi->free.rb_node) {
+	while (!ubi->free.rb_node && ubi->works_count) {
 		spin_unlock(&ubi->wl_lock);
 
 		dbg_wl("do one work synchronously");
@@ -395,6 +399,19 @@ int ubi_wl_get_peb(struct ubi_device *ubi, int dtype)
 retry:
 	spin_lock(&ubi->wl_lock);
 	if (!ubi->free.rb_node) {
+#ifdef CONFIG_MTD_UBI_FASTMAP
+		if (ubi->fm_reserved.rb_node) {
+			/*
+			 * The pool ran dry before the fastmap was rewritten.
+			 * Drop the fastmap to get the reserved PEBs back.
+			 */
+			spin_unlock(&ubi->wl_lock);
+			ubi_fm_invalidate(ubi);
+			if (ubi->ro_mode)
+				return -EROFS;
+			goto retry;
+		}
+#endif
 		if (ubi->works_count == 0) {
 			ubi_assert(list_empty(&ubi->works));
 			ubi_err("no free eraseblocks");
@@ -458,6 +475,11 @@ retry:
 	rb_erase(&e->u.rb, &ubi->free);
 	dbg_wl("PEB %d EC %d", e->pnum, e->ec);
 	prot_queue_add(ubi, e);
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	if (ubi->fm_valid && !ubi->fm_dirty &&
+	    ++ubi->fm_pool_used * 2 >= ubi->fm_pool_size)
+		ubi_fm_request_update(ubi);
+#endif
 	spin_unlock(&ubi->wl_lock);
 
 	err = ubi_dbg_check_all_ff(ubi, e->pnum, ubi->vid_hdr_aloffset,
@@ -1012,6 +1034,25 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 		return 0;
 	}
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	spin_lock(&ubi->wl_lock);
+	if (ubi->fm_valid && test_bit(pnum, ubi->fm_used)) {
+		/*
+		 * The fastmap still maps a LEB to this PEB, so its contents
+		 * have to stay until the fastmap is rewritten.
+		 */
+		dbg_wl("defer erasure of PEB %d EC %d", pnum, e->ec);
+		list_add_tail(&e->u.list, &ubi->fm_deferred);
+		ubi->fm_deferred_count += 1;
+		if (ubi->fm_deferred_count > ubi->fm_pool_size)
+			ubi_fm_request_update(ubi);
+		spin_unlock(&ubi->wl_lock);
+		kfree(wl_wrk);
+		return 0;
+	}
+	spin_unlock(&ubi->wl_lock);
+#endif
+
 	dbg_wl("erase PEB %d EC %d", pnum, e->ec);
 
 	err = sync_erase(ubi, e, wl_wrk->torture);
@@ -1020,7 +1061,7 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 		kfree(wl_wrk);
 
 		spin_lock(&ubi->wl_lock);
-		wl_tree_add(e, &ubi->free);
+		wl_tree_add(e, free_tree(ubi, pnum));
 		spin_unlock(&ubi->wl_lock);
 
 		/*
@@ -1083,6 +1124,9 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 	}
 	spin_unlock(&ubi->volumes_lock);
 
+	/* The fastmap would have attaching erase this PEB once more */
+	ubi_fm_invalidate(ubi);
+
 	ubi_msg("mark PEB %d as bad", pnum);
 	err = ubi_io_mark_bad(ubi, pnum);
 	if (err)
@@ -1106,6 +1150,15 @@ out_ro:
 	return err;
 }
 
+/**
+ * ubi_is_erase_work - check if a work is an erasure.
+ * @wrk: the work to check
+ */
+int ubi_is_erase_work(struct ubi_work *wrk)
+{
+	return wrk->func == erase_worker;
+}
+
 /**
  * ubi_wl_put_peb - return a PEB to the wear-leveling sub-system.
  * @ubi: UBI device description object
@@ -1266,6 +1319,18 @@ int ubi_wl_flush(struct ubi_device *ubi)
 {
 	int err;
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	/*
+	 * Callers expect unmapped LEBs to be gone from the flash afterwards,
+	 * which is not true for the PEBs the fastmap holds on to.
+	 */
+	spin_lock(&ubi->wl_lock);
+	err = !list_empty(&ubi->fm_deferred);
+	spin_unlock(&ubi->wl_lock);
+	if (err)
+		ubi_fm_invalidate(ubi);
+#endif
+
 	/*
 	 * Erase while the pending works queue is not empty, but not more than
 	 * the number of currently pending works.
@@ -1298,6 +1363,125 @@ int ubi_wl_flush(struct ubi_device *ubi)
 	return 0;
 }
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+/**
+ * move_tree - move all entries of one RB-tree to another.
+ * @from: the tree to empty
+ * @to: the tree to add the entries to
+ */
+static void move_tree(struct rb_root *from, struct rb_root *to)
+{
+	struct rb_node *rb;
+	struct ubi_wl_entry *e;
+
+	while ((rb = rb_first(from))) {
+		e = rb_entry(rb, struct ubi_wl_entry, u.rb);
+		rb_erase(rb, from);
+		wl_tree_add(e, to);
+	}
+}
+
+/**
+ * ubi_wl_fm_refill - pick the fastmap PEB and a new pool.
+ * @ubi: UBI device description object
+ * @fm_e: the erased PEB which held the previous fastmap, or %NULL
+ * @size: how many PEBs the pool should have
+ *
+ * All free PEBs, @fm_e included, are put together. The least worn one which
+ * attaching looks at becomes the fastmap PEB and is returned, or %NULL if
+ * there is no such PEB. Up to @size of the rest become the new pool, picked
+ * evenly over the range of erase counters so wear-leveling is still free to
+ * choose, and the others are reserved. Has to be called with @ubi->wl_lock
+ * held.
+ */
+struct ubi_wl_entry *ubi_wl_fm_refill(struct ubi_device *ubi,
+				      struct ubi_wl_entry *fm_e, int size)
+{
+	int count = 0, stride, i = 0;
+	struct ubi_wl_entry *e, *fm = NULL;
+	struct rb_node *rb;
+
+	move_tree(&ubi->fm_reserved, &ubi->free);
+	if (fm_e) {
+		ubi->lookuptbl[fm_e->pnum] = fm_e;
+		wl_tree_add(fm_e, &ubi->free);
+	}
+
+	ubi_rb_for_each_entry(rb, e, &ubi->free, u.rb) {
+		if (!fm && e->pnum < UBI_FM_MAX_START)
+			fm = e;
+		count += 1;
+	}
+	if (!fm)
+		return NULL;
+	rb_erase(&fm->u.rb, &ubi->free);
+	count -= 1;
+
+	bitmap_zero(ubi->fm_pool, ubi->peb_count);
+	ubi->fm_pool_size = 0;
+	stride = max(count / size, 1);
+	rb = rb_first(&ubi->free);
+	while (rb) {
+		e = rb_entry(rb, struct ubi_wl_entry, u.rb);
+		rb = rb_next(rb);
+		if (i++ % stride == 0 && ubi->fm_pool_size < size) {
+			set_bit(e->pnum, ubi->fm_pool);
+			ubi->fm_pool_size += 1;
+			continue;
+		}
+		rb_erase(&e->u.rb, &ubi->free);
+		wl_tree_add(e, &ubi->fm_reserved);
+	}
+
+	return fm;
+}
+
+/**
+ * ubi_wl_fm_release - release the PEBs held back for the fastmap.
+ * @ubi: UBI device description object
+ * @valid: if the fastmap has just been written and is valid
+ *
+ * The PEBs whose erasure was deferred are scheduled for erasure. If the
+ * fastmap is not valid, the reserved PEBs become free again.
+ */
+void ubi_wl_fm_release(struct ubi_device *ubi, int valid)
+{
+	struct ubi_wl_entry *e, *tmp;
+	LIST_HEAD(deferred);
+
+	spin_lock(&ubi->wl_lock);
+	ubi->fm_valid = valid;
+	ubi->fm_pool_used = 0;
+	if (!valid)
+		move_tree(&ubi->fm_reserved, &ubi->free);
+	list_splice_init(&ubi->fm_deferred, &deferred);
+	ubi->fm_deferred_count = 0;
+	spin_unlock(&ubi->wl_lock);
+
+	list_for_each_entry_safe(e, tmp, &deferred, u.list) {
+		list_del(&e->u.list);
+		if (schedule_erase(ubi, e, 0)) {
+			kmem_cache_free(ubi_wl_entry_slab, e);
+			ubi_ro_mode(ubi);
+		}
+	}
+}
+
+/**
+ * deferred_destroy - free the PEBs whose erasure was deferred.
+ * @ubi: UBI device description object
+ */
+static void deferred_destroy(struct ubi_device *ubi)
+{
+	struct ubi_wl_entry *e, *tmp;
+
+	list_for_each_entry_safe(e, tmp, &ubi->fm_deferred, u.list) {
+		list_del(&e->u.list);
+		kmem_cache_free(ubi_wl_entry_slab, e);
+	}
+}
+#endif
+
 /**
  * tree_destroy - destroy an RB-tree.
  * @root: the root of the tree to destroy
@@ -1329,6 +1513,18 @@ static void tree_destroy(struct rb_root *root)
 	}
 }
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+static inline int fm_dirty(struct ubi_device *ubi)
+{
+	return ubi->fm_dirty;
+}
+#else
+static inline int fm_dirty(struct ubi_device *ubi)
+{
+	return 0;
+}
+#endif
+
 /**
  * ubi_thread - UBI background thread.
  * @u: the UBI device description object pointer
@@ -1343,7 +1539,7 @@ int ubi_thread(void *u)
 
 	set_freezable();
 	for (;;) {
-		int err;
+		int err, idle;
 
 		if (kthread_should_stop())
 			break;
@@ -1352,7 +1548,8 @@ int ubi_thread(void *u)
 			continue;
 
 		spin_lock(&ubi->wl_lock);
-		if (list_empty(&ubi->works) || ubi->ro_mode ||
+		idle = list_empty(&ubi->works);
+		if ((idle && !fm_dirty(ubi)) || ubi->ro_mode ||
 			       !ubi->thread_enabled) {
 			set_current_state(TASK_INTERRUPTIBLE);
 			spin_unlock(&ubi->wl_lock);
@@ -1361,6 +1558,12 @@ int ubi_thread(void *u)
 		}
 		spin_unlock(&ubi->wl_lock);
 
+		if (idle) {
+			/* Nothing else to do, rewrite the fastmap */
+			ubi_update_fastmap(ubi);
+			continue;
+		}
+
 		err = do_work(ubi);
 		if (err) {
 			ubi_err("%s: work failed with error code %d",
@@ -1463,7 +1666,7 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 		e->pnum = seb->pnum;
 		e->ec = seb->ec;
 		ubi_assert(e->ec >= 0);
-		wl_tree_add(e, &ubi->free);
+		wl_tree_add(e, free_tree(ubi, e->pnum));
 		ubi->lookuptbl[e->pnum] = e;
 	}
 
@@ -1514,6 +1717,17 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 	ubi->avail_pebs -= WL_RESERVED_PEBS;
 	ubi->rsvd_pebs += WL_RESERVED_PEBS;
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	/* One PEB holds the fastmap, if the volumes left one over */
+	if (ubi->avail_pebs > 0) {
+		ubi->avail_pebs -= 1;
+		ubi->rsvd_pebs += 1;
+	} else {
+		ubi_warn("no PEB left for the fastmap");
+		ubi->fm_disabled = 1;
+	}
+#endif
+
 	/* Schedule wear-leveling if needed */
 	err = ensure_wear_leveling(ubi);
 	if (err)
@@ -1526,6 +1740,9 @@ out_free:
 	tree_destroy(&ubi->used);
 	tree_destroy(&ubi->free);
 	tree_destroy(&ubi->scrub);
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	tree_destroy(&ubi->fm_reserved);
+#endif
 	kfree(ubi->lookuptbl);
 	return err;
 }
@@ -1560,6 +1777,10 @@ void ubi_wl_close(struct ubi_device *ubi)
 	tree_destroy(&ubi->erroneous);
 	tree_destroy(&ubi->free);
 	tree_destroy(&ubi->scrub);
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	tree_destroy(&ubi->fm_reserved);
+	deferred_destroy(ubi);
+#endif
 	kfree(ubi->lookuptbl);
 }
 
@@ -39,6 +39,7 @@ when         who        what, where, why                                 comment
 #include <linux/platform_device.h>
 #include <linux/if_arp.h>
 #include <linux/msm_rmnet.h>
+#include <net/checksum.h>
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #include <linux/earlysuspend.h>
@@ -62,6 +63,18 @@ when         who        what, where, why                                 comment
 
 #define HEADROOM_FOR_QOS    8
 
+#define RMNET_NAPI_WEIGHT	64
+#define RMNET_RX_POOL_MAX	32
+
+/* largest aggregated smd packet, and bytes queued before the
+   queue is stopped when aggregating */
+static uint rmnet_agg_size = 4096;
+module_param_named(agg_size, rmnet_agg_size,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+static uint rmnet_agg_limit = 16384;
+module_param_named(agg_limit, rmnet_agg_limit,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
 static const char *ch_name[8] = {
 	"DATA5",
 	"DATA6",
@@ -90,6 +103,11 @@ struct rmnet_private
 	struct sk_buff *skb;
 	spinlock_t lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
+	struct sk_buff_head rx_pool;	/* recycled tx skbs for rx */
+	struct sk_buff_head tx_q;	/* waiting to be aggregated */
+	unsigned tx_q_bytes;		/* protected by tx_q.lock */
+	struct tasklet_struct agg_tsklt;
 	u32 operation_mode;    /* IOCTL specified mode (protocol, QoS header) */
 	struct platform_driver pdrv;
 	struct completion complete;
@@ -252,21 +270,108 @@ static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
 	return protocol;
 }
 
-/* Called in soft-irq context */
-static void smd_net_data_handler(unsigned long arg)
+/* Largest frame rx can be handed, as the checks in rmnet_poll() go */
+static int rmnet_rx_buf_size(struct net_device *dev)
+{
+	return max_t(int, dev->mtu, RMNET_DEFAULT_MTU_LEN) + ETH_HLEN +
+		NET_IP_ALIGN;
+}
+
+/*
+ * Transmitted skbs that are big enough, linear and not shared are kept
+ * on rx_pool, so that most receives don't have to allocate.
+ */
+static void rmnet_recycle_skb(struct net_device *dev, struct sk_buff *skb)
+{
+	struct rmnet_private *p = netdev_priv(dev);
+
+	if (skb_queue_len(&p->rx_pool) < RMNET_RX_POOL_MAX &&
+	    skb_recycle_check(skb, rmnet_rx_buf_size(dev)))
+		skb_queue_tail(&p->rx_pool, skb);
+	else
+		dev_kfree_skb_any(skb);
+}
+
+static struct sk_buff *rmnet_rx_skb(struct net_device *dev, int sz)
 {
-	struct net_device *dev = (struct net_device *) arg;
 	struct rmnet_private *p = netdev_priv(dev);
 	struct sk_buff *skb;
+
+	skb = skb_dequeue(&p->rx_pool);
+	if (skb && skb_tailroom(skb) < sz + NET_IP_ALIGN) {
+		/* left over from a larger mtu */
+		dev_kfree_skb_any(skb);
+		skb = NULL;
+	}
+	if (!skb)
+		skb = dev_alloc_skb(sz + NET_IP_ALIGN);
+
+	return skb;
+}
+
+/*
+ * Copies a packet out of the fifo and checksums everything from @start
+ * on in the same pass, so that neither GRO nor the protocols read it again.
+ */
+static int rmnet_read_csum(struct rmnet_private *p, unsigned char *data,
+			   int len, int start, __wsum *csum)
+{
+	__wsum sum = 0;
+	void *ptr;
+	int off = 0, n, skip;
+
+	while (off < len) {
+		n = smd_read_buffer(p->ch, &ptr);
+		if (n <= 0)
+			break;
+		if (n > len - off)
+			n = len - off;
+
+		skip = 0;
+		if (off < start) {
+			skip = min(n, start - off);
+			memcpy(data + off, ptr, skip);
+		}
+		if (n > skip)
+			sum = csum_block_add(sum,
+				csum_partial_copy_nocheck(ptr + skip,
+							  data + off + skip,
+							  n - skip, 0),
+				off + skip - start);
+
+		smd_read_done(p->ch, n);
+		off += n;
+	}
+
+	*csum = sum;
+	return off;
+}
+
+static int rmnet_rx_pending(struct rmnet_private *p)
+{
+	return p->ch && smd_read_avail(p->ch) &&
+		(smd_read_avail(p->ch) >= smd_cur_packet_size(p->ch));
+}
+
+/* Called in soft-irq context */
+static int rmnet_poll(struct napi_struct *napi, int budget)
+{
+	struct rmnet_private *p = container_of(napi, struct rmnet_private,
+					       napi);
+	struct net_device *dev = napi->dev;
+	struct sk_buff *skb;
 	void *ptr = 0;
+	__wsum csum;
 	int sz;
+	int work = 0;
 	u32 opmode = p->operation_mode;
 //	unsigned long flags;
  //   int max_package_size;
-	for (;;) {
+	while (p->ch && work < budget) {
 		sz = smd_cur_packet_size(p->ch);
 		if (sz == 0) break;
 		if (smd_read_avail(p->ch) < sz) break;
+		work++;
 //ZTE_RIL_WANGCHENG_20110425 start
 #ifdef CONFIG_ZTE_PLATFORM			
 
@@ -283,7 +388,7 @@ static void smd_net_data_handler(unsigned long arg)
 					dev->mtu : (dev->mtu + ETH_HLEN));
 			ptr = 0;
 		} else {
-			skb = dev_alloc_skb(sz + NET_IP_ALIGN);
+			skb = rmnet_rx_skb(dev, sz);
 			if (skb == NULL) {
 				pr_err("rmnet_recv() cannot allocate skb\n");
 			} else {
@@ -291,20 +396,31 @@ static void smd_net_data_handler(unsigned long arg)
 				skb_reserve(skb, NET_IP_ALIGN);
 				ptr = skb_put(skb, sz);
 				wake_lock_timeout(&p->wake_lock, HZ / 2);
-				if (smd_read(p->ch, ptr, sz) != sz) {
+				if (rmnet_read_csum(p, ptr, sz,
+						    RMNET_IS_MODE_IP(opmode) ?
+						    0 : ETH_HLEN, &csum) != sz) {
 					pr_err("rmnet_recv() smd lied about avail?!");
-					ptr = 0;
-					dev_kfree_skb_irq(skb);
+					dev_kfree_skb_any(skb);
+					continue;
 				} else {
 					/* Handle Rx frame format */
 					//spin_lock_irqsave(&p->lock, flags);
 					//opmode = p->operation_mode;
 					//spin_unlock_irqrestore(&p->lock, flags);
 
+					skb->csum = csum;
+					skb->ip_summed = CHECKSUM_COMPLETE;
 					if (RMNET_IS_MODE_IP(opmode)) {
 						/* Driver in IP mode */
 						skb->protocol =
 						  rmnet_ip_type_trans(skb, dev);
+						/*
+						 * GRO compares link headers, give
+						 * it a blank one in the headroom.
+						 */
+						memset(skb->data - ETH_HLEN, 0,
+						       ETH_HLEN);
+						skb_set_mac_header(skb, -ETH_HLEN);
 					} else {
 						/* Driver in Ethernet mode */
 						skb->protocol =
@@ -319,7 +435,7 @@ static void smd_net_data_handler(unsigned long arg)
 						p->stats.rx_packets++;
 						p->stats.rx_bytes += skb->len;
 					}
-					netif_rx(skb);
+					napi_gro_receive(napi, skb);
 				}
 				continue;
 			}
@@ -327,11 +443,50 @@ static void smd_net_data_handler(unsigned long arg)
 		if (smd_read(p->ch, ptr, sz) != sz)
 			pr_err("rmnet_recv() smd lied about avail?!");
 	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* smd_net_notify() can't reschedule us until napi_complete(),
+		   so pick up anything that arrived in the meantime */
+		if (rmnet_rx_pending(p))
+			napi_schedule(napi);
+	}
+
+	return work;
 }
 
 //ZTE_RIL_RJG_20101103 end
 
-static DECLARE_TASKLET(smd_net_data_tasklet, smd_net_data_handler, 0);
+/* Copy into space reserved with smd_write_start() */
+static int rmnet_smd_copy(smd_channel_t *ch, const void *data, int len)
+{
+	int done, n;
+	void *ptr;
+
+	for (done = 0; done < len; done += n) {
+		n = smd_write_buffer(ch, &ptr);
+		if (n <= 0)
+			return done;
+		if (n > len - done)
+			n = len - done;
+		memcpy(ptr, data + done, n);
+		smd_write_commit(ch, n);
+	}
+
+	return done;
+}
+
+/* Copy the frame straight into the fifo, header and data in one go */
+static int rmnet_smd_write(smd_channel_t *ch, struct sk_buff *skb)
+{
+	int r;
+
+	r = smd_write_start(ch, skb->len);
+	if (r < 0)
+		return r;
+
+	return rmnet_smd_copy(ch, skb->data, skb->len);
+}
 
 static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 {
@@ -356,7 +511,7 @@ static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 	}
 
 	dev->trans_start = jiffies;
-	smd_ret = smd_write(ch, skb->data, skb->len);
+	smd_ret = rmnet_smd_write(ch, skb);
 	if (smd_ret != skb->len) {
 		pr_err("%s: smd_write returned error %d", __func__, smd_ret);
 		goto xmit_out;
@@ -373,7 +528,152 @@ static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 
 xmit_out:
 	/* data xmited, safe to release skb */
-	dev_kfree_skb_irq(skb);
+	rmnet_recycle_skb(dev, skb);
+	return 0;
+}
+
+/*
+ * TX aggregation, raw IP mode only.
+ *
+ * Packets are queued on tx_q and agg_tsklt packs as many as fit into
+ * one smd packet, each behind a QMAP header and padded to 4 bytes.
+ * The tasklet runs after the net softirqs, so the ACKs generated by
+ * one rx poll, or the packets of one qdisc run, go out together.
+ * Like BQL, the queue is stopped once agg_limit bytes are waiting
+ * rather than when the fifo is full.
+ */
+static int rmnet_agg_len(struct sk_buff *skb)
+{
+	return sizeof(struct QMAP_HDR_S) + ALIGN(skb->len, 4);
+}
+
+static void rmnet_agg_write(struct net_device *dev, smd_channel_t *ch,
+			    struct sk_buff_head *batch, int total)
+{
+	static const char pad[4];
+	struct rmnet_private *p = netdev_priv(dev);
+	struct QMAP_HDR_S qmh;
+	struct sk_buff *skb;
+	int len, ok;
+
+	ok = smd_write_start(ch, total) >= 0;
+
+	while ((skb = __skb_dequeue(batch)) != NULL) {
+		len = ALIGN(skb->len, 4);
+		qmh.pad_len = len - skb->len;
+		qmh.mux_id = 0;
+		qmh.pkt_len = htons(len);
+
+		if (ok)
+			ok = rmnet_smd_copy(ch, &qmh, sizeof(qmh)) ==
+					sizeof(qmh) &&
+				rmnet_smd_copy(ch, skb->data, skb->len) ==
+					skb->len &&
+				rmnet_smd_copy(ch, pad, qmh.pad_len) ==
+					qmh.pad_len;
+
+		if (ok) {
+			p->stats.tx_packets++;
+			p->stats.tx_bytes += skb->len;
+		} else
+			p->stats.tx_dropped++;
+
+		rmnet_recycle_skb(dev, skb);
+	}
+
+	if (!ok)
+		pr_err("%s: smd_write of %d failed", __func__, total);
+#ifdef CONFIG_MSM_RMNET_DEBUG
+	else
+		p->wakeups_xmit += rmnet_cause_wakeup(p);
+#endif
+}
+
+static void rmnet_agg_flush(unsigned long param)
+{
+	struct net_device *dev = (struct net_device *)param;
+	struct rmnet_private *p = netdev_priv(dev);
+	smd_channel_t *ch = p->ch;
+	struct sk_buff_head batch;
+	struct sk_buff *skb;
+	unsigned long flags;
+	int avail, total, len, wake, pending;
+
+	if (!ch)
+		return;
+
+	__skb_queue_head_init(&batch);
+
+	for (;;) {
+		avail = smd_write_avail(ch);
+		total = 0;
+
+		spin_lock_irqsave(&p->tx_q.lock, flags);
+		while ((skb = skb_peek(&p->tx_q)) != NULL) {
+			len = rmnet_agg_len(skb);
+			if (total + len > avail ||
+			    (total && total + len > rmnet_agg_size))
+				break;
+			__skb_unlink(skb, &p->tx_q);
+			p->tx_q_bytes -= skb->len;
+			__skb_queue_tail(&batch, skb);
+			total += len;
+		}
+		wake = p->tx_q_bytes < rmnet_agg_limit / 2;
+		pending = !skb_queue_empty(&p->tx_q);
+		spin_unlock_irqrestore(&p->tx_q.lock, flags);
+
+		if (!total)
+			break;
+
+		dev->trans_start = jiffies;
+		rmnet_agg_write(dev, ch, &batch, total);
+
+		if (wake && netif_queue_stopped(dev))
+			netif_wake_queue(dev);
+
+		if (!pending) {
+			spin_lock_irqsave(&p->lock, flags);
+			smd_disable_read_intr(ch);
+			spin_unlock_irqrestore(&p->lock, flags);
+			return;
+		}
+	}
+
+	/* Out of fifo space: have the modem tell us when it has read
+	   some, and look again in case it already did */
+	spin_lock_irqsave(&p->lock, flags);
+	smd_enable_read_intr(ch);
+	spin_unlock_irqrestore(&p->lock, flags);
+
+	skb = skb_peek(&p->tx_q);
+	if (skb && smd_write_avail(ch) >= rmnet_agg_len(skb))
+		tasklet_schedule(&p->agg_tsklt);
+}
+
+static int rmnet_agg_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	struct rmnet_private *p = netdev_priv(dev);
+	struct QMI_QOS_HDR_S *qmih;
+	unsigned long flags;
+
+	if (RMNET_IS_MODE_QOS(p->operation_mode)) {
+		qmih = (struct QMI_QOS_HDR_S *)
+			skb_push(skb, sizeof(struct QMI_QOS_HDR_S));
+		qmih->version = 1;
+		qmih->flags = 0;
+		qmih->flow_id = skb->mark;
+	}
+
+	spin_lock_irqsave(&p->tx_q.lock, flags);
+	__skb_queue_tail(&p->tx_q, skb);
+	p->tx_q_bytes += skb->len;
+	if (p->tx_q_bytes >= rmnet_agg_limit)
+		netif_stop_queue(dev);
+	spin_unlock_irqrestore(&p->tx_q.lock, flags);
+
+	tasklet_schedule(&p->agg_tsklt);
+
 	return 0;
 }
 
@@ -444,11 +744,11 @@ static void smd_net_notify(void *_dev, unsigned event)
 
 	spin_unlock(&p->lock);
 
-	if (smd_read_avail(p->ch) &&
-	    (smd_read_avail(p->ch) >= smd_cur_packet_size(p->ch))) {
-		smd_net_data_tasklet.data = (unsigned long) _dev;
-		tasklet_schedule(&smd_net_data_tasklet);
-	}
+	if (!skb_queue_empty(&p->tx_q))
+		tasklet_schedule(&p->agg_tsklt);
+
+	if (rmnet_rx_pending(p))
+		napi_schedule(&p->napi);
 }
 
 static int __rmnet_open(struct net_device *dev)
@@ -497,13 +797,18 @@ static int __rmnet_close(struct net_device *dev)
 
 static int rmnet_open(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
 	int rc = 0;
 
 	pr_info("rmnet_open()\n");
 
 	rc = __rmnet_open(dev);
-	if (rc == 0)
+	if (rc == 0) {
+		napi_enable(&p->napi);
+		/* data may have been waiting since before napi_enable() */
+		napi_schedule(&p->napi);
 		netif_start_queue(dev);
+	}
 
 	return rc;
 }
@@ -515,7 +820,12 @@ static int rmnet_stop(struct net_device *dev)
 	pr_info("rmnet_stop()\n");
 
 	netif_stop_queue(dev);
+	napi_disable(&p->napi);
 	tasklet_kill(&p->tsklt);
+	tasklet_kill(&p->agg_tsklt);
+	skb_queue_purge(&p->tx_q);
+	p->tx_q_bytes = 0;
+	skb_queue_purge(&p->rx_pool);
 
 	/* TODO: unload modem safely,
 	   currently, this causes unnecessary unloads */
@@ -550,6 +860,13 @@ static int rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 		return 0;
 	}
 
+	/* keep going through tx_q until it drains, so that turning
+	   aggregation off doesn't reorder packets */
+	if ((RMNET_IS_MODE_AGG(p->operation_mode) &&
+	     RMNET_IS_MODE_IP(p->operation_mode)) ||
+	    !skb_queue_empty(&p->tx_q))
+		return rmnet_agg_xmit(skb, dev);
+
 	spin_lock_irqsave(&p->lock, flags);
 	smd_enable_read_intr(ch);
 	if (smd_write_avail(ch) < skb->len) {
@@ -682,6 +999,20 @@ static int rmnet_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd)
 			(void *)(p->operation_mode & RMNET_MODE_QOS);
 		break;
 
+	case RMNET_IOCTL_SET_AGG_ENABLE:    /* Set TX aggregation on   */
+		spin_lock_irqsave(&p->lock, flags);
+		p->operation_mode |= RMNET_MODE_AGG;
+		spin_unlock_irqrestore(&p->lock, flags);
+		pr_info("rmnet_ioctl(): set TX aggregation enable\n");
+		break;
+
+	case RMNET_IOCTL_SET_AGG_DISABLE:   /* Set TX aggregation off  */
+		spin_lock_irqsave(&p->lock, flags);
+		p->operation_mode &= ~RMNET_MODE_AGG;
+		spin_unlock_irqrestore(&p->lock, flags);
+		pr_info("rmnet_ioctl(): set TX aggregation disable\n");
+		break;
+
 	case RMNET_IOCTL_GET_OPMODE:        /* Get operation mode      */
 		ifr->ifr_ifru.ifru_data = (void *)p->operation_mode;
 		break;
@@ -716,6 +1047,7 @@ static void __init rmnet_setup(struct net_device *dev)
 	/* set this after calling ether_setup */
 	dev->mtu = RMNET_DATA_LEN;
 	dev->needed_headroom = HEADROOM_FOR_QOS;
+	dev->features |= NETIF_F_GRO;
 
 	random_ether_addr(dev->dev_addr);
 
@@ -768,6 +1100,11 @@ static int __init rmnet_init(void)
 		spin_lock_init(&p->lock);
 		tasklet_init(&p->tsklt, _rmnet_resume_flow,
 				(unsigned long)dev);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
+		skb_queue_head_init(&p->rx_pool);
+		skb_queue_head_init(&p->tx_q);
+		tasklet_init(&p->agg_tsklt, rmnet_agg_flush,
+				(unsigned long)dev);
 		wake_lock_init(&p->wake_lock, WAKE_LOCK_SUSPEND, ch_name[n]);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
@@ -35,8 +35,12 @@
 #include <sdiovar.h>	/* ioctl/iovars */
 
 #include <linux/mmc/core.h>
+#include <linux/mmc/card.h>
+#include <linux/mmc/host.h>
+#include <linux/mmc/sdio.h>
 #include <linux/mmc/sdio_func.h>
 #include <linux/mmc/sdio_ids.h>
+#include <linux/scatterlist.h>
 
 #include <dngl_stats.h>
 #include <dhd.h>
@@ -78,6 +82,9 @@ DHD_PM_RESUME_WAIT_INIT(sdioh_request_buffer_wait);
 
 #define DMA_ALIGN_MASK	0x03
 
+/* Most packets a chained read is scattered over in one CMD53 */
+#define SDIOH_SG_MAX	32
+
 int sdioh_sdmmc_card_regread(sdioh_info_t *sd, int func, uint32 regaddr, int regsize, uint32 *data);
 
 static int
@@ -505,7 +512,7 @@ sdioh_iovar_op(sdioh_info_t *si, const char *name,
 	}
 
 	case IOV_GVAL(IOV_RXCHAIN):
-		int_val = FALSE;
+		int_val = TRUE;
 		bcopy(&int_val, arg, val_size);
 		break;
 
@@ -885,6 +892,82 @@ sdioh_request_word(sdioh_info_t *sd, uint cmd_type, uint rw, uint func, uint add
 	return ((err_ret == 0) ? SDIOH_API_RC_SUCCESS : SDIOH_API_RC_FAIL);
 }
 
+/*
+ * Read a packet chain with a single block mode CMD53, scattering the data
+ * straight into the packets. Returns FALSE, leaving *err untouched, if the
+ * chain does not fit one request and has to be read packet by packet.
+ * Called with the host claimed.
+ */
+static bool
+sdioh_sdmmc_read_chain(sdioh_info_t *sd, uint func, uint addr, bool fifo,
+                       void *pkt, int *err)
+{
+	struct sdio_func *sdfunc = gInstance->func[func];
+	struct mmc_host *host = sdfunc->card->host;
+	struct scatterlist sg[SDIOH_SG_MAX];
+	struct mmc_request mrq;
+	struct mmc_command cmd;
+	struct mmc_data data;
+	uint blksz = sdfunc->cur_blksize;
+	uint nsegs = 0, totlen = 0, blocks;
+	void *pnext;
+
+	for (pnext = pkt; pnext; pnext = PKTNEXT(sd->osh, pnext)) {
+		if (nsegs == SDIOH_SG_MAX || nsegs == host->max_hw_segs)
+			return FALSE;
+		nsegs++;
+		totlen += PKTLEN(sd->osh, pnext);
+	}
+
+	blocks = totlen / blksz;
+	if (!blksz || (totlen % blksz) || blocks > 511 ||
+	    blocks > host->max_blk_count || totlen > host->max_req_size)
+		return FALSE;
+
+	sg_init_table(sg, nsegs);
+	for (nsegs = 0, pnext = pkt; pnext; pnext = PKTNEXT(sd->osh, pnext), nsegs++)
+		sg_set_buf(&sg[nsegs], PKTDATA(sd->osh, pnext), PKTLEN(sd->osh, pnext));
+
+	memset(&mrq, 0, sizeof(mrq));
+	memset(&cmd, 0, sizeof(cmd));
+	memset(&data, 0, sizeof(data));
+
+	cmd.opcode = SD_IO_RW_EXTENDED;
+	cmd.arg = (func << 28) | (addr << 9) | 0x08000000 | blocks;
+	if (!fifo)
+		cmd.arg |= 0x04000000;
+	cmd.flags = MMC_RSP_SPI_R5 | MMC_RSP_R5 | MMC_CMD_ADTC;
+
+	data.blksz = blksz;
+	data.blocks = blocks;
+	data.flags = MMC_DATA_READ;
+	data.sg = sg;
+	data.sg_len = nsegs;
+	mmc_set_data_timeout(&data, sdfunc->card);
+
+	mrq.cmd = &cmd;
+	mrq.data = &data;
+	mmc_wait_for_req(host, &mrq);
+
+	if (cmd.error)
+		*err = cmd.error;
+	else if (data.error)
+		*err = data.error;
+	else if (cmd.resp[0] & (R5_ERROR | R5_FUNCTION_NUMBER | R5_OUT_OF_RANGE))
+		*err = -EIO;
+	else
+		*err = 0;
+
+	if (*err)
+		sd_err(("%s: RX of %d packets, %d bytes at 0x%05x failed, ERR=0x%08x\n",
+		        __FUNCTION__, nsegs, totlen, addr, *err));
+	else
+		sd_trace(("%s: RX xfr'd %d packets, addr=0x%05x, len=%d\n",
+		          __FUNCTION__, nsegs, addr, totlen));
+
+	return TRUE;
+}
+
 static SDIOH_API_RC
 sdioh_request_packet(sdioh_info_t *sd, uint fix_inc, uint write, uint func,
                      uint addr, void *pkt)
@@ -903,6 +986,14 @@ sdioh_request_packet(sdioh_info_t *sd, uint fix_inc, uint write, uint func,
 
 	/* Claim host controller */
 	sdio_claim_host(gInstance->func[func]);
+
+	/* A chained read (a glom superframe) goes out as one transfer */
+	if (!write && PKTNEXT(sd->osh, pkt) &&
+	    sdioh_sdmmc_read_chain(sd, func, addr, fifo, pkt, &err_ret)) {
+		sdio_release_host(gInstance->func[func]);
+		return ((err_ret == 0) ? SDIOH_API_RC_SUCCESS : SDIOH_API_RC_FAIL);
+	}
+
 	for (pnext = pkt; pnext; pnext = PKTNEXT(sd->osh, pnext)) {
 		uint pkt_len = PKTLEN(sd->osh, pnext);
 		pkt_len += 3;
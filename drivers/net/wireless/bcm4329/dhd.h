@@ -111,6 +111,7 @@ typedef struct dhd_pub {
 	/* Internal dhd items */
 	bool up;		/* Driver up/down (to OS) */
 	bool txoff;		/* Transmit flow-controlled */
+	uint8 txoff_ac;		/* Stack tx queues flow-controlled (bitmap) */
 	bool dongle_reset;  /* TRUE = DEVRESET put dongle into reset */
 	enum dhd_bus_state busstate;
 	uint hdrlen;		/* Total DHD header length (proto + bus) */
@@ -138,6 +139,13 @@ typedef struct dhd_pub {
 	ulong rx_dropped;	/* Packets dropped locally (no memory) */
 	ulong rx_flushed;  /* Packets flushed due to unscheduled sendup thread */
 	ulong wd_dpc_sched;   /* Number of times dhd dpc scheduled by watchdog timer */
+	ulong dpc_runs;		/* Number of DPC passes run */
+	ulong dpc_resched;	/* DPC passes that left work for another pass */
+	ulong dpc_yields;	/* Times the DPC thread used up its budget */
+	ulong dpc_maxpasses;	/* Most back to back DPC passes */
+	ulong suspends;		/* Early suspends with filters and offloads on */
+	ulong suspend_filtered;	/* Frames dongle filters dropped while suspended */
+	ulong suspend_arp_replies;	/* ARP requests dongle answered while suspended */
 
 	ulong rx_readahead_cnt;	/* Number of packets where header read-ahead was used. */
 	ulong tx_realloc;	/* Number of tx packets we had to realloc for headroom */
@@ -153,6 +161,8 @@ typedef struct dhd_pub {
 	/* Suspend disable flag and "in suspend" flag */
 	int suspend_disable_flag; /* "1" to disable all extra powersaving during suspend */
 	int in_suspend;			/* flag set to 1 when early suspend called */
+	uint32 suspend_filtered_base;	/* Dongle counters at early suspend */
+	uint32 suspend_arp_base;
 #ifdef PNO_SUPPORT
 	int pno_enable;                 /* pno status : "1" is pno enable */
 #endif /* PNO_SUPPORT */
@@ -162,6 +172,8 @@ typedef struct dhd_pub {
 	char * pktfilter[100];
 	int pktfilter_count;
 
+	uint32 arp_hostip;	/* IPv4 address given to the ARP agent (network order) */
+
 	uint8 country_code[WLC_CNTRY_BUF_SZ];
 	char eventmask[WL_EVENTING_MASK_LEN];
 
@@ -247,6 +259,15 @@ extern void dhd_detach(dhd_pub_t *dhdp);
 /* Indication from bus module to change flow-control state */
 extern void dhd_txflowcontrol(dhd_pub_t *dhdp, int ifidx, bool on);
 
+/* Stack tx queues, one per access category. Bus precedences 0-1 carry BK,
+ * 2-3 BE, 4-5 VI and 6-7 VO (see PRIO2PREC), two precedences per queue.
+ */
+#define DHD_NUM_TXQ		4
+#define DHD_PREC2TXQ(prec)	((prec) >> 1)
+
+/* Same as dhd_txflowcontrol(), for one stack tx queue only */
+extern void dhd_txflowcontrol_ac(dhd_pub_t *dhdp, int ifidx, int txq, bool on);
+
 extern bool dhd_prec_enq(dhd_pub_t *dhdp, struct pktq *q, void *pkt, int prec);
 
 /* Receive frame for delivery to OS.  Callee disposes of rxp. */
@@ -371,6 +392,15 @@ extern uint dhd_arp_mode;
 /* ARP offload enable */
 extern uint dhd_arp_enable;
 
+/* Dongle to host glomming */
+extern uint dhd_rxglom;
+
+/* Per access category stack flow control */
+extern uint dhd_txflow_ac;
+
+/* Most queued frames sent back to back per bus pass */
+extern uint dhd_txbatch;
+
 /* Pkt filte enable control */
 extern uint dhd_pkt_filter_enable;
 
@@ -192,6 +192,10 @@ dhd_dump(dhd_pub_t *dhdp, char *buf, int buflen)
 	bcm_bprintf(strbuf, "rx_readahead_cnt %ld tx_realloc %ld fc_packets %ld\n",
 	            dhdp->rx_readahead_cnt, dhdp->tx_realloc, dhdp->fc_packets);
 	bcm_bprintf(strbuf, "wd_dpc_sched %ld\n", dhdp->wd_dpc_sched);
+	bcm_bprintf(strbuf, "dpc_runs %ld dpc_resched %ld dpc_yields %ld dpc_maxpasses %ld\n",
+	            dhdp->dpc_runs, dhdp->dpc_resched, dhdp->dpc_yields, dhdp->dpc_maxpasses);
+	bcm_bprintf(strbuf, "suspends %ld suspend_filtered %ld suspend_arp_replies %ld\n",
+	            dhdp->suspends, dhdp->suspend_filtered, dhdp->suspend_arp_replies);
 	bcm_bprintf(strbuf, "\n");
 
 	/* Add any prot info */
@@ -286,6 +290,8 @@ dhd_doiovar(dhd_pub_t *dhd_pub, const bcm_iovar_t *vi, uint32 actionid, const ch
 		dhd_pub->rx_readahead_cnt = 0;
 		dhd_pub->tx_realloc = 0;
 		dhd_pub->wd_dpc_sched = 0;
+		dhd_pub->dpc_runs = dhd_pub->dpc_resched = 0;
+		dhd_pub->dpc_yields = dhd_pub->dpc_maxpasses = 0;
 		memset(&dhd_pub->dstats, 0, sizeof(dhd_pub->dstats));
 		dhd_bus_clearcounts(dhd_pub);
 		break;
@@ -1211,8 +1217,85 @@ dhd_arp_offload_enable(dhd_pub_t * dhd, int arp_enable)
 		DHD_TRACE(("%s: successfully enabed ARP offload to %d\n",
 		__FUNCTION__, arp_enable));
 }
+
+/* Give the dongle the host's IPv4 address, so the ARP agent can answer
+ * requests for it without waking the host.
+ */
+void
+dhd_arp_offload_add_ip(dhd_pub_t *dhd, uint32 ipaddr)
+{
+	char iovbuf[32];
+	int retcode;
+
+	bcm_mkiovar("arp_hostip", (char *)&ipaddr, 4, iovbuf, sizeof(iovbuf));
+	retcode = dhdcdc_set_ioctl(dhd, 0, WLC_SET_VAR, iovbuf, sizeof(iovbuf));
+	retcode = retcode >= 0 ? 0 : retcode;
+	if (retcode)
+		DHD_TRACE(("%s: ARP ip addr add failed, retcode = %d\n",
+		__FUNCTION__, retcode));
+	else
+		DHD_TRACE(("%s: ARP ipaddr entry added\n", __FUNCTION__));
+}
+
+/* Forget the host addresses and the peer ARP table, e.g. on an IP change */
+void
+dhd_arp_cleanup(dhd_pub_t *dhd)
+{
+	char iovbuf[32];
+	int retcode;
+
+	bcm_mkiovar("arp_hostip_clear", 0, 0, iovbuf, sizeof(iovbuf));
+	retcode = dhdcdc_set_ioctl(dhd, 0, WLC_SET_VAR, iovbuf, sizeof(iovbuf));
+	if (retcode < 0)
+		DHD_TRACE(("%s: arp_hostip_clear failed, retcode = %d\n",
+		__FUNCTION__, retcode));
+
+	bcm_mkiovar("arp_table_clear", 0, 0, iovbuf, sizeof(iovbuf));
+	retcode = dhdcdc_set_ioctl(dhd, 0, WLC_SET_VAR, iovbuf, sizeof(iovbuf));
+	if (retcode < 0)
+		DHD_TRACE(("%s: arp_table_clear failed, retcode = %d\n",
+		__FUNCTION__, retcode));
+}
+
+/* ARP requests from peers the dongle answered on the host's behalf */
+uint32
+dhd_arp_offload_replies(dhd_pub_t *dhd)
+{
+	char iovbuf[32 + sizeof(struct arp_ol_stats_t)];
+	struct arp_ol_stats_t *stats = (struct arp_ol_stats_t *)iovbuf;
+
+	bcm_mkiovar("arp_stats", 0, 0, iovbuf, sizeof(iovbuf));
+	if (dhdcdc_query_ioctl(dhd, 0, WLC_GET_VAR, iovbuf, sizeof(iovbuf)) < 0)
+		return 0;
+
+	return dtoh32(stats->peer_service);
+}
 #endif
 
+#ifdef PKT_FILTER_SUPPORT
+/* Frames the dongle's packet filters kept from the host, over all filters
+ * in dhd->pktfilter[].
+ */
+uint32
+dhd_pktfilter_discarded(dhd_pub_t *dhd)
+{
+	char iovbuf[32 + sizeof(wl_pkt_filter_stats_t)];
+	wl_pkt_filter_stats_t *stats = (wl_pkt_filter_stats_t *)iovbuf;
+	uint32 id, discarded = 0;
+	int i;
+
+	for (i = 0; i < dhd->pktfilter_count; i++) {
+		id = htod32(bcm_strtoul(dhd->pktfilter[i], NULL, 0));
+		bcm_mkiovar("pkt_filter_stats", (char *)&id, 4, iovbuf, sizeof(iovbuf));
+		if (dhdcdc_query_ioctl(dhd, 0, WLC_GET_VAR, iovbuf, sizeof(iovbuf)) < 0)
+			continue;
+		discarded += dtoh32(stats->num_pkts_discarded);
+	}
+
+	return discarded;
+}
+#endif /* PKT_FILTER_SUPPORT */
+
 int
 dhd_preinit_ioctls(dhd_pub_t *dhd)
 {
@@ -1221,7 +1304,7 @@ dhd_preinit_ioctls(dhd_pub_t *dhd)
 	char buf[128], *ptr;
 	uint power_mode = PM_FAST;
 	uint32 dongle_align = DHD_SDALIGN;
-	uint32 glom = 0;
+	uint32 glom = dhd_rxglom;
 	uint bcn_timeout = 3;
 	int scan_assoc_time = 40;
 	int scan_unassoc_time = 40;
@@ -1300,7 +1383,7 @@ dhd_preinit_ioctls(dhd_pub_t *dhd)
 	bcm_mkiovar("bus:txglomalign", (char *)&dongle_align, 4, iovbuf, sizeof(iovbuf));
 	dhdcdc_set_ioctl(dhd, 0, WLC_SET_VAR, iovbuf, sizeof(iovbuf));
 
-	/* disable glom option per default */
+	/* Dongle side glomming, read by the host as one superframe */
 	bcm_mkiovar("bus:txglom", (char *)&glom, 4, iovbuf, sizeof(iovbuf));
 	dhdcdc_set_ioctl(dhd, 0, WLC_SET_VAR, iovbuf, sizeof(iovbuf));
 
@@ -1376,6 +1459,10 @@ dhd_preinit_ioctls(dhd_pub_t *dhd)
 	if (dhd_arp_enable)
 		dhd_arp_offload_set(dhd, dhd_arp_mode);
 	dhd_arp_offload_enable(dhd, dhd_arp_enable);
+
+	/* A reloaded dongle has forgotten the host address */
+	if (dhd_arp_enable && dhd->arp_hostip)
+		dhd_arp_offload_add_ip(dhd, dhd->arp_hostip);
 #endif /* ARP_OFFLOAD_SUPPORT */
 
 #ifdef PKT_FILTER_SUPPORT
@@ -52,6 +52,7 @@
 #include <bcmendian.h>
 
 #include <proto/ethernet.h>
+#include <proto/802.1d.h>
 #include <dngl_stats.h>
 #include <dhd.h>
 #include <dhd_bus.h>
@@ -61,6 +62,13 @@
 #ifdef CONFIG_HAS_WAKELOCK
 #include <linux/wakelock.h>
 #endif
+
+/* Received frames go up through NAPI so that GRO can merge them */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 29)
+#define DHD_GRO
+#define DHD_NAPI_WEIGHT		64
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 29) */
+
 #if defined(CUSTOMER_HW2) && defined(CONFIG_WIFI_CONTROL_FUNC)
 #include <linux/wlan_plat.h>
 
@@ -225,8 +233,23 @@ extern int dhdcdc_set_ioctl(dhd_pub_t *dhd, int ifidx, uint cmd, void *buf, uint
 #ifdef PKT_FILTER_SUPPORT
 extern void dhd_pktfilter_offload_set(dhd_pub_t * dhd, char *arg);
 extern void dhd_pktfilter_offload_enable(dhd_pub_t * dhd, char *arg, int enable, int master_mode);
+extern uint32 dhd_pktfilter_discarded(dhd_pub_t *dhd);
 #endif
 
+#ifdef ARP_OFFLOAD_SUPPORT
+#include <linux/inetdevice.h>
+extern void dhd_arp_offload_add_ip(dhd_pub_t *dhd, uint32 ipaddr);
+extern void dhd_arp_cleanup(dhd_pub_t *dhd);
+extern uint32 dhd_arp_offload_replies(dhd_pub_t *dhd);
+
+static int dhd_inetaddr_notifier_call(struct notifier_block *this,
+	unsigned long event, void *ptr);
+
+static struct notifier_block dhd_inetaddr_notifier = {
+	.notifier_call = dhd_inetaddr_notifier_call
+};
+#endif /* ARP_OFFLOAD_SUPPORT */
+
 /* Interface control information */
 typedef struct dhd_if {
 	struct dhd_info *info;			/* back pointer to dhd_info */
@@ -269,6 +292,13 @@ typedef struct dhd_info {
 	long dpc_pid;
 	struct semaphore dpc_sem;
 	struct completion dpc_exited;
+	int dpc_prio;		/* Priority the DPC thread runs at */
+	int dpc_cpu;		/* CPU the DPC thread is bound to */
+	bool dpc_demoted;	/* DPC thread used up its budget */
+#ifdef DHD_GRO
+	struct napi_struct napi;
+	struct sk_buff_head rx_napi_queue;	/* Frames for dhd_napi_poll() */
+#endif /* DHD_GRO */
 
 	/* Wakelocks */
 #ifdef CONFIG_HAS_WAKELOCK
@@ -335,6 +365,18 @@ module_param(dhd_arp_mode, uint, 0);
 uint dhd_arp_enable = TRUE;
 module_param(dhd_arp_enable, uint, 0);
 
+/* Let the dongle glom frames to the host into superframes */
+uint dhd_rxglom = TRUE;
+module_param(dhd_rxglom, uint, 0);
+
+/* Flow control the stack per access category, so bulk can't block voice */
+uint dhd_txflow_ac = TRUE;
+module_param(dhd_txflow_ac, uint, 0644);
+
+/* Queued frames sent back to back before completions are reported */
+uint dhd_txbatch = 8;
+module_param(dhd_txbatch, uint, 0644);
+
 /* Global Pkt filter enable control */
 uint dhd_pkt_filter_enable = TRUE;
 module_param(dhd_pkt_filter_enable, uint, 0);
@@ -351,9 +393,23 @@ module_param(dhd_master_mode, uint, 1);
 int dhd_watchdog_prio = 97;
 module_param(dhd_watchdog_prio, int, 0);
 
-/* DPC thread priority, -1 to use tasklet */
+/* DPC thread priority, -1 to use tasklet. Changing it on a running
+ * thread takes effect on its next pass, 0 or less runs it SCHED_NORMAL.
+ */
 int dhd_dpc_prio = 98;
-module_param(dhd_dpc_prio, int, 0);
+module_param(dhd_dpc_prio, int, 0644);
+
+/* CPU to run the DPC thread on, -1 for any */
+int dhd_dpc_cpu = -1;
+module_param(dhd_dpc_cpu, int, 0644);
+
+/* Back to back DPC passes (each bounded by txbound/rxbound) the thread
+ * makes at its RT priority. Past that it carries on as a normal task until
+ * the bus goes idle, so a long download can't starve everything else.
+ * 0 for no limit.
+ */
+uint dhd_dpc_budget = 8;
+module_param(dhd_dpc_budget, uint, 0644);
 
 /* DPC thread priority, -1 to use tasklet */
 extern int dhd_dongle_memsize;
@@ -519,6 +575,35 @@ static void dhd_set_packet_filter(int value, dhd_pub_t *dhd)
 }
 
 #if defined(CONFIG_HAS_EARLYSUSPEND)
+/* Snapshot the dongle's filter and ARP agent counters at early suspend and
+ * add what they moved by at late resume: frames that never woke the host.
+ */
+static void dhd_suspend_stats(int value, dhd_pub_t *dhd)
+{
+	uint32 filtered = 0, arp_replies = 0;
+
+#ifdef PKT_FILTER_SUPPORT
+	if (dhd_pkt_filter_enable)
+		filtered = dhd_pktfilter_discarded(dhd);
+#endif
+#ifdef ARP_OFFLOAD_SUPPORT
+	if (dhd_arp_enable)
+		arp_replies = dhd_arp_offload_replies(dhd);
+#endif
+
+	if (value) {
+		dhd->suspends++;
+		dhd->suspend_filtered_base = filtered;
+		dhd->suspend_arp_base = arp_replies;
+	} else {
+		/* Counters restart if the dongle was reloaded meanwhile */
+		if (filtered >= dhd->suspend_filtered_base)
+			dhd->suspend_filtered += filtered - dhd->suspend_filtered_base;
+		if (arp_replies >= dhd->suspend_arp_base)
+			dhd->suspend_arp_replies += arp_replies - dhd->suspend_arp_base;
+	}
+}
+
 static int dhd_set_suspend(int value, dhd_pub_t *dhd)
 {
 	int power_mode = PM_MAX;
@@ -543,6 +628,7 @@ static int dhd_set_suspend(int value, dhd_pub_t *dhd)
 
 			/* Enable packet filter, only allow unicast packet to send up */
 			dhd_set_packet_filter(1, dhd);
+			dhd_suspend_stats(1, dhd);
 
 				/* if dtim skip setup as default force it to wake each thrid dtim
 				 *  for better power saving.
@@ -570,6 +656,7 @@ static int dhd_set_suspend(int value, dhd_pub_t *dhd)
 				sizeof(power_mode));
 
 			/* disable pkt filter */
+			dhd_suspend_stats(0, dhd);
 			dhd_set_packet_filter(0, dhd);
 
 				/* restore pre-suspend setting for dtim_skip */
@@ -1124,7 +1211,7 @@ dhd_start_xmit(struct sk_buff *skb, struct net_device *net)
 	if (!dhd->pub.up || (dhd->pub.busstate == DHD_BUS_DOWN)) {
 		DHD_ERROR(("%s: xmit rejected pub.up=%d busstate=%d\n",
 			 __FUNCTION__, dhd->pub.up, dhd->pub.busstate));
-		netif_stop_queue(net);
+		netif_tx_stop_all_queues(net);
 		/* Send Event when bus down detected during data session */
 		if (dhd->pub.busstate == DHD_BUS_DOWN)  {
 			DHD_ERROR(("%s: Event HANG send up\n", __FUNCTION__));
@@ -1137,7 +1224,7 @@ dhd_start_xmit(struct sk_buff *skb, struct net_device *net)
 	ifidx = dhd_net2idx(dhd, net);
 	if (ifidx == DHD_BAD_IF) {
 		DHD_ERROR(("%s: bad ifidx %d\n", __FUNCTION__, ifidx));
-		netif_stop_queue(net);
+		netif_tx_stop_all_queues(net);
 		dhd_os_wake_unlock(&dhd->pub);
 		return -ENODEV;
 	}
@@ -1194,9 +1281,46 @@ dhd_txflowcontrol(dhd_pub_t *dhdp, int ifidx, bool state)
 	ASSERT(dhd && dhd->iflist[ifidx]);
 	net = dhd->iflist[ifidx]->net;
 	if (state == ON)
-		netif_stop_queue(net);
-	else
-		netif_wake_queue(net);
+		netif_tx_stop_all_queues(net);
+	else {
+		dhdp->txoff_ac = 0;
+		netif_tx_wake_all_queues(net);
+	}
+}
+
+void
+dhd_txflowcontrol_ac(dhd_pub_t *dhdp, int ifidx, int txq, bool state)
+{
+	struct net_device *net;
+	dhd_info_t *dhd = dhdp->info;
+
+	DHD_TRACE(("%s: txq %d %s\n", __FUNCTION__, txq, state ? "off" : "on"));
+
+	ASSERT(dhd && dhd->iflist[ifidx]);
+	net = dhd->iflist[ifidx]->net;
+
+	/* Only the primary interface has a queue per access category */
+	if (txq >= net->real_num_tx_queues)
+		return;
+
+	if (state == ON) {
+		dhdp->txoff_ac |= NBITVAL(txq);
+		netif_stop_subqueue(net, txq);
+	} else {
+		dhdp->txoff_ac &= ~NBITVAL(txq);
+		if (!dhdp->txoff)
+			netif_wake_subqueue(net, txq);
+	}
+}
+
+/* Pick the stack tx queue from the 802.1d priority the bus will use */
+static u16
+dhd_select_queue(struct net_device *net, struct sk_buff *skb)
+{
+	if (PKTPRIO(skb) == 0)
+		pktsetprio(skb, FALSE);
+
+	return DHD_PREC2TXQ(PRIO2PREC(PKTPRIO(skb) & MAXPRIO));
 }
 
 void
@@ -1274,6 +1398,9 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt)
 		dhdp->dstats.rx_bytes += skb->len;
 		dhdp->rx_packets++; /* Local count */
 
+#ifdef DHD_GRO
+		skb_queue_tail(&dhd->rx_napi_queue, skb);
+#else
 		if (in_interrupt()) {
 			netif_rx(skb);
 		} else {
@@ -1293,10 +1420,41 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt)
 			local_irq_restore(flags);
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 0) */
 		}
-	}
+#endif /* DHD_GRO */
+	}
+#ifdef DHD_GRO
+	/* From the DPC thread the softirq runs at local_bh_enable() */
+	local_bh_disable();
+	napi_schedule(&dhd->napi);
+	local_bh_enable();
+#endif /* DHD_GRO */
 	dhd_os_wake_lock_timeout_enable(dhdp);
 }
 
+#ifdef DHD_GRO
+static int
+dhd_napi_poll(struct napi_struct *napi, int budget)
+{
+	dhd_info_t *dhd = container_of(napi, dhd_info_t, napi);
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&dhd->rx_napi_queue)) != NULL) {
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* dhd_rx_frame() can't reschedule us until napi_complete() */
+		if (!skb_queue_empty(&dhd->rx_napi_queue))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+#endif /* DHD_GRO */
+
 void
 dhd_event(struct dhd_info *dhd, char *evpkt, int evlen, int ifidx)
 {
@@ -1423,34 +1581,93 @@ dhd_watchdog(ulong data)
 	dhd_os_wake_unlock(&dhd->pub);
 }
 
+#ifdef DHD_SCHED
+static void
+dhd_dpc_setprio(int prio)
+{
+	struct sched_param param;
+
+	if (prio > 0) {
+		param.sched_priority = (prio < MAX_RT_PRIO)?prio:(MAX_RT_PRIO-1);
+		setScheduler(current, SCHED_FIFO, &param);
+	} else {
+		param.sched_priority = 0;
+		setScheduler(current, SCHED_NORMAL, &param);
+	}
+}
+#endif /* DHD_SCHED */
+
+/* Pick up priority and affinity changes made through the module params */
+static void
+dhd_dpc_update(dhd_info_t *dhd)
+{
+#ifdef DHD_SCHED
+	if (!dhd->dpc_demoted && dhd->dpc_prio != dhd_dpc_prio) {
+		dhd->dpc_prio = dhd_dpc_prio;
+		dhd_dpc_setprio(dhd->dpc_prio);
+	}
+#endif /* DHD_SCHED */
+
+#ifdef CONFIG_SMP
+	if (dhd->dpc_cpu != dhd_dpc_cpu) {
+		dhd->dpc_cpu = dhd_dpc_cpu;
+		if (dhd->dpc_cpu >= 0 && dhd->dpc_cpu < nr_cpu_ids &&
+		    cpu_online(dhd->dpc_cpu))
+			set_cpus_allowed_ptr(current, cpumask_of(dhd->dpc_cpu));
+		else
+			set_cpus_allowed_ptr(current, cpu_possible_mask);
+	}
+#endif /* CONFIG_SMP */
+}
+
 static int
 dhd_dpc_thread(void *data)
 {
 	dhd_info_t *dhd = (dhd_info_t *)data;
+	uint passes = 0;
 
 	/* This thread doesn't need any user-level access,
 	 * so get rid of all our resources
 	 */
-#ifdef DHD_SCHED
-	if (dhd_dpc_prio > 0)
-	{
-		struct sched_param param;
-		param.sched_priority = (dhd_dpc_prio < MAX_RT_PRIO)?dhd_dpc_prio:(MAX_RT_PRIO-1);
-		setScheduler(current, SCHED_FIFO, &param);
-	}
-#endif /* DHD_SCHED */
+	dhd->dpc_prio = 0;
+	dhd->dpc_cpu = -1;
+	dhd->dpc_demoted = FALSE;
+	dhd_dpc_update(dhd);
 
 	DAEMONIZE("dhd_dpc");
 
 	/* Run until signal received */
 	while (1) {
 		if (down_interruptible(&dhd->dpc_sem) == 0) {
+			dhd_dpc_update(dhd);
+
 			/* Call bus dpc unless it indicated down (then clean stop) */
 			if (dhd->pub.busstate != DHD_BUS_DOWN) {
+				dhd->pub.dpc_runs++;
 				if (dhd_bus_dpc(dhd->pub.bus)) {
+					dhd->pub.dpc_resched++;
+					if (++passes > dhd->pub.dpc_maxpasses)
+						dhd->pub.dpc_maxpasses = passes;
+#ifdef DHD_SCHED
+					if (dhd_dpc_budget && passes == dhd_dpc_budget &&
+					    dhd->dpc_prio > 0) {
+						dhd_dpc_setprio(0);
+						dhd->dpc_demoted = TRUE;
+						dhd->pub.dpc_yields++;
+					}
+#endif /* DHD_SCHED */
 					up(&dhd->dpc_sem);
+					cond_resched();
 				}
 				else {
+					passes = 0;
+#ifdef DHD_SCHED
+					if (dhd->dpc_demoted) {
+						dhd->dpc_demoted = FALSE;
+						dhd->dpc_prio = dhd_dpc_prio;
+						dhd_dpc_setprio(dhd->dpc_prio);
+					}
+#endif /* DHD_SCHED */
 					dhd_os_wake_unlock(&dhd->pub);
 				}
 			} else {
@@ -1851,7 +2068,7 @@ dhd_stop(struct net_device *net)
 
 	/* Set state and stop OS transmissions */
 	dhd->pub.up = 0;
-	netif_stop_queue(net);
+	netif_tx_stop_all_queues(net);
 #else
 	DHD_ERROR(("BYPASS %s:due to BRCM compilation : under investigation ...\n", __FUNCTION__));
 #endif /* !defined(IGNORE_ETH0_DOWN) */
@@ -1887,6 +2104,10 @@ dhd_open(struct net_device *net)
 	memcpy(net->dev_addr, dhd->pub.mac.octet, ETHER_ADDR_LEN);
 
 #ifdef TOE
+	/* Have the dongle verify rx checksums, GRO only merges verified frames */
+	if (dhd_toe_get(dhd, ifidx, &toe_ol) >= 0 && !(toe_ol & TOE_RX_CSUM_OL))
+		dhd_toe_set(dhd, ifidx, toe_ol | TOE_RX_CSUM_OL);
+
 	/* Get current TOE mode from dongle */
 	if (dhd_toe_get(dhd, ifidx, &toe_ol) >= 0 && (toe_ol & TOE_TX_CSUM_OL) != 0)
 		dhd->iflist[ifidx]->net->features |= NETIF_F_IP_CSUM;
@@ -1895,7 +2116,7 @@ dhd_open(struct net_device *net)
 #endif
 	}
 	/* Allow transmit calls */
-	netif_start_queue(net);
+	netif_tx_start_all_queues(net);
 	dhd->pub.up = 1;
 
 	OLD_MOD_INC_USE_COUNT;
@@ -1989,7 +2210,7 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 		strcpy(nv_path, nvram_path);
 
 	/* Allocate etherdev, including space for private structure */
-	if (!(net = alloc_etherdev(sizeof(dhd)))) {
+	if (!(net = alloc_etherdev_mq(sizeof(dhd), DHD_NUM_TXQ))) {
 		DHD_ERROR(("%s: OOM - alloc_etherdev\n", __FUNCTION__));
 		goto fail;
 	}
@@ -2008,6 +2229,12 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 	memcpy(netdev_priv(net), &dhd, sizeof(dhd));
 	dhd->pub.osh = osh;
 
+#ifdef DHD_GRO
+	skb_queue_head_init(&dhd->rx_napi_queue);
+	netif_napi_add(net, &dhd->napi, dhd_napi_poll, DHD_NAPI_WEIGHT);
+	napi_enable(&dhd->napi);
+#endif /* DHD_GRO */
+
 	/* Set network interface name if it was provided as module parameter */
 	if (iface_name[0]) {
 		int len;
@@ -2120,6 +2347,9 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27)) && defined(CONFIG_PM_SLEEP)
 	register_pm_notifier(&dhd_sleep_pm_notifier);
 #endif /*  (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27)) && defined(CONFIG_PM_SLEEP) */
+#ifdef ARP_OFFLOAD_SUPPORT
+	register_inetaddr_notifier(&dhd_inetaddr_notifier);
+#endif /* ARP_OFFLOAD_SUPPORT */
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	dhd->early_suspend.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN + 20;
@@ -2266,6 +2496,7 @@ static struct net_device_ops dhd_ops_pri = {
 	.ndo_get_stats = dhd_get_stats,
 	.ndo_do_ioctl = dhd_ioctl_entry,
 	.ndo_start_xmit = dhd_start_xmit,
+	.ndo_select_queue = dhd_select_queue,
 	.ndo_set_mac_address = dhd_set_mac_address,
 	.ndo_set_multicast_list = dhd_set_multicast_list,
 };
@@ -2279,6 +2510,59 @@ static struct net_device_ops dhd_ops_virt = {
 };
 #endif
 
+#ifdef ARP_OFFLOAD_SUPPORT
+/* Keep the dongle's ARP agent in step with the primary interface address */
+static int
+dhd_inetaddr_notifier_call(struct notifier_block *this, unsigned long event, void *ptr)
+{
+	struct in_ifaddr *ifa = (struct in_ifaddr *)ptr;
+	struct net_device *net = ifa->ifa_dev->dev;
+	dhd_info_t *dhd;
+	dhd_pub_t *dhdp;
+
+	if (!dhd_arp_enable)
+		return NOTIFY_DONE;
+
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 31))
+	if (net->netdev_ops != &dhd_ops_pri)
+#else
+	if (net->open != dhd_open)
+#endif
+		return NOTIFY_DONE;
+
+	dhd = *(dhd_info_t **)netdev_priv(net);
+	dhdp = &dhd->pub;
+
+	switch (event) {
+	case NETDEV_UP:
+		DHD_TRACE(("%s: [%s] up IP: 0x%x\n", __FUNCTION__, net->name,
+			ifa->ifa_address));
+		dhdp->arp_hostip = ifa->ifa_address;
+		break;
+	case NETDEV_DOWN:
+		DHD_TRACE(("%s: [%s] down IP: 0x%x\n", __FUNCTION__, net->name,
+			ifa->ifa_address));
+		if (dhdp->arp_hostip != ifa->ifa_address)
+			return NOTIFY_DONE;
+		dhdp->arp_hostip = 0;
+		break;
+	default:
+		return NOTIFY_DONE;
+	}
+
+	/* dhd_preinit_ioctls() picks the address up if the dongle isn't up yet */
+	if (dhdp->up && dhdp->busstate == DHD_BUS_DATA) {
+		dhd_os_proto_block(dhdp);
+		dhd_arp_cleanup(dhdp);
+		if (dhdp->arp_hostip)
+			dhd_arp_offload_add_ip(dhdp, dhdp->arp_hostip);
+		dhd_os_proto_unblock(dhdp);
+	}
+
+	return NOTIFY_DONE;
+}
+#endif /* ARP_OFFLOAD_SUPPORT */
+
 int
 dhd_net_attach(dhd_pub_t *dhdp, int ifidx)
 {
@@ -2326,6 +2610,9 @@ dhd_net_attach(dhd_pub_t *dhdp, int ifidx)
 		temp_addr[0] |= 0x02;  /* set bit 2 , - Locally Administered address  */
 	}
 	net->hard_header_len = ETH_HLEN + dhd->pub.hdrlen;
+#ifdef DHD_GRO
+	net->features |= NETIF_F_GRO;
+#endif /* DHD_GRO */
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 24)
 	net->ethtool_ops = &dhd_ethtool_ops;
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 24) */
@@ -2460,12 +2747,20 @@ dhd_detach(dhd_pub_t *dhdp)
 
 			dhd_bus_detach(dhdp);
 
+#ifdef DHD_GRO
+			napi_disable(&dhd->napi);
+			skb_queue_purge(&dhd->rx_napi_queue);
+#endif /* DHD_GRO */
+
 			if (dhdp->prot)
 				dhd_prot_detach(dhdp);
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27)) && defined(CONFIG_PM_SLEEP)
 			unregister_pm_notifier(&dhd_sleep_pm_notifier);
 #endif /* (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27)) && defined(CONFIG_PM_SLEEP) */
+#ifdef ARP_OFFLOAD_SUPPORT
+			unregister_inetaddr_notifier(&dhd_inetaddr_notifier);
+#endif /* ARP_OFFLOAD_SUPPORT */
 			free_netdev(ifp->net);
 #ifdef CONFIG_HAS_WAKELOCK
 			wake_lock_destroy(&dhd->wl_wifi);
@@ -70,6 +70,14 @@
 #define FCLOW		(FCHI / 2)
 #define PRIOMASK	7
 
+/* Per access category flow control: a stack tx queue is stopped once its
+ * two precedences hold FCHI_AC frames, and woken again below FCLOW_AC.
+ */
+#define FCHI_AC		64
+#define FCLOW_AC	(FCHI_AC / 2)
+
+#define DHD_TXBATCH_MAX	16	/* Most frames taken off txq in one go */
+
 #define TXRETRIES	2	/* # of retries for tx frames */
 
 #if defined(CONFIG_MACH_SANDGATE2G)
@@ -118,6 +126,16 @@
 
 #define MAX_RX_DATASZ	2048
 
+/* Receive packet pool, refilled between bursts so that frames and glom
+ * subframes don't each need an allocation while the bus is busy.
+ * A buffer holds one full sized (1500 MTU) frame.
+ */
+#define DHD_RXPOOL_MAX		32
+#define DHD_RXPOOL_BUFSZ	(1600 + DHD_SDALIGN)
+
+/* Buckets for frames per glom: 1, 2-3, 4-7, 8-15, 16 and up */
+#define DHD_GLOMHIST_SZ		5
+
 /* Maximum milliseconds to wait for F2 to come up */
 #define DHD_WAIT_F2RDY	3000
 
@@ -204,6 +222,9 @@ typedef struct dhd_bus {
 	void		*glom;			/* Packet chain for glommed superframe */
 	uint		glomerr;		/* Glom packet read errors */
 
+	void		*rxpool;		/* Preallocated receive packets */
+	uint		rxpool_cnt;		/* Packets in rxpool */
+
 	uint8		*rxbuf;			/* Buffer for receiving control packets */
 	uint		rxblen;			/* Allocated length of rxbuf */
 	uint8		*rxctl;			/* Aligned pointer into rxbuf */
@@ -287,6 +308,17 @@ typedef struct dhd_bus {
 	uint		rxglomfail;		/* Failed deglom attempts */
 	uint		rxglomframes;		/* Number of glom frames (superframes) */
 	uint		rxglompkts;		/* Number of packets from glom frames */
+	uint		rxglommax;		/* Most packets seen in one glom frame */
+	uint		rxglomhist[DHD_GLOMHIST_SZ];	/* Glom frames by packet count */
+	uint		rxpool_hits;		/* Receive packets taken from rxpool */
+	uint		rxpool_misses;		/* Receive packets allocated on demand */
+	uint		txq_hiwat[PRIOMASK + 1];	/* Longest each precedence got */
+	uint		txq_drops[PRIOMASK + 1];	/* Frames refused by a full txq */
+	uint		fc_ac_xoff[DHD_NUM_TXQ];	/* Stack tx queue stopped */
+	uint		fc_ac_xon[DHD_NUM_TXQ];		/* Stack tx queue woken */
+	uint		txbatches;		/* Batches taken off txq */
+	uint		txbatchpkts;		/* Frames sent in those batches */
+	uint		txbatchmax;		/* Largest batch */
 	uint		f2rxhdrs;		/* Number of header reads */
 	uint		f2rxdata;		/* Number of frame data reads */
 	uint		f2txdata;		/* Number of f2 frame writes */
@@ -433,6 +465,7 @@ static int dhdsdio_download_state(dhd_bus_t *bus, bool enter);
 static void dhdsdio_release(dhd_bus_t *bus, osl_t *osh);
 static void dhdsdio_release_malloc(dhd_bus_t *bus, osl_t *osh);
 static void dhdsdio_disconnect(void *ptr);
+static void dhdsdio_txflow_ac(dhd_bus_t *bus, int txq, bool state);
 static bool dhdsdio_chipmatch(uint16 chipid);
 static bool dhdsdio_probe_attach(dhd_bus_t *bus, osl_t *osh, void *sdh,
                                  void * regsva, uint16  devid);
@@ -1084,14 +1117,19 @@ dhd_bus_txdata(struct dhd_bus *bus, void *pkt)
 			dhd_txcomplete(bus->dhd, pkt, FALSE);
 			PKTFREE(osh, pkt, TRUE);
 			DHD_ERROR(("%s: out of bus->txq !!!\n", __FUNCTION__));
+			bus->txq_drops[prec]++;
 			ret = BCME_NORESOURCE;
 		} else {
 			ret = BCME_OK;
 		}
+		if (pktq_plen(&bus->txq, prec) > bus->txq_hiwat[prec])
+			bus->txq_hiwat[prec] = pktq_plen(&bus->txq, prec);
 		dhd_os_sdunlock_txq(bus->dhd);
 
 		if ((pktq_len(&bus->txq) >= FCHI) && dhd_doflow)
 			dhd_txflowcontrol(bus->dhd, 0, ON);
+		else if (dhd_txflow_ac)
+			dhdsdio_txflow_ac(bus, DHD_PREC2TXQ(prec), ON);
 
 #ifdef DHD_DEBUG
 		if (pktq_plen(&bus->txq, prec) > qcount[prec])
@@ -1135,16 +1173,36 @@ dhd_bus_txdata(struct dhd_bus *bus, void *pkt)
 	return ret;
 }
 
+/* Stop or wake one stack tx queue from the length of its two precedences */
+static void
+dhdsdio_txflow_ac(dhd_bus_t *bus, int txq, bool state)
+{
+	dhd_pub_t *dhd = bus->dhd;
+	bool off = (dhd->txoff_ac & NBITVAL(txq)) != 0;
+	uint len = pktq_mlen(&bus->txq, 3 << (txq * 2));
+
+	if (state == ON && !off && len >= FCHI_AC) {
+		bus->fc_ac_xoff[txq]++;
+		dhd_txflowcontrol_ac(dhd, 0, txq, ON);
+	} else if (state == OFF && off && len < FCLOW_AC) {
+		bus->fc_ac_xon[txq]++;
+		dhd_txflowcontrol_ac(dhd, 0, txq, OFF);
+	}
+}
+
 static uint
 dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 {
 	void *pkt;
+	void *batch[DHD_TXBATCH_MAX];
 	uint32 intstatus = 0;
 	uint retries = 0;
 	int ret = 0, prec_out;
 	uint cnt = 0;
 	uint datalen;
 	uint8 tx_prec_map;
+	uint n, i, nbatch;
+	int txq;
 
 	dhd_pub_t *dhd = bus->dhd;
 	sdpcmd_regs_t *regs = bus->regs;
@@ -1152,30 +1210,50 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
 
 	tx_prec_map = ~bus->flowcontrol;
+	nbatch = MAX(1, MIN(dhd_txbatch, DHD_TXBATCH_MAX));
 
 	/* Send frames until the limit or some other event */
-	for (cnt = 0; (cnt < maxframes) && DATAOK(bus); cnt++) {
+	while ((cnt < maxframes) && DATAOK(bus)) {
+		/* Take as many frames as the dongle has credit for in one go,
+		 * highest precedence first, then send them back to back.
+		 */
+		n = MIN(maxframes - cnt, nbatch);
+		n = MIN(n, (uint8)(bus->tx_max - bus->tx_seq));
+
 		dhd_os_sdlock_txq(bus->dhd);
-		if ((pkt = pktq_mdeq(&bus->txq, tx_prec_map, &prec_out)) == NULL) {
-			dhd_os_sdunlock_txq(bus->dhd);
-			break;
+		for (i = 0; i < n; i++) {
+			batch[i] = pktq_mdeq(&bus->txq, tx_prec_map, &prec_out);
+			if (batch[i] == NULL)
+				break;
 		}
 		dhd_os_sdunlock_txq(bus->dhd);
-		datalen = PKTLEN(bus->dhd->osh, pkt) - SDPCM_HDRLEN;
+
+		if ((n = i) == 0)
+			break;
+
+		bus->txbatches++;
+		bus->txbatchpkts += n;
+		if (n > bus->txbatchmax)
+			bus->txbatchmax = n;
+
+		for (i = 0; i < n; i++, cnt++) {
+			pkt = batch[i];
+			datalen = PKTLEN(bus->dhd->osh, pkt) - SDPCM_HDRLEN;
 
 #ifndef SDTEST
-		ret = dhdsdio_txpkt(bus, pkt, SDPCM_DATA_CHANNEL, TRUE);
+			ret = dhdsdio_txpkt(bus, pkt, SDPCM_DATA_CHANNEL, TRUE);
 #else
-		ret = dhdsdio_txpkt(bus, pkt,
-		        (bus->ext_loop ? SDPCM_TEST_CHANNEL : SDPCM_DATA_CHANNEL), TRUE);
+			ret = dhdsdio_txpkt(bus, pkt,
+			        (bus->ext_loop ? SDPCM_TEST_CHANNEL : SDPCM_DATA_CHANNEL), TRUE);
 #endif
-		if (ret)
-			bus->dhd->tx_errors++;
-		else
-			bus->dhd->dstats.tx_bytes += datalen;
+			if (ret)
+				bus->dhd->tx_errors++;
+			else
+				bus->dhd->dstats.tx_bytes += datalen;
+		}
 
 		/* In poll mode, need to check for other events */
-		if (!bus->intr && cnt)
+		if (!bus->intr && cnt > 1)
 		{
 			/* Check device status, signal pending interrupt */
 			R_SDREG(intstatus, &regs->intstatus, retries);
@@ -1192,6 +1270,11 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 	    dhd->txoff && (pktq_len(&bus->txq) < FCLOW))
 		dhd_txflowcontrol(dhd, 0, OFF);
 
+	if (dhd->txoff_ac && dhd->up && (dhd->busstate == DHD_BUS_DATA)) {
+		for (txq = 0; txq < DHD_NUM_TXQ; txq++)
+			dhdsdio_txflow_ac(bus, txq, OFF);
+	}
+
 	return cnt;
 }
 
@@ -1506,6 +1589,27 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 	            bus->fc_rcvd, bus->fc_xoff, bus->fc_xon);
 	bcm_bprintf(strbuf, "rxglomfail %d, rxglomframes %d, rxglompkts %d\n",
 	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts);
+	bcm_bprintf(strbuf, "rxglommax %d, pkts/glom (1/2-3/4-7/8-15/16+) %d %d %d %d %d\n",
+	            bus->rxglommax, bus->rxglomhist[0], bus->rxglomhist[1],
+	            bus->rxglomhist[2], bus->rxglomhist[3], bus->rxglomhist[4]);
+	bcm_bprintf(strbuf, "rxpool %d, hits %d, misses %d, rxchain %d\n",
+	            bus->rxpool_cnt, bus->rxpool_hits, bus->rxpool_misses,
+	            bus->use_rxchain);
+	bcm_bprintf(strbuf, "txbatches %d, pkts %d, max %d, txoff_ac 0x%x\n",
+	            bus->txbatches, bus->txbatchpkts, bus->txbatchmax, bus->dhd->txoff_ac);
+	{
+		int prec;
+
+		bcm_bprintf(strbuf, "txq prec: len/hiwat/drops");
+		for (prec = 0; prec <= PRIOMASK; prec++)
+			bcm_bprintf(strbuf, " %d/%d/%d", pktq_plen(&bus->txq, prec),
+			            bus->txq_hiwat[prec], bus->txq_drops[prec]);
+		bcm_bprintf(strbuf, "\ntxq ac (bk/be/vi/vo): xoff/xon");
+		for (prec = 0; prec < DHD_NUM_TXQ; prec++)
+			bcm_bprintf(strbuf, " %d/%d", bus->fc_ac_xoff[prec],
+			            bus->fc_ac_xon[prec]);
+		bcm_bprintf(strbuf, "\n");
+	}
 	bcm_bprintf(strbuf, "f2rx (hdrs/data) %d (%d/%d), f2tx %d f1regs %d\n",
 	            (bus->f2rxhdrs + bus->f2rxdata), bus->f2rxhdrs, bus->f2rxdata,
 	            bus->f2txdata, bus->f1regdata);
@@ -1572,6 +1676,13 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 	bus->rx_hdrfail = bus->rx_badhdr = bus->rx_badseq = 0;
 	bus->tx_sderrs = bus->fc_rcvd = bus->fc_xoff = bus->fc_xon = 0;
 	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = 0;
+	bus->rxglommax = bus->rxpool_hits = bus->rxpool_misses = 0;
+	bzero(bus->rxglomhist, sizeof(bus->rxglomhist));
+	bzero(bus->txq_hiwat, sizeof(bus->txq_hiwat));
+	bzero(bus->txq_drops, sizeof(bus->txq_drops));
+	bzero(bus->fc_ac_xoff, sizeof(bus->fc_ac_xoff));
+	bzero(bus->fc_ac_xon, sizeof(bus->fc_ac_xon));
+	bus->txbatches = bus->txbatchpkts = bus->txbatchmax = 0;
 	bus->f2rxhdrs = bus->f2rxdata = bus->f2txdata = bus->f1regdata = 0;
 }
 
@@ -3039,6 +3150,57 @@ done:
 	dhd_os_ioctl_resp_wake(bus->dhd);
 }
 
+/* Receive packet of at least len bytes, from the pool if one is big enough */
+static void *
+dhdsdio_pktget(dhd_bus_t *bus, uint len)
+{
+	osl_t *osh = bus->dhd->osh;
+	void *pkt;
+
+	if (len > DHD_RXPOOL_BUFSZ || !bus->rxpool) {
+		bus->rxpool_misses++;
+		return PKTGET(osh, len, FALSE);
+	}
+
+	pkt = bus->rxpool;
+	bus->rxpool = PKTLINK(pkt);
+	bus->rxpool_cnt--;
+	bus->rxpool_hits++;
+
+	PKTSETLINK(pkt, NULL);
+	PKTSETLEN(osh, pkt, len);
+	return pkt;
+}
+
+/* Top the pool back up, called once a burst of frames has been read */
+static void
+dhdsdio_rxpool_fill(dhd_bus_t *bus)
+{
+	osl_t *osh = bus->dhd->osh;
+	void *pkt;
+
+	while (bus->rxpool_cnt < DHD_RXPOOL_MAX) {
+		if (!(pkt = PKTGET(osh, DHD_RXPOOL_BUFSZ, FALSE)))
+			break;
+		PKTSETLINK(pkt, bus->rxpool);
+		bus->rxpool = pkt;
+		bus->rxpool_cnt++;
+	}
+}
+
+static void
+dhdsdio_rxpool_free(dhd_bus_t *bus, osl_t *osh)
+{
+	void *pkt;
+
+	while ((pkt = bus->rxpool)) {
+		bus->rxpool = PKTLINK(pkt);
+		PKTSETLINK(pkt, NULL);
+		PKTFREE(osh, pkt, FALSE);
+	}
+	bus->rxpool_cnt = 0;
+}
+
 static uint8
 dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 {
@@ -3055,6 +3217,7 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 
 	int ifidx = 0;
 	bool usechain = bus->use_rxchain;
+	uint bucket;
 
 	/* If packets, issue read(s) and send up packet chain */
 	/* Return sequence numbers consumed? */
@@ -3100,7 +3263,7 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 			}
 
 			/* Allocate/chain packet for next subframe */
-			if ((pnext = PKTGET(osh, sublen + DHD_SDALIGN, FALSE)) == NULL) {
+			if ((pnext = dhdsdio_pktget(bus, sublen + DHD_SDALIGN)) == NULL) {
 				DHD_ERROR(("%s: PKTGET failed, num %d len %d\n",
 				           __FUNCTION__, num, sublen));
 				break;
@@ -3417,6 +3580,11 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 
 		bus->rxglomframes++;
 		bus->rxglompkts += num;
+		if (num > bus->rxglommax)
+			bus->rxglommax = num;
+		for (bucket = 0; (bucket < DHD_GLOMHIST_SZ - 1) && (num >> (bucket + 1)); bucket++)
+			;
+		bus->rxglomhist[bucket]++;
 	}
 	return num;
 }
@@ -3511,7 +3679,7 @@ dhdsdio_readframes(dhd_bus_t *bus, uint maxframes, bool *finished)
 			 */
 			/* Allocate a packet buffer */
 			dhd_os_sdlock_rxq(bus->dhd);
-			if (!(pkt = PKTGET(osh, rdlen + DHD_SDALIGN, FALSE))) {
+			if (!(pkt = dhdsdio_pktget(bus, rdlen + DHD_SDALIGN))) {
 				if (bus->bus == SPI_BUS) {
 					bus->usebufpool = FALSE;
 					bus->rxctl = bus->rxbuf;
@@ -3885,7 +4053,7 @@ dhdsdio_readframes(dhd_bus_t *bus, uint maxframes, bool *finished)
 		}
 
 		dhd_os_sdlock_rxq(bus->dhd);
-		if (!(pkt = PKTGET(osh, (rdlen + firstread + DHD_SDALIGN), FALSE))) {
+		if (!(pkt = dhdsdio_pktget(bus, rdlen + firstread + DHD_SDALIGN))) {
 			/* Give up on data, request rtx of events */
 			DHD_ERROR(("%s: PKTGET failed: rdlen %d chan %d\n",
 			           __FUNCTION__, rdlen, chan));
@@ -3986,6 +4154,10 @@ deliver:
 		dhd_os_sdlock(bus->dhd);
 	}
 	rxcount = maxframes - rxleft;
+
+	/* Refill the pool now rather than per frame */
+	if (rxcount)
+		dhdsdio_rxpool_fill(bus);
 #ifdef DHD_DEBUG
 	/* Message if we hit the limit */
 	if (!rxleft && !sdtest)
@@ -5339,6 +5511,8 @@ dhdsdio_release_malloc(dhd_bus_t *bus, osl_t *osh)
 #endif
 		bus->databuf = NULL;
 	}
+
+	dhdsdio_rxpool_free(bus, osh);
 }
 
 
@@ -1476,7 +1476,7 @@ static int __devinit msm_batt_init_smem(void)
 
     init_waitqueue_head(&msm_batt_info.wait_q);
 
-    msm_batt_info.msm_batt_wq = create_singlethread_workqueue("msm_battery");
+    msm_batt_info.msm_batt_wq = create_shared_workqueue("msm_battery");
 
     if (!msm_batt_info.msm_batt_wq)
     {
@@ -1583,7 +1583,7 @@ static void __exit msm_batt_exit(void)
     platform_driver_unregister(&msm_batt_driver);
 }
 
-module_init(msm_batt_init);
+parallel_initcall(msm_batt_init);
 module_exit(msm_batt_exit);
 
 MODULE_LICENSE("Dual BSD/GPL");
@@ -1640,12 +1640,25 @@ static int wl_initialized = 0;//The rpc occur anytime ,so ,we must make sure tha
 #define BATTERY_HIGH           	    4300
 
 #define BATTERY_STATUS_POLL_TIME    (2*HZ)
+/* Longest poll interval while the screen is off and nothing changes */
+#define BATTERY_STATUS_POLL_TIME_MAX (64*HZ)
 #define SUSPEND_EVENT		(1UL << 0)
 #define RESUME_EVENT		(1UL << 1)
 #define CLEANUP_EVENT		(1UL << 2)
 //#define CAPACITY_EVENT      (1UL << 3)
 #define EVENT_CONDITION (SUSPEND_EVENT | RESUME_EVENT | CLEANUP_EVENT)
 
+static unsigned long msm_batt_poll_time = BATTERY_STATUS_POLL_TIME;
+static int msm_batt_screen_off;
+
+/* SMEM status reads, changes reported to userspace and RPC calls to the modem */
+static unsigned int msm_batt_reads;
+static unsigned int msm_batt_changes;
+static unsigned int msm_batt_rpc_calls;
+module_param_named(status_reads, msm_batt_reads, uint, S_IRUGO);
+module_param_named(status_changes, msm_batt_changes, uint, S_IRUGO);
+module_param_named(rpc_calls, msm_batt_rpc_calls, uint, S_IRUGO);
+
 
 #define DEBUG  0
 
@@ -2071,6 +2084,7 @@ static int msm_batt_handle_control_usb_charging(u32 usb_enable_disable)
 				__func__,usb_enable_disable);
 
 	req.usb_chg_enable = cpu_to_be32(usb_enable_disable);
+	msm_batt_rpc_calls++;
     rc=msm_rpc_call(msm_batt_info.chg_ep, BATTERY_ENABLE_DISABLE_USB_CHG_PROC, &req,
                     sizeof(req), 5 * HZ);
 
@@ -2348,6 +2362,7 @@ else
 
 void msm_batt_update_psy_status_v1(void)
 {
+    msm_batt_reads++;
     msm_batt_get_batt_chg_status_v1();/*get battery information for SMEM*/
 
     DEBUG_MSM_BATTERY();
@@ -2378,6 +2393,8 @@ void msm_batt_update_psy_status_v1(void)
         return;
     }
 
+    msm_batt_changes++;
+
 #ifdef MSM_BATTERY_DEBUGX
 	/*once one of the following change,such as charger_status,charger_type,battery_status
 	,battery_level, battery_voltage,battery_temp,chg_fulled and charging.
@@ -2619,6 +2636,7 @@ void msm_batt_force_update(void)
 			printk("No pity! update battery event\n");
                         wake_lock_timeout(&charger_wake_lock, 3 * HZ);
                         msm_batt_update_psy_status_v1();
+                        msm_batt_poll_time = BATTERY_STATUS_POLL_TIME;
 					#ifdef ZTE_CLK_BY_MOD_UART_CLOCK_NO_SLEEP
 						if(clk_record_enable_pre != clk_record_enable)
 							msm_batt_enable_2_record_clk_proccomm();
@@ -2644,9 +2662,23 @@ static int msm_batt_handle_resume(void)
     return 0;
 }
 
+/*
+ * Poll every BATTERY_STATUS_POLL_TIME while the screen is on or the status
+ * keeps changing. With the screen off each poll that finds nothing new
+ * doubles the interval up to BATTERY_STATUS_POLL_TIME_MAX. Charger events
+ * still arrive right away from the modem through msm_batt_force_update().
+ */
 static int msm_batt_handle_status_timeout(void)
 {
+    unsigned int changes = msm_batt_changes;
+
     msm_batt_update_psy_status_v1();
+
+    if (!msm_batt_screen_off || msm_batt_changes != changes)
+        msm_batt_poll_time = BATTERY_STATUS_POLL_TIME;
+    else
+        msm_batt_poll_time = min(msm_batt_poll_time * 2,
+                                 (unsigned long)BATTERY_STATUS_POLL_TIME_MAX);
     return 0;
 }
 
@@ -2726,7 +2758,7 @@ static void msm_batt_wait_for_batt_chg_event(struct work_struct *work)
     while (1)
     {
         ret = wait_event_interruptible_timeout(msm_batt_info.wait_q,
-                                               msm_batt_info.type_of_event & EVENT_CONDITION, BATTERY_STATUS_POLL_TIME);
+                                               msm_batt_info.type_of_event & EVENT_CONDITION, msm_batt_poll_time);
 
         DEBUG_MSM_BATTERY("ret = %d", ret);
         DEBUG_MSM_BATTERY("%s: %d\n", __func__, __LINE__);
@@ -2855,12 +2887,16 @@ void msm_batt_early_suspend(struct early_suspend *h)
 {
     DEBUG_MSM_BATTERY(KERN_INFO "%s(): going to early suspend\n", __func__);
     //msm_batt_send_event(SUSPEND_EVENT);
+    msm_batt_screen_off = 1;
 }
 
 void msm_batt_late_resume(struct early_suspend *h)
 {
     DEBUG_MSM_BATTERY(KERN_INFO "%s(): going to resume\n", __func__);
-    //msm_batt_send_event(RESUME_EVENT);
+    msm_batt_screen_off = 0;
+    /* The status may be a minute old, refresh it for the screen */
+    msm_batt_poll_time = BATTERY_STATUS_POLL_TIME;
+    msm_batt_send_event(RESUME_EVENT);
 }
 #endif
     /* ZTE_BATTERY_LYJ_005 start */
@@ -2970,7 +3006,7 @@ static int __devinit msm_batt_init_smem(void)
 
     init_waitqueue_head(&msm_batt_info.wait_q);
 
-    msm_batt_info.msm_batt_wq = create_singlethread_workqueue("msm_battery");
+    msm_batt_info.msm_batt_wq = create_shared_workqueue("msm_battery");
 
     if (!msm_batt_info.msm_batt_wq)
     {
@@ -3077,7 +3113,7 @@ static void __exit msm_batt_exit(void)
     platform_driver_unregister(&msm_batt_driver);
 }
 
-module_init(msm_batt_init);
+parallel_initcall(msm_batt_init);
 module_exit(msm_batt_exit);
 
 MODULE_LICENSE("Dual BSD/GPL");
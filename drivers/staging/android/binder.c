@@ -28,6 +28,7 @@
 #include <linux/nsproxy.h>
 #include <linux/poll.h>
 #include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <linux/rbtree.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
@@ -36,6 +37,7 @@
 #include <linux/vmalloc.h>
 
 #include "binder.h"
+#include "binder_trace.h"
 
 static DEFINE_MUTEX(binder_lock);
 static DEFINE_MUTEX(binder_deferred_lock);
@@ -82,6 +84,20 @@ BINDER_DEBUG_ENTRY(proc);
 
 #define BINDER_SMALL_BUF_SIZE (PAGE_SIZE * 64)
 
+/*
+ * Transactions of up to 256 bytes are served from per-proc size-class
+ * free lists. Slots are carved out of BINDER_SLAB_SIZE chunks taken from
+ * the best-fit allocator and keep their pages mapped while on the free
+ * list, so small allocations and frees never touch free_buffers or the
+ * page tables.
+ */
+#define BINDER_SIZE_CLASSES             3
+#define BINDER_SIZE_CLASS_MIN_SHIFT     6
+#define BINDER_SIZE_CLASS_MAX \
+	(1U << (BINDER_SIZE_CLASS_MIN_SHIFT + BINDER_SIZE_CLASSES - 1))
+#define BINDER_SLAB_SIZE                PAGE_SIZE
+#define BINDER_MAX_SLABS_PER_CLASS      4
+
 enum {
 	BINDER_DEBUG_USER_ERROR             = 1U << 0,
 	BINDER_DEBUG_FAILED_TRANSACTION     = 1U << 1,
@@ -149,9 +165,13 @@ enum binder_stat_types {
 
 struct binder_stats {
 	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
-	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
+	int bc[_IOC_NR(BC_REPLY_SG) + 1];
 	int obj_created[BINDER_STAT_COUNT];
 	int obj_deleted[BINDER_STAT_COUNT];
+	int small_alloc[BINDER_SIZE_CLASSES];
+	int small_free[BINDER_SIZE_CLASSES];
+	int small_slabs[BINDER_SIZE_CLASSES];
+	int large_alloc;
 };
 
 static struct binder_stats binder_stats;
@@ -200,6 +220,47 @@ static struct binder_transaction_log_entry *binder_transaction_log_add(
 	return e;
 }
 
+/*
+ * Per-proc transaction latency histograms, in log2 microsecond buckets.
+ * wakeup is the time from BC_TRANSACTION until a thread of the target proc
+ * picks the transaction up, reply is the time the target then takes to
+ * send BC_REPLY. A growing wakeup tail points at thread-pool starvation, a
+ * growing reply tail at slow service code.
+ */
+#define BINDER_LATENCY_BUCKETS 24
+
+struct binder_latency_hist {
+	unsigned int wakeup[BINDER_LATENCY_BUCKETS];
+	unsigned int reply[BINDER_LATENCY_BUCKETS];
+};
+
+static void binder_latency_add(unsigned int *hist, s64 us)
+{
+	int bucket = us > 0 ? fls64(us) : 0;
+
+	if (bucket >= BINDER_LATENCY_BUCKETS)
+		bucket = BINDER_LATENCY_BUCKETS - 1;
+	hist[bucket]++;
+}
+
+/*
+ * Round trips of two-way transactions, from BC_TRANSACTION until the target
+ * sends BC_REPLY, for all procs by transaction data size: up to 64, 256,
+ * 1K and 4K bytes, and more. Protected by binder_lock.
+ */
+#define BINDER_RTT_CLASSES 5
+
+static unsigned int binder_rtt[BINDER_RTT_CLASSES][BINDER_LATENCY_BUCKETS];
+
+static unsigned int binder_rtt_class(size_t size)
+{
+	unsigned int class = 0;
+
+	while (class < BINDER_RTT_CLASSES - 1 && size > (64 << (2 * class)))
+		class++;
+	return class;
+}
+
 struct binder_work {
 	struct list_head entry;
 	enum {
@@ -232,6 +293,7 @@ struct binder_node {
 	unsigned pending_weak_ref:1;
 	unsigned has_async_transaction:1;
 	unsigned accept_fds:1;
+	unsigned inherit_rt:1;
 	unsigned min_priority:8;
 	struct list_head async_todo;
 };
@@ -260,12 +322,16 @@ struct binder_ref {
 
 struct binder_buffer {
 	struct list_head entry; /* free and allocated entries by address */
-	struct rb_node rb_node; /* free entry by size or allocated entry */
-				/* by address */
+	union {
+		struct rb_node rb_node; /* free entry by size or allocated */
+					/* entry by address */
+		struct list_head class_entry; /* free size-class slot */
+	};
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
-	unsigned debug_id:29;
+	unsigned size_class:2; /* 0 for best-fit buffers, else class + 1 */
+	unsigned debug_id:27;
 
 	struct binder_transaction *transaction;
 
@@ -301,6 +367,11 @@ struct binder_proc {
 	struct rb_root free_buffers;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
+	struct list_head small_buffers[BINDER_SIZE_CLASSES];
+	int small_slabs[BINDER_SIZE_CLASSES];
+	struct mutex alloc_lock; /* buffers, free/allocated trees, pages */
+	int tmp_ref; /* in-flight transactions copying into our buffer */
+	int release_deferred;
 
 	struct page **pages;
 	size_t buffer_size;
@@ -315,6 +386,7 @@ struct binder_proc {
 	int ready_threads;
 	long default_priority;
 	struct dentry *debugfs_entry;
+	struct binder_latency_hist latency;
 };
 
 enum {
@@ -350,6 +422,8 @@ struct binder_transaction {
 	struct binder_thread *to_thread;
 	struct binder_transaction *to_parent;
 	unsigned need_reply:1;
+	unsigned rt_inherited:1;
+	unsigned rtt_class:3;
 	/* unsigned is_dead:1; */	/* not used at the moment */
 
 	struct binder_buffer *buffer;
@@ -357,7 +431,13 @@ struct binder_transaction {
 	unsigned int	flags;
 	long	priority;
 	long	saved_priority;
+	int	policy;
+	int	rt_priority;
+	int	saved_policy;
+	int	saved_rt_priority;
 	uid_t	sender_euid;
+	ktime_t	start_time;	/* queued by the sender */
+	ktime_t	deliver_time;	/* picked up by the target thread */
 };
 
 static void
@@ -518,6 +598,24 @@ static void binder_set_nice(long nice)
 	binder_user_error("binder: %d RLIMIT_NICE not set\n", current->pid);
 }
 
+static int binder_rt_policy(int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static void binder_set_rt_priority(int policy, int rt_priority)
+{
+	struct sched_param param = { .sched_priority = rt_priority };
+
+	if (current->policy == policy && current->rt_priority == rt_priority)
+		return;
+	if (sched_setscheduler_nocheck(current, policy, &param))
+		binder_debug(BINDER_DEBUG_PRIORITY_CAP,
+			     "binder: %d: policy %d rt priority %d "
+			     "not allowed\n", current->pid, policy,
+			     rt_priority);
+}
+
 static size_t binder_buffer_size(struct binder_proc *proc,
 				 struct binder_buffer *buffer)
 {
@@ -589,13 +687,15 @@ static void binder_insert_allocated_buffer(struct binder_proc *proc,
 static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 						  void __user *user_ptr)
 {
-	struct rb_node *n = proc->allocated_buffers.rb_node;
-	struct binder_buffer *buffer;
+	struct rb_node *n;
+	struct binder_buffer *buffer = NULL;
 	struct binder_buffer *kern_ptr;
 
 	kern_ptr = user_ptr - proc->user_buffer_offset
 		- offsetof(struct binder_buffer, data);
 
+	mutex_lock(&proc->alloc_lock);
+	n = proc->allocated_buffers.rb_node;
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(buffer->free);
@@ -605,9 +705,10 @@ static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 		else if (kern_ptr > buffer)
 			n = n->rb_right;
 		else
-			return buffer;
+			break;
 	}
-	return NULL;
+	mutex_unlock(&proc->alloc_lock);
+	return n ? buffer : NULL;
 }
 
 static int binder_update_page_range(struct binder_proc *proc, int allocate,
@@ -717,9 +818,8 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
+static struct binder_buffer *binder_alloc_best_fit(struct binder_proc *proc,
+						   size_t size)
 {
 	struct rb_node *n = proc->free_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -727,31 +827,6 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	struct rb_node *best_fit = NULL;
 	void *has_page_addr;
 	void *end_page_addr;
-	size_t size;
-
-	if (proc->vma == NULL) {
-		binder_debug(BINDER_DEBUG_TOP_ERRORS,
-		       "binder: %d: binder_alloc_buf, no vma\n",
-		       proc->pid);
-		return NULL;
-	}
-
-	size = ALIGN(data_size, sizeof(void *)) +
-		ALIGN(offsets_size, sizeof(void *));
-
-	if (size < data_size || size < offsets_size) {
-		binder_user_error("binder: %d: got transaction with invalid "
-			"size %zd-%zd\n", proc->pid, data_size, offsets_size);
-		return NULL;
-	}
-
-	if (is_async &&
-	    proc->free_async_space < size + sizeof(struct binder_buffer)) {
-		binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-			     "binder: %d: binder_alloc_buf size %zd"
-			     "failed, no async space left\n", proc->pid, size);
-		return NULL;
-	}
 
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
@@ -806,11 +881,159 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		struct binder_buffer *new_buffer = (void *)buffer->data + size;
 		list_add(&new_buffer->entry, &buffer->entry);
 		new_buffer->free = 1;
+		new_buffer->size_class = 0;
 		binder_insert_free_buffer(proc, new_buffer);
 	}
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: binder_alloc_buf size %zd got "
 		     "%p\n", proc->pid, size, buffer);
+	return buffer;
+}
+
+static int binder_size_class(size_t size)
+{
+	int size_class = 0;
+
+	if (size > BINDER_SIZE_CLASS_MAX)
+		return -1;
+	while (size > (1U << (BINDER_SIZE_CLASS_MIN_SHIFT + size_class)))
+		size_class++;
+	return size_class;
+}
+
+static size_t binder_size_class_bytes(int size_class)
+{
+	return 1U << (BINDER_SIZE_CLASS_MIN_SHIFT + size_class);
+}
+
+/*
+ * Carve a new slab for size_class out of the best-fit allocator. The slab
+ * is split into slots that stay linked into proc->buffers in address
+ * order, so binder_buffer_size() keeps working on them. Slots are never
+ * marked free, which keeps neighbouring best-fit buffers from merging with
+ * them and keeps their pages mapped.
+ */
+static int binder_grow_size_class(struct binder_proc *proc, int size_class)
+{
+	struct binder_buffer *slab, *slot, *prev;
+	size_t slot_size, total;
+	int i, count;
+
+	if (proc->small_slabs[size_class] >= BINDER_MAX_SLABS_PER_CLASS)
+		return -ENOSPC;
+
+	slab = binder_alloc_best_fit(proc, BINDER_SLAB_SIZE -
+				     sizeof(struct binder_buffer));
+	if (slab == NULL)
+		return -ENOMEM;
+	rb_erase(&slab->rb_node, &proc->allocated_buffers);
+
+	slot_size = sizeof(struct binder_buffer) +
+		binder_size_class_bytes(size_class);
+	total = binder_buffer_size(proc, slab) + sizeof(struct binder_buffer);
+	count = total / slot_size;
+	BUG_ON(count == 0);
+
+	prev = NULL;
+	for (i = 0; i < count; i++) {
+		slot = (void *)slab + i * slot_size;
+		if (prev) {
+			memset(slot, 0, sizeof(*slot));
+			list_add(&slot->entry, &prev->entry);
+		}
+		slot->free = 0;
+		slot->allow_user_free = 0;
+		slot->async_transaction = 0;
+		slot->size_class = size_class + 1;
+		slot->transaction = NULL;
+		slot->target_node = NULL;
+		list_add_tail(&slot->class_entry,
+			      &proc->small_buffers[size_class]);
+		prev = slot;
+	}
+	proc->small_slabs[size_class]++;
+	proc->stats.small_slabs[size_class]++;
+	binder_stats.small_slabs[size_class]++;
+
+	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+		     "binder: %d: new slab %p for size class %zd, %d slots\n",
+		     proc->pid, slab, binder_size_class_bytes(size_class),
+		     count);
+	return 0;
+}
+
+static struct binder_buffer *binder_alloc_small_buf(struct binder_proc *proc,
+						    int size_class)
+{
+	struct list_head *head = &proc->small_buffers[size_class];
+	struct binder_buffer *buffer;
+
+	if (list_empty(head) && binder_grow_size_class(proc, size_class))
+		return NULL;
+
+	buffer = list_first_entry(head, struct binder_buffer, class_entry);
+	list_del(&buffer->class_entry);
+	binder_insert_allocated_buffer(proc, buffer);
+	proc->stats.small_alloc[size_class]++;
+	binder_stats.small_alloc[size_class]++;
+	return buffer;
+}
+
+static void binder_free_small_buf(struct binder_proc *proc,
+				  struct binder_buffer *buffer)
+{
+	int size_class = buffer->size_class - 1;
+
+	rb_erase(&buffer->rb_node, &proc->allocated_buffers);
+	list_add(&buffer->class_entry, &proc->small_buffers[size_class]);
+	proc->stats.small_free[size_class]++;
+	binder_stats.small_free[size_class]++;
+}
+
+static struct binder_buffer *__binder_alloc_buf(struct binder_proc *proc,
+						size_t data_size,
+						size_t offsets_size,
+						int is_async)
+{
+	struct binder_buffer *buffer = NULL;
+	size_t size;
+	int size_class;
+
+	if (proc->vma == NULL) {
+		binder_debug(BINDER_DEBUG_TOP_ERRORS,
+		       "binder: %d: binder_alloc_buf, no vma\n",
+		       proc->pid);
+		return NULL;
+	}
+
+	size = ALIGN(data_size, sizeof(void *)) +
+		ALIGN(offsets_size, sizeof(void *));
+
+	if (size < data_size || size < offsets_size) {
+		binder_user_error("binder: %d: got transaction with invalid "
+			"size %zd-%zd\n", proc->pid, data_size, offsets_size);
+		return NULL;
+	}
+
+	if (is_async &&
+	    proc->free_async_space < size + sizeof(struct binder_buffer)) {
+		binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+			     "binder: %d: binder_alloc_buf size %zd"
+			     "failed, no async space left\n", proc->pid, size);
+		return NULL;
+	}
+
+	size_class = binder_size_class(size);
+	if (size_class >= 0)
+		buffer = binder_alloc_small_buf(proc, size_class);
+	if (buffer == NULL) {
+		buffer = binder_alloc_best_fit(proc, size);
+		if (buffer == NULL)
+			return NULL;
+		proc->stats.large_alloc++;
+		binder_stats.large_alloc++;
+	}
+
 	buffer->data_size = data_size;
 	buffer->offsets_size = offsets_size;
 	buffer->async_transaction = is_async;
@@ -825,6 +1048,23 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+/*
+ * The allocator is protected by proc->alloc_lock rather than binder_lock so
+ * that binder_transaction() can allocate and fill the target buffer without
+ * holding the global lock.
+ */
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size, int is_async)
+{
+	struct binder_buffer *buffer;
+
+	mutex_lock(&proc->alloc_lock);
+	buffer = __binder_alloc_buf(proc, data_size, offsets_size, is_async);
+	mutex_unlock(&proc->alloc_lock);
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -882,8 +1122,8 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 	}
 }
 
-static void binder_free_buf(struct binder_proc *proc,
-			    struct binder_buffer *buffer)
+static void __binder_free_buf(struct binder_proc *proc,
+			      struct binder_buffer *buffer)
 {
 	size_t size, buffer_size;
 
@@ -911,6 +1151,11 @@ static void binder_free_buf(struct binder_proc *proc,
 			     proc->free_async_space);
 	}
 
+	if (buffer->size_class) {
+		binder_free_small_buf(proc, buffer);
+		return;
+	}
+
 	binder_update_page_range(proc, 0,
 		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
 		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
@@ -937,6 +1182,35 @@ static void binder_free_buf(struct binder_proc *proc,
 	binder_insert_free_buffer(proc, buffer);
 }
 
+static void binder_free_buf(struct binder_proc *proc,
+			    struct binder_buffer *buffer)
+{
+	mutex_lock(&proc->alloc_lock);
+	__binder_free_buf(proc, buffer);
+	mutex_unlock(&proc->alloc_lock);
+}
+
+/*
+ * A proc with a positive tmp_ref has a transaction copying into one of its
+ * buffers without binder_lock held. binder_deferred_release() must not tear
+ * down its pages until the last such transaction is done, so the release is
+ * postponed and requeued from binder_proc_dec_tmpref(). Both are called with
+ * binder_lock held.
+ */
+static void binder_proc_inc_tmpref(struct binder_proc *proc)
+{
+	proc->tmp_ref++;
+}
+
+static void binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	BUG_ON(proc->tmp_ref <= 0);
+	if (--proc->tmp_ref == 0 && proc->release_deferred) {
+		proc->release_deferred = 0;
+		binder_defer_work(proc, BINDER_DEFERRED_RELEASE);
+	}
+}
+
 static struct binder_node *binder_get_node(struct binder_proc *proc,
 					   void __user *ptr)
 {
@@ -1402,9 +1676,36 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+/*
+ * Gather the payload of a BC_TRANSACTION_SG/BC_REPLY_SG from the user
+ * buffers in sg->vecs into data, which has room for data_size bytes.
+ */
+static int binder_copy_sg_data(void *data,
+			       struct binder_transaction_data_sg *sg,
+			       size_t data_size)
+{
+	const struct binder_buffer_vec __user *uvec = sg->vecs;
+	struct binder_buffer_vec vec;
+	size_t i;
+
+	for (i = 0; i < sg->vec_count; i++) {
+		if (copy_from_user(&vec, &uvec[i], sizeof(vec)))
+			return -EFAULT;
+		if (vec.len > data_size)
+			return -EINVAL;
+		if (copy_from_user(data, vec.base, vec.len))
+			return -EFAULT;
+		data += vec.len;
+		data_size -= vec.len;
+	}
+	return data_size ? -EINVAL : 0;
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
-			       struct binder_transaction_data *tr, int reply)
+			       struct binder_transaction_data *tr,
+			       struct binder_transaction_data_sg *sg,
+			       int reply)
 {
 	struct binder_transaction *t;
 	struct binder_work *tcomplete;
@@ -1435,6 +1736,11 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
+		if (in_reply_to->rt_inherited) {
+			binder_set_rt_priority(in_reply_to->saved_policy,
+					       in_reply_to->saved_rt_priority);
+			in_reply_to->rt_inherited = 0;
+		}
 		binder_set_nice(in_reply_to->saved_priority);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("binder: %d:%d got reply transaction "
@@ -1450,6 +1756,15 @@ static void binder_transaction(struct binder_proc *proc,
 			goto err_bad_call_stack;
 		}
 		thread->transaction_stack = in_reply_to->to_parent;
+		if (in_reply_to->deliver_time.tv64) {
+			s64 us = ktime_us_delta(ktime_get(),
+						in_reply_to->deliver_time);
+			binder_latency_add(proc->latency.reply, us);
+			trace_binder_reply(in_reply_to, us);
+		}
+		binder_latency_add(binder_rtt[in_reply_to->rtt_class],
+				   ktime_us_delta(ktime_get(),
+						  in_reply_to->start_time));
 		target_thread = in_reply_to->from;
 		if (target_thread == NULL) {
 			return_error = BR_DEAD_REPLY;
@@ -1508,21 +1823,8 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error = BR_FAILED_REPLY;
 				goto err_bad_call_stack;
 			}
-			while (tmp) {
-				if (tmp->from && tmp->from->proc == target_proc)
-					target_thread = tmp->from;
-				tmp = tmp->from_parent;
-			}
 		}
 	}
-	if (target_thread) {
-		e->to_thread = target_thread->pid;
-		target_list = &target_thread->todo;
-		target_wait = &target_thread->wait;
-	} else {
-		target_list = &target_proc->todo;
-		target_wait = &target_proc->wait;
-	}
 	e->to_proc = target_proc->pid;
 
 	/* TODO: reuse incoming transaction for reply */
@@ -1566,13 +1868,33 @@ static void binder_transaction(struct binder_proc *proc,
 		t->from = NULL;
 	t->sender_euid = proc->tsk->cred->euid;
 	t->to_proc = target_proc;
-	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
 	t->priority = task_nice(current);
+	t->policy = current->policy;
+	t->rt_priority = current->rt_priority;
+
+	/*
+	 * Allocate the target buffer and copy the payload into it without
+	 * binder_lock, so that transactions between unrelated processes do
+	 * not serialize on each other's copy_from_user() and page mapping.
+	 * The buffer is not visible to the target until it is queued below,
+	 * target_proc is pinned by tmp_ref and target_node by a local
+	 * strong reference. Everything else is revalidated once the lock is
+	 * taken again.
+	 */
+	binder_proc_inc_tmpref(target_proc);
+	if (target_node)
+		binder_inc_node(target_node, 1, 0, NULL);
+	mutex_unlock(&binder_lock);
+
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
 		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
 	if (t->buffer == NULL) {
+		mutex_lock(&binder_lock);
+		binder_proc_dec_tmpref(target_proc);
+		if (target_node)
+			binder_dec_node(target_node, 1, 0);
 		return_error = BR_FAILED_REPLY;
 		goto err_binder_alloc_buf_failed;
 	}
@@ -1580,23 +1902,64 @@ static void binder_transaction(struct binder_proc *proc,
 	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
 	t->buffer->target_node = target_node;
-	if (target_node)
-		binder_inc_node(target_node, 1, 0, NULL);
 
 	offp = (size_t *)(t->buffer->data + ALIGN(tr->data_size, sizeof(void *)));
 
-	if (copy_from_user(t->buffer->data, tr->data.ptr.buffer, tr->data_size)) {
+	if (sg) {
+		if (binder_copy_sg_data(t->buffer->data, sg, tr->data_size)) {
+			mutex_lock(&binder_lock);
+			binder_proc_dec_tmpref(target_proc);
+			binder_user_error("binder: %d:%d got transaction with "
+				"invalid buffer vector\n",
+				proc->pid, thread->pid);
+			return_error = BR_FAILED_REPLY;
+			goto err_copy_data_failed;
+		}
+	} else if (copy_from_user(t->buffer->data, tr->data.ptr.buffer,
+				  tr->data_size)) {
+		mutex_lock(&binder_lock);
+		binder_proc_dec_tmpref(target_proc);
 		binder_user_error("binder: %d:%d got transaction with invalid "
 			"data ptr\n", proc->pid, thread->pid);
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
 	if (copy_from_user(offp, tr->data.ptr.offsets, tr->offsets_size)) {
+		mutex_lock(&binder_lock);
+		binder_proc_dec_tmpref(target_proc);
 		binder_user_error("binder: %d:%d got transaction with invalid "
 			"offsets ptr\n", proc->pid, thread->pid);
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
+
+	mutex_lock(&binder_lock);
+	binder_proc_dec_tmpref(target_proc);
+
+	if (reply) {
+		if (in_reply_to->from != target_thread) {
+			/* the caller died while we were copying */
+			return_error = BR_DEAD_REPLY;
+			goto err_copy_data_failed;
+		}
+	} else if (!(tr->flags & TF_ONE_WAY) && thread->transaction_stack) {
+		struct binder_transaction *tmp = thread->transaction_stack;
+
+		while (tmp) {
+			if (tmp->from && tmp->from->proc == target_proc)
+				target_thread = tmp->from;
+			tmp = tmp->from_parent;
+		}
+	}
+	t->to_thread = target_thread;
+	if (target_thread) {
+		e->to_thread = target_thread->pid;
+		target_list = &target_thread->todo;
+		target_wait = &target_thread->wait;
+	} else {
+		target_list = &target_proc->todo;
+		target_wait = &target_proc->wait;
+	}
 	if (!IS_ALIGNED(tr->offsets_size, sizeof(size_t))) {
 		binder_user_error("binder: %d:%d got transaction with "
 			"invalid offsets size, %zd\n",
@@ -1634,6 +1997,8 @@ static void binder_transaction(struct binder_proc *proc,
 						FLAT_BINDER_FLAG_PRIORITY_MASK;
 				node->accept_fds = !!(fp->flags &
 						FLAT_BINDER_FLAG_ACCEPTS_FDS);
+				node->inherit_rt = !!(fp->flags &
+						FLAT_BINDER_FLAG_INHERIT_RT);
 			}
 			if (fp->cookie != node->cookie) {
 				binder_user_error("binder: %d:%d sending u%p "
@@ -1782,6 +2147,9 @@ static void binder_transaction(struct binder_proc *proc,
 			target_node->has_async_transaction = 1;
 	}
 	t->work.type = BINDER_WORK_TRANSACTION;
+	t->start_time = ktime_get();
+	t->rtt_class = binder_rtt_class(tr->data_size);
+	trace_binder_transaction(reply, t, target_node);
 	list_add_tail(&t->work.entry, target_list);
 	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
 	list_add_tail(&tcomplete->entry, &thread->todo);
@@ -2032,7 +2400,20 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (copy_from_user(&tr, ptr, sizeof(tr)))
 				return -EFAULT;
 			ptr += sizeof(tr);
-			binder_transaction(proc, thread, &tr, cmd == BC_REPLY);
+			binder_transaction(proc, thread, &tr, NULL,
+					   cmd == BC_REPLY);
+			break;
+		}
+
+		case BC_TRANSACTION_SG:
+		case BC_REPLY_SG: {
+			struct binder_transaction_data_sg tr;
+
+			if (copy_from_user(&tr, ptr, sizeof(tr)))
+				return -EFAULT;
+			ptr += sizeof(tr);
+			binder_transaction(proc, thread, &tr.transaction_data,
+					   &tr, cmd == BC_REPLY_SG);
 			break;
 		}
 
@@ -2321,6 +2702,7 @@ retry:
 			ret = wait_event_interruptible(thread->wait, binder_has_thread_work(thread));
 	}
 	mutex_lock(&binder_lock);
+	trace_binder_wakeup(proc, thread, wait_for_proc_work, ret);
 	if (wait_for_proc_work)
 		proc->ready_threads--;
 	thread->looper &= ~BINDER_LOOPER_STATE_WAITING;
@@ -2333,6 +2715,7 @@ retry:
 		struct binder_transaction_data tr;
 		struct binder_work *w;
 		struct binder_transaction *t = NULL;
+		s64 latency;
 
 		if (!list_empty(&thread->todo))
 			w = list_first_entry(&thread->todo, struct binder_work, entry);
@@ -2472,6 +2855,22 @@ retry:
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
 			t->saved_priority = task_nice(current);
+			t->saved_policy = current->policy;
+			t->saved_rt_priority = current->rt_priority;
+			/*
+			 * Nodes that opted in with FLAT_BINDER_FLAG_INHERIT_RT
+			 * run synchronous calls from real-time callers at the
+			 * caller's policy and priority until BC_REPLY.
+			 */
+			if (target_node->inherit_rt &&
+			    !(t->flags & TF_ONE_WAY) &&
+			    binder_rt_policy(t->policy) &&
+			    (!binder_rt_policy(current->policy) ||
+			     current->rt_priority < t->rt_priority)) {
+				binder_set_rt_priority(t->policy,
+						       t->rt_priority);
+				t->rt_inherited = 1;
+			}
 			if (t->priority < target_node->min_priority &&
 			    !(t->flags & TF_ONE_WAY))
 				binder_set_nice(t->priority);
@@ -2479,6 +2878,10 @@ retry:
 				 t->saved_priority > target_node->min_priority)
 				binder_set_nice(target_node->min_priority);
 			cmd = BR_TRANSACTION;
+			t->deliver_time = ktime_get();
+			latency = ktime_us_delta(t->deliver_time, t->start_time);
+			binder_latency_add(proc->latency.wakeup, latency);
+			trace_binder_transaction_received(t, latency);
 		} else {
 			tr.target.ptr = NULL;
 			tr.cookie = NULL;
@@ -2950,6 +3353,7 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	INIT_LIST_HEAD(&proc->buffers);
 	list_add(&buffer->entry, &proc->buffers);
 	buffer->free = 1;
+	buffer->size_class = 0;
 	binder_insert_free_buffer(proc, buffer);
 	proc->free_async_space = proc->buffer_size / 2;
 	barrier();
@@ -2982,6 +3386,7 @@ err_bad_arg:
 static int binder_open(struct inode *nodp, struct file *filp)
 {
 	struct binder_proc *proc;
+	int i;
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE, "binder_open: %d:%d\n",
 		     current->group_leader->pid, current->pid);
@@ -2993,6 +3398,9 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc->tsk = current;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
+	for (i = 0; i < BINDER_SIZE_CLASSES; i++)
+		INIT_LIST_HEAD(&proc->small_buffers[i]);
+	mutex_init(&proc->alloc_lock);
 	proc->default_priority = task_nice(current);
 	mutex_lock(&binder_lock);
 	binder_stats_created(BINDER_STAT_PROC);
@@ -3207,8 +3615,12 @@ static void binder_deferred_func(struct work_struct *work)
 		if (defer & BINDER_DEFERRED_FLUSH)
 			binder_deferred_flush(proc);
 
-		if (defer & BINDER_DEFERRED_RELEASE)
-			binder_deferred_release(proc); /* frees proc */
+		if (defer & BINDER_DEFERRED_RELEASE) {
+			if (proc->tmp_ref)
+				proc->release_deferred = 1;
+			else
+				binder_deferred_release(proc); /* frees proc */
+		}
 
 		mutex_unlock(&binder_lock);
 		if (files)
@@ -3391,9 +3803,13 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
+	if (!binder_debug_no_lock)
+		mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		print_binder_buffer(m, "  buffer",
 				    rb_entry(n, struct binder_buffer, rb_node));
+	if (!binder_debug_no_lock)
+		mutex_unlock(&proc->alloc_lock);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -3442,7 +3858,9 @@ static const char * const binder_command_strings[] = {
 	"BC_EXIT_LOOPER",
 	"BC_REQUEST_DEATH_NOTIFICATION",
 	"BC_CLEAR_DEATH_NOTIFICATION",
-	"BC_DEAD_BINDER_DONE"
+	"BC_DEAD_BINDER_DONE",
+	"BC_TRANSACTION_SG",
+	"BC_REPLY_SG"
 };
 
 static const char * const binder_objstat_strings[] = {
@@ -3523,8 +3941,12 @@ static void print_binder_proc_stats(struct seq_file *m,
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
 	count = 0;
+	if (!binder_debug_no_lock)
+		mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		count++;
+	if (!binder_debug_no_lock)
+		mutex_unlock(&proc->alloc_lock);
 	seq_printf(m, "  buffers: %d\n", count);
 
 	count = 0;
@@ -3618,6 +4040,56 @@ static int binder_proc_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static void print_binder_latency_hist(struct seq_file *m, const char *name,
+				      unsigned int *hist)
+{
+	int i;
+
+	for (i = 0; i < BINDER_LATENCY_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		if (i == 0)
+			seq_printf(m, "  %s <1us: %u\n", name, hist[i]);
+		else if (i == BINDER_LATENCY_BUCKETS - 1)
+			seq_printf(m, "  %s >=%lluus: %u\n", name,
+				   1ULL << (i - 1), hist[i]);
+		else
+			seq_printf(m, "  %s %llu-%lluus: %u\n", name,
+				   1ULL << (i - 1), (1ULL << i) - 1, hist[i]);
+	}
+}
+
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+	char name[16];
+	int i;
+	int do_lock = !binder_debug_no_lock;
+
+	if (do_lock)
+		mutex_lock(&binder_lock);
+
+	seq_puts(m, "binder latency:\n");
+	for (i = 0; i < BINDER_RTT_CLASSES; i++) {
+		if (i < BINDER_RTT_CLASSES - 1)
+			snprintf(name, sizeof(name), "rtt <=%uB",
+				 64 << (2 * i));
+		else
+			snprintf(name, sizeof(name), "rtt >%uB",
+				 64 << (2 * (i - 1)));
+		print_binder_latency_hist(m, name, binder_rtt[i]);
+	}
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		seq_printf(m, "proc %d\n", proc->pid);
+		print_binder_latency_hist(m, "wakeup", proc->latency.wakeup);
+		print_binder_latency_hist(m, "reply", proc->latency.reply);
+	}
+	if (do_lock)
+		mutex_unlock(&binder_lock);
+	return 0;
+}
+
 static void print_binder_transaction_log_entry(struct seq_file *m,
 					struct binder_transaction_log_entry *e)
 {
@@ -3663,12 +4135,13 @@ BINDER_DEBUG_ENTRY(state);
 BINDER_DEBUG_ENTRY(stats);
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
+BINDER_DEBUG_ENTRY(latency);
 
 static int __init binder_init(void)
 {
 	int ret;
 
-	binder_deferred_workqueue = create_singlethread_workqueue("binder");
+	binder_deferred_workqueue = create_shared_workqueue("binder");
 	if (!binder_deferred_workqueue)
 		return -ENOMEM;
 
@@ -3703,10 +4176,18 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("latency",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 	}
 	return ret;
 }
 
 device_initcall(binder_init);
 
+#define CREATE_TRACE_POINTS
+#include "binder_trace.h"
+
 MODULE_LICENSE("GPL v2");
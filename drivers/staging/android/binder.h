@@ -37,6 +37,7 @@ enum {
 enum {
 	FLAT_BINDER_FLAG_PRIORITY_MASK = 0xff,
 	FLAT_BINDER_FLAG_ACCEPTS_FDS = 0x100,
+	FLAT_BINDER_FLAG_INHERIT_RT = 0x800,
 };
 
 /*
@@ -147,6 +148,24 @@ struct binder_transaction_data {
 	} data;
 };
 
+struct binder_buffer_vec {
+	const void	*base;
+	size_t		len;
+};
+
+/*
+ * Scatter-gather form of binder_transaction_data. The payload is gathered
+ * by the driver from vec_count user buffers, whose lengths must add up to
+ * transaction_data.data_size, straight into the target's buffer. The
+ * data.ptr.buffer field is ignored; offsets still come from
+ * data.ptr.offsets and index into the gathered payload.
+ */
+struct binder_transaction_data_sg {
+	struct binder_transaction_data	transaction_data;
+	const struct binder_buffer_vec	*vecs;
+	size_t				vec_count;
+};
+
 struct binder_ptr_cookie {
 	void *ptr;
 	void *cookie;
@@ -324,6 +343,13 @@ enum BinderDriverCommandProtocol {
 	/*
 	 * void *: cookie
 	 */
+
+	BC_TRANSACTION_SG = _IOW('c', 17, struct binder_transaction_data_sg),
+	BC_REPLY_SG = _IOW('c', 18, struct binder_transaction_data_sg),
+	/*
+	 * binder_transaction_data_sg: the sent command, with the payload
+	 * described by a list of user buffers.
+	 */
 };
 
 #endif /* _LINUX_BINDER_H */
@@ -21,44 +21,66 @@
 #include <linux/module.h>
 #include <linux/fs.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/uaccess.h>
 #include <linux/poll.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
 #include <linux/time.h>
+#include <linux/timer.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
+#include <asm/shmparam.h>
 
 /*
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
  * This structure lives from module insertion until module removal, so it does
- * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * not need additional reference counting. The ring and the reader offsets are
+ * protected by the spinlock 'lock'. Nobody copies to or from user-space while
+ * holding it: writers gather their payload first and readers copy an entry
+ * out into a private buffer, so the lock is only held for a memcpy.
  */
 struct logger_log {
 	unsigned char 		*buffer;/* the ring buffer itself */
 	struct miscdevice	misc;	/* misc device representing the log */
 	wait_queue_head_t	wq;	/* wait queue for readers */
 	struct list_head	readers; /* this log's readers */
-	struct mutex		mutex;	/* mutex protecting buffer */
+	spinlock_t		lock;	/* lock protecting buffer */
 	size_t			w_off;	/* current write head offset */
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
+	__u32			written; /* total bytes written, wraps */
+	atomic_t		wake_pending; /* bytes written since wakeup */
+	unsigned int		wake_threshold; /* wake after this many */
+	unsigned long		wake_delay; /* or after this many jiffies */
+	struct timer_list	wake_timer; /* for wake_delay */
 };
 
 /*
  * struct logger_reader - a logging device open for reading
  *
  * This object lives from open to release, so we don't need additional
- * reference counting. The structure is protected by log->mutex.
+ * reference counting. r_off is protected by log->lock, 'mutex' serializes
+ * reads on the same file so that they can share 'buf'.
  */
 struct logger_reader {
 	struct logger_log	*log;	/* associated log */
 	struct list_head	list;	/* entry in logger_log's list */
 	size_t			r_off;	/* current read head offset */
+	struct mutex		mutex;	/* serializes reads */
+	unsigned char		*buf;	/* one entry, copied out of the ring */
 };
 
+/* writes with payloads up to this size need no allocation */
+#define LOGGER_STACK_PAYLOAD	256
+
+/* upper bound for LOGGER_SET_WAKE_DELAY, in milliseconds */
+#define LOGGER_MAX_WAKE_DELAY	1000
+
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
 #define logger_offset(n)	((n) & (log->size - 1))
 
@@ -89,7 +111,7 @@ static inline struct logger_log *file_get_log(struct file *file)
  * get_entry_len - Grabs the length of the payload of the next entry starting
  * from 'off'.
  *
- * Caller needs to hold log->mutex.
+ * Caller needs to hold log->lock.
  */
 static __u32 get_entry_len(struct logger_log *log, size_t off)
 {
@@ -108,71 +130,51 @@ static __u32 get_entry_len(struct logger_log *log, size_t off)
 }
 
 /*
- * do_read_log_to_user - reads exactly 'count' bytes from 'log' into the
- * user-space buffer 'buf'. Returns 'count' on success.
+ * do_read_log - copies exactly 'count' bytes at offset 'off' of 'log' into
+ * the kernel buffer 'buf'.
  *
- * Caller must hold log->mutex.
+ * Caller must hold log->lock.
  */
-static ssize_t do_read_log_to_user(struct logger_log *log,
-				   struct logger_reader *reader,
-				   char __user *buf,
-				   size_t count)
+static void do_read_log(struct logger_log *log, size_t off,
+			unsigned char *buf, size_t count)
 {
 	size_t len;
 
 	/*
 	 * We read from the log in two disjoint operations. First, we read from
-	 * the current read head offset up to 'count' bytes or to the end of
-	 * the log, whichever comes first.
+	 * 'off' up to 'count' bytes or to the end of the log, whichever comes
+	 * first.
 	 */
-	len = min(count, log->size - reader->r_off);
-	if (copy_to_user(buf, log->buffer + reader->r_off, len))
-		return -EFAULT;
+	len = min(count, log->size - off);
+	memcpy(buf, log->buffer + off, len);
 
 	/*
 	 * Second, we read any remaining bytes, starting back at the head of
 	 * the log.
 	 */
 	if (count != len)
-		if (copy_to_user(buf + len, log->buffer, count - len))
-			return -EFAULT;
-
-	reader->r_off = logger_offset(reader->r_off + count);
-
-	return count;
+		memcpy(buf + len, log->buffer, count - len);
 }
 
 /*
- * logger_read - our log's read() method
- *
- * Behavior:
- *
- * 	- O_NONBLOCK works
- * 	- If there are no log entries to read, blocks until log is written to
- * 	- Atomically reads exactly one log entry
- *
- * Optimal read size is LOGGER_ENTRY_MAX_LEN. Will set errno to EINVAL if read
- * buffer is insufficient to hold next entry.
+ * logger_wait - waits until there is an entry for 'reader', unless 'nonblock'
  */
-static ssize_t logger_read(struct file *file, char __user *buf,
-			   size_t count, loff_t *pos)
+static int logger_wait(struct logger_reader *reader, int nonblock)
 {
-	struct logger_reader *reader = file->private_data;
 	struct logger_log *log = reader->log;
-	ssize_t ret;
+	int ret;
 	DEFINE_WAIT(wait);
 
-start:
 	while (1) {
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		ret = (log->w_off == reader->r_off);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 		if (!ret)
 			break;
 
-		if (file->f_flags & O_NONBLOCK) {
+		if (nonblock) {
 			ret = -EAGAIN;
 			break;
 		}
@@ -186,29 +188,200 @@ start:
 	}
 
 	finish_wait(&log->wq, &wait);
+	return ret;
+}
+
+/*
+ * logger_read - our log's read() method
+ *
+ * Behavior:
+ *
+ * 	- O_NONBLOCK works
+ * 	- If there are no log entries to read, blocks until log is written to
+ * 	- Atomically reads exactly one log entry
+ *
+ * Optimal read size is LOGGER_ENTRY_MAX_LEN. Will set errno to EINVAL if read
+ * buffer is insufficient to hold next entry.
+ */
+static ssize_t logger_read(struct file *file, char __user *buf,
+			   size_t count, loff_t *pos)
+{
+	struct logger_reader *reader = file->private_data;
+	struct logger_log *log = reader->log;
+	size_t off;
+	ssize_t ret;
+
+start:
+	ret = logger_wait(reader, file->f_flags & O_NONBLOCK);
 	if (ret)
 		return ret;
 
-	mutex_lock(&log->mutex);
+	mutex_lock(&reader->mutex);
+	spin_lock(&log->lock);
 
 	/* is there still something to read or did we race? */
 	if (unlikely(log->w_off == reader->r_off)) {
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
+		mutex_unlock(&reader->mutex);
 		goto start;
 	}
 
 	/* get the size of the next entry */
-	ret = get_entry_len(log, reader->r_off);
+	off = reader->r_off;
+	ret = get_entry_len(log, off);
 	if (count < ret) {
+		spin_unlock(&log->lock);
 		ret = -EINVAL;
 		goto out;
 	}
 
 	/* get exactly one entry from the log */
-	ret = do_read_log_to_user(log, reader, buf, ret);
+	do_read_log(log, off, reader->buf, ret);
+	spin_unlock(&log->lock);
+
+	if (copy_to_user(buf, reader->buf, ret)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	/*
+	 * Only consume the entry if a writer did not lap us while we were
+	 * copying; fix_up_readers() has already moved r_off on in that case.
+	 */
+	spin_lock(&log->lock);
+	if (reader->r_off == off)
+		reader->r_off = logger_offset(off + ret);
+	spin_unlock(&log->lock);
 
 out:
-	mutex_unlock(&log->mutex);
+	mutex_unlock(&reader->mutex);
+
+	return ret;
+}
+
+static const struct pipe_buf_operations logger_pipe_buf_ops = {
+	.can_merge = 0,
+	.map = generic_pipe_buf_map,
+	.unmap = generic_pipe_buf_unmap,
+	.confirm = generic_pipe_buf_confirm,
+	.release = generic_pipe_buf_release,
+	.steal = generic_pipe_buf_steal,
+	.get = generic_pipe_buf_get,
+};
+
+static void logger_spd_release(struct splice_pipe_desc *spd, unsigned int i)
+{
+	put_page(spd->pages[i]);
+}
+
+/*
+ * logger_splice_read - our log's splice_read() method
+ *
+ * Moves as many whole entries as fit in 'len' into the pipe, a page of
+ * entries per pipe buffer, so that logcat can splice the log straight to a
+ * socket or to adb. Entries never straddle a page. Blocks like read() until
+ * there is at least one entry, and fails with EINVAL if 'len' can't hold it.
+ */
+static ssize_t logger_splice_read(struct file *file, loff_t *ppos,
+				  struct pipe_inode_info *pipe, size_t len,
+				  unsigned int flags)
+{
+	struct logger_reader *reader = file->private_data;
+	struct logger_log *log = reader->log;
+	struct page *pages[PIPE_DEF_BUFFERS];
+	struct partial_page partial[PIPE_DEF_BUFFERS];
+	struct splice_pipe_desc spd = {
+		.pages = pages,
+		.partial = partial,
+		.flags = flags,
+		.ops = &logger_pipe_buf_ops,
+		.spd_release = logger_spd_release,
+	};
+	size_t off, cur, entry, fill;
+	ssize_t ret;
+
+start:
+	ret = logger_wait(reader, (file->f_flags & O_NONBLOCK) ||
+				  (flags & SPLICE_F_NONBLOCK));
+	if (ret)
+		return ret;
+
+	mutex_lock(&reader->mutex);
+	spin_lock(&log->lock);
+
+	/* is there still something to read or did we race? */
+	if (unlikely(log->w_off == reader->r_off)) {
+		spin_unlock(&log->lock);
+		mutex_unlock(&reader->mutex);
+		goto start;
+	}
+
+	off = cur = reader->r_off;
+	if (len < get_entry_len(log, off)) {
+		spin_unlock(&log->lock);
+		ret = -EINVAL;
+		goto out;
+	}
+	spin_unlock(&log->lock);
+
+	/*
+	 * Fill the pages without consuming anything, the entries are only
+	 * consumed once the pipe has taken them. If a writer laps us in
+	 * between, fix_up_readers() moves r_off and we stop there.
+	 */
+	while (len && spd.nr_pages < PIPE_DEF_BUFFERS) {
+		struct page *page = alloc_page(GFP_KERNEL);
+
+		if (!page) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		fill = 0;
+		spin_lock(&log->lock);
+		while (reader->r_off == off && cur != log->w_off) {
+			entry = get_entry_len(log, cur);
+			if (fill + entry > min_t(size_t, len, PAGE_SIZE))
+				break;
+			do_read_log(log, cur, page_address(page) + fill,
+				    entry);
+			fill += entry;
+			cur = logger_offset(cur + entry);
+		}
+		spin_unlock(&log->lock);
+
+		if (!fill) {
+			put_page(page);
+			break;
+		}
+
+		pages[spd.nr_pages] = page;
+		partial[spd.nr_pages].offset = 0;
+		partial[spd.nr_pages].len = fill;
+		spd.nr_pages++;
+		len -= fill;
+	}
+
+	if (!spd.nr_pages) {
+		if (ret)
+			goto out;
+		/* lapped before we copied anything */
+		mutex_unlock(&reader->mutex);
+		goto start;
+	}
+
+	ret = splice_to_pipe(pipe, &spd);
+
+	/* the pipe takes whole pages, so whole entries are consumed */
+	if (ret > 0) {
+		spin_lock(&log->lock);
+		if (reader->r_off == off)
+			reader->r_off = logger_offset(off + ret);
+		spin_unlock(&log->lock);
+	}
+
+out:
+	mutex_unlock(&reader->mutex);
 
 	return ret;
 }
@@ -217,7 +390,7 @@ out:
  * get_next_entry - return the offset of the first valid entry at least 'len'
  * bytes after 'off'.
  *
- * Caller must hold log->mutex.
+ * Caller must hold log->lock.
  */
 static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
 {
@@ -255,7 +428,7 @@ static inline int clock_interval(size_t a, size_t b, size_t c)
  * We do this by "pulling forward" the readers and start head to the first
  * entry after the new write head.
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold log->lock.
  */
 static void fix_up_readers(struct logger_log *log, size_t len)
 {
@@ -274,7 +447,7 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 /*
  * do_write_log - writes 'len' bytes from 'buf' to 'log'
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold log->lock.
  */
 static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 {
@@ -291,41 +464,48 @@ static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 }
 
 /*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
- *
- * The caller needs to hold log->mutex.
- *
- * Returns 'count' on success, negative error code on failure.
+ * logger_wake_readers - account 'count' freshly written bytes and wake the
+ * readers, either right away or, if a wakeup threshold is set, once enough
+ * bytes have accumulated or wake_delay has passed.
  */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
+static void logger_wake_readers(struct logger_log *log, size_t count)
 {
-	size_t len;
+	unsigned int threshold = log->wake_threshold;
 
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
+	if (!threshold ||
+	    atomic_add_return(count, &log->wake_pending) >= threshold) {
+		atomic_set(&log->wake_pending, 0);
+		wake_up_interruptible(&log->wq);
+		return;
+	}
 
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
-			return -EFAULT;
+	if (!timer_pending(&log->wake_timer))
+		mod_timer(&log->wake_timer, jiffies + log->wake_delay);
+}
 
-	log->w_off = logger_offset(log->w_off + count);
+static void logger_wake_timer_fn(unsigned long data)
+{
+	struct logger_log *log = (struct logger_log *) data;
 
-	return count;
+	atomic_set(&log->wake_pending, 0);
+	wake_up_interruptible(&log->wq);
 }
 
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
  * them above all else.
+ *
+ * The payload is gathered from user-space before log->lock is taken, on the
+ * stack for the common short entry, so that concurrent writers only contend
+ * for the few microseconds it takes to memcpy an entry into the ring.
  */
 ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
+	unsigned char stack_payload[LOGGER_STACK_PAYLOAD];
+	unsigned char *payload = stack_payload;
 	struct logger_entry header;
 	struct timespec now;
 	ssize_t ret = 0;
@@ -342,41 +522,47 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
+	if (header.len > sizeof(stack_payload)) {
+		payload = kmalloc(header.len, GFP_KERNEL);
+		if (!payload)
+			return -ENOMEM;
+	}
 
-	while (nr_segs-- > 0) {
+	while (nr_segs-- > 0 && ret < header.len) {
 		size_t len;
-		ssize_t nr;
 
 		/* figure out how much of this vector we can keep */
 		len = min_t(size_t, iov->iov_len, header.len - ret);
 
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
+		if (copy_from_user(payload + ret, iov->iov_base, len)) {
+			ret = -EFAULT;
+			goto out;
 		}
 
 		iov++;
-		ret += nr;
+		ret += len;
 	}
 
-	mutex_unlock(&log->mutex);
+	spin_lock(&log->lock);
+
+	/*
+	 * Fix up any readers, pulling them forward to the first readable
+	 * entry after (what will be) the new write offset.
+	 */
+	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
+
+	do_write_log(log, &header, sizeof(struct logger_entry));
+	do_write_log(log, payload, header.len);
+	log->written += sizeof(struct logger_entry) + header.len;
+
+	spin_unlock(&log->lock);
 
 	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
+	logger_wake_readers(log, sizeof(struct logger_entry) + header.len);
+
+out:
+	if (payload != stack_payload)
+		kfree(payload);
 
 	return ret;
 }
@@ -408,13 +594,20 @@ static int logger_open(struct inode *inode, struct file *file)
 		if (!reader)
 			return -ENOMEM;
 
+		reader->buf = kmalloc(LOGGER_ENTRY_MAX_LEN, GFP_KERNEL);
+		if (!reader->buf) {
+			kfree(reader);
+			return -ENOMEM;
+		}
+
 		reader->log = log;
 		INIT_LIST_HEAD(&reader->list);
+		mutex_init(&reader->mutex);
 
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		reader->r_off = log->head;
 		list_add_tail(&reader->list, &log->readers);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 
 		file->private_data = reader;
 	} else
@@ -432,7 +625,12 @@ static int logger_release(struct inode *ignored, struct file *file)
 {
 	if (file->f_mode & FMODE_READ) {
 		struct logger_reader *reader = file->private_data;
+		struct logger_log *log = reader->log;
+
+		spin_lock(&log->lock);
 		list_del(&reader->list);
+		spin_unlock(&log->lock);
+		kfree(reader->buf);
 		kfree(reader);
 	}
 
@@ -462,21 +660,71 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 
 	poll_wait(file, &log->wq, wait);
 
-	mutex_lock(&log->mutex);
+	spin_lock(&log->lock);
 	if (log->w_off != reader->r_off)
 		ret |= POLLIN | POLLRDNORM;
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
 	return ret;
 }
 
+/*
+ * logger_mmap - the log's mmap file operation
+ *
+ * Readers may map the whole ring read-only and parse entries in place,
+ * using LOGGER_GET_OFFSETS to find where valid entries start and end and to
+ * detect being lapped by writers while parsing. The buffer is aligned to
+ * SHMLBA and only shared mappings are allowed, so on aliasing VIPT caches
+ * the user mapping gets the same cache colour as the kernel one.
+ */
+static int logger_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct logger_log *log = file_get_log(file);
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+	if (vma->vm_pgoff || size != log->size)
+		return -EINVAL;
+	if ((vma->vm_flags & VM_WRITE) || !(vma->vm_flags & VM_SHARED))
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND;
+
+	return remap_pfn_range(vma, vma->vm_start,
+			       virt_to_phys(log->buffer) >> PAGE_SHIFT,
+			       size, vma->vm_page_prot);
+}
+
+static long logger_get_offsets(struct logger_log *log, void __user *argp)
+{
+	struct logger_offsets offsets;
+
+	spin_lock(&log->lock);
+	offsets.head = log->head;
+	offsets.w_off = log->w_off;
+	offsets.written = log->written;
+	spin_unlock(&log->lock);
+
+	if (copy_to_user(argp, &offsets, sizeof(offsets)))
+		return -EFAULT;
+	return 0;
+}
+
 static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct logger_log *log = file_get_log(file);
 	struct logger_reader *reader;
 	long ret = -ENOTTY;
 
-	mutex_lock(&log->mutex);
+	if (cmd == LOGGER_GET_OFFSETS) {
+		if (!(file->f_mode & FMODE_READ))
+			return -EBADF;
+		return logger_get_offsets(log, (void __user *) arg);
+	}
+
+	spin_lock(&log->lock);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -514,9 +762,33 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		log->head = log->w_off;
 		ret = 0;
 		break;
+	case LOGGER_SET_WAKE_THRESHOLD:
+		if (!(file->f_mode & FMODE_WRITE)) {
+			ret = -EBADF;
+			break;
+		}
+		if (arg > log->size / 2) {
+			ret = -EINVAL;
+			break;
+		}
+		log->wake_threshold = arg;
+		ret = 0;
+		break;
+	case LOGGER_SET_WAKE_DELAY:
+		if (!(file->f_mode & FMODE_WRITE)) {
+			ret = -EBADF;
+			break;
+		}
+		if (arg > LOGGER_MAX_WAKE_DELAY) {
+			ret = -EINVAL;
+			break;
+		}
+		log->wake_delay = msecs_to_jiffies(arg);
+		ret = 0;
+		break;
 	}
 
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
 	return ret;
 }
@@ -524,10 +796,12 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 static const struct file_operations logger_fops = {
 	.owner = THIS_MODULE,
 	.read = logger_read,
+	.splice_read = logger_splice_read,
 	.aio_write = logger_aio_write,
 	.poll = logger_poll,
 	.unlocked_ioctl = logger_ioctl,
 	.compat_ioctl = logger_ioctl,
+	.mmap = logger_mmap,
 	.open = logger_open,
 	.release = logger_release,
 };
@@ -535,10 +809,11 @@ static const struct file_operations logger_fops = {
 /*
  * Defines a log structure with name 'NAME' and a size of 'SIZE' bytes, which
  * must be a power of two, greater than LOGGER_ENTRY_MAX_LEN, and less than
- * LONG_MAX minus LOGGER_ENTRY_MAX_LEN.
+ * LONG_MAX minus LOGGER_ENTRY_MAX_LEN. It must also be a multiple of
+ * PAGE_SIZE so the ring can be mapped by readers.
  */
 #define DEFINE_LOGGER_DEVICE(VAR, NAME, SIZE) \
-static unsigned char _buf_ ## VAR[SIZE]; \
+static unsigned char _buf_ ## VAR[SIZE] __aligned(SHMLBA); \
 static struct logger_log VAR = { \
 	.buffer = _buf_ ## VAR, \
 	.misc = { \
@@ -549,10 +824,16 @@ static struct logger_log VAR = { \
 	}, \
 	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .wq), \
 	.readers = LIST_HEAD_INIT(VAR .readers), \
-	.mutex = __MUTEX_INITIALIZER(VAR .mutex), \
+	.lock = __SPIN_LOCK_UNLOCKED(VAR .lock), \
 	.w_off = 0, \
 	.head = 0, \
 	.size = SIZE, \
+	.written = 0, \
+	.wake_pending = ATOMIC_INIT(0), \
+	.wake_threshold = 0, \
+	.wake_delay = 0, \
+	.wake_timer = TIMER_INITIALIZER(logger_wake_timer_fn, 0, \
+				       (unsigned long) &VAR), \
 };
 
 DEFINE_LOGGER_DEVICE(log_main, LOGGER_LOG_MAIN, 32*1024)
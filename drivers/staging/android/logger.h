@@ -30,6 +30,20 @@ struct logger_entry {
 	char		msg[0];	/* the entry's payload */
 };
 
+/*
+ * struct logger_offsets - returned by LOGGER_GET_OFFSETS
+ *
+ * Valid entries in an mmap()ed log start at 'head' and end at 'w_off'.
+ * 'written' counts all bytes ever written and wraps; if it advanced by more
+ * than the distance from the reader's position to the end of the ring while
+ * the reader was parsing, the parsed entries may have been overwritten.
+ */
+struct logger_offsets {
+	__u32		head;	/* oldest valid entry */
+	__u32		w_off;	/* next entry will be written here */
+	__u32		written; /* total bytes written */
+};
+
 #define LOGGER_LOG_RADIO	"log_radio"	/* radio-related messages */
 #define LOGGER_LOG_EVENTS	"log_events"	/* system/hardware events */
 #define LOGGER_LOG_SYSTEM	"log_system"	/* system/framework messages */
@@ -45,5 +59,8 @@ struct logger_entry {
 #define LOGGER_GET_LOG_LEN		_IO(__LOGGERIO, 2) /* used log len */
 #define LOGGER_GET_NEXT_ENTRY_LEN	_IO(__LOGGERIO, 3) /* next entry len */
 #define LOGGER_FLUSH_LOG		_IO(__LOGGERIO, 4) /* flush log */
+#define LOGGER_SET_WAKE_THRESHOLD	_IO(__LOGGERIO, 5) /* batch wakeups */
+#define LOGGER_SET_WAKE_DELAY		_IO(__LOGGERIO, 6) /* max delay, ms */
+#define LOGGER_GET_OFFSETS		_IOR(__LOGGERIO, 7, struct logger_offsets)
 
 #endif /* _LINUX_LOGGER_H */
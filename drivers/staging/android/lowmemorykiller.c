@@ -40,6 +40,9 @@
 #include <linux/mutex.h>
 #include <linux/delay.h>
 #include <linux/swap.h>
+#include <linux/fs.h>
+#include <linux/ashmem.h>
+#include <linux/memcontrol.h>
 
 #ifdef CONFIG_HIGHMEM
 #define _ZONE ZONE_HIGHMEM
@@ -67,9 +70,26 @@ static int lowmem_minfree[6] = {
 };
 static int lowmem_minfree_size = 4;
 static int lmk_fast_run = 1;
+/*
+ * When set, correct other_file for memory that NR_FILE_PAGES - NR_SHMEM
+ * gets wrong: swap cache pages (anonymous, and with zram already backed
+ * by compressed RAM) are not counted as cheaply reclaimable, while
+ * unpinned ashmem ranges, which the ashmem shrinker can purge, are.
+ */
+static int lmk_account_swap = 0;
+/*
+ * When set, size a candidate by the usage of its memory cgroup if that is
+ * larger than its RSS. With one cgroup per app this counts the page cache
+ * and the other processes the app keeps around, not just the one mm.
+ */
+static int lmk_memcg = 1;
 
+static struct task_struct *lowmem_deathpending;
 static unsigned long lowmem_deathpending_timeout;
 
+/* stale RSS estimates tolerated before giving up on this pass */
+#define LOWMEM_PICK_RETRIES	4
+
 #define lowmem_print(level, x...)			\
 	do {						\
 		if (lowmem_debug_level >= (level))	\
@@ -150,9 +170,7 @@ void tune_lmk_zone_param(struct zonelist *zonelist, int classzone_idx,
 	}
 }
 
-static struct task_struct *pick_next_from_adj_tree(struct task_struct *task);
-static struct task_struct *pick_first_task(void);
-static struct task_struct *pick_last_task(void);
+static struct task_struct *pick_first_task(int min_adj, int *oom_adj);
 
 void tune_lmk_param(int *other_free, int *other_file, gfp_t gfp_mask)
 {
@@ -200,6 +218,22 @@ void tune_lmk_param(int *other_free, int *other_file, gfp_t gfp_mask)
 	}
 }
 
+static void lowmem_account_swap(int *other_file)
+{
+	unsigned long swapcache = total_swapcache_pages;
+	unsigned long unpinned = min(ashmem_unpinned_pages(),
+				     global_page_state(NR_SHMEM));
+
+	if (*other_file > swapcache)
+		*other_file -= swapcache;
+	else
+		*other_file = 0;
+	*other_file += unpinned;
+
+	lowmem_print(4, "lowmem_shrink swapcache %lu, ashmem unpinned %lu, "
+		     "ofile %d\n", swapcache, unpinned, *other_file);
+}
+
 static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 {
 	struct task_struct *tsk;
@@ -213,13 +247,22 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 	int array_size = ARRAY_SIZE(lowmem_adj);
 	int other_free;
 	int other_file;
-	
+	int retries = LOWMEM_PICK_RETRIES;
+
 	tsk = current->group_leader;
 	if ((tsk->flags & PF_EXITING) && test_task_flag(tsk, TIF_MEMDIE)) {
 		set_tsk_thread_flag(current, TIF_MEMDIE);
 		return 0;
 	}
-	
+
+	/*
+	 * A victim is already on its way out: don't go looking for another
+	 * one until it has exited or the death-pending timeout expires.
+	 */
+	if (nr_to_scan > 0 && lowmem_deathpending &&
+	    time_before_eq(jiffies, lowmem_deathpending_timeout))
+		return 0;
+
 	if (nr_to_scan > 0) {
 		if (mutex_lock_interruptible(&scan_mutex) < 0)
 			return 0;
@@ -228,6 +271,8 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 	other_free = global_page_state(NR_FREE_PAGES);
 	other_file = global_page_state(NR_FILE_PAGES) -
 						global_page_state(NR_SHMEM);
+	if (lmk_account_swap)
+		lowmem_account_swap(&other_file);
 
 	tune_lmk_param(&other_free, &other_file, gfp_mask);
 
@@ -259,84 +304,53 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 
 		return rem;
 	}
-	selected_oom_adj = min_adj;
 
-	rcu_read_lock();
-	for (tsk = pick_first_task();
-		tsk != pick_last_task();
-		tsk = pick_next_from_adj_tree(tsk)) {
+	/*
+	 * Take the biggest cached RSS from the highest populated bucket,
+	 * then confirm it against the real mm.  Only the candidate pays
+	 * for task_lock; a stale estimate is refreshed and we retry.
+	 */
+	while (!selected && retries--) {
 		struct task_struct *p;
-		int oom_adj;
-
-		if (tsk->flags & PF_KTHREAD)
-			continue;
 
-		/* if task no longer has any memory ignore it */
-		if (test_task_flag(tsk, TIF_MM_RELEASED))
-			continue;
-
-		if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			if (test_task_flag(tsk, TIF_MEMDIE)) {
-				rcu_read_unlock();
-				/* give the system time to free up the memory */
-				if (!same_thread_group(current, tsk))
-					msleep_interruptible(20);
-				else
-					set_tsk_thread_flag(current, TIF_MEMDIE);
-				mutex_unlock(&scan_mutex);
-				return 0;
-			}
-		}
+		tsk = pick_first_task(min_adj, &selected_oom_adj);
+		if (!tsk)
+			break;
 
 		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
-
-		oom_adj = p->signal->oom_adj;
-		if (oom_adj < min_adj) {
-			task_unlock(p);
-			break;
-		}
-		
-		
-		if (fatal_signal_pending(p) ||
-			((p->flags & PF_EXITING) &&
-			test_tsk_thread_flag(p, TIF_MEMDIE))) {
-			lowmem_print(2, "skip slow dying process %d\n", p->pid);
-			task_unlock(p);
+		if (!p) {
+			tsk->adj_rss = 0;
+			put_task_struct(tsk);
 			continue;
 		}
-		
 		tasksize = get_mm_rss(p->mm);
+		if (lmk_memcg)
+			tasksize = max_t(unsigned long, tasksize,
+					 mem_cgroup_mm_usage(p->mm));
 		task_unlock(p);
-		if (tasksize <= 0)
+		tsk->adj_rss = tasksize;
+		if (tasksize <= 0) {
+			put_task_struct(tsk);
 			continue;
-		if (selected) {
-			if (oom_adj < selected_oom_adj)
-				break;
-			if (oom_adj == selected_oom_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
 		}
-		selected = p;
+		selected = tsk;
 		selected_tasksize = tasksize;
-		selected_oom_adj = oom_adj;
 		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_adj, tasksize);
+			     tsk->pid, tsk->comm, selected_oom_adj, tasksize);
 	}
 	if (selected) {
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
 			     selected->pid, selected->comm,
 			     selected_oom_adj, selected_tasksize);
+		lowmem_deathpending = selected;
 		lowmem_deathpending_timeout = jiffies + HZ;
 		send_sig(SIGKILL, selected, 0);
 		set_tsk_thread_flag(selected, TIF_MEMDIE);
 		rem -= selected_tasksize;
-		rcu_read_unlock();
+		put_task_struct(selected);
 		/* give the system time to free up the memory */
 		msleep_interruptible(20);
-	} else
-		rcu_read_unlock();
+	}
 
 	lowmem_print(4, "lowmem_shrink %d, %x, return %d\n",
 		     nr_to_scan, gfp_mask, rem);
@@ -360,79 +374,89 @@ static void __exit lowmem_exit(void)
 	unregister_shrinker(&lowmem_shrinker);
 }
 
-DEFINE_SPINLOCK(lmk_lock);
-struct rb_root tasksadj = RB_ROOT;
-void add_2_adj_tree(struct task_struct *task)
-{		struct rb_node **link = &tasksadj.rb_node;
-struct rb_node *parent = NULL;
-struct task_struct *task_entry;
-s64 key = task->signal->oom_adj;
 /*
- * Find the right place in the rbtree:
+ * Thread group leaders are kept on one list per oom_adj value, so that
+ * finding the highest populated adj level is a fixed-size scan and the
+ * shrinker never has to walk tasks below the level it is killing at.
+ * Each leader carries an RSS estimate (adj_rss) refreshed at fork, exec,
+ * oom_adj writes and whenever the shrinker looks at it.
  */
-spin_lock(&lmk_lock);
-while (*link) {
-	parent = *link;
-	task_entry = rb_entry(parent, struct task_struct, adj_node);
-	if (key < task_entry->signal->oom_adj)
-		link = &parent->rb_right;
-	else
-		link = &parent->rb_left;
-}
+#define LOWMEM_ADJ_BUCKETS	(OOM_ADJUST_MAX - OOM_DISABLE + 1)
 
-rb_link_node(&task->adj_node, parent, link);
-rb_insert_color(&task->adj_node, &tasksadj);
-spin_unlock(&lmk_lock);
-}
+static DEFINE_SPINLOCK(lmk_lock);
+static struct list_head lmk_buckets[LOWMEM_ADJ_BUCKETS];
 
-void delete_from_adj_tree(struct task_struct *task)
+static struct list_head *lmk_bucket(int oom_adj)
 {
-	spin_lock(&lmk_lock);
-	rb_erase(&task->adj_node, &tasksadj);
-	spin_unlock(&lmk_lock);
+	struct list_head *head;
+
+	oom_adj = clamp(oom_adj, OOM_DISABLE, OOM_ADJUST_MAX);
+	head = &lmk_buckets[oom_adj - OOM_DISABLE];
+	/* buckets are zero-initialised; lmk_lock covers the lazy init */
+	if (unlikely(!head->next))
+		INIT_LIST_HEAD(head);
+	return head;
 }
 
-
-static struct task_struct *pick_next_from_adj_tree(struct task_struct *task)
+/* (re)queue @task on the bucket matching its current oom_adj */
+void add_2_adj_tree(struct task_struct *task)
 {
-	struct rb_node *next;
-	
+	struct list_head *head;
+
 	spin_lock(&lmk_lock);
-	next = rb_next(&task->adj_node);
+	head = lmk_bucket(task->signal->oom_adj);
+	if (!list_empty(&task->adj_node))
+		list_del(&task->adj_node);
+	list_add(&task->adj_node, head);
 	spin_unlock(&lmk_lock);
-	
-	if (!next)
-		return NULL;
-	
-	return rb_entry(next, struct task_struct, adj_node);
 }
 
-static struct task_struct *pick_first_task(void)
+void delete_from_adj_tree(struct task_struct *task)
 {
-	struct rb_node *left;
-	
 	spin_lock(&lmk_lock);
-	left = rb_first(&tasksadj);
+	list_del_init(&task->adj_node);
+	if (lowmem_deathpending == task)
+		lowmem_deathpending = NULL;
 	spin_unlock(&lmk_lock);
-	
-	if (!left)
-		return NULL;
-	
-	return rb_entry(left, struct task_struct, adj_node);
 }
 
-static struct task_struct *pick_last_task(void)
+/*
+ * Return the killable leader with the largest RSS estimate, at the
+ * highest populated adj level not below @min_adj, with a reference held.
+ */
+static struct task_struct *pick_first_task(int min_adj, int *oom_adj)
 {
-	struct rb_node *right;
-	
+	struct task_struct *task, *best = NULL;
+	struct list_head *head;
+	int adj;
+
+	if (min_adj > OOM_ADJUST_MAX)
+		return NULL;
+	if (min_adj < OOM_DISABLE)
+		min_adj = OOM_DISABLE;
+
 	spin_lock(&lmk_lock);
-	right = rb_last(&tasksadj);
+	for (adj = OOM_ADJUST_MAX; adj >= min_adj && !best; adj--) {
+		head = lmk_bucket(adj);
+		list_for_each_entry(task, head, adj_node) {
+			if (task->flags & PF_KTHREAD)
+				continue;
+			/* if task no longer has any memory ignore it */
+			if (test_tsk_thread_flag(task, TIF_MM_RELEASED) ||
+			    fatal_signal_pending(task) ||
+			    test_tsk_thread_flag(task, TIF_MEMDIE))
+				continue;
+			if (!best || task->adj_rss > best->adj_rss)
+				best = task;
+		}
+		if (best)
+			*oom_adj = adj;
+	}
+	if (best)
+		get_task_struct(best);
 	spin_unlock(&lmk_lock);
-	
-	if (!right)
-		return NULL;
-	
-	return rb_entry(right, struct task_struct, adj_node);
+
+	return best;
 }
 
 module_param_named(cost, lowmem_shrinker.seeks, int, S_IRUGO | S_IWUSR);
@@ -442,6 +466,9 @@ module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
 module_param_named(lmk_fast_run, lmk_fast_run, int, S_IRUGO | S_IWUSR);
+module_param_named(lmk_account_swap, lmk_account_swap, int,
+		   S_IRUGO | S_IWUSR);
+module_param_named(lmk_memcg, lmk_memcg, int, S_IRUGO | S_IWUSR);
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
@@ -24,6 +24,10 @@
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 #include <linux/rslib.h>
+#include <linux/notifier.h>
+#include <linux/reboot.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
 #endif
 
 struct ram_console_buffer {
@@ -54,6 +58,32 @@ static int ram_console_bad_blocks;
 #define ECC_SIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_ECC_SIZE
 #define ECC_SYMSIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_SYMBOL_SIZE
 #define ECC_POLY CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_POLYNOMIAL
+
+/*
+ * Parity is not computed on the printk path. ram_console_write() only
+ * copies the text and records here which bytes have stale parity; the
+ * blocks are encoded later by ram_console_flush_ecc(), from a deferrable
+ * timer, at panic and at reboot. The record lives after the header parity
+ * and is updated before the text it covers, so after a crash at any point
+ * the next boot knows which blocks (and whether the header) must not be
+ * "corrected" with old parity.
+ */
+struct ram_console_ecc_state {
+	uint32_t    sig;
+	uint32_t    start;	/* first byte with stale parity */
+	uint32_t    pending;	/* bytes with stale parity, header too if != 0 */
+};
+
+#define RAM_CONSOLE_ECC_SIG (0x43434544) /* DECC */
+#define RAM_CONSOLE_ECC_FLUSH_INTERVAL	(HZ)
+
+static struct ram_console_ecc_state *ram_console_ecc_state;
+static int ram_console_unchecked_blocks;
+static size_t ram_console_stale_first;
+static size_t ram_console_stale_blocks;
+static void ram_console_ecc_work_fn(struct work_struct *work);
+static DECLARE_WORK(ram_console_ecc_work, ram_console_ecc_work_fn);
+static struct timer_list ram_console_ecc_timer;
 #endif
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
@@ -79,39 +109,111 @@ static int ram_console_decode_rs8(void *data, size_t len, uint8_t *ecc)
 }
 #endif
 
-static void ram_console_update(const char *s, unsigned int count)
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+static void ram_console_encode_blocks(size_t start, size_t count)
 {
 	struct ram_console_buffer *buffer = ram_console_buffer;
-#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 	uint8_t *buffer_end = buffer->data + ram_console_buffer_size;
 	uint8_t *block;
 	uint8_t *par;
 	int size = ECC_BLOCK_SIZE;
-#endif
-	memcpy(buffer->data + buffer->start, s, count);
-#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	block = buffer->data + (buffer->start & ~(ECC_BLOCK_SIZE - 1));
-	par = ram_console_par_buffer +
-	      (buffer->start / ECC_BLOCK_SIZE) * ECC_SIZE;
+
+	block = buffer->data + (start & ~(ECC_BLOCK_SIZE - 1));
+	par = ram_console_par_buffer + (start / ECC_BLOCK_SIZE) * ECC_SIZE;
 	do {
 		if (block + ECC_BLOCK_SIZE > buffer_end)
 			size = buffer_end - block;
 		ram_console_encode_rs8(block, size, par);
 		block += ECC_BLOCK_SIZE;
 		par += ECC_SIZE;
-	} while (block < buffer->data + buffer->start + count);
-#endif
+	} while (block < buffer->data + start + count);
 }
 
-static void ram_console_update_header(void)
+/* Called with the console semaphore held, or from panic */
+static void ram_console_flush_ecc(void)
 {
-#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	struct ram_console_ecc_state *state = ram_console_ecc_state;
 	struct ram_console_buffer *buffer = ram_console_buffer;
+	size_t start = state->start;
+	size_t pending = state->pending;
+	size_t rem;
 	uint8_t *par;
+
+	if (!pending)
+		return;
+
+	/* start == size means the next write wraps */
+	if (start >= ram_console_buffer_size)
+		start = 0;
+	rem = ram_console_buffer_size - start;
+	if (pending > rem) {
+		ram_console_encode_blocks(start, rem);
+		start = 0;
+		pending -= rem;
+	}
+	ram_console_encode_blocks(start, pending);
+
 	par = ram_console_par_buffer +
 	      DIV_ROUND_UP(ram_console_buffer_size, ECC_BLOCK_SIZE) * ECC_SIZE;
 	ram_console_encode_rs8((uint8_t *)buffer, sizeof(*buffer), par);
+
+	/* Parity must be complete before the record says so */
+	barrier();
+	state->start = buffer->start;
+	barrier();
+	state->pending = 0;
+}
+
+static void ram_console_ecc_work_fn(struct work_struct *work)
+{
+	acquire_console_sem();
+	ram_console_flush_ecc();
+	release_console_sem();
+}
+
+static void ram_console_ecc_timer_fn(unsigned long data)
+{
+	/*
+	 * The write path never arms anything, a printk from inside the timer
+	 * or workqueue code must not recurse into them.
+	 */
+	if (ram_console_ecc_state->pending)
+		schedule_work(&ram_console_ecc_work);
+	mod_timer(&ram_console_ecc_timer,
+		  jiffies + RAM_CONSOLE_ECC_FLUSH_INTERVAL);
+}
+
+static int ram_console_ecc_panic(struct notifier_block *nb,
+				 unsigned long event, void *unused)
+{
+	/* The console semaphore may be held by whoever panicked */
+	ram_console_flush_ecc();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ram_console_ecc_panic_nb = {
+	.notifier_call	= ram_console_ecc_panic,
+	.priority	= INT_MIN,
+};
+
+static int ram_console_ecc_reboot(struct notifier_block *nb,
+				  unsigned long event, void *unused)
+{
+	del_timer_sync(&ram_console_ecc_timer);
+	ram_console_ecc_work_fn(NULL);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ram_console_ecc_reboot_nb = {
+	.notifier_call	= ram_console_ecc_reboot,
+	.priority	= INT_MIN,
+};
 #endif
+
+static void ram_console_update(const char *s, unsigned int count)
+{
+	struct ram_console_buffer *buffer = ram_console_buffer;
+	memcpy(buffer->data + buffer->start, s, count);
 }
 
 static void
@@ -119,11 +221,20 @@ ram_console_write(struct console *console, const char *s, unsigned int count)
 {
 	int rem;
 	struct ram_console_buffer *buffer = ram_console_buffer;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	struct ram_console_ecc_state *state = ram_console_ecc_state;
+#endif
 
 	if (count > ram_console_buffer_size) {
 		s += count - ram_console_buffer_size;
 		count = ram_console_buffer_size;
 	}
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	/* Mark the parity stale before the text and header change under it */
+	state->pending = min_t(size_t, state->pending + count,
+			       ram_console_buffer_size);
+	barrier();
+#endif
 	rem = ram_console_buffer_size - buffer->start;
 	if (rem < count) {
 		ram_console_update(s, rem);
@@ -137,7 +248,6 @@ ram_console_write(struct console *console, const char *s, unsigned int count)
 	buffer->start += count;
 	if (buffer->size < ram_console_buffer_size)
 		buffer->size += count;
-	ram_console_update_header();
 }
 
 static struct console ram_console = {
@@ -155,6 +265,52 @@ void ram_console_enable_console(int enabled)
 		ram_console.flags &= ~CON_ENABLED;
 }
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+static int __init ram_console_block_stale(size_t offset)
+{
+	size_t nblocks = DIV_ROUND_UP(ram_console_buffer_size, ECC_BLOCK_SIZE);
+	size_t i = offset / ECC_BLOCK_SIZE;
+
+	return (i + nblocks - ram_console_stale_first) % nblocks <
+		ram_console_stale_blocks;
+}
+
+/*
+ * Work out from the previous boot's record which blocks were written after
+ * their parity. Returns nonzero if the header was as well.
+ */
+static int __init ram_console_ecc_state_init(void)
+{
+	struct ram_console_ecc_state *state = ram_console_ecc_state;
+	size_t nblocks = DIV_ROUND_UP(ram_console_buffer_size, ECC_BLOCK_SIZE);
+	int dirty = 0;
+
+	if (state->sig == RAM_CONSOLE_ECC_SIG &&
+	    state->start < ram_console_buffer_size &&
+	    state->pending <= ram_console_buffer_size) {
+		if (state->pending) {
+			ram_console_stale_first = state->start / ECC_BLOCK_SIZE;
+			/* One extra for a partial last block */
+			ram_console_stale_blocks = min(nblocks,
+				DIV_ROUND_UP(state->start % ECC_BLOCK_SIZE +
+					     state->pending, ECC_BLOCK_SIZE) + 1);
+			dirty = 1;
+		}
+	} else if (state->sig == RAM_CONSOLE_ECC_SIG) {
+		/* Can't tell what is stale, decode nothing */
+		ram_console_stale_blocks = nblocks;
+		dirty = 1;
+	}
+
+	/* Nothing is covered until the first flush */
+	state->start = 0;
+	state->pending = ram_console_buffer_size;
+	barrier();
+	state->sig = RAM_CONSOLE_ECC_SIG;
+	return dirty;
+}
+#endif
+
 static void __init
 ram_console_save_old(struct ram_console_buffer *buffer, char *dest)
 {
@@ -172,6 +328,13 @@ ram_console_save_old(struct ram_console_buffer *buffer, char *dest)
 		int size = ECC_BLOCK_SIZE;
 		if (block + size > buffer->data + ram_console_buffer_size)
 			size = buffer->data + ram_console_buffer_size - block;
+		if (ram_console_block_stale(block - buffer->data)) {
+			/* Parity predates the text, it would only undo it */
+			ram_console_unchecked_blocks++;
+			block += ECC_BLOCK_SIZE;
+			par += ECC_SIZE;
+			continue;
+		}
 		numerr = ram_console_decode_rs8(block, size, par);
 		if (numerr > 0) {
 #if 0
@@ -189,10 +352,13 @@ ram_console_save_old(struct ram_console_buffer *buffer, char *dest)
 		block += ECC_BLOCK_SIZE;
 		par += ECC_SIZE;
 	}
-	if (ram_console_corrected_bytes || ram_console_bad_blocks)
+	if (ram_console_corrected_bytes || ram_console_bad_blocks ||
+	    ram_console_unchecked_blocks)
 		strbuf_len = snprintf(strbuf, sizeof(strbuf),
-			"\n%d Corrected bytes, %d unrecoverable blocks\n",
-			ram_console_corrected_bytes, ram_console_bad_blocks);
+			"\n%d Corrected bytes, %d unrecoverable blocks, "
+			"%d unchecked blocks\n",
+			ram_console_corrected_bytes, ram_console_bad_blocks,
+			ram_console_unchecked_blocks);
 	else
 		strbuf_len = snprintf(strbuf, sizeof(strbuf),
 				      "\nNo errors detected\n");
@@ -242,7 +408,8 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 	ram_console_buffer_size -= (DIV_ROUND_UP(ram_console_buffer_size,
-						ECC_BLOCK_SIZE) + 1) * ECC_SIZE;
+						ECC_BLOCK_SIZE) + 1) * ECC_SIZE +
+				   sizeof(struct ram_console_ecc_state);
 
 	if (ram_console_buffer_size > buffer_size) {
 		pr_err("ram_console: buffer %p, invalid size %zu, "
@@ -252,7 +419,10 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 	}
 
 	ram_console_par_buffer = buffer->data + ram_console_buffer_size;
-
+	ram_console_ecc_state = (struct ram_console_ecc_state *)
+		(ram_console_par_buffer +
+		 (DIV_ROUND_UP(ram_console_buffer_size, ECC_BLOCK_SIZE) + 1) *
+		 ECC_SIZE);
 
 	/* first consecutive root is 0
 	 * primitive element to generate roots = 1
@@ -269,7 +439,12 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 	par = ram_console_par_buffer +
 	      DIV_ROUND_UP(ram_console_buffer_size, ECC_BLOCK_SIZE) * ECC_SIZE;
 
-	numerr = ram_console_decode_rs8(buffer, sizeof(*buffer), par);
+	numerr = 0;
+	if (ram_console_ecc_state_init())
+		printk(KERN_INFO "ram_console: header written after its "
+		       "parity, not checked\n");
+	else
+		numerr = ram_console_decode_rs8(buffer, sizeof(*buffer), par);
 	if (numerr > 0) {
 		printk(KERN_INFO "ram_console: error in header, %d\n", numerr);
 		ram_console_corrected_bytes += numerr;
@@ -301,6 +476,17 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 	buffer->start = 0;
 	buffer->size = 0;
 	buffer->is_busy = 0;//ZTE_BOOT_HUANGYANJUN_20110228_01
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	ram_console_flush_ecc();
+
+	init_timer_deferrable(&ram_console_ecc_timer);
+	ram_console_ecc_timer.function = ram_console_ecc_timer_fn;
+	mod_timer(&ram_console_ecc_timer,
+		  jiffies + RAM_CONSOLE_ECC_FLUSH_INTERVAL);
+	atomic_notifier_chain_register(&panic_notifier_list,
+				       &ram_console_ecc_panic_nb);
+	register_reboot_notifier(&ram_console_ecc_reboot_nb);
+#endif
 
 	register_console(&ram_console);
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ENABLE_VERBOSE
@@ -8,12 +8,16 @@
  * and, thus indirectly, for cleancache and frontswap.  Zcache includes two
  * page-accessible memory [1] interfaces, both utilizing lzo1x compression:
  * 1) "compression buddies" ("zbud") is used for ephemeral pages
- * 2) xvmalloc is used for persistent pages.
- * Xvmalloc (based on the TLSF allocator) has very low fragmentation
- * so maximizes space efficiency, while zbud allows pairs (and potentially,
- * in the future, more than a pair of) compressed pages to be closely linked
- * so that reclaiming can be done via the kernel's physical-page-oriented
- * "shrinker" interface.
+ * 2) zsmalloc is used for persistent pages.
+ * Zsmalloc has very low fragmentation so maximizes space efficiency,
+ * while zbud allows pairs (and potentially, in the future, more than a
+ * pair of) compressed pages to be closely linked so that reclaiming can
+ * be done via the kernel's physical-page-oriented "shrinker" interface.
+ *
+ * Both kinds of pages share one budget of page frames (max_pages in
+ * sysfs).  Swap pages get priority: a frontswap put that finds the budget
+ * used up first evicts clean pagecache pages, while a cleancache put that
+ * finds it used up simply fails.
  *
  * [1] For a definition of page-accessible memory (aka PAM), see:
  *   http://marc.info/?l=linux-mm&m=127811271605009
@@ -29,7 +33,7 @@
 #include <asm/atomic.h>
 #include "tmem.h"
 
-#include "../ramzswap/sub-projects/allocators/xvmalloc-kmod/xvmalloc.h" /* if built in drivers/staging */
+#include "../zsmalloc/zsmalloc.h"
 
 #if (!defined(CONFIG_CLEANCACHE) && !defined(CONFIG_FRONTSWAP))
 #error "zcache is useless without CONFIG_CLEANCACHE or CONFIG_FRONTSWAP"
@@ -585,12 +589,12 @@ static int zbud_show_cumul_chunk_counts(char *buf)
 #endif
 
 /**********
- * This "zv" PAM implementation combines the TLSF-based xvMalloc
- * with lzo1x compression to maximize the amount of data that can
- * be packed into a physical page.
+ * This "zv" PAM implementation combines zsmalloc with lzo1x compression
+ * to maximize the amount of data that can be packed into a physical page.
  *
  * Zv represents a PAM page with the index and object (plus a "size" value
  * necessary for decompression) immediately preceding the compressed data.
+ * The pampd is the zsmalloc handle, not a pointer.
  */
 
 #define ZVH_SENTINEL  0x43214321
@@ -599,68 +603,60 @@ struct zv_hdr {
 	uint32_t pool_id;
 	struct tmem_oid oid;
 	uint32_t index;
+	uint16_t size;
 	DECL_SENTINEL
 };
 
 static const int zv_max_page_size = (PAGE_SIZE / 8) * 7;
 
-static struct zv_hdr *zv_create(struct xv_pool *xvpool, uint32_t pool_id,
+static unsigned long zv_create(struct zs_pool *zspool, uint32_t pool_id,
 				struct tmem_oid *oid, uint32_t index,
 				void *cdata, unsigned clen)
 {
-	struct page *page;
-	struct zv_hdr *zv = NULL;
-	uint32_t offset;
-	int ret;
+	struct zv_hdr *zv;
+	unsigned long handle;
 
 	BUG_ON(!irqs_disabled());
-	ret = xv_malloc(xvpool, clen + sizeof(struct zv_hdr),
-			&page, &offset, ZCACHE_GFP_MASK);
-	if (unlikely(ret))
+	handle = zs_malloc(zspool, clen + sizeof(struct zv_hdr));
+	if (unlikely(!handle))
 		goto out;
-	zv = kmap_atomic(page, KM_USER0) + offset;
+	zv = zs_map_object(zspool, handle, ZS_MM_WO);
 	zv->index = index;
 	zv->oid = *oid;
 	zv->pool_id = pool_id;
+	zv->size = clen;
 	SET_SENTINEL(zv, ZVH);
 	memcpy((char *)zv + sizeof(struct zv_hdr), cdata, clen);
-	kunmap_atomic(zv, KM_USER0);
+	zs_unmap_object(zspool, handle);
 out:
-	return zv;
+	return handle;
 }
 
-static void zv_free(struct xv_pool *xvpool, struct zv_hdr *zv)
+static void zv_free(struct zs_pool *zspool, unsigned long handle)
 {
 	unsigned long flags;
-	struct page *page;
-	uint32_t offset;
-	uint16_t size;
 
-	ASSERT_SENTINEL(zv, ZVH);
-	size = xv_get_object_size(zv) - sizeof(*zv);
-	BUG_ON(size == 0 || size > zv_max_page_size);
-	INVERT_SENTINEL(zv, ZVH);
-	page = virt_to_page(zv);
-	offset = (unsigned long)zv & ~PAGE_MASK;
 	local_irq_save(flags);
-	xv_free(xvpool, page, offset);
+	zs_free(zspool, handle);
 	local_irq_restore(flags);
 }
 
-static void zv_decompress(struct page *page, struct zv_hdr *zv)
+static void zv_decompress(struct page *page, struct zs_pool *zspool,
+				unsigned long handle)
 {
 	size_t clen = PAGE_SIZE;
+	struct zv_hdr *zv;
 	char *to_va;
-	unsigned size;
 	int ret;
 
+	zv = zs_map_object(zspool, handle, ZS_MM_RO);
 	ASSERT_SENTINEL(zv, ZVH);
-	size = xv_get_object_size(zv) - sizeof(*zv);
-	BUG_ON(size == 0 || size > zv_max_page_size);
-	to_va = kmap_atomic(page, KM_USER0);
+	BUG_ON(zv->size == 0 || zv->size > zv_max_page_size);
+	to_va = kmap_atomic(page, KM_USER1);
 	ret = lzo1x_decompress_safe((char *)zv + sizeof(*zv),
-					size, to_va, &clen);
-	kunmap_atomic(to_va, KM_USER0);
+					zv->size, to_va, &clen);
+	kunmap_atomic(to_va, KM_USER1);
+	zs_unmap_object(zspool, handle);
 	BUG_ON(ret != LZO_E_OK);
 	BUG_ON(clen != PAGE_SIZE);
 }
@@ -681,9 +677,32 @@ static unsigned long zcache_failed_pers_puts;
 
 static struct {
 	struct tmem_pool *tmem_pools[MAX_POOLS_PER_CLIENT];
-	struct xv_pool *xvpool;
+	struct zs_pool *zspool;
 } zcache_client;
 
+/*
+ * Page frames that ephemeral and persistent pages together may occupy.
+ * Set at init to 3/8 of RAM, roughly what the old limit of 3/4 of RAM
+ * worth of compressed swap pages amounted to.
+ */
+static unsigned long zcache_max_pages;
+static unsigned long zcache_budget_evicts;
+
+static unsigned long zcache_curr_pages(void)
+{
+	unsigned long pages = atomic_read(&zcache_zbud_curr_raw_pages);
+
+	if (zcache_client.zspool)
+		pages += zs_get_total_size_bytes(zcache_client.zspool) >>
+								PAGE_SHIFT;
+	return pages;
+}
+
+static inline bool zcache_over_budget(void)
+{
+	return zcache_curr_pages() >= zcache_max_pages;
+}
+
 /*
  * Tmem operations assume the poolid implies the invoking client.
  * Zcache only has one client (the kernel itself), so translate
@@ -910,6 +929,9 @@ static void *zcache_pampd_create(struct tmem_pool *pool, struct tmem_oid *oid,
 	unsigned long count;
 
 	if (ephemeral) {
+		/* clean pages never push out swap pages */
+		if (zcache_over_budget())
+			goto out;
 		ret = zcache_compress(page, &cdata, &clen);
 		if (ret == 0)
 
@@ -926,13 +948,8 @@ static void *zcache_pampd_create(struct tmem_pool *pool, struct tmem_oid *oid,
 				zcache_curr_eph_pampd_count_max = count;
 		}
 	} else {
-		/*
-		 * FIXME: This is all the "policy" there is for now.
-		 * 3/4 totpages should allow ~37% of RAM to be filled with
-		 * compressed frontswap pages
-		 */
-		if (atomic_read(&zcache_curr_pers_pampd_count) >
-							3 * totalram_pages / 4)
+		/* zcache_frontswap_put_page() already evicted what it could */
+		if (zcache_over_budget())
 			goto out;
 		ret = zcache_compress(page, &cdata, &clen);
 		if (ret == 0)
@@ -941,7 +958,7 @@ static void *zcache_pampd_create(struct tmem_pool *pool, struct tmem_oid *oid,
 			zcache_compress_poor++;
 			goto out;
 		}
-		pampd = (void *)zv_create(zcache_client.xvpool, pool->pool_id,
+		pampd = (void *)zv_create(zcache_client.zspool, pool->pool_id,
 						oid, index, cdata, clen);
 		if (pampd == NULL)
 			goto out;
@@ -965,7 +982,8 @@ static int zcache_pampd_get_data(struct page *page, void *pampd,
 	if (is_ephemeral(pool))
 		ret = zbud_decompress(page, pampd);
 	else
-		zv_decompress(page, pampd);
+		zv_decompress(page, zcache_client.zspool,
+				(unsigned long)pampd);
 	return ret;
 }
 
@@ -980,7 +998,7 @@ static void zcache_pampd_free(void *pampd, struct tmem_pool *pool)
 		atomic_dec(&zcache_curr_eph_pampd_count);
 		BUG_ON(atomic_read(&zcache_curr_eph_pampd_count) < 0);
 	} else {
-		zv_free(zcache_client.xvpool, (struct zv_hdr *)pampd);
+		zv_free(zcache_client.zspool, (unsigned long)pampd);
 		atomic_dec(&zcache_curr_pers_pampd_count);
 		BUG_ON(atomic_read(&zcache_curr_pers_pampd_count) < 0);
 	}
@@ -1121,6 +1139,7 @@ ZCACHE_SYSFS_RO(put_to_flush);
 ZCACHE_SYSFS_RO(aborted_preload);
 ZCACHE_SYSFS_RO(aborted_shrink);
 ZCACHE_SYSFS_RO(compress_poor);
+ZCACHE_SYSFS_RO(budget_evicts);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_raw_pages);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_zpages);
 ZCACHE_SYSFS_RO_ATOMIC(curr_obj_count);
@@ -1130,6 +1149,39 @@ ZCACHE_SYSFS_RO_CUSTOM(zbud_unbuddied_list_counts,
 ZCACHE_SYSFS_RO_CUSTOM(zbud_cumul_chunk_counts,
 			zbud_show_cumul_chunk_counts);
 
+static ssize_t zcache_curr_pages_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", zcache_curr_pages());
+}
+static struct kobj_attribute zcache_curr_pages_attr = {
+	.attr = { .name = "curr_pages", .mode = 0444 },
+	.show = zcache_curr_pages_show,
+};
+
+static ssize_t zcache_max_pages_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", zcache_max_pages);
+}
+
+static ssize_t zcache_max_pages_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val) || val > totalram_pages)
+		return -EINVAL;
+	zcache_max_pages = val;
+	return count;
+}
+static struct kobj_attribute zcache_max_pages_attr = {
+	.attr = { .name = "max_pages", .mode = 0644 },
+	.show = zcache_max_pages_show,
+	.store = zcache_max_pages_store,
+};
+
 static struct attribute *zcache_attrs[] = {
 	&zcache_curr_obj_count_attr.attr,
 	&zcache_curr_obj_count_max_attr.attr,
@@ -1159,6 +1211,9 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_aborted_shrink_attr.attr,
 	&zcache_zbud_unbuddied_list_counts_attr.attr,
 	&zcache_zbud_cumul_chunk_counts_attr.attr,
+	&zcache_budget_evicts_attr.attr,
+	&zcache_curr_pages_attr.attr,
+	&zcache_max_pages_attr.attr,
 	NULL,
 };
 
@@ -1362,23 +1417,30 @@ out:
  */
 
 #ifdef CONFIG_CLEANCACHE
-static void zcache_cleancache_put_page(int pool_id,
-					struct cleancache_filekey key,
+static inline struct tmem_oid zcache_ino_to_oid(ino_t ino)
+{
+	struct tmem_oid oid = { .oid = { 0 } };
+
+	oid.oid[0] = ino;
+	return oid;
+}
+
+static void zcache_cleancache_put_page(int pool_id, ino_t ino,
 					pgoff_t index, struct page *page)
 {
 	u32 ind = (u32) index;
-	struct tmem_oid oid = *(struct tmem_oid *)&key;
+	struct tmem_oid oid = zcache_ino_to_oid(ino);
 
+	/* called under the mapping's tree_lock, interrupts disabled */
 	if (likely(ind == index))
 		(void)zcache_put_page(pool_id, &oid, index, page);
 }
 
-static int zcache_cleancache_get_page(int pool_id,
-					struct cleancache_filekey key,
+static int zcache_cleancache_get_page(int pool_id, ino_t ino,
 					pgoff_t index, struct page *page)
 {
 	u32 ind = (u32) index;
-	struct tmem_oid oid = *(struct tmem_oid *)&key;
+	struct tmem_oid oid = zcache_ino_to_oid(ino);
 	int ret = -1;
 
 	if (likely(ind == index))
@@ -1386,21 +1448,19 @@ static int zcache_cleancache_get_page(int pool_id,
 	return ret;
 }
 
-static void zcache_cleancache_flush_page(int pool_id,
-					struct cleancache_filekey key,
+static void zcache_cleancache_flush_page(int pool_id, ino_t ino,
 					pgoff_t index)
 {
 	u32 ind = (u32) index;
-	struct tmem_oid oid = *(struct tmem_oid *)&key;
+	struct tmem_oid oid = zcache_ino_to_oid(ino);
 
 	if (likely(ind == index))
 		(void)zcache_flush_page(pool_id, &oid, ind);
 }
 
-static void zcache_cleancache_flush_inode(int pool_id,
-					struct cleancache_filekey key)
+static void zcache_cleancache_flush_inode(int pool_id, ino_t ino)
 {
-	struct tmem_oid oid = *(struct tmem_oid *)&key;
+	struct tmem_oid oid = zcache_ino_to_oid(ino);
 
 	(void)zcache_flush_object(pool_id, &oid);
 }
@@ -1413,8 +1473,6 @@ static void zcache_cleancache_flush_fs(int pool_id)
 
 static int zcache_cleancache_init_fs(size_t pagesize)
 {
-	BUG_ON(sizeof(struct cleancache_filekey) !=
-				sizeof(struct tmem_oid));
 	BUG_ON(pagesize != PAGE_SIZE);
 	return zcache_new_pool(0);
 }
@@ -1422,8 +1480,6 @@ static int zcache_cleancache_init_fs(size_t pagesize)
 static int zcache_cleancache_init_shared_fs(char *uuid, size_t pagesize)
 {
 	/* shared pools are unsupported and map to private */
-	BUG_ON(sizeof(struct cleancache_filekey) !=
-				sizeof(struct tmem_oid));
 	BUG_ON(pagesize != PAGE_SIZE);
 	return zcache_new_pool(0);
 }
@@ -1440,9 +1496,9 @@ static struct cleancache_ops zcache_cleancache_ops = {
 
 struct cleancache_ops zcache_cleancache_register_ops(void)
 {
-	struct cleancache_ops old_ops =
-		cleancache_register_ops(&zcache_cleancache_ops);
+	struct cleancache_ops old_ops = cleancache_ops;
 
+	cleancache_ops = zcache_cleancache_ops;
 	return old_ops;
 }
 #endif
@@ -1467,6 +1523,26 @@ static inline struct tmem_oid oswiz(unsigned type, u32 ind)
 	return oid;
 }
 
+/*
+ * Swap pages take precedence over clean pagecache pages: when the shared
+ * budget is used up, evict ephemeral pages to make room.  This has to be
+ * done before interrupts are disabled for the put.
+ */
+static void zcache_make_room(void)
+{
+	unsigned long curr = zcache_curr_pages();
+
+	if (curr < zcache_max_pages)
+		return;
+	if (!atomic_read(&zcache_zbud_curr_raw_pages))
+		return;
+	if (spin_trylock(&zcache_direct_reclaim_lock)) {
+		zbud_evict_pages(curr - zcache_max_pages + 1);
+		zcache_budget_evicts++;
+		spin_unlock(&zcache_direct_reclaim_lock);
+	}
+}
+
 static int zcache_frontswap_put_page(unsigned type, pgoff_t offset,
 				   struct page *page)
 {
@@ -1478,6 +1554,7 @@ static int zcache_frontswap_put_page(unsigned type, pgoff_t offset,
 
 	BUG_ON(!PageLocked(page));
 	if (likely(ind64 == ind)) {
+		zcache_make_room();
 		local_irq_save(flags);
 		ret = zcache_put_page(zcache_frontswap_poolid, &oid,
 					iswiz(ind), page);
@@ -1603,6 +1680,8 @@ static int __init zcache_init(void)
 	if (zcache_enabled) {
 		unsigned int cpu;
 
+		zcache_max_pages = totalram_pages * 3 / 8;
+		zbud_init();
 		tmem_register_hostops(&zcache_hostops);
 		tmem_register_pamops(&zcache_pamops);
 		ret = register_cpu_notifier(&zcache_cpu_notifier_block);
@@ -1625,7 +1704,6 @@ static int __init zcache_init(void)
 	if (zcache_enabled && use_cleancache) {
 		struct cleancache_ops old_ops;
 
-		zbud_init();
 		register_shrinker(&zcache_shrinker);
 		old_ops = zcache_cleancache_register_ops();
 		pr_info("zcache: cleancache enabled using kernel "
@@ -1638,14 +1716,15 @@ static int __init zcache_init(void)
 	if (zcache_enabled && use_frontswap) {
 		struct frontswap_ops old_ops;
 
-		zcache_client.xvpool = xv_create_pool();
-		if (zcache_client.xvpool == NULL) {
-			pr_err("zcache: can't create xvpool\n");
+		zcache_client.zspool = zs_create_pool("zcache",
+							ZCACHE_GFP_MASK);
+		if (zcache_client.zspool == NULL) {
+			pr_err("zcache: can't create zspool\n");
 			goto out;
 		}
 		old_ops = zcache_frontswap_register_ops();
 		pr_info("zcache: frontswap enabled using kernel "
-			"transcendent memory and xvmalloc\n");
+			"transcendent memory and zsmalloc\n");
 		if (old_ops.init != NULL)
 			pr_warning("ktmem: frontswap_ops overridden");
 	}
@@ -0,0 +1,278 @@
+/*
+ * Compressor backends for zram
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/lzo.h>
+#ifdef CONFIG_ZRAM_LZ4_COMPRESS
+#include <linux/lz4.h>
+#endif
+
+#include "zcomp.h"
+
+static void *zcomp_lzo_create(void)
+{
+	return kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+}
+
+static void zcomp_lzo_destroy(void *private)
+{
+	kfree(private);
+}
+
+static int zcomp_lzo_compress(const unsigned char *src, unsigned char *dst,
+		size_t *dst_len, void *private)
+{
+	int ret = lzo1x_1_compress(src, PAGE_SIZE, dst, dst_len, private);
+	return ret == LZO_E_OK ? 0 : ret;
+}
+
+static int zcomp_lzo_decompress(const unsigned char *src, size_t src_len,
+		unsigned char *dst)
+{
+	size_t dst_len = PAGE_SIZE;
+	int ret = lzo1x_decompress_safe(src, src_len, dst, &dst_len);
+	return ret == LZO_E_OK ? 0 : ret;
+}
+
+static const struct zcomp_backend zcomp_lzo = {
+	.compress = zcomp_lzo_compress,
+	.decompress = zcomp_lzo_decompress,
+	.create = zcomp_lzo_create,
+	.destroy = zcomp_lzo_destroy,
+	.name = "lzo",
+};
+
+#ifdef CONFIG_ZRAM_LZ4_COMPRESS
+static void *zcomp_lz4_create(void)
+{
+	return kzalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+}
+
+static void zcomp_lz4_destroy(void *private)
+{
+	kfree(private);
+}
+
+static int zcomp_lz4_compress(const unsigned char *src, unsigned char *dst,
+		size_t *dst_len, void *private)
+{
+	return lz4_compress(src, PAGE_SIZE, dst, dst_len, private);
+}
+
+static int zcomp_lz4_decompress(const unsigned char *src, size_t src_len,
+		unsigned char *dst)
+{
+	size_t dst_len = PAGE_SIZE;
+	return lz4_decompress_unknownoutputsize(src, src_len, dst, &dst_len);
+}
+
+static const struct zcomp_backend zcomp_lz4 = {
+	.compress = zcomp_lz4_compress,
+	.decompress = zcomp_lz4_decompress,
+	.create = zcomp_lz4_create,
+	.destroy = zcomp_lz4_destroy,
+	.name = "lz4",
+};
+#endif
+
+/* the first entry is the default */
+static const struct zcomp_backend *backends[] = {
+	&zcomp_lzo,
+#ifdef CONFIG_ZRAM_LZ4_COMPRESS
+	&zcomp_lz4,
+#endif
+	NULL
+};
+
+/* look up a backend by name, NULL selects the default */
+const struct zcomp_backend *zcomp_find_backend(const char *name)
+{
+	int i;
+
+	if (!name)
+		return backends[0];
+
+	for (i = 0; backends[i]; i++)
+		if (sysfs_streq(name, backends[i]->name))
+			return backends[i];
+	return NULL;
+}
+
+/* list the backends, the one in use in brackets */
+ssize_t zcomp_available_show(const struct zcomp_backend *comp, char *buf)
+{
+	ssize_t sz = 0;
+	int i;
+
+	for (i = 0; backends[i]; i++) {
+		if (backends[i] == comp)
+			sz += sprintf(buf + sz, "[%s] ", backends[i]->name);
+		else
+			sz += sprintf(buf + sz, "%s ", backends[i]->name);
+	}
+	sz += sprintf(buf + sz, "\n");
+	return sz;
+}
+
+static void zcomp_strm_free(struct zcomp *comp, struct zcomp_strm *zstrm)
+{
+	if (zstrm->private)
+		comp->backend->destroy(zstrm->private);
+	free_pages((unsigned long)zstrm->buffer, 1);
+	kfree(zstrm);
+}
+
+static struct zcomp_strm *zcomp_strm_alloc(struct zcomp *comp)
+{
+	struct zcomp_strm *zstrm = kmalloc(sizeof(*zstrm), GFP_KERNEL);
+	if (!zstrm)
+		return NULL;
+
+	zstrm->private = comp->backend->create();
+	/*
+	 * allocate 2 pages. 1 for compressed data, plus 1 extra for the
+	 * case when compressed size is larger than the original one
+	 */
+	zstrm->buffer = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+	if (!zstrm->private || !zstrm->buffer) {
+		zcomp_strm_free(comp, zstrm);
+		return NULL;
+	}
+	return zstrm;
+}
+
+/*
+ * Grow or shrink the pool to @num_strm streams.  Idle streams over the
+ * limit are freed now, busy ones when they are released.  Fails only if
+ * the pool ends up with no stream at all.
+ */
+int zcomp_set_max_streams(struct zcomp *comp, int num_strm)
+{
+	struct zcomp_strm *zstrm;
+	LIST_HEAD(victims);
+
+	if (num_strm < 1)
+		return -EINVAL;
+
+	spin_lock(&comp->strm_lock);
+	comp->max_strm = num_strm;
+	while (comp->avail_strm > num_strm &&
+			!list_empty(&comp->idle_strm)) {
+		zstrm = list_first_entry(&comp->idle_strm,
+				struct zcomp_strm, list);
+		list_move(&zstrm->list, &victims);
+		comp->avail_strm--;
+	}
+
+	while (comp->avail_strm < comp->max_strm) {
+		/* count it now so a racing resize does not overshoot */
+		comp->avail_strm++;
+		spin_unlock(&comp->strm_lock);
+		zstrm = zcomp_strm_alloc(comp);
+		spin_lock(&comp->strm_lock);
+		if (!zstrm) {
+			comp->avail_strm--;
+			break;
+		}
+		list_add(&zstrm->list, &comp->idle_strm);
+		wake_up(&comp->strm_wait);
+	}
+	num_strm = comp->avail_strm;
+	spin_unlock(&comp->strm_lock);
+
+	while (!list_empty(&victims)) {
+		zstrm = list_first_entry(&victims, struct zcomp_strm, list);
+		list_del(&zstrm->list);
+		zcomp_strm_free(comp, zstrm);
+	}
+
+	return num_strm ? 0 : -ENOMEM;
+}
+
+/* get an idle stream, sleeping until one is released if necessary */
+struct zcomp_strm *zcomp_strm_find(struct zcomp *comp)
+{
+	struct zcomp_strm *zstrm;
+
+	spin_lock(&comp->strm_lock);
+	while (list_empty(&comp->idle_strm)) {
+		spin_unlock(&comp->strm_lock);
+		wait_event(comp->strm_wait, !list_empty(&comp->idle_strm));
+		spin_lock(&comp->strm_lock);
+	}
+	zstrm = list_first_entry(&comp->idle_strm, struct zcomp_strm, list);
+	list_del(&zstrm->list);
+	spin_unlock(&comp->strm_lock);
+
+	return zstrm;
+}
+
+void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm)
+{
+	spin_lock(&comp->strm_lock);
+	if (comp->avail_strm <= comp->max_strm) {
+		list_add(&zstrm->list, &comp->idle_strm);
+		spin_unlock(&comp->strm_lock);
+		wake_up(&comp->strm_wait);
+		return;
+	}
+	comp->avail_strm--;
+	spin_unlock(&comp->strm_lock);
+	zcomp_strm_free(comp, zstrm);
+}
+
+int zcomp_compress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t *dst_len)
+{
+	return comp->backend->compress(src, zstrm->buffer, dst_len,
+			zstrm->private);
+}
+
+int zcomp_decompress(struct zcomp *comp, const unsigned char *src,
+		size_t src_len, unsigned char *dst)
+{
+	return comp->backend->decompress(src, src_len, dst);
+}
+
+/* all streams must be idle */
+void zcomp_destroy(struct zcomp *comp)
+{
+	struct zcomp_strm *zstrm;
+
+	while (!list_empty(&comp->idle_strm)) {
+		zstrm = list_first_entry(&comp->idle_strm,
+				struct zcomp_strm, list);
+		list_del(&zstrm->list);
+		zcomp_strm_free(comp, zstrm);
+	}
+	kfree(comp);
+}
+
+struct zcomp *zcomp_create(const struct zcomp_backend *backend, int max_strm)
+{
+	struct zcomp *comp = kzalloc(sizeof(*comp), GFP_KERNEL);
+	if (!comp)
+		return NULL;
+
+	comp->backend = backend;
+	spin_lock_init(&comp->strm_lock);
+	INIT_LIST_HEAD(&comp->idle_strm);
+	init_waitqueue_head(&comp->strm_wait);
+
+	if (zcomp_set_max_streams(comp, max_strm)) {
+		zcomp_destroy(comp);
+		return NULL;
+	}
+	return comp;
+}
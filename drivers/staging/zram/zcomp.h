@@ -0,0 +1,74 @@
+/*
+ * Compressor backends for zram
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZCOMP_H_
+#define _ZCOMP_H_
+
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+
+/*
+ * A compressor usable by zram.  compress() always compresses exactly one
+ * page and may need up to two pages at dst; decompress() must reproduce
+ * the page into dst and fail on corrupt input rather than overrun.
+ * Per-device scratch memory comes from create() and goes to compress().
+ */
+struct zcomp_backend {
+	int (*compress)(const unsigned char *src, unsigned char *dst,
+			size_t *dst_len, void *private);
+
+	int (*decompress)(const unsigned char *src, size_t src_len,
+				unsigned char *dst);
+
+	void *(*create)(void);
+	void (*destroy)(void *private);
+
+	const char *name;
+};
+
+/* one compression context: backend scratch memory and output buffer */
+struct zcomp_strm {
+	void *buffer;	/* two pages */
+	void *private;
+	struct list_head list;
+};
+
+/*
+ * Pool of compression streams so that concurrent writers compress in
+ * parallel.  Streams are only ever allocated from process context in
+ * zcomp_create() and zcomp_set_max_streams(); the I/O path waits for an
+ * idle one instead of allocating.
+ */
+struct zcomp {
+	const struct zcomp_backend *backend;
+	spinlock_t strm_lock;		/* protects the fields below */
+	struct list_head idle_strm;
+	wait_queue_head_t strm_wait;
+	int avail_strm;			/* streams allocated, idle or busy */
+	int max_strm;
+};
+
+const struct zcomp_backend *zcomp_find_backend(const char *name);
+ssize_t zcomp_available_show(const struct zcomp_backend *comp, char *buf);
+
+struct zcomp *zcomp_create(const struct zcomp_backend *backend, int max_strm);
+void zcomp_destroy(struct zcomp *comp);
+int zcomp_set_max_streams(struct zcomp *comp, int num_strm);
+
+struct zcomp_strm *zcomp_strm_find(struct zcomp *comp);
+void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm);
+
+int zcomp_compress(struct zcomp *comp, struct zcomp_strm *zstrm,
+		const unsigned char *src, size_t *dst_len);
+int zcomp_decompress(struct zcomp *comp, const unsigned char *src,
+		size_t src_len, unsigned char *dst);
+
+#endif /* _ZCOMP_H_ */
@@ -23,16 +23,17 @@
 #include <linux/kernel.h>
 #include <linux/bio.h>
 #include <linux/bitops.h>
+#include <linux/completion.h>
 #include <linux/blkdev.h>
 #include <linux/buffer_head.h>
 #include <linux/device.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 #include <linux/ratelimit.h>
+#include <linux/swap.h>
 
 #include "zram_drv.h"
 
@@ -114,6 +115,14 @@ static ssize_t zero_pages_show(struct device *dev,
 	return sprintf(buf, "%u\n", zram->stats.pages_zero);
 }
 
+static ssize_t same_pages_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%u\n", zram->stats.pages_same);
+}
+
 static ssize_t orig_data_size_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -147,6 +156,103 @@ static ssize_t mem_used_total_show(struct device *dev,
 	return sprintf(buf, "%llu\n", val);
 }
 
+static ssize_t swap_cost_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%u\n", zram->disk->queue->swap_cost);
+}
+
+static ssize_t swap_cost_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int ret;
+	unsigned long cost;
+	struct zram *zram = dev_to_zram(dev);
+
+	ret = strict_strtoul(buf, 10, &cost);
+	if (ret)
+		return ret;
+	if (cost < 1 || cost > 1000)
+		return -EINVAL;
+
+	blk_queue_swap_cost(zram->disk->queue, cost);
+	swap_update_cost();
+
+	return len;
+}
+
+static ssize_t comp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	ssize_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->comp, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t comp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	const struct zcomp_backend *comp;
+	struct zram *zram = dev_to_zram(dev);
+
+	comp = zcomp_find_backend(buf);
+	if (!comp)
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+	zram->comp = comp;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t max_comp_streams_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%d\n", zram->max_comp_streams);
+}
+
+static ssize_t max_comp_streams_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int ret = 0;
+	unsigned long num;
+	struct zram *zram = dev_to_zram(dev);
+
+	ret = strict_strtoul(buf, 10, &num);
+	if (ret)
+		return ret;
+	if (num < 1 || num > INT_MAX)
+		return -EINVAL;
+
+	/*
+	 * Only a read lock: streams are allocated with GFP_KERNEL, which
+	 * may end up writing to this very device.
+	 */
+	down_read(&zram->init_lock);
+	if (zram->init_done)
+		ret = zcomp_set_max_streams(zram->meta->comp, num);
+	if (!ret)
+		zram->max_comp_streams = num;
+	up_read(&zram->init_lock);
+
+	return ret ? ret : len;
+}
+
 static int zram_test_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
 {
@@ -165,6 +271,219 @@ static void zram_clear_flag(struct zram_meta *meta, u32 index,
 	meta->table[index].flags &= ~BIT(flag);
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static void zram_reset_bdev(struct zram *zram)
+{
+	if (!zram->bdev)
+		return;
+
+	close_bdev_exclusive(zram->bdev, FMODE_READ | FMODE_WRITE);
+	zram->bdev = NULL;
+	kfree(zram->bitmap);
+	zram->bitmap = NULL;
+	kfree(zram->backing_dev);
+	zram->backing_dev = NULL;
+	zram->nr_pages = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	ssize_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = sprintf(buf, "%s\n",
+			zram->backing_dev ? zram->backing_dev : "none");
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int ret = 0;
+	char *path;
+	struct block_device *bdev;
+	unsigned long nr_pages, *bitmap;
+	struct zram *zram = dev_to_zram(dev);
+
+	path = kstrdup(buf, GFP_KERNEL);
+	if (!path)
+		return -ENOMEM;
+	if (len && path[len - 1] == '\n')
+		path[len - 1] = '\0';
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		pr_info("Can't setup backing device for initialized device\n");
+		ret = -EBUSY;
+		goto out;
+	}
+
+	zram_reset_bdev(zram);
+	if (!strcmp(path, "none"))
+		goto out;
+
+	bdev = open_bdev_exclusive(path, FMODE_READ | FMODE_WRITE, zram);
+	if (IS_ERR(bdev)) {
+		ret = PTR_ERR(bdev);
+		goto out;
+	}
+
+	nr_pages = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	bitmap = kzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long), GFP_KERNEL);
+	if (nr_pages < 2 || !bitmap) {
+		kfree(bitmap);
+		close_bdev_exclusive(bdev, FMODE_READ | FMODE_WRITE);
+		ret = nr_pages < 2 ? -EINVAL : -ENOMEM;
+		goto out;
+	}
+	/* block 0 is never handed out, so 0 can mean "no block" */
+	set_bit(0, bitmap);
+
+	zram->bdev = bdev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	zram->backing_dev = path;
+	path = NULL;
+	pr_info("setup backing device %s\n", zram->backing_dev);
+out:
+	up_write(&zram->init_lock);
+	kfree(path);
+
+	return ret ? ret : len;
+}
+
+static unsigned long zram_alloc_block(struct zram *zram)
+{
+	unsigned long blk;
+
+retry:
+	blk = find_next_zero_bit(zram->bitmap, zram->nr_pages, 1);
+	if (blk >= zram->nr_pages)
+		return 0;
+	if (test_and_set_bit(blk, zram->bitmap))
+		goto retry;
+
+	atomic64_inc(&zram->stats.bd_count);
+	return blk;
+}
+
+static void zram_free_block(struct zram *zram, unsigned long blk)
+{
+	WARN_ON_ONCE(!test_and_clear_bit(blk, zram->bitmap));
+	atomic64_dec(&zram->stats.bd_count);
+}
+
+static void zram_bdev_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+/* synchronous, so never to be called from zram_make_request() itself */
+static int zram_bdev_rw_page(struct zram *zram, struct page *page,
+			unsigned long blk, int rw)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_bdev = zram->bdev;
+	bio->bi_end_io = zram_bdev_end_io;
+	bio->bi_private = &done;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	submit_bio(rw, bio);
+	wait_for_completion(&done);
+	ret = test_bit(BIO_UPTODATE, &bio->bi_flags) ? 0 : -EIO;
+	bio_put(bio);
+
+	if (!ret)
+		atomic64_inc(rw == READ ? &zram->stats.bd_reads :
+					&zram->stats.bd_writes);
+	return ret;
+}
+
+struct zram_read_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct page *page;
+	unsigned long blk;
+	int ret;
+};
+
+static void zram_read_work_fn(struct work_struct *work)
+{
+	struct zram_read_work *rw =
+		container_of(work, struct zram_read_work, work);
+
+	rw->ret = zram_bdev_rw_page(rw->zram, rw->page, rw->blk, READ);
+}
+
+/*
+ * We are called from zram_make_request(), where any bio we submit is only
+ * queued on current->bio_list until we return, so waiting for it would
+ * hang.  Issue the read from a worker and wait for that instead.
+ */
+static int zram_read_from_bdev(struct zram *zram, char *mem,
+			unsigned long blk)
+{
+	struct zram_read_work work;
+	void *src;
+
+	work.page = alloc_page(GFP_NOIO);
+	if (!work.page)
+		return -ENOMEM;
+	work.zram = zram;
+	work.blk = blk;
+
+	INIT_WORK_ON_STACK(&work.work, zram_read_work_fn);
+	schedule_work(&work.work);
+	flush_work(&work.work);
+	destroy_work_on_stack(&work.work);
+
+	if (!work.ret) {
+		src = kmap_atomic(work.page, KM_USER0);
+		copy_page(mem, src);
+		kunmap_atomic(src, KM_USER0);
+	}
+	__free_page(work.page);
+
+	return work.ret;
+}
+
+static inline void zram_touch(struct zram_meta *meta, u32 index)
+{
+	meta->table[index].ac_time = jiffies;
+}
+
+static void zram_schedule_wb(struct zram *zram)
+{
+	if (zram->bdev)
+		schedule_work(&zram->wb_work);
+}
+#else
+static inline void zram_reset_bdev(struct zram *zram) { }
+static inline void zram_free_block(struct zram *zram, unsigned long blk) { }
+static inline int zram_read_from_bdev(struct zram *zram, char *mem,
+			unsigned long blk)
+{
+	return -EIO;
+}
+static inline void zram_touch(struct zram_meta *meta, u32 index) { }
+static inline void zram_schedule_wb(struct zram *zram) { }
+#endif
+
 static inline int is_partial_io(struct bio_vec *bvec)
 {
 	return bvec->bv_len != PAGE_SIZE;
@@ -197,39 +516,34 @@ static inline int valid_io_request(struct zram *zram, struct bio *bio)
 static void zram_meta_free(struct zram_meta *meta)
 {
 	zs_destroy_pool(meta->mem_pool);
-	kfree(meta->compress_workmem);
-	free_pages((unsigned long)meta->compress_buffer, 1);
+	zcomp_destroy(meta->comp);
 	vfree(meta->table);
 	kfree(meta);
 }
 
-static struct zram_meta *zram_meta_alloc(u64 disksize)
+static struct zram_meta *zram_meta_alloc(const char *pool_name, u64 disksize,
+		const struct zcomp_backend *backend, int max_comp_streams)
 {
 	size_t num_pages;
 	struct zram_meta *meta = kmalloc(sizeof(*meta), GFP_KERNEL);
 	if (!meta)
 		goto out;
 
-	meta->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!meta->compress_workmem)
+	meta->comp = zcomp_create(backend, max_comp_streams);
+	if (!meta->comp) {
+		pr_err("Error allocating compression streams\n");
 		goto free_meta;
-
-	meta->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!meta->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		goto free_workmem;
 	}
 
 	num_pages = disksize >> PAGE_SHIFT;
 	meta->table = vmalloc(num_pages * sizeof(*meta->table));
 	if (!meta->table) {
 		pr_err("Error allocating zram address table\n");
-		goto free_buffer;
+		goto free_comp;
 	}
 	memset(meta->table, 0, num_pages * sizeof(*meta->table));
 
-	meta->mem_pool = zs_create_pool(GFP_NOIO | __GFP_HIGHMEM |
+	meta->mem_pool = zs_create_pool(pool_name, GFP_NOIO | __GFP_HIGHMEM |
 					__GFP_NOWARN);
 	if (!meta->mem_pool) {
 		pr_err("Error creating memory pool\n");
@@ -240,10 +554,8 @@ static struct zram_meta *zram_meta_alloc(u64 disksize)
 
 free_table:
 	vfree(meta->table);
-free_buffer:
-	free_pages((unsigned long)meta->compress_buffer, 1);
-free_workmem:
-	kfree(meta->compress_workmem);
+free_comp:
+	zcomp_destroy(meta->comp);
 free_meta:
 	kfree(meta);
 	meta = NULL;
@@ -258,31 +570,59 @@ static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 	*offset = (*offset + bvec->bv_len) % PAGE_SIZE;
 }
 
-static int page_zero_filled(void *ptr)
+/*
+ * A page made of one repeated word (zeros being the common case, but
+ * memset() patterns are frequent in swapped-out heaps too) is kept as
+ * that word alone.  The last word is checked first so that ordinary pages
+ * usually bail out after two loads.
+ */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
-	unsigned int pos;
-	unsigned long *page;
+	unsigned int pos, last_pos = PAGE_SIZE / sizeof(unsigned long) - 1;
+	unsigned long *page = (unsigned long *)ptr;
+	unsigned long val = page[0];
 
-	page = (unsigned long *)ptr;
+	if (val != page[last_pos])
+		return 0;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos < last_pos; pos++) {
+		if (page[pos] != val)
 			return 0;
 	}
 
+	*element = val;
 	return 1;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void zram_fill_page(void *ptr, unsigned long len,
+			unsigned long value)
+{
+	unsigned long *page = (unsigned long *)ptr;
+	unsigned long pos;
+
+	if (!value) {
+		memset(ptr, 0, len);
+		return;
+	}
+
+	for (pos = 0; pos < len / sizeof(*page); pos++)
+		page[pos] = value;
+}
+
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
+	/* bv_offset and bv_len are sector multiples, so word aligned */
 	user_mem = kmap_atomic(page, KM_USER0);
 	if (is_partial_io(bvec))
-		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
-	else
+		zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len,
+				element);
+	else if (!element)
 		clear_page(user_mem);
+	else
+		zram_fill_page(user_mem, PAGE_SIZE, element);
 	kunmap_atomic(user_mem, KM_USER0);
 
 	flush_dcache_page(page);
@@ -294,18 +634,29 @@ static void zram_free_page(struct zram *zram, size_t index)
 	unsigned long handle = meta->table[index].handle;
 	u16 size = meta->table[index].size;
 
-	if (unlikely(!handle)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(meta, index, ZRAM_ZERO)) {
-			zram_clear_flag(meta, index, ZRAM_ZERO);
+	/*
+	 * No memory is allocated for same filled pages.
+	 * Simply clear same page flag.
+	 */
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		if (!meta->table[index].element)
 			zram->stats.pages_zero--;
-		}
+		zram->stats.pages_same--;
+		meta->table[index].element = 0;
 		return;
 	}
 
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		zram_free_block(zram, meta->table[index].element);
+		meta->table[index].element = 0;
+		return;
+	}
+
+	if (unlikely(!handle))
+		return;
+
 	if (unlikely(size > max_zpage_size))
 		zram->stats.bad_compress--;
 
@@ -319,17 +670,33 @@ static void zram_free_page(struct zram *zram, size_t index)
 
 	meta->table[index].handle = 0;
 	meta->table[index].size = 0;
+	zram_clear_flag(meta, index, ZRAM_HUGE);
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
 }
 
 static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 {
-	int ret = LZO_E_OK;
-	size_t clen = PAGE_SIZE;
+	int ret = 0;
 	unsigned char *cmem;
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
 
-	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_fill_page(mem, PAGE_SIZE, meta->table[index].element);
+		return 0;
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		ret = zram_read_from_bdev(zram, mem, meta->table[index].element);
+		if (unlikely(ret)) {
+			pr_err("Backing device read failed! err=%d, page=%u\n",
+				ret, index);
+			atomic64_inc(&zram->stats.failed_reads);
+		}
+		return ret;
+	}
+
+	if (!handle) {
 		clear_page(mem);
 		return 0;
 	}
@@ -338,12 +705,12 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	if (meta->table[index].size == PAGE_SIZE)
 		copy_page(mem, cmem);
 	else
-		ret = lzo1x_decompress_safe(cmem, meta->table[index].size,
-						mem, &clen);
+		ret = zcomp_decompress(meta->comp, cmem,
+				meta->table[index].size, mem);
 	zs_unmap_object(meta->mem_pool, handle);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		atomic64_inc(&zram->stats.failed_reads);
 		return ret;
@@ -361,12 +728,35 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	struct zram_meta *meta = zram->meta;
 	page = bvec->bv_page;
 
-	if (unlikely(!meta->table[index].handle) ||
-			zram_test_flag(meta, index, ZRAM_ZERO)) {
-		handle_zero_page(bvec);
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		handle_same_page(bvec, meta->table[index].element);
+		return 0;
+	}
+
+	if (unlikely(!meta->table[index].handle)) {
+		handle_same_page(bvec, 0);
 		return 0;
 	}
 
+	zram_touch(meta, index);
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		/* the read sleeps, so not into a kmap_atomic()ed page */
+		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
+		if (!uncmem)
+			return -ENOMEM;
+		ret = zram_decompress_page(zram, uncmem, index);
+		if (!ret) {
+			user_mem = kmap_atomic(page, KM_USER0);
+			memcpy(user_mem + bvec->bv_offset, uncmem + offset,
+					bvec->bv_len);
+			kunmap_atomic(user_mem, KM_USER0);
+			flush_dcache_page(page);
+		}
+		kfree(uncmem);
+		return ret;
+	}
+
 	if (is_partial_io(bvec))
 		/* Use  a temporary buffer to decompress the page */
 		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
@@ -383,7 +773,7 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 
 	ret = zram_decompress_page(zram, uncmem, index);
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK))
+	if (unlikely(ret))
 		goto out_cleanup;
 
 	if (is_partial_io(bvec))
@@ -399,19 +789,38 @@ out_cleanup:
 	return ret;
 }
 
+static void handle_pending_slot_free(struct zram *zram)
+{
+	struct zram_slot_free *free_rq;
+
+	spin_lock(&zram->slot_free_lock);
+	while (zram->slot_free_rq) {
+		free_rq = zram->slot_free_rq;
+		zram->slot_free_rq = free_rq->next;
+		zram_free_page(zram, free_rq->index);
+		kfree(free_rq);
+	}
+	spin_unlock(&zram->slot_free_lock);
+}
+
+/*
+ * Compression runs with only a stream from the pool held, so writers on
+ * different CPUs compress in parallel; zram->lock is taken for writing
+ * just to swap the table entry and the 32bit stats.
+ */
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
 	int ret = 0;
 	size_t clen;
-	unsigned long handle;
+	unsigned long handle, element;
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
+	struct zcomp_strm *zstrm;
 	static unsigned long zram_rs_time;
 
 	page = bvec->bv_page;
-	src = meta->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
@@ -423,11 +832,18 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			ret = -ENOMEM;
 			goto out;
 		}
+		down_read(&zram->lock);
+		handle_pending_slot_free(zram);
 		ret = zram_decompress_page(zram, uncmem, index);
+		up_read(&zram->lock);
 		if (ret)
 			goto out;
 	}
 
+	/* may sleep, so before the page is mapped */
+	zstrm = zcomp_strm_find(meta->comp);
+	src = zstrm->buffer;
+
 	user_mem = kmap_atomic(page, KM_USER0);
 
 	if (is_partial_io(bvec)) {
@@ -439,27 +855,26 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		kunmap_atomic(user_mem, KM_USER0);
+		zcomp_strm_release(meta->comp, zstrm);
+
+		down_write(&zram->lock);
+		handle_pending_slot_free(zram);
 		/* Free memory associated with this sector now. */
 		zram_free_page(zram, index);
 
-		zram->stats.pages_zero++;
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		if (!element)
+			zram->stats.pages_zero++;
+		zram->stats.pages_same++;
+		zram_set_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = element;
+		up_write(&zram->lock);
 		ret = 0;
 		goto out;
 	}
 
-	/*
-	 * zram_slot_free_notify could miss free so that let's
-	 * double check.
-	 */
-	if (unlikely(meta->table[index].handle ||
-			zram_test_flag(meta, index, ZRAM_ZERO)))
-		zram_free_page(zram, index);
-
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       meta->compress_workmem);
+	ret = zcomp_compress(meta->comp, zstrm, uncmem, &clen);
 
 	if (!is_partial_io(bvec)) {
 		kunmap_atomic(user_mem, KM_USER0);
@@ -467,13 +882,12 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = NULL;
 	}
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
-		goto out;
+		goto out_release;
 	}
 
 	if (unlikely(clen > max_zpage_size)) {
-		zram->stats.bad_compress++;
 		clen = PAGE_SIZE;
 		src = NULL;
 		if (is_partial_io(bvec))
@@ -487,7 +901,7 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			pr_info("Error allocating memory for compressed page: %u, size=%zu\n",
 				index, clen);
 		ret = -ENOMEM;
-		goto out;
+		goto out_release;
 	}
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_WO);
 
@@ -500,7 +914,10 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	}
 
 	zs_unmap_object(meta->mem_pool, handle);
+	zcomp_strm_release(meta->comp, zstrm);
 
+	down_write(&zram->lock);
+	handle_pending_slot_free(zram);
 	/*
 	 * Free memory associated with this sector
 	 * before overwriting unused sectors.
@@ -509,13 +926,25 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	meta->table[index].handle = handle;
 	meta->table[index].size = clen;
+	zram_touch(meta, index);
 
 	/* Update stats */
 	atomic64_add(clen, &zram->stats.compr_size);
 	zram->stats.pages_stored++;
+	if (clen > max_zpage_size) {
+		zram->stats.bad_compress++;
+		zram_set_flag(meta, index, ZRAM_HUGE);
+	}
 	if (clen <= PAGE_SIZE / 2)
 		zram->stats.good_compress++;
+	up_write(&zram->lock);
 
+	if (clen > max_zpage_size)
+		zram_schedule_wb(zram);
+	goto out;
+
+out_release:
+	zcomp_strm_release(meta->comp, zstrm);
 out:
 	if (is_partial_io(bvec))
 		kfree(uncmem);
@@ -525,20 +954,6 @@ out:
 	return ret;
 }
 
-static void handle_pending_slot_free(struct zram *zram)
-{
-	struct zram_slot_free *free_rq;
-
-	spin_lock(&zram->slot_free_lock);
-	while (zram->slot_free_rq) {
-		free_rq = zram->slot_free_rq;
-		zram->slot_free_rq = free_rq->next;
-		zram_free_page(zram, free_rq->index);
-		kfree(free_rq);
-	}
-	spin_unlock(&zram->slot_free_lock);
-}
-
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, struct bio *bio, int rw)
 {
@@ -550,24 +965,176 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
 		up_read(&zram->lock);
 	} else {
-		down_write(&zram->lock);
-		handle_pending_slot_free(zram);
 		ret = zram_bvec_write(zram, bvec, index, offset);
+	}
+
+	return ret;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static bool zram_wb_candidate(struct zram_meta *meta, u32 index,
+			unsigned long age)
+{
+	if (zram_test_flag(meta, index, ZRAM_SAME) ||
+			zram_test_flag(meta, index, ZRAM_WB) ||
+			zram_test_flag(meta, index, ZRAM_UNDER_WB) ||
+			!meta->table[index].handle)
+		return false;
+
+	if (zram_test_flag(meta, index, ZRAM_HUGE))
+		return true;
+
+	return age && time_after_eq(jiffies, meta->table[index].ac_time + age);
+}
+
+/*
+ * Move incompressible pages, and with a non-zero @age pages not accessed
+ * for that long, to the backing device.  Each page is copied out under
+ * zram->lock and marked ZRAM_UNDER_WB; zram_free_page() clears the mark,
+ * so a page freed or rewritten while the block is being written is
+ * detected afterwards and the block dropped.  Caller holds init_lock for
+ * reading and has checked zram->bdev.
+ */
+static int zram_writeback(struct zram *zram, unsigned long age)
+{
+	int ret = 0;
+	u32 index, nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long blk;
+	struct zram_meta *meta = zram->meta;
+	struct page *page;
+	void *mem;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	for (index = 0; index < nr_pages; index++) {
+		down_write(&zram->lock);
+		if (!zram_wb_candidate(meta, index, age)) {
+			up_write(&zram->lock);
+			continue;
+		}
+		mem = kmap(page);
+		ret = zram_decompress_page(zram, mem, index);
+		kunmap(page);
+		if (ret) {
+			up_write(&zram->lock);
+			ret = 0;
+			continue;
+		}
+		zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		up_write(&zram->lock);
+
+		blk = zram_alloc_block(zram);
+		if (blk)
+			ret = zram_bdev_rw_page(zram, page, blk, WRITE);
+		else
+			ret = -ENOSPC;
+
+		down_write(&zram->lock);
+		if (ret || !zram_test_flag(meta, index, ZRAM_UNDER_WB)) {
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			if (blk)
+				zram_free_block(zram, blk);
+			up_write(&zram->lock);
+			if (ret)
+				break;
+			continue;
+		}
+		zram_free_page(zram, index);
+		zram_set_flag(meta, index, ZRAM_WB);
+		meta->table[index].element = blk;
 		up_write(&zram->lock);
 	}
 
+	__free_page(page);
 	return ret;
 }
 
+/* queued when an incompressible page is stored */
+static void zram_wb_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(work, struct zram, wb_work);
+
+	down_read(&zram->init_lock);
+	if (zram->init_done && zram->bdev)
+		zram_writeback(zram, 0);
+	up_read(&zram->init_lock);
+}
+
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int ret;
+	unsigned long do_wb;
+	struct zram *zram = dev_to_zram(dev);
+
+	ret = strict_strtoul(buf, 10, &do_wb);
+	if (ret)
+		return ret;
+	if (!do_wb)
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (zram->init_done && zram->bdev)
+		ret = zram_writeback(zram, (unsigned long)zram->wb_age * HZ);
+	else
+		ret = -EINVAL;
+	up_read(&zram->init_lock);
+
+	return ret ? ret : len;
+}
+
+static ssize_t writeback_age_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%u\n", zram->wb_age);
+}
+
+static ssize_t writeback_age_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int ret;
+	unsigned long age;
+	struct zram *zram = dev_to_zram(dev);
+
+	ret = strict_strtoul(buf, 10, &age);
+	if (ret)
+		return ret;
+	if (age > UINT_MAX / HZ)
+		return -EINVAL;
+
+	zram->wb_age = age;
+	return len;
+}
+
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.bd_count),
+			(u64)atomic64_read(&zram->stats.bd_reads),
+			(u64)atomic64_read(&zram->stats.bd_writes));
+}
+#endif
+
 static void zram_reset_device(struct zram *zram, bool reset_capacity)
 {
 	size_t index;
 	struct zram_meta *meta;
 
 	flush_work(&zram->free_work);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	flush_work(&zram->wb_work);
+#endif
 
 	down_write(&zram->init_lock);
 	if (!zram->init_done) {
+		zram_reset_bdev(zram);
 		up_write(&zram->init_lock);
 		return;
 	}
@@ -578,7 +1145,8 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		unsigned long handle = meta->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(meta, index, ZRAM_SAME) ||
+				zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
 		zs_free(meta->mem_pool, handle);
@@ -586,6 +1154,7 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 
 	zram_meta_free(zram->meta);
 	zram->meta = NULL;
+	zram_reset_bdev(zram);
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
 
@@ -613,6 +1182,9 @@ static void zram_init_device(struct zram *zram, struct zram_meta *meta)
 
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
+	/* and there is nothing to gain from reading more than asked for */
+	zram->disk->queue->backing_dev_info.capabilities |=
+		BDI_CAP_SYNCHRONOUS_IO;
 
 	zram->meta = meta;
 	zram->init_done = 1;
@@ -632,7 +1204,12 @@ static ssize_t disksize_store(struct device *dev,
 		return -EINVAL;
 
 	disksize = PAGE_ALIGN(disksize);
-	meta = zram_meta_alloc(disksize);
+	down_read(&zram->init_lock);
+	meta = zram_meta_alloc(zram->disk->disk_name, disksize, zram->comp,
+				zram->max_comp_streams);
+	up_read(&zram->init_lock);
+	if (!meta)
+		return -ENOMEM;
 	down_write(&zram->init_lock);
 	if (zram->init_done) {
 		up_write(&zram->init_lock);
@@ -649,6 +1226,23 @@ static ssize_t disksize_store(struct device *dev,
 	return len;
 }
 
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	zs_compact(zram->meta->mem_pool);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
 static ssize_t reset_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
@@ -806,27 +1400,54 @@ static DEVICE_ATTR(disksize, S_IRUGO | S_IWUSR,
 		disksize_show, disksize_store);
 static DEVICE_ATTR(initstate, S_IRUGO, initstate_show, NULL);
 static DEVICE_ATTR(reset, S_IWUSR, NULL, reset_store);
+static DEVICE_ATTR(compact, S_IWUSR, NULL, compact_store);
 static DEVICE_ATTR(num_reads, S_IRUGO, num_reads_show, NULL);
 static DEVICE_ATTR(num_writes, S_IRUGO, num_writes_show, NULL);
 static DEVICE_ATTR(invalid_io, S_IRUGO, invalid_io_show, NULL);
 static DEVICE_ATTR(notify_free, S_IRUGO, notify_free_show, NULL);
 static DEVICE_ATTR(zero_pages, S_IRUGO, zero_pages_show, NULL);
+static DEVICE_ATTR(same_pages, S_IRUGO, same_pages_show, NULL);
 static DEVICE_ATTR(orig_data_size, S_IRUGO, orig_data_size_show, NULL);
 static DEVICE_ATTR(compr_data_size, S_IRUGO, compr_data_size_show, NULL);
 static DEVICE_ATTR(mem_used_total, S_IRUGO, mem_used_total_show, NULL);
+static DEVICE_ATTR(comp_algorithm, S_IRUGO | S_IWUSR,
+		comp_algorithm_show, comp_algorithm_store);
+static DEVICE_ATTR(max_comp_streams, S_IRUGO | S_IWUSR,
+		max_comp_streams_show, max_comp_streams_store);
+static DEVICE_ATTR(swap_cost, S_IRUGO | S_IWUSR,
+		swap_cost_show, swap_cost_store);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR(backing_dev, S_IRUGO | S_IWUSR,
+		backing_dev_show, backing_dev_store);
+static DEVICE_ATTR(writeback, S_IWUSR, NULL, writeback_store);
+static DEVICE_ATTR(writeback_age, S_IRUGO | S_IWUSR,
+		writeback_age_show, writeback_age_store);
+static DEVICE_ATTR(bd_stat, S_IRUGO, bd_stat_show, NULL);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
 	&dev_attr_initstate.attr,
 	&dev_attr_reset.attr,
+	&dev_attr_compact.attr,
 	&dev_attr_num_reads.attr,
 	&dev_attr_num_writes.attr,
 	&dev_attr_invalid_io.attr,
 	&dev_attr_notify_free.attr,
 	&dev_attr_zero_pages.attr,
+	&dev_attr_same_pages.attr,
 	&dev_attr_orig_data_size.attr,
 	&dev_attr_compr_data_size.attr,
 	&dev_attr_mem_used_total.attr,
+	&dev_attr_comp_algorithm.attr,
+	&dev_attr_max_comp_streams.attr,
+	&dev_attr_swap_cost.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_writeback_age.attr,
+	&dev_attr_bd_stat.attr,
+#endif
 	NULL,
 };
 
@@ -842,8 +1463,13 @@ static int create_device(struct zram *zram, int device_id)
 	init_rwsem(&zram->init_lock);
 
 	INIT_WORK(&zram->free_work, zram_slot_free);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	INIT_WORK(&zram->wb_work, zram_wb_work);
+#endif
 	spin_lock_init(&zram->slot_free_lock);
 	zram->slot_free_rq = NULL;
+	zram->comp = zcomp_find_backend(NULL);
+	zram->max_comp_streams = num_online_cpus();
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -882,6 +1508,7 @@ static int create_device(struct zram *zram, int device_id)
 					ZRAM_LOGICAL_BLOCK_SIZE);
 	blk_queue_io_min(zram->disk->queue, PAGE_SIZE);
 	blk_queue_io_opt(zram->disk->queue, PAGE_SIZE);
+	blk_queue_swap_cost(zram->disk->queue, ZRAM_SWAP_COST);
 
 	add_disk(zram->disk);
 
@@ -19,6 +19,7 @@
 #include <linux/mutex.h>
 
 #include "../zsmalloc/zsmalloc.h"
+#include "zcomp.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -51,10 +52,23 @@ static const size_t max_zpage_size = PAGE_SIZE / 10 * 9;
 #define ZRAM_SECTOR_PER_LOGICAL_BLOCK	\
 	(1 << (ZRAM_LOGICAL_BLOCK_SHIFT - SECTOR_SHIFT))
 
+/*
+ * Default cost of a swap-in, in percent of reading a file page back.
+ * Decompressing a page takes tens of microseconds, a NAND or SD read
+ * a millisecond or more.
+ */
+#define ZRAM_SWAP_COST		25
+
 /* Flags for zram pages (table[page_no].flags) */
 enum zram_pageflags {
-	/* Page consists entirely of zeros */
-	ZRAM_ZERO,
+	/* Page is one word repeated, kept in table.element, not stored */
+	ZRAM_SAME,
+	/* Page did not compress and is stored as is */
+	ZRAM_HUGE,
+	/* Page is being written to the backing device */
+	ZRAM_UNDER_WB,
+	/* Page lives in the backing device, block number in table.element */
+	ZRAM_WB,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -63,10 +77,16 @@ enum zram_pageflags {
 
 /* Allocated for each disk page */
 struct table {
-	unsigned long handle;
+	union {
+		unsigned long handle;
+		unsigned long element;	/* ZRAM_SAME fill pattern */
+	};
 	u16 size;	/* object size (excluding header) */
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	unsigned long ac_time;	/* jiffies of last access */
+#endif
 } __aligned(4);
 
 /*
@@ -81,15 +101,20 @@ struct zram_stats {
 	atomic64_t failed_writes;	/* can happen when memory is too low */
 	atomic64_t invalid_io;	/* non-page-aligned I/O requests */
 	atomic64_t notify_free;	/* no. of swap slot free notifications */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;	/* no. of pages in backing device */
+	atomic64_t bd_reads;	/* no. of reads from backing device */
+	atomic64_t bd_writes;	/* no. of writes to backing device */
+#endif
 	u32 pages_zero;		/* no. of zero filled pages */
+	u32 pages_same;		/* no. of same filled pages, incl. zero */
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 bad_compress;	/* % of pages with compression ratio>=75% */
 };
 
 struct zram_meta {
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zcomp *comp;
 	struct table *table;
 	struct zs_pool *mem_pool;
 };
@@ -101,9 +126,9 @@ struct zram_slot_free {
 
 struct zram {
 	struct zram_meta *meta;
-	struct rw_semaphore lock; /* protect compression buffers, table,
-				   * 32bit stat counters against concurrent
-				   * notifications, reads and writes */
+	struct rw_semaphore lock; /* protect table, 32bit stat counters
+				   * against concurrent notifications,
+				   * reads and writes */
 
 	struct work_struct free_work;  /* handle pending free request */
 	struct zram_slot_free *slot_free_rq; /* list head of free request */
@@ -118,6 +143,18 @@ struct zram {
 	 * we can store in a disk.
 	 */
 	u64 disksize;	/* bytes */
+	/* compressor for the next initialization, see comp_algorithm */
+	const struct zcomp_backend *comp;
+	/* size of the compression stream pool, see zcomp_set_max_streams */
+	int max_comp_streams;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct work_struct wb_work;	/* write back huge pages */
+	struct block_device *bdev;	/* see backing_dev_store */
+	char *backing_dev;		/* its path, for show */
+	unsigned long nr_pages;		/* size of bdev in pages */
+	unsigned long *bitmap;		/* blocks used in bdev */
+	unsigned int wb_age;		/* seconds idle before writeback */
+#endif
 	spinlock_t slot_free_lock;
 
 	struct zram_stats stats;
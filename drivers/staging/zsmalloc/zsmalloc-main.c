@@ -52,6 +52,16 @@
  *		Basically forming list of zspages in a fullness group.
  *	page->mapping: class index and fullness group of the zspage
  *
+ * Handles given out by zs_malloc() are not object locations but point to
+ * a word, allocated from zs_handle_cachep, holding the location.  This
+ * lets zs_compact() move objects between zspages behind their owners'
+ * backs.  To find the handle of an object being moved, every object
+ * except in huge classes starts with a ZS_HANDLE_SIZE header holding its
+ * handle tagged with OBJ_ALLOCATED_TAG; free objects hold a (shifted, so
+ * untagged) freelist link there instead.  Bit HANDLE_PIN_BIT of the
+ * handle word is a bit spinlock held while an object is mapped, freed or
+ * moved.
+ *
  * Usage of struct page flags:
  *	PG_private: identifies the first component page
  *	PG_private2: identifies the last component page
@@ -78,6 +88,10 @@
 #include <linux/hardirq.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
+#include <linux/bit_spinlock.h>
+#include <linux/mm.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "zsmalloc.h"
 
@@ -119,9 +133,20 @@
 #endif
 #endif
 #define _PFN_BITS		(MAX_PHYSMEM_BITS - PAGE_SHIFT)
-#define OBJ_INDEX_BITS	(BITS_PER_LONG - _PFN_BITS)
+
+/*
+ * Object locations are shifted up by OBJ_TAG_BITS so that bit 0 is free:
+ * in an object header it is OBJ_ALLOCATED_TAG, in a handle word it is
+ * HANDLE_PIN_BIT.
+ */
+#define OBJ_ALLOCATED_TAG	1
+#define OBJ_TAG_BITS	1
+#define HANDLE_PIN_BIT	0
+#define OBJ_INDEX_BITS	(BITS_PER_LONG - _PFN_BITS - OBJ_TAG_BITS)
 #define OBJ_INDEX_MASK	((_AC(1, UL) << OBJ_INDEX_BITS) - 1)
 
+#define ZS_HANDLE_SIZE	(sizeof(unsigned long))
+
 #define MAX(a, b) ((a) >= (b) ? (a) : (b))
 /* ZS_MIN_ALLOC_SIZE must be multiple of ZS_ALIGN */
 #define ZS_MIN_ALLOC_SIZE \
@@ -183,11 +208,15 @@ struct size_class {
 
 	/* Number of PAGE_SIZE sized pages to combine to form a 'zspage' */
 	int pages_per_zspage;
+	int objs_per_zspage;
+	/* one object per zspage: no header, never compacted */
+	bool huge;
 
 	spinlock_t lock;
 
 	/* stats */
 	u64 pages_allocated;
+	unsigned long objs_inuse;
 
 	struct page *fullness_list[_ZS_NR_FULLNESS_GROUPS];
 };
@@ -199,16 +228,28 @@ struct size_class {
  * This must be power of 2 and less than or equal to ZS_ALIGN
  */
 struct link_free {
-	/* Handle of next free chunk (encodes <PFN, obj_idx>) */
-	void *next;
+	union {
+		/* Location of next free chunk (encodes <PFN, obj_idx>) */
+		void *next;
+		/* Handle of allocated object, OBJ_ALLOCATED_TAG set */
+		unsigned long handle;
+	};
 };
 
 struct zs_pool {
 	struct size_class size_class[ZS_SIZE_CLASSES];
 
 	gfp_t flags;	/* allocation flags used when growing pool */
+
+	char *name;
+	struct shrinker shrinker;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *stat_dentry;
+#endif
 };
 
+static struct kmem_cache *zs_handle_cachep;
+
 /*
  * A zspage's class index and fullness group
  * are encoded in its (first)page->mapping
@@ -431,36 +472,75 @@ static struct page *get_next_page(struct page *page)
 }
 
 /*
- * Encode <page, obj_idx> as a single handle value.
+ * Encode <page, obj_idx> as a single object location value.
  * On hardware platforms with physical memory starting at 0x0 the pfn
- * could be 0 so we ensure that the handle will never be 0 by adjusting the
- * encoded obj_idx value before encoding.
+ * could be 0 so we ensure that the location will never be 0 by adjusting
+ * the encoded obj_idx value before encoding.
  */
-static void *obj_location_to_handle(struct page *page, unsigned long obj_idx)
+static void *obj_location_to_obj(struct page *page, unsigned long obj_idx)
 {
-	unsigned long handle;
+	unsigned long obj;
 
 	if (!page) {
 		BUG_ON(obj_idx);
 		return NULL;
 	}
 
-	handle = page_to_pfn(page) << OBJ_INDEX_BITS;
-	handle |= ((obj_idx + 1) & OBJ_INDEX_MASK);
+	obj = page_to_pfn(page) << OBJ_INDEX_BITS;
+	obj |= ((obj_idx + 1) & OBJ_INDEX_MASK);
 
-	return (void *)handle;
+	return (void *)(obj << OBJ_TAG_BITS);
 }
 
 /*
- * Decode <page, obj_idx> pair from the given object handle. We adjust the
- * decoded obj_idx back to its original value since it was adjusted in
- * obj_location_to_handle().
+ * Decode <page, obj_idx> pair from the given object location. We adjust
+ * the decoded obj_idx back to its original value since it was adjusted in
+ * obj_location_to_obj().
  */
-static void obj_handle_to_location(unsigned long handle, struct page **page,
+static void obj_to_location(unsigned long obj, struct page **page,
 				unsigned long *obj_idx)
 {
-	*page = pfn_to_page(handle >> OBJ_INDEX_BITS);
-	*obj_idx = (handle & OBJ_INDEX_MASK) - 1;
+	obj >>= OBJ_TAG_BITS;
+	*page = pfn_to_page(obj >> OBJ_INDEX_BITS);
+	*obj_idx = (obj & OBJ_INDEX_MASK) - 1;
+}
+
+static unsigned long cache_alloc_handle(struct zs_pool *pool)
+{
+	return (unsigned long)kmem_cache_alloc(zs_handle_cachep,
+			pool->flags & ~__GFP_HIGHMEM);
+}
+
+static void cache_free_handle(unsigned long handle)
+{
+	kmem_cache_free(zs_handle_cachep, (void *)handle);
+}
+
+static unsigned long handle_to_obj(unsigned long handle)
+{
+	return ACCESS_ONCE(*(unsigned long *)handle) &
+			~(1UL << HANDLE_PIN_BIT);
+}
+
+/* the pin bit is part of @obj, so this also sets or clears it */
+static void record_obj(unsigned long handle, unsigned long obj)
+{
+	ACCESS_ONCE(*(unsigned long *)handle) = obj;
+}
+
+static void pin_tag(unsigned long handle)
+{
+	bit_spin_lock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static int trypin_tag(unsigned long handle)
+{
+	return bit_spin_trylock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static void unpin_tag(unsigned long handle)
+{
+	bit_spin_unlock(HANDLE_PIN_BIT, (unsigned long *)handle);
 }
 
 static unsigned long obj_idx_to_offset(struct page *page,
@@ -537,7 +617,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		for (i = 1; i <= objs_on_page; i++) {
 			off += class->size;
 			if (off < PAGE_SIZE) {
-				link->next = obj_location_to_handle(page, i);
+				link->next = obj_location_to_obj(page, i);
 				link += class->size / sizeof(*link);
 			}
 		}
@@ -548,7 +628,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		 * page (if present)
 		 */
 		next_page = get_next_page(page);
-		link->next = obj_location_to_handle(next_page, 0);
+		link->next = obj_location_to_obj(next_page, 0);
 		kunmap_atomic(link, KM_USER0);
 		page = next_page;
 		off = (off + class->size) % PAGE_SIZE;
@@ -602,7 +682,7 @@ static struct page *alloc_zspage(struct size_class *class, gfp_t flags)
 
 	init_zspage(first_page, class);
 
-	first_page->freelist = obj_location_to_handle(first_page, 0);
+	first_page->freelist = obj_location_to_obj(first_page, 0);
 	/* Maximum number of objects we can store in this zspage */
 	first_page->objects = class->pages_per_zspage * PAGE_SIZE / class->size;
 
@@ -631,6 +711,253 @@ static struct page *find_get_zspage(struct size_class *class)
 	return page;
 }
 
+/*
+ * Take a free object off @first_page's freelist for @handle.  The caller
+ * holds class->lock and fixes the fullness group afterwards.
+ */
+static unsigned long obj_malloc(struct size_class *class,
+			struct page *first_page, unsigned long handle)
+{
+	unsigned long obj, m_objidx, m_offset;
+	struct link_free *link;
+	struct page *m_page;
+
+	obj = (unsigned long)first_page->freelist;
+	obj_to_location(obj, &m_page, &m_objidx);
+	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
+
+	link = (struct link_free *)kmap_atomic(m_page, KM_USER0) +
+					m_offset / sizeof(*link);
+	first_page->freelist = link->next;
+	if (!class->huge)
+		link->handle = handle | OBJ_ALLOCATED_TAG;
+	else
+		memset(link, POISON_INUSE, sizeof(*link));
+	kunmap_atomic(link, KM_USER0);
+
+	first_page->inuse++;
+	class->objs_inuse++;
+
+	return obj;
+}
+
+/* counterpart of obj_malloc(), same rules */
+static void obj_free(struct size_class *class, unsigned long obj)
+{
+	struct link_free *link;
+	struct page *first_page, *f_page;
+	unsigned long f_objidx, f_offset;
+
+	obj_to_location(obj, &f_page, &f_objidx);
+	first_page = get_first_page(f_page);
+	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
+
+	/* Insert this object in containing zspage's freelist */
+	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page, KM_USER0)
+							+ f_offset);
+	link->next = first_page->freelist;
+	kunmap_atomic(link, KM_USER0);
+	first_page->freelist = (void *)obj;
+
+	first_page->inuse--;
+	class->objs_inuse--;
+}
+
+static int zs_list_count(struct list_head *head)
+{
+	struct list_head *pos;
+	int n = 0;
+
+	list_for_each(pos, head)
+		n++;
+	return n;
+}
+
+/* zspages of @class that compaction could free, class->lock held */
+static unsigned long zs_can_compact(struct size_class *class)
+{
+	unsigned long obj_allocated, obj_wasted;
+
+	if (class->huge)
+		return 0;
+
+	obj_allocated = class->pages_allocated / class->pages_per_zspage *
+			class->objs_per_zspage;
+	obj_wasted = obj_allocated - class->objs_inuse;
+
+	return obj_wasted / class->objs_per_zspage;
+}
+
+/* copy a whole object slot, header included; either may span two pages */
+static void zs_object_copy(unsigned long dst, unsigned long src,
+			struct size_class *class)
+{
+	struct page *s_page, *d_page;
+	unsigned long s_objidx, d_objidx;
+	unsigned long s_off, d_off;
+	void *s_addr, *d_addr;
+	int s_size, d_size, size;
+	int written = 0;
+
+	obj_to_location(src, &s_page, &s_objidx);
+	obj_to_location(dst, &d_page, &d_objidx);
+	s_off = obj_idx_to_offset(s_page, s_objidx, class->size);
+	d_off = obj_idx_to_offset(d_page, d_objidx, class->size);
+
+	s_addr = kmap_atomic(s_page, KM_USER0);
+	d_addr = kmap_atomic(d_page, KM_USER1);
+
+	for (;;) {
+		s_size = min_t(int, class->size - written, PAGE_SIZE - s_off);
+		d_size = min_t(int, class->size - written, PAGE_SIZE - d_off);
+		size = min(s_size, d_size);
+
+		memcpy(d_addr + d_off, s_addr + s_off, size);
+		written += size;
+		if (written == class->size)
+			break;
+
+		s_off += size;
+		d_off += size;
+		if (s_off >= PAGE_SIZE) {
+			kunmap_atomic(s_addr, KM_USER0);
+			s_page = get_next_page(s_page);
+			BUG_ON(!s_page);
+			s_addr = kmap_atomic(s_page, KM_USER0);
+			s_off = 0;
+		}
+		if (d_off >= PAGE_SIZE) {
+			kunmap_atomic(d_addr, KM_USER1);
+			d_page = get_next_page(d_page);
+			BUG_ON(!d_page);
+			d_addr = kmap_atomic(d_page, KM_USER1);
+			d_off = 0;
+		}
+	}
+
+	kunmap_atomic(d_addr, KM_USER1);
+	kunmap_atomic(s_addr, KM_USER0);
+}
+
+/*
+ * Move the objects of @src into @dst until @src has been scanned or @dst
+ * is full.  Objects pinned by a mapper or by zs_free() are left alone.
+ * Both zspages have been taken off their fullness lists and class->lock
+ * is held throughout.  Returns -EAGAIN if @dst filled up first.
+ */
+static int migrate_zspage(struct size_class *class, struct page *src,
+			struct page *dst)
+{
+	struct page *page = src;
+	unsigned long obj_idx = 0, handle, head, used_obj, free_obj;
+	int nr = 0, offset;
+	void *addr;
+
+	while (page && nr < src->objects) {
+		offset = obj_idx_to_offset(page, obj_idx, class->size);
+		if (offset >= PAGE_SIZE) {
+			page = get_next_page(page);
+			obj_idx = 0;
+			continue;
+		}
+		nr++;
+		obj_idx++;
+
+		addr = kmap_atomic(page, KM_USER0);
+		head = *(unsigned long *)(addr + offset);
+		kunmap_atomic(addr, KM_USER0);
+		if (!(head & OBJ_ALLOCATED_TAG))
+			continue;
+
+		handle = head & ~OBJ_ALLOCATED_TAG;
+		if (!trypin_tag(handle))
+			continue;
+
+		if (dst->inuse == dst->objects) {
+			unpin_tag(handle);
+			return -EAGAIN;
+		}
+
+		used_obj = handle_to_obj(handle);
+		free_obj = obj_malloc(class, dst, handle);
+		zs_object_copy(free_obj, used_obj, class);
+		record_obj(handle, free_obj | (1UL << HANDLE_PIN_BIT));
+		unpin_tag(handle);
+		obj_free(class, used_obj);
+	}
+
+	return 0;
+}
+
+static struct page *isolate_zspage(struct size_class *class, bool source)
+{
+	int i;
+	struct page *page;
+	enum fullness_group fg[2] = { ZS_ALMOST_EMPTY, ZS_ALMOST_FULL };
+
+	/* sources are the emptiest zspages, destinations the fullest */
+	if (!source) {
+		fg[0] = ZS_ALMOST_FULL;
+		fg[1] = ZS_ALMOST_EMPTY;
+	}
+
+	for (i = 0; i < 2; i++) {
+		page = class->fullness_list[fg[i]];
+		if (page) {
+			remove_zspage(page, class, fg[i]);
+			return page;
+		}
+	}
+
+	return NULL;
+}
+
+static enum fullness_group putback_zspage(struct size_class *class,
+			struct page *first_page)
+{
+	enum fullness_group fullness = get_fullness_group(first_page);
+
+	insert_zspage(first_page, class, fullness);
+	set_zspage_mapping(first_page, class->index, fullness);
+	return fullness;
+}
+
+static unsigned long __zs_compact(struct size_class *class)
+{
+	struct page *src, *dst;
+	unsigned long freed = 0;
+
+	spin_lock(&class->lock);
+	while (zs_can_compact(class)) {
+		src = isolate_zspage(class, true);
+		if (!src)
+			break;
+
+		while ((dst = isolate_zspage(class, false))) {
+			int ret = migrate_zspage(class, src, dst);
+
+			putback_zspage(class, dst);
+			if (!ret)
+				break;
+		}
+
+		if (putback_zspage(class, src) != ZS_EMPTY) {
+			/* pinned objects or nowhere left to move them */
+			break;
+		}
+
+		class->pages_allocated -= class->pages_per_zspage;
+		freed += class->pages_per_zspage;
+		spin_unlock(&class->lock);
+		free_zspage(src);
+		cond_resched();
+		spin_lock(&class->lock);
+	}
+	spin_unlock(&class->lock);
+
+	return freed;
+}
+
 #ifdef USE_PGTABLE_MAPPING
 static inline int __zs_cpu_up(struct mapping_area *area)
 {
@@ -662,7 +989,8 @@ static inline void *__zs_map_object(struct mapping_area *area,
 }
 
 static inline void __zs_unmap_object(struct mapping_area *area,
-				struct page *pages[2], int off, int size)
+				struct page *pages[2], int off, int size,
+				int hdr)
 {
 	unsigned long addr = (unsigned long)area->vm_addr;
 
@@ -720,17 +1048,21 @@ out:
 	return area->vm_buf;
 }
 
+/* the first @hdr bytes are the object header, which the user never saw */
 static void __zs_unmap_object(struct mapping_area *area,
-			struct page *pages[2], int off, int size)
+			struct page *pages[2], int off, int size, int hdr)
 {
 	int sizes[2];
 	void *addr;
-	char *buf = area->vm_buf;
+	char *buf = area->vm_buf + hdr;
 
 	/* no write fastpath */
 	if (area->vm_mm == ZS_MM_RO)
 		goto out;
 
+	off += hdr;
+	size -= hdr;
+
 	sizes[0] = PAGE_SIZE - off;
 	sizes[1] = size - sizes[0];
 
@@ -776,6 +1108,110 @@ static struct notifier_block zs_cpu_nb = {
 	.notifier_call = zs_cpu_notifier
 };
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *zs_stat_root;
+
+static int zs_stats_show(struct seq_file *s, void *v)
+{
+	int i, fg, count[_ZS_NR_FULLNESS_GROUPS];
+	struct zs_pool *pool = s->private;
+	struct size_class *class;
+	struct page *page;
+	unsigned long obj_allocated, obj_used, pages_used, freeable;
+	unsigned long total_allocated = 0, total_used = 0;
+	unsigned long total_pages = 0, total_freeable = 0;
+
+	seq_printf(s, " %5s %5s %11s %12s %13s %10s %10s %16s %8s\n",
+			"class", "size", "almost_full", "almost_empty",
+			"obj_allocated", "obj_used", "pages_used",
+			"pages_per_zspage", "freeable");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = &pool->size_class[i];
+
+		spin_lock(&class->lock);
+		for (fg = 0; fg < _ZS_NR_FULLNESS_GROUPS; fg++) {
+			count[fg] = 0;
+			page = class->fullness_list[fg];
+			if (page)
+				count[fg] = 1 + zs_list_count(&page->lru);
+		}
+		pages_used = class->pages_allocated;
+		obj_allocated = pages_used / class->pages_per_zspage *
+				class->objs_per_zspage;
+		obj_used = class->objs_inuse;
+		freeable = zs_can_compact(class) * class->pages_per_zspage;
+		spin_unlock(&class->lock);
+
+		if (!pages_used)
+			continue;
+
+		seq_printf(s, " %5u %5u %11d %12d %13lu %10lu %10lu %16d %8lu\n",
+			i, class->size, count[ZS_ALMOST_FULL],
+			count[ZS_ALMOST_EMPTY], obj_allocated, obj_used,
+			pages_used, class->pages_per_zspage, freeable);
+
+		total_allocated += obj_allocated;
+		total_used += obj_used;
+		total_pages += pages_used;
+		total_freeable += freeable;
+	}
+
+	seq_printf(s, "\n %5s %5s %11s %12s %13lu %10lu %10lu %16s %8lu\n",
+			"Total", "", "", "", total_allocated, total_used,
+			total_pages, "", total_freeable);
+
+	return 0;
+}
+
+static int zs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_stats_show, inode->i_private);
+}
+
+static const struct file_operations zs_stat_fops = {
+	.open		= zs_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void zs_pool_stat_create(struct zs_pool *pool)
+{
+	if (!zs_stat_root)
+		return;
+
+	pool->stat_dentry = debugfs_create_dir(pool->name, zs_stat_root);
+	if (!pool->stat_dentry) {
+		pr_warning("zsmalloc: debugfs dir <%s> creation failed\n",
+			pool->name);
+		return;
+	}
+	debugfs_create_file("classes", S_IFREG | S_IRUGO,
+			pool->stat_dentry, pool, &zs_stat_fops);
+}
+
+static void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+	debugfs_remove_recursive(pool->stat_dentry);
+}
+
+static void zs_stat_init(void)
+{
+	zs_stat_root = debugfs_create_dir("zsmalloc", NULL);
+}
+
+static void zs_stat_exit(void)
+{
+	debugfs_remove_recursive(zs_stat_root);
+}
+#else
+static inline void zs_pool_stat_create(struct zs_pool *pool) { }
+static inline void zs_pool_stat_destroy(struct zs_pool *pool) { }
+static inline void zs_stat_init(void) { }
+static inline void zs_stat_exit(void) { }
+#endif
+
 static void zs_exit(void)
 {
 	int cpu;
@@ -783,26 +1219,58 @@ static void zs_exit(void)
 	for_each_online_cpu(cpu)
 		zs_cpu_notifier(NULL, CPU_DEAD, (void *)(long)cpu);
 	unregister_cpu_notifier(&zs_cpu_nb);
+	zs_stat_exit();
+	if (zs_handle_cachep)
+		kmem_cache_destroy(zs_handle_cachep);
 }
 
 static int zs_init(void)
 {
 	int cpu, ret;
 
+	zs_handle_cachep = kmem_cache_create("zs_handle", ZS_HANDLE_SIZE,
+					0, 0, NULL);
+	if (!zs_handle_cachep)
+		return -ENOMEM;
+
 	register_cpu_notifier(&zs_cpu_nb);
 	for_each_online_cpu(cpu) {
 		ret = zs_cpu_notifier(NULL, CPU_UP_PREPARE, (void *)(long)cpu);
 		if (notifier_to_errno(ret))
 			goto fail;
 	}
+	zs_stat_init();
 	return 0;
 fail:
 	zs_exit();
 	return notifier_to_errno(ret);
 }
 
+static int zs_shrinker_scan(struct shrinker *shrinker, int nr_to_scan,
+			gfp_t gfp_mask)
+{
+	int i;
+	unsigned long freeable = 0;
+	struct zs_pool *pool = container_of(shrinker, struct zs_pool,
+					shrinker);
+
+	if (nr_to_scan)
+		zs_compact(pool);
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		spin_lock(&class->lock);
+		freeable += zs_can_compact(class) * class->pages_per_zspage;
+		spin_unlock(&class->lock);
+	}
+
+	return min_t(unsigned long, freeable, INT_MAX);
+}
+
 /**
  * zs_create_pool - Creates an allocation pool to work from.
+ * @name: name of the pool, used for its debugfs directory
  * @flags: allocation flags used to allocate pool metadata
  *
  * This function must be called before anything when using
@@ -811,7 +1279,7 @@ fail:
  * On success, a pointer to the newly created pool is returned,
  * otherwise NULL.
  */
-struct zs_pool *zs_create_pool(gfp_t flags)
+struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 {
 	int i, ovhd_size;
 	struct zs_pool *pool;
@@ -821,6 +1289,12 @@ struct zs_pool *zs_create_pool(gfp_t flags)
 	if (!pool)
 		return NULL;
 
+	pool->name = kstrdup(name, GFP_KERNEL);
+	if (!pool->name) {
+		kfree(pool);
+		return NULL;
+	}
+
 	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
 		int size;
 		struct size_class *class;
@@ -834,11 +1308,18 @@ struct zs_pool *zs_create_pool(gfp_t flags)
 		class->index = i;
 		spin_lock_init(&class->lock);
 		class->pages_per_zspage = get_pages_per_zspage(size);
-
+		class->objs_per_zspage = class->pages_per_zspage *
+					PAGE_SIZE / size;
+		class->huge = class->objs_per_zspage == 1;
 	}
 
 	pool->flags = flags;
 
+	pool->shrinker.shrink = zs_shrinker_scan;
+	pool->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&pool->shrinker);
+	zs_pool_stat_create(pool);
+
 	return pool;
 }
 EXPORT_SYMBOL_GPL(zs_create_pool);
@@ -847,6 +1328,9 @@ void zs_destroy_pool(struct zs_pool *pool)
 {
 	int i;
 
+	zs_pool_stat_destroy(pool);
+	unregister_shrinker(&pool->shrinker);
+
 	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
 		int fg;
 		struct size_class *class = &pool->size_class[i];
@@ -858,6 +1342,7 @@ void zs_destroy_pool(struct zs_pool *pool)
 			}
 		}
 	}
+	kfree(pool->name);
 	kfree(pool);
 }
 EXPORT_SYMBOL_GPL(zs_destroy_pool);
@@ -873,17 +1358,20 @@ EXPORT_SYMBOL_GPL(zs_destroy_pool);
  */
 unsigned long zs_malloc(struct zs_pool *pool, size_t size)
 {
-	unsigned long obj;
-	struct link_free *link;
+	unsigned long handle, obj;
 	int class_idx;
 	struct size_class *class;
-
-	struct page *first_page, *m_page;
-	unsigned long m_objidx, m_offset;
+	struct page *first_page;
 
 	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
 		return 0;
 
+	handle = cache_alloc_handle(pool);
+	if (!handle)
+		return 0;
+
+	/* the biggest sizes land in the huge class, which has no header */
+	size = min_t(size_t, size + ZS_HANDLE_SIZE, ZS_MAX_ALLOC_SIZE);
 	class_idx = get_size_class_index(size);
 	class = &pool->size_class[class_idx];
 	BUG_ON(class_idx != class->index);
@@ -894,75 +1382,84 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size)
 	if (!first_page) {
 		spin_unlock(&class->lock);
 		first_page = alloc_zspage(class, pool->flags);
-		if (unlikely(!first_page))
+		if (unlikely(!first_page)) {
+			cache_free_handle(handle);
 			return 0;
+		}
 
 		set_zspage_mapping(first_page, class->index, ZS_EMPTY);
 		spin_lock(&class->lock);
 		class->pages_allocated += class->pages_per_zspage;
 	}
 
-	obj = (unsigned long)first_page->freelist;
-	obj_handle_to_location(obj, &m_page, &m_objidx);
-	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
-
-	link = (struct link_free *)kmap_atomic(m_page, KM_USER0) +
-					m_offset / sizeof(*link);
-	first_page->freelist = link->next;
-	memset(link, POISON_INUSE, sizeof(*link));
-	kunmap_atomic(link, KM_USER0);
-
-	first_page->inuse++;
+	obj = obj_malloc(class, first_page, handle);
 	/* Now move the zspage to another fullness group, if required */
 	fix_fullness_group(pool, first_page);
+	record_obj(handle, obj);
 	spin_unlock(&class->lock);
 
-	return obj;
+	return handle;
 }
 EXPORT_SYMBOL_GPL(zs_malloc);
 
-void zs_free(struct zs_pool *pool, unsigned long obj)
+void zs_free(struct zs_pool *pool, unsigned long handle)
 {
-	struct link_free *link;
 	struct page *first_page, *f_page;
-	unsigned long f_objidx, f_offset;
-
+	unsigned long obj, f_objidx;
 	int class_idx;
 	struct size_class *class;
 	enum fullness_group fullness;
 
-	if (unlikely(!obj))
+	if (unlikely(!handle))
 		return;
 
-	obj_handle_to_location(obj, &f_page, &f_objidx);
+	/* keeps zs_compact() from moving the object under us */
+	pin_tag(handle);
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &f_page, &f_objidx);
 	first_page = get_first_page(f_page);
 
 	get_zspage_mapping(first_page, &class_idx, &fullness);
 	class = &pool->size_class[class_idx];
-	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
 
 	spin_lock(&class->lock);
-
-	/* Insert this object in containing zspage's freelist */
-	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page, KM_USER0)
-							+ f_offset);
-	link->next = first_page->freelist;
-	kunmap_atomic(link, KM_USER0);
-	first_page->freelist = (void *)obj;
-
-	first_page->inuse--;
+	obj_free(class, obj);
 	fullness = fix_fullness_group(pool, first_page);
 
 	if (fullness == ZS_EMPTY)
 		class->pages_allocated -= class->pages_per_zspage;
 
 	spin_unlock(&class->lock);
+	unpin_tag(handle);
+	cache_free_handle(handle);
 
 	if (fullness == ZS_EMPTY)
 		free_zspage(first_page);
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
+/**
+ * zs_compact - move objects to free sparsely used zspages
+ * @pool: pool to compact
+ *
+ * Within each size class, objects are moved out of the emptiest zspages
+ * into the fullest until no further zspage can be freed.  Handles stay
+ * valid; objects currently mapped are skipped.  May sleep.
+ *
+ * Returns the number of pages freed.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	int i;
+	unsigned long freed = 0;
+
+	for (i = ZS_SIZE_CLASSES - 1; i >= 0; i--)
+		freed += __zs_compact(&pool->size_class[i]);
+
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
 /**
  * zs_map_object - get address of allocated object from handle.
  * @pool: pool from which the object was allocated
@@ -981,7 +1478,8 @@ void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 			enum zs_mapmode mm)
 {
 	struct page *page;
-	unsigned long obj_idx, off;
+	unsigned long obj_handle, obj_idx, off;
+	int hdr;
 
 	unsigned int class_idx;
 	enum fullness_group fg;
@@ -998,17 +1496,22 @@ void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 	 */
 	BUG_ON(in_interrupt());
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	/* pinned until zs_unmap_object(), so zs_compact() leaves it be */
+	pin_tag(handle);
+
+	obj_handle = handle_to_obj(handle);
+	obj_to_location(obj_handle, &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
+	hdr = class->huge ? 0 : ZS_HANDLE_SIZE;
 
 	area = &get_cpu_var(zs_map_area);
 	area->vm_mm = mm;
 	if (off + class->size <= PAGE_SIZE) {
 		/* this object is contained entirely within a page */
 		area->vm_addr = kmap_atomic(page, KM_USER0);
-		return area->vm_addr + off;
+		return area->vm_addr + off + hdr;
 	}
 
 	/* this object spans two pages */
@@ -1016,14 +1519,14 @@ void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 	pages[1] = get_next_page(page);
 	BUG_ON(!pages[1]);
 
-	return __zs_map_object(area, pages, off, class->size);
+	return __zs_map_object(area, pages, off, class->size) + hdr;
 }
 EXPORT_SYMBOL_GPL(zs_map_object);
 
 void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
 {
 	struct page *page;
-	unsigned long obj_idx, off;
+	unsigned long obj_handle, obj_idx, off;
 
 	unsigned int class_idx;
 	enum fullness_group fg;
@@ -1032,7 +1535,8 @@ void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
 
 	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	obj_handle = handle_to_obj(handle);
+	obj_to_location(obj_handle, &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
@@ -1047,9 +1551,11 @@ void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
 		pages[1] = get_next_page(page);
 		BUG_ON(!pages[1]);
 
-		__zs_unmap_object(area, pages, off, class->size);
+		__zs_unmap_object(area, pages, off, class->size,
+				class->huge ? 0 : ZS_HANDLE_SIZE);
 	}
 	put_cpu_var(zs_map_area);
+	unpin_tag(handle);
 }
 EXPORT_SYMBOL_GPL(zs_unmap_object);
 
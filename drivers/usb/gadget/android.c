@@ -77,6 +77,10 @@ struct android_usb_function {
 
 	/* for android_dev.enabled_functions */
 	struct list_head enabled_list;
+	/* for android_dev.bound_functions */
+	struct list_head bound_list;
+	/* an attribute used at bind time was written since the last bind */
+	bool changed;
 
 	/* Optional: initialization during gadget bind */
 	int (*init)(struct android_usb_function *, struct usb_composite_dev *);
@@ -96,10 +100,13 @@ struct android_usb_function {
 struct android_dev {
 	struct android_usb_function **functions;
 	struct list_head enabled_functions;
+	/* the functions in android_config_driver, while it is added */
+	struct list_head bound_functions;
 	struct usb_composite_dev *cdev;
 	struct device *dev;
 
 	bool enabled;
+	bool config_added;
 	bool connected;
 	bool sw_connected;
 	struct work_struct work;
@@ -267,6 +274,7 @@ static ssize_t acm_instances_store(struct device *dev,
 	if (value > MAX_ACM_INSTANCES)
 		value = MAX_ACM_INSTANCES;
 	config->instances = value;
+	f->changed = true;
 	return size;
 }
 
@@ -417,8 +425,10 @@ static ssize_t rndis_manufacturer_store(struct device *dev,
 
 	if (size >= sizeof(config->manufacturer))
 		return -EINVAL;
-	if (sscanf(buf, "%s", config->manufacturer) == 1)
+	if (sscanf(buf, "%s", config->manufacturer) == 1) {
+		f->changed = true;
 		return size;
+	}
 	return -1;
 }
 
@@ -442,6 +452,7 @@ static ssize_t rndis_wceis_store(struct device *dev,
 
 	if (sscanf(buf, "%d", &value) == 1) {
 		config->wceis = value;
+		f->changed = true;
 		return size;
 	}
 	return -EINVAL;
@@ -469,8 +480,10 @@ static ssize_t rndis_ethaddr_store(struct device *dev,
 	if (sscanf(buf, "%02x:%02x:%02x:%02x:%02x:%02x\n",
 		    (int *)&rndis->ethaddr[0], (int *)&rndis->ethaddr[1],
 		    (int *)&rndis->ethaddr[2], (int *)&rndis->ethaddr[3],
-		    (int *)&rndis->ethaddr[4], (int *)&rndis->ethaddr[5]) == 6)
+		    (int *)&rndis->ethaddr[4], (int *)&rndis->ethaddr[5]) == 6) {
+		f->changed = true;
 		return size;
+	}
 	return -EINVAL;
 }
 
@@ -494,6 +507,7 @@ static ssize_t rndis_vendorID_store(struct device *dev,
 
 	if (sscanf(buf, "%04x", &value) == 1) {
 		config->vendorID = value;
+		f->changed = true;
 		return size;
 	}
 	return -EINVAL;
@@ -729,12 +743,15 @@ android_bind_enabled_functions(struct android_dev *dev,
 	struct android_usb_function *f;
 	int ret;
 
+	INIT_LIST_HEAD(&dev->bound_functions);
 	list_for_each_entry(f, &dev->enabled_functions, enabled_list) {
 		ret = f->bind_config(f, c);
 		if (ret) {
 			pr_err("%s: %s failed", __func__, f->name);
 			return ret;
 		}
+		f->changed = false;
+		list_add_tail(&f->bound_list, &dev->bound_functions);
 	}
 	return 0;
 }
@@ -745,10 +762,40 @@ android_unbind_enabled_functions(struct android_dev *dev,
 {
 	struct android_usb_function *f;
 
-	list_for_each_entry(f, &dev->enabled_functions, enabled_list) {
+	list_for_each_entry(f, &dev->bound_functions, bound_list) {
 		if (f->unbind_config)
 			f->unbind_config(f, c);
 	}
+	INIT_LIST_HEAD(&dev->bound_functions);
+}
+
+/*
+ * Whether the configuration still added to the composite device differs
+ * from what userspace asks for now: other functions, in another order,
+ * function settings written since their bind, or other device
+ * descriptor fields.
+ */
+static bool android_config_changed(struct android_dev *dev)
+{
+	struct usb_composite_dev *cdev = dev->cdev;
+	struct list_head *b = dev->bound_functions.next;
+	struct android_usb_function *f;
+
+	list_for_each_entry(f, &dev->enabled_functions, enabled_list) {
+		if (b == &dev->bound_functions ||
+		    b != &f->bound_list || f->changed)
+			return true;
+		b = b->next;
+	}
+	if (b != &dev->bound_functions)
+		return true;
+
+	return cdev->desc.idVendor != device_desc.idVendor ||
+		cdev->desc.idProduct != device_desc.idProduct ||
+		cdev->desc.bcdDevice != device_desc.bcdDevice ||
+		cdev->desc.bDeviceClass != device_desc.bDeviceClass ||
+		cdev->desc.bDeviceSubClass != device_desc.bDeviceSubClass ||
+		cdev->desc.bDeviceProtocol != device_desc.bDeviceProtocol;
 }
 
 static int android_enable_function(struct android_dev *dev, char *name)
@@ -823,20 +870,34 @@ static ssize_t enable_store(struct device *pdev, struct device_attribute *attr,
 
 	sscanf(buff, "%d", &enabled);
 	if (enabled && !dev->enabled) {
-		/* update values in composite driver's copy of device descriptor */
-		cdev->desc.idVendor = device_desc.idVendor;
-		cdev->desc.idProduct = device_desc.idProduct;
-		cdev->desc.bcdDevice = device_desc.bcdDevice;
-		cdev->desc.bDeviceClass = device_desc.bDeviceClass;
-		cdev->desc.bDeviceSubClass = device_desc.bDeviceSubClass;
-		cdev->desc.bDeviceProtocol = device_desc.bDeviceProtocol;
-		usb_add_config(cdev, &android_config_driver,
+		/*
+		 * Disabling only dropped the pullup. Userspace re-enabling
+		 * the same functions (the usual disable, write functions,
+		 * enable sequence) keeps the bound functions and their
+		 * requests and only reconnects.
+		 */
+		if (dev->config_added && android_config_changed(dev)) {
+			usb_remove_config(cdev, &android_config_driver);
+			dev->config_added = false;
+		}
+		if (!dev->config_added) {
+			/* update values in composite driver's copy of device descriptor */
+			cdev->desc.idVendor = device_desc.idVendor;
+			cdev->desc.idProduct = device_desc.idProduct;
+			cdev->desc.bcdDevice = device_desc.bcdDevice;
+			cdev->desc.bDeviceClass = device_desc.bDeviceClass;
+			cdev->desc.bDeviceSubClass = device_desc.bDeviceSubClass;
+			cdev->desc.bDeviceProtocol = device_desc.bDeviceProtocol;
+			dev->config_added = !usb_add_config(cdev,
+					&android_config_driver,
 					android_bind_config);
+		}
 		usb_gadget_connect(cdev->gadget);
 		dev->enabled = true;
 	} else if (!enabled && dev->enabled) {
 		usb_gadget_disconnect(cdev->gadget);
-		usb_remove_config(cdev, &android_config_driver);
+		/* the functions stay bound, only reset them */
+		composite_disconnect(cdev->gadget);
 		dev->enabled = false;
 	} else {
 		pr_err("android_usb: already %s\n",
@@ -1023,6 +1084,7 @@ static int android_usb_unbind(struct usb_composite_dev *cdev)
 	struct android_dev *dev = _android_dev;
 
 	cancel_work_sync(&dev->work);
+	dev->config_added = false;
 	android_cleanup_functions(dev->functions);
 	return 0;
 }
@@ -1132,6 +1194,7 @@ static int __init init(void)
 
 	dev->functions = supported_functions;
 	INIT_LIST_HEAD(&dev->enabled_functions);
+	INIT_LIST_HEAD(&dev->bound_functions);
 	INIT_WORK(&dev->work, android_work);
 
 	err = android_create_device(dev);
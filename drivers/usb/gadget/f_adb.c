@@ -26,8 +26,12 @@
 #include <linux/types.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
 
-#define ADB_BULK_BUFFER_SIZE           4096
+/* the largest request msm72k_udc takes; a write of up to this
+ * size goes out as one transfer */
+#define ADB_BULK_BUFFER_SIZE           16384
 
 /* number of tx requests to allocate */
 #define TX_REQ_MAX 4
@@ -404,6 +408,125 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/* a tx request being filled from a pipe by adb_splice_write() */
+struct adb_splice_state {
+	struct adb_dev *dev;
+	struct usb_request *req;
+};
+
+static int adb_splice_send(struct adb_splice_state *st)
+{
+	struct adb_dev *dev = st->dev;
+	struct usb_request *req = st->req;
+	int ret;
+
+	st->req = 0;
+	ret = usb_ep_queue(dev->ep_in, req, GFP_ATOMIC);
+	if (ret < 0) {
+		pr_debug("adb_splice_write: xfer error %d\n", ret);
+		dev->error = 1;
+		adb_req_put(dev, &dev->tx_idle, req);
+		return -EIO;
+	}
+	return 0;
+}
+
+/*
+ * Packs the pipe buffers into tx requests and queues each one once it is
+ * full, so that a page cache pipe goes out in ADB_BULK_BUFFER_SIZE
+ * transfers with a single copy instead of a page per write().
+ */
+static int adb_splice_actor(struct pipe_inode_info *pipe,
+			    struct pipe_buffer *buf, struct splice_desc *sd)
+{
+	struct adb_splice_state *st = sd->u.data;
+	struct adb_dev *dev = st->dev;
+	unsigned int done = 0, xfer;
+	char *src;
+	int ret;
+
+	ret = buf->ops->confirm(pipe, buf);
+	if (ret)
+		return ret;
+
+	while (done < sd->len) {
+		if (dev->error) {
+			ret = -EIO;
+			break;
+		}
+
+		if (!st->req) {
+			ret = wait_event_interruptible(dev->write_wq,
+				(st->req = adb_req_get(dev, &dev->tx_idle)) ||
+				dev->error);
+			if (ret < 0)
+				break;
+			if (!st->req)
+				continue;
+			st->req->length = 0;
+		}
+
+		xfer = min_t(unsigned int, sd->len - done,
+			     ADB_BULK_BUFFER_SIZE - st->req->length);
+		src = buf->ops->map(pipe, buf, 0);
+		memcpy(st->req->buf + st->req->length,
+		       src + buf->offset + done, xfer);
+		buf->ops->unmap(pipe, buf, src);
+		st->req->length += xfer;
+		done += xfer;
+
+		if (st->req->length == ADB_BULK_BUFFER_SIZE) {
+			ret = adb_splice_send(st);
+			if (ret < 0)
+				break;
+		}
+	}
+
+	return done ? done : ret;
+}
+
+static ssize_t adb_splice_write(struct pipe_inode_info *pipe,
+				struct file *fp, loff_t *ppos,
+				size_t len, unsigned int flags)
+{
+	struct adb_dev *dev = fp->private_data;
+	struct adb_splice_state st = { .dev = dev };
+	struct splice_desc sd = {
+		.total_len = len,
+		.flags = flags,
+		.pos = *ppos,
+		.u.data = &st,
+	};
+	ssize_t r;
+	int ret;
+
+	if (!_adb_dev)
+		return -ENODEV;
+	pr_debug("adb_splice_write(%d)\n", len);
+
+	if (adb_lock(&dev->write_excl))
+		return -EBUSY;
+
+	pipe_lock(pipe);
+	r = __splice_from_pipe(pipe, &sd, adb_splice_actor);
+	pipe_unlock(pipe);
+
+	/* send what is left over */
+	if (st.req) {
+		if (st.req->length && !dev->error) {
+			ret = adb_splice_send(&st);
+			if (ret < 0)
+				r = ret;
+		} else {
+			adb_req_put(dev, &dev->tx_idle, st.req);
+		}
+	}
+
+	adb_unlock(&dev->write_excl);
+	pr_debug("adb_splice_write returning %d\n", r);
+	return r;
+}
+
 static int adb_open(struct inode *ip, struct file *fp)
 {
 	printk(KERN_INFO "adb_open\n");
@@ -433,6 +556,7 @@ static struct file_operations adb_fops = {
 	.owner = THIS_MODULE,
 	.read = adb_read,
 	.write = adb_write,
+	.splice_write = adb_splice_write,
 	.open = adb_open,
 	.release = adb_release,
 };
@@ -28,6 +28,8 @@
 
 #include <linux/types.h>
 #include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/backing-dev.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 
@@ -49,9 +51,11 @@
 #define STATE_CANCELED              3   /* transaction canceled by host */
 #define STATE_ERROR                 4   /* error from completion routine */
 
-/* number of tx and rx requests to allocate */
-#define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+/* number of tx and rx requests to allocate. The udc takes at most
+ * 16K per request, so file transfers keep several of them queued.
+ */
+#define TX_REQ_MAX 8
+#define RX_REQ_MAX 8
 #define INTR_REQ_MAX 5
 
 /* ID for Microsoft MTP OS String */
@@ -92,7 +96,7 @@ struct mtp_dev {
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
-	int rx_done;
+	int rx_done;		/* rx requests completed since last reset */
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
@@ -361,7 +365,7 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
+	dev->rx_done++;
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
@@ -627,6 +631,19 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/* what POSIX_FADV_SEQUENTIAL does: the whole file is about to be
+ * read front to back, so double the read-ahead window
+ */
+static void mtp_file_sequential(struct file *filp)
+{
+	struct backing_dev_info *bdi = filp->f_mapping->backing_dev_info;
+
+	filp->f_ra.ra_pages = bdi->ra_pages * 2;
+	spin_lock(&filp->f_lock);
+	filp->f_mode &= ~FMODE_RANDOM;
+	spin_unlock(&filp->f_lock);
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data) {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, send_file_work);
@@ -648,6 +665,8 @@ static void send_file_work(struct work_struct *data) {
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
+	mtp_file_sequential(filp);
+
 	if (dev->xfer_send_header) {
 		hdr_size = sizeof(struct mtp_data_header);
 		count += hdr_size;
@@ -727,16 +746,22 @@ static void send_file_work(struct work_struct *data) {
 	smp_wmb();
 }
 
+static void mtp_rx_dequeue(struct mtp_dev *dev, int from, int to)
+{
+	for (; from < to; from++)
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[from % RX_REQ_MAX]);
+}
+
 /* read from USB and write to a local file */
 static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
 	loff_t offset;
 	int64_t count;
-	int ret, cur_buf = 0;
+	int ret, queued = 0, done = 0, depth;
 	int r = 0;
 
 	/* read our parameters */
@@ -747,62 +772,65 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	/* Keep up to RX_REQ_MAX reads queued while writing out the ones
+	 * that completed, but never ask for more than is left or the next
+	 * command would be read into the file. If xfer_file_length is
+	 * 0xFFFFFFFF we read until we get a short packet, so only one
+	 * read can be outstanding.
+	 */
+	depth = (count == 0xFFFFFFFF) ? 1 : RX_REQ_MAX;
+	dev->rx_done = 0;
 
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
+	while (1) {
+		while (count > 0 && queued - done < depth) {
+			req = dev->rx_req[queued % RX_REQ_MAX];
+			req->length = (count > MTP_BULK_BUFFER_SIZE
 					? MTP_BULK_BUFFER_SIZE : count);
-			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
 				break;
 			}
+			if (count != 0xFFFFFFFF)
+				count -= req->length;
+			queued++;
 		}
+		if (r || queued == done)
+			break;
 
-		if (write_req) {
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				dev->state = STATE_ERROR;
-				break;
-			}
-			write_req = NULL;
+		/* wait for the oldest read to complete */
+		wait_event_interruptible(dev->read_wq,
+			dev->rx_done > done || dev->state != STATE_BUSY);
+		if (dev->state != STATE_BUSY) {
+			r = (dev->state == STATE_CANCELED) ? -ECANCELED : -EIO;
+			break;
 		}
+		if (dev->rx_done <= done)
+			continue;
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
-			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/* short packet is used to signal EOF for sizes > 4 gig */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+		req = dev->rx_req[done % RX_REQ_MAX];
+		done++;
 
-			write_req = read_req;
-			read_req = NULL;
+		DBG(cdev, "rx %p %d\n", req, req->actual);
+		ret = vfs_write(filp, req->buf, req->actual, &offset);
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			break;
+		}
+
+		if (req->actual < req->length) {
+			/* short packet is used to signal EOF for sizes > 4 gig */
+			DBG(cdev, "got short packet\n");
+			break;
 		}
 	}
 
+	/* reads past the end, or left over after an error */
+	mtp_rx_dequeue(dev, done, queued);
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
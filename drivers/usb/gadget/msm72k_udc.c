@@ -487,8 +487,10 @@ static void init_endpoints(struct usb_info *ui)
 			ept->head = ui->head + (ept->num << 1);
 			ept->flags = 0;
 		}
-		setup_timer(&ept->prime_timer, ept_prime_timer_func,
-			(unsigned long) ept);
+		/* Only a watchdog for a stuck prime, no need to wake for it */
+		init_timer_deferrable(&ept->prime_timer);
+		ept->prime_timer.function = ept_prime_timer_func;
+		ept->prime_timer.data = (unsigned long) ept;
 
 	}
 }
@@ -628,6 +630,18 @@ out:
 	spin_unlock_irqrestore(&ui->lock, flags);
 }
 
+/* prepare the transaction descriptor item for the hardware */
+static void usb_ept_fill_item(struct msm_request *req)
+{
+	req->live = 1;
+	req->item->info =
+		INFO_BYTES(req->req.length) | INFO_IOC | INFO_ACTIVE;
+	req->item->page0 = req->dma;
+	req->item->page1 = (req->dma + 0x1000) & 0xfffff000;
+	req->item->page2 = (req->dma + 0x2000) & 0xfffff000;
+	req->item->page3 = (req->dma + 0x3000) & 0xfffff000;
+}
+
 static void usb_ept_start(struct msm_endpoint *ept)
 {
 	struct usb_info *ui = ept->ui;
@@ -637,14 +651,7 @@ static void usb_ept_start(struct msm_endpoint *ept)
 	BUG_ON(req->live);
 
 	while (req) {
-		req->live = 1;
-		/* prepare the transaction descriptor item for the hardware */
-		req->item->info =
-			INFO_BYTES(req->req.length) | INFO_IOC | INFO_ACTIVE;
-		req->item->page0 = req->dma;
-		req->item->page1 = (req->dma + 0x1000) & 0xfffff000;
-		req->item->page2 = (req->dma + 0x2000) & 0xfffff000;
-		req->item->page3 = (req->dma + 0x3000) & 0xfffff000;
+		usb_ept_fill_item(req);
 
 		if (req->next == NULL) {
 			req->item->next = TERMINATE;
@@ -672,6 +679,59 @@ static void usb_ept_start(struct msm_endpoint *ept)
 	mod_timer(&ept->prime_timer, EPT_PRIME_CHECK_DELAY);
 }
 
+/*
+ * Add @req to the end of the dTD list the endpoint is working on, so
+ * that it doesn't go idle until handle_endpoint() restarts it. Uses
+ * the add dTD tripwire to find out whether the controller was still
+ * running the list when the link was made; if it wasn't, and the list
+ * has been retired, the endpoint is primed again on @req.
+ * Called with ui->lock held.
+ */
+static void usb_ept_append(struct msm_endpoint *ept, struct msm_request *last,
+			   struct msm_request *req)
+{
+	struct usb_info *ui = ept->ui;
+	unsigned n = 1 << ept->bit;
+	unsigned stat;
+
+	usb_ept_fill_item(req);
+	req->item->next = TERMINATE;
+
+	/* the new dTD must be complete before it is linked */
+	wmb();
+	last->item->next = req->item_dma;
+	mb();
+
+	/* a prime in progress will pick up the new link */
+	if (readl_relaxed(USB_ENDPTPRIME) & n)
+		return;
+
+	do {
+		writel_relaxed(readl_relaxed(USB_USBCMD) | USBCMD_ATDTW,
+			       USB_USBCMD);
+		stat = readl_relaxed(USB_ENDPTSTAT) & n;
+	} while (!(readl_relaxed(USB_USBCMD) & USBCMD_ATDTW));
+	writel_relaxed(readl_relaxed(USB_USBCMD) & ~USBCMD_ATDTW, USB_USBCMD);
+
+	if (stat)
+		return;
+
+	/* clean speculative fetches on last->item->info */
+	dma_coherent_post_ops();
+	if (last->item->info & INFO_ACTIVE) {
+		/* not running with work left: a failed prime, which
+		 * ept_prime_timer_func() retries with the new link in */
+		mod_timer(&ept->prime_timer, EPT_PRIME_CHECK_DELAY);
+		return;
+	}
+
+	ept->head->next = req->item_dma;
+	ept->head->info = 0;
+	mb();
+	writel_relaxed(n, USB_ENDPTPRIME);
+	mod_timer(&ept->prime_timer, EPT_PRIME_CHECK_DELAY);
+}
+
 int usb_ept_queue_xfer(struct msm_endpoint *ept, struct usb_request *_req)
 {
 	unsigned long flags;
@@ -744,11 +804,15 @@ int usb_ept_queue_xfer(struct msm_endpoint *ept, struct usb_request *_req)
 	last = ept->last;
 	if (last) {
 		/* Already requests in the queue. add us to the
-		 * end, but let the completion interrupt actually
-		 * start things going, to avoid hw issues
+		 * end; on ep0, or if the hardware hasn't been given
+		 * the rest of the queue yet, let the completion
+		 * interrupt actually start things going, to avoid
+		 * hw issues
 		 */
 		last->next = req;
 		req->prev = last;
+		if (ept->num != 0 && last->live)
+			usb_ept_append(ept, last, req);
 
 	} else {
 		/* queue was empty -- kick the hardware */
@@ -1122,7 +1186,8 @@ ack:
 static void handle_endpoint(struct usb_info *ui, unsigned bit)
 {
 	struct msm_endpoint *ept = ui->ept + bit;
-	struct msm_request *req;
+	struct msm_request *req, *next;
+	struct msm_request *done = NULL, **done_tail = &done;
 	unsigned long flags;
 	unsigned info;
 
@@ -1177,13 +1242,21 @@ static void handle_endpoint(struct usb_info *ui, unsigned bit)
 		req->busy = 0;
 		req->live = 0;
 
-		if (req->req.complete) {
-			spin_unlock_irqrestore(&ui->lock, flags);
-			req->req.complete(&ept->ep, &req->req);
-			spin_lock_irqsave(&ui->lock, flags);
-		}
+		/* complete them all once the lock is dropped */
+		req->next = NULL;
+		*done_tail = req;
+		done_tail = &req->next;
 	}
 	spin_unlock_irqrestore(&ui->lock, flags);
+
+	/* The gadget driver may requeue or free a request in its
+	 * completion handler, so get the next one first.
+	 */
+	for (req = done; req; req = next) {
+		next = req->next;
+		if (req->req.complete)
+			req->req.complete(&ept->ep, &req->req);
+	}
 }
 
 static void flush_endpoint_hw(struct usb_info *ui, unsigned bits)
@@ -2666,8 +2739,11 @@ static int msm72k_probe(struct platform_device *pdev)
 	pm_runtime_enable(&pdev->dev);
 
 	/* Setup phy stuck timer */
-	if (ui->pdata && ui->pdata->is_phy_status_timer_on)
-		setup_timer(&phy_status_timer, usb_phy_status_check_timer, 0);
+	if (ui->pdata && ui->pdata->is_phy_status_timer_on) {
+		init_timer_deferrable(&phy_status_timer);
+		phy_status_timer.function = usb_phy_status_check_timer;
+		phy_status_timer.data = 0;
+	}
 	return 0;
 }
 
@@ -597,6 +597,9 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 		return -ENOMEM;
 	resp = (rndis_init_cmplt_type *)r->buf;
 
+	/* how much the host takes in one transfer from us */
+	params->host_max_xfer_size = get_unaligned_le32(&buf->MaxTransferSize);
+
 	resp->MessageType = cpu_to_le32(REMOTE_NDIS_INITIALIZE_CMPLT);
 	resp->MessageLength = cpu_to_le32(52);
 	resp->RequestID = buf->RequestID; /* Still LE in msg buffer */
@@ -605,12 +608,12 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32(RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32(RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32(RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32(1);
-	resp->MaxTransferSize = cpu_to_le32(
-		  params->dev->mtu
+	resp->MaxPacketsPerTransfer = cpu_to_le32(params->max_pkt_per_xfer);
+	resp->MaxTransferSize = cpu_to_le32(params->max_pkt_per_xfer *
+		(params->dev->mtu
 		+ sizeof(struct ethhdr)
 		+ sizeof(struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = cpu_to_le32(0);
 	resp->AFListOffset = cpu_to_le32(0);
 	resp->AFListSize = cpu_to_le32(0);
@@ -810,6 +813,25 @@ void rndis_set_host_mac(int configNr, const u8 *addr)
 	rndis_per_dev_params[configNr].host_mac = addr;
 }
 
+/* Packets the host may send in one transfer, from the next INIT on */
+void rndis_set_max_pkt_xfer(u8 configNr, u32 max_pkt_per_xfer)
+{
+	if (configNr >= RNDIS_MAX_CONFIGS)
+		return;
+
+	rndis_per_dev_params[configNr].max_pkt_per_xfer =
+			max_t(u32, max_pkt_per_xfer, 1);
+}
+
+/* MaxTransferSize from the host's INIT message, 0 until there was one */
+u32 rndis_get_host_max_xfer_size(u8 configNr)
+{
+	if (configNr >= RNDIS_MAX_CONFIGS)
+		return 0;
+
+	return rndis_per_dev_params[configNr].host_max_xfer_size;
+}
+
 /*
  * Message Parser
  */
@@ -922,6 +944,8 @@ int rndis_register(void (*resp_avail)(void *v), void *v)
 			rndis_per_dev_params[i].used = 1;
 			rndis_per_dev_params[i].resp_avail = resp_avail;
 			rndis_per_dev_params[i].v = v;
+			rndis_per_dev_params[i].max_pkt_per_xfer = 1;
+			rndis_per_dev_params[i].host_max_xfer_size = 0;
 			pr_debug("%s: configNr = %d\n", __func__, i);
 			return i;
 		}
@@ -1043,27 +1067,57 @@ static rndis_resp_t *rndis_add_response(int configNr, u32 length)
 	return r;
 }
 
+/*
+ * A transfer may hold several packet messages (see max_pkt_per_xfer).
+ * All but the last are queued as clones sharing the transfer's data.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32 *tmp = (void *)skb->data;
+	struct sk_buff *skb2;
+	__le32 *tmp;
+	u32 msg_len, data_offset, data_len;
+	int first = 1;
+
+	for (;;) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		tmp = (void *)skb->data;
+
+		/* MessageType, MessageLength */
+		if (skb->len < 16 || cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(tmp++)) {
+			dev_kfree_skb_any(skb);
+			/* anything after the first packet is padding */
+			return first ? -EINVAL : 0;
+		}
+		msg_len = get_unaligned_le32(tmp++);
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++);
+		data_len = get_unaligned_le32(tmp++);
+
+		if (msg_len == 0 || msg_len >= skb->len)
+			break;		/* the last one */
+
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2 || !skb_pull(skb2, data_offset + 8)) {
+			dev_kfree_skb_any(skb2);
+			dev_kfree_skb_any(skb);
+			return -ENOMEM;
+		}
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
+
+		skb_pull(skb, msg_len);
+		first = 0;
 	}
-	tmp++;
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
+	if (!skb_pull(skb, data_offset + 8)) {
 		dev_kfree_skb_any(skb);
 		return -EOVERFLOW;
 	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
+	skb_trim(skb, data_len);
 
 	skb_queue_tail(list, skb);
 	return 0;
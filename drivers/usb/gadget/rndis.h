@@ -239,6 +239,9 @@ typedef struct rndis_params
 	void			(*resp_avail)(void *v);
 	void			*v;
 	struct list_head	resp_queue;
+
+	u32			max_pkt_per_xfer;	/* host to device */
+	u32			host_max_xfer_size;	/* device to host */
 } rndis_params;
 
 /* RNDIS Message parser and other useless functions */
@@ -261,6 +264,8 @@ int  rndis_signal_connect (int configNr);
 int  rndis_signal_disconnect (int configNr);
 int  rndis_state (int configNr);
 extern void rndis_set_host_mac (int configNr, const u8 *addr);
+void rndis_set_max_pkt_xfer(u8 configNr, u32 max_pkt_per_xfer);
+u32  rndis_get_host_max_xfer_size(u8 configNr);
 
 int rndis_init(void);
 void rndis_exit (void);
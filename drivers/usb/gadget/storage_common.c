@@ -274,10 +274,14 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
 /* Number of buffers for CBW, DATA and CSW */
-#ifdef CONFIG_USB_CSW_HACK
+#ifndef CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS
+#define CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS 2
+#endif
+
+#if defined(CONFIG_USB_CSW_HACK) && CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS < 4
 #define FSG_NUM_BUFFERS    4
 #else
-#define FSG_NUM_BUFFERS    2
+#define FSG_NUM_BUFFERS    CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS
 #endif
 
 
@@ -71,6 +71,16 @@ struct eth_dev {
 
 	struct sk_buff_head	rx_frames;
 
+	/* several packets per tx transfer: each tx request then owns a
+	 * buffer of tx_agg_len bytes they are copied into. tx_agg_req is
+	 * being filled while earlier transfers are on the wire, guarded
+	 * by req_lock.
+	 */
+	unsigned		tx_agg_len;
+	unsigned		tx_agg_max;
+	struct usb_request	*tx_agg_req;
+	unsigned		tx_agg_count;
+
 	unsigned		header_len;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
 	int			(*unwrap)(struct gether *,
@@ -237,6 +247,8 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	if (dev->port_usb->ul_max_pkts_per_xfer > 1)
+		size *= dev->port_usb->ul_max_pkts_per_xfer;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -408,6 +420,18 @@ extra:
 	return 0;
 }
 
+/* called with req_lock held */
+static void tx_agg_free(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		kfree(req->buf);
+		req->buf = NULL;
+	}
+	dev->tx_agg_len = 0;
+}
+
 static int alloc_requests(struct eth_dev *dev, struct gether *link, unsigned n)
 {
 	int	status;
@@ -419,6 +443,31 @@ static int alloc_requests(struct eth_dev *dev, struct gether *link, unsigned n)
 	status = prealloc(&dev->rx_reqs, link->out_ep, n);
 	if (status < 0)
 		goto fail;
+
+	dev->tx_agg_len = 0;
+	if (link->dl_max_pkts_per_xfer > 1) {
+		struct usb_request	*req;
+		unsigned		len;
+
+		/* room for a zlp byte too */
+		len = link->dl_max_pkts_per_xfer * (dev->net->mtu +
+				sizeof(struct ethhdr) + link->header_len);
+		list_for_each_entry(req, &dev->tx_reqs, list)
+			req->buf = NULL;
+		list_for_each_entry(req, &dev->tx_reqs, list) {
+			req->buf = kmalloc(len + 1, GFP_ATOMIC);
+			if (!req->buf)
+				goto agg_fail;
+		}
+		dev->tx_agg_len = len;
+		dev->tx_agg_max = link->dl_max_pkts_per_xfer;
+	}
+	goto done;
+agg_fail:
+	/* carry on a packet per transfer */
+	DBG(dev, "no tx aggregation buffers\n");
+	tx_agg_free(dev);
+	status = 0;
 	goto done;
 fail:
 	DBG(dev, "can't alloc requests\n");
@@ -463,11 +512,37 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_agg_queue(struct eth_dev *dev, struct usb_ep *in,
+			 struct usb_request *req);
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
 
+	if (!skb) {
+		/* aggregated; packets were counted when copied in */
+		if (req->status && req->status != -ECONNRESET &&
+		    req->status != -ESHUTDOWN) {
+			dev->net->stats.tx_errors++;
+			VDBG(dev, "tx err %d\n", req->status);
+		}
+
+		/* send what piled up while this was on the wire */
+		spin_lock(&dev->req_lock);
+		list_add(&req->list, &dev->tx_reqs);
+		atomic_dec(&dev->tx_qlen);
+		req = dev->tx_agg_req;
+		dev->tx_agg_req = NULL;
+		if (req)
+			tx_agg_queue(dev, ep, req);
+		spin_unlock(&dev->req_lock);
+
+		if (netif_carrier_ok(dev->net))
+			netif_wake_queue(dev->net);
+		return;
+	}
+
 	switch (req->status) {
 	default:
 		dev->net->stats.tx_errors++;
@@ -499,6 +574,102 @@ static inline int is_promisc(u16 cdc_filter)
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+/* Start an aggregated transfer; called with req_lock held */
+static void tx_agg_queue(struct eth_dev *dev, struct usb_ep *in,
+			 struct usb_request *req)
+{
+	req->context = NULL;
+	req->complete = tx_complete;
+	req->no_interrupt = 0;
+	req->zero = 1;
+	if (!dev->zlp && (req->length % in->maxpacket) == 0)
+		req->length++;
+
+	if (usb_ep_queue(in, req, GFP_ATOMIC)) {
+		DBG(dev, "tx queue err\n");
+		dev->net->stats.tx_dropped++;
+		list_add(&req->list, &dev->tx_reqs);
+		return;
+	}
+
+	dev->net->trans_start = jiffies;
+	atomic_inc(&dev->tx_qlen);
+}
+
+/*
+ * Copy @skb into the request being filled. That is sent once it holds
+ * tx_agg_max packets or the next one might not fit, or straight away if
+ * nothing else is on the wire; otherwise tx_complete() sends it, so
+ * packets only wait while the link is busy anyway.
+ */
+static netdev_tx_t eth_agg_xmit(struct eth_dev *dev, struct sk_buff *skb,
+				struct usb_ep *in, u32 host_max)
+{
+	struct net_device	*net = dev->net;
+	struct usb_request	*req;
+	unsigned long		flags;
+	unsigned		limit, max;
+
+	limit = dev->tx_agg_len;
+	max = dev->tx_agg_max;
+	if (!host_max)
+		max = 1;
+	else if (host_max < limit)
+		limit = host_max;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_agg_req;
+	dev->tx_agg_req = NULL;
+	if (req && req->length + skb->len + dev->header_len > limit) {
+		tx_agg_queue(dev, in, req);
+		req = NULL;
+	}
+	if (!req) {
+		if (list_empty(&dev->tx_reqs)) {
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			return NETDEV_TX_BUSY;
+		}
+		req = container_of(dev->tx_reqs.next, struct usb_request, list);
+		list_del(&req->list);
+		req->length = 0;
+		dev->tx_agg_count = 0;
+
+		/* temporarily stop TX queue when the freelist empties */
+		if (list_empty(&dev->tx_reqs))
+			netif_stop_queue(net);
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	/* req is ours alone until it goes back to tx_agg_req */
+	if (dev->wrap) {
+		spin_lock_irqsave(&dev->lock, flags);
+		if (dev->port_usb)
+			skb = dev->wrap(dev->port_usb, skb);
+		spin_unlock_irqrestore(&dev->lock, flags);
+	}
+
+	if (skb) {
+		memcpy(req->buf + req->length, skb->data, skb->len);
+		req->length += skb->len;
+		dev->tx_agg_count++;
+		net->stats.tx_packets++;
+		net->stats.tx_bytes += skb->len;
+		dev_kfree_skb_any(skb);
+	} else
+		net->stats.tx_dropped++;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (!req->length)
+		list_add(&req->list, &dev->tx_reqs);
+	else if (dev->tx_agg_count >= max || !atomic_read(&dev->tx_qlen))
+		tx_agg_queue(dev, in, req);
+	else
+		dev->tx_agg_req = req;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	return NETDEV_TX_OK;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
@@ -509,14 +680,17 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	u32			host_max;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
+		host_max = dev->port_usb->dl_max_xfer_size;
 	} else {
 		in = NULL;
 		cdc_filter = 0;
+		host_max = 0;
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
@@ -547,6 +721,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (dev->tx_agg_len)
+		return eth_agg_xmit(dev, skb, in, host_max);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -1001,6 +1178,12 @@ void gether_disconnect(struct gether *link)
 	 */
 	usb_ep_disable(link->in_ep);
 	spin_lock(&dev->req_lock);
+	if (dev->tx_agg_req) {
+		list_add(&dev->tx_agg_req->list, &dev->tx_reqs);
+		dev->tx_agg_req = NULL;
+	}
+	if (dev->tx_agg_len)
+		tx_agg_free(dev);
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
@@ -66,6 +66,13 @@ struct gether {
 	bool				is_fixed;
 	u32				fixed_out_len;
 	u32				fixed_in_len;
+	/* several packets per transfer, as RNDIS allows; 0 or 1 if not.
+	 * dl_max_xfer_size is how much the host takes in one transfer,
+	 * 0 while that isn't known yet.
+	 */
+	unsigned			ul_max_pkts_per_xfer;	/* to us */
+	unsigned			dl_max_pkts_per_xfer;	/* to host */
+	u32				dl_max_xfer_size;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
@@ -873,6 +873,15 @@ error:
 static void vsync_isr_handler(void)
 {
 	vsync_cntrl.vsync_time = ktime_get();
+	if (vsync_cntrl.vsync_irq_enabled)
+		schedule_work(&vsync_cntrl.vsync_work);
+}
+
+/* Wake poll() on vsync_event */
+static void vsync_notify_work(struct work_struct *work)
+{
+	if (vsync_cntrl.dev)
+		sysfs_notify(&vsync_cntrl.dev->kobj, NULL, "vsync_event");
 }
 
 /* Returns < 0 on error, 0 on timeout, or > 0 on successful wait */
@@ -1306,7 +1315,9 @@ irqreturn_t mdp_isr(int irq, void *ptr)
 		if (mdp_interrupt & LCDC_FRAME_START) {
 			dma = &dma2_data;
 			spin_lock_irqsave(&mdp_spin_lock, flag);
-			vsync_isr = vsync_cntrl.vsync_irq_enabled;
+			/* keep the interrupt while a flip waits for it */
+			vsync_isr = vsync_cntrl.vsync_irq_enabled |
+				mdp_lcdc_flip_latched();
 			disabled_clocks = vsync_cntrl.disabled_clocks;
 			/* let's disable LCDC interrupt */
 			if (dma->waiting) {
@@ -1429,6 +1440,7 @@ static void mdp_drv_init(void)
 	dma2_data.waiting = FALSE;
 	init_completion(&dma2_data.comp);
 	init_completion(&vsync_cntrl.vsync_comp);
+	INIT_WORK(&vsync_cntrl.vsync_work, vsync_notify_work);
 	init_MUTEX(&dma2_data.mutex);
 	mutex_init(&dma2_data.ov_mutex);
 
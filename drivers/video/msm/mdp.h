@@ -704,6 +704,10 @@ void mdp_set_dma_pan_info(struct fb_info *info, struct mdp_dirty_region *dirty,
 void mdp_dma_pan_update(struct fb_info *info);
 void mdp_refresh_screen(unsigned long data);
 int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req);
+int mdp_ppp_blit_fb(struct fb_info *info, struct mdp_blit_req *req);
+int mdp_ppp_blit_check(struct fb_info *info, struct mdp_blit_req *req);
+void mdp_ppp_blit_begin(void);
+void mdp_ppp_blit_end(void);
 void mdp_lcd_update_workqueue_handler(struct work_struct *work);
 void mdp_vsync_resync_workqueue_handler(struct work_struct *work);
 void mdp_dma2_update(struct msm_fb_data_type *mfd);
@@ -737,6 +741,7 @@ void mdp_dma3_update(struct msm_fb_data_type *mfd);
 int mdp_lcdc_on(struct platform_device *pdev);
 int mdp_lcdc_off(struct platform_device *pdev);
 void mdp_lcdc_update(struct msm_fb_data_type *mfd);
+int mdp_lcdc_flip_latched(void);
 
 #ifdef CONFIG_FB_MSM_MDP303
 int mdp_dsi_video_on(struct platform_device *pdev);
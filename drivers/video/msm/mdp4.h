@@ -271,6 +271,8 @@ struct mdp4_iommu_pipe_info {
 	u8 mark_unmap;
 };
 
+#define MDP4_PIPE_SHADOW_REGS	32
+
 struct mdp4_overlay_pipe {
 	uint32 pipe_used;
 	uint32 pipe_type;		/* rgb, video/graphic */
@@ -347,6 +349,13 @@ struct mdp4_overlay_pipe {
 	uint32 luma_align_size;
 	struct mdp4_hsic_regs hsic_regs;
 	struct completion dmas_comp;
+	/*
+	 * Last values written to the RGB pipe geometry and address
+	 * registers, indexed by offset / 4, for the ones set in
+	 * shadow_valid
+	 */
+	uint32 shadow[MDP4_PIPE_SHADOW_REGS];
+	uint32 shadow_valid;
 	struct mdp_overlay req_data;
 };
 
@@ -394,6 +403,7 @@ struct mdp4_statistic {
 	ulong err_stage;
 	ulong err_play;
 	ulong err_underflow;
+	ulong pipe_reg_skip;	/* unchanged pipe registers not written */
 };
 
 struct mdp4_overlay_pipe *mdp4_overlay_ndx2pipe(int ndx);
@@ -535,6 +545,7 @@ int mdp4_overlay_play_wait(struct fb_info *info,
 int mdp4_overlay_play(struct fb_info *info, struct msmfb_overlay_data *req);
 struct mdp4_overlay_pipe *mdp4_overlay_pipe_alloc(int ptype, int mixer);
 void mdp4_overlay_pipe_free(struct mdp4_overlay_pipe *pipe);
+void mdp4_overlay_shadow_reset(void);
 void mdp4_overlay_dmap_cfg(struct msm_fb_data_type *mfd, int lcdc);
 void mdp4_overlay_dmap_xy(struct mdp4_overlay_pipe *pipe);
 void mdp4_overlay_dmae_cfg(struct msm_fb_data_type *mfd, int atv);
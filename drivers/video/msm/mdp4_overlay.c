@@ -542,6 +542,35 @@ static void mdp4_scale_setup(struct mdp4_overlay_pipe *pipe)
 	}
 }
 
+/*
+ * Write an RGB pipe register unless it already holds the value. A static
+ * layer played again only changes nothing, or just its buffer address.
+ * Only for registers nothing but mdp4_overlay_rgb_setup() writes.
+ */
+static void mdp4_pipe_outpdw(struct mdp4_overlay_pipe *pipe, char *base,
+			     uint32 off, uint32 val)
+{
+	uint32 bit = 1 << (off >> 2);
+
+	if ((pipe->shadow_valid & bit) && pipe->shadow[off >> 2] == val) {
+		mdp4_stat.pipe_reg_skip++;
+		return;
+	}
+
+	outpdw(base + off, val);
+	pipe->shadow[off >> 2] = val;
+	pipe->shadow_valid |= bit;
+}
+
+/* The MDP lost its registers, write everything on the next setup */
+void mdp4_overlay_shadow_reset(void)
+{
+	int i;
+
+	for (i = 0; i < OVERLAY_PIPE_MAX; i++)
+		ctrl->plist[i].shadow_valid = 0;
+}
+
 void mdp4_overlay_rgb_setup(struct mdp4_overlay_pipe *pipe)
 {
 	char *rgb_base;
@@ -587,16 +616,22 @@ void mdp4_overlay_rgb_setup(struct mdp4_overlay_pipe *pipe)
 	mask = 0xFFFEFFFF;
 	pipe->op_mode = (pipe->op_mode & mask) | (curr & ~mask);
 
-	outpdw(rgb_base + 0x0000, src_size);	/* MDP_RGB_SRC_SIZE */
-	outpdw(rgb_base + 0x0004, src_xy);	/* MDP_RGB_SRC_XY */
-	outpdw(rgb_base + 0x0008, dst_size);	/* MDP_RGB_DST_SIZE */
-	outpdw(rgb_base + 0x000c, dst_xy);	/* MDP_RGB_DST_XY */
+	/* MDP_RGB_SRC_SIZE */
+	mdp4_pipe_outpdw(pipe, rgb_base, 0x0000, src_size);
+	/* MDP_RGB_SRC_XY */
+	mdp4_pipe_outpdw(pipe, rgb_base, 0x0004, src_xy);
+	/* MDP_RGB_DST_SIZE */
+	mdp4_pipe_outpdw(pipe, rgb_base, 0x0008, dst_size);
+	/* MDP_RGB_DST_XY */
+	mdp4_pipe_outpdw(pipe, rgb_base, 0x000c, dst_xy);
 
-	outpdw(rgb_base + 0x0010, pipe->srcp0_addr + offset);
-	outpdw(rgb_base + 0x0040, pipe->srcp0_ystride);
+	mdp4_pipe_outpdw(pipe, rgb_base, 0x0010, pipe->srcp0_addr + offset);
+	mdp4_pipe_outpdw(pipe, rgb_base, 0x0040, pipe->srcp0_ystride);
 
+	/* The stage code toggles solid fill in these two behind our back */
 	outpdw(rgb_base + 0x0050, format);/* MDP_RGB_SRC_FORMAT */
-	outpdw(rgb_base + 0x0054, pattern);/* MDP_RGB_SRC_UNPACK_PATTERN */
+	/* MDP_RGB_SRC_UNPACK_PATTERN */
+	mdp4_pipe_outpdw(pipe, rgb_base, 0x0054, pattern);
 	if (format & MDP4_FORMAT_SOLID_FILL) {
 		u32 op_mode = pipe->op_mode;
 		op_mode &= ~(MDP4_OP_FLIP_LR + MDP4_OP_SCALEX_EN);
@@ -604,8 +639,8 @@ void mdp4_overlay_rgb_setup(struct mdp4_overlay_pipe *pipe)
 		outpdw(rgb_base + 0x0058, op_mode);/* MDP_RGB_OP_MODE */
 	} else
 		outpdw(rgb_base + 0x0058, pipe->op_mode);/* MDP_RGB_OP_MODE */
-	outpdw(rgb_base + 0x005c, pipe->phasex_step);
-	outpdw(rgb_base + 0x0060, pipe->phasey_step);
+	mdp4_pipe_outpdw(pipe, rgb_base, 0x005c, pipe->phasex_step);
+	mdp4_pipe_outpdw(pipe, rgb_base, 0x0060, pipe->phasey_step);
 
 	mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_OFF, FALSE);
 
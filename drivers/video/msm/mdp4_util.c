@@ -209,6 +209,24 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 	return -1;
 }
 
+int mdp_ppp_blit_fb(struct fb_info *info, struct mdp_blit_req *req)
+{
+	return -ENODEV;
+}
+
+int mdp_ppp_blit_check(struct fb_info *info, struct mdp_blit_req *req)
+{
+	return 0;
+}
+
+void mdp_ppp_blit_begin(void)
+{
+}
+
+void mdp_ppp_blit_end(void)
+{
+}
+
 void mdp4_fetch_cfg(uint32 core_clk)
 {
 	uint32 dmap_data, vg_data;
@@ -250,6 +268,8 @@ void mdp4_hw_init(void)
 	ulong bits;
 	uint32 clk_rate;
 
+	mdp4_overlay_shadow_reset();
+
 	/* MDP cmd block enable */
 	mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_ON, FALSE);
 
@@ -480,6 +480,10 @@ static ssize_t mdp_stat_read(
 		       mdp4_stat.err_underflow);
 	bp += len;
 	dlen -= len;
+	len = snprintf(bp, dlen, "pipe_reg_skip: %08lu\n\n",
+		       mdp4_stat.pipe_reg_skip);
+	bp += len;
+	dlen -= len;
 
 	len = snprintf(bp, dlen, "writeback:\n");
 	bp += len;
@@ -521,14 +521,31 @@ void mdp_set_dma_pan_info(struct fb_info *info, struct mdp_dirty_region *dirty,
 	iBuf->vsync_enable = sync;
 
 	if (dirty) {
+		int x = dirty->xoffset % info->var.xres;
+		int y = dirty->yoffset % info->var.yres;
+		int x2 = x + dirty->width;
+		int y2 = y + dirty->height;
+
+		/*
+		 * The refresher hasn't pushed the last region yet, so the
+		 * panel still needs it too: send the union of both.
+		 */
+		if (!mfd->hw_refresh && !mfd->ibuf_flushed &&
+		    iBuf->dma_w && iBuf->dma_h) {
+			x2 = max_t(int, x2, iBuf->dma_x + iBuf->dma_w);
+			y2 = max_t(int, y2, iBuf->dma_y + iBuf->dma_h);
+			x = min(x, iBuf->dma_x);
+			y = min(y, iBuf->dma_y);
+		}
+
 		/*
 		 * ToDo: dirty region check inside var.xoffset+xres
 		 * <-> var.yoffset+yres
 		 */
-		iBuf->dma_x = dirty->xoffset % info->var.xres;
-		iBuf->dma_y = dirty->yoffset % info->var.yres;
-		iBuf->dma_w = dirty->width;
-		iBuf->dma_h = dirty->height;
+		iBuf->dma_x = x;
+		iBuf->dma_y = y;
+		iBuf->dma_w = x2 - x;
+		iBuf->dma_h = y2 - y;
 	} else {
 		iBuf->dma_x = 0;
 		iBuf->dma_y = 0;
@@ -31,6 +31,7 @@
 #include <asm/mach-types.h>
 #include <linux/semaphore.h>
 #include <linux/spinlock.h>
+#include <linux/wait.h>
 
 #include <linux/fb.h>
 
@@ -61,6 +62,25 @@ int first_pixel_start_x;
 int first_pixel_start_y;
 static bool firstupdate = TRUE;			////LCD_LUYA_20100610_01
 
+#ifndef CONFIG_FB_MSM_MDP40
+/*
+ * Non-blocking pans: the new address is written to DMA_P and the caller
+ * returns at once, the LCDC latches the address at the next frame start.
+ * Only one flip may wait for that. The next pan blocks until it is on
+ * screen, so with three framebuffer pages the page the client draws
+ * into next is never the one being scanned out.
+ */
+static int lcdc_async_pan;
+module_param_named(async_pan, lcdc_async_pan, int, 0644);
+
+static DECLARE_WAIT_QUEUE_HEAD(lcdc_flip_wq);
+static int lcdc_flip_pending;
+/* The frame start raised before the write latched the old address */
+static int lcdc_flip_stale;
+#endif
+
+static ktime_t lcdc_vsync_reported;
+
 ssize_t mdp_dma_lcdc_show_event(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -70,6 +90,17 @@ ssize_t mdp_dma_lcdc_show_event(struct device *dev,
 		atomic_read(&vsync_cntrl.vsync_resume) == 0)
 		return 0;
 
+	/* Report a vsync that poll() woke the reader for without waiting */
+	if (!ktime_equal(vsync_cntrl.vsync_time, lcdc_vsync_reported) &&
+	    ktime_to_ms(ktime_sub(ktime_get(), vsync_cntrl.vsync_time)) <
+	    VSYNC_PERIOD) {
+		lcdc_vsync_reported = vsync_cntrl.vsync_time;
+		ret = snprintf(buf, PAGE_SIZE, "VSYNC=%llu",
+				ktime_to_ns(lcdc_vsync_reported));
+		buf[strlen(buf) + 1] = '\0';
+		return ret;
+	}
+
 	INIT_COMPLETION(vsync_cntrl.vsync_wait);
 
 	ret = wait_for_completion_interruptible_timeout(&vsync_cntrl.vsync_wait,
@@ -81,8 +112,9 @@ ssize_t mdp_dma_lcdc_show_event(struct device *dev,
 		return ret;
     }
 
+	lcdc_vsync_reported = vsync_cntrl.vsync_time;
 	ret = snprintf(buf, PAGE_SIZE, "VSYNC=%llu",
-			ktime_to_ns(vsync_cntrl.vsync_time));
+			ktime_to_ns(lcdc_vsync_reported));
 	buf[strlen(buf) + 1] = '\0';
 	return ret;
 }
@@ -345,6 +377,9 @@ int mdp_lcdc_off(struct platform_device *pdev)
 	struct msm_fb_data_type *mfd;
 	uint32 timer_base = LCDC_BASE;
 	uint32 block = MDP_DMA2_BLOCK;
+#ifndef CONFIG_FB_MSM_MDP40
+	unsigned long flag;
+#endif
 
 	mfd = (struct msm_fb_data_type *)platform_get_drvdata(pdev);
 
@@ -386,6 +421,17 @@ int mdp_lcdc_off(struct platform_device *pdev)
 
 	ret = panel_next_off(pdev);
 
+#ifndef CONFIG_FB_MSM_MDP40
+	/* A flip still waiting won't reach the screen any more */
+	spin_lock_irqsave(&mdp_spin_lock, flag);
+	if (lcdc_flip_pending) {
+		lcdc_flip_pending = 0;
+		mdp_disable_irq(MDP_DMA2_TERM);
+	}
+	spin_unlock_irqrestore(&mdp_spin_lock, flag);
+	wake_up(&lcdc_flip_wq);
+#endif
+
 	atomic_set(&vsync_cntrl.suspend, 1);
 	atomic_set(&vsync_cntrl.vsync_resume, 0);
 	complete_all(&vsync_cntrl.vsync_wait);
@@ -434,6 +480,49 @@ void mdp_dma_lcdc_vsync_ctrl(int enable)
 		atomic_set(&vsync_cntrl.vsync_resume, 1);
 }
 
+#ifndef CONFIG_FB_MSM_MDP40
+/*
+ * Called from the LCDC frame start interrupt with mdp_spin_lock held.
+ * Returns nonzero while a flip still needs the interrupt.
+ */
+int mdp_lcdc_flip_latched(void)
+{
+	if (!lcdc_flip_pending)
+		return 0;
+
+	if (lcdc_flip_stale) {
+		lcdc_flip_stale = 0;
+		return 1;
+	}
+
+	lcdc_flip_pending = 0;
+	mdp_disable_irq_nosync(MDP_DMA2_TERM);
+	wake_up(&lcdc_flip_wq);
+	return 0;
+}
+
+static void mdp_lcdc_flip(uint32 dma_base, uint8 *buf)
+{
+	unsigned long flag;
+
+	wait_event(lcdc_flip_wq, !lcdc_flip_pending);
+
+	spin_lock_irqsave(&mdp_spin_lock, flag);
+	if (!(mdp_intr_mask & LCDC_FRAME_START))
+		outp32(MDP_INTR_CLEAR, LCDC_FRAME_START);
+
+	/* starting address */
+	MDP_OUTP(MDP_BASE + dma_base + 0x8, (uint32) buf);
+
+	lcdc_flip_stale = !!(inp32(MDP_INTR_STATUS) & LCDC_FRAME_START);
+	lcdc_flip_pending = 1;
+	mdp_enable_irq(MDP_DMA2_TERM);
+	mdp_intr_mask |= LCDC_FRAME_START;
+	outp32(MDP_INTR_ENABLE, mdp_intr_mask);
+	spin_unlock_irqrestore(&mdp_spin_lock, flag);
+}
+#endif
+
 void mdp_lcdc_update(struct msm_fb_data_type *mfd)
 {
 	struct fb_info *fbi = mfd->fbi;
@@ -464,6 +553,16 @@ void mdp_lcdc_update(struct msm_fb_data_type *mfd)
 		dma_base = DMA_E_BASE;
 	}
 #endif
+#ifndef CONFIG_FB_MSM_MDP40
+	if (lcdc_async_pan && !firstupdate) {
+		mdp_lcdc_flip(dma_base, buf);
+		return;
+	}
+
+	/* Let a flip from before async_pan was cleared finish */
+	wait_event(lcdc_flip_wq, !lcdc_flip_pending);
+#endif
+
 	if(firstupdate)			/////LCD_LUYA_20100610_01
 	{
 		firstupdate = FALSE;
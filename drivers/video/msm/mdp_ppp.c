@@ -1314,13 +1314,60 @@ void put_img(struct file *p_src_file)
 }
 
 
+/*
+ * Task that holds the PPP for a whole list of blit requests. The PPP has
+ * no command list of its own, so each operation still waits for its own
+ * interrupt, but the list shares one hold of mdp_ppp_mutex and one vote
+ * for the command block clocks instead of taking both per layer.
+ */
+static struct task_struct *mdp_ppp_batch_owner;
+
+/**
+ * mdp_ppp_blit_check - validate a blit request without starting it
+ * @info: framebuffer the request was made on
+ * @req: the request
+ *
+ * Lets a list of requests be refused before any layer is drawn.
+ */
+int mdp_ppp_blit_check(struct fb_info *info, struct mdp_blit_req *req)
+{
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
+	struct mdp_blit_req tmp = *req;
+
+	if (tmp.dst.format == MDP_FB_FORMAT)
+		tmp.dst.format = mfd->fb_imgType;
+	if (tmp.src.format == MDP_FB_FORMAT)
+		tmp.src.format = mfd->fb_imgType;
+
+	return mdp_ppp_verify_req(&tmp) ? -EINVAL : 0;
+}
+
+void mdp_ppp_blit_begin(void)
+{
+	down(&mdp_ppp_mutex);
+	/* MDP cmd block enable */
+	mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_ON, FALSE);
+	mdp_ppp_batch_owner = current;
+}
+
+void mdp_ppp_blit_end(void)
+{
+	mdp_ppp_batch_owner = NULL;
+	/* MDP cmd block disable */
+	mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_OFF, FALSE);
+	up(&mdp_ppp_mutex);
+}
+
+static int mdp_ppp_blit_img(struct msm_fb_data_type *mfd,
+			    struct mdp_blit_req *req,
+			    unsigned long src_start, unsigned long dst_start,
+			    struct file *p_src_file, struct file *p_dst_file);
+
 int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 {
 	unsigned long src_start, dst_start;
 	unsigned long src_len = 0;
 	unsigned long dst_len = 0;
-	MDPIBUF iBuf;
-	u32 dst_width, dst_height;
 	struct file *p_src_file = 0 , *p_dst_file = 0;
 	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
 
@@ -1354,6 +1401,43 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 		return -1;
 	}
 
+	return mdp_ppp_blit_img(mfd, req, src_start, dst_start,
+				p_src_file, p_dst_file);
+}
+
+/**
+ * mdp_ppp_blit_fb - blit within the framebuffer on behalf of the kernel
+ * @info: the framebuffer, both source and destination
+ * @req: the request, its memory_id fields are ignored
+ *
+ * The caller keeps the CPU caches coherent with the framebuffer.
+ */
+int mdp_ppp_blit_fb(struct fb_info *info, struct mdp_blit_req *req)
+{
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
+
+	if (req->dst.format == MDP_FB_FORMAT)
+		req->dst.format = mfd->fb_imgType;
+	if (req->src.format == MDP_FB_FORMAT)
+		req->src.format = mfd->fb_imgType;
+	if (mdp_ppp_verify_req(req))
+		return -EINVAL;
+
+	req->flags |= MDP_BLIT_NON_CACHED;
+	return mdp_ppp_blit_img(mfd, req, info->fix.smem_start,
+				info->fix.smem_start, NULL, NULL);
+}
+
+/* Blit between two images already looked up, and drop them when done */
+static int mdp_ppp_blit_img(struct msm_fb_data_type *mfd,
+			    struct mdp_blit_req *req,
+			    unsigned long src_start, unsigned long dst_start,
+			    struct file *p_src_file, struct file *p_dst_file)
+{
+	MDPIBUF iBuf;
+	u32 dst_width, dst_height;
+	bool batched = mdp_ppp_batch_owner == current;
+
 	iBuf.ibuf_width = req->dst.width;
 	iBuf.ibuf_height = req->dst.height;
 	iBuf.bpp = bytes_per_pixel[req->dst.format];
@@ -1485,9 +1569,11 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 #endif
 	}
 
-	down(&mdp_ppp_mutex);
-	/* MDP cmd block enable */
-	mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_ON, FALSE);
+	if (!batched) {
+		down(&mdp_ppp_mutex);
+		/* MDP cmd block enable */
+		mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_ON, FALSE);
+	}
 
 #ifndef CONFIG_FB_MSM_MDP22
 	mdp_start_ppp(mfd, &iBuf, req, p_src_file, p_dst_file);
@@ -1581,9 +1667,11 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 	}
 #endif
 
-	/* MDP cmd block disable */
-	mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_OFF, FALSE);
-	up(&mdp_ppp_mutex);
+	if (!batched) {
+		/* MDP cmd block disable */
+		mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_OFF, FALSE);
+		up(&mdp_ppp_mutex);
+	}
 
 	put_img(p_src_file);
 	put_img(p_dst_file);
@@ -45,6 +45,7 @@ when         who           what, where, why                          comment tag
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
 #include <mach/board.h>
+#include <mach/msm_latency.h>
 #include <linux/uaccess.h>
 
 #include <linux/workqueue.h>
@@ -57,6 +58,8 @@ when         who           what, where, why                          comment tag
 #include <linux/android_pmem.h>
 #include <linux/leds.h>
 #include <linux/pm_runtime.h>
+#include <linux/hardirq.h>
+#include <asm/cacheflush.h>
 
 #define MSM_FB_C
 #include "msm_fb.h"
@@ -451,6 +454,8 @@ static int msm_fb_probe(struct platform_device *pdev)
 #endif
 
 	pm_runtime_enable(&pdev->dev);
+	/* The panel is turned on by late resume, nothing waits for this */
+	device_enable_async_suspend(&pdev->dev);
 
 	pdev_list[pdev_list_cnt++] = pdev;
 	msm_fb_create_sysfs(pdev);
@@ -940,12 +945,73 @@ static void msm_fb_fillrect(struct fb_info *info,
 	}
 }
 
+/* Below this the CPU is done before the PPP is set up */
+#define MSM_FB_PPP_MIN_PIXELS	4096
+
+/*
+ * Copy an area of the framebuffer with the PPP. fbcon scrolls by moving
+ * the screen up a line, so overlapping copies are only done upwards,
+ * where the PPP reads each source line before it writes over it.
+ */
+static int msm_fb_ppp_copyarea(struct fb_info *info,
+			       const struct fb_copyarea *area)
+{
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
+	struct mdp_blit_req req;
+	unsigned long start, end;
+	int ret;
+
+	if (!mfd->panel_power_on || info->var.bits_per_pixel != 16 ||
+	    area->width * area->height < MSM_FB_PPP_MIN_PIXELS)
+		return -EINVAL;
+
+	if (area->dy >= area->sy && area->dy < area->sy + area->height)
+		return -EINVAL;
+
+	/* The PPP sleeps: oops output and console writes from atomic
+	 * context stay on the CPU */
+	if (oops_in_progress || in_atomic() || irqs_disabled())
+		return -EBUSY;
+
+	memset(&req, 0, sizeof(req));
+	req.src.width = info->fix.line_length / 2;
+	req.src.height = info->var.yres_virtual;
+	req.src.format = MDP_FB_FORMAT;
+	req.dst = req.src;
+	req.src_rect.x = area->sx;
+	req.src_rect.y = area->sy;
+	req.src_rect.w = area->width;
+	req.src_rect.h = area->height;
+	req.dst_rect.x = area->dx;
+	req.dst_rect.y = area->dy;
+	req.dst_rect.w = area->width;
+	req.dst_rect.h = area->height;
+	req.alpha = MDP_ALPHA_NOP;
+	req.transp_mask = MDP_TRANSP_NOP;
+
+	/* The kernel draws through a cached mapping of the framebuffer */
+	start = min(area->sy, area->dy) * info->fix.line_length;
+	end = (max(area->sy, area->dy) + area->height) *
+		info->fix.line_length;
+	dmac_flush_range(info->screen_base + start, info->screen_base + end);
+	outer_flush_range(info->fix.smem_start + start,
+			  info->fix.smem_start + end);
+
+	ret = mdp_ppp_blit_fb(info, &req);
+
+	outer_inv_range(info->fix.smem_start + start,
+			info->fix.smem_start + end);
+	dmac_flush_range(info->screen_base + start, info->screen_base + end);
+	return ret;
+}
+
 static void msm_fb_copyarea(struct fb_info *info,
 			    const struct fb_copyarea *area)
 {
 	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
 
-	cfb_copyarea(info, area);
+	if (msm_fb_ppp_copyarea(info, area))
+		cfb_copyarea(info, area);
 	if (!mfd->hw_refresh && (info->var.yoffset == 0) &&
 		!mfd->sw_currently_refreshing) {
 		struct fb_var_screeninfo var;
@@ -1319,6 +1385,10 @@ static int msm_fb_register(struct msm_fb_data_type *mfd)
 #endif
 	fbi->fbops = &msm_fb_ops;
 	fbi->flags = FBINFO_FLAG_DEFAULT;
+#ifndef CONFIG_FB_MSM_MDP40
+	/* fbcon scrolls with copyarea, which the PPP does */
+	fbi->flags |= FBINFO_HWACCEL_COPYAREA;
+#endif
 	fbi->pseudo_palette = msm_fb_pseudo_palette;
 
 	mfd->ref_cnt = 0;
@@ -1614,6 +1684,7 @@ static int msm_fb_pan_display(struct fb_var_screeninfo *var,
 	struct mdp_dirty_region *dirtyPtr = NULL;
 	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
 	struct msm_fb_panel_data *pdata;
+	u64 start;
 
 	/*
 	 * If framebuffer is 1 or 2, io pen display is not allowed.
@@ -1676,6 +1747,7 @@ static int msm_fb_pan_display(struct fb_var_screeninfo *var,
 		dirtyPtr = &dirty;
 	}
 
+	start = msm_latency_start(MSM_LATENCY_FB, (unsigned long)info);
 	down(&msm_fb_pan_sem);
 
 	if (info->node == 0) { /* primary */
@@ -1690,6 +1762,7 @@ static int msm_fb_pan_display(struct fb_var_screeninfo *var,
 			     (var->activate == FB_ACTIVATE_VBL));
 	mdp_dma_pan_update(info);
 	up(&msm_fb_pan_sem);
+	msm_latency_done(MSM_LATENCY_FB, (unsigned long)info, start, 0);
 
 	if (unset_bl_level && !bl_updated) {
 		pdata = (struct msm_fb_panel_data *)mfd->pdev->
@@ -2697,10 +2770,19 @@ static int msmfb_blit(struct fb_info *info, void __user *p)
 		msm_fb_ensure_memory_coherency_before_dma(info,
 				req_list, req_list_count);
 
+		/* Refuse a bad window before any of its layers is drawn */
+		for (i = 0; i < req_list_count; i++) {
+			if (!(req_list[i].flags & MDP_NO_BLIT) &&
+			    mdp_ppp_blit_check(info, &(req_list[i])))
+				return -EINVAL;
+		}
+
 		/*
 		 * Do the blit DMA, if required -- returning early only if
-		 * there is a failure.
+		 * there is a failure. The whole window is blitted under one
+		 * hold of the PPP.
 		 */
+		mdp_ppp_blit_begin();
 		for (i = 0; i < req_list_count; i++) {
 			if (!(req_list[i].flags & MDP_NO_BLIT)) {
 				/* Do the actual blit. */
@@ -2710,10 +2792,13 @@ static int msmfb_blit(struct fb_info *info, void __user *p)
 				 * Note that early returns don't guarantee
 				 * memory coherency.
 				 */
-				if (ret)
+				if (ret) {
+					mdp_ppp_blit_end();
 					return ret;
+				}
 			}
 		}
+		mdp_ppp_blit_end();
 
 		/*
 		 * Ensure that CPU cache and other internal CPU state is
@@ -2731,6 +2816,32 @@ static int msmfb_blit(struct fb_info *info, void __user *p)
 	return 0;
 }
 
+static int msmfb_display_commit(struct fb_info *info, void __user *argp)
+{
+	struct mdp_display_commit commit;
+	struct fb_var_screeninfo *var = &commit.var;
+	struct mdp_rect *roi = &commit.roi;
+
+	if (copy_from_user(&commit, argp, sizeof(commit)))
+		return -EFAULT;
+
+	if (roi->w && roi->h) {
+		if (roi->w > info->var.xres || roi->x > info->var.xres - roi->w ||
+		    roi->h > info->var.yres || roi->y > info->var.yres - roi->h)
+			return -EINVAL;
+
+		/* Hand the roi to pan display as an "UPDT" dirty region */
+		var->reserved[0] = 0x54445055;
+		var->reserved[1] = (roi->y << 16) | roi->x;
+		var->reserved[2] = ((roi->y + roi->h) << 16) |
+			(roi->x + roi->w);
+	} else {
+		var->reserved[0] = 0;
+	}
+
+	return msm_fb_pan_display(var, info);
+}
+
 static int msmfb_vsync_ctrl(struct fb_info *info, void __user *argp)
 {
 	int enable, ret;
@@ -3538,6 +3649,10 @@ static int msm_fb_ioctl(struct fb_info *info, unsigned int cmd,
 		ret = msmfb_handle_metadata_ioctl(mfd, &mdp_metadata);
 		break;
 
+	case MSMFB_DISPLAY_COMMIT:
+		ret = msmfb_display_commit(info, argp);
+		break;
+
 	default:
 		MSM_FB_INFO("MDP: unknown ioctl (cmd=%d) received!\n", cmd);
 		ret = -EINVAL;
@@ -472,6 +472,8 @@ u32 vidc_lookup_addr_table(struct video_client_ctx *client_ctx,
 	u32 i;
 	struct buf_addr_table *buf_addr_table;
 	u32 found = false;
+	unsigned long key;
+	u8 *hash;
 
 	if (!client_ctx)
 		return false;
@@ -487,7 +489,30 @@ u32 vidc_lookup_addr_table(struct video_client_ctx *client_ctx,
 		DBG("%s(): buffer = OUTPUT\n", __func__);
 	}
 
-	for (i = 0; i < num_of_buffers; ++i) {
+	/*
+	 * Buffers are registered once and then looked up for every frame.
+	 * Try the slot that matched last time before walking the table;
+	 * deletes move entries around, so a hit is always re-checked.
+	 */
+	key = search_with_user_vaddr ? *user_vaddr : *kernel_vaddr;
+	hash = &client_ctx->addr_hash[buffer == BUFFER_TYPE_INPUT ? 0 : 1]
+		[search_with_user_vaddr ? 1 : 0]
+		[(key >> PAGE_SHIFT) % VIDC_ADDR_HASH_SIZE];
+	i = *hash;
+	if (i && i <= num_of_buffers &&
+		key == (search_with_user_vaddr ?
+			buf_addr_table[i - 1].user_vaddr :
+			buf_addr_table[i - 1].kernel_vaddr)) {
+		i--;
+		if (search_with_user_vaddr)
+			*kernel_vaddr = buf_addr_table[i].kernel_vaddr;
+		else
+			*user_vaddr = buf_addr_table[i].user_vaddr;
+		found = true;
+	} else
+		i = 0;
+
+	for (; !found && i < num_of_buffers; ++i) {
 		if (search_with_user_vaddr) {
 			if (*user_vaddr == buf_addr_table[i].user_vaddr) {
 				*kernel_vaddr = buf_addr_table[i].kernel_vaddr;
@@ -510,6 +535,7 @@ u32 vidc_lookup_addr_table(struct video_client_ctx *client_ctx,
 	}
 
 	if (found) {
+		*hash = i + 1;
 		*phy_addr = buf_addr_table[i].dev_addr;
 		*pmem_fd = buf_addr_table[i].pmem_fd;
 		*file = buf_addr_table[i].file;
@@ -51,12 +51,16 @@ struct buf_addr_table {
 	void *client_data;
 };
 
+#define VIDC_ADDR_HASH_SIZE 64
+
 struct video_client_ctx {
 	void *vcd_handle;
 	u32 num_of_input_buffers;
 	u32 num_of_output_buffers;
 	struct buf_addr_table input_buf_addr_table[MAX_VIDEO_NUM_OF_BUFF];
 	struct buf_addr_table output_buf_addr_table[MAX_VIDEO_NUM_OF_BUFF];
+	/* index + 1 of the last hit, by [direction][user vaddr][hash] */
+	u8 addr_hash[2][2][VIDC_ADDR_HASH_SIZE];
 	struct list_head msg_queue;
 	struct mutex msg_queue_lock;
 	struct mutex enrty_queue_lock;
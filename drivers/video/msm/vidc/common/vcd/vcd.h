@@ -396,6 +396,13 @@ u32 vcd_sched_get_client_frame(struct list_head *sched_clnt_list,
 	struct vcd_clnt_ctxt **cctxt,
 	struct vcd_buffer_entry **buffer);
 
+u64 vcd_sched_time_us(void);
+
+void vcd_sched_frame_done(struct vcd_dev_ctxt *dev_ctxt,
+	struct vcd_transc *transc);
+
+void vcd_sched_debugfs_init(struct vcd_dev_ctxt *dev_ctxt);
+
 void vcd_handle_clnt_fatal(struct vcd_clnt_ctxt *cctxt, u32 trans_end);
 
 void vcd_handle_clnt_fatal_input_done(struct vcd_clnt_ctxt *cctxt,
@@ -96,12 +96,16 @@ struct vcd_buffer_entry {
 	u32 allocated;
 	u32 in_use;
 	struct vcd_frame_data frame;
-
+	u64 queued_us;
+	u64 deadline_us;
 };
 
+#define VCD_POOL_HASH_SIZE 64
+
 struct vcd_buffer_pool {
 	struct vcd_buffer_entry *entries;
 	u32 count;
+	u8 hash[VCD_POOL_HASH_SIZE];
 	struct vcd_buffer_requirement buf_req;
 	u32 validated;
 	u32 allocated;
@@ -126,6 +130,17 @@ struct vcd_transc {
 
 	u32 input_done;
 	u32 frame_done;
+	u64 submit_us;
+};
+
+struct vcd_frame_stats {
+	u32 frames;
+	u32 deadline_miss;
+	u64 queue_wait_us;
+	u32 max_queue_wait_us;
+	u32 done;
+	u64 proc_us;
+	u32 max_proc_us;
 };
 
 struct vcd_dev_ctxt {
@@ -163,6 +178,7 @@ struct vcd_dev_ctxt {
 	u32 curr_perf_lvl;
 	u32 set_perf_lvl_pending;
 
+	struct vcd_frame_stats frm_stats;
 };
 
 struct vcd_clnt_status {
@@ -187,8 +203,8 @@ struct vcd_sched_clnt_ctx {
 	u32 clnt_active;
 	void *clnt_data;
 	u32 tkns;
-	u32 round_perfrm;
-	u32 rounds;
+	u32 frm_period_us;
+	u64 last_deadline;
 	struct list_head ip_frm_list;
 };
 
@@ -200,6 +200,7 @@ u32 vcd_init_device_context(struct vcd_drv_ctxt *drv_ctxt,
 	}
 
 	VCD_MSG_HIGH("Created scheduler instance.");
+	vcd_sched_debugfs_init(dev_ctxt);
 
 	ddl_init.core_virtual_base_addr = dev_ctxt->device_base_addr;
 	ddl_init.interrupt_clr = dev_ctxt->config.interrupt_clr;
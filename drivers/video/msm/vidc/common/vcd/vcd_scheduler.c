@@ -16,19 +16,33 @@
  *
  */
 
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <media/msm/vidc_type.h>
 #include "vcd.h"
 
-#define NORMALIZATION_FACTOR 3600
-#define ADJUST_CLIENT_ROUNDS(client, round_adjustment) \
-do {\
-	if ((client)->rounds < round_adjustment) {\
-		(client)->rounds = 0;\
-		VCD_MSG_HIGH("%s(): WARNING: Scheduler list unsorted",\
-			__func__);\
-	} else\
-		(client)->rounds -= round_adjustment;\
-} while (0)
+/*
+ * Every input frame gets a deadline one frame period (at the client's
+ * frame rate) after the later of its arrival and the client's previous
+ * deadline, and the frame with the earliest deadline runs next.  A
+ * decoder with a deep input queue is paced at its own rate instead of
+ * starving an encoder that only ever has a frame or two queued.
+ */
+u64 vcd_sched_time_us(void)
+{
+	return ktime_to_us(ktime_get());
+}
+
+static u32 vcd_sched_frm_period(struct vcd_clnt_ctxt *cctxt)
+{
+	u64 period = (u64)USEC_PER_SEC * cctxt->frm_rate.fps_denominator;
+
+	if (!cctxt->frm_rate.fps_numerator)
+		return 0;
+	do_div(period, cctxt->frm_rate.fps_numerator);
+	return (u32)period;
+}
 
 u32 vcd_sched_create(struct list_head *sched_list)
 {
@@ -55,17 +69,7 @@ void vcd_sched_destroy(struct list_head *sched_clnt_list)
 void insert_client_in_list(struct list_head *sched_clnt_list,
 	struct vcd_sched_clnt_ctx *sched_new_clnt, bool tail)
 {
-	struct vcd_sched_clnt_ctx *sched_clnt;
-	if (!list_empty(sched_clnt_list)) {
-		if (tail)
-			sched_clnt = list_entry(sched_clnt_list->prev,
-				struct vcd_sched_clnt_ctx, list);
-		else
-			sched_clnt = list_first_entry(sched_clnt_list,
-				struct vcd_sched_clnt_ctx, list);
-		sched_new_clnt->rounds = sched_clnt->rounds;
-	} else
-		sched_new_clnt->rounds = 0;
+	sched_new_clnt->last_deadline = 0;
 	if (tail)
 		list_add_tail(&sched_new_clnt->list, sched_clnt_list);
 	else
@@ -116,9 +120,8 @@ u32 vcd_sched_add_client(struct vcd_clnt_ctxt *cctxt)
 			memset(sched_cctxt, 0,
 				sizeof(struct vcd_sched_clnt_ctx));
 			sched_cctxt->tkns = 0;
-			sched_cctxt->round_perfrm = NORMALIZATION_FACTOR *
-				cctxt->frm_rate.fps_denominator /
-				cctxt->frm_rate.fps_numerator;
+			sched_cctxt->frm_period_us =
+				vcd_sched_frm_period(cctxt);
 			sched_cctxt->clnt_active = true;
 			sched_cctxt->clnt_data = cctxt;
 			INIT_LIST_HEAD(&sched_cctxt->ip_frm_list);
@@ -158,16 +161,9 @@ u32 vcd_sched_update_config(struct vcd_clnt_ctxt *cctxt)
 	if (!cctxt || !cctxt->sched_clnt_hdl) {
 		VCD_MSG_ERROR("%s(): Invalid parameter", __func__);
 		rc = VCD_ERR_ILLEGAL_PARM;
-	} else {
-		cctxt->sched_clnt_hdl->rounds /=
-			cctxt->sched_clnt_hdl->round_perfrm;
-		cctxt->sched_clnt_hdl->round_perfrm =
-			NORMALIZATION_FACTOR *
-			cctxt->frm_rate.fps_denominator /
-			cctxt->frm_rate.fps_numerator;
-		cctxt->sched_clnt_hdl->rounds *=
-			cctxt->sched_clnt_hdl->round_perfrm;
-	}
+	} else
+		cctxt->sched_clnt_hdl->frm_period_us =
+			vcd_sched_frm_period(cctxt);
 	return rc;
 }
 
@@ -176,13 +172,20 @@ u32 vcd_sched_queue_buffer(
 	struct vcd_buffer_entry *buffer, u32 tail)
 {
 	u32 rc = VCD_S_SUCCESS;
+	u64 now;
 	if (!sched_cctxt || !buffer) {
 		VCD_MSG_ERROR("%s(): Invalid parameter", __func__);
 		rc = VCD_ERR_ILLEGAL_PARM;
-	} else if (tail)
+	} else if (tail) {
+		now = vcd_sched_time_us();
+		buffer->queued_us = now;
+		buffer->deadline_us = max(now, sched_cctxt->last_deadline) +
+			sched_cctxt->frm_period_us;
+		sched_cctxt->last_deadline = buffer->deadline_us;
 		list_add_tail(&buffer->sched_list,
 				&sched_cctxt->ip_frm_list);
-	else
+	} else
+		/* Requeued frame, it keeps its deadline */
 		list_add(&buffer->sched_list, &sched_cctxt->ip_frm_list);
 	return rc;
 }
@@ -251,42 +254,138 @@ u32 vcd_sched_get_client_frame(struct list_head *sched_clnt_list,
 	struct vcd_clnt_ctxt **cctxt,
 	struct vcd_buffer_entry **buffer)
 {
-	u32 rc = VCD_ERR_QEMPTY, round_adjustment = 0;
-	struct vcd_sched_clnt_ctx *sched_clnt, *clnt_nxt;
+	u32 rc = VCD_ERR_QEMPTY;
+	struct vcd_sched_clnt_ctx *sched_clnt, *next = NULL;
+	struct vcd_buffer_entry *head;
+	struct vcd_frame_stats *stats;
+	u64 deadline = 0, now, wait;
 	if (!sched_clnt_list || !cctxt || !buffer) {
 		VCD_MSG_ERROR("%s(): Invalid parameter", __func__);
 		rc = VCD_ERR_ILLEGAL_PARM;
 	} else if (!list_empty(sched_clnt_list)) {
 		*cctxt = NULL;
 		*buffer = NULL;
-		list_for_each_entry_safe(sched_clnt,
-			clnt_nxt, sched_clnt_list, list) {
-			if (&sched_clnt->list == sched_clnt_list->next)
-				round_adjustment = sched_clnt->rounds;
-			if (*cctxt) {
-				if ((*cctxt)->sched_clnt_hdl->rounds >=
-					sched_clnt->rounds)
-					list_move(&(*cctxt)->sched_clnt_hdl\
-						->list, &sched_clnt->list);
-				ADJUST_CLIENT_ROUNDS(sched_clnt,
-					round_adjustment);
-			} else if (sched_clnt->tkns &&
-				!list_empty(&sched_clnt->ip_frm_list)) {
-				*cctxt = sched_clnt->clnt_data;
-				sched_clnt->rounds += sched_clnt->round_perfrm;
-			} else
-				ADJUST_CLIENT_ROUNDS(sched_clnt,
-						round_adjustment);
+		list_for_each_entry(sched_clnt, sched_clnt_list, list) {
+			if (!sched_clnt->tkns ||
+				list_empty(&sched_clnt->ip_frm_list))
+				continue;
+			head = list_first_entry(&sched_clnt->ip_frm_list,
+				struct vcd_buffer_entry, sched_list);
+			if (!next || head->deadline_us < deadline) {
+				next = sched_clnt;
+				deadline = head->deadline_us;
+			}
 		}
-		if (*cctxt) {
-			rc = vcd_sched_dequeue_buffer(
-				(*cctxt)->sched_clnt_hdl, buffer);
+		if (next) {
+			rc = vcd_sched_dequeue_buffer(next, buffer);
 			if (rc == VCD_S_SUCCESS) {
-				(*cctxt)->sched_clnt_hdl->tkns--;
-				ADJUST_CLIENT_ROUNDS((*cctxt)->\
-					sched_clnt_hdl, round_adjustment);
+				*cctxt = next->clnt_data;
+				next->tkns--;
+				/* Equal deadlines take turns */
+				list_move_tail(&next->list, sched_clnt_list);
+
+				now = vcd_sched_time_us();
+				wait = now - (*buffer)->queued_us;
+				stats = &(*cctxt)->dev_ctxt->frm_stats;
+				stats->frames++;
+				stats->queue_wait_us += wait;
+				if (wait > stats->max_queue_wait_us)
+					stats->max_queue_wait_us = (u32)wait;
+				if (now > deadline)
+					stats->deadline_miss++;
 			}
 		}
 	}
 	return rc;
 }
+
+void vcd_sched_frame_done(struct vcd_dev_ctxt *dev_ctxt,
+	struct vcd_transc *transc)
+{
+	struct vcd_frame_stats *stats = &dev_ctxt->frm_stats;
+	u64 proc;
+
+	if (!transc->submit_us)
+		return;
+	proc = vcd_sched_time_us() - transc->submit_us;
+	transc->submit_us = 0;
+	stats->done++;
+	stats->proc_us += proc;
+	if (proc > stats->max_proc_us)
+		stats->max_proc_us = (u32)proc;
+}
+
+#ifdef VIDC_ENABLE_DBGFS
+static int vcd_sched_stats_show(struct seq_file *m, void *unused)
+{
+	struct vcd_drv_ctxt *drv_ctxt = vcd_get_drv_context();
+	struct vcd_dev_ctxt *dev_ctxt = m->private;
+	struct vcd_frame_stats stats;
+	struct vcd_sched_clnt_ctx *sched_clnt;
+
+	mutex_lock(&drv_ctxt->dev_mutex);
+	stats = dev_ctxt->frm_stats;
+	if (stats.frames)
+		do_div(stats.queue_wait_us, stats.frames);
+	if (stats.done)
+		do_div(stats.proc_us, stats.done);
+	seq_printf(m, "frames           %u\n", stats.frames);
+	seq_printf(m, "deadline_miss    %u\n", stats.deadline_miss);
+	seq_printf(m, "queue_wait_avg   %llu us\n", stats.queue_wait_us);
+	seq_printf(m, "queue_wait_max   %u us\n", stats.max_queue_wait_us);
+	seq_printf(m, "frame_time_avg   %llu us\n", stats.proc_us);
+	seq_printf(m, "frame_time_max   %u us\n", stats.max_proc_us);
+	list_for_each_entry(sched_clnt, &dev_ctxt->sched_clnt_list, list)
+		seq_printf(m, "client %p: %s period %u us tokens %u\n",
+			sched_clnt->clnt_data,
+			((struct vcd_clnt_ctxt *)sched_clnt->clnt_data)->
+			decoding ? "dec" : "enc",
+			sched_clnt->frm_period_us, sched_clnt->tkns);
+	mutex_unlock(&drv_ctxt->dev_mutex);
+	return 0;
+}
+
+static int vcd_sched_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vcd_sched_stats_show, inode->i_private);
+}
+
+static ssize_t vcd_sched_stats_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct vcd_drv_ctxt *drv_ctxt = vcd_get_drv_context();
+	struct seq_file *m = file->private_data;
+	struct vcd_dev_ctxt *dev_ctxt = m->private;
+
+	/* Any write clears the counters */
+	mutex_lock(&drv_ctxt->dev_mutex);
+	memset(&dev_ctxt->frm_stats, 0, sizeof(dev_ctxt->frm_stats));
+	mutex_unlock(&drv_ctxt->dev_mutex);
+	return count;
+}
+
+static const struct file_operations vcd_sched_stats_fops = {
+	.open = vcd_sched_stats_open,
+	.read = seq_read,
+	.write = vcd_sched_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void vcd_sched_debugfs_init(struct vcd_dev_ctxt *dev_ctxt)
+{
+	static struct dentry *stats_file;
+	struct dentry *root = vidc_get_debugfs_root();
+
+	if (stats_file || !root)
+		return;
+	stats_file = debugfs_create_file("frame_stats", S_IRUGO | S_IWUSR,
+		root, dev_ctxt, &vcd_sched_stats_fops);
+	if (!stats_file)
+		VCD_MSG_ERROR("%s(): Error creating frame_stats", __func__);
+}
+#else
+void vcd_sched_debugfs_init(struct vcd_dev_ctxt *dev_ctxt)
+{
+}
+#endif
@@ -895,18 +895,30 @@ struct vcd_buffer_entry *vcd_get_free_buffer_pool_entry
 struct vcd_buffer_entry *vcd_find_buffer_pool_entry
 	(struct vcd_buffer_pool *pool, u8 *addr)
 {
-	u32 i;
+	u32 i, slot;
 	u32 found = false;
 
+	/*
+	 * Frames come back as virtual addresses every time, remember where
+	 * each was found so the next lookup is a single compare.
+	 */
+	slot = ((u32) addr >> PAGE_SHIFT) % VCD_POOL_HASH_SIZE;
+	i = pool->hash[slot];
+	if (addr && pool->entries && i && i <= pool->count + 1 &&
+		pool->entries[i - 1].virtual == addr)
+		return &pool->entries[i - 1];
+
 	for (i = 0; i <= pool->count && !found; i++) {
 		if (pool->entries[i].virtual == addr)
 			found = true;
 
 	}
 
-	if (found)
+	if (found) {
+		if (addr && i <= 0xff)
+			pool->hash[slot] = i;
 		return &pool->entries[i - 1];
-	else
+	} else
 		return NULL;
 
 }
@@ -1468,6 +1480,7 @@ u32 vcd_submit_frame(struct vcd_dev_ctxt *dev_ctxt,
 	transc->ip_frm_tag = ip_frm_entry->ip_frm_tag;
 	transc->time_stamp = ip_frm_entry->time_stamp;
 	transc->flags = ip_frm_entry->flags;
+	transc->submit_us = vcd_sched_time_us();
 	ip_frm_entry->ip_frm_tag = (u32) transc;
 	memset(&ddl_ip_frm, 0, sizeof(ddl_ip_frm));
 	memset(&ddl_op_frm, 0, sizeof(ddl_op_frm));
@@ -2187,6 +2200,7 @@ u32 vcd_handle_frame_done(
 		}
 	}
 	VCD_FAILED_RETURN(rc, "Bad output buffer pointer");
+	vcd_sched_frame_done(cctxt->dev_ctxt, transc);
 	op_frm->vcd_frm.time_stamp = transc->time_stamp;
 	op_frm->vcd_frm.ip_frm_tag = transc->ip_frm_tag;
 
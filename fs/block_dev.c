@@ -1523,6 +1523,7 @@ static int __blkdev_put(struct block_device *bdev, fmode_t mode, int for_part)
 		bdev->bd_part_count--;
 
 	if (!--bdev->bd_openers) {
+		blkdev_flush_discards(bdev);
 		sync_blockdev(bdev);
 		kill_bdev(bdev);
 	}
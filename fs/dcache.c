@@ -448,6 +448,33 @@ static void prune_one_dentry(struct dentry * dentry)
 	}
 }
 
+/*
+ * Free the dentries moved off the LRU onto @list.
+ * Called with dcache_lock held, which may be dropped in between.
+ */
+static void shrink_dentry_list(struct list_head *list)
+{
+	struct dentry *dentry;
+
+	while (!list_empty(list)) {
+		dentry = list_entry(list->prev, struct dentry, d_lru);
+		dentry_lru_del_init(dentry);
+		spin_lock(&dentry->d_lock);
+		/*
+		 * We found an inuse dentry which was not removed from
+		 * the LRU because of laziness during lookup.  Do not free
+		 * it - just keep it off the LRU list.
+		 */
+		if (atomic_read(&dentry->d_count)) {
+			spin_unlock(&dentry->d_lock);
+			continue;
+		}
+		prune_one_dentry(dentry);
+		/* dentry->d_lock was dropped in prune_one_dentry() */
+		cond_resched_lock(&dcache_lock);
+	}
+}
+
 /*
  * Shrink the dentry LRU on a given superblock.
  * @sb   : superblock to shrink dentry LRU.
@@ -499,23 +526,7 @@ restart:
 			cond_resched_lock(&dcache_lock);
 		}
 	}
-	while (!list_empty(&tmp)) {
-		dentry = list_entry(tmp.prev, struct dentry, d_lru);
-		dentry_lru_del_init(dentry);
-		spin_lock(&dentry->d_lock);
-		/*
-		 * We found an inuse dentry which was not removed from
-		 * the LRU because of laziness during lookup.  Do not free
-		 * it - just keep it off the LRU list.
-		 */
-		if (atomic_read(&dentry->d_count)) {
-			spin_unlock(&dentry->d_lock);
-			continue;
-		}
-		prune_one_dentry(dentry);
-		/* dentry->d_lock was dropped in prune_one_dentry() */
-		cond_resched_lock(&dcache_lock);
-	}
+	shrink_dentry_list(&tmp);
 	if (count == NULL && !list_empty(&sb->s_dentry_lru))
 		goto restart;
 	if (count != NULL)
@@ -525,35 +536,56 @@ restart:
 	spin_unlock(&dcache_lock);
 }
 
-/**
- * prune_dcache - shrink the dcache
- * @count: number of entries to try to free
- *
- * Shrink the dcache. This is done when we need more memory, or simply when we
- * need to unmount something (at which point we need to unuse all dentries).
- *
- * This function may fail to free any resources if all the dentries are in use.
+/*
+ * Free up to *count negative dentries from the LRU of @sb, whatever
+ * their referenced bit, looking at no more than four times that many.
+ * The other dentries keep their place on the LRU.
  */
-static void prune_dcache(int count)
+static void __shrink_dcache_sb_negative(struct super_block *sb, int *count)
+{
+	LIST_HEAD(keep);
+	LIST_HEAD(tmp);
+	struct dentry *dentry;
+	int cnt = *count;
+	int scan = cnt * 4;
+
+	spin_lock(&dcache_lock);
+	while (cnt > 0 && scan-- > 0 && !list_empty(&sb->s_dentry_lru)) {
+		dentry = list_entry(sb->s_dentry_lru.prev,
+				struct dentry, d_lru);
+		if (dentry->d_inode) {
+			list_move(&dentry->d_lru, &keep);
+		} else {
+			list_move_tail(&dentry->d_lru, &tmp);
+			cnt--;
+		}
+		cond_resched_lock(&dcache_lock);
+	}
+	list_splice_tail(&keep, &sb->s_dentry_lru);
+	shrink_dentry_list(&tmp);
+	*count = cnt;
+	spin_unlock(&dcache_lock);
+}
+
+/*
+ * One pass of prune_dcache() over the superblocks, with dcache_lock held.
+ * With @negative set, only superblocks weighted above the default are
+ * visited, and only their negative dentries are freed.
+ * Returns how many of @count are left to free.
+ */
+static int prune_dcache_pass(int count, int prune_ratio, int negative)
 {
 	struct super_block *sb, *p = NULL;
 	int w_count;
-	int unused = dentry_stat.nr_unused;
-	int prune_ratio;
 	int pruned;
 
-	if (unused == 0 || count == 0)
-		return;
-	spin_lock(&dcache_lock);
-	if (count >= unused)
-		prune_ratio = 1;
-	else
-		prune_ratio = unused / count;
 	spin_lock(&sb_lock);
 	list_for_each_entry(sb, &super_blocks, s_list) {
 		if (list_empty(&sb->s_instances))
 			continue;
-		if (sb->s_nr_dentry_unused == 0)
+		if (sb->s_nr_dentry_unused == 0 || sb->s_cache_weight == 0)
+			continue;
+		if (negative && sb->s_cache_weight <= SB_CACHE_WEIGHT_DEFAULT)
 			continue;
 		sb->s_count++;
 		/* Now, we reclaim unused dentrins with fairness.
@@ -564,12 +596,17 @@ static void prune_dcache(int count)
 		 * number of dentries to scan on this sb =
 		 * count * (number of dentries on this sb /
 		 * number of dentries in the machine)
+		 * scaled by the reclaim weight of the sb.
 		 */
 		spin_unlock(&sb_lock);
 		if (prune_ratio != 1)
 			w_count = (sb->s_nr_dentry_unused / prune_ratio) + 1;
 		else
 			w_count = sb->s_nr_dentry_unused;
+		if (sb->s_cache_weight != SB_CACHE_WEIGHT_DEFAULT)
+			w_count = min_t(unsigned long, sb->s_nr_dentry_unused,
+				(unsigned long)w_count * sb->s_cache_weight /
+				SB_CACHE_WEIGHT_DEFAULT + 1);
 		pruned = w_count;
 		/*
 		 * We need to be sure this filesystem isn't being unmounted,
@@ -582,8 +619,12 @@ static void prune_dcache(int count)
 			if ((sb->s_root != NULL) &&
 			    (!list_empty(&sb->s_dentry_lru))) {
 				spin_unlock(&dcache_lock);
-				__shrink_dcache_sb(sb, &w_count,
-						DCACHE_REFERENCED);
+				if (negative)
+					__shrink_dcache_sb_negative(sb,
+								    &w_count);
+				else
+					__shrink_dcache_sb(sb, &w_count,
+							DCACHE_REFERENCED);
 				pruned -= w_count;
 				spin_lock(&dcache_lock);
 			}
@@ -601,6 +642,37 @@ static void prune_dcache(int count)
 	if (p)
 		__put_super(p);
 	spin_unlock(&sb_lock);
+	return count;
+}
+
+/**
+ * prune_dcache - shrink the dcache
+ * @count: number of entries to try to free
+ *
+ * Shrink the dcache. This is done when we need more memory, or simply when we
+ * need to unmount something (at which point we need to unuse all dentries).
+ *
+ * Each superblock gives up its share scaled by s_cache_weight. Negative
+ * dentries of superblocks weighted above the default, such as procfs and
+ * sysfs, go first.
+ *
+ * This function may fail to free any resources if all the dentries are in use.
+ */
+static void prune_dcache(int count)
+{
+	int unused = dentry_stat.nr_unused;
+	int prune_ratio;
+
+	if (unused == 0 || count == 0)
+		return;
+	spin_lock(&dcache_lock);
+	if (count >= unused)
+		prune_ratio = 1;
+	else
+		prune_ratio = unused / count;
+	count = prune_dcache_pass(count, prune_ratio, 1);
+	if (count > 0)
+		prune_dcache_pass(count, prune_ratio, 0);
 	spin_unlock(&dcache_lock);
 }
 
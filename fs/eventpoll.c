@@ -33,6 +33,9 @@
 #include <linux/bitops.h>
 #include <linux/mutex.h>
 #include <linux/anon_inodes.h>
+#include <linux/wakelock.h>
+#include <linux/android_aid.h>
+#include <linux/hrtimer.h>
 #include <asm/uaccess.h>
 #include <asm/system.h>
 #include <asm/io.h>
@@ -72,7 +75,7 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -141,6 +144,9 @@ struct epitem {
 
 	/* The structure that describe the interested events and the source fd */
 	struct epoll_event event;
+
+	/* Held while the item is ready, for EPOLLWAKEUP */
+	struct wake_lock *ws;
 };
 
 /*
@@ -181,6 +187,12 @@ struct eventpoll {
 
 	/* The user that created the eventpoll descriptor */
 	struct user_struct *user;
+
+	/*
+	 * Held from the time EPOLLWAKEUP events are returned until the next
+	 * epoll_wait(), created with the first EPOLLWAKEUP item
+	 */
+	struct wake_lock *ws;
 };
 
 /* Wait structure used by the poll hooks */
@@ -219,6 +231,12 @@ struct ep_send_events_data {
 /* Maximum number of epoll watched descriptors, per user */
 static int max_user_watches __read_mostly;
 
+/*
+ * Once woken with events, epoll_wait() waits this many microseconds more
+ * for others to batch them into one return
+ */
+static int wakeup_batch_us __read_mostly;
+
 /*
  * This mutex is used to serialize ep_free() and eventpoll_release_file().
  */
@@ -241,6 +259,7 @@ static struct kmem_cache *pwq_cache __read_mostly;
 #include <linux/sysctl.h>
 
 static int zero;
+static int max_batch_us = USEC_PER_SEC / HZ;
 
 ctl_table epoll_table[] = {
 	{
@@ -251,6 +270,15 @@ ctl_table epoll_table[] = {
 		.proc_handler	= proc_dointvec_minmax,
 		.extra1		= &zero,
 	},
+	{
+		.procname	= "wakeup_batch_us",
+		.data		= &wakeup_batch_us,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &max_batch_us,
+	},
 	{ }
 };
 #endif /* CONFIG_SYSCTL */
@@ -296,6 +324,87 @@ static inline int ep_op_has_event(int op)
 	return op != EPOLL_CTL_DEL;
 }
 
+/*
+ * EPOLLWAKEUP keeps the system out of suspend, so it is only honoured
+ * for callers that could take a wake lock themselves.
+ */
+static inline int ep_may_wakeup(void)
+{
+#ifdef CONFIG_HAS_WAKELOCK
+	return in_egroup_p(AID_SYSTEM) || capable(CAP_SYS_ADMIN);
+#else
+	return 0;
+#endif
+}
+
+static struct wake_lock *ep_wakeup_source_alloc(const char *name)
+{
+	size_t len = strlen(name) + 1;
+	struct wake_lock *ws;
+
+	/* The name lives right behind the lock */
+	ws = kmalloc(sizeof(*ws) + len, GFP_KERNEL);
+	if (ws) {
+		memcpy(ws + 1, name, len);
+		wake_lock_init(ws, WAKE_LOCK_SUSPEND, (const char *)(ws + 1));
+	}
+	return ws;
+}
+
+static void ep_wakeup_source_free(struct wake_lock *ws)
+{
+	if (ws) {
+		wake_lock_destroy(ws);
+		kfree(ws);
+	}
+}
+
+/* Must be called with "mtx" held */
+static int ep_create_wakeup_source(struct epitem *epi)
+{
+	struct eventpoll *ep = epi->ep;
+
+	if (!ep->ws) {
+		ep->ws = ep_wakeup_source_alloc("eventpoll");
+		if (!ep->ws)
+			return -ENOMEM;
+	}
+
+	epi->ws = ep_wakeup_source_alloc(
+			(const char *)epi->ffd.file->f_path.dentry->d_name.name);
+	if (!epi->ws)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/* Must be called with "mtx" held */
+static void ep_destroy_wakeup_source(struct epitem *epi)
+{
+	struct eventpoll *ep = epi->ep;
+	struct wake_lock *ws;
+
+	/* Keep ep_poll_callback() off it */
+	spin_lock_irq(&ep->lock);
+	ws = epi->ws;
+	epi->ws = NULL;
+	spin_unlock_irq(&ep->lock);
+
+	ep_wakeup_source_free(ws);
+}
+
+static inline void ep_stay_awake(struct wake_lock *ws)
+{
+	if (ws)
+		wake_lock(ws);
+}
+
+static inline void ep_relax(struct wake_lock *ws)
+{
+	if (ws)
+		wake_unlock(ws);
+}
+
 /* Initialize the poll safe wake up structure */
 static void ep_nested_calls_init(struct nested_calls *ncalls)
 {
@@ -492,6 +601,8 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 		 */
 		if (!ep_is_linked(&epi->rdllink))
 			list_add_tail(&epi->rdllink, &ep->rdllist);
+		/* "sproc" may have released it after the callback took it */
+		ep_stay_awake(epi->ws);
 	}
 	/*
 	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
@@ -558,6 +669,8 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 		list_del_init(&epi->rdllink);
 	spin_unlock_irqrestore(&ep->lock, flags);
 
+	ep_wakeup_source_free(epi->ws);
+
 	/* At this point it is safe to free the eventpoll item */
 	kmem_cache_free(epi_cache, epi);
 
@@ -608,6 +721,7 @@ static void ep_free(struct eventpoll *ep)
 	mutex_unlock(&epmutex);
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
+	ep_wakeup_source_free(ep->ws);
 	kfree(ep);
 }
 
@@ -636,6 +750,7 @@ static int ep_read_events_proc(struct eventpoll *ep, struct list_head *head,
 			 * callback, but it's not actually ready, as far as
 			 * caller requested events goes. We can remove it here.
 			 */
+			ep_relax(epi->ws);
 			list_del_init(&epi->rdllink);
 		}
 	}
@@ -821,12 +936,14 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 			epi->next = ep->ovflist;
 			ep->ovflist = epi;
 		}
+		ep_stay_awake(epi->ws);
 		goto out_unlock;
 	}
 
 	/* If this file is already in the ready list we exit soon */
 	if (!ep_is_linked(&epi->rdllink))
 		list_add_tail(&epi->rdllink, &ep->rdllist);
+	ep_stay_awake(epi->ws);
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
@@ -915,6 +1032,12 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	epi->event = *event;
 	epi->nwait = 0;
 	epi->next = EP_UNACTIVE_PTR;
+	epi->ws = NULL;
+	if (epi->event.events & EPOLLWAKEUP) {
+		error = ep_create_wakeup_source(epi);
+		if (error)
+			goto error_create_wakeup_source;
+	}
 
 	/* Initialize the poll table using the queue callback */
 	epq.epi = epi;
@@ -955,6 +1078,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	/* If the file is already "ready" we drop it inside the ready list */
 	if ((revents & event->events) && !ep_is_linked(&epi->rdllink)) {
 		list_add_tail(&epi->rdllink, &ep->rdllist);
+		ep_stay_awake(epi->ws);
 
 		/* Notify waiting tasks that events are available */
 		if (waitqueue_active(&ep->wq))
@@ -987,6 +1111,8 @@ error_unregister:
 		list_del_init(&epi->rdllink);
 	spin_unlock_irqrestore(&ep->lock, flags);
 
+error_create_wakeup_source:
+	ep_wakeup_source_free(epi->ws);
 	kmem_cache_free(epi_cache, epi);
 
 	return error;
@@ -1001,6 +1127,13 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	int pwake = 0;
 	unsigned int revents;
 
+	if (event->events & EPOLLWAKEUP) {
+		if (!epi->ws && ep_create_wakeup_source(epi))
+			return -ENOMEM;
+	} else if (epi->ws) {
+		ep_destroy_wakeup_source(epi);
+	}
+
 	/*
 	 * Set the new event interest mask before calling f_op->poll();
 	 * otherwise we might miss an event that happens between the
@@ -1021,6 +1154,7 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	 */
 	if (revents & event->events) {
 		spin_lock_irq(&ep->lock);
+		ep_stay_awake(epi->ws);
 		if (!ep_is_linked(&epi->rdllink)) {
 			list_add_tail(&epi->rdllink, &ep->rdllist);
 
@@ -1058,6 +1192,16 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 	     !list_empty(head) && eventcnt < esed->maxevents;) {
 		epi = list_first_entry(head, struct epitem, rdllink);
 
+		/*
+		 * Hand the wake lock over to ep->ws, which covers the event
+		 * until the next epoll_wait(). The item takes its own again
+		 * below if it stays ready.
+		 */
+		if (epi->ws) {
+			ep_stay_awake(ep->ws);
+			ep_relax(epi->ws);
+		}
+
 		list_del_init(&epi->rdllink);
 
 		revents = epi->ffd.file->f_op->poll(epi->ffd.file, NULL) &
@@ -1092,6 +1236,7 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 				 * poll callback will queue them in ep->ovflist.
 				 */
 				list_add_tail(&epi->rdllink, &ep->rdllist);
+				ep_stay_awake(epi->ws);
 			}
 		}
 	}
@@ -1113,12 +1258,13 @@ static int ep_send_events(struct eventpoll *ep,
 static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		   int maxevents, long timeout)
 {
-	int res, eavail, timed_out = 0;
+	int res, eavail, timed_out = 0, slept = 0;
 	unsigned long flags;
 	long slack;
 	wait_queue_t wait;
 	struct timespec end_time;
 	ktime_t expires, *to = NULL;
+	int batch_us = wakeup_batch_us;
 
 	if (timeout > 0) {
 		ktime_get_ts(&end_time);
@@ -1131,6 +1277,9 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 	}
 
 retry:
+	/* The caller is done with the events we returned last time */
+	ep_relax(ep->ws);
+
 	spin_lock_irqsave(&ep->lock, flags);
 
 	res = 0;
@@ -1160,6 +1309,7 @@ retry:
 			spin_unlock_irqrestore(&ep->lock, flags);
 			if (!schedule_hrtimeout_range(to, slack, HRTIMER_MODE_ABS))
 				timed_out = 1;
+			slept = 1;
 
 			spin_lock_irqsave(&ep->lock, flags);
 		}
@@ -1172,6 +1322,19 @@ retry:
 
 	spin_unlock_irqrestore(&ep->lock, flags);
 
+	/*
+	 * Woken by the first of a burst of events: give the rest of the burst
+	 * a moment to arrive, unless the caller's timeout runs out first.
+	 */
+	if (!res && eavail && slept && batch_us && !timed_out &&
+	    (!to || ktime_to_us(ktime_sub(*to, ktime_get())) > batch_us)) {
+		ktime_t batch = ktime_set(0, batch_us * NSEC_PER_USEC);
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		schedule_hrtimeout_range(&batch, 0, HRTIMER_MODE_REL);
+		slept = 0;
+	}
+
 	/*
 	 * Try to transfer events to user space. In case we get 0 events and
 	 * there's still timeout left over, we go trying again in search of
@@ -1273,6 +1436,10 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	 */
 	ep = file->private_data;
 
+	if (ep_op_has_event(op) && (epds.events & EPOLLWAKEUP) &&
+	    !ep_may_wakeup())
+		epds.events &= ~EPOLLWAKEUP;
+
 	mutex_lock(&ep->mtx);
 
 	/*
@@ -850,6 +850,7 @@ static int de_thread(struct task_struct *tsk)
 
 		list_replace_rcu(&leader->tasks, &tsk->tasks);
 		delete_from_adj_tree(leader);
+		tsk->adj_rss = leader->adj_rss;
 		add_2_adj_tree(tsk);
 		list_replace_init(&leader->sibling, &tsk->sibling);
 
@@ -1039,6 +1039,9 @@ struct ext4_super_block {
 #define EXT4_MF_MNTDIR_SAMPLED	0x0001
 #define EXT4_MF_FS_ABORTED	0x0002	/* Fatal error detected */
 
+/* s_erase_unit while mounting: take it from the device */
+#define EXT4_ERASE_UNIT_AUTO	UINT_MAX
+
 /*
  * fourth extended-fs super-block data in memory
  */
@@ -1128,6 +1131,7 @@ struct ext4_sb_info {
 
 	/* tunables */
 	unsigned long s_stripe;
+	unsigned int s_erase_unit;
 	unsigned int s_mb_stream_request;
 	unsigned int s_mb_max_to_scan;
 	unsigned int s_mb_min_to_scan;
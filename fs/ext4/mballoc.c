@@ -1672,14 +1672,30 @@ int ext4_mb_try_best_found(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Alignment the goal extent should start at: the stripe for stripe-size
+ * requests, the flash erase unit for requests that are a multiple of it.
+ * 0 if the request need not be aligned.
+ */
+static unsigned int ext4_mb_goal_align(struct ext4_allocation_context *ac)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+
+	if (ac->ac_g_ex.fe_len == sbi->s_stripe)
+		return sbi->s_stripe;
+	if (sbi->s_erase_unit && ac->ac_g_ex.fe_len % sbi->s_erase_unit == 0)
+		return sbi->s_erase_unit;
+	return 0;
+}
+
 static noinline_for_stack
 int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 				struct ext4_buddy *e4b)
 {
 	ext4_group_t group = ac->ac_g_ex.fe_group;
+	unsigned int align = ext4_mb_goal_align(ac);
 	int max;
 	int err;
-	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
 	struct ext4_free_extent ex;
 
 	if (!(ac->ac_flags & EXT4_MB_HINT_TRY_GOAL))
@@ -1693,13 +1709,13 @@ int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 	max = mb_find_extent(e4b, 0, ac->ac_g_ex.fe_start,
 			     ac->ac_g_ex.fe_len, &ex);
 
-	if (max >= ac->ac_g_ex.fe_len && ac->ac_g_ex.fe_len == sbi->s_stripe) {
+	if (max >= ac->ac_g_ex.fe_len && align) {
 		ext4_fsblk_t start;
 
 		start = ext4_group_first_block_no(ac->ac_sb, e4b->bd_group) +
 			ex.fe_start;
 		/* use do_div to get remainder (would be 64-bit modulo) */
-		if (do_div(start, sbi->s_stripe) == 0) {
+		if (do_div(start, align) == 0) {
 			ac->ac_found++;
 			ac->ac_b_ex = ex;
 			ext4_mb_use_best_found(ac, e4b);
@@ -1832,15 +1848,17 @@ void ext4_mb_complex_scan_group(struct ext4_allocation_context *ac,
 
 /*
  * This is a special case for storages like raid5
- * we try to find stripe-aligned chunks for stripe-size requests
- * XXX should do so at least for multiples of stripe size as well
+ * we try to find stripe-aligned chunks for stripe-size requests.
+ * On flash, requests that are a multiple of the erase unit get
+ * unit-aligned chunks the same way.
  */
 static noinline_for_stack
 void ext4_mb_scan_aligned(struct ext4_allocation_context *ac,
 				 struct ext4_buddy *e4b)
 {
 	struct super_block *sb = ac->ac_sb;
-	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned int align = ext4_mb_goal_align(ac);
+	int len = ac->ac_g_ex.fe_len;
 	void *bitmap = EXT4_MB_BITMAP(e4b);
 	struct ext4_free_extent ex;
 	ext4_fsblk_t first_group_block;
@@ -1848,26 +1866,26 @@ void ext4_mb_scan_aligned(struct ext4_allocation_context *ac,
 	ext4_grpblk_t i;
 	int max;
 
-	BUG_ON(sbi->s_stripe == 0);
+	BUG_ON(align == 0);
 
-	/* find first stripe-aligned block in group */
+	/* find first aligned block in group */
 	first_group_block = ext4_group_first_block_no(sb, e4b->bd_group);
 
-	a = first_group_block + sbi->s_stripe - 1;
-	do_div(a, sbi->s_stripe);
-	i = (a * sbi->s_stripe) - first_group_block;
+	a = first_group_block + align - 1;
+	do_div(a, align);
+	i = (a * align) - first_group_block;
 
 	while (i < EXT4_BLOCKS_PER_GROUP(sb)) {
 		if (!mb_test_bit(i, bitmap)) {
-			max = mb_find_extent(e4b, 0, i, sbi->s_stripe, &ex);
-			if (max >= sbi->s_stripe) {
+			max = mb_find_extent(e4b, 0, i, len, &ex);
+			if (max >= len) {
 				ac->ac_found++;
 				ac->ac_b_ex = ex;
 				ext4_mb_use_best_found(ac, e4b);
 				break;
 			}
 		}
-		i += sbi->s_stripe;
+		i += align;
 	}
 }
 
@@ -2102,8 +2120,7 @@ repeat:
 			ac->ac_groups_scanned++;
 			if (cr == 0)
 				ext4_mb_simple_scan_group(ac, &e4b);
-			else if (cr == 1 &&
-					ac->ac_g_ex.fe_len == sbi->s_stripe)
+			else if (cr == 1 && ext4_mb_goal_align(ac))
 				ext4_mb_scan_aligned(ac, &e4b);
 			else
 				ext4_mb_complex_scan_group(ac, &e4b);
@@ -2877,7 +2894,8 @@ out_err:
  * here we normalize request for locality group
  * Group request are normalized to s_strip size if we set the same via mount
  * option. If not we set it to s_mb_group_prealloc which can be configured via
- * /sys/fs/ext4/<partition>/mb_group_prealloc
+ * /sys/fs/ext4/<partition>/mb_group_prealloc, rounded up to whole flash
+ * erase units so small files are packed into units of their own
  *
  * XXX: should we try to preallocate more than the group has now?
  */
@@ -2889,6 +2907,9 @@ static void ext4_mb_normalize_group_request(struct ext4_allocation_context *ac)
 	BUG_ON(lg == NULL);
 	if (EXT4_SB(sb)->s_stripe)
 		ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_stripe;
+	else if (EXT4_SB(sb)->s_erase_unit)
+		ac->ac_g_ex.fe_len = roundup(EXT4_SB(sb)->s_mb_group_prealloc,
+					     EXT4_SB(sb)->s_erase_unit);
 	else
 		ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_mb_group_prealloc;
 	mb_debug(1, "#%u: goal %u blocks for locality group\n",
@@ -1008,6 +1008,8 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 
 	if (sbi->s_stripe)
 		seq_printf(seq, ",stripe=%lu", sbi->s_stripe);
+	if (sbi->s_erase_unit)
+		seq_printf(seq, ",erase_unit=%u", sbi->s_erase_unit);
 	/*
 	 * journal mode get enabled in different ways
 	 * So just print the value even if we didn't specify it
@@ -1211,7 +1213,7 @@ enum {
 	Opt_jqfmt_vfsold, Opt_jqfmt_vfsv0, Opt_jqfmt_vfsv1, Opt_quota,
 	Opt_noquota, Opt_ignore, Opt_barrier, Opt_nobarrier, Opt_err,
 	Opt_resize, Opt_usrquota, Opt_grpquota, Opt_i_version,
-	Opt_stripe, Opt_delalloc, Opt_nodelalloc,
+	Opt_stripe, Opt_erase_unit, Opt_delalloc, Opt_nodelalloc,
 	Opt_block_validity, Opt_noblock_validity,
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
@@ -1272,6 +1274,7 @@ static const match_table_t tokens = {
 	{Opt_nobarrier, "nobarrier"},
 	{Opt_i_version, "i_version"},
 	{Opt_stripe, "stripe=%u"},
+	{Opt_erase_unit, "erase_unit=%u"},
 	{Opt_resize, "resize"},
 	{Opt_delalloc, "delalloc"},
 	{Opt_nodelalloc, "nodelalloc"},
@@ -1700,6 +1703,13 @@ set_qf_format:
 				return 0;
 			sbi->s_stripe = option;
 			break;
+		case Opt_erase_unit:
+			if (match_int(&args[0], &option))
+				return 0;
+			if (option < 0)
+				return 0;
+			sbi->s_erase_unit = option;
+			break;
 		case Opt_delalloc:
 			set_opt(sbi->s_mount_opt, DELALLOC);
 			break;
@@ -2278,6 +2288,32 @@ static unsigned long ext4_get_stripe_size(struct ext4_sb_info *sbi)
 	return 0;
 }
 
+/*
+ * ext4_get_erase_unit: Get the flash erase unit size.
+ * @sb: super block
+ *
+ * Use the erase_unit mount option if given, else the optimal I/O size
+ * of the device, which the MMC block driver sets to the card's erase
+ * or allocation unit. Like the stripe, the allocator needs it to be
+ * less than blocks per group.
+ */
+static unsigned int ext4_get_erase_unit(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned int unit = sbi->s_erase_unit;
+
+	if (unit == EXT4_ERASE_UNIT_AUTO) {
+		unit = bdev_io_opt(sb->s_bdev) >> sb->s_blocksize_bits;
+		if (unit < 2)
+			return 0;
+	}
+
+	if (unit > sbi->s_blocks_per_group)
+		return 0;
+
+	return unit;
+}
+
 /* sysfs supprt */
 
 struct ext4_attr {
@@ -2685,6 +2721,7 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	    ((def_mount_opts & EXT4_DEFM_NODELALLOC) == 0))
 		set_opt(sbi->s_mount_opt, DELALLOC);
 
+	sbi->s_erase_unit = EXT4_ERASE_UNIT_AUTO;
 	if (!parse_options((char *) sbi->s_es->s_mount_opts, sb,
 			   &journal_devnum, &journal_ioprio, NULL, 0)) {
 		ext4_msg(sb, KERN_WARNING,
@@ -2947,6 +2984,7 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	}
 
 	sbi->s_stripe = ext4_get_stripe_size(sbi);
+	sbi->s_erase_unit = ext4_get_erase_unit(sb);
 	sbi->s_max_writeback_mb_bump = 128;
 
 	/*
@@ -3768,6 +3806,7 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 		err = -EINVAL;
 		goto restore_opts;
 	}
+	sbi->s_erase_unit = ext4_get_erase_unit(sb);
 
 	if (sbi->s_mount_flags & EXT4_MF_FS_ABORTED)
 		ext4_abort(sb, "Abort forced by user");
@@ -22,8 +22,11 @@
 #include <linux/rbtree.h>
 #include <linux/poll.h>
 
-/** Max number of pages that can be used in a single read request */
-#define FUSE_MAX_PAGES_PER_REQ 32
+/** Default max number of pages that can be used in a single request */
+#define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
+
+/** Upper limit for the negotiated max_pages, and size of req->pages */
+#define FUSE_MAX_MAX_PAGES 128
 
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
@@ -277,7 +280,7 @@ struct fuse_req {
 	} misc;
 
 	/** page vector */
-	struct page *pages[FUSE_MAX_PAGES_PER_REQ];
+	struct page *pages[FUSE_MAX_MAX_PAGES];
 
 	/** number of pages in vector */
 	unsigned num_pages;
@@ -333,6 +336,9 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
+	/** Maximum number of pages in a request */
+	unsigned max_pages;
+
 	/** Readers of the connection are waiting on this */
 	wait_queue_head_t waitq;
 
@@ -472,6 +472,15 @@ static void prune_icache(int nr_to_scan)
 			list_move(&inode->i_list, &inode_unused);
 			continue;
 		}
+		/*
+		 * Leave the page cache of filesystems weighted below the
+		 * default to the page LRU rather than dropping it here.
+		 */
+		if (inode->i_data.nrpages &&
+		    inode->i_sb->s_cache_weight < SB_CACHE_WEIGHT_DEFAULT) {
+			list_move(&inode->i_list, &inode_unused);
+			continue;
+		}
 		if (inode_has_buffers(inode) || inode->i_data.nrpages) {
 			__iget(inode);
 			spin_unlock(&inode_lock);
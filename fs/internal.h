@@ -89,6 +89,7 @@ extern struct file *get_empty_filp(void);
 extern int do_remount_sb(struct super_block *, int, void *, int);
 extern void __put_super(struct super_block *sb);
 extern void put_super(struct super_block *sb);
+extern void __init sb_sysfs_init(void);
 
 /*
  * open.c
@@ -1008,6 +1008,8 @@ restart_loop:
 	 */
 	stats.ts_tid = commit_transaction->t_tid;
 	stats.run.rs_handle_count = commit_transaction->t_handle_count;
+	stats.run.rs_fsyncs = commit_transaction->t_fsyncs;
+	stats.run.rs_fsync_commits = commit_transaction->t_fsyncs ? 1 : 0;
 	trace_jbd2_run_stats(journal->j_fs_dev->bd_dev,
 			     commit_transaction->t_tid, &stats.run);
 
@@ -1024,6 +1026,8 @@ restart_loop:
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
+	journal->j_stats.run.rs_fsyncs += stats.run.rs_fsyncs;
+	journal->j_stats.run.rs_fsync_commits += stats.run.rs_fsync_commits;
 	spin_unlock(&journal->j_history_lock);
 
 	commit_transaction->t_state = T_FINISHED;
@@ -43,6 +43,7 @@
 #include <linux/vmalloc.h>
 #include <linux/backing-dev.h>
 #include <linux/bitops.h>
+#include <linux/hrtimer.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/jbd2.h>
@@ -82,6 +83,7 @@ EXPORT_SYMBOL(jbd2_journal_ack_err);
 EXPORT_SYMBOL(jbd2_journal_clear_err);
 EXPORT_SYMBOL(jbd2_log_wait_commit);
 EXPORT_SYMBOL(jbd2_log_start_commit);
+EXPORT_SYMBOL(jbd2_log_batch_fsync);
 EXPORT_SYMBOL(jbd2_journal_start_commit);
 EXPORT_SYMBOL(jbd2_journal_force_commit_nested);
 EXPORT_SYMBOL(jbd2_journal_wipe);
@@ -505,6 +507,53 @@ int jbd2_log_start_commit(journal_t *journal, tid_t tid)
 	return ret;
 }
 
+/**
+ * jbd2_log_batch_fsync() - give other fsyncs a chance to join a commit
+ * @journal: journal
+ * @tid: transaction an fsync is about to commit
+ *
+ * Called before jbd2_log_start_commit() for an fsync.  Like synchronous
+ * handles in jbd2_journal_stop(), if the last fsync came from another
+ * task, wait until the transaction has been running for about as long
+ * as a commit takes (bounded by j_min_batch_time and j_max_batch_time),
+ * so fsyncs from other tasks land in the same commit instead of each
+ * paying for their own commit and cache flush.  A single task issuing
+ * a stream of fsyncs never waits.
+ */
+void jbd2_log_batch_fsync(journal_t *journal, tid_t tid)
+{
+	transaction_t *transaction;
+	pid_t pid = current->pid;
+	u64 commit_time, trans_time;
+
+	spin_lock(&journal->j_state_lock);
+	transaction = journal->j_running_transaction;
+	if (!transaction || transaction->t_tid != tid) {
+		spin_unlock(&journal->j_state_lock);
+		return;
+	}
+	transaction->t_fsyncs++;
+	if (journal->j_last_sync_writer == pid) {
+		spin_unlock(&journal->j_state_lock);
+		return;
+	}
+	journal->j_last_sync_writer = pid;
+	commit_time = journal->j_average_commit_time;
+	trans_time = ktime_to_ns(ktime_sub(ktime_get(),
+					   transaction->t_start_time));
+	spin_unlock(&journal->j_state_lock);
+
+	commit_time = max_t(u64, commit_time, 1000*journal->j_min_batch_time);
+	commit_time = min_t(u64, commit_time, 1000*journal->j_max_batch_time);
+
+	if (trans_time < commit_time) {
+		ktime_t expires = ktime_add_ns(ktime_get(),
+					       commit_time - trans_time);
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+	}
+}
+
 /*
  * Force and wait upon a commit if the calling process is not within
  * transaction.  This is used for forcing out undo-protected data which contains
@@ -734,6 +783,11 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	seq_printf(seq, "%u fsyncs in %u fsync commits\n",
+	    s->stats->run.rs_fsyncs, s->stats->run.rs_fsync_commits);
+	if (s->stats->run.rs_fsync_commits)
+		seq_printf(seq, "  %u fsyncs per fsync commit\n",
+		    s->stats->run.rs_fsyncs / s->stats->run.rs_fsync_commits);
 	return 0;
 }
 
@@ -753,6 +753,7 @@ need_lookup:
 		new = d_alloc(parent, name);
 		dentry = ERR_PTR(-ENOMEM);
 		if (new) {
+			dir->i_sb->s_lookup_misses++;
 			dentry = dir->i_op->lookup(dir, new, nd);
 			if (dentry)
 				dput(new);
@@ -1162,6 +1163,7 @@ static struct dentry *__lookup_hash(struct qstr *name,
 		dentry = ERR_PTR(-ENOMEM);
 		if (!new)
 			goto out;
+		inode->i_sb->s_lookup_misses++;
 		dentry = inode->i_op->lookup(inode, new, nd);
 		if (!dentry)
 			dentry = new;
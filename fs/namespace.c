@@ -2334,6 +2334,7 @@ void __init mnt_init(void)
 		printk(KERN_WARNING "%s: kobj create error\n", __func__);
 	init_rootfs();
 	init_mount_tree();
+	sb_sysfs_init();
 }
 
 void put_mnt_ns(struct mnt_namespace *ns)
@@ -82,6 +82,7 @@
 #include <linux/pid_namespace.h>
 #include <linux/fs_struct.h>
 #include <linux/slab.h>
+#include <linux/uksm.h>
 #include "internal.h"
 
 /* NOTE:
@@ -366,6 +367,37 @@ static int proc_pid_schedstat(struct task_struct *task, char *buffer)
 			(unsigned long long)task->sched_info.run_delay,
 			task->sched_info.pcount);
 }
+
+/*
+ * Provides /proc/PID/schedstat_hist
+ */
+static int proc_pid_schedstat_hist(struct task_struct *task, char *buffer)
+{
+	unsigned int *hist = task->sched_info.delay_hist;
+	int i, len = 0;
+
+	for (i = 0; i < SCHED_DELAY_HIST_BUCKETS; i++)
+		len += sprintf(buffer + len, "%s%u", i ? " " : "", hist[i]);
+	len += sprintf(buffer + len, "\n");
+	return len;
+}
+#endif
+
+#ifdef CONFIG_UKSM
+/*
+ * Provides /proc/PID/uksm
+ */
+static int proc_pid_uksm(struct seq_file *m, struct pid_namespace *ns,
+			 struct pid *pid, struct task_struct *task)
+{
+	struct mm_struct *mm = mm_for_maps(task);
+
+	if (!mm)
+		return -EACCES;
+	uksm_show_mm(m, mm);
+	mmput(mm);
+	return 0;
+}
 #endif
 
 #ifdef CONFIG_LATENCYTOP
@@ -1024,6 +1056,7 @@ static ssize_t oom_adjust_write(struct file *file, const char __user *buf,
 				size_t count, loff_t *ppos)
 {
 	struct task_struct *task;
+	struct mm_struct *mm;
 	char buffer[PROC_NUMBUF];
 	long oom_adjust;
 	unsigned long flags;
@@ -1045,13 +1078,18 @@ static ssize_t oom_adjust_write(struct file *file, const char __user *buf,
 	task = get_proc_task(file->f_path.dentry->d_inode);
 	if (!task)
 		return -ESRCH;
+	mm = get_task_mm(task);
 	if (!lock_task_sighand(task, &flags)) {
+		if (mm)
+			mmput(mm);
 		put_task_struct(task);
 		return -ESRCH;
 	}
 
 	if (oom_adjust < task->signal->oom_adj && !capable(CAP_SYS_RESOURCE)) {
 		unlock_task_sighand(task, &flags);
+		if (mm)
+			mmput(mm);
 		put_task_struct(task);
 		return -EACCES;
 	}
@@ -1059,10 +1097,22 @@ static ssize_t oom_adjust_write(struct file *file, const char __user *buf,
 	task->signal->oom_adj = oom_adjust;
 
 	unlock_task_sighand(task, &flags);
+
+	/*
+	 * Re-bucket the group leader under tasklist_lock so that it can be
+	 * neither released nor replaced by de_thread() while we do it.
+	 */
+	read_lock(&tasklist_lock);
+	if (pid_alive(task->group_leader)) {
+		if (mm)
+			task->group_leader->adj_rss = get_mm_rss(mm);
+		add_2_adj_tree(task->group_leader);
+	}
+	read_unlock(&tasklist_lock);
+
+	if (mm)
+		mmput(mm);
 	put_task_struct(task);
-	
-	delete_from_adj_tree(task);
-	add_2_adj_tree(task);
 
 	return count;
 }
@@ -2712,6 +2762,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 	INF("cmdline",    S_IRUGO, proc_pid_cmdline),
 	ONE("stat",       S_IRUGO, proc_tgid_stat),
 	ONE("statm",      S_IRUGO, proc_pid_statm),
+#ifdef CONFIG_UKSM
+	ONE("uksm",       S_IRUGO, proc_pid_uksm),
+#endif
 	REG("maps",       S_IRUGO, proc_maps_operations),
 #ifdef CONFIG_NUMA
 	REG("numa_maps",  S_IRUGO, proc_numa_maps_operations),
@@ -2739,6 +2792,7 @@ static const struct pid_entry tgid_base_stuff[] = {
 #endif
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat",  S_IRUGO, proc_pid_schedstat),
+	INF("schedstat_hist", S_IRUGO, proc_pid_schedstat_hist),
 #endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
@@ -3073,6 +3127,7 @@ static const struct pid_entry tid_base_stuff[] = {
 #endif
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat", S_IRUGO, proc_pid_schedstat),
+	INF("schedstat_hist", S_IRUGO, proc_pid_schedstat_hist),
 #endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
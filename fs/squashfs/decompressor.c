@@ -23,6 +23,9 @@
 
 #include <linux/types.h>
 #include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/cpumask.h>
 #include <linux/buffer_head.h>
 
 #include "squashfs_fs.h"
@@ -40,9 +43,17 @@ static const struct squashfs_decompressor squashfs_lzma_unsupported_comp_ops = {
 	NULL, NULL, NULL, LZMA_COMPRESSION, "lzma", 0
 };
 
-static const struct squashfs_decompressor squashfs_lzo_unsupported_comp_ops = {
+#ifndef CONFIG_SQUASHFS_LZO
+static const struct squashfs_decompressor squashfs_lzo_comp_ops = {
 	NULL, NULL, NULL, LZO_COMPRESSION, "lzo", 0
 };
+#endif
+
+#ifndef CONFIG_SQUASHFS_XZ
+static const struct squashfs_decompressor squashfs_xz_comp_ops = {
+	NULL, NULL, NULL, XZ_COMPRESSION, "xz", 0
+};
+#endif
 
 static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 	NULL, NULL, NULL, 0, "unknown", 0
@@ -51,7 +62,8 @@ static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 static const struct squashfs_decompressor *decompressor[] = {
 	&squashfs_zlib_comp_ops,
 	&squashfs_lzma_unsupported_comp_ops,
-	&squashfs_lzo_unsupported_comp_ops,
+	&squashfs_lzo_comp_ops,
+	&squashfs_xz_comp_ops,
 	&squashfs_unknown_comp_ops
 };
 
@@ -66,3 +78,153 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 
 	return decompressor[i];
 }
+
+
+/*
+ * Each mounted filesystem keeps a pool of decompressor streams, so readers
+ * don't serialise on one stream.  A stream is held while waiting for the
+ * compressed block to be read, so even on a uniprocessor a second stream
+ * lets one reader decompress while another waits for I/O.  The first
+ * stream is allocated at mount time, others only when all streams are
+ * busy, up to squashfs_max_decompressors().
+ */
+struct squashfs_stream {
+	struct mutex		mutex;
+	struct list_head	free;
+	int			streams;
+	int			max_streams;
+	wait_queue_head_t	wait;
+};
+
+struct decomp_stream {
+	void			*stream;
+	struct list_head	list;
+};
+
+
+int squashfs_max_decompressors(void)
+{
+	return num_possible_cpus() * 2;
+}
+
+
+static struct decomp_stream *alloc_decomp_stream(struct squashfs_sb_info *msblk)
+{
+	struct decomp_stream *decomp_strm;
+
+	decomp_strm = kmalloc(sizeof(*decomp_strm), GFP_KERNEL);
+	if (decomp_strm == NULL)
+		return NULL;
+
+	decomp_strm->stream = msblk->decompressor->init(msblk);
+	if (decomp_strm->stream == NULL) {
+		kfree(decomp_strm);
+		return NULL;
+	}
+
+	return decomp_strm;
+}
+
+
+struct squashfs_stream *squashfs_decompressor_init(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *stream;
+	struct decomp_stream *decomp_strm;
+
+	stream = kmalloc(sizeof(*stream), GFP_KERNEL);
+	if (stream == NULL)
+		return NULL;
+
+	decomp_strm = alloc_decomp_stream(msblk);
+	if (decomp_strm == NULL) {
+		kfree(stream);
+		return NULL;
+	}
+
+	mutex_init(&stream->mutex);
+	INIT_LIST_HEAD(&stream->free);
+	list_add(&decomp_strm->list, &stream->free);
+	stream->streams = 1;
+	stream->max_streams = squashfs_max_decompressors();
+	init_waitqueue_head(&stream->wait);
+
+	return stream;
+}
+
+
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk,
+	struct squashfs_stream *stream)
+{
+	struct decomp_stream *decomp_strm, *tmp;
+
+	if (stream == NULL)
+		return;
+
+	list_for_each_entry_safe(decomp_strm, tmp, &stream->free, list) {
+		list_del(&decomp_strm->list);
+		msblk->decompressor->free(decomp_strm->stream);
+		kfree(decomp_strm);
+	}
+
+	kfree(stream);
+}
+
+
+static struct decomp_stream *get_decomp_stream(struct squashfs_sb_info *msblk,
+	struct squashfs_stream *stream)
+{
+	struct decomp_stream *decomp_strm;
+
+	mutex_lock(&stream->mutex);
+	while (1) {
+		if (!list_empty(&stream->free)) {
+			decomp_strm = list_first_entry(&stream->free,
+				struct decomp_stream, list);
+			list_del(&decomp_strm->list);
+			break;
+		}
+
+		if (stream->streams < stream->max_streams) {
+			decomp_strm = alloc_decomp_stream(msblk);
+			if (decomp_strm) {
+				stream->streams++;
+				break;
+			}
+			/* Make do with the streams we have */
+			stream->max_streams = stream->streams;
+		}
+
+		mutex_unlock(&stream->mutex);
+		wait_event(stream->wait, !list_empty(&stream->free));
+		mutex_lock(&stream->mutex);
+	}
+	mutex_unlock(&stream->mutex);
+
+	return decomp_strm;
+}
+
+
+static void put_decomp_stream(struct squashfs_stream *stream,
+	struct decomp_stream *decomp_strm)
+{
+	mutex_lock(&stream->mutex);
+	list_add(&decomp_strm->list, &stream->free);
+	mutex_unlock(&stream->mutex);
+	wake_up(&stream->wait);
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	struct decomp_stream *decomp_strm;
+	int res;
+
+	decomp_strm = get_decomp_stream(msblk, msblk->stream);
+	res = msblk->decompressor->decompress(msblk, decomp_strm->stream,
+		buffer, bh, b, offset, length, srclength, pages);
+	put_decomp_stream(msblk->stream, decomp_strm);
+
+	return res;
+}
@@ -371,6 +371,92 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Decompress a datablock straight into the page cache pages it covers,
+ * instead of into the "data" cache and copying it out from there.  This
+ * only works if every page of the block that is not yet uptodate can be
+ * grabbed, otherwise -EAGAIN is returned and the caller goes through the
+ * cache.  Returns 0 with target_page unlocked on success; on any error
+ * target_page is left locked.
+ */
+static int squashfs_readpage_block(struct page *target_page, u64 block,
+	int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int i, n, pages, res = -EAGAIN;
+	struct page **page;
+	void **pageaddr;
+
+	/* Don't grab pages beyond the end of the file */
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	page = kcalloc(pages, sizeof(*page), GFP_KERNEL);
+	pageaddr = kmalloc(pages * sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	for (i = 0, n = start_index; i < pages; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+		/* Decompressing needs all pages, even the uptodate ones */
+		if (page[i] == NULL || PageUptodate(page[i]))
+			goto release_pages;
+	}
+
+	for (i = 0; i < pages; i++)
+		pageaddr[i] = kmap(page[i]);
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+	for (i = 0; i < pages; i++)
+		kunmap(page[i]);
+
+	if (res < 0) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		res = -EIO;
+		goto release_pages;
+	}
+
+	/* Zero whatever the block didn't fill */
+	for (i = res >> PAGE_CACHE_SHIFT; i < pages; i++) {
+		int offset = max(res - (i << PAGE_CACHE_SHIFT), 0);
+		void *addr = kmap_atomic(page[i], KM_USER0);
+
+		memset(addr + offset, 0, PAGE_CACHE_SIZE - offset);
+		kunmap_atomic(addr, KM_USER0);
+	}
+
+	for (i = 0; i < pages; i++) {
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+		unlock_page(page[i]);
+		if (page[i] != target_page)
+			page_cache_release(page[i]);
+	}
+	res = 0;
+	goto out;
+
+release_pages:
+	for (i = 0; i < pages && page[i]; i++) {
+		if (page[i] == target_page)
+			continue;
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -410,8 +496,16 @@ static int squashfs_readpage(struct file *file, struct page *page)
 			sparse = 1;
 		} else {
 			/*
-			 * Read and decompress datablock.
+			 * Read and decompress datablock, straight into the
+			 * page cache if possible.
 			 */
+			int res = squashfs_readpage_block(page, block, bsize);
+
+			if (res == 0)
+				return 0;
+			if (res != -EAGAIN)
+				goto error_out;
+
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
 			if (buffer->error) {
@@ -75,6 +75,21 @@ static const struct squashfs_decompressor *supported_squashfs_filesystem(short
 }
 
 
+/*
+ * Size the fragment cache to the memory of the machine: up to 1/512th of
+ * RAM in fragment blocks, but no fewer than SQUASHFS_CACHED_FRAGMENTS.
+ */
+static int squashfs_fragment_cache_size(struct squashfs_sb_info *msblk)
+{
+	unsigned long entries;
+
+	entries = (totalram_pages >> 9) / (msblk->block_size >> PAGE_SHIFT);
+
+	return clamp_t(unsigned long, entries, SQUASHFS_CACHED_FRAGMENTS,
+		max(SQUASHFS_CACHED_FRAGMENTS, SQUASHFS_CACHED_FRAGMENTS_MAX));
+}
+
+
 static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 {
 	struct squashfs_sb_info *msblk;
@@ -105,7 +120,6 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	msblk->devblksize = sb_min_blocksize(sb, BLOCK_SIZE);
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
 
-	mutex_init(&msblk->read_data_mutex);
 	mutex_init(&msblk->meta_index_mutex);
 
 	/*
@@ -209,8 +223,12 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
-	/* Allocate read_page block */
-	msblk->read_page = squashfs_cache_init("data", 1, msblk->block_size);
+	/*
+	 * Allocate read_page blocks, one for each decompressor stream so
+	 * concurrent datablock reads don't wait for each other's entry
+	 */
+	msblk->read_page = squashfs_cache_init("data",
+		squashfs_max_decompressors(), msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
@@ -230,7 +248,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 		goto allocate_lookup_table;
 
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		squashfs_fragment_cache_size(msblk), msblk->block_size);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
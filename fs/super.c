@@ -97,6 +97,7 @@ static struct super_block *alloc_super(struct file_system_type *type)
 		s->s_op = &default_op;
 		s->s_time_gran = 1000000000;
 		s->cleancache_poolid = -1;
+		s->s_cache_weight = SB_CACHE_WEIGHT_DEFAULT;
 	}
 out:
 	return s;
@@ -143,6 +144,159 @@ void put_super(struct super_block *sb)
 	spin_unlock(&sb_lock);
 }
 
+/*
+ * /sys/fs/sb/<major>:<minor>/ for every mounted superblock, to tune how
+ * hard its dentries and inodes are reclaimed and to see how often its
+ * lookups miss the dcache.
+ */
+static struct kobject *sb_kobj;
+
+struct sb_kobject {
+	struct kobject kobj;
+	struct super_block *sb;
+};
+
+#define to_sb(k) (container_of(k, struct sb_kobject, kobj)->sb)
+
+static ssize_t type_show(struct kobject *kobj, struct kobj_attribute *attr,
+			 char *buf)
+{
+	return sprintf(buf, "%s\n", to_sb(kobj)->s_type->name);
+}
+
+static ssize_t id_show(struct kobject *kobj, struct kobj_attribute *attr,
+		       char *buf)
+{
+	return sprintf(buf, "%s\n", to_sb(kobj)->s_id);
+}
+
+static ssize_t cache_weight_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", to_sb(kobj)->s_cache_weight);
+}
+
+static ssize_t cache_weight_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val) || val > SB_CACHE_WEIGHT_MAX)
+		return -EINVAL;
+
+	to_sb(kobj)->s_cache_weight = val;
+	return count;
+}
+
+static ssize_t lookup_misses_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", to_sb(kobj)->s_lookup_misses);
+}
+
+static ssize_t dentry_unused_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", to_sb(kobj)->s_nr_dentry_unused);
+}
+
+static struct kobj_attribute type_attr = __ATTR_RO(type);
+static struct kobj_attribute id_attr = __ATTR_RO(id);
+static struct kobj_attribute cache_weight_attr =
+	__ATTR(cache_weight, 0644, cache_weight_show, cache_weight_store);
+static struct kobj_attribute lookup_misses_attr = __ATTR_RO(lookup_misses);
+static struct kobj_attribute dentry_unused_attr = __ATTR_RO(dentry_unused);
+
+static struct attribute *sb_attrs[] = {
+	&type_attr.attr,
+	&id_attr.attr,
+	&cache_weight_attr.attr,
+	&lookup_misses_attr.attr,
+	&dentry_unused_attr.attr,
+	NULL,
+};
+
+static void sb_kobj_release(struct kobject *kobj)
+{
+	kfree(container_of(kobj, struct sb_kobject, kobj));
+}
+
+static struct kobj_type sb_ktype = {
+	.sysfs_ops	= &kobj_sysfs_ops,
+	.default_attrs	= sb_attrs,
+	.release	= sb_kobj_release,
+};
+
+/* Caller holds s_umount for writing */
+static void sb_sysfs_add(struct super_block *s)
+{
+	struct sb_kobject *sk;
+
+	if (!sb_kobj || s->s_kobj)
+		return;
+
+	sk = kzalloc(sizeof(*sk), GFP_KERNEL);
+	if (!sk)
+		return;
+
+	sk->sb = s;
+	if (kobject_init_and_add(&sk->kobj, &sb_ktype, sb_kobj, "%u:%u",
+				 MAJOR(s->s_dev), MINOR(s->s_dev))) {
+		kobject_put(&sk->kobj);
+		return;
+	}
+	s->s_kobj = &sk->kobj;
+}
+
+/* Caller holds s_umount for writing */
+static void sb_sysfs_del(struct super_block *s)
+{
+	if (!s->s_kobj)
+		return;
+
+	/* No attribute method runs once this returns */
+	kobject_del(s->s_kobj);
+	kobject_put(s->s_kobj);
+	s->s_kobj = NULL;
+}
+
+/*
+ * Called once fs_kobj exists; add the superblocks mounted before that,
+ * like sysfs and rootfs.
+ */
+void __init sb_sysfs_init(void)
+{
+	struct super_block *sb, *p = NULL;
+
+	if (!fs_kobj)
+		return;
+	sb_kobj = kobject_create_and_add("sb", fs_kobj);
+	if (!sb_kobj)
+		return;
+
+	spin_lock(&sb_lock);
+	list_for_each_entry(sb, &super_blocks, s_list) {
+		if (list_empty(&sb->s_instances))
+			continue;
+		sb->s_count++;
+		spin_unlock(&sb_lock);
+
+		down_write(&sb->s_umount);
+		if (sb->s_root)
+			sb_sysfs_add(sb);
+		up_write(&sb->s_umount);
+
+		spin_lock(&sb_lock);
+		if (p)
+			__put_super(p);
+		p = sb;
+	}
+	if (p)
+		__put_super(p);
+	spin_unlock(&sb_lock);
+}
+
 
 /**
  *	deactivate_locked_super	-	drop an active reference to superblock
@@ -159,6 +313,7 @@ void deactivate_locked_super(struct super_block *s)
 {
 	struct file_system_type *fs = s->s_type;
 	if (atomic_dec_and_test(&s->s_active)) {
+		sb_sysfs_del(s);
 		cleancache_flush_fs(s);
 		fs->kill_sb(s);
 		put_filesystem(fs);
@@ -950,6 +1105,7 @@ vfs_kern_mount(struct file_system_type *type, int flags, const char *name, void
 
 	mnt->mnt_mountpoint = mnt->mnt_root;
 	mnt->mnt_parent = mnt;
+	sb_sysfs_add(mnt->mnt_sb);
 	up_write(&mnt->mnt_sb->s_umount);
 	free_secdata(secdata);
 	return mnt;
@@ -50,6 +50,7 @@ static int sysfs_fill_super(struct super_block *sb, void *data, int silent)
 	sb->s_magic = SYSFS_MAGIC;
 	sb->s_op = &sysfs_ops;
 	sb->s_time_gran = 1;
+	sb->s_cache_weight = SB_CACHE_WEIGHT_VOLATILE;
 
 	/* get root inode, initialize and unlock it */
 	mutex_lock(&sysfs_mutex);
@@ -14,6 +14,68 @@
 #include "yaffs_checkptrw.h"
 #include "yaffs_getblockinfo.h"
 
+#ifdef CONFIG_YAFFS_CHECKPOINT_LZO
+#include <linux/lzo.h>
+
+/*
+ * The checkpoint stream can be written as a series of LZO compressed
+ * frames, each preceded by a header of three __u32s: a magic number, the
+ * uncompressed length and the compressed length. The first word of an
+ * uncompressed stream is the size of the validity marker, so a reader can
+ * tell the two apart and still restore checkpoints written without
+ * compression. The checksum is taken over the uncompressed bytes.
+ */
+#define YAFFS_CHECKPOINT_LZO_MAGIC	0x594c5a4f
+#define YAFFS_CHECKPOINT_FRAME_SIZE	16384
+#define YAFFS_CHECKPOINT_ZBUFFER_SIZE	lzo1x_worst_compress(YAFFS_CHECKPOINT_FRAME_SIZE)
+
+static void yaffs2_CheckpointAllocFrames(yaffs_Device *dev, int forWriting)
+{
+	int zBytes = YAFFS_CHECKPOINT_ZBUFFER_SIZE;
+
+	if (forWriting)
+		zBytes += LZO1X_1_MEM_COMPRESS;
+
+	dev->checkpointFrame = YMALLOC_ALT(YAFFS_CHECKPOINT_FRAME_SIZE);
+	dev->checkpointZBuffer = YMALLOC_ALT(zBytes);
+	if (!dev->checkpointFrame || !dev->checkpointZBuffer) {
+		/* Carry on without compression */
+		if (dev->checkpointFrame)
+			YFREE_ALT(dev->checkpointFrame);
+		if (dev->checkpointZBuffer)
+			YFREE_ALT(dev->checkpointZBuffer);
+		dev->checkpointFrame = NULL;
+		dev->checkpointZBuffer = NULL;
+	}
+
+	dev->checkpointFrameLength = 0;
+	dev->checkpointFrameOffset = 0;
+	dev->checkpointCompressed = forWriting ?
+		(dev->checkpointFrame != NULL) : -1;
+}
+
+static void yaffs2_CheckpointFreeFrames(yaffs_Device *dev)
+{
+	if (dev->checkpointFrame)
+		YFREE_ALT(dev->checkpointFrame);
+	if (dev->checkpointZBuffer)
+		YFREE_ALT(dev->checkpointZBuffer);
+	dev->checkpointFrame = NULL;
+	dev->checkpointZBuffer = NULL;
+}
+#else
+static void yaffs2_CheckpointAllocFrames(yaffs_Device *dev, int forWriting)
+{
+	dev->checkpointFrame = NULL;
+	dev->checkpointZBuffer = NULL;
+	dev->checkpointCompressed = 0;
+}
+
+static void yaffs2_CheckpointFreeFrames(yaffs_Device *dev)
+{
+}
+#endif
+
 static int yaffs2_CheckpointSpaceOk(yaffs_Device *dev)
 {
 	int blocksAvailable = dev->nErasedBlocks - dev->param.nReservedBlocks;
@@ -153,6 +215,8 @@ int yaffs2_CheckpointOpen(yaffs_Device *dev, int forWriting)
 	dev->checkpointCurrentChunk = -1;
 	dev->checkpointNextBlock = dev->internalStartBlock;
 
+	yaffs2_CheckpointAllocFrames(dev, forWriting);
+
 	/* Erase all the blocks in the checkpoint area */
 	if (forWriting) {
 		memset(dev->checkpointBuffer, 0, dev->nDataBytesPerChunk);
@@ -238,7 +302,7 @@ static int yaffs2_CheckpointFlushBuffer(yaffs_Device *dev)
 }
 
 
-int yaffs2_CheckpointWrite(yaffs_Device *dev, const void *data, int nBytes)
+static int yaffs2_CheckpointWriteRaw(yaffs_Device *dev, const void *data, int nBytes)
 {
 	int i = 0;
 	int ok = 1;
@@ -247,17 +311,8 @@ int yaffs2_CheckpointWrite(yaffs_Device *dev, const void *data, int nBytes)
 	__u8 * dataBytes = (__u8 *)data;
 
 
-
-	if (!dev->checkpointBuffer)
-		return 0;
-
-	if (!dev->checkpointOpenForWrite)
-		return -1;
-
 	while (i < nBytes && ok) {
 		dev->checkpointBuffer[dev->checkpointByteOffset] = *dataBytes;
-		dev->checkpointSum += *dataBytes;
-		dev->checkpointXor ^= *dataBytes;
 
 		dev->checkpointByteOffset++;
 		i++;
@@ -273,7 +328,7 @@ int yaffs2_CheckpointWrite(yaffs_Device *dev, const void *data, int nBytes)
 	return i;
 }
 
-int yaffs2_CheckpointRead(yaffs_Device *dev, void *data, int nBytes)
+static int yaffs2_CheckpointReadRaw(yaffs_Device *dev, void *data, int nBytes)
 {
 	int i = 0;
 	int ok = 1;
@@ -285,12 +340,6 @@ int yaffs2_CheckpointRead(yaffs_Device *dev, void *data, int nBytes)
 
 	__u8 *dataBytes = (__u8 *)data;
 
-	if (!dev->checkpointBuffer)
-		return 0;
-
-	if (dev->checkpointOpenForWrite)
-		return -1;
-
 	while (i < nBytes && ok) {
 
 
@@ -336,8 +385,6 @@ int yaffs2_CheckpointRead(yaffs_Device *dev, void *data, int nBytes)
 
 		if (ok) {
 			*dataBytes = dev->checkpointBuffer[dev->checkpointByteOffset];
-			dev->checkpointSum += *dataBytes;
-			dev->checkpointXor ^= *dataBytes;
 			dev->checkpointByteOffset++;
 			i++;
 			dataBytes++;
@@ -348,10 +395,182 @@ int yaffs2_CheckpointRead(yaffs_Device *dev, void *data, int nBytes)
 	return 	i;
 }
 
+#ifdef CONFIG_YAFFS_CHECKPOINT_LZO
+static int yaffs2_CheckpointFlushFrame(yaffs_Device *dev)
+{
+	__u32 hdr[3];
+	size_t zLength;
+
+	if (dev->checkpointFrameLength == 0)
+		return 1;
+
+	if (lzo1x_1_compress(dev->checkpointFrame, dev->checkpointFrameLength,
+			dev->checkpointZBuffer, &zLength,
+			dev->checkpointZBuffer + YAFFS_CHECKPOINT_ZBUFFER_SIZE) != LZO_E_OK)
+		return 0;
+
+	hdr[0] = YAFFS_CHECKPOINT_LZO_MAGIC;
+	hdr[1] = dev->checkpointFrameLength;
+	hdr[2] = zLength;
+
+	T(YAFFS_TRACE_CHECKPOINT, (TSTR("checkpoint frame %d -> %d bytes" TENDSTR),
+		hdr[1], hdr[2]));
+
+	dev->checkpointFrameLength = 0;
+
+	return yaffs2_CheckpointWriteRaw(dev, hdr, sizeof(hdr)) == sizeof(hdr) &&
+		yaffs2_CheckpointWriteRaw(dev, dev->checkpointZBuffer, zLength) == zLength;
+}
+
+static int yaffs2_CheckpointFillFrame(yaffs_Device *dev)
+{
+	__u32 hdr[3];
+	size_t length = YAFFS_CHECKPOINT_FRAME_SIZE;
+
+	if (yaffs2_CheckpointReadRaw(dev, hdr, sizeof(hdr[0])) != sizeof(hdr[0]))
+		return 0;
+
+	if (hdr[0] != YAFFS_CHECKPOINT_LZO_MAGIC) {
+		if (dev->checkpointCompressed >= 0)
+			return 0;
+
+		/* An uncompressed checkpoint. Hand back the word we took
+		 * and read the rest straight through.
+		 */
+		memcpy(dev->checkpointFrame, hdr, sizeof(hdr[0]));
+		dev->checkpointFrameLength = sizeof(hdr[0]);
+		dev->checkpointFrameOffset = 0;
+		dev->checkpointCompressed = 0;
+		return 1;
+	}
+
+	dev->checkpointCompressed = 1;
+
+	if (yaffs2_CheckpointReadRaw(dev, &hdr[1], 2 * sizeof(hdr[0])) != 2 * sizeof(hdr[0]) ||
+		hdr[1] > YAFFS_CHECKPOINT_FRAME_SIZE ||
+		hdr[2] > YAFFS_CHECKPOINT_ZBUFFER_SIZE ||
+		yaffs2_CheckpointReadRaw(dev, dev->checkpointZBuffer, hdr[2]) != hdr[2])
+		return 0;
+
+	if (lzo1x_decompress_safe(dev->checkpointZBuffer, hdr[2],
+			dev->checkpointFrame, &length) != LZO_E_OK ||
+		length != hdr[1])
+		return 0;
+
+	dev->checkpointFrameLength = length;
+	dev->checkpointFrameOffset = 0;
+
+	return 1;
+}
+
+static int yaffs2_CheckpointWriteFramed(yaffs_Device *dev, const __u8 *data, int nBytes)
+{
+	int i = 0;
+	int n;
+
+	while (i < nBytes) {
+		n = YAFFS_CHECKPOINT_FRAME_SIZE - dev->checkpointFrameLength;
+		if (n > nBytes - i)
+			n = nBytes - i;
+
+		memcpy(dev->checkpointFrame + dev->checkpointFrameLength, data + i, n);
+		dev->checkpointFrameLength += n;
+		i += n;
+
+		if (dev->checkpointFrameLength >= YAFFS_CHECKPOINT_FRAME_SIZE &&
+			!yaffs2_CheckpointFlushFrame(dev))
+			break;
+	}
+
+	return i;
+}
+
+static int yaffs2_CheckpointReadFramed(yaffs_Device *dev, __u8 *data, int nBytes)
+{
+	int i = 0;
+	int n;
+
+	while (i < nBytes) {
+		if (dev->checkpointFrameOffset >= dev->checkpointFrameLength) {
+			if (dev->checkpointCompressed == 0)
+				return i + yaffs2_CheckpointReadRaw(dev, data + i, nBytes - i);
+			if (!yaffs2_CheckpointFillFrame(dev))
+				break;
+			continue;
+		}
+
+		n = dev->checkpointFrameLength - dev->checkpointFrameOffset;
+		if (n > nBytes - i)
+			n = nBytes - i;
+
+		memcpy(data + i, dev->checkpointFrame + dev->checkpointFrameOffset, n);
+		dev->checkpointFrameOffset += n;
+		i += n;
+	}
+
+	return i;
+}
+#endif
+
+int yaffs2_CheckpointWrite(yaffs_Device *dev, const void *data, int nBytes)
+{
+	const __u8 *dataBytes = (const __u8 *)data;
+	int i;
+
+	if (!dev->checkpointBuffer)
+		return 0;
+
+	if (!dev->checkpointOpenForWrite)
+		return -1;
+
+	for (i = 0; i < nBytes; i++) {
+		dev->checkpointSum += dataBytes[i];
+		dev->checkpointXor ^= dataBytes[i];
+	}
+
+#ifdef CONFIG_YAFFS_CHECKPOINT_LZO
+	if (dev->checkpointFrame)
+		return yaffs2_CheckpointWriteFramed(dev, dataBytes, nBytes);
+#endif
+	return yaffs2_CheckpointWriteRaw(dev, dataBytes, nBytes);
+}
+
+int yaffs2_CheckpointRead(yaffs_Device *dev, void *data, int nBytes)
+{
+	__u8 *dataBytes = (__u8 *)data;
+	int n;
+	int i;
+
+	if (!dev->checkpointBuffer)
+		return 0;
+
+	if (dev->checkpointOpenForWrite)
+		return -1;
+
+#ifdef CONFIG_YAFFS_CHECKPOINT_LZO
+	if (dev->checkpointFrame)
+		n = yaffs2_CheckpointReadFramed(dev, dataBytes, nBytes);
+	else
+#endif
+		n = yaffs2_CheckpointReadRaw(dev, dataBytes, nBytes);
+
+	for (i = 0; i < n; i++) {
+		dev->checkpointSum += dataBytes[i];
+		dev->checkpointXor ^= dataBytes[i];
+	}
+
+	return n;
+}
+
 int yaffs2_CheckpointClose(yaffs_Device *dev)
 {
+	int ok = 1;
 
 	if (dev->checkpointOpenForWrite) {
+#ifdef CONFIG_YAFFS_CHECKPOINT_LZO
+		if (dev->checkpointFrame && !yaffs2_CheckpointFlushFrame(dev))
+			ok = 0;
+#endif
 		if (dev->checkpointByteOffset != 0)
 			yaffs2_CheckpointFlushBuffer(dev);
 	} else if(dev->checkpointBlockList){
@@ -378,11 +597,13 @@ int yaffs2_CheckpointClose(yaffs_Device *dev)
 	T(YAFFS_TRACE_CHECKPOINT, (TSTR("checkpoint byte count %d" TENDSTR),
 			dev->checkpointByteCount));
 
+	yaffs2_CheckpointFreeFrames(dev);
+
 	if (dev->checkpointBuffer) {
 		/* free the buffer */
 		YFREE(dev->checkpointBuffer);
 		dev->checkpointBuffer = NULL;
-		return 1;
+		return ok;
 	} else
 		return 0;
 }
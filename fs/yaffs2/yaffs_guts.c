@@ -26,6 +26,7 @@
 #include "yaffs_yaffs2.h"
 #include "yaffs_bitmap.h"
 #include "yaffs_verify.h"
+#include "yaffs_summary.h"
 
 #include "yaffs_nand.h"
 #include "yaffs_packedtags2.h"
@@ -60,6 +61,10 @@ static int yaffs_WriteNewChunkWithTagsToNAND(yaffs_Device *dev,
 					const __u8 *buffer,
 					yaffs_ExtendedTags *tags,
 					int useReserve);
+static int yaffs_WriteNewChunksWithTagsToNAND(yaffs_Device *dev,
+					const __u8 *buffer,
+					yaffs_ExtendedTags *tags,
+					int nChunks);
 
 
 static yaffs_Object *yaffs_CreateNewObject(yaffs_Device *dev, int number,
@@ -69,6 +74,7 @@ static yaffs_Object *yaffs_CreateNewObject(yaffs_Device *dev, int number,
 static int yaffs_ApplyXMod(yaffs_Object *obj, char *buffer, yaffs_XAttrMod *xmod);
 
 static void yaffs_RemoveObjectFromDirectory(yaffs_Object *obj);
+static void yaffs_NameHashUpdate(yaffs_Object *obj);
 static int yaffs_CheckStructures(void);
 static int yaffs_DoGenericObjectDeletion(yaffs_Object *in);
 
@@ -486,7 +492,66 @@ static int yaffs_WriteNewChunkWithTagsToNAND(struct yaffs_DeviceStruct *dev,
 }
 
 
- 
+/*
+ * Write nChunks chunks to consecutive pages of the current allocation
+ * block in one NAND operation.  Only done once the block has passed its
+ * erased check, and only if the chunks fit in what is left of the block.
+ * Returns the first chunk written, or -1 if nothing was written, in which
+ * case the caller falls back to writing the chunks one at a time.
+ */
+static int yaffs_WriteNewChunksWithTagsToNAND(yaffs_Device *dev,
+					const __u8 *buffer,
+					yaffs_ExtendedTags *tags,
+					int nChunks)
+{
+	yaffs_BlockInfo *bi;
+	int firstChunk;
+	int chunk;
+	int i;
+
+	if (!dev->param.writeChunksWithTagsToNAND ||
+		dev->param.alwaysCheckErased ||
+		nChunks < 2 || nChunks > YAFFS_MAX_WRITE_BATCH)
+		return -1;
+
+	if (dev->allocationBlock < 0 ||
+		dev->allocationPage + nChunks > dev->chunksPerSummary ||
+		!yaffs_CheckSpaceForAllocation(dev, nChunks))
+		return -1;
+
+	bi = yaffs_GetBlockInfo(dev, dev->allocationBlock);
+	if (!bi->skipErasedCheck)
+		return -1;
+
+	yaffs2_InvalidateCheckpoint(dev);
+
+	firstChunk = yaffs_AllocateChunk(dev, 0, NULL);
+	for (i = 1; i < nChunks; i++) {
+		chunk = yaffs_AllocateChunk(dev, 0, NULL);
+		if (chunk != firstChunk + i)
+			YBUG();
+	}
+
+	if (yaffs_WriteChunksWithTagsToNAND(dev, firstChunk, nChunks,
+					buffer, tags) != YAFFS_OK) {
+		/* We can't tell which pages made it; drop them all and
+		 * let the caller rewrite them elsewhere.
+		 */
+		for (i = nChunks - 1; i > 0; i--)
+			yaffs_DeleteChunk(dev, firstChunk + i, 1, __LINE__);
+		yaffs_HandleWriteChunkError(dev, firstChunk, 1);
+		dev->nRetriedWrites += nChunks;
+		return -1;
+	}
+
+	for (i = 0; i < nChunks; i++)
+		yaffs_HandleWriteChunkOk(dev, firstChunk + i,
+				buffer + i * dev->param.totalBytesPerChunk,
+				&tags[i]);
+
+	return firstChunk;
+}
+
 /*
  * Block retiring for handling a broken block.
  */
@@ -539,10 +604,23 @@ static void yaffs_HandleWriteChunkOk(yaffs_Device *dev, int chunkInNAND,
 				const __u8 *data,
 				const yaffs_ExtendedTags *tags)
 {
-	dev=dev;
-	chunkInNAND=chunkInNAND;
+	int chunk;
+
 	data=data;
-	tags=tags;
+
+	if (!yaffs_SummaryAdd(dev, tags, chunkInNAND))
+		return;
+
+	/* The block is full apart from the last chunk. Put the summary
+	 * there. It holds no file data, so it is garbage to the gc from
+	 * the start.
+	 */
+	chunk = yaffs_AllocateChunk(dev, 1, NULL);
+	if (chunk < 0)
+		return;
+
+	yaffs_SummaryWrite(dev, chunk);
+	yaffs_DeleteChunk(dev, chunk, 0, __LINE__);
 }
 
 static void yaffs_HandleUpdateChunk(yaffs_Device *dev, int chunkInNAND,
@@ -568,6 +646,19 @@ void yaffs_HandleChunkError(yaffs_Device *dev, yaffs_BlockInfo *bi)
 	}
 }
 
+/* The ECC fixed a chunk but the NAND driver thinks the block is getting
+ * close to what it can correct, so move the data off it soon. Unlike a
+ * real error this is normal wear and is not held against the block.
+ */
+void yaffs_HandleChunkScrub(yaffs_Device *dev, yaffs_BlockInfo *bi)
+{
+	if (!bi->gcPrioritise) {
+		bi->gcPrioritise = 1;
+		dev->hasPendingPrioritisedGCs = 1;
+		dev->nScrubs++;
+	}
+}
+
 static void yaffs_HandleWriteChunkError(yaffs_Device *dev, int chunkInNAND,
 		int erasedOk)
 {
@@ -622,6 +713,7 @@ void yaffs_SetObjectName(yaffs_Object *obj, const YCHAR *name)
 		obj->shortName[0] = _Y('\0');
 #endif
 	obj->sum = yaffs_CalcNameSum(name);
+	yaffs_NameHashUpdate(obj);
 }
 
 void yaffs_SetObjectNameFromOH(yaffs_Object *obj, const yaffs_ObjectHeader *oh)
@@ -660,16 +752,66 @@ yaffs_Tnode *yaffs_GetTnode(yaffs_Device *dev)
 /* FreeTnode frees up a tnode and puts it back on the free list */
 static void yaffs_FreeTnode(yaffs_Device *dev, yaffs_Tnode *tn)
 {
-	yaffs_FreeRawTnode(dev,tn);
-	dev->nTnodes--;
+	if (tn) {
+		yaffs_FreeRawTnode(dev, tn);
+		dev->nTnodes--;
+	}
 	dev->nCheckpointBlocksRequired = 0; /* force recalculation*/
 }
 
+/* Free a whole tnode tree. Runs have no tnode of their own. */
+static void yaffs_FreeTnodeTree(yaffs_Device *dev, yaffs_Tnode *tn, int level)
+{
+	int i;
+
+	if (!tn)
+		return;
+
+	if (yaffs_TnodeIsRun(tn)) {
+		dev->nTnodeRuns--;
+		return;
+	}
+
+	if (level > 0)
+		for (i = 0; i < YAFFS_NTNODES_INTERNAL; i++)
+			yaffs_FreeTnodeTree(dev, tn->internal[i], level - 1);
+
+	yaffs_FreeTnode(dev, tn);
+}
+
 static void yaffs_DeinitialiseTnodesAndObjects(yaffs_Device *dev)
 {
+	struct ylist_head *i;
+	struct ylist_head *n;
+	yaffs_Object *obj;
+	int b;
+
+	/* Hand everything back one at a time. The allocator may be made of
+	 * slab caches, which have to be empty before they can go.
+	 */
+	for (b = 0; b < YAFFS_NOBJECT_BUCKETS; b++) {
+		ylist_for_each_safe(i, n, &dev->objectBucket[b].list) {
+			obj = ylist_entry(i, yaffs_Object, hashLink);
+			if (obj->variantType == YAFFS_OBJECT_TYPE_DIRECTORY) {
+				YFREE(obj->variant.directoryVariant.nameHash);
+				obj->variant.directoryVariant.nameHash = NULL;
+			} else if (obj->variantType == YAFFS_OBJECT_TYPE_FILE) {
+				yaffs_FreeTnodeTree(dev,
+					obj->variant.fileVariant.top,
+					obj->variant.fileVariant.topLevel);
+				obj->variant.fileVariant.top = NULL;
+			}
+			ylist_del_init(&obj->hashLink);
+			yaffs_FreeRawObject(dev, obj);
+			dev->nObjects--;
+		}
+		dev->objectBucket[b].count = 0;
+	}
+
 	yaffs_DeinitialiseRawTnodesAndObjects(dev);
 	dev->nObjects = 0;
 	dev->nTnodes = 0;
+	dev->nTnodeRuns = 0;
 }
 
 
@@ -732,6 +874,103 @@ __u32 yaffs_GetChunkGroupBase(yaffs_Device *dev, yaffs_Tnode *tn,
 	return val;
 }
 
+/*
+ * Runs.
+ *
+ * Big files written in one go tend to end up in consecutive chunks, so
+ * many level 0 tnodes just count up by one from entry to entry. Such a
+ * tnode is dropped and its parent's entry holds the first value instead,
+ * tagged in the bottom bit (see yaffs_MakeTnodeRun()). Runs only ever
+ * sit in level 1 tnodes.
+ */
+
+/* Return tn, or if it is a run a read-only level 0 tnode made up from it,
+ * valid until the next call.
+ */
+yaffs_Tnode *yaffs_TnodeRunView(yaffs_Device *dev, yaffs_Tnode *tn)
+{
+	yaffs_Tnode *view = (yaffs_Tnode *)dev->tnodeRunView;
+	__u32 base;
+	int i;
+
+	if (!yaffs_TnodeIsRun(tn))
+		return tn;
+
+	base = yaffs_TnodeRunBase(tn);
+	memset(view, 0, sizeof(dev->tnodeRunView));
+	for (i = 0; i < YAFFS_NTNODES_LEVEL0; i++)
+		yaffs_LoadLevel0Tnode(dev, view, i,
+				(base + i) << dev->chunkGroupBits);
+
+	return view;
+}
+
+/* Turn the run in *slot back into a real level 0 tnode */
+static yaffs_Tnode *yaffs_ExpandTnodeRun(yaffs_Device *dev, yaffs_Tnode **slot)
+{
+	yaffs_Tnode *tn = yaffs_GetTnode(dev);
+
+	if (!tn) {
+		T(YAFFS_TRACE_ERROR,
+			(TSTR("yaffs: no more tnodes" TENDSTR)));
+		return NULL;
+	}
+
+	memcpy(tn, yaffs_TnodeRunView(dev, *slot), dev->tnodeSize);
+	*slot = tn;
+	dev->nTnodeRuns--;
+
+	return tn;
+}
+
+/* If the level 0 tnode holding chunkId counts up by one all the way,
+ * swap it for a run. The tree must already reach chunkId.
+ */
+void yaffs_CompactLevel0Tnode(yaffs_Device *dev, yaffs_FileStructure *fStruct,
+				__u32 chunkId)
+{
+	yaffs_Tnode *tn = fStruct->top;
+	yaffs_Tnode **slot;
+	int level = fStruct->topLevel;
+	__u32 base;
+	int i;
+
+	if (level < 1 || level > YAFFS_TNODES_MAX_LEVEL)
+		return;
+
+	while (level > 1 && tn) {
+		tn = tn->internal[(chunkId >>
+			(YAFFS_TNODES_LEVEL0_BITS +
+				(level - 1) *
+				YAFFS_TNODES_INTERNAL_BITS)) &
+			YAFFS_TNODES_INTERNAL_MASK];
+		level--;
+	}
+
+	if (!tn)
+		return;
+
+	slot = &tn->internal[(chunkId >> YAFFS_TNODES_LEVEL0_BITS) &
+				YAFFS_TNODES_INTERNAL_MASK];
+	tn = *slot;
+	if (!tn || yaffs_TnodeIsRun(tn))
+		return;
+
+	base = yaffs_GetChunkGroupBase(dev, tn, 0) >> dev->chunkGroupBits;
+	if (!base || yaffs_TnodeRunBase(yaffs_MakeTnodeRun(base)) != base)
+		return;
+
+	for (i = 1; i < YAFFS_NTNODES_LEVEL0; i++) {
+		if ((yaffs_GetChunkGroupBase(dev, tn, i) >> dev->chunkGroupBits) !=
+		    base + i)
+			return;
+	}
+
+	yaffs_FreeTnode(dev, tn);
+	*slot = yaffs_MakeTnodeRun(base);
+	dev->nTnodeRuns++;
+}
+
 /* ------------------- End of individual tnode manipulation -----------------*/
 
 /* ---------Functions to manipulate the look-up tree (made up of tnodes) ------
@@ -739,7 +978,9 @@ __u32 yaffs_GetChunkGroupBase(yaffs_Device *dev, yaffs_Tnode *tn,
  * in the tree. 0 means only the level 0 tnode is in the tree.
  */
 
-/* FindLevel0Tnode finds the level 0 tnode, if one exists. */
+/* FindLevel0Tnode finds the level 0 tnode, if one exists.
+ * For a run this is a read-only copy, see yaffs_TnodeRunView().
+ */
 yaffs_Tnode *yaffs_FindLevel0Tnode(yaffs_Device *dev,
 					yaffs_FileStructure *fStruct,
 					__u32 chunkId)
@@ -749,8 +990,6 @@ yaffs_Tnode *yaffs_FindLevel0Tnode(yaffs_Device *dev,
 	int requiredTallness;
 	int level = fStruct->topLevel;
 
-	dev=dev;
-
 	/* Check sane level and chunk Id */
 	if (level < 0 || level > YAFFS_TNODES_MAX_LEVEL)
 		return NULL;
@@ -780,6 +1019,9 @@ yaffs_Tnode *yaffs_FindLevel0Tnode(yaffs_Device *dev,
 		level--;
 	}
 
+	if (tn)
+		tn = yaffs_TnodeRunView(dev, tn);
+
 	return tn;
 }
 
@@ -864,7 +1106,9 @@ yaffs_Tnode *yaffs_AddOrFindLevel0Tnode(yaffs_Device *dev,
 				/* Looking from level 1 at level 0 */
 				if (passedTn) {
 					/* If we already have one, then release it.*/
-					if (tn->internal[x])
+					if (yaffs_TnodeIsRun(tn->internal[x]))
+						dev->nTnodeRuns--;
+					else if (tn->internal[x])
 						yaffs_FreeTnode(dev, tn->internal[x]);
 					tn->internal[x] = passedTn;
 
@@ -873,6 +1117,10 @@ yaffs_Tnode *yaffs_AddOrFindLevel0Tnode(yaffs_Device *dev,
 					tn->internal[x] = yaffs_GetTnode(dev);
 					if(!tn->internal[x])
 						return NULL;
+				} else if (yaffs_TnodeIsRun(tn->internal[x])) {
+					/* About to be modified, so unpack it */
+					if (!yaffs_ExpandTnodeRun(dev, &tn->internal[x]))
+						return NULL;
 				}
 			}
 
@@ -1048,7 +1296,16 @@ static int yaffs_SoftDeleteWorker(yaffs_Object *in, yaffs_Tnode *tn,
 
 			for (i = YAFFS_NTNODES_INTERNAL - 1; allDone && i >= 0;
 			     i--) {
-				if (tn->internal[i]) {
+				if (yaffs_TnodeIsRun(tn->internal[i])) {
+					__u32 base = yaffs_TnodeRunBase(tn->internal[i]);
+					int j;
+
+					for (j = 0; j < YAFFS_NTNODES_LEVEL0; j++)
+						yaffs_SoftDeleteChunk(dev,
+							(base + j) << dev->chunkGroupBits);
+					tn->internal[i] = NULL;
+					dev->nTnodeRuns--;
+				} else if (tn->internal[i]) {
 					allDone =
 					    yaffs_SoftDeleteWorker(in,
 								   tn->
@@ -1142,7 +1399,8 @@ static yaffs_Tnode *yaffs_PruneWorker(yaffs_Device *dev, yaffs_Tnode *tn,
 
 		if(level > 0){
 			for (i = 0; i < YAFFS_NTNODES_INTERNAL; i++) {
-				if (tn->internal[i]) {
+				if (tn->internal[i] &&
+				    !yaffs_TnodeIsRun(tn->internal[i])) {
 					tn->internal[i] =
 						yaffs_PruneWorker(dev, tn->internal[i],
 							level - 1,
@@ -1203,6 +1461,12 @@ static int yaffs_PruneFileStructure(yaffs_Device *dev,
 					hasData++;
 			}
 
+			/* A run can't be the top of the tree */
+			if (!hasData && fStruct->topLevel == 1 &&
+			    yaffs_TnodeIsRun(tn->internal[0]) &&
+			    !yaffs_ExpandTnodeRun(dev, &tn->internal[0]))
+				hasData = 1;
+
 			if (!hasData) {
 				fStruct->top = tn->internal[0];
 				fStruct->topLevel--;
@@ -1238,6 +1502,7 @@ static yaffs_Object *yaffs_AllocateEmptyObject(yaffs_Device *dev)
 		YINIT_LIST_HEAD(&(obj->hardLinks));
 		YINIT_LIST_HEAD(&(obj->hashLink));
 		YINIT_LIST_HEAD(&obj->siblings);
+		YINIT_LIST_HEAD(&obj->nameLink);
 
 
 		/* Now make the directory sane */
@@ -1320,6 +1585,9 @@ static void yaffs_FreeObject(yaffs_Object *obj)
 
 	yaffs_UnhashObject(obj);
 
+	if (obj->variantType == YAFFS_OBJECT_TYPE_DIRECTORY)
+		YFREE(obj->variant.directoryVariant.nameHash);
+
 	yaffs_FreeRawObject(dev,obj);
 	dev->nObjects--;
 	dev->nCheckpointBlocksRequired = 0; /* force recalculation*/
@@ -1338,6 +1606,7 @@ static void yaffs_InitialiseTnodesAndObjects(yaffs_Device *dev)
 
 	dev->nObjects = 0;
 	dev->nTnodes = 0;
+	dev->nTnodeRuns = 0;
 
 	yaffs_InitialiseRawTnodesAndObjects(dev);
 
@@ -1491,6 +1760,7 @@ yaffs_Object *yaffs_CreateNewObject(yaffs_Device *dev, int number,
 					children);
 			YINIT_LIST_HEAD(&theObject->variant.directoryVariant.
 					dirty);
+			theObject->variant.directoryVariant.nameHash = NULL;
 			break;
 		case YAFFS_OBJECT_TYPE_SYMLINK:
 		case YAFFS_OBJECT_TYPE_HARDLINK:
@@ -2589,6 +2859,17 @@ static int yaffs_CheckGarbageCollection(yaffs_Device *dev, int background)
 
 		dev->gcSkip = 5;
 
+		/* Leave passive gc to the background thread if there is one */
+		if (!background && !aggressive &&
+			dev->param.deferGarbageCollection &&
+			dev->param.deferGarbageCollection(dev)) {
+			dev->deferredGCs++;
+			break;
+		}
+
+		if (aggressive && !background)
+			dev->foregroundAggressiveGCs++;
+
                 /* If we don't already have a block being gc'd then see if we should start another */
 
 		if (dev->gcBlock < 1 && !aggressive) {
@@ -2710,8 +2991,14 @@ static int yaffs_FindAndDeleteChunkInFile(yaffs_Object *in, int chunkInInode,
 		    yaffs_FindChunkInGroup(dev, theChunk, tags, in->objectId,
 					   chunkInInode);
 
-		/* Delete the entry in the filestructure (if found) */
-		if (retVal != -1)
+		/* Delete the entry in the filestructure (if found).
+		 * A run has to be unpacked first.
+		 */
+		if (retVal != -1 && tn == (yaffs_Tnode *)dev->tnodeRunView)
+			tn = yaffs_AddOrFindLevel0Tnode(dev,
+						&in->variant.fileVariant,
+						chunkInInode, NULL);
+		if (retVal != -1 && tn)
 			yaffs_LoadLevel0Tnode(dev, tn, chunkInInode, 0);
 	}
 
@@ -2843,6 +3130,7 @@ int yaffs_PutChunkIntoFile(yaffs_Object *in, int chunkInInode,
 		in->nDataChunks++;
 
 	yaffs_LoadLevel0Tnode(dev, tn, chunkInInode, chunkInNAND);
+	yaffs_CompactLevel0Tnode(dev, &in->variant.fileVariant, chunkInInode);
 
 	return YAFFS_OK;
 }
@@ -2990,6 +3278,54 @@ static int yaffs_WriteChunkDataToObject(yaffs_Object *in, int chunkInInode,
 
 }
 
+/* Writes nChunks full chunks of file data, starting at chunkInInode, with
+ * a single batched NAND write.  Returns the number of chunks written,
+ * which is either nChunks or 0.
+ */
+static int yaffs_WriteChunksDataToObject(yaffs_Object *in, int chunkInInode,
+					const __u8 *buffer, int nChunks)
+{
+	int prevChunkId[YAFFS_MAX_WRITE_BATCH];
+	yaffs_ExtendedTags prevTags;
+	yaffs_ExtendedTags newTags[YAFFS_MAX_WRITE_BATCH];
+	int newChunkId;
+	int i;
+
+	yaffs_Device *dev = in->myDev;
+
+	yaffs_CheckGarbageCollection(dev, 0);
+
+	for (i = 0; i < nChunks; i++) {
+		prevChunkId[i] = yaffs_FindChunkInFile(in, chunkInInode + i,
+							&prevTags);
+		if (prevChunkId[i] < 1 &&
+			!yaffs_PutChunkIntoFile(in, chunkInInode + i, 0, 0))
+			return 0;
+
+		yaffs_InitialiseTags(&newTags[i]);
+		newTags[i].chunkId = chunkInInode + i;
+		newTags[i].objectId = in->objectId;
+		newTags[i].serialNumber =
+		    (prevChunkId[i] > 0) ? prevTags.serialNumber + 1 : 1;
+		newTags[i].byteCount = dev->nDataBytesPerChunk;
+	}
+
+	newChunkId = yaffs_WriteNewChunksWithTagsToNAND(dev, buffer, newTags,
+							nChunks);
+	if (newChunkId < 0)
+		return 0;
+
+	for (i = 0; i < nChunks; i++) {
+		yaffs_PutChunkIntoFile(in, chunkInInode + i, newChunkId + i, 0);
+
+		if (prevChunkId[i] > 0)
+			yaffs_DeleteChunk(dev, prevChunkId[i], 1, __LINE__);
+	}
+	yaffs_VerifyFileSanity(in);
+
+	return nChunks;
+}
+
 /* UpdateObjectHeader updates the header on NAND for an object.
  * If name is not NULL, then that new name is used.
  */
@@ -3176,8 +3512,8 @@ int yaffs_UpdateObjectHeader(yaffs_Object *in, const YCHAR *name, int force,
  *   In Linux, the page cache provides read buffering aand the short op cache provides write
  *   buffering.
  *
- *   There are a limited number (~10) of cache chunks per device so that we don't
- *   need a very intelligent search.
+ *   Caches in use are hashed on object and chunk, and kept on a list in
+ *   order of use so that the least recently used one is pushed out first.
  */
 
 static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
@@ -3197,6 +3533,32 @@ static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
 	return 0;
 }
 
+static Y_INLINE struct ylist_head *yaffs_ChunkCacheBucket(yaffs_Device *dev,
+					const yaffs_Object *obj, int chunkId)
+{
+	return &dev->srHash[(obj->objectId * 31 + chunkId) &
+				(dev->srHashBuckets - 1)];
+}
+
+/* Hook a cache up to an object's chunk so that it can be found */
+static void yaffs_AttachChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache,
+				yaffs_Object *obj, int chunkId)
+{
+	cache->object = obj;
+	cache->chunkId = chunkId;
+	cache->dirty = 0;
+	cache->locked = 0;
+	ylist_add(&cache->hashLink, yaffs_ChunkCacheBucket(dev, obj, chunkId));
+}
+
+/* Unhook a cache and put it first in line for reuse */
+static void yaffs_ReleaseChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	cache->object = NULL;
+	ylist_del_init(&cache->hashLink);
+	ylist_del(&cache->lruLink);
+	ylist_add(&cache->lruLink, &dev->srLru);
+}
 
 static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 {
@@ -3234,7 +3596,7 @@ static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 								 cache->nBytes,
 								 1);
 				cache->dirty = 0;
-				cache->object = NULL;
+				yaffs_ReleaseChunkCache(dev, cache);
 			}
 
 		} while (cache && chunkWritten > 0);
@@ -3283,28 +3645,48 @@ void yaffs_FlushEntireDeviceCache(yaffs_Device *dev)
  * First look for an empty one.
  * Then look for the least recently used non-dirty one.
  * Then look for the least recently used dirty one...., flush and look again.
+ *
+ * The LRU list runs from least to most recently used. Released caches go
+ * to the front, so empty ones are normally found straight away.
  */
 static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device *dev)
 {
-	int i;
+	struct ylist_head *i;
+	yaffs_ChunkCache *cache;
 
 	if (dev->param.nShortOpCaches > 0) {
-		for (i = 0; i < dev->param.nShortOpCaches; i++) {
-			if (!dev->srCache[i].object)
-				return &dev->srCache[i];
+		ylist_for_each(i, &dev->srLru) {
+			cache = ylist_entry(i, yaffs_ChunkCache, lruLink);
+			if (!cache->object)
+				return cache;
 		}
 	}
 
 	return NULL;
 }
 
+/* Least recently used cache that can be pushed out, optionally
+ * only looking at clean ones.
+ */
+static yaffs_ChunkCache *yaffs_FindChunkCacheVictim(yaffs_Device *dev,
+						int cleanOnly)
+{
+	struct ylist_head *i;
+	yaffs_ChunkCache *cache;
+
+	ylist_for_each(i, &dev->srLru) {
+		cache = ylist_entry(i, yaffs_ChunkCache, lruLink);
+		if (cache->object && !cache->locked &&
+		    (!cleanOnly || !cache->dirty))
+			return cache;
+	}
+
+	return NULL;
+}
+
 static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device *dev)
 {
 	yaffs_ChunkCache *cache;
-	yaffs_Object *theObj;
-	int usage;
-	int i;
-	int pushout;
 
 	if (dev->param.nShortOpCaches > 0) {
 		/* Try find a non-dirty one... */
@@ -3312,33 +3694,17 @@ static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device *dev)
 		cache = yaffs_GrabChunkCacheWorker(dev);
 
 		if (!cache) {
-			/* They were all dirty, find the last recently used object and flush
-			 * its cache, then  find again.
-			 * NB what's here is not very accurate, we actually flush the object
-			 * the last recently used page.
+			/* None free, push out the least recently used one.
+			 * If that is dirty, flush its object and look again.
 			 */
+			cache = yaffs_FindChunkCacheVictim(dev, 0);
 
-			/* With locking we can't assume we can use entry zero */
-
-			theObj = NULL;
-			usage = -1;
-			cache = NULL;
-			pushout = -1;
-
-			for (i = 0; i < dev->param.nShortOpCaches; i++) {
-				if (dev->srCache[i].object &&
-				    !dev->srCache[i].locked &&
-				    (dev->srCache[i].lastUse < usage || !cache)) {
-					usage = dev->srCache[i].lastUse;
-					theObj = dev->srCache[i].object;
-					cache = &dev->srCache[i];
-					pushout = i;
-				}
-			}
-
-			if (!cache || cache->dirty) {
+			if (cache && !cache->dirty) {
+				yaffs_ReleaseChunkCache(dev, cache);
+			} else {
 				/* Flush and try again */
-				yaffs_FlushFilesChunkCache(theObj);
+				if (cache)
+					yaffs_FlushFilesChunkCache(cache->object);
 				cache = yaffs_GrabChunkCacheWorker(dev);
 			}
 
@@ -3354,14 +3720,17 @@ static yaffs_ChunkCache *yaffs_FindChunkCache(const yaffs_Object *obj,
 					      int chunkId)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
+	struct ylist_head *i;
+	yaffs_ChunkCache *cache;
+
 	if (dev->param.nShortOpCaches > 0) {
-		for (i = 0; i < dev->param.nShortOpCaches; i++) {
-			if (dev->srCache[i].object == obj &&
-			    dev->srCache[i].chunkId == chunkId) {
+		ylist_for_each(i, yaffs_ChunkCacheBucket(dev, obj, chunkId)) {
+			cache = ylist_entry(i, yaffs_ChunkCache, hashLink);
+			if (cache->object == obj &&
+			    cache->chunkId == chunkId) {
 				dev->cacheHits++;
 
-				return &dev->srCache[i];
+				return cache;
 			}
 		}
 	}
@@ -3374,18 +3743,8 @@ static void yaffs_UseChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache,
 {
 
 	if (dev->param.nShortOpCaches > 0) {
-		if (dev->srLastUse < 0 || dev->srLastUse > 100000000) {
-			/* Reset the cache usages */
-			int i;
-			for (i = 1; i < dev->param.nShortOpCaches; i++)
-				dev->srCache[i].lastUse = 0;
-
-			dev->srLastUse = 0;
-		}
-
-		dev->srLastUse++;
-
-		cache->lastUse = dev->srLastUse;
+		ylist_del(&cache->lruLink);
+		ylist_add_tail(&cache->lruLink, &dev->srLru);
 
 		if (isAWrite)
 			cache->dirty = 1;
@@ -3402,7 +3761,7 @@ static void yaffs_InvalidateChunkCache(yaffs_Object *object, int chunkId)
 		yaffs_ChunkCache *cache = yaffs_FindChunkCache(object, chunkId);
 
 		if (cache)
-			cache->object = NULL;
+			yaffs_ReleaseChunkCache(object->myDev, cache);
 	}
 }
 
@@ -3418,11 +3777,69 @@ static void yaffs_InvalidateWholeChunkCache(yaffs_Object *in)
 		/* Invalidate it. */
 		for (i = 0; i < dev->param.nShortOpCaches; i++) {
 			if (dev->srCache[i].object == in)
-				dev->srCache[i].object = NULL;
+				yaffs_ReleaseChunkCache(dev, &dev->srCache[i]);
 		}
 	}
 }
 
+/*
+ * Read-ahead.
+ *
+ * When a file is being read chunk after chunk, and the chunks that follow
+ * sit next to each other on NAND, read them all in one go into clean
+ * caches. Only used if the NAND layer can read several chunks at once.
+ * Never pushes out dirty data and stops at anything already cached.
+ */
+static void yaffs_ReadAhead(yaffs_Object *in, int chunk)
+{
+	yaffs_Device *dev = in->myDev;
+	yaffs_ChunkCache *cache;
+	int firstInNAND;
+	int chunkInNAND;
+	int maxChunks;
+	int n;
+	int i;
+
+	firstInNAND = yaffs_FindChunkInFile(in, chunk, NULL);
+	if (firstInNAND < 0)
+		return;
+
+	maxChunks = dev->param.nChunksPerBlock -
+			(firstInNAND % dev->param.nChunksPerBlock);
+	if (maxChunks > dev->readAheadChunks)
+		maxChunks = dev->readAheadChunks;
+
+	for (n = 1; n < maxChunks; n++) {
+		chunkInNAND = yaffs_FindChunkInFile(in, chunk + n, NULL);
+		if (chunkInNAND != firstInNAND + n ||
+		    yaffs_FindChunkCache(in, chunk + n))
+			break;
+	}
+
+	if (n < 2 ||
+	    yaffs_ReadChunksFromNAND(dev, firstInNAND, n,
+				dev->readAheadBuffer) != YAFFS_OK)
+		return;
+
+	dev->nPrefetchedChunks += n;
+
+	for (i = 0; i < n; i++) {
+		cache = yaffs_GrabChunkCacheWorker(dev);
+		if (!cache) {
+			cache = yaffs_FindChunkCacheVictim(dev, 1);
+			if (!cache)
+				break;
+			yaffs_ReleaseChunkCache(dev, cache);
+		}
+
+		yaffs_AttachChunkCache(dev, cache, in, chunk + i);
+		memcpy(cache->data,
+			dev->readAheadBuffer + i * dev->param.totalBytesPerChunk,
+			dev->nDataBytesPerChunk);
+		cache->nBytes = 0;
+		yaffs_UseChunkCache(dev, cache, 0);
+	}
+}
 
 /*--------------------- File read/write ------------------------
  * Read and write have very similar structures.
@@ -3465,6 +3882,18 @@ int yaffs_ReadDataFromFile(yaffs_Object *in, __u8 *buffer, loff_t offset,
 
 		cache = yaffs_FindChunkCache(in, chunk);
 
+		/* Reading on from where the last read of this file stopped?
+		 * Then fetch what follows while we're at it.
+		 */
+		if (!cache && dev->readAheadChunks > 0 &&
+		    in->objectId == dev->readAheadObjectId &&
+		    chunk == dev->readAheadNextChunk) {
+			yaffs_ReadAhead(in, chunk);
+			cache = yaffs_FindChunkCache(in, chunk);
+		}
+		dev->readAheadObjectId = in->objectId;
+		dev->readAheadNextChunk = chunk + 1;
+
 		/* If the chunk is already in the cache or it is less than a whole chunk
 		 * or we're using inband tags then use the cache (if there is caching)
 		 * else bypass the cache.
@@ -3476,10 +3905,7 @@ int yaffs_ReadDataFromFile(yaffs_Object *in, __u8 *buffer, loff_t offset,
 
 				if (!cache) {
 					cache = yaffs_GrabChunkCache(in->myDev);
-					cache->object = in;
-					cache->chunkId = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_AttachChunkCache(dev, cache, in, chunk);
 					yaffs_ReadChunkDataFromObject(in, chunk,
 								      cache->
 								      data);
@@ -3603,10 +4029,7 @@ int yaffs_DoWriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
 				if (!cache
 				    && yaffs_CheckSpaceForAllocation(dev, 1)) {
 					cache = yaffs_GrabChunkCache(dev);
-					cache->object = in;
-					cache->chunkId = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_AttachChunkCache(dev, cache, in, chunk);
 					yaffs_ReadChunkDataFromObject(in, chunk,
 								      cache->data);
 				} else if (cache &&
@@ -3670,17 +4093,33 @@ int yaffs_DoWriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
 			}
 
 		} else {
-			/* A full chunk. Write directly from the supplied buffer. */
-
-
+			/* A full chunk. Write directly from the supplied buffer,
+			 * batching it with any full chunks that follow.
+			 */
+			int nChunks = n / dev->nDataBytesPerChunk;
+			int i;
 
-			chunkWritten =
-			    yaffs_WriteChunkDataToObject(in, chunk, buffer,
-							 dev->nDataBytesPerChunk,
-							 0);
+			if (nChunks > YAFFS_MAX_WRITE_BATCH)
+				nChunks = YAFFS_MAX_WRITE_BATCH;
+
+			if (nChunks > 1 &&
+			    yaffs_WriteChunksDataToObject(in, chunk, buffer,
+							  nChunks) == nChunks) {
+				for (i = 0; i < nChunks; i++)
+					yaffs_InvalidateChunkCache(in,
+								   chunk + i);
+				nToCopy = nChunks * dev->nDataBytesPerChunk;
+				chunkWritten = chunk;
+			} else {
+				chunkWritten =
+				    yaffs_WriteChunkDataToObject(in, chunk,
+							buffer,
+							dev->nDataBytesPerChunk,
+							0);
 
-			/* Since we've overwritten the cached data, we better invalidate it. */
-			yaffs_InvalidateChunkCache(in, chunk);
+				/* Since we've overwritten the cached data, we better invalidate it. */
+				yaffs_InvalidateChunkCache(in, chunk);
+			}
 		}
 
 		if (chunkWritten >= 0) {
@@ -4464,6 +4903,100 @@ void yaffs_UpdateDirtyDirectories(yaffs_Device *dev)
 	}
 }
 
+/*
+ * Name hashing for big directories.
+ *
+ * The first lookup that has to walk a lot of children builds a hash of
+ * them on their name sums, which is then kept up to date as children
+ * come and go. Children whose sum can't be trusted yet (lost+found, lazy
+ * loaded objects, objects without a header) are kept on an extra list
+ * checked by every lookup, and moved to their bucket once that changes.
+ */
+#define YAFFS_NAME_HASH_THRESHOLD	32
+#define YAFFS_NAME_HASH_MIN_BUCKETS	16
+#define YAFFS_NAME_HASH_MAX_BUCKETS	1024
+
+static int yaffs_NameHashBucket(yaffs_Object *dir, yaffs_Object *obj)
+{
+	yaffs_DirectoryStructure *ds = &dir->variant.directoryVariant;
+
+	if (obj->objectId == YAFFS_OBJECTID_LOSTNFOUND ||
+		obj->lazyLoaded || obj->hdrChunk <= 0)
+		return ds->nameHashBuckets;
+
+	return obj->sum & (ds->nameHashBuckets - 1);
+}
+
+static void yaffs_NameHashAdd(yaffs_Object *dir, yaffs_Object *obj)
+{
+	yaffs_DirectoryStructure *ds = &dir->variant.directoryVariant;
+
+	ylist_add(&obj->nameLink, &ds->nameHash[yaffs_NameHashBucket(dir, obj)]);
+	ds->nameHashCount++;
+}
+
+static void yaffs_NameHashRemove(yaffs_Object *obj)
+{
+	if (!ylist_empty(&obj->nameLink)) {
+		ylist_del_init(&obj->nameLink);
+		obj->parent->variant.directoryVariant.nameHashCount--;
+	}
+}
+
+/* Rehash an object after something its bucket depends on changed */
+static void yaffs_NameHashUpdate(yaffs_Object *obj)
+{
+	yaffs_Object *dir = obj->parent;
+
+	if (dir && !ylist_empty(&obj->nameLink)) {
+		ylist_del(&obj->nameLink);
+		ylist_add(&obj->nameLink,
+			&dir->variant.directoryVariant.nameHash[yaffs_NameHashBucket(dir, obj)]);
+	}
+}
+
+static void yaffs_NameHashBuild(yaffs_Object *dir, int nChildren)
+{
+	yaffs_DirectoryStructure *ds = &dir->variant.directoryVariant;
+	struct ylist_head *i;
+	int nBuckets = YAFFS_NAME_HASH_MIN_BUCKETS;
+	int b;
+
+	while (nBuckets < nChildren / 2 && nBuckets < YAFFS_NAME_HASH_MAX_BUCKETS)
+		nBuckets <<= 1;
+
+	/* One more for the objects that can't be hashed */
+	ds->nameHash = YMALLOC((nBuckets + 1) * sizeof(struct ylist_head));
+	if (!ds->nameHash)
+		return;	/* Carry on with plain lookups */
+
+	for (b = 0; b <= nBuckets; b++)
+		YINIT_LIST_HEAD(&ds->nameHash[b]);
+
+	ds->nameHashBuckets = nBuckets;
+	ds->nameHashCount = 0;
+
+	ylist_for_each(i, &ds->children)
+		yaffs_NameHashAdd(dir, ylist_entry(i, yaffs_Object, siblings));
+
+	T(YAFFS_TRACE_OS, (TSTR("Name hash for directory %d, %d children %d buckets" TENDSTR),
+		dir->objectId, ds->nameHashCount, nBuckets));
+}
+
+static void yaffs_NameHashDestroy(yaffs_Object *dir)
+{
+	yaffs_DirectoryStructure *ds = &dir->variant.directoryVariant;
+	struct ylist_head *i;
+
+	ylist_for_each(i, &ds->children)
+		ylist_del_init(&ylist_entry(i, yaffs_Object, siblings)->nameLink);
+
+	YFREE(ds->nameHash);
+	ds->nameHash = NULL;
+	ds->nameHashBuckets = 0;
+	ds->nameHashCount = 0;
+}
+
 static void yaffs_RemoveObjectFromDirectory(yaffs_Object *obj)
 {
 	yaffs_Device *dev = obj->myDev;
@@ -4478,6 +5011,7 @@ static void yaffs_RemoveObjectFromDirectory(yaffs_Object *obj)
 		dev->param.removeObjectCallback(obj);
 
 
+	yaffs_NameHashRemove(obj);
 	ylist_del_init(&obj->siblings);
 	obj->parent = NULL;
 	
@@ -4518,6 +5052,17 @@ void yaffs_AddObjectToDirectory(yaffs_Object *directory,
 	ylist_add(&obj->siblings, &directory->variant.directoryVariant.children);
 	obj->parent = directory;
 
+	if (directory->variant.directoryVariant.nameHash) {
+		yaffs_NameHashAdd(directory, obj);
+
+		/* Grown well past its size? Rebuild on the next lookup. */
+		if (directory->variant.directoryVariant.nameHashCount >
+			4 * directory->variant.directoryVariant.nameHashBuckets &&
+			directory->variant.directoryVariant.nameHashBuckets <
+			YAFFS_NAME_HASH_MAX_BUCKETS)
+			yaffs_NameHashDestroy(directory);
+	}
+
 	if (directory == obj->myDev->unlinkedDir
 			|| directory == obj->myDev->deletedDir) {
 		obj->unlinked = 1;
@@ -4529,15 +5074,74 @@ void yaffs_AddObjectToDirectory(yaffs_Object *directory,
 	yaffs_VerifyObjectInDirectory(obj);
 }
 
+static int yaffs_ObjectNameMatches(yaffs_Object *l, const YCHAR *name, int sum)
+{
+	YCHAR buffer[YAFFS_MAX_NAME_LENGTH + 1];
+
+	yaffs_CheckObjectDetailsLoaded(l);
+
+	/* Special case for lost-n-found */
+	if (l->objectId == YAFFS_OBJECTID_LOSTNFOUND)
+		return yaffs_strcmp(name, YAFFS_LOSTNFOUND_NAME) == 0;
+
+	if (yaffs_SumCompare(l->sum, sum) || l->hdrChunk <= 0) {
+		/* LostnFound chunk called Objxxx
+		 * Do a real check
+		 */
+		yaffs_GetObjectName(l, buffer, YAFFS_MAX_NAME_LENGTH + 1);
+		return yaffs_strncmp(name, buffer, YAFFS_MAX_NAME_LENGTH) == 0;
+	}
+
+	return 0;
+}
+
+static yaffs_Object *yaffs_FindObjectInNameHash(yaffs_Object *directory,
+						const YCHAR *name, int sum)
+{
+	yaffs_DirectoryStructure *ds = &directory->variant.directoryVariant;
+	struct ylist_head *i;
+	struct ylist_head *n;
+	yaffs_Object *found = NULL;
+	yaffs_Object *l;
+
+	ylist_for_each(i, &ds->nameHash[sum & (ds->nameHashBuckets - 1)]) {
+		l = ylist_entry(i, yaffs_Object, nameLink);
+
+		if (l->parent != directory)
+			YBUG();
+
+		if (yaffs_ObjectNameMatches(l, name, sum))
+			return l;
+	}
+
+	/* Then the ones we could not hash. Move any that have become
+	 * hashable since to their bucket.
+	 */
+	ylist_for_each_safe(i, n, &ds->nameHash[ds->nameHashBuckets]) {
+		l = ylist_entry(i, yaffs_Object, nameLink);
+
+		if (l->parent != directory)
+			YBUG();
+
+		if (!found && yaffs_ObjectNameMatches(l, name, sum))
+			found = l;
+
+		if (yaffs_NameHashBucket(directory, l) != ds->nameHashBuckets)
+			yaffs_NameHashUpdate(l);
+	}
+
+	return found;
+}
+
 yaffs_Object *yaffs_FindObjectByName(yaffs_Object *directory,
 				     const YCHAR *name)
 {
 	int sum;
+	int nChecked = 0;
 
 	struct ylist_head *i;
-	YCHAR buffer[YAFFS_MAX_NAME_LENGTH + 1];
 
-	yaffs_Object *l;
+	yaffs_Object *l = NULL;
 
 	if (!name)
 		return NULL;
@@ -4559,6 +5163,9 @@ yaffs_Object *yaffs_FindObjectByName(yaffs_Object *directory,
 
 	sum = yaffs_CalcNameSum(name);
 
+	if (directory->variant.directoryVariant.nameHash)
+		return yaffs_FindObjectInNameHash(directory, name, sum);
+
 	ylist_for_each(i, &directory->variant.directoryVariant.children) {
 		if (i) {
 			l = ylist_entry(i, yaffs_Object, siblings);
@@ -4566,25 +5173,20 @@ yaffs_Object *yaffs_FindObjectByName(yaffs_Object *directory,
 			if (l->parent != directory)
 				YBUG();
 
-			yaffs_CheckObjectDetailsLoaded(l);
+			nChecked++;
 
-			/* Special case for lost-n-found */
-			if (l->objectId == YAFFS_OBJECTID_LOSTNFOUND) {
-				if (yaffs_strcmp(name, YAFFS_LOSTNFOUND_NAME) == 0)
-					return l;
-			} else if (yaffs_SumCompare(l->sum, sum) || l->hdrChunk <= 0) {
-				/* LostnFound chunk called Objxxx
-				 * Do a real check
-				 */
-				yaffs_GetObjectName(l, buffer,
-						    YAFFS_MAX_NAME_LENGTH + 1);
-				if (yaffs_strncmp(name, buffer, YAFFS_MAX_NAME_LENGTH) == 0)
-					return l;
-			}
+			if (yaffs_ObjectNameMatches(l, name, sum))
+				break;
 		}
 	}
 
-	return NULL;
+	if (nChecked >= YAFFS_NAME_HASH_THRESHOLD)
+		yaffs_NameHashBuild(directory, nChecked);
+
+	if (i == &directory->variant.directoryVariant.children)
+		return NULL;
+
+	return l;
 }
 
 
@@ -5270,6 +5872,9 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 	dev->passiveGCs = 0;
 	dev->oldestDirtyGCs = 0;
 	dev->backgroundGCs = 0;
+	dev->deferredGCs = 0;
+	dev->foregroundAggressiveGCs = 0;
+	dev->nSummaryScans = 0;
 	dev->gcBlockFinder = 0;
 	dev->bufferedBlock = -1;
 	dev->doingBufferedBlockRewrite = 0;
@@ -5278,6 +5883,7 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 	dev->nUnlinkedFiles = 0;
 	dev->eccFixed = 0;
 	dev->eccUnfixed = 0;
+	dev->nScrubs = 0;
 	dev->tagsEccFixed = 0;
 	dev->tagsEccUnfixed = 0;
 	dev->nErasureFailures = 0;
@@ -5293,7 +5899,14 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 		init_failed = 1;
 
 	dev->srCache = NULL;
+	dev->srHash = NULL;
+	dev->srHashBuckets = 0;
+	YINIT_LIST_HEAD(&dev->srLru);
+	dev->readAheadBuffer = NULL;
+	dev->readAheadChunks = 0;
+	dev->readAheadObjectId = 0;
 	dev->gcCleanupList = NULL;
+	dev->sumTags = NULL;
 
 
 	if (!init_failed &&
@@ -5314,14 +5927,49 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 
 		for (i = 0; i < dev->param.nShortOpCaches && buf; i++) {
 			dev->srCache[i].object = NULL;
-			dev->srCache[i].lastUse = 0;
 			dev->srCache[i].dirty = 0;
+			YINIT_LIST_HEAD(&dev->srCache[i].hashLink);
+			ylist_add_tail(&dev->srCache[i].lruLink, &dev->srLru);
 			dev->srCache[i].data = buf = YMALLOC_DMA(dev->param.totalBytesPerChunk);
 		}
 		if (!buf)
 			init_failed = 1;
 
-		dev->srLastUse = 0;
+		/* Power of two buckets, about two caches to a bucket */
+		dev->srHashBuckets = 8;
+		while (dev->srHashBuckets * 2 < dev->param.nShortOpCaches)
+			dev->srHashBuckets <<= 1;
+
+		if (!init_failed) {
+			dev->srHash = YMALLOC(dev->srHashBuckets *
+					sizeof(struct ylist_head));
+			if (!dev->srHash)
+				init_failed = 1;
+		}
+
+		for (i = 0; dev->srHash && i < dev->srHashBuckets; i++)
+			YINIT_LIST_HEAD(&dev->srHash[i]);
+	}
+
+	/* Read-ahead fills clean caches, so leave at least half of them
+	 * for everything else.
+	 */
+	if (!init_failed &&
+	    dev->param.readChunksFromNAND &&
+	    !dev->param.inbandTags) {
+		int n = dev->param.nReadAheadChunks;
+
+		if (n > dev->param.nShortOpCaches / 2)
+			n = dev->param.nShortOpCaches / 2;
+		if (n > YAFFS_MAX_READ_AHEAD_CHUNKS)
+			n = YAFFS_MAX_READ_AHEAD_CHUNKS;
+
+		if (n >= 2) {
+			dev->readAheadBuffer =
+				YMALLOC_DMA(n * dev->param.totalBytesPerChunk);
+			if (dev->readAheadBuffer)
+				dev->readAheadChunks = n;
+		}
 	}
 
 	dev->cacheHits = 0;
@@ -5332,6 +5980,9 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 			init_failed = 1;
 	}
 
+	if (!init_failed && !yaffs_SummaryInitialise(dev))
+		init_failed = 1;
+
 	if (dev->param.isYaffs2)
 		dev->param.useHeaderFileSize = 1;
 
@@ -5400,6 +6051,9 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 	/* Zero out stats */
 	dev->nPageReads = 0;
 	dev->nPageWrites = 0;
+	dev->nBatchedWrites = 0;
+	dev->nSummaryWrites = 0;
+	dev->nPrefetchedChunks = 0;
 	dev->nBlockErasures = 0;
 	dev->nGCCopies = 0;
 	dev->nRetriedWrites = 0;
@@ -5439,7 +6093,15 @@ void yaffs_Deinitialise(yaffs_Device *dev)
 			dev->srCache = NULL;
 		}
 
+		YFREE(dev->srHash);
+		dev->srHash = NULL;
+
+		YFREE(dev->readAheadBuffer);
+		dev->readAheadBuffer = NULL;
+		dev->readAheadChunks = 0;
+
 		YFREE(dev->gcCleanupList);
+		yaffs_SummaryDeinitialise(dev);
 
 		for (i = 0; i < YAFFS_N_TEMP_BUFFERS; i++)
 			YFREE(dev->tempBuffer[i].buffer);
@@ -87,8 +87,14 @@
 #define YAFFS_OBJECTID_CHECKPOINT_DATA	0x20
 #define YAFFS_SEQUENCE_CHECKPOINT_DATA  0x21
 
+/* Pseudo object id for block summaries. Deliberately outside the object
+ * space so that older code treats summary chunks as garbage.
+ */
+#define YAFFS_OBJECTID_SUMMARY		(YAFFS_OBJECT_SPACE + 0x10)
+
 
-#define YAFFS_MAX_SHORT_OP_CACHES	20
+#define YAFFS_MAX_SHORT_OP_CACHES	256
+#define YAFFS_MAX_READ_AHEAD_CHUNKS	32
 
 #define YAFFS_N_TEMP_BUFFERS		6
 
@@ -98,6 +104,9 @@
  */
 #define YAFFS_WR_ATTEMPTS		(5*64)
 
+/* Maximum number of consecutive chunks written in one NAND operation. */
+#define YAFFS_MAX_WRITE_BATCH		8
+
 /* Sequence numbers are used in YAFFS2 to determine block allocation order.
  * The range is limited slightly to help distinguish bad numbers from good.
  * This also allows us to perhaps in the future use special numbers for
@@ -115,7 +124,8 @@
 typedef struct {
 	struct yaffs_ObjectStruct *object;
 	int chunkId;
-	int lastUse;
+	struct ylist_head hashLink;	/* Entry in the device's cache hash, if in use */
+	struct ylist_head lruLink;	/* Entry in the device's LRU list */
 	int dirty;
 	int nBytes;		/* Only valid if the cache is dirty */
 	int locked;		/* Can't push out or flush while locked. */
@@ -201,6 +211,13 @@ typedef struct {
 
 } yaffs_ExtendedTags;
 
+/* The part of the tags kept in a block summary */
+typedef struct {
+	unsigned objectId;
+	unsigned chunkId;
+	unsigned byteCount;
+} yaffs_SummaryTags;
+
 /* Spare structure for YAFFS1 */
 typedef struct {
 	__u8 tagByte0;
@@ -357,6 +374,15 @@ union yaffs_Tnode_union {
 
 typedef union yaffs_Tnode_union yaffs_Tnode;
 
+/* A level 1 tnode entry may hold a run instead of pointing to a level 0
+ * tnode whose entries just count up by one: the first entry's value,
+ * tagged with the bottom bit that tnode pointers never have set.
+ */
+#define yaffs_TnodeIsRun(tn)	(((unsigned long)(tn)) & 1)
+#define yaffs_TnodeRunBase(tn)	((__u32)(((unsigned long)(tn)) >> 1))
+#define yaffs_MakeTnodeRun(base) \
+	((yaffs_Tnode *)((((unsigned long)(base)) << 1) | 1))
+
 
 /*------------------------  Object -----------------------------*/
 /* An object can be one of:
@@ -377,6 +403,9 @@ typedef struct {
 typedef struct {
 	struct ylist_head children;     /* list of child links */
 	struct ylist_head dirty;	/* Entry for list of dirty directories */
+	struct ylist_head *nameHash;	/* Children hashed by name sum, built on lookup */
+	int nameHashBuckets;
+	int nameHashCount;
 } yaffs_DirectoryStructure;
 
 typedef struct {
@@ -434,6 +463,7 @@ struct yaffs_ObjectStruct {
 	/* also used for linking up the free list */
 	struct yaffs_ObjectStruct *parent;
 	struct ylist_head siblings;
+	struct ylist_head nameLink;	/* Entry in the parent's name hash */
 
 	/* Where's my object header in NAND? */
 	int hdrChunk;
@@ -537,6 +567,10 @@ struct yaffs_DeviceParamStruct {
 				 * the number of short op caches (don't use too many).
                                  * 10 to 20 is a good bet.
 				 */
+	int nReadAheadChunks;	/* Chunks to read ahead on sequential reads.
+				 * Needs readChunksFromNAND and at least twice
+				 * as many short op caches.
+				 */
 	int useNANDECC;		/* Flag to decide whether or not to use NANDECC on data (yaffs1) */
 	int noTagsECC;		/* Flag to decide whether or not to do ECC on packed tags (yaffs2) */ 
 
@@ -569,9 +603,22 @@ struct yaffs_DeviceParamStruct {
 	int (*writeChunkWithTagsToNAND) (struct yaffs_DeviceStruct *dev,
 					 int chunkInNAND, const __u8 *data,
 					 const yaffs_ExtendedTags *tags);
+	/* Optional. Writes nChunks consecutive chunks in one operation;
+	 * data holds the chunks back to back, tags one entry per chunk.
+	 */
+	int (*writeChunksWithTagsToNAND) (struct yaffs_DeviceStruct *dev,
+					  int chunkInNAND, int nChunks,
+					  const __u8 *data,
+					  const yaffs_ExtendedTags *tags);
 	int (*readChunkWithTagsFromNAND) (struct yaffs_DeviceStruct *dev,
 					  int chunkInNAND, __u8 *data,
 					  yaffs_ExtendedTags *tags);
+	/* Optional: read the data of several chunks in a row. data holds
+	 * the chunks back to back, totalBytesPerChunk apart. Must fail
+	 * rather than return data with any ECC trouble.
+	 */
+	int (*readChunksFromNAND) (struct yaffs_DeviceStruct *dev,
+				   int chunkInNAND, int nChunks, __u8 *data);
 	int (*markNANDBlockBad) (struct yaffs_DeviceStruct *dev, int blockNo);
 	int (*queryNANDBlock) (struct yaffs_DeviceStruct *dev, int blockNo,
 			       yaffs_BlockState *state, __u32 *sequenceNumber);
@@ -590,9 +637,16 @@ struct yaffs_DeviceParamStruct {
 	/*  Callback to control garbage collection. */
 	unsigned (*gcControl)(struct yaffs_DeviceStruct *dev);
 
+	/* Optional. Called when the write path wants to do passive gc.
+	 * Returns non-zero if a background thread will do it instead.
+	 * Aggressive gc is still done inline.
+	 */
+	int (*deferGarbageCollection)(struct yaffs_DeviceStruct *dev);
+
         /* Debug control flags. Don't use unless you know what you're doing */
 	int useHeaderFileSize;	/* Flag to determine if we should use file sizes from the header */
 	int disableLazyLoad;	/* Disable lazy loading on this device */
+	int disableSummary;	/* yaffs2 only: Set to not write block summaries */
 	int wideTnodesDisabled; /* Set to disable wide tnodes */
 	int disableSoftDelete;  /* yaffs 1 only: Set to disable the use of softdeletion. */
 	
@@ -664,6 +718,13 @@ struct yaffs_DeviceStruct {
 	__u32 checkpointSum;
 	__u32 checkpointXor;
 
+	/* Checkpoint compression, see yaffs_checkptrw.c */
+	__u8 *checkpointFrame;		/* Uncompressed frame */
+	__u8 *checkpointZBuffer;	/* Compressed frame and LZO workspace */
+	int checkpointFrameLength;
+	int checkpointFrameOffset;
+	int checkpointCompressed;	/* 1 = compressed, 0 = not, -1 = don't know yet */
+
 	int nCheckpointBlocksRequired; /* Number of blocks needed to store current checkpoint set */
 
 	/* Block Info */
@@ -684,6 +745,10 @@ struct yaffs_DeviceStruct {
 	void *allocator;
 	int nObjects;
 	int nTnodes;
+	int nTnodeRuns;		/* Level 0 tnodes held as runs */
+	__u32 tnodeRunView[YAFFS_NTNODES_LEVEL0]; /* Room for any level 0 tnode,
+						   * see yaffs_TnodeRunView()
+						   */
 
 	int nHardLinks;
 
@@ -692,6 +757,12 @@ struct yaffs_DeviceStruct {
 
 	int nFreeChunks;
 
+	/* Block summary of the block being allocated from */
+	yaffs_SummaryTags *sumTags;
+	int chunksPerSummary;	/* Chunks per block usable for data */
+	int sumBlock;
+	int sumCount;
+
 	/* Garbage collection control */
 	__u32 *gcCleanupList;	/* objects to delete at the end of a GC. */
 	__u32 nCleanups;
@@ -719,7 +790,15 @@ struct yaffs_DeviceStruct {
 	int doingBufferedBlockRewrite;
 
 	yaffs_ChunkCache *srCache;
-	int srLastUse;
+	struct ylist_head *srHash;	/* Caches in use, hashed on object and chunk */
+	int srHashBuckets;
+	struct ylist_head srLru;	/* All caches, least recently used first */
+
+	/* Read-ahead into the short op cache */
+	__u8 *readAheadBuffer;
+	int readAheadChunks;	/* Chunks per read-ahead, 0 if off */
+	__u32 readAheadObjectId;	/* Where the last read stopped */
+	int readAheadNextChunk;
 
 	/* Stuff for background deletion and unlinked files.*/
 	yaffs_Object *unlinkedDir;	/* Directory where unlinked and deleted files live. */
@@ -750,6 +829,10 @@ struct yaffs_DeviceStruct {
 
 	/* Statistcs */
 	__u32 nPageWrites;
+	__u32 nBatchedWrites;
+	__u32 nSummaryWrites;
+	__u32 nSummaryScans;	/* Blocks scanned from their summary */
+	__u32 nPrefetchedChunks;	/* Chunks fetched by read-ahead */
 	__u32 nPageReads;
 	__u32 nBlockErasures;
 	__u32 nErasureFailures;
@@ -759,10 +842,13 @@ struct yaffs_DeviceStruct {
 	__u32 oldestDirtyGCs;
 	__u32 nGCBlocks;
 	__u32 backgroundGCs;
+	__u32 deferredGCs;	/* Passive gc handed to the background thread */
+	__u32 foregroundAggressiveGCs;
 	__u32 nRetriedWrites;
 	__u32 nRetiredBlocks;
 	__u32 eccFixed;
 	__u32 eccUnfixed;
+	__u32 nScrubs;		/* Blocks queued for gc after bit flips */
 	__u32 tagsEccFixed;
 	__u32 tagsEccUnfixed;
 	__u32 nDeletions;
@@ -925,6 +1011,7 @@ void yaffs_GutsTest(yaffs_Device *dev);
 void yaffs_DeleteChunk(yaffs_Device *dev, int chunkId, int markNAND, int lyn);
 int yaffs_CheckFF(__u8 *buffer, int nBytes);
 void yaffs_HandleChunkError(yaffs_Device *dev, yaffs_BlockInfo *bi);
+void yaffs_HandleChunkScrub(yaffs_Device *dev, yaffs_BlockInfo *bi);
 
 __u8 *yaffs_GetTempBuffer(yaffs_Device *dev, int lineNo);
 void yaffs_ReleaseTempBuffer(yaffs_Device *dev, __u8 *buffer, int lineNo);
@@ -963,6 +1050,9 @@ int yaffs_CountFreeChunks(yaffs_Device *dev);
 yaffs_Tnode *yaffs_FindLevel0Tnode(yaffs_Device *dev,
 				yaffs_FileStructure *fStruct,
 				__u32 chunkId);
+yaffs_Tnode *yaffs_TnodeRunView(yaffs_Device *dev, yaffs_Tnode *tn);
+void yaffs_CompactLevel0Tnode(yaffs_Device *dev, yaffs_FileStructure *fStruct,
+				__u32 chunkId);
 
 __u32 yaffs_GetChunkGroupBase(yaffs_Device *dev, yaffs_Tnode *tn, unsigned pos);
 
@@ -25,6 +25,7 @@ struct yaffs_LinuxContext {
 	struct super_block * superBlock;
 	struct task_struct *bgThread; /* Background thread for this device */
 	int bgRunning;
+	unsigned long bgWakeTime; /* Earliest time the write path rewakes it */
         struct semaphore grossLock;     /* Gross locking semaphore */
 	__u8 *spareBuffer;      /* For mtdif2 use. Don't know the size of the buffer
 				 * at compile time so we have to allocate it.
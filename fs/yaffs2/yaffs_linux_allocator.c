@@ -11,22 +11,23 @@
  * published by the Free Software Foundation.
  *
  * Note: Only YAFFS headers are LGPL, YAFFS C code is covered by GPL.
- *
- * Note: Tis code is currently unused. Being checked in in case it becomes useful.
  */
 
+/*
+ * Tnodes and objects come from a pair of slab caches per mount. The tnode
+ * size depends on the partition, hence a cache per mount rather than one
+ * for the whole module. Unlike the allocator in yaffs_allocator.c, memory
+ * from slabs that empty out goes back to the system while mounted.
+ *
+ * A slab cache can only be destroyed once it is empty, so everything must
+ * be handed back through yaffs_FreeRawTnode()/yaffs_FreeRawObject() first.
+ */
 
 #include "yaffs_allocator.h"
 #include "yaffs_guts.h"
 #include "yaffs_trace.h"
 #include "yportenv.h"
 #include "yaffs_linux.h"
-/*
- * Start out with the same allocator as yaffs direct.
- * Todo: Change to Linux slab allocator.
- */
-
-
 
 #define NAMELEN  20
 struct yaffs_AllocatorStruct {
@@ -38,163 +39,105 @@ struct yaffs_AllocatorStruct {
 
 typedef struct yaffs_AllocatorStruct yaffs_Allocator;
 
-int mount_id;
-
 void yaffs_DeinitialiseRawTnodesAndObjects(yaffs_Device *dev)
 {
 	yaffs_Allocator *allocator = (yaffs_Allocator *)dev->allocator;
 
-	T(YAFFS_TRACE_ALLOCATE,(TSTR("Deinitialising yaffs allocator\n")));
-
-	if(allocator){
-		if(allocator->tnode_cache){
-			kmem_cache_destroy(allocator->tnode_cache);
-			allocator->tnode_cache = NULL;
-		} else {
-			T(YAFFS_TRACE_ALWAYS,
-				(TSTR("NULL tnode cache\n")));
-			YBUG();
-		}
-
-		if(allocator->object_cache){
-			kmem_cache_destroy(allocator->object_cache);
-			allocator->object_cache = NULL;
-		} else {
-			T(YAFFS_TRACE_ALWAYS,
-				(TSTR("NULL object cache\n")));
-			YBUG();
-		}
-
-		YFREE(allocator);
-
-	} else {
+	T(YAFFS_TRACE_ALLOCATE, (TSTR("Deinitialising yaffs allocator" TENDSTR)));
+
+	if (!allocator) {
 		T(YAFFS_TRACE_ALWAYS,
-			(TSTR("Deinitialising NULL allocator\n")));
+			(TSTR("Deinitialising NULL allocator" TENDSTR)));
 		YBUG();
+		return;
 	}
-	dev->allocator = NULL;
-}
 
+	if (dev->nTnodes || dev->nObjects)
+		T(YAFFS_TRACE_ERROR,
+			(TSTR("yaffs: %d tnodes and %d objects leaked" TENDSTR),
+			dev->nTnodes, dev->nObjects));
 
-static void fake_ctor0(void *data){data = data;}
-static void fake_ctor1(void *data){data = data;}
-static void fake_ctor2(void *data){data = data;}
-static void fake_ctor3(void *data){data = data;}
-static void fake_ctor4(void *data){data = data;}
-static void fake_ctor5(void *data){data = data;}
-static void fake_ctor6(void *data){data = data;}
-static void fake_ctor7(void *data){data = data;}
-static void fake_ctor8(void *data){data = data;}
-static void fake_ctor9(void *data){data = data;}
-
-static void (*fake_ctor_list[10]) (void *) = {
-	fake_ctor0,
-	fake_ctor1,
-	fake_ctor2,
-	fake_ctor3,
-	fake_ctor4,
-	fake_ctor5,
-	fake_ctor6,
-	fake_ctor7,
-	fake_ctor8,
-	fake_ctor9,
-};
+	if (allocator->tnode_cache)
+		kmem_cache_destroy(allocator->tnode_cache);
+	if (allocator->object_cache)
+		kmem_cache_destroy(allocator->object_cache);
+
+	YFREE(allocator);
+	dev->allocator = NULL;
+}
 
 void yaffs_InitialiseRawTnodesAndObjects(yaffs_Device *dev)
 {
 	yaffs_Allocator *allocator;
 	unsigned mount_id = yaffs_DeviceToLC(dev)->mount_id;
 
-	T(YAFFS_TRACE_ALLOCATE,(TSTR("Initialising yaffs allocator\n")));
+	T(YAFFS_TRACE_ALLOCATE, (TSTR("Initialising yaffs allocator" TENDSTR)));
 
-	if(dev->allocator)
+	if (dev->allocator) {
 		YBUG();
-	else if(mount_id >= 10){
-		T(YAFFS_TRACE_ALWAYS,(TSTR("Bad mount_id %u\n"),mount_id));
-	} else {
-		 allocator = YMALLOC(sizeof(yaffs_Allocator));
-		 memset(allocator,0,sizeof(yaffs_Allocator));
-		 dev->allocator = allocator;
-
-		if(!dev->allocator){
-			T(YAFFS_TRACE_ALWAYS,
-				(TSTR("yaffs allocator creation failed\n")));
-			YBUG();
-			return;
-
-		}
-
-		sprintf(allocator->tnode_name,"yaffs_t_%u",mount_id);
-		sprintf(allocator->object_name,"yaffs_o_%u",mount_id);
-
-		allocator->tnode_cache =
-			kmem_cache_create(allocator->tnode_name,
-				dev->tnodeSize,
-				0, 0,
-				fake_ctor_list[mount_id]);
-		if(allocator->tnode_cache)
-			T(YAFFS_TRACE_ALLOCATE,
-				(TSTR("tnode cache \"%s\" %p\n"),
-				allocator->tnode_name,allocator->tnode_cache));
-		else {
-			T(YAFFS_TRACE_ALWAYS,
-				(TSTR("yaffs cache creation failed\n")));
-			YBUG();
-		}
-
-
-		allocator->object_cache = 
-			kmem_cache_create(allocator->object_name,
-				sizeof(yaffs_Object),
-				0, 0,
-				fake_ctor_list[mount_id]);
-
-		if(allocator->object_cache)
-			T(YAFFS_TRACE_ALLOCATE,
-				(TSTR("object cache \"%s\" %p\n"),
-				allocator->object_name,allocator->object_cache));
-
-		else {
-			T(YAFFS_TRACE_ALWAYS,
-				(TSTR("yaffs cache creation failed\n")));
-			YBUG();
-		}
-	} 
-}
+		return;
+	}
+
+	allocator = YMALLOC(sizeof(yaffs_Allocator));
+	if (!allocator) {
+		T(YAFFS_TRACE_ALWAYS,
+			(TSTR("yaffs allocator creation failed" TENDSTR)));
+		return;
+	}
+	memset(allocator, 0, sizeof(yaffs_Allocator));
+	dev->allocator = allocator;
+
+	snprintf(allocator->tnode_name, NAMELEN, "yaffs_t_%u", mount_id);
+	snprintf(allocator->object_name, NAMELEN, "yaffs_o_%u", mount_id);
 
+	allocator->tnode_cache =
+		kmem_cache_create(allocator->tnode_name, dev->tnodeSize,
+				0, 0, NULL);
+	allocator->object_cache =
+		kmem_cache_create(allocator->object_name, sizeof(yaffs_Object),
+				0, 0, NULL);
+
+	if (!allocator->tnode_cache || !allocator->object_cache)
+		T(YAFFS_TRACE_ALWAYS,
+			(TSTR("yaffs cache creation failed" TENDSTR)));
+	else
+		T(YAFFS_TRACE_ALLOCATE,
+			(TSTR("tnode cache \"%s\" object cache \"%s\"" TENDSTR),
+			allocator->tnode_name, allocator->object_name));
+}
 
 yaffs_Tnode *yaffs_AllocateRawTnode(yaffs_Device *dev)
 {
 	yaffs_Allocator *allocator = dev->allocator;
-	if(!allocator || !allocator->tnode_cache){
-		YBUG();
+
+	if (!allocator || !allocator->tnode_cache)
 		return NULL;
-	}
+
 	return kmem_cache_alloc(allocator->tnode_cache, GFP_NOFS);
 }
 
 void yaffs_FreeRawTnode(yaffs_Device *dev, yaffs_Tnode *tn)
 {
 	yaffs_Allocator *allocator = dev->allocator;
-	kmem_cache_free(allocator->tnode_cache,tn);
+
+	if (tn)
+		kmem_cache_free(allocator->tnode_cache, tn);
 }
 
 yaffs_Object *yaffs_AllocateRawObject(yaffs_Device *dev)
 {
 	yaffs_Allocator *allocator = dev->allocator;
-	if(!allocator){
-		YBUG();
-		return NULL;
-	}
-	if(!allocator->object_cache){
-		YBUG();
+
+	if (!allocator || !allocator->object_cache)
 		return NULL;
-	}
+
 	return kmem_cache_alloc(allocator->object_cache, GFP_NOFS);
 }
 
 void yaffs_FreeRawObject(yaffs_Device *dev, yaffs_Object *obj)
 {
 	yaffs_Allocator *allocator = dev->allocator;
-	kmem_cache_free(allocator->object_cache,obj);
+
+	if (obj)
+		kmem_cache_free(allocator->object_cache, obj);
 }
@@ -97,6 +97,91 @@ int nandmtd2_WriteChunkWithTagsToNAND(yaffs_Device *dev, int chunkInNAND,
 		return YAFFS_FAIL;
 }
 
+#if (MTD_VERSION_CODE > MTD_VERSION(2, 6, 17))
+/* Writes consecutive chunks with a single write_oob() call, so the driver
+ * can map the data once and run the pages back to back.  The packed tags
+ * are laid out one per page at a stride of oobavail bytes, the way
+ * MTD_OOB_AUTO consumes them.  Not used with inband tags.
+ */
+int nandmtd2_WriteChunksWithTagsToNAND(yaffs_Device *dev, int chunkInNAND,
+				       int nChunks, const __u8 *data,
+				       const yaffs_ExtendedTags *tags)
+{
+	struct mtd_info *mtd = yaffs_DeviceToMtd(dev);
+	struct mtd_oob_ops ops;
+	int retval;
+	int i;
+	__u8 *oob;
+	yaffs_PackedTags2 pt;
+
+	int packed_tags_size = dev->param.noTagsECC ? sizeof(pt.t) : sizeof(pt);
+	void * packed_tags_ptr = dev->param.noTagsECC ? (void *) &pt.t : (void *)&pt;
+
+	T(YAFFS_TRACE_MTD,
+	  (TSTR
+	   ("nandmtd2_WriteChunksWithTagsToNAND chunk %d count %d"
+	    TENDSTR), chunkInNAND, nChunks));
+
+	if (!data || !tags || dev->param.inbandTags ||
+		packed_tags_size > mtd->oobavail)
+		BUG();
+
+	oob = YMALLOC(nChunks * mtd->oobavail);
+	if (!oob)
+		return YAFFS_FAIL;
+	memset(oob, 0xff, nChunks * mtd->oobavail);
+
+	for (i = 0; i < nChunks; i++) {
+		yaffs_PackTags2(&pt, &tags[i], !dev->param.noTagsECC);
+		memcpy(oob + i * mtd->oobavail, packed_tags_ptr,
+			packed_tags_size);
+	}
+
+	ops.mode = MTD_OOB_AUTO;
+	ops.ooblen = nChunks * mtd->oobavail;
+	ops.len = nChunks * dev->param.totalBytesPerChunk;
+	ops.ooboffs = 0;
+	ops.datbuf = (__u8 *)data;
+	ops.oobbuf = oob;
+	retval = mtd->write_oob(mtd,
+			((loff_t) chunkInNAND) * dev->param.totalBytesPerChunk,
+			&ops);
+
+	YFREE(oob);
+
+	if (retval == 0 && ops.retlen == ops.len)
+		return YAFFS_OK;
+	else
+		return YAFFS_FAIL;
+}
+#endif
+
+int nandmtd2_ReadChunksFromNAND(yaffs_Device *dev, int chunkInNAND,
+				int nChunks, __u8 *data)
+{
+	struct mtd_info *mtd = yaffs_DeviceToMtd(dev);
+	size_t len = nChunks * dev->param.totalBytesPerChunk;
+	size_t retlen = 0;
+	int retval;
+
+	T(YAFFS_TRACE_MTD,
+	  (TSTR
+	   ("nandmtd2_ReadChunksFromNAND chunk %d count %d"
+	    TENDSTR), chunkInNAND, nChunks));
+
+	retval = mtd->read(mtd,
+			((loff_t) chunkInNAND) * dev->param.totalBytesPerChunk,
+			len, &retlen, data);
+
+	/* Corrected bit flips (-EUCLEAN) count as failure too, so that the
+	 * normal read path gets to see and handle them.
+	 */
+	if (retval == 0 && retlen == len)
+		return YAFFS_OK;
+	else
+		return YAFFS_FAIL;
+}
+
 int nandmtd2_ReadChunkWithTagsFromNAND(yaffs_Device *dev, int chunkInNAND,
 				       __u8 *data, yaffs_ExtendedTags *tags)
 {
@@ -45,12 +45,32 @@ int yaffs_ReadChunkWithTagsFromNAND(yaffs_Device *dev, int chunkInNAND,
 
 		yaffs_BlockInfo *bi;
 		bi = yaffs_GetBlockInfo(dev, chunkInNAND/dev->param.nChunksPerBlock);
-		yaffs_HandleChunkError(dev, bi);
+		if (tags->eccResult == YAFFS_ECC_RESULT_FIXED)
+			yaffs_HandleChunkScrub(dev, bi);
+		else
+			yaffs_HandleChunkError(dev, bi);
 	}
 
 	return result;
 }
 
+/*
+ * Read the data of several chunks in a row without tags. Only for
+ * read-ahead: on any failure the caller falls back to single chunk reads,
+ * which take care of ECC handling.
+ */
+int yaffs_ReadChunksFromNAND(yaffs_Device *dev, int chunkInNAND, int nChunks,
+				__u8 *buffer)
+{
+	if (!dev->param.readChunksFromNAND)
+		return YAFFS_FAIL;
+
+	dev->nPageReads += nChunks;
+
+	return dev->param.readChunksFromNAND(dev, chunkInNAND - dev->chunkOffset,
+					      nChunks, buffer);
+}
+
 int yaffs_WriteChunkWithTagsToNAND(yaffs_Device *dev,
 						   int chunkInNAND,
 						   const __u8 *buffer,
@@ -88,6 +108,39 @@ int yaffs_WriteChunkWithTagsToNAND(yaffs_Device *dev,
 								       tags);
 }
 
+int yaffs_WriteChunksWithTagsToNAND(yaffs_Device *dev,
+						   int chunkInNAND, int nChunks,
+						   const __u8 *buffer,
+						   yaffs_ExtendedTags *tags)
+{
+	int i;
+
+	if (!dev->param.writeChunksWithTagsToNAND)
+		YBUG();
+
+	dev->nPageWrites += nChunks;
+	dev->nBatchedWrites++;
+
+	chunkInNAND -= dev->chunkOffset;
+
+	for (i = 0; i < nChunks; i++) {
+		tags[i].sequenceNumber = dev->sequenceNumber;
+		tags[i].chunkUsed = 1;
+		if (!yaffs_ValidateTags(&tags[i])) {
+			T(YAFFS_TRACE_ERROR,
+			  (TSTR("Writing uninitialised tags" TENDSTR)));
+			YBUG();
+		}
+	}
+
+	T(YAFFS_TRACE_WRITE,
+	  (TSTR("Writing chunks %d..%d tags %d %d" TENDSTR), chunkInNAND,
+	   chunkInNAND + nChunks - 1, tags[0].objectId, tags[0].chunkId));
+
+	return dev->param.writeChunksWithTagsToNAND(dev, chunkInNAND, nChunks,
+						    buffer, tags);
+}
+
 int yaffs_MarkBlockBad(yaffs_Device *dev, int blockNo)
 {
 	blockNo -= dev->blockOffset;
@@ -23,11 +23,19 @@ int yaffs_ReadChunkWithTagsFromNAND(yaffs_Device *dev, int chunkInNAND,
 					__u8 *buffer,
 					yaffs_ExtendedTags *tags);
 
+int yaffs_ReadChunksFromNAND(yaffs_Device *dev, int chunkInNAND, int nChunks,
+				__u8 *buffer);
+
 int yaffs_WriteChunkWithTagsToNAND(yaffs_Device *dev,
 						int chunkInNAND,
 						const __u8 *buffer,
 						yaffs_ExtendedTags *tags);
 
+int yaffs_WriteChunksWithTagsToNAND(yaffs_Device *dev,
+						int chunkInNAND, int nChunks,
+						const __u8 *buffer,
+						yaffs_ExtendedTags *tags);
+
 int yaffs_MarkBlockBad(yaffs_Device *dev, int blockNo);
 
 int yaffs_QueryInitialBlockState(yaffs_Device *dev,
@@ -0,0 +1,234 @@
+/*
+ * YAFFS: Yet Another Flash File System. A NAND-flash specific file system.
+ *
+ * Copyright (C) 2002-2010 Aleph One Ltd.
+ *   for Toby Churchill Ltd and Brightstar Engineering
+ *
+ * Created by Charles Manning <charles@aleph1.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Block summaries.
+ *
+ * While a block is being filled we keep a copy of the tags of each chunk
+ * written to it. When all but the last chunk have been written the copy
+ * is written to the last chunk of the block. A scan can then read the
+ * tags for the whole block in one go instead of one chunk at a time.
+ *
+ * The summary chunk is tagged with YAFFS_OBJECTID_SUMMARY, which lies
+ * outside the object id space, so code that does not know about
+ * summaries discards it as a chunk with bad tags.
+ *
+ * Blocks that were not filled in order from the first chunk (partly
+ * written before a remount, or cut short by a write error) simply have
+ * no summary and get scanned the old way.
+ */
+
+#include "yaffs_summary.h"
+#include "yaffs_nand.h"
+#include "yaffs_tagsvalidity.h"
+#include "yaffs_getblockinfo.h"
+#include "yaffs_trace.h"
+
+#define YAFFS_SUMMARY_VERSION	1
+
+typedef struct {
+	__u32 version;
+	__u32 sequenceNumber;
+	__u32 nEntries;
+	__u32 sum;
+} yaffs_SummaryHeader;
+
+static __u32 yaffs_SummarySum(yaffs_Device *dev)
+{
+	__u8 *p = (__u8 *) dev->sumTags;
+	int n = dev->chunksPerSummary * sizeof(yaffs_SummaryTags);
+	__u32 sum = 0;
+
+	while (n-- > 0) {
+		sum = (sum << 1) | (sum >> 31);
+		sum += *p++;
+	}
+
+	return sum;
+}
+
+int yaffs_SummaryInitialise(yaffs_Device *dev)
+{
+	int nEntries = dev->param.nChunksPerBlock - 1;
+	int nBytes = nEntries * sizeof(yaffs_SummaryTags);
+
+	dev->sumTags = NULL;
+	dev->sumBlock = -1;
+	dev->sumCount = 0;
+	dev->chunksPerSummary = dev->param.nChunksPerBlock;
+
+	if (!dev->param.isYaffs2 || dev->param.disableSummary ||
+		sizeof(yaffs_SummaryHeader) + nBytes > dev->nDataBytesPerChunk)
+		return YAFFS_OK;
+
+	dev->sumTags = YMALLOC(nBytes);
+	if (!dev->sumTags)
+		return YAFFS_FAIL;
+
+	dev->chunksPerSummary = nEntries;
+
+	return YAFFS_OK;
+}
+
+void yaffs_SummaryDeinitialise(yaffs_Device *dev)
+{
+	YFREE(dev->sumTags);
+	dev->sumTags = NULL;
+}
+
+/*
+ * Record the tags of a chunk just written. Returns 1 once the summary
+ * for the block is complete and should be written to the next chunk.
+ */
+int yaffs_SummaryAdd(yaffs_Device *dev, const yaffs_ExtendedTags *tags,
+			int chunkInNAND)
+{
+	int blk = chunkInNAND / dev->param.nChunksPerBlock;
+	int page = chunkInNAND % dev->param.nChunksPerBlock;
+	yaffs_SummaryTags *st;
+
+	if (!dev->sumTags)
+		return 0;
+
+	if (page == 0) {
+		dev->sumBlock = blk;
+		dev->sumCount = 0;
+	}
+
+	if (blk != dev->sumBlock || page != dev->sumCount) {
+		/* Something was skipped, this block won't get a summary */
+		dev->sumBlock = -1;
+		return 0;
+	}
+
+	st = &dev->sumTags[page];
+	st->objectId = tags->objectId;
+	st->chunkId = tags->chunkId;
+	st->byteCount = tags->byteCount;
+
+	dev->sumCount++;
+
+	return dev->sumCount == dev->chunksPerSummary;
+}
+
+int yaffs_SummaryWrite(yaffs_Device *dev, int chunkInNAND)
+{
+	yaffs_ExtendedTags tags;
+	yaffs_SummaryHeader hdr;
+	int nBytes = dev->chunksPerSummary * sizeof(yaffs_SummaryTags);
+	int blk = chunkInNAND / dev->param.nChunksPerBlock;
+	__u8 *buffer;
+	int result;
+
+	hdr.version = YAFFS_SUMMARY_VERSION;
+	hdr.sequenceNumber = dev->sequenceNumber;
+	hdr.nEntries = dev->chunksPerSummary;
+	hdr.sum = yaffs_SummarySum(dev);
+
+	buffer = yaffs_GetTempBuffer(dev, __LINE__);
+	memset(buffer, 0xff, dev->nDataBytesPerChunk);
+	memcpy(buffer, &hdr, sizeof(hdr));
+	memcpy(buffer + sizeof(hdr), dev->sumTags, nBytes);
+
+	yaffs_InitialiseTags(&tags);
+	tags.objectId = YAFFS_OBJECTID_SUMMARY;
+	tags.chunkId = 1;
+	tags.byteCount = sizeof(hdr) + nBytes;
+
+	result = yaffs_WriteChunkWithTagsToNAND(dev, chunkInNAND, buffer, &tags);
+
+	yaffs_ReleaseTempBuffer(dev, buffer, __LINE__);
+
+	dev->sumBlock = -1;
+
+	if (result != YAFFS_OK) {
+		yaffs_HandleChunkError(dev, yaffs_GetBlockInfo(dev, blk));
+		return YAFFS_FAIL;
+	}
+
+	dev->nSummaryWrites++;
+
+	return YAFFS_OK;
+}
+
+/*
+ * Load the summary of a block into dev->sumTags for the scan.
+ * Returns 1 if the block has a summary that can be trusted.
+ */
+int yaffs_SummaryRead(yaffs_Device *dev, int blk)
+{
+	yaffs_BlockInfo *bi = yaffs_GetBlockInfo(dev, blk);
+	yaffs_ExtendedTags tags;
+	yaffs_SummaryHeader hdr;
+	int nBytes = dev->chunksPerSummary * sizeof(yaffs_SummaryTags);
+	int chunk = (blk + 1) * dev->param.nChunksPerBlock - 1;
+	__u8 *buffer;
+	int ok;
+
+	if (!dev->sumTags)
+		return 0;
+
+	buffer = yaffs_GetTempBuffer(dev, __LINE__);
+
+	yaffs_ReadChunkWithTagsFromNAND(dev, chunk, buffer, &tags);
+
+	ok = tags.chunkUsed &&
+		tags.eccResult <= YAFFS_ECC_RESULT_FIXED &&
+		tags.objectId == YAFFS_OBJECTID_SUMMARY &&
+		tags.sequenceNumber == bi->sequenceNumber &&
+		tags.byteCount == sizeof(hdr) + nBytes;
+
+	if (ok) {
+		memcpy(&hdr, buffer, sizeof(hdr));
+		memcpy(dev->sumTags, buffer + sizeof(hdr), nBytes);
+
+		ok = hdr.version == YAFFS_SUMMARY_VERSION &&
+			hdr.sequenceNumber == bi->sequenceNumber &&
+			hdr.nEntries == dev->chunksPerSummary &&
+			hdr.sum == yaffs_SummarySum(dev);
+	}
+
+	yaffs_ReleaseTempBuffer(dev, buffer, __LINE__);
+
+	if (!ok)
+		T(YAFFS_TRACE_SCAN,
+		  (TSTR("Block %d has no usable summary" TENDSTR), blk));
+
+	return ok;
+}
+
+/*
+ * Make up the tags of a chunk from the summary loaded by
+ * yaffs_SummaryRead(). The summary does not keep the extra header
+ * info, so callers needing that must read the tags of object headers.
+ */
+void yaffs_SummaryFetch(yaffs_Device *dev, yaffs_ExtendedTags *tags,
+			int chunkInBlock)
+{
+	yaffs_InitialiseTags(tags);
+
+	tags->chunkUsed = 1;
+	tags->eccResult = YAFFS_ECC_RESULT_NO_ERROR;
+
+	if (chunkInBlock >= dev->chunksPerSummary) {
+		/* The summary chunk itself */
+		tags->objectId = YAFFS_OBJECTID_SUMMARY;
+		tags->chunkId = 1;
+	} else {
+		yaffs_SummaryTags *st = &dev->sumTags[chunkInBlock];
+
+		tags->objectId = st->objectId;
+		tags->chunkId = st->chunkId;
+		tags->byteCount = st->byteCount;
+	}
+}
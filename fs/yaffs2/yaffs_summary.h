@@ -0,0 +1,32 @@
+/*
+ * YAFFS: Yet Another Flash File System. A NAND-flash specific file system.
+ *
+ * Copyright (C) 2002-2010 Aleph One Ltd.
+ *   for Toby Churchill Ltd and Brightstar Engineering
+ *
+ * Created by Charles Manning <charles@aleph1.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Block summaries (yaffs2 only)
+ */
+
+#ifndef __YAFFS_SUMMARY_H__
+#define __YAFFS_SUMMARY_H__
+
+#include "yaffs_guts.h"
+
+int yaffs_SummaryInitialise(yaffs_Device *dev);
+void yaffs_SummaryDeinitialise(yaffs_Device *dev);
+int yaffs_SummaryAdd(yaffs_Device *dev, const yaffs_ExtendedTags *tags,
+			int chunkInNAND);
+int yaffs_SummaryWrite(yaffs_Device *dev, int chunkInNAND);
+int yaffs_SummaryRead(yaffs_Device *dev, int blk);
+void yaffs_SummaryFetch(yaffs_Device *dev, yaffs_ExtendedTags *tags,
+			int chunkInBlock);
+
+#endif
@@ -240,6 +240,8 @@ int yaffs_VerifyTnodeWorker(yaffs_Object *obj, yaffs_Tnode *tn,
 			yaffs_ExtendedTags tags;
 			__u32 objectId = obj->objectId;
 
+			tn = yaffs_TnodeRunView(dev, tn);
+
 			chunkOffset <<=  YAFFS_TNODES_LEVEL0_BITS;
 
 			for (i = 0; i < YAFFS_NTNODES_LEVEL0; i++) {
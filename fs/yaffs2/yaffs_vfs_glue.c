@@ -94,6 +94,9 @@
 #ifdef YAFFS_COMPILE_FREEZER
 #include <linux/freezer.h>
 #endif
+#ifdef CONFIG_HAS_EARLYSUSPEND
+#include <linux/earlysuspend.h>
+#endif
 
 #include <asm/div64.h>
 
@@ -169,12 +172,26 @@ static uint32_t YCALCBLOCKS(uint64_t partition_size, uint32_t block_size)
 #include "yaffs_mtdif.h"
 #include "yaffs_mtdif1.h"
 #include "yaffs_mtdif2.h"
+#include "yaffs_packedtags2.h"
 
 unsigned int yaffs_traceMask = YAFFS_TRACE_BAD_BLOCKS | YAFFS_TRACE_ALWAYS;
 unsigned int yaffs_wr_attempts = YAFFS_WR_ATTEMPTS;
 unsigned int yaffs_auto_checkpoint = 1;
 unsigned int yaffs_gc_control = 1;
 unsigned int yaffs_bg_enable = 1;
+/* Background gc starts once this percentage of the free chunks is
+ * scattered over dirty blocks rather than sitting in erased ones.
+ */
+unsigned int yaffs_bg_gc_dirty_ratio = 50;
+/* Passive background gc waits for this long without writes. */
+unsigned int yaffs_bg_gc_idle_ms = 1000;
+/* Allow passive background gc while the screen is on. */
+unsigned int yaffs_bg_gc_screen_on;
+/* Chunk sized caches per mount, and how many of them a sequential
+ * read may fill ahead of the reader.
+ */
+unsigned int yaffs_short_op_caches = 32;
+unsigned int yaffs_read_ahead_chunks = 8;
 
 /* Module Parameters */
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
@@ -183,6 +200,11 @@ module_param(yaffs_wr_attempts, uint, 0644);
 module_param(yaffs_auto_checkpoint, uint, 0644);
 module_param(yaffs_gc_control, uint, 0644);
 module_param(yaffs_bg_enable, uint, 0644);
+module_param(yaffs_bg_gc_dirty_ratio, uint, 0644);
+module_param(yaffs_bg_gc_idle_ms, uint, 0644);
+module_param(yaffs_bg_gc_screen_on, uint, 0644);
+module_param(yaffs_short_op_caches, uint, 0644);
+module_param(yaffs_read_ahead_chunks, uint, 0644);
 #else
 MODULE_PARM(yaffs_traceMask, "i");
 MODULE_PARM(yaffs_wr_attempts, "i");
@@ -2253,12 +2275,12 @@ static unsigned yaffs_bg_gc_urgency(yaffs_Device *dev)
 		return 0;
 	else if(scatteredFree < (dev->param.nChunksPerBlock * 2))
 		return 0;
-	else if(erasedChunks > dev->nFreeChunks/2)
-		return 0;
-	else if(erasedChunks > dev->nFreeChunks/4)
+	else if(erasedChunks <= dev->nFreeChunks/4)
+		return 2;
+	else if(scatteredFree * 100 >= yaffs_bg_gc_dirty_ratio * dev->nFreeChunks)
 		return 1;
 	else
-		return 2;
+		return 0;
 }
 
 static int yaffs_do_sync_fs(struct super_block *sb,
@@ -2307,11 +2329,50 @@ static int yaffs_do_sync_fs(struct super_block *sb,
 
 #ifdef YAFFS_COMPILE_BACKGROUND
 
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static int yaffs_screen_on = 1;
+#else
+#define yaffs_screen_on 0
+#endif
+
 void yaffs_background_waker(unsigned long data)
 {
 	wake_up_process((struct task_struct *)data);
 }
 
+/*
+ * Urgent gc always runs.  Passive gc waits until there have been no
+ * writes for yaffs_bg_gc_idle_ms, and by default until the screen is off,
+ * so that it does not compete with interactive bursts of I/O.
+ */
+static int yaffs_bg_gc_allowed(unsigned urgency, unsigned long now,
+				unsigned long last_write)
+{
+	if(urgency > 1)
+		return 1;
+	if(urgency < 1)
+		return 0;
+	if(yaffs_screen_on && !yaffs_bg_gc_screen_on)
+		return 0;
+	return time_after_eq(now,
+			last_write + msecs_to_jiffies(yaffs_bg_gc_idle_ms));
+}
+
+/* Called by the write path instead of doing passive gc itself. */
+static int yaffs_bg_defer_gc(yaffs_Device *dev)
+{
+	struct yaffs_LinuxContext *context = yaffs_DeviceToLC(dev);
+
+	if(!context->bgRunning || !context->bgThread || !yaffs_bg_enable)
+		return 0;
+
+	if(time_after(jiffies, context->bgWakeTime)){
+		context->bgWakeTime = jiffies + HZ/20;
+		wake_up_process(context->bgThread);
+	}
+	return 1;
+}
+
 static int yaffs_BackgroundThread(void *data)
 {
 	yaffs_Device *dev = (yaffs_Device *)data;
@@ -2320,6 +2381,8 @@ static int yaffs_BackgroundThread(void *data)
 	unsigned long next_dir_update = now;
 	unsigned long next_gc = now;
 	unsigned long expires;
+	unsigned long last_write = now;
+	__u32 fg_writes = 0;
 	unsigned int urgency;
 
 	int gcResult;
@@ -2347,6 +2410,12 @@ static int yaffs_BackgroundThread(void *data)
 
 		now = jiffies;
 
+		/* Page writes not done by gc itself */
+		if(dev->nPageWrites - dev->nGCCopies != fg_writes){
+			fg_writes = dev->nPageWrites - dev->nGCCopies;
+			last_write = now;
+		}
+
 		if(time_after(now, next_dir_update) && yaffs_bg_enable){
 			yaffs_UpdateDirtyDirectories(dev);
 			next_dir_update = now + HZ;
@@ -2355,11 +2424,17 @@ static int yaffs_BackgroundThread(void *data)
 		if(time_after(now,next_gc) && yaffs_bg_enable){
 			if(!dev->isCheckpointed){
 				urgency = yaffs_bg_gc_urgency(dev);
-				gcResult = yaffs_BackgroundGarbageCollect(dev, urgency);
-				if(urgency > 1)
-					next_gc = now + HZ/20+1;
-				else if(urgency > 0)
-					next_gc = now + HZ/10+1;
+				if(yaffs_bg_gc_allowed(urgency, now, last_write)){
+					gcResult = yaffs_BackgroundGarbageCollect(dev, urgency);
+					if(urgency > 1)
+						next_gc = now + HZ/20+1;
+					else
+						next_gc = now + HZ/10+1;
+				} else if(urgency > 0 &&
+					!(yaffs_screen_on && !yaffs_bg_gc_screen_on))
+					/* recheck once the writes have gone quiet */
+					next_gc = now +
+						msecs_to_jiffies(yaffs_bg_gc_idle_ms) + 1;
 				else
 					next_gc = now + HZ * 2;
 			} else /*
@@ -2544,6 +2619,36 @@ static void yaffs_read_inode(struct inode *inode)
 static YLIST_HEAD(yaffs_context_list);
 struct semaphore yaffs_context_lock;
 
+#if defined(YAFFS_COMPILE_BACKGROUND) && defined(CONFIG_HAS_EARLYSUSPEND)
+/* Screen off: let the background threads catch up on passive gc. */
+static void yaffs_early_suspend(struct early_suspend *h)
+{
+	struct ylist_head *item;
+
+	yaffs_screen_on = 0;
+
+	down(&yaffs_context_lock);
+	ylist_for_each(item, &yaffs_context_list) {
+		struct yaffs_LinuxContext *dc = ylist_entry(item,
+				struct yaffs_LinuxContext, contextList);
+		if(dc->bgThread)
+			wake_up_process(dc->bgThread);
+	}
+	up(&yaffs_context_lock);
+}
+
+static void yaffs_late_resume(struct early_suspend *h)
+{
+	yaffs_screen_on = 1;
+}
+
+static struct early_suspend yaffs_early_suspend_desc = {
+	.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN,
+	.suspend = yaffs_early_suspend,
+	.resume = yaffs_late_resume,
+};
+#endif
+
 static void yaffs_put_super(struct super_block *sb)
 {
 	yaffs_Device *dev = yaffs_SuperToDevice(sb);
@@ -2612,6 +2717,7 @@ typedef struct {
 	int lazy_loading_overridden;
 	int empty_lost_and_found;
 	int empty_lost_and_found_overridden;
+	int no_summary;
 } yaffs_options;
 
 #define MAX_OPT_LEN 30
@@ -2660,6 +2766,8 @@ static int yaffs_parse_options(yaffs_options *options, const char *options_str)
 			options->empty_lost_and_found_overridden=1;
 		} else if (!strcmp(cur_opt, "no-cache"))
 			options->no_cache = 1;
+		else if (!strcmp(cur_opt, "no-summary"))
+			options->no_summary = 1;
 		else if (!strcmp(cur_opt, "no-checkpoint-read"))
 			options->skip_checkpoint_read = 1;
 		else if (!strcmp(cur_opt, "no-checkpoint-write"))
@@ -2916,7 +3024,8 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	param->nChunksPerBlock = YAFFS_CHUNKS_PER_BLOCK;
 	param->totalBytesPerChunk = YAFFS_BYTES_PER_CHUNK;
 	param->nReservedBlocks = 5;
-	param->nShortOpCaches = (options.no_cache) ? 0 : 10;
+	param->nShortOpCaches = (options.no_cache) ? 0 : yaffs_short_op_caches;
+	param->nReadAheadChunks = yaffs_read_ahead_chunks;
 	param->inbandTags = options.inband_tags;
 
 #ifdef CONFIG_YAFFS_DISABLE_LAZY_LOAD
@@ -2961,8 +3070,20 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	if (yaffsVersion == 2) {
 		param->writeChunkWithTagsToNAND =
 		    nandmtd2_WriteChunkWithTagsToNAND;
+#if (MTD_VERSION_CODE > MTD_VERSION(2, 6, 17))
+		/* Batched writes need the packed tags to fit in each page's
+		 * free oob area.
+		 */
+		if (!param->inbandTags &&
+		    (param->noTagsECC ? sizeof(yaffs_PackedTags2TagsPart) :
+		     sizeof(yaffs_PackedTags2)) <= mtd->oobavail)
+			param->writeChunksWithTagsToNAND =
+			    nandmtd2_WriteChunksWithTagsToNAND;
+#endif
 		param->readChunkWithTagsFromNAND =
 		    nandmtd2_ReadChunkWithTagsFromNAND;
+		if (!param->inbandTags)
+			param->readChunksFromNAND = nandmtd2_ReadChunksFromNAND;
 		param->markNANDBlockBad = nandmtd2_MarkNANDBlockBad;
 		param->queryNANDBlock = nandmtd2_QueryNANDBlock;
 		yaffs_DeviceToLC(dev)->spareBuffer = YMALLOC(mtd->oobsize);
@@ -3015,6 +3136,7 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 
 	param->skipCheckpointRead = options.skip_checkpoint_read;
 	param->skipCheckpointWrite = options.skip_checkpoint_write;
+	param->disableSummary = options.no_summary;
 
 	down(&yaffs_context_lock);
 	/* Get a mount id */
@@ -3051,6 +3173,10 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 		
 	if(!context->bgThread)
 		param->deferDirectoryUpdate = 0;
+#ifdef YAFFS_COMPILE_BACKGROUND
+	else
+		param->deferGarbageCollection = yaffs_bg_defer_gc;
+#endif
 
 
 	/* Release lock before yaffs_get_inode() */
@@ -3196,8 +3322,10 @@ static char *yaffs_dump_dev_part0(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "inbandTags......... %d\n", dev->param.inbandTags);
 	buf += sprintf(buf, "emptyLostAndFound.. %d\n", dev->param.emptyLostAndFound);
 	buf += sprintf(buf, "disableLazyLoad.... %d\n", dev->param.disableLazyLoad);
+	buf += sprintf(buf, "disableSummary..... %d\n", dev->param.disableSummary);
 	buf += sprintf(buf, "refreshPeriod...... %d\n", dev->param.refreshPeriod);
 	buf += sprintf(buf, "nShortOpCaches..... %d\n", dev->param.nShortOpCaches);
+	buf += sprintf(buf, "nReadAheadChunks... %d\n", dev->readAheadChunks);
 	buf += sprintf(buf, "nReservedBlocks.... %d\n", dev->param.nReservedBlocks);
 	buf += sprintf(buf, "alwaysCheckErased.. %d\n", dev->param.alwaysCheckErased);
 
@@ -3216,10 +3344,15 @@ static char *yaffs_dump_dev_part1(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "blocksInCheckpoint. %d\n", dev->blocksInCheckpoint);
 	buf += sprintf(buf, "\n");
 	buf += sprintf(buf, "nTnodes............ %d\n", dev->nTnodes);
+	buf += sprintf(buf, "nTnodeRuns......... %d\n", dev->nTnodeRuns);
 	buf += sprintf(buf, "nObjects........... %d\n", dev->nObjects);
 	buf += sprintf(buf, "nFreeChunks........ %d\n", dev->nFreeChunks);
 	buf += sprintf(buf, "\n");
 	buf += sprintf(buf, "nPageWrites........ %u\n", dev->nPageWrites);
+	buf += sprintf(buf, "nBatchedWrites..... %u\n", dev->nBatchedWrites);
+	buf += sprintf(buf, "nSummaryWrites..... %u\n", dev->nSummaryWrites);
+	buf += sprintf(buf, "nSummaryScans...... %u\n", dev->nSummaryScans);
+	buf += sprintf(buf, "nPrefetchedChunks.. %u\n", dev->nPrefetchedChunks);
 	buf += sprintf(buf, "nPageReads......... %u\n", dev->nPageReads);
 	buf += sprintf(buf, "nBlockErasures..... %u\n", dev->nBlockErasures);
 	buf += sprintf(buf, "nGCCopies.......... %u\n", dev->nGCCopies);
@@ -3228,10 +3361,18 @@ static char *yaffs_dump_dev_part1(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "oldestDirtyGCs..... %u\n", dev->oldestDirtyGCs);
 	buf += sprintf(buf, "nGCBlocks.......... %u\n", dev->nGCBlocks);
 	buf += sprintf(buf, "backgroundGCs...... %u\n", dev->backgroundGCs);
+	buf += sprintf(buf, "deferredGCs........ %u\n", dev->deferredGCs);
+	buf += sprintf(buf, "fgAggressiveGCs.... %u\n",
+			dev->foregroundAggressiveGCs);
+	buf += sprintf(buf, "gcCopiesPerErase... %u.%02u\n",
+			dev->nGCBlocks ? dev->nGCCopies / dev->nGCBlocks : 0,
+			dev->nGCBlocks ?
+			(dev->nGCCopies % dev->nGCBlocks) * 100 / dev->nGCBlocks : 0);
 	buf += sprintf(buf, "nRetriedWrites..... %u\n", dev->nRetriedWrites);
 	buf += sprintf(buf, "nRetireBlocks...... %u\n", dev->nRetiredBlocks);
 	buf += sprintf(buf, "eccFixed........... %u\n", dev->eccFixed);
 	buf += sprintf(buf, "eccUnfixed......... %u\n", dev->eccUnfixed);
+	buf += sprintf(buf, "nScrubs............ %u\n", dev->nScrubs);
 	buf += sprintf(buf, "tagsEccFixed....... %u\n", dev->tagsEccFixed);
 	buf += sprintf(buf, "tagsEccUnfixed..... %u\n", dev->tagsEccUnfixed);
 	buf += sprintf(buf, "cacheHits.......... %u\n", dev->cacheHits);
@@ -3497,6 +3638,10 @@ static int __init init_yaffs_fs(void)
 
 	init_MUTEX(&yaffs_context_lock);
 
+#if defined(YAFFS_COMPILE_BACKGROUND) && defined(CONFIG_HAS_EARLYSUSPEND)
+	register_early_suspend(&yaffs_early_suspend_desc);
+#endif
+
 	/* Install the proc_fs entries */
 	my_proc_entry = create_proc_entry("yaffs",
 					       S_IRUGO | S_IFREG,
@@ -3555,6 +3700,10 @@ static void __exit exit_yaffs_fs(void)
 	T(YAFFS_TRACE_ALWAYS,
 		(TSTR("yaffs built " __DATE__ " " __TIME__ " removing. \n")));
 
+#if defined(YAFFS_COMPILE_BACKGROUND) && defined(CONFIG_HAS_EARLYSUSPEND)
+	unregister_early_suspend(&yaffs_early_suspend_desc);
+#endif
+
 	remove_proc_entry("yaffs", YPROC_ROOT);
 	remove_proc_entry("yaffs_stats", YPROC_ROOT);
 
@@ -21,6 +21,7 @@
 #include "yaffs_nand.h"
 #include "yaffs_getblockinfo.h"
 #include "yaffs_verify.h"
+#include "yaffs_summary.h"
 
 /*
  * Checkpoints are really no benefit on very small partitions.
@@ -230,7 +231,8 @@ int yaffs2_CalcCheckpointBlocksRequired(yaffs_Device *dev)
 		nBytes += devBlocks * sizeof(yaffs_BlockInfo);
 		nBytes += devBlocks * dev->chunkBitmapStride;
 		nBytes += (sizeof(yaffs_CheckpointObject) + sizeof(__u32)) * (dev->nObjects);
-		nBytes += (dev->tnodeSize + sizeof(__u32)) * (dev->nTnodes);
+		nBytes += (dev->tnodeSize + sizeof(__u32)) *
+				(dev->nTnodes + dev->nTnodeRuns);
 		nBytes += sizeof(yaffs_CheckpointValidity);
 		nBytes += sizeof(__u32); /* checksum*/
 
@@ -471,6 +473,9 @@ static int yaffs2_CheckpointTnodeWorker(yaffs_Object *in, yaffs_Tnode *tn,
 			}
 		} else if (level == 0) {
 			__u32 baseOffset = chunkOffset <<  YAFFS_TNODES_LEVEL0_BITS;
+
+			/* Runs go out as plain tnodes to keep the format */
+			tn = yaffs_TnodeRunView(dev, tn);
 			ok = (yaffs2_CheckpointWrite(dev, &baseOffset, sizeof(baseOffset)) == sizeof(baseOffset));
 			if (ok)
 				ok = (yaffs2_CheckpointWrite(dev, tn, dev->tnodeSize) == dev->tnodeSize);
@@ -527,6 +532,9 @@ static int yaffs2_ReadCheckpointTnodes(yaffs_Object *obj)
 							baseChunk,
 							tn) ? 1 : 0;
 
+		if (ok)
+			yaffs_CompactLevel0Tnode(dev, fileStructPtr, baseChunk);
+
 		if (ok)
 			ok = (yaffs2_CheckpointRead(dev, &baseChunk, sizeof(baseChunk)) == sizeof(baseChunk));
 
@@ -936,6 +944,7 @@ int yaffs2_ScanBackwards(yaffs_Device *dev)
 	int fileSize;
 	int isShrink;
 	int foundChunksInBlock;
+	int summaryAvailable;
 	int equivalentObjectId;
 	int alloc_failed = 0;
 
@@ -1063,6 +1072,13 @@ int yaffs2_ScanBackwards(yaffs_Device *dev)
 
 		deleted = 0;
 
+		summaryAvailable = 0;
+		if (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING &&
+			yaffs_SummaryRead(dev, blk)) {
+			summaryAvailable = 1;
+			dev->nSummaryScans++;
+		}
+
 		/* For each chunk in each block that needs scanning.... */
 		foundChunksInBlock = 0;
 		for (c = dev->param.nChunksPerBlock - 1;
@@ -1075,7 +1091,15 @@ int yaffs2_ScanBackwards(yaffs_Device *dev)
 
 			chunk = blk * dev->param.nChunksPerBlock + c;
 
-			result = yaffs_ReadChunkWithTagsFromNAND(dev, chunk, NULL,
+			if (summaryAvailable) {
+				yaffs_SummaryFetch(dev, &tags, c);
+				tags.sequenceNumber = bi->sequenceNumber;
+				/* Headers still need their extra tags info */
+				if (tags.chunkId == 0)
+					result = yaffs_ReadChunkWithTagsFromNAND(dev,
+							chunk, NULL, &tags);
+			} else
+				result = yaffs_ReadChunkWithTagsFromNAND(dev, chunk, NULL,
 							&tags);
 
 			/* Let's have a good look at this chunk... */
@@ -1132,6 +1156,10 @@ int yaffs2_ScanBackwards(yaffs_Device *dev)
 
 				  dev->nFreeChunks++;
 
+			} else if (tags.objectId == YAFFS_OBJECTID_SUMMARY) {
+				/* A block summary, nothing to hook up */
+				dev->nFreeChunks++;
+
 			} else if (tags.objectId > YAFFS_MAX_OBJECT_ID ||
 				tags.chunkId > YAFFS_MAX_CHUNK_ID ||
 				(tags.chunkId > 0 && tags.byteCount > dev->nDataBytesPerChunk) ||
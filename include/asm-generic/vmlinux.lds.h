@@ -616,7 +616,13 @@
 #define INIT_CALLS							\
 		VMLINUX_SYMBOL(__initcall_start) = .;			\
 		INITCALLS						\
-		VMLINUX_SYMBOL(__initcall_end) = .;
+		VMLINUX_SYMBOL(__initcall_end) = .;			\
+		VMLINUX_SYMBOL(__parallel_initcall_start) = .;		\
+		*(.initcall_parallel.init)				\
+		VMLINUX_SYMBOL(__parallel_initcall_end) = .;		\
+		VMLINUX_SYMBOL(__deferred_initcall_start) = .;		\
+		*(.initcall_deferred.init)				\
+		VMLINUX_SYMBOL(__deferred_initcall_end) = .;
 
 #define CON_INITCALL							\
 		VMLINUX_SYMBOL(__con_initcall_start) = .;		\
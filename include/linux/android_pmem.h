@@ -61,6 +61,24 @@
 
 #define PMEM_GET_FREE_SPACE	_IOW(PMEM_IOCTL_MAGIC, 14, unsigned int)
 #define PMEM_ALLOCATE_ALIGNED	_IOW(PMEM_IOCTL_MAGIC, 15, unsigned int)
+/* Like PMEM_ALLOCATE_ALIGNED, but also picks how the allocation will be
+ * mapped; pass a struct pmem_allocation_attr */
+#define PMEM_ALLOCATE_ATTR	_IOW(PMEM_IOCTL_MAGIC, 16, unsigned int)
+/* Record that the CPU wrote the given pmem_region (offset relative to the
+ * allocation) of a PMEM_MAP_DIRTY_TRACK allocation */
+#define PMEM_MARK_DIRTY		_IOW(PMEM_IOCTL_MAGIC, 17, unsigned int)
+
+/* mapping attributes for PMEM_ALLOCATE_ATTR */
+#define PMEM_MAP_DEFAULT	0x0	/* whatever the region is set up for */
+#define PMEM_MAP_CACHED		0x1	/* only valid on cached regions */
+#define PMEM_MAP_WRITECOMBINE	0x2
+#define PMEM_MAP_UNCACHED	0x3
+#define PMEM_MAP_MASK		0x3
+/*
+ * Cached allocations only: the client reports every CPU write with
+ * PMEM_MARK_DIRTY, so kernel flushes before DMA clean only those ranges.
+ */
+#define PMEM_MAP_DIRTY_TRACK	0x100
 struct pmem_region {
 	unsigned long offset;
 	unsigned long len;
@@ -82,6 +100,12 @@ struct pmem_allocation {
 	unsigned int align;
 };
 
+struct pmem_allocation_attr {
+	unsigned long size;
+	unsigned int align;
+	unsigned int attr;
+};
+
 #ifdef __KERNEL__
 int get_pmem_file(unsigned int fd, unsigned long *start, unsigned long *vstart,
 		  unsigned long *end, struct file **filp);
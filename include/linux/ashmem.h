@@ -32,6 +32,20 @@ struct ashmem_pin {
 	__u32 len;	/* length forward from offset, in bytes, page-aligned */
 };
 
+/*
+ * ASHMEM_GET_PIN_STATUS_VEC: query 'count' ranges at once.  'pins' points
+ * to an array of struct ashmem_pin, 'status' to an array of __u32 that
+ * receives ASHMEM_IS_PINNED or ASHMEM_IS_UNPINNED for each of them.
+ */
+struct ashmem_pin_vec {
+	__u64 pins;
+	__u64 status;
+	__u32 count;
+	__u32 __reserved;
+};
+
+#define ASHMEM_PIN_VEC_MAX	1024
+
 #define __ASHMEMIOC		0x77
 
 #define ASHMEM_SET_NAME		_IOW(__ASHMEMIOC, 1, char[ASHMEM_NAME_LEN])
@@ -47,9 +61,16 @@ struct ashmem_pin {
 #define ASHMEM_CACHE_FLUSH_RANGE	_IO(__ASHMEMIOC, 11)
 #define ASHMEM_CACHE_CLEAN_RANGE	_IO(__ASHMEMIOC, 12)
 #define ASHMEM_CACHE_INV_RANGE		_IO(__ASHMEMIOC, 13)
+#define ASHMEM_GET_PIN_STATUS_VEC	_IOW(__ASHMEMIOC, 14, struct ashmem_pin_vec)
 
 int get_ashmem_file(int fd, struct file **filp, struct file **vm_file,
 			unsigned long *len);
 void put_ashmem_file(struct file *file);
 
+#ifdef CONFIG_ASHMEM
+unsigned long ashmem_unpinned_pages(void);
+#else
+static inline unsigned long ashmem_unpinned_pages(void) { return 0; }
+#endif
+
 #endif	/* _LINUX_ASHMEM_H */
@@ -195,7 +195,7 @@ struct request {
 
 	struct gendisk *rq_disk;
 	unsigned long start_time;
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_LATENCY_HIST)
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
 #endif
@@ -329,6 +329,27 @@ struct queue_limits {
 	signed char		discard_zeroes_data;
 };
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+/*
+ * log2 histograms of the time requests spend queued and being serviced.
+ * Bucket n counts latencies below 2^(n+1) usec, the last one the rest.
+ */
+#define BLK_LAT_BUCKETS		24
+
+enum {
+	BLK_LAT_READ,
+	BLK_LAT_WRITE,			/* async writes */
+	BLK_LAT_SYNC,			/* sync writes */
+	BLK_LAT_DISCARD,
+	BLK_LAT_TYPES,
+};
+
+struct blk_latency_hist {
+	unsigned int		queue[BLK_LAT_TYPES][BLK_LAT_BUCKETS];
+	unsigned int		service[BLK_LAT_TYPES][BLK_LAT_BUCKETS];
+};
+#endif
+
 struct request_queue
 {
 	/*
@@ -424,6 +445,13 @@ struct request_queue
 	struct list_head	timeout_list;
 
 	struct queue_limits	limits;
+
+	/*
+	 * Cost of swapping a page in from this device, in percent of
+	 * reading a file page back; 0 if the driver doesn't say.
+	 */
+	unsigned int		swap_cost;
+
     bool      notified_urgent;
     bool      dispatched_urgent;
 
@@ -449,6 +477,23 @@ struct request_queue
 #if defined(CONFIG_BLK_DEV_BSG)
 	struct bsg_class_device bsg_dev;
 #endif
+#ifdef CONFIG_BLK_LATENCY_HIST
+	struct blk_latency_hist	lat_hist;
+#endif
+#ifdef CONFIG_BLK_DEFERRED_DISCARD
+	/*
+	 * Discards waiting for the queue to go idle, sorted by sector.
+	 * Protected by queue_lock.
+	 */
+	struct list_head	discard_ranges;
+	unsigned int		nr_discard_ranges;
+	unsigned long		discard_delay;
+	sector_t		discard_sector;	/* chunk being issued */
+	sector_t		discard_nr;
+	wait_queue_head_t	discard_wait;
+	struct delayed_work	discard_work;
+	struct list_head	discard_node;
+#endif
 };
 
 #define QUEUE_FLAG_CLUSTER	0	/* cluster several segments into 1 */
@@ -949,6 +994,7 @@ extern void blk_limits_io_min(struct queue_limits *limits, unsigned int min);
 extern void blk_queue_io_min(struct request_queue *q, unsigned int min);
 extern void blk_limits_io_opt(struct queue_limits *limits, unsigned int opt);
 extern void blk_queue_io_opt(struct request_queue *q, unsigned int opt);
+extern void blk_queue_swap_cost(struct request_queue *q, unsigned int cost);
 extern void blk_set_default_limits(struct queue_limits *lim);
 extern int blk_stack_limits(struct queue_limits *t, struct queue_limits *b,
 			    sector_t offset);
@@ -1012,9 +1058,11 @@ static inline struct request *blk_map_queue_find_tag(struct blk_queue_tag *bqt,
 enum{
 	BLKDEV_WAIT,	/* wait for completion */
 	BLKDEV_BARRIER,	/*issue request with barrier */
+	BLKDEV_DEFER,	/* discard may be issued later, when idle */
 };
 #define BLKDEV_IFL_WAIT		(1 << BLKDEV_WAIT)
 #define BLKDEV_IFL_BARRIER	(1 << BLKDEV_BARRIER)
+#define BLKDEV_IFL_DEFER	(1 << BLKDEV_DEFER)
 extern int blkdev_issue_flush(struct block_device *, gfp_t, sector_t *,
 			unsigned long);
 extern int blkdev_issue_discard(struct block_device *bdev, sector_t sector,
@@ -1027,8 +1075,16 @@ static inline int sb_issue_discard(struct super_block *sb,
 	block <<= (sb->s_blocksize_bits - 9);
 	nr_blocks <<= (sb->s_blocksize_bits - 9);
 	return blkdev_issue_discard(sb->s_bdev, block, nr_blocks, GFP_KERNEL,
-				   BLKDEV_IFL_WAIT | BLKDEV_IFL_BARRIER);
+				   BLKDEV_IFL_WAIT | BLKDEV_IFL_BARRIER |
+				   BLKDEV_IFL_DEFER);
 }
+#ifdef CONFIG_BLK_DEFERRED_DISCARD
+extern void blkdev_flush_discards(struct block_device *bdev);
+#else
+static inline void blkdev_flush_discards(struct block_device *bdev)
+{
+}
+#endif
 
 extern int blk_verify_command(unsigned char *cmd, fmode_t has_write_perm);
 
@@ -1216,7 +1272,7 @@ static inline void put_dev_sector(Sector p)
 struct work_struct;
 int kblockd_schedule_work(struct request_queue *q, struct work_struct *work);
 
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_LATENCY_HIST)
 /*
  * This should not be using sched_clock(). A real patch is in progress
  * to fix this up, until that is in place we need to disable preemption
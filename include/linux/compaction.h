@@ -52,7 +52,23 @@ static inline bool compaction_deferred(struct zone *zone)
 	return zone->compact_considered < (1UL << zone->compact_defer_shift);
 }
 
+#ifdef CONFIG_COMPACTION_KCOMPACTD
+extern int sysctl_compact_proactive_order;
+extern int sysctl_compact_proactive_interval;
+extern int sysctl_kcompactd_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos);
+extern void wakeup_kcompactd(int order);
+#else
+static inline void wakeup_kcompactd(int order)
+{
+}
+#endif
+
 #else
+static inline void wakeup_kcompactd(int order)
+{
+}
+
 static inline unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			int order, gfp_t gfp_mask, nodemask_t *nodemask)
 {
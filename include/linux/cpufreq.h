@@ -343,6 +343,32 @@ static inline unsigned int cpufreq_quick_get(unsigned int cpu)
 #endif
 
 
+/*********************************************************************
+ *                        CPUFREQ INPUT BOOST                        *
+ *********************************************************************/
+
+#ifdef CONFIG_CPU_FREQ_INPUT_BOOST
+/* Governors opting in are notified, in atomic context, when a touch starts */
+int cpufreq_input_boost_register(struct notifier_block *nb);
+int cpufreq_input_boost_unregister(struct notifier_block *nb);
+/* Frequency floor (kHz) while a touch boost lasts, 0 when there is none */
+unsigned int cpufreq_input_boost_freq(void);
+#else
+static inline int cpufreq_input_boost_register(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline int cpufreq_input_boost_unregister(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline unsigned int cpufreq_input_boost_freq(void)
+{
+	return 0;
+}
+#endif
+
+
 /*********************************************************************
  *                       CPUFREQ DEFAULT GOVERNOR                    *
  *********************************************************************/
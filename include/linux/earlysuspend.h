@@ -29,6 +29,8 @@
  * the suspend handlers have already been called without a matching call to the
  * resume handlers, the suspend handler will be called directly from
  * register_early_suspend. This direct call can violate the normal level order.
+ * With CONFIG_EARLYSUSPEND_PARALLEL, handlers of the same level may be called
+ * concurrently, handlers that depend on each other need different levels.
  */
 enum {
 	EARLY_SUSPEND_LEVEL_BLANK_SCREEN = 50,
@@ -41,6 +43,9 @@ struct early_suspend {
 	int level;
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
+	/* Time the last suspend and resume call took, in usecs */
+	unsigned int suspend_time;
+	unsigned int resume_time;
 #endif
 };
 
@@ -899,6 +899,7 @@ struct file_ra_state {
 
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
+	unsigned int random_miss;	/* Random read() misses in a row */
 	loff_t prev_pos;		/* Cache last read() position */
 };
 
@@ -1350,6 +1351,12 @@ struct super_block {
 	struct list_head	s_dentry_lru;	/* unused dentry lru */
 	int			s_nr_dentry_unused;	/* # of dentry on lru */
 
+	/* Reclaim weight of the dcache and icache, percent of fair share */
+	unsigned int		s_cache_weight;
+	/* Lookups that missed the dcache, updated without locking */
+	unsigned long		s_lookup_misses;
+	struct kobject		*s_kobj;	/* /sys/fs/sb/<dev> */
+
 	struct block_device	*s_bdev;
 	struct backing_dev_info *s_bdi;
 	struct mtd_info		*s_mtd;
@@ -1389,6 +1396,11 @@ struct super_block {
 	int cleancache_poolid;
 };
 
+/* Values for s_cache_weight */
+#define SB_CACHE_WEIGHT_DEFAULT		100
+#define SB_CACHE_WEIGHT_VOLATILE	400	/* procfs, sysfs */
+#define SB_CACHE_WEIGHT_MAX		1000
+
 extern struct timespec current_fs_time(struct super_block *sb);
 
 /*
@@ -41,6 +41,9 @@
  * 7.15
  *  - add store notify
  *  - add retrieve notify
+ *
+ * Backported from later versions, without a version bump:
+ *  - add FUSE_MAX_PAGES, add max_pages to init_out (7.28 layout)
  */
 
 #ifndef _LINUX_FUSE_H
@@ -149,6 +152,7 @@ struct fuse_file_lock {
  *
  * FUSE_EXPORT_SUPPORT: filesystem handles lookups of "." and ".."
  * FUSE_DONT_MASK: don't apply umask to file mode on create operations
+ * FUSE_MAX_PAGES: init_out.max_pages contains the max number of req pages
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -157,6 +161,7 @@ struct fuse_file_lock {
 #define FUSE_EXPORT_SUPPORT	(1 << 4)
 #define FUSE_BIG_WRITES		(1 << 5)
 #define FUSE_DONT_MASK		(1 << 6)
+#define FUSE_MAX_PAGES		(1 << 22)
 
 /**
  * CUSE INIT request/reply flags
@@ -464,6 +469,10 @@ struct fuse_init_out {
 	__u16   max_background;
 	__u16   congestion_threshold;
 	__u32	max_write;
+	__u32	time_gran;	/* unused, keeps the 7.28 layout */
+	__u16	max_pages;
+	__u16	padding;
+	__u32	unused[8];
 };
 
 #define CUSE_INIT_INFO_MAX 4096
@@ -61,6 +61,7 @@ enum gpio_event_matrix_flags {
 					   GPIOKPF_DEBOUNCE,
 	GPIOKPF_DRIVE_INACTIVE           = 1U << 3,
 	GPIOKPF_LEVEL_TRIGGERED_IRQ      = 1U << 4,
+	GPIOKPF_HELD_KEY_IRQ             = 1U << 5,
 	GPIOKPF_PRINT_UNMAPPED_KEYS      = 1U << 16,
 	GPIOKPF_PRINT_MAPPED_KEYS        = 1U << 17,
 	GPIOKPF_PRINT_PHANTOM_KEYS       = 1U << 18,
@@ -87,6 +88,12 @@ struct gpio_event_matrix_info {
 	/* time to wait before scanning the keypad a second time */
 	ktime_t debounce_delay;
 	ktime_t poll_time;
+	/*
+	 * With GPIOKPF_HELD_KEY_IRQ, held keys are watched by interrupts
+	 * instead of polling; rescan anyway after this long (0 = never), as
+	 * a press sharing an input with a held key does not change the line.
+	 */
+	ktime_t held_poll_time;
 	unsigned flags;
 };
 
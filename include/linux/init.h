@@ -139,6 +139,15 @@ typedef void (*ctor_fn_t)(void);
 
 /* Defined in init/main.c */
 extern int do_one_initcall(initcall_t fn);
+
+/* Defined in init/initcalls.c */
+#ifdef CONFIG_PARALLEL_INITCALLS
+extern int do_timed_initcall(initcall_t fn, char kind);
+extern int initcalls_deferred(void);
+#else
+#define do_timed_initcall(fn, kind)	do_one_initcall(fn)
+#define initcalls_deferred()		0
+#endif
 extern char __initdata boot_command_line[];
 extern char *saved_command_line;
 extern unsigned int reset_devices;
@@ -215,6 +224,37 @@ extern int initcall_debug;
 	static initcall_t __initcall_##fn \
 	__used __section(.security_initcall.init) = fn
 
+/*
+ * parallel_initcall() functions run on a small pool of kernel threads
+ * once every device_initcall() has returned, and all of them have
+ * finished before the first late_initcall(). parallel_initcall_after()
+ * also waits for the parallel initcall named @dep.
+ *
+ * deferred_initcall() functions run after userspace has started, when
+ * /proc/deferred_initcalls is first read or after a timeout. See
+ * init/initcalls.c. Without CONFIG_PARALLEL_INITCALLS all of these are
+ * ordinary device initcalls.
+ */
+struct parallel_initcall {
+	initcall_t fn;
+	const char *name;
+	const char *after;
+};
+
+#ifdef CONFIG_PARALLEL_INITCALLS
+#define parallel_initcall_after(fn, dep) \
+	static struct parallel_initcall __pinitcall_##fn __used \
+	__section(.initcall_parallel.init) = { fn, #fn, dep }
+#define parallel_initcall(fn)		parallel_initcall_after(fn, NULL)
+#define deferred_initcall(fn) \
+	static initcall_t __initcall_##fn __used \
+	__section(.initcall_deferred.init) = fn
+#else
+#define parallel_initcall_after(fn, dep) device_initcall(fn)
+#define parallel_initcall(fn)		device_initcall(fn)
+#define deferred_initcall(fn)		device_initcall(fn)
+#endif
+
 struct obs_kernel_param {
 	const char *str;
 	int (*setup_func)(char *);
@@ -281,6 +321,9 @@ void __init parse_early_options(char *cmdline);
 #define fs_initcall(fn)			module_init(fn)
 #define device_initcall(fn)		module_init(fn)
 #define late_initcall(fn)		module_init(fn)
+#define parallel_initcall(fn)		module_init(fn)
+#define parallel_initcall_after(fn, dep) module_init(fn)
+#define deferred_initcall(fn)		module_init(fn)
 
 #define security_initcall(fn)		module_init(fn)
 
@@ -19,6 +19,7 @@
 
 #include <linux/interrupt.h>
 #include <linux/earlysuspend.h>
+#include <linux/input/touch_latency.h>
 
 
 #define ABS_SINGLE_TAP	0x21	/* Major axis of touching ellipse */
@@ -92,7 +93,8 @@ struct synaptics_rmi4_data{
 	int gpio_irq;
 	struct hrtimer timer;
 	//struct hrtimer resume_timer;  //ZTE_WLY_CRDB00512790
-	struct work_struct  work;
+	struct work_struct  work;	/* polling mode only */
+	struct touch_latency latency;
 	__u16 max[2];			// maxmum x/y position supported
 	struct early_suspend early_suspend;
 	__u32 dup_threshold;    //ZTE_XUKE_TOUCH_THRESHOLD_20100201
@@ -0,0 +1,60 @@
+/*
+ * Touch controller interrupt to input event latency
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef _LINUX_INPUT_TOUCH_LATENCY_H
+#define _LINUX_INPUT_TOUCH_LATENCY_H
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+/*
+ * The hard IRQ handler stamps the interrupt with touch_latency_irq() and
+ * the IRQ thread calls touch_latency_sync() after input_sync(). Only the
+ * IRQ thread updates the totals.
+ */
+struct touch_latency {
+	ktime_t irq_time;
+	unsigned int reports;
+	unsigned int max_us;
+	u64 total_us;
+};
+
+static inline void touch_latency_irq(struct touch_latency *tl)
+{
+	tl->irq_time = ktime_get();
+}
+
+static inline void touch_latency_sync(struct touch_latency *tl)
+{
+	unsigned int us;
+
+	us = ktime_to_us(ktime_sub(ktime_get(), tl->irq_time));
+	tl->reports++;
+	tl->total_us += us;
+	if (us > tl->max_us)
+		tl->max_us = us;
+}
+
+static inline ssize_t touch_latency_show(struct touch_latency *tl, char *buf)
+{
+	unsigned int reports = tl->reports;
+
+	return snprintf(buf, PAGE_SIZE, "reports %u avg_us %u max_us %u\n",
+			reports, reports ?
+			(unsigned int)div_u64(tl->total_us, reports) : 0,
+			tl->max_us);
+}
+
+#endif /* _LINUX_INPUT_TOUCH_LATENCY_H */
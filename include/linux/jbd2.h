@@ -631,6 +631,11 @@ struct transaction_s
 	 */
 	int t_handle_count;
 
+	/*
+	 * How many fsyncs are waiting for this transaction? [j_state_lock]
+	 */
+	int t_fsyncs;
+
 	/*
 	 * This transaction is being forced and some process is
 	 * waiting for it to finish.
@@ -655,6 +660,8 @@ struct transaction_run_stats_s {
 	__u32			rs_handle_count;
 	__u32			rs_blocks;
 	__u32			rs_blocks_logged;
+	__u32			rs_fsyncs;
+	__u32			rs_fsync_commits;
 };
 
 struct transaction_stats_s {
@@ -1201,6 +1208,7 @@ extern void	jbd2_journal_switch_revoke_table(journal_t *journal);
 
 int __jbd2_log_space_left(journal_t *); /* Called with journal locked */
 int jbd2_log_start_commit(journal_t *journal, tid_t tid);
+void jbd2_log_batch_fsync(journal_t *journal, tid_t tid);
 int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_journal_force_commit_nested(journal_t *journal);
@@ -127,6 +127,7 @@ static inline bool mem_cgroup_disabled(void)
 }
 
 void mem_cgroup_update_file_mapped(struct page *page, int val);
+unsigned long mem_cgroup_mm_usage(struct mm_struct *mm);
 unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 						gfp_t gfp_mask, int nid,
 						int zid);
@@ -302,6 +303,11 @@ static inline void mem_cgroup_update_file_mapped(struct page *page,
 {
 }
 
+static inline unsigned long mem_cgroup_mm_usage(struct mm_struct *mm)
+{
+	return 0;
+}
+
 static inline
 unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 					    gfp_t gfp_mask, int nid, int zid)
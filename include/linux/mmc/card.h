@@ -45,6 +45,12 @@ struct mmc_ext_csd {
 	unsigned int		sa_timeout;		/* Units: 100ns */
 	unsigned int		hs_max_dtr;
 	unsigned int		sectors;
+	unsigned int		cache_size;		/* Units: KB */
+	u8			cache_ctrl;		/* cache turned on */
+	u8			max_packed_writes;
+	u8			max_packed_reads;
+	u8			hpi_en;			/* HPI turned on */
+	unsigned int		hpi_cmd;		/* CMD12 or CMD13 */
 };
 
 struct sd_scr {
@@ -111,6 +117,7 @@ struct mmc_card {
 	struct mmc_ext_csd	ext_csd;	/* mmc v4 extended card specific */
 	struct sd_scr		scr;		/* extra SD information */
 	struct sd_switch_caps	sw_caps;	/* switch (CMD6) caps */
+	unsigned int		erase_size;	/* erase/allocation unit, sectors */
 
 	unsigned int		sdio_funcs;	/* number of SDIO functions */
 	struct sdio_cccr	cccr;		/* common card info */
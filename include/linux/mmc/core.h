@@ -115,9 +115,11 @@ struct mmc_data {
 
 	unsigned int		sg_len;		/* size of scatter list */
 	struct scatterlist	*sg;		/* I/O scatter list */
+	int			host_cookie;	/* set by the host's pre_req */
 };
 
 struct mmc_request {
+	struct mmc_command	*sbc;		/* SET_BLOCK_COUNT, if any */
 	struct mmc_command	*cmd;
 	struct mmc_data		*data;
 	struct mmc_command	*stop;
@@ -130,11 +132,17 @@ struct mmc_host;
 struct mmc_card;
 
 extern void mmc_wait_for_req(struct mmc_host *, struct mmc_request *);
+extern void mmc_start_req(struct mmc_host *, struct mmc_request *,
+			  struct completion *);
+extern void mmc_pre_req(struct mmc_host *, struct mmc_request *, bool);
+extern void mmc_post_req(struct mmc_host *, struct mmc_request *, int);
 extern int mmc_wait_for_cmd(struct mmc_host *, struct mmc_command *, int);
 extern int mmc_wait_for_app_cmd(struct mmc_host *, struct mmc_card *,
 	struct mmc_command *, int);
 
 extern void mmc_set_data_timeout(struct mmc_data *, const struct mmc_card *);
+extern int mmc_flush_cache(struct mmc_card *);
+extern int mmc_interrupt_hpi(struct mmc_card *, u32 *);
 extern unsigned int mmc_align_data_size(struct mmc_card *, unsigned int);
 
 extern int __mmc_claim_host(struct mmc_host *host, atomic_t *abort);
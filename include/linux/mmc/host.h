@@ -83,6 +83,18 @@ struct mmc_host_ops {
 	 */
 	int (*enable)(struct mmc_host *host);
 	int (*disable)(struct mmc_host *host, int lazy);
+	/*
+	 * 'pre_req' lets the host map the data of a request before it is
+	 * issued, while the request before it is still in progress. If the
+	 * host takes it, it sets data->host_cookie. 'post_req' is called
+	 * once the request is done, or with a non-zero 'err' if it is
+	 * dropped, so the host can undo a mapping it never used. Both are
+	 * optional and are called with the host claimed.
+	 */
+	void	(*pre_req)(struct mmc_host *host, struct mmc_request *req,
+			   bool is_first_req);
+	void	(*post_req)(struct mmc_host *host, struct mmc_request *req,
+			    int err);
 	void	(*request)(struct mmc_host *host, struct mmc_request *req);
 	/*
 	 * Avoid calling these three functions too often or in a "fast path",
@@ -157,6 +169,7 @@ struct mmc_host {
 #define MMC_CAP_DISABLE		(1 << 7)	/* Can the host be disabled */
 #define MMC_CAP_NONREMOVABLE	(1 << 8)	/* Nonremovable e.g. eMMC */
 #define MMC_CAP_WAIT_WHILE_BUSY	(1 << 9)	/* Waits while card is busy */
+#define MMC_CAP_CMD23		(1 << 10)	/* Sends mrq->sbc (CMD23) */
 
 	mmc_pm_flag_t		pm_caps;	/* supported pm features */
 
@@ -172,6 +172,9 @@ enum zone_watermarks {
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 #define lots_wmark_pages(z) (z->watermark[WMARK_LOTS])
 
+/* Highest order of the freed blocks kept on the per-cpu lists */
+#define PCP_HIGH_ORDER		3
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
@@ -179,6 +182,15 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/*
+	 * Freed order 1..PCP_HIGH_ORDER blocks, per order and migrate type.
+	 * high_count is in pages and kept at or below batch.
+	 */
+	int high_count;
+	unsigned int high_hits;
+	unsigned int high_misses;
+	struct list_head high_lists[PCP_HIGH_ORDER][MIGRATE_PCPTYPES];
 };
 
 struct per_cpu_pageset {
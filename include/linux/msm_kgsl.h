@@ -471,6 +471,26 @@ struct kgsl_timestamp_event_fence {
 #define IOCTL_KGSL_TIMESTAMP_EVENT \
 	_IOWR(KGSL_IOC_TYPE, 0x33, struct kgsl_timestamp_event)
 
+/*
+ * Cache maintenance on part of a GPU buffer, e.g. the rectangle the CPU
+ * drew into. Buffers the CPU only maps write-combined need none, the call
+ * returns right away for them.
+ */
+
+#define KGSL_GPUMEM_CACHE_CLEAN	0x1
+#define KGSL_GPUMEM_CACHE_INV	0x2
+#define KGSL_GPUMEM_CACHE_FLUSH	0x3
+
+struct kgsl_gpumem_cache_range {
+	unsigned int gpuaddr;
+	unsigned int offset;
+	unsigned int length;
+	unsigned int op;
+};
+
+#define IOCTL_KGSL_GPUMEM_CACHE_RANGE \
+	_IOW(KGSL_IOC_TYPE, 0x34, struct kgsl_gpumem_cache_range)
+
 #ifdef __KERNEL__
 #ifdef CONFIG_MSM_KGSL_DRM
 int kgsl_gem_obj_addr(int drm_fd, int handle, unsigned long *start,
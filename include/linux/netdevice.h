@@ -1046,6 +1046,14 @@ struct net_device {
 #define GSO_MAX_SIZE		65536
 	unsigned int		gso_max_size;
 
+	/*
+	 * TCP defaults for connections routed out of this device, used
+	 * when the route has no such metric. 0 means the system default.
+	 */
+	unsigned int		tcp_initcwnd;
+	unsigned int		tcp_initrwnd;
+	int			tcp_rmem_max;
+
 #ifdef CONFIG_DCB
 	/* Data Center Bridging netlink ops */
 	const struct dcbnl_rtnl_ops *dcbnl_ops;
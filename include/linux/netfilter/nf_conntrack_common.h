@@ -121,6 +121,7 @@ struct ip_conntrack_stat {
 	unsigned int expect_create;
 	unsigned int expect_delete;
 	unsigned int search_restart;
+	unsigned int early_drop_udp;
 };
 
 /* call to create an explicit dependency on nf_conntrack. */
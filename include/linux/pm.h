@@ -457,6 +457,9 @@ struct dev_pm_info {
 #ifdef CONFIG_PM_SLEEP
 	struct list_head	entry;
 	struct completion	completion;
+	/* Time spent in the last suspend and resume callbacks, in usecs */
+	s64			suspend_time;
+	s64			resume_time;
 #endif
 #ifdef CONFIG_PM_RUNTIME
 	struct timer_list	suspend_timer;
@@ -552,6 +555,9 @@ extern void __suspend_report_result(const char *function, void *fn, int ret);
 	} while (0)
 
 extern void device_pm_wait_for_dev(struct device *sub, struct device *dev);
+
+/* Slowest devices of the last suspend and resume, for /sys/power */
+extern ssize_t dpm_report_show(char *buf);
 #else /* !CONFIG_PM_SLEEP */
 
 #define device_pm_lock() do {} while (0)
@@ -117,4 +117,12 @@
 #define PR_SET_NO_NEW_PRIVS 38
 #define PR_GET_NO_NEW_PRIVS 39
 
+/*
+ * Leave the ptes of page cache pages out of the page tables of forked
+ * children, they fault them in on first touch. Not inherited across
+ * fork, cleared by execve.
+ */
+#define PR_SET_LAZY_FORK 40
+#define PR_GET_LAZY_FORK 41
+
 #endif /* _LINUX_PRCTL_H */
@@ -435,6 +435,7 @@ extern int get_dumpable(struct mm_struct *mm);
 #endif
 					/* leave room for more dump flags */
 #define MMF_VM_MERGEABLE	16	/* KSM may merge identical pages */
+#define MMF_LAZY_FORK		17	/* fork leaves page cache ptes to fault */
 
 #define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
 
@@ -712,6 +713,15 @@ extern struct user_struct root_user;
 struct backing_dev_info;
 struct reclaim_state;
 
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * Run delay histogram: bucket i counts delays below 2^(SHIFT + i) ns
+ * (262us, 524us, ... 16.7ms), the last bucket everything above.
+ */
+#define SCHED_DELAY_HIST_SHIFT		18
+#define SCHED_DELAY_HIST_BUCKETS	8
+#endif
+
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 struct sched_info {
 	/* cumulative counters */
@@ -724,6 +734,7 @@ struct sched_info {
 #ifdef CONFIG_SCHEDSTATS
 	/* BKL stats */
 	unsigned int bkl_count;
+	unsigned int delay_hist[SCHED_DELAY_HIST_BUCKETS];
 #endif
 };
 #endif /* defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT) */
@@ -1230,7 +1241,8 @@ struct task_struct {
 #endif
 
 	struct list_head tasks;
-	struct rb_node adj_node;
+	struct list_head adj_node;
+	unsigned long adj_rss;		/* lowmemorykiller RSS estimate */
 	struct plist_node pushable_tasks;
 
 	struct mm_struct *mm, *active_mm;
@@ -1918,6 +1930,7 @@ static inline unsigned int get_sysctl_timer_migration(void)
 #endif
 extern unsigned int sysctl_sched_rt_period;
 extern int sysctl_sched_rt_runtime;
+extern int sysctl_sched_rt_burst;
 
 int sched_rt_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
@@ -32,12 +32,17 @@ enum stat_item {
 	DEACTIVATE_TO_TAIL,	/* Cpu slab was moved to the tail of partials */
 	DEACTIVATE_REMOTE_FREES,/* Slab contained remotely freed objects */
 	ORDER_FALLBACK,		/* Number of times fallback was necessary */
+	CPU_PARTIAL_ALLOC,	/* Cpu slab acquired from cpu partial list */
+	CPU_PARTIAL_FREE,	/* Freeing moves slab to cpu partial list */
+	CPU_PARTIAL_DRAIN,	/* Cpu partial list moved to node lists */
 	NR_SLUB_STAT_ITEMS };
 
 struct kmem_cache_cpu {
 	void **freelist;	/* Pointer to first free per cpu object */
 	struct page *page;	/* The slab from which we are allocating */
 	int node;		/* The node of the page (or -1 for debug) */
+	struct page *partial;	/* Frozen partial slabs, via lru.next */
+	int nr_partial;		/* Number of slabs on the partial list */
 #ifdef CONFIG_SLUB_STATS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
 #endif
@@ -84,6 +89,7 @@ struct kmem_cache {
 	int inuse;		/* Offset to metadata */
 	int align;		/* Alignment */
 	unsigned long min_partial;
+	int cpu_partial;	/* Max slabs on each cpu partial list */
 	const char *name;	/* Name (only for display!) */
 	struct list_head list;	/* List of slab caches */
 #ifdef CONFIG_SLUB_DEBUG
@@ -148,6 +148,7 @@ enum {
 	SWP_SOLIDSTATE	= (1 << 4),	/* blkdev seeks are cheap */
 	SWP_CONTINUED	= (1 << 5),	/* swap_map has count continuation */
 	SWP_BLKDEV	= (1 << 6),	/* its a block device */
+	SWP_SYNCHRONOUS_IO = (1 << 7),	/* memory backed, no seek at all */
 					/* add others here before... */
 	SWP_SCANNING	= (1 << 8),	/* refcount in scan_swap_map */
 };
@@ -260,6 +261,7 @@ extern unsigned long shrink_all_memory(unsigned long nr_pages);
 extern int vm_swappiness;
 extern int remove_mapping(struct address_space *mapping, struct page *page);
 extern long vm_total_pages;
+extern bool page_cache_refault(struct address_space *mapping, pgoff_t index);
 
 #ifdef CONFIG_NUMA
 extern int zone_reclaim_mode;
@@ -298,6 +300,9 @@ extern void mem_cgroup_get_shmem_target(struct inode *inode, pgoff_t pgoff,
 
 extern void swap_unplug_io_fn(struct backing_dev_info *, struct page *);
 
+/* Cost of a swap-in in percent of reading a file page back */
+#define SWAP_COST_DEFAULT	100
+
 #ifdef CONFIG_SWAP
 /* linux/mm/page_io.c */
 extern int swap_readpage(struct page *);
@@ -323,6 +328,8 @@ extern struct page *swapin_readahead(swp_entry_t, gfp_t,
 /* linux/mm/swapfile.c */
 extern long nr_swap_pages;
 extern long total_swap_pages;
+extern unsigned int vm_swap_cost;
+extern void swap_update_cost(void);
 extern void si_swapinfo(struct sysinfo *);
 extern swp_entry_t get_swap_page(void);
 extern swp_entry_t get_swap_page_of_type(int);
@@ -387,6 +394,11 @@ static inline void mem_cgroup_uncharge_swap(swp_entry_t ent)
 #define nr_swap_pages				0L
 #define total_swap_pages			0L
 #define total_swapcache_pages			0UL
+#define vm_swap_cost				SWAP_COST_DEFAULT
+
+static inline void swap_update_cost(void)
+{
+}
 
 #define si_swapinfo(val) \
 	do { (val)->freeswap = (val)->totalswap = 0; } while (0)
@@ -18,12 +18,14 @@
 
 /* Contains definitions for resource tracking per uid. */
 
+struct sock;
+
 #ifdef CONFIG_UID_STAT
-int uid_stat_tcp_snd(uid_t uid, int size);
-int uid_stat_tcp_rcv(uid_t uid, int size);
+int uid_stat_tcp_snd(struct sock *sk, uid_t uid, int size);
+int uid_stat_tcp_rcv(struct sock *sk, uid_t uid, int size);
 #else
-#define uid_stat_tcp_snd(uid, size) do {} while (0);
-#define uid_stat_tcp_rcv(uid, size) do {} while (0);
+#define uid_stat_tcp_snd(sk, uid, size) do {} while (0);
+#define uid_stat_tcp_rcv(sk, uid, size) do {} while (0);
 #endif
 
 #endif /* _LINUX_UID_STAT_H */
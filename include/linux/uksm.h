@@ -24,11 +24,15 @@ extern struct page *empty_uksm_zero_page;
 extern void uksm_vma_add_new(struct vm_area_struct *vma);
 extern void uksm_remove_vma(struct vm_area_struct *vma);
 
+struct seq_file;
+extern void uksm_show_mm(struct seq_file *m, struct mm_struct *mm);
+
 #define UKSM_SLOT_NEED_SORT	(1 << 0)
 #define UKSM_SLOT_NEED_RERAND 	(1 << 1)
 #define UKSM_SLOT_SCANNED     	(1 << 2) /* It's scanned in this round */
 #define UKSM_SLOT_FUL_SCANNED 	(1 << 3)
 #define UKSM_SLOT_IN_UKSM 	(1 << 4)
+#define UKSM_SLOT_THRASHED	(1 << 5) /* Dropped for breaking COW too often */
 
 struct vma_slot {
 	struct sradix_tree_node *snode;
@@ -52,6 +56,8 @@ struct vma_slot {
 	unsigned long pages_cowed; /* pages cowed this round */
 	unsigned long pages_merged; /* pages merged this round */
 	unsigned long pages_bemerged;
+	unsigned long pages_cowed_total; /* pages cowed since the slot was created */
+	unsigned long long thrash_round; /* eval round it was last dropped */
 
 	/* when it has page merged in this eval round */
 	struct list_head dedup_list;
@@ -71,14 +77,18 @@ static inline void uksm_map_zero_page(pte_t pte)
 
 static inline void uksm_cow_page(struct vm_area_struct *vma, struct page *page)
 {
-	if (vma->uksm_vma_slot && PageKsm(page))
+	if (vma->uksm_vma_slot && PageKsm(page)) {
 		vma->uksm_vma_slot->pages_cowed++;
+		vma->uksm_vma_slot->pages_cowed_total++;
+	}
 }
 
 static inline void uksm_cow_pte(struct vm_area_struct *vma, pte_t pte)
 {
-	if (vma->uksm_vma_slot && pte_pfn(pte) == uksm_zero_pfn)
+	if (vma->uksm_vma_slot && pte_pfn(pte) == uksm_zero_pfn) {
 		vma->uksm_vma_slot->pages_cowed++;
+		vma->uksm_vma_slot->pages_cowed_total++;
+	}
 }
 
 static inline int uksm_flags_can_scan(unsigned long vm_flags)
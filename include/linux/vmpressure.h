@@ -0,0 +1,31 @@
+#ifndef _LINUX_VMPRESSURE_H
+#define _LINUX_VMPRESSURE_H
+
+#include <linux/types.h>
+#include <linux/gfp.h>
+
+/*
+ * Memory pressure levels, as reported through /dev/vmpressure.
+ *
+ * low:      reclaim is running and keeping up
+ * medium:   reclaim is working hard; caches should be trimmed
+ * critical: reclaim is failing; the system is about to start killing
+ */
+enum vmpressure_levels {
+	VMPRESSURE_LOW = 0,
+	VMPRESSURE_MEDIUM,
+	VMPRESSURE_CRITICAL,
+	VMPRESSURE_NUM_LEVELS,
+};
+
+#ifdef CONFIG_VMPRESSURE
+extern void vmpressure(gfp_t gfp, unsigned long scanned,
+		       unsigned long reclaimed);
+extern void vmpressure_prio(gfp_t gfp, int prio);
+#else
+static inline void vmpressure(gfp_t gfp, unsigned long scanned,
+			      unsigned long reclaimed) {}
+static inline void vmpressure_prio(gfp_t gfp, int prio) {}
+#endif
+
+#endif /* _LINUX_VMPRESSURE_H */
@@ -32,6 +32,9 @@ enum {
 	WAKE_LOCK_TYPE_COUNT
 };
 
+/* Hold time histogram buckets: < 1ms, then one per power of two ms */
+#define WAKE_LOCK_HIST_BUCKETS 16
+
 struct wake_lock {
 #ifdef CONFIG_HAS_WAKELOCK
 	struct list_head    link;
@@ -47,6 +50,9 @@ struct wake_lock {
 		ktime_t         prevent_suspend_time;
 		ktime_t         max_time;
 		ktime_t         last_time;
+#ifdef CONFIG_WAKELOCK_PROFILE
+		unsigned int    hold_hist[WAKE_LOCK_HIST_BUCKETS];
+#endif
 	} stat;
 #endif
 #endif
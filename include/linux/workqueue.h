@@ -211,6 +211,28 @@ __create_workqueue_key(const char *name, int singlethread,
 #define create_freezeable_workqueue(name) __create_workqueue((name), 1, 1, 0)
 #define create_singlethread_workqueue(name) __create_workqueue((name), 1, 0, 0)
 
+extern struct workqueue_struct *
+__create_shared_workqueue_key(const char *name, struct lock_class_key *key,
+			      const char *lock_name);
+
+#ifdef CONFIG_LOCKDEP
+#define create_shared_workqueue(name)				\
+({								\
+	static struct lock_class_key __key;			\
+	const char *__lock_name;				\
+								\
+	if (__builtin_constant_p(name))				\
+		__lock_name = (name);				\
+	else							\
+		__lock_name = #name;				\
+								\
+	__create_shared_workqueue_key((name), &__key, __lock_name); \
+})
+#else
+#define create_shared_workqueue(name)				\
+	__create_shared_workqueue_key((name), NULL, NULL)
+#endif
+
 extern void destroy_workqueue(struct workqueue_struct *wq);
 
 extern int queue_work(struct workqueue_struct *wq, struct work_struct *work);
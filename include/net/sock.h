@@ -211,6 +211,7 @@ struct sock_common {
   *	@sk_send_head: front of stuff to transmit
   *	@sk_security: used by security modules
   *	@sk_mark: generic packet mark
+  *	@sk_uid_stat: uid_stat entry of the uid that last used the socket
   *	@sk_write_pending: a write to stream socket waits to start
   *	@sk_state_change: callback to indicate change in the state of the sock
   *	@sk_data_ready: callback to indicate there is data to be processed
@@ -313,6 +314,9 @@ struct sock {
 #endif
 	__u32			sk_mark;
 	u32			sk_classid;
+#ifdef CONFIG_UID_STAT
+	struct uid_stat		*sk_uid_stat;
+#endif
 	void			(*sk_state_change)(struct sock *sk);
 	void			(*sk_data_ready)(struct sock *sk, int bytes);
 	void			(*sk_write_space)(struct sock *sk);
@@ -1017,6 +1017,30 @@ extern void tcp_select_initial_window(int __space, __u32 mss,
 				      int wscale_ok, __u8 *rcv_wscale,
 				      __u32 init_rcv_wnd);
 
+/* Initial receive window of a route, else the one of its output device */
+static inline u32 tcp_dst_initrwnd(struct dst_entry *dst)
+{
+	u32 rwnd = dst_metric(dst, RTAX_INITRWND);
+
+	if (!rwnd && dst->dev)
+		rwnd = dst->dev->tcp_initrwnd;
+	return rwnd;
+}
+
+/*
+ * Receive buffer limit of a socket: the one of its output device if set,
+ * else tcp_rmem[2]. The window scale is still picked from the global
+ * limits, so a device can't usefully go beyond net.core.rmem_max.
+ */
+static inline int tcp_rmem_max(struct sock *sk)
+{
+	struct dst_entry *dst = __sk_dst_get(sk);
+
+	if (dst && dst->dev && dst->dev->tcp_rmem_max)
+		return dst->dev->tcp_rmem_max;
+	return sysctl_tcp_rmem[2];
+}
+
 static inline int tcp_win_from_space(int space)
 {
 	return sysctl_tcp_adv_win_scale<=0 ?
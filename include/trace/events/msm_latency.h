@@ -0,0 +1,78 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM msm_latency
+
+#if !defined(_TRACE_MSM_LATENCY_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MSM_LATENCY_H
+
+#include <linux/tracepoint.h>
+
+#define show_msm_latency_subsys(subsys)				\
+	__print_symbolic(subsys,					\
+			 { 0, "smd" },					\
+			 { 1, "rpc" },					\
+			 { 2, "sdcc" },					\
+			 { 3, "nand" },					\
+			 { 4, "fb" },					\
+			 { 5, "kgsl" })
+
+/**
+ * msm_req_start - an MSM driver starts a request
+ * @subsys: enum msm_latency_subsys
+ * @id: identifies the request until msm_req_done, e.g. its address
+ */
+TRACE_EVENT(msm_req_start,
+
+	TP_PROTO(int subsys, unsigned long id),
+
+	TP_ARGS(subsys, id),
+
+	TP_STRUCT__entry(
+		__field(	int,		subsys		)
+		__field(	unsigned long,	id		)
+	),
+
+	TP_fast_assign(
+		__entry->subsys = subsys;
+		__entry->id = id;
+	),
+
+	TP_printk("%s id=%lx", show_msm_latency_subsys(__entry->subsys),
+		  __entry->id)
+);
+
+/**
+ * msm_req_done - the request is complete
+ * @subsys: enum msm_latency_subsys
+ * @id: as passed to msm_req_start
+ * @ns: time since msm_req_start
+ * @result: 0 or a negative errno
+ */
+TRACE_EVENT(msm_req_done,
+
+	TP_PROTO(int subsys, unsigned long id, u64 ns, int result),
+
+	TP_ARGS(subsys, id, ns, result),
+
+	TP_STRUCT__entry(
+		__field(	int,		subsys		)
+		__field(	unsigned long,	id		)
+		__field(	u64,		ns		)
+		__field(	int,		result		)
+	),
+
+	TP_fast_assign(
+		__entry->subsys = subsys;
+		__entry->id = id;
+		__entry->ns = ns;
+		__entry->result = result;
+	),
+
+	TP_printk("%s id=%lx ns=%llu result=%d",
+		  show_msm_latency_subsys(__entry->subsys), __entry->id,
+		  (unsigned long long)__entry->ns, __entry->result)
+);
+
+#endif /* _TRACE_MSM_LATENCY_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
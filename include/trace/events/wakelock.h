@@ -0,0 +1,85 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM wakelock
+
+#if !defined(_TRACE_WAKELOCK_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_WAKELOCK_H
+
+#include <linux/tracepoint.h>
+#include <linux/wakelock.h>
+
+/**
+ * wake_lock - called when a wake lock is taken
+ * @lock: the wake lock
+ * @timeout: timeout in jiffies, 0 for a lock without timeout
+ */
+TRACE_EVENT(wake_lock,
+
+	TP_PROTO(struct wake_lock *lock, long timeout),
+
+	TP_ARGS(lock, timeout),
+
+	TP_STRUCT__entry(
+		__string(	name,		lock->name	)
+		__field(	long,		timeout		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, lock->name);
+		__entry->timeout = timeout;
+	),
+
+	TP_printk("name=%s timeout=%ld", __get_str(name), __entry->timeout)
+);
+
+/**
+ * wake_unlock - called when a wake lock is released or expires
+ * @lock: the wake lock
+ * @expired: the timeout ran out rather than wake_unlock() being called
+ */
+TRACE_EVENT(wake_unlock,
+
+	TP_PROTO(struct wake_lock *lock, int expired),
+
+	TP_ARGS(lock, expired),
+
+	TP_STRUCT__entry(
+		__string(	name,		lock->name	)
+		__field(	int,		expired		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, lock->name);
+		__entry->expired = expired;
+	),
+
+	TP_printk("name=%s expired=%d", __get_str(name), __entry->expired)
+);
+
+/**
+ * suspend_blocked - called when a suspend attempt is given up
+ * @name: the first active suspend wake lock, the one that blocked it
+ * @active: number of active suspend wake locks
+ */
+TRACE_EVENT(suspend_blocked,
+
+	TP_PROTO(const char *name, int active),
+
+	TP_ARGS(name, active),
+
+	TP_STRUCT__entry(
+		__string(	name,		name		)
+		__field(	int,		active		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->active = active;
+	),
+
+	TP_printk("name=%s active=%d", __get_str(name), __entry->active)
+);
+
+#endif /* _TRACE_WAKELOCK_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
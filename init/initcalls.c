@@ -0,0 +1,396 @@
+/*
+ *  linux/init/initcalls.c
+ *
+ *  Parallel and deferred initcalls, and a report of where the time
+ *  spent in initcalls went.
+ *
+ *  Parallel initcalls are handed to CONFIG_PARALLEL_INITCALL_THREADS
+ *  kernel threads as soon as every device_initcall() has returned.
+ *  They are meant for drivers that mostly sleep in their init, waiting
+ *  for modem RPC replies or slow devices, so they can wait side by
+ *  side. A parallel initcall may name another one it has to run after.
+ *  The first late_initcall() waits for all of them.
+ *
+ *  Deferred initcalls run once userspace is up, the first time
+ *  /proc/deferred_initcalls is read or CONFIG_DEFERRED_INITCALL_TIMEOUT
+ *  seconds after boot, whichever comes first. Init memory is only
+ *  freed after they have run.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/debugfs.h>
+
+extern struct parallel_initcall __parallel_initcall_start[];
+extern struct parallel_initcall __parallel_initcall_end[];
+extern initcall_t __deferred_initcall_start[], __deferred_initcall_end[];
+extern void free_initmem(void);
+
+#define INITCALL_SLOWEST	16
+
+struct initcall_time {
+	initcall_t fn;
+	unsigned int usecs;
+	char kind;
+};
+
+/* Per kind totals: sequential, parallel and deferred */
+static const char initcall_kinds[] = "spd";
+static unsigned int initcall_count[3];
+static u64 initcall_usecs[3];
+
+static struct initcall_time initcall_slowest[INITCALL_SLOWEST];
+static DEFINE_SPINLOCK(initcall_time_lock);
+
+static void initcall_account(initcall_t fn, char kind, unsigned int usecs)
+{
+	const char *k = strchr(initcall_kinds, kind);
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&initcall_time_lock, flags);
+	if (k) {
+		initcall_count[k - initcall_kinds]++;
+		initcall_usecs[k - initcall_kinds] += usecs;
+	}
+
+	/* Keep the slowest ones sorted, longest first */
+	for (i = INITCALL_SLOWEST - 1; i >= 0; i--) {
+		if (initcall_slowest[i].fn && initcall_slowest[i].usecs >= usecs)
+			break;
+		if (i + 1 < INITCALL_SLOWEST)
+			initcall_slowest[i + 1] = initcall_slowest[i];
+	}
+	if (i + 1 < INITCALL_SLOWEST) {
+		initcall_slowest[i + 1].fn = fn;
+		initcall_slowest[i + 1].usecs = usecs;
+		initcall_slowest[i + 1].kind = kind;
+	}
+	spin_unlock_irqrestore(&initcall_time_lock, flags);
+}
+
+int do_timed_initcall(initcall_t fn, char kind)
+{
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = do_one_initcall(fn);
+	initcall_account(fn, kind,
+			 ktime_to_us(ktime_sub(ktime_get(), start)));
+	return ret;
+}
+
+/* Parallel initcalls */
+
+enum {
+	PINIT_PENDING,
+	PINIT_RUNNING,
+	PINIT_DONE,
+};
+
+struct parallel_initcall_state {
+	/* Copied, the table is in init memory */
+	struct parallel_initcall call;
+	int state;
+	int thread;
+	/* Relative to the start of the parallel phase */
+	unsigned int start_us;
+	unsigned int end_us;
+};
+
+static struct parallel_initcall_state *pinit_state;
+static int pinit_count, pinit_done, pinit_running, pinit_threads;
+static unsigned int pinit_wall_us;
+static ktime_t pinit_start;
+static DEFINE_SPINLOCK(pinit_lock);
+static DECLARE_WAIT_QUEUE_HEAD(pinit_wait);
+
+static struct parallel_initcall *pinit_call(int i)
+{
+	return &pinit_state[i].call;
+}
+
+/* A dependency on an initcall that is not parallel is always met */
+static int pinit_dep_done(const char *after)
+{
+	int i;
+
+	if (!after)
+		return 1;
+	for (i = 0; i < pinit_count; i++)
+		if (!strcmp(pinit_call(i)->name, after) &&
+		    pinit_state[i].state != PINIT_DONE)
+			return 0;
+	return 1;
+}
+
+/*
+ * Pick the next pending initcall whose dependency has run. Returns -1
+ * when there is nothing left to start and -EAGAIN when the caller has
+ * to wait for a running one. Called with pinit_lock held.
+ */
+static int pinit_next(void)
+{
+	int i, pending = -1;
+
+	for (i = 0; i < pinit_count; i++) {
+		if (pinit_state[i].state != PINIT_PENDING)
+			continue;
+		if (pending < 0)
+			pending = i;
+		if (pinit_dep_done(pinit_call(i)->after))
+			return i;
+	}
+	if (pending < 0)
+		return -1;
+	if (pinit_running)
+		return -EAGAIN;
+
+	/* Nothing runs and nothing can: a dependency loop */
+	printk(KERN_WARNING "parallel initcall %s: dependency %s never "
+	       "completes, running it anyway\n", pinit_call(pending)->name,
+	       pinit_call(pending)->after);
+	return pending;
+}
+
+static int __init parallel_initcall_thread(void *data)
+{
+	int thread = (long)data;
+	int i;
+
+	for (;;) {
+		spin_lock(&pinit_lock);
+		while ((i = pinit_next()) == -EAGAIN) {
+			int done = pinit_done;
+
+			spin_unlock(&pinit_lock);
+			wait_event(pinit_wait, pinit_done != done);
+			spin_lock(&pinit_lock);
+		}
+		if (i < 0) {
+			spin_unlock(&pinit_lock);
+			break;
+		}
+		pinit_state[i].state = PINIT_RUNNING;
+		pinit_state[i].thread = thread;
+		pinit_state[i].start_us =
+			ktime_to_us(ktime_sub(ktime_get(), pinit_start));
+		pinit_running++;
+		spin_unlock(&pinit_lock);
+
+		do_timed_initcall(pinit_call(i)->fn, 'p');
+
+		spin_lock(&pinit_lock);
+		pinit_state[i].end_us =
+			ktime_to_us(ktime_sub(ktime_get(), pinit_start));
+		pinit_state[i].state = PINIT_DONE;
+		pinit_running--;
+		pinit_done++;
+		spin_unlock(&pinit_lock);
+		wake_up_all(&pinit_wait);
+	}
+	return 0;
+}
+
+static int __init parallel_initcalls_start(void)
+{
+	int i;
+
+	pinit_count = __parallel_initcall_end - __parallel_initcall_start;
+	if (!pinit_count)
+		return 0;
+
+	pinit_state = kcalloc(pinit_count, sizeof(*pinit_state), GFP_KERNEL);
+	if (!pinit_state) {
+		/* Still run them, one after the other */
+		for (i = 0; i < pinit_count; i++)
+			do_timed_initcall(__parallel_initcall_start[i].fn, 's');
+		pinit_count = 0;
+		return -ENOMEM;
+	}
+	for (i = 0; i < pinit_count; i++)
+		pinit_state[i].call = __parallel_initcall_start[i];
+
+	pinit_start = ktime_get();
+	for (i = 0; i < CONFIG_PARALLEL_INITCALL_THREADS &&
+		    i < pinit_count; i++) {
+		struct task_struct *t;
+
+		t = kthread_run(parallel_initcall_thread, (void *)(long)i,
+				"pinitcall/%d", i);
+		if (IS_ERR(t))
+			break;
+	}
+	pinit_threads = i;
+	return 0;
+}
+/* After every device initcall, the first of the sync level */
+device_initcall_sync(parallel_initcalls_start);
+
+static int __init parallel_initcalls_wait(void)
+{
+	if (!pinit_count)
+		return 0;
+
+	/* Help out, this also covers threads that failed to start */
+	parallel_initcall_thread((void *)(long)pinit_threads);
+	wait_event(pinit_wait, pinit_done == pinit_count);
+	pinit_wall_us = ktime_to_us(ktime_sub(ktime_get(), pinit_start));
+	return 0;
+}
+/* Before any late initcall */
+late_initcall(parallel_initcalls_wait);
+
+/* Deferred initcalls */
+
+static DEFINE_MUTEX(deferred_lock);
+static int deferred_done;
+static unsigned long deferred_at;
+
+int initcalls_deferred(void)
+{
+	return __deferred_initcall_end - __deferred_initcall_start > 0;
+}
+
+/* Runs from process context after boot, while init memory is kept */
+static void __ref run_deferred_initcalls(void)
+{
+	initcall_t *fn;
+
+	mutex_lock(&deferred_lock);
+	if (!deferred_done) {
+		deferred_at = jiffies;
+		for (fn = __deferred_initcall_start;
+		     fn < __deferred_initcall_end; fn++)
+			do_timed_initcall(*fn, 'd');
+		deferred_done = 1;
+		if (initcalls_deferred())
+			free_initmem();
+	}
+	mutex_unlock(&deferred_lock);
+}
+
+static void deferred_initcall_timeout(struct work_struct *work)
+{
+	run_deferred_initcalls();
+}
+static DECLARE_DELAYED_WORK(deferred_initcall_work, deferred_initcall_timeout);
+
+static int deferred_initcalls_show(struct seq_file *m, void *v)
+{
+	run_deferred_initcalls();
+	seq_printf(m, "%u\n", initcall_count[2]);
+	return 0;
+}
+
+static int deferred_initcalls_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, deferred_initcalls_show, NULL);
+}
+
+static const struct file_operations deferred_initcalls_fops = {
+	.open		= deferred_initcalls_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* Report */
+
+static void initcall_report_path(struct seq_file *m, int i, int depth)
+{
+	const char *after = pinit_call(i)->after;
+	int j, dep = -1;
+
+	/* The dependency that finished last held this one up */
+	for (j = 0; after && j < pinit_count; j++)
+		if (!strcmp(pinit_call(j)->name, after) &&
+		    (dep < 0 || pinit_state[j].end_us > pinit_state[dep].end_us))
+			dep = j;
+	if (dep >= 0 && depth < pinit_count)
+		initcall_report_path(m, dep, depth + 1);
+
+	seq_printf(m, "  %6u %6u ms  thread %d  %s\n",
+		   pinit_state[i].start_us / 1000, pinit_state[i].end_us / 1000,
+		   pinit_state[i].thread, pinit_call(i)->name);
+}
+
+static int initcall_report_show(struct seq_file *m, void *v)
+{
+	int i, last = -1;
+
+	seq_printf(m, "sequential: %u calls, %llu ms\n", initcall_count[0],
+		   div_u64(initcall_usecs[0], 1000));
+	seq_printf(m, "parallel:   %u calls on %d threads, %llu ms of work "
+		   "in %u ms\n", initcall_count[1], pinit_threads + 1,
+		   div_u64(initcall_usecs[1], 1000), pinit_wall_us / 1000);
+	if (deferred_done)
+		seq_printf(m, "deferred:   %u calls, %llu ms, %u s after "
+			   "boot\n", initcall_count[2],
+			   div_u64(initcall_usecs[2], 1000),
+			   jiffies_to_msecs(deferred_at - INITIAL_JIFFIES) /
+			   1000);
+	else
+		seq_printf(m, "deferred:   %d calls not run yet\n",
+			   (int)(__deferred_initcall_end -
+				 __deferred_initcall_start));
+
+	/* The boot waits for the parallel initcall that ends last */
+	for (i = 0; i < pinit_count; i++)
+		if (last < 0 || pinit_state[i].end_us > pinit_state[last].end_us)
+			last = i;
+	if (last >= 0) {
+		seq_printf(m, "\ncritical path of the parallel phase:\n"
+			   "   start    end\n");
+		initcall_report_path(m, last, 0);
+	}
+
+	seq_printf(m, "\nslowest:\n");
+	for (i = 0; i < INITCALL_SLOWEST && initcall_slowest[i].fn; i++)
+		seq_printf(m, "  %c %8u us  %pF\n", initcall_slowest[i].kind,
+			   initcall_slowest[i].usecs, initcall_slowest[i].fn);
+	return 0;
+}
+
+static int initcall_report_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, initcall_report_show, NULL);
+}
+
+static const struct file_operations initcall_report_fops = {
+	.open		= initcall_report_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init initcalls_report_init(void)
+{
+	debugfs_create_file("initcalls", S_IRUGO, NULL, NULL,
+			    &initcall_report_fops);
+
+	if (initcalls_deferred()) {
+		proc_create("deferred_initcalls", S_IRUSR, NULL,
+			    &deferred_initcalls_fops);
+		schedule_delayed_work(&deferred_initcall_work,
+				      CONFIG_DEFERRED_INITCALL_TIMEOUT * HZ);
+	}
+	return 0;
+}
+late_initcall(initcalls_report_init);
@@ -8,6 +8,7 @@
 #include <linux/dirent.h>
 #include <linux/syscalls.h>
 #include <linux/utime.h>
+#include <linux/async.h>
 
 static __initdata char *message;
 static void __init error(char *x)
@@ -483,6 +484,33 @@ static int __init retain_initrd_param(char *str)
 }
 __setup("retain_initrd", retain_initrd_param);
 
+/*
+ * Unpacking runs on an async thread while the device initcalls go on.
+ * Whatever needs the files has to call wait_for_initramfs() first.
+ */
+static int __initdata initramfs_async = 1;
+
+static int __init initramfs_async_param(char *str)
+{
+	initramfs_async = simple_strtoul(str, NULL, 0) != 0;
+	return 1;
+}
+__setup("initramfs_async=", initramfs_async_param);
+
+/* A domain of its own, async work waiting on it must not wait on itself */
+static LIST_HEAD(initramfs_domain);
+static async_cookie_t initramfs_cookie;
+static int initramfs_pending;
+
+void wait_for_initramfs(void)
+{
+	if (!initramfs_pending)
+		return;
+	async_synchronize_cookie_domain(initramfs_cookie + 1,
+					&initramfs_domain);
+	initramfs_pending = 0;
+}
+
 extern char __initramfs_start[], __initramfs_end[];
 #include <linux/initrd.h>
 #include <linux/kexec.h>
@@ -568,7 +596,7 @@ static void __init clean_rootfs(void)
 }
 #endif
 
-static int __init populate_rootfs(void)
+static void __init do_populate_rootfs(void *unused, async_cookie_t cookie)
 {
 	char *err = unpack_to_rootfs(__initramfs_start,
 			 __initramfs_end - __initramfs_start);
@@ -582,7 +610,7 @@ static int __init populate_rootfs(void)
 			initrd_end - initrd_start);
 		if (!err) {
 			free_initrd();
-			return 0;
+			return;
 		} else {
 			clean_rootfs();
 			unpack_to_rootfs(__initramfs_start,
@@ -606,6 +634,17 @@ static int __init populate_rootfs(void)
 		free_initrd();
 #endif
 	}
+}
+
+static int __init populate_rootfs(void)
+{
+	if (!initramfs_async) {
+		do_populate_rootfs(NULL, 0);
+		return 0;
+	}
+	initramfs_pending = 1;
+	initramfs_cookie = async_schedule_domain(do_populate_rootfs, NULL,
+						 &initramfs_domain);
 	return 0;
 }
 rootfs_initcall(populate_rootfs);
@@ -724,12 +724,12 @@ static void __init do_ctors(void)
 int initcall_debug;
 core_param(initcall_debug, initcall_debug, bool, 0644);
 
-static char msgbuf[64];
-static struct boot_trace_call call;
-static struct boot_trace_ret ret;
-
 int do_one_initcall(initcall_t fn)
 {
+	/* Parallel initcalls get here from several threads at once */
+	char msgbuf[64];
+	struct boot_trace_call call;
+	struct boot_trace_ret ret;
 	int count = preempt_count();
 	ktime_t calltime, delta, rettime;
 
@@ -781,7 +781,7 @@ static void __init do_initcalls(void)
 	initcall_t *fn;
 
 	for (fn = __early_initcall_end; fn < __initcall_end; fn++)
-		do_one_initcall(*fn);
+		do_timed_initcall(*fn, 's');
 
 	/* Make sure there is no pending stuff from the initcall sequence */
 	flush_scheduled_work();
@@ -828,7 +828,9 @@ static noinline int init_post(void)
 {
 	/* need to finish all async __init code before freeing the memory */
 	async_synchronize_full();
-	free_initmem();
+	/* Deferred initcalls are still in init memory, they free it */
+	if (!initcalls_deferred())
+		free_initmem();
 	unlock_kernel();
 	mark_rodata_ro();
 	system_state = SYSTEM_RUNNING;
@@ -901,6 +903,9 @@ static int __init kernel_init(void * unused)
 
 	do_basic_setup();
 
+	/* The first file on the rootfs we touch, it has to be unpacked */
+	wait_for_initramfs();
+
 	/* Open the /dev/console on the rootfs, this should never fail */
 	if (sys_open((const char __user *) "/dev/console", O_RDWR, 0) < 0)
 		printk(KERN_WARNING "Warning: unable to open an initial console.\n");
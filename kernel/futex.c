@@ -59,6 +59,9 @@
 #include <linux/magic.h>
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/futex.h>
 
@@ -66,6 +69,7 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
+/* Hash buckets per possible cpu */
 #define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
 
 /*
@@ -127,12 +131,52 @@ struct futex_q {
  * location.  Each key may have multiple futex_q structures, one for each task
  * waiting on a futex.
  */
+#ifdef CONFIG_FUTEX_STATS
+/*
+ * Contention seen by one hash bucket, updated under its lock. With the
+ * table scaled to the cpus most buckets see a single futex, which
+ * last_uaddr and last_tgid name.
+ */
+struct futex_stats {
+	unsigned long waits;		/* sleeps in FUTEX_WAIT* */
+	unsigned long pi_waits;		/* sleeps in FUTEX_LOCK_PI */
+	unsigned long wakes;		/* waiters woken */
+	unsigned long requeues;		/* waiters requeued to this bucket */
+	unsigned long collisions;	/* other futexes walked past on wake */
+	unsigned long last_uaddr;
+	pid_t last_tgid;
+};
+#endif
+
 struct futex_hash_bucket {
 	spinlock_t lock;
 	struct plist_head chain;
+#ifdef CONFIG_FUTEX_STATS
+	struct futex_stats stats;
+#endif
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/* Sized in futex_init() */
+static unsigned long futex_hashsize __read_mostly;
+static struct futex_hash_bucket *futex_queues __read_mostly;
+
+#ifdef CONFIG_FUTEX_STATS
+#define futex_stat_inc(hb, field)	((hb)->stats.field++)
+
+static inline void futex_stat_sleep(struct futex_hash_bucket *hb,
+				    u32 __user *uaddr, int pi)
+{
+	if (pi)
+		hb->stats.pi_waits++;
+	else
+		hb->stats.waits++;
+	hb->stats.last_uaddr = (unsigned long)uaddr;
+	hb->stats.last_tgid = current->tgid;
+}
+#else
+#define futex_stat_inc(hb, field)	do { } while (0)
+#define futex_stat_sleep(hb, uaddr, pi)	do { } while (0)
+#endif
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
@@ -142,7 +186,7 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
 /*
@@ -932,8 +976,11 @@ static int futex_wake(u32 __user *uaddr, int fshared, int nr_wake, u32 bitset)
 				continue;
 
 			wake_futex(this);
+			futex_stat_inc(hb, wakes);
 			if (++ret >= nr_wake)
 				break;
+		} else {
+			futex_stat_inc(hb, collisions);
 		}
 	}
 
@@ -1381,6 +1428,7 @@ retry_private:
 			}
 		}
 		requeue_futex(this, hb1, hb2, &key2);
+		futex_stat_inc(hb2, requeues);
 		drop_count++;
 	}
 
@@ -1865,6 +1913,8 @@ retry:
 	if (ret)
 		goto out;
 
+	futex_stat_sleep(hb, uaddr, 0);
+
 	/* queue_me and wait for wakeup, timeout, or a signal. */
 	futex_wait_queue_me(hb, &q, to);
 
@@ -1997,6 +2047,7 @@ retry_private:
 	/*
 	 * Only actually queue now that the atomic ops are done:
 	 */
+	futex_stat_sleep(hb, uaddr, 1);
 	queue_me(&q, hb);
 
 	WARN_ON(!q.pi_state);
@@ -2296,6 +2347,8 @@ static int futex_wait_requeue_pi(u32 __user *uaddr, int fshared,
 		goto out_put_keys;
 	}
 
+	futex_stat_sleep(hb, uaddr, 0);
+
 	/* Queue the futex_q, drop the hb lock, wait for wakeup. */
 	futex_wait_queue_me(hb, &q, to);
 
@@ -2690,10 +2743,43 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 	return do_futex(uaddr, op, val, tp, uaddr2, val2, val3);
 }
 
+#ifdef CONFIG_FUTEX_STATS
+static int futex_stats_show(struct seq_file *s, void *unused)
+{
+	struct futex_stats *st;
+	unsigned long i;
+
+	seq_printf(s, "bucket   waits    pi_waits wakes    requeues "
+		   "collisions last_uaddr tgid\n");
+	for (i = 0; i < futex_hashsize; i++) {
+		st = &futex_queues[i].stats;
+		if (!st->waits && !st->pi_waits && !st->requeues)
+			continue;
+		seq_printf(s, "%-8lu %-8lu %-8lu %-8lu %-8lu %-10lu %08lx %d\n",
+			   i, st->waits, st->pi_waits, st->wakes,
+			   st->requeues, st->collisions, st->last_uaddr,
+			   st->last_tgid);
+	}
+	return 0;
+}
+
+static int futex_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, futex_stats_show, NULL);
+}
+
+static const struct file_operations futex_stats_fops = {
+	.open		= futex_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 static int __init futex_init(void)
 {
 	u32 curval;
-	int i;
+	unsigned long i;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2709,11 +2795,28 @@ static int __init futex_init(void)
 	if (curval == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
+	/*
+	 * Dalvik monitors put many futexes in play at once; keep the chains
+	 * short as the number of threads grows with the cpus.
+	 */
+	futex_hashsize = roundup_pow_of_two((1UL << FUTEX_HASHBITS) *
+					    num_possible_cpus());
+	futex_queues = kcalloc(futex_hashsize, sizeof(*futex_queues),
+			       GFP_KERNEL);
+	if (!futex_queues)
+		panic("futex: cannot allocate %lu hash buckets\n",
+		      futex_hashsize);
+
+	for (i = 0; i < futex_hashsize; i++) {
 		plist_head_init(&futex_queues[i].chain, &futex_queues[i].lock);
 		spin_lock_init(&futex_queues[i].lock);
 	}
 
+#ifdef CONFIG_FUTEX_STATS
+	debugfs_create_file("futex_stats", 0400, NULL, NULL,
+			    &futex_stats_fops);
+#endif
+
 	return 0;
 }
 __initcall(futex_init);
@@ -32,6 +32,7 @@
 #include <linux/mount.h>
 #include <linux/kernel.h>
 #include <linux/init.h>
+#include <linux/initrd.h>
 #include <linux/resource.h>
 #include <linux/notifier.h>
 #include <linux/suspend.h>
@@ -399,6 +400,9 @@ int call_usermodehelper_exec(struct subprocess_info *sub_info,
 		goto out;
 	}
 
+	/* Helpers during boot may live in the initramfs */
+	wait_for_initramfs();
+
 	sub_info->complete = &done;
 	sub_info->wait = wait;
 
@@ -40,6 +40,8 @@
 #include <linux/string.h>
 #include <linux/platform_device.h>
 #include <linux/init.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/uaccess.h>
 
@@ -56,6 +58,10 @@ struct pm_qos_request_list {
 		s32 kbps;
 	};
 	int pm_qos_class;
+	/* who asked: the caller of pm_qos_add_request(), or the task that
+	 * opened the misc device */
+	void *owner;
+	char comm[TASK_COMM_LEN];
 };
 
 static s32 max_compare(s32 v1, s32 v2);
@@ -223,7 +229,8 @@ EXPORT_SYMBOL_GPL(pm_qos_request);
  * element as a handle for use in updating and removal.  Call needs to save
  * this handle for later use.
  */
-struct pm_qos_request_list *pm_qos_add_request(int pm_qos_class, s32 value)
+static struct pm_qos_request_list *__pm_qos_add_request(int pm_qos_class,
+		s32 value, void *owner, const char *comm)
 {
 	struct pm_qos_request_list *dep;
 	unsigned long flags;
@@ -235,6 +242,9 @@ struct pm_qos_request_list *pm_qos_add_request(int pm_qos_class, s32 value)
 		else
 			dep->value = value;
 		dep->pm_qos_class = pm_qos_class;
+		dep->owner = owner;
+		if (comm)
+			strlcpy(dep->comm, comm, sizeof(dep->comm));
 
 		spin_lock_irqsave(&pm_qos_lock, flags);
 		list_add(&dep->list,
@@ -245,6 +255,12 @@ struct pm_qos_request_list *pm_qos_add_request(int pm_qos_class, s32 value)
 
 	return dep;
 }
+
+struct pm_qos_request_list *pm_qos_add_request(int pm_qos_class, s32 value)
+{
+	return __pm_qos_add_request(pm_qos_class, value,
+				    __builtin_return_address(0), NULL);
+}
 EXPORT_SYMBOL_GPL(pm_qos_add_request);
 
 /**
@@ -352,8 +368,9 @@ static int pm_qos_power_open(struct inode *inode, struct file *filp)
 
 	pm_qos_class = find_pm_qos_object_by_minor(iminor(inode));
 	if (pm_qos_class >= 0) {
-		filp->private_data = (void *) pm_qos_add_request(pm_qos_class,
-				PM_QOS_DEFAULT_VALUE);
+		filp->private_data = (void *) __pm_qos_add_request(
+				pm_qos_class, PM_QOS_DEFAULT_VALUE,
+				NULL, current->comm);
 
 		if (filp->private_data)
 			return 0;
@@ -400,10 +417,67 @@ static ssize_t pm_qos_power_write(struct file *filp, const char __user *buf,
 }
 
 
+#ifdef CONFIG_DEBUG_FS
+static int pm_qos_debug_show(struct seq_file *m, void *unused)
+{
+	struct pm_qos_object *o = m->private;
+	struct pm_qos_request_list *node;
+	unsigned long flags;
+	s32 target;
+
+	spin_lock_irqsave(&pm_qos_lock, flags);
+	target = atomic_read(&o->target_value);
+	seq_printf(m, "target %d, default %d\n", target, o->default_value);
+	list_for_each_entry(node, &o->requests.list, list) {
+		seq_printf(m, "%c %11d  ", node->value == target ? '*' : ' ',
+			   node->value);
+		if (node->owner)
+			seq_printf(m, "%pS\n", node->owner);
+		else
+			seq_printf(m, "%s (misc device)\n", node->comm);
+	}
+	spin_unlock_irqrestore(&pm_qos_lock, flags);
+	return 0;
+}
+
+static int pm_qos_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pm_qos_debug_show, inode->i_private);
+}
+
+static const struct file_operations pm_qos_debug_fops = {
+	.open		= pm_qos_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * debugfs/pm_qos/<class>: the aggregated target and every request that
+ * feeds it, with the ones setting the target marked '*'.
+ */
+static void __init pm_qos_debug_init(void)
+{
+	struct dentry *dir;
+	int i;
+
+	dir = debugfs_create_dir("pm_qos", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+	for (i = 1; i < PM_QOS_NUM_CLASSES; i++)
+		debugfs_create_file(pm_qos_array[i]->name, S_IRUGO, dir,
+				    pm_qos_array[i], &pm_qos_debug_fops);
+}
+#else
+static inline void pm_qos_debug_init(void) { }
+#endif
+
 static int __init pm_qos_power_init(void)
 {
 	int ret = 0;
 
+	pm_qos_debug_init();
+
 	ret = register_pm_qos_misc(&cpu_dma_pm_qos);
 	if (ret < 0) {
 		printk(KERN_ERR "pm_qos_param: cpu_dma_latency setup failed\n");
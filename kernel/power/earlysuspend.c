@@ -13,10 +13,13 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
@@ -62,6 +65,18 @@ enum {
 };
 static int state;
 
+#ifdef CONFIG_EARLYSUSPEND_PARALLEL
+static int parallel = 1;
+module_param_named(parallel, parallel, int, S_IRUGO | S_IWUSR | S_IWGRP);
+static LIST_HEAD(early_suspend_domain);
+#endif
+
+/* Duration of the last early suspend and late resume, in usecs */
+static s64 early_suspend_time;
+static s64 late_resume_time;
+/* Time from late resume start until the display handlers were done */
+static s64 late_resume_display_time;
+
 #ifdef CONFIG_SPEEDUP_KEYRESUME
 	struct sched_param earlysuspend_s = { .sched_priority = 66 };
 	struct sched_param earlysuspend_v = { .sched_priority = 0 };
@@ -97,10 +112,83 @@ EXPORT_SYMBOL(unregister_early_suspend);
 
 extern void zte_update_lateresume_2_earlysuspend_time(bool resume_or_earlysuspend);	//LHX_PM_20110411_01 resume_or_earlysuspend? lateresume : earlysuspend
 
+static void early_suspend_call(struct early_suspend *pos, bool resume)
+{
+	ktime_t calltime = ktime_get();
+
+	if (debug_mask & DEBUG_SUSPEND)
+		pr_info("%s: handlers level=%d\n",
+			resume ? "late_resume" : "early_suspend", pos->level);
+	if (resume) {
+		pos->resume(pos);
+		pos->resume_time = ktime_us_delta(ktime_get(), calltime);
+	} else {
+		pos->suspend(pos);
+		pos->suspend_time = ktime_us_delta(ktime_get(), calltime);
+	}
+}
+
+#ifdef CONFIG_EARLYSUSPEND_PARALLEL
+static void early_suspend_async(void *data, async_cookie_t cookie)
+{
+	early_suspend_call(data, false);
+}
+
+static void late_resume_async(void *data, async_cookie_t cookie)
+{
+	early_suspend_call(data, true);
+}
+#endif
+
+static struct early_suspend *early_suspend_next(struct early_suspend *pos,
+						bool resume)
+{
+	return list_entry(resume ? pos->link.prev : pos->link.next,
+			  struct early_suspend, link);
+}
+
+/*
+ * Call the suspend (or resume) handlers of the level of 'first', which
+ * are next to each other in the list, and return the first handler of the
+ * next level. When several handlers share the level, all but the last one
+ * are handed to the async threads, the last one runs here, and the level is
+ * only left once they are all done. Caller holds early_suspend_lock.
+ */
+static struct early_suspend *early_suspend_call_level(
+	struct early_suspend *first, bool resume)
+{
+	struct early_suspend *pos, *last = NULL;
+	int level = first->level;
+
+	for (pos = first; &pos->link != &early_suspend_handlers &&
+	     pos->level == level; pos = early_suspend_next(pos, resume)) {
+		if (!(resume ? pos->resume : pos->suspend))
+			continue;
+		if (last) {
+#ifdef CONFIG_EARLYSUSPEND_PARALLEL
+			if (parallel)
+				async_schedule_domain(resume ?
+					late_resume_async : early_suspend_async,
+					last, &early_suspend_domain);
+			else
+#endif
+				early_suspend_call(last, resume);
+		}
+		last = pos;
+	}
+	if (last)
+		early_suspend_call(last, resume);
+#ifdef CONFIG_EARLYSUSPEND_PARALLEL
+	async_synchronize_full_domain(&early_suspend_domain);
+#endif
+	return pos;
+}
+
 static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
+	ktime_t starttime;
 	int abort = 0;
 
 	mutex_lock(&early_suspend_lock);
@@ -120,21 +208,20 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
-	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL)
+	starttime = ktime_get();
+	pos = list_first_entry(&early_suspend_handlers, struct early_suspend,
+			       link);
+	while (&pos->link != &early_suspend_handlers) {
+		#ifdef FEATURE_ZTE_EARLYSUSPEND_DEBUG
+		if(debug_earlysuspend_level <= pos->level)
 		{
-			#ifdef FEATURE_ZTE_EARLYSUSPEND_DEBUG
-			if(debug_earlysuspend_level <= pos->level)
-			{
-				pr_info("NO early_suspend: handlers level = %d \n",pos->level);
-				break;
-			}
-			#endif
-			if (debug_mask & DEBUG_SUSPEND)
-                        	pr_info("early_suspend: handlers level=%d\n", pos->level);
-			pos->suspend(pos);
+			pr_info("NO early_suspend: handlers level = %d \n",pos->level);
+			break;
 		}
+		#endif
+		pos = early_suspend_call_level(pos, false);
 	}
+	early_suspend_time = ktime_us_delta(ktime_get(), starttime);
 	mutex_unlock(&early_suspend_lock);
 
 	if (debug_mask & DEBUG_SUSPEND)
@@ -158,10 +245,23 @@ abort:
 	spin_unlock_irqrestore(&state_lock, irqflags);
 }
 
+static void late_resume_restore_prio(void)
+{
+#ifdef CONFIG_SPEEDUP_KEYRESUME
+	if (!(unlikely(earlysuspend_old_policy == SCHED_FIFO) || unlikely(earlysuspend_old_policy == SCHED_RR))) {
+		earlysuspend_v.sched_priority = earlysuspend_old_prio;
+		if ((sched_setscheduler(current, earlysuspend_old_policy, &earlysuspend_v)) < 0)
+			printk(KERN_ERR "late_resume: down late_resume failed\n");
+	}
+#endif
+}
+
 static void late_resume(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
+	ktime_t starttime;
+	bool display_done = false;
 	int abort = 0;
 
 #ifdef CONFIG_SPEEDUP_KEYRESUME
@@ -177,14 +277,6 @@ static void late_resume(struct work_struct *work)
 
 	mutex_lock(&early_suspend_lock);
 
-#ifdef CONFIG_SPEEDUP_KEYRESUME
-	if (!(unlikely(earlysuspend_old_policy == SCHED_FIFO) || unlikely(earlysuspend_old_policy == SCHED_RR))) {
-		earlysuspend_v.sched_priority = earlysuspend_old_prio;
-		if ((sched_setscheduler(current, earlysuspend_old_policy, &earlysuspend_v)) < 0)
-			printk(KERN_ERR "late_resume: down late_resume failed\n");
-	}
-#endif
-
 	spin_lock_irqsave(&state_lock, irqflags);
 	if (state == SUSPENDED)
 		state &= ~SUSPENDED;
@@ -199,19 +291,33 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
-	{
-		if (pos->resume != NULL)
-		{
-			if (debug_mask & DEBUG_SUSPEND)
-                                pr_info("late_resume: handlers level=%d\n", pos->level);
-			pos->resume(pos);
+	/*
+	 * The display handlers (STOP_DRAWING and up) resume first anyway,
+	 * with SPEEDUP_KEYRESUME they also keep the real-time priority, and
+	 * touch, sensors, WLAN etc. go back to normal priority after them.
+	 */
+	starttime = ktime_get();
+	pos = list_entry(early_suspend_handlers.prev, struct early_suspend,
+			 link);
+	while (&pos->link != &early_suspend_handlers) {
+		if (!display_done &&
+		    pos->level < EARLY_SUSPEND_LEVEL_STOP_DRAWING) {
+			late_resume_restore_prio();
+			late_resume_display_time =
+				ktime_us_delta(ktime_get(), starttime);
+			display_done = true;
 		}
+		pos = early_suspend_call_level(pos, true);
 	}
+	late_resume_time = ktime_us_delta(ktime_get(), starttime);
+	if (!display_done)
+		late_resume_display_time = late_resume_time;
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
 	zte_update_lateresume_2_earlysuspend_time(true);//LHX_PM_20110411_01 update resume time
 abort:
+	if (!display_done)
+		late_resume_restore_prio();
 	mutex_unlock(&early_suspend_lock);
 }
 
@@ -260,3 +366,41 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+static int early_suspend_stats_show(struct seq_file *m, void *unused)
+{
+	struct early_suspend *pos;
+
+	mutex_lock(&early_suspend_lock);
+	seq_printf(m, "early suspend: %lld us\n", early_suspend_time);
+	seq_printf(m, "late resume: %lld us, display done after %lld us\n\n",
+		   late_resume_time, late_resume_display_time);
+	seq_puts(m, "level\tsuspend_us\tresume_us\thandler\n");
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(m, "%d\t%u\t%u\t%pf\n", pos->level,
+			   pos->suspend_time, pos->resume_time,
+			   pos->resume ? (void *)pos->resume :
+			   (void *)pos->suspend);
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_stats_show, NULL);
+}
+
+static const struct file_operations early_suspend_stats_fops = {
+	.open = early_suspend_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init early_suspend_debugfs_init(void)
+{
+	debugfs_create_file("earlysuspend", S_IRUGO, NULL, NULL,
+			    &early_suspend_stats_fops);
+	return 0;
+}
+late_initcall(early_suspend_debugfs_init);
@@ -70,6 +70,14 @@ static ssize_t pm_async_store(struct kobject *kobj, struct kobj_attribute *attr,
 
 power_attr(pm_async);
 
+static ssize_t pm_report_show(struct kobject *kobj, struct kobj_attribute *attr,
+			      char *buf)
+{
+	return dpm_report_show(buf);
+}
+
+static struct kobj_attribute pm_report_attr = __ATTR_RO(pm_report);
+
 #ifdef CONFIG_PM_DEBUG
 int pm_test_level = TEST_NONE;
 
@@ -252,6 +260,7 @@ static struct attribute * g[] = {
 #endif
 #ifdef CONFIG_PM_SLEEP
 	&pm_async_attr.attr,
+	&pm_report_attr.attr,
 #ifdef CONFIG_PM_DEBUG
 	&pm_test_attr.attr,
 #endif
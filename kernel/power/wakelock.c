@@ -30,6 +30,9 @@
 #include <linux/proc_fs.h>
 #endif
 #include "power.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/wakelock.h>
 //20100519 ZTE_WAKELOCK_LYJ_001 
 #include <linux/moduleparam.h>
 
@@ -53,6 +56,12 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+/*
+ * Active wake locks per type, and how many of them have no timeout, so
+ * has_wake_lock() only walks the list when it needs the longest timeout.
+ */
+static int active_count[WAKE_LOCK_TYPE_COUNT];
+static int active_untimed_count[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
@@ -316,6 +325,9 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	lock->stat.total_time = ktime_add(lock->stat.total_time, duration);
 	if (ktime_to_ns(duration) > ktime_to_ns(lock->stat.max_time))
 		lock->stat.max_time = duration;
+#ifdef CONFIG_WAKELOCK_PROFILE
+	wake_lock_hist_add(lock, duration);
+#endif
 	lock->stat.last_time = ktime_get();
 	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
 		duration = ktime_sub(now, last_sleep_time_update);
@@ -350,14 +362,193 @@ static void update_sleep_wait_stats_locked(int done)
 	}
 	last_sleep_time_update = now;
 }
+
+#ifdef CONFIG_WAKELOCK_PROFILE
+/*
+ * Suspend blocker timeline: the last suspend wake lock changes and suspend
+ * attempts, with the lock names copied so they outlive the locks. The same
+ * events go to the wakelock tracepoints when tracing is built in.
+ */
+#define WAKE_LOCK_TIMELINE_SIZE 256
+#define WAKE_LOCK_TIMELINE_NAME_LEN 24
+
+enum {
+	WAKE_LOCK_EV_LOCK,
+	WAKE_LOCK_EV_UNLOCK,
+	WAKE_LOCK_EV_EXPIRE,
+	WAKE_LOCK_EV_BLOCKED,
+	WAKE_LOCK_EV_SUSPEND,
+	WAKE_LOCK_EV_RESUME,
+};
+
+static const char *wake_lock_event_names[] = {
+	[WAKE_LOCK_EV_LOCK] = "lock",
+	[WAKE_LOCK_EV_UNLOCK] = "unlock",
+	[WAKE_LOCK_EV_EXPIRE] = "expire",
+	[WAKE_LOCK_EV_BLOCKED] = "blocked",
+	[WAKE_LOCK_EV_SUSPEND] = "suspend",
+	[WAKE_LOCK_EV_RESUME] = "resume",
+};
+
+static struct wake_lock_timeline_entry {
+	ktime_t time;
+	int event;
+	long arg;
+	char name[WAKE_LOCK_TIMELINE_NAME_LEN];
+} wake_lock_timeline[WAKE_LOCK_TIMELINE_SIZE];
+static unsigned int wake_lock_timeline_next;
+
+/* Caller must acquire the list_lock spinlock */
+static void wake_lock_timeline_add_locked(int event, const char *name,
+					  long arg)
+{
+	struct wake_lock_timeline_entry *e;
+
+	e = &wake_lock_timeline[wake_lock_timeline_next++ %
+				WAKE_LOCK_TIMELINE_SIZE];
+	e->time = ktime_get();
+	e->event = event;
+	e->arg = arg;
+	strlcpy(e->name, name ? name : "", sizeof(e->name));
+}
+
+static void wake_lock_hist_add(struct wake_lock *lock, ktime_t duration)
+{
+	u64 ms = ktime_to_ns(duration);
+	int bucket;
+
+	do_div(ms, NSEC_PER_MSEC);
+	if (ms >= 1U << (WAKE_LOCK_HIST_BUCKETS - 2))
+		bucket = WAKE_LOCK_HIST_BUCKETS - 1;
+	else
+		bucket = fls((u32)ms);
+	lock->stat.hold_hist[bucket]++;
+}
+
+static int wakelock_hist_show(struct seq_file *m, void *unused)
+{
+	unsigned long irqflags;
+	struct wake_lock *lock;
+	int type;
+	int i;
+
+	seq_puts(m, "name");
+	for (i = 0; i < WAKE_LOCK_HIST_BUCKETS - 1; i++)
+		seq_printf(m, "\t<%ums", 1U << i);
+	seq_printf(m, "\t>=%ums\n", 1U << (WAKE_LOCK_HIST_BUCKETS - 2));
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	list_for_each_entry(lock, &inactive_locks, link) {
+		if (!lock->stat.count)
+			continue;
+		seq_printf(m, "\"%s\"", lock->name);
+		for (i = 0; i < WAKE_LOCK_HIST_BUCKETS; i++)
+			seq_printf(m, "\t%u", lock->stat.hold_hist[i]);
+		seq_putc(m, '\n');
+	}
+	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
+		list_for_each_entry(lock, &active_wake_locks[type], link) {
+			if (!lock->stat.count)
+				continue;
+			seq_printf(m, "\"%s\"", lock->name);
+			for (i = 0; i < WAKE_LOCK_HIST_BUCKETS; i++)
+				seq_printf(m, "\t%u", lock->stat.hold_hist[i]);
+			seq_putc(m, '\n');
+		}
+	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
+	return 0;
+}
+
+/*
+ * The suspend wake locks held right now, then the timeline, oldest event
+ * first.
+ */
+static int wakelock_timeline_show(struct seq_file *m, void *unused)
+{
+	unsigned long irqflags;
+	struct wake_lock *lock;
+	unsigned int i, n;
+	ktime_t now = ktime_get();
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	seq_printf(m, "active: %d (%d without timeout)\n",
+		   active_count[WAKE_LOCK_SUSPEND],
+		   active_untimed_count[WAKE_LOCK_SUSPEND]);
+	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link)
+		seq_printf(m, "\"%s\"\theld %lld ms\ttime left %ld\n",
+			   lock->name,
+			   div_s64(ktime_to_ns(ktime_sub(now,
+					lock->stat.last_time)), NSEC_PER_MSEC),
+			   lock->flags & WAKE_LOCK_AUTO_EXPIRE ?
+			   (long)(lock->expires - jiffies) : -1L);
+
+	seq_puts(m, "\ntime\tevent\targ\tname\n");
+	n = min_t(unsigned int, wake_lock_timeline_next,
+		  WAKE_LOCK_TIMELINE_SIZE);
+	for (i = wake_lock_timeline_next - n;
+	     i != wake_lock_timeline_next; i++) {
+		struct wake_lock_timeline_entry *e =
+			&wake_lock_timeline[i % WAKE_LOCK_TIMELINE_SIZE];
+		seq_printf(m, "%lld\t%s\t%ld\t%s\n", ktime_to_ns(e->time),
+			   wake_lock_event_names[e->event], e->arg, e->name);
+	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
+	return 0;
+}
+#endif
 #endif
 
+/* Caller must acquire the list_lock spinlock */
+static void wake_lock_count_locked(struct wake_lock *lock, int delta)
+{
+	int type = lock->flags & WAKE_LOCK_TYPE_MASK;
+
+	if (!(lock->flags & WAKE_LOCK_ACTIVE))
+		return;
+	active_count[type] += delta;
+	if (!(lock->flags & WAKE_LOCK_AUTO_EXPIRE))
+		active_untimed_count[type] += delta;
+}
+
+/*
+ * Record that a suspend attempt was given up, and which wake lock blocked
+ * it. The locks without timeout are at the head of the list.
+ */
+static void suspend_blocked(void)
+{
+	unsigned long irqflags;
+	struct wake_lock *lock;
+	const char *name = NULL;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	if (!list_empty(&active_wake_locks[WAKE_LOCK_SUSPEND])) {
+		lock = list_first_entry(&active_wake_locks[WAKE_LOCK_SUSPEND],
+					struct wake_lock, link);
+		name = lock->name;
+	}
+	trace_suspend_blocked(name ? name : "",
+			      active_count[WAKE_LOCK_SUSPEND]);
+#ifdef CONFIG_WAKELOCK_PROFILE
+	wake_lock_timeline_add_locked(WAKE_LOCK_EV_BLOCKED, name,
+				      active_count[WAKE_LOCK_SUSPEND]);
+#endif
+	spin_unlock_irqrestore(&list_lock, irqflags);
+}
+
 
 static void expire_wake_lock(struct wake_lock *lock)
 {
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 1);
 #endif
+	trace_wake_unlock(lock, 1);
+#ifdef CONFIG_WAKELOCK_PROFILE
+	if ((lock->flags & WAKE_LOCK_TYPE_MASK) == WAKE_LOCK_SUSPEND)
+		wake_lock_timeline_add_locked(WAKE_LOCK_EV_EXPIRE,
+					      lock->name, 0);
+#endif
+	wake_lock_count_locked(lock, -1);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
 	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
@@ -394,6 +585,10 @@ static long has_wake_lock_locked(int type)
 	long max_timeout = 0;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
+	if (!active_count[type])
+		return 0;
+	if (active_untimed_count[type])
+		return -1;
 	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
 		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
 			long timeout = lock->expires - jiffies;
@@ -495,6 +690,7 @@ static void suspend(struct work_struct *work)
 	if (has_wake_lock(WAKE_LOCK_SUSPEND)) {
 		if (debug_mask & DEBUG_SUSPEND)
 			pr_info("suspend: abort suspend\n");
+		suspend_blocked();
 		return;
 	}
 #ifdef	CONFIG_ZTE_SUSPEND_WAKEUP_MONITOR
@@ -508,7 +704,17 @@ static void suspend(struct work_struct *work)
 	
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("suspend: enter suspend\n");
+#ifdef CONFIG_WAKELOCK_PROFILE
+	spin_lock_irq(&list_lock);
+	wake_lock_timeline_add_locked(WAKE_LOCK_EV_SUSPEND, NULL, 0);
+	spin_unlock_irq(&list_lock);
+#endif
 	ret = pm_suspend(requested_suspend_state);
+#ifdef CONFIG_WAKELOCK_PROFILE
+	spin_lock_irq(&list_lock);
+	wake_lock_timeline_add_locked(WAKE_LOCK_EV_RESUME, NULL, ret);
+	spin_unlock_irq(&list_lock);
+#endif
 	if (debug_mask & DEBUG_EXIT_SUSPEND) {
 		struct timespec ts;
 		struct rtc_time tm;
@@ -566,6 +772,8 @@ static int power_suspend_late(struct device *dev)
 #ifdef CONFIG_WAKELOCK_STAT
 	wait_for_wakeup = 1;
 #endif
+	if (ret)
+		suspend_blocked();
 	if (debug_mask & DEBUG_SUSPEND)
 	{		
 		pr_info("power_suspend_late return %d\n", ret);
@@ -605,6 +813,9 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->stat.prevent_suspend_time = ktime_set(0, 0);
 	lock->stat.max_time = ktime_set(0, 0);
 	lock->stat.last_time = ktime_set(0, 0);
+#ifdef CONFIG_WAKELOCK_PROFILE
+	memset(lock->stat.hold_hist, 0, sizeof(lock->stat.hold_hist));
+#endif
 #endif
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
@@ -635,8 +846,17 @@ void wake_lock_destroy(struct wake_lock *lock)
 		deleted_wake_locks.stat.max_time =
 			ktime_add(deleted_wake_locks.stat.max_time,
 				  lock->stat.max_time);
+#ifdef CONFIG_WAKELOCK_PROFILE
+		{
+			int i;
+			for (i = 0; i < WAKE_LOCK_HIST_BUCKETS; i++)
+				deleted_wake_locks.stat.hold_hist[i] +=
+					lock->stat.hold_hist[i];
+		}
+#endif
 	}
 #endif
+	wake_lock_count_locked(lock, -1);
 	list_del(&lock->link);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
@@ -653,6 +873,7 @@ static void wake_lock_internal(
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	BUG_ON(!(lock->flags & WAKE_LOCK_INITIALIZED));
+	wake_lock_count_locked(lock, -1);
 #ifdef CONFIG_WAKELOCK_STAT
 	if (type == WAKE_LOCK_SUSPEND && wait_for_wakeup) {
 		if (debug_mask & DEBUG_WAKEUP)
@@ -688,7 +909,13 @@ static void wake_lock_internal(
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
 		list_add(&lock->link, &active_wake_locks[type]);
 	}
+	wake_lock_count_locked(lock, 1);
+	trace_wake_lock(lock, has_timeout ? timeout : 0);
 	if (type == WAKE_LOCK_SUSPEND) {
+#ifdef CONFIG_WAKELOCK_PROFILE
+		wake_lock_timeline_add_locked(WAKE_LOCK_EV_LOCK, lock->name,
+					      has_timeout ? timeout : 0);
+#endif
 #ifdef	CONFIG_ZTE_SUSPEND_WAKEUP_MONITOR			
 	/*ZTE_HYJ_WAKELOCK_TOOL 2010.0114 begin*/	
 		if (lock == &main_wake_lock) {
@@ -748,6 +975,15 @@ void wake_unlock(struct wake_lock *lock)
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	if (lock->flags & WAKE_LOCK_ACTIVE) {
+		trace_wake_unlock(lock, 0);
+#ifdef CONFIG_WAKELOCK_PROFILE
+		if (type == WAKE_LOCK_SUSPEND)
+			wake_lock_timeline_add_locked(WAKE_LOCK_EV_UNLOCK,
+						      lock->name, 0);
+#endif
+	}
+	wake_lock_count_locked(lock, -1);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
 	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
@@ -803,6 +1039,34 @@ static const struct file_operations wakelock_stats_fops = {
 	.release = single_release,
 };
 
+#ifdef CONFIG_WAKELOCK_PROFILE
+static int wakelock_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakelock_hist_show, NULL);
+}
+
+static const struct file_operations wakelock_hist_fops = {
+	.owner = THIS_MODULE,
+	.open = wakelock_hist_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int wakelock_timeline_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakelock_timeline_show, NULL);
+}
+
+static const struct file_operations wakelock_timeline_fops = {
+	.owner = THIS_MODULE,
+	.open = wakelock_timeline_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 static int __init wakelocks_init(void)
 {
 	int ret;
@@ -858,6 +1122,11 @@ static int __init wakelocks_init(void)
 #ifdef CONFIG_WAKELOCK_STAT
 	proc_create("wakelocks", S_IRUGO, NULL, &wakelock_stats_fops);
 #endif
+#ifdef CONFIG_WAKELOCK_PROFILE
+	proc_create("wakelock_hist", S_IRUGO, NULL, &wakelock_hist_fops);
+	proc_create("wakelock_timeline", S_IRUGO, NULL,
+		    &wakelock_timeline_fops);
+#endif
 
 	return 0;
 
@@ -883,6 +1152,10 @@ static void  __exit wakelocks_exit(void)
 	 
 #ifdef CONFIG_WAKELOCK_STAT
 	remove_proc_entry("wakelocks", NULL);
+#endif
+#ifdef CONFIG_WAKELOCK_PROFILE
+	remove_proc_entry("wakelock_hist", NULL);
+	remove_proc_entry("wakelock_timeline", NULL);
 #endif
 	destroy_workqueue(suspend_work_queue);
 	platform_driver_unregister(&power_driver);
@@ -42,6 +42,9 @@
 #include <linux/kmsg_dump.h>
 #include <linux/syslog.h>
 #include <linux/rtc.h>
+#include <linux/kthread.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <asm/uaccess.h>
 /*20100726 ZTE_LYJ_PRINTK_001*/
 static int printk_proc_info = 1;
@@ -115,6 +118,34 @@ static int console_locked, console_suspended;
  */
 static DEFINE_SPINLOCK(logbuf_lock);
 
+/* printk_pending bits, acted on from the next timer tick */
+#define PRINTK_PENDING_WAKEUP	0x01	/* wake up klogd */
+#define PRINTK_PENDING_OUTPUT	0x02	/* wake up the console thread */
+
+static DEFINE_PER_CPU(int, printk_pending);
+
+#ifdef CONFIG_PRINTK_ASYNC
+/*
+ * printk() only copies into log_buf and leaves driving the consoles to
+ * printk_task, which is kicked from printk_tick() since waking it straight
+ * from printk() could recurse into the scheduler. Until the thread exists,
+ * and while an oops or panic is in progress, printk() writes the consoles
+ * itself as before.
+ */
+static int printk_async = 1;
+module_param_named(async, printk_async, bool, S_IRUGO | S_IWUSR);
+
+static struct task_struct *printk_task;
+
+static struct {
+	unsigned long deferred;		/* printk()s left to the thread */
+	unsigned long async_flushes;	/* console runs by the thread */
+	unsigned long sync_flushes;	/* console runs by everyone else */
+	unsigned long long console_ns;	/* time in console ->write() */
+	unsigned long long max_ns;	/* longest single console run */
+} printk_stats;
+#endif
+
 #define LOG_BUF_MASK (log_buf_len-1)
 #define LOG_BUF(idx) (log_buf[(idx) & LOG_BUF_MASK])
 
@@ -740,6 +771,26 @@ static int acquire_console_semaphore_for_printk(unsigned int cpu)
 	spin_unlock(&logbuf_lock);
 	return retval;
 }
+#ifdef CONFIG_PRINTK_ASYNC
+/*
+ * Called from vprintk() with logbuf_lock held and interrupts off. Returns
+ * nonzero if the console output is left to printk_task.
+ */
+static inline int printk_defer_output(void)
+{
+	if (!printk_async || !printk_task || oops_in_progress)
+		return 0;
+	printk_stats.deferred++;
+	__get_cpu_var(printk_pending) |= PRINTK_PENDING_OUTPUT;
+	return 1;
+}
+#else
+static inline int printk_defer_output(void)
+{
+	return 0;
+}
+#endif
+
 static const char recursion_bug_msg [] =
 		KERN_CRIT "BUG: recent printk recursion!\n";
 static int recursion_bug;
@@ -911,8 +962,14 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	 * The acquire_console_semaphore_for_printk() function
 	 * will release 'logbuf_lock' regardless of whether it
 	 * actually gets the semaphore or not.
+	 *
+	 * With CONFIG_PRINTK_ASYNC the consoles are normally left to
+	 * printk_task instead.
 	 */
-	if (acquire_console_semaphore_for_printk(this_cpu))
+	if (printk_defer_output()) {
+		printk_cpu = UINT_MAX;
+		spin_unlock(&logbuf_lock);
+	} else if (acquire_console_semaphore_for_printk(this_cpu))
 		release_console_sem();
 
 	lockdep_on();
@@ -1126,13 +1183,18 @@ int is_console_locked(void)
 	return console_locked;
 }
 
-static DEFINE_PER_CPU(int, printk_pending);
-
 void printk_tick(void)
 {
-	if (__get_cpu_var(printk_pending)) {
+	int pending = __get_cpu_var(printk_pending);
+
+	if (pending) {
 		__get_cpu_var(printk_pending) = 0;
-		wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_WAKEUP)
+			wake_up_interruptible(&log_wait);
+#ifdef CONFIG_PRINTK_ASYNC
+		if (pending & PRINTK_PENDING_OUTPUT)
+			wake_up_process(printk_task);
+#endif
 	}
 }
 
@@ -1146,9 +1208,88 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		this_cpu_write(printk_pending, 1);
+		this_cpu_or(printk_pending, PRINTK_PENDING_WAKEUP);
+}
+
+#ifdef CONFIG_PRINTK_ASYNC
+static void printk_account_console(unsigned long long start)
+{
+	unsigned long long ns = cpu_clock(smp_processor_id()) - start;
+
+	if (current == printk_task)
+		printk_stats.async_flushes++;
+	else
+		printk_stats.sync_flushes++;
+	printk_stats.console_ns += ns;
+	if (ns > printk_stats.max_ns)
+		printk_stats.max_ns = ns;
 }
 
+static int printk_thread(void *unused)
+{
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (con_start == log_end)
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		/* release_console_sem() does the printing */
+		acquire_console_sem();
+		release_console_sem();
+	}
+	return 0;
+}
+
+static int __init printk_async_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(printk_thread, NULL, "kprintkd");
+	if (IS_ERR(task)) {
+		printk(KERN_ERR "printk: can't start kprintkd, consoles stay "
+		       "synchronous\n");
+		return PTR_ERR(task);
+	}
+	printk_task = task;
+	return 0;
+}
+early_initcall(printk_async_init);
+
+#ifdef CONFIG_DEBUG_FS
+static int printk_stats_show(struct seq_file *m, void *unused)
+{
+	seq_printf(m, "deferred:      %lu\n", printk_stats.deferred);
+	seq_printf(m, "async_flushes: %lu\n", printk_stats.async_flushes);
+	seq_printf(m, "sync_flushes:  %lu\n", printk_stats.sync_flushes);
+	seq_printf(m, "console_us:    %llu\n",
+		   div_u64(printk_stats.console_ns, NSEC_PER_USEC));
+	seq_printf(m, "max_us:        %llu\n",
+		   div_u64(printk_stats.max_ns, NSEC_PER_USEC));
+	return 0;
+}
+
+static int printk_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, printk_stats_show, NULL);
+}
+
+static const struct file_operations printk_stats_fops = {
+	.open		= printk_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init printk_stats_init(void)
+{
+	debugfs_create_file("printk_stats", 0444, NULL, NULL,
+			    &printk_stats_fops);
+	return 0;
+}
+late_initcall(printk_stats_init);
+#endif /* CONFIG_DEBUG_FS */
+#endif /* CONFIG_PRINTK_ASYNC */
+
 /**
  * release_console_sem - unlock the console system
  *
@@ -1168,6 +1309,9 @@ void release_console_sem(void)
 	unsigned long flags;
 	unsigned _con_start, _log_end;
 	unsigned wake_klogd = 0;
+#ifdef CONFIG_PRINTK_ASYNC
+	unsigned long long start;
+#endif
 
 	if (console_suspended) {
 		up(&console_sem);
@@ -1186,7 +1330,13 @@ void release_console_sem(void)
 		con_start = log_end;		/* Flush */
 		spin_unlock(&logbuf_lock);
 		stop_critical_timings();	/* don't trace print latency */
+#ifdef CONFIG_PRINTK_ASYNC
+		start = cpu_clock(smp_processor_id());
 		call_console_drivers(_con_start, _log_end);
+		printk_account_console(start);
+#else
+		call_console_drivers(_con_start, _log_end);
+#endif
 		start_critical_timings();
 		local_irq_restore(flags);
 	}
@@ -254,6 +254,8 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+	/* favoured over other groups at wakeup, see wakeup_gran() */
+	int latency_sensitive;
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -273,6 +275,9 @@ struct task_group {
 #ifdef CONFIG_SCHED_AUTOGROUP
 	struct autogroup *autogroup;
 #endif
+#ifdef CONFIG_SCHEDSTATS
+	unsigned int delay_hist[SCHED_DELAY_HIST_BUCKETS];
+#endif
 };
 
 #define root_task_group init_task_group
@@ -398,6 +403,7 @@ struct rt_rq {
 	int rt_throttled;
 	u64 rt_time;
 	u64 rt_runtime;
+	u64 rt_burst_credit;
 	/* Nests inside the rq lock: */
 	raw_spinlock_t rt_runtime_lock;
 
@@ -839,6 +845,13 @@ static __read_mostly int scheduler_running;
  */
 int sysctl_sched_rt_runtime = 950000;
 
+/*
+ * rt time left unused in a period that may be spent in later ones on top
+ * of the runtime, in us.
+ * default: 0.025s, half of what the defaults leave to SCHED_OTHER
+ */
+int sysctl_sched_rt_burst = 25000;
+
 static inline u64 global_rt_period(void)
 {
 	return (u64)sysctl_sched_rt_period * NSEC_PER_USEC;
@@ -7457,6 +7470,7 @@ static void init_rt_rq(struct rt_rq *rt_rq, struct rq *rq)
 	rt_rq->rt_time = 0;
 	rt_rq->rt_throttled = 0;
 	rt_rq->rt_runtime = 0;
+	rt_rq->rt_burst_credit = 0;
 	raw_spin_lock_init(&rt_rq->rt_runtime_lock);
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -8623,6 +8637,22 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 
 	return (u64) tg->shares;
 }
+
+static int cpu_latency_sensitive_write_u64(struct cgroup *cgrp,
+					   struct cftype *cftype, u64 val)
+{
+	if (val > 1)
+		return -EINVAL;
+
+	cgroup_tg(cgrp)->latency_sensitive = val;
+	return 0;
+}
+
+static u64 cpu_latency_sensitive_read_u64(struct cgroup *cgrp,
+					  struct cftype *cft)
+{
+	return (u64) cgroup_tg(cgrp)->latency_sensitive;
+}
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -8649,6 +8679,15 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_SCHEDSTATS
+static int cpu_delay_hist_read(struct cgroup *cgrp, struct cftype *cft,
+			       struct seq_file *m)
+{
+	show_delay_hist(m, cgroup_tg(cgrp)->delay_hist);
+	return 0;
+}
+#endif
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -8656,6 +8695,11 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "latency_sensitive",
+		.read_u64 = cpu_latency_sensitive_read_u64,
+		.write_u64 = cpu_latency_sensitive_write_u64,
+	},
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
@@ -8669,6 +8713,12 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_rt_period_write_uint,
 	},
 #endif
+#ifdef CONFIG_SCHEDSTATS
+	{
+		.name = "delay_hist",
+		.read_seq_string = cpu_delay_hist_read,
+	},
+#endif
 };
 
 static int cpu_cgroup_populate(struct cgroup_subsys *ss, struct cgroup *cont)
@@ -205,6 +205,24 @@ find_matching_se(struct sched_entity **se, struct sched_entity **pse)
 	}
 }
 
+/* Is the group this entity is, or is queued in, latency sensitive ? */
+static inline int entity_latency_sensitive(struct sched_entity *se)
+{
+	struct task_group *tg;
+
+	if (entity_is_task(se))
+		tg = cfs_rq_of(se)->tg;
+	else
+		tg = group_cfs_rq(se)->tg;
+
+#ifdef CONFIG_SCHED_AUTOGROUP
+	/* autogroups sit in the root cgroup and follow its setting */
+	if (tg->autogroup)
+		tg = &root_task_group;
+#endif
+	return tg->latency_sensitive;
+}
+
 #else	/* !CONFIG_FAIR_GROUP_SCHED */
 
 static inline struct task_struct *task_of(struct sched_entity *se)
@@ -265,6 +283,11 @@ find_matching_se(struct sched_entity **se, struct sched_entity **pse)
 {
 }
 
+static inline int entity_latency_sensitive(struct sched_entity *se)
+{
+	return 0;
+}
+
 #endif	/* CONFIG_FAIR_GROUP_SCHED */
 
 
@@ -745,7 +768,8 @@ place_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int initial)
 		 * Halve their sleep time's effect, to allow
 		 * for a gentler effect of sleepers:
 		 */
-		if (sched_feat(GENTLE_FAIR_SLEEPERS))
+		if (sched_feat(GENTLE_FAIR_SLEEPERS) &&
+		    !entity_latency_sensitive(se))
 			thresh >>= 1;
 
 		vruntime -= thresh;
@@ -1585,6 +1609,17 @@ wakeup_gran(struct sched_entity *curr, struct sched_entity *se)
 {
 	unsigned long gran = sysctl_sched_wakeup_granularity;
 
+	/*
+	 * Between a latency sensitive group and one that isn't, the
+	 * sensitive side preempts as soon as it is owed time, and is
+	 * preempted only past twice the granularity.
+	 */
+	if (entity_latency_sensitive(se) != entity_latency_sensitive(curr)) {
+		if (entity_latency_sensitive(se))
+			return 0;
+		gran <<= 1;
+	}
+
 	/*
 	 * Since its curr running now, convert the gran from real-time
 	 * to virtual-time in his units.
@@ -483,6 +483,7 @@ static void __enable_runtime(struct rq *rq)
 		rt_rq->rt_runtime = rt_b->rt_runtime;
 		rt_rq->rt_time = 0;
 		rt_rq->rt_throttled = 0;
+		rt_rq->rt_burst_credit = 0;
 		raw_spin_unlock(&rt_rq->rt_runtime_lock);
 		raw_spin_unlock(&rt_b->rt_runtime_lock);
 	}
@@ -516,6 +517,33 @@ static inline int balance_runtime(struct rt_rq *rt_rq)
 }
 #endif /* CONFIG_SMP */
 
+static inline u64 sched_rt_burst(void)
+{
+	return (u64)sysctl_sched_rt_burst * NSEC_PER_USEC;
+}
+
+/*
+ * Charge the rt time of the elapsed periods against their budget. Budget
+ * left over is saved as burst credit, up to sched_rt_burst_us, and time
+ * run past the budget is paid from the credit first.
+ */
+static void sched_rt_charge_period(struct rt_rq *rt_rq, u64 budget)
+{
+	u64 excess, paid;
+
+	if (rt_rq->rt_time <= budget) {
+		rt_rq->rt_burst_credit = min(sched_rt_burst(),
+			rt_rq->rt_burst_credit + budget - rt_rq->rt_time);
+		rt_rq->rt_time = 0;
+		return;
+	}
+
+	excess = rt_rq->rt_time - budget;
+	paid = min(excess, rt_rq->rt_burst_credit);
+	rt_rq->rt_burst_credit -= paid;
+	rt_rq->rt_time = excess - paid;
+}
+
 static int do_sched_rt_period_timer(struct rt_bandwidth *rt_b, int overrun)
 {
 	int i, idle = 1;
@@ -531,14 +559,15 @@ static int do_sched_rt_period_timer(struct rt_bandwidth *rt_b, int overrun)
 		struct rq *rq = rq_of_rt_rq(rt_rq);
 
 		raw_spin_lock(&rq->lock);
-		if (rt_rq->rt_time) {
+		if (rt_rq->rt_time ||
+		    rt_rq->rt_burst_credit < sched_rt_burst()) {
 			u64 runtime;
 
 			raw_spin_lock(&rt_rq->rt_runtime_lock);
 			if (rt_rq->rt_throttled)
 				balance_runtime(rt_rq);
 			runtime = rt_rq->rt_runtime;
-			rt_rq->rt_time -= min(rt_rq->rt_time, overrun*runtime);
+			sched_rt_charge_period(rt_rq, overrun*runtime);
 			if (rt_rq->rt_throttled && rt_rq->rt_time < runtime) {
 				rt_rq->rt_throttled = 0;
 				enqueue = 1;
@@ -584,7 +613,8 @@ static int sched_rt_runtime_exceeded(struct rt_rq *rt_rq)
 	if (runtime == RUNTIME_INF)
 		return 0;
 
-	if (rt_rq->rt_time > runtime) {
+	/* A short overrun may borrow the budget earlier periods left */
+	if (rt_rq->rt_time > runtime + rt_rq->rt_burst_credit) {
 		rt_rq->rt_throttled = 1;
 		if (rt_rq_throttled(rt_rq)) {
 			sched_rt_rq_dequeue(rt_rq);
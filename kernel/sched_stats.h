@@ -97,13 +97,61 @@ static const struct file_operations proc_schedstat_operations = {
 	.release = single_release,
 };
 
+static void show_delay_hist(struct seq_file *seq, unsigned int *hist)
+{
+	int i;
+
+	for (i = 0; i < SCHED_DELAY_HIST_BUCKETS; i++)
+		seq_printf(seq, " %u", hist[i]);
+	seq_printf(seq, "\n");
+}
+
+static int show_schedstat_hist(struct seq_file *seq, void *v)
+{
+	int cpu, i;
+
+	seq_printf(seq, "bucket_us");
+	for (i = 0; i < SCHED_DELAY_HIST_BUCKETS - 1; i++)
+		seq_printf(seq, " %u", (1U << (SCHED_DELAY_HIST_SHIFT + i)) /
+			   NSEC_PER_USEC);
+	seq_printf(seq, " inf\n");
+
+	for_each_online_cpu(cpu) {
+		seq_printf(seq, "cpu%d", cpu);
+		show_delay_hist(seq, cpu_rq(cpu)->rq_sched_info.delay_hist);
+	}
+	return 0;
+}
+
+static int schedstat_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_schedstat_hist, NULL);
+}
+
+static const struct file_operations proc_schedstat_hist_operations = {
+	.open    = schedstat_hist_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
 static int __init proc_schedstat_init(void)
 {
 	proc_create("schedstat", 0, NULL, &proc_schedstat_operations);
+	proc_create("schedstat_hist", 0, NULL, &proc_schedstat_hist_operations);
 	return 0;
 }
 module_init(proc_schedstat_init);
 
+static inline int sched_delay_hist_bucket(unsigned long long delta)
+{
+	unsigned long long units = delta >> SCHED_DELAY_HIST_SHIFT;
+
+	if (units >= 1ULL << (SCHED_DELAY_HIST_BUCKETS - 2))
+		return SCHED_DELAY_HIST_BUCKETS - 1;
+	return fls(units);
+}
+
 /*
  * Expects runqueue lock to be held for atomicity of update
  */
@@ -116,6 +164,28 @@ rq_sched_info_arrive(struct rq *rq, unsigned long long delta)
 	}
 }
 
+/*
+ * Count a run delay of a task in its own, its runqueue's and its cpu
+ * cgroup's histogram. Runqueue lock held.
+ */
+static inline void sched_info_delay_hist(struct task_struct *t,
+					 unsigned long long delta)
+{
+	int bucket = sched_delay_hist_bucket(delta);
+#ifdef CONFIG_CGROUP_SCHED
+	struct cgroup_subsys_state *css;
+#endif
+
+	t->sched_info.delay_hist[bucket]++;
+	task_rq(t)->rq_sched_info.delay_hist[bucket]++;
+#ifdef CONFIG_CGROUP_SCHED
+	/* The cgroup itself, not the autogroup task_group() may return */
+	css = task_subsys_state_check(t, cpu_cgroup_subsys_id,
+			lockdep_is_held(&task_rq(t)->lock));
+	container_of(css, struct task_group, css)->delay_hist[bucket]++;
+#endif
+}
+
 /*
  * Expects runqueue lock to be held for atomicity of update
  */
@@ -145,6 +215,9 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 static inline void
 rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 {}
+static inline void sched_info_delay_hist(struct task_struct *t,
+					 unsigned long long delta)
+{}
 # define schedstat_inc(rq, field)	do { } while (0)
 # define schedstat_add(rq, field, amt)	do { } while (0)
 # define schedstat_set(var, val)	do { } while (0)
@@ -192,8 +265,10 @@ static void sched_info_arrive(struct task_struct *t)
 {
 	unsigned long long now = task_rq(t)->clock, delta = 0;
 
-	if (t->sched_info.last_queued)
+	if (t->sched_info.last_queued) {
 		delta = now - t->sched_info.last_queued;
+		sched_info_delay_hist(t, delta);
+	}
 	sched_info_reset_dequeued(t);
 	t->sched_info.run_delay += delta;
 	t->sched_info.last_arrival = now;
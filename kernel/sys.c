@@ -1632,6 +1632,22 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 			if (arg2 || arg3 || arg4 || arg5)
 				return -EINVAL;
 			return current->no_new_privs ? 1 : 0;
+		case PR_SET_LAZY_FORK:
+			if (arg2 > 1 || arg3 || arg4 || arg5)
+				return -EINVAL;
+			if (!me->mm)
+				return -EINVAL;
+			if (arg2)
+				set_bit(MMF_LAZY_FORK, &me->mm->flags);
+			else
+				clear_bit(MMF_LAZY_FORK, &me->mm->flags);
+			break;
+		case PR_GET_LAZY_FORK:
+			if (arg2 || arg3 || arg4 || arg5)
+				return -EINVAL;
+			if (!me->mm)
+				return -EINVAL;
+			return test_bit(MMF_LAZY_FORK, &me->mm->flags) ? 1 : 0;
 		default:
 			error = -EINVAL;
 			break;
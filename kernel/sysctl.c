@@ -269,6 +269,9 @@ static int max_sched_shares_ratelimit = NSEC_PER_SEC; /* 1 second */
 static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
 #endif
+#ifdef CONFIG_COMPACTION_KCOMPACTD
+static int max_proactive_order = MAX_ORDER - 1;
+#endif
 
 static struct ctl_table kern_table[] = {
 	{
@@ -377,6 +380,14 @@ static struct ctl_table kern_table[] = {
 		.mode		= 0644,
 		.proc_handler	= sched_rt_handler,
 	},
+	{
+		.procname	= "sched_rt_burst_us",
+		.data		= &sysctl_sched_rt_burst,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
 	{
 		.procname	= "sched_compat_yield",
 		.data		= &sysctl_sched_compat_yield,
@@ -1166,6 +1177,25 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &min_extfrag_threshold,
 		.extra2		= &max_extfrag_threshold,
 	},
+#ifdef CONFIG_COMPACTION_KCOMPACTD
+	{
+		.procname	= "compact_proactive_order",
+		.data		= &sysctl_compact_proactive_order,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= sysctl_kcompactd_handler,
+		.extra1		= &one,
+		.extra2		= &max_proactive_order,
+	},
+	{
+		.procname	= "compact_proactive_interval",
+		.data		= &sysctl_compact_proactive_interval,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= sysctl_kcompactd_handler,
+		.extra1		= &zero,
+	},
+#endif
 
 #endif /* CONFIG_COMPACTION */
 	{
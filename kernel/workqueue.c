@@ -63,6 +63,7 @@ struct workqueue_struct {
 	int singlethread;
 	int freezeable;		/* Freeze threads during suspend */
 	int rt;
+	int shared;		/* cpu_wq belongs to shared_wq */
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map lockdep_map;
 #endif
@@ -182,6 +183,9 @@ static inline void debug_work_deactivate(struct work_struct *work) { }
 static DEFINE_SPINLOCK(workqueue_lock);
 static LIST_HEAD(workqueues);
 
+/* The thread behind every create_shared_workqueue() workqueue */
+static struct workqueue_struct *shared_wq __read_mostly;
+
 static int singlethread_cpu __read_mostly;
 static const struct cpumask *cpu_singlethread_map __read_mostly;
 /*
@@ -1050,6 +1054,37 @@ struct workqueue_struct *__create_workqueue_key(const char *name,
 }
 EXPORT_SYMBOL_GPL(__create_workqueue_key);
 
+/*
+ * A shared workqueue behaves like a singlethread one, but its work runs
+ * in order with that of every other shared workqueue on one common
+ * thread, so it costs no thread and stack of its own. Meant for drivers
+ * whose work is short or rare. Work on a shared workqueue must not wait
+ * for other work queued on one, and flushing one flushes them all.
+ */
+struct workqueue_struct *__create_shared_workqueue_key(const char *name,
+						struct lock_class_key *key,
+						const char *lock_name)
+{
+	struct workqueue_struct *wq;
+
+	/* too early: give it a thread of its own */
+	if (!shared_wq)
+		return __create_workqueue_key(name, 1, 0, 0, key, lock_name);
+
+	wq = kzalloc(sizeof(*wq), GFP_KERNEL);
+	if (!wq)
+		return NULL;
+
+	wq->cpu_wq = shared_wq->cpu_wq;
+	wq->name = name;
+	lockdep_init_map(&wq->lockdep_map, lock_name, key, 0);
+	wq->singlethread = 1;
+	wq->shared = 1;
+	INIT_LIST_HEAD(&wq->list);
+	return wq;
+}
+EXPORT_SYMBOL_GPL(__create_shared_workqueue_key);
+
 static void cleanup_workqueue_thread(struct cpu_workqueue_struct *cwq)
 {
 	/*
@@ -1089,6 +1124,12 @@ void destroy_workqueue(struct workqueue_struct *wq)
 	const struct cpumask *cpu_map = wq_cpu_map(wq);
 	int cpu;
 
+	if (wq->shared) {
+		flush_workqueue(wq);
+		kfree(wq);
+		return;
+	}
+
 	cpu_maps_update_begin();
 	spin_lock(&workqueue_lock);
 	list_del(&wq->list);
@@ -1211,4 +1252,6 @@ void __init init_workqueues(void)
 	hotcpu_notifier(workqueue_cpu_callback, 0);
 	keventd_wq = create_workqueue("events");
 	BUG_ON(!keventd_wq);
+	shared_wq = create_singlethread_workqueue("shared_wq");
+	BUG_ON(!shared_wq);
 }
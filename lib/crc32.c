@@ -26,15 +26,16 @@
 #include <linux/compiler.h>
 #include <linux/types.h>
 #include <linux/init.h>
+#include <linux/cache.h>
 #include <asm/atomic.h>
 #include "crc32defs.h"
-#if CRC_LE_BITS == 8
+#if CRC_LE_BITS > 8
 # define tole(x) __constant_cpu_to_le32(x)
 #else
 # define tole(x) (x)
 #endif
 
-#if CRC_BE_BITS == 8
+#if CRC_BE_BITS > 8
 # define tobe(x) __constant_cpu_to_be32(x)
 #else
 # define tobe(x) (x)
@@ -45,26 +46,42 @@ MODULE_AUTHOR("Matt Domsch <Matt_Domsch@dell.com>");
 MODULE_DESCRIPTION("Ethernet CRC32 calculations");
 MODULE_LICENSE("GPL");
 
-#if CRC_LE_BITS == 8 || CRC_BE_BITS == 8
+#if CRC_LE_BITS > 8 || CRC_BE_BITS > 8
 
+/*
+ * Slicing by 4 or by 8: row j of tab is the crc of a byte followed by j
+ * zero bytes, so each 32 bit word costs four independent table lookups.
+ * bits is a constant, the unused slicing drops out when inlined.
+ */
 static inline u32
-crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
+crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256],
+	   int bits)
 {
 # ifdef __LITTLE_ENDIAN
-#  define DO_CRC(x) crc = tab[0][(crc ^ (x)) & 255] ^ (crc >> 8)
-#  define DO_CRC4 crc = tab[3][(crc) & 255] ^ \
-		tab[2][(crc >> 8) & 255] ^ \
-		tab[1][(crc >> 16) & 255] ^ \
-		tab[0][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[(crc ^ (x)) & 255] ^ (crc >> 8)
+#  define DO_CRC4(q) (t3[(q) & 255] ^ t2[((q) >> 8) & 255] ^ \
+		      t1[((q) >> 16) & 255] ^ t0[((q) >> 24) & 255])
+#  define DO_CRC8(q) (t7[(q) & 255] ^ t6[((q) >> 8) & 255] ^ \
+		      t5[((q) >> 16) & 255] ^ t4[((q) >> 24) & 255])
 # else
-#  define DO_CRC(x) crc = tab[0][((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
-#  define DO_CRC4 crc = tab[0][(crc) & 255] ^ \
-		tab[1][(crc >> 8) & 255] ^ \
-		tab[2][(crc >> 16) & 255] ^ \
-		tab[3][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+#  define DO_CRC4(q) (t0[(q) & 255] ^ t1[((q) >> 8) & 255] ^ \
+		      t2[((q) >> 16) & 255] ^ t3[((q) >> 24) & 255])
+#  define DO_CRC8(q) (t4[(q) & 255] ^ t5[((q) >> 8) & 255] ^ \
+		      t6[((q) >> 16) & 255] ^ t7[((q) >> 24) & 255])
 # endif
+	const u32 *t0 = tab[0], *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+	const u32 *t4 = NULL, *t5 = NULL, *t6 = NULL, *t7 = NULL;
 	const u32 *b;
 	size_t    rem_len;
+	u32 q;
+
+	if (bits == 64) {
+		t4 = tab[4];
+		t5 = tab[5];
+		t6 = tab[6];
+		t7 = tab[7];
+	}
 
 	/* Align it */
 	if (unlikely((long)buf & 3 && len)) {
@@ -72,13 +89,25 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 			DO_CRC(*buf++);
 		} while ((--len) && ((long)buf)&3);
 	}
-	rem_len = len & 3;
-	/* load data 32 bits wide, xor data 32 bits wide. */
-	len = len >> 2;
 	b = (const u32 *)buf;
-	for (--b; len; --len) {
-		crc ^= *++b; /* use pre increment for speed */
-		DO_CRC4;
+	if (bits == 64) {
+		rem_len = len & 7;
+		/* load data 64 bits wide, xor data 32 bits wide. */
+		len = len >> 3;
+		for (--b; len; --len) {
+			q = crc ^ *++b; /* use pre increment for speed */
+			crc = DO_CRC8(q);
+			q = *++b;
+			crc ^= DO_CRC4(q);
+		}
+	} else {
+		rem_len = len & 3;
+		/* load data 32 bits wide, xor data 32 bits wide. */
+		len = len >> 2;
+		for (--b; len; --len) {
+			q = crc ^ *++b; /* use pre increment for speed */
+			crc = DO_CRC4(q);
+		}
 	}
 	len = rem_len;
 	/* And the last few bytes */
@@ -91,6 +120,7 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 	return crc;
 #undef DO_CRC
 #undef DO_CRC4
+#undef DO_CRC8
 }
 #endif
 /**
@@ -122,26 +152,32 @@ u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 
 u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 {
-# if CRC_LE_BITS == 8
+# if CRC_LE_BITS > 8
 	const u32      (*tab)[] = crc32table_le;
 
 	crc = __cpu_to_le32(crc);
-	crc = crc32_body(crc, p, len, tab);
+	crc = crc32_body(crc, p, len, tab, CRC_LE_BITS);
 	return __le32_to_cpu(crc);
+# elif CRC_LE_BITS == 8
+	while (len--) {
+		crc ^= *p++;
+		crc = (crc >> 8) ^ crc32table_le[0][crc & 255];
+	}
+	return crc;
 # elif CRC_LE_BITS == 4
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
+		crc = (crc >> 4) ^ crc32table_le[0][crc & 15];
+		crc = (crc >> 4) ^ crc32table_le[0][crc & 15];
 	}
 	return crc;
 # elif CRC_LE_BITS == 2
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
 	}
 	return crc;
 # endif
@@ -179,26 +215,32 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 #else				/* Table-based approach */
 u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 {
-# if CRC_BE_BITS == 8
+# if CRC_BE_BITS > 8
 	const u32      (*tab)[] = crc32table_be;
 
 	crc = __cpu_to_be32(crc);
-	crc = crc32_body(crc, p, len, tab);
+	crc = crc32_body(crc, p, len, tab, CRC_BE_BITS);
 	return __be32_to_cpu(crc);
+# elif CRC_BE_BITS == 8
+	while (len--) {
+		crc ^= *p++ << 24;
+		crc = (crc << 8) ^ crc32table_be[0][crc >> 24];
+	}
+	return crc;
 # elif CRC_BE_BITS == 4
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
 	}
 	return crc;
 # elif CRC_BE_BITS == 2
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
 	}
 	return crc;
 # endif
@@ -208,6 +250,98 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 EXPORT_SYMBOL(crc32_le);
 EXPORT_SYMBOL(crc32_be);
 
+#ifdef CONFIG_CRC32_SELFTEST
+
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+#define CRC32_TEST_BUF	4096
+#define CRC32_TEST_LOOPS 256
+
+static u32 __init crc32_ref_le(u32 crc, unsigned char const *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
+	}
+	return crc;
+}
+
+static u32 __init crc32_ref_be(u32 crc, unsigned char const *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 24;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^
+			      ((crc & 0x80000000) ? CRCPOLY_BE : 0);
+	}
+	return crc;
+}
+
+/*
+ * Check both crcs against the bit at a time reference for every
+ * alignment and a range of lengths, then time crc32_le on 4KB blocks.
+ */
+static int __init crc32_selftest(void)
+{
+	static const size_t lens[] = {
+		0, 1, 3, 4, 7, 8, 9, 15, 16, 31, 64, 255, 1000,
+	};
+	unsigned char *buf;
+	u32 seed = 0x2545f491, crc;
+	int off, i, errors = 0;
+	ktime_t start;
+	s64 ns;
+
+	buf = kmalloc(CRC32_TEST_BUF, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	for (i = 0; i < CRC32_TEST_BUF; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = seed >> 16;
+	}
+
+	for (off = 0; off < 8; off++)
+		for (i = 0; i < ARRAY_SIZE(lens); i++) {
+			if (crc32_le(~0, buf + off, lens[i]) !=
+			    crc32_ref_le(~0, buf + off, lens[i]) ||
+			    crc32_le(0, buf + off, lens[i]) !=
+			    crc32_ref_le(0, buf + off, lens[i]))
+				errors++;
+			if (crc32_be(~0, buf + off, lens[i]) !=
+			    crc32_ref_be(~0, buf + off, lens[i]) ||
+			    crc32_be(0, buf + off, lens[i]) !=
+			    crc32_ref_be(0, buf + off, lens[i]))
+				errors++;
+		}
+
+	crc = 0;
+	start = ktime_get();
+	for (i = 0; i < CRC32_TEST_LOOPS; i++)
+		crc = crc32_le(crc, buf, CRC32_TEST_BUF);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	kfree(buf);
+
+	if (errors)
+		printk(KERN_ERR "crc32: self test failed, %d errors\n",
+		       errors);
+	else
+		printk(KERN_INFO "crc32: self test passed, %d bits at a time,"
+		       " %llu MB/s (%08x)\n", CRC_LE_BITS, ns > 0 ?
+		       div64_u64((u64)CRC32_TEST_LOOPS * CRC32_TEST_BUF *
+				 1000, ns) : 0ULL, crc);
+	return 0;
+}
+module_init(crc32_selftest);
+
+#endif /* CONFIG_CRC32_SELFTEST */
+
 /*
  * A brief CRC tutorial.
  *
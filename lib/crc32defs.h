@@ -6,27 +6,48 @@
 #define CRCPOLY_LE 0xedb88320
 #define CRCPOLY_BE 0x04c11db7
 
-/* How many bits at a time to use.  Requires a table of 4<<CRC_xx_BITS bytes. */
-/* For less performance-sensitive, use 4 */
-#ifndef CRC_LE_BITS 
-# define CRC_LE_BITS 8
+/*
+ * How many bits at a time to use.  1, 2, 4 and 8 use a table of
+ * 4<<CRC_xx_BITS bytes and go a byte at a time.  32 and 64 slice the
+ * input 4 or 8 bytes at a time with a 4KB or 8KB table.
+ */
+#ifndef CRC_LE_BITS
+# if defined(CONFIG_CRC32_SLICEBY4)
+#  define CRC_LE_BITS 32
+# elif defined(CONFIG_CRC32_SARWATE)
+#  define CRC_LE_BITS 8
+# elif defined(CONFIG_CRC32_BIT)
+#  define CRC_LE_BITS 1
+# else
+#  define CRC_LE_BITS 64
+# endif
 #endif
 #ifndef CRC_BE_BITS
-# define CRC_BE_BITS 8
+# if defined(CONFIG_CRC32_SLICEBY4)
+#  define CRC_BE_BITS 32
+# elif defined(CONFIG_CRC32_SARWATE)
+#  define CRC_BE_BITS 8
+# elif defined(CONFIG_CRC32_BIT)
+#  define CRC_BE_BITS 1
+# else
+#  define CRC_BE_BITS 64
+# endif
 #endif
 
 /*
  * Little-endian CRC computation.  Used with serial bit streams sent
  * lsbit-first.  Be sure to use cpu_to_le32() to append the computed CRC.
  */
-#if CRC_LE_BITS > 8 || CRC_LE_BITS < 1 || CRC_LE_BITS & CRC_LE_BITS-1
-# error CRC_LE_BITS must be a power of 2 between 1 and 8
+#if CRC_LE_BITS > 64 || CRC_LE_BITS < 1 || CRC_LE_BITS == 16 || \
+	CRC_LE_BITS & CRC_LE_BITS-1
+# error CRC_LE_BITS must be one of 1, 2, 4, 8, 32 or 64
 #endif
 
 /*
  * Big-endian CRC computation.  Used with serial bit streams sent
  * msbit-first.  Be sure to use cpu_to_be32() to append the computed CRC.
  */
-#if CRC_BE_BITS > 8 || CRC_BE_BITS < 1 || CRC_BE_BITS & CRC_BE_BITS-1
-# error CRC_BE_BITS must be a power of 2 between 1 and 8
+#if CRC_BE_BITS > 64 || CRC_BE_BITS < 1 || CRC_BE_BITS == 16 || \
+	CRC_BE_BITS & CRC_BE_BITS-1
+# error CRC_BE_BITS must be one of 1, 2, 4, 8, 32 or 64
 #endif
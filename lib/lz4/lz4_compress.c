@@ -0,0 +1,124 @@
+/*
+ * LZ4 - Fast LZ compression algorithm
+ *
+ * Single pass greedy compressor producing the LZ4 block format, see
+ * lz4defs.h for the sequence layout.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+static inline unsigned char *lz4_put_length(unsigned char *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	u32 *hashtable = wrkmem;
+	const unsigned char *ip = src;
+	const unsigned char *anchor = src;
+	const unsigned char *const iend = src + src_len;
+	const unsigned char *const mflimit = iend - MFLIMIT;
+	const unsigned char *const matchlimit = iend - LASTLITERALS;
+	unsigned char *op = dst;
+	unsigned char *token;
+	size_t len;
+
+	if (src_len < MINLENGTH)
+		goto last_literals;
+
+	memset(hashtable, 0, LZ4_MEM_COMPRESS);
+	hashtable[LZ4_HASH_VALUE(ip)] = 0;
+	ip++;
+
+	for (;;) {
+		const unsigned char *ref;
+
+		/* find the next match */
+		for (;; ip++) {
+			u32 h;
+
+			if (ip > mflimit)
+				goto last_literals;
+			h = LZ4_HASH_VALUE(ip);
+			ref = src + hashtable[h];
+			hashtable[h] = ip - src;
+			if (ip - ref <= MAX_DISTANCE &&
+			    get_unaligned((const u32 *)ref) ==
+			    get_unaligned((const u32 *)ip))
+				break;
+		}
+
+		/* extend it backwards into the pending literals */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		/* literal run */
+		len = ip - anchor;
+		token = op++;
+		if (len >= RUN_MASK) {
+			*token = RUN_MASK << ML_BITS;
+			op = lz4_put_length(op, len - RUN_MASK);
+		} else
+			*token = len << ML_BITS;
+		memcpy(op, anchor, len);
+		op += len;
+
+		/* offset */
+		put_unaligned_le16(ip - ref, op);
+		op += 2;
+
+		/* match length, the last LASTLITERALS bytes stay literal */
+		ip += MINMATCH;
+		ref += MINMATCH;
+		anchor = ip;
+		while (ip < matchlimit && *ip == *ref) {
+			ip++;
+			ref++;
+		}
+		len = ip - anchor;
+		if (len >= ML_MASK) {
+			*token += ML_MASK;
+			op = lz4_put_length(op, len - ML_MASK);
+		} else
+			*token += len;
+
+		anchor = ip;
+		if (ip > mflimit)
+			break;
+		hashtable[LZ4_HASH_VALUE(ip - 2)] = ip - 2 - src;
+	}
+
+last_literals:
+	len = iend - anchor;
+	token = op++;
+	if (len >= RUN_MASK) {
+		*token = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, len - RUN_MASK);
+	} else
+		*token = len << ML_BITS;
+	memcpy(op, anchor, len);
+	op += len;
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 compressor");
@@ -0,0 +1,95 @@
+/*
+ * LZ4 Decompressor for Linux kernel
+ *
+ * Every length and offset read from the stream is checked against both
+ * buffers, so corrupt input fails with an error instead of overrunning.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+static inline int lz4_get_length(const unsigned char **ip,
+		const unsigned char *iend, size_t *len)
+{
+	unsigned int s;
+
+	do {
+		if (*ip >= iend)
+			return -1;
+		s = *(*ip)++;
+		*len += s;
+	} while (s == 255);
+
+	return 0;
+}
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	const unsigned char *ip = src;
+	const unsigned char *const iend = src + src_len;
+	unsigned char *op = dest;
+	unsigned char *const oend = dest + *dest_len;
+
+	while (ip < iend) {
+		const unsigned char *ref;
+		unsigned int token = *ip++;
+		size_t len, offset;
+
+		/* literal run */
+		len = token >> ML_BITS;
+		if (len == RUN_MASK && lz4_get_length(&ip, iend, &len))
+			goto malformed;
+		if (len > iend - ip || len > oend - op)
+			goto malformed;
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+
+		/* the final sequence carries literals only */
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			goto malformed;
+		offset = get_unaligned_le16(ip);
+		ip += 2;
+		if (!offset || offset > op - dest)
+			goto malformed;
+		ref = op - offset;
+
+		len = token & ML_MASK;
+		if (len == ML_MASK && lz4_get_length(&ip, iend, &len))
+			goto malformed;
+		len += MINMATCH;
+		if (len > oend - op)
+			goto malformed;
+
+		/* a match may overlap its own output, e.g. runs of one byte */
+		if (offset >= len) {
+			memcpy(op, ref, len);
+			op += len;
+		} else {
+			while (len--)
+				*op++ = *ref++;
+		}
+	}
+
+	*dest_len = op - dest;
+	return 0;
+
+malformed:
+	return -1;
+}
+EXPORT_SYMBOL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
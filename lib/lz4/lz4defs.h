@@ -0,0 +1,32 @@
+/*
+ * lz4defs.h -- architecture specific defines
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+/*
+ * Every sequence starts with a token byte: the high nibble is the literal
+ * run length, the low nibble the match length minus MINMATCH.  A nibble of
+ * 15 is extended by following bytes, each adding up to 255.
+ */
+#define MINMATCH	4
+#define COPYLENGTH	8
+#define LASTLITERALS	5
+#define MFLIMIT		(COPYLENGTH + MINMATCH)
+#define MINLENGTH	(MFLIMIT + 1)
+
+#define MAXD_LOG	16
+#define MAX_DISTANCE	((1 << MAXD_LOG) - 1)
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+#define HASH_LOG	12
+#define HASHTABLESIZE	(1 << HASH_LOG)
+
+#define LZ4_HASH_VALUE(p)	\
+	((get_unaligned_le32(p) * 2654435761U) >> (32 - HASH_LOG))
@@ -147,7 +147,7 @@ copy_literal_run:
 				NEED_IP(2, 0);
 			}
 			m_pos = op - 1;
-			next = get_unaligned_le16(ip);
+			next = LZO_GET_LE16(ip);
 			ip += 2;
 			m_pos -= next >> 2;
 			next &= 3;
@@ -164,7 +164,7 @@ copy_literal_run:
 				t += 7 + *ip++;
 				NEED_IP(2, 0);
 			}
-			next = get_unaligned_le16(ip);
+			next = LZO_GET_LE16(ip);
 			ip += 2;
 			m_pos -= next >> 2;
 			next &= 3;
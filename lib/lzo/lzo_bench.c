@@ -0,0 +1,148 @@
+/*
+ *  LZO1X self test and benchmark
+ *
+ *  Compresses and decompresses pages that look roughly like what zram and
+ *  zcache see: mostly zero pages, text, heap words full of pointers and
+ *  some incompressible data. Every page must decompress to what went in.
+ *  Loading the module prints the throughput and fails on purpose.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/lzo.h>
+
+#define BENCH_PAGES	64
+#define BENCH_PASSES	16
+
+static u32 bench_seed = 0x12345678;
+
+static u32 bench_random(void)
+{
+	bench_seed = bench_seed * 1664525 + 1013904223;
+	return bench_seed;
+}
+
+static void bench_fill(unsigned char *page, int i)
+{
+	static const char text[] =
+		"The quick brown fox jumps over the lazy dog. 0123456789\n";
+	u32 *words = (u32 *)page;
+	int j;
+
+	switch (i % 4) {
+	case 0:
+		memset(page, 0, PAGE_SIZE);
+		words[bench_random() % (PAGE_SIZE / 4)] = bench_random();
+		break;
+	case 1:
+		for (j = 0; j < PAGE_SIZE; j++)
+			page[j] = text[(j + j / 97) % (sizeof(text) - 1)];
+		break;
+	case 2:
+		for (j = 0; j < PAGE_SIZE / 4; j++)
+			words[j] = 0xc0000000 + (bench_random() & 0xfff0);
+		break;
+	case 3:
+		for (j = 0; j < PAGE_SIZE / 4; j++)
+			words[j] = bench_random();
+		break;
+	}
+}
+
+static unsigned long long bench_mbps(size_t bytes, s64 ns)
+{
+	/* bytes per us is MB/s */
+	return ns > 0 ? div64_u64((u64)bytes * 1000, ns) : 0;
+}
+
+static int __init lzo_bench_init(void)
+{
+	unsigned char *in, *out, *back;
+	size_t *clen;
+	void *wrkmem;
+	size_t total = 0, len;
+	s64 comp_ns = 0, decomp_ns = 0;
+	ktime_t start;
+	int i, pass, ret = -ENOMEM;
+
+	in = vmalloc(BENCH_PAGES * PAGE_SIZE);
+	out = vmalloc(BENCH_PAGES * lzo1x_worst_compress(PAGE_SIZE));
+	back = vmalloc(PAGE_SIZE);
+	clen = kmalloc(BENCH_PAGES * sizeof(*clen), GFP_KERNEL);
+	wrkmem = kmalloc(LZO1X_1_MEM_COMPRESS, GFP_KERNEL);
+	if (!in || !out || !back || !clen || !wrkmem)
+		goto out;
+
+	for (i = 0; i < BENCH_PAGES; i++)
+		bench_fill(in + i * PAGE_SIZE, i);
+
+	for (pass = 0; pass < BENCH_PASSES; pass++) {
+		start = ktime_get();
+		for (i = 0; i < BENCH_PAGES; i++) {
+			ret = lzo1x_1_compress(in + i * PAGE_SIZE, PAGE_SIZE,
+				out + i * lzo1x_worst_compress(PAGE_SIZE),
+				&clen[i], wrkmem);
+			if (ret != LZO_E_OK) {
+				printk(KERN_ERR "lzo_bench: page %d: compress"
+				       " failed %d\n", i, ret);
+				ret = -EIO;
+				goto out;
+			}
+		}
+		comp_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		start = ktime_get();
+		for (i = 0; i < BENCH_PAGES; i++) {
+			len = PAGE_SIZE;
+			ret = lzo1x_decompress_safe(
+				out + i * lzo1x_worst_compress(PAGE_SIZE),
+				clen[i], back, &len);
+			if (ret != LZO_E_OK || len != PAGE_SIZE ||
+			    memcmp(back, in + i * PAGE_SIZE, PAGE_SIZE)) {
+				printk(KERN_ERR "lzo_bench: page %d: round trip"
+				       " failed %d len %zu\n", i, ret, len);
+				ret = -EIO;
+				goto out;
+			}
+		}
+		decomp_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+		cond_resched();
+	}
+
+	for (i = 0; i < BENCH_PAGES; i++)
+		total += clen[i];
+	printk(KERN_INFO "lzo_bench: %d pages -> %zu bytes, compress %llu MB/s,"
+	       " decompress %llu MB/s\n", BENCH_PAGES, total,
+	       bench_mbps(BENCH_PASSES * BENCH_PAGES * PAGE_SIZE, comp_ns),
+	       bench_mbps(BENCH_PASSES * BENCH_PAGES * PAGE_SIZE, decomp_ns));
+
+	/* Done, don't stay loaded */
+	ret = -EAGAIN;
+out:
+	kfree(wrkmem);
+	kfree(clen);
+	vfree(back);
+	vfree(out);
+	vfree(in);
+	return ret;
+}
+
+static void __exit lzo_bench_exit(void)
+{
+}
+
+module_init(lzo_bench_init);
+module_exit(lzo_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZO1X self test and benchmark");
@@ -14,9 +14,43 @@
 
 #if 1 && defined(__arm__) && ((__LINUX_ARM_ARCH__ >= 6) || defined(__ARM_FEATURE_UNALIGNED))
 #define CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS 1
-#define COPY4(dst, src)	\
-		* (u32 *) (void *) (dst) = * (const u32 *) (const void *) (src)
+#endif
+
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) && defined(__arm__) && \
+	defined(__LITTLE_ENDIAN)
+/*
+ * ldr/ldrh/str take any address here, but asm/unaligned.h goes a byte at
+ * a time, and gcc may merge plain word accesses into ldm/ldrd, which
+ * trap on unaligned addresses. Keep each access a single instruction.
+ */
+static inline u32 lzo_load32(const void *p)
+{
+	u32 v;
+
+	asm("ldr	%0, [%1]" : "=r" (v) : "r" (p), "m" (*(const u8 (*)[4]) p));
+	return v;
+}
+
+static inline u16 lzo_load16(const void *p)
+{
+	u16 v;
+
+	asm("ldrh	%0, [%1]" : "=r" (v) : "r" (p), "m" (*(const u8 (*)[2]) p));
+	return v;
+}
+
+static inline void lzo_store32(void *p, u32 v)
+{
+	asm("str	%1, [%2]" : "=m" (*(u8 (*)[4]) p) : "r" (v), "r" (p));
+}
+
+#define LZO_GET_LE32(p)	lzo_load32(p)
+#define LZO_GET_LE16(p)	lzo_load16(p)
+#define COPY4(dst, src)	lzo_store32(dst, lzo_load32(src))
 #else
+#define lzo_load32(p)	get_unaligned((const u32 *)(p))
+#define LZO_GET_LE32(p)	get_unaligned_le32(p)
+#define LZO_GET_LE16(p)	get_unaligned_le16(p)
 #define COPY4(dst, src)	\
 		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
 #endif
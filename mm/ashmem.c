@@ -27,6 +27,8 @@
 #include <linux/personality.h>
 #include <linux/bitops.h>
 #include <linux/mutex.h>
+#include <linux/rbtree.h>
+#include <linux/spinlock.h>
 #include <linux/shmem_fs.h>
 #include <linux/ashmem.h>
 #include <asm/cacheflush.h>
@@ -38,12 +40,13 @@
 /*
  * ashmem_area - anonymous shared memory area
  * Lifecycle: From our parent file's open() until its release()
- * Locking: Protected by `ashmem_mutex'
+ * Locking: Protected by its own `mutex'
  * Big Note: Mappings do NOT pin this structure; it dies on close()
  */
 struct ashmem_area {
 	char name[ASHMEM_FULL_NAME_LEN];/* optional name for /proc/pid/maps */
-	struct list_head unpinned_list;	/* list of all ashmem areas */
+	struct mutex mutex;		/* protects this area and its ranges */
+	struct rb_root unpinned_root;	/* unpinned ranges, by pgstart */
 	struct file *file;		/* the shmem-based backing file */
 	size_t size;			/* size of the mapping, in bytes */
 	unsigned long vm_start;		/* Start address of vm_area
@@ -54,29 +57,36 @@ struct ashmem_area {
 /*
  * ashmem_range - represents an interval of unpinned (evictable) pages
  * Lifecycle: From unpin to pin
- * Locking: Protected by `ashmem_mutex'
+ * Locking: Protected by its area's `mutex'; `lru' by `ashmem_lru_lock'
  */
 struct ashmem_range {
 	struct list_head lru;		/* entry in LRU list */
-	struct list_head unpinned;	/* entry in its area's unpinned list */
+	struct rb_node node;		/* entry in its area's unpinned tree */
 	struct ashmem_area *asma;	/* associated area */
 	size_t pgstart;			/* starting page, inclusive */
 	size_t pgend;			/* ending page, inclusive */
 	unsigned int purged;		/* ASHMEM_NOT or ASHMEM_WAS_PURGED */
 };
 
-/* LRU list of unpinned pages, protected by ashmem_mutex */
+/* LRU list of unpinned pages, protected by ashmem_lru_lock */
 static LIST_HEAD(ashmem_lru_list);
 
-/* Count of pages on our LRU list, protected by ashmem_mutex */
+/* Count of pages on our LRU list, protected by ashmem_lru_lock */
 static unsigned long lru_count;
 
 /*
- * ashmem_mutex - protects the list of and each individual ashmem_area
+ * ashmem_lru_lock - protects ashmem_lru_list and lru_count only
  *
- * Lock Ordering: ashmex_mutex -> i_mutex -> i_alloc_sem
+ * Pin, unpin and the other per-area operations take just their area's
+ * mutex, so they no longer serialise against each other across
+ * processes.  The shrinker only holds ashmem_lru_lock long enough to
+ * pick a range; truncation runs under the owning area's mutex alone.
+ *
+ * Lock Ordering: asma->mutex -> ashmem_lru_lock
+ *                asma->mutex -> i_mutex -> i_alloc_sem
+ * The shrinker nests asma->mutex inside ashmem_lru_lock by trylock only.
  */
-static DEFINE_MUTEX(ashmem_mutex);
+static DEFINE_SPINLOCK(ashmem_lru_lock);
 
 static struct kmem_cache *ashmem_area_cachep __read_mostly;
 static struct kmem_cache *ashmem_range_cachep __read_mostly;
@@ -107,29 +117,94 @@ static struct kmem_cache *ashmem_range_cachep __read_mostly;
 
 static inline void lru_add(struct ashmem_range *range)
 {
+	spin_lock(&ashmem_lru_lock);
 	list_add_tail(&range->lru, &ashmem_lru_list);
 	lru_count += range_size(range);
+	spin_unlock(&ashmem_lru_lock);
 }
 
-static inline void lru_del(struct ashmem_range *range)
+static inline void __lru_del(struct ashmem_range *range)
 {
 	list_del(&range->lru);
 	lru_count -= range_size(range);
 }
 
+static inline void lru_del(struct ashmem_range *range)
+{
+	spin_lock(&ashmem_lru_lock);
+	__lru_del(range);
+	spin_unlock(&ashmem_lru_lock);
+}
+
+/*
+ * range_first_overlap - the lowest unpinned range that overlaps
+ * [start, end], or NULL.  Unpinned ranges never overlap one another, so
+ * ordering by pgstart also orders by pgend and a plain rbtree is enough
+ * for interval lookups; the rest of the overlaps follow via rb_next().
+ *
+ * Caller must hold asma->mutex.
+ */
+static struct ashmem_range *range_first_overlap(struct ashmem_area *asma,
+						size_t start, size_t end)
+{
+	struct rb_node *n = asma->unpinned_root.rb_node;
+	struct ashmem_range *range, *found = NULL;
+
+	while (n) {
+		range = rb_entry(n, struct ashmem_range, node);
+		if (range_before_page(range, start)) {
+			n = n->rb_right;
+		} else {
+			found = range;
+			n = n->rb_left;
+		}
+	}
+
+	if (found && found->pgstart > end)
+		return NULL;
+	return found;
+}
+
+static inline struct ashmem_range *range_next(struct ashmem_range *range)
+{
+	struct rb_node *n = rb_next(&range->node);
+
+	return n ? rb_entry(n, struct ashmem_range, node) : NULL;
+}
+
+static void range_insert(struct ashmem_area *asma, struct ashmem_range *range)
+{
+	struct rb_node **p = &asma->unpinned_root.rb_node;
+	struct rb_node *parent = NULL;
+	struct ashmem_range *entry;
+
+	while (*p) {
+		parent = *p;
+		entry = rb_entry(parent, struct ashmem_range, node);
+		if (range->pgstart < entry->pgstart)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+
+	rb_link_node(&range->node, parent, p);
+	rb_insert_color(&range->node, &asma->unpinned_root);
+
+	if (range_on_lru(range))
+		lru_add(range);
+}
+
 /*
  * range_alloc - allocate and initialize a new ashmem_range structure
  *
  * 'asma' - associated ashmem_area
- * 'prev_range' - the previous ashmem_range in the sorted asma->unpinned list
  * 'purged' - initial purge value (ASMEM_NOT_PURGED or ASHMEM_WAS_PURGED)
  * 'start' - starting page, inclusive
  * 'end' - ending page, inclusive
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
-static int range_alloc(struct ashmem_area *asma,
-		       struct ashmem_range *prev_range, unsigned int purged,
+static int range_alloc(struct ashmem_area *asma, unsigned int purged,
 		       size_t start, size_t end)
 {
 	struct ashmem_range *range;
@@ -143,37 +218,42 @@ static int range_alloc(struct ashmem_area *asma,
 	range->pgend = end;
 	range->purged = purged;
 
-	list_add_tail(&range->unpinned, &prev_range->unpinned);
-
-	if (range_on_lru(range))
-		lru_add(range);
+	range_insert(asma, range);
 
 	return 0;
 }
 
-static void range_del(struct ashmem_range *range)
+/* take @range out of its area's tree and off the LRU, without freeing it */
+static void range_unlink(struct ashmem_range *range)
 {
-	list_del(&range->unpinned);
+	rb_erase(&range->node, &range->asma->unpinned_root);
 	if (range_on_lru(range))
 		lru_del(range);
+}
+
+static void range_del(struct ashmem_range *range)
+{
+	range_unlink(range);
 	kmem_cache_free(ashmem_range_cachep, range);
 }
 
 /*
  * range_shrink - shrinks a range
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static inline void range_shrink(struct ashmem_range *range,
 				size_t start, size_t end)
 {
 	size_t pre = range_size(range);
 
+	spin_lock(&ashmem_lru_lock);
 	range->pgstart = start;
 	range->pgend = end;
 
 	if (range_on_lru(range))
 		lru_count -= pre - range_size(range);
+	spin_unlock(&ashmem_lru_lock);
 }
 
 static int ashmem_open(struct inode *inode, struct file *file)
@@ -189,7 +269,8 @@ static int ashmem_open(struct inode *inode, struct file *file)
 	if (unlikely(!asma))
 		return -ENOMEM;
 
-	INIT_LIST_HEAD(&asma->unpinned_list);
+	mutex_init(&asma->mutex);
+	asma->unpinned_root = RB_ROOT;
 	memcpy(asma->name, ASHMEM_NAME_PREFIX, ASHMEM_NAME_PREFIX_LEN);
 	asma->prot_mask = PROT_MASK;
 	file->private_data = asma;
@@ -200,12 +281,12 @@ static int ashmem_open(struct inode *inode, struct file *file)
 static int ashmem_release(struct inode *ignored, struct file *file)
 {
 	struct ashmem_area *asma = file->private_data;
-	struct ashmem_range *range, *next;
+	struct rb_node *n;
 
-	mutex_lock(&ashmem_mutex);
-	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned)
-		range_del(range);
-	mutex_unlock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
+	while ((n = rb_first(&asma->unpinned_root)))
+		range_del(rb_entry(n, struct ashmem_range, node));
+	mutex_unlock(&asma->mutex);
 
 	if (asma->file)
 		fput(asma->file);
@@ -220,7 +301,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* If size is not set, or set to 0, always return EOF. */
 	if (asma->size == 0) {
@@ -232,7 +313,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 		goto out_unlock;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	/*
 	 * asma and asma->file are used outside the lock here.  We assume
@@ -248,7 +329,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	return ret;
 
 out_unlock:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -257,7 +338,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	struct ashmem_area *asma = file->private_data;
 	int ret;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	if (asma->size == 0) {
 		ret = -EINVAL;
@@ -278,7 +359,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	file->f_pos = asma->file->f_pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -295,7 +376,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* user needs to SET_SIZE before mapping */
 	if (unlikely(!asma->size)) {
@@ -339,7 +420,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	asma->vm_start = vma->vm_start;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -356,11 +437,14 @@ out:
  *
  * We approximate LRU via least-recently-unpinned, jettisoning unpinned partial
  * chunks of ashmem regions LRU-wise one-at-a-time until we hit 'nr_to_scan'
- * pages freed.
+ * pages freed.  ashmem_lru_lock is dropped across each truncation, which runs
+ * with only the owning area's mutex held; areas that are busy (their mutex is
+ * contended by a pin or unpin) are skipped for this pass.
  */
 static int ashmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 {
-	struct ashmem_range *range, *next;
+	struct ashmem_range *range;
+	struct ashmem_area *asma;
 
 	/* We might recurse into filesystem code, so bail out if necessary */
 	if (nr_to_scan && !(gfp_mask & __GFP_FS))
@@ -368,26 +452,53 @@ static int ashmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 	if (!nr_to_scan)
 		return lru_count;
 
-	if (!mutex_trylock(&ashmem_mutex))
-		return -1;
-	list_for_each_entry_safe(range, next, &ashmem_lru_list, lru) {
-		struct inode *inode = range->asma->file->f_dentry->d_inode;
-		loff_t start = range->pgstart * PAGE_SIZE;
-		loff_t end = (range->pgend + 1) * PAGE_SIZE - 1;
+	while (nr_to_scan > 0) {
+		struct inode *inode;
+		loff_t start, end;
 
-		vmtruncate_range(inode, start, end);
+		asma = NULL;
+		spin_lock(&ashmem_lru_lock);
+		list_for_each_entry(range, &ashmem_lru_list, lru) {
+			if (mutex_trylock(&range->asma->mutex)) {
+				asma = range->asma;
+				break;
+			}
+		}
+		if (!asma) {
+			spin_unlock(&ashmem_lru_lock);
+			break;
+		}
+		/*
+		 * Mark it purged before dropping the LRU lock: a concurrent
+		 * pin of this range has to wait for asma->mutex and will
+		 * then correctly report ASHMEM_WAS_PURGED.
+		 */
+		__lru_del(range);
 		range->purged = ASHMEM_WAS_PURGED;
-		lru_del(range);
+		spin_unlock(&ashmem_lru_lock);
 
+		inode = asma->file->f_dentry->d_inode;
+		start = range->pgstart * PAGE_SIZE;
+		end = (range->pgend + 1) * PAGE_SIZE - 1;
 		nr_to_scan -= range_size(range);
-		if (nr_to_scan <= 0)
-			break;
+
+		vmtruncate_range(inode, start, end);
+		mutex_unlock(&asma->mutex);
 	}
-	mutex_unlock(&ashmem_mutex);
 
 	return lru_count;
 }
 
+/*
+ * ashmem_unpinned_pages - pages in unpinned ranges, i.e. what our shrinker
+ * could purge right now.  Read without ashmem_lru_lock; callers only want an
+ * estimate.
+ */
+unsigned long ashmem_unpinned_pages(void)
+{
+	return ACCESS_ONCE(lru_count);
+}
+
 static struct shrinker ashmem_shrinker = {
 	.shrink = ashmem_shrink,
 	.seeks = DEFAULT_SEEKS * 4,
@@ -397,7 +508,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* the user can only remove, not add, protection bits */
 	if (unlikely((asma->prot_mask & prot) != prot)) {
@@ -412,7 +523,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 	asma->prot_mask = prot;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -427,7 +538,7 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 		return len;
 	if (len == ASHMEM_NAME_LEN)
 		lname[ASHMEM_NAME_LEN - 1] = '\0';
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* cannot change an existing mapping's name */
 	if (unlikely(asma->file))
@@ -435,7 +546,7 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 	else
 		strcpy(asma->name + ASHMEM_NAME_PREFIX_LEN, lname);
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -445,7 +556,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 	char lname[ASHMEM_NAME_LEN];
 	size_t len;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 	if (asma->name[ASHMEM_NAME_PREFIX_LEN] != '\0') {
 		/*
 		 * Copying only `len', instead of ASHMEM_NAME_LEN, bytes
@@ -457,7 +568,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 		len = strlen(ASHMEM_NAME_DEF) + 1;
 		memcpy(lname, ASHMEM_NAME_DEF, len);
 	}
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	if (unlikely(copy_to_user(name, lname, len)))
 		ret = -EFAULT;
 	return ret;
@@ -467,17 +578,16 @@ static int get_name(struct ashmem_area *asma, void __user *name)
  * ashmem_pin - pin the given ashmem region, returning whether it was
  * previously purged (ASHMEM_WAS_PURGED) or not (ASHMEM_NOT_PURGED).
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
 	struct ashmem_range *range, *next;
 	int ret = ASHMEM_NOT_PURGED;
 
-	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned) {
-		/* moved past last applicable page; we can short circuit */
-		if (range_before_page(range, pgstart))
-			break;
+	for (range = range_first_overlap(asma, pgstart, pgend);
+	     range && range->pgstart <= pgend; range = next) {
+		next = range_next(range);
 
 		/*
 		 * The user can ask us to pin pages that span multiple ranges,
@@ -520,7 +630,7 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 			 * more complicated, we allocate a new range for the
 			 * second half and adjust the first chunk's endpoint.
 			 */
-			range_alloc(asma, range, range->purged,
+			range_alloc(asma, range->purged,
 				    pgend + 1, range->pgend);
 			range_shrink(range, range->pgstart, pgstart - 1);
 			break;
@@ -533,59 +643,86 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 /*
  * ashmem_unpin - unpin the given range of pages. Returns zero on success.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_unpin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
-	struct ashmem_range *range, *next;
+	struct ashmem_range *range, *next, *merged;
 	unsigned int purged = ASHMEM_NOT_PURGED;
 
-restart:
-	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned) {
-		/* short circuit: this is our insertion point */
-		if (range_before_page(range, pgstart))
-			break;
+	range = range_first_overlap(asma, pgstart, pgend);
+	if (!range)
+		return range_alloc(asma, purged, pgstart, pgend);
 
-		/*
-		 * The user can ask us to unpin pages that are already entirely
-		 * or partially pinned. We handle those two cases here.
-		 */
-		if (page_range_subsumed_by_range(range, pgstart, pgend))
-			return 0;
-		if (page_range_in_range(range, pgstart, pgend)) {
-			pgstart = min_t(size_t, range->pgstart, pgstart),
-			pgend = max_t(size_t, range->pgend, pgend);
-			purged |= range->purged;
+	/*
+	 * The user can ask us to unpin pages that are already entirely
+	 * or partially pinned. We handle those two cases here.
+	 */
+	if (page_range_subsumed_by_range(range, pgstart, pgend))
+		return 0;
+
+	/*
+	 * Merge every overlapping range into the first one, reusing its
+	 * structure rather than allocating a new one.
+	 */
+	merged = range;
+	for (; range && range->pgstart <= pgend; range = next) {
+		next = range_next(range);
+		pgstart = min_t(size_t, range->pgstart, pgstart);
+		pgend = max_t(size_t, range->pgend, pgend);
+		purged |= range->purged;
+		if (range != merged)
 			range_del(range);
-			goto restart;
-		}
 	}
 
-	return range_alloc(asma, range, purged, pgstart, pgend);
+	range_unlink(merged);
+	merged->pgstart = pgstart;
+	merged->pgend = pgend;
+	merged->purged = purged;
+	range_insert(asma, merged);
+
+	return 0;
 }
 
 /*
  * ashmem_get_pin_status - Returns ASHMEM_IS_UNPINNED if _any_ pages in the
  * given interval are unpinned and ASHMEM_IS_PINNED otherwise.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_get_pin_status(struct ashmem_area *asma, size_t pgstart,
 				 size_t pgend)
 {
-	struct ashmem_range *range;
-	int ret = ASHMEM_IS_PINNED;
+	if (range_first_overlap(asma, pgstart, pgend))
+		return ASHMEM_IS_UNPINNED;
+	return ASHMEM_IS_PINNED;
+}
 
-	list_for_each_entry(range, &asma->unpinned_list, unpinned) {
-		if (range_before_page(range, pgstart))
-			break;
-		if (page_range_in_range(range, pgstart, pgend)) {
-			ret = ASHMEM_IS_UNPINNED;
-			break;
-		}
-	}
+/*
+ * ashmem_pin_to_pages - validate a user ashmem_pin and convert it to an
+ * inclusive page interval.
+ */
+static int ashmem_pin_to_pages(struct ashmem_area *asma,
+			       struct ashmem_pin *pin,
+			       size_t *pgstart, size_t *pgend)
+{
+	/* per custom, you can pass zero for len to mean "everything onward" */
+	if (!pin->len)
+		pin->len = PAGE_ALIGN(asma->size) - pin->offset;
 
-	return ret;
+	if (unlikely((pin->offset | pin->len) & ~PAGE_MASK))
+		return -EINVAL;
+
+	if (unlikely(((__u32) -1) - pin->offset < pin->len))
+		return -EINVAL;
+
+	if (unlikely(PAGE_ALIGN(asma->size) < pin->offset + pin->len))
+		return -EINVAL;
+
+	*pgstart = pin->offset / PAGE_SIZE;
+	*pgend = *pgstart + (pin->len / PAGE_SIZE) - 1;
+
+	return 0;
 }
 
 static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
@@ -601,23 +738,12 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 	if (unlikely(copy_from_user(&pin, p, sizeof(pin))))
 		return -EFAULT;
 
-	/* per custom, you can pass zero for len to mean "everything onward" */
-	if (!pin.len)
-		pin.len = PAGE_ALIGN(asma->size) - pin.offset;
-
-	if (unlikely((pin.offset | pin.len) & ~PAGE_MASK))
-		return -EINVAL;
-
-	if (unlikely(((__u32) -1) - pin.offset < pin.len))
-		return -EINVAL;
-
-	if (unlikely(PAGE_ALIGN(asma->size) < pin.offset + pin.len))
-		return -EINVAL;
-
-	pgstart = pin.offset / PAGE_SIZE;
-	pgend = pgstart + (pin.len / PAGE_SIZE) - 1;
+	ret = ashmem_pin_to_pages(asma, &pin, &pgstart, &pgend);
+	if (unlikely(ret))
+		return ret;
 
-	mutex_lock(&ashmem_mutex);
+	ret = -EINVAL;
+	mutex_lock(&asma->mutex);
 
 	switch (cmd) {
 	case ASHMEM_PIN:
@@ -631,11 +757,69 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 		break;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
 
+/*
+ * ashmem_get_pin_status_vec - ASHMEM_GET_PIN_STATUS for a vector of ranges
+ * in one call.  Each entry of 'status' is set to ASHMEM_IS_PINNED or
+ * ASHMEM_IS_UNPINNED; the return value is the number of unpinned ranges.
+ */
+static int ashmem_get_pin_status_vec(struct ashmem_area *asma,
+				     void __user *p)
+{
+	struct ashmem_pin_vec vec;
+	struct ashmem_pin __user *upins;
+	__u32 __user *ustatus;
+	struct ashmem_pin pins[16];
+	__u32 status[ARRAY_SIZE(pins)];
+	size_t pgstart, pgend;
+	unsigned int i, n, done;
+	int unpinned = 0;
+	int ret;
+
+	if (unlikely(!asma->file))
+		return -EINVAL;
+
+	if (unlikely(copy_from_user(&vec, p, sizeof(vec))))
+		return -EFAULT;
+
+	if (unlikely(vec.count > ASHMEM_PIN_VEC_MAX))
+		return -EINVAL;
+
+	upins = (struct ashmem_pin __user *)(unsigned long) vec.pins;
+	ustatus = (__u32 __user *)(unsigned long) vec.status;
+
+	for (done = 0; done < vec.count; done += n) {
+		n = min_t(unsigned int, vec.count - done, ARRAY_SIZE(pins));
+		if (unlikely(copy_from_user(pins, upins + done,
+					    n * sizeof(pins[0]))))
+			return -EFAULT;
+
+		mutex_lock(&asma->mutex);
+		for (i = 0; i < n; i++) {
+			ret = ashmem_pin_to_pages(asma, &pins[i],
+						  &pgstart, &pgend);
+			if (unlikely(ret)) {
+				mutex_unlock(&asma->mutex);
+				return ret;
+			}
+			status[i] = ashmem_get_pin_status(asma, pgstart, pgend);
+			if (status[i] == ASHMEM_IS_UNPINNED)
+				unpinned++;
+		}
+		mutex_unlock(&asma->mutex);
+
+		if (unlikely(copy_to_user(ustatus + done, status,
+					  n * sizeof(status[0]))))
+			return -EFAULT;
+	}
+
+	return unpinned;
+}
+
 #ifdef CONFIG_OUTER_CACHE
 static unsigned int virtaddr_to_physaddr(unsigned int virtaddr)
 {
@@ -753,6 +937,9 @@ static long ashmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case ASHMEM_GET_PIN_STATUS:
 		ret = ashmem_pin_unpin(asma, cmd, (void __user *) arg);
 		break;
+	case ASHMEM_GET_PIN_STATUS_VEC:
+		ret = ashmem_get_pin_status_vec(asma, (void __user *) arg);
+		break;
 	case ASHMEM_PURGE_ALL_CACHES:
 		ret = -EPERM;
 		if (capable(CAP_SYS_ADMIN)) {
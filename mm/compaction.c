@@ -14,6 +14,11 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#ifdef CONFIG_HAS_EARLYSUSPEND
+#include <linux/earlysuspend.h>
+#endif
 #include "internal.h"
 
 /*
@@ -583,6 +588,148 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+#ifdef CONFIG_COMPACTION_KCOMPACTD
+/*
+ * kcompactd compacts a zone ahead of time when a free block of
+ * compact_proactive_order pages could only be had by compacting it: the
+ * zone has the free memory, but the fragmentation index for that order
+ * is above extfrag_threshold. While the screen is off it checks every
+ * compact_proactive_interval seconds. While it is on, it only runs when a
+ * small high-order allocation entered the slow path, and at most once an
+ * interval, so it doesn't compete with the foreground for the cpu.
+ */
+int sysctl_compact_proactive_order = PAGE_ALLOC_COSTLY_ORDER;
+int sysctl_compact_proactive_interval = 30;
+
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+static bool kcompactd_woken;
+static bool kcompactd_screen_on = true;
+static struct task_struct *kcompactd_task;
+
+void wakeup_kcompactd(int order)
+{
+	if (order == 0 || order > sysctl_compact_proactive_order)
+		return;
+	if (!waitqueue_active(&kcompactd_wait))
+		return;
+
+	kcompactd_woken = true;
+	wake_up_interruptible(&kcompactd_wait);
+}
+
+static void kcompactd_compact(int order)
+{
+	struct zone *zone;
+
+	lru_add_drain_all();
+
+	for_each_populated_zone(zone) {
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.zone = zone,
+		};
+		unsigned long watermark;
+
+		/* Migration needs room for the copies, as for direct compaction */
+		watermark = low_wmark_pages(zone) + (2UL << order);
+		if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+			continue;
+
+		/* -1000: a block is free already, up to the threshold: no memory */
+		if (fragmentation_index(zone, order) <= sysctl_extfrag_threshold)
+			continue;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+		compact_zone(zone, &cc);
+	}
+}
+
+static int kcompactd(void *unused)
+{
+	unsigned long last_run = jiffies;
+
+	set_user_nice(current, 19);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		long timeout = MAX_SCHEDULE_TIMEOUT;
+		unsigned long interval = sysctl_compact_proactive_interval * HZ;
+
+		if (interval && !kcompactd_screen_on)
+			timeout = interval;
+
+		wait_event_freezable_timeout(kcompactd_wait,
+			kcompactd_woken || kthread_should_stop(), timeout);
+		kcompactd_woken = false;
+
+		if (!interval)
+			continue;
+		if (kcompactd_screen_on &&
+		    time_before(jiffies, last_run + interval))
+			continue;
+
+		last_run = jiffies;
+		kcompactd_compact(sysctl_compact_proactive_order);
+	}
+
+	return 0;
+}
+
+int sysctl_kcompactd_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+
+	/* Pick up a new interval */
+	if (!ret && write && kcompactd_task) {
+		kcompactd_woken = true;
+		wake_up_interruptible(&kcompactd_wait);
+	}
+	return ret;
+}
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void kcompactd_early_suspend(struct early_suspend *h)
+{
+	/* Good moment for a first run */
+	kcompactd_screen_on = false;
+	kcompactd_woken = true;
+	wake_up_interruptible(&kcompactd_wait);
+}
+
+static void kcompactd_late_resume(struct early_suspend *h)
+{
+	kcompactd_screen_on = true;
+}
+
+static struct early_suspend kcompactd_early_suspend_desc = {
+	.suspend = kcompactd_early_suspend,
+	.resume = kcompactd_late_resume,
+};
+#endif
+
+static int __init kcompactd_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(kcompactd, NULL, "kcompactd");
+	if (IS_ERR(task)) {
+		pr_err("Failed to start kcompactd\n");
+		return PTR_ERR(task);
+	}
+	kcompactd_task = task;
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&kcompactd_early_suspend_desc);
+#endif
+	return 0;
+}
+module_init(kcompactd_init)
+#endif /* CONFIG_COMPACTION_KCOMPACTD */
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
@@ -456,10 +456,13 @@ int __add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 
 	ret = add_to_page_cache(page, mapping, offset, gfp_mask);
 	if (ret == 0) {
-		if (page_is_file_cache(page))
+		if (page_is_file_cache(page)) {
+			if (page_cache_refault(mapping, offset))
+				count_vm_event(PGREFAULT_FILE);
 			lru_cache_add_file_tail(page, tail);
-		else
+		} else {
 			lru_cache_add_anon(page);
+		}
 	}
 	return ret;
 }
@@ -1474,6 +1477,8 @@ static int page_cache_read(struct file *file, pgoff_t offset)
 }
 
 #define MMAP_LOTSAMISS  (100)
+/* The read-around window halves for every this many net misses */
+#define MMAP_MISS_SHIFT	(MMAP_LOTSAMISS / 4)
 
 /*
  * Synchronous readahead happens when we don't even find
@@ -1488,7 +1493,7 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	struct address_space *mapping = file->f_mapping;
 
 	/* If we don't want any read-ahead, don't bother */
-	if (VM_RandomReadHint(vma))
+	if (VM_RandomReadHint(vma) || (file->f_mode & FMODE_RANDOM))
 		return;
 
 	if (VM_SequentialReadHint(vma)) {
@@ -1509,9 +1514,12 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 		return;
 
 	/*
-	 * mmap read-around
+	 * mmap read-around, shrinking as misses outnumber hits so that
+	 * randomly touched mappings like dex and zip files stop pulling
+	 * in pages nobody uses well before read-around is given up.
 	 */
 	ra_pages = max_sane_readahead(ra->ra_pages);
+	ra_pages >>= ra->mmap_miss / MMAP_MISS_SHIFT;
 	if (ra_pages) {
 		ra->start = max_t(long, 0, offset - ra_pages/2);
 		ra->size = ra_pages;
@@ -1533,7 +1541,7 @@ static void do_async_mmap_readahead(struct vm_area_struct *vma,
 	struct address_space *mapping = file->f_mapping;
 
 	/* If we don't want any read-ahead, don't bother */
-	if (VM_RandomReadHint(vma))
+	if (VM_RandomReadHint(vma) || (file->f_mode & FMODE_RANDOM))
 		return;
 	if (ra->mmap_miss > 0)
 		ra->mmap_miss--;
@@ -696,6 +696,27 @@ static inline bool mem_cgroup_is_root(struct mem_cgroup *mem)
 	return (mem == root_mem_cgroup);
 }
 
+/*
+ * Pages charged to the memcg @mm is accounted to, or 0 for the root
+ * cgroup, which would only report the whole system. Used by the low
+ * memory killer to size up apps that run in a cgroup of their own.
+ */
+unsigned long mem_cgroup_mm_usage(struct mm_struct *mm)
+{
+	struct mem_cgroup *mem;
+	unsigned long usage = 0;
+
+	if (mem_cgroup_disabled() || !mm)
+		return 0;
+
+	rcu_read_lock();
+	mem = mem_cgroup_from_task(rcu_dereference(mm->owner));
+	if (mem && !mem_cgroup_is_root(mem))
+		usage = res_counter_read_u64(&mem->res, RES_USAGE) >> PAGE_SHIFT;
+	rcu_read_unlock();
+	return usage;
+}
+
 /*
  * Following LRU functions are allowed to be used without PCG_LOCK.
  * Operations are called by routine of global LRU independently from memcg.
@@ -1460,9 +1481,16 @@ done:
  * TODO: maybe necessary to use big numbers in big irons.
  */
 #define CHARGE_SIZE	(32 * PAGE_SIZE)
+/*
+ * Stocks kept per cpu. With a cgroup per app, every context switch
+ * between apps would otherwise drain one app's stock back to its
+ * res_counter and charge the next one's afresh.
+ */
+#define MEMCG_STOCK_SLOTS	4
 struct memcg_stock_pcp {
-	struct mem_cgroup *cached; /* this never be root cgroup */
-	int charge;
+	struct mem_cgroup *cached[MEMCG_STOCK_SLOTS]; /* never root cgroup */
+	int charge[MEMCG_STOCK_SLOTS];
+	int next;	/* slot to reuse when all are taken */
 	struct work_struct work;
 };
 static DEFINE_PER_CPU(struct memcg_stock_pcp, memcg_stock);
@@ -1477,31 +1505,44 @@ static atomic_t memcg_drain_count;
 static bool consume_stock(struct mem_cgroup *mem)
 {
 	struct memcg_stock_pcp *stock;
-	bool ret = true;
+	bool ret = false;
+	int i;
 
 	stock = &get_cpu_var(memcg_stock);
-	if (mem == stock->cached && stock->charge)
-		stock->charge -= PAGE_SIZE;
-	else /* need to call res_counter_charge */
-		ret = false;
+	for (i = 0; i < MEMCG_STOCK_SLOTS; i++) {
+		if (mem == stock->cached[i] && stock->charge[i]) {
+			stock->charge[i] -= PAGE_SIZE;
+			ret = true;
+			break;
+		}
+	}
+	/* otherwise need to call res_counter_charge */
 	put_cpu_var(memcg_stock);
 	return ret;
 }
 
+static void drain_stock_slot(struct memcg_stock_pcp *stock, int i)
+{
+	struct mem_cgroup *old = stock->cached[i];
+
+	if (stock->charge[i]) {
+		res_counter_uncharge(&old->res, stock->charge[i]);
+		if (do_swap_account)
+			res_counter_uncharge(&old->memsw, stock->charge[i]);
+	}
+	stock->cached[i] = NULL;
+	stock->charge[i] = 0;
+}
+
 /*
  * Returns stocks cached in percpu to res_counter and reset cached information.
  */
 static void drain_stock(struct memcg_stock_pcp *stock)
 {
-	struct mem_cgroup *old = stock->cached;
+	int i;
 
-	if (stock->charge) {
-		res_counter_uncharge(&old->res, stock->charge);
-		if (do_swap_account)
-			res_counter_uncharge(&old->memsw, stock->charge);
-	}
-	stock->cached = NULL;
-	stock->charge = 0;
+	for (i = 0; i < MEMCG_STOCK_SLOTS; i++)
+		drain_stock_slot(stock, i);
 }
 
 /*
@@ -1521,12 +1562,25 @@ static void drain_local_stock(struct work_struct *dummy)
 static void refill_stock(struct mem_cgroup *mem, int val)
 {
 	struct memcg_stock_pcp *stock = &get_cpu_var(memcg_stock);
+	int i, slot = -1;
 
-	if (stock->cached != mem) { /* reset if necessary */
-		drain_stock(stock);
-		stock->cached = mem;
+	for (i = 0; i < MEMCG_STOCK_SLOTS; i++) {
+		if (stock->cached[i] == mem) {
+			slot = i;
+			break;
+		}
+		if (slot < 0 && !stock->charge[i])
+			slot = i;
+	}
+	if (slot < 0) {
+		slot = stock->next;
+		stock->next = (slot + 1) % MEMCG_STOCK_SLOTS;
+	}
+	if (stock->cached[slot] != mem) { /* reset if necessary */
+		drain_stock_slot(stock, slot);
+		stock->cached[slot] = mem;
 	}
-	stock->charge += val;
+	stock->charge[slot] += val;
 	put_cpu_var(memcg_stock);
 }
 
@@ -758,19 +758,73 @@ out_set_pte:
 	return 0;
 }
 
+/*
+ * Lazy fork (PR_SET_LAZY_FORK): ptes mapping page cache pages are left
+ * out of the child, which faults them back in from the page cache on
+ * first touch, just like the mappings without an anon_vma that
+ * copy_page_range() skips altogether. Only private COW copies, swap
+ * entries and special mappings have to be copied.
+ */
+static inline int lazy_fork_vma(struct mm_struct *src_mm,
+				struct vm_area_struct *vma)
+{
+	return test_bit(MMF_LAZY_FORK, &src_mm->flags) &&
+		vma->vm_ops && vma->vm_ops->fault &&
+		!(vma->vm_flags & (VM_HUGETLB|VM_NONLINEAR|VM_PFNMAP|
+				   VM_INSERTPAGE|VM_MIXEDMAP));
+}
+
+static inline int lazy_fork_skip_pte(struct vm_area_struct *vma,
+				     unsigned long addr, pte_t pte)
+{
+	struct page *page;
+
+	if (!pte_present(pte))
+		return 0;
+	page = vm_normal_page(vma, addr, pte);
+	return page && !PageAnon(page);
+}
+
+/*
+ * Nothing in this page table needs copying, so the child does not even
+ * get a page table for it.
+ */
+static int lazy_fork_skip_pmd(struct mm_struct *src_mm, pmd_t *src_pmd,
+			      struct vm_area_struct *vma,
+			      unsigned long addr, unsigned long end)
+{
+	pte_t *orig_src_pte, *src_pte;
+	spinlock_t *src_ptl;
+	int skip = 1;
+
+	orig_src_pte = src_pte = pte_offset_map_lock(src_mm, src_pmd, addr,
+						     &src_ptl);
+	do {
+		if (!pte_none(*src_pte) &&
+		    !lazy_fork_skip_pte(vma, addr, *src_pte)) {
+			skip = 0;
+			break;
+		}
+	} while (src_pte++, addr += PAGE_SIZE, addr != end);
+	pte_unmap_unlock(orig_src_pte, src_ptl);
+	return skip;
+}
+
 static int copy_pte_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		pmd_t *dst_pmd, pmd_t *src_pmd, struct vm_area_struct *vma,
-		unsigned long addr, unsigned long end)
+		unsigned long addr, unsigned long end, int lazy)
 {
 	pte_t *orig_src_pte, *orig_dst_pte;
 	pte_t *src_pte, *dst_pte;
 	spinlock_t *src_ptl, *dst_ptl;
 	int progress = 0;
 	int rss[NR_MM_COUNTERS];
+	int skipped;
 	swp_entry_t entry = (swp_entry_t){0};
 
 again:
 	init_rss_vec(rss);
+	skipped = 0;
 
 	dst_pte = pte_alloc_map_lock(dst_mm, dst_pmd, addr, &dst_ptl);
 	if (!dst_pte)
@@ -797,6 +851,11 @@ again:
 			progress++;
 			continue;
 		}
+		if (lazy && lazy_fork_skip_pte(vma, addr, *src_pte)) {
+			skipped++;
+			progress++;
+			continue;
+		}
 		entry.val = copy_one_pte(dst_mm, src_mm, dst_pte, src_pte,
 							vma, addr, rss);
 		if (entry.val)
@@ -809,6 +868,8 @@ again:
 	pte_unmap_nested(orig_src_pte);
 	add_mm_rss_vec(dst_mm, rss);
 	pte_unmap_unlock(orig_dst_pte, dst_ptl);
+	if (skipped)
+		count_vm_events(PGFORKLAZY, skipped);
 	cond_resched();
 
 	if (entry.val) {
@@ -827,6 +888,7 @@ static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src
 {
 	pmd_t *src_pmd, *dst_pmd;
 	unsigned long next;
+	int lazy = lazy_fork_vma(src_mm, vma);
 
 	dst_pmd = pmd_alloc(dst_mm, dst_pud, addr);
 	if (!dst_pmd)
@@ -836,8 +898,10 @@ static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src
 		next = pmd_addr_end(addr, end);
 		if (pmd_none_or_clear_bad(src_pmd))
 			continue;
+		if (lazy && lazy_fork_skip_pmd(src_mm, src_pmd, vma, addr, next))
+			continue;
 		if (copy_pte_range(dst_mm, src_mm, dst_pmd, src_pmd,
-						vma, addr, next))
+						vma, addr, next, lazy))
 			return -ENOMEM;
 	} while (dst_pmd++, src_pmd++, addr = next, addr != end);
 	return 0;
@@ -2713,6 +2777,7 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		/* Had to read the page from swap area: Major fault */
 		ret = VM_FAULT_MAJOR;
 		count_vm_event(PGMAJFAULT);
+		count_vm_event(PGREFAULT_ANON);
 	} else if (PageHWPoison(page)) {
 		/*
 		 * hwpoisoned dirty swapcache pages are kept for killing
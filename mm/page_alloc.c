@@ -634,6 +634,104 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	spin_unlock(&zone->lock);
 }
 
+/*
+ * Give the oldest cached high-order blocks back to the buddy allocator,
+ * the largest first, until at most 'target' pages are left.
+ */
+static void free_pcp_high(struct zone *zone, struct per_cpu_pages *pcp,
+			  int target)
+{
+	int order, mt;
+
+	if (pcp->high_count <= target)
+		return;
+
+	spin_lock(&zone->lock);
+	zone->all_unreclaimable = 0;
+	zone->pages_scanned = 0;
+
+	for (order = PCP_HIGH_ORDER; order > 0; order--) {
+		for (mt = 0; mt < MIGRATE_PCPTYPES; mt++) {
+			struct list_head *list = &pcp->high_lists[order - 1][mt];
+
+			while (!list_empty(list) && pcp->high_count > target) {
+				struct page *page;
+
+				page = list_entry(list->prev, struct page, lru);
+				list_del(&page->lru);
+				pcp->high_count -= 1 << order;
+				__free_one_page(page, zone, order,
+						page_private(page));
+				__mod_zone_page_state(zone, NR_FREE_PAGES,
+						      1 << order);
+			}
+		}
+	}
+	spin_unlock(&zone->lock);
+}
+
+/*
+ * Keep a freed order 1..PCP_HIGH_ORDER block on this cpu's lists, so the
+ * next kernel stack or skb of that size doesn't need the zone lock.
+ * Returns false if the block should go to the buddy allocator instead.
+ * Called with interrupts disabled.
+ */
+static bool free_pcp_high_page(struct zone *zone, struct page *page,
+			       unsigned int order, int migratetype)
+{
+	struct per_cpu_pages *pcp;
+	int mt = migratetype;
+
+	if (order == 0 || order > PCP_HIGH_ORDER)
+		return false;
+
+	/* As for order 0: isolated blocks go back, reserve counts as movable */
+	if (mt >= MIGRATE_PCPTYPES) {
+		if (unlikely(mt == MIGRATE_ISOLATE))
+			return false;
+		mt = MIGRATE_MOVABLE;
+	}
+
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	if ((1 << order) > pcp->batch)
+		return false;
+
+	/* __free_one_page() would do this when the block goes to the buddy */
+	if (unlikely(PageCompound(page)) && destroy_compound_page(page, order))
+		return true;
+
+	set_page_private(page, migratetype);
+	list_add(&page->lru, &pcp->high_lists[order - 1][mt]);
+	pcp->high_count += 1 << order;
+	free_pcp_high(zone, pcp, pcp->batch);
+	return true;
+}
+
+/* Called with interrupts disabled */
+static struct page *rmqueue_pcp_high(struct zone *zone, unsigned int order,
+				     int migratetype)
+{
+	struct per_cpu_pages *pcp;
+	struct list_head *list;
+	struct page *page;
+
+	if (order > PCP_HIGH_ORDER)
+		return NULL;
+
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list = &pcp->high_lists[order - 1][migratetype];
+	if (list_empty(list)) {
+		pcp->high_misses++;
+		return NULL;
+	}
+
+	page = list_entry(list->next, struct page, lru);
+	list_del(&page->lru);
+	pcp->high_count -= 1 << order;
+	pcp->high_hits++;
+	return page;
+}
+
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
@@ -683,18 +781,21 @@ static bool free_pages_prepare(struct page *page, unsigned int order)
 
 static void __free_pages_ok(struct page *page, unsigned int order)
 {
+	struct zone *zone = page_zone(page);
 	unsigned long flags;
+	int migratetype;
 	int wasMlocked = __TestClearPageMlocked(page);
 
 	if (!free_pages_prepare(page, order))
 		return;
 
+	migratetype = get_pageblock_migratetype(page);
 	local_irq_save(flags);
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
-					get_pageblock_migratetype(page));
+	if (!free_pcp_high_page(zone, page, order, migratetype))
+		free_one_page(zone, page, order, migratetype);
 	local_irq_restore(flags);
 }
 
@@ -1108,6 +1209,7 @@ static void drain_pages(unsigned int cpu)
 			free_pcppages_bulk(zone, pcp->count, pcp);
 			pcp->count = 0;
 		}
+		free_pcp_high(zone, pcp, 0);
 		local_irq_restore(flags);
 	}
 }
@@ -1340,12 +1442,17 @@ again:
 			 */
 			WARN_ON_ONCE(order > 1);
 		}
-		spin_lock_irqsave(&zone->lock, flags);
-		page = __rmqueue(zone, order, migratetype);
-		spin_unlock(&zone->lock);
-		if (!page)
-			goto failed;
-		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1 << order));
+		local_irq_save(flags);
+		page = rmqueue_pcp_high(zone, order, migratetype);
+		if (!page) {
+			spin_lock(&zone->lock);
+			page = __rmqueue(zone, order, migratetype);
+			spin_unlock(&zone->lock);
+			if (!page)
+				goto failed;
+			__mod_zone_page_state(zone, NR_FREE_PAGES,
+					      -(1 << order));
+		}
 	}
 
 	__count_zone_vm_events(PGALLOC, zone, 1 << order);
@@ -2023,6 +2130,7 @@ __alloc_pages_slowpath(gfp_t gfp_mask, unsigned int order,
 
 restart:
 	wake_all_kswapd(order, zonelist, high_zoneidx);
+	wakeup_kcompactd(order);
 
 	/*
 	 * OK, we're below the kswapd watermark and have kicked background
@@ -3399,7 +3507,7 @@ static int zone_batchsize(struct zone *zone)
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
-	int migratetype;
+	int migratetype, order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -3409,6 +3517,10 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+	for (order = 0; order < PCP_HIGH_ORDER; order++)
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+		     migratetype++)
+			INIT_LIST_HEAD(&pcp->high_lists[order][migratetype]);
 }
 
 /*
@@ -3516,6 +3628,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		free_pcp_high(zone, pcp, 0);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
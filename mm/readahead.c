@@ -414,6 +414,35 @@ static int try_context_readahead(struct address_space *mapping,
 	return 1;
 }
 
+/*
+ * After this many random misses in a row the file is treated as randomly
+ * accessed: reads at the start of the file or next to cached pages no
+ * longer open a readahead window. Zip central directory lookups and dex
+ * files read with pread() look like this. A sequential miss ends it.
+ */
+#define RA_RANDOM_MISSES	4
+
+static inline int ra_random(struct file_ra_state *ra)
+{
+	return ra->random_miss >= RA_RANDOM_MISSES;
+}
+
+/*
+ * A stream that keeps using up a full window is given a bigger one, up to
+ * what POSIX_FADV_SEQUENTIAL would set.
+ */
+static unsigned long ra_grow_window(struct address_space *mapping,
+				    struct file_ra_state *ra,
+				    unsigned long max)
+{
+	unsigned long limit = mapping->backing_dev_info->ra_pages * 2;
+
+	if (ra->size < max || ra->ra_pages >= limit)
+		return max;
+	ra->ra_pages = min_t(unsigned long, ra->ra_pages * 2, limit);
+	return max_sane_readahead(ra->ra_pages);
+}
+
 /*
  * A minimal readahead algorithm for trivial sequential/random reads.
  */
@@ -428,7 +457,7 @@ ondemand_readahead(struct address_space *mapping,
 	/*
 	 * start of file
 	 */
-	if (!offset)
+	if (!offset && !ra_random(ra))
 		goto initial_readahead;
 
 	/*
@@ -437,6 +466,7 @@ ondemand_readahead(struct address_space *mapping,
 	 */
 	if ((offset == (ra->start + ra->size - ra->async_size) ||
 	     offset == (ra->start + ra->size))) {
+		max = ra_grow_window(mapping, ra, max);
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
@@ -476,20 +506,25 @@ ondemand_readahead(struct address_space *mapping,
 	/*
 	 * sequential cache miss
 	 */
-	if (offset - (ra->prev_pos >> PAGE_CACHE_SHIFT) <= 1UL)
+	if (offset - (ra->prev_pos >> PAGE_CACHE_SHIFT) <= 1UL) {
+		ra->random_miss = 0;
 		goto initial_readahead;
+	}
 
 	/*
 	 * Query the page cache and look for the traces(cached history pages)
 	 * that a sequential stream would leave behind.
 	 */
-	if (try_context_readahead(mapping, ra, offset, req_size, max))
+	if (!ra_random(ra) &&
+	    try_context_readahead(mapping, ra, offset, req_size, max))
 		goto readit;
 
 	/*
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
 	 */
+	if (!ra_random(ra))
+		ra->random_miss++;
 	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
 initial_readahead:
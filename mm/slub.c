@@ -128,14 +128,22 @@
  * Mininum number of partial slabs. These will be left on the partial
  * lists even if they are empty. kmem_cache_shrink may reclaim them.
  */
+#ifdef CONFIG_SLUB_SMALL_MEMORY
+#define MIN_PARTIAL 2
+#else
 #define MIN_PARTIAL 5
+#endif
 
 /*
  * Maximum number of desirable partial slabs.
  * The existence of more partial slabs makes kmem_cache_shrink
  * sort the partial list by the number of objects in the.
  */
+#ifdef CONFIG_SLUB_SMALL_MEMORY
+#define MAX_PARTIAL 4
+#else
 #define MAX_PARTIAL 10
+#endif
 
 #define DEBUG_DEFAULT_FLAGS (SLAB_DEBUG_FREE | SLAB_RED_ZONE | \
 				SLAB_POISON | SLAB_STORE_USER)
@@ -1443,6 +1451,58 @@ static void unfreeze_slab(struct kmem_cache *s, struct page *page, int tail)
 	}
 }
 
+/*
+ * Per cpu partial lists. A full slab that gets an object freed is put on
+ * the partial list of the freeing cpu instead of its node's, and stays
+ * frozen there. That cpu takes its next cpu slab from this list without
+ * touching list_lock. Only the owning cpu uses the list, with interrupts
+ * disabled. The slabs are chained through page->lru.next, which is not
+ * used while a slab is frozen.
+ */
+static void unfreeze_partials(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct page *page;
+
+	if (!c->partial)
+		return;
+
+	stat(s, CPU_PARTIAL_DRAIN);
+	while ((page = c->partial)) {
+		c->partial = (struct page *)page->lru.next;
+		slab_lock(page);
+		unfreeze_slab(s, page, 1);
+	}
+	c->nr_partial = 0;
+}
+
+static void put_cpu_partial(struct kmem_cache *s, struct kmem_cache_cpu *c,
+			    struct page *page)
+{
+	if (c->nr_partial >= s->cpu_partial)
+		unfreeze_partials(s, c);
+
+	page->lru.next = (struct list_head *)c->partial;
+	c->partial = page;
+	c->nr_partial++;
+	stat(s, CPU_PARTIAL_FREE);
+}
+
+/*
+ * Take a slab off the cpu partial list and lock it.
+ */
+static struct page *get_cpu_partial(struct kmem_cache_cpu *c, int node)
+{
+	struct page *page = c->partial;
+
+	if (!page || (node != -1 && page_to_nid(page) != node))
+		return NULL;
+
+	c->partial = (struct page *)page->lru.next;
+	c->nr_partial--;
+	slab_lock(page);
+	return page;
+}
+
 /*
  * Remove the cpu slab
  */
@@ -1492,8 +1552,11 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	if (likely(c && c->page))
-		flush_slab(s, c);
+	if (likely(c)) {
+		if (c->page)
+			flush_slab(s, c);
+		unfreeze_partials(s, c);
+	}
 }
 
 static void flush_cpu_slab(void *d)
@@ -1640,6 +1703,13 @@ another_slab:
 	deactivate_slab(s, c);
 
 new_slab:
+	new = get_cpu_partial(c, node);
+	if (new) {
+		c->page = new;
+		stat(s, CPU_PARTIAL_ALLOC);
+		goto load_freelist;
+	}
+
 	new = get_partial(s, gfpflags, node);
 	if (new) {
 		c->page = new;
@@ -1805,6 +1875,12 @@ checks_ok:
 	 * then add it.
 	 */
 	if (unlikely(!prior)) {
+		if (s->cpu_partial && !(SLABDEBUG && PageSlubDebug(page))) {
+			__SetPageSlubFrozen(page);
+			slab_unlock(page);
+			put_cpu_partial(s, __this_cpu_ptr(s->cpu_slab), page);
+			return;
+		}
 		add_partial(get_node(s, page_to_nid(page)), page, 1);
 		stat(s, FREE_ADD_PARTIAL);
 	}
@@ -2188,6 +2264,23 @@ static void set_min_partial(struct kmem_cache *s, unsigned long min)
 	s->min_partial = min;
 }
 
+/*
+ * Bigger objects mean more memory sitting in each slab on the cpu
+ * partial lists, so keep fewer of them.
+ */
+static void set_cpu_partial(struct kmem_cache *s)
+{
+	if (s->size >= PAGE_SIZE)
+		s->cpu_partial = 2;
+	else if (s->size >= 1024)
+		s->cpu_partial = 4;
+	else
+		s->cpu_partial = 8;
+#ifdef CONFIG_SLUB_SMALL_MEMORY
+	s->cpu_partial /= 2;
+#endif
+}
+
 /*
  * calculate_sizes() determines the order and the distribution of data within
  * a slab object.
@@ -2344,6 +2437,7 @@ static int kmem_cache_open(struct kmem_cache *s, gfp_t gfpflags,
 	 * list to avoid pounding the page allocator excessively.
 	 */
 	set_min_partial(s, ilog2(s->size));
+	set_cpu_partial(s);
 	s->refcount = 1;
 #ifdef CONFIG_NUMA
 	s->remote_node_defrag_ratio = 1000;
@@ -3140,9 +3234,72 @@ void __init kmem_cache_init(void)
 		nr_cpu_ids, nr_node_ids);
 }
 
+#ifdef CONFIG_SLUB_SMALL_MEMORY
+/*
+ * Free objects sitting in partial slabs, roughly. The cpu partial list
+ * counts are read without the cpus' cooperation, which is good enough.
+ */
+static unsigned long slub_partial_objects(void)
+{
+	struct kmem_cache *s;
+	unsigned long nr = 0;
+	int node, cpu;
+
+	list_for_each_entry(s, &slab_caches, list) {
+		unsigned long slabs = 0;
+
+		for_each_node_state(node, N_NORMAL_MEMORY)
+			slabs += get_node(s, node)->nr_partial;
+		for_each_online_cpu(cpu)
+			slabs += per_cpu_ptr(s->cpu_slab, cpu)->nr_partial;
+		nr += slabs * oo_objects(s->oo);
+	}
+	return nr;
+}
+
+/*
+ * Under memory pressure drain the cpu partial lists and hand the empty
+ * slabs kept on the node partial lists back to the page allocator. A
+ * pass goes over every cache, so do at most one a second.
+ */
+static int slub_shrink(struct shrinker *shrink, int nr_to_scan, gfp_t gfp_mask)
+{
+	static unsigned long last_shrink;
+	struct kmem_cache *s;
+	int nr;
+
+	if (!down_read_trylock(&slub_lock))
+		return nr_to_scan ? -1 : 0;
+
+	if (nr_to_scan) {
+		if (!(gfp_mask & __GFP_WAIT) ||
+		    time_before(jiffies, last_shrink + HZ)) {
+			up_read(&slub_lock);
+			return -1;
+		}
+		last_shrink = jiffies;
+		list_for_each_entry(s, &slab_caches, list)
+			kmem_cache_shrink(s);
+	}
+	nr = min_t(unsigned long, slub_partial_objects(), INT_MAX);
+	up_read(&slub_lock);
+	return nr;
+}
+
+static struct shrinker slub_shrinker = {
+	.shrink = slub_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
 void __init kmem_cache_init_late(void)
 {
+	register_shrinker(&slub_shrinker);
 }
+#else
+void __init kmem_cache_init_late(void)
+{
+}
+#endif
 
 /*
  * Find a mergeable slab cache
@@ -3940,6 +4097,40 @@ static ssize_t min_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(min_partial);
 
+static ssize_t cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->cpu_partial);
+}
+
+static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
+				 size_t length)
+{
+	unsigned long slabs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &slabs);
+	if (err)
+		return err;
+	if (slabs > MAX_PARTIAL * 4)
+		return -EINVAL;
+
+	s->cpu_partial = slabs;
+	flush_all(s);
+	return length;
+}
+SLAB_ATTR(cpu_partial);
+
+static ssize_t slabs_cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	unsigned long slabs = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		slabs += per_cpu_ptr(s->cpu_slab, cpu)->nr_partial;
+	return sprintf(buf, "%lu\n", slabs);
+}
+SLAB_ATTR_RO(slabs_cpu_partial);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -4278,6 +4469,9 @@ STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
 STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
 STAT_ATTR(DEACTIVATE_REMOTE_FREES, deactivate_remote_frees);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
+STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
+STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
+STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4286,6 +4480,8 @@ static struct attribute *slab_attrs[] = {
 	&objs_per_slab_attr.attr,
 	&order_attr.attr,
 	&min_partial_attr.attr,
+	&cpu_partial_attr.attr,
+	&slabs_cpu_partial_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&total_objects_attr.attr,
@@ -4332,6 +4528,9 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_to_tail_attr.attr,
 	&deactivate_remote_frees_attr.attr,
 	&order_fallback_attr.attr,
+	&cpu_partial_alloc_attr.attr,
+	&cpu_partial_free_attr.attr,
+	&cpu_partial_drain_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
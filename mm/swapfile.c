@@ -48,6 +48,7 @@ static unsigned int nr_swapfiles;
 long nr_swap_pages;
 long total_swap_pages;
 static int least_priority;
+unsigned int vm_swap_cost = SWAP_COST_DEFAULT;
 
 static const char Bad_file[] = "Bad swap file entry ";
 static const char Unused_file[] = "Unused swap file entry ";
@@ -58,6 +59,41 @@ struct swap_list_t swap_list = {-1, -1};
 
 struct swap_info_struct *swap_info[MAX_SWAPFILES];
 
+/*
+ * Reclaim weighs anon against file pages by the cost of the swap device
+ * new swap entries go to, the first writable one on swap_list. A block
+ * device advertises its cost with blk_queue_swap_cost(), swap files and
+ * devices that don't cost SWAP_COST_DEFAULT. Called with swap_lock held.
+ */
+static void __swap_update_cost(void)
+{
+	int i;
+
+	for (i = swap_list.head; i >= 0; i = swap_info[i]->next) {
+		struct swap_info_struct *si = swap_info[i];
+		unsigned int cost = 0;
+
+		if (!(si->flags & SWP_WRITEOK))
+			continue;
+		if (si->flags & SWP_BLKDEV)
+			cost = bdev_get_queue(si->bdev)->swap_cost;
+		vm_swap_cost = cost ? cost : SWAP_COST_DEFAULT;
+		return;
+	}
+	vm_swap_cost = SWAP_COST_DEFAULT;
+}
+
+/**
+ * swap_update_cost - pick up a changed swap cost of a block device
+ */
+void swap_update_cost(void)
+{
+	spin_lock(&swap_lock);
+	__swap_update_cost();
+	spin_unlock(&swap_lock);
+}
+EXPORT_SYMBOL_GPL(swap_update_cost);
+
 static DEFINE_MUTEX(swapon_mutex);
 
 static inline unsigned char swap_count(unsigned char ent)
@@ -233,7 +269,13 @@ static inline unsigned long scan_swap_map(struct swap_info_struct *si,
 	scan_base = offset = si->cluster_next;
 
 	if (unlikely(!si->cluster_nr--)) {
-		if (si->pages - si->inuse_pages < SWAPFILE_CLUSTER) {
+		/*
+		 * A memory backed device has no seeks to save: clusters
+		 * only spread the slots out, so keep taking the next free
+		 * one and the device's table stays compact.
+		 */
+		if (si->pages - si->inuse_pages < SWAPFILE_CLUSTER ||
+		    (si->flags & SWP_SYNCHRONOUS_IO)) {
 			si->cluster_nr = SWAPFILE_CLUSTER - 1;
 			goto checks;
 		}
@@ -1623,6 +1665,7 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	nr_swap_pages -= p->pages;
 	total_swap_pages -= p->pages;
 	p->flags &= ~SWP_WRITEOK;
+	__swap_update_cost();
 	spin_unlock(&swap_lock);
 
 	current->flags |= PF_OOM_ORIGIN;
@@ -1648,6 +1691,7 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 		nr_swap_pages += p->pages;
 		total_swap_pages += p->pages;
 		p->flags |= SWP_WRITEOK;
+		__swap_update_cost();
 		spin_unlock(&swap_lock);
 		goto out_dput;
 	}
@@ -2069,7 +2113,11 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 	}
 
 	if (p->bdev) {
-		if (blk_queue_nonrot(bdev_get_queue(p->bdev))) {
+		struct request_queue *q = bdev_get_queue(p->bdev);
+
+		if (bdi_cap_synchronous_io(&q->backing_dev_info))
+			p->flags |= SWP_SOLIDSTATE | SWP_SYNCHRONOUS_IO;
+		else if (blk_queue_nonrot(q)) {
 			p->flags |= SWP_SOLIDSTATE;
 			p->cluster_next = 1 + (random32() % p->highest_bit);
 		}
@@ -2091,10 +2139,11 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 	total_swap_pages += nr_good_pages;
 
 	printk(KERN_INFO "Adding %uk swap on %s.  "
-			 "Priority:%d extents:%d across:%lluk %s%s%s\n",
+			 "Priority:%d extents:%d across:%lluk %s%s%s%s\n",
 		nr_good_pages<<(PAGE_SHIFT-10), name, p->prio,
 		nr_extents, (unsigned long long)span<<(PAGE_SHIFT-10),
 		(p->flags & SWP_SOLIDSTATE) ? "SS" : "",
+		(p->flags & SWP_SYNCHRONOUS_IO) ? "M" : "",
 		(p->flags & SWP_DISCARDABLE) ? "D" : "",
 		(p->frontswap_map) ? "FS" : "");
 
@@ -2111,6 +2160,7 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 	else
 		swap_info[prev]->next = type;
 	frontswap_init(type);
+	__swap_update_cost();
 	spin_unlock(&swap_lock);
 	mutex_unlock(&swapon_mutex);
 	error = 0;
@@ -2288,6 +2338,9 @@ int valid_swaphandles(swp_entry_t entry, unsigned long *offset)
 		return 0;
 
 	si = swap_info[swp_type(entry)];
+	/* Reading ahead from memory only costs decompression and memory */
+	if (si->flags & SWP_SYNCHRONOUS_IO)
+		return 0;
 	target = swp_offset(entry);
 	base = (target >> our_page_cluster) << our_page_cluster;
 	end = base + (1 << our_page_cluster);
@@ -69,6 +69,11 @@
 #include <linux/gcd.h>
 #include <linux/freezer.h>
 #include <linux/sradix-tree.h>
+#include <linux/seq_file.h>
+#include <linux/power_supply.h>
+#ifdef CONFIG_HAS_EARLYSUSPEND
+#include <linux/earlysuspend.h>
+#endif
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -560,6 +565,28 @@ struct list_head vma_slot_dedup = LIST_HEAD_INIT(vma_slot_dedup);
 /* How many times the ksmd has slept since startup */
 static unsigned long long uksm_sleep_times;
 
+/*
+ * Scanning while the screen is off or on battery mostly burns power, the
+ * merges it finds can wait. With the screen off uksmd sleeps at least
+ * uksm_screen_off_sleep_jiffies between batches (0 stops it until the
+ * screen comes back on), on battery the sleep is multiplied by
+ * uksm_battery_sleep_factor. The ladder's page quota per batch stays the
+ * same, so the longer sleep lowers the share of cpu uksmd takes.
+ */
+static unsigned int uksm_screen_off_sleep_jiffies;
+static unsigned int uksm_battery_sleep_factor = 2;
+static int uksm_screen_on = 1;
+
+/*
+ * A slot that breaks COW on more than uksm_thrash_threshold percent of the
+ * pages merged in it is dropped to the lowest rung as soon as
+ * UKSM_COW_THRASH_MIN breaks are seen, without waiting for its rung to
+ * finish the round, and isn't promoted again for UKSM_THRASH_BACKOFF eval
+ * rounds.
+ */
+#define UKSM_COW_THRASH_MIN	8
+#define UKSM_THRASH_BACKOFF	4
+
 #define UKSM_RUN_STOP	0
 #define UKSM_RUN_MERGE	1
 static unsigned int uksm_run = 1;
@@ -1167,6 +1194,79 @@ void uksm_remove_vma(struct vm_area_struct *vma)
 	vma->uksm_vma_slot = NULL;
 }
 
+struct uksm_mm_walk {
+	struct vm_area_struct *vma;
+	unsigned long merged;
+	unsigned long zero;
+};
+
+static int uksm_show_pte(pte_t *pte, unsigned long addr, unsigned long end,
+			 struct mm_walk *walk)
+{
+	struct uksm_mm_walk *w = walk->private;
+	struct page *page;
+
+	if (!pte_present(*pte))
+		return 0;
+
+	if (pte_pfn(*pte) == uksm_zero_pfn) {
+		w->zero++;
+		return 0;
+	}
+
+	page = vm_normal_page(w->vma, addr, *pte);
+	if (page && PageKsm(page))
+		w->merged++;
+
+	return 0;
+}
+
+/**
+ * uksm_show_mm() - print what merging saves in each vma of @mm
+ *
+ * Shows, for every vma uksm scans, its rung, its size in pages, how many
+ * of its ptes map a merged page or the uksm zero page, and how many COW
+ * breaks it took on merged pages, followed by the totals. Backs
+ * /proc/<pid>/uksm.
+ */
+void uksm_show_mm(struct seq_file *m, struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	struct uksm_mm_walk w, total = { NULL, 0, 0 };
+	unsigned long cowed = 0;
+	struct mm_walk walk = {
+		.pte_entry = uksm_show_pte,
+		.mm = mm,
+		.private = &w,
+	};
+
+	down_read(&mm->mmap_sem);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		struct vma_slot *slot = vma->uksm_vma_slot;
+
+		if (!slot)
+			continue;
+
+		w.vma = vma;
+		w.merged = w.zero = 0;
+		walk_page_range(vma->vm_start, vma->vm_end, &walk);
+
+		seq_printf(m, "%08lx-%08lx rung %d pages %lu merged %lu "
+			   "zero %lu cowed %lu\n", vma->vm_start, vma->vm_end,
+			   slot->rung ? (int)(slot->rung - uksm_scan_ladder) : -1,
+			   slot->pages, w.merged, w.zero,
+			   slot->pages_cowed_total);
+
+		total.merged += w.merged;
+		total.zero += w.zero;
+		cowed += slot->pages_cowed_total;
+	}
+	up_read(&mm->mmap_sem);
+
+	seq_printf(m, "total merged %lu zero %lu cowed %lu\n",
+		   total.merged, total.zero, cowed);
+}
+
 /*   32/3 < they < 32/2 */
 #define shiftl	8
 #define shiftr	12
@@ -3470,6 +3570,20 @@ static inline int vma_rung_down(struct vma_slot *slot)
 	return vma_rung_enter(slot, rung);
 }
 
+static inline int slot_cow_thrashing(struct vma_slot *slot)
+{
+	return uksm_thrash_threshold &&
+	       slot->pages_cowed >= UKSM_COW_THRASH_MIN &&
+	       slot->pages_cowed * 100 >
+	       slot->pages_merged * uksm_thrash_threshold;
+}
+
+static inline int slot_thrash_backoff(struct vma_slot *slot)
+{
+	return (slot->flags & UKSM_SLOT_THRASHED) &&
+	       uksm_eval_round - slot->thrash_round < UKSM_THRASH_BACKOFF;
+}
+
 /**
  * cal_dedup_ratio() - Calculate the deduplication ratio for this slot.
  */
@@ -3990,7 +4104,8 @@ static noinline void round_update_ladder(void)
 		/* slot may be rung_rm_slot() when mm exits */
 		if (slot->snode) {
 			dedup = cal_dedup_ratio_old(slot);
-			if (dedup && dedup >= uksm_abundant_threshold)
+			if (dedup && dedup >= uksm_abundant_threshold &&
+			    !slot_thrash_backoff(slot))
 				vma_rung_up(slot);
 		}
 
@@ -4298,9 +4413,14 @@ static inline void judge_slot(struct vma_slot *slot)
 	int deleted;
 
 	dedup = cal_dedup_ratio(slot);
-	if (vma_fully_scanned(slot) && uksm_thrash_threshold)
+	if (slot_cow_thrashing(slot)) {
+		slot->flags |= UKSM_SLOT_THRASHED;
+		slot->thrash_round = uksm_eval_round;
 		deleted = vma_rung_enter(slot, &uksm_scan_ladder[0]);
-	else if (dedup && dedup >= uksm_abundant_threshold)
+	} else if (vma_fully_scanned(slot) && uksm_thrash_threshold)
+		deleted = vma_rung_enter(slot, &uksm_scan_ladder[0]);
+	else if (dedup && dedup >= uksm_abundant_threshold &&
+		 !slot_thrash_backoff(slot))
 		deleted = vma_rung_up(slot);
 	else
 		deleted = vma_rung_down(slot);
@@ -4442,7 +4562,8 @@ rm_slot:
 			vpages++;
 
 			if (rung->current_offset + rung->step > slot->pages - 1
-			    || vma_fully_scanned(slot)) {
+			    || vma_fully_scanned(slot)
+			    || slot_cow_thrashing(slot)) {
 				up_read(&slot->vma->vm_mm->mmap_sem);
 				judge_slot(slot);
 				mmsem_batch = 0;
@@ -4548,6 +4669,25 @@ static int ksmd_should_run(void)
 	return uksm_run & UKSM_RUN_MERGE;
 }
 
+/* How long to sleep after a batch given the screen and battery state */
+static long uksm_power_sleep(int screen_on)
+{
+	long sleep = uksm_sleep_real;
+
+	if (!screen_on) {
+		if (!uksm_screen_off_sleep_jiffies)
+			return MAX_SCHEDULE_TIMEOUT;
+		return max_t(long, sleep, uksm_screen_off_sleep_jiffies);
+	}
+
+	/* -ENOSYS means no power supply registered, treat as on mains */
+	if (uksm_battery_sleep_factor > 1 &&
+	    power_supply_is_system_supplied() == 0)
+		sleep *= uksm_battery_sleep_factor;
+
+	return sleep;
+}
+
 static int uksm_scan_thread(void *nothing)
 {
 	set_freezable();
@@ -4563,7 +4703,13 @@ static int uksm_scan_thread(void *nothing)
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
-			schedule_timeout_interruptible(uksm_sleep_real);
+			int screen_on = uksm_screen_on;
+
+			/* Cut a screen off sleep short when it comes back on */
+			wait_event_freezable_timeout(uksm_thread_wait,
+				uksm_screen_on != screen_on ||
+				kthread_should_stop(),
+				uksm_power_sleep(screen_on));
 			uksm_sleep_times++;
 		} else {
 			wait_event_freezable(uksm_thread_wait,
@@ -4894,6 +5040,54 @@ static ssize_t sleep_millisecs_store(struct kobject *kobj,
 }
 UKSM_ATTR(sleep_millisecs);
 
+static ssize_t screen_off_sleep_millisecs_show(struct kobject *kobj,
+					       struct kobj_attribute *attr,
+					       char *buf)
+{
+	return sprintf(buf, "%u\n",
+		       jiffies_to_msecs(uksm_screen_off_sleep_jiffies));
+}
+
+static ssize_t screen_off_sleep_millisecs_store(struct kobject *kobj,
+						struct kobj_attribute *attr,
+						const char *buf, size_t count)
+{
+	unsigned long msecs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &msecs);
+	if (err || msecs > 3600 * MSEC_PER_SEC)
+		return -EINVAL;
+
+	uksm_screen_off_sleep_jiffies = msecs_to_jiffies(msecs);
+
+	return count;
+}
+UKSM_ATTR(screen_off_sleep_millisecs);
+
+static ssize_t battery_sleep_factor_show(struct kobject *kobj,
+					 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", uksm_battery_sleep_factor);
+}
+
+static ssize_t battery_sleep_factor_store(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  const char *buf, size_t count)
+{
+	unsigned long factor;
+	int err;
+
+	err = strict_strtoul(buf, 10, &factor);
+	if (err || factor < 1 || factor > 100)
+		return -EINVAL;
+
+	uksm_battery_sleep_factor = factor;
+
+	return count;
+}
+UKSM_ATTR(battery_sleep_factor);
+
 
 static ssize_t cpu_governor_show(struct kobject *kobj,
 				  struct kobj_attribute *attr, char *buf)
@@ -5256,6 +5450,8 @@ UKSM_ATTR_RO(sleep_times);
 static struct attribute *uksm_attrs[] = {
 	&max_cpu_percentage_attr.attr,
 	&sleep_millisecs_attr.attr,
+	&screen_off_sleep_millisecs_attr.attr,
+	&battery_sleep_factor_attr.attr,
 	&cpu_governor_attr.attr,
 	&run_attr.attr,
 	&ema_per_page_time_attr.attr,
@@ -5495,6 +5691,24 @@ struct page *ksm_does_need_to_copy(struct page *page,
 	return new_page;
 }
 
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void uksm_early_suspend(struct early_suspend *h)
+{
+	uksm_screen_on = 0;
+}
+
+static void uksm_late_resume(struct early_suspend *h)
+{
+	uksm_screen_on = 1;
+	wake_up_interruptible(&uksm_thread_wait);
+}
+
+static struct early_suspend uksm_early_suspend_desc = {
+	.suspend = uksm_early_suspend,
+	.resume = uksm_late_resume,
+};
+#endif
+
 static int __init uksm_init(void)
 {
 	struct task_struct *uksm_thread;
@@ -5502,6 +5716,7 @@ static int __init uksm_init(void)
 
 	uksm_sleep_jiffies = msecs_to_jiffies(5000);
 	uksm_sleep_saved = uksm_sleep_jiffies;
+	uksm_screen_off_sleep_jiffies = msecs_to_jiffies(60 * MSEC_PER_SEC);
 
 	slot_tree_init();
 	init_scan_ladder();
@@ -5544,6 +5759,9 @@ static int __init uksm_init(void)
 	 * later callbacks could only be taking locks which nest within that.
 	 */
 	hotplug_memory_notifier(uksm_memory_callback, 100);
+#endif
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&uksm_early_suspend_desc);
 #endif
 	return 0;
 
@@ -0,0 +1,300 @@
+/* mm/vmpressure.c
+ *
+ * Memory pressure notification for userspace.
+ *
+ * Reclaim efficiency (pages reclaimed versus pages scanned) is sampled
+ * over fixed windows of scanned pages and turned into one of three
+ * levels.  Userspace opens /dev/vmpressure, optionally writes the lowest
+ * level it cares about ("low", "medium" or "critical"), and then polls;
+ * read() returns the level that fired.  This lets the framework trim
+ * caches before the low memory killer has to act.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/swap.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+#include <linux/vmpressure.h>
+
+/*
+ * Number of scanned pages over which reclaim efficiency is averaged.
+ * Smaller windows react faster but are noisier.
+ */
+static unsigned long vmpressure_win = SWAP_CLUSTER_MAX * 16;
+
+/* percentage of scanned-but-not-reclaimed pages for each level */
+static unsigned int vmpressure_level_med = 60;
+static unsigned int vmpressure_level_critical = 95;
+
+/* reclaim priority at or below which pressure is reported as critical */
+static int vmpressure_level_critical_prio = 3;
+
+static DEFINE_SPINLOCK(vmpressure_lock);
+static unsigned long vmpressure_scanned;
+static unsigned long vmpressure_reclaimed;
+
+/*
+ * One event counter per level.  An event at level L bumps the counters
+ * of L and every level below it, so a reader only has to watch the
+ * counter of the lowest level it subscribed to.
+ */
+static unsigned long vmpressure_seq[VMPRESSURE_NUM_LEVELS];
+static enum vmpressure_levels vmpressure_last;
+static DECLARE_WAIT_QUEUE_HEAD(vmpressure_wait);
+
+static const char * const vmpressure_str_levels[] = {
+	[VMPRESSURE_LOW] = "low",
+	[VMPRESSURE_MEDIUM] = "medium",
+	[VMPRESSURE_CRITICAL] = "critical",
+};
+
+struct vmpressure_reader {
+	enum vmpressure_levels level;	/* lowest level reported */
+	unsigned long seq;		/* vmpressure_seq[level] last seen */
+};
+
+static enum vmpressure_levels vmpressure_calc_level(unsigned long scanned,
+						    unsigned long reclaimed)
+{
+	unsigned long pressure;
+
+	if (reclaimed >= scanned)
+		return VMPRESSURE_LOW;
+
+	pressure = (scanned - reclaimed) * 100 / scanned;
+	if (pressure >= vmpressure_level_critical)
+		return VMPRESSURE_CRITICAL;
+	if (pressure >= vmpressure_level_med)
+		return VMPRESSURE_MEDIUM;
+	return VMPRESSURE_LOW;
+}
+
+/* must be called with vmpressure_lock held */
+static void vmpressure_event(enum vmpressure_levels level)
+{
+	int i;
+
+	for (i = 0; i <= level; i++)
+		vmpressure_seq[i]++;
+	vmpressure_last = level;
+}
+
+static bool vmpressure_gfp_ok(gfp_t gfp)
+{
+	/*
+	 * Only page cache and user memory reclaim says anything about the
+	 * memory userspace could give back.  Atomic and NOIO/NOFS
+	 * allocations reclaim under constraints and would skew the ratio.
+	 */
+	return gfp & (__GFP_HIGHMEM | __GFP_MOVABLE | __GFP_IO | __GFP_FS);
+}
+
+/**
+ * vmpressure() - account reclaim efficiency
+ * @gfp:	reclaimer's gfp mask
+ * @scanned:	number of pages scanned
+ * @reclaimed:	number of pages reclaimed
+ *
+ * Called from the global reclaim paths in mm/vmscan.c after each zone
+ * has been shrunk.  Once a window's worth of pages has been scanned the
+ * level is computed and readers are woken.
+ */
+void vmpressure(gfp_t gfp, unsigned long scanned, unsigned long reclaimed)
+{
+	enum vmpressure_levels level;
+	unsigned long flags;
+
+	if (!vmpressure_gfp_ok(gfp) || !scanned)
+		return;
+
+	spin_lock_irqsave(&vmpressure_lock, flags);
+	vmpressure_scanned += scanned;
+	vmpressure_reclaimed += reclaimed;
+	if (vmpressure_scanned < vmpressure_win) {
+		spin_unlock_irqrestore(&vmpressure_lock, flags);
+		return;
+	}
+	level = vmpressure_calc_level(vmpressure_scanned, vmpressure_reclaimed);
+	vmpressure_scanned = 0;
+	vmpressure_reclaimed = 0;
+	vmpressure_event(level);
+	spin_unlock_irqrestore(&vmpressure_lock, flags);
+
+	wake_up_interruptible(&vmpressure_wait);
+}
+
+/**
+ * vmpressure_prio() - report pressure from the reclaim priority
+ * @gfp:	reclaimer's gfp mask
+ * @prio:	reclaim priority
+ *
+ * When reclaim has dropped to a low priority the efficiency window may
+ * not fill up before the killer runs, so report critical directly.
+ */
+void vmpressure_prio(gfp_t gfp, int prio)
+{
+	unsigned long flags;
+
+	if (prio > vmpressure_level_critical_prio || !vmpressure_gfp_ok(gfp))
+		return;
+
+	spin_lock_irqsave(&vmpressure_lock, flags);
+	vmpressure_event(VMPRESSURE_CRITICAL);
+	spin_unlock_irqrestore(&vmpressure_lock, flags);
+
+	wake_up_interruptible(&vmpressure_wait);
+}
+
+static bool vmpressure_pending(struct vmpressure_reader *reader)
+{
+	return ACCESS_ONCE(vmpressure_seq[reader->level]) != reader->seq;
+}
+
+static int vmpressure_open(struct inode *inode, struct file *file)
+{
+	struct vmpressure_reader *reader;
+	int ret;
+
+	ret = nonseekable_open(inode, file);
+	if (unlikely(ret))
+		return ret;
+
+	reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+	if (!reader)
+		return -ENOMEM;
+
+	reader->level = VMPRESSURE_LOW;
+	reader->seq = ACCESS_ONCE(vmpressure_seq[VMPRESSURE_LOW]);
+	file->private_data = reader;
+
+	return 0;
+}
+
+static int vmpressure_release(struct inode *ignored, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static ssize_t vmpressure_read(struct file *file, char __user *buf,
+			       size_t count, loff_t *pos)
+{
+	struct vmpressure_reader *reader = file->private_data;
+	enum vmpressure_levels level;
+	unsigned long flags;
+	const char *str;
+	size_t len;
+	int ret;
+
+	if (!vmpressure_pending(reader)) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(vmpressure_wait,
+					       vmpressure_pending(reader));
+		if (ret)
+			return ret;
+	}
+
+	spin_lock_irqsave(&vmpressure_lock, flags);
+	reader->seq = vmpressure_seq[reader->level];
+	level = max(vmpressure_last, reader->level);
+	spin_unlock_irqrestore(&vmpressure_lock, flags);
+
+	str = vmpressure_str_levels[level];
+	len = strlen(str);
+	if (count < len + 1)
+		return -EINVAL;
+	if (copy_to_user(buf, str, len) || put_user('\n', buf + len))
+		return -EFAULT;
+
+	return len + 1;
+}
+
+/* write the lowest level this reader wants to hear about */
+static ssize_t vmpressure_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *pos)
+{
+	struct vmpressure_reader *reader = file->private_data;
+	char kbuf[16];
+	int i;
+
+	if (count >= sizeof(kbuf))
+		return -EINVAL;
+	if (copy_from_user(kbuf, buf, count))
+		return -EFAULT;
+	kbuf[count] = '\0';
+
+	for (i = 0; i < VMPRESSURE_NUM_LEVELS; i++) {
+		if (!strcmp(strstrip(kbuf), vmpressure_str_levels[i])) {
+			reader->level = i;
+			reader->seq = ACCESS_ONCE(vmpressure_seq[i]);
+			return count;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static unsigned int vmpressure_poll(struct file *file, poll_table *wait)
+{
+	struct vmpressure_reader *reader = file->private_data;
+
+	poll_wait(file, &vmpressure_wait, wait);
+
+	return vmpressure_pending(reader) ? POLLIN | POLLRDNORM : 0;
+}
+
+static const struct file_operations vmpressure_fops = {
+	.owner = THIS_MODULE,
+	.open = vmpressure_open,
+	.release = vmpressure_release,
+	.read = vmpressure_read,
+	.write = vmpressure_write,
+	.poll = vmpressure_poll,
+	.llseek = no_llseek,
+};
+
+static struct miscdevice vmpressure_misc = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "vmpressure",
+	.fops = &vmpressure_fops,
+};
+
+static int __init vmpressure_init(void)
+{
+	int ret;
+
+	ret = misc_register(&vmpressure_misc);
+	if (unlikely(ret)) {
+		printk(KERN_ERR "vmpressure: failed to register misc device!\n");
+		return ret;
+	}
+
+	return 0;
+}
+
+module_param_named(window, vmpressure_win, ulong, S_IRUGO | S_IWUSR);
+module_param_named(level_medium, vmpressure_level_med, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(level_critical, vmpressure_level_critical, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(level_critical_prio, vmpressure_level_critical_prio, int,
+		   S_IRUGO | S_IWUSR);
+
+module_init(vmpressure_init);
@@ -40,11 +40,13 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/vmpressure.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
 
 #include <linux/swapops.h>
+#include <linux/hash.h>
 
 #include "internal.h"
 
@@ -416,6 +418,59 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 	return PAGE_CLEAN;
 }
 
+/*
+ * Reclaim remembers which page cache pages it evicted, hashed by mapping
+ * and index into a bitmap, so a page read back in soon after can be
+ * counted as a refault. Once half as many evictions as there are bits
+ * went into the current bitmap the older one is cleared and takes over,
+ * so a refault is seen for about the last EVICT_HASH_SIZE evictions.
+ */
+#define EVICT_HASH_BITS		15
+#define EVICT_HASH_SIZE		(1 << EVICT_HASH_BITS)
+
+static unsigned long evict_map[2][BITS_TO_LONGS(EVICT_HASH_SIZE)];
+static unsigned int evict_gen;
+static unsigned int evict_count;
+static DEFINE_SPINLOCK(evict_lock);
+
+static unsigned long evict_hash(struct address_space *mapping, pgoff_t index)
+{
+	return hash_long((unsigned long)mapping ^
+			 hash_long(index, BITS_PER_LONG), EVICT_HASH_BITS);
+}
+
+static void note_evicted_page(struct address_space *mapping, pgoff_t index)
+{
+	spin_lock(&evict_lock);
+	__set_bit(evict_hash(mapping, index), evict_map[evict_gen]);
+	if (++evict_count >= EVICT_HASH_SIZE / 2) {
+		evict_count = 0;
+		evict_gen ^= 1;
+		bitmap_zero(evict_map[evict_gen], EVICT_HASH_SIZE);
+	}
+	spin_unlock(&evict_lock);
+}
+
+/**
+ * page_cache_refault - was this page cache page evicted by reclaim lately?
+ * @mapping: the mapping the page is being added to
+ * @index: its index in @mapping
+ *
+ * May see a false positive when two pages hash alike.
+ */
+bool page_cache_refault(struct address_space *mapping, pgoff_t index)
+{
+	unsigned long hash = evict_hash(mapping, index);
+	bool ret;
+
+	spin_lock(&evict_lock);
+	ret = __test_and_clear_bit(hash, evict_map[0]);
+	ret |= __test_and_clear_bit(hash, evict_map[1]);
+	spin_unlock(&evict_lock);
+
+	return ret;
+}
+
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
  * gets returned with a refcount of 0.
@@ -465,9 +520,13 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		spin_unlock_irq(&mapping->tree_lock);
 		swapcache_free(swap, page);
 	} else {
+		pgoff_t index = page->index;
+
 		__remove_from_page_cache(page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
+		if (page_is_file_cache(page))
+			note_evicted_page(mapping, index);
 	}
 
 	return 1;
@@ -1606,6 +1665,15 @@ static void get_scan_count(struct zone *zone, struct scan_control *sc,
 	anon_prio = sc->swappiness;
 	file_prio = 200 - sc->swappiness;
 
+	/*
+	 * vm_swap_cost is what swapping a page in from the swap device in
+	 * use costs, in percent of reading a file page back from storage.
+	 * On zram it is well below 100, so anon pages get that much more
+	 * of the pressure.
+	 */
+	if (vm_swap_cost && vm_swap_cost != SWAP_COST_DEFAULT)
+		anon_prio = anon_prio * SWAP_COST_DEFAULT / vm_swap_cost;
+
 	/*
 	 * The amount of pressure on anon vs file pages is inversely
 	 * proportional to the fraction of recently scanned pages on
@@ -1661,6 +1729,7 @@ static void shrink_zone(int priority, struct zone *zone,
 	enum lru_list l;
 	unsigned long nr_reclaimed = sc->nr_reclaimed;
 	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
+	unsigned long nr_scanned = sc->nr_scanned;
 
 	get_scan_count(zone, sc, nr, priority);
 
@@ -1690,6 +1759,9 @@ static void shrink_zone(int priority, struct zone *zone,
 			break;
 	}
 
+	if (scanning_global_lru(sc))
+		vmpressure(sc->gfp_mask, sc->nr_scanned - nr_scanned,
+			   nr_reclaimed - sc->nr_reclaimed);
 	sc->nr_reclaimed = nr_reclaimed;
 
 	/*
@@ -1835,6 +1907,8 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		sc->nr_scanned = 0;
 		if (!priority)
 			disable_swap_token();
+		if (scanning_global_lru(sc))
+			vmpressure_prio(sc->gfp_mask, priority);
 		shrink_zones(priority, zonelist, sc);
 		/*
 		 * Don't shrink slabs when reclaiming memory from
@@ -790,6 +790,8 @@ static const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+	"pgrefault_anon",
+	"pgrefault_file",
 
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
@@ -812,6 +814,8 @@ static const char * const vmstat_text[] = {
 	"unevictable_pgs_cleared",
 	"unevictable_pgs_stranded",
 	"unevictable_pgs_mlockfreed",
+
+	"pgfork_lazy",
 #endif
 };
 
@@ -856,11 +860,17 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   "\n    cpu: %i"
 			   "\n              count: %i"
 			   "\n              high:  %i"
-			   "\n              batch: %i",
+			   "\n              batch: %i"
+			   "\n              high_order: %i"
+			   "\n              high_order_hits: %u"
+			   "\n              high_order_misses: %u",
 			   i,
 			   pageset->pcp.count,
 			   pageset->pcp.high,
-			   pageset->pcp.batch);
+			   pageset->pcp.batch,
+			   pageset->pcp.high_count,
+			   pageset->pcp.high_hits,
+			   pageset->pcp.high_misses);
 #ifdef CONFIG_SMP
 		seq_printf(m, "\n  vm stats threshold: %d",
 				pageset->stat_threshold);
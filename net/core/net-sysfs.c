@@ -257,6 +257,53 @@ static ssize_t store_tx_queue_len(struct device *dev,
 	return netdev_store(dev, attr, buf, len, change_tx_queue_len);
 }
 
+NETDEVICE_SHOW(tcp_initcwnd, fmt_dec);
+
+static int change_tcp_initcwnd(struct net_device *net, unsigned long new)
+{
+	net->tcp_initcwnd = new;
+	return 0;
+}
+
+static ssize_t store_tcp_initcwnd(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t len)
+{
+	return netdev_store(dev, attr, buf, len, change_tcp_initcwnd);
+}
+
+NETDEVICE_SHOW(tcp_initrwnd, fmt_dec);
+
+static int change_tcp_initrwnd(struct net_device *net, unsigned long new)
+{
+	net->tcp_initrwnd = new;
+	return 0;
+}
+
+static ssize_t store_tcp_initrwnd(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t len)
+{
+	return netdev_store(dev, attr, buf, len, change_tcp_initrwnd);
+}
+
+NETDEVICE_SHOW(tcp_rmem_max, fmt_dec);
+
+static int change_tcp_rmem_max(struct net_device *net, unsigned long new)
+{
+	if (new > INT_MAX)
+		return -EINVAL;
+	net->tcp_rmem_max = new;
+	return 0;
+}
+
+static ssize_t store_tcp_rmem_max(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t len)
+{
+	return netdev_store(dev, attr, buf, len, change_tcp_rmem_max);
+}
+
 static ssize_t store_ifalias(struct device *dev, struct device_attribute *attr,
 			     const char *buf, size_t len)
 {
@@ -313,6 +360,12 @@ static struct device_attribute net_class_attributes[] = {
 	__ATTR(flags, S_IRUGO | S_IWUSR, show_flags, store_flags),
 	__ATTR(tx_queue_len, S_IRUGO | S_IWUSR, show_tx_queue_len,
 	       store_tx_queue_len),
+	__ATTR(tcp_initcwnd, S_IRUGO | S_IWUSR, show_tcp_initcwnd,
+	       store_tcp_initcwnd),
+	__ATTR(tcp_initrwnd, S_IRUGO | S_IWUSR, show_tcp_initrwnd,
+	       store_tcp_initrwnd),
+	__ATTR(tcp_rmem_max, S_IRUGO | S_IWUSR, show_tcp_rmem_max,
+	       store_tcp_rmem_max),
 	{}
 };
 
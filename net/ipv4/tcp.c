@@ -1105,7 +1105,7 @@ out:
 	release_sock(sk);
 
 	if (copied > 0)
-		uid_stat_tcp_snd(current_uid(), copied);
+		uid_stat_tcp_snd(sk, current_uid(), copied);
 	return copied;
 
 do_fault:
@@ -1384,7 +1384,7 @@ int tcp_read_sock(struct sock *sk, read_descriptor_t *desc,
 	/* Clean up data we have read: This will do ACK frames. */
 	if (copied > 0) {
 		tcp_cleanup_rbuf(sk, copied);
-		uid_stat_tcp_rcv(current_uid(), copied);
+		uid_stat_tcp_rcv(sk, current_uid(), copied);
 	}
 
 	return copied;
@@ -1774,7 +1774,7 @@ skip_copy:
 	release_sock(sk);
 
 	if (copied > 0)
-		uid_stat_tcp_rcv(current_uid(), copied);
+		uid_stat_tcp_rcv(sk, current_uid(), copied);
 	return copied;
 
 out:
@@ -1785,7 +1785,7 @@ out:
 recv_urg:
 	err = tcp_recv_urg(sk, msg, len, flags);
 	if (err > 0)
-		uid_stat_tcp_rcv(current_uid(), err);
+		uid_stat_tcp_rcv(sk, current_uid(), err);
 	goto out;
 }
 
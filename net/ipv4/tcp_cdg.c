@@ -0,0 +1,384 @@
+/*
+ * CAIA Delay-Gradient (CDG) congestion control
+ *
+ * This implementation is based on the paper:
+ *   D.A. Hayes and G. Armitage. "Revisiting TCP congestion control using
+ *   delay gradients." In IFIP Networking, pages 328-341. Springer, 2011.
+ *
+ * CDG backs off with a probability that grows with the gradient of the
+ * per-RTT minimum (or, failing that, maximum) round trip time, so it
+ * reacts to a queue building up in the network before the buffer
+ * overflows. This keeps the RTT of a download over a deeply buffered
+ * cellular link close to its minimum, and interactive traffic sharing the
+ * link responsive. Losses while the queue wasn't growing are taken as
+ * non-congestion losses and cost less than a halving, and a shadow window
+ * keeps CDG from starving next to loss-based flows.
+ *
+ * Deviations from the paper:
+ *  - the gradients are summed over a window instead of averaged, with
+ *    the backoff factor scaled to match;
+ *  - consecutive backoffs that don't drain the queue are taken to mean
+ *    competing loss-based flows, and delay backoffs stop until the queue
+ *    drains again;
+ *  - slow start is left when the per-RTT minimum RTT grows past the
+ *    base RTT by an eighth (at least HYSTART_DELAY_MIN).
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/inet_diag.h>
+#include <net/tcp.h>
+
+#define CDG_WINDOW		8	/* gradients summed, power of 2 */
+#define HYSTART_DELAY_MIN	2000U	/* us */
+#define CDG_U32_MAX		((u32)~0U)
+
+static int backoff_beta __read_mostly = 724;	/* 0.7071 * 1024 */
+static int backoff_factor __read_mostly = 42;
+static int use_ineff __read_mostly = 5;
+static int use_shadow __read_mostly = 1;
+static int use_tolerance __read_mostly;
+static int hystart __read_mostly = 1;
+
+module_param(backoff_beta, int, 0644);
+MODULE_PARM_DESC(backoff_beta, "Window after a delay backoff (x/1024)");
+module_param(backoff_factor, int, 0644);
+MODULE_PARM_DESC(backoff_factor, "Backoff probability scale factor");
+module_param(use_ineff, int, 0644);
+MODULE_PARM_DESC(use_ineff, "Ineffective backoffs before delay backoffs stop (0 disables)");
+module_param(use_shadow, int, 0644);
+MODULE_PARM_DESC(use_shadow, "Use shadow window for loss recovery");
+module_param(use_tolerance, int, 0644);
+MODULE_PARM_DESC(use_tolerance, "Ignore losses while the queue isn't full");
+module_param(hystart, int, 0644);
+MODULE_PARM_DESC(hystart, "Leave slow start on RTT increase");
+
+enum cdg_state {
+	CDG_UNKNOWN = 0,
+	CDG_NONFULL = 1,
+	CDG_FULL    = 2,
+	CDG_BACKOFF = 3,
+};
+
+struct cdg_minmax {
+	s32 min;
+	s32 max;
+};
+
+struct cdg {
+	struct cdg_minmax rtt;		/* this RTT, in us */
+	struct cdg_minmax rtt_prev;	/* last RTT */
+	struct cdg_minmax gsum;
+	struct cdg_minmax *gradients;	/* last CDG_WINDOW gradients */
+	u32 rtt_seq;			/* end of this RTT */
+	u32 base_rtt;			/* lowest RTT seen, in us */
+	u32 shadow_wnd;
+	u32 backoffs;
+	u16 backoff_cnt;		/* backoffs since the queue drained */
+	u8 tail;
+	u8 state;
+	u8 delack;
+};
+
+/*
+ * nexp_u32 - negative base-e exponential
+ * @ux: x in units of micro
+ *
+ * Returns exp(ux * -1e-6) * CDG_U32_MAX.
+ */
+static u32 nexp_u32(u32 ux)
+{
+	static const u16 v[] = {
+		/* exp(-x)*65536-1 for x = 0, 0.000256, 0.000512, ... */
+		65535,
+		65518, 65501, 65468, 65401, 65267, 65000, 64470, 63422,
+		61378, 57484, 50422, 38795, 22965, 8047,  987,   14,
+	};
+	u32 msb = ux >> 8;
+	u32 res;
+	int i;
+
+	/* Cut off when ux >= 2^24 (actual result is <= 222/U32_MAX). */
+	if (msb > 0xffff)
+		return 0;
+
+	/* Scale first eight bits linearly: */
+	res = CDG_U32_MAX - (ux & 0xff) * (CDG_U32_MAX / 1000000);
+
+	/* Obtain e^(x + y + ...) by computing e^x * e^y * ...: */
+	for (i = 1; msb; i++, msb >>= 1) {
+		u32 y = v[i & -(msb & 1)] + 1U;
+
+		res = ((u64)res * y) >> 16;
+	}
+
+	return res;
+}
+
+/* Gradient over the last CDG_WINDOW RTTs, updates the queue state */
+static s32 tcp_cdg_grad(struct cdg *ca)
+{
+	s32 gmin = ca->rtt.min - ca->rtt_prev.min;
+	s32 gmax = ca->rtt.max - ca->rtt_prev.max;
+	s32 grad;
+
+	/* Without the window the gradients of single RTTs are used */
+	if (ca->gradients) {
+		ca->gsum.min += gmin - ca->gradients[ca->tail].min;
+		ca->gsum.max += gmax - ca->gradients[ca->tail].max;
+		ca->gradients[ca->tail].min = gmin;
+		ca->gradients[ca->tail].max = gmax;
+		ca->tail = (ca->tail + 1) & (CDG_WINDOW - 1);
+		gmin = ca->gsum.min;
+		gmax = ca->gsum.max;
+	}
+
+	/* The sums stand in for the paper's smoothed gradients, which
+	 * simplify to (rtt_latest - rtt_oldest) / window. The division by
+	 * the window is folded into backoff_factor.
+	 */
+	grad = gmin > 0 ? gmin : gmax;
+
+	/* The queue drained, backoffs work again */
+	if (gmin <= 0 || gmax <= 0)
+		ca->backoff_cnt = 0;
+
+	if (gmin > 0 && gmax <= 0)
+		ca->state = CDG_FULL;
+	else if ((gmin > 0 && gmax > 0) || gmax < 0)
+		ca->state = CDG_NONFULL;
+
+	return grad;
+}
+
+static bool tcp_cdg_backoff(struct sock *sk, u32 grad)
+{
+	struct cdg *ca = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (random32() <= nexp_u32(grad * backoff_factor))
+		return false;
+
+	if (use_ineff) {
+		ca->backoff_cnt++;
+		if (ca->backoff_cnt > use_ineff)
+			return false;
+	}
+
+	ca->shadow_wnd = max(ca->shadow_wnd, tp->snd_cwnd);
+	ca->state = CDG_BACKOFF;
+	ca->backoffs++;
+	tcp_enter_cwr(sk, 1);
+	return true;
+}
+
+/* Leave slow start once the queue starts growing */
+static void tcp_cdg_hystart(struct sock *sk)
+{
+	struct cdg *ca = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+	u32 thresh;
+
+	if (!ca->base_rtt || !ca->rtt_prev.min)
+		return;
+
+	thresh = ca->base_rtt + max(ca->base_rtt >> 3, HYSTART_DELAY_MIN);
+	if ((u32)ca->rtt_prev.min > thresh)
+		tp->snd_ssthresh = tp->snd_cwnd;
+}
+
+static void tcp_cdg_cong_avoid(struct sock *sk, u32 ack, u32 in_flight)
+{
+	struct cdg *ca = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+	u32 prior_snd_cwnd;
+	u32 incr;
+
+	if (after(ack, ca->rtt_seq) && ca->rtt.min) {
+		s32 grad = 0;
+
+		if (ca->rtt_prev.min)
+			grad = tcp_cdg_grad(ca);
+		ca->rtt_seq = tp->snd_nxt;
+		ca->rtt_prev = ca->rtt;
+		ca->rtt.min = 0;
+		ca->rtt.max = 0;
+
+		if (grad > 0 && tcp_cdg_backoff(sk, grad))
+			return;
+
+		if (hystart && tp->snd_cwnd <= tp->snd_ssthresh)
+			tcp_cdg_hystart(sk);
+	}
+
+	if (!tcp_is_cwnd_limited(sk, in_flight)) {
+		ca->shadow_wnd = min(ca->shadow_wnd, tp->snd_cwnd);
+		return;
+	}
+
+	prior_snd_cwnd = tp->snd_cwnd;
+	tcp_reno_cong_avoid(sk, ack, in_flight);
+
+	incr = tp->snd_cwnd - prior_snd_cwnd;
+	ca->shadow_wnd = max(ca->shadow_wnd, ca->shadow_wnd + incr);
+}
+
+static void tcp_cdg_acked(struct sock *sk, u32 num_acked, s32 rtt_us)
+{
+	struct cdg *ca = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (rtt_us <= 0)
+		return;
+
+	/* A heuristic for filtering delayed ACKs, adapted from:
+	 * D.A. Hayes. "Timing enhancements to the FreeBSD kernel to support
+	 * delay and rate based TCP mechanisms." TR 100219A. CAIA, 2010.
+	 */
+	if (tp->sacked_out == 0) {
+		if (num_acked == 1 && ca->delack) {
+			/* A delayed ACK only counts for the minimum if it is
+			 * lower than an existing non-zero minimum.
+			 */
+			if (ca->rtt.min)
+				ca->rtt.min = min(ca->rtt.min, rtt_us);
+			ca->delack--;
+			return;
+		} else if (num_acked > 1 && ca->delack < 5) {
+			ca->delack++;
+		}
+	}
+
+	if (!ca->rtt.min || rtt_us < ca->rtt.min)
+		ca->rtt.min = rtt_us;
+	ca->rtt.max = max(ca->rtt.max, rtt_us);
+	if (!ca->base_rtt || (u32)rtt_us < ca->base_rtt)
+		ca->base_rtt = rtt_us;
+}
+
+static u32 tcp_cdg_ssthresh(struct sock *sk)
+{
+	struct cdg *ca = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (ca->state == CDG_BACKOFF)
+		return max(2U, (tp->snd_cwnd * min(1024, backoff_beta)) >> 10);
+
+	if (ca->state == CDG_NONFULL && use_tolerance)
+		return tp->snd_cwnd;
+
+	ca->shadow_wnd = min(ca->shadow_wnd >> 1, tp->snd_cwnd);
+	if (use_shadow)
+		return max(max(2U, ca->shadow_wnd), tp->snd_cwnd >> 1);
+	return max(2U, tp->snd_cwnd >> 1);
+}
+
+static void tcp_cdg_cwnd_event(struct sock *sk, enum tcp_ca_event ev)
+{
+	struct cdg *ca = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct cdg_minmax *gradients;
+	u32 base_rtt, backoffs;
+
+	switch (ev) {
+	case CA_EVENT_CWND_RESTART:
+		/* Idle: what was measured before says nothing about now */
+		gradients = ca->gradients;
+		if (gradients)
+			memset(gradients, 0, CDG_WINDOW * sizeof(*gradients));
+		base_rtt = ca->base_rtt;
+		backoffs = ca->backoffs;
+		memset(ca, 0, sizeof(*ca));
+		ca->gradients = gradients;
+		ca->base_rtt = base_rtt;
+		ca->backoffs = backoffs;
+		ca->rtt_seq = tp->snd_nxt;
+		ca->shadow_wnd = tp->snd_cwnd;
+		break;
+	case CA_EVENT_COMPLETE_CWR:
+		ca->state = CDG_UNKNOWN;
+		ca->rtt_seq = tp->snd_nxt;
+		ca->rtt_prev = ca->rtt;
+		ca->rtt.min = 0;
+		ca->rtt.max = 0;
+		break;
+	default:
+		break;
+	}
+}
+
+static void tcp_cdg_init(struct sock *sk)
+{
+	struct cdg *ca = inet_csk_ca(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	memset(ca, 0, sizeof(*ca));
+	/* Called from softirq for passive opens. Without memory the
+	 * gradients are simply not smoothed.
+	 */
+	ca->gradients = kcalloc(CDG_WINDOW, sizeof(*ca->gradients),
+				GFP_NOWAIT | __GFP_NOWARN);
+	ca->rtt_seq = tp->snd_nxt;
+	ca->shadow_wnd = tp->snd_cwnd;
+}
+
+static void tcp_cdg_release(struct sock *sk)
+{
+	struct cdg *ca = inet_csk_ca(sk);
+
+	kfree(ca->gradients);
+	ca->gradients = NULL;
+}
+
+/* Reported as vegas info: last RTT's minimum, base RTT, delay backoffs */
+static void tcp_cdg_get_info(struct sock *sk, u32 ext, struct sk_buff *skb)
+{
+	const struct cdg *ca = inet_csk_ca(sk);
+
+	if (ext & (1 << (INET_DIAG_VEGASINFO - 1))) {
+		struct tcpvegas_info info = {
+			.tcpv_enabled = !use_ineff ||
+					ca->backoff_cnt <= use_ineff,
+			.tcpv_rttcnt = ca->backoffs,
+			.tcpv_rtt = ca->rtt_prev.min,
+			.tcpv_minrtt = ca->base_rtt,
+		};
+
+		nla_put(skb, INET_DIAG_VEGASINFO, sizeof(info), &info);
+	}
+}
+
+static struct tcp_congestion_ops tcp_cdg = {
+	.flags		= TCP_CONG_RTT_STAMP,
+	.init		= tcp_cdg_init,
+	.release	= tcp_cdg_release,
+	.ssthresh	= tcp_cdg_ssthresh,
+	.cong_avoid	= tcp_cdg_cong_avoid,
+	.min_cwnd	= tcp_reno_min_cwnd,
+	.pkts_acked	= tcp_cdg_acked,
+	.cwnd_event	= tcp_cdg_cwnd_event,
+	.get_info	= tcp_cdg_get_info,
+
+	.owner		= THIS_MODULE,
+	.name		= "cdg",
+};
+
+static int __init tcp_cdg_register(void)
+{
+	BUILD_BUG_ON(sizeof(struct cdg) > ICSK_CA_PRIV_SIZE);
+	BUILD_BUG_ON(CDG_WINDOW & (CDG_WINDOW - 1));
+	return tcp_register_congestion_control(&tcp_cdg);
+}
+
+static void __exit tcp_cdg_unregister(void)
+{
+	tcp_unregister_congestion_control(&tcp_cdg);
+}
+
+module_init(tcp_cdg_register);
+module_exit(tcp_cdg_unregister);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("TCP CDG");
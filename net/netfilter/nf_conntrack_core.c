@@ -525,7 +525,7 @@ static noinline int early_drop(struct net *net, unsigned int hash)
 {
 	/* Use oldest entry, which is roughly LRU */
 	struct nf_conntrack_tuple_hash *h;
-	struct nf_conn *ct = NULL, *tmp;
+	struct nf_conn *ct = NULL, *tmp, *udp = NULL;
 	struct hlist_nulls_node *n;
 	unsigned int i, cnt = 0;
 	int dropped = 0;
@@ -537,6 +537,13 @@ static noinline int early_drop(struct net *net, unsigned int hash)
 			tmp = nf_ct_tuplehash_to_ctrack(h);
 			if (!test_bit(IPS_ASSURED_BIT, &tmp->status))
 				ct = tmp;
+#ifdef CONFIG_NF_CONNTRACK_SMALL
+			/* Otherwise the UDP flow closest to timing out */
+			else if (nf_ct_protonum(tmp) == IPPROTO_UDP &&
+				 (!udp || time_before(tmp->timeout.expires,
+						      udp->timeout.expires)))
+				udp = tmp;
+#endif
 			cnt++;
 		}
 
@@ -553,6 +560,14 @@ static noinline int early_drop(struct net *net, unsigned int hash)
 
 		hash = (hash + 1) % net->ct.htable_size;
 	}
+
+	if (!ct && udp) {
+		if (likely(!nf_ct_is_dying(udp) &&
+			   atomic_inc_not_zero(&udp->ct_general.use)))
+			ct = udp;
+		else
+			udp = NULL;
+	}
 	rcu_read_unlock();
 
 	if (!ct)
@@ -562,6 +577,8 @@ static noinline int early_drop(struct net *net, unsigned int hash)
 		death_by_timeout((unsigned long)ct);
 		dropped = 1;
 		NF_CT_STAT_INC_ATOMIC(net, early_drop);
+		if (ct == udp)
+			NF_CT_STAT_INC_ATOMIC(net, early_drop_udp);
 	}
 	nf_ct_put(ct);
 	return dropped;
@@ -1340,6 +1357,10 @@ static int nf_conntrack_init_init_net(void)
 			   / sizeof(struct hlist_head));
 		if (totalram_pages > (1024 * 1024 * 1024 / PAGE_SIZE))
 			nf_conntrack_htable_size = 16384;
+#ifdef CONFIG_NF_CONNTRACK_SMALL
+		/* A phone forwards for a handful of hosts, not thousands */
+		nf_conntrack_htable_size /= 4;
+#endif
 		if (nf_conntrack_htable_size < 32)
 			nf_conntrack_htable_size = 32;
 
@@ -1348,6 +1369,10 @@ static int nf_conntrack_init_init_net(void)
 		 * we use the old value of 8 to avoid reducing the max.
 		 * entries. */
 		max_factor = 4;
+#ifdef CONFIG_NF_CONNTRACK_SMALL
+		/* Shorter chains, and fewer entries to allocate */
+		max_factor = 2;
+#endif
 	}
 	nf_conntrack_max = max_factor * nf_conntrack_htable_size;
 
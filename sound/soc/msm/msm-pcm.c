@@ -129,12 +129,15 @@ void alsa_dsp_event(void *data, unsigned id, uint16_t *msg)
 				printk(KERN_ERR "bogus buffer idx\n");
 				break;
 			}
-			/* Update with actual sent buffer size */
-			if (prtd->out[idx].used != BUF_INVALID_LEN)
+			/* Update with actual sent buffer size. The writes
+			 * need not be whole periods, so wrap rather than
+			 * snapping back to the first period.
+			 */
+			if (prtd->out[idx].used != BUF_INVALID_LEN &&
+			    prtd->pcm_size) {
 				prtd->pcm_irq_pos += prtd->out[idx].used;
-
-			if (prtd->pcm_irq_pos > prtd->pcm_size)
-				prtd->pcm_irq_pos = prtd->pcm_count;
+				prtd->pcm_irq_pos %= prtd->pcm_size;
+			}
 
 			if (prtd->ops->playback)
 				prtd->ops->playback(prtd);